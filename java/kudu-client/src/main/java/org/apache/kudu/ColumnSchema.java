@@ -53,7 +53,8 @@ public class ColumnSchema {
     GROUP_VARINT(EncodingType.GROUP_VARINT),
     RLE(EncodingType.RLE),
     DICT_ENCODING(EncodingType.DICT_ENCODING),
-    BIT_SHUFFLE(EncodingType.BIT_SHUFFLE);
+    BIT_SHUFFLE(EncodingType.BIT_SHUFFLE),
+    FRAME_OF_REFERENCE(EncodingType.FRAME_OF_REFERENCE);
 
     final EncodingType internalPbType;
 
@@ -76,7 +77,8 @@ public class ColumnSchema {
     NO_COMPRESSION(CompressionType.NO_COMPRESSION),
     SNAPPY(CompressionType.SNAPPY),
     LZ4(CompressionType.LZ4),
-    ZLIB(CompressionType.ZLIB);
+    ZLIB(CompressionType.ZLIB),
+    ZSTD(CompressionType.ZSTD);
 
     final CompressionType internalPbType;
 
@@ -44,12 +44,14 @@ from kudu.schema import (int8, int16, int32, int64, string_ as string,  # noqa
                          COMPRESSION_SNAPPY,
                          COMPRESSION_LZ4,
                          COMPRESSION_ZLIB,
+                         COMPRESSION_ZSTD,
                          ENCODING_AUTO,
                          ENCODING_PLAIN,
                          ENCODING_PREFIX,
                          ENCODING_BIT_SHUFFLE,
                          ENCODING_RLE,
-                         ENCODING_DICT)
+                         ENCODING_DICT,
+                         ENCODING_FRAME_OF_REFERENCE)
 
 
 def connect(host, port=7051, admin_timeout_ms=None, rpc_timeout_ms=None):
@@ -127,6 +127,7 @@ cdef extern from "kudu/client/schema.h" namespace "kudu::client" nogil:
         EncodingType_BIT_SHUFFLE " kudu::client::KuduColumnStorageAttributes::BIT_SHUFFLE"
         EncodingType_RLE " kudu::client::KuduColumnStorageAttributes::RLE"
         EncodingType_DICT " kudu::client::KuduColumnStorageAttributes::DICT_ENCODING"
+        EncodingType_FRAME_OF_REFERENCE " kudu::client::KuduColumnStorageAttributes::FRAME_OF_REFERENCE"
 
     enum CompressionType" kudu::client::KuduColumnStorageAttributes::CompressionType":
         CompressionType_DEFAULT " kudu::client::KuduColumnStorageAttributes::DEFAULT_COMPRESSION"
@@ -134,6 +135,7 @@ cdef extern from "kudu/client/schema.h" namespace "kudu::client" nogil:
         CompressionType_SNAPPY " kudu::client::KuduColumnStorageAttributes::SNAPPY"
         CompressionType_LZ4 " kudu::client::KuduColumnStorageAttributes::LZ4"
         CompressionType_ZLIB " kudu::client::KuduColumnStorageAttributes::ZLIB"
+        CompressionType_ZSTD " kudu::client::KuduColumnStorageAttributes::ZSTD"
 
     cdef struct KuduColumnStorageAttributes:
         KuduColumnStorageAttributes()
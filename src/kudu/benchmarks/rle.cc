@@ -21,7 +21,10 @@
 // micro benchmark (rle-benchmark.cc).
 //
 
+#include <algorithm>
 #include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <ostream>
 
 #include <gflags/gflags.h>
@@ -29,6 +32,7 @@
 
 #include "kudu/gutil/basictypes.h"
 #include "kudu/gutil/mathlimits.h"
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/bit-stream-utils.h"
 #include "kudu/util/bit-stream-utils.inline.h"
 #include "kudu/util/faststring.h"
@@ -39,6 +43,9 @@
 DEFINE_int32(bitstream_num_bytes, 1 * 1024 * 1024,
              "Number of bytes worth of bits to write and read from the bitstream");
 
+using std::unique_ptr;
+using strings::Substitute;
+
 namespace kudu {
 
 // Measure writing and reading single-bit streams
@@ -101,6 +108,37 @@ void BooleanRLE() {
   }
 }
 
+// Measure decoding bit-packed literal runs one value at a time with Get()
+// against decoding them in batches with GetBatch().
+template<typename T>
+void LiteralRLE(int bit_width) {
+  const int num_values = FLAGS_bitstream_num_bytes;
+  const uint64_t mask = (1ULL << bit_width) - 1;
+
+  faststring buffer;
+  RleEncoder<T> encoder(&buffer, bit_width);
+  for (int i = 0; i < num_values; i++) {
+    // Multiplicative hashing keeps neighbors distinct, so no repeated runs form.
+    encoder.Put(static_cast<T>((i * 2654435761U) & mask));
+  }
+  encoder.Flush();
+
+  unique_ptr<T[]> values(new T[num_values]);
+  LOG_TIMING(INFO, Substitute("decoding $0-bit literals with Get()", bit_width)) {
+    RleDecoder<T> decoder(buffer.data(), encoder.len(), bit_width);
+    for (int i = 0; i < num_values; i++) {
+      decoder.Get(&values[i]);
+    }
+  }
+  LOG_TIMING(INFO, Substitute("decoding $0-bit literals with GetBatch()", bit_width)) {
+    const int kBatchSize = 1024;
+    RleDecoder<T> decoder(buffer.data(), encoder.len(), bit_width);
+    for (int i = 0; i < num_values; i += kBatchSize) {
+      decoder.GetBatch(&values[i], std::min(kBatchSize, num_values - i));
+    }
+  }
+}
+
 } // namespace kudu
 
 int main(int argc, char **argv) {
@@ -116,5 +154,10 @@ int main(int argc, char **argv) {
     kudu::BooleanRLE();
   }
 
+  kudu::LiteralRLE<bool>(1);
+  for (int bit_width : { 4, 13, 32 }) {
+    kudu::LiteralRLE<uint32_t>(bit_width);
+  }
+
   return 0;
 }
@@ -0,0 +1,593 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// Micro benchmarks for the tablet storage engine, with results written as
+// JSON so that they can be compared across versions. The benchmarks are
+// grouped as follows (see --benchmarks):
+//
+//   encoding    : encoding and decoding of blocks, per type and encoding
+//   block_cache : block cache lookups
+//   tablet      : MemRowSet inserts, DiskRowSet point lookups, application of
+//                 deltas in memory and on disk, merging scans over overlapping
+//                 rowsets, and compaction
+//   predicate   : evaluation of column predicates over column blocks
+//
+// For example, to compare the encodings of a build with those of another:
+//
+//   kudu-storage-bench --benchmarks=encoding --json_output=encoding.json
+//
+// Each benchmark is run --repetitions times. For each, the JSON output
+// includes the number of items (values, rows or lookups) and bytes processed
+// per repetition, the minimum and mean wall time and the mean CPU time of the
+// repetitions, and the resulting rate based on the minimum wall time.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "kudu/cfile/block_cache.h"
+#include "kudu/cfile/block_encodings.h"
+#include "kudu/cfile/cfile_util.h"
+#include "kudu/cfile/type_encodings.h"
+#include "kudu/common/column_predicate.h"
+#include "kudu/common/columnblock.h"
+#include "kudu/common/common.pb.h"
+#include "kudu/common/iterator.h"
+#include "kudu/common/partial_row.h"
+#include "kudu/common/rowblock.h"
+#include "kudu/common/scan_spec.h"
+#include "kudu/common/schema.h"
+#include "kudu/common/types.h"
+#include "kudu/gutil/strings/split.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/sysinfo.h"
+#include "kudu/gutil/walltime.h"
+#include "kudu/tablet/local_tablet_writer.h"
+#include "kudu/tablet/mvcc.h"
+#include "kudu/tablet/tablet-harness.h"
+#include "kudu/tablet/tablet.h"
+#include "kudu/util/env.h"
+#include "kudu/util/flags.h"
+#include "kudu/util/jsonwriter.h"
+#include "kudu/util/logging.h"
+#include "kudu/util/memory/arena.h"
+#include "kudu/util/net/net_util.h"
+#include "kudu/util/path_util.h"
+#include "kudu/util/random.h"
+#include "kudu/util/slice.h"
+#include "kudu/util/status.h"
+#include "kudu/util/stopwatch.h"
+#include "kudu/util/version_info.h"
+
+DEFINE_string(benchmarks, "encoding,block_cache,tablet,predicate",
+              "Comma-separated list of the groups of benchmarks to run.");
+DEFINE_string(json_output, "",
+              "File to write the results to, as JSON. If empty, the results "
+              "are written to stdout.");
+DEFINE_int32(repetitions, 3,
+             "Number of times each benchmark is run.");
+DEFINE_int32(num_values, 1024 * 1024,
+             "Number of values encoded and decoded, and evaluated against "
+             "predicates, per benchmark.");
+DEFINE_int32(num_rows, 100000,
+             "Number of rows inserted into the tablet by the tablet benchmarks.");
+DEFINE_int32(num_lookups, 100000,
+             "Number of lookups done by the point lookup and block cache benchmarks.");
+DEFINE_int32(num_rowsets, 4,
+             "Number of overlapping rowsets merged by the merge and compaction "
+             "benchmarks.");
+
+using kudu::cfile::BlockBuilder;
+using kudu::cfile::BlockCache;
+using kudu::cfile::BlockCacheHandle;
+using kudu::cfile::BlockDecoder;
+using kudu::cfile::TypeEncodingInfo;
+using kudu::cfile::WriterOptions;
+using kudu::tablet::LocalTabletWriter;
+using kudu::tablet::MvccSnapshot;
+using kudu::tablet::Tablet;
+using kudu::tablet::TabletHarness;
+using std::string;
+using std::unique_ptr;
+using std::unordered_map;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+
+// Collects the timings of the benchmarks and writes them out as JSON.
+class BenchmarkResults {
+ public:
+  // Runs 'f', which processes 'items' items totalling 'bytes' bytes (0 if
+  // not meaningful), and records its timing under 'name'.
+  void Time(const string& name, int64_t items, int64_t bytes,
+            const std::function<void()>& f) {
+    Stopwatch sw(Stopwatch::THIS_THREAD);
+    sw.start();
+    f();
+    sw.stop();
+    const CpuTimes times = sw.elapsed();
+
+    auto it = index_.find(name);
+    if (it == index_.end()) {
+      it = index_.emplace(name, results_.size()).first;
+      results_.emplace_back();
+      results_.back().name = name;
+    }
+    Result* result = &results_[it->second];
+    result->items = items;
+    result->bytes = bytes;
+    result->repetitions++;
+    result->min_wall_seconds = result->repetitions == 1 ?
+        times.wall_seconds() : std::min(result->min_wall_seconds, times.wall_seconds());
+    result->total_wall_seconds += times.wall_seconds();
+    result->total_cpu_seconds += times.user_cpu_seconds() + times.system_cpu_seconds();
+    LOG(INFO) << name << ": " << times.ToString() << " for " << items << " items";
+  }
+
+  void WriteJson(std::ostringstream* out) const {
+    JsonWriter jw(out, JsonWriter::PRETTY);
+    jw.StartObject();
+
+    jw.String("context");
+    jw.StartObject();
+    jw.String("version");
+    jw.String(VersionInfo::GetVersionInfo());
+    string hostname;
+    if (GetHostname(&hostname).ok()) {
+      jw.String("host");
+      jw.String(hostname);
+    }
+    jw.String("num_cpus");
+    jw.Int(base::NumCPUs());
+    jw.String("timestamp_micros");
+    jw.Int64(GetCurrentTimeMicros());
+    jw.EndObject();
+
+    jw.String("benchmarks");
+    jw.StartArray();
+    for (const auto& result : results_) {
+      const double min_wall_seconds = std::max(result.min_wall_seconds, 1e-9);
+      jw.StartObject();
+      jw.String("name");
+      jw.String(result.name);
+      jw.String("repetitions");
+      jw.Int(result.repetitions);
+      jw.String("items");
+      jw.Int64(result.items);
+      jw.String("bytes");
+      jw.Int64(result.bytes);
+      jw.String("min_wall_seconds");
+      jw.Double(result.min_wall_seconds);
+      jw.String("mean_wall_seconds");
+      jw.Double(result.total_wall_seconds / result.repetitions);
+      jw.String("mean_cpu_seconds");
+      jw.Double(result.total_cpu_seconds / result.repetitions);
+      jw.String("items_per_second");
+      jw.Double(result.items / min_wall_seconds);
+      if (result.bytes > 0) {
+        jw.String("bytes_per_second");
+        jw.Double(result.bytes / min_wall_seconds);
+      }
+      jw.EndObject();
+    }
+    jw.EndArray();
+    jw.EndObject();
+  }
+
+ private:
+  struct Result {
+    string name;
+    int repetitions = 0;
+    int64_t items = 0;
+    int64_t bytes = 0;
+    double min_wall_seconds = 0;
+    double total_wall_seconds = 0;
+    double total_cpu_seconds = 0;
+  };
+
+  // In the order in which the benchmarks first ran.
+  vector<Result> results_;
+  unordered_map<string, size_t> index_;
+};
+
+namespace {
+
+// Generates values which compress reasonably, like most real data: integers
+// are a random walk with small steps, and strings share long prefixes.
+template <DataType Type>
+void GenerateValues(Random* random, int n, Arena* arena, void* out) {
+  typedef typename TypeTraits<Type>::cpp_type CppType;
+  CppType* values = reinterpret_cast<CppType*>(out);
+  CppType value = 0;
+  for (int i = 0; i < n; i++) {
+    value += random->Uniform(16);
+    values[i] = value;
+  }
+}
+
+template <>
+void GenerateValues<DOUBLE>(Random* random, int n, Arena* arena, void* out) {
+  double* values = reinterpret_cast<double*>(out);
+  for (int i = 0; i < n; i++) {
+    values[i] = random->NextDoubleFraction();
+  }
+}
+
+template <>
+void GenerateValues<STRING>(Random* random, int n, Arena* arena, void* out) {
+  Slice* values = reinterpret_cast<Slice*>(out);
+  for (int i = 0; i < n; i++) {
+    string value = Substitute("user-$0-$1", i / 1000, random->Uniform(1000));
+    CHECK(arena->RelocateSlice(Slice(value), &values[i]));
+  }
+}
+
+// Encodes --num_values values of the given type with each of the encodings
+// which support it, and decodes them back.
+template <DataType Type>
+void BenchmarkEncodings(BenchmarkResults* results) {
+  typedef typename TypeTraits<Type>::cpp_type CppType;
+  const TypeInfo* type_info = GetTypeInfo(Type);
+  const int n = FLAGS_num_values;
+  Random random(0);
+  Arena values_arena(1024 * 1024);
+  unique_ptr<CppType[]> values(new CppType[n]);
+  GenerateValues<Type>(&random, n, &values_arena, values.get());
+
+  int64_t raw_bytes = n * sizeof(CppType);
+  if (Type == STRING) {
+    raw_bytes = 0;
+    for (int i = 0; i < n; i++) {
+      raw_bytes += reinterpret_cast<const Slice*>(&values[i])->size();
+    }
+  }
+
+  WriterOptions options;
+  options.storage_attributes.cfile_block_size = 256 * 1024;
+
+  // Dictionary encoding isn't covered: its blocks can only be decoded with
+  // the dictionary of their CFile.
+  for (EncodingType encoding : { PLAIN_ENCODING, PREFIX_ENCODING, RLE, BIT_SHUFFLE }) {
+    const TypeEncodingInfo* encoding_info;
+    if (!TypeEncodingInfo::Get(type_info, encoding, &encoding_info).ok()) {
+      continue;
+    }
+    const string prefix = Substitute("encoding/$0/$1/", DataType_Name(Type),
+                                     EncodingType_Name(encoding));
+    for (int rep = 0; rep < FLAGS_repetitions; rep++) {
+      vector<string> blocks;
+      int64_t encoded_bytes = 0;
+      results->Time(prefix + "encode", n, raw_bytes, [&]() {
+        BlockBuilder* bb_ptr;
+        CHECK_OK(encoding_info->CreateBlockBuilder(&bb_ptr, &options));
+        unique_ptr<BlockBuilder> bb(bb_ptr);
+        int pos = 0;
+        while (pos < n) {
+          bb->Reset();
+          const int first_ordinal = pos;
+          while (pos < n && !bb->IsBlockFull()) {
+            int added = bb->Add(reinterpret_cast<const uint8_t*>(&values[pos]),
+                                std::min(n - pos, 1024));
+            if (added == 0) {
+              break;
+            }
+            pos += added;
+          }
+          Slice block = bb->Finish(first_ordinal);
+          encoded_bytes += block.size();
+          blocks.emplace_back(block.ToString());
+        }
+      });
+
+      results->Time(prefix + "decode", n, encoded_bytes, [&]() {
+        const int kBatchSize = 1024;
+        unique_ptr<CppType[]> decoded(new CppType[kBatchSize]);
+        Arena arena(32 * 1024);
+        int64_t num_decoded = 0;
+        for (const auto& block : blocks) {
+          BlockDecoder* bd_ptr;
+          CHECK_OK(encoding_info->CreateBlockDecoder(&bd_ptr, Slice(block), nullptr));
+          unique_ptr<BlockDecoder> bd(bd_ptr);
+          CHECK_OK(bd->ParseHeader());
+          while (bd->HasNext()) {
+            arena.Reset();
+            ColumnBlock cb(type_info, nullptr, decoded.get(), kBatchSize, &arena);
+            ColumnDataView cdv(&cb);
+            size_t batch = kBatchSize;
+            CHECK_OK(bd->CopyNextValues(&batch, &cdv));
+            num_decoded += batch;
+          }
+        }
+        CHECK_EQ(n, num_decoded);
+      });
+    }
+  }
+}
+
+void BenchmarkEncodings(BenchmarkResults* results) {
+  BenchmarkEncodings<INT32>(results);
+  BenchmarkEncodings<INT64>(results);
+  BenchmarkEncodings<DOUBLE>(results);
+  BenchmarkEncodings<STRING>(results);
+}
+
+// Looks up random blocks in a block cache which holds all of them.
+void BenchmarkBlockCache(BenchmarkResults* results) {
+  const int kBlockSize = 32 * 1024;
+  const int kNumBlocks = 1024;
+  BlockCache cache(2L * kBlockSize * kNumBlocks);
+  BlockCache::FileId file_id(1234);
+  for (int i = 0; i < kNumBlocks; i++) {
+    BlockCache::PendingEntry entry = cache.Allocate(
+        BlockCache::CacheKey(file_id, i * kBlockSize), kBlockSize);
+    CHECK(entry.valid());
+    memset(entry.val_ptr(), 0, kBlockSize);
+    BlockCacheHandle handle;
+    cache.Insert(&entry, &handle);
+  }
+
+  Random random(0);
+  for (int rep = 0; rep < FLAGS_repetitions; rep++) {
+    results->Time("block_cache/lookup", FLAGS_num_lookups, 0, [&]() {
+      for (int i = 0; i < FLAGS_num_lookups; i++) {
+        BlockCacheHandle handle;
+        BlockCache::CacheKey key(file_id, random.Uniform(kNumBlocks) * kBlockSize);
+        CHECK(cache.Lookup(key, Cache::EXPECT_IN_CACHE, &handle));
+      }
+    });
+  }
+}
+
+// The tablet benchmarks, each of which builds on the state left by the
+// previous ones.
+class TabletBenchmark {
+ public:
+  TabletBenchmark(BenchmarkResults* results, string root_dir)
+      : results_(results),
+        root_dir_(std::move(root_dir)),
+        client_schema_({ ColumnSchema("key", INT64),
+                         ColumnSchema("val", INT32),
+                         ColumnSchema("str", STRING) }, 1) {
+  }
+
+  Status Run() {
+    RETURN_NOT_OK(Env::Default()->CreateDir(root_dir_));
+    harness_.reset(new TabletHarness(SchemaBuilder(client_schema_).Build(),
+                                     TabletHarness::Options(root_dir_)));
+    RETURN_NOT_OK(harness_->Create(true));
+    RETURN_NOT_OK(harness_->Open());
+    tablet_ = harness_->tablet().get();
+
+    // Insert the rows into the MemRowSet in 'num_rowsets' interleaved runs,
+    // each flushed into its own DiskRowSet, so that the rowsets overlap.
+    LocalTabletWriter writer(tablet_, &client_schema_);
+    const int num_rowsets = std::max(FLAGS_num_rowsets, 1);
+    for (int r = 0; r < num_rowsets; r++) {
+      const int num_rows = FLAGS_num_rows / num_rowsets;
+      Status s;
+      results_->Time("tablet/mrs_insert", num_rows, 0, [&]() {
+        for (int i = 0; i < num_rows && s.ok(); i++) {
+          s = WriteRow(&writer, RowOperationsPB::INSERT, i * num_rowsets + r, i);
+        }
+      });
+      RETURN_NOT_OK(s);
+      RETURN_NOT_OK(tablet_->Flush());
+    }
+    num_keys_ = (FLAGS_num_rows / num_rowsets) * num_rowsets;
+
+    RETURN_NOT_OK(PointLookups());
+    RETURN_NOT_OK(Scan("tablet/merge_scan", ORDERED));
+    RETURN_NOT_OK(Scan("tablet/scan", UNORDERED));
+
+    // Update every row, so that each is scanned with one delta applied:
+    // first from the DeltaMemStores, then from the flushed delta files.
+    Status s;
+    results_->Time("tablet/update", num_keys_, 0, [&]() {
+      for (int64_t key = 0; key < num_keys_ && s.ok(); key++) {
+        s = WriteRow(&writer, RowOperationsPB::UPDATE, key, -1);
+      }
+    });
+    RETURN_NOT_OK(s);
+    RETURN_NOT_OK(Scan("tablet/delta_apply/dms", UNORDERED));
+    RETURN_NOT_OK(tablet_->FlushAllDMSForTests());
+    RETURN_NOT_OK(Scan("tablet/delta_apply/delta_file", UNORDERED));
+
+    results_->Time("tablet/compaction", num_keys_, 0, [&]() {
+      s = tablet_->Compact(Tablet::FORCE_COMPACT_ALL);
+    });
+    RETURN_NOT_OK(s);
+    return Scan("tablet/scan_compacted", UNORDERED);
+  }
+
+ private:
+  Status WriteRow(LocalTabletWriter* writer, RowOperationsPB::Type type,
+                  int64_t key, int32_t val) {
+    KuduPartialRow row(&client_schema_);
+    RETURN_NOT_OK(row.SetInt64(0, key));
+    RETURN_NOT_OK(row.SetInt32(1, val));
+    if (type == RowOperationsPB::INSERT) {
+      RETURN_NOT_OK(row.SetStringCopy(2, Substitute("row-$0", key)));
+      return writer->Insert(row);
+    }
+    return writer->Update(row);
+  }
+
+  Status PointLookups() {
+    const Schema& key_schema = tablet_->key_schema();
+    Random random(0);
+    vector<int64_t> keys(FLAGS_num_lookups);
+    for (auto& key : keys) {
+      key = random.Uniform64(num_keys_);
+    }
+    Arena arena(1024);
+    RowBlock block(client_schema_, 1, &arena);
+    Status s;
+    results_->Time("tablet/drs_point_lookup", keys.size(), 0, [&]() {
+      for (size_t i = 0; i < keys.size() && s.ok(); i++) {
+        arena.Reset();
+        // An INT64 key is encoded in the key schema's row format as is.
+        vector<ConstContiguousRow> row_keys = {
+          ConstContiguousRow(&key_schema, reinterpret_cast<const uint8_t*>(&keys[i]))
+        };
+        s = tablet_->GetRows(client_schema_, row_keys, &block);
+        if (s.ok() && !block.selection_vector()->IsRowSelected(0)) {
+          s = Status::NotFound(Substitute("key $0 not found", keys[i]));
+        }
+      }
+    });
+    return s;
+  }
+
+  // Scans all the rows of the tablet.
+  Status Scan(const string& name, OrderMode order) {
+    for (int rep = 0; rep < FLAGS_repetitions; rep++) {
+      Status s;
+      int64_t num_rows = 0;
+      results_->Time(name, num_keys_, 0, [&]() {
+        s = [&]() -> Status {
+          gscoped_ptr<RowwiseIterator> iter;
+          RETURN_NOT_OK(tablet_->NewRowIterator(
+              client_schema_, MvccSnapshot(*tablet_->mvcc_manager()), order, &iter));
+          ScanSpec spec;
+          RETURN_NOT_OK(iter->Init(&spec));
+          Arena arena(32 * 1024);
+          RowBlock block(iter->schema(), 1024, &arena);
+          while (iter->HasNext()) {
+            arena.Reset();
+            RETURN_NOT_OK(iter->NextBlock(&block));
+            num_rows += block.selection_vector()->CountSelected();
+          }
+          return Status::OK();
+        }();
+      });
+      RETURN_NOT_OK(s);
+      if (num_rows != num_keys_) {
+        return Status::Corruption(Substitute("$0: scanned $1 rows, expected $2",
+                                             name, num_rows, num_keys_));
+      }
+    }
+    return Status::OK();
+  }
+
+  BenchmarkResults* const results_;
+  const string root_dir_;
+  const Schema client_schema_;
+  unique_ptr<TabletHarness> harness_;
+  Tablet* tablet_ = nullptr;
+  int64_t num_keys_ = 0;
+};
+
+// Evaluates range and equality predicates over blocks of integers and strings.
+template <DataType Type>
+void BenchmarkPredicates(BenchmarkResults* results) {
+  typedef typename TypeTraits<Type>::cpp_type CppType;
+  const int n = FLAGS_num_values;
+  Random random(0);
+  Arena arena(1024 * 1024);
+  unique_ptr<CppType[]> values(new CppType[n]);
+  GenerateValues<Type>(&random, n, &arena, values.get());
+  ColumnBlock block(GetTypeInfo(Type), nullptr, values.get(), n, &arena);
+
+  // Select about half of the values with the range, and one of them with
+  // the equality.
+  const CppType& lower = values[n / 4];
+  const CppType& upper = values[3 * n / 4];
+  const ColumnSchema column("col", Type);
+  const vector<std::pair<string, ColumnPredicate>> predicates = {
+    { "range", ColumnPredicate::Range(column, &lower, &upper) },
+    { "equality", ColumnPredicate::Equality(column, &values[n / 2]) },
+  };
+  SelectionVector sel(n);
+  for (const auto& predicate : predicates) {
+    for (int rep = 0; rep < FLAGS_repetitions; rep++) {
+      sel.SetAllTrue();
+      results->Time(Substitute("predicate/$0/$1", DataType_Name(Type), predicate.first),
+                    n, 0, [&]() {
+        predicate.second.Evaluate(block, &sel);
+      });
+    }
+  }
+}
+
+void BenchmarkPredicates(BenchmarkResults* results) {
+  BenchmarkPredicates<INT32>(results);
+  BenchmarkPredicates<INT64>(results);
+  BenchmarkPredicates<STRING>(results);
+}
+
+Status RunBenchmarks() {
+  BenchmarkResults results;
+  vector<string> groups = strings::Split(FLAGS_benchmarks, ",", strings::SkipEmpty());
+  for (const string& group : groups) {
+    if (group == "encoding") {
+      BenchmarkEncodings(&results);
+    } else if (group == "block_cache") {
+      BenchmarkBlockCache(&results);
+    } else if (group == "tablet") {
+      string test_dir;
+      RETURN_NOT_OK(Env::Default()->GetTestDirectory(&test_dir));
+      const string root_dir = JoinPathSegments(
+          test_dir, Substitute("kudu-storage-bench-$0", getpid()));
+      Status s = TabletBenchmark(&results, root_dir).Run();
+      WARN_NOT_OK(Env::Default()->DeleteRecursively(root_dir),
+                  "unable to delete the tablet benchmark's data");
+      RETURN_NOT_OK(s);
+    } else if (group == "predicate") {
+      BenchmarkPredicates(&results);
+    } else {
+      return Status::InvalidArgument("unknown group of benchmarks", group);
+    }
+  }
+
+  std::ostringstream json;
+  results.WriteJson(&json);
+  if (FLAGS_json_output.empty()) {
+    std::cout << json.str() << std::endl;
+    return Status::OK();
+  }
+  return WriteStringToFile(Env::Default(), json.str(), FLAGS_json_output);
+}
+
+} // anonymous namespace
+} // namespace kudu
+
+int main(int argc, char** argv) {
+  FLAGS_logtostderr = 1;
+  kudu::ParseCommandLineFlags(&argc, &argv, true);
+  kudu::InitGoogleLoggingSafe(argv[0]);
+
+  kudu::Status s = kudu::RunBenchmarks();
+  if (!s.ok()) {
+    LOG(ERROR) << s.ToString();
+    return 1;
+  }
+  return 0;
+}
@@ -55,6 +55,8 @@ using client::KuduClientBuilder;
 using client::KuduError;
 using client::KuduPredicate;
 using client::KuduRowResult;
+using client::KuduScanToken;
+using client::KuduScanTokenBuilder;
 using client::KuduScanner;
 using client::KuduSchema;
 using client::KuduSession;
@@ -213,6 +215,28 @@ void RpcLineItemDAO::OpenTpch1ScannerForOrderKeyRange(int64_t min_key, int64_t m
   OpenScannerImpl(tpch::GetTpchQ1QueryColumns(), preds, out_scanner);
 }
 
+void RpcLineItemDAO::GetTpch1ScanTokens(const string& return_flag,
+                                        const string& line_status,
+                                        vector<KuduScanToken*>* tokens) {
+  KuduScanTokenBuilder builder(client_table_.get());
+  CHECK_OK(builder.SetCacheBlocks(FLAGS_tpch_cache_blocks_when_scanning));
+  CHECK_OK(builder.SetProjectedColumnNames(tpch::GetTpchQ1QueryColumns()));
+  CHECK_OK(builder.AddConjunctPredicate(client_table_->NewComparisonPredicate(
+      tpch::kShipDateColName, KuduPredicate::LESS_EQUAL,
+      KuduValue::CopyString(kScanUpperBound))));
+  if (!return_flag.empty()) {
+    CHECK_OK(builder.AddConjunctPredicate(client_table_->NewComparisonPredicate(
+        tpch::kReturnFlagColName, KuduPredicate::EQUAL,
+        KuduValue::CopyString(return_flag))));
+  }
+  if (!line_status.empty()) {
+    CHECK_OK(builder.AddConjunctPredicate(client_table_->NewComparisonPredicate(
+        tpch::kLineStatusColName, KuduPredicate::EQUAL,
+        KuduValue::CopyString(line_status))));
+  }
+  CHECK_OK(builder.Build(tokens));
+}
+
 bool RpcLineItemDAO::IsTableEmpty() {
   KuduScanner scanner(client_table_.get());
   CHECK_OK(scanner.Open());
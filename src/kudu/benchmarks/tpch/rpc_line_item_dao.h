@@ -38,6 +38,7 @@ namespace kudu {
 
 namespace client {
 class KuduPredicate;
+class KuduScanToken;
 }
 
 class KuduPartialRow;
@@ -75,6 +76,13 @@ class RpcLineItemDAO {
   // select rows in the given order key range.
   void OpenTpch1ScannerForOrderKeyRange(int64_t min_orderkey, int64_t max_orderkey,
                                         gscoped_ptr<Scanner>* scanner);
+  // Builds scan tokens for the tpch1 query, which together cover the whole
+  // table, into 'tokens'; the caller takes ownership of them. If
+  // 'return_flag' and 'line_status' are not empty, the scans only select the
+  // rows of that l_returnflag and l_linestatus group.
+  void GetTpch1ScanTokens(const std::string& return_flag,
+                          const std::string& line_status,
+                          std::vector<client::KuduScanToken*>* tokens);
   bool IsTableEmpty();
 
   // TODO: this wrapper class is of limited utility now that we only have a single
@@ -26,6 +26,13 @@
 //         -tpch_num_query_iterations=1
 //         -tpch_expected_matching_rows=12345
 //
+// The query is run by -tpch_num_scan_threads threads in parallel over the
+// table's scan tokens. For each iteration, it reports where the time went:
+// the tablet servers' CPU time, the time waiting for batches beyond it
+// (mostly the network), and the time the client spent aggregating. With
+// -tpch_use_columnar_format the rows are returned in columnar layout, and
+// with -tpch_push_down_aggregation the tablet servers compute the aggregates.
+//
 // From Impala:
 // ====
 // ---- QUERY : TPCH-Q1
@@ -57,11 +64,15 @@
 // 'R','F',37719753,56568041380.90,53741292684.6,55889619119.8,25.5,38250.9,0.1,1478870
 // ====
 
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
 #include <cstdlib>
+#include <map>
+#include <memory>
 #include <ostream>
 #include <string>
-#include <unordered_map>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -71,16 +82,22 @@
 
 #include "kudu/benchmarks/tpch/line_item_tsv_importer.h"
 #include "kudu/benchmarks/tpch/rpc_line_item_dao.h"
-#include "kudu/client/row_result.h"
+#include "kudu/benchmarks/tpch/tpch-schemas.h"
+#include "kudu/client/client.h"
+#include "kudu/client/resource_metrics.h"
+#include "kudu/client/scan_batch.h"
 #include "kudu/codegen/compilation_manager.h"
+#include "kudu/common/partial_row.h"
 #include "kudu/gutil/gscoped_ptr.h"
-#include "kudu/gutil/hash/city.h"
+#include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/stringprintf.h"
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/master/mini_master.h"
 #include "kudu/mini-cluster/internal_mini_cluster.h"
 #include "kudu/util/env.h"
 #include "kudu/util/flags.h"
 #include "kudu/util/logging.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/status.h"
 #include "kudu/util/stopwatch.h"
@@ -102,46 +119,85 @@ DEFINE_int32(tpch_max_batch_size, 1000,
              "KuduSession running in AUTO_BACKGROUND_MODE flush mode.");
 DEFINE_string(table_name, "lineitem",
               "The table name to write/read");
+DEFINE_int32(tpch_num_scan_threads, 4,
+             "Number of threads running the scans of the query. The query is "
+             "split into scan tokens, which the threads pick up one at a time.");
+DEFINE_bool(tpch_use_columnar_format, false,
+            "Whether the tablet servers should return the scanned rows in "
+            "columnar layout rather than row by row. Has no effect with "
+            "--tpch_push_down_aggregation.");
+DEFINE_bool(tpch_push_down_aggregation, false,
+            "Whether the tablet servers should compute the aggregates of the "
+            "query rather than returning the rows to the client. Since sums of "
+            "expressions can't be pushed down, the discounted price and charge "
+            "aren't computed in this mode.");
 
+using std::map;
+using std::pair;
 using std::string;
-using std::unordered_map;
+using std::thread;
+using std::unique_ptr;
 using std::vector;
+using strings::Substitute;
 
 namespace kudu {
 
-using client::KuduRowResult;
+using client::KuduScanBatch;
+using client::KuduScanToken;
+using client::KuduScanner;
+using client::ResourceMetrics;
+
+// Flags of TPC-H Q1 groups, as per the TPC-H specification.
+const char* const kReturnFlags[] = { "A", "N", "R" };
+const char* const kLineStatuses[] = { "F", "O" };
 
 struct Result {
-  int32_t l_quantity;
-  double l_extendedprice;
-  double l_discount;
-  double l_tax;
-  int count;
-  Result()
-    : l_quantity(0), l_extendedprice(0), l_discount(0), l_tax(0), count(0) {
+  int64_t l_quantity = 0;
+  double l_extendedprice = 0;
+  double disc_price = 0;
+  double charge = 0;
+  double l_discount = 0;
+  int64_t count = 0;
+
+  void Merge(const Result& other) {
+    l_quantity += other.l_quantity;
+    l_extendedprice += other.l_extendedprice;
+    disc_price += other.disc_price;
+    charge += other.charge;
+    l_discount += other.l_discount;
+    count += other.count;
   }
 };
 
-// This struct is used for the keys while running the GROUP BY instead of manipulating strings
-struct SliceMapKey {
-  Slice slice;
+// Results of the GROUP BY, keyed by l_returnflag and l_linestatus. There are
+// only a handful of groups, so looking them up in an ordered map is cheap,
+// and the short keys don't allocate.
+typedef map<pair<string, string>, Result> ResultMap;
 
-  // This copies the string out of the result buffer
-  void RelocateSlice() {
-    auto buf = new uint8_t[slice.size()];
-    slice.relocate(buf);
-  }
+// Where the time of a query was spent, summed over the scanner threads.
+struct PhaseTimes {
+  // Time spent waiting for the tablet servers to scan and return batches,
+  // including the network round trips.
+  int64_t fetch_nanos = 0;
+  // CPU time the tablet servers spent on the scans.
+  int64_t server_cpu_nanos = 0;
+  // Time spent aggregating the rows in the client.
+  int64_t aggregate_nanos = 0;
+  int64_t rows = 0;
 
-  bool operator==(const SliceMapKey &other_key) const {
-    return slice == other_key.slice;
+  void Merge(const PhaseTimes& other) {
+    fetch_nanos += other.fetch_nanos;
+    server_cpu_nanos += other.server_cpu_nanos;
+    aggregate_nanos += other.aggregate_nanos;
+    rows += other.rows;
   }
 };
 
-struct Hash {
-  size_t operator()(const SliceMapKey &key) const {
-    return util_hash::CityHash64(
-      reinterpret_cast<const char *>(key.slice.data()), key.slice.size());
-  }
+// A scan for one of the scanner threads to run.
+struct ScanTask {
+  // With --tpch_push_down_aggregation, the group whose rows the scan selects.
+  pair<string, string> group;
+  unique_ptr<KuduScanToken> token;
 };
 
 void LoadLineItems(const string &path, RpcLineItemDAO *dao) {
@@ -161,86 +217,251 @@ void WarmupScanCache(RpcLineItemDAO* dao) {
   codegen::CompilationManager::GetSingleton()->Wait();
 }
 
-void Tpch1(RpcLineItemDAO *dao) {
-  typedef unordered_map<SliceMapKey, Result*, Hash> slice_map;
-  typedef unordered_map<SliceMapKey, slice_map*, Hash> slice_map_map;
+void AddServerCpu(const KuduScanner& scanner, PhaseTimes* times) {
+  const ResourceMetrics& metrics = scanner.GetResourceMetrics();
+  times->server_cpu_nanos +=
+      metrics.GetMetric("cpu_user_nanos") + metrics.GetMetric("cpu_system_nanos");
+}
 
-  gscoped_ptr<RpcLineItemDAO::Scanner> scanner;
-  dao->OpenTpch1Scanner(&scanner);
+// Aggregates the rows of a batch in the default row-wise layout.
+void AggregateRows(const KuduScanBatch& batch, pair<string, string>* key,
+                   ResultMap* results) {
+  for (KuduScanBatch::RowPtr row : batch) {
+    Slice l_returnflag;
+    CHECK_OK(row.GetString(1, &l_returnflag));
+    Slice l_linestatus;
+    CHECK_OK(row.GetString(2, &l_linestatus));
+    int32_t l_quantity;
+    CHECK_OK(row.GetInt32(3, &l_quantity));
+    double l_extendedprice;
+    CHECK_OK(row.GetDouble(4, &l_extendedprice));
+    double l_discount;
+    CHECK_OK(row.GetDouble(5, &l_discount));
+    double l_tax;
+    CHECK_OK(row.GetDouble(6, &l_tax));
 
-  int matching_rows = 0;
-  slice_map_map results;
-  Result *r;
-  vector<KuduRowResult> rows;
-  while (scanner->HasMore()) {
-    scanner->GetNext(&rows);
-    for (const KuduRowResult& row : rows) {
-      matching_rows++;
-
-      SliceMapKey l_returnflag;
-      CHECK_OK(row.GetString(1, &l_returnflag.slice));
-      SliceMapKey l_linestatus;
-      CHECK_OK(row.GetString(2, &l_linestatus.slice));
-      int32_t l_quantity;
-      CHECK_OK(row.GetInt32(3, &l_quantity));
-      double l_extendedprice;
-      CHECK_OK(row.GetDouble(4, &l_extendedprice));
-      double l_discount;
-      CHECK_OK(row.GetDouble(5, &l_discount));
-      double l_tax;
-      CHECK_OK(row.GetDouble(6, &l_tax));
-
-      slice_map *linestatus_map;
-      auto it = results.find(l_returnflag);
-      if (it == results.end()) {
-        linestatus_map = new slice_map;
-        l_returnflag.RelocateSlice();
-        results[l_returnflag] = linestatus_map;
-      } else {
-        linestatus_map = it->second;
+    key->first.assign(reinterpret_cast<const char*>(l_returnflag.data()),
+                      l_returnflag.size());
+    key->second.assign(reinterpret_cast<const char*>(l_linestatus.data()),
+                       l_linestatus.size());
+    Result* r = &(*results)[*key];
+    const double disc_price = l_extendedprice * (1 - l_discount);
+    r->l_quantity += l_quantity;
+    r->l_extendedprice += l_extendedprice;
+    r->disc_price += disc_price;
+    r->charge += disc_price * (1 + l_tax);
+    r->l_discount += l_discount;
+    r->count++;
+  }
+}
+
+// Aggregates the rows of a batch in columnar layout, reading each column
+// directly out of the response sidecars.
+void AggregateColumns(const KuduScanBatch& batch, pair<string, string>* key,
+                      ResultMap* results) {
+  Slice returnflag_offsets, returnflag_data;
+  CHECK_OK(batch.GetVariableLengthColumn(1, &returnflag_offsets, &returnflag_data));
+  Slice linestatus_offsets, linestatus_data;
+  CHECK_OK(batch.GetVariableLengthColumn(2, &linestatus_offsets, &linestatus_data));
+  Slice quantity, extendedprice, discount, tax;
+  CHECK_OK(batch.GetFixedLengthColumn(3, &quantity));
+  CHECK_OK(batch.GetFixedLengthColumn(4, &extendedprice));
+  CHECK_OK(batch.GetFixedLengthColumn(5, &discount));
+  CHECK_OK(batch.GetFixedLengthColumn(6, &tax));
+
+  const auto* rf_offsets = reinterpret_cast<const uint32_t*>(returnflag_offsets.data());
+  const auto* ls_offsets = reinterpret_cast<const uint32_t*>(linestatus_offsets.data());
+  const auto* l_quantity = reinterpret_cast<const int32_t*>(quantity.data());
+  const auto* l_extendedprice = reinterpret_cast<const double*>(extendedprice.data());
+  const auto* l_discount = reinterpret_cast<const double*>(discount.data());
+  const auto* l_tax = reinterpret_cast<const double*>(tax.data());
+  for (int i = 0; i < batch.NumRows(); i++) {
+    key->first.assign(reinterpret_cast<const char*>(returnflag_data.data()) + rf_offsets[i],
+                      rf_offsets[i + 1] - rf_offsets[i]);
+    key->second.assign(reinterpret_cast<const char*>(linestatus_data.data()) + ls_offsets[i],
+                       ls_offsets[i + 1] - ls_offsets[i]);
+    Result* r = &(*results)[*key];
+    const double disc_price = l_extendedprice[i] * (1 - l_discount[i]);
+    r->l_quantity += l_quantity[i];
+    r->l_extendedprice += l_extendedprice[i];
+    r->disc_price += disc_price;
+    r->charge += disc_price * (1 + l_tax[i]);
+    r->l_discount += l_discount[i];
+    r->count++;
+  }
+}
+
+// Runs the scan of 'task', fetching the rows and aggregating them into
+// 'results'.
+void ScanAndAggregate(const ScanTask& task, ResultMap* results, PhaseTimes* times) {
+  KuduScanner* scanner_ptr;
+  CHECK_OK(task.token->IntoKuduScanner(&scanner_ptr));
+  unique_ptr<KuduScanner> scanner(scanner_ptr);
+  if (FLAGS_tpch_use_columnar_format) {
+    CHECK_OK(scanner->SetRowFormatFlags(KuduScanner::COLUMNAR_LAYOUT));
+  }
+
+  MonoTime start = MonoTime::Now();
+  CHECK_OK(scanner->Open());
+  KuduScanBatch batch;
+  pair<string, string> key;
+  while (scanner->HasMoreRows()) {
+    CHECK_OK(scanner->NextBatch(&batch));
+    MonoTime fetched = MonoTime::Now();
+    times->fetch_nanos += (fetched - start).ToNanoseconds();
+    if (FLAGS_tpch_use_columnar_format) {
+      AggregateColumns(batch, &key, results);
+    } else {
+      AggregateRows(batch, &key, results);
+    }
+    times->rows += batch.NumRows();
+    start = MonoTime::Now();
+    times->aggregate_nanos += (start - fetched).ToNanoseconds();
+  }
+  times->fetch_nanos += (MonoTime::Now() - start).ToNanoseconds();
+  AddServerCpu(*scanner, times);
+}
+
+// Runs the scan of 'task' with the tablet servers computing the aggregates
+// of its group, and adds them to 'results'.
+//
+// Aggregates can only be grouped by a prefix of the primary key, so each
+// group of the query is scanned separately, with the group's l_returnflag
+// and l_linestatus as predicates. The sums of expressions aren't supported
+// either, so the discounted prices and charges are left out.
+void ScanWithPushedDownAggregates(const ScanTask& task, ResultMap* results,
+                                  PhaseTimes* times) {
+  KuduScanner* scanner_ptr;
+  CHECK_OK(task.token->IntoKuduScanner(&scanner_ptr));
+  unique_ptr<KuduScanner> scanner(scanner_ptr);
+  CHECK_OK(scanner->AddAggregate(KuduScanner::COUNT, ""));
+  CHECK_OK(scanner->AddAggregate(KuduScanner::SUM, tpch::kQuantityColName));
+  CHECK_OK(scanner->AddAggregate(KuduScanner::SUM, tpch::kExtendedPriceColName));
+  CHECK_OK(scanner->AddAggregate(KuduScanner::SUM, tpch::kDiscountColName));
+
+  MonoTime start = MonoTime::Now();
+  CHECK_OK(scanner->Open());
+  vector<KuduPartialRow*> rows;
+  ElementDeleter d(&rows);
+  CHECK_OK(scanner->GetAggregateResults(&rows));
+  MonoTime fetched = MonoTime::Now();
+  times->fetch_nanos += (fetched - start).ToNanoseconds();
+
+  CHECK_EQ(1, rows.size());
+  const KuduPartialRow& row = *rows[0];
+  int64_t count;
+  CHECK_OK(row.GetInt64("count(*)", &count));
+  if (count > 0) {
+    Result partial;
+    partial.count = count;
+    CHECK_OK(row.GetInt64(Substitute("sum($0)", tpch::kQuantityColName), &partial.l_quantity));
+    CHECK_OK(row.GetDouble(Substitute("sum($0)", tpch::kExtendedPriceColName),
+                           &partial.l_extendedprice));
+    CHECK_OK(row.GetDouble(Substitute("sum($0)", tpch::kDiscountColName),
+                           &partial.l_discount));
+    (*results)[task.group].Merge(partial);
+  }
+  times->rows += count;
+  times->aggregate_nanos += (MonoTime::Now() - fetched).ToNanoseconds();
+  AddServerCpu(*scanner, times);
+}
+
+void Tpch1(RpcLineItemDAO *dao) {
+  vector<ScanTask> tasks;
+  auto add_tasks = [&](const string& return_flag, const string& line_status) {
+    vector<KuduScanToken*> tokens;
+    dao->GetTpch1ScanTokens(return_flag, line_status, &tokens);
+    for (KuduScanToken* token : tokens) {
+      ScanTask task;
+      task.group = { return_flag, line_status };
+      task.token.reset(token);
+      tasks.emplace_back(std::move(task));
+    }
+  };
+  if (FLAGS_tpch_push_down_aggregation) {
+    for (const char* return_flag : kReturnFlags) {
+      for (const char* line_status : kLineStatuses) {
+        add_tasks(return_flag, line_status);
       }
+    }
+  } else {
+    add_tasks("", "");
+  }
 
-      auto inner_it = linestatus_map->find(l_linestatus);
-      if (inner_it == linestatus_map->end()) {
-        r = new Result();
-        l_linestatus.RelocateSlice();
-        (*linestatus_map)[l_linestatus] = r;
-      } else {
-        r = inner_it->second;
+  // Each thread aggregates the scans it runs separately, and the partial
+  // results are merged once all the scans are done.
+  const int num_threads = std::max(FLAGS_tpch_num_scan_threads, 1);
+  vector<ResultMap> thread_results(num_threads);
+  vector<PhaseTimes> thread_times(num_threads);
+  std::atomic<size_t> next_task(0);
+  vector<thread> threads;
+  Stopwatch sw;
+  sw.start();
+  for (int t = 0; t < num_threads; t++) {
+    threads.emplace_back([&, t]() {
+      for (size_t i = next_task++; i < tasks.size(); i = next_task++) {
+        if (FLAGS_tpch_push_down_aggregation) {
+          ScanWithPushedDownAggregates(tasks[i], &thread_results[t], &thread_times[t]);
+        } else {
+          ScanAndAggregate(tasks[i], &thread_results[t], &thread_times[t]);
+        }
       }
-      r->l_quantity += l_quantity;
-      r->l_extendedprice += l_extendedprice;
-      r->l_discount += l_discount;
-      r->l_tax += l_tax;
-      r->count++;
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  sw.stop();
+  const double scan_wall_ms = sw.elapsed().wall_millis();
+
+  sw.start();
+  ResultMap results;
+  PhaseTimes times;
+  for (int t = 0; t < num_threads; t++) {
+    for (const auto& entry : thread_results[t]) {
+      results[entry.first].Merge(entry.second);
     }
+    times.Merge(thread_times[t]);
   }
+  sw.stop();
+  const double merge_wall_ms = sw.elapsed().wall_millis();
+
   LOG(INFO) << "Result: ";
-  for (const auto& result : results) {
-    const SliceMapKey returnflag = result.first;
-    const auto* maps = result.second;
-    for (const auto& map : *maps) {
-      const SliceMapKey linestatus = map.first;
-      Result* r = map.second;
-      double avg_q = static_cast<double>(r->l_quantity) / r->count;
-      double avg_ext_p = r->l_extendedprice / r->count;
-      double avg_discount = r->l_discount / r->count;
-      LOG(INFO) << returnflag.slice.ToString() << ", " <<
-                   linestatus.slice.ToString() << ", " <<
-                   r->l_quantity << ", " <<
-                   StringPrintf("%.2f", r->l_extendedprice) << ", " <<
-                   // TODO those two are missing at the moment, might want to change Result
-                   // sum(l_extendedprice * (1 - l_discount))
-                   // sum(l_extendedprice * (1 - l_discount) * (1 + l_tax))
-                   StringPrintf("%.2f", avg_q) << ", " <<
-                   StringPrintf("%.2f", avg_ext_p) << ", " <<
-                   StringPrintf("%.2f", avg_discount) << ", " <<
-                   r->count;
-      delete r;
-      delete linestatus.slice.data();
-    }
-    delete maps;
-    delete returnflag.slice.data();
+  for (const auto& entry : results) {
+    const Result& r = entry.second;
+    double avg_q = static_cast<double>(r.l_quantity) / r.count;
+    double avg_ext_p = r.l_extendedprice / r.count;
+    double avg_discount = r.l_discount / r.count;
+    LOG(INFO) << entry.first.first << ", " <<
+                 entry.first.second << ", " <<
+                 r.l_quantity << ", " <<
+                 StringPrintf("%.2f", r.l_extendedprice) << ", " <<
+                 (FLAGS_tpch_push_down_aggregation ?
+                  "-, -" :
+                  StringPrintf("%.2f, %.2f", r.disc_price, r.charge)) << ", " <<
+                 StringPrintf("%.2f", avg_q) << ", " <<
+                 StringPrintf("%.2f", avg_ext_p) << ", " <<
+                 StringPrintf("%.2f", avg_discount) << ", " <<
+                 r.count;
+  }
+
+  // The time spent waiting for batches beyond the servers' CPU time is
+  // mostly the network, plus any disk IO and queueing on the servers.
+  const int64_t network_nanos =
+      std::max<int64_t>(times.fetch_nanos - times.server_cpu_nanos, 0);
+  LOG(INFO) << Substitute(
+      "Scanned $0 rows in $1 tasks with $2 threads in $3 ms ($4 rows/s)",
+      times.rows, tasks.size(), num_threads, scan_wall_ms,
+      scan_wall_ms > 0 ? static_cast<int64_t>(times.rows * 1000 / scan_wall_ms) : 0);
+  LOG(INFO) << Substitute(
+      "Phase times summed over threads: server scan (CPU) $0 ms, network and "
+      "waiting $1 ms, client aggregation $2 ms; merging took $3 ms",
+      times.server_cpu_nanos / 1000000, network_nanos / 1000000,
+      times.aggregate_nanos / 1000000, merge_wall_ms);
+
+  int64_t matching_rows = 0;
+  for (const auto& entry : results) {
+    matching_rows += entry.second.count;
   }
   if (FLAGS_tpch_check_matching_rows) {
     CHECK_EQ(matching_rows, FLAGS_tpch_expected_matching_rows) << "Wrong number of rows returned";
@@ -169,6 +169,15 @@ Status BinaryDictBlockBuilder::AppendExtraInfo(CFileWriter* c_writer, CFileFoote
   return Status::OK();
 }
 
+size_t BinaryDictBlockBuilder::ExtraInfoSize() const {
+  // Each string is stored along with its offset.
+  size_t size = 0;
+  for (const auto& entry : dictionary_) {
+    size += entry.first.size() + sizeof(uint32_t);
+  }
+  return size;
+}
+
 size_t BinaryDictBlockBuilder::Count() const {
   return data_builder_->Count();
 }
@@ -204,7 +213,7 @@ Status BinaryDictBlockBuilder::GetLastKey(void* key_void) const {
 BinaryDictBlockDecoder::BinaryDictBlockDecoder(Slice slice, CFileIterator* iter)
     : data_(slice),
       parsed_(false),
-      dict_decoder_(iter->GetDictDecoder()),
+      dict_decoder_(down_cast<BinaryPlainBlockDecoder*>(iter->GetDictDecoder())),
       parent_cfile_iter_(iter) {
 }
 
@@ -264,10 +273,6 @@ Status BinaryDictBlockDecoder::SeekAtOrAfterValue(const void* value_void, bool*
   }
 }
 
-// TODO: implement CopyNextAndEval for more blocks. Eg. other blocks can
-// store their min/max values. CopyNextAndEval in these blocks could
-// short-circuit if the query can does not search for values within the
-// min/max range, or copy all and evaluate otherwise.
 Status BinaryDictBlockDecoder::CopyNextAndEval(size_t* n,
                                                ColumnMaterializationContext* ctx,
                                                SelectionVectorView* sel,
@@ -291,8 +296,10 @@ Status BinaryDictBlockDecoder::CopyNextAndEval(size_t* n,
     return Status::OK();
   }
 
-  // IsNotNull predicates should return all data.
-  if (ctx->pred()->predicate_type() == PredicateType::IsNotNull) {
+  // IsNotNull predicates, and predicates that match every word, should
+  // return all data.
+  if (ctx->pred()->predicate_type() == PredicateType::IsNotNull ||
+      parent_cfile_iter_->AllCodeWordsMatchPredicate()) {
     return CopyNextDecodeStrings(n, dst);
   }
 
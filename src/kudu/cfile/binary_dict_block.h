@@ -90,6 +90,8 @@ class BinaryDictBlockBuilder final : public BlockBuilder {
   // accordingly.
   Status AppendExtraInfo(CFileWriter* c_writer, CFileFooterPB* footer) OVERRIDE;
 
+  size_t ExtraInfoSize() const OVERRIDE;
+
   int Add(const uint8_t* vals, size_t count) OVERRIDE;
 
   Slice Finish(rowid_t ordinal_pos) OVERRIDE;
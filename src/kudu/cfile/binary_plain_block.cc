@@ -163,7 +163,8 @@ BinaryPlainBlockDecoder::BinaryPlainBlockDecoder(Slice slice)
       parsed_(false),
       num_elems_(0),
       ordinal_pos_base_(0),
-      cur_idx_(0) {
+      cur_idx_(0),
+      reference_block_data_(false) {
 }
 
 Status BinaryPlainBlockDecoder::ParseHeader() {
@@ -307,6 +308,11 @@ Status BinaryPlainBlockDecoder::HandleBatch(size_t* n, ColumnDataView* dst, Cell
 }
 
 Status BinaryPlainBlockDecoder::CopyNextValues(size_t* n, ColumnDataView* dst) {
+  if (reference_block_data_) {
+    return HandleBatch(n, dst, [&](size_t i, Slice elem, Slice* out, Arena* out_arena) {
+      *out = elem;
+    });
+  }
   return HandleBatch(n, dst, [&](size_t i, Slice elem, Slice* out, Arena* out_arena) {
     CHECK(out_arena->RelocateSlice(elem, out));
   });
@@ -321,7 +327,11 @@ Status BinaryPlainBlockDecoder::CopyNextAndEval(size_t* n,
     if (!sel->TestBit(i)) {
       return;
     } else if (ctx->pred()->EvaluateCell<BINARY>(static_cast<const void*>(&elem))) {
-      CHECK(out_arena->RelocateSlice(elem, out));
+      if (reference_block_data_) {
+        *out = elem;
+      } else {
+        CHECK(out_arena->RelocateSlice(elem, out));
+      }
     } else {
       sel->ClearBit(i);
     }
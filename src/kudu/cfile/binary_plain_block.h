@@ -143,6 +143,14 @@ class BinaryPlainBlockDecoder final : public BlockDecoder {
     return Slice(&data_[str_offset], len);
   }
 
+  // If set, the decoded cells point into the block's data instead of being
+  // copied into the destination arena. The caller must then keep the block's
+  // data alive for as long as the decoded cells, e.g. by retaining it in the
+  // destination arena.
+  void set_reference_block_data(bool reference) {
+    reference_block_data_ = reference;
+  }
+
   // Minimum length of a header.
   static const size_t kMinHeaderSize = sizeof(uint32_t) * 3;
 
@@ -183,6 +191,9 @@ class BinaryPlainBlockDecoder final : public BlockDecoder {
 
   // Index of the currently seeked element in the block.
   uint32_t cur_idx_;
+
+  // See set_reference_block_data().
+  bool reference_block_data_;
 };
 
 } // namespace cfile
@@ -26,13 +26,16 @@
 // Include the bitshuffle header again, but this time importing the
 // AVX2-compiled symbols by defining some macros.
 #undef BITSHUFFLE_H
+#undef BITSHUFFLE_CORE_H
 #define bshuf_compress_lz4_bound bshuf_compress_lz4_bound_avx2
 #define bshuf_compress_lz4 bshuf_compress_lz4_avx2
 #define bshuf_decompress_lz4 bshuf_decompress_lz4_avx2
+#define bshuf_bitunshuffle bshuf_bitunshuffle_avx2
 #include <bitshuffle.h> // NOLINT(*)
 #undef bshuf_compress_lz4_bound
 #undef bshuf_compress_lz4
 #undef bshuf_decompress_lz4
+#undef bshuf_bitunshuffle
 
 #include "kudu/gutil/cpu.h"
 
@@ -48,6 +51,7 @@ namespace {
 decltype(&bshuf_compress_lz4_bound) g_bshuf_compress_lz4_bound;
 decltype(&bshuf_compress_lz4) g_bshuf_compress_lz4;
 decltype(&bshuf_decompress_lz4) g_bshuf_decompress_lz4;
+decltype(&bshuf_bitunshuffle) g_bshuf_bitunshuffle;
 } // anonymous namespace
 
 // When this translation unit is initialized, figure out the current CPU and
@@ -62,15 +66,19 @@ void SelectBitshuffleFunctions() {
     g_bshuf_compress_lz4_bound = bshuf_compress_lz4_bound_avx2;
     g_bshuf_compress_lz4 = bshuf_compress_lz4_avx2;
     g_bshuf_decompress_lz4 = bshuf_decompress_lz4_avx2;
+    g_bshuf_bitunshuffle = bshuf_bitunshuffle_avx2;
   } else {
     g_bshuf_compress_lz4_bound = bshuf_compress_lz4_bound;
     g_bshuf_compress_lz4 = bshuf_compress_lz4;
     g_bshuf_decompress_lz4 = bshuf_decompress_lz4;
+    g_bshuf_bitunshuffle = bshuf_bitunshuffle;
+  g_bshuf_bitunshuffle = bshuf_bitunshuffle;
   }
 #else
   g_bshuf_compress_lz4_bound = bshuf_compress_lz4_bound;
   g_bshuf_compress_lz4 = bshuf_compress_lz4;
   g_bshuf_decompress_lz4 = bshuf_decompress_lz4;
+  g_bshuf_bitunshuffle = bshuf_bitunshuffle;
 #endif
 }
 
@@ -85,6 +93,15 @@ int64_t decompress_lz4(void* in, void* out, size_t size,
 size_t compress_lz4_bound(size_t size, size_t elem_size, size_t block_size) {
   return g_bshuf_compress_lz4_bound(size, elem_size, block_size);
 }
+int64_t bitunshuffle(const void* in, void* out, size_t size,
+                     size_t elem_size, size_t block_size) {
+  return g_bshuf_bitunshuffle(in, out, size, elem_size, block_size);
+}
+size_t default_block_size(size_t elem_size) {
+  // The block size is part of the on-disk format, so it doesn't depend on
+  // the instruction set.
+  return bshuf_default_block_size(elem_size);
+}
 
 } // namespace bitshuffle
 } // namespace kudu
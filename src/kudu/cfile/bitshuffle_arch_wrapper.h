@@ -28,6 +28,8 @@ namespace bitshuffle {
 size_t compress_lz4_bound(size_t size, size_t elem_size, size_t block_size);
 int64_t compress_lz4(void* in, void* out, size_t size, size_t elem_size, size_t block_size);
 int64_t decompress_lz4(void* in, void* out, size_t size, size_t elem_size, size_t block_size);
+int64_t bitunshuffle(const void* in, void* out, size_t size, size_t elem_size, size_t block_size);
+size_t default_block_size(size_t elem_size);
 
 } // namespace bitshuffle
 } // namespace kudu
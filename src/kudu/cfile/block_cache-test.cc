@@ -16,12 +16,24 @@
 // under the License.
 
 #include <cstring>
+#include <string>
 
+#include <gflags/gflags.h>
+#include <gflags/gflags_declare.h>
 #include <gtest/gtest.h>
 
 #include "kudu/cfile/block_cache.h"
 #include "kudu/util/cache.h"
+#include "kudu/util/env.h"
 #include "kudu/util/slice.h"
+#include "kudu/util/test_macros.h"
+#include "kudu/util/test_util.h"
+
+DECLARE_bool(cache_force_single_shard);
+DECLARE_int64(block_cache_nvm_capacity_mb);
+DECLARE_string(nvm_cache_path);
+
+using std::string;
 
 namespace kudu {
 namespace cfile {
@@ -62,6 +74,46 @@ TEST(TestBlockCache, TestBasics) {
   ASSERT_FALSE(cache.Lookup(key1, Cache::EXPECT_IN_CACHE, &retrieved_handle));
 }
 
+#if defined(__linux__)
+class TestBlockCacheNvmTier : public KuduTest {};
+
+TEST_F(TestBlockCacheNvmTier, TestDemotionAndPromotion) {
+  if (google::GetCommandLineFlagInfoOrDie("nvm_cache_path").is_default) {
+    FLAGS_nvm_cache_path = GetTestPath("nvm-cache");
+    ASSERT_OK(Env::Default()->CreateDir(FLAGS_nvm_cache_path));
+  }
+  FLAGS_cache_force_single_shard = true;
+  FLAGS_block_cache_nvm_capacity_mb = 32;
+
+  // The DRAM tier only has room for one block.
+  const size_t kBlockSize = 1024;
+  BlockCache cache(kBlockSize);
+  ASSERT_TRUE(cache.has_nvm_tier());
+  BlockCache::FileId id(1234);
+  BlockCache::CacheKey key1(id, 1);
+  BlockCache::CacheKey key2(id, 2);
+  for (const auto& key : { key1, key2 }) {
+    BlockCache::PendingEntry data = cache.Allocate(key, kBlockSize);
+    memset(data.val_ptr(), key.offset_, kBlockSize);
+    BlockCacheHandle handle;
+    cache.Insert(&data, &handle);
+  }
+
+  // The first block was demoted into the NVM tier when the second one was
+  // inserted, and is promoted back on lookup, demoting the second one.
+  for (int i = 0; i < 3; i++) {
+    for (const auto& key : { key1, key2 }) {
+      BlockCacheHandle handle;
+      ASSERT_TRUE(cache.Lookup(key, Cache::EXPECT_IN_CACHE, &handle));
+      ASSERT_EQ(kBlockSize, handle.data().size());
+      ASSERT_EQ(string(kBlockSize, key.offset_), handle.data().ToString());
+    }
+  }
+
+  BlockCacheHandle handle;
+  ASSERT_FALSE(cache.Lookup(BlockCache::CacheKey(id, 3), Cache::EXPECT_IN_CACHE, &handle));
+}
+#endif // defined(__linux__)
 
 } // namespace cfile
 } // namespace kudu
@@ -15,27 +15,79 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <atomic>
+#include <cstring>
+#include <memory>
 #include <ostream>
 #include <string>
+#include <vector>
 
 #include <gflags/gflags.h>
+#include <glog/logging.h>
 
 #include "kudu/cfile/block_cache.h"
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/cache.h"
+#include "kudu/util/cache_metrics.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/string_case.h"
 
+using std::string;
+using std::vector;
+using strings::Substitute;
+
 DEFINE_int64(block_cache_capacity_mb, 512, "block cache capacity in MB");
 TAG_FLAG(block_cache_capacity_mb, stable);
 
 DEFINE_string(block_cache_type, "DRAM",
               "Which type of block cache to use for caching data. "
-              "Valid choices are 'DRAM' or 'NVM'. DRAM, the default, "
-              "caches data in regular memory. 'NVM' caches data "
+              "Valid choices are 'DRAM', 'CLOCK' or 'NVM'. DRAM, the default, "
+              "caches data in regular memory. 'CLOCK' also caches data in "
+              "regular memory, but evicts with the CLOCK algorithm instead "
+              "of LRU, which lets concurrent lookups proceed without "
+              "contending on a lock. 'NVM' caches data "
               "in a memory-mapped file using the NVML library.");
 TAG_FLAG(block_cache_type, experimental);
 
+DEFINE_double(block_cache_high_priority_ratio, 0.1,
+              "Fraction of the DRAM block cache capacity reserved for index, "
+              "bloom and dictionary blocks, and for blocks which have been hit "
+              "since they were cached. Other blocks are inserted in the middle "
+              "of the LRU list, so that scanning a large amount of data once "
+              "doesn't evict them. 0 disables the reserved pool and uses a "
+              "plain LRU policy.");
+TAG_FLAG(block_cache_high_priority_ratio, advanced);
+TAG_FLAG(block_cache_high_priority_ratio, experimental);
+
+DEFINE_double(block_cache_compressed_ratio, 0,
+              "Fraction of the block cache capacity used to cache blocks of "
+              "compressed CFiles in their compressed form, the rest caching "
+              "blocks after decompression. Caching compressed blocks fits more "
+              "of them in the same memory, at the cost of decompressing a block "
+              "each time it is read from the cache. 0 disables the compressed "
+              "tier.");
+TAG_FLAG(block_cache_compressed_ratio, advanced);
+TAG_FLAG(block_cache_compressed_ratio, experimental);
+
+static bool ValidateCompressedRatio(const char* flagname, double value) {
+  if (value < 0 || value >= 1) {
+    LOG(ERROR) << Substitute("$0 must be at least 0 and less than 1 (value: $1)",
+                             flagname, value);
+    return false;
+  }
+  return true;
+}
+DEFINE_validator(block_cache_compressed_ratio, &ValidateCompressedRatio);
+
+DEFINE_int64(block_cache_nvm_capacity_mb, 0,
+             "Capacity in MB of a second tier of the block cache in persistent "
+             "memory, at --nvm_cache_path, into which the blocks evicted from "
+             "the DRAM block cache are demoted. Blocks found in it are "
+             "promoted back to the DRAM block cache. 0 disables the tier. "
+             "Ignored if --block_cache_type is 'NVM'.");
+TAG_FLAG(block_cache_nvm_capacity_mb, experimental);
+
 template <class T> class scoped_refptr;
 
 namespace kudu {
@@ -46,54 +98,186 @@ namespace cfile {
 
 namespace {
 
-Cache* CreateCache(int64_t capacity) {
+CacheType GetCacheType() {
   CacheType t;
   ToUpperCase(FLAGS_block_cache_type, &FLAGS_block_cache_type);
   if (FLAGS_block_cache_type == "NVM") {
     t = NVM_CACHE;
   } else if (FLAGS_block_cache_type == "DRAM") {
     t = DRAM_CACHE;
+  } else if (FLAGS_block_cache_type == "CLOCK") {
+    t = DRAM_CLOCK_CACHE;
   } else {
     LOG(FATAL) << "Unknown block cache type: '" << FLAGS_block_cache_type
-               << "' (expected 'DRAM' or 'NVM')";
+               << "' (expected 'DRAM', 'CLOCK' or 'NVM')";
   }
-  return NewLRUCache(t, capacity, "block_cache");
+  return t;
+}
+
+Cache* CreateCache(int64_t capacity) {
+  return NewLRUCache(GetCacheType(), capacity, "block_cache",
+                     FLAGS_block_cache_high_priority_ratio);
+}
+
+Cache* CreateCompressedCache(int64_t capacity) {
+  return NewLRUCache(GetCacheType(), capacity, "block_cache_compressed",
+                     FLAGS_block_cache_high_priority_ratio);
+}
+
+Slice KeySlice(const BlockCache::CacheKey& key) {
+  return Slice(reinterpret_cast<const uint8_t*>(&key), sizeof(key));
 }
 
 } // anonymous namespace
 
+// Copies the blocks evicted from the uncompressed tier into the NVM tier.
+class BlockCache::DemotionCallback : public Cache::EvictionCallback {
+ public:
+  explicit DemotionCallback(Cache* nvm_cache)
+      : nvm_cache_(nvm_cache),
+        enabled_(true) {
+  }
+
+  void EvictedEntry(Slice key, Slice value) override {
+    if (!enabled_.load(std::memory_order_relaxed)) {
+      return;
+    }
+    Cache::PendingHandle* ph = nvm_cache_->Allocate(key, value.size(), value.size());
+    if (ph == nullptr) {
+      // The NVM tier is out of space, and couldn't evict enough to make room.
+      return;
+    }
+    memcpy(nvm_cache_->MutableValue(ph), value.data(), value.size());
+    nvm_cache_->Release(nvm_cache_->Insert(ph, /* eviction_callback= */ nullptr));
+  }
+
+  // Stops demoting blocks, e.g. when the uncompressed tier is destroyed.
+  void Disable() {
+    enabled_.store(false, std::memory_order_relaxed);
+  }
+
+ private:
+  Cache* const nvm_cache_;
+  std::atomic<bool> enabled_;
+
+  DISALLOW_COPY_AND_ASSIGN(DemotionCallback);
+};
+
 BlockCache::BlockCache()
   : BlockCache(FLAGS_block_cache_capacity_mb * 1024 * 1024) {
 }
 
-BlockCache::BlockCache(size_t capacity)
-  : cache_(CreateCache(capacity)) {
+BlockCache::BlockCache(size_t capacity) {
+  size_t compressed_capacity = capacity * FLAGS_block_cache_compressed_ratio;
+  const CacheType type = GetCacheType();
+  if (FLAGS_block_cache_nvm_capacity_mb > 0 && type != NVM_CACHE) {
+    nvm_cache_.reset(NewLRUCache(NVM_CACHE, FLAGS_block_cache_nvm_capacity_mb * 1024 * 1024,
+                                 "block_cache_nvm"));
+    demotion_callback_.reset(new DemotionCallback(nvm_cache_.get()));
+  }
+  cache_.reset(CreateCache(capacity - compressed_capacity));
+  if (compressed_capacity > 0) {
+    compressed_cache_.reset(CreateCompressedCache(compressed_capacity));
+  }
+}
+
+BlockCache::~BlockCache() {
+  // Don't demote the blocks dropped along with the uncompressed tier.
+  if (demotion_callback_) {
+    demotion_callback_->Disable();
+  }
 }
 
-BlockCache::PendingEntry BlockCache::Allocate(const CacheKey& key, size_t val_size) {
+BlockCache::PendingEntry BlockCache::Allocate(const CacheKey& key, size_t val_size,
+                                              Cache::Priority priority) {
   Slice key_slice(reinterpret_cast<const uint8_t*>(&key), sizeof(key));
   int charge = val_size;
-  return PendingEntry(cache_.get(), cache_->Allocate(key_slice, val_size, charge));
+  return PendingEntry(cache_.get(), cache_->Allocate(key_slice, val_size, charge, priority));
+}
+
+void BlockCache::GetHottestBlocks(size_t max_blocks, vector<CacheKey>* keys) {
+  vector<string> raw_keys;
+  cache_->GetHottestKeys(max_blocks, &raw_keys);
+  for (const auto& raw_key : raw_keys) {
+    DCHECK_EQ(sizeof(CacheKey), raw_key.size());
+    CacheKey key(BlockId(), 0);
+    memcpy(&key, raw_key.data(), sizeof(key));
+    keys->emplace_back(key);
+  }
 }
 
 bool BlockCache::Lookup(const CacheKey& key, Cache::CacheBehavior behavior,
                         BlockCacheHandle *handle) {
-  Cache::Handle *h = cache_->Lookup(Slice(reinterpret_cast<const uint8_t*>(&key),
-                                          sizeof(key)), behavior);
+  Cache::Handle *h = cache_->Lookup(KeySlice(key), behavior);
   if (h != nullptr) {
     handle->SetHandle(cache_.get(), h);
+    return true;
+  }
+  if (nvm_cache_) {
+    return LookupAndPromote(KeySlice(key), behavior, handle);
+  }
+  return false;
+}
+
+bool BlockCache::LookupAndPromote(const Slice& key, Cache::CacheBehavior behavior,
+                                  BlockCacheHandle* handle) {
+  Cache::Handle* nvm_h = nvm_cache_->Lookup(key, behavior);
+  if (nvm_h == nullptr) {
+    return false;
+  }
+  Slice value = nvm_cache_->Value(nvm_h);
+  Cache::PendingHandle* ph = cache_->Allocate(key, value.size(), value.size());
+  if (ph == nullptr) {
+    // Serve the block from the NVM tier.
+    handle->SetHandle(nvm_cache_.get(), nvm_h);
+    return true;
+  }
+  memcpy(cache_->MutableValue(ph), value.data(), value.size());
+  nvm_cache_->Release(nvm_h);
+  nvm_cache_->Erase(key);
+  handle->SetHandle(cache_.get(), cache_->Insert(ph, demotion_callback_.get()));
+  return true;
+}
+
+bool BlockCache::LookupCompressed(const CacheKey& key, Cache::CacheBehavior behavior,
+                                  BlockCacheHandle *handle) {
+  DCHECK(has_compressed_tier());
+  Cache::Handle *h = compressed_cache_->Lookup(
+      Slice(reinterpret_cast<const uint8_t*>(&key), sizeof(key)), behavior);
+  if (h != nullptr) {
+    handle->SetHandle(compressed_cache_.get(), h);
   }
   return h != nullptr;
 }
 
+BlockCache::PendingEntry BlockCache::AllocateCompressed(const CacheKey& key, size_t val_size,
+                                                        Cache::Priority priority) {
+  DCHECK(has_compressed_tier());
+  Slice key_slice(reinterpret_cast<const uint8_t*>(&key), sizeof(key));
+  int charge = val_size;
+  return PendingEntry(compressed_cache_.get(),
+                      compressed_cache_->Allocate(key_slice, val_size, charge, priority));
+}
+
 void BlockCache::Insert(BlockCache::PendingEntry* entry, BlockCacheHandle* inserted) {
-  Cache::Handle *h = cache_->Insert(entry->handle_, /* eviction_callback= */ nullptr);
+  Cache* cache = DCHECK_NOTNULL(entry->cache_);
+  // Only the blocks of the uncompressed tier are demoted when evicted.
+  Cache::Handle *h = cache->Insert(entry->handle_,
+                                   cache == cache_.get() ? demotion_callback_.get() : nullptr);
   entry->handle_ = nullptr;
-  inserted->SetHandle(cache_.get(), h);
+  inserted->SetHandle(cache, h);
 }
 
 void BlockCache::StartInstrumentation(const scoped_refptr<MetricEntity>& metric_entity) {
   cache_->SetMetrics(metric_entity);
+  if (compressed_cache_) {
+    compressed_cache_->SetMetrics(std::unique_ptr<CacheMetrics>(
+        CacheMetrics::CreateForCompressedBlockCache(metric_entity)));
+  }
+  if (nvm_cache_) {
+    nvm_cache_->SetMetrics(std::unique_ptr<CacheMetrics>(
+        CacheMetrics::CreateForNvmBlockCache(metric_entity)));
+  }
 }
 
 } // namespace cfile
@@ -20,6 +20,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <utility>
+#include <vector>
 
 #include <gflags/gflags_declare.h>
 #include <glog/logging.h>
@@ -118,8 +119,10 @@ class BlockCache {
   }
 
   explicit BlockCache(size_t capacity);
+  ~BlockCache();
 
-  // Lookup the given block in the cache.
+  // Lookup the given block in the cache. Blocks found in the NVM tier, if
+  // any, are promoted to the DRAM tier.
   //
   // If the entry is found, then sets *handle to refer to the entry.
   // This object's destructor will release the cache entry so it may be freed again.
@@ -129,6 +132,50 @@ class BlockCache {
   bool Lookup(const CacheKey& key, Cache::CacheBehavior behavior,
               BlockCacheHandle* handle);
 
+  // Compressed tier
+  // --------------------
+  // If --block_cache_compressed_ratio is positive, that fraction of the
+  // capacity is set aside for a second cache which holds blocks as they are
+  // stored on disk, i.e. before decompression. It can hold several times more
+  // blocks than the same amount of uncompressed cache, at the cost of
+  // decompressing a block on every hit. The blocks found in it are expected
+  // to be inserted into the uncompressed tier once decompressed.
+
+  // Return true if this cache has a compressed tier.
+  bool has_compressed_tier() const {
+    return compressed_cache_ != nullptr;
+  }
+
+  // Like Lookup(), but in the compressed tier.
+  // REQUIRES: has_compressed_tier()
+  bool LookupCompressed(const CacheKey& key, Cache::CacheBehavior behavior,
+                        BlockCacheHandle* handle);
+
+  // Like Allocate(), but in the compressed tier. The resulting entry is
+  // inserted with Insert() like any other.
+  // REQUIRES: has_compressed_tier()
+  PendingEntry AllocateCompressed(const CacheKey& key, size_t block_size,
+                                  Cache::Priority priority = Cache::NORMAL_PRIORITY);
+
+  // NVM tier
+  // --------------------
+  // If --block_cache_nvm_capacity_mb is positive, the blocks evicted from the
+  // uncompressed tier are demoted into a second-level cache of that capacity
+  // in persistent memory (see --nvm_cache_path) rather than dropped. Lookups
+  // which miss the uncompressed tier consult the NVM tier, and blocks found
+  // there are promoted back. The two tiers don't hold the same block at the
+  // same time, so their capacities add up.
+
+  // Return true if this cache has an NVM tier.
+  bool has_nvm_tier() const {
+    return nvm_cache_ != nullptr;
+  }
+
+  // Append to 'keys' the keys of up to 'max_blocks' of the blocks of the
+  // uncompressed tier which are least likely to be evicted next, the most
+  // valuable first. Used to warm the cache up after a restart.
+  void GetHottestBlocks(size_t max_blocks, std::vector<CacheKey>* keys);
+
   // Pass a metric entity to the cache to start recording metrics.
   // This should be called before the block cache starts serving blocks.
   // Not calling StartInstrumentation will simply result in no block cache-related metrics.
@@ -154,10 +201,15 @@ class BlockCache {
   //   cache->Insert(&entry, &bch);
 
   // Allocate a new entry to be inserted into the cache.
-  PendingEntry Allocate(const CacheKey& key, size_t block_size);
-
-  // Insert the given block into the cache. 'inserted' is set to refer to the
-  // entry in the cache.
+  //
+  // Blocks which are consulted on most reads of a file (index, bloom and
+  // dictionary blocks) should be allocated with Cache::HIGH_PRIORITY so that
+  // they are not displaced by a scan over the data blocks.
+  PendingEntry Allocate(const CacheKey& key, size_t block_size,
+                        Cache::Priority priority = Cache::NORMAL_PRIORITY);
+
+  // Insert the given block into the cache, in the tier it was allocated
+  // from. 'inserted' is set to refer to the entry in the cache.
   void Insert(PendingEntry* entry, BlockCacheHandle* inserted);
 
  private:
@@ -166,7 +218,28 @@ class BlockCache {
 
   DISALLOW_COPY_AND_ASSIGN(BlockCache);
 
+  class DemotionCallback;
+
+  // Looks up 'key' in the NVM tier and, if found, moves the block to the
+  // uncompressed tier. Sets 'handle' to refer to the block in whichever tier
+  // it ends up in.
+  //
+  // Returns true to indicate that the entry was found, false otherwise.
+  bool LookupAndPromote(const Slice& key, Cache::CacheBehavior behavior,
+                        BlockCacheHandle* handle);
+
+  // The NVM tier, or NULL if there is none. Declared before 'cache_', whose
+  // evicted blocks are demoted into it, so that it's destroyed after it.
+  gscoped_ptr<Cache> nvm_cache_;
+
+  // Demotes the blocks evicted from 'cache_' into 'nvm_cache_', or NULL if
+  // there is no NVM tier.
+  gscoped_ptr<DemotionCallback> demotion_callback_;
+
   gscoped_ptr<Cache> cache_;
+
+  // The compressed tier, or NULL if there is none.
+  gscoped_ptr<Cache> compressed_cache_;
 };
 
 // Scoped reference to a block from the block cache.
@@ -0,0 +1,262 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/cfile/block_cache_warmer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "kudu/cfile/block_cache.h"
+#include "kudu/cfile/block_handle.h"
+#include "kudu/cfile/block_pointer.h"
+#include "kudu/cfile/cfile.pb.h"
+#include "kudu/cfile/cfile_reader.h"
+#include "kudu/cfile/cfile_util.h"
+#include "kudu/cfile/index_btree.h"
+#include "kudu/fs/block_id.h"
+#include "kudu/fs/block_manager.h"
+#include "kudu/fs/fs_manager.h"
+#include "kudu/gutil/map-util.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/cache.h"
+#include "kudu/util/env.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/pb_util.h"
+#include "kudu/util/stopwatch.h"
+#include "kudu/util/thread.h"
+#include "kudu/util/throttler.h"
+
+DEFINE_int32(block_cache_snapshot_interval_secs, 300,
+             "Interval at which the tablet server persists the keys of the "
+             "hottest blocks of the block cache, to read them back into the "
+             "cache after a restart. 0 disables both the snapshots and the "
+             "warm-up.");
+TAG_FLAG(block_cache_snapshot_interval_secs, experimental);
+
+DEFINE_int32(block_cache_snapshot_max_blocks, 100000,
+             "Maximum number of blocks persisted by each snapshot of the "
+             "block cache.");
+TAG_FLAG(block_cache_snapshot_max_blocks, experimental);
+
+DEFINE_int32(block_cache_warmup_rate_mb_per_sec, 64,
+             "Rate at which the blocks of the last snapshot of the block cache "
+             "are read back into the cache after a restart. 0 means no limit.");
+TAG_FLAG(block_cache_warmup_rate_mb_per_sec, experimental);
+TAG_FLAG(block_cache_warmup_rate_mb_per_sec, runtime);
+
+using kudu::fs::ReadableBlock;
+using std::unique_ptr;
+using std::unordered_map;
+using std::unordered_set;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+namespace cfile {
+
+namespace {
+
+// The hot blocks of a CFile, as listed by a snapshot.
+struct HotFile {
+  BlockId block_id;
+  unordered_set<uint64_t> offsets;
+  unique_ptr<CFileReader> reader;
+  // The pointers to the hot blocks, found by walking the index.
+  unordered_map<uint64_t, BlockPointer> pointers;
+};
+
+// Opens the CFile of 'file' and caches its index blocks, collecting the
+// pointers to its hot blocks along the way.
+Status OpenAndWalkIndex(FsManager* fs_manager, HotFile* file) {
+  unique_ptr<ReadableBlock> block;
+  RETURN_NOT_OK(fs_manager->OpenBlock(file->block_id, &block));
+  RETURN_NOT_OK(CFileReader::Open(std::move(block), ReaderOptions(), &file->reader));
+  CFileReader* reader = file->reader.get();
+
+  const CFileFooterPB& footer = reader->footer();
+  if (footer.has_dict_block_ptr()) {
+    BlockPointer ptr(footer.dict_block_ptr());
+    if (ContainsKey(file->offsets, ptr.offset())) {
+      file->pointers.emplace(ptr.offset(), ptr);
+    }
+  }
+  if (!reader->has_posidx() && !reader->has_validx()) {
+    return Status::OK();
+  }
+  unique_ptr<IndexTreeIterator> iter(IndexTreeIterator::Create(
+      reader, reader->has_posidx() ? reader->posidx_root() : reader->validx_root()));
+  RETURN_NOT_OK(iter->SeekToFirst());
+  while (true) {
+    const BlockPointer& ptr = iter->GetCurrentBlockPointer();
+    if (ContainsKey(file->offsets, ptr.offset())) {
+      file->pointers.emplace(ptr.offset(), ptr);
+    }
+    if (!iter->HasNext()) {
+      break;
+    }
+    RETURN_NOT_OK(iter->Next());
+  }
+  return Status::OK();
+}
+
+} // anonymous namespace
+
+BlockCacheWarmer::BlockCacheWarmer(FsManager* fs_manager)
+    : fs_manager_(fs_manager),
+      stop_latch_(1),
+      warm_up_done_(false) {
+}
+
+BlockCacheWarmer::~BlockCacheWarmer() {
+  Shutdown();
+}
+
+Status BlockCacheWarmer::Start() {
+  if (FLAGS_block_cache_snapshot_interval_secs <= 0) {
+    return Status::OK();
+  }
+  return Thread::Create("block-cache", "block-cache-warmer",
+                        &BlockCacheWarmer::RunThread, this, &thread_);
+}
+
+void BlockCacheWarmer::Shutdown() {
+  if (!thread_) {
+    return;
+  }
+  stop_latch_.CountDown();
+  thread_->Join();
+  thread_.reset();
+  // Until the warm-up is done, the cache holds a subset of the last snapshot.
+  if (warm_up_done_) {
+    WARN_NOT_OK(SaveSnapshot(), "unable to save block cache snapshot");
+  }
+}
+
+void BlockCacheWarmer::RunThread() {
+  Status s = WarmFromSnapshot();
+  if (s.IsAborted()) {
+    return;
+  }
+  if (!s.ok() && !s.IsNotFound()) {
+    WARN_NOT_OK(s, "unable to warm the block cache up");
+  }
+  warm_up_done_ = true;
+  while (!stop_latch_.WaitFor(
+      MonoDelta::FromSeconds(FLAGS_block_cache_snapshot_interval_secs))) {
+    WARN_NOT_OK(SaveSnapshot(), "unable to save block cache snapshot");
+  }
+}
+
+Status BlockCacheWarmer::SaveSnapshot() {
+  vector<BlockCache::CacheKey> keys;
+  BlockCache::GetSingleton()->GetHottestBlocks(FLAGS_block_cache_snapshot_max_blocks, &keys);
+
+  BlockCacheSnapshotPB pb;
+  unordered_map<uint64_t, BlockCacheSnapshotPB::FileBlocksPB*> files;
+  for (const auto& key : keys) {
+    BlockCacheSnapshotPB::FileBlocksPB*& file = LookupOrInsert(&files, key.file_id_, nullptr);
+    if (file == nullptr) {
+      file = pb.add_files();
+      file->set_block_id(key.file_id_);
+    }
+    file->add_offsets(key.offset_);
+  }
+  return pb_util::WritePBContainerToPath(fs_manager_->env(),
+                                         fs_manager_->GetBlockCacheSnapshotPath(),
+                                         pb, pb_util::OVERWRITE, pb_util::NO_SYNC);
+}
+
+Status BlockCacheWarmer::WarmFromSnapshot() {
+  BlockCacheSnapshotPB pb;
+  RETURN_NOT_OK(pb_util::ReadPBContainerFromPath(fs_manager_->env(),
+                                                 fs_manager_->GetBlockCacheSnapshotPath(),
+                                                 &pb));
+  SCOPED_LOG_TIMING(INFO, Substitute("warming the block cache up from $0 files", pb.files_size()));
+  vector<HotFile> files(pb.files_size());
+  for (int i = 0; i < pb.files_size(); i++) {
+    files[i].block_id = BlockId(pb.files(i).block_id());
+    files[i].offsets.insert(pb.files(i).offsets().begin(), pb.files(i).offsets().end());
+  }
+
+  // First cache the index blocks of all the files, which are needed by any
+  // read of them.
+  for (auto& file : files) {
+    if (stop_latch_.count() == 0) {
+      return Status::Aborted("shutting down");
+    }
+    Status s = OpenAndWalkIndex(fs_manager_, &file);
+    if (!s.ok()) {
+      // The file may have been deleted since the snapshot.
+      if (!s.IsNotFound()) {
+        WARN_NOT_OK(s, Substitute("unable to warm up blocks of $0",
+                                  file.block_id.ToString()));
+      }
+      file.reader.reset();
+    }
+  }
+
+  // Then read the hot blocks, in the order of the snapshot.
+  const uint64_t rate = static_cast<uint64_t>(FLAGS_block_cache_warmup_rate_mb_per_sec) << 20;
+  Throttler throttler(MonoTime::Now(), 0, rate, 10);
+  int64_t num_blocks = 0;
+  for (int i = 0; i < pb.files_size(); i++) {
+    HotFile* file = &files[i];
+    if (!file->reader) {
+      continue;
+    }
+    for (uint64_t offset : pb.files(i).offsets()) {
+      if (stop_latch_.count() == 0) {
+        return Status::Aborted("shutting down");
+      }
+      const BlockPointer* ptr = FindOrNull(file->pointers, offset);
+      if (ptr == nullptr) {
+        continue;
+      }
+      // A burst of the throttler holds one second of reads.
+      while (!throttler.Take(MonoTime::Now(), 0, std::min<uint64_t>(ptr->size(), rate))) {
+        if (stop_latch_.WaitFor(MonoDelta::FromMicroseconds(
+                Throttler::kRefillPeriodMicros))) {
+          return Status::Aborted("shutting down");
+        }
+      }
+      BlockHandle handle;
+      Status s = file->reader->ReadBlock(*ptr, CFileReader::CACHE_BLOCK, &handle);
+      if (!s.ok()) {
+        WARN_NOT_OK(s, Substitute("unable to warm up blocks of $0",
+                                  file->block_id.ToString()));
+        break;
+      }
+      num_blocks++;
+    }
+    file->reader.reset();
+  }
+  LOG(INFO) << Substitute("Read $0 blocks into the block cache", num_blocks);
+  return Status::OK();
+}
+
+} // namespace cfile
+} // namespace kudu
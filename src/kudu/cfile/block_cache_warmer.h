@@ -0,0 +1,84 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_CFILE_BLOCK_CACHE_WARMER_H
+#define KUDU_CFILE_BLOCK_CACHE_WARMER_H
+
+#include <atomic>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/util/countdown_latch.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+class FsManager;
+class Thread;
+
+namespace cfile {
+
+// Persists the hottest blocks of the singleton block cache every
+// --block_cache_snapshot_interval_secs, and reads them back into the cache
+// after a restart, so that a restarted server doesn't serve its first reads
+// from a cold cache.
+//
+// Only the keys of the blocks are persisted, i.e. their CFile and offset.
+// Their sizes are found again by walking the index of each CFile, which also
+// caches its index blocks. The index blocks are read first, then the
+// persisted blocks in the order they were persisted, which lists the
+// high-priority ones (bloom, dictionary and index blocks) first. The reads
+// are throttled to --block_cache_warmup_rate_mb_per_sec, so as not to compete
+// with the reads of the clients for too long. Blocks which have been deleted
+// since the snapshot are skipped.
+class BlockCacheWarmer {
+ public:
+  explicit BlockCacheWarmer(FsManager* fs_manager);
+  ~BlockCacheWarmer();
+
+  // Starts the thread which warms the cache up from the last snapshot, if
+  // any, then periodically takes new snapshots.
+  Status Start();
+
+  // Stops the thread, then takes a last snapshot unless the warm-up was
+  // interrupted.
+  void Shutdown();
+
+  // Persists the keys of the hottest blocks of the cache.
+  Status SaveSnapshot();
+
+  // Reads the blocks of the last snapshot into the cache. Returns
+  // Status::NotFound() if there is no snapshot.
+  Status WarmFromSnapshot();
+
+ private:
+  void RunThread();
+
+  FsManager* const fs_manager_;
+
+  CountDownLatch stop_latch_;
+  scoped_refptr<Thread> thread_;
+
+  // Set by the thread once it's done warming the cache up.
+  std::atomic<bool> warm_up_done_;
+
+  DISALLOW_COPY_AND_ASSIGN(BlockCacheWarmer);
+};
+
+} // namespace cfile
+} // namespace kudu
+
+#endif // KUDU_CFILE_BLOCK_CACHE_WARMER_H
@@ -47,6 +47,13 @@ class BlockBuilder {
     return Status::OK();
   }
 
+  // Returns an estimate of the size of the extra information which
+  // AppendExtraInfo() would append, for comparing the encoded size of the
+  // same data across encodings.
+  virtual size_t ExtraInfoSize() const {
+    return 0;
+  }
+
   // Used by the cfile writer to determine whether the current block is full.
   // A block is full if it its estimated size is larger than the configured
   // WriterOptions' cfile_block_size.
@@ -160,6 +167,10 @@ class BlockDecoder {
   //
   // Modifies *n to contain the number of values fetched.
   //
+  // Decoders which can evaluate the predicate on their encoded form (e.g. once
+  // per run, or once per dictionary word) should override this. Values of
+  // rows which don't satisfy the predicate needn't be copied into 'dst'.
+  //
   // POSTCONDITION: ctx->decoder_eval_supported_ is not kNotSet. State must
   // be consistent throughout the entire column.
   virtual Status CopyNextAndEval(size_t* n,
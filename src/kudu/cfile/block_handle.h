@@ -18,16 +18,22 @@
 #ifndef KUDU_CFILE_BLOCK_HANDLE_H
 #define KUDU_CFILE_BLOCK_HANDLE_H
 
+#include <memory>
+#include <utility>
+
 #include "kudu/cfile/block_cache.h"
 
 namespace kudu {
 
+class FileMapping;
+
 namespace cfile {
 
 // When blocks are read, they are sometimes resident in the block cache, and sometimes skip the
 // block cache. In the case that they came from the cache, we just need to dereference them when
 // they stop being used. In the case that they didn't come from cache, we need to actually free
-// the underlying data.
+// the underlying data. Blocks read straight out of a memory mapped file keep the mapping
+// alive instead.
 class BlockHandle {
  public:
   static BlockHandle WithOwnedData(const Slice& data) {
@@ -38,6 +44,11 @@ class BlockHandle {
     return BlockHandle(handle);
   }
 
+  static BlockHandle WithMappedData(const Slice& data,
+                                    std::shared_ptr<const FileMapping> mapping) {
+    return BlockHandle(data, std::move(mapping));
+  }
+
   // Constructor to use to Pass to.
   BlockHandle()
     : is_data_owner_(false) { }
@@ -56,7 +67,7 @@ class BlockHandle {
   }
 
   Slice data() const {
-    if (is_data_owner_) {
+    if (is_data_owner_ || mapping_) {
       return data_;
     } else {
       return dblk_data_.data();
@@ -66,6 +77,7 @@ class BlockHandle {
  private:
   BlockCacheHandle dblk_data_;
   Slice data_;
+  std::shared_ptr<const FileMapping> mapping_;
   bool is_data_owner_;
 
   explicit BlockHandle(Slice data)
@@ -73,6 +85,12 @@ class BlockHandle {
         is_data_owner_(true) {
   }
 
+  BlockHandle(Slice data, std::shared_ptr<const FileMapping> mapping)
+      : data_(data),
+        mapping_(std::move(mapping)),
+        is_data_owner_(false) {
+  }
+
   explicit BlockHandle(BlockCacheHandle *dblk_data)
     : is_data_owner_(false) {
     dblk_data_.swap(dblk_data);
@@ -85,6 +103,9 @@ class BlockHandle {
     if (is_data_owner_) {
       data_ = other->data_;
       other->is_data_owner_ = false;
+    } else if (other->mapping_) {
+      data_ = other->data_;
+      mapping_ = std::move(other->mapping_);
     } else {
       dblk_data_.swap(&other->dblk_data_);
     }
@@ -95,6 +116,7 @@ class BlockHandle {
       delete [] data_.data();
       is_data_owner_ = false;
     }
+    mapping_.reset();
     data_ = "";
   }
 
@@ -55,7 +55,10 @@ class BlockPointer {
     InlinePutVarint32(s, size_);
   }
 
-  Status DecodeFrom(const uint8_t *data, const uint8_t *limit) {
+  // Decode a block pointer encoded by EncodeTo(). If 'end' is non-null,
+  // it is set to the first byte past the encoded data.
+  Status DecodeFrom(const uint8_t *data, const uint8_t *limit,
+                    const uint8_t **end = nullptr) {
     data = GetVarint64Ptr(data, limit, &offset_);
     if (!data) {
       return Status::Corruption("bad block pointer");
@@ -66,6 +69,9 @@ class BlockPointer {
       return Status::Corruption("bad block pointer");
     }
 
+    if (end) {
+      *end = data;
+    }
     return Status::OK();
   }
 
@@ -21,6 +21,7 @@
 #include <ostream>
 #include <utility>
 
+#include <gflags/gflags_declare.h>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 
@@ -36,6 +37,8 @@
 #include "kudu/util/slice.h"
 #include "kudu/util/test_macros.h"
 
+DECLARE_bool(bloomfile_split_block_filters);
+
 using std::shared_ptr;
 
 namespace kudu {
@@ -48,7 +51,7 @@ using std::unique_ptr;
 class BloomFileTest : public BloomFileTestBase {
 
  protected:
-  void VerifyBloomFile() {
+  void VerifyBloomFile(double expected_fp_rate = FLAGS_fp_rate) {
     // Verify all the keys that we inserted probe as present.
     for (uint64_t i = 0; i < FLAGS_n_keys; i++) {
       uint64_t i_byteswapped = BigEndian::FromHost64(i << kKeyShift);
@@ -74,7 +77,7 @@ class BloomFileTest : public BloomFileTestBase {
 
     double fp_rate = static_cast<double>(positive_count) / FLAGS_n_keys;
     LOG(INFO) << "fp_rate: " << fp_rate << "(" << positive_count << "/" << FLAGS_n_keys << ")";
-    ASSERT_LT(fp_rate, FLAGS_fp_rate + FLAGS_fp_rate * 0.20f)
+    ASSERT_LT(fp_rate, expected_fp_rate + expected_fp_rate * 0.20f)
       << "Should be no more than 1.2x the expected FP rate";
   }
 };
@@ -86,6 +89,19 @@ TEST_F(BloomFileTest, TestWriteAndRead) {
   VerifyBloomFile();
 }
 
+TEST_F(BloomFileTest, TestSplitBlockWriteAndRead) {
+  FLAGS_bloomfile_split_block_filters = true;
+  ASSERT_NO_FATAL_FAILURE(WriteTestBloomFile());
+  ASSERT_OK(OpenBloomFile());
+
+  // Split-block filters have a somewhat higher false positive rate than
+  // classic ones of the same size.
+  BloomFilterBuilder bfb(BloomFilterSizing::BySizeAndFPRate(FLAGS_bloom_size_bytes, FLAGS_fp_rate),
+                         SPLIT_BLOCK_BLOOM_FILTER);
+  LOG(INFO) << "Expected split-block FP rate: " << bfb.false_positive_rate();
+  VerifyBloomFile(bfb.false_positive_rate());
+}
+
 #ifdef NDEBUG
 TEST_F(BloomFileTest, Benchmark) {
   ASSERT_NO_FATAL_FAILURE(WriteTestBloomFile());
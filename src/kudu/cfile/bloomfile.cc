@@ -21,7 +21,7 @@
 #include <utility>
 #include <vector>
 
-#include <gflags/gflags_declare.h>
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 
 #include "kudu/cfile/block_handle.h"
@@ -38,8 +38,10 @@
 #include "kudu/gutil/atomicops.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/stringprintf.h"
+#include "kudu/util/cache.h"
 #include "kudu/util/coding.h"
 #include "kudu/util/compression/compression.pb.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/hexdump.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/malloc.h"
@@ -48,6 +50,14 @@
 
 DECLARE_bool(cfile_lazy_open);
 
+DEFINE_bool(bloomfile_split_block_filters, false,
+            "Whether to write new bloom files with split-block bloom filters, in which "
+            "probing for a key touches a single cache line, rather than with classic "
+            "bloom filters. For the same size, split-block filters have a slightly higher "
+            "false positive rate. Bloom files written this way cannot be read by older "
+            "versions of Kudu.");
+TAG_FLAG(bloomfile_split_block_filters, experimental);
+
 using std::string;
 using std::unique_ptr;
 using std::vector;
@@ -96,7 +106,8 @@ using BloomCacheTLC = ThreadLocalCache<uint64_t, BloomCacheItem>;
 
 BloomFileWriter::BloomFileWriter(unique_ptr<WritableBlock> block,
                                  const BloomFilterSizing &sizing)
-  : bloom_builder_(sizing) {
+  : bloom_builder_(sizing, FLAGS_bloomfile_split_block_filters ?
+                   SPLIT_BLOCK_BLOOM_FILTER : CLASSIC_BLOOM_FILTER) {
   cfile::WriterOptions opts;
   opts.write_posidx = false;
   opts.write_validx = true;
@@ -165,6 +176,9 @@ Status BloomFileWriter::FinishCurrentBloomBlock() {
   // Encode the header.
   BloomBlockHeaderPB hdr;
   hdr.set_num_hash_functions(bloom_builder_.n_hashes());
+  if (bloom_builder_.layout() == SPLIT_BLOCK_BLOOM_FILTER) {
+    hdr.set_layout(BloomBlockHeaderPB::SPLIT_BLOCK);
+  }
   faststring hdr_str;
   PutFixed32(&hdr_str, hdr.ByteSize());
   pb_util::AppendToString(hdr, &hdr_str);
@@ -275,12 +289,33 @@ Status BloomFileReader::ParseBlockHeader(const Slice &block,
   }
 
   data.remove_prefix(header_len);
+  switch (hdr->layout()) {
+    case BloomBlockHeaderPB::CLASSIC:
+      break;
+    case BloomBlockHeaderPB::SPLIT_BLOCK:
+      if (PREDICT_FALSE(hdr->num_hash_functions() != 8 || data.size() % 32 != 0)) {
+        return Status::Corruption(
+            StringPrintf("Invalid split-block bloom filter: %d hashes, %ld bytes",
+                         hdr->num_hash_functions(), data.size()));
+      }
+      break;
+    default:
+      return Status::NotSupported(
+          StringPrintf("Unsupported bloom filter layout %d", hdr->layout()));
+  }
   *bloom_data = data;
   return Status::OK();
 }
 
 Status BloomFileReader::CheckKeyPresent(const BloomKeyProbe &probe,
                                         bool *maybe_present) {
+  const BloomKeyProbe* probes[] = { &probe };
+  return CheckKeysPresent(probes, 1, maybe_present);
+}
+
+Status BloomFileReader::CheckKeysPresent(const BloomKeyProbe* const* probes,
+                                         size_t n,
+                                         bool* maybe_present) {
   DCHECK(init_once_.init_succeeded());
 
   // Since we frequently will access the same BloomFile many times in a row
@@ -299,37 +334,43 @@ Status BloomFileReader::CheckKeyPresent(const BloomKeyProbe &probe,
       << "Cached index reader does not match expected instance";
 
   IndexTreeIterator* index_iter = &bci->index_iter;
-  Status s = index_iter->SeekAtOrBefore(probe.key());
-  if (PREDICT_FALSE(s.IsNotFound())) {
-    // Seek to before the first entry in the file.
-    *maybe_present = false;
-    return Status::OK();
-  }
-  RETURN_NOT_OK(s);
-
-  // Successfully found the pointer to the bloom block.
-  BlockPointer bblk_ptr = index_iter->GetCurrentBlockPointer();
-
-  // If the previous lookup from this bloom on this thread seeked to a different
-  // block in the BloomFile, we need to read the correct block and re-hydrate the
-  // BloomFilter instance.
-  if (!bci->cur_block_pointer.Equals(bblk_ptr)) {
-    BlockHandle dblk_data;
-    RETURN_NOT_OK(reader_->ReadBlock(bblk_ptr, CFileReader::CACHE_BLOCK, &dblk_data));
-
-    // Parse the header in the block.
-    BloomBlockHeaderPB hdr;
-    Slice bloom_data;
-    RETURN_NOT_OK(ParseBlockHeader(dblk_data.data(), &hdr, &bloom_data));
-
-    // Save the data back into our threadlocal cache.
-    bci->cur_bloom = BloomFilter(bloom_data, hdr.num_hash_functions());
-    bci->cur_block_pointer = bblk_ptr;
-    bci->cur_block_handle = std::move(dblk_data);
-  }
+  for (size_t i = 0; i < n; i++) {
+    const BloomKeyProbe& probe = *probes[i];
+    Status s = index_iter->SeekAtOrBefore(probe.key());
+    if (PREDICT_FALSE(s.IsNotFound())) {
+      // Seek to before the first entry in the file.
+      maybe_present[i] = false;
+      continue;
+    }
+    RETURN_NOT_OK(s);
+
+    // Successfully found the pointer to the bloom block.
+    BlockPointer bblk_ptr = index_iter->GetCurrentBlockPointer();
+
+    // If the previous lookup from this bloom on this thread seeked to a different
+    // block in the BloomFile, we need to read the correct block and re-hydrate the
+    // BloomFilter instance.
+    if (!bci->cur_block_pointer.Equals(bblk_ptr)) {
+      BlockHandle dblk_data;
+      RETURN_NOT_OK(reader_->ReadBlock(bblk_ptr, CFileReader::CACHE_BLOCK, &dblk_data,
+                                       Cache::HIGH_PRIORITY));
+
+      // Parse the header in the block.
+      BloomBlockHeaderPB hdr;
+      Slice bloom_data;
+      RETURN_NOT_OK(ParseBlockHeader(dblk_data.data(), &hdr, &bloom_data));
+
+      // Save the data back into our threadlocal cache.
+      bci->cur_bloom = BloomFilter(bloom_data, hdr.num_hash_functions(),
+                                   hdr.layout() == BloomBlockHeaderPB::SPLIT_BLOCK ?
+                                   SPLIT_BLOCK_BLOOM_FILTER : CLASSIC_BLOOM_FILTER);
+      bci->cur_block_pointer = bblk_ptr;
+      bci->cur_block_handle = std::move(dblk_data);
+    }
 
-  // Actually check the bloom filter.
-  *maybe_present = bci->cur_bloom.MayContainKey(probe);
+    // Actually check the bloom filter.
+    maybe_present[i] = bci->cur_bloom.MayContainKey(probe);
+  }
   return Status::OK();
 }
 
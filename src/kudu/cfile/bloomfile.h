@@ -115,6 +115,14 @@ class BloomFileReader {
   Status CheckKeyPresent(const BloomKeyProbe &probe,
                          bool* maybe_present);
 
+  // Like CheckKeyPresent(), for each of the 'n' keys in 'probes', setting
+  // maybe_present[i] for probes[i]. This is cheaper than checking the keys one
+  // by one, especially if they're sorted, since neighboring keys generally
+  // fall in the same bloom block.
+  Status CheckKeysPresent(const BloomKeyProbe* const* probes,
+                          size_t n,
+                          bool* maybe_present);
+
   // Can be called before Init().
   uint64_t FileSize() const {
     return reader_->file_size();
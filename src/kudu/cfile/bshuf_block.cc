@@ -19,7 +19,13 @@
 #include <algorithm>
 #include <limits>
 
+#include <lz4.h>
+
+#include "kudu/gutil/endian.h"
 #include "kudu/gutil/port.h"
+#include "kudu/gutil/strings/substitute.h"
+
+using strings::Substitute;
 
 namespace kudu {
 namespace cfile {
@@ -49,6 +55,36 @@ void AbortWithBitShuffleError(int64_t val) {
   }
 }
 
+Status DecodeBitshuffleBlock(const uint8_t* in, const uint8_t* limit,
+                             size_t num_elems, size_t elem_size,
+                             faststring* scratch, uint8_t* out) {
+  // Each bitshuffle block is stored as its big-endian compressed length,
+  // followed by the LZ4-compressed bitshuffled data.
+  const size_t size = num_elems * elem_size;
+  DCHECK_LE(in + sizeof(uint32_t), limit);
+  const uint32_t compressed_size = BigEndian::Load32(in);
+  in += sizeof(uint32_t);
+  if (PREDICT_FALSE(compressed_size > static_cast<size_t>(limit - in))) {
+    return Status::Corruption("bitshuffle block extends past end of data");
+  }
+  scratch->resize(size);
+  int decompressed = LZ4_decompress_safe(reinterpret_cast<const char*>(in),
+                                         reinterpret_cast<char*>(scratch->data()),
+                                         compressed_size, size);
+  if (PREDICT_FALSE(decompressed != static_cast<int>(size))) {
+    return Status::Corruption(Substitute("LZ4 decompressed $0 bytes of bitshuffle block, "
+                                         "expected $1", decompressed, size));
+  }
+  int64_t bytes = bitshuffle::bitunshuffle(scratch->data(), out, num_elems, elem_size,
+                                           num_elems);
+  if (PREDICT_FALSE(bytes < 0)) {
+    // Ideally, this should not happen.
+    AbortWithBitShuffleError(bytes);
+    return Status::RuntimeError("Unshuffle Process failed");
+  }
+  return Status::OK();
+}
+
 // Template specialization for UINT32, which is used by dictionary encoding.
 // It dynamically switches the element size to UINT16 or UINT8 depending on the values
 // in the current block.
@@ -96,6 +132,7 @@ Status BShufBlockDecoder<UINT32>::SeekAtOrAfterValue(const void* value_void, boo
 
   while (left != right) {
     uint32_t mid = (left + right) / 2;
+    RETURN_NOT_OK(EnsureDecoded(mid));
     uint32_t mid_key;
     switch (size_of_elem_) {
       case 1: {
@@ -141,7 +178,7 @@ Status BShufBlockDecoder<UINT32>::CopyNextValuesToArray(size_t* n, uint8_t* arra
 
   // First, copy it to the destination array without any "expansion".
   size_t max_fetch = std::min(*n, static_cast<size_t>(num_elems_ - cur_idx_));
-  memcpy(array, &decoded_[cur_idx_ * size_of_elem_], max_fetch * size_of_elem_);
+  RETURN_NOT_OK(DecodeRange(cur_idx_, max_fetch, array));
 
   *n = max_fetch;
   cur_idx_ += max_fetch;
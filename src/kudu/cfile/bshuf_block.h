@@ -29,6 +29,7 @@
 #include <cstring>
 #include <cstdint>
 #include <ostream>
+#include <vector>
 
 #include <glog/logging.h>
 
@@ -40,6 +41,7 @@
 #include "kudu/common/rowid.h"
 #include "kudu/common/schema.h"
 #include "kudu/common/types.h"
+#include "kudu/gutil/endian.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/alignment.h"
@@ -56,6 +58,14 @@ namespace cfile {
 // Log a FATAL error message and exit.
 void AbortWithBitShuffleError(int64_t val) ATTRIBUTE_NORETURN;
 
+// Decompress and unshuffle a single bitshuffle block of 'num_elems' elements
+// of 'elem_size' bytes each into 'out'. 'in' points to the block's length
+// prefix, and 'limit' to the end of the compressed data. 'scratch' holds the
+// intermediate LZ4-decompressed (still shuffled) data.
+Status DecodeBitshuffleBlock(const uint8_t* in, const uint8_t* limit,
+                             size_t num_elems, size_t elem_size,
+                             faststring* scratch, uint8_t* out);
+
 // BshufBlockBuilder bitshuffles and compresses the bits of fixed
 // size type blocks with lz4.
 //
@@ -237,6 +247,7 @@ class BShufBlockDecoder final : public BlockDecoder {
         num_elems_(0),
         compressed_size_(0),
         num_elems_after_padding_(0),
+        elems_per_chunk_(0),
         cur_idx_(0) {
   }
 
@@ -280,7 +291,7 @@ class BShufBlockDecoder final : public BlockDecoder {
                                                     size_of_elem_, size_of_type));
     }
 
-    RETURN_NOT_OK(Expand());
+    RETURN_NOT_OK(ParseChunks());
 
     parsed_ = true;
     return Status::OK();
@@ -303,6 +314,7 @@ class BShufBlockDecoder final : public BlockDecoder {
     int32_t right = num_elems_;
     while (left != right) {
       uint32_t mid = (left + right) / 2;
+      RETURN_NOT_OK(EnsureDecoded(mid));
       CppType mid_key = Decode<CppType>(
             &decoded_[mid * size_of_type]);
       if (mid_key == target) {
@@ -342,7 +354,7 @@ class BShufBlockDecoder final : public BlockDecoder {
     }
 
     size_t max_fetch = std::min(*n, static_cast<size_t>(num_elems_ - cur_idx_));
-    memcpy(array, &decoded_[cur_idx_ * size_of_type], max_fetch * size_of_type);
+    RETURN_NOT_OK(DecodeRange(cur_idx_, max_fetch, array));
 
     *n = max_fetch;
     cur_idx_ += max_fetch;
@@ -375,18 +387,72 @@ class BShufBlockDecoder final : public BlockDecoder {
     return result;
   }
 
-  Status Expand() {
-    if (num_elems_ > 0) {
-      int64_t bytes;
-      decoded_.resize(num_elems_after_padding_ * size_of_elem_);
-      uint8_t* in = const_cast<uint8_t*>(&data_[kHeaderSize]);
-      bytes = bitshuffle::decompress_lz4(in, decoded_.data(), num_elems_after_padding_,
-                                         size_of_elem_, 0);
-      if (PREDICT_FALSE(bytes < 0)) {
-        // Ideally, this should not happen.
-        AbortWithBitShuffleError(bytes);
-        return Status::RuntimeError("Unshuffle Process failed");
+  // The data is compressed as a sequence of independently decodable
+  // bitshuffle blocks, here called chunks to avoid confusion with cfile
+  // blocks. Locate them, so they can be decoded as they are read.
+  Status ParseChunks() {
+    if (num_elems_ == 0) {
+      return Status::OK();
+    }
+    elems_per_chunk_ = bitshuffle::default_block_size(size_of_elem_);
+    const size_t num_chunks = (num_elems_after_padding_ + elems_per_chunk_ - 1) / elems_per_chunk_;
+    chunk_offsets_.resize(num_chunks);
+    chunk_decoded_.assign(num_chunks, false);
+    size_t offset = kHeaderSize;
+    for (size_t i = 0; i < num_chunks; i++) {
+      if (PREDICT_FALSE(offset + sizeof(uint32_t) > data_.size())) {
+        return Status::Corruption("bitshuffle block truncated");
+      }
+      chunk_offsets_[i] = offset;
+      offset += sizeof(uint32_t) + BigEndian::Load32(&data_[offset]);
+    }
+    if (PREDICT_FALSE(offset != data_.size())) {
+      return Status::Corruption(strings::Substitute(
+          "bitshuffle chunks end at offset $0 of $1", offset, data_.size()));
+    }
+    decoded_.resize(num_elems_after_padding_ * size_of_elem_);
+    return Status::OK();
+  }
+
+  // Decode the given chunk into 'out'.
+  Status DecodeChunk(size_t chunk, uint8_t* out) {
+    const size_t chunk_start = chunk * elems_per_chunk_;
+    const size_t chunk_elems = std::min<size_t>(elems_per_chunk_,
+                                                num_elems_after_padding_ - chunk_start);
+    return DecodeBitshuffleBlock(&data_[chunk_offsets_[chunk]], data_.data() + data_.size(),
+                                 chunk_elems, size_of_elem_, &scratch_, out);
+  }
+
+  // Make sure the chunk containing element 'idx' is decoded into 'decoded_'.
+  Status EnsureDecoded(size_t idx) {
+    size_t chunk = idx / elems_per_chunk_;
+    if (!chunk_decoded_[chunk]) {
+      RETURN_NOT_OK(DecodeChunk(chunk, &decoded_[chunk * elems_per_chunk_ * size_of_elem_]));
+      chunk_decoded_[chunk] = true;
+    }
+    return Status::OK();
+  }
+
+  // Decode the 'n' elements starting at 'start' into 'out', at their encoded
+  // size of 'size_of_elem_' bytes each. Chunks which are entirely covered by
+  // the range are unshuffled straight into 'out', without an intermediate
+  // copy; the others are decoded into 'decoded_' and copied from there.
+  Status DecodeRange(size_t start, size_t n, uint8_t* out) {
+    const size_t end = start + n;
+    while (start < end) {
+      const size_t chunk = start / elems_per_chunk_;
+      const size_t chunk_start = chunk * elems_per_chunk_;
+      const size_t chunk_end = std::min<size_t>(chunk_start + elems_per_chunk_,
+                                                num_elems_after_padding_);
+      size_t count = std::min(end, chunk_end) - start;
+      if (!chunk_decoded_[chunk] && start == chunk_start && chunk_end <= end) {
+        RETURN_NOT_OK(DecodeChunk(chunk, out));
+      } else {
+        RETURN_NOT_OK(EnsureDecoded(start));
+        memcpy(out, &decoded_[start * size_of_elem_], count * size_of_elem_);
       }
+      out += count * size_of_elem_;
+      start += count;
     }
     return Status::OK();
   }
@@ -406,13 +472,27 @@ class BShufBlockDecoder final : public BlockDecoder {
   uint32_t compressed_size_;
   uint32_t num_elems_after_padding_;
 
+  // The number of elements in each bitshuffle chunk (but the last), and the
+  // offset of each chunk's length prefix in 'data_'.
+  size_t elems_per_chunk_;
+  std::vector<uint32_t> chunk_offsets_;
+
+  // Whether each chunk has been decoded into 'decoded_'.
+  std::vector<bool> chunk_decoded_;
+
   // The size of each decoded element. In the case that the input range was
   // smaller than the type, this may be smaller than 'size_of_type'.
   // Currently, this is always 1, 2, 4, or 8.
   int size_of_elem_;
 
   size_t cur_idx_;
+
+  // The decoded elements of the chunks marked in 'chunk_decoded_'. The
+  // contents for other chunks are undefined.
   faststring decoded_;
+
+  // Scratch space for decoding a chunk.
+  faststring scratch_;
 };
 
 template<>
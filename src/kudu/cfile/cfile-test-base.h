@@ -228,6 +228,23 @@ class Int64DataGenerator : public DataGenerator<INT64, HAS_NULLS> {
   }
 };
 
+// Generator for int64 data with only 'num' distinct values, like a status code
+// or region id column.
+template<bool HAS_NULLS>
+class LowCardinalityInt64DataGenerator : public DataGenerator<INT64, HAS_NULLS> {
+ public:
+  explicit LowCardinalityInt64DataGenerator(int num)
+      : num_(num) {
+  }
+
+  int64_t BuildTestValue(size_t /*block_index*/, size_t value) OVERRIDE {
+    return (value % num_) * 1000000007LL;
+  }
+
+ private:
+  const int num_;
+};
+
 // Floating-point data generator.
 // This works for both floats and doubles.
 template<DataType DATA_TYPE, bool HAS_NULLS>
@@ -334,7 +351,10 @@ class CFileTestBase : public KuduTest {
   enum Flags {
     NO_FLAGS = 0,
     WRITE_VALIDX = 1,
-    SMALL_BLOCKSIZE = 1 << 1
+    SMALL_BLOCKSIZE = 1 << 1,
+    WRITE_ZONE_MAPS = 1 << 2,
+    WRITE_STATISTICS = 1 << 3,
+    ADAPTIVE_ENCODING = 1 << 4
   };
 
   template<class DataGeneratorType>
@@ -353,6 +373,15 @@ class CFileTestBase : public KuduTest {
     if (flags & WRITE_VALIDX) {
       opts.write_validx = true;
     }
+    if (flags & WRITE_ZONE_MAPS) {
+      opts.write_zone_map = true;
+    }
+    if (flags & WRITE_STATISTICS) {
+      opts.write_statistics = true;
+    }
+    if (flags & ADAPTIVE_ENCODING) {
+      opts.adaptive_encoding = true;
+    }
     if (flags & SMALL_BLOCKSIZE) {
       // Use a smaller block size to exercise multi-level indexing.
       opts.storage_attributes.cfile_block_size = 1024;
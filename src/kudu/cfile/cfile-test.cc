@@ -32,6 +32,7 @@
 #include <gtest/gtest.h>
 
 #include "kudu/cfile/block_cache.h"
+#include "kudu/cfile/block_cache_warmer.h"
 #include "kudu/cfile/block_handle.h"
 #include "kudu/cfile/block_pointer.h"
 #include "kudu/cfile/cfile-test-base.h"
@@ -39,9 +40,11 @@
 #include "kudu/cfile/cfile_reader.h"
 #include "kudu/cfile/cfile_util.h"
 #include "kudu/cfile/cfile_writer.h"
+#include "kudu/cfile/column_statistics.h"
 #include "kudu/cfile/index_btree.h"
 #include "kudu/cfile/type_encodings.h"
 #include "kudu/common/column_materialization_context.h"
+#include "kudu/common/column_predicate.h"
 #include "kudu/common/columnblock.h"
 #include "kudu/common/common.pb.h"
 #include "kudu/common/encoded_key.h"
@@ -67,20 +70,34 @@
 #include "kudu/util/mem_tracker.h"
 #include "kudu/util/memory/arena.h"
 #include "kudu/util/metrics.h"
+#include "kudu/util/scoped_cleanup.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/status.h"
 #include "kudu/util/stopwatch.h"
 #include "kudu/util/test_macros.h"
 #include "kudu/util/test_util.h"
 
+DECLARE_bool(cache_force_single_shard);
 DECLARE_bool(cfile_write_checksums);
 DECLARE_bool(cfile_verify_checksums);
+DECLARE_bool(cfile_late_materialization);
+DECLARE_double(block_cache_compressed_ratio);
+DECLARE_int64(block_cache_capacity_mb);
+DECLARE_int32(cfile_adaptive_encoding_sample_bytes);
+DECLARE_int32(cfile_readahead_bytes);
+DECLARE_int32(cfile_stream_readahead_bytes);
+DECLARE_int32(cfile_zstd_dictionary_size);
+DECLARE_int32(cfile_zstd_dictionary_training_bytes);
+DECLARE_bool(cfile_zero_copy_binary_scans);
 
 #if defined(__linux__)
 DECLARE_string(nvm_cache_path);
 DECLARE_bool(nvm_cache_simulate_allocation_failure);
 #endif
 
+METRIC_DECLARE_counter(block_cache_compressed_hits_caching);
+METRIC_DECLARE_counter(block_cache_compressed_inserts);
+METRIC_DECLARE_counter(block_cache_compressed_misses_caching);
 METRIC_DECLARE_counter(block_cache_hits_caching);
 
 METRIC_DECLARE_entity(server);
@@ -251,6 +268,66 @@ class TestCFile : public CFileTestBase {
     TimeSeekAndReadFileWithNulls(generator, block_id, n);
   }
 
+  // Scans a file with a sparse selection vector and no predicate, as is done
+  // for the non-predicate columns of a selective scan, and verifies that the
+  // selected rows are materialized correctly.
+  template <class DataGeneratorType>
+  void TestLateMaterialization(DataGeneratorType* generator, EncodingType encoding) {
+    const int kNumRows = 10000;
+    const int kBatchSize = 1000;
+    // A scattering of single rows, plus a dense stretch in each batch.
+    auto is_selected = [](int row) {
+      return row % 97 == 0 || (row % kBatchSize >= 500 && row % kBatchSize < 540 && row % 3 != 0);
+    };
+
+    generator->Reset();
+    BlockId block_id;
+    WriteTestFile(generator, encoding, NO_COMPRESSION, kNumRows, SMALL_BLOCKSIZE, &block_id);
+
+    unique_ptr<ReadableBlock> block;
+    ASSERT_OK(fs_manager_->OpenBlock(block_id, &block));
+    unique_ptr<CFileReader> reader;
+    ASSERT_OK(CFileReader::Open(std::move(block), ReaderOptions(), &reader));
+
+    for (bool late_materialization : { false, true }) {
+      FLAGS_cfile_late_materialization = late_materialization;
+      gscoped_ptr<CFileIterator> iter;
+      ASSERT_OK(reader->NewIterator(&iter, CFileReader::CACHE_BLOCK));
+      ASSERT_OK(iter->SeekToFirst());
+
+      ScopedColumnBlock<DataGeneratorType::kDataType> cb(kBatchSize);
+      SelectionVector sel(kBatchSize);
+      ColumnMaterializationContext ctx = CreateNonDecoderEvalContext(&cb, &sel);
+      int offset = 0;
+      while (iter->HasNext()) {
+        size_t n = cb.nrows();
+        ASSERT_OK(iter->PrepareBatch(&n));
+        sel.SetAllFalse();
+        for (size_t j = 0; j < n; j++) {
+          if (is_selected(offset + j)) {
+            BitmapSet(sel.mutable_bitmap(), j);
+          }
+        }
+        ASSERT_OK(iter->Scan(&ctx));
+        ASSERT_OK(iter->FinishBatch());
+
+        generator->Build(offset, n);
+        for (size_t j = 0; j < n; j++) {
+          ASSERT_EQ(is_selected(offset + j), sel.IsRowSelected(j));
+          if (!is_selected(offset + j)) continue;
+          bool expected_null = generator->TestValueShouldBeNull(offset + j);
+          ASSERT_EQ(expected_null, cb.is_null(j)) << "row " << offset + j;
+          if (!expected_null) {
+            ASSERT_EQ((*generator)[j], cb[j]) << "row " << offset + j;
+          }
+        }
+        cb.arena()->Reset();
+        offset += n;
+      }
+      ASSERT_EQ(kNumRows, offset);
+    }
+  }
+
   void TestReadWriteRawBlocks(CompressionType compression, int num_entries) {
     // Test Write
     unique_ptr<WritableBlock> sink;
@@ -384,6 +461,165 @@ class TestCFile : public CFileTestBase {
 
     return Status::OK();
   }
+
+  // Writes a file of ascending integers with zone maps, and checks that the
+  // zone maps rule out the right ranges of rows, and that scanning with a
+  // predicate still returns exactly the matching rows.
+  template <class DataGeneratorType>
+  void TestZoneMaps(DataGeneratorType* generator) {
+    // The values are the multiples of 10 in [0, 100000), so values in
+    // [50000, 50100) are found in rows [5000, 5010).
+    const int kNumRows = 10000;
+    BlockId block_id;
+    WriteTestFile(generator, PLAIN_ENCODING, NO_COMPRESSION, kNumRows,
+                  SMALL_BLOCKSIZE | WRITE_ZONE_MAPS, &block_id);
+
+    unique_ptr<ReadableBlock> block;
+    ASSERT_OK(fs_manager_->OpenBlock(block_id, &block));
+    unique_ptr<CFileReader> reader;
+    ASSERT_OK(CFileReader::Open(std::move(block), ReaderOptions(), &reader));
+    ASSERT_TRUE(reader->footer().has_zone_map_block_ptr());
+    gscoped_ptr<CFileIterator> iter;
+    ASSERT_OK(reader->NewIterator(&iter, CFileReader::CACHE_BLOCK));
+
+    ColumnSchema col("c", UINT32, DataGeneratorType::has_nulls());
+    uint32_t lower = 50000;
+    uint32_t upper = 50100;
+    ColumnPredicate pred = ColumnPredicate::Range(col, &lower, &upper);
+
+    bool may_match;
+    ASSERT_OK(iter->RowsMayMatch(0, 1000, pred, &may_match));
+    ASSERT_FALSE(may_match);
+    ASSERT_OK(iter->RowsMayMatch(4000, 2000, pred, &may_match));
+    ASSERT_TRUE(may_match);
+    ASSERT_OK(iter->RowsMayMatch(9000, 1000, pred, &may_match));
+    ASSERT_FALSE(may_match);
+    // Rows past the end of the file aren't covered by any zone map.
+    ASSERT_OK(iter->RowsMayMatch(9000, 2000, pred, &may_match));
+    ASSERT_TRUE(may_match);
+
+    // Scan the file with the predicate. The batches are smaller than the data
+    // blocks, so the blocks which can't match are skipped within Scan().
+    const size_t kBatchSize = 100;
+    ScopedColumnBlock<UINT32> cb(kBatchSize);
+    SelectionVector sel(kBatchSize);
+    ASSERT_OK(iter->SeekToFirst());
+    rowid_t row = 0;
+    while (iter->HasNext()) {
+      size_t n = kBatchSize;
+      ASSERT_OK(iter->PrepareBatch(&n));
+      ASSERT_EQ(kBatchSize, n);
+      sel.SetAllTrue();
+      ColumnMaterializationContext ctx(0, &pred, &cb, &sel);
+      ASSERT_OK(iter->Scan(&ctx));
+      if (ctx.DecoderEvalNotSupported()) {
+        pred.Evaluate(cb, &sel);
+      }
+      for (size_t i = 0; i < n; i++) {
+        rowid_t r = row + i;
+        bool expected = !generator->TestValueShouldBeNull(r) && r >= 5000 && r < 5010;
+        ASSERT_EQ(expected, sel.IsRowSelected(i)) << "row " << r;
+      }
+      ASSERT_OK(iter->FinishBatch());
+      row += n;
+    }
+    ASSERT_EQ(kNumRows, row);
+  }
+
+  // Writes a file of ascending integers with statistics, and checks that the
+  // footer describes its cells.
+  template <class DataGeneratorType>
+  void TestStatistics(DataGeneratorType* generator) {
+    const int kNumRows = 10000;
+    BlockId block_id;
+    WriteTestFile(generator, PLAIN_ENCODING, NO_COMPRESSION, kNumRows,
+                  SMALL_BLOCKSIZE | WRITE_STATISTICS, &block_id);
+
+    unique_ptr<ReadableBlock> block;
+    ASSERT_OK(fs_manager_->OpenBlock(block_id, &block));
+    unique_ptr<CFileReader> reader;
+    ASSERT_OK(CFileReader::Open(std::move(block), ReaderOptions(), &reader));
+    ASSERT_TRUE(reader->footer().has_statistics());
+    const ColumnStatisticsPB& stats = reader->footer().statistics();
+
+    uint64_t null_count = 0;
+    bool has_min = false;
+    uint32_t min = 0;
+    uint32_t max = 0;
+    for (int i = 0; i < kNumRows; i++) {
+      if (generator->TestValueShouldBeNull(i)) {
+        null_count++;
+        continue;
+      }
+      uint32_t value = generator->BuildTestValue(0, i);
+      if (!has_min) {
+        min = value;
+        has_min = true;
+      }
+      max = value;
+    }
+    const uint64_t non_null_count = kNumRows - null_count;
+    ASSERT_EQ(kNumRows, stats.num_values());
+    ASSERT_EQ(null_count, stats.null_count());
+    ASSERT_EQ(non_null_count * sizeof(uint32_t), stats.total_value_size());
+    ASSERT_EQ(string(reinterpret_cast<const char*>(&min), sizeof(min)), stats.min_value());
+    ASSERT_EQ(string(reinterpret_cast<const char*>(&max), sizeof(max)), stats.max_value());
+
+    // All of the values are distinct.
+    uint64_t estimate;
+    ASSERT_OK(EstimateDistinctValues(stats, &estimate));
+    ASSERT_GE(estimate, non_null_count * 0.9);
+    ASSERT_LE(estimate, non_null_count * 1.1);
+  }
+
+  // Writes a dictionary-encoded integer file, and checks that scanning it with
+  // the predicate 'lower <= value < upper', which the decoders evaluate
+  // themselves, returns exactly the matching rows.
+  template <class DataGeneratorType>
+  void TestDictEncodedIntsWithPredicate(DataGeneratorType* generator, int flags,
+                                        typename DataGeneratorType::cpp_type lower,
+                                        typename DataGeneratorType::cpp_type upper) {
+    const int kNumRows = 10000;
+    BlockId block_id;
+    WriteTestFile(generator, DICT_ENCODING, NO_COMPRESSION, kNumRows, flags, &block_id);
+
+    unique_ptr<ReadableBlock> block;
+    ASSERT_OK(fs_manager_->OpenBlock(block_id, &block));
+    unique_ptr<CFileReader> reader;
+    ASSERT_OK(CFileReader::Open(std::move(block), ReaderOptions(), &reader));
+    ASSERT_TRUE(reader->footer().has_dict_block_ptr());
+    gscoped_ptr<CFileIterator> iter;
+    ASSERT_OK(reader->NewIterator(&iter, CFileReader::CACHE_BLOCK));
+
+    ColumnSchema col("c", DataGeneratorType::kDataType, DataGeneratorType::has_nulls());
+    ColumnPredicate pred = ColumnPredicate::Range(col, &lower, &upper);
+
+    const size_t kBatchSize = 100;
+    ScopedColumnBlock<DataGeneratorType::kDataType> cb(kBatchSize);
+    SelectionVector sel(kBatchSize);
+    ASSERT_OK(iter->SeekToFirst());
+    rowid_t row = 0;
+    while (iter->HasNext()) {
+      size_t n = kBatchSize;
+      ASSERT_OK(iter->PrepareBatch(&n));
+      sel.SetAllTrue();
+      ColumnMaterializationContext ctx(0, &pred, &cb, &sel);
+      ASSERT_OK(iter->Scan(&ctx));
+      ASSERT_FALSE(ctx.DecoderEvalNotSupported());
+      for (size_t i = 0; i < n; i++) {
+        rowid_t r = row + i;
+        auto value = generator->BuildTestValue(0, r);
+        bool expected = !generator->TestValueShouldBeNull(r) && lower <= value && value < upper;
+        ASSERT_EQ(expected, sel.IsRowSelected(i)) << "row " << r;
+        if (expected) {
+          ASSERT_EQ(value, cb[i]) << "row " << r;
+        }
+      }
+      ASSERT_OK(iter->FinishBatch());
+      row += n;
+    }
+    ASSERT_EQ(kNumRows, row);
+  }
 };
 
 // Subclass of TestCFile which is parameterized on the block cache type.
@@ -525,25 +761,25 @@ TEST_P(TestCFileBothCacheTypes, TestWrite1MLowCardinalityStringsDictEncoding) {
 }
 
 TEST_P(TestCFileBothCacheTypes, TestReadWriteUInt32) {
-  for (auto enc : { PLAIN_ENCODING, RLE }) {
+  for (auto enc : { PLAIN_ENCODING, RLE, DICT_ENCODING }) {
     TestReadWriteFixedSizeTypes<UInt32DataGenerator<false>>(enc);
   }
 }
 
 TEST_P(TestCFileBothCacheTypes, TestReadWriteInt32) {
-  for (auto enc : { PLAIN_ENCODING, RLE }) {
+  for (auto enc : { PLAIN_ENCODING, RLE, DICT_ENCODING }) {
     TestReadWriteFixedSizeTypes<Int32DataGenerator<false>>(enc);
   }
 }
 
 TEST_P(TestCFileBothCacheTypes, TestReadWriteUInt64) {
-  for (auto enc : { PLAIN_ENCODING, RLE, BIT_SHUFFLE }) {
+  for (auto enc : { PLAIN_ENCODING, RLE, BIT_SHUFFLE, DICT_ENCODING }) {
     TestReadWriteFixedSizeTypes<UInt64DataGenerator<false>>(enc);
   }
 }
 
 TEST_P(TestCFileBothCacheTypes, TestReadWriteInt64) {
-  for (auto enc : { PLAIN_ENCODING, RLE, BIT_SHUFFLE }) {
+  for (auto enc : { PLAIN_ENCODING, RLE, BIT_SHUFFLE, DICT_ENCODING }) {
     TestReadWriteFixedSizeTypes<Int64DataGenerator<false>>(enc);
   }
 }
@@ -830,6 +1066,7 @@ TEST_P(TestCFileBothCacheTypes, TestAppendRaw) {
   TestReadWriteRawBlocks(SNAPPY, 1000);
   TestReadWriteRawBlocks(LZ4, 1000);
   TestReadWriteRawBlocks(ZLIB, 1000);
+  TestReadWriteRawBlocks(ZSTD, 1000);
 }
 
 TEST_P(TestCFileBothCacheTypes, TestChecksumFlags) {
@@ -888,6 +1125,7 @@ TEST_P(TestCFileBothCacheTypes, TestNullInts) {
   TestNullTypes(&generator, BIT_SHUFFLE, LZ4);
   TestNullTypes(&generator, RLE, NO_COMPRESSION);
   TestNullTypes(&generator, RLE, LZ4);
+  TestNullTypes(&generator, BIT_SHUFFLE, ZSTD);
 }
 
 TEST_P(TestCFileBothCacheTypes, TestNullFloats) {
@@ -915,6 +1153,146 @@ TEST_P(TestCFileBothCacheTypes, TestNullDictStrings) {
   TestNullTypes(&generator, DICT_ENCODING, LZ4);
 }
 
+TEST_P(TestCFileBothCacheTypes, TestLateMaterialization) {
+  {
+    UInt32DataGenerator<false> generator;
+    TestLateMaterialization(&generator, PLAIN_ENCODING);
+    TestLateMaterialization(&generator, BIT_SHUFFLE);
+    TestLateMaterialization(&generator, RLE);
+  }
+  {
+    UInt32DataGenerator<true> generator;
+    TestLateMaterialization(&generator, BIT_SHUFFLE);
+    TestLateMaterialization(&generator, RLE);
+  }
+  {
+    StringDataGenerator<true> generator("hello %zu");
+    TestLateMaterialization(&generator, PREFIX_ENCODING);
+    TestLateMaterialization(&generator, DICT_ENCODING);
+  }
+}
+
+TEST_P(TestCFileBothCacheTypes, TestZoneMaps) {
+  {
+    UInt32DataGenerator<false> generator;
+    NO_FATALS(TestZoneMaps(&generator));
+  }
+  {
+    UInt32DataGenerator<true> generator;
+    NO_FATALS(TestZoneMaps(&generator));
+  }
+}
+
+TEST_P(TestCFileBothCacheTypes, TestStatistics) {
+  {
+    UInt32DataGenerator<false> generator;
+    NO_FATALS(TestStatistics(&generator));
+  }
+  {
+    UInt32DataGenerator<true> generator;
+    NO_FATALS(TestStatistics(&generator));
+  }
+}
+
+// Checks that a file of strings with long shared prefixes, which are
+// dictionary-encoded by default, gets prefix-encoded when its encoding is
+// picked adaptively, both when the sample covers the whole file and when the
+// encoding is picked part way through.
+TEST_F(TestCFile, TestAdaptiveEncoding) {
+  for (int sample_bytes : { 4096, 1024 * 1024 }) {
+    SCOPED_TRACE(sample_bytes);
+    FLAGS_cfile_adaptive_encoding_sample_bytes = sample_bytes;
+    StringDataGenerator<true> generator("a fairly long common prefix %zu");
+    BlockId block_id;
+    WriteTestFile(&generator, AUTO_ENCODING, NO_COMPRESSION, 10000,
+                  SMALL_BLOCKSIZE | ADAPTIVE_ENCODING, &block_id);
+
+    unique_ptr<ReadableBlock> block;
+    ASSERT_OK(fs_manager_->OpenBlock(block_id, &block));
+    unique_ptr<CFileReader> reader;
+    ASSERT_OK(CFileReader::Open(std::move(block), ReaderOptions(), &reader));
+    ASSERT_EQ(PREFIX_ENCODING, reader->type_encoding_info()->encoding_type());
+
+    size_t n;
+    NO_FATALS(TimeReadFile(fs_manager_.get(), block_id, &n));
+    ASSERT_EQ(10000, n);
+    generator.Reset();
+    NO_FATALS(TimeSeekAndReadFileWithNulls(&generator, block_id, n));
+  }
+}
+
+TEST_F(TestCFile, TestMergeColumnStatistics) {
+  const TypeInfo* type = GetTypeInfo(BINARY);
+  const vector<Slice> first = { "banana", "apple", "cherry" };
+  const vector<Slice> second = { "cherry", "date" };
+
+  ColumnStatisticsPB merged;
+  {
+    ColumnStatisticsBuilder builder(type);
+    builder.AddCells(reinterpret_cast<const uint8_t*>(first.data()), first.size());
+    builder.AddNulls(2);
+    builder.Finish(&merged);
+  }
+  ColumnStatisticsPB stats;
+  {
+    ColumnStatisticsBuilder builder(type);
+    builder.AddCells(reinterpret_cast<const uint8_t*>(second.data()), second.size());
+    builder.Finish(&stats);
+  }
+  ASSERT_OK(MergeColumnStatistics(type, stats, &merged));
+  ASSERT_EQ(7, merged.num_values());
+  ASSERT_EQ(2, merged.null_count());
+  ASSERT_EQ(6 + 5 + 6 + 6 + 4, merged.total_value_size());
+  ASSERT_EQ("apple", merged.min_value());
+  ASSERT_EQ("date", merged.max_value());
+  uint64_t estimate;
+  ASSERT_OK(EstimateDistinctValues(merged, &estimate));
+  ASSERT_EQ(4, estimate);
+
+  // Once the bounds of either side are unknown, so are those of the union.
+  const string long_value(100, 'x');
+  const Slice long_slice(long_value);
+  {
+    ColumnStatisticsBuilder builder(type);
+    builder.AddCells(reinterpret_cast<const uint8_t*>(&long_slice), 1);
+    builder.Finish(&stats);
+  }
+  ASSERT_FALSE(stats.has_min_value());
+  ASSERT_OK(MergeColumnStatistics(type, stats, &merged));
+  ASSERT_FALSE(merged.has_min_value());
+  ASSERT_FALSE(merged.has_max_value());
+  ASSERT_EQ(8, merged.num_values());
+
+  // Statistics without a sketch can't be merged into one.
+  stats.clear_distinct_values_sketch();
+  ASSERT_OK(MergeColumnStatistics(type, stats, &merged));
+  ASSERT_TRUE(EstimateDistinctValues(merged, &estimate).IsNotFound());
+}
+
+TEST_P(TestCFileBothCacheTypes, TestDictEncodedIntsWithPredicate) {
+  const int64_t kValue = 1000000007LL;
+  {
+    // Ten distinct values, of which two match.
+    LowCardinalityInt64DataGenerator<false> generator(10);
+    NO_FATALS(TestDictEncodedIntsWithPredicate(&generator, NO_FLAGS, 2 * kValue, 4 * kValue));
+  }
+  {
+    LowCardinalityInt64DataGenerator<true> generator(10);
+    NO_FATALS(TestDictEncodedIntsWithPredicate(&generator, NO_FLAGS, 2 * kValue, 4 * kValue));
+  }
+  {
+    // No values match.
+    LowCardinalityInt64DataGenerator<false> generator(10);
+    NO_FATALS(TestDictEncodedIntsWithPredicate(&generator, NO_FLAGS, -2 * kValue, -kValue));
+  }
+  {
+    // Unique values overflow the dictionary, and the later blocks fall back
+    // to plain encoding.
+    Int64DataGenerator<true> generator;
+    NO_FATALS(TestDictEncodedIntsWithPredicate(&generator, SMALL_BLOCKSIZE, 0, INT64_MAX / 2));
+  }
+}
+
 TEST_P(TestCFileBothCacheTypes, TestReleaseBlock) {
   unique_ptr<WritableBlock> sink;
   ASSERT_OK(fs_manager_->CreateNewBlock({}, &sink));
@@ -1019,6 +1397,262 @@ TEST_P(TestCFileBothCacheTypes, TestCacheKeysAreStable) {
   }
 }
 
+// Tests that sequential scans which read ahead return the same data as those
+// which don't, whether the readahead covers many blocks or less than one, and
+// however the scan seeks around. Streaming iterators, which always read ahead
+// and drop what they read from the page cache, are tested too.
+TEST_F(TestCFile, TestReadahead) {
+  const int kNumRows = 100000;
+  BlockId block_id;
+  UInt32DataGenerator<false> generator;
+  WriteTestFile(&generator, PLAIN_ENCODING, NO_COMPRESSION, kNumRows,
+                SMALL_BLOCKSIZE | WRITE_VALIDX, &block_id);
+
+  for (auto cache_control : { CFileReader::DONT_CACHE_BLOCK,
+                              CFileReader::DONT_CACHE_BLOCK_OR_PAGES }) {
+    for (int readahead_bytes : { 0, 1, 4096, 64 * 1024 }) {
+      SCOPED_TRACE(cache_control);
+      SCOPED_TRACE(readahead_bytes);
+      FLAGS_cfile_readahead_bytes = readahead_bytes;
+      FLAGS_cfile_stream_readahead_bytes = readahead_bytes;
+
+      unique_ptr<ReadableBlock> block;
+      ASSERT_OK(fs_manager_->OpenBlock(block_id, &block));
+      unique_ptr<CFileReader> reader;
+      ASSERT_OK(CFileReader::Open(std::move(block), ReaderOptions(), &reader));
+      gscoped_ptr<CFileIterator> iter;
+      // Don't cache, so that every pass actually reads the file.
+      ASSERT_OK(reader->NewIterator(&iter, cache_control));
+
+      for (int start : { 0, kNumRows / 2, 17 }) {
+        SCOPED_TRACE(start);
+        ASSERT_OK(iter->SeekToOrdinal(start));
+        const int kBatchSize = 997;
+        ScopedColumnBlock<UINT32> out(kBatchSize);
+        SelectionVector sel(kBatchSize);
+        int row = start;
+        while (iter->HasNext()) {
+          size_t n = kBatchSize;
+          ColumnMaterializationContext ctx = CreateNonDecoderEvalContext(&out, &sel);
+          ASSERT_OK(iter->CopyNextValues(&n, &ctx));
+          for (int i = 0; i < n; i++) {
+            ASSERT_EQ(generator.BuildTestValue(0, row + i), out[i]) << "row " << (row + i);
+          }
+          row += n;
+        }
+        ASSERT_EQ(kNumRows, row);
+      }
+    }
+  }
+}
+
+// Tests that scanned plain-encoded strings point into the file's blocks
+// rather than being copied into the destination arena, and that the arena
+// keeps the blocks alive even after the reader is gone.
+TEST_F(TestCFile, TestZeroCopyBinaryScan) {
+  const int kNumRows = 10000;
+  BlockId block_id;
+  StringDataGenerator<false> generator("hello %zu");
+  WriteTestFile(&generator, PLAIN_ENCODING, NO_COMPRESSION, kNumRows,
+                SMALL_BLOCKSIZE, &block_id);
+  size_t total_bytes = 0;
+  for (int i = 0; i < kNumRows; i++) {
+    total_bytes += StringPrintf("hello %d", i).size();
+  }
+
+  for (bool zero_copy : { true, false }) {
+    SCOPED_TRACE(zero_copy);
+    FLAGS_cfile_zero_copy_binary_scans = zero_copy;
+    ScopedColumnBlock<STRING> out(kNumRows);
+    {
+      unique_ptr<ReadableBlock> block;
+      ASSERT_OK(fs_manager_->OpenBlock(block_id, &block));
+      unique_ptr<CFileReader> reader;
+      ASSERT_OK(CFileReader::Open(std::move(block), ReaderOptions(), &reader));
+      gscoped_ptr<CFileIterator> iter;
+      // Uncached blocks are freed as soon as nothing references them.
+      ASSERT_OK(reader->NewIterator(&iter, CFileReader::DONT_CACHE_BLOCK));
+      ASSERT_OK(iter->SeekToFirst());
+      SelectionVector sel(kNumRows);
+      size_t n = kNumRows;
+      ColumnMaterializationContext ctx = CreateNonDecoderEvalContext(&out, &sel);
+      ASSERT_OK(iter->CopyNextValues(&n, &ctx));
+      ASSERT_EQ(kNumRows, n);
+    }
+    if (zero_copy) {
+      ASSERT_LT(out.arena()->memory_footprint(), total_bytes);
+    } else {
+      ASSERT_GE(out.arena()->memory_footprint(), total_bytes);
+    }
+    for (int i = 0; i < kNumRows; i++) {
+      ASSERT_EQ(StringPrintf("hello %d", i), out[i].ToString()) << "row " << i;
+    }
+  }
+}
+
+// Tests that blocks of a compressed file which don't fit in the uncompressed
+// tier of the block cache are served from its compressed tier.
+TEST_F(TestCFile, TestCompressedBlockCacheTier) {
+  FLAGS_cache_force_single_shard = true;
+  FLAGS_block_cache_capacity_mb = 1;
+  FLAGS_block_cache_compressed_ratio = 0.9;
+  Singleton<BlockCache>::UnsafeReset();
+  SCOPED_CLEANUP({ Singleton<BlockCache>::UnsafeReset(); });
+
+  MetricRegistry registry;
+  scoped_refptr<MetricEntity> entity(METRIC_ENTITY_server.Instantiate(&registry, "test_entity"));
+  BlockCache* cache = BlockCache::GetSingleton();
+  ASSERT_TRUE(cache->has_compressed_tier());
+  cache->StartInstrumentation(entity);
+  auto counter_value = [&](const CounterPrototype& proto) {
+    return down_cast<Counter*>(entity->FindOrNull(proto).get())->value();
+  };
+
+  // A file whose uncompressed blocks are several times larger than the
+  // uncompressed tier, but whose compressed blocks fit in the compressed tier.
+  BlockId block_id;
+  {
+    const int nrows = 50000;
+    StringDataGenerator<false> generator("hello %05d");
+    WriteTestFile(&generator, PLAIN_ENCODING, LZ4, nrows,
+                  SMALL_BLOCKSIZE | WRITE_VALIDX, &block_id);
+  }
+
+  // Read every data block twice.
+  unique_ptr<ReadableBlock> source;
+  ASSERT_OK(fs_manager_->OpenBlock(block_id, &source));
+  unique_ptr<CFileReader> reader;
+  ASSERT_OK(CFileReader::Open(std::move(source), ReaderOptions(), &reader));
+  vector<string> first_pass;
+  int64_t disk_reads_after_first_pass = 0;
+  for (int pass = 0; pass < 2; pass++) {
+    gscoped_ptr<IndexTreeIterator> iter(
+        IndexTreeIterator::Create(reader.get(), reader->posidx_root()));
+    ASSERT_OK(iter->SeekToFirst());
+    int block_idx = 0;
+    while (true) {
+      BlockHandle bh;
+      ASSERT_OK(reader->ReadBlock(iter->GetCurrentBlockPointer(),
+                                  CFileReader::CACHE_BLOCK, &bh));
+      if (pass == 0) {
+        first_pass.push_back(bh.data().ToString());
+      } else {
+        ASSERT_EQ(first_pass[block_idx], bh.data().ToString());
+      }
+      block_idx++;
+      if (!iter->HasNext()) break;
+      ASSERT_OK(iter->Next());
+    }
+    if (pass == 0) {
+      disk_reads_after_first_pass =
+          counter_value(METRIC_block_cache_compressed_misses_caching);
+      ASSERT_GT(disk_reads_after_first_pass, 0);
+      ASSERT_EQ(disk_reads_after_first_pass,
+                counter_value(METRIC_block_cache_compressed_inserts));
+    }
+  }
+
+  // The second pass didn't go to disk, and was mostly served by the
+  // compressed tier.
+  ASSERT_EQ(disk_reads_after_first_pass,
+            counter_value(METRIC_block_cache_compressed_misses_caching));
+  ASSERT_GT(counter_value(METRIC_block_cache_compressed_hits_caching),
+            counter_value(METRIC_block_cache_hits_caching));
+}
+
+// Test that the blocks of a snapshot of the block cache are read back into
+// a cold cache.
+TEST_F(TestCFile, TestBlockCacheWarmup) {
+  Singleton<BlockCache>::UnsafeReset();
+  SCOPED_CLEANUP({ Singleton<BlockCache>::UnsafeReset(); });
+  BlockCacheWarmer warmer(fs_manager_.get());
+  ASSERT_TRUE(warmer.WarmFromSnapshot().IsNotFound());
+
+  BlockId block_id;
+  UInt32DataGenerator<false> generator;
+  WriteTestFile(&generator, PLAIN_ENCODING, NO_COMPRESSION, 10000, SMALL_BLOCKSIZE, &block_id);
+
+  // Cache every other data block.
+  unique_ptr<ReadableBlock> source;
+  ASSERT_OK(fs_manager_->OpenBlock(block_id, &source));
+  unique_ptr<CFileReader> reader;
+  ASSERT_OK(CFileReader::Open(std::move(source), ReaderOptions(), &reader));
+  vector<BlockPointer> data_blocks;
+  gscoped_ptr<IndexTreeIterator> iter(
+      IndexTreeIterator::Create(reader.get(), reader->posidx_root()));
+  ASSERT_OK(iter->SeekToFirst());
+  while (true) {
+    data_blocks.push_back(iter->GetCurrentBlockPointer());
+    if (!iter->HasNext()) break;
+    ASSERT_OK(iter->Next());
+  }
+  ASSERT_GT(data_blocks.size(), 2);
+  for (int i = 0; i < data_blocks.size(); i += 2) {
+    BlockHandle bh;
+    ASSERT_OK(reader->ReadBlock(data_blocks[i], CFileReader::CACHE_BLOCK, &bh));
+  }
+  ASSERT_OK(warmer.SaveSnapshot());
+
+  // After a restart, the same blocks are cached again.
+  Singleton<BlockCache>::UnsafeReset();
+  ASSERT_OK(warmer.WarmFromSnapshot());
+  BlockCache* cache = BlockCache::GetSingleton();
+  for (int i = 0; i < data_blocks.size(); i++) {
+    BlockCacheHandle handle;
+    ASSERT_EQ(i % 2 == 0,
+              cache->Lookup(BlockCache::CacheKey(block_id, data_blocks[i].offset()),
+                            Cache::NO_EXPECT_IN_CACHE, &handle)) << i;
+  }
+
+  // The blocks of a deleted file are skipped.
+  reader.reset();
+  ASSERT_OK(fs_manager_->DeleteBlock(block_id));
+  Singleton<BlockCache>::UnsafeReset();
+  ASSERT_OK(warmer.WarmFromSnapshot());
+}
+
+// Test that a cfile whose later blocks are compressed with a trained ZSTD
+// dictionary reads back correctly, including the blocks written before the
+// dictionary was trained.
+TEST_F(TestCFile, TestZstdDictionary) {
+  FLAGS_cfile_zstd_dictionary_size = 4096;
+  FLAGS_cfile_zstd_dictionary_training_bytes = 64 * 1024;
+
+  const int nrows = 50000;
+  auto formatter = [](size_t i) {
+    return StringPrintf("host-%03zu.example.com/metrics/cpu_%zu", i % 101, i);
+  };
+  BlockId block_id;
+  {
+    StringDataGenerator<false> generator(formatter);
+    WriteTestFile(&generator, PLAIN_ENCODING, ZSTD, nrows,
+                  SMALL_BLOCKSIZE, &block_id);
+  }
+
+  unique_ptr<ReadableBlock> block;
+  ASSERT_OK(fs_manager_->OpenBlock(block_id, &block));
+  unique_ptr<CFileReader> reader;
+  ASSERT_OK(CFileReader::Open(std::move(block), ReaderOptions(), &reader));
+  ASSERT_EQ(ZSTD, reader->footer().compression());
+  ASSERT_TRUE(reader->footer().incompatible_features() & IncompatibleFeatures::ZSTD_DICTIONARY);
+
+  gscoped_ptr<CFileIterator> iter;
+  ASSERT_OK(reader->NewIterator(&iter, CFileReader::CACHE_BLOCK));
+  ASSERT_OK(iter->SeekToFirst());
+  SelectionVector sel(1000);
+  int row = 0;
+  while (iter->HasNext()) {
+    ScopedColumnBlock<STRING> cb(1000);
+    ColumnMaterializationContext ctx = CreateNonDecoderEvalContext(&cb, &sel);
+    size_t n = cb.nrows();
+    ASSERT_OK(iter->CopyNextValues(&n, &ctx));
+    for (size_t i = 0; i < n; i++, row++) {
+      ASSERT_EQ(formatter(row), cb[i].ToString());
+    }
+  }
+  ASSERT_EQ(nrows, row);
+}
+
 #if defined(__linux__)
 // Inject failures in nvm allocation and ensure that we can still read a file.
 TEST_P(TestCFileBothCacheTypes, TestNvmAllocationFailure) {
@@ -36,6 +36,7 @@
 #include "kudu/cfile/cfile_writer.h" // for kMagicString
 #include "kudu/cfile/index_btree.h"
 #include "kudu/cfile/type_encodings.h"
+#include "kudu/cfile/zone_map.h"
 #include "kudu/common/column_materialization_context.h"
 #include "kudu/common/column_predicate.h"
 #include "kudu/common/columnblock.h"
@@ -45,6 +46,7 @@
 #include "kudu/common/rowblock.h"
 #include "kudu/common/types.h"
 #include "kudu/gutil/basictypes.h"
+#include "kudu/gutil/casts.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/move.h"
 #include "kudu/gutil/stringprintf.h"
@@ -56,6 +58,7 @@
 #include "kudu/util/compression/compression_codec.h"
 #include "kudu/util/crc.h"
 #include "kudu/util/debug/trace_event.h"
+#include "kudu/util/env.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/malloc.h"
@@ -63,7 +66,9 @@
 #include "kudu/util/memory/overwrite.h"
 #include "kudu/util/object_pool.h"
 #include "kudu/util/pb_util.h"
+#include "kudu/util/probes.h"
 #include "kudu/util/rle-encoding.h"
+#include "kudu/util/scoped_cleanup.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/status.h"
 #include "kudu/util/trace.h"
@@ -76,8 +81,48 @@ DEFINE_bool(cfile_verify_checksums, true,
             "Verify the checksum for each block on read if one exists");
 TAG_FLAG(cfile_verify_checksums, evolving);
 
+DEFINE_bool(cfile_use_zone_maps, true,
+            "Whether to use the per-block zone maps of cfiles to skip data blocks "
+            "which can't match scan predicates");
+TAG_FLAG(cfile_use_zone_maps, hidden);
+TAG_FLAG(cfile_use_zone_maps, runtime);
+
+DEFINE_bool(cfile_late_materialization, true,
+            "Whether to only decode the values of a column for the rows which passed "
+            "the scan's predicates evaluated so far, skipping over the other rows.");
+TAG_FLAG(cfile_late_materialization, hidden);
+TAG_FLAG(cfile_late_materialization, runtime);
+
+DEFINE_int32(cfile_readahead_bytes, 1024 * 1024,
+             "Number of bytes of a cfile which a scan which reads its data "
+             "blocks sequentially has the OS read ahead into its page cache at "
+             "once. Reading many blocks at once cuts down on the number of IOs "
+             "and, on spinning disks, on the number of seeks between the files "
+             "of the scanned columns. 0 disables readahead.");
+TAG_FLAG(cfile_readahead_bytes, advanced);
+TAG_FLAG(cfile_readahead_bytes, runtime);
+
+DEFINE_int32(cfile_stream_readahead_bytes, 8 * 1024 * 1024,
+             "Number of bytes of a cfile which an iterator which streams through "
+             "it without caching it, e.g. as input to a compaction, has the OS "
+             "read ahead into its page cache at once. Such iterators read ahead "
+             "from their first data block on, and drop what they read from the "
+             "page cache once they're done with it. 0 falls back to "
+             "--cfile_readahead_bytes.");
+TAG_FLAG(cfile_stream_readahead_bytes, advanced);
+TAG_FLAG(cfile_stream_readahead_bytes, runtime);
+
+DEFINE_bool(cfile_zero_copy_binary_scans, true,
+            "Whether scans of plain-encoded binary columns return cells which "
+            "point into the cfile's data blocks, keeping the blocks pinned "
+            "until the scanned batch is released, instead of copying the "
+            "cells out of the blocks.");
+TAG_FLAG(cfile_zero_copy_binary_scans, hidden);
+TAG_FLAG(cfile_zero_copy_binary_scans, runtime);
+
 using kudu::fs::ReadableBlock;
 using kudu::pb_util::SecureDebugString;
+using std::shared_ptr;
 using std::string;
 using std::unique_ptr;
 using std::vector;
@@ -131,6 +176,9 @@ CFileReader::CFileReader(ReaderOptions options,
                    memory_footprint()) {
 }
 
+CFileReader::~CFileReader() {
+}
+
 Status CFileReader::Open(unique_ptr<ReadableBlock> block,
                          ReaderOptions options,
                          unique_ptr<CFileReader>* reader) {
@@ -306,6 +354,15 @@ Status CFileReader::ReadAndParseFooter() {
     RETURN_NOT_OK_PREPEND(GetCompressionCodec(footer_->compression(), &codec_),
                           "failed to load CFile compression codec");
   }
+  if (footer_->has_zstd_dictionary()) {
+    RETURN_NOT_OK_PREPEND(NewZstdDictionaryCodec(footer_->zstd_dictionary(), 0,
+                                                 &zstd_dictionary_codec_),
+                          "failed to load CFile zstd dictionary");
+    codec_ = zstd_dictionary_codec_.get();
+    // The codec keeps its own copy, and footers stay in memory for as long
+    // as the cfile is open.
+    footer_->clear_zstd_dictionary();
+  }
 
   VLOG(2) << "Read footer: " << SecureDebugString(*footer_);
 
@@ -359,16 +416,15 @@ class ScratchMemory {
   // no capacity and cannot evict to make room, this will fall back
   // to allocating from the heap. In that case, IsFromCache() will
   // return false.
-  void TryAllocateFromCache(BlockCache* cache, const BlockCache::CacheKey& key, int size) {
-    DCHECK(!ptr_);
-    from_cache_ = cache->Allocate(key, size);
-    if (!from_cache_.valid()) {
-      AllocateFromHeap(size);
-      return;
-    } else {
-      ptr_ = from_cache_.val_ptr();
-    }
-    size_ = size;
+  void TryAllocateFromCache(BlockCache* cache, const BlockCache::CacheKey& key, int size,
+                            Cache::Priority priority) {
+    TryAllocate(cache->Allocate(key, size, priority), size);
+  }
+
+  // Like TryAllocateFromCache(), but from the compressed tier of the cache.
+  void TryAllocateFromCompressedCache(BlockCache* cache, const BlockCache::CacheKey& key,
+                                      int size, Cache::Priority priority) {
+    TryAllocate(cache->AllocateCompressed(key, size, priority), size);
   }
 
   void AllocateFromHeap(int size) {
@@ -410,6 +466,18 @@ class ScratchMemory {
   }
 
  private:
+  void TryAllocate(BlockCache::PendingEntry entry, int size) {
+    DCHECK(!ptr_);
+    from_cache_ = std::move(entry);
+    if (!from_cache_.valid()) {
+      AllocateFromHeap(size);
+      return;
+    } else {
+      ptr_ = from_cache_.val_ptr();
+    }
+    size_ = size;
+  }
+
   BlockCache::PendingEntry from_cache_;
   uint8_t* ptr_;
   int size_;
@@ -417,19 +485,54 @@ class ScratchMemory {
 };
 } // anonymous namespace
 
+bool ReadaheadWindow::Contains(uint64_t offset, size_t size) const {
+  return offset >= offset_ && offset + size <= offset_ + size_;
+}
+
+Status ReadaheadWindow::Prefetch(const ReadableBlock& block, uint64_t offset, size_t size) {
+  // Even if the advice fails, there's no point in retrying it for every block.
+  offset_ = offset;
+  size_ = size;
+  return block.Prefetch(offset, size);
+}
+
+void ReadaheadWindow::DropCache(const ReadableBlock& block) const {
+  if (size_ > 0) {
+    WARN_NOT_OK(block.DropCache(offset_, size_),
+                Substitute("could not drop block $0 from the page cache",
+                           block.id().ToString()));
+  }
+}
+
 Status CFileReader::ReadBlock(const BlockPointer &ptr, CacheControl cache_control,
-                              BlockHandle *ret) const {
+                              BlockHandle *ret, Cache::Priority priority,
+                              ReadaheadWindow* readahead) const {
   DCHECK(init_once_.init_succeeded());
   CHECK(ptr.offset() > 0 &&
         ptr.offset() + ptr.size() < file_size_) <<
     "bad offset " << ptr.ToString() << " in file of size "
                   << file_size_;
+  // Uncompressed blocks of memory mapped files are decoded straight out of
+  // the mapping rather than being copied into the block cache, so that they
+  // aren't held in memory by both the page cache and the block cache.
+  Slice mapped_block;
+  shared_ptr<const FileMapping> mapping;
+  const bool stream = cache_control == DONT_CACHE_BLOCK_OR_PAGES;
+  if (codec_ == nullptr && !stream &&
+      block_->ReadMapped(ptr.offset(), ptr.size(), &mapped_block, &mapping)) {
+    TRACE_COUNTER_INCREMENT("cfile_mapped_read", 1);
+    RETURN_NOT_OK(VerifyMappedBlock(ptr, &mapped_block));
+    *ret = BlockHandle::WithMappedData(mapped_block, std::move(mapping));
+    return Status::OK();
+  }
+
   BlockCacheHandle bc_handle;
   Cache::CacheBehavior cache_behavior = cache_control == CACHE_BLOCK ?
       Cache::EXPECT_IN_CACHE : Cache::NO_EXPECT_IN_CACHE;
   BlockCache* cache = BlockCache::GetSingleton();
   BlockCache::CacheKey key(block_->id(), ptr.offset());
   if (cache->Lookup(key, cache_behavior, &bc_handle)) {
+    KUDU_PROBE(cfile_block_cache_hit, key.file_id_, ptr.offset(), ptr.size());
     TRACE_COUNTER_INCREMENT("cfile_cache_hit", 1);
     TRACE_COUNTER_INCREMENT(CFILE_CACHE_HIT_BYTES_METRIC_NAME, ptr.size());
     *ret = BlockHandle::WithDataFromCache(&bc_handle);
@@ -437,50 +540,104 @@ Status CFileReader::ReadBlock(const BlockPointer &ptr, CacheControl cache_contro
     return Status::OK();
   }
 
-  // Cache miss: need to read ourselves.
-  // We issue trace events only in the cache miss case since we expect the
-  // tracing overhead to be small compared to the IO (even if it's a memcpy
-  // from the Linux cache).
-  TRACE_EVENT1("io", "CFileReader::ReadBlock(cache miss)",
-               "cfile", ToString());
-  TRACE_COUNTER_INCREMENT("cfile_cache_miss", 1);
-  TRACE_COUNTER_INCREMENT(CFILE_CACHE_MISS_BYTES_METRIC_NAME, ptr.size());
-
-  uint32_t data_size = ptr.size();
-  if (has_checksums()) {
-    if (PREDICT_FALSE(kChecksumSize > data_size)) {
-      return Status::Corruption("invalid data size for block pointer",
-                                ptr.ToString());
-    }
-    data_size -= kChecksumSize;
-  }
+  // For compressed files, look for the block as stored on disk in the
+  // compressed tier of the cache, and cache it there when reading it.
+  const bool use_compressed_tier = codec_ != nullptr && cache_control == CACHE_BLOCK &&
+      cache->has_compressed_tier();
 
   ScratchMemory scratch;
-  // If we are reading uncompressed data and plan to cache the result,
-  // then we should allocate our scratch memory directly from the cache.
-  // This avoids an extra memory copy in the case of an NVM cache.
-  if (codec_ == nullptr && cache_control == CACHE_BLOCK) {
-    scratch.TryAllocateFromCache(cache, key, data_size);
+  BlockCacheHandle compressed_handle;
+  Slice block;
+  if (use_compressed_tier && cache->LookupCompressed(key, cache_behavior, &compressed_handle)) {
+    // Compressed cache hit: the block has already been verified, so all that's
+    // left is to decompress it below.
+    TRACE_COUNTER_INCREMENT("cfile_compressed_cache_hit", 1);
+    TRACE_COUNTER_INCREMENT(CFILE_CACHE_HIT_BYTES_METRIC_NAME, ptr.size());
+    block = compressed_handle.data();
+  } else if (codec_ != nullptr && !use_compressed_tier && !stream &&
+             block_->ReadMapped(ptr.offset(), ptr.size(), &mapped_block, &mapping)) {
+    // Compressed blocks of memory mapped files are decompressed straight out
+    // of the mapping, and only the decompressed block is cached.
+    TRACE_COUNTER_INCREMENT("cfile_cache_miss", 1);
+    TRACE_COUNTER_INCREMENT(CFILE_CACHE_MISS_BYTES_METRIC_NAME, ptr.size());
+    TRACE_COUNTER_INCREMENT("cfile_mapped_read", 1);
+    RETURN_NOT_OK(VerifyMappedBlock(ptr, &mapped_block));
+    block = mapped_block;
   } else {
-    scratch.AllocateFromHeap(data_size);
-  }
-  uint8_t* buf = scratch.get();
-  Slice block(buf, data_size);
-  uint8_t checksum_scratch[kChecksumSize];
-  Slice checksum(checksum_scratch, kChecksumSize);
-
-  // Read the data and checksum if needed.
-  Slice results_backing[] = { block, checksum };
-  bool read_checksum = has_checksums() && FLAGS_cfile_verify_checksums;
-  ArrayView<Slice> results(results_backing, read_checksum ? 2 : 1);
-  RETURN_NOT_OK_PREPEND(block_->ReadV(ptr.offset(), results),
-                        Substitute("failed to read CFile block $0 at $1",
-                                   block_id().ToString(), ptr.ToString()));
+    // Cache miss: need to read ourselves.
+    // We issue trace events only in the cache miss case since we expect the
+    // tracing overhead to be small compared to the IO (even if it's a memcpy
+    // from the Linux cache).
+    TRACE_EVENT1("io", "CFileReader::ReadBlock(cache miss)",
+                 "cfile", ToString());
+    TRACE_COUNTER_INCREMENT("cfile_cache_miss", 1);
+    TRACE_COUNTER_INCREMENT(CFILE_CACHE_MISS_BYTES_METRIC_NAME, ptr.size());
+    KUDU_PROBE(cfile_block_cache_miss, key.file_id_, ptr.offset(), ptr.size());
+
+    uint32_t data_size = ptr.size();
+    if (has_checksums()) {
+      if (PREDICT_FALSE(kChecksumSize > data_size)) {
+        return Status::Corruption("invalid data size for block pointer",
+                                  ptr.ToString());
+      }
+      data_size -= kChecksumSize;
+    }
 
-  if (has_checksums() && FLAGS_cfile_verify_checksums) {
-    RETURN_NOT_OK_PREPEND(VerifyChecksum(ArrayView<const Slice>(&block, 1), checksum),
-                          Substitute("checksum error on CFile block $0 at $1",
+    // If we are reading uncompressed data and plan to cache the result,
+    // then we should allocate our scratch memory directly from the cache.
+    // This avoids an extra memory copy in the case of an NVM cache. The
+    // same goes for compressed data which is to be cached in the compressed
+    // tier.
+    if (codec_ == nullptr && cache_control == CACHE_BLOCK) {
+      scratch.TryAllocateFromCache(cache, key, data_size, priority);
+    } else if (use_compressed_tier) {
+      scratch.TryAllocateFromCompressedCache(cache, key, data_size, priority);
+    } else {
+      scratch.AllocateFromHeap(data_size);
+    }
+    block = Slice(scratch.get(), data_size);
+    uint8_t checksum_scratch[kChecksumSize];
+    Slice checksum(checksum_scratch, kChecksumSize);
+
+    // Read the data and checksum if needed.
+    KUDU_PROBE(cfile_read_block_start, key.file_id_, ptr.offset(), ptr.size());
+    SCOPED_CLEANUP({
+      KUDU_PROBE(cfile_read_block_done, key.file_id_, ptr.offset(), ptr.size());
+    });
+    Slice results_backing[] = { block, checksum };
+    bool read_checksum = has_checksums() && FLAGS_cfile_verify_checksums;
+    ArrayView<Slice> results(results_backing, read_checksum ? 2 : 1);
+    if (readahead != nullptr && !readahead->Contains(ptr.offset(), ptr.size())) {
+      // Rather than reading the window into a buffer of the iterator, which
+      // would take that much untracked memory for each column of each scan,
+      // have the OS read it ahead into its page cache. Read as far ahead as
+      // requested, but at least the whole block, and without running past
+      // the end of the file.
+      uint64_t size = FLAGS_cfile_readahead_bytes;
+      if (stream && FLAGS_cfile_stream_readahead_bytes > 0) {
+        size = FLAGS_cfile_stream_readahead_bytes;
+      }
+      size = std::max<uint64_t>(size, ptr.size());
+      size = std::min<uint64_t>(size, file_size_ - ptr.offset());
+      TRACE_COUNTER_INCREMENT("cfile_readahead_bytes", size);
+      WARN_NOT_OK(readahead->Prefetch(*block_, ptr.offset(), size),
+                  Substitute("could not read ahead CFile block $0 at $1",
+                             block_id().ToString(), ptr.ToString()));
+    }
+    RETURN_NOT_OK_PREPEND(block_->ReadV(ptr.offset(), results),
+                          Substitute("failed to read CFile block $0 at $1",
                                      block_id().ToString(), ptr.ToString()));
+    if (stream) {
+      WARN_NOT_OK(block_->DropCache(ptr.offset(), ptr.size()),
+                  Substitute("could not drop CFile block $0 at $1 from the page cache",
+                             block_id().ToString(), ptr.ToString()));
+    }
+
+    if (has_checksums() && FLAGS_cfile_verify_checksums) {
+      RETURN_NOT_OK_PREPEND(VerifyChecksum(ArrayView<const Slice>(&block, 1), checksum),
+                            Substitute("checksum error on CFile block $0 at $1",
+                                       block_id().ToString(), ptr.ToString()));
+    }
   }
 
   // Decompress the block
@@ -500,7 +657,7 @@ Status CFileReader::ReadBlock(const BlockPointer &ptr, CacheControl cache_contro
     // decompress directly into the cache's memory (to avoid a memcpy for NVM).
     ScratchMemory decompressed_scratch;
     if (cache_control == CACHE_BLOCK) {
-      decompressed_scratch.TryAllocateFromCache(cache, key, uncompressed_size);
+      decompressed_scratch.TryAllocateFromCache(cache, key, uncompressed_size, priority);
     } else {
       decompressed_scratch.AllocateFromHeap(uncompressed_size);
     }
@@ -511,13 +668,20 @@ Status CFileReader::ReadBlock(const BlockPointer &ptr, CacheControl cache_contro
       return s;
     }
 
+    // If we read the compressed block into the compressed tier, it has proven
+    // to be valid and can now be cached there.
+    if (use_compressed_tier && scratch.IsFromCache()) {
+      cache->Insert(scratch.mutable_pending_entry(), &compressed_handle);
+      ignore_result(scratch.release());
+    }
+
     // Now that we've decompressed, we don't need to keep holding onto the original
     // scratch buffer. Instead, we have to start holding onto our decompression
     // output buffer.
     scratch.Swap(&decompressed_scratch);
 
     // Set the result block to our decompressed data.
-    block = Slice(buf, uncompressed_size);
+    block = Slice(scratch.get(), uncompressed_size);
   } else {
     // Some of the File implementations from LevelDB attempt to be tricky
     // and just return a Slice into an mmapped region (or in-memory region).
@@ -538,7 +702,7 @@ Status CFileReader::ReadBlock(const BlockPointer &ptr, CacheControl cache_contro
     // if the entry could not be allocated from the block cache.
     // Since we allocate memory to include the key for the cache entry
     // we must reset the block.
-    DCHECK_EQ(block.data(), buf);
+    DCHECK_EQ(block.data(), scratch.get());
     DCHECK(!scratch.IsFromCache());
     *ret = BlockHandle::WithOwnedData(scratch.as_slice());
   }
@@ -550,6 +714,24 @@ Status CFileReader::ReadBlock(const BlockPointer &ptr, CacheControl cache_contro
   return Status::OK();
 }
 
+Status CFileReader::VerifyMappedBlock(const BlockPointer& ptr, Slice* block) const {
+  if (!has_checksums()) {
+    return Status::OK();
+  }
+  if (PREDICT_FALSE(kChecksumSize > block->size())) {
+    return Status::Corruption("invalid data size for block pointer",
+                              ptr.ToString());
+  }
+  Slice checksum(block->data() + block->size() - kChecksumSize, kChecksumSize);
+  block->truncate(block->size() - kChecksumSize);
+  if (FLAGS_cfile_verify_checksums) {
+    RETURN_NOT_OK_PREPEND(VerifyChecksum(ArrayView<const Slice>(block, 1), checksum),
+                          Substitute("checksum error on CFile block $0 at $1",
+                                     block_id().ToString(), ptr.ToString()));
+  }
+  return Status::OK();
+}
+
 Status CFileReader::CountRows(rowid_t *count) const {
   *count = footer().num_values();
   return Status::OK();
@@ -657,14 +839,20 @@ Status DefaultColumnValueIterator::FinishBatch() {
 CFileIterator::CFileIterator(CFileReader* reader,
                              CFileReader::CacheControl cache_control)
   : reader_(reader),
+    all_codewords_match_pred_(false),
+    zone_maps_loaded_(false),
     seeked_(nullptr),
     prepared_(false),
     cache_control_(cache_control),
     last_prepare_idx_(-1),
-    last_prepare_count_(-1) {
+    last_prepare_count_(-1),
+    sequential_blocks_read_(0) {
 }
 
 CFileIterator::~CFileIterator() {
+  if (cache_control_ == CFileReader::DONT_CACHE_BLOCK_OR_PAGES) {
+    readahead_.DropCache(reader_->block());
+  }
 }
 
 Status CFileIterator::SeekToOrdinal(rowid_t ord_idx) {
@@ -822,6 +1010,36 @@ Status CFileIterator::SeekAtOrAfter(const EncodedKey &key,
   return Status::OK();
 }
 
+Status CFileIterator::SeekForwardAtOrAfter(const EncodedKey &key,
+                                           bool *exact_match) {
+  // Only reuse the block of a previous SeekAtOrAfter() call, not one which
+  // was prepared by scanning.
+  if (seeked_ != nullptr && seeked_ == validx_iter_.get() &&
+      !prepared_ && prepared_blocks_.size() == 1) {
+    PreparedBlock *b = prepared_blocks_[0];
+    Status s;
+    if (key.num_key_columns() > 1) {
+      Slice slice = key.encoded_key();
+      s = b->dblk_->SeekAtOrAfterValue(&slice, exact_match);
+    } else {
+      s = b->dblk_->SeekAtOrAfterValue(key.raw_keys()[0], exact_match);
+    }
+    // Since the key is no smaller than the previous one, which was at or
+    // before some value of this block, a value at or after it within the
+    // block is also the first such value in the file. If there's none, the
+    // key is past the end of the block and we need a regular seek.
+    if (s.ok()) {
+      last_prepare_idx_ = b->first_row_idx() + b->dblk_->GetCurrentIndex();
+      last_prepare_count_ = 0;
+      return Status::OK();
+    }
+    if (!s.IsNotFound()) {
+      return s;
+    }
+  }
+  return SeekAtOrAfter(key, exact_match);
+}
+
 Status CFileIterator::PrepareForNewSeek() {
   // Fully open the CFileReader if it was lazily opened earlier.
   //
@@ -844,10 +1062,18 @@ Status CFileIterator::PrepareForNewSeek() {
     BlockPointer bp(reader_->footer().dict_block_ptr());
 
     // Cache the dictionary for performance
-    RETURN_NOT_OK_PREPEND(reader_->ReadBlock(bp, CFileReader::CACHE_BLOCK, &dict_block_handle_),
+    RETURN_NOT_OK_PREPEND(reader_->ReadBlock(bp, CFileReader::CACHE_BLOCK, &dict_block_handle_,
+                                             Cache::HIGH_PRIORITY),
                           "couldn't read dictionary block");
 
-    dict_decoder_.reset(new BinaryPlainBlockDecoder(dict_block_handle_.data()));
+    // The dictionary is a plain block of the column's type.
+    const TypeEncodingInfo* dict_encoding_info;
+    RETURN_NOT_OK(TypeEncodingInfo::Get(reader_->type_info(), PLAIN_ENCODING,
+                                        &dict_encoding_info));
+    BlockDecoder* dict_decoder;
+    RETURN_NOT_OK(dict_encoding_info->CreateBlockDecoder(&dict_decoder,
+                                                         dict_block_handle_.data(), this));
+    dict_decoder_.reset(dict_decoder);
     RETURN_NOT_OK_PREPEND(dict_decoder_->ParseHeader(),
                           Substitute("couldn't parse dictionary block header in block $0 ($1)",
                                      reader_->block_id().ToString(),
@@ -859,7 +1085,83 @@ Status CFileIterator::PrepareForNewSeek() {
     prepared_block_pool_.Destroy(pb);
   }
   prepared_blocks_.clear();
+  sequential_blocks_read_ = 0;
+
+  return Status::OK();
+}
+
+Status CFileIterator::LoadZoneMaps() {
+  if (zone_maps_loaded_) {
+    return Status::OK();
+  }
+  RETURN_NOT_OK(reader_->Init());
+  if (reader_->footer().has_zone_map_block_ptr()) {
+    BlockPointer bp(reader_->footer().zone_map_block_ptr());
+    BlockHandle handle;
+    RETURN_NOT_OK_PREPEND(reader_->ReadBlock(bp, cache_control_, &handle),
+                          "couldn't read zone map block");
+    unique_ptr<ZoneMapsPB> zone_maps(new ZoneMapsPB);
+    RETURN_NOT_OK_PREPEND(pb_util::ParseFromArray(zone_maps.get(), handle.data().data(),
+                                                  handle.data().size()),
+                          Substitute("couldn't parse zone map block in block $0 ($1)",
+                                     reader_->block_id().ToString(), bp.ToString()));
+    zone_maps_ = std::move(zone_maps);
+  }
+  zone_maps_loaded_ = true;
+  return Status::OK();
+}
+
+const BlockZoneMapPB* CFileIterator::FindZoneMap(rowid_t first_ordinal,
+                                                 uint32_t num_rows) const {
+  if (!zone_maps_) {
+    return nullptr;
+  }
+  const auto& blocks = zone_maps_->blocks();
+  auto it = std::lower_bound(blocks.begin(), blocks.end(), first_ordinal,
+                             [](const BlockZoneMapPB& zm, rowid_t ord) {
+                               return zm.first_ordinal() < ord;
+                             });
+  if (it == blocks.end() || it->first_ordinal() != first_ordinal ||
+      it->num_rows() != num_rows) {
+    return nullptr;
+  }
+  return &*it;
+}
+
+Status CFileIterator::RowsMayMatch(rowid_t ord_idx,
+                                   size_t nrows,
+                                   const ColumnPredicate& pred,
+                                   bool* may_match) {
+  *may_match = true;
+  if (!FLAGS_cfile_use_zone_maps || nrows == 0) {
+    return Status::OK();
+  }
+  RETURN_NOT_OK(LoadZoneMaps());
+  if (!zone_maps_) {
+    return Status::OK();
+  }
 
+  // Find the block containing 'ord_idx', then walk through the blocks until
+  // the end of the range. Rows which aren't covered by any zone map may match.
+  const auto& blocks = zone_maps_->blocks();
+  auto it = std::upper_bound(blocks.begin(), blocks.end(), ord_idx,
+                             [](rowid_t ord, const BlockZoneMapPB& zm) {
+                               return ord < zm.first_ordinal();
+                             });
+  if (it == blocks.begin()) {
+    return Status::OK();
+  }
+  --it;
+  const rowid_t end_idx = ord_idx + nrows;
+  rowid_t covered_idx = ord_idx;
+  for (; it != blocks.end() && it->first_ordinal() < end_idx; ++it) {
+    if (it->first_ordinal() > covered_idx ||
+        ZoneMapMayMatch(*it, reader_->type_info(), pred)) {
+      return Status::OK();
+    }
+    covered_idx = it->first_ordinal() + it->num_rows();
+  }
+  *may_match = covered_idx < end_idx;
   return Status::OK();
 }
 
@@ -893,11 +1195,26 @@ Status DecodeNullInfo(Slice *data_block, uint32_t *num_rows_in_block, Slice *nul
 
 Status CFileIterator::ReadCurrentDataBlock(const IndexTreeIterator &idx_iter,
                                            PreparedBlock *prep_block) {
+  // Only read ahead once the scan has gone through a couple of blocks in a
+  // row: a short scan or one seeking around would waste the IO.
+  static const int kMinSequentialBlocksForReadahead = 2;
+  //
+  // Streaming iterators always read ahead, since they are expected to read
+  // the whole file.
+  ReadaheadWindow* readahead = nullptr;
+  if (cache_control_ == CFileReader::DONT_CACHE_BLOCK_OR_PAGES ||
+      (sequential_blocks_read_ >= kMinSequentialBlocksForReadahead &&
+       FLAGS_cfile_readahead_bytes > 0)) {
+    readahead = &readahead_;
+  }
   prep_block->dblk_ptr_ = idx_iter.GetCurrentBlockPointer();
-  RETURN_NOT_OK(reader_->ReadBlock(prep_block->dblk_ptr_, cache_control_, &prep_block->dblk_data_));
+  prep_block->dblk_data_ = std::make_shared<BlockHandle>();
+  RETURN_NOT_OK(reader_->ReadBlock(prep_block->dblk_ptr_, cache_control_,
+                                   prep_block->dblk_data_.get(),
+                                   Cache::NORMAL_PRIORITY, readahead));
 
   uint32_t num_rows_in_block = 0;
-  Slice data_block = prep_block->dblk_data_.data();
+  Slice data_block = prep_block->dblk_data_->data();
   if (reader_->is_nullable()) {
     RETURN_NOT_OK(DecodeNullInfo(&data_block, &num_rows_in_block, &(prep_block->rle_bitmap)));
     prep_block->rle_decoder_ = RleDecoder<bool>(prep_block->rle_bitmap.data(),
@@ -907,6 +1224,15 @@ Status CFileIterator::ReadCurrentDataBlock(const IndexTreeIterator &idx_iter,
   BlockDecoder *bd;
   RETURN_NOT_OK(reader_->type_encoding_info()->CreateBlockDecoder(&bd, data_block, this));
   prep_block->dblk_.reset(bd);
+  // Plain-encoded binary cells are stored contiguously in the block, so
+  // rather than copying each of them into the destination arena, the block
+  // is retained by the arena and the cells point into it.
+  prep_block->references_block_data_ = FLAGS_cfile_zero_copy_binary_scans &&
+      reader_->type_info()->physical_type() == BINARY &&
+      reader_->type_encoding_info()->encoding_type() == PLAIN_ENCODING;
+  if (prep_block->references_block_data_) {
+    down_cast<BinaryPlainBlockDecoder*>(bd)->set_reference_block_data(true);
+  }
   RETURN_NOT_OK_PREPEND(prep_block->dblk_->ParseHeader(),
                         Substitute("unable to decode data block header in block $0 ($1)",
                                    reader_->block_id().ToString(),
@@ -935,6 +1261,7 @@ Status CFileIterator::ReadCurrentDataBlock(const IndexTreeIterator &idx_iter,
 Status CFileIterator::QueueCurrentDataBlock(const IndexTreeIterator &idx_iter) {
   pblock_pool_scoped_ptr b = prepared_block_pool_.make_scoped_ptr(
     prepared_block_pool_.Construct());
+  sequential_blocks_read_++;
   RETURN_NOT_OK(ReadCurrentDataBlock(idx_iter, b.get()));
   prepared_blocks_.push_back(b.release());
   return Status::OK();
@@ -1055,15 +1382,43 @@ Status CFileIterator::Scan(ColumnMaterializationContext* ctx) {
     size_t nwords = dict_decoder_->Count();
     if (nwords > 0) {
       codewords_matching_pred_.reset(new SelectionVector(nwords));
-      codewords_matching_pred_->SetAllFalse();
-      for (size_t i = 0; i < nwords; i++) {
-        Slice cur_string = dict_decoder_->string_at_index(i);
-        if (ctx->pred()->EvaluateCell<BINARY>(static_cast<const void *>(&cur_string))) {
-          BitmapSet(codewords_matching_pred_->mutable_bitmap(), i);
+      if (reader_->type_info()->physical_type() == BINARY) {
+        BinaryPlainBlockDecoder* dict_decoder =
+            down_cast<BinaryPlainBlockDecoder*>(dict_decoder_.get());
+        codewords_matching_pred_->SetAllFalse();
+        for (size_t i = 0; i < nwords; i++) {
+          Slice cur_string = dict_decoder->string_at_index(i);
+          if (ctx->pred()->EvaluateCell<BINARY>(static_cast<const void *>(&cur_string))) {
+            BitmapSet(codewords_matching_pred_->mutable_bitmap(), i);
+          }
         }
+      } else {
+        // Fixed-width dictionaries are small enough to decode whole, and then
+        // evaluate the predicate on in one vectorized pass.
+        std::unique_ptr<uint8_t[]> dict_values(new uint8_t[nwords * reader_->type_info()->size()]);
+        ColumnBlock dict_block(reader_->type_info(), nullptr, dict_values.get(), nwords, nullptr);
+        ColumnDataView dict_view(&dict_block);
+        size_t n = nwords;
+        dict_decoder_->SeekToPositionInBlock(0);
+        RETURN_NOT_OK(dict_decoder_->CopyNextValues(&n, &dict_view));
+        DCHECK_EQ(nwords, n);
+        codewords_matching_pred_->SetAllTrue();
+        ctx->pred()->Evaluate(dict_block, codewords_matching_pred_.get());
       }
+      all_codewords_match_pred_ = codewords_matching_pred_->CountSelected() == nwords;
     }
   }
+  // Zone maps describe the base data, so they can only be used when decoder
+  // evaluation is allowed, i.e. when the rows have no updates.
+  const bool use_zone_maps = FLAGS_cfile_use_zone_maps && ctx->DecoderEvalNotDisabled();
+  if (use_zone_maps) {
+    RETURN_NOT_OK(LoadZoneMaps());
+  }
+  // Columns are only decoded for the rows which are still selected after
+  // evaluating the preceding predicates. This holds for predicate columns too:
+  // evaluating a predicate only ever unselects rows, so it needn't look at the
+  // rows which an earlier predicate already filtered out.
+  const bool late_materialize = FLAGS_cfile_late_materialization && ctx->sel() != nullptr;
   for (PreparedBlock *pb : prepared_blocks_) {
     if (pb->needs_rewind_) {
       // Seek back to the saved position.
@@ -1072,80 +1427,38 @@ Status CFileIterator::Scan(ColumnMaterializationContext* ctx) {
       // that might be more efficient (allowing the decoder to save internal state
       // instead of having to reconstruct it)
     }
-    if (reader_->is_nullable()) {
-      DCHECK(ctx->block()->is_nullable());
-
-      size_t nrows = std::min(rem, pb->num_rows_in_block_ - pb->idx_in_block_);
-      // Fill column bitmap
-      size_t count = nrows;
-      while (count > 0) {
-        bool not_null = false;
-        size_t nblock = pb->rle_decoder_.GetNextRun(&not_null, count);
-        DCHECK_LE(nblock, count);
-        if (PREDICT_FALSE(nblock == 0)) {
-          return Status::Corruption(
-            Substitute("Unexpected EOF on NULL bitmap read. Expected at least $0 more rows",
-                       count));
-        }
-        size_t this_batch = nblock;
-        if (not_null) {
-          if (ctx->DecoderEvalNotDisabled()) {
-            RETURN_NOT_OK(pb->dblk_->CopyNextAndEval(&this_batch,
-                                                     ctx,
-                                                     &remaining_sel,
-                                                     &remaining_dst));
-          } else {
-            RETURN_NOT_OK(pb->dblk_->CopyNextValues(&this_batch, &remaining_dst));
-          }
-          DCHECK_EQ(nblock, this_batch);
-          pb->needs_rewind_ = true;
-        } else {
-#ifndef NDEBUG
-          kudu::OverwriteWithPattern(reinterpret_cast<char *>(remaining_dst.data()),
-                                     remaining_dst.stride() * nblock,
-                                     "NULLNULLNULLNULLNULL");
-#endif
-          if (ctx->DecoderEvalNotDisabled() && !ctx->EvaluatingIsNull()) {
-            remaining_sel.ClearBits(this_batch);
-          }
+    size_t nrows = std::min(rem, pb->num_rows_in_block_ - pb->idx_in_block_);
+    if (use_zone_maps) {
+      const BlockZoneMapPB* zone_map = FindZoneMap(pb->first_row_idx(), pb->num_rows_in_block_);
+      if (zone_map && !ZoneMapMayMatch(*zone_map, reader_->type_info(), *ctx->pred())) {
+        // None of the block's rows can match: skip over them without decoding.
+        remaining_sel.ClearBits(nrows);
+        SkipRowsInBlock(pb, nrows, ctx, &remaining_dst, &remaining_sel);
+        rem -= nrows;
+        if (rem == 0) {
+          break;
         }
-
-        // Set the ColumnBlock bitmap
-        remaining_dst.SetNullBits(this_batch, not_null);
-
-        rem -= this_batch;
-        count -= this_batch;
-        pb->idx_in_block_ += this_batch;
-        remaining_dst.Advance(this_batch);
-        remaining_sel.Advance(this_batch);
+        continue;
       }
+    }
+    // The decoded cells may point into the block: keep it alive for as long
+    // as the destination's arena holds them.
+    if (pb->references_block_data_ && nrows > 0) {
+      Arena* arena = ctx->block()->arena();
+      DCHECK(arena) << "binary columns must be scanned into a block with an arena";
+      arena->RetainUntilReset(pb->dblk_data_);
+    }
+    if (late_materialize) {
+      RETURN_NOT_OK(ScanSelectedRowsInBlock(pb, nrows, ctx, &remaining_dst, &remaining_sel));
     } else {
-      // Fetch as many as we can from the current datablock.
-      size_t this_batch = rem;
-
-      if (ctx->DecoderEvalNotDisabled()) {
-        RETURN_NOT_OK(pb->dblk_->CopyNextAndEval(&this_batch, ctx, &remaining_sel, &remaining_dst));
-      } else {
-        RETURN_NOT_OK(pb->dblk_->CopyNextValues(&this_batch, &remaining_dst));
-      }
-      pb->needs_rewind_ = true;
-      DCHECK_LE(this_batch, rem);
-
-      // If the column is nullable, set all bits to true
-      if (ctx->block()->is_nullable()) {
-        remaining_dst.SetNullBits(this_batch, true);
-      }
-
-      rem -= this_batch;
-      pb->idx_in_block_ += this_batch;
-      remaining_dst.Advance(this_batch);
-      remaining_sel.Advance(this_batch);
+      RETURN_NOT_OK(ScanRowsInBlock(pb, nrows, ctx, &remaining_dst, &remaining_sel));
     }
+    rem -= nrows;
 
     // If we didn't fetch as many as requested, then it should
     // be because the current data block ran out.
     if (rem > 0) {
-      DCHECK_EQ(pb->dblk_->Count(), pb->dblk_->GetCurrentIndex()) <<
+      DCHECK_EQ(pb->num_rows_in_block_, pb->idx_in_block_) <<
         "dblk stopped yielding values before it was empty.";
     } else {
       break;
@@ -1156,6 +1469,128 @@ Status CFileIterator::Scan(ColumnMaterializationContext* ctx) {
   return Status::OK();
 }
 
+Status CFileIterator::ScanRowsInBlock(PreparedBlock* pb, size_t nrows,
+                                      ColumnMaterializationContext* ctx,
+                                      ColumnDataView* dst, SelectionVectorView* sel) {
+  DCHECK_LE(nrows, pb->num_rows_in_block_ - pb->idx_in_block_);
+  if (nrows == 0) {
+    return Status::OK();
+  }
+  if (reader_->is_nullable()) {
+    DCHECK(ctx->block()->is_nullable());
+
+    // Fill column bitmap
+    size_t count = nrows;
+    while (count > 0) {
+      bool not_null = false;
+      size_t nblock = pb->rle_decoder_.GetNextRun(&not_null, count);
+      DCHECK_LE(nblock, count);
+      if (PREDICT_FALSE(nblock == 0)) {
+        return Status::Corruption(
+          Substitute("Unexpected EOF on NULL bitmap read. Expected at least $0 more rows",
+                     count));
+      }
+      size_t this_batch = nblock;
+      if (not_null) {
+        if (ctx->DecoderEvalNotDisabled()) {
+          RETURN_NOT_OK(pb->dblk_->CopyNextAndEval(&this_batch, ctx, sel, dst));
+        } else {
+          RETURN_NOT_OK(pb->dblk_->CopyNextValues(&this_batch, dst));
+        }
+        DCHECK_EQ(nblock, this_batch);
+        pb->needs_rewind_ = true;
+      } else {
+#ifndef NDEBUG
+        kudu::OverwriteWithPattern(reinterpret_cast<char *>(dst->data()),
+                                   dst->stride() * nblock,
+                                   "NULLNULLNULLNULLNULL");
+#endif
+        if (ctx->DecoderEvalNotDisabled() && !ctx->EvaluatingIsNull()) {
+          sel->ClearBits(this_batch);
+        }
+      }
+
+      // Set the ColumnBlock bitmap
+      dst->SetNullBits(this_batch, not_null);
+
+      count -= this_batch;
+      pb->idx_in_block_ += this_batch;
+      dst->Advance(this_batch);
+      sel->Advance(this_batch);
+    }
+  } else {
+    size_t this_batch = nrows;
+
+    if (ctx->DecoderEvalNotDisabled()) {
+      RETURN_NOT_OK(pb->dblk_->CopyNextAndEval(&this_batch, ctx, sel, dst));
+    } else {
+      RETURN_NOT_OK(pb->dblk_->CopyNextValues(&this_batch, dst));
+    }
+    pb->needs_rewind_ = true;
+    DCHECK_EQ(nrows, this_batch);
+
+    // If the column is nullable, set all bits to true
+    if (ctx->block()->is_nullable()) {
+      dst->SetNullBits(this_batch, true);
+    }
+
+    pb->idx_in_block_ += this_batch;
+    dst->Advance(this_batch);
+    sel->Advance(this_batch);
+  }
+  return Status::OK();
+}
+
+Status CFileIterator::ScanSelectedRowsInBlock(PreparedBlock* pb, size_t nrows,
+                                              ColumnMaterializationContext* ctx,
+                                              ColumnDataView* dst, SelectionVectorView* sel) {
+  // Seeking costs about as much as decoding a handful of values, so shorter
+  // runs of unselected rows are decoded along with their neighbors.
+  static const size_t kMinSkippedRun = 16;
+
+  while (nrows > 0) {
+    size_t first_selected = sel->FindFirst(0, nrows, true);
+    if (first_selected > 0) {
+      SkipRowsInBlock(pb, first_selected, ctx, dst, sel);
+      nrows -= first_selected;
+      continue;
+    }
+
+    // Decode up to the next run of unselected rows that's worth skipping.
+    size_t to_decode = nrows;
+    size_t run_start = sel->FindFirst(0, nrows, false);
+    while (run_start < nrows) {
+      size_t run_end = sel->FindFirst(run_start, nrows, true);
+      if (run_end == nrows || run_end - run_start >= kMinSkippedRun) {
+        to_decode = run_start;
+        break;
+      }
+      run_start = sel->FindFirst(run_end, nrows, false);
+    }
+    RETURN_NOT_OK(ScanRowsInBlock(pb, to_decode, ctx, dst, sel));
+    nrows -= to_decode;
+  }
+  return Status::OK();
+}
+
+void CFileIterator::SkipRowsInBlock(PreparedBlock* pb, size_t nrows,
+                                    ColumnMaterializationContext* ctx,
+                                    ColumnDataView* dst, SelectionVectorView* sel) {
+  DCHECK_LE(nrows, pb->num_rows_in_block_ - pb->idx_in_block_);
+  if (ctx->block()->is_nullable()) {
+    dst->SetNullBits(nrows, false);
+  }
+#ifndef NDEBUG
+  kudu::OverwriteWithPattern(reinterpret_cast<char *>(dst->data()),
+                             dst->stride() * nrows,
+                             "SKIPPEDSKIPPEDSKIPPED");
+#endif
+  SeekToPositionInBlock(pb, pb->idx_in_block_ + nrows);
+  pb->needs_rewind_ = true;
+  dst->Advance(nrows);
+  sel->Advance(nrows);
+}
+
 Status CFileIterator::CopyNextValues(size_t* n, ColumnMaterializationContext* ctx) {
   RETURN_NOT_OK(PrepareBatch(n));
   RETURN_NOT_OK(Scan(ctx));
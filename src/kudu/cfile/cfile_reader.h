@@ -37,6 +37,8 @@
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/port.h"
+#include "kudu/util/array_view.h"
+#include "kudu/util/cache.h"
 #include "kudu/util/compression/compression.pb.h"
 #include "kudu/util/faststring.h"
 #include "kudu/util/mem_tracker.h"
@@ -48,22 +50,49 @@
 
 namespace kudu {
 
+class ColumnDataView;
 class ColumnMaterializationContext;
+class ColumnPredicate;
 class CompressionCodec;
 class EncodedKey;
 class SelectionVector;
+class SelectionVectorView;
 class TypeInfo;
 
 template <typename T> class ArrayView;
 
 namespace cfile {
 
-class BinaryPlainBlockDecoder;
 class CFileIterator;
 class IndexTreeIterator;
 class TypeEncodingInfo;
 struct ReaderOptions;
 
+// The range of a CFile which the OS was last advised to read ahead into its
+// page cache, ahead of a sequential scan, so that the blocks within the range
+// can be read without waiting for further IO. The data read ahead isn't held
+// by the scan, but by the page cache, whose memory the OS may reclaim.
+class ReadaheadWindow {
+ public:
+  ReadaheadWindow() : offset_(0), size_(0) {}
+
+  // Returns whether the 'size' bytes at 'offset' are within the window.
+  bool Contains(uint64_t offset, size_t size) const;
+
+  // Moves the window to the 'size' bytes of 'block' starting at 'offset',
+  // and advises the OS to read them into its page cache in the background.
+  Status Prefetch(const fs::ReadableBlock& block, uint64_t offset, size_t size);
+
+  // Drops the window of 'block' from the OS page cache.
+  void DropCache(const fs::ReadableBlock& block) const;
+
+ private:
+  uint64_t offset_;
+  size_t size_;
+
+  DISALLOW_COPY_AND_ASSIGN(ReadaheadWindow);
+};
+
 class CFileReader {
  public:
   // Fully open a cfile using a previously opened block.
@@ -83,6 +112,8 @@ class CFileReader {
                            ReaderOptions options,
                            std::unique_ptr<CFileReader>* reader);
 
+  ~CFileReader();
+
   // Fully opens a previously lazily opened cfile, parsing and validating
   // its contents.
   //
@@ -91,7 +122,13 @@ class CFileReader {
 
   enum CacheControl {
     CACHE_BLOCK,
-    DONT_CACHE_BLOCK
+    DONT_CACHE_BLOCK,
+    // Like DONT_CACHE_BLOCK, and drops what was read from the OS page cache
+    // too. Iterators have the OS read ahead by
+    // --cfile_stream_readahead_bytes. For
+    // reading files through once which aren't to be read again, e.g. the
+    // inputs of compactions.
+    DONT_CACHE_BLOCK_OR_PAGES
   };
 
   // Can be called before Init().
@@ -106,8 +143,17 @@ class CFileReader {
 
   // TODO: make this private? should only be used
   // by the iterator and index tree readers, I think.
+  //
+  // If the block is cached, it is cached with the given 'priority'.
+  //
+  // If 'readahead' is non-NULL, the block is not in the cache and it isn't
+  // within 'readahead' already, 'readahead' is first moved to the
+  // --cfile_readahead_bytes bytes of the file starting at the block
+  // (--cfile_stream_readahead_bytes for DONT_CACHE_BLOCK_OR_PAGES).
   Status ReadBlock(const BlockPointer &ptr, CacheControl cache_control,
-                   BlockHandle *ret) const;
+                   BlockHandle *ret,
+                   Cache::Priority priority = Cache::NORMAL_PRIORITY,
+                   ReadaheadWindow* readahead = nullptr) const;
 
   // Return the number of rows in this cfile.
   // This is assumed to be reasonably fast (i.e does not scan
@@ -131,6 +177,11 @@ class CFileReader {
     return block_->id();
   }
 
+  // Can be called before Init().
+  const fs::ReadableBlock& block() const {
+    return *block_;
+  }
+
   const TypeInfo *type_info() const {
     DCHECK(init_once_.init_succeeded());
     return type_info_;
@@ -197,6 +248,10 @@ class CFileReader {
   Status ReadAndParseFooter();
   Status VerifyChecksum(ArrayView<const Slice> data, const Slice& checksum) const;
 
+  // Strips the checksum off 'block', the mapped bytes of the block at 'ptr',
+  // and verifies it if --cfile_verify_checksums is set.
+  Status VerifyMappedBlock(const BlockPointer& ptr, Slice* block) const;
+
   // Returns the memory usage of the object including the object itself.
   size_t memory_footprint() const;
 
@@ -211,6 +266,9 @@ class CFileReader {
   gscoped_ptr<CFileHeaderPB> header_;
   gscoped_ptr<CFileFooterPB> footer_;
   const CompressionCodec* codec_;
+  // Set if the blocks are compressed with a ZSTD dictionary. 'codec_' then
+  // points to this codec.
+  std::unique_ptr<CompressionCodec> zstd_dictionary_codec_;
   const TypeInfo *type_info_;
   const TypeEncodingInfo *type_encoding_info_;
 
@@ -272,6 +330,20 @@ class ColumnIterator {
   // batch left off.
   virtual Status FinishBatch() = 0;
 
+  // Sets '*may_match' to false if it's certain that none of the 'nrows' rows
+  // starting at ordinal 'ord_idx' satisfy 'pred', e.g. because of the zone
+  // maps of the underlying file. Otherwise sets it to true.
+  //
+  // This doesn't account for any updates to the rows, and does not require
+  // the iterator to be seeked or prepared.
+  virtual Status RowsMayMatch(rowid_t /* ord_idx */,
+                              size_t /* nrows */,
+                              const ColumnPredicate& /* pred */,
+                              bool* may_match) {
+    *may_match = true;
+    return Status::OK();
+  }
+
   virtual const IteratorStats& io_statistics() const = 0;
 };
 
@@ -339,6 +411,16 @@ class CFileIterator : public ColumnIterator {
   Status SeekAtOrAfter(const EncodedKey &encoded_key,
                        bool *exact_match);
 
+  // Like SeekAtOrAfter(), for a caller which seeks to a series of keys in
+  // increasing order, such as a batch of sorted presence checks.
+  //
+  // 'encoded_key' must be no smaller than the key of the previous seek. If it
+  // falls within the data block the iterator is already positioned in, the
+  // seek is done within that block, without consulting the value index or
+  // reading and decoding the block again.
+  Status SeekForwardAtOrAfter(const EncodedKey &encoded_key,
+                              bool *exact_match);
+
   // Return true if this reader is currently seeked.
   // If the iterator is not seeked, it is an error to call any functions except
   // for seek (including GetCurrentOrdinal).
@@ -375,6 +457,12 @@ class CFileIterator : public ColumnIterator {
   // batch left off.
   Status FinishBatch() OVERRIDE;
 
+  // Uses the file's zone maps, if it has any.
+  Status RowsMayMatch(rowid_t ord_idx,
+                      size_t nrows,
+                      const ColumnPredicate& pred,
+                      bool* may_match) override;
+
   // Return true if the next call to PrepareBatch will return at least one row.
   bool HasNext() const;
 
@@ -385,26 +473,35 @@ class CFileIterator : public ColumnIterator {
     return io_stats_;
   }
 
-  // If the column is dictionary-coded, returns the decoder
-  // for the cfile's dictionary block. This is called by the
-  // BinaryDictBlockDecoder.
-  BinaryPlainBlockDecoder* GetDictDecoder() { return dict_decoder_.get(); }
+  // If the column is dictionary-coded, returns the decoder for the cfile's
+  // dictionary block: a plain decoder for the column's type. This is called
+  // by the BinaryDictBlockDecoder and DictBlockDecoder.
+  BlockDecoder* GetDictDecoder() { return dict_decoder_.get(); }
 
   // If the column is dictionary-coded and a predicate on the column exists,
   // returns the set of codewords that pass the predicate. Since a vocabulary
-  // is shared among the multiple BinaryDictBlockDecoders in a single cfile,
+  // is shared among the multiple dictionary decoders in a single cfile,
   // the reader must expose an interface for all decoders to access the
   // single set of predicate-satisfying codewords.
   SelectionVector* GetCodeWordsMatchingPredicate() { return codewords_matching_pred_.get(); }
 
+  // Returns true if every codeword in the dictionary passes the predicate, in
+  // which case the decoders needn't check the codewords of individual rows.
+  bool AllCodeWordsMatchPredicate() const { return all_codewords_match_pred_; }
+
  private:
   DISALLOW_COPY_AND_ASSIGN(CFileIterator);
 
   struct PreparedBlock {
     BlockPointer dblk_ptr_;
-    BlockHandle dblk_data_;
+    // Shared so that the block can be retained by the arena of a scan's
+    // destination when decoded cells point into it.
+    std::shared_ptr<BlockHandle> dblk_data_;
     gscoped_ptr<BlockDecoder> dblk_;
 
+    // Whether 'dblk_' decodes cells which point into 'dblk_data_'.
+    bool references_block_data_;
+
     // The rowid of the first row in this block.
     rowid_t first_row_idx() const {
       return dblk_->GetFirstRowId();
@@ -443,6 +540,25 @@ class CFileIterator : public ColumnIterator {
   // Seek the given PreparedBlock to the given index within it.
   void SeekToPositionInBlock(PreparedBlock *pb, uint32_t idx_in_block);
 
+  // Decodes the next 'nrows' rows of 'pb' into 'dst', evaluating the context's
+  // predicate if decoder-level evaluation is enabled. The rows must all belong
+  // to 'pb'. Advances both views past the rows.
+  Status ScanRowsInBlock(PreparedBlock* pb, size_t nrows,
+                         ColumnMaterializationContext* ctx,
+                         ColumnDataView* dst, SelectionVectorView* sel);
+
+  // Like ScanRowsInBlock(), but only decodes the rows which are selected in
+  // 'sel', seeking over sufficiently long runs of unselected rows. The cells
+  // of skipped rows are left unspecified (and NULL, if the column is nullable).
+  Status ScanSelectedRowsInBlock(PreparedBlock* pb, size_t nrows,
+                                 ColumnMaterializationContext* ctx,
+                                 ColumnDataView* dst, SelectionVectorView* sel);
+
+  // Moves 'pb' and both views past the next 'nrows' rows without decoding them.
+  void SkipRowsInBlock(PreparedBlock* pb, size_t nrows,
+                       ColumnMaterializationContext* ctx,
+                       ColumnDataView* dst, SelectionVectorView* sel);
+
   // Read the data block currently pointed to by idx_iter_
   // into the given PreparedBlock structure.
   //
@@ -452,24 +568,43 @@ class CFileIterator : public ColumnIterator {
 
   // Read the data block currently pointed to by idx_iter_, and enqueue
   // it onto the end of the prepared_blocks_ deque.
+  //
+  // This is used when scanning forward from block to block, so it counts
+  // towards starting readahead.
   Status QueueCurrentDataBlock(const IndexTreeIterator &idx_iter);
 
   // Fully initialize the underlying cfile reader if needed, and clear any
   // seek-related state.
   Status PrepareForNewSeek();
 
+  // Reads the file's zone maps into 'zone_maps_', if they haven't been read
+  // yet and the file has them.
+  Status LoadZoneMaps();
+
+  // Returns the zone map of the data block starting at 'first_ordinal' and
+  // holding 'num_rows' rows, or nullptr if there isn't one.
+  const BlockZoneMapPB* FindZoneMap(rowid_t first_ordinal, uint32_t num_rows) const;
+
   CFileReader* reader_;
 
   gscoped_ptr<IndexTreeIterator> posidx_iter_;
   gscoped_ptr<IndexTreeIterator> validx_iter_;
 
   // Decoder for the dictionary block.
-  gscoped_ptr<BinaryPlainBlockDecoder> dict_decoder_;
+  gscoped_ptr<BlockDecoder> dict_decoder_;
   BlockHandle dict_block_handle_;
 
   // Set containing the codewords that match the predicate in a dictionary.
   std::unique_ptr<SelectionVector> codewords_matching_pred_;
 
+  // Whether all of the codewords in 'codewords_matching_pred_' are set.
+  bool all_codewords_match_pred_;
+
+  // The zone maps of the file's data blocks. Null if the file has none, or
+  // they haven't been loaded yet.
+  std::unique_ptr<ZoneMapsPB> zone_maps_;
+  bool zone_maps_loaded_;
+
   // The currently in-use index iterator. This is equal to either
   // posidx_iter_.get(), validx_iter_.get(), or NULL if not seeked.
   IndexTreeIterator *seeked_;
@@ -500,6 +635,12 @@ class CFileIterator : public ColumnIterator {
 
   // a temporary buffer for encoding
   faststring tmp_buf_;
+
+  // The number of data blocks read one after the other since the last seek.
+  // Past a couple of them, the scan is deemed sequential and reads ahead
+  // through 'readahead_'.
+  int sequential_blocks_read_;
+  ReadaheadWindow readahead_;
 };
 
 } // namespace cfile
@@ -41,7 +41,13 @@ enum IncompatibleFeatures {
   // Write a crc32 checksum at the end of each cfile block
   CHECKSUM = 1 << 0,
 
-  SUPPORTED = NONE | CHECKSUM
+  // Blocks may be compressed with the ZSTD dictionary stored in the footer
+  ZSTD_DICTIONARY = 1 << 1,
+
+  // Index blocks may store prefix-compressed keys
+  PREFIX_INDEX_BLOCKS = 1 << 2,
+
+  SUPPORTED = NONE | CHECKSUM | ZSTD_DICTIONARY | PREFIX_INDEX_BLOCKS
 };
 
 struct WriterOptions {
@@ -59,12 +65,32 @@ struct WriterOptions {
   // Default: 16
   int block_restart_interval;
 
+  // Number of keys between restart points for prefix compression of the
+  // keys in index blocks. If zero, index keys are stored in full.
+  //
+  // Default: 16
+  int index_block_restart_interval;
+
   // Whether the file needs a positional index.
   bool write_posidx;
 
   // Whether the file needs a value index
   bool write_validx;
 
+  // Whether to write a zone map (min/max cells and NULL count) for each data
+  // block, allowing readers to skip blocks which can't match a predicate.
+  bool write_zone_map;
+
+  // Whether to write statistics about all of the cells of the file (NULL
+  // count, min/max cells, average value size and a distinct values sketch)
+  // into its footer.
+  bool write_statistics;
+
+  // Whether to pick the encoding of a column whose storage attributes ask
+  // for AUTO_ENCODING by trial encoding a sample of its first cells, rather
+  // than using the type's default encoding.
+  bool adaptive_encoding;
+
   // Whether to optimize index keys by storing shortest separating prefixes
   // instead of entire keys.
   bool optimize_index_keys;
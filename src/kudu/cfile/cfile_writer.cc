@@ -17,6 +17,7 @@
 
 #include "kudu/cfile/cfile_writer.h"
 
+#include <algorithm>
 #include <numeric>
 #include <ostream>
 #include <utility>
@@ -29,8 +30,10 @@
 #include "kudu/cfile/block_pointer.h"
 #include "kudu/cfile/cfile.pb.h"
 #include "kudu/cfile/cfile_util.h"
+#include "kudu/cfile/column_statistics.h"
 #include "kudu/cfile/index_btree.h"
 #include "kudu/cfile/type_encodings.h"
+#include "kudu/cfile/zone_map.h"
 #include "kudu/common/common.pb.h"
 #include "kudu/common/key_encoder.h"
 #include "kudu/common/schema.h"
@@ -45,6 +48,7 @@
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/hexdump.h"
 #include "kudu/util/logging.h"
+#include "kudu/util/memory/arena.h"
 #include "kudu/util/pb_util.h"
 
 DEFINE_int32(cfile_default_block_size, 256*1024, "The default block size to use in cfiles");
@@ -54,10 +58,70 @@ DEFINE_string(cfile_default_compression_codec, "none",
               "Default cfile block compression codec.");
 TAG_FLAG(cfile_default_compression_codec, advanced);
 
+DEFINE_int32(cfile_zstd_compression_level, 3,
+             "Compression level to use for cfiles compressed with ZSTD. Higher "
+             "levels compress better but are slower to write; read speed is "
+             "largely unaffected.");
+TAG_FLAG(cfile_zstd_compression_level, experimental);
+
+DEFINE_int32(cfile_zstd_dictionary_size, 0,
+             "If non-zero, ZSTD-compressed cfiles train a dictionary of up to this "
+             "many bytes from their first blocks, store it in the cfile footer, and "
+             "compress the remaining blocks with it. This helps small blocks, which "
+             "otherwise compress poorly. If zero, no dictionary is used.");
+TAG_FLAG(cfile_zstd_dictionary_size, experimental);
+
+DEFINE_int32(cfile_zstd_dictionary_training_bytes, 1024 * 1024,
+             "Amount of uncompressed block data to sample from each cfile before "
+             "training its ZSTD dictionary. Only relevant when "
+             "--cfile_zstd_dictionary_size is non-zero.");
+TAG_FLAG(cfile_zstd_dictionary_training_bytes, experimental);
+
 DEFINE_bool(cfile_write_checksums, true,
             "Write CRC32 checksums for each block");
 TAG_FLAG(cfile_write_checksums, evolving);
 
+DEFINE_bool(cfile_write_zone_maps, true,
+            "Write per-block zone maps (min/max values and NULL counts) into cfiles "
+            "configured to have them, allowing scans to skip blocks which can't "
+            "match their predicates");
+TAG_FLAG(cfile_write_zone_maps, evolving);
+
+DEFINE_bool(cfile_write_statistics, true,
+            "Write column statistics (NULL count, min/max values, average value "
+            "size and a sketch of the number of distinct values) into the footers "
+            "of cfiles configured to have them, for use by query planners");
+TAG_FLAG(cfile_write_statistics, evolving);
+
+DEFINE_bool(cfile_prefix_compress_index_blocks, true,
+            "Whether to prefix-compress the keys in cfile index blocks. This "
+            "makes index blocks of files with long, similar keys (e.g. composite "
+            "primary keys) considerably smaller. Files written with this enabled "
+            "cannot be read by versions which do not support it.");
+TAG_FLAG(cfile_prefix_compress_index_blocks, evolving);
+
+DEFINE_bool(cfile_adaptive_encoding, true,
+            "Pick the encoding of column cfiles which don't specify one by trial "
+            "encoding a sample of their first cells with each of the encodings "
+            "supported by the column's type, instead of always using the type's "
+            "default encoding. Columns without an explicit compression codec may "
+            "also end up uncompressed if compression doesn't pay off on the sample.");
+TAG_FLAG(cfile_adaptive_encoding, evolving);
+
+DEFINE_int32(cfile_adaptive_encoding_sample_bytes, 256 * 1024,
+             "Amount of cell data to sample from each cfile before picking its "
+             "encoding. Only relevant when --cfile_adaptive_encoding is enabled.");
+TAG_FLAG(cfile_adaptive_encoding_sample_bytes, experimental);
+
+DEFINE_double(cfile_adaptive_encoding_min_saving, 0.1,
+              "Fraction of the sampled data's size which an encoding must save over "
+              "the type's default encoding to be picked instead of it, and which "
+              "compression must save for a cfile to be compressed. The defaults "
+              "decode fastest, so they're kept unless the alternative is "
+              "substantially smaller. Only relevant when --cfile_adaptive_encoding "
+              "is enabled.");
+TAG_FLAG(cfile_adaptive_encoding_min_saving, experimental);
+
 using google::protobuf::RepeatedPtrField;
 using kudu::fs::BlockCreationTransaction;
 using kudu::fs::BlockManager;
@@ -78,6 +142,22 @@ const size_t kChecksumSize = sizeof(uint32_t);
 
 static const size_t kMinBlockSize = 512;
 
+// The dictionary trainer works best with many small samples, so sampled
+// blocks are split into pieces of this size.
+static const size_t kZstdDictionarySampleSize = 4096;
+
+// The encodings tried when picking the encoding of a file adaptively, on top
+// of the default encoding for its type. Those not supported by the type are
+// skipped.
+static const EncodingType kAdaptiveEncodingCandidates[] = {
+  PLAIN_ENCODING,
+  PREFIX_ENCODING,
+  RLE,
+  DICT_ENCODING,
+  BIT_SHUFFLE,
+  FRAME_OF_REFERENCE
+};
+
 static CompressionType GetDefaultCompressionCodec() {
   return GetCompressionCodecType(FLAGS_cfile_default_compression_codec);
 }
@@ -88,8 +168,12 @@ static CompressionType GetDefaultCompressionCodec() {
 WriterOptions::WriterOptions()
   : index_block_size(32*1024),
     block_restart_interval(16),
+    index_block_restart_interval(16),
     write_posidx(false),
     write_validx(false),
+    write_zone_map(false),
+    write_statistics(false),
+    adaptive_encoding(false),
     optimize_index_keys(true) {
 }
 
@@ -110,6 +194,11 @@ CFileWriter::CFileWriter(const WriterOptions &options,
     is_nullable_(is_nullable),
     typeinfo_(typeinfo),
     key_encoder_(nullptr),
+    sampling_for_zstd_dictionary_(false),
+    sampling_for_encoding_(false),
+    adaptive_compression_(false),
+    encoding_sample_rows_(0),
+    encoding_sample_bytes_(0),
     state_(kWriterInitialized) {
   EncodingType encoding = options_.storage_attributes.encoding;
   Status s = TypeEncodingInfo::Get(typeinfo_, encoding, &type_encoding_info_);
@@ -128,6 +217,13 @@ CFileWriter::CFileWriter(const WriterOptions &options,
     compression_ = GetDefaultCompressionCodec();
   }
 
+  if (options_.adaptive_encoding && FLAGS_cfile_adaptive_encoding &&
+      options_.storage_attributes.encoding == AUTO_ENCODING &&
+      FLAGS_cfile_adaptive_encoding_sample_bytes > 0) {
+    sampling_for_encoding_ = true;
+    adaptive_compression_ = options_.storage_attributes.compression == DEFAULT_COMPRESSION;
+  }
+
   if (options_.storage_attributes.cfile_block_size <= 0) {
     options_.storage_attributes.cfile_block_size = FLAGS_cfile_default_block_size;
   }
@@ -138,6 +234,10 @@ CFileWriter::CFileWriter(const WriterOptions &options,
     options_.storage_attributes.cfile_block_size = kMinBlockSize;
   }
 
+  if (!FLAGS_cfile_prefix_compress_index_blocks) {
+    options_.index_block_restart_interval = 0;
+  }
+
   if (options.write_posidx) {
     posidx_builder_.reset(new IndexTreeBuilder(&options_, this));
   }
@@ -146,6 +246,15 @@ CFileWriter::CFileWriter(const WriterOptions &options,
     key_encoder_ = &GetKeyEncoder<faststring>(typeinfo_);
     validx_builder_.reset(new IndexTreeBuilder(&options_, this));
   }
+
+  if (options.write_zone_map && FLAGS_cfile_write_zone_maps) {
+    zone_map_builder_.reset(new ZoneMapBuilder(typeinfo_));
+    zone_maps_.reset(new ZoneMapsPB);
+  }
+
+  if (options.write_statistics && FLAGS_cfile_write_statistics) {
+    statistics_builder_.reset(new ColumnStatisticsBuilder(typeinfo_));
+  }
 }
 
 CFileWriter::~CFileWriter() {
@@ -158,8 +267,11 @@ Status CFileWriter::Start() {
 
   if (compression_ != NO_COMPRESSION) {
     const CompressionCodec* codec;
-    RETURN_NOT_OK(GetCompressionCodec(compression_, &codec));
+    RETURN_NOT_OK(GetCompressionCodec(compression_, FLAGS_cfile_zstd_compression_level,
+                                      &codec));
     block_compressor_ .reset(new CompressedBlockBuilder(codec));
+    sampling_for_zstd_dictionary_ =
+        compression_ == ZSTD && FLAGS_cfile_zstd_dictionary_size > 0;
   }
 
   CFileHeaderPB header;
@@ -215,6 +327,11 @@ Status CFileWriter::FinishAndReleaseBlock(BlockCreationTransaction* transaction)
   CHECK(state_ == kWriterWriting) <<
     "Bad state for Finish(): " << state_;
 
+  // Files smaller than the sample pick their encoding from all of their cells.
+  if (sampling_for_encoding_) {
+    RETURN_NOT_OK(FinishEncodingSample());
+  }
+
   // Write out any pending values as the last data block.
   RETURN_NOT_OK(FinishCurDataBlock());
 
@@ -224,6 +341,12 @@ Status CFileWriter::FinishAndReleaseBlock(BlockCreationTransaction* transaction)
   if (FLAGS_cfile_write_checksums) {
     incompatible_features |= IncompatibleFeatures::CHECKSUM;
   }
+  if (zstd_dictionary_codec_) {
+    incompatible_features |= IncompatibleFeatures::ZSTD_DICTIONARY;
+  }
+  if ((posidx_builder_ || validx_builder_) && options_.index_block_restart_interval > 0) {
+    incompatible_features |= IncompatibleFeatures::PREFIX_INDEX_BLOCKS;
+  }
 
   // Start preparing the footer.
   CFileFooterPB footer;
@@ -233,6 +356,12 @@ Status CFileWriter::FinishAndReleaseBlock(BlockCreationTransaction* transaction)
   footer.set_num_values(value_count_);
   footer.set_compression(compression_);
   footer.set_incompatible_features(incompatible_features);
+  if (zstd_dictionary_codec_) {
+    footer.set_zstd_dictionary(zstd_dictionary_);
+  }
+  if (statistics_builder_) {
+    statistics_builder_->Finish(footer.mutable_statistics());
+  }
 
   // Write out any pending positional index blocks.
   if (options_.write_posidx) {
@@ -252,6 +381,15 @@ Status CFileWriter::FinishAndReleaseBlock(BlockCreationTransaction* transaction)
   // Example: dictionary block for dictionary encoding
   RETURN_NOT_OK(data_block_->AppendExtraInfo(this, &footer));
 
+  if (zone_maps_ && zone_maps_->blocks_size() > 0) {
+    faststring zone_maps_str;
+    pb_util::SerializeToString(*zone_maps_, &zone_maps_str);
+    BlockPointer ptr;
+    RETURN_NOT_OK_PREPEND(AddBlock({ Slice(zone_maps_str) }, &ptr, "zone map block"),
+                          "Couldn't write zone maps");
+    ptr.CopyToPB(footer.mutable_zone_map_block_ptr());
+  }
+
   // Flush metadata.
   FlushMetadataToPB(footer.mutable_metadata());
 
@@ -307,6 +445,9 @@ void CFileWriter::FlushMetadataToPB(RepeatedPtrField<FileMetadataPairPB> *field)
 
 Status CFileWriter::AppendEntries(const void *entries, size_t count) {
   DCHECK(!is_nullable_);
+  if (PREDICT_FALSE(sampling_for_encoding_)) {
+    return AddToEncodingSample(nullptr, entries, count);
+  }
 
   int rem = count;
 
@@ -315,6 +456,12 @@ Status CFileWriter::AppendEntries(const void *entries, size_t count) {
   while (rem > 0) {
     int n = data_block_->Add(ptr, rem);
     DCHECK_GE(n, 0);
+    if (zone_map_builder_) {
+      zone_map_builder_->AddCells(ptr, n);
+    }
+    if (statistics_builder_) {
+      statistics_builder_->AddCells(ptr, n);
+    }
 
     ptr += typeinfo_->size() * n;
     rem -= n;
@@ -333,6 +480,9 @@ Status CFileWriter::AppendNullableEntries(const uint8_t *bitmap,
                                           const void *entries,
                                           size_t count) {
   DCHECK(is_nullable_ && bitmap != nullptr);
+  if (PREDICT_FALSE(sampling_for_encoding_)) {
+    return AddToEncodingSample(bitmap, entries, count);
+  }
 
   const uint8_t *ptr = reinterpret_cast<const uint8_t *>(entries);
 
@@ -345,6 +495,12 @@ Status CFileWriter::AppendNullableEntries(const uint8_t *bitmap,
       do {
         int n = data_block_->Add(ptr, rem);
         DCHECK_GE(n, 0);
+        if (zone_map_builder_) {
+          zone_map_builder_->AddCells(ptr, n);
+        }
+        if (statistics_builder_) {
+          statistics_builder_->AddCells(ptr, n);
+        }
 
         null_bitmap_builder_->AddRun(true, n);
         ptr += n * typeinfo_->size();
@@ -358,6 +514,12 @@ Status CFileWriter::AppendNullableEntries(const uint8_t *bitmap,
       } while (rem > 0);
     } else {
       null_bitmap_builder_->AddRun(false, nblock);
+      if (zone_map_builder_) {
+        zone_map_builder_->AddNulls(nblock);
+      }
+      if (statistics_builder_) {
+        statistics_builder_->AddNulls(nblock);
+      }
       ptr += nblock * typeinfo_->size();
       value_count_ += nblock;
     }
@@ -366,6 +528,169 @@ Status CFileWriter::AppendNullableEntries(const uint8_t *bitmap,
   return Status::OK();
 }
 
+Status CFileWriter::AddToEncodingSample(const uint8_t* bitmap,
+                                        const void* entries,
+                                        size_t count) {
+  const size_t size = typeinfo_->size();
+  const uint8_t* ptr = reinterpret_cast<const uint8_t*>(entries);
+  if (bitmap != nullptr) {
+    encoding_sample_null_bitmap_.resize(BitmapSize(encoding_sample_rows_ + count));
+    for (size_t i = 0; i < count; i++) {
+      BitmapChange(encoding_sample_null_bitmap_.data(), encoding_sample_rows_ + i,
+                   BitmapTest(bitmap, i));
+    }
+  }
+
+  if (typeinfo_->physical_type() == BINARY) {
+    // The cells only point to the data, which must be copied.
+    if (!encoding_sample_arena_) {
+      encoding_sample_arena_.reset(new Arena(32 * 1024));
+    }
+    for (size_t i = 0; i < count; i++) {
+      Slice copy;
+      if (bitmap == nullptr || BitmapTest(bitmap, i)) {
+        const Slice* cell = reinterpret_cast<const Slice*>(ptr + i * size);
+        if (PREDICT_FALSE(!encoding_sample_arena_->RelocateSlice(*cell, &copy))) {
+          return Status::RuntimeError("unable to allocate memory for encoding sample");
+        }
+        encoding_sample_bytes_ += cell->size();
+      }
+      encoding_sample_cells_.append(&copy, sizeof(copy));
+    }
+  } else {
+    encoding_sample_cells_.append(ptr, count * size);
+    encoding_sample_bytes_ += count * size;
+  }
+  encoding_sample_rows_ += count;
+
+  if (encoding_sample_bytes_ <
+      static_cast<size_t>(FLAGS_cfile_adaptive_encoding_sample_bytes)) {
+    return Status::OK();
+  }
+  return FinishEncodingSample();
+}
+
+Status CFileWriter::FinishEncodingSample() {
+  DCHECK(sampling_for_encoding_);
+  sampling_for_encoding_ = false;
+
+  const size_t size = typeinfo_->size();
+  const uint8_t* cells = encoding_sample_cells_.data();
+  const size_t num_rows = encoding_sample_rows_;
+
+  // Only the non-NULL cells are encoded.
+  faststring non_null_cells;
+  const uint8_t* trial_cells = cells;
+  size_t trial_count = num_rows;
+  if (is_nullable_) {
+    for (size_t i = 0; i < num_rows; i++) {
+      if (BitmapTest(encoding_sample_null_bitmap_.data(), i)) {
+        non_null_cells.append(cells + i * size, size);
+      }
+    }
+    trial_cells = non_null_cells.data();
+    trial_count = non_null_cells.size() / size;
+  }
+
+  if (trial_count > 0) {
+    const EncodingType default_encoding = type_encoding_info_->encoding_type();
+    size_t default_raw_size;
+    size_t default_size;
+    RETURN_NOT_OK(TrialEncode(type_encoding_info_, trial_cells, trial_count,
+                              &default_raw_size, &default_size));
+
+    const TypeEncodingInfo* best = type_encoding_info_;
+    size_t best_raw_size = default_raw_size;
+    size_t best_size = default_size;
+    for (EncodingType encoding : kAdaptiveEncodingCandidates) {
+      const TypeEncodingInfo* info;
+      if (encoding == default_encoding ||
+          !TypeEncodingInfo::Get(typeinfo_, encoding, &info).ok()) {
+        continue;
+      }
+      size_t raw_size;
+      size_t encoded_size;
+      RETURN_NOT_OK(TrialEncode(info, trial_cells, trial_count, &raw_size, &encoded_size));
+      if (encoded_size < best_size) {
+        best = info;
+        best_raw_size = raw_size;
+        best_size = encoded_size;
+      }
+    }
+
+    const double min_saving = FLAGS_cfile_adaptive_encoding_min_saving;
+    if (best != type_encoding_info_ && best_size < default_size * (1 - min_saving)) {
+      type_encoding_info_ = best;
+      BlockBuilder* bb;
+      RETURN_NOT_OK(type_encoding_info_->CreateBlockBuilder(&bb, &options_));
+      data_block_.reset(bb);
+    } else {
+      best_raw_size = default_raw_size;
+      best_size = default_size;
+    }
+
+    // Compression which barely shrinks the data only slows down reads.
+    if (adaptive_compression_ && block_compressor_ &&
+        best_size > best_raw_size * (1 - min_saving)) {
+      compression_ = NO_COMPRESSION;
+      block_compressor_.reset();
+      sampling_for_zstd_dictionary_ = false;
+    }
+    VLOG(1) << "Picked encoding " << EncodingType_Name(type_encoding_info_->encoding_type())
+            << " and compression " << CompressionType_Name(compression_)
+            << " from a sample of " << num_rows << " cells";
+  }
+
+  // Now that the encoding is settled, append the sampled cells.
+  encoding_sample_rows_ = 0;
+  Status s = is_nullable_ ?
+      AppendNullableEntries(encoding_sample_null_bitmap_.data(), cells, num_rows) :
+      AppendEntries(cells, num_rows);
+
+  encoding_sample_cells_.clear();
+  encoding_sample_cells_.shrink_to_fit();
+  encoding_sample_null_bitmap_.clear();
+  encoding_sample_null_bitmap_.shrink_to_fit();
+  encoding_sample_arena_.reset();
+  return s;
+}
+
+Status CFileWriter::TrialEncode(const TypeEncodingInfo* encoding_info,
+                                const uint8_t* cells,
+                                size_t count,
+                                size_t* raw_size,
+                                size_t* compressed_size) {
+  BlockBuilder* bb;
+  RETURN_NOT_OK(encoding_info->CreateBlockBuilder(&bb, &options_));
+  unique_ptr<BlockBuilder> builder(bb);
+
+  *raw_size = 0;
+  *compressed_size = 0;
+  const size_t size = typeinfo_->size();
+  vector<Slice> compressed;
+  size_t i = 0;
+  while (i < count) {
+    i += builder->Add(cells + i * size, count - i);
+    if (!builder->IsBlockFull() && i < count) {
+      continue;
+    }
+    Slice block = builder->Finish(0);
+    *raw_size += block.size();
+    if (block_compressor_) {
+      RETURN_NOT_OK(block_compressor_->Compress({ block }, &compressed));
+      for (const Slice& s : compressed) {
+        *compressed_size += s.size();
+      }
+    } else {
+      *compressed_size += block.size();
+    }
+    builder->Reset();
+  }
+  *raw_size += builder->ExtraInfoSize();
+  *compressed_size += builder->ExtraInfoSize();
+  return Status::OK();
+}
+
 Status CFileWriter::FinishCurDataBlock() {
   uint32_t num_elems_in_block = data_block_->Count();
   if (is_nullable_) {
@@ -380,6 +705,11 @@ Status CFileWriter::FinishCurDataBlock() {
   VLOG(1) << "Appending data block for values " <<
     first_elem_ord << "-" << (first_elem_ord + num_elems_in_block);
 
+  if (zone_map_builder_) {
+    zone_map_builder_->FinishBlock(first_elem_ord, num_elems_in_block,
+                                   zone_maps_->add_blocks());
+  }
+
   // The current data block is full, need to push it
   // into the file, and add to index
   Slice data = data_block_->Finish(first_elem_ord);
@@ -470,6 +800,10 @@ Status CFileWriter::AddBlock(const vector<Slice> &data_slices,
   uint64_t start_offset = off_;
   vector<Slice> out_slices;
 
+  if (PREDICT_FALSE(sampling_for_zstd_dictionary_)) {
+    SampleForZstdDictionary(data_slices);
+  }
+
   if (block_compressor_ != nullptr) {
     // Write compressed block
     Status s = block_compressor_->Compress(data_slices, &out_slices);
@@ -503,6 +837,40 @@ Status CFileWriter::AddBlock(const vector<Slice> &data_slices,
   return Status::OK();
 }
 
+void CFileWriter::SampleForZstdDictionary(const vector<Slice>& data_slices) {
+  for (const Slice& data : data_slices) {
+    for (size_t off = 0; off < data.size(); off += kZstdDictionarySampleSize) {
+      size_t len = std::min(kZstdDictionarySampleSize, data.size() - off);
+      zstd_dictionary_samples_.append(data.data() + off, len);
+      zstd_dictionary_sample_sizes_.push_back(len);
+    }
+  }
+  if (zstd_dictionary_samples_.size() <
+      static_cast<size_t>(FLAGS_cfile_zstd_dictionary_training_bytes)) {
+    return;
+  }
+
+  sampling_for_zstd_dictionary_ = false;
+  Status s = TrainZstdDictionary(Slice(zstd_dictionary_samples_),
+                                 zstd_dictionary_sample_sizes_,
+                                 FLAGS_cfile_zstd_dictionary_size,
+                                 &zstd_dictionary_);
+  zstd_dictionary_samples_.clear();
+  zstd_dictionary_samples_.shrink_to_fit();
+  vector<size_t>().swap(zstd_dictionary_sample_sizes_);
+  if (s.ok()) {
+    s = NewZstdDictionaryCodec(zstd_dictionary_, FLAGS_cfile_zstd_compression_level,
+                               &zstd_dictionary_codec_);
+  }
+  if (!s.ok()) {
+    // Not fatal: the remaining blocks are compressed without a dictionary.
+    VLOG(1) << "Unable to set up zstd dictionary: " << s.ToString();
+    zstd_dictionary_.clear();
+    return;
+  }
+  block_compressor_.reset(new CompressedBlockBuilder(zstd_dictionary_codec_.get()));
+}
+
 Status CFileWriter::WriteRawData(const vector<Slice>& data) {
   size_t data_size = accumulate(data.begin(), data.end(), static_cast<size_t>(0),
                                 [&](int sum, const Slice& curr) {
@@ -47,6 +47,8 @@ class RepeatedPtrField; // IWYU pragma: keep
 
 namespace kudu {
 
+class Arena;
+class CompressionCodec;
 class TypeInfo;
 template <typename Buffer>
 class KeyEncoder;
@@ -55,10 +57,13 @@ namespace cfile {
 
 class BlockBuilder;
 class BlockPointer;
+class ColumnStatisticsBuilder;
 class CompressedBlockBuilder;
 class FileMetadataPairPB;
 class IndexTreeBuilder;
 class TypeEncodingInfo;
+class ZoneMapBuilder;
+class ZoneMapsPB;
 
 // Magic used in header/footer
 extern const char kMagicStringV1[];
@@ -171,7 +176,7 @@ class CFileWriter {
   // This includes NULL cells, but does not include any "raw" blocks
   // appended.
   int written_value_count() const {
-    return value_count_;
+    return value_count_ + encoding_sample_rows_;
   }
 
   std::string ToString() const { return block_->id().ToString(); }
@@ -201,6 +206,31 @@ class CFileWriter {
 
   Status FinishCurDataBlock();
 
+  // Adds the uncompressed contents of a block to the samples used to train
+  // the ZSTD dictionary. Once enough data has been sampled, trains the
+  // dictionary and switches subsequent blocks over to compressing with it.
+  void SampleForZstdDictionary(const std::vector<Slice>& data_slices);
+
+  // Buffers 'count' cells into the sample from which the encoding of the
+  // file is picked, and picks it once the sample is large enough. 'bitmap'
+  // is the null bitmap of the cells, or nullptr if the file isn't nullable.
+  Status AddToEncodingSample(const uint8_t* bitmap, const void* entries, size_t count);
+
+  // Picks the encoding of the file, and whether to compress it, by trial
+  // encoding the buffered sample with each candidate encoding, then appends
+  // the sampled cells to the file.
+  Status FinishEncodingSample();
+
+  // Encodes the 'count' non-NULL cells at 'cells' with the encoding
+  // 'encoding_info', setting 'raw_size' to the size of the encoded blocks
+  // and 'compressed_size' to their size after compression with the file's
+  // codec, if any.
+  Status TrialEncode(const TypeEncodingInfo* encoding_info,
+                     const uint8_t* cells,
+                     size_t count,
+                     size_t* raw_size,
+                     size_t* compressed_size);
+
   // Flush the current unflushed_metadata_ entries into the given protobuf
   // field, clearing the buffer.
   void FlushMetadataToPB(google::protobuf::RepeatedPtrField<FileMetadataPairPB> *field);
@@ -242,6 +272,36 @@ class CFileWriter {
   gscoped_ptr<NullBitmapBuilder> null_bitmap_builder_;
   gscoped_ptr<CompressedBlockBuilder> block_compressor_;
 
+  // State for training a ZSTD dictionary from the first blocks of the file.
+  // 'sampling_for_zstd_dictionary_' is only set while samples are collected.
+  bool sampling_for_zstd_dictionary_;
+  faststring zstd_dictionary_samples_;
+  std::vector<size_t> zstd_dictionary_sample_sizes_;
+  std::string zstd_dictionary_;
+  std::unique_ptr<CompressionCodec> zstd_dictionary_codec_;
+  // State for picking the encoding of the file from a sample of its first
+  // cells. 'sampling_for_encoding_' is only set while the sample is
+  // collected, during which no data blocks are written.
+  bool sampling_for_encoding_;
+  // Whether the file's compression may be turned off if it doesn't pay off
+  // on the sample, i.e. if it wasn't configured explicitly.
+  bool adaptive_compression_;
+  faststring encoding_sample_cells_;
+  faststring encoding_sample_null_bitmap_;
+  size_t encoding_sample_rows_;
+  size_t encoding_sample_bytes_;
+  // Holds copies of the sampled binary cells.
+  std::unique_ptr<Arena> encoding_sample_arena_;
+
+  gscoped_ptr<ZoneMapBuilder> zone_map_builder_;
+
+  // The zone maps of the data blocks written so far. Only set if the writer
+  // is writing zone maps.
+  std::unique_ptr<ZoneMapsPB> zone_maps_;
+
+  // Only set if the writer is writing column statistics.
+  std::unique_ptr<ColumnStatisticsBuilder> statistics_builder_;
+
   enum State {
     kWriterInitialized,
     kWriterWriting,
@@ -0,0 +1,171 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/cfile/column_statistics.h"
+
+#include <string>
+
+#include <glog/logging.h>
+
+#include "kudu/cfile/cfile.pb.h"
+#include "kudu/common/common.pb.h"
+#include "kudu/common/types.h"
+#include "kudu/gutil/hash/city.h"
+#include "kudu/util/slice.h"
+
+using std::string;
+
+namespace kudu {
+namespace cfile {
+
+namespace {
+
+bool HasNonNullCells(const ColumnStatisticsPB& stats) {
+  return stats.num_values() > stats.null_count();
+}
+
+} // anonymous namespace
+
+ColumnStatisticsBuilder::ColumnStatisticsBuilder(const TypeInfo* typeinfo)
+    : typeinfo_(typeinfo),
+      bounds_(typeinfo),
+      num_values_(0),
+      null_count_(0),
+      total_value_size_(0) {
+}
+
+void ColumnStatisticsBuilder::AddCells(const uint8_t* cells, size_t count) {
+  bounds_.AddCells(cells, count);
+  num_values_ += count;
+
+  const size_t size = typeinfo_->size();
+  if (typeinfo_->physical_type() == BINARY) {
+    for (size_t i = 0; i < count; i++) {
+      const Slice* s = reinterpret_cast<const Slice*>(cells + i * size);
+      distinct_values_.AddHash(util_hash::CityHash64(
+          reinterpret_cast<const char*>(s->data()), s->size()));
+      total_value_size_ += s->size();
+    }
+  } else {
+    for (size_t i = 0; i < count; i++) {
+      distinct_values_.AddHash(util_hash::CityHash64(
+          reinterpret_cast<const char*>(cells + i * size), size));
+    }
+    total_value_size_ += count * size;
+  }
+}
+
+void ColumnStatisticsBuilder::Finish(ColumnStatisticsPB* pb) {
+  pb->set_num_values(num_values_);
+  pb->set_null_count(null_count_);
+  pb->set_total_value_size(total_value_size_);
+
+  // The zone map builder only stores bounds when they're known and small
+  // enough to be worth storing.
+  BlockZoneMapPB bounds;
+  bounds_.FinishBlock(0, 0, &bounds);
+  if (bounds.has_min_value()) {
+    pb->set_min_value(bounds.min_value());
+    pb->set_max_value(bounds.max_value());
+  }
+  distinct_values_.SerializeTo(pb->mutable_distinct_values_sketch());
+}
+
+Status MergeColumnStatistics(const TypeInfo* typeinfo,
+                             const ColumnStatisticsPB& src,
+                             ColumnStatisticsPB* dst) {
+  const bool src_has_cells = HasNonNullCells(src);
+  const bool dst_has_cells = HasNonNullCells(*dst);
+
+  if (src.has_num_values() && dst->has_num_values()) {
+    dst->set_num_values(dst->num_values() + src.num_values());
+  } else {
+    dst->clear_num_values();
+  }
+  if (src.has_null_count() && dst->has_null_count()) {
+    dst->set_null_count(dst->null_count() + src.null_count());
+  } else {
+    dst->clear_null_count();
+  }
+  if (src.has_total_value_size() && dst->has_total_value_size()) {
+    dst->set_total_value_size(dst->total_value_size() + src.total_value_size());
+  } else {
+    dst->clear_total_value_size();
+  }
+
+  // Once either side has non-NULL cells with unknown bounds, the bounds of
+  // the union are unknown too.
+  if (src_has_cells) {
+    if (!src.has_min_value() || !src.has_max_value() ||
+        (dst_has_cells && (!dst->has_min_value() || !dst->has_max_value()))) {
+      dst->clear_min_value();
+      dst->clear_max_value();
+    } else if (!dst_has_cells) {
+      dst->set_min_value(src.min_value());
+      dst->set_max_value(src.max_value());
+    } else {
+      Slice src_slice;
+      Slice dst_slice;
+      const void* src_min = ZoneMapValueCellPtr(typeinfo, src.min_value(), &src_slice);
+      const void* dst_min = ZoneMapValueCellPtr(typeinfo, dst->min_value(), &dst_slice);
+      if (PREDICT_FALSE(src_min == nullptr || dst_min == nullptr)) {
+        return Status::Corruption("invalid minimum value in column statistics");
+      }
+      if (typeinfo->Compare(src_min, dst_min) < 0) {
+        dst->set_min_value(src.min_value());
+      }
+      const void* src_max = ZoneMapValueCellPtr(typeinfo, src.max_value(), &src_slice);
+      const void* dst_max = ZoneMapValueCellPtr(typeinfo, dst->max_value(), &dst_slice);
+      if (PREDICT_FALSE(src_max == nullptr || dst_max == nullptr)) {
+        return Status::Corruption("invalid maximum value in column statistics");
+      }
+      if (typeinfo->Compare(src_max, dst_max) > 0) {
+        dst->set_max_value(src.max_value());
+      }
+    }
+  }
+
+  if (!src.has_distinct_values_sketch() || !dst->has_distinct_values_sketch()) {
+    dst->clear_distinct_values_sketch();
+    return Status::OK();
+  }
+  HyperLogLog src_hll;
+  HyperLogLog dst_hll;
+  RETURN_NOT_OK(HyperLogLog::ParseFrom(src.distinct_values_sketch(), &src_hll));
+  RETURN_NOT_OK(HyperLogLog::ParseFrom(dst->distinct_values_sketch(), &dst_hll));
+  if (src_hll.precision() != dst_hll.precision()) {
+    // Sketches of different precisions can't be merged.
+    dst->clear_distinct_values_sketch();
+    return Status::OK();
+  }
+  dst_hll.Merge(src_hll);
+  dst_hll.SerializeTo(dst->mutable_distinct_values_sketch());
+  return Status::OK();
+}
+
+Status EstimateDistinctValues(const ColumnStatisticsPB& stats, uint64_t* estimate) {
+  if (!stats.has_distinct_values_sketch()) {
+    return Status::NotFound("no distinct values sketch");
+  }
+  HyperLogLog hll;
+  RETURN_NOT_OK(HyperLogLog::ParseFrom(stats.distinct_values_sketch(), &hll));
+  *estimate = hll.Estimate();
+  return Status::OK();
+}
+
+} // namespace cfile
+} // namespace kudu
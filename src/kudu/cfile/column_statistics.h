@@ -0,0 +1,86 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_CFILE_COLUMN_STATISTICS_H
+#define KUDU_CFILE_COLUMN_STATISTICS_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "kudu/cfile/zone_map.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/util/hyperloglog.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+class TypeInfo;
+
+namespace cfile {
+
+class ColumnStatisticsPB;
+
+// Accumulates the statistics of all of the cells written to a cfile: the
+// number of NULLs, the minimum and maximum cells, the total value size, and
+// a sketch of the number of distinct values.
+class ColumnStatisticsBuilder {
+ public:
+  explicit ColumnStatisticsBuilder(const TypeInfo* typeinfo);
+
+  // Adds 'count' non-NULL cells, stored contiguously at 'cells'.
+  void AddCells(const uint8_t* cells, size_t count);
+
+  // Adds 'count' NULL cells.
+  void AddNulls(size_t count) {
+    num_values_ += count;
+    null_count_ += count;
+  }
+
+  // Writes the statistics of the cells added so far into 'pb'. The builder
+  // may not be used afterwards.
+  void Finish(ColumnStatisticsPB* pb);
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ColumnStatisticsBuilder);
+
+  const TypeInfo* const typeinfo_;
+
+  // Never reset, so that it tracks the bounds of the whole file.
+  ZoneMapBuilder bounds_;
+
+  HyperLogLog distinct_values_;
+
+  uint64_t num_values_;
+  uint64_t null_count_;
+  uint64_t total_value_size_;
+};
+
+// Merges the statistics 'src' of one set of cells into the statistics 'dst'
+// of another set, both over columns of type 'typeinfo', so that 'dst' holds
+// the statistics of their union. Statistics which are missing from either
+// side are cleared from 'dst'.
+Status MergeColumnStatistics(const TypeInfo* typeinfo,
+                             const ColumnStatisticsPB& src,
+                             ColumnStatisticsPB* dst);
+
+// Sets 'estimate' to the estimated number of distinct non-NULL values
+// described by 'stats'. Returns NotFound if 'stats' has no sketch of them.
+Status EstimateDistinctValues(const ColumnStatisticsPB& stats, uint64_t* estimate);
+
+} // namespace cfile
+} // namespace kudu
+
+#endif // KUDU_CFILE_COLUMN_STATISTICS_H
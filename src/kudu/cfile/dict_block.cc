@@ -0,0 +1,370 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/cfile/dict_block.h"
+
+#include <ostream>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "kudu/cfile/block_pointer.h"
+#include "kudu/cfile/bshuf_block.h"
+#include "kudu/cfile/cfile.pb.h"
+#include "kudu/cfile/cfile_reader.h"
+#include "kudu/cfile/cfile_writer.h"
+#include "kudu/common/column_materialization_context.h"
+#include "kudu/common/column_predicate.h"
+#include "kudu/common/columnblock.h"
+#include "kudu/common/rowblock.h"
+#include "kudu/gutil/casts.h"
+#include "kudu/gutil/map-util.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/bitmap.h"
+#include "kudu/util/coding.h"
+#include "kudu/util/coding-inl.h"
+
+namespace kudu {
+namespace cfile {
+
+template<DataType Type>
+DictBlockBuilder<Type>::DictBlockBuilder(const WriterOptions* options)
+    : options_(options),
+      dict_block_(options_),
+      mode_(kCodeWordMode),
+      first_key_(0),
+      last_key_(0) {
+  data_builder_.reset(new BShufBlockBuilder<UINT32>(options_));
+  Reset();
+}
+
+template<DataType Type>
+void DictBlockBuilder<Type>::Reset() {
+  buffer_.clear();
+  buffer_.resize(kMaxHeaderSize);
+  buffer_.reserve(options_->storage_attributes.cfile_block_size);
+
+  if (mode_ == kCodeWordMode &&
+      dict_block_.IsBlockFull()) {
+    mode_ = kPlainBinaryMode;
+    data_builder_.reset(new PlainBlockBuilder<Type>(options_));
+  } else {
+    data_builder_->Reset();
+  }
+
+  finished_ = false;
+}
+
+template<DataType Type>
+Slice DictBlockBuilder<Type>::Finish(rowid_t ordinal_pos) {
+  finished_ = true;
+
+  InlineEncodeFixed32(&buffer_[0], mode_);
+
+  Slice data_slice = data_builder_->Finish(ordinal_pos);
+  buffer_.append(data_slice.data(), data_slice.size());
+
+  return Slice(buffer_);
+}
+
+// As with strings, the current block is considered full when the data block
+// exceeds its limit or when the dictionary block exceeds the CFile block
+// size, after which the subsequent data blocks are plain encoded.
+template<DataType Type>
+bool DictBlockBuilder<Type>::IsBlockFull() const {
+  if (data_builder_->IsBlockFull()) return true;
+  if (dict_block_.IsBlockFull() && (mode_ == kCodeWordMode)) return true;
+  return false;
+}
+
+template<DataType Type>
+int DictBlockBuilder<Type>::AddCodeWords(const uint8_t* vals, size_t count) {
+  DCHECK(!finished_);
+  DCHECK_GT(count, 0);
+  size_t i;
+
+  const CppType* src = reinterpret_cast<const CppType*>(vals);
+  if (data_builder_->Count() == 0) {
+    first_key_ = src[0];
+  }
+
+  for (i = 0; i < count; i++) {
+    uint32_t codeword;
+    if (PREDICT_FALSE(!FindCopy(dictionary_, src[i], &codeword))) {
+      // Not already in dictionary, try to add it if there is space.
+      if (PREDICT_FALSE(!AddToDict(src[i], &codeword))) {
+        break;
+      }
+    }
+    if (PREDICT_FALSE(data_builder_->Add(reinterpret_cast<const uint8_t*>(&codeword), 1) == 0)) {
+      // The data block is full
+      break;
+    }
+    last_key_ = src[i];
+  }
+  return i;
+}
+
+template<DataType Type>
+bool DictBlockBuilder<Type>::AddToDict(CppType val, uint32_t* codeword) {
+  if (PREDICT_FALSE(dict_block_.Add(reinterpret_cast<const uint8_t*>(&val), 1) == 0)) {
+    // The dictionary block is full
+    return false;
+  }
+  *codeword = dict_block_.Count() - 1;
+  InsertOrDie(&dictionary_, val, *codeword);
+  return true;
+}
+
+template<DataType Type>
+int DictBlockBuilder<Type>::Add(const uint8_t* vals, size_t count) {
+  if (mode_ == kCodeWordMode) {
+    return AddCodeWords(vals, count);
+  } else {
+    DCHECK_EQ(mode_, kPlainBinaryMode);
+    return data_builder_->Add(vals, count);
+  }
+}
+
+template<DataType Type>
+Status DictBlockBuilder<Type>::AppendExtraInfo(CFileWriter* c_writer, CFileFooterPB* footer) {
+  Slice dict_slice = dict_block_.Finish(0);
+
+  std::vector<Slice> dict_v;
+  dict_v.push_back(dict_slice);
+
+  BlockPointer ptr;
+  Status s = c_writer->AppendDictBlock(dict_v, &ptr, "Append dictionary block");
+  if (!s.ok()) {
+    LOG(WARNING) << "Unable to append block to file: " << s.ToString();
+    return s;
+  }
+  ptr.CopyToPB(footer->mutable_dict_block_ptr());
+  return Status::OK();
+}
+
+template<DataType Type>
+size_t DictBlockBuilder<Type>::ExtraInfoSize() const {
+  return dictionary_.size() * sizeof(CppType);
+}
+
+template<DataType Type>
+size_t DictBlockBuilder<Type>::Count() const {
+  return data_builder_->Count();
+}
+
+template<DataType Type>
+Status DictBlockBuilder<Type>::GetFirstKey(void* key_void) const {
+  if (mode_ == kCodeWordMode) {
+    CHECK(finished_);
+    *reinterpret_cast<CppType*>(key_void) = first_key_;
+    return Status::OK();
+  } else {
+    DCHECK_EQ(mode_, kPlainBinaryMode);
+    return data_builder_->GetFirstKey(key_void);
+  }
+}
+
+template<DataType Type>
+Status DictBlockBuilder<Type>::GetLastKey(void* key_void) const {
+  if (mode_ == kCodeWordMode) {
+    CHECK(finished_);
+    *reinterpret_cast<CppType*>(key_void) = last_key_;
+    return Status::OK();
+  } else {
+    DCHECK_EQ(mode_, kPlainBinaryMode);
+    return data_builder_->GetLastKey(key_void);
+  }
+}
+
+////////////////////////////////////////////////////////////
+// Decoding
+////////////////////////////////////////////////////////////
+
+template<DataType Type>
+DictBlockDecoder<Type>::DictBlockDecoder(Slice slice, CFileIterator* iter)
+    : data_(slice),
+      parsed_(false),
+      dict_decoder_(down_cast<PlainBlockDecoder<Type>*>(iter->GetDictDecoder())),
+      parent_cfile_iter_(iter) {
+}
+
+template<DataType Type>
+Status DictBlockDecoder<Type>::ParseHeader() {
+  CHECK(!parsed_);
+
+  if (data_.size() < kMinHeaderSize) {
+    return Status::Corruption(
+      strings::Substitute("not enough bytes for header: dictionary block header "
+        "size ($0) less than minimum possible header length ($1)",
+        data_.size(), kMinHeaderSize));
+  }
+
+  bool valid = tight_enum_test_cast<DictEncodingMode>(DecodeFixed32(&data_[0]), &mode_);
+  if (PREDICT_FALSE(!valid)) {
+    return Status::Corruption("header Mode information corrupted");
+  }
+  Slice content(data_.data() + 4, data_.size() - 4);
+
+  if (mode_ == kCodeWordMode) {
+    if (PREDICT_FALSE(dict_decoder_ == nullptr)) {
+      return Status::Corruption("dictionary encoded data block in a cfile without a dictionary");
+    }
+    data_decoder_.reset(new BShufBlockDecoder<UINT32>(content));
+  } else {
+    if (mode_ != kPlainBinaryMode) {
+      return Status::Corruption("Unrecognized Dictionary encoded data block header");
+    }
+    data_decoder_.reset(new PlainBlockDecoder<Type>(content));
+  }
+
+  RETURN_NOT_OK(data_decoder_->ParseHeader());
+  parsed_ = true;
+  return Status::OK();
+}
+
+template<DataType Type>
+void DictBlockDecoder<Type>::SeekToPositionInBlock(uint pos) {
+  data_decoder_->SeekToPositionInBlock(pos);
+}
+
+template<DataType Type>
+Status DictBlockDecoder<Type>::SeekAtOrAfterValue(const void* value_void, bool* exact) {
+  if (mode_ == kCodeWordMode) {
+    // As with strings, this relies on the values of a key column arriving in
+    // sorted order, so that both the dictionary and the codewords are sorted.
+    DCHECK(value_void != nullptr);
+    Status s = dict_decoder_->SeekAtOrAfterValue(value_void, exact);
+    if (!s.ok()) {
+      // The value is larger than the largest key in the dictionary block, so
+      // it can't be in the current data block: move to the end of the block.
+      data_decoder_->SeekToPositionInBlock(data_decoder_->Count() - 1);
+      return s;
+    }
+
+    uint32_t index = dict_decoder_->GetCurrentIndex();
+    bool tmp;
+    return data_decoder_->SeekAtOrAfterValue(&index, &tmp);
+  } else {
+    DCHECK_EQ(mode_, kPlainBinaryMode);
+    return data_decoder_->SeekAtOrAfterValue(value_void, exact);
+  }
+}
+
+template<DataType Type>
+Status DictBlockDecoder<Type>::CopyNextCodeWords(size_t* n) {
+  codeword_buf_.resize(*n * sizeof(uint32_t));
+  BShufBlockDecoder<UINT32>* d_bptr = down_cast<BShufBlockDecoder<UINT32>*>(data_decoder_.get());
+  return d_bptr->CopyNextValuesToArray(n, codeword_buf_.data());
+}
+
+template<DataType Type>
+Status DictBlockDecoder<Type>::CopyNextAndEval(size_t* n,
+                                               ColumnMaterializationContext* ctx,
+                                               SelectionVectorView* sel,
+                                               ColumnDataView* dst) {
+  ctx->SetDecoderEvalSupported();
+  if (mode_ == kPlainBinaryMode) {
+    // Plain blocks don't evaluate predicates themselves, so copy the values
+    // and evaluate them one by one.
+    RETURN_NOT_OK(data_decoder_->CopyNextValues(n, dst));
+    const CppType* values = reinterpret_cast<const CppType*>(dst->data());
+    for (size_t i = 0; i < *n; i++) {
+      if (sel->TestBit(i) && !ctx->pred()->EvaluateCell<Type>(&values[i])) {
+        sel->ClearBit(i);
+      }
+    }
+    return Status::OK();
+  }
+
+  // Predicates that have no matching words should return no data.
+  SelectionVector* codewords_matching_pred = parent_cfile_iter_->GetCodeWordsMatchingPredicate();
+  CHECK(codewords_matching_pred != nullptr);
+  if (!codewords_matching_pred->AnySelected()) {
+    // If nothing is selected, move the data_decoder_ pointer forward and clear
+    // the corresponding bits in the selection vector.
+    int skip = static_cast<int>(*n);
+    data_decoder_->SeekForward(&skip);
+    *n = static_cast<size_t>(skip);
+    sel->ClearBits(*n);
+    return Status::OK();
+  }
+
+  // IsNotNull predicates, and predicates that match every word, should
+  // return all data.
+  if (ctx->pred()->predicate_type() == PredicateType::IsNotNull ||
+      parent_cfile_iter_->AllCodeWordsMatchPredicate()) {
+    return CopyNextDecodeValues(n, dst);
+  }
+
+  // Evaluate the predicate by looking the rows' codewords up in the set of
+  // matching codewords, and only decode the rows that pass.
+  RETURN_NOT_OK(CopyNextCodeWords(n));
+  const uint32_t* codewords = reinterpret_cast<const uint32_t*>(codeword_buf_.data());
+  CppType* out = reinterpret_cast<CppType*>(dst->data());
+  for (size_t i = 0; i < *n; i++) {
+    if (!sel->TestBit(i)) {
+      continue;
+    }
+    uint32_t codeword = codewords[i];
+    if (BitmapTest(codewords_matching_pred->bitmap(), codeword)) {
+      out[i] = dict_decoder_->value_at_index(codeword);
+    } else {
+      sel->ClearBit(i);
+    }
+  }
+  return Status::OK();
+}
+
+template<DataType Type>
+Status DictBlockDecoder<Type>::CopyNextDecodeValues(size_t* n, ColumnDataView* dst) {
+  DCHECK(parsed_);
+  DCHECK_LE(*n, dst->nrows());
+  DCHECK_EQ(dst->stride(), sizeof(CppType));
+
+  // Copy the codewords into a temporary buffer first, and then copy the
+  // values corresponding to the codewords to the destination buffer.
+  RETURN_NOT_OK(CopyNextCodeWords(n));
+  const uint32_t* codewords = reinterpret_cast<const uint32_t*>(codeword_buf_.data());
+  CppType* out = reinterpret_cast<CppType*>(dst->data());
+  for (size_t i = 0; i < *n; i++) {
+    out[i] = dict_decoder_->value_at_index(codewords[i]);
+  }
+  return Status::OK();
+}
+
+template<DataType Type>
+Status DictBlockDecoder<Type>::CopyNextValues(size_t* n, ColumnDataView* dst) {
+  if (mode_ == kCodeWordMode) {
+    return CopyNextDecodeValues(n, dst);
+  } else {
+    DCHECK_EQ(mode_, kPlainBinaryMode);
+    return data_decoder_->CopyNextValues(n, dst);
+  }
+}
+
+template class DictBlockBuilder<UINT32>;
+template class DictBlockBuilder<INT32>;
+template class DictBlockBuilder<UINT64>;
+template class DictBlockBuilder<INT64>;
+template class DictBlockDecoder<UINT32>;
+template class DictBlockDecoder<INT32>;
+template class DictBlockDecoder<UINT64>;
+template class DictBlockDecoder<INT64>;
+
+} // namespace cfile
+} // namespace kudu
@@ -0,0 +1,191 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// Dictionary encoding for fixed-width integer types. Like the dictionary
+// encoding for strings (see binary_dict_block.h), there is only one
+// dictionary block for all the data blocks within a cfile, stored as a
+// plain block of the column's type. Data blocks share the header format of
+// binary dictionary blocks:
+//
+// Either header + embedded bitshuffled codeword block, when mode_ = kCodeWordMode.
+// Or     header + embedded plain block of the column's type, when
+//        mode_ = kPlainBinaryMode.
+//
+// Data blocks start in kCodeWordMode. Once the dictionary block grows beyond
+// the cfile block size, the subsequent data blocks switch to plain blocks.
+//
+// This suits low-cardinality integer columns (status codes, region ids and
+// other enum-like values): codewords only need as many bits as the number of
+// distinct values does, which bitshuffle takes advantage of, and predicates
+// can be evaluated once per dictionary entry rather than once per row.
+#ifndef KUDU_CFILE_DICT_BLOCK_H
+#define KUDU_CFILE_DICT_BLOCK_H
+
+#include <sys/types.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+
+#include "kudu/cfile/binary_dict_block.h"
+#include "kudu/cfile/block_encodings.h"
+#include "kudu/cfile/plain_block.h"
+#include "kudu/common/common.pb.h"
+#include "kudu/common/rowid.h"
+#include "kudu/common/types.h"
+#include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/port.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/slice.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+class ColumnDataView;
+class ColumnMaterializationContext;
+class SelectionVectorView;
+
+namespace cfile {
+
+class CFileFooterPB;
+class CFileIterator;
+class CFileWriter;
+
+struct WriterOptions;
+
+template<DataType Type>
+class DictBlockBuilder final : public BlockBuilder {
+ public:
+  explicit DictBlockBuilder(const WriterOptions* options);
+
+  bool IsBlockFull() const override;
+
+  // Append the dictionary block for the current cfile to the end of the cfile and set the footer
+  // accordingly.
+  Status AppendExtraInfo(CFileWriter* c_writer, CFileFooterPB* footer) OVERRIDE;
+
+  size_t ExtraInfoSize() const OVERRIDE;
+
+  int Add(const uint8_t* vals, size_t count) OVERRIDE;
+
+  Slice Finish(rowid_t ordinal_pos) OVERRIDE;
+
+  void Reset() OVERRIDE;
+
+  size_t Count() const OVERRIDE;
+
+  Status GetFirstKey(void* key) const OVERRIDE;
+
+  Status GetLastKey(void* key) const OVERRIDE;
+
+  static const size_t kMaxHeaderSize = sizeof(uint32_t) * 1;
+
+ private:
+  typedef typename TypeTraits<Type>::cpp_type CppType;
+
+  int AddCodeWords(const uint8_t* vals, size_t count);
+
+  ATTRIBUTE_COLD
+  bool AddToDict(CppType val, uint32_t* codeword);
+
+  faststring buffer_;
+  bool finished_;
+  const WriterOptions* options_;
+
+  gscoped_ptr<BlockBuilder> data_builder_;
+
+  // dict_block_ and dictionary_ are related to the dictionary block (one per
+  // cfile). They should NOT be cleared in the Reset() method.
+  PlainBlockBuilder<Type> dict_block_;
+  std::unordered_map<CppType, uint32_t> dictionary_;
+
+  DictEncodingMode mode_;
+
+  // First and last keys when mode_ = kCodeWordMode.
+  CppType first_key_;
+  CppType last_key_;
+
+  DISALLOW_COPY_AND_ASSIGN(DictBlockBuilder);
+};
+
+template<DataType Type>
+class DictBlockDecoder final : public BlockDecoder {
+ public:
+  DictBlockDecoder(Slice slice, CFileIterator* iter);
+
+  Status ParseHeader() OVERRIDE;
+  void SeekToPositionInBlock(uint pos) OVERRIDE;
+  Status SeekAtOrAfterValue(const void* value, bool* exact_match) OVERRIDE;
+  Status CopyNextValues(size_t* n, ColumnDataView* dst) OVERRIDE;
+  Status CopyNextAndEval(size_t* n,
+                         ColumnMaterializationContext* ctx,
+                         SelectionVectorView* sel,
+                         ColumnDataView* dst) override;
+
+  bool HasNext() const OVERRIDE {
+    return data_decoder_->HasNext();
+  }
+
+  size_t Count() const OVERRIDE {
+    return data_decoder_->Count();
+  }
+
+  size_t GetCurrentIndex() const OVERRIDE {
+    return data_decoder_->GetCurrentIndex();
+  }
+
+  rowid_t GetFirstRowId() const OVERRIDE {
+    return data_decoder_->GetFirstRowId();
+  }
+
+  static const size_t kMinHeaderSize = sizeof(uint32_t) * 1;
+
+ private:
+  typedef typename TypeTraits<Type>::cpp_type CppType;
+
+  // Copies the next '*n' codewords into codeword_buf_, returning in '*n' how
+  // many were copied.
+  Status CopyNextCodeWords(size_t* n);
+
+  // Decodes the next '*n' codewords into values of the column's type.
+  Status CopyNextDecodeValues(size_t* n, ColumnDataView* dst);
+
+  Slice data_;
+  bool parsed_;
+
+  // Dictionary block decoder
+  PlainBlockDecoder<Type>* dict_decoder_;
+
+  gscoped_ptr<BlockDecoder> data_decoder_;
+
+  // Parent CFileIterator, each dictionary decoder in the same CFile will share
+  // the same vocabulary, and thus, the same set of matching codewords.
+  CFileIterator* parent_cfile_iter_;
+
+  DictEncodingMode mode_;
+
+  // buffer to hold the codewords, needed by CopyNextDecodeValues()
+  faststring codeword_buf_;
+
+  DISALLOW_COPY_AND_ASSIGN(DictBlockDecoder);
+};
+
+} // namespace cfile
+} // namespace kudu
+
+#endif // KUDU_CFILE_DICT_BLOCK_H
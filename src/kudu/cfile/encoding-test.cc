@@ -37,11 +37,15 @@
 #include "kudu/cfile/block_encodings.h"
 #include "kudu/cfile/bshuf_block.h"
 #include "kudu/cfile/cfile_util.h"
+#include "kudu/cfile/for_block.h"
 #include "kudu/cfile/plain_bitmap_block.h"
 #include "kudu/cfile/plain_block.h"
 #include "kudu/cfile/rle_block.h"
+#include "kudu/common/column_materialization_context.h"
+#include "kudu/common/column_predicate.h"
 #include "kudu/common/columnblock.h"
 #include "kudu/common/common.pb.h"
+#include "kudu/common/rowblock.h"
 #include "kudu/common/schema.h"
 #include "kudu/common/types.h"
 #include "kudu/gutil/gscoped_ptr.h"
@@ -62,6 +66,7 @@
 using std::string;
 using std::unique_ptr;
 using std::vector;
+using strings::Substitute;
 
 namespace kudu {
 namespace cfile {
@@ -466,6 +471,42 @@ class TestEncoding : public KuduTest {
     }
   }
 
+  // Decode a bitshuffled block in batches of various sizes, starting both at
+  // the beginning of the block and at positions within it. Bitshuffle blocks
+  // are decoded in chunks, straight into the destination when a batch covers
+  // whole chunks, so this exercises both the direct and the buffered paths.
+  template<DataType Type>
+  void TestBShufDecodeInBatches(const vector<typename TypeTraits<Type>::cpp_type>& src) {
+    typedef typename TypeTraits<Type>::cpp_type CppType;
+    gscoped_ptr<WriterOptions> opts(NewWriterOptions());
+    BShufBlockBuilder<Type> bb(opts.get());
+    ASSERT_EQ(src.size(), static_cast<size_t>(
+        bb.Add(reinterpret_cast<const uint8_t*>(src.data()), src.size())));
+    Slice s = bb.Finish(0);
+
+    for (size_t batch_size : { 1000, 2048, 4096, 8192, 10000 }) {
+      for (size_t start : { 0, 7, 2048 }) {
+        SCOPED_TRACE(Substitute("batch size $0, start $1", batch_size, start));
+        BShufBlockDecoder<Type> bd(s);
+        ASSERT_OK(bd.ParseHeader());
+        bd.SeekToPositionInBlock(start);
+
+        vector<CppType> decoded(src.size() - start);
+        ColumnBlock dst_block(GetTypeInfo(Type), nullptr, &decoded[0], decoded.size(), &arena_);
+        ColumnDataView view(&dst_block);
+        while (bd.HasNext()) {
+          size_t n = std::min(batch_size, view.nrows());
+          ASSERT_OK_FAST(bd.CopyNextValues(&n, &view));
+          view.Advance(n);
+        }
+        ASSERT_EQ(0, view.nrows());
+        for (size_t i = start; i < src.size(); i++) {
+          ASSERT_EQ(src[i], decoded[i - start]) << "at index " << i;
+        }
+      }
+    }
+  }
+
   // Test truncation of blocks
   template<class BuilderType, class DecoderType>
   void TestBinaryBlockTruncation() {
@@ -675,6 +716,52 @@ class TestEncoding : public KuduTest {
     }
   }
 
+  // Encodes 'values' and decodes them in randomly-sized batches with
+  // CopyNextAndEval(), checking that exactly the rows satisfying 'pred' are
+  // selected, and that their values are decoded correctly.
+  template <DataType Type, class BuilderType, class DecoderType>
+  void TestCopyNextAndEval(const typename TypeTraits<Type>::cpp_type* values,
+                           size_t num_values,
+                           const ColumnPredicate& pred) {
+    typedef typename TypeTraits<Type>::cpp_type CppType;
+    SCOPED_TRACE(pred.ToString());
+
+    unique_ptr<WriterOptions> opts(NewWriterOptions());
+    BuilderType bb(opts.get());
+    bb.Add(reinterpret_cast<const uint8_t*>(values), num_values);
+    Slice s = bb.Finish(0);
+
+    DecoderType bd(s);
+    ASSERT_OK(bd.ParseHeader());
+
+    unique_ptr<CppType[]> decoded(new CppType[num_values]);
+    ColumnBlock dst_block(GetTypeInfo(Type), nullptr, decoded.get(), num_values, &arena_);
+    SelectionVector sel(num_values);
+    sel.SetAllTrue();
+    ColumnMaterializationContext ctx(0, &pred, &dst_block, &sel);
+    ColumnDataView dst_data(&dst_block);
+    SelectionVectorView sel_view(&sel);
+
+    size_t dec_count = 0;
+    while (bd.HasNext()) {
+      size_t n = std::min(num_values - dec_count, static_cast<size_t>((random() % 30) + 1));
+      ASSERT_OK(bd.CopyNextAndEval(&n, &ctx, &sel_view, &dst_data));
+      dst_data.Advance(n);
+      sel_view.Advance(n);
+      dec_count += n;
+    }
+    ASSERT_EQ(num_values, dec_count);
+    ASSERT_FALSE(ctx.DecoderEvalNotSupported());
+
+    for (size_t i = 0; i < num_values; i++) {
+      bool expected = pred.EvaluateCell<Type>(&values[i]);
+      ASSERT_EQ(expected, sel.IsRowSelected(i)) << "row " << i;
+      if (expected) {
+        ASSERT_EQ(values[i], decoded[i]) << "row " << i;
+      }
+    }
+  }
+
   Arena arena_;
 };
 
@@ -703,6 +790,22 @@ TEST_F(TestEncoding, TestBShufIntBlockEncoder) {
                                     BShufBlockDecoder<INT32> >(ints.get(), kSize);
 }
 
+TEST_F(TestEncoding, TestBShufDecodeInBatches) {
+  const int kSize = 10000;
+  vector<int64_t> int64s;
+  vector<uint32_t> uint32s;
+  vector<uint32_t> narrow_uint32s;
+  for (int i = 0; i < kSize; i++) {
+    int64s.push_back(static_cast<int64_t>(random()) * random());
+    uint32s.push_back(random());
+    // Stored as single bytes.
+    narrow_uint32s.push_back(random() % 200);
+  }
+  TestBShufDecodeInBatches<INT64>(int64s);
+  TestBShufDecodeInBatches<UINT32>(uint32s);
+  TestBShufDecodeInBatches<UINT32>(narrow_uint32s);
+}
+
 TEST_F(TestEncoding, TestBShufFloatBlockEncoder) {
   const uint32_t kSize = 10000;
 
@@ -727,6 +830,53 @@ TEST_F(TestEncoding, TestBShufDoubleBlockEncoder) {
                                     BShufBlockDecoder<DOUBLE> >(doubles.get(), kSize);
 }
 
+// Test for frame of reference blocks, mixing mini-blocks of increasing
+// timestamps, which are delta-encoded, with mini-blocks of clustered but
+// unordered values, which aren't.
+TEST_F(TestEncoding, TestForIntBlockEncoder) {
+  const uint32_t kSize = 10000;
+
+  gscoped_ptr<int64_t[]> ints(new int64_t[kSize]);
+  int64_t timestamp = 1500000000000000L;
+  for (int i = 0; i < kSize; i++) {
+    if ((i / 1000) % 2 == 0) {
+      timestamp += random() % 1000;
+      ints.get()[i] = timestamp;
+    } else {
+      ints.get()[i] = timestamp + random() % 100000;
+    }
+  }
+
+  TestEncodeDecodeTemplateBlockEncoder<INT64, ForBlockBuilder<INT64>,
+                                    ForBlockDecoder<INT64> >(ints.get(), kSize);
+}
+
+TEST_F(TestEncoding, TestForIntBlockEncoderSize) {
+  const size_t kSize = 10000;
+  unique_ptr<WriterOptions> opts(NewWriterOptions());
+
+  // Increasing timestamps a few hundred microseconds apart need about 10 bits
+  // per value.
+  vector<int64_t> timestamps;
+  int64_t timestamp = 1500000000000000L;
+  for (size_t i = 0; i < kSize; i++) {
+    timestamp += 1 + random() % 1000;
+    timestamps.push_back(timestamp);
+  }
+  ForBlockBuilder<INT64> ibb(opts.get());
+  ibb.Add(reinterpret_cast<const uint8_t*>(timestamps.data()), kSize);
+  Slice s = ibb.Finish(0);
+  LOG(INFO) << "Frame of reference encoded size for 10k timestamps: " << s.size();
+  ASSERT_LT(s.size(), kSize * 2);
+
+  // A block of a single repeated value takes no bits per value at all.
+  ibb.Reset();
+  vector<int64_t> zeros(kSize, 0);
+  ibb.Add(reinterpret_cast<const uint8_t*>(zeros.data()), kSize);
+  s = ibb.Finish(0);
+  ASSERT_LT(s.size(), kSize / 10);
+}
+
 TEST_F(TestEncoding, TestRleIntBlockEncoder) {
   unique_ptr<WriterOptions> opts(NewWriterOptions());
   RleIntBlockBuilder<UINT32> ibb(opts.get());
@@ -749,6 +899,55 @@ TEST_F(TestEncoding, TestRleIntBlockEncoder) {
   ASSERT_EQ(14UL, s.size());
 }
 
+TEST_F(TestEncoding, TestRleIntBlockCopyNextAndEval) {
+  srand(123);
+  // Generate runs of repeated values, as well as literal runs.
+  vector<uint32_t> values;
+  while (values.size() < 10003) {
+    int run_size = random() % 50 + 1;
+    uint32_t val = random() % 20;
+    for (int j = 0; j < run_size; j++) {
+      values.push_back(random() % 8 == 0 ? random() % 20 : val);
+    }
+  }
+
+  ColumnSchema column("c", UINT32);
+  uint32_t three = 3;
+  uint32_t seven = 7;
+  uint32_t fifteen = 15;
+  vector<const void*> in_list = { &three, &seven, &fifteen };
+  for (const ColumnPredicate& pred : { ColumnPredicate::Range(column, &three, &fifteen),
+                                       ColumnPredicate::Range(column, &seven, nullptr),
+                                       ColumnPredicate::Equality(column, &seven),
+                                       ColumnPredicate::InList(column, &in_list),
+                                       ColumnPredicate::IsNotNull(column) }) {
+    NO_FATALS((TestCopyNextAndEval<UINT32, RleIntBlockBuilder<UINT32>,
+                                   RleIntBlockDecoder<UINT32>>(
+        values.data(), values.size(), pred)));
+  }
+}
+
+TEST_F(TestEncoding, TestRleBitMapCopyNextAndEval) {
+  srand(123);
+  unique_ptr<bool[]> values(new bool[10003]);
+  for (int i = 0; i < 10003; ) {
+    int run_size = std::min(10003 - i, static_cast<int>(random() % 100 + 1));
+    bool val = random() % 2;
+    for (int j = 0; j < run_size; j++) {
+      values[i++] = val;
+    }
+  }
+
+  ColumnSchema column("c", BOOL);
+  bool t = true;
+  bool f = false;
+  for (const ColumnPredicate& pred : { ColumnPredicate::Equality(column, &t),
+                                       ColumnPredicate::Equality(column, &f) }) {
+    NO_FATALS((TestCopyNextAndEval<BOOL, RleBitMapBlockBuilder, RleBitMapBlockDecoder>(
+        values.get(), 10003, pred)));
+  }
+}
+
 TEST_F(TestEncoding, TestPlainBitMapRoundTrip) {
   TestBoolBlockRoundTrip<PlainBitMapBlockBuilder, PlainBitMapBlockDecoder>();
 }
@@ -796,6 +995,10 @@ TEST_F(TestEncoding, TestBinaryPrefixEmptyBlockEncodeDecode) {
   TestEmptyBlockEncodeDecode<BinaryPrefixBlockBuilder, BinaryPrefixBlockDecoder>();
 }
 
+TEST_F(TestEncoding, TestForEmptyBlockEncodeDecode) {
+  TestEmptyBlockEncodeDecode<ForBlockBuilder<UINT32>, ForBlockDecoder<UINT32>>();
+}
+
 // Test encode/decode of a binary block with various-sized truncations.
 TEST_F(TestEncoding, TestBinaryPlainBlockBuilderTruncation) {
   TestBinaryBlockTruncation<BinaryPlainBlockBuilder, BinaryPlainBlockDecoder>();
@@ -833,7 +1036,16 @@ struct BitshuffleTestTraits {
     typedef BShufBlockDecoder<type> decoder_type;
   };
 };
-typedef testing::Types<RleTestTraits, BitshuffleTestTraits, PlainTestTraits> MyTestFixtures;
+
+struct ForTestTraits {
+  template<DataType type>
+  struct Classes {
+    typedef ForBlockBuilder<type> encoder_type;
+    typedef ForBlockDecoder<type> decoder_type;
+  };
+};
+typedef testing::Types<RleTestTraits, BitshuffleTestTraits, PlainTestTraits,
+                       ForTestTraits> MyTestFixtures;
 TYPED_TEST_CASE(IntEncodingTest, MyTestFixtures);
 
 template<class TestTraits>
@@ -0,0 +1,99 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#include "kudu/cfile/for_block.h"
+
+#include <cstring>
+
+#include "kudu/gutil/port.h"
+
+namespace kudu {
+namespace cfile {
+
+namespace {
+
+// Unpacks values of a width known at compile time, so that the shifts and
+// masks are constants and the compiler can unroll and vectorize the loop.
+template<int kWidth>
+void UnpackBitsOfWidth(const uint8_t* in, size_t n, uint64_t* out) {
+  if (kWidth == 0) {
+    memset(out, 0, n * sizeof(*out));
+    return;
+  }
+  constexpr uint64_t kMask = kWidth == 64 ? ~0ULL : (1ULL << (kWidth % 64)) - 1;
+  for (size_t i = 0; i < n; i++) {
+    const size_t bit = i * kWidth;
+    const uint8_t* p = in + bit / 8;
+    const int shift = bit % 8;
+    uint64_t v = UNALIGNED_LOAD64(p) >> shift;
+    // Values wider than 56 bits may straddle nine bytes.
+    if (kWidth > 56 && shift > 0) {
+      v |= static_cast<uint64_t>(p[8]) << (64 - shift);
+    }
+    out[i] = v & kMask;
+  }
+}
+
+typedef void (*UnpackFunc)(const uint8_t* in, size_t n, uint64_t* out);
+
+#define UNPACK(w) &UnpackBitsOfWidth<w>
+const UnpackFunc kUnpackFuncs[] = {
+  UNPACK(0),  UNPACK(1),  UNPACK(2),  UNPACK(3),  UNPACK(4),  UNPACK(5),  UNPACK(6),  UNPACK(7),
+  UNPACK(8),  UNPACK(9),  UNPACK(10), UNPACK(11), UNPACK(12), UNPACK(13), UNPACK(14), UNPACK(15),
+  UNPACK(16), UNPACK(17), UNPACK(18), UNPACK(19), UNPACK(20), UNPACK(21), UNPACK(22), UNPACK(23),
+  UNPACK(24), UNPACK(25), UNPACK(26), UNPACK(27), UNPACK(28), UNPACK(29), UNPACK(30), UNPACK(31),
+  UNPACK(32), UNPACK(33), UNPACK(34), UNPACK(35), UNPACK(36), UNPACK(37), UNPACK(38), UNPACK(39),
+  UNPACK(40), UNPACK(41), UNPACK(42), UNPACK(43), UNPACK(44), UNPACK(45), UNPACK(46), UNPACK(47),
+  UNPACK(48), UNPACK(49), UNPACK(50), UNPACK(51), UNPACK(52), UNPACK(53), UNPACK(54), UNPACK(55),
+  UNPACK(56), UNPACK(57), UNPACK(58), UNPACK(59), UNPACK(60), UNPACK(61), UNPACK(62), UNPACK(63),
+  UNPACK(64)
+};
+#undef UNPACK
+
+} // anonymous namespace
+
+void PackBits(const uint64_t* vals, size_t n, int width, faststring* out) {
+  DCHECK_GE(width, 0);
+  DCHECK_LE(width, 64);
+  const size_t packed_size = (n * width + 7) / 8;
+  const size_t start = out->size();
+
+  // Leave room to OR in a whole word at the last value's offset.
+  out->resize(start + packed_size + sizeof(uint64_t) + 1);
+  uint8_t* dst = &(*out)[start];
+  memset(dst, 0, out->size() - start);
+  for (size_t i = 0; i < n; i++) {
+    DCHECK(width == 64 || vals[i] >> width == 0)
+        << vals[i] << " does not fit in " << width << " bits";
+    const size_t bit = i * width;
+    uint8_t* p = dst + bit / 8;
+    const int shift = bit % 8;
+    UNALIGNED_STORE64(p, UNALIGNED_LOAD64(p) | (vals[i] << shift));
+    if (shift > 0 && width + shift > 64) {
+      p[8] |= static_cast<uint8_t>(vals[i] >> (64 - shift));
+    }
+  }
+  out->resize(start + packed_size);
+}
+
+void UnpackBits(const uint8_t* in, size_t n, int width, uint64_t* out) {
+  DCHECK_GE(width, 0);
+  DCHECK_LE(width, 64);
+  kUnpackFuncs[width](in, n, out);
+}
+
+} // namespace cfile
+} // namespace kudu
@@ -0,0 +1,529 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// Frame-of-reference and delta encoding of integer blocks, with the
+// resulting offsets bit-packed at the narrowest width which fits them.
+// Reference:
+// https://github.com/lemire/FastPFor
+#ifndef KUDU_CFILE_FOR_BLOCK_H
+#define KUDU_CFILE_FOR_BLOCK_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "kudu/cfile/block_encodings.h"
+#include "kudu/cfile/cfile_util.h"
+#include "kudu/common/columnblock.h"
+#include "kudu/common/rowid.h"
+#include "kudu/common/types.h"
+#include "kudu/gutil/bits.h"
+#include "kudu/gutil/port.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/coding.h"
+#include "kudu/util/coding-inl.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/slice.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+namespace cfile {
+
+// Appends the low 'width' bits of each of the 'n' values in 'vals' to 'out',
+// packed back to back in little-endian bit order and padded to a whole byte.
+void PackBits(const uint64_t* vals, size_t n, int width, faststring* out);
+
+// Unpacks 'n' values of 'width' bits each from 'in' into 'out'. Reads whole
+// 64-bit words, so up to kForPaddingBytes past the packed data must be
+// readable.
+void UnpackBits(const uint8_t* in, size_t n, int width, uint64_t* out);
+
+enum {
+  // The number of values in a mini-block, save for the last of a block.
+  kForMiniBlockSize = 128,
+
+  // The number of zero bytes which follow the last mini-block, so that
+  // UnpackBits() never reads past the end of the block.
+  kForPaddingBytes = 16,
+
+  // Flag set in a mini-block's descriptor if its values are delta-encoded.
+  kForDeltaFlag = 0x80,
+};
+
+// ForBlockBuilder splits the values of a block into mini-blocks of
+// kForMiniBlockSize values. Each mini-block is stored as offsets from a
+// reference value, bit-packed at the width of the largest offset. The
+// offsets are either those of the values from their minimum (frame of
+// reference), or those of the differences between consecutive values from
+// their minimum (delta); whichever is smaller is used. Delta encoding suits
+// monotonically increasing keys and timestamps, while frame of reference
+// suits values which are clustered but unordered.
+//
+// Since every mini-block can be decoded on its own, seeking to an ordinal
+// only decodes the mini-block holding it, and seeking to a value only decodes
+// the first value of O(log n) mini-blocks and one mini-block in full.
+//
+// The block format is as follows:
+//
+// 1. Header: (8 bytes total)
+//
+//    <first_ordinal> [32-bit]
+//      The ordinal offset of the first element in the block.
+//
+//    <num_elements> [32-bit]
+//      The number of elements encoded in the block.
+//
+// 2. Mini-block descriptors: (1 byte per mini-block)
+//
+//    The low 7 bits hold the width in bits of the mini-block's packed
+//    offsets. kForDeltaFlag is set if it is delta-encoded.
+//
+// 3. Mini-blocks, one after another:
+//
+//    <reference> [size of type]
+//      The minimum value for frame of reference, or the first value for
+//      delta encoding.
+//
+//    <min_delta> [size of type] (delta encoding only)
+//      The minimum difference between consecutive values.
+//
+//    <packed offsets>
+//      One offset per value, or per value after the first for delta
+//      encoding, padded to a whole byte.
+//
+// 4. kForPaddingBytes zero bytes.
+//
+//   NOTE: all on-disk ints are encoded little-endian
+//
+template<DataType Type>
+class ForBlockBuilder final : public BlockBuilder {
+ public:
+  explicit ForBlockBuilder(const WriterOptions* options)
+      : options_(options) {
+    Reset();
+  }
+
+  void Reset() OVERRIDE {
+    count_ = 0;
+    pending_.clear();
+    descriptors_.clear();
+    mini_blocks_.clear();
+    buffer_.clear();
+  }
+
+  bool IsBlockFull() const override {
+    size_t estimated_size = kHeaderSize + descriptors_.size() + mini_blocks_.size() +
+        pending_.size() * sizeof(CppType);
+    return estimated_size > static_cast<size_t>(options_->storage_attributes.cfile_block_size);
+  }
+
+  int Add(const uint8_t* vals_void, size_t count) OVERRIDE {
+    const CppType* vals = reinterpret_cast<const CppType*>(vals_void);
+    if (count > 0) {
+      if (count_ == 0) {
+        first_key_ = vals[0];
+      }
+      last_key_ = vals[count - 1];
+    }
+    for (size_t i = 0; i < count; i++) {
+      pending_.push_back(vals[i]);
+      if (pending_.size() == kForMiniBlockSize) {
+        FlushMiniBlock();
+      }
+    }
+    count_ += count;
+    return count;
+  }
+
+  size_t Count() const OVERRIDE {
+    return count_;
+  }
+
+  Status GetFirstKey(void* key) const OVERRIDE {
+    if (count_ == 0) {
+      return Status::NotFound("no keys in data block");
+    }
+    memcpy(key, &first_key_, sizeof(CppType));
+    return Status::OK();
+  }
+
+  Status GetLastKey(void* key) const OVERRIDE {
+    if (count_ == 0) {
+      return Status::NotFound("no keys in data block");
+    }
+    memcpy(key, &last_key_, sizeof(CppType));
+    return Status::OK();
+  }
+
+  Slice Finish(rowid_t ordinal_pos) OVERRIDE {
+    if (!pending_.empty()) {
+      FlushMiniBlock();
+    }
+    buffer_.resize(kHeaderSize);
+    InlineEncodeFixed32(&buffer_[0], ordinal_pos);
+    InlineEncodeFixed32(&buffer_[4], count_);
+    buffer_.append(descriptors_.data(), descriptors_.size());
+    buffer_.append(mini_blocks_.data(), mini_blocks_.size());
+    buffer_.resize(buffer_.size() + kForPaddingBytes);
+    memset(&buffer_[buffer_.size() - kForPaddingBytes], 0, kForPaddingBytes);
+    return Slice(buffer_);
+  }
+
+ private:
+  typedef typename TypeTraits<Type>::cpp_type CppType;
+  typedef typename std::make_unsigned<CppType>::type UnsignedType;
+  typedef typename std::make_signed<CppType>::type SignedType;
+
+  static int BitWidth(uint64_t max_offset) {
+    return max_offset == 0 ? 0 : Bits::Log2FloorNonZero64(max_offset) + 1;
+  }
+
+  static size_t PackedSize(size_t n, int width) {
+    return (n * width + 7) / 8;
+  }
+
+  void AppendValue(CppType val) {
+    mini_blocks_.append(&val, sizeof(val));
+  }
+
+  // Encodes the values in 'pending_' as a mini-block, picking whichever of
+  // frame of reference and delta encoding is smaller.
+  void FlushMiniBlock() {
+    const size_t n = pending_.size();
+    DCHECK_GT(n, 0);
+    DCHECK_LE(n, kForMiniBlockSize);
+
+    CppType min_val = pending_[0];
+    CppType max_val = pending_[0];
+    SignedType min_delta = 0;
+    SignedType max_delta = 0;
+    for (size_t i = 1; i < n; i++) {
+      min_val = std::min(min_val, pending_[i]);
+      max_val = std::max(max_val, pending_[i]);
+      SignedType delta = static_cast<SignedType>(static_cast<UnsignedType>(
+          static_cast<UnsignedType>(pending_[i]) - static_cast<UnsignedType>(pending_[i - 1])));
+      if (i == 1) {
+        min_delta = delta;
+        max_delta = delta;
+      } else {
+        min_delta = std::min(min_delta, delta);
+        max_delta = std::max(max_delta, delta);
+      }
+    }
+
+    const int for_width = BitWidth(static_cast<UnsignedType>(
+        static_cast<UnsignedType>(max_val) - static_cast<UnsignedType>(min_val)));
+    const int delta_width = BitWidth(static_cast<UnsignedType>(
+        static_cast<UnsignedType>(max_delta) - static_cast<UnsignedType>(min_delta)));
+    const size_t for_size = PackedSize(n, for_width);
+    const size_t delta_size = sizeof(CppType) + PackedSize(n - 1, delta_width);
+
+    uint64_t offsets[kForMiniBlockSize];
+    if (n > 1 && delta_size < for_size) {
+      descriptors_.push_back(kForDeltaFlag | delta_width);
+      AppendValue(pending_[0]);
+      AppendValue(static_cast<CppType>(min_delta));
+      for (size_t i = 1; i < n; i++) {
+        offsets[i - 1] = static_cast<UnsignedType>(
+            static_cast<UnsignedType>(pending_[i]) - static_cast<UnsignedType>(pending_[i - 1]) -
+            static_cast<UnsignedType>(min_delta));
+      }
+      PackBits(offsets, n - 1, delta_width, &mini_blocks_);
+    } else {
+      descriptors_.push_back(for_width);
+      AppendValue(min_val);
+      for (size_t i = 0; i < n; i++) {
+        offsets[i] = static_cast<UnsignedType>(
+            static_cast<UnsignedType>(pending_[i]) - static_cast<UnsignedType>(min_val));
+      }
+      PackBits(offsets, n, for_width, &mini_blocks_);
+    }
+    pending_.clear();
+  }
+
+  // Length of a header.
+  static const size_t kHeaderSize = sizeof(uint32_t) * 2;
+
+  // The values added since the last full mini-block.
+  std::vector<CppType> pending_;
+
+  faststring descriptors_;
+  faststring mini_blocks_;
+  faststring buffer_;
+  uint32_t count_;
+  CppType first_key_;
+  CppType last_key_;
+  const WriterOptions* options_;
+};
+
+template<DataType Type>
+class ForBlockDecoder final : public BlockDecoder {
+ public:
+  explicit ForBlockDecoder(Slice slice)
+      : data_(slice),
+        parsed_(false),
+        ordinal_pos_base_(0),
+        num_elems_(0),
+        cur_idx_(0),
+        decoded_mini_block_(-1) {
+  }
+
+  Status ParseHeader() OVERRIDE {
+    CHECK(!parsed_);
+    if (data_.size() < kHeaderSize) {
+      return Status::Corruption(
+          strings::Substitute("not enough bytes for header: frame of reference block header "
+                              "size ($0) less than expected header length ($1)",
+                              data_.size(), kHeaderSize));
+    }
+
+    ordinal_pos_base_ = DecodeFixed32(&data_[0]);
+    num_elems_ = DecodeFixed32(&data_[4]);
+
+    const size_t num_mini_blocks = (num_elems_ + kForMiniBlockSize - 1) / kForMiniBlockSize;
+    if (data_.size() < kHeaderSize + num_mini_blocks) {
+      return Status::Corruption(
+          strings::Substitute("not enough bytes for $0 mini-block descriptors",
+                              num_mini_blocks));
+    }
+    descriptors_ = &data_[kHeaderSize];
+
+    // Compute where each mini-block starts, so that any of them may be
+    // decoded without looking at the others.
+    mini_block_offsets_.resize(num_mini_blocks);
+    size_t offset = kHeaderSize + num_mini_blocks;
+    for (size_t i = 0; i < num_mini_blocks; i++) {
+      const int width = descriptors_[i] & ~kForDeltaFlag;
+      if (PREDICT_FALSE(width > static_cast<int>(sizeof(CppType) * 8))) {
+        return Status::Corruption(
+            strings::Substitute("invalid bit width $0 for mini-block $1", width, i));
+      }
+      const bool delta = descriptors_[i] & kForDeltaFlag;
+      const size_t n = MiniBlockCount(i);
+      const size_t num_packed = delta ? n - 1 : n;
+      mini_block_offsets_[i] = offset;
+      offset += (delta ? 2 : 1) * sizeof(CppType) + (num_packed * width + 7) / 8;
+    }
+    if (data_.size() < offset + kForPaddingBytes) {
+      return Status::Corruption(
+          strings::Substitute("frame of reference block size ($0) less than expected ($1)",
+                              data_.size(), offset + kForPaddingBytes));
+    }
+
+    parsed_ = true;
+    return Status::OK();
+  }
+
+  void SeekToPositionInBlock(uint pos) OVERRIDE {
+    CHECK(parsed_) << "Must call ParseHeader()";
+    if (PREDICT_FALSE(num_elems_ == 0)) {
+      DCHECK_EQ(0, pos);
+      return;
+    }
+
+    DCHECK_LE(pos, num_elems_);
+    cur_idx_ = pos;
+  }
+
+  Status SeekAtOrAfterValue(const void* value_void, bool* exact) OVERRIDE {
+    CHECK(parsed_) << "Must call ParseHeader()";
+    CppType target = *reinterpret_cast<const CppType*>(value_void);
+    if (PREDICT_FALSE(num_elems_ == 0)) {
+      return Status::NotFound("after last key in block");
+    }
+
+    // Find the last mini-block whose first value is before the target. Every
+    // earlier mini-block ends before the target too, so the first value at or
+    // after it is either in this mini-block or starts the next one. The strict
+    // comparison matters when runs of equal values span mini-blocks.
+    int32_t left = 0;
+    int32_t right = mini_block_offsets_.size();
+    while (right - left > 1) {
+      int32_t mid = (left + right) / 2;
+      if (MiniBlockFirstValue(mid) < target) {
+        left = mid;
+      } else {
+        right = mid;
+      }
+    }
+
+    DecodeMiniBlockIfNeeded(left);
+    const size_t n = MiniBlockCount(left);
+    const CppType* begin = mini_block_values_;
+    const CppType* end = begin + n;
+    const CppType* it = std::lower_bound(begin, end, target);
+    cur_idx_ = left * kForMiniBlockSize + (it - begin);
+    if (cur_idx_ == num_elems_) {
+      *exact = false;
+      return Status::NotFound("after last key in block");
+    }
+    // If every value of the mini-block is before the target, we're positioned
+    // at the start of the next one.
+    if (it == end) {
+      *exact = MiniBlockFirstValue(left + 1) == target;
+    } else {
+      *exact = *it == target;
+    }
+    return Status::OK();
+  }
+
+  Status CopyNextValues(size_t* n, ColumnDataView* dst) OVERRIDE {
+    DCHECK_EQ(dst->stride(), sizeof(CppType));
+    return CopyNextValuesToArray(n, dst->data());
+  }
+
+  Status CopyNextValuesToArray(size_t* n, uint8_t* array) {
+    DCHECK(parsed_);
+    if (PREDICT_FALSE(*n == 0 || cur_idx_ >= num_elems_)) {
+      *n = 0;
+      return Status::OK();
+    }
+
+    const size_t max_fetch = std::min(*n, static_cast<size_t>(num_elems_ - cur_idx_));
+    CppType* out = reinterpret_cast<CppType*>(array);
+    size_t remaining = max_fetch;
+    while (remaining > 0) {
+      const int mini_block = cur_idx_ / kForMiniBlockSize;
+      const size_t offset = cur_idx_ % kForMiniBlockSize;
+      const size_t mini_block_count = MiniBlockCount(mini_block);
+      const size_t to_copy = std::min(remaining, mini_block_count - offset);
+      if (offset == 0 && to_copy == mini_block_count) {
+        // The whole mini-block is wanted: decode it straight into the output.
+        DecodeMiniBlock(mini_block, out);
+      } else {
+        DecodeMiniBlockIfNeeded(mini_block);
+        memcpy(out, &mini_block_values_[offset], to_copy * sizeof(CppType));
+      }
+      out += to_copy;
+      cur_idx_ += to_copy;
+      remaining -= to_copy;
+    }
+
+    *n = max_fetch;
+    return Status::OK();
+  }
+
+  size_t GetCurrentIndex() const OVERRIDE {
+    DCHECK(parsed_) << "must parse header first";
+    return cur_idx_;
+  }
+
+  virtual rowid_t GetFirstRowId() const OVERRIDE {
+    return ordinal_pos_base_;
+  }
+
+  size_t Count() const OVERRIDE {
+    return num_elems_;
+  }
+
+  bool HasNext() const OVERRIDE {
+    return cur_idx_ < num_elems_;
+  }
+
+ private:
+  typedef typename TypeTraits<Type>::cpp_type CppType;
+  typedef typename std::make_unsigned<CppType>::type UnsignedType;
+
+  template<typename T>
+  static T Decode(const uint8_t* ptr) {
+    T result;
+    memcpy(&result, ptr, sizeof(result));
+    return result;
+  }
+
+  size_t MiniBlockCount(int mini_block) const {
+    return std::min<size_t>(kForMiniBlockSize, num_elems_ - mini_block * kForMiniBlockSize);
+  }
+
+  CppType MiniBlockFirstValue(int mini_block) const {
+    const uint8_t* in = &data_[mini_block_offsets_[mini_block]];
+    const uint8_t descriptor = descriptors_[mini_block];
+    CppType reference = Decode<CppType>(in);
+    if (descriptor & kForDeltaFlag) {
+      return reference;
+    }
+    uint64_t offset;
+    UnpackBits(in + sizeof(CppType), 1, descriptor, &offset);
+    return static_cast<CppType>(static_cast<UnsignedType>(
+        static_cast<UnsignedType>(reference) + static_cast<UnsignedType>(offset)));
+  }
+
+  // Decodes all the values of 'mini_block' into 'out'.
+  void DecodeMiniBlock(int mini_block, CppType* out) const {
+    const uint8_t* in = &data_[mini_block_offsets_[mini_block]];
+    const uint8_t descriptor = descriptors_[mini_block];
+    const int width = descriptor & ~kForDeltaFlag;
+    const size_t n = MiniBlockCount(mini_block);
+    const UnsignedType reference = Decode<UnsignedType>(in);
+    in += sizeof(CppType);
+
+    uint64_t offsets[kForMiniBlockSize];
+    if (descriptor & kForDeltaFlag) {
+      const UnsignedType min_delta = Decode<UnsignedType>(in);
+      in += sizeof(CppType);
+      UnpackBits(in, n - 1, width, offsets);
+      UnsignedType cur = reference;
+      out[0] = static_cast<CppType>(cur);
+      for (size_t i = 1; i < n; i++) {
+        cur += min_delta + static_cast<UnsignedType>(offsets[i - 1]);
+        out[i] = static_cast<CppType>(cur);
+      }
+    } else {
+      UnpackBits(in, n, width, offsets);
+      for (size_t i = 0; i < n; i++) {
+        out[i] = static_cast<CppType>(static_cast<UnsignedType>(
+            reference + static_cast<UnsignedType>(offsets[i])));
+      }
+    }
+  }
+
+  void DecodeMiniBlockIfNeeded(int mini_block) {
+    if (decoded_mini_block_ != mini_block) {
+      DecodeMiniBlock(mini_block, mini_block_values_);
+      decoded_mini_block_ = mini_block;
+    }
+  }
+
+  // Length of a header.
+  static const size_t kHeaderSize = sizeof(uint32_t) * 2;
+
+  Slice data_;
+  bool parsed_;
+
+  rowid_t ordinal_pos_base_;
+  uint32_t num_elems_;
+
+  const uint8_t* descriptors_;
+
+  // The offset within 'data_' of each mini-block.
+  std::vector<uint32_t> mini_block_offsets_;
+
+  size_t cur_idx_;
+
+  // The values of mini-block 'decoded_mini_block_', or -1 if none has been
+  // decoded yet.
+  int decoded_mini_block_;
+  CppType mini_block_values_[kForMiniBlockSize];
+};
+
+} // namespace cfile
+} // namespace kudu
+#endif
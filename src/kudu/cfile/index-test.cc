@@ -19,6 +19,7 @@
 #include <cstdio>
 #include <cstring>
 #include <string>
+#include <vector>
 
 #include <glog/logging.h>
 #include <gtest/gtest.h>
@@ -30,12 +31,17 @@
 #include "kudu/common/key_encoder.h"
 #include "kudu/gutil/endian.h"
 #include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/faststring.h"
 #include "kudu/util/hexdump.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/status.h"
 #include "kudu/util/test_macros.h"
 
+using std::string;
+using std::vector;
+using strings::Substitute;
+
 namespace kudu {
 namespace cfile {
 
@@ -336,6 +342,65 @@ TEST(TestIndexBlock, TestIterator) {
   ASSERT_TRUE(iter->HasNext());
 }
 
+// Test that prefix-compressed index blocks are smaller than ones storing
+// full keys, and that seeking works within and across restart intervals.
+TEST(TestIndexBlock, TestPrefixCompression) {
+  const int kNumEntries = 1000;
+  vector<string> keys;
+  for (int i = 0; i < kNumEntries; i++) {
+    keys.push_back(Substitute("composite-key-prefix-$0-suffix", 10000 + i * 2));
+  }
+
+  size_t full_key_block_size = 0;
+  for (int restart_interval : { 0, 1, 3, 16 }) {
+    SCOPED_TRACE(restart_interval);
+    WriterOptions opts;
+    opts.index_block_restart_interval = restart_interval;
+    IndexBlockBuilder idx(&opts, true);
+    for (int i = 0; i < kNumEntries; i++) {
+      idx.Add(keys[i], BlockPointer(100000 + i, 64 * 1024));
+    }
+    Slice first_key;
+    ASSERT_OK(idx.GetFirstKey(&first_key));
+    ASSERT_EQ(keys[0], first_key);
+    size_t est_size = idx.EstimateEncodedSize();
+    Slice s = idx.Finish();
+    EXPECT_LE(s.size(), est_size);
+    if (restart_interval == 0) {
+      full_key_block_size = s.size();
+    } else if (restart_interval > 1) {
+      EXPECT_LT(s.size(), full_key_block_size);
+    }
+
+    IndexBlockReader reader;
+    ASSERT_OK(reader.Parse(s));
+    ASSERT_EQ(kNumEntries, static_cast<int>(reader.Count()));
+    gscoped_ptr<IndexBlockIterator> iter(reader.NewIterator());
+    for (int i = 0; i < kNumEntries; i++) {
+      // Seek to the exact key, and to one between it and the next key.
+      ASSERT_OK(iter->SeekAtOrBefore(keys[i]));
+      ASSERT_EQ(keys[i], iter->GetCurrentKey());
+      ASSERT_EQ(100000U + i, iter->GetCurrentBlockPointer().offset());
+      ASSERT_OK(iter->SeekAtOrBefore(keys[i] + "-"));
+      ASSERT_EQ(keys[i], iter->GetCurrentKey());
+
+      ASSERT_OK(iter->SeekToIndex(i));
+      ASSERT_EQ(keys[i], iter->GetCurrentKey());
+    }
+    ASSERT_TRUE(iter->SeekAtOrBefore("composite").IsNotFound());
+
+    // Iterate through the whole block.
+    ASSERT_OK(iter->SeekToIndex(0));
+    for (int i = 1; i < kNumEntries; i++) {
+      ASSERT_TRUE(iter->HasNext());
+      ASSERT_OK(iter->Next());
+      ASSERT_EQ(keys[i], iter->GetCurrentKey());
+      ASSERT_EQ(100000U + i, iter->GetCurrentBlockPointer().offset());
+    }
+    ASSERT_FALSE(iter->HasNext());
+  }
+}
+
 TEST(TestIndexKeys, TestGetSeparatingKey) {
   // Test example cases
   Slice left = "";
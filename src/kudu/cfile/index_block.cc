@@ -17,12 +17,14 @@
 
 #include "kudu/cfile/index_block.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <ostream>
 #include <string>
 
 #include <glog/logging.h>
 
+#include "kudu/cfile/cfile_util.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/coding-inl.h"
@@ -61,7 +63,10 @@ IndexBlockBuilder::IndexBlockBuilder(
   bool is_leaf)
   : options_(options),
     finished_(false),
-    is_leaf_(is_leaf) {
+    is_leaf_(is_leaf),
+    restart_interval_(options->index_block_restart_interval),
+    num_entries_(0) {
+  DCHECK_GE(restart_interval_, 0);
 }
 
 
@@ -71,9 +76,24 @@ void IndexBlockBuilder::Add(const Slice &keyptr,
     "Must Reset() after Finish() before more Add()";
 
   size_t entry_offset = buffer_.size();
-  SliceEncode(keyptr, &buffer_);
+  if (restart_interval_ == 0) {
+    SliceEncode(keyptr, &buffer_);
+    entry_offsets_.push_back(entry_offset);
+  } else {
+    // Add "<shared><non_shared><non-shared key bytes>".
+    size_t shared = 0;
+    if (num_entries_ % restart_interval_ == 0) {
+      entry_offsets_.push_back(entry_offset);
+    } else {
+      shared = CommonPrefixLength(Slice(last_key_), keyptr);
+    }
+    InlinePutVarint32(&buffer_, shared);
+    InlinePutVarint32(&buffer_, keyptr.size() - shared);
+    buffer_.append(keyptr.data() + shared, keyptr.size() - shared);
+    last_key_.assign_copy(keyptr.data(), keyptr.size());
+  }
   ptr.EncodeTo(&buffer_);
-  entry_offsets_.push_back(entry_offset);
+  num_entries_++;
 }
 
 Slice IndexBlockBuilder::Finish() {
@@ -84,9 +104,12 @@ Slice IndexBlockBuilder::Finish() {
   }
 
   IndexBlockTrailerPB trailer;
-  trailer.set_num_entries(entry_offsets_.size());
+  trailer.set_num_entries(num_entries_);
   trailer.set_type(
     is_leaf_ ? IndexBlockTrailerPB::LEAF : IndexBlockTrailerPB::INTERNAL);
+  if (restart_interval_ > 0) {
+    trailer.set_restart_interval(restart_interval_);
+  }
   AppendPBToString(trailer, &buffer_);
 
   InlinePutFixed32(&buffer_, trailer.GetCachedSize());
@@ -105,7 +128,16 @@ Status IndexBlockBuilder::GetFirstKey(Slice *key) const {
     return Status::NotFound("no keys in builder");
   }
 
-  bool success = nullptr != SliceDecode(buffer_.data(),buffer_.data() + buffer_.size(),key);
+  const uint8_t *ptr = buffer_.data();
+  const uint8_t *limit = buffer_.data() + buffer_.size();
+  if (restart_interval_ > 0) {
+    // The first entry is a restart point, so it shares nothing with its
+    // (non-existent) predecessor.
+    uint32_t shared;
+    ptr = GetVarint32Ptr(ptr, limit, &shared);
+    DCHECK(ptr == nullptr || shared == 0);
+  }
+  bool success = ptr != nullptr && SliceDecode(ptr, limit, key) != nullptr;
 
   if (success) {
     return Status::OK();
@@ -118,7 +150,7 @@ size_t IndexBlockBuilder::EstimateEncodedSize() const {
   // the actual encoded index entries
   int size = buffer_.size();
 
-  // entry offsets
+  // entry offsets (only of the restart points, if prefix-compressed)
   size += sizeof(uint32_t) * entry_offsets_.size();
 
   // estimate trailer cheaply -- not worth actually constructing
@@ -131,7 +163,10 @@ size_t IndexBlockBuilder::EstimateEncodedSize() const {
 // Construct a reader.
 // After construtoin, call
 IndexBlockReader::IndexBlockReader()
-  : parsed_(false) {
+  : key_offsets_(nullptr),
+    restart_interval_(1),
+    num_restarts_(0),
+    parsed_(false) {
 }
 
 void IndexBlockReader::Reset() {
@@ -169,8 +204,18 @@ Status IndexBlockReader::Parse(const Slice &data) {
       trailer_.InitializationErrorString());
   }
 
-  key_offsets_ = trailer_ptr - sizeof(uint32_t) * trailer_.num_entries();
-  CHECK(trailer_ptr >= data_.data());
+  if (PREDICT_FALSE(trailer_.num_entries() < 0)) {
+    return Status::Corruption(strings::Substitute(
+        "invalid number of index block entries: $0", trailer_.num_entries()));
+  }
+  restart_interval_ = IsPrefixCompressed() ? trailer_.restart_interval() : 1;
+  num_restarts_ = (trailer_.num_entries() + restart_interval_ - 1) / restart_interval_;
+  if (PREDICT_FALSE(num_restarts_ * sizeof(uint32_t) >
+                    static_cast<size_t>(trailer_ptr - data_.data()))) {
+    return Status::Corruption(strings::Substitute(
+        "index block too small for $0 restart points", num_restarts_));
+  }
+  key_offsets_ = trailer_ptr - sizeof(uint32_t) * num_restarts_;
 
   VLOG(2) << "Parsed index trailer: " << pb_util::SecureDebugString(trailer_);
 
@@ -192,10 +237,20 @@ bool IndexBlockReader::IsLeaf() {
   return trailer_.type() == IndexBlockTrailerPB::LEAF;
 }
 
-int IndexBlockReader::CompareKey(int idx_in_block,
+int IndexBlockReader::CompareKey(int restart_idx,
                                  const Slice &search_key) const {
   const uint8_t *key_ptr, *limit;
-  GetKeyPointer(idx_in_block, &key_ptr, &limit);
+  GetKeyPointer(restart_idx, &key_ptr, &limit);
+  if (IsPrefixCompressed()) {
+    // Keys at restart points are stored in full, with a zero-length
+    // shared prefix.
+    uint32_t shared;
+    key_ptr = GetVarint32Ptr(key_ptr, limit, &shared);
+    if (PREDICT_FALSE(key_ptr == nullptr || shared != 0)) {
+      LOG(WARNING)<< "Invalid data in block!";
+      return 0;
+    }
+  }
   Slice this_slice;
   if (PREDICT_FALSE(SliceDecode(key_ptr, limit, &this_slice) == nullptr)) {
     LOG(WARNING)<< "Invalid data in block!";
@@ -205,36 +260,51 @@ int IndexBlockReader::CompareKey(int idx_in_block,
   return this_slice.compare(search_key);
 }
 
-Status IndexBlockReader::ReadEntry(size_t idx, Slice *key, BlockPointer *block_ptr) const {
-  if (idx >= trailer_.num_entries()) {
-    return Status::NotFound("Invalid index");
-  }
-
+Status IndexBlockReader::DecodeEntry(const uint8_t *ptr, const Slice &prev_key,
+                                     faststring *key_buf, Slice *key,
+                                     BlockPointer *block_ptr, const uint8_t **next) const {
   // At 'ptr', data is encoded as follows:
   // <key> <block offset> <block length>
-
-  const uint8_t *ptr, *limit;
-  GetKeyPointer(idx, &ptr, &limit);
-
-  ptr = SliceDecode(ptr, limit, key);
-  if (ptr == nullptr) {
-    return Status::Corruption("Invalid key in index");
+  //
+  // or, in prefix-compressed blocks:
+  // <shared> <non_shared> <non-shared key bytes> <block offset> <block length>
+  const uint8_t *limit = key_offsets_;
+  if (!IsPrefixCompressed()) {
+    ptr = SliceDecode(ptr, limit, key);
+    if (ptr == nullptr) {
+      return Status::Corruption("Invalid key in index");
+    }
+  } else {
+    uint32_t shared, non_shared;
+    if ((ptr = GetVarint32Ptr(ptr, limit, &shared)) == nullptr ||
+        (ptr = GetVarint32Ptr(ptr, limit, &non_shared)) == nullptr ||
+        shared > prev_key.size() ||
+        static_cast<size_t>(limit - ptr) < non_shared) {
+      return Status::Corruption("Invalid key in index");
+    }
+    if (shared == 0) {
+      *key = Slice(ptr, non_shared);
+    } else {
+      key_buf->assign_copy(prev_key.data(), shared);
+      key_buf->append(ptr, non_shared);
+      *key = Slice(*key_buf);
+    }
+    ptr += non_shared;
   }
 
-  return block_ptr->DecodeFrom(ptr, data_.data() + data_.size());
+  return block_ptr->DecodeFrom(ptr, limit, next);
 }
 
-void IndexBlockReader::GetKeyPointer(int idx_in_block, const uint8_t **ptr,
+void IndexBlockReader::GetKeyPointer(int restart_idx, const uint8_t **ptr,
                                      const uint8_t **limit) const {
   size_t offset_in_block = DecodeFixed32(
-    &key_offsets_[idx_in_block * sizeof(uint32_t)]);
+    &key_offsets_[restart_idx * sizeof(uint32_t)]);
   *ptr = data_.data() + offset_in_block;
 
-  int next_idx = idx_in_block + 1;
+  size_t next_idx = restart_idx + 1;
 
-  if (PREDICT_FALSE(next_idx >= trailer_.num_entries())) {
-    DCHECK(next_idx == Count()) << "Bad index: " << idx_in_block
-                                << " Count: " << Count();
+  if (PREDICT_FALSE(next_idx >= num_restarts_)) {
+    DCHECK_EQ(next_idx, num_restarts_) << "Bad index: " << restart_idx;
     // last key in block: limit is the beginning of the offsets array
     *limit = key_offsets_;
   } else {
@@ -248,23 +318,31 @@ void IndexBlockReader::GetKeyPointer(int idx_in_block, const uint8_t **ptr,
 void IndexBlockBuilder::Reset() {
   buffer_.clear();
   entry_offsets_.clear();
+  num_entries_ = 0;
+  last_key_.clear();
   finished_ = false;
 }
 
 IndexBlockIterator::IndexBlockIterator(const IndexBlockReader *reader)
   : reader_(reader),
     cur_idx_(-1),
-    seeked_(false) {
+    seeked_(false),
+    next_entry_(nullptr),
+    cur_key_buf_(0) {
 }
 
 void IndexBlockIterator::Reset() {
   seeked_ = false;
   cur_idx_ = -1;
+  next_entry_ = nullptr;
 }
 
 Status IndexBlockIterator::SeekAtOrBefore(const Slice &search_key) {
+  // Binary search for the last restart point whose key is <= the search
+  // key. Keys at restart points are stored in full, so none of the other
+  // entries need to be decoded.
   size_t left = 0;
-  size_t right = reader_->Count() - 1;
+  size_t right = reader_->num_restarts_ - 1;
   while (left < right) {
     int mid = (left + right + 1) / 2;
 
@@ -288,14 +366,68 @@ Status IndexBlockIterator::SeekAtOrBefore(const Slice &search_key) {
     return Status::NotFound("key not present");
   }
 
-  return SeekToIndex(left);
+  RETURN_NOT_OK(SeekToRestartPoint(left));
+
+  // Scan the rest of the restart interval for the last key <= the search
+  // key. The next restart point's key is known to be greater.
+  size_t end = std::min(reader_->Count(), (left + 1) * reader_->restart_interval_);
+  while (cur_idx_ + 1 < end) {
+    Slice key;
+    BlockPointer ptr;
+    const uint8_t *next;
+    RETURN_NOT_OK(PeekNext(&key, &ptr, &next));
+    if (key.compare(search_key) > 0) {
+      break;
+    }
+    AdvanceTo(key, ptr, next);
+  }
+  return Status::OK();
 }
 
 Status IndexBlockIterator::SeekToIndex(size_t idx) {
-  cur_idx_ = idx;
-  Status s = reader_->ReadEntry(idx, &cur_key_, &cur_ptr_);
+  if (idx >= reader_->Count()) {
+    seeked_ = false;
+    return Status::NotFound("Invalid index");
+  }
+  RETURN_NOT_OK(SeekToRestartPoint(idx / reader_->restart_interval_));
+  while (cur_idx_ < idx) {
+    RETURN_NOT_OK(Next());
+  }
+  return Status::OK();
+}
+
+Status IndexBlockIterator::SeekToRestartPoint(size_t restart_idx) {
+  const uint8_t *ptr, *limit;
+  reader_->GetKeyPointer(restart_idx, &ptr, &limit);
+  cur_idx_ = restart_idx * reader_->restart_interval_ - 1;
+  next_entry_ = ptr;
+  seeked_ = true;
+
+  Slice key;
+  BlockPointer block_ptr;
+  const uint8_t *next;
+  Status s = PeekNext(&key, &block_ptr, &next);
   seeked_ = s.ok();
-  return s;
+  RETURN_NOT_OK(s);
+  AdvanceTo(key, block_ptr, next);
+  return Status::OK();
+}
+
+Status IndexBlockIterator::PeekNext(Slice *key, BlockPointer *ptr, const uint8_t **next) {
+  DCHECK(seeked_);
+  // Restart points don't depend on the previous key.
+  Slice prev_key = (cur_idx_ + 1) % reader_->restart_interval_ == 0 ? Slice() : cur_key_;
+  return reader_->DecodeEntry(next_entry_, prev_key, &key_bufs_[cur_key_buf_ ^ 1],
+                              key, ptr, next);
+}
+
+void IndexBlockIterator::AdvanceTo(const Slice &key, const BlockPointer &ptr,
+                                   const uint8_t *next) {
+  cur_idx_++;
+  cur_key_ = key;
+  cur_ptr_ = ptr;
+  next_entry_ = next;
+  cur_key_buf_ ^= 1;
 }
 
 bool IndexBlockIterator::HasNext() const {
@@ -303,7 +435,20 @@ bool IndexBlockIterator::HasNext() const {
 }
 
 Status IndexBlockIterator::Next() {
-  return SeekToIndex(cur_idx_ + 1);
+  if (!seeked_) {
+    return SeekToIndex(cur_idx_ + 1);
+  }
+  if (!HasNext()) {
+    return Status::NotFound("Invalid index");
+  }
+  Slice key;
+  BlockPointer ptr;
+  const uint8_t *next;
+  Status s = PeekNext(&key, &ptr, &next);
+  seeked_ = s.ok();
+  RETURN_NOT_OK(s);
+  AdvanceTo(key, ptr, next);
+  return Status::OK();
 }
 
 const BlockPointer &IndexBlockIterator::GetCurrentBlockPointer() const {
@@ -41,6 +41,12 @@ struct WriterOptions;
 // This works like the rest of the builders in the cfile package.
 // After repeatedly calling Add(), call Finish() to encode it
 // into a Slice, then you may Reset to re-use buffers.
+//
+// If WriterOptions::index_block_restart_interval is non-zero, keys are
+// prefix-compressed against their predecessors in the same way as
+// BinaryPrefixBlockBuilder does it: every 'restart_interval' entries a
+// "restart point" stores its key in full, and only the restart points
+// are listed in the block's offset array.
 class IndexBlockBuilder {
  public:
   explicit IndexBlockBuilder(const WriterOptions *options,
@@ -63,7 +69,7 @@ class IndexBlockBuilder {
   // Return the number of entries already added to this index
   // block.
   size_t count() const {
-    return entry_offsets_.size();
+    return num_entries_;
   }
 
   // Return an estimate of the post-encoding size of this
@@ -78,9 +84,6 @@ class IndexBlockBuilder {
  private:
   DISALLOW_COPY_AND_ASSIGN(IndexBlockBuilder);
 
-#ifdef __clang__
-  __attribute__((__unused__))
-#endif
   const WriterOptions *options_;
 
   // Is the builder currently between Finish() and Reset()
@@ -89,8 +92,19 @@ class IndexBlockBuilder {
   // Is this a leaf block?
   bool is_leaf_;
 
+  // Number of entries between restart points, or 0 if keys are
+  // stored in full.
+  const int restart_interval_;
+
   faststring buffer_;
+
+  // The offsets of the restart points, or of all entries if keys are
+  // stored in full.
   std::vector<uint32_t> entry_offsets_;
+  size_t num_entries_;
+
+  // The last key added, which the next key is prefix-compressed against.
+  faststring last_key_;
 };
 
 class IndexBlockReader {
@@ -117,23 +131,41 @@ class IndexBlockReader {
  private:
   friend class IndexBlockIterator;
 
-  int CompareKey(int idx_in_block, const Slice &search_key) const;
+  // Compare the key of the given restart point against 'search_key'.
+  int CompareKey(int restart_idx, const Slice &search_key) const;
 
-  Status ReadEntry(size_t idx, Slice *key, BlockPointer *block_ptr) const;
+  // Decode the entry starting at 'ptr'.
+  //
+  // For prefix-compressed blocks, 'prev_key' must be the key of the previous
+  // entry. If the key shares a prefix with it, it is assembled in 'key_buf';
+  // otherwise '*key' points directly into the block.
+  //
+  // On success, sets '*next' to the beginning of the following entry.
+  Status DecodeEntry(const uint8_t *ptr, const Slice &prev_key, faststring *key_buf,
+                     Slice *key, BlockPointer *block_ptr, const uint8_t **next) const;
 
-  // Set *ptr to the beginning of the index data for the given index
-  // entry.
+  // Set *ptr to the beginning of the index data for the given restart
+  // point.
   // Set *limit to the 'limit' pointer for that entry (i.e a pointer
   // beyond which the data no longer is part of that entry).
   //   - *limit can be used to prevent overrunning in the case of a
   //     corrupted length varint or length prefix
-  void GetKeyPointer(int idx_in_block, const uint8_t **ptr, const uint8_t **limit) const;
+  void GetKeyPointer(int restart_idx, const uint8_t **ptr, const uint8_t **limit) const;
+
+  bool IsPrefixCompressed() const {
+    return trailer_.restart_interval() > 0;
+  }
 
   static const int kMaxTrailerSize = 64*1024;
   Slice data_;
 
   IndexBlockTrailerPB trailer_;
   const uint8_t *key_offsets_;
+
+  // Number of entries between restart points. Blocks whose keys are stored
+  // in full have a restart point at every entry.
+  size_t restart_interval_;
+  size_t num_restarts_;
   bool parsed_;
 
   DISALLOW_COPY_AND_ASSIGN(IndexBlockReader);
@@ -170,12 +202,31 @@ class IndexBlockIterator {
   const Slice GetCurrentKey() const;
 
  private:
+  // Position the iterator at the given restart point.
+  Status SeekToRestartPoint(size_t restart_idx);
+
+  // Decode the entry following the current one, without moving the
+  // iterator. The returned key remains valid until the next call to
+  // this function or AdvanceTo().
+  Status PeekNext(Slice *key, BlockPointer *ptr, const uint8_t **next);
+
+  // Move the iterator to the entry returned by PeekNext().
+  void AdvanceTo(const Slice &key, const BlockPointer &ptr, const uint8_t *next);
+
   const IndexBlockReader *reader_;
   size_t cur_idx_;
   Slice cur_key_;
   BlockPointer cur_ptr_;
   bool seeked_;
 
+  // The beginning of the entry following the current one.
+  const uint8_t *next_entry_;
+
+  // Prefix-compressed keys are assembled in these buffers: one holds the
+  // current key, and the other the key returned by PeekNext().
+  faststring key_bufs_[2];
+  int cur_key_buf_;
+
   DISALLOW_COPY_AND_ASSIGN(IndexBlockIterator);
 };
 
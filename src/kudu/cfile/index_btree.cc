@@ -28,6 +28,7 @@
 #include "kudu/cfile/index_btree.h"
 #include "kudu/fs/block_id.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/cache.h"
 #include "kudu/util/debug-util.h"
 
 using std::vector;
@@ -277,7 +278,8 @@ Status IndexTreeIterator::LoadBlock(const BlockPointer &block, int depth) {
     seeked = seeked_indexes_.back().get();
   }
 
-  RETURN_NOT_OK(reader_->ReadBlock(block, CFileReader::CACHE_BLOCK, &seeked->data));
+  RETURN_NOT_OK(reader_->ReadBlock(block, CFileReader::CACHE_BLOCK, &seeked->data,
+                                   Cache::HIGH_PRIORITY));
   seeked->block_ptr = block;
 
   // Parse the new block.
@@ -224,6 +224,12 @@ class PlainBlockDecoder final : public BlockDecoder {
     return ordinal_pos_base_;
   }
 
+  // Returns the value at index 'idx', regardless of the current position.
+  typename TypeTraits<Type>::cpp_type value_at_index(size_t idx) const {
+    DCHECK_LT(idx, num_elems_);
+    return Decode<CppType>(&data_[kPlainBlockHeaderSize + idx * size_of_type]);
+  }
+
  private:
 
   Slice data_;
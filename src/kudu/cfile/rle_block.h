@@ -24,13 +24,18 @@
 #include "kudu/gutil/port.h"
 #include "kudu/cfile/block_encodings.h"
 #include "kudu/cfile/cfile_util.h"
+#include "kudu/common/column_materialization_context.h"
+#include "kudu/common/column_predicate.h"
 #include "kudu/common/columnblock.h"
+#include "kudu/common/rowblock.h"
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/coding.h"
 #include "kudu/util/coding-inl.h"
 #include "kudu/util/hexdump.h"
 #include "kudu/util/bit-stream-utils.inline.h"
 #include "kudu/util/bitmap.h"
 #include "kudu/util/rle-encoding.h"
+#include "kudu/util/status.h"
 
 
 namespace kudu {
@@ -42,6 +47,36 @@ enum {
   kRleBitmapBlockHeaderSize = 8
 };
 
+// Copies the next 'n' values from 'decoder' into 'out' a run at a time,
+// evaluating the predicate of 'ctx' once per run rather than once per value.
+// The rows of runs which don't satisfy the predicate are cleared in 'sel',
+// and their values are not copied.
+template <DataType Type>
+Status CopyNextRunsAndEval(size_t n,
+                           ColumnMaterializationContext* ctx,
+                           RleDecoder<typename TypeTraits<Type>::cpp_type>* decoder,
+                           SelectionVectorView* sel,
+                           typename TypeTraits<Type>::cpp_type* out) {
+  typedef typename TypeTraits<Type>::cpp_type CppType;
+  size_t fetched = 0;
+  while (fetched < n) {
+    CppType val;
+    size_t run_length = decoder->GetNextRun(&val, n - fetched);
+    if (PREDICT_FALSE(run_length == 0)) {
+      return Status::Corruption(
+          strings::Substitute("unexpected end of RLE data: expected $0 more values",
+                              n - fetched));
+    }
+    if (ctx->pred()->EvaluateCell<Type>(&val)) {
+      std::fill(out + fetched, out + fetched + run_length, val);
+    } else {
+      sel->ClearBits(fetched, run_length);
+    }
+    fetched += run_length;
+  }
+  return Status::OK();
+}
+
 //
 // RLE encoder for the BOOL datatype: uses an RLE-encoded bitmap to
 // represent a bool column.
@@ -176,15 +211,8 @@ class RleBitMapBlockDecoder final : public BlockDecoder {
     }
 
     size_t bits_to_fetch = std::min(*n, static_cast<size_t>(num_elems_ - cur_idx_));
-    size_t remaining = bits_to_fetch;
-    uint8_t* data_ptr = dst->data();
-    // TODO : do this a word/byte at a time as opposed bit at a time
-    while (remaining > 0) {
-      bool result = rle_decoder_.Get(reinterpret_cast<bool*>(data_ptr));
-      DCHECK(result);
-      remaining--;
-      data_ptr++;
-    }
+    size_t fetched = rle_decoder_.GetBatch(reinterpret_cast<bool*>(dst->data()), bits_to_fetch);
+    DCHECK_EQ(bits_to_fetch, fetched);
 
     cur_idx_ += bits_to_fetch;
     *n = bits_to_fetch;
@@ -197,6 +225,28 @@ class RleBitMapBlockDecoder final : public BlockDecoder {
     return Status::NotSupported("BOOL keys are not supported!");
   }
 
+  Status CopyNextAndEval(size_t* n,
+                         ColumnMaterializationContext* ctx,
+                         SelectionVectorView* sel,
+                         ColumnDataView* dst) override {
+    DCHECK(parsed_);
+    DCHECK_LE(*n, dst->nrows());
+    DCHECK_EQ(dst->stride(), sizeof(bool));
+    ctx->SetDecoderEvalSupported();
+
+    if (PREDICT_FALSE(*n == 0 || cur_idx_ >= num_elems_)) {
+      *n = 0;
+      return Status::OK();
+    }
+
+    size_t bits_to_fetch = std::min(*n, static_cast<size_t>(num_elems_ - cur_idx_));
+    RETURN_NOT_OK(CopyNextRunsAndEval<BOOL>(bits_to_fetch, ctx, &rle_decoder_, sel,
+                                            reinterpret_cast<bool*>(dst->data())));
+    cur_idx_ += bits_to_fetch;
+    *n = bits_to_fetch;
+    return Status::OK();
+  }
+
   virtual bool HasNext() const OVERRIDE { return cur_idx_ < num_elems_; }
 
   virtual size_t Count() const OVERRIDE { return num_elems_; }
@@ -406,15 +456,31 @@ class RleIntBlockDecoder final : public BlockDecoder {
     }
 
     size_t to_fetch = std::min(*n, static_cast<size_t>(num_elems_ - cur_idx_));
-    size_t remaining = to_fetch;
-    uint8_t* data_ptr = dst->data();
-    while (remaining > 0) {
-      bool result = rle_decoder_.Get(reinterpret_cast<CppType*>(data_ptr));
-      DCHECK(result);
-      remaining--;
-      data_ptr += kCppTypeSize;
+    size_t fetched = rle_decoder_.GetBatch(reinterpret_cast<CppType*>(dst->data()), to_fetch);
+    DCHECK_EQ(to_fetch, fetched);
+
+    cur_idx_ += to_fetch;
+    *n = to_fetch;
+    return Status::OK();
+  }
+
+  Status CopyNextAndEval(size_t* n,
+                         ColumnMaterializationContext* ctx,
+                         SelectionVectorView* sel,
+                         ColumnDataView* dst) override {
+    DCHECK(parsed_);
+    DCHECK_LE(*n, dst->nrows());
+    DCHECK_EQ(dst->stride(), sizeof(CppType));
+    ctx->SetDecoderEvalSupported();
+
+    if (PREDICT_FALSE(*n == 0 || cur_idx_ >= num_elems_)) {
+      *n = 0;
+      return Status::OK();
     }
 
+    size_t to_fetch = std::min(*n, static_cast<size_t>(num_elems_ - cur_idx_));
+    RETURN_NOT_OK(CopyNextRunsAndEval<IntType>(to_fetch, ctx, &rle_decoder_, sel,
+                                               reinterpret_cast<CppType*>(dst->data())));
     cur_idx_ += to_fetch;
     *n = to_fetch;
     return Status::OK();
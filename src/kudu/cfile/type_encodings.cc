@@ -22,6 +22,8 @@
 #include <utility>
 
 #include "kudu/cfile/bshuf_block.h"
+#include "kudu/cfile/dict_block.h"
+#include "kudu/cfile/for_block.h"
 #include "kudu/cfile/plain_bitmap_block.h"
 #include "kudu/cfile/plain_block.h"
 #include "kudu/cfile/rle_block.h"
@@ -171,6 +173,38 @@ struct DataTypeEncodingTraits<BINARY, DICT_ENCODING> {
   }
 };
 
+// Dictionary encoding for fixed-width integer types. Only instantiated for
+// 32 and 64-bit integers: narrower types gain nothing from 32-bit codewords.
+template<DataType IntType>
+struct DataTypeEncodingTraits<IntType, DICT_ENCODING> {
+
+  static Status CreateBlockBuilder(BlockBuilder** bb, const WriterOptions *options) {
+    *bb = new DictBlockBuilder<IntType>(options);
+    return Status::OK();
+  }
+
+  static Status CreateBlockDecoder(BlockDecoder** bd, const Slice& slice,
+                                   CFileIterator *iter) {
+    *bd = new DictBlockDecoder<IntType>(slice, iter);
+    return Status::OK();
+  }
+};
+
+template<DataType IntType>
+struct DataTypeEncodingTraits<IntType, FRAME_OF_REFERENCE> {
+
+  static Status CreateBlockBuilder(BlockBuilder** bb, const WriterOptions *options) {
+    *bb = new ForBlockBuilder<IntType>(options);
+    return Status::OK();
+  }
+
+  static Status CreateBlockDecoder(BlockDecoder** bd, const Slice& slice,
+                                   CFileIterator *iter) {
+    *bd = new ForBlockDecoder<IntType>(slice);
+    return Status::OK();
+  }
+};
+
 template<DataType IntType>
 struct DataTypeEncodingTraits<IntType, RLE> {
 
@@ -244,27 +278,39 @@ class TypeEncodingResolver {
     AddMapping<UINT8, BIT_SHUFFLE>();
     AddMapping<UINT8, PLAIN_ENCODING>();
     AddMapping<UINT8, RLE>();
+    AddMapping<UINT8, FRAME_OF_REFERENCE>();
     AddMapping<INT8, BIT_SHUFFLE>();
     AddMapping<INT8, PLAIN_ENCODING>();
     AddMapping<INT8, RLE>();
+    AddMapping<INT8, FRAME_OF_REFERENCE>();
     AddMapping<UINT16, BIT_SHUFFLE>();
     AddMapping<UINT16, PLAIN_ENCODING>();
     AddMapping<UINT16, RLE>();
+    AddMapping<UINT16, FRAME_OF_REFERENCE>();
     AddMapping<INT16, BIT_SHUFFLE>();
     AddMapping<INT16, PLAIN_ENCODING>();
     AddMapping<INT16, RLE>();
+    AddMapping<INT16, FRAME_OF_REFERENCE>();
     AddMapping<UINT32, BIT_SHUFFLE>();
     AddMapping<UINT32, RLE>();
+    AddMapping<UINT32, FRAME_OF_REFERENCE>();
+    AddMapping<UINT32, DICT_ENCODING>();
     AddMapping<UINT32, PLAIN_ENCODING>();
     AddMapping<INT32, BIT_SHUFFLE>();
     AddMapping<INT32, PLAIN_ENCODING>();
     AddMapping<INT32, RLE>();
+    AddMapping<INT32, FRAME_OF_REFERENCE>();
+    AddMapping<INT32, DICT_ENCODING>();
     AddMapping<UINT64, BIT_SHUFFLE>();
     AddMapping<UINT64, PLAIN_ENCODING>();
     AddMapping<UINT64, RLE>();
+    AddMapping<UINT64, FRAME_OF_REFERENCE>();
+    AddMapping<UINT64, DICT_ENCODING>();
     AddMapping<INT64, BIT_SHUFFLE>();
     AddMapping<INT64, PLAIN_ENCODING>();
     AddMapping<INT64, RLE>();
+    AddMapping<INT64, FRAME_OF_REFERENCE>();
+    AddMapping<INT64, DICT_ENCODING>();
     AddMapping<FLOAT, BIT_SHUFFLE>();
     AddMapping<FLOAT, PLAIN_ENCODING>();
     AddMapping<DOUBLE, BIT_SHUFFLE>();
@@ -0,0 +1,215 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/cfile/zone_map.h"
+
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "kudu/cfile/cfile.pb.h"
+#include "kudu/common/column_predicate.h"
+#include "kudu/common/common.pb.h"
+#include "kudu/common/types.h"
+
+using std::string;
+
+namespace kudu {
+namespace cfile {
+
+namespace {
+
+// Binary bounds longer than this aren't stored: they would bloat the zone
+// maps, and long strings are rarely compared against in predicates anyway.
+const size_t kMaxBinaryBoundSize = 64;
+
+bool IsBinary(const TypeInfo* typeinfo) {
+  return typeinfo->physical_type() == BINARY;
+}
+
+bool IsNaN(const TypeInfo* typeinfo, const uint8_t* cell) {
+  switch (typeinfo->physical_type()) {
+    case FLOAT: {
+      float f;
+      memcpy(&f, cell, sizeof(f));
+      return std::isnan(f);
+    }
+    case DOUBLE: {
+      double d;
+      memcpy(&d, cell, sizeof(d));
+      return std::isnan(d);
+    }
+    default:
+      return false;
+  }
+}
+
+} // anonymous namespace
+
+const void* ZoneMapValueCellPtr(const TypeInfo* typeinfo, const string& value, Slice* slice) {
+  if (IsBinary(typeinfo)) {
+    *slice = Slice(value);
+    return slice;
+  }
+  if (PREDICT_FALSE(value.size() != typeinfo->size())) {
+    return nullptr;
+  }
+  return value.data();
+}
+
+ZoneMapBuilder::ZoneMapBuilder(const TypeInfo* typeinfo)
+    : typeinfo_(typeinfo),
+      has_cells_(false),
+      bounds_unknown_(false),
+      null_count_(0) {
+}
+
+const void* ZoneMapBuilder::CellPtr(const faststring& buf, Slice* slice) const {
+  if (IsBinary(typeinfo_)) {
+    *slice = Slice(buf);
+    return slice;
+  }
+  return buf.data();
+}
+
+void ZoneMapBuilder::CopyCell(const void* cell, faststring* buf) const {
+  if (IsBinary(typeinfo_)) {
+    const Slice* s = reinterpret_cast<const Slice*>(cell);
+    buf->assign_copy(s->data(), s->size());
+  } else {
+    buf->assign_copy(reinterpret_cast<const uint8_t*>(cell), typeinfo_->size());
+  }
+}
+
+void ZoneMapBuilder::AddCells(const uint8_t* cells, size_t count) {
+  if (count == 0 || bounds_unknown_) {
+    return;
+  }
+  const size_t size = typeinfo_->size();
+
+  // Find the bounds of this batch first, so that at most one copy of each
+  // bound is made per batch.
+  const uint8_t* batch_min = cells;
+  const uint8_t* batch_max = cells;
+  for (size_t i = 0; i < count; i++) {
+    const uint8_t* cell = cells + i * size;
+    if (PREDICT_FALSE(IsNaN(typeinfo_, cell))) {
+      bounds_unknown_ = true;
+      return;
+    }
+    if (typeinfo_->Compare(cell, batch_min) < 0) {
+      batch_min = cell;
+    } else if (typeinfo_->Compare(cell, batch_max) > 0) {
+      batch_max = cell;
+    }
+  }
+
+  Slice tmp;
+  if (!has_cells_ || typeinfo_->Compare(batch_min, CellPtr(min_, &tmp)) < 0) {
+    CopyCell(batch_min, &min_);
+  }
+  if (!has_cells_ || typeinfo_->Compare(batch_max, CellPtr(max_, &tmp)) > 0) {
+    CopyCell(batch_max, &max_);
+  }
+  has_cells_ = true;
+}
+
+void ZoneMapBuilder::FinishBlock(rowid_t first_ordinal, uint32_t num_rows,
+                                 BlockZoneMapPB* pb) {
+  DCHECK_LE(null_count_, num_rows);
+  pb->set_first_ordinal(first_ordinal);
+  pb->set_num_rows(num_rows);
+  pb->set_null_count(null_count_);
+  if (has_cells_ && !bounds_unknown_ &&
+      !(IsBinary(typeinfo_) &&
+        (min_.size() > kMaxBinaryBoundSize || max_.size() > kMaxBinaryBoundSize))) {
+    pb->set_min_value(min_.data(), min_.size());
+    pb->set_max_value(max_.data(), max_.size());
+  }
+
+  has_cells_ = false;
+  bounds_unknown_ = false;
+  null_count_ = 0;
+  min_.clear();
+  max_.clear();
+}
+
+bool ZoneMapMayMatch(const BlockZoneMapPB& zone_map,
+                     const TypeInfo* typeinfo,
+                     const ColumnPredicate& pred) {
+  if (!zone_map.has_num_rows() || !zone_map.has_null_count()) {
+    return true;
+  }
+  const bool all_null = zone_map.null_count() == zone_map.num_rows();
+  switch (pred.predicate_type()) {
+    case PredicateType::None:
+      return false;
+    case PredicateType::IsNull:
+      return zone_map.null_count() > 0;
+    case PredicateType::IsNotNull:
+      return !all_null;
+    default:
+      break;
+  }
+  // The remaining predicates never match NULLs.
+  if (all_null) {
+    return false;
+  }
+  if (!zone_map.has_min_value() || !zone_map.has_max_value()) {
+    return true;
+  }
+
+  Slice min_slice;
+  Slice max_slice;
+  const void* min = ZoneMapValueCellPtr(typeinfo, zone_map.min_value(), &min_slice);
+  const void* max = ZoneMapValueCellPtr(typeinfo, zone_map.max_value(), &max_slice);
+  if (PREDICT_FALSE(min == nullptr || max == nullptr)) {
+    return true;
+  }
+
+  switch (pred.predicate_type()) {
+    case PredicateType::Range:
+    case PredicateType::InBloomFilter:
+      // Only the bounds of a bloom filter predicate are checked.
+      if (pred.raw_upper() != nullptr && typeinfo->Compare(min, pred.raw_upper()) >= 0) {
+        return false;
+      }
+      if (pred.raw_lower() != nullptr && typeinfo->Compare(max, pred.raw_lower()) < 0) {
+        return false;
+      }
+      return true;
+    case PredicateType::Equality:
+      return typeinfo->Compare(pred.raw_lower(), min) >= 0 &&
+             typeinfo->Compare(pred.raw_lower(), max) <= 0;
+    case PredicateType::InList:
+      for (const void* value : pred.raw_values()) {
+        if (typeinfo->Compare(value, min) >= 0 && typeinfo->Compare(value, max) <= 0) {
+          return true;
+        }
+      }
+      return false;
+    default:
+      LOG(DFATAL) << "unexpected predicate type: " << pred.ToString();
+      return true;
+  }
+}
+
+} // namespace cfile
+} // namespace kudu
@@ -0,0 +1,97 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_CFILE_ZONE_MAP_H
+#define KUDU_CFILE_ZONE_MAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "kudu/common/rowid.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/slice.h"
+
+namespace kudu {
+
+class ColumnPredicate;
+class TypeInfo;
+
+namespace cfile {
+
+class BlockZoneMapPB;
+
+// Accumulates the zone map (the minimum and maximum cells, and the number
+// of NULLs) of the data block currently being written by a CFileWriter.
+class ZoneMapBuilder {
+ public:
+  explicit ZoneMapBuilder(const TypeInfo* typeinfo);
+
+  // Adds 'count' non-NULL cells, stored contiguously at 'cells'.
+  void AddCells(const uint8_t* cells, size_t count);
+
+  // Adds 'count' NULL cells.
+  void AddNulls(size_t count) {
+    null_count_ += count;
+  }
+
+  // Writes the zone map of the current block, which holds the 'num_rows'
+  // rows starting at 'first_ordinal', into 'pb', and resets the builder for
+  // the next block.
+  void FinishBlock(rowid_t first_ordinal, uint32_t num_rows, BlockZoneMapPB* pb);
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ZoneMapBuilder);
+
+  // Returns a pointer to the cell stored in 'buf'. For binary types,
+  // 'slice' is used as the storage for the cell.
+  const void* CellPtr(const faststring& buf, Slice* slice) const;
+
+  // Stores a copy of 'cell' into 'buf'.
+  void CopyCell(const void* cell, faststring* buf) const;
+
+  const TypeInfo* const typeinfo_;
+
+  // Whether any non-NULL cell has been added to the current block.
+  bool has_cells_;
+
+  // Whether the bounds of the current block can't be stored, e.g. because
+  // it contains a floating point NaN.
+  bool bounds_unknown_;
+
+  uint32_t null_count_;
+  faststring min_;
+  faststring max_;
+};
+
+// Returns a pointer to the cell stored in the zone map bound 'value', or
+// nullptr if 'value' isn't a valid cell of type 'typeinfo'. For binary
+// types, 'slice' is used as the storage for the cell.
+const void* ZoneMapValueCellPtr(const TypeInfo* typeinfo, const std::string& value,
+                                Slice* slice);
+
+// Returns false if it's certain that none of the rows of the block described
+// by 'zone_map' can satisfy 'pred', which must be a predicate over a column
+// of type 'typeinfo'.
+bool ZoneMapMayMatch(const BlockZoneMapPB& zone_map,
+                     const TypeInfo* typeinfo,
+                     const ColumnPredicate& pred);
+
+} // namespace cfile
+} // namespace kudu
+
+#endif // KUDU_CFILE_ZONE_MAP_H
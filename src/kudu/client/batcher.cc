@@ -17,6 +17,7 @@
 
 #include "kudu/client/batcher.h"
 
+#include <algorithm>
 #include <cstddef>
 #include <memory>
 #include <mutex>
@@ -38,6 +39,7 @@
 #include "kudu/client/schema.h"
 #include "kudu/client/session-internal.h"
 #include "kudu/client/shared_ptr.h"
+#include "kudu/client/write_flow_control.h"
 #include "kudu/client/write_op-internal.h"
 #include "kudu/client/write_op.h"
 #include "kudu/common/common.pb.h"
@@ -158,11 +160,12 @@ struct InFlightOp {
     // In AUTO_FLUSH_BACKGROUND mode, the operations may wait in this state for one of
     // two reasons:
     //
-    //   1) There are already too many outstanding RPCs to the given tablet server.
+    //   1) There are already too many outstanding RPCs to the given tablet.
     //
-    //      We restrict the number of concurrent RPCs from one client to a given TS
-    //      to achieve better batching and throughput.
-    //      TODO: not implemented yet
+    //      The client restricts the number of concurrent write RPCs to a given
+    //      tablet, depending on the load its tablet server reports: see
+    //      WriteFlowControl. Operations flushed while the RPCs are restricted
+    //      are in the kRequestSent state, in an RPC queued until it may be sent.
     //
     //   2) Batching delay.
     //
@@ -237,6 +240,9 @@ class WriteRpc : public RetriableRpc<RemoteTabletServer, WriteRequestPB, WriteRe
   const WriteResponsePB& resp() const { return resp_; }
   const string& tablet_id() const { return tablet_id_; }
 
+  // Sets the RPC to send once this one completes, taking ownership of it.
+  void set_next_chunk(WriteRpc* next_chunk) { next_chunk_ = next_chunk; }
+
  protected:
   void Try(RemoteTabletServer* replica, const ResponseCallback& callback) override;
   RetriableRpcStatus AnalyzeResponse(const Status& rpc_cb_status) override;
@@ -244,6 +250,10 @@ class WriteRpc : public RetriableRpc<RemoteTabletServer, WriteRequestPB, WriteRe
   bool GetNewAuthnTokenAndRetry() override;
 
  private:
+  // Returns true if the tablet server reported being overloaded in response
+  // to the last attempt.
+  bool ServerOverloaded() const;
+
   // Pointer back to the batcher. Processes the write response when it
   // completes, regardless of success or failure.
   scoped_refptr<Batcher> batcher_;
@@ -254,6 +264,11 @@ class WriteRpc : public RetriableRpc<RemoteTabletServer, WriteRequestPB, WriteRe
 
   // The id of the tablet being written to.
   string tablet_id_;
+
+  // When the operations of a batcher for the tablet are split into several
+  // RPCs, the RPC with the next operations. Chunks are sent one after the
+  // other, so as to apply the operations in order.
+  WriteRpc* next_chunk_;
 };
 
 WriteRpc::WriteRpc(const scoped_refptr<Batcher>& batcher,
@@ -267,7 +282,8 @@ WriteRpc::WriteRpc(const scoped_refptr<Batcher>& batcher,
     : RetriableRpc(replica_picker, request_tracker, deadline, std::move(messenger)),
       batcher_(batcher),
       ops_(std::move(ops)),
-      tablet_id_(tablet_id) {
+      tablet_id_(tablet_id),
+      next_chunk_(nullptr) {
   const Schema* schema = table()->schema().schema_;
 
   req_.set_tablet_id(tablet_id_);
@@ -324,6 +340,7 @@ WriteRpc::WriteRpc(const scoped_refptr<Batcher>& batcher,
 }
 
 WriteRpc::~WriteRpc() {
+  DCHECK(!next_chunk_);
   STLDeleteElements(&ops_);
 }
 
@@ -348,9 +365,32 @@ void WriteRpc::Finish(const Status& status) {
                    ops_.size(), tablet_id_, num_attempts()));
     KLOG_EVERY_N_SECS(WARNING, 1) << final_status.ToString();
   }
+  WriteFlowControl* flow_control = batcher_->client_->data_->write_flow_control_.get();
+  flow_control->Release(tablet_id_);
+  if (next_chunk_) {
+    WriteRpc* next_chunk = next_chunk_;
+    next_chunk_ = nullptr;
+    flow_control->Send(tablet_id_, [next_chunk]() { next_chunk->SendRpc(); });
+  }
   batcher_->ProcessWriteResponse(*this, final_status);
 }
 
+bool WriteRpc::ServerOverloaded() const {
+  const RpcController& controller = retrier().controller();
+  if (!controller.status().ok()) {
+    // Tablet servers reject writes with this error when their service queue
+    // is full, when past their soft memory limit, or when throttling.
+    const ErrorStatusPB* err = controller.error_response();
+    return err && err->has_code() && err->code() == ErrorStatusPB::ERROR_SERVER_TOO_BUSY;
+  }
+  if (!resp_.has_load_hint()) {
+    return false;
+  }
+  return resp_.load_hint().memory_pressure() ||
+      resp_.load_hint().write_delay_ms() > 0 ||
+      resp_.load_hint().queue_time_us() > WriteFlowControl::kOverloadedQueueTimeMs * 1000;
+}
+
 RetriableRpcStatus WriteRpc::AnalyzeResponse(const Status& rpc_cb_status) {
   RetriableRpcStatus result;
   result.status = rpc_cb_status;
@@ -361,6 +401,12 @@ RetriableRpcStatus WriteRpc::AnalyzeResponse(const Status& rpc_cb_status) {
     result.status = mutable_retrier()->controller().status();
   }
 
+  // If the tablet server responded, adapt the writes to the tablet to its load.
+  if (rpc_cb_status.ok() && (result.status.ok() || result.status.IsRemoteError())) {
+    batcher_->client_->data_->write_flow_control_->RecordResponse(tablet_id_,
+                                                                  ServerOverloaded());
+  }
+
   // Check for specific RPC errors.
   if (result.status.IsRemoteError()) {
     const ErrorStatusPB* err = mutable_retrier()->controller().error_response();
@@ -402,6 +448,16 @@ RetriableRpcStatus WriteRpc::AnalyzeResponse(const Status& rpc_cb_status) {
     result.status = StatusFromPB(resp_.error().status());
   }
 
+  // A mismatched schema means the table was altered since it was opened: the
+  // next opening of the table must not get the cached schema.
+  if (resp_.has_error() &&
+      resp_.error().code() == tserver::TabletServerErrorPB::MISMATCHED_SCHEMA) {
+    const auto& cache = batcher_->client_->data_->table_metadata_cache_;
+    if (cache) {
+      cache->InvalidateTableId(table()->id());
+    }
+  }
+
   // If we get TABLET_NOT_FOUND, the replica we thought was leader has been deleted.
   if (resp_.has_error() && resp_.error().code() == tserver::TabletServerErrorPB::TABLET_NOT_FOUND) {
     result.result = RetriableRpcStatus::RESOURCE_NOT_FOUND;
@@ -610,6 +666,175 @@ Status Batcher::Add(KuduWriteOperation* write_op) {
   return Status::OK();
 }
 
+void Batcher::AddBatch(const vector<KuduWriteOperation*>& write_ops,
+                       vector<pair<KuduWriteOperation*, Status>>* failed_ops) {
+  // Encode the partition keys up front, grouping the operations by table
+  // (in order of appearance) so that each table's keys are resolved against
+  // the MetaCache in one go.
+  vector<string> partition_keys(write_ops.size());
+  vector<pair<const KuduTable*, vector<size_t>>> op_idx_by_table;
+  for (size_t i = 0; i < write_ops.size(); i++) {
+    KuduWriteOperation* write_op = write_ops[i];
+    Status s = write_op->table_->partition_schema().EncodeKey(write_op->row(),
+                                                              &partition_keys[i]);
+    if (PREDICT_FALSE(!s.ok())) {
+      failed_ops->emplace_back(write_op, std::move(s));
+      continue;
+    }
+    if (op_idx_by_table.empty() || op_idx_by_table.back().first != write_op->table()) {
+      auto it = std::find_if(op_idx_by_table.begin(), op_idx_by_table.end(),
+                             [&](const pair<const KuduTable*, vector<size_t>>& e) {
+                               return e.first == write_op->table();
+                             });
+      if (it == op_idx_by_table.end()) {
+        op_idx_by_table.emplace_back(write_op->table(), vector<size_t>());
+      } else if (it != op_idx_by_table.end() - 1) {
+        // Keep the most recently used table at the back.
+        std::iter_swap(it, op_idx_by_table.end() - 1);
+      }
+    }
+    op_idx_by_table.back().second.push_back(i);
+  }
+
+  // Operations whose tablet was found in the cache, grouped per tablet in
+  // order of appearance, and those which need an asynchronous lookup.
+  vector<pair<scoped_refptr<RemoteTablet>, vector<InFlightOp*>>> ops_by_tablet;
+  unordered_map<RemoteTablet*, size_t> tablet_group_idx;
+  vector<PendingLookups> to_lookup_by_table;
+  vector<string> keys;
+  vector<scoped_refptr<RemoteTablet>> tablets;
+  for (auto& e : op_idx_by_table) {
+    const vector<size_t>& op_idx = e.second;
+    keys.clear();
+    keys.reserve(op_idx.size());
+    for (size_t i : op_idx) {
+      keys.emplace_back(std::move(partition_keys[i]));
+    }
+    client_->data_->meta_cache_->LookupTabletsByKeysFastPath(e.first, keys, &tablets);
+    PendingLookups to_lookup;
+    for (size_t j = 0; j < op_idx.size(); j++) {
+      InFlightOp* op = new InFlightOp();
+      op->write_op.reset(write_ops[op_idx[j]]);
+      op->state = InFlightOp::kLookingUpTablet;
+      if (!tablets[j]) {
+        to_lookup.emplace_back(op, std::move(keys[j]));
+        continue;
+      }
+      op->tablet = std::move(tablets[j]);
+      auto ins = tablet_group_idx.emplace(op->tablet.get(), ops_by_tablet.size());
+      if (ins.second) {
+        ops_by_tablet.emplace_back(op->tablet, vector<InFlightOp*>());
+      }
+      ops_by_tablet[ins.first->second].second.push_back(op);
+    }
+    if (!to_lookup.empty()) {
+      to_lookup_by_table.emplace_back(std::move(to_lookup));
+    }
+  }
+
+  int64_t bytes_added = 0;
+  for (const auto& e : ops_by_tablet) {
+    const vector<InFlightOp*>& ops = e.second;
+    std::lock_guard<simple_spinlock> l(lock_);
+    CHECK_EQ(state_, kGatheringOps);
+    if (PREDICT_FALSE(!first_op_time_.Initialized())) {
+      first_op_time_ = MonoTime::Now();
+    }
+    vector<InFlightOp*>& to_ts = per_tablet_ops_[e.first.get()];
+    to_ts.reserve(to_ts.size() + ops.size());
+    for (InFlightOp* op : ops) {
+      InsertOrDie(&ops_, op);
+      op->sequence_number_ = next_op_sequence_number_++;
+      op->state = InFlightOp::kBufferedToTabletServer;
+      // Every op already buffered for this tablet has a lower sequence
+      // number, and ops still in lookup are re-sequenced by
+      // TabletLookupFinished(), so appending keeps the user's order.
+      to_ts.push_back(op);
+      bytes_added += op->write_op->SizeInBuffer();
+    }
+  }
+
+  if (to_lookup_by_table.empty()) {
+    buffer_bytes_used_.IncrementBy(bytes_added);
+    return;
+  }
+
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    CHECK_EQ(state_, kGatheringOps);
+    if (PREDICT_FALSE(!first_op_time_.Initialized())) {
+      first_op_time_ = MonoTime::Now();
+    }
+    for (const auto& to_lookup : to_lookup_by_table) {
+      for (const auto& e : to_lookup) {
+        InsertOrDie(&ops_, e.first);
+        e.first->sequence_number_ = next_op_sequence_number_++;
+        bytes_added += e.first->write_op->SizeInBuffer();
+      }
+    }
+  }
+  // Account for the buffered data before any lookup callback may run.
+  buffer_bytes_used_.IncrementBy(bytes_added);
+
+  MonoTime deadline = ComputeDeadlineUnlocked();
+  for (auto& to_lookup : to_lookup_by_table) {
+    // Count the lookups as outstanding right away, so the batch isn't
+    // flushed while the locations are being prefetched.
+    base::RefCountIncN(&outstanding_lookups_, static_cast<Atomic32>(to_lookup.size()));
+    if (to_lookup.size() == 1) {
+      LookupTablets(&to_lookup, deadline);
+      continue;
+    }
+    // Rather than sending a lookup to the master for each of the operations
+    // which missed the cache, fetch the locations for the whole key range
+    // they span first.
+    string lower_bound = to_lookup[0].second;
+    string upper_bound = to_lookup[0].second;
+    for (const auto& e : to_lookup) {
+      if (e.second < lower_bound) {
+        lower_bound = e.second;
+      } else if (e.second > upper_bound) {
+        upper_bound = e.second;
+      }
+    }
+    // The upper bound is exclusive: append a zero byte to get the smallest
+    // partition key past the largest one.
+    upper_bound.push_back('\0');
+    const KuduTable* table = to_lookup[0].first->write_op->table();
+    auto* pending = new PendingLookups(std::move(to_lookup));
+    client_->data_->meta_cache_->PrefetchTabletLocations(
+        table,
+        std::move(lower_bound),
+        std::move(upper_bound),
+        deadline,
+        Bind(&Batcher::TabletLocationsPrefetched, this, Owned(pending), deadline));
+  }
+}
+
+void Batcher::TabletLocationsPrefetched(PendingLookups* lookups,
+                                        MonoTime deadline,
+                                        const Status& s) {
+  if (PREDICT_FALSE(!s.ok())) {
+    // Not fatal: each operation's own lookup will retry, and report
+    // the error if it persists.
+    VLOG(1) << "Failed to prefetch tablet locations: " << s.ToString();
+  }
+  LookupTablets(lookups, deadline);
+}
+
+void Batcher::LookupTablets(PendingLookups* lookups, const MonoTime& deadline) {
+  for (auto& e : *lookups) {
+    InFlightOp* op = e.first;
+    VLOG(3) << "Looking up tablet for " << op->ToString();
+    client_->data_->meta_cache_->LookupTabletByKey(
+        op->write_op->table(),
+        std::move(e.second),
+        deadline,
+        &op->tablet,
+        Bind(&Batcher::TabletLookupFinished, this, op));
+  }
+}
+
 void Batcher::AddInFlightOp(InFlightOp* op) {
   DCHECK_EQ(op->state, InFlightOp::kLookingUpTablet);
 
@@ -764,15 +989,42 @@ void Batcher::FlushBuffer(RemoteTablet* tablet, const vector<InFlightOp*>& ops)
                                 client_->data_->meta_cache_,
                                 ops[0]->write_op->table(),
                                 tablet));
-  WriteRpc* rpc = new WriteRpc(this,
-                               server_picker,
-                               client_->data_->request_tracker_,
-                               ops,
-                               deadline_,
-                               client_->data_->messenger_,
-                               tablet->tablet_id(),
-                               client_->data_->GetLatestObservedTimestamp());
-  rpc->SendRpc();
+
+  // Split the ops into chunks no larger than the batches the tablet's server
+  // currently accepts, sent one after the other.
+  WriteFlowControl* flow_control = client_->data_->write_flow_control_.get();
+  const int64_t max_batch_bytes = flow_control->max_batch_bytes(tablet->tablet_id());
+  vector<vector<InFlightOp*>> chunks(1);
+  int64_t chunk_bytes = 0;
+  for (InFlightOp* op : ops) {
+    const int64_t op_bytes = GetOperationSizeInBuffer(op->write_op.get());
+    if (!chunks.back().empty() && chunk_bytes + op_bytes > max_batch_bytes) {
+      chunks.emplace_back();
+      chunk_bytes = 0;
+    }
+    chunks.back().push_back(op);
+    chunk_bytes += op_bytes;
+  }
+
+  WriteRpc* first_rpc = nullptr;
+  WriteRpc* prev_rpc = nullptr;
+  for (auto& chunk : chunks) {
+    WriteRpc* rpc = new WriteRpc(this,
+                                 server_picker,
+                                 client_->data_->request_tracker_,
+                                 std::move(chunk),
+                                 deadline_,
+                                 client_->data_->messenger_,
+                                 tablet->tablet_id(),
+                                 client_->data_->GetLatestObservedTimestamp());
+    if (prev_rpc) {
+      prev_rpc->set_next_chunk(rpc);
+    } else {
+      first_rpc = rpc;
+    }
+    prev_rpc = rpc;
+  }
+  flow_control->Send(tablet->tablet_id(), [first_rpc]() { first_rpc->SendRpc(); });
 }
 
 void Batcher::ProcessWriteResponse(const WriteRpc& rpc,
@@ -19,8 +19,10 @@
 
 #include <cstdint>
 #include <mutex>
+#include <string>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include "kudu/client/client.h"
@@ -88,6 +90,21 @@ class Batcher : public RefCountedThreadSafe<Batcher> {
   // NOTE: If this returns not-OK, does not take ownership of 'write_op'.
   Status Add(KuduWriteOperation* write_op) WARN_UNUSED_RESULT;
 
+  // Add a batch of operations. Requires that the batch has not yet been flushed.
+  //
+  // Unlike calling Add() for every operation, the tablets for the whole batch
+  // are resolved against the MetaCache in a single pass, and operations bound
+  // for the same tablet are buffered under a single acquisition of the batcher
+  // lock. Operations whose tablet is not cached fall back to the same
+  // asynchronous lookup as Add().
+  //
+  // Takes ownership of every operation except those whose partition key
+  // cannot be encoded: they are appended to 'failed_ops' along with the
+  // corresponding error, and ownership stays with the caller.
+  void AddBatch(
+      const std::vector<KuduWriteOperation*>& write_ops,
+      std::vector<std::pair<KuduWriteOperation*, Status>>* failed_ops);
+
   // Return true if any operations are still pending. An operation is no longer considered
   // pending once it has either errored or succeeded.  Operations are considering pending
   // as soon as they are added, even if Flush has not been called.
@@ -162,8 +179,18 @@ class Batcher : public RefCountedThreadSafe<Batcher> {
   // to the batcher.
   void ProcessWriteResponse(const WriteRpc& rpc, const Status& s);
 
+  // Operations waiting for a tablet lookup, along with their partition keys.
+  typedef std::vector<std::pair<InFlightOp*, std::string>> PendingLookups;
+
+  // Look up the tablet of each of the operations in 'lookups'. The lookups
+  // must already be counted in 'outstanding_lookups_'.
+  void LookupTablets(PendingLookups* lookups, const MonoTime& deadline);
+
   // Async Callbacks.
   void TabletLookupFinished(InFlightOp* op, const Status& s);
+  void TabletLocationsPrefetched(PendingLookups* lookups,
+                                 MonoTime deadline,
+                                 const Status& s);
 
   // Compute a new deadline based on timeout_. If no timeout_ has been set,
   // uses a hard-coded default and issues periodic warnings.
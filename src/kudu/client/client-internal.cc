@@ -35,6 +35,8 @@
 #include "kudu/client/master_rpc.h"
 #include "kudu/client/meta_cache.h"
 #include "kudu/client/schema.h"
+#include "kudu/client/table_metadata_cache.h"
+#include "kudu/client/write_flow_control.h"
 #include "kudu/common/partition.h"
 #include "kudu/common/schema.h"
 #include "kudu/common/wire_protocol.h"
@@ -60,6 +62,7 @@
 #include "kudu/util/net/sockaddr.h"
 #include "kudu/util/pb_util.h"
 #include "kudu/util/thread_restrictions.h"
+#include "kudu/util/threadpool.h"
 #include "kudu/rpc/connection.h"
 
 using std::pair;
@@ -106,6 +109,7 @@ namespace client {
 using internal::ConnectToClusterRpc;
 using internal::RemoteTablet;
 using internal::RemoteTabletServer;
+using internal::TableMetadataCache;
 
 Status RetryFunc(const MonoTime& deadline,
                  const string& retry_msg,
@@ -342,7 +346,8 @@ Status KuduClient::Data::SyncLeaderMasterRpc(
     vector<uint32_t> required_feature_flags);
 
 KuduClient::Data::Data()
-    : latest_observed_timestamp_(KuduClient::kNoTimestamp) {
+    : write_flow_control_(new internal::WriteFlowControl),
+      latest_observed_timestamp_(KuduClient::kNoTimestamp) {
 }
 
 KuduClient::Data::~Data() {
@@ -354,8 +359,64 @@ KuduClient::Data::~Data() {
   // jitter on the reactor is not a big deal (and DNS resolutions are not in flight).
   ThreadRestrictions::ScopedAllowWait allow_wait;
   dns_resolver_.reset();
+  if (async_scan_pool_) {
+    async_scan_pool_->Shutdown();
+  }
+  if (table_metadata_pool_) {
+    table_metadata_pool_->Shutdown();
+  }
+}
+
+Status KuduClient::Data::GetAsyncScanPool(ThreadPool** pool) {
+  std::lock_guard<simple_spinlock> l(async_scan_pool_lock_);
+  if (!async_scan_pool_) {
+    // The pool only runs the slow paths of the scans: most batches are
+    // handed out from the reactor threads.
+    RETURN_NOT_OK(ThreadPoolBuilder("async-scan")
+                  .set_min_threads(0)
+                  .set_max_threads(4)
+                  .set_idle_timeout(MonoDelta::FromSeconds(10))
+                  .Build(&async_scan_pool_));
+  }
+  *pool = async_scan_pool_.get();
+  return Status::OK();
+}
+
+namespace {
+
+// Sets 'healthy' to the servers of 'candidates' which aren't overloaded, or
+// to all of them if they all are. A server is overloaded if RPCs recently
+// spent over kMinOverloadedQueueTimeUs queued on it, and kOverloadedRatio
+// times as long as on the least loaded candidate, according to the master.
+void FilterOverloadedTServers(const vector<RemoteTabletServer*>& candidates,
+                              vector<RemoteTabletServer*>* healthy) {
+  const int64_t kMinOverloadedQueueTimeUs = 10 * 1000;
+  const int64_t kOverloadedRatio = 4;
+
+  int64_t min_queue_time_us = -1;
+  for (const RemoteTabletServer* rts : candidates) {
+    int64_t queue_time_us = std::max<int64_t>(0, rts->recent_rpc_queue_time_us());
+    if (min_queue_time_us < 0 || queue_time_us < min_queue_time_us) {
+      min_queue_time_us = queue_time_us;
+    }
+  }
+  const int64_t max_queue_time_us = std::max(kMinOverloadedQueueTimeUs,
+                                             kOverloadedRatio * min_queue_time_us);
+  healthy->clear();
+  for (RemoteTabletServer* rts : candidates) {
+    if (rts->recent_rpc_queue_time_us() <= max_queue_time_us) {
+      healthy->push_back(rts);
+    } else {
+      VLOG(1) << "Avoiding overloaded tserver " << rts->permanent_uuid();
+    }
+  }
+  if (healthy->empty()) {
+    *healthy = candidates;
+  }
 }
 
+} // anonymous namespace
+
 RemoteTabletServer* KuduClient::Data::SelectTServer(const scoped_refptr<RemoteTablet>& rt,
                                                     const ReplicaSelection selection,
                                                     const set<string>& blacklist,
@@ -390,16 +451,19 @@ RemoteTabletServer* KuduClient::Data::SelectTServer(const scoped_refptr<RemoteTa
           ret = filtered[0];
         }
       } else if (selection == CLOSEST_REPLICA) {
+        // Avoid the overloaded replicas, if any.
+        vector<RemoteTabletServer*> healthy;
+        FilterOverloadedTServers(filtered, &healthy);
         // Choose a local replica.
-        for (RemoteTabletServer* rts : filtered) {
+        for (RemoteTabletServer* rts : healthy) {
           if (IsTabletServerLocal(*rts)) {
             ret = rts;
             break;
           }
         }
         // Fallback to a random replica if none are local.
-        if (ret == nullptr && !filtered.empty()) {
-          ret = filtered[rand() % filtered.size()];
+        if (ret == nullptr && !healthy.empty()) {
+          ret = healthy[rand() % healthy.size()];
         }
       }
       break;
@@ -498,6 +562,9 @@ Status KuduClient::Data::DeleteTable(KuduClient* client,
   DeleteTableResponsePB resp;
 
   req.mutable_table()->set_table_name(table_name);
+  if (table_metadata_cache_) {
+    table_metadata_cache_->InvalidateTableName(table_name);
+  }
   return SyncLeaderMasterRpc<DeleteTableRequestPB, DeleteTableResponsePB>(
       deadline, client, req, &resp,
       "DeleteTable", &MasterServiceProxy::DeleteTable, {});
@@ -512,6 +579,9 @@ Status KuduClient::Data::AlterTable(KuduClient* client,
   if (has_add_drop_partition) {
     required_feature_flags.push_back(MasterFeatures::ADD_DROP_RANGE_PARTITIONS);
   }
+  if (table_metadata_cache_) {
+    table_metadata_cache_->InvalidateTableName(req.table().table_name());
+  }
   return SyncLeaderMasterRpc<AlterTableRequestPB, AlterTableResponsePB>(
       deadline,
       client,
@@ -605,6 +675,38 @@ Status KuduClient::Data::GetTableSchema(KuduClient* client,
                                         PartitionSchema* partition_schema,
                                         string* table_id,
                                         int* num_replicas) {
+  shared_ptr<const TableMetadataCache::Entry> entry;
+  if (table_metadata_cache_) {
+    bool refresh;
+    entry = table_metadata_cache_->Lookup(table_name, &refresh);
+    if (entry && refresh) {
+      RefreshTableMetadataAsync(client, table_name);
+    }
+  }
+  if (!entry) {
+    RETURN_NOT_OK(FetchTableMetadata(client, table_name, deadline, &entry));
+  }
+
+  if (schema) {
+    delete schema->schema_;
+    schema->schema_ = new Schema(entry->schema);
+  }
+  if (partition_schema) {
+    *partition_schema = entry->partition_schema;
+  }
+  if (table_id) {
+    *table_id = entry->table_id;
+  }
+  if (num_replicas) {
+    *num_replicas = entry->num_replicas;
+  }
+  return Status::OK();
+}
+
+Status KuduClient::Data::FetchTableMetadata(KuduClient* client,
+                                            const string& table_name,
+                                            const MonoTime& deadline,
+                                            shared_ptr<const TableMetadataCache::Entry>* entry) {
   GetTableSchemaRequestPB req;
   GetTableSchemaResponsePB resp;
 
@@ -613,29 +715,58 @@ Status KuduClient::Data::GetTableSchema(KuduClient* client,
       SyncLeaderMasterRpc<GetTableSchemaRequestPB, GetTableSchemaResponsePB>(
           deadline, client, req, &resp,
           "GetTableSchema", &MasterServiceProxy::GetTableSchema, {})));
+  auto new_entry = std::make_shared<TableMetadataCache::Entry>();
+  new_entry->fetch_time = MonoTime::Now();
+
   // Parse the server schema out of the response.
-  unique_ptr<Schema> new_schema(new Schema());
-  RETURN_NOT_OK(SchemaFromPB(resp.schema(), new_schema.get()));
+  RETURN_NOT_OK(SchemaFromPB(resp.schema(), &new_entry->schema));
 
   // Parse the server partition schema out of the response.
-  PartitionSchema new_partition_schema;
   RETURN_NOT_OK(PartitionSchema::FromPB(resp.partition_schema(),
-                                        *new_schema,
-                                        &new_partition_schema));
-  if (schema) {
-    delete schema->schema_;
-    schema->schema_ = new_schema.release();
+                                        new_entry->schema,
+                                        &new_entry->partition_schema));
+  new_entry->table_id = resp.table_id();
+  new_entry->table_name = table_name;
+  new_entry->num_replicas = resp.num_replicas();
+  new_entry->schema_version = resp.schema_version();
+
+  // Masters don't tell the version of the schemas of tables being altered: those
+  // schemas may not have reached every tablet server yet.
+  if (table_metadata_cache_ && resp.has_schema_version()) {
+    table_metadata_cache_->Put(new_entry);
   }
-  if (partition_schema) {
-    *partition_schema = std::move(new_partition_schema);
+  *entry = std::move(new_entry);
+  return Status::OK();
+}
+
+void KuduClient::Data::RefreshTableMetadataAsync(KuduClient* client, const string& table_name) {
+  Status s;
+  {
+    std::lock_guard<simple_spinlock> l(table_metadata_pool_lock_);
+    if (!table_metadata_pool_) {
+      s = ThreadPoolBuilder("table-metadata")
+          .set_min_threads(0)
+          .set_max_threads(1)
+          .set_idle_timeout(MonoDelta::FromSeconds(10))
+          .Build(&table_metadata_pool_);
+    }
   }
-  if (table_id) {
-    *table_id = resp.table_id();
+  if (s.ok()) {
+    // The pool is shut down before the client is destroyed.
+    s = table_metadata_pool_->SubmitFunc([this, client, table_name]() {
+      shared_ptr<const TableMetadataCache::Entry> entry;
+      Status s = FetchTableMetadata(client, table_name,
+                                    MonoTime::Now() + default_rpc_timeout_, &entry);
+      if (!s.ok()) {
+        VLOG(1) << "Could not refresh the metadata of table " << table_name << ": "
+                << s.ToString();
+        table_metadata_cache_->RefreshFailed(table_name);
+      }
+    });
   }
-  if (num_replicas) {
-    *num_replicas = resp.num_replicas();
+  if (!s.ok()) {
+    table_metadata_cache_->RefreshFailed(table_name);
   }
-  return Status::OK();
 }
 
 void KuduClient::Data::ConnectedToClusterCb(
@@ -29,6 +29,7 @@
 #include <vector>
 
 #include "kudu/client/client.h"
+#include "kudu/client/table_metadata_cache.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/ref_counted.h"
@@ -50,6 +51,7 @@ namespace kudu {
 class DnsResolver;
 class PartitionSchema;
 class Sockaddr;
+class ThreadPool;
 
 namespace master {
 class AlterTableRequestPB;
@@ -75,6 +77,7 @@ class ConnectToClusterRpc;
 class MetaCache;
 class RemoteTablet;
 class RemoteTabletServer;
+class WriteFlowControl;
 } // namespace internal
 
 class KuduClient::Data {
@@ -131,6 +134,8 @@ class KuduClient::Data {
                                    master::TableIdentifierPB table,
                                    const MonoTime& deadline);
 
+  // Gets the schema of table 'table_name' from the master, or from
+  // 'table_metadata_cache_' if the client has one.
   Status GetTableSchema(KuduClient* client,
                         const std::string& table_name,
                         const MonoTime& deadline,
@@ -139,6 +144,17 @@ class KuduClient::Data {
                         std::string* table_id,
                         int* num_replicas);
 
+  // Gets the metadata of table 'table_name' from the master, caching it in
+  // 'table_metadata_cache_' if the client has one.
+  Status FetchTableMetadata(
+      KuduClient* client,
+      const std::string& table_name,
+      const MonoTime& deadline,
+      std::shared_ptr<const internal::TableMetadataCache::Entry>* entry);
+
+  // Refreshes the cached metadata of table 'table_name' in the background.
+  void RefreshTableMetadataAsync(KuduClient* client, const std::string& table_name);
+
   Status InitLocalHostNames();
 
   bool IsLocalHostPort(const HostPort& hp) const;
@@ -235,6 +251,27 @@ class KuduClient::Data {
   gscoped_ptr<DnsResolver> dns_resolver_;
   scoped_refptr<internal::MetaCache> meta_cache_;
 
+  // Limits the writes in flight to each tablet, shared by all of the sessions.
+  std::unique_ptr<internal::WriteFlowControl> write_flow_control_;
+
+  // Returns the pool which runs the steps of asynchronous scans which may
+  // block, e.g. opening the next tablet or retrying after an error, creating
+  // it on first use.
+  Status GetAsyncScanPool(ThreadPool** pool);
+
+  // See GetAsyncScanPool(). Protected by 'async_scan_pool_lock_'.
+  gscoped_ptr<ThreadPool> async_scan_pool_;
+  simple_spinlock async_scan_pool_lock_;
+
+  // Caches the metadata of the tables the client opens. Only set if the
+  // client was built with a table metadata cache TTL.
+  std::unique_ptr<internal::TableMetadataCache> table_metadata_cache_;
+
+  // Runs the background refreshes of 'table_metadata_cache_', created on
+  // first use. Protected by 'table_metadata_pool_lock_'.
+  gscoped_ptr<ThreadPool> table_metadata_pool_;
+  simple_spinlock table_metadata_pool_lock_;
+
   // Set of hostnames and IPs on the local host.
   // This is initialized at client startup.
   std::unordered_set<std::string> local_host_names_;
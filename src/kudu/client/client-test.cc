@@ -18,6 +18,7 @@
 #include <algorithm>
 #include <atomic>
 #include <cstdint>
+#include <cstring>
 #include <cstdlib>
 #include <functional>
 #include <iterator>
@@ -55,6 +56,7 @@
 #include "kudu/client/schema.h"
 #include "kudu/client/session-internal.h"
 #include "kudu/client/shared_ptr.h"
+#include "kudu/client/table_metadata_cache.h"
 #include "kudu/client/value.h"
 #include "kudu/client/write_op.h"
 #include "kudu/clock/clock.h"
@@ -94,6 +96,7 @@
 #include "kudu/tserver/ts_tablet_manager.h"
 #include "kudu/tserver/tserver.pb.h"
 #include "kudu/util/async_util.h"
+#include "kudu/util/bitmap.h"
 #include "kudu/util/countdown_latch.h"
 #include "kudu/util/locks.h"  // IWYU pragma: keep
 #include "kudu/util/metrics.h"
@@ -129,6 +132,7 @@ DEFINE_int32(test_scan_num_rows, 1000, "Number of rows to insert and scan");
 METRIC_DECLARE_counter(rpcs_queue_overflow);
 METRIC_DECLARE_histogram(handler_latency_kudu_master_MasterService_GetMasterRegistration);
 METRIC_DECLARE_histogram(handler_latency_kudu_master_MasterService_GetTableLocations);
+METRIC_DECLARE_histogram(handler_latency_kudu_master_MasterService_GetTableSchema);
 METRIC_DECLARE_histogram(handler_latency_kudu_master_MasterService_GetTabletLocations);
 
 using std::bind;
@@ -398,13 +402,19 @@ class ClientTest : public KuduTest {
       ASSERT_OK(scanner.Open());
       ASSERT_TRUE(scanner.HasMoreRows());
       KuduScanBatch batch;
+      int64_t num_rows = 0;
       while (scanner.HasMoreRows()) {
         ASSERT_OK(scanner.NextBatch(&batch));
+        num_rows += batch.NumRows();
       }
       std::map<std::string, int64_t> metrics = scanner.GetResourceMetrics().Get();
       ASSERT_TRUE(ContainsKey(metrics, "cfile_cache_miss_bytes"));
       ASSERT_TRUE(ContainsKey(metrics, "cfile_cache_hit_bytes"));
       ASSERT_GT(metrics["cfile_cache_miss_bytes"] + metrics["cfile_cache_hit_bytes"], 0);
+      // The per-response counts are summed up over the scan.
+      ASSERT_EQ(num_rows, metrics["rows_scanned"]);
+      ASSERT_EQ(num_rows, metrics["rows_returned"]);
+      ASSERT_GT(metrics["cpu_user_nanos"] + metrics["cpu_system_nanos"], 0);
     }
   }
 
@@ -986,6 +996,340 @@ TEST_F(ClientTest, TestScanMultiTablet) {
                                    kNoBound));
 }
 
+static unique_ptr<KuduError> GetSingleErrorFromSession(KuduSession* session) {
+  CHECK_EQ(1, session->CountPendingErrors());
+  vector<KuduError*> errors;
+  bool overflow;
+  session->GetPendingErrors(&errors, &overflow);
+  CHECK(!overflow);
+  CHECK_EQ(1, errors.size());
+  return unique_ptr<KuduError>(errors[0]);
+}
+
+// Test applying batches of operations spanning several tablets, both with a
+// cold and a warm meta cache.
+TEST_F(ClientTest, TestApplyBatchMultiTablet) {
+  static const int kTabletsNum = 5;
+  static const int kRowsPerTablet = 10;
+
+  shared_ptr<KuduTable> table;
+  {
+    vector<unique_ptr<KuduPartialRow>> rows;
+    for (int i = 1; i < kTabletsNum; ++i) {
+      unique_ptr<KuduPartialRow> row(schema_.NewRow());
+      ASSERT_OK(row->SetInt32(0, i * kRowsPerTablet));
+      rows.emplace_back(std::move(row));
+    }
+    ASSERT_NO_FATAL_FAILURE(CreateTable("TestApplyBatchMultiTablet", 1,
+                                        std::move(rows), {}, &table));
+  }
+
+  shared_ptr<KuduSession> session = client_->NewSession();
+  ASSERT_OK(session->SetFlushMode(KuduSession::MANUAL_FLUSH));
+  session->SetTimeoutMillis(5000);
+
+  // Interleave the rows across the tablets, and update every row right
+  // after inserting it: the updates only succeed if the per-tablet order
+  // of the operations is preserved. The nearly empty meta cache forces
+  // most of the lookups through the slow path.
+  const int kNumRows = kTabletsNum * kRowsPerTablet;
+  vector<KuduWriteOperation*> ops;
+  for (int i = 0; i < kRowsPerTablet; ++i) {
+    for (int t = 0; t < kTabletsNum; ++t) {
+      const int key = t * kRowsPerTablet + i;
+      ops.push_back(BuildTestRow(table.get(), key).release());
+      ops.push_back(UpdateTestRow(table.get(), key).release());
+    }
+  }
+  // An operation without a key fails, but doesn't prevent the rest
+  // of the batch from being applied.
+  unique_ptr<KuduInsert> bad_insert(table->NewInsert());
+  ASSERT_OK(bad_insert->mutable_row()->SetInt32("int_val", 54321));
+  KuduInsert* bad_insert_ptr = bad_insert.get();
+  ops.push_back(bad_insert.release());
+  Status s = session->ApplyBatch(ops);
+  ASSERT_TRUE(s.IsIllegalState()) << s.ToString();
+  unique_ptr<KuduError> error = GetSingleErrorFromSession(session.get());
+  ASSERT_EQ(bad_insert_ptr, &error->failed_op());
+  ASSERT_EQ(2 * kNumRows, session->CountBufferedOperations());
+  FlushSessionOrDie(session);
+  ASSERT_EQ(kNumRows, CountRowsFromClient(table.get()));
+
+  // Now that the tablet locations are cached, delete every other row with
+  // a single batch, this time in AUTO_FLUSH_SYNC mode.
+  ASSERT_OK(session->SetFlushMode(KuduSession::AUTO_FLUSH_SYNC));
+  ops.clear();
+  for (int i = 0; i < kNumRows; i += 2) {
+    ops.push_back(DeleteTestRow(table.get(), i).release());
+  }
+  ASSERT_OK(session->ApplyBatch(ops));
+  ASSERT_FALSE(session->HasPendingOperations());
+  ASSERT_EQ(0, session->CountPendingErrors());
+  ASSERT_EQ(kNumRows / 2, CountRowsFromClient(table.get()));
+
+  vector<string> rows;
+  ASSERT_NO_FATAL_FAILURE(ScanTableToStrings(table.get(), &rows));
+  ASSERT_EQ(kNumRows / 2, rows.size());
+  for (const auto& row : rows) {
+    ASSERT_STR_CONTAINS(row, "hello again");
+  }
+}
+
+// Test building INSERT operations from columnar data.
+TEST_F(ClientTest, TestColumnarInsertBuilder) {
+  const int kNumRows = 100;
+  vector<int32_t> keys(kNumRows);
+  vector<int32_t> int_vals(kNumRows);
+  vector<string> strings(kNumRows);
+  vector<Slice> string_vals(kNumRows);
+  vector<uint8_t> string_non_null(BitmapSize(kNumRows));
+  for (int i = 0; i < kNumRows; i++) {
+    keys[i] = i;
+    int_vals[i] = i * 2;
+    strings[i] = Substitute("hello $0", i);
+    string_vals[i] = strings[i];
+    // Every third string is null.
+    BitmapChange(string_non_null.data(), i, i % 3 != 0);
+  }
+
+  {
+    // The key columns are required.
+    KuduColumnarInsertBuilder builder(client_table_, kNumRows);
+    ASSERT_OK(builder.SetColumn("int_val", int_vals.data()));
+    vector<KuduWriteOperation*> ops;
+    Status s = builder.Build(&ops);
+    ASSERT_TRUE(s.IsIllegalState()) << s.ToString();
+    ASSERT_TRUE(ops.empty());
+
+    // Non-nullable columns can't contain nulls, and columns must exist.
+    s = builder.SetColumn("int_val", int_vals.data(), string_non_null.data());
+    ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+    s = builder.SetColumn("no_such_column", int_vals.data());
+    ASSERT_TRUE(s.IsNotFound()) << s.ToString();
+  }
+
+  KuduColumnarInsertBuilder builder(client_table_, kNumRows);
+  ASSERT_OK(builder.SetColumn("key", keys.data()));
+  ASSERT_OK(builder.SetColumn(1, int_vals.data()));
+  ASSERT_OK(builder.SetColumn("string_val", string_vals.data(), string_non_null.data()));
+  vector<KuduWriteOperation*> ops;
+  ASSERT_OK(builder.Build(&ops));
+  ASSERT_EQ(kNumRows, ops.size());
+  ASSERT_EQ(R"(INSERT int32 key=1, int32 int_val=2, string string_val="hello 1")",
+            ops[1]->ToString());
+  ASSERT_EQ("INSERT int32 key=3, int32 int_val=6, string string_val=NULL",
+            ops[3]->ToString());
+
+  shared_ptr<KuduSession> session = client_->NewSession();
+  ASSERT_OK(session->SetFlushMode(KuduSession::MANUAL_FLUSH));
+  ASSERT_OK(session->ApplyBatch(ops));
+  FlushSessionOrDie(session);
+
+  vector<string> rows;
+  ASSERT_NO_FATAL_FAILURE(ScanTableToStrings(client_table_.get(), &rows));
+  ASSERT_EQ(kNumRows, rows.size());
+  ASSERT_TRUE(std::find(rows.begin(), rows.end(),
+                        R"((int32 key=1, int32 int_val=2, string string_val="hello 1", )"
+                        "int32 non_null_with_default=12345)") != rows.end());
+  ASSERT_TRUE(std::find(rows.begin(), rows.end(),
+                        "(int32 key=3, int32 int_val=6, string string_val=NULL, "
+                        "int32 non_null_with_default=12345)") != rows.end());
+}
+
+// Test that aggregates computed by the tablet servers are merged across
+// tablets.
+TEST_F(ClientTest, TestScanWithAggregates) {
+  ASSERT_NO_FATAL_FAILURE(InsertTestRows(client_table_.get(), 20));
+
+  {
+    KuduScanner scanner(client_table_.get());
+    ASSERT_OK(scanner.AddAggregate(KuduScanner::COUNT, ""));
+    ASSERT_OK(scanner.AddAggregate(KuduScanner::SUM, "int_val"));
+    ASSERT_OK(scanner.AddAggregate(KuduScanner::MIN, "string_val"));
+    ASSERT_OK(scanner.AddAggregate(KuduScanner::MAX, "key"));
+    ASSERT_OK(scanner.Open());
+    Status s = scanner.AddAggregate(KuduScanner::COUNT, "");
+    ASSERT_TRUE(s.IsIllegalState()) << s.ToString();
+
+    vector<KuduPartialRow*> results;
+    ElementDeleter drop(&results);
+    ASSERT_OK(scanner.GetAggregateResults(&results));
+    ASSERT_EQ(1, results.size());
+    ASSERT_EQ("int64 count(*)=20, int64 sum(int_val)=380, "
+              "string min(string_val)=\"hello 0\", int32 max(key)=19",
+              results[0]->ToString());
+  }
+
+  {
+    KuduScanner scanner(client_table_.get());
+    ASSERT_OK(scanner.SetProjectedColumnNames({ "key", "int_val" }));
+    ASSERT_OK(scanner.SetGroupByKeyPrefix(1));
+    ASSERT_OK(scanner.AddAggregate(KuduScanner::COUNT, ""));
+    ASSERT_OK(scanner.AddAggregate(KuduScanner::SUM, "int_val"));
+    ASSERT_OK(scanner.AddConjunctPredicate(client_table_->NewComparisonPredicate(
+        "key", KuduPredicate::GREATER_EQUAL, KuduValue::FromInt(5))));
+    ASSERT_OK(scanner.Open());
+
+    vector<KuduPartialRow*> results;
+    ElementDeleter drop(&results);
+    ASSERT_OK(scanner.GetAggregateResults(&results));
+    ASSERT_EQ(15, results.size());
+    for (int i = 0; i < results.size(); i++) {
+      ASSERT_EQ(Substitute("int32 key=$0, int64 count(*)=1, int64 sum(int_val)=$1",
+                           i + 5, (i + 5) * 2),
+                results[i]->ToString());
+    }
+  }
+
+  {
+    KuduScanner scanner(client_table_.get());
+    Status s = scanner.SetGroupByKeyPrefix(2);
+    ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+    ASSERT_OK(scanner.AddAggregate(KuduScanner::SUM, "string_val"));
+    s = scanner.Open();
+    ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+  }
+
+  {
+    KuduScanner scanner(client_table_.get());
+    ASSERT_OK(scanner.Open());
+    vector<KuduPartialRow*> results;
+    Status s = scanner.GetAggregateResults(&results);
+    ASSERT_TRUE(s.IsIllegalState()) << s.ToString();
+  }
+}
+
+// Test scans with a limit and ordered merges across the tablets of a hash
+// partitioned table, whose tablets each hold keys from the whole key range.
+TEST_F(ClientTest, TestScanLimitAndOrderedMerge) {
+  const string kTableName = "hash_table";
+  unique_ptr<KuduTableCreator> table_creator(client_->NewTableCreator());
+  ASSERT_OK(table_creator->table_name(kTableName)
+            .schema(&schema_)
+            .num_replicas(1)
+            .add_hash_partitions({ "key" }, 3)
+            .Create());
+  shared_ptr<KuduTable> table;
+  ASSERT_OK(client_->OpenTable(kTableName, &table));
+  ASSERT_NO_FATAL_FAILURE(InsertTestRows(table.get(), 100));
+
+  {
+    KuduScanner scanner(table.get());
+    ASSERT_OK(scanner.SetLimit(10));
+    vector<string> rows;
+    ASSERT_OK(ScanToStrings(&scanner, &rows));
+    ASSERT_EQ(10, rows.size());
+  }
+
+  {
+    KuduScanner scanner(table.get());
+    ASSERT_OK(scanner.SetOrderedMerge(true));
+    ASSERT_OK(scanner.SetBatchSizeBytes(100));
+    vector<string> rows;
+    ASSERT_OK(ScanToStrings(&scanner, &rows));
+    ASSERT_EQ(100, rows.size());
+    for (int i = 0; i < rows.size(); i++) {
+      ASSERT_EQ(Substitute("(int32 key=$0, int32 int_val=$1, string string_val=\"hello $0\", "
+                           "int32 non_null_with_default=$2)", i, i * 2, i * 3),
+                rows[i]);
+    }
+  }
+
+  {
+    // The first rows from a key onwards.
+    KuduScanner scanner(table.get());
+    ASSERT_OK(scanner.SetProjectedColumnNames({ "int_val", "key" }));
+    ASSERT_OK(scanner.AddConjunctPredicate(table->NewComparisonPredicate(
+        "key", KuduPredicate::GREATER_EQUAL, KuduValue::FromInt(50))));
+    ASSERT_OK(scanner.SetOrderedMerge(true));
+    ASSERT_OK(scanner.SetLimit(7));
+    vector<string> rows;
+    ASSERT_OK(ScanToStrings(&scanner, &rows));
+    ASSERT_EQ(7, rows.size());
+    for (int i = 0; i < rows.size(); i++) {
+      ASSERT_EQ(Substitute("(int32 int_val=$0, int32 key=$1)", (i + 50) * 2, i + 50), rows[i]);
+    }
+  }
+
+  {
+    KuduScanner scanner(table.get());
+    ASSERT_OK(scanner.SetProjectedColumnNames({ "int_val" }));
+    ASSERT_OK(scanner.SetOrderedMerge(true));
+    Status s = scanner.Open();
+    ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+  }
+
+  {
+    KuduScanner scanner(table.get());
+    Status s = scanner.SetLimit(-1);
+    ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+  }
+}
+
+// Drives several scanners of a multi-tablet table at once from a single
+// thread with NextBatchAsync().
+TEST_F(ClientTest, TestNextBatchAsync) {
+  const string kTableName = "async_scan_table";
+  const int kNumRows = 1000;
+  const int kNumScanners = 4;
+  unique_ptr<KuduTableCreator> table_creator(client_->NewTableCreator());
+  ASSERT_OK(table_creator->table_name(kTableName)
+            .schema(&schema_)
+            .num_replicas(1)
+            .add_hash_partitions({ "key" }, 3)
+            .Create());
+  shared_ptr<KuduTable> table;
+  ASSERT_OK(client_->OpenTable(kTableName, &table));
+  ASSERT_NO_FATAL_FAILURE(InsertTestRows(table.get(), kNumRows));
+
+  struct AsyncScan {
+    explicit AsyncScan(KuduTable* table)
+        : scanner(table),
+          cb(&sync, &Synchronizer::StatusCB),
+          num_rows(0) {
+    }
+    KuduScanner scanner;
+    KuduScanBatch batch;
+    Synchronizer sync;
+    KuduStatusMemberCallback<Synchronizer> cb;
+    int num_rows;
+  };
+  vector<unique_ptr<AsyncScan>> scans;
+  for (int i = 0; i < kNumScanners; i++) {
+    unique_ptr<AsyncScan> scan(new AsyncScan(table.get()));
+    // Small batches, so that each tablet takes several RPCs, with and
+    // without prefetching and fault tolerance.
+    ASSERT_OK(scan->scanner.SetBatchSizeBytes(1024));
+    ASSERT_OK(scan->scanner.SetPrefetching(i % 2 == 1));
+    if (i >= kNumScanners / 2) {
+      ASSERT_OK(scan->scanner.SetFaultTolerant());
+    }
+    ASSERT_OK(scan->scanner.Open());
+    scans.emplace_back(std::move(scan));
+  }
+
+  while (true) {
+    vector<AsyncScan*> outstanding;
+    for (const auto& scan : scans) {
+      if (scan->scanner.HasMoreRows()) {
+        scan->sync.Reset();
+        scan->scanner.NextBatchAsync(&scan->batch, &scan->cb);
+        outstanding.push_back(scan.get());
+      }
+    }
+    if (outstanding.empty()) {
+      break;
+    }
+    for (AsyncScan* scan : outstanding) {
+      ASSERT_OK(scan->sync.Wait());
+      scan->num_rows += scan->batch.NumRows();
+    }
+  }
+  for (const auto& scan : scans) {
+    ASSERT_EQ(kNumRows, scan->num_rows);
+  }
+}
+
 TEST_F(ClientTest, TestScanEmptyTable) {
   KuduScanner scanner(client_table_.get());
   ASSERT_OK(scanner.SetProjectedColumns(vector<string>()));
@@ -1024,6 +1368,50 @@ TEST_F(ClientTest, TestScanEmptyProjection) {
   }
 }
 
+// Test scanning with the columnar row format, checking the per-column buffers.
+TEST_F(ClientTest, TestScanColumnarLayout) {
+  const int kNumRows = 1000;
+  ASSERT_NO_FATAL_FAILURE(InsertTestRows(client_table_.get(), kNumRows));
+  KuduScanner scanner(client_table_.get());
+  ASSERT_OK(scanner.SetProjectedColumnNames({ "string_val", "key" }));
+  ASSERT_OK(scanner.SetRowFormatFlags(KuduScanner::COLUMNAR_LAYOUT));
+  ASSERT_OK(scanner.SetFaultTolerant());
+  ASSERT_OK(scanner.Open());
+
+  int expected_key = 0;
+  KuduScanBatch batch;
+  while (scanner.HasMoreRows()) {
+    ASSERT_OK(scanner.NextBatch(&batch));
+    if (batch.NumRows() == 0) continue;
+
+    Slice keys;
+    ASSERT_OK(batch.GetFixedLengthColumn(1, &keys));
+    ASSERT_EQ(batch.NumRows() * sizeof(int32_t), keys.size());
+
+    Slice offsets_data, strings_data, non_null_bitmap;
+    ASSERT_OK(batch.GetVariableLengthColumn(0, &offsets_data, &strings_data));
+    ASSERT_OK(batch.GetNonNullBitmapForColumn(0, &non_null_bitmap));
+    const uint32_t* offsets = reinterpret_cast<const uint32_t*>(offsets_data.data());
+
+    for (int i = 0; i < batch.NumRows(); i++) {
+      int32_t key;
+      memcpy(&key, keys.data() + i * sizeof(int32_t), sizeof(key));
+      ASSERT_EQ(expected_key, key);
+      ASSERT_TRUE(BitmapTest(non_null_bitmap.data(), i));
+      Slice str(strings_data.data() + offsets[i], offsets[i + 1] - offsets[i]);
+      ASSERT_EQ(StringPrintf("hello %d", key), str.ToString());
+      expected_key++;
+    }
+
+    // Using the wrong accessor for a column's type is an error.
+    Slice unused;
+    ASSERT_TRUE(batch.GetFixedLengthColumn(0, &unused).IsInvalidArgument());
+    ASSERT_TRUE(batch.GetVariableLengthColumn(1, &unused, &unused).IsInvalidArgument());
+    ASSERT_TRUE(batch.GetNonNullBitmapForColumn(2, &unused).IsInvalidArgument());
+  }
+  ASSERT_EQ(kNumRows, expected_key);
+}
+
 TEST_F(ClientTest, TestProjectInvalidColumn) {
   KuduScanner scanner(client_table_.get());
   Status s = scanner.SetProjectedColumns({ "column-doesnt-exist" });
@@ -1654,10 +2042,76 @@ TEST_F(ClientTest, TestMetaCacheExpiry) {
   ASSERT_TRUE(entry.stale());
   ASSERT_FALSE(meta_cache->LookupTabletByKeyFastPath(client_table_.get(), "", &entry));
 
-  // Force a lookup and ensure the entry is refreshed.
+  // The expired entry is still usable while being refreshed.
+  bool needs_refresh;
+  ASSERT_TRUE(meta_cache->LookupTabletByKeyFastPath(client_table_.get(), "", &entry,
+                                                    &needs_refresh));
+  ASSERT_TRUE(needs_refresh);
+  ASSERT_TRUE(entry.usable_past_expiration());
+
+  // A lookup is served from the expired entry, and refreshes it in the
+  // background. Use a longer TTL so the refreshed entry doesn't expire
+  // before we check it.
+  FLAGS_table_locations_ttl_ms = 60 * 1000;
   CHECK_NOTNULL(MetaCacheLookup(client_table_.get(), "").get());
-  ASSERT_TRUE(meta_cache->LookupTabletByKeyFastPath(client_table_.get(), "", &entry));
-  ASSERT_FALSE(entry.stale());
+  ASSERT_EVENTUALLY([&]() {
+    ASSERT_TRUE(meta_cache->LookupTabletByKeyFastPath(client_table_.get(), "", &entry));
+    ASSERT_FALSE(entry.stale());
+  });
+}
+
+// Test that concurrent lookups missing the cache are coalesced into few
+// master lookups, and that the locations of a whole key range can be
+// prefetched at once.
+TEST_F(ClientTest, TestMetaCacheLookupCoalescingAndPrefetch) {
+  const int kNumTablets = 20;
+  shared_ptr<KuduTable> table;
+  {
+    vector<unique_ptr<KuduPartialRow>> rows;
+    for (int i = 1; i < kNumTablets; i++) {
+      unique_ptr<KuduPartialRow> row(schema_.NewRow());
+      ASSERT_OK(row->SetInt32(0, i * 10));
+      rows.emplace_back(std::move(row));
+    }
+    ASSERT_NO_FATAL_FAILURE(CreateTable("coalescing", 1, std::move(rows), {}, &table));
+  }
+  auto& meta_cache = client_->data_->meta_cache_;
+
+  // Many concurrent lookups of the same key result in a single master lookup.
+  meta_cache->ClearCache();
+  const int kNumLookups = 100;
+  int initial_lookups = CountMasterLookupRPCs();
+  vector<Synchronizer> syncs(kNumLookups);
+  vector<scoped_refptr<internal::RemoteTablet>> tablets(kNumLookups);
+  for (int i = 0; i < kNumLookups; i++) {
+    meta_cache->LookupTabletByKey(table.get(), "", MonoTime::Now() + MonoDelta::FromSeconds(30),
+                                  &tablets[i], syncs[i].AsStatusCallback());
+  }
+  for (int i = 0; i < kNumLookups; i++) {
+    ASSERT_OK(syncs[i].Wait());
+    ASSERT_EQ(tablets[0].get(), tablets[i].get());
+  }
+  // Reconnecting to the cluster after clearing the cache may take a couple
+  // of extra RPCs, but not one per lookup.
+  ASSERT_LT(CountMasterLookupRPCs() - initial_lookups, 5);
+
+  // Prefetching the whole table caches all of its tablets.
+  meta_cache->ClearCache();
+  Synchronizer sync;
+  meta_cache->PrefetchTabletLocations(table.get(), "", "",
+                                      MonoTime::Now() + MonoDelta::FromSeconds(30),
+                                      sync.AsStatusCallback());
+  ASSERT_OK(sync.Wait());
+  int num_cached = 0;
+  string partition_key;
+  internal::MetaCacheEntry entry;
+  while (meta_cache->LookupTabletByKeyFastPath(table.get(), partition_key, &entry)) {
+    ASSERT_FALSE(entry.is_non_covered_range());
+    num_cached++;
+    partition_key = entry.upper_bound_partition_key();
+    if (partition_key.empty()) break;
+  }
+  ASSERT_EQ(kNumTablets, num_cached);
 }
 
 TEST_F(ClientTest, TestGetTabletServerBlacklist) {
@@ -1928,6 +2382,47 @@ TEST_F(ClientTest, TestScannerKeepAlive) {
   ASSERT_EQ(sum, 499500);
 }
 
+// Test that a scan which prefetches batches returns the same rows as one which
+// doesn't, including when it is closed with a prefetch RPC in flight.
+TEST_F(ClientTest, TestScanWithPrefetching) {
+  NO_FATALS(InsertTestRows(client_table_.get(), 1000));
+
+  for (bool prefetching : { false, true }) {
+    SCOPED_TRACE(prefetching);
+    KuduScanner scanner(client_table_.get());
+    ASSERT_OK(scanner.SetPrefetching(prefetching));
+    // Make sure the scan of each tablet takes several batches.
+    ASSERT_OK(scanner.SetBatchSizeBytes(100));
+    ASSERT_OK(scanner.Open());
+    ASSERT_TRUE(scanner.SetPrefetching(prefetching).IsIllegalState());
+
+    KuduScanBatch batch;
+    int64_t sum = 0;
+    int num_rows = 0;
+    while (scanner.HasMoreRows()) {
+      ASSERT_OK(scanner.NextBatch(&batch));
+      sum += SumResults(batch);
+      num_rows += batch.NumRows();
+    }
+    ASSERT_EQ(1000, num_rows);
+    ASSERT_EQ(499500, sum);
+  }
+
+  {
+    KuduScanner scanner(client_table_.get());
+    ASSERT_OK(scanner.SetPrefetching(true));
+    ASSERT_OK(scanner.SetBatchSizeBytes(100));
+    ASSERT_OK(scanner.Open());
+    KuduScanBatch batch;
+    while (scanner.HasMoreRows()) {
+      ASSERT_OK(scanner.NextBatch(&batch));
+      if (batch.NumRows() > 0) break;
+    }
+    ASSERT_TRUE(scanner.HasMoreRows());
+    scanner.Close();
+  }
+}
+
 // Test cleanup of scanners on the server side when closed.
 TEST_F(ClientTest, TestCloseScanner) {
   ASSERT_NO_FATAL_FAILURE(InsertTestRows(client_table_.get(), 10));
@@ -2017,16 +2512,6 @@ TEST_F(ClientTest, TestScanTimeout) {
   }
 }
 
-static unique_ptr<KuduError> GetSingleErrorFromSession(KuduSession* session) {
-  CHECK_EQ(1, session->CountPendingErrors());
-  vector<KuduError*> errors;
-  bool overflow;
-  session->GetPendingErrors(&errors, &overflow);
-  CHECK(!overflow);
-  CHECK_EQ(1, errors.size());
-  return unique_ptr<KuduError>(errors[0]);
-}
-
 // Simplest case of inserting through the client API: a single row
 // with manual batching.
 TEST_F(ClientTest, TestInsertSingleRowManualBatch) {
@@ -4167,7 +4652,7 @@ TEST_F(ClientTest, TestCreateTableWithInvalidEncodings) {
   KuduSchema schema;
   KuduSchemaBuilder schema_builder;
   schema_builder.AddColumn("key")->Type(KuduColumnSchema::INT32)->NotNull()->PrimaryKey()
-      ->Encoding(KuduColumnStorageAttributes::DICT_ENCODING);
+      ->Encoding(KuduColumnStorageAttributes::PREFIX_ENCODING);
   ASSERT_OK(schema_builder.Build(&schema));
   Status s = table_creator->table_name("foobar")
       .schema(&schema)
@@ -4176,7 +4661,7 @@ TEST_F(ClientTest, TestCreateTableWithInvalidEncodings) {
   ASSERT_TRUE(s.IsNotSupported()) << s.ToString();
   ASSERT_STR_CONTAINS(s.ToString(),
                       "invalid encoding for column 'key': encoding "
-                      "DICT_ENCODING not supported for type INT32");
+                      "PREFIX_ENCODING not supported for type INT32");
 }
 
 TEST_F(ClientTest, TestCreateTableWithTooManyColumns) {
@@ -5102,6 +5587,81 @@ TEST_F(ClientTest, TestGetSecurityInfoFromMaster) {
   ASSERT_EQ(authn_creds, new_authn_creds);
 }
 
+// Test that the clients built with share_connections() share their messenger,
+// and with it their connections, unless their credentials differ.
+TEST_F(ClientTest, TestShareConnections) {
+  const string master_addr = cluster_->mini_master()->bound_rpc_addr().ToString();
+  shared_ptr<KuduClient> client1;
+  ASSERT_OK(KuduClientBuilder()
+            .add_master_server_addr(master_addr)
+            .share_connections(true)
+            .Build(&client1));
+  shared_ptr<KuduClient> client2;
+  ASSERT_OK(KuduClientBuilder()
+            .add_master_server_addr(master_addr)
+            .share_connections(true)
+            .Build(&client2));
+  ASSERT_EQ(client1->data_->messenger_.get(), client2->data_->messenger_.get());
+
+  // Clients not asking to share, or with other credentials, get their own.
+  ASSERT_NE(client_->data_->messenger_.get(), client1->data_->messenger_.get());
+  string authn_creds;
+  ASSERT_OK(client_->ExportAuthenticationCredentials(&authn_creds));
+  shared_ptr<KuduClient> client3;
+  ASSERT_OK(KuduClientBuilder()
+            .add_master_server_addr(master_addr)
+            .import_authentication_credentials(authn_creds)
+            .share_connections(true)
+            .Build(&client3));
+  ASSERT_NE(client1->data_->messenger_.get(), client3->data_->messenger_.get());
+
+  // The messenger outlives the client which created it.
+  client1.reset();
+  shared_ptr<KuduTable> table;
+  ASSERT_OK(client2->OpenTable(kTableName, &table));
+}
+
+// Test that the clients built with a table metadata cache open tables without
+// asking the master, until the cached metadata is invalidated.
+TEST_F(ClientTest, TestTableMetadataCache) {
+  const auto count_get_table_schema = [&]() {
+    return METRIC_handler_latency_kudu_master_MasterService_GetTableSchema
+        .Instantiate(cluster_->mini_master()->master()->metric_entity())->TotalCount();
+  };
+  shared_ptr<KuduClient> client;
+  ASSERT_OK(KuduClientBuilder()
+            .add_master_server_addr(cluster_->mini_master()->bound_rpc_addr().ToString())
+            .table_metadata_cache_ttl(MonoDelta::FromSeconds(600))
+            .Build(&client));
+
+  const auto initial_count = count_get_table_schema();
+  shared_ptr<KuduTable> table;
+  for (int i = 0; i < 3; i++) {
+    ASSERT_OK(client->OpenTable(kTableName, &table));
+  }
+  ASSERT_EQ(initial_count + 1, count_get_table_schema());
+
+  // Altering the table drops its cached metadata, and the table is then
+  // opened with its new schema.
+  unique_ptr<KuduTableAlterer> alterer(client->NewTableAlterer(kTableName));
+  alterer->AddColumn("new_col")->Type(KuduColumnSchema::INT32);
+  ASSERT_OK(alterer->Alter());
+  ASSERT_OK(client->OpenTable(kTableName, &table));
+  ASSERT_EQ(initial_count + 2, count_get_table_schema());
+  const KuduSchema& schema = table->schema();
+  ASSERT_EQ("new_col", schema.Column(schema.num_columns() - 1).name());
+
+  // So does a tablet server reporting a mismatched schema of the table.
+  client->data_->table_metadata_cache_->InvalidateTableId(table->id());
+  ASSERT_OK(client->OpenTable(kTableName, &table));
+  ASSERT_EQ(initial_count + 3, count_get_table_schema());
+
+  // The tables of clients built without the cache are always fetched.
+  ASSERT_OK(client_->OpenTable(kTableName, &table));
+  ASSERT_OK(client_->OpenTable(kTableName, &table));
+  ASSERT_EQ(initial_count + 5, count_get_table_schema());
+}
+
 struct ServiceUnavailableRetryParams {
   MonoDelta usurper_sleep;
   MonoDelta client_timeout;
@@ -28,8 +28,10 @@
 #include "kudu/client/client.h"
 #include "kudu/client/client-internal.h"
 #include "kudu/client/error_collector.h"
+#include "kudu/client/scanner-internal.h"
 #include "kudu/client/schema.h"
 #include "kudu/client/value.h"
+#include "kudu/client/write_flow_control.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/status.h"
@@ -221,5 +223,103 @@ TEST(ClientUnitTest, TestErrorCollector) {
   }
 }
 
+TEST(ClientUnitTest, TestScanBatchSizer) {
+  const auto ms = [](int64_t v) { return MonoDelta::FromMilliseconds(v); };
+  const uint32_t kInitial = ScanBatchSizer::kDefaultBatchSizeBytes;
+  ScanBatchSizer sizer(kInitial);
+  ASSERT_EQ(kInitial, sizer.batch_size_bytes());
+
+  // Batches which end before their size, e.g. at the end of a tablet, don't
+  // change it.
+  sizer.RecordBatch(kInitial / 4, ms(10), ms(1), MonoDelta(), false);
+  ASSERT_EQ(kInitial, sizer.batch_size_bytes());
+
+  // Full batches dominated by the network grow, up to the maximum size.
+  sizer.RecordBatch(kInitial, ms(10), ms(1), MonoDelta(), false);
+  ASSERT_EQ(kInitial * 2, sizer.batch_size_bytes());
+  for (int i = 0; i < 10; i++) {
+    sizer.RecordBatch(sizer.batch_size_bytes(), ms(10), ms(1), MonoDelta(), false);
+  }
+  ASSERT_EQ(ScanBatchSizer::kMaxBatchSizeBytes, sizer.batch_size_bytes());
+
+  // Slow RPCs shrink the batches, down to the minimum size.
+  sizer.RecordBatch(sizer.batch_size_bytes(), ms(500), ms(1), MonoDelta(), false);
+  ASSERT_EQ(ScanBatchSizer::kMaxBatchSizeBytes / 2, sizer.batch_size_bytes());
+  for (int i = 0; i < 20; i++) {
+    sizer.RecordBatch(sizer.batch_size_bytes(), ms(500), ms(1), MonoDelta(), false);
+  }
+  ASSERT_EQ(ScanBatchSizer::kMinBatchSizeBytes, sizer.batch_size_bytes());
+
+  // Batches dominated by the tablet server don't grow.
+  ScanBatchSizer server_bound(kInitial);
+  server_bound.RecordBatch(kInitial, ms(10), ms(8), MonoDelta(), false);
+  ASSERT_EQ(kInitial, server_bound.batch_size_bytes());
+
+  // With prefetching, a slow application shrinks the batches, and one which
+  // isn't much faster than the RPCs doesn't grow them.
+  ScanBatchSizer prefetched(kInitial);
+  prefetched.RecordBatch(kInitial, ms(10), ms(1), ms(8), true);
+  ASSERT_EQ(kInitial, prefetched.batch_size_bytes());
+  prefetched.RecordBatch(kInitial, ms(10), ms(1), ms(20), true);
+  ASSERT_EQ(kInitial / 2, prefetched.batch_size_bytes());
+  prefetched.RecordBatch(kInitial / 2, ms(10), ms(1), ms(1), true);
+  ASSERT_EQ(kInitial, prefetched.batch_size_bytes());
+
+  // An initial size below the minimum bounds the batches instead.
+  ScanBatchSizer small(1024);
+  small.RecordBatch(1024, ms(500), ms(1), MonoDelta(), false);
+  ASSERT_EQ(1024, small.batch_size_bytes());
+}
+
+TEST(ClientUnitTest, TestWriteFlowControl) {
+  using internal::WriteFlowControl;
+  WriteFlowControl flow_control;
+  const string kTablet = "tablet";
+  ASSERT_EQ(WriteFlowControl::kMaxWindow, flow_control.window(kTablet));
+  ASSERT_EQ(WriteFlowControl::kMaxBatchBytes, flow_control.max_batch_bytes(kTablet));
+
+  // Up to a window's worth of RPCs are sent right away.
+  int num_sent = 0;
+  const auto send = [&]() { num_sent++; };
+  for (int i = 0; i < WriteFlowControl::kMaxWindow; i++) {
+    flow_control.Send(kTablet, send);
+  }
+  ASSERT_EQ(WriteFlowControl::kMaxWindow, num_sent);
+
+  // Overload halves the limits, once per decrease interval.
+  flow_control.RecordResponse(kTablet, true);
+  flow_control.RecordResponse(kTablet, true);
+  ASSERT_EQ(WriteFlowControl::kMaxWindow / 2, flow_control.window(kTablet));
+  ASSERT_EQ(WriteFlowControl::kMaxBatchBytes / 2, flow_control.max_batch_bytes(kTablet));
+
+  // RPCs beyond the window are queued until enough of those in flight complete.
+  flow_control.Send(kTablet, send);
+  ASSERT_EQ(WriteFlowControl::kMaxWindow, num_sent);
+  for (int i = 0; i < WriteFlowControl::kMaxWindow / 2; i++) {
+    flow_control.Release(kTablet);
+  }
+  ASSERT_EQ(WriteFlowControl::kMaxWindow, num_sent);
+  flow_control.Release(kTablet);
+  ASSERT_EQ(WriteFlowControl::kMaxWindow + 1, num_sent);
+
+  // The limits have lower bounds.
+  for (int i = 0; i < 20; i++) {
+    SleepFor(MonoDelta::FromMilliseconds(WriteFlowControl::kDecreaseIntervalMs));
+    flow_control.RecordResponse(kTablet, true);
+  }
+  ASSERT_EQ(WriteFlowControl::kMinWindow, flow_control.window(kTablet));
+  ASSERT_EQ(WriteFlowControl::kMinBatchBytes, flow_control.max_batch_bytes(kTablet));
+
+  // Responses from a server which isn't overloaded grow the limits back.
+  for (int i = 0; i < 1000; i++) {
+    flow_control.RecordResponse(kTablet, false);
+  }
+  ASSERT_EQ(WriteFlowControl::kMaxWindow, flow_control.window(kTablet));
+  ASSERT_EQ(WriteFlowControl::kMaxBatchBytes, flow_control.max_batch_bytes(kTablet));
+  for (int i = 0; i < WriteFlowControl::kMaxWindow / 2; i++) {
+    flow_control.Release(kTablet);
+  }
+}
+
 } // namespace client
 } // namespace kudu
@@ -17,11 +17,14 @@
 
 #include "kudu/client/client.h"
 
+#include <algorithm>
 #include <cstdlib>
 #include <memory>
+#include <mutex>
 #include <ostream>
 #include <set>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -48,10 +51,12 @@
 #include "kudu/client/table-internal.h"
 #include "kudu/client/table_alterer-internal.h"
 #include "kudu/client/table_creator-internal.h"
+#include "kudu/client/table_metadata_cache.h"
 #include "kudu/client/tablet-internal.h"
 #include "kudu/client/tablet_server-internal.h"
 #include "kudu/client/value.h"
 #include "kudu/client/write_op.h"
+#include "kudu/common/aggregation.h"
 #include "kudu/common/common.pb.h"
 #include "kudu/common/partial_row.h"
 #include "kudu/common/partition.h"
@@ -70,6 +75,7 @@
 #include "kudu/gutil/move.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/gutil/stl_util.h"
+#include "kudu/gutil/strings/join.h"
 #include "kudu/gutil/strings/numbers.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/master/master.pb.h"
@@ -93,6 +99,8 @@
 #include "kudu/util/net/net_util.h"
 #include "kudu/util/oid_generator.h"
 #include "kudu/util/scoped_cleanup.h"
+#include "kudu/util/thread_restrictions.h"
+#include "kudu/util/threadpool.h"
 #include "kudu/util/version_info.h"
 
 using kudu::master::AlterTableRequestPB;
@@ -150,6 +158,7 @@ namespace client {
 class ResourceMetrics;
 
 using internal::MetaCache;
+using internal::TableMetadataCache;
 using sp::shared_ptr;
 
 static const char* kProgName = "kudu_client";
@@ -284,6 +293,16 @@ KuduClientBuilder& KuduClientBuilder::import_authentication_credentials(string a
   return *this;
 }
 
+KuduClientBuilder& KuduClientBuilder::share_connections(bool share) {
+  data_->share_connections_ = share;
+  return *this;
+}
+
+KuduClientBuilder& KuduClientBuilder::table_metadata_cache_ttl(const MonoDelta& ttl) {
+  data_->table_metadata_cache_ttl_ = ttl;
+  return *this;
+}
+
 namespace {
 Status ImportAuthnCredsToMessenger(const string& authn_creds,
                                    Messenger* messenger) {
@@ -309,19 +328,62 @@ Status ImportAuthnCredsToMessenger(const string& authn_creds,
   }
   return Status::OK();
 }
+
+Status CreateMessenger(const string& authn_creds, std::shared_ptr<Messenger>* messenger) {
+  MessengerBuilder builder("client");
+  RETURN_NOT_OK(builder.Build(messenger));
+
+  // Parse and import the provided authn data, if any.
+  if (!authn_creds.empty()) {
+    RETURN_NOT_OK(ImportAuthnCredsToMessenger(authn_creds, messenger->get()));
+  }
+  return Status::OK();
+}
+
+// Returns the messenger shared by the clients of the masters in
+// 'master_server_addrs' with the credentials in 'authn_creds', creating it
+// if no such client is alive.
+Status GetSharedMessenger(vector<string> master_server_addrs,
+                          const string& authn_creds,
+                          std::shared_ptr<Messenger>* messenger) {
+  // Leaked on purpose, so that clients destroyed during static destruction
+  // do not outlive it.
+  static std::mutex* lock = new std::mutex();
+  static auto* messengers = new std::unordered_map<string, std::weak_ptr<Messenger>>();
+
+  std::sort(master_server_addrs.begin(), master_server_addrs.end());
+  const string key = JoinStrings(master_server_addrs, ",") + "|" + authn_creds;
+
+  std::lock_guard<std::mutex> l(*lock);
+  *messenger = (*messengers)[key].lock();
+  if (*messenger) {
+    return Status::OK();
+  }
+  RETURN_NOT_OK(CreateMessenger(authn_creds, messenger));
+
+  // Drop the entries of the messengers no client uses anymore.
+  for (auto it = messengers->begin(); it != messengers->end();) {
+    if (it->second.expired()) {
+      it = messengers->erase(it);
+    } else {
+      ++it;
+    }
+  }
+  (*messengers)[key] = *messenger;
+  return Status::OK();
+}
 } // anonymous namespace
 
 Status KuduClientBuilder::Build(shared_ptr<KuduClient>* client) {
   RETURN_NOT_OK(CheckCPUFlags());
 
   // Init messenger.
-  MessengerBuilder builder("client");
   std::shared_ptr<Messenger> messenger;
-  RETURN_NOT_OK(builder.Build(&messenger));
-
-  // Parse and import the provided authn data, if any.
-  if (!data_->authn_creds_.empty()) {
-    RETURN_NOT_OK(ImportAuthnCredsToMessenger(data_->authn_creds_, messenger.get()));
+  if (data_->share_connections_) {
+    RETURN_NOT_OK(GetSharedMessenger(data_->master_server_addrs_, data_->authn_creds_,
+                                     &messenger));
+  } else {
+    RETURN_NOT_OK(CreateMessenger(data_->authn_creds_, &messenger));
   }
 
   shared_ptr<KuduClient> c(new KuduClient());
@@ -337,6 +399,11 @@ Status KuduClientBuilder::Build(shared_ptr<KuduClient>* client) {
                         "Could not connect to the cluster");
 
   c->data_->meta_cache_.reset(new MetaCache(c.get()));
+  const MonoDelta& table_metadata_ttl = data_->table_metadata_cache_ttl_;
+  if (table_metadata_ttl.Initialized() &&
+      table_metadata_ttl > MonoDelta::FromNanoseconds(0)) {
+    c->data_->table_metadata_cache_.reset(new TableMetadataCache(table_metadata_ttl));
+  }
   c->data_->dns_resolver_.reset(new DnsResolver());
 
   // Init local host names used for locality decisions.
@@ -862,6 +929,25 @@ KuduPredicate* KuduTable::NewInListPredicate(const Slice& col_name,
   });
 }
 
+KuduPredicate* KuduTable::NewInBloomFilterPredicate(const Slice& col_name,
+                                                    vector<KuduValue*>* values,
+                                                    double false_positive_rate) {
+  // We always take ownership of values; this ensures cleanup if the predicate is invalid.
+  auto cleanup = MakeScopedCleanup([&]() {
+    STLDeleteElements(values);
+  });
+  if (!(false_positive_rate > 0 && false_positive_rate < 1)) {
+    return new KuduPredicate(new ErrorPredicateData(Status::InvalidArgument(
+        Substitute("invalid bloom filter false positive rate: $0", false_positive_rate))));
+  }
+  return data_->MakePredicate(col_name, [&](const ColumnSchema& col_schema) {
+    // Ownership of values is passed to the valid returned predicate.
+    cleanup.cancel();
+    return new KuduPredicate(new InBloomFilterPredicateData(col_schema, values,
+                                                            false_positive_rate));
+  });
+}
+
 KuduPredicate* KuduTable::NewIsNotNullPredicate(const Slice& col_name) {
   return data_->MakePredicate(col_name, [&](const ColumnSchema& col_schema) {
     return new KuduPredicate(new IsNotNullPredicateData(col_schema));
@@ -983,6 +1069,17 @@ Status KuduSession::Apply(KuduWriteOperation* write_op) {
   return Status::OK();
 }
 
+Status KuduSession::ApplyBatch(const vector<KuduWriteOperation*>& write_ops) {
+  Status s = data_->ApplyWriteOps(write_ops);
+  if (data_->flush_mode_ == AUTO_FLUSH_SYNC) {
+    Status flush_status = data_->Flush();
+    if (s.ok()) {
+      s = std::move(flush_status);
+    }
+  }
+  return s;
+}
+
 int KuduSession::CountBufferedOperations() const {
   return data_->CountBufferedOperations();
 }
@@ -1224,6 +1321,24 @@ Status KuduScanner::SetFaultTolerant() {
   return data_->mutable_configuration()->SetFaultTolerant(true);
 }
 
+Status KuduScanner::SetLimit(int64_t limit) {
+  if (data_->open_) {
+    return Status::IllegalState("Limit must be set before Open()");
+  }
+  return data_->mutable_configuration()->SetLimit(limit);
+}
+
+Status KuduScanner::SetOrderedMerge(bool ordered_merge) {
+  if (data_->open_) {
+    return Status::IllegalState("Ordered merge must be set before Open()");
+  }
+  if (ordered_merge) {
+    RETURN_NOT_OK(data_->mutable_configuration()->SetFaultTolerant(true));
+  }
+  data_->mutable_configuration()->SetOrderedMerge(ordered_merge);
+  return Status::OK();
+}
+
 Status KuduScanner::SetSnapshotMicros(uint64_t snapshot_timestamp_micros) {
   if (data_->open_) {
     return Status::IllegalState("Snapshot timestamp must be set before Open()");
@@ -1232,6 +1347,17 @@ Status KuduScanner::SetSnapshotMicros(uint64_t snapshot_timestamp_micros) {
   return Status::OK();
 }
 
+Status KuduScanner::SetMaxStalenessMillis(int64_t max_staleness_ms) {
+  if (data_->open_) {
+    return Status::IllegalState("Maximum staleness must be set before Open()");
+  }
+  if (max_staleness_ms < 0) {
+    return Status::InvalidArgument("Maximum staleness must not be negative");
+  }
+  data_->mutable_configuration()->SetMaxStalenessMillis(max_staleness_ms);
+  return Status::OK();
+}
+
 Status KuduScanner::SetSnapshotRaw(uint64_t snapshot_timestamp) {
   if (data_->open_) {
     return Status::IllegalState("Snapshot timestamp must be set before Open()");
@@ -1298,14 +1424,70 @@ Status KuduScanner::SetCacheBlocks(bool cache_blocks) {
   return data_->mutable_configuration()->SetCacheBlocks(cache_blocks);
 }
 
+Status KuduScanner::SetPrefetching(bool prefetching) {
+  if (data_->open_) {
+    return Status::IllegalState("Prefetching must be set before Open()");
+  }
+  data_->mutable_configuration()->SetPrefetching(prefetching);
+  return Status::OK();
+}
+
+Status KuduScanner::SetAdaptiveBatchSizing(bool adaptive) {
+  if (data_->open_) {
+    return Status::IllegalState("Adaptive batch sizing must be set before Open()");
+  }
+  data_->mutable_configuration()->SetAdaptiveBatchSizing(adaptive);
+  return Status::OK();
+}
+
 KuduSchema KuduScanner::GetProjectionSchema() const {
   return KuduSchema(*data_->configuration().projection());
 }
 
+Status KuduScanner::AddAggregate(AggregateFunction function, const string& col_name) {
+  if (data_->open_) {
+    return Status::IllegalState("Aggregates must be added before Open()");
+  }
+  AggregationSpecPB::Function pb_function;
+  switch (function) {
+    case COUNT: pb_function = AggregationSpecPB::COUNT; break;
+    case SUM: pb_function = AggregationSpecPB::SUM; break;
+    case MIN: pb_function = AggregationSpecPB::MIN; break;
+    case MAX: pb_function = AggregationSpecPB::MAX; break;
+    default:
+      return Status::InvalidArgument(Substitute("Invalid aggregate function: $0", function));
+  }
+  data_->mutable_configuration()->AddAggregate(pb_function, col_name);
+  return Status::OK();
+}
+
+Status KuduScanner::SetGroupByKeyPrefix(int num_key_columns) {
+  if (data_->open_) {
+    return Status::IllegalState("Group-by columns must be set before Open()");
+  }
+  return data_->mutable_configuration()->SetGroupByKeyPrefix(num_key_columns);
+}
+
+Status KuduScanner::GetAggregateResults(vector<KuduPartialRow*>* results) {
+  if (!data_->open_) {
+    return Status::IllegalState("Scanner was not open");
+  }
+  if (!data_->aggregator_) {
+    return Status::IllegalState("Scan has no aggregates");
+  }
+  KuduScanBatch batch;
+  while (HasMoreRows()) {
+    RETURN_NOT_OK(NextBatch(&batch));
+  }
+  data_->aggregator_->GetResultRows(results);
+  return Status::OK();
+}
+
 Status KuduScanner::SetRowFormatFlags(uint64_t flags) {
   switch (flags) {
     case NO_FLAGS:
     case PAD_UNIXTIME_MICROS_TO_16_BYTES:
+    case COLUMNAR_LAYOUT:
       break;
     default:
       return Status::InvalidArgument(Substitute("Invalid row format flags: $0", flags));
@@ -1351,6 +1533,26 @@ Status KuduScanner::Open() {
   CHECK(!data_->open_) << "Scanner already open";
 
   data_->mutable_configuration()->OptimizeScanSpec();
+  data_->num_rows_returned_ = 0;
+  data_->aggregator_.reset();
+  data_->batch_sizer_.reset();
+  data_->batch_handed_out_ = MonoTime();
+  data_->consumer_time_ = MonoDelta();
+  if (data_->configuration().adaptive_batch_sizing()) {
+    data_->batch_sizer_.reset(new ScanBatchSizer(
+        data_->configuration().has_batch_size_bytes() ?
+            data_->configuration().batch_size_bytes() :
+            ScanBatchSizer::kDefaultBatchSizeBytes));
+  }
+  if (data_->configuration().has_aggregation()) {
+    if (data_->configuration().has_limit() || data_->configuration().ordered_merge()) {
+      return Status::InvalidArgument(
+          "Aggregates can't be combined with a limit or an ordered merge");
+    }
+    RETURN_NOT_OK(ScanAggregator::Create(data_->configuration().aggregation(),
+                                         *data_->configuration().projection(),
+                                         &data_->aggregator_));
+  }
   data_->partition_pruner_.Init(*data_->table_->schema().schema_,
                                 data_->table_->partition_schema(),
                                 data_->configuration().spec());
@@ -1366,8 +1568,13 @@ Status KuduScanner::Open() {
   VLOG(2) << "Beginning " << data_->DebugString();
 
   MonoTime deadline = MonoTime::Now() + data_->configuration().timeout();
-  set<string> blacklist;
+  if (data_->configuration().ordered_merge()) {
+    RETURN_NOT_OK(data_->OpenOrderedMerge(deadline));
+    data_->open_ = true;
+    return Status::OK();
+  }
 
+  set<string> blacklist;
   RETURN_NOT_OK(data_->OpenNextTablet(deadline, &blacklist));
 
   data_->open_ = true;
@@ -1388,6 +1595,11 @@ void KuduScanner::Close() {
   // If the scan did not match any rows, the tserver will not assign a scanner ID.
   // This is reflected in the Open() response. In this case, there is no server-side state
   // to clean up.
+  if (data_->prefetch_in_flight_) {
+    // Let the prefetch RPC complete so that the close request isn't rejected
+    // for arriving out of sequence.
+    ignore_result(data_->WaitForPrefetchRpc());
+  }
   if (!data_->next_req_.scanner_id().empty()) {
     CHECK(data_->proxy_);
     gscoped_ptr<CloseCallback> closer(new CloseCallback);
@@ -1400,13 +1612,19 @@ void KuduScanner::Close() {
     ignore_result(closer.release());
   }
   data_->proxy_.reset();
+  data_->merge_sources_.clear();
+  data_->merge_heap_.clear();
   data_->open_ = false;
   return;
 }
 
 bool KuduScanner::HasMoreRows() const {
   CHECK(data_->open_);
+  if (data_->configuration().ordered_merge()) {
+    return !data_->short_circuit_ && !data_->ReachedLimit() && !data_->merge_heap_.empty();
+  }
   return !data_->short_circuit_ &&                 // The scan is not short circuited
+      !data_->ReachedLimit() &&                    // The scan returned fewer rows than its limit
       (data_->data_in_open_ ||                     // more data in hand
        data_->last_response_.has_more_results() || // more data in this tablet
        data_->MoreTablets());                      // more tablets to scan, possibly with more data
@@ -1424,12 +1642,7 @@ Status KuduScanner::NextBatch(vector<KuduRowResult>* rows) {
 }
 
 Status KuduScanner::NextBatch(KuduScanBatch* batch) {
-  // TODO: do some double-buffering here -- when we return this batch
-  // we should already have fired off the RPC for the next batch, but
-  // need to do some swapping of the response objects around to avoid
-  // stomping on the memory the user is looking at.
   CHECK(data_->open_);
-  CHECK(data_->proxy_);
 
   batch->data_->Clear();
 
@@ -1437,15 +1650,28 @@ Status KuduScanner::NextBatch(KuduScanBatch* batch) {
     return Status::OK();
   }
 
+  if (data_->configuration().ordered_merge()) {
+    return data_->NextMergedBatch(batch->data_);
+  }
+  CHECK(data_->proxy_);
+
+  if (data_->batch_sizer_ && data_->batch_handed_out_.Initialized()) {
+    data_->consumer_time_ = MonoTime::Now() - data_->batch_handed_out_;
+  }
+
   if (data_->data_in_open_) {
     // We have data from a previous scan.
     VLOG(2) << "Extracting data from " << data_->DebugString();
     data_->data_in_open_ = false;
-    return batch->data_->Reset(&data_->controller_,
-                               data_->configuration().projection(),
-                               data_->configuration().client_projection(),
-                               data_->configuration().row_format_flags(),
-                               make_gscoped_ptr(data_->last_response_.release_data()));
+    RETURN_NOT_OK(batch->data_->Reset(
+        &data_->controller_,
+        data_->configuration().projection(),
+        data_->configuration().client_projection(),
+        data_->configuration().row_format_flags(),
+        make_gscoped_ptr(data_->last_response_.release_data()),
+        make_gscoped_ptr(data_->last_response_.release_columnar_data())));
+    data_->FinishBatch(batch->data_);
+    return Status::OK();
   }
 
   if (data_->last_response_.has_more_results()) {
@@ -1453,50 +1679,17 @@ Status KuduScanner::NextBatch(KuduScanBatch* batch) {
     VLOG(2) << "Continuing " << data_->DebugString();
 
     MonoTime batch_deadline = MonoTime::Now() + data_->configuration().timeout();
-    data_->PrepareRequest(KuduScanner::Data::CONTINUE);
-
-    while (true) {
-      bool allow_time_for_failover = data_->configuration().is_fault_tolerant();
-      ScanRpcStatus result = data_->SendScanRpc(batch_deadline, allow_time_for_failover);
-
-      // Success case.
-      if (result.result == ScanRpcStatus::OK) {
-        if (data_->last_response_.has_last_primary_key()) {
-          data_->last_primary_key_ = data_->last_response_.last_primary_key();
-        }
-        data_->scan_attempts_ = 0;
-        return batch->data_->Reset(&data_->controller_,
-                                   data_->configuration().projection(),
-                                   data_->configuration().client_projection(),
-                                   data_->configuration().row_format_flags(),
-                                   make_gscoped_ptr(data_->last_response_.release_data()));
-      }
-
-      data_->scan_attempts_++;
-
-      // Error handling.
-      set<string> blacklist;
-      Status s = data_->HandleError(result, batch_deadline, &blacklist);
-      if (!s.ok()) {
-        LOG(WARNING) << "Scan at tablet server " << data_->ts_->ToString() << " of tablet "
-                     << data_->DebugString() << " failed: " << result.status.ToString();
-        return s;
-      }
-
-      if (data_->configuration().is_fault_tolerant()) {
-        LOG(WARNING) << "Attempting to retry scan of tablet " << data_->DebugString()
-                     << " elsewhere.";
-        return data_->ReopenCurrentTablet(batch_deadline, &blacklist);
-      }
-
-      if (blacklist.empty()) {
-        // If we didn't blacklist the current server, we can just retry again.
-        continue;
-      }
-      // If we blacklisted the current server, and it's not fault-tolerant, we can't
-      // retry anywhere, so just propagate the error.
-      return result.status;
+    // If the continuation was prefetched, its request has already been
+    // prepared and sent.
+    bool use_prefetched = data_->prefetch_in_flight_;
+    if (!use_prefetched) {
+      data_->PrepareRequest(KuduScanner::Data::CONTINUE);
     }
+
+    ScanRpcStatus result = use_prefetched ?
+        data_->WaitForPrefetchRpc() :
+        data_->SendScanRpc(batch_deadline, data_->configuration().is_fault_tolerant());
+    return data_->ProcessContinueResult(result, batch_deadline, batch->data_);
   } else if (data_->MoreTablets()) {
     // More data may be available in other tablets.
     // No need to close the current tablet; we scanned all the data so the
@@ -1515,8 +1708,72 @@ Status KuduScanner::NextBatch(KuduScanBatch* batch) {
   }
 }
 
+void KuduScanner::NextBatchAsync(KuduScanBatch* batch, KuduStatusCallback* cb) {
+  CHECK(data_->open_);
+
+  if (data_->short_circuit_ || data_->data_in_open_ || !HasMoreRows()) {
+    // No RPC is needed.
+    cb->Run(NextBatch(batch));
+    return;
+  }
+
+  if (data_->configuration().ordered_merge() || !data_->last_response_.has_more_results()) {
+    // Opening the next tablet, or refilling the sources of an ordered merge,
+    // blocks on RPCs: do it on a client thread.
+    ThreadPool* pool;
+    Status s = data_->table_->client()->data_->GetAsyncScanPool(&pool);
+    if (s.ok()) {
+      s = pool->SubmitFunc([this, batch, cb]() { cb->Run(NextBatch(batch)); });
+    }
+    if (!s.ok()) {
+      cb->Run(s);
+    }
+    return;
+  }
+
+  // More data is available in this tablet: send the continuation as a
+  // prefetch RPC, unless it was already prefetched, and hand out its batch
+  // from the reactor thread which completes it.
+  VLOG(2) << "Continuing asynchronously " << data_->DebugString();
+  batch->data_->Clear();
+  if (data_->batch_sizer_ && data_->batch_handed_out_.Initialized()) {
+    data_->consumer_time_ = MonoTime::Now() - data_->batch_handed_out_;
+  }
+  if (!data_->prefetch_in_flight_) {
+    data_->SendPrefetchRpc();
+  }
+  MonoTime batch_deadline = MonoTime::Now() + data_->configuration().timeout();
+  data_->OnPrefetchRpcDone([this, batch, cb, batch_deadline]() {
+    ScanRpcStatus result;
+    {
+      // The RPC has completed, so this doesn't actually wait.
+      ThreadRestrictions::ScopedAllowWait allow_wait;
+      result = data_->WaitForPrefetchRpc();
+    }
+    if (result.result == ScanRpcStatus::OK) {
+      cb->Run(data_->ProcessContinueResult(result, batch_deadline, batch->data_));
+      return;
+    }
+    // Handling the error may back off or reopen the tablet elsewhere, which
+    // blocks: do it on a client thread.
+    ThreadPool* pool;
+    Status s = data_->table_->client()->data_->GetAsyncScanPool(&pool);
+    if (s.ok()) {
+      s = pool->SubmitFunc([this, batch, cb, result, batch_deadline]() {
+        cb->Run(data_->ProcessContinueResult(result, batch_deadline, batch->data_));
+      });
+    }
+    if (!s.ok()) {
+      cb->Run(s);
+    }
+  });
+}
+
 Status KuduScanner::GetCurrentServer(KuduTabletServer** server) {
   CHECK(data_->open_);
+  if (data_->configuration().ordered_merge()) {
+    return Status::IllegalState("An ordered merge scans several tablet servers at once");
+  }
   internal::RemoteTabletServer* rts = data_->ts_;
   CHECK(rts);
   vector<HostPort> host_ports;
@@ -1633,6 +1890,11 @@ Status KuduScanTokenBuilder::SetCacheBlocks(bool cache_blocks) {
   return data_->mutable_configuration()->SetCacheBlocks(cache_blocks);
 }
 
+Status KuduScanTokenBuilder::SetSplitSizeBytes(uint64_t split_size_bytes) {
+  data_->SetSplitSizeBytes(split_size_bytes);
+  return Status::OK();
+}
+
 Status KuduScanTokenBuilder::Build(vector<KuduScanToken*>* tokens) {
   return data_->Build(tokens);
 }
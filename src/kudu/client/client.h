@@ -245,6 +245,38 @@ class KUDU_EXPORT KuduClientBuilder {
   /// @return Reference to the updated object.
   KuduClientBuilder& import_authentication_credentials(std::string authn_creds);
 
+  /// Share RPC connections with the other clients of this process.
+  ///
+  /// Clients built with this option share their RPC messenger, and with it
+  /// their connections to the cluster's servers, with the other clients built
+  /// with this option for the same set of masters and the same imported
+  /// authentication credentials. This saves the cost of every client opening,
+  /// and negotiating, connections of its own to every server.
+  /// By default, every client has connections of its own.
+  ///
+  /// @param [in] share
+  ///   Whether to share the connections.
+  /// @return Reference to the updated object.
+  KuduClientBuilder& share_connections(bool share);
+
+  /// Cache the metadata of the tables opened by the client.
+  ///
+  /// A client built with this option remembers the schema and partitioning
+  /// of the tables it opens for up to the given time, so that opening them
+  /// again, e.g. from the many tasks of a job, needn't ask the master. The
+  /// cached metadata of the tables opened often is refreshed in the
+  /// background. It's dropped when the client alters or deletes a table, and
+  /// when a tablet server finds the client's schema of a table to be out of
+  /// date; tables altered by other clients may otherwise be opened with their
+  /// former schema until it expires.
+  /// By default, the metadata of tables is fetched from the master whenever
+  /// a table is opened.
+  ///
+  /// @param [in] ttl
+  ///   The time the metadata of a table is cached for.
+  /// @return Reference to the updated object.
+  KuduClientBuilder& table_metadata_cache_ttl(const MonoDelta& ttl);
+
   /// Create a client object.
   ///
   /// @note KuduClients objects are shared amongst multiple threads and,
@@ -543,10 +575,13 @@ class KUDU_EXPORT KuduClient : public sp::enable_shared_from_this<KuduClient> {
   FRIEND_TEST(ClientTest, TestMasterDown);
   FRIEND_TEST(ClientTest, TestMasterLookupPermits);
   FRIEND_TEST(ClientTest, TestMetaCacheExpiry);
+  FRIEND_TEST(ClientTest, TestMetaCacheLookupCoalescingAndPrefetch);
   FRIEND_TEST(ClientTest, TestNonCoveringRangePartitions);
   FRIEND_TEST(ClientTest, TestReplicatedTabletWritesWithLeaderElection);
   FRIEND_TEST(ClientTest, TestScanFaultTolerance);
   FRIEND_TEST(ClientTest, TestScanTimeout);
+  FRIEND_TEST(ClientTest, TestShareConnections);
+  FRIEND_TEST(ClientTest, TestTableMetadataCache);
   FRIEND_TEST(ClientTest, TestWriteWithDeadMaster);
   FRIEND_TEST(MasterFailoverTest, TestPauseAfterCreateTableIssued);
 
@@ -960,6 +995,38 @@ class KUDU_EXPORT KuduTable : public sp::enable_shared_from_this<KuduTable> {
   KuduPredicate* NewInListPredicate(const Slice& col_name,
                                     std::vector<KuduValue*>* values);
 
+  /// Create a new IN bloom filter predicate which can be used for scanners
+  /// on this table.
+  ///
+  /// Like an IN list predicate, the predicate matches the rows whose value of
+  /// the column equals a value from the list. However, the tablet servers are
+  /// sent a bloom filter of the values, bounded by the smallest and largest
+  /// of them, rather than the list itself. The filter is much smaller than a
+  /// long list, at the cost of also matching some rows with other values.
+  /// This suits semi-joins of large tables against many keys, e.g. of the
+  /// rows of a dimension table, whose results are filtered again by the
+  /// join itself.
+  ///
+  /// The type of entries in the list must correspond to the type of the
+  /// column, as for NewInListPredicate().
+  ///
+  /// @param [in] col_name
+  ///   Name of the column to which the predicate applies.
+  /// @param [in] values
+  ///   Vector of values which the column will be matched against.
+  /// @param [in] false_positive_rate
+  ///   The rate, strictly between 0 and 1, at which the filter is to match
+  ///   values which are not in the list.
+  /// @return Raw pointer to an IN bloom filter predicate. The caller owns the
+  ///   predicate until it is passed into KuduScanner::AddConjunctPredicate().
+  ///   The returned predicate takes ownership of the values vector and its
+  ///   elements. In the case of an error (e.g. an invalid column name), a
+  ///   non-NULL value is still returned. The error will be returned when
+  ///   attempting to add this predicate to a KuduScanner.
+  KuduPredicate* NewInBloomFilterPredicate(const Slice& col_name,
+                                           std::vector<KuduValue*>* values,
+                                           double false_positive_rate);
+
   /// Create a new IS NOT NULL predicate which can be used for scanners on this
   /// table.
   ///
@@ -1527,6 +1594,26 @@ class KUDU_EXPORT KuduSession : public sp::enable_shared_from_this<KuduSession>
   /// @return Operation result status.
   Status Apply(KuduWriteOperation* write_op) WARN_UNUSED_RESULT;
 
+  /// Apply a batch of write operations.
+  ///
+  /// This is equivalent to calling Apply() for every operation in order,
+  /// but considerably cheaper for large batches: the destination tablets
+  /// for the whole batch are resolved in one pass using the cached tablet
+  /// locations, and the operations bound for the same tablet are buffered
+  /// together. In @c AUTO_FLUSH_SYNC mode, the batch is flushed as a whole
+  /// once all of its operations are applied.
+  ///
+  /// Every operation is applied even if some of them fail; the failed
+  /// operations are stored in the session's error collector.
+  ///
+  /// @param [in] write_ops
+  ///   Operations to apply. This method transfers the ownership
+  ///   of the operations to the KuduSession.
+  /// @return The first error encountered while applying the operations,
+  ///   or Status::OK() if there was none.
+  Status ApplyBatch(const std::vector<KuduWriteOperation*>& write_ops)
+      WARN_UNUSED_RESULT;
+
   /// Flush any pending writes.
   ///
   /// This method initiates flushing of the current batch of buffered
@@ -1875,6 +1962,41 @@ class KUDU_EXPORT KuduScanner {
   /// @return Operation result status.
   Status SetCacheBlocks(bool cache_blocks);
 
+  /// Set whether the scanner should prefetch the next batch of rows.
+  ///
+  /// When prefetching is enabled, the scanner requests the next batch of rows
+  /// from the tablet server as soon as NextBatch() returns a batch, so the
+  /// network round trip and the work of the server overlap with the
+  /// processing of the returned batch by the application. At most one batch
+  /// is prefetched at a time, so the additional memory used by the scanner is
+  /// bounded by the batch size (see SetBatchSizeBytes()).
+  ///
+  /// @param [in] prefetching
+  ///   Whether to prefetch batches. Default is @c false.
+  /// @return Operation result status.
+  Status SetPrefetching(bool prefetching);
+
+  /// Set whether the scanner should adjust the batch size as it goes.
+  ///
+  /// When adaptive batch sizing is enabled, the scanner starts with the batch
+  /// size set by SetBatchSizeBytes(), or else with the default of the tablet
+  /// servers, and adjusts it after each batch from the time taken by the
+  /// round trip to the tablet server, by the server itself, and by the
+  /// application to process the previous batch:
+  ///   @li The batch size is doubled while the round trips, rather than the
+  ///     scanning by the server, take most of the time of the requests, and
+  ///     the application waits for the batches.
+  ///   @li It is reduced when requests take too long, to bound the latency
+  ///     of each batch, or when the application, rather than the tablet
+  ///     server, is the bottleneck of a prefetching scanner (see
+  ///     SetPrefetching()), to bound the memory used by the batches.
+  /// The tablet servers cap the batch size at their maximum.
+  ///
+  /// @param [in] adaptive
+  ///   Whether to adjust the batch size. Default is @c false.
+  /// @return Operation result status.
+  Status SetAdaptiveBatchSizing(bool adaptive);
+
   /// @return Result status of the operation (begin scanning).
   Status Open();
 
@@ -1939,6 +2061,31 @@ class KUDU_EXPORT KuduScanner {
   /// @return Operation result status.
   Status NextBatch(KuduScanBatch* batch);
 
+  /// Fetch the next batch of results for this scanner asynchronously.
+  ///
+  /// This is the asynchronous counterpart of NextBatch(KuduScanBatch*): it
+  /// doesn't block the calling thread while waiting for the tablet server, so
+  /// that a single thread can drive many scanners at once.
+  ///
+  /// Only one call to NextBatchAsync() may be outstanding per scanner at a
+  /// time, and the scanner may not be used otherwise, nor closed or
+  /// destroyed, until the callback is called. When prefetching is enabled,
+  /// the batch is handed out from the prefetched RPC if there is one.
+  ///
+  /// @note Not all of the work of a scan is asynchronous: opening the next
+  ///   tablet, the ordered merge of several tablets, and recovering from
+  ///   errors are done on a small pool of client threads.
+  ///
+  /// @param [out] batch
+  ///   Placeholder for the result. It must remain valid until the callback
+  ///   is called. See NextBatch(KuduScanBatch*) about reusing it.
+  /// @param [in] cb
+  ///   Callback to report on the result of the operation. As in all other
+  ///   async functions in Kudu, the callback may be called either from an IO
+  ///   thread or the same thread which calls NextBatchAsync(). The callback
+  ///   should not block. It must remain valid until it is called.
+  void NextBatchAsync(KuduScanBatch* batch, KuduStatusCallback* cb);
+
   /// Get the KuduTabletServer that is currently handling the scan.
   ///
   /// More concretely, this is the server that handled the most recent
@@ -1949,7 +2096,11 @@ class KUDU_EXPORT KuduScanner {
   /// @return Operation result status.
   Status GetCurrentServer(KuduTabletServer** server);
 
-  /// @return Cumulative resource metrics since the scan was started.
+  /// @return Cumulative resource metrics since the scan was started:
+  ///   among others, the CPU time spent by the tablet servers, the bytes
+  ///   read from the block cache and from disk, the rows scanned and
+  ///   returned, the delta mutations applied and the time spent waiting
+  ///   for a consistent snapshot.
   const ResourceMetrics& GetResourceMetrics() const;
 
   /// Set the hint for the size of the next batch in bytes.
@@ -1999,6 +2150,32 @@ class KUDU_EXPORT KuduScanner {
   /// @return Operation result status.
   Status SetFaultTolerant() WARN_UNUSED_RESULT;
 
+  /// Limit the number of rows returned by the scan.
+  ///
+  /// The limit is pushed down to the tablet servers, which stop scanning once
+  /// they have returned enough rows. Combined with SetOrderedMerge(), this
+  /// returns the first rows of the table in primary key order.
+  ///
+  /// @param [in] limit
+  ///   The maximum number of rows to return; must not be negative.
+  /// @return Operation result status.
+  Status SetLimit(int64_t limit) WARN_UNUSED_RESULT;
+
+  /// Return the rows of all tablets in primary key order.
+  ///
+  /// By default, the rows of each tablet are returned in turn, so that the
+  /// rows of a hash partitioned table are not ordered by primary key. With an
+  /// ordered merge, the scanner scans every tablet in primary key order at
+  /// once, and merges their rows. This implies SetFaultTolerant().
+  ///
+  /// The projection must include all the primary key columns, and the rows
+  /// must use the default row format.
+  ///
+  /// @param [in] ordered_merge
+  ///   Whether to merge the rows of all tablets in primary key order.
+  /// @return Operation result status.
+  Status SetOrderedMerge(bool ordered_merge) WARN_UNUSED_RESULT;
+
   /// Set snapshot timestamp for scans in @c READ_AT_SNAPSHOT mode.
   ///
   /// @param [in] snapshot_timestamp_micros
@@ -2020,6 +2197,22 @@ class KUDU_EXPORT KuduScanner {
   /// @return Operation result status.
   Status SetSnapshotRaw(uint64_t snapshot_timestamp) WARN_UNUSED_RESULT;
 
+  /// Allow scans in @c READ_AT_SNAPSHOT mode without a snapshot timestamp
+  /// to read slightly stale data in exchange for not waiting on the replica.
+  ///
+  /// The replica then picks the newest snapshot timestamp it can serve
+  /// right away, as long as it is at most @c max_staleness_ms behind its
+  /// current time, which lets followers serve such scans without waiting
+  /// for the leader. Otherwise the replica picks its current time, as usual.
+  ///
+  /// @note This method is experimental and will either disappear or
+  ///   change in a future release.
+  ///
+  /// @param [in] max_staleness_ms
+  ///   The maximum staleness of the snapshot, in milliseconds.
+  /// @return Operation result status.
+  Status SetMaxStalenessMillis(int64_t max_staleness_ms) WARN_UNUSED_RESULT;
+
   /// Set the maximum time that Open() and NextBatch() are allowed to take.
   ///
   /// @param [in] millis
@@ -2030,6 +2223,62 @@ class KUDU_EXPORT KuduScanner {
   /// @return Schema of the projection being scanned.
   KuduSchema GetProjectionSchema() const;
 
+  /// Aggregate functions which the tablet servers can evaluate on behalf of
+  /// a scan.
+  enum AggregateFunction {
+    /// The number of non-null values of a column, or the number of rows.
+    COUNT,
+
+    /// The sum of the non-null values of an integer or floating point column.
+    SUM,
+
+    /// The smallest non-null value of a column.
+    MIN,
+
+    /// The largest non-null value of a column.
+    MAX
+  };
+
+  /// Add an aggregate for the tablet servers to compute over the scanned rows.
+  ///
+  /// Once an aggregate is added, the tablet servers return partial aggregates
+  /// instead of the rows, which saves shipping the rows to the client. The
+  /// results must then be fetched with GetAggregateResults() rather than
+  /// NextBatch().
+  ///
+  /// @param [in] function
+  ///   The aggregate function.
+  /// @param [in] col_name
+  ///   The name of the column to aggregate, which must be part of the
+  ///   projection. May be empty for @c COUNT, to count the rows.
+  /// @return Operation result status.
+  Status AddAggregate(AggregateFunction function, const std::string& col_name)
+      WARN_UNUSED_RESULT;
+
+  /// Group the aggregates by a prefix of the primary key.
+  ///
+  /// @param [in] num_key_columns
+  ///   The number of leading primary key columns to group by. They must also
+  ///   be the leading columns of the projection, in key order.
+  /// @return Operation result status.
+  Status SetGroupByKeyPrefix(int num_key_columns) WARN_UNUSED_RESULT;
+
+  /// Run a scan with aggregates to completion and fetch the results.
+  ///
+  /// Each result row holds the values of the group-by columns, followed by
+  /// one column per aggregate, named after it, e.g. @c "count(*)" or
+  /// @c "sum(col)". @c COUNT results are INT64; @c SUM results are INT64 or
+  /// DOUBLE, depending on the column type; @c MIN and @c MAX results have the
+  /// type of the column. Aggregates of no non-null values other than
+  /// @c COUNT are NULL.
+  ///
+  /// @param [out] results
+  ///   One row per group, in primary key order; without group-by columns,
+  ///   exactly one row. The caller takes ownership of the rows, which must
+  ///   not outlive this scanner.
+  /// @return Operation result status.
+  Status GetAggregateResults(std::vector<KuduPartialRow*>* results) WARN_UNUSED_RESULT;
+
   /// @name Advanced/Unstable API
   //
   ///@{
@@ -2046,6 +2295,15 @@ class KUDU_EXPORT KuduScanner {
   ///   data for further decoding. Using KuduScanBatch::Row() might yield incorrect/corrupt
   ///   results and might even cause the client to crash.
   static const uint64_t PAD_UNIXTIME_MICROS_TO_16_BYTES = 1 << 0;
+  /// Makes the server return the data in columnar layout: each projected
+  /// column is sent as a separate buffer, avoiding the transposition of rows
+  /// on both the server and the client.
+  /// @note If this flag is enabled, the user _must_ use
+  ///   KuduScanBatch::GetFixedLengthColumn(),
+  ///   KuduScanBatch::GetVariableLengthColumn() and
+  ///   KuduScanBatch::GetNonNullBitmapForColumn() to access the data.
+  ///   KuduScanBatch::Row(), direct_data() and indirect_data() must not be used.
+  static const uint64_t COLUMNAR_LAYOUT = 1 << 1;
   /// Optionally set row format modifier flags.
   ///
   /// If flags is RowFormatFlags::NO_FLAGS, then no modifications will be made to the row
@@ -2257,6 +2515,21 @@ class KUDU_EXPORT KuduScanTokenBuilder {
   /// @copydoc KuduScanner::SetTimeoutMillis
   Status SetTimeoutMillis(int millis) WARN_UNUSED_RESULT;
 
+  /// Split the tablets into tokens of about the given on-disk size.
+  ///
+  /// By default, Build() creates one token per tablet, so a large tablet
+  /// makes for a scan which finishes well after the others. With a split
+  /// size, the tablet servers estimate primary keys splitting each tablet
+  /// into ranges of about that much on-disk data, from keys sampled from
+  /// their indexes, and each range gets its own token. The estimates don't
+  /// account for data which hasn't been flushed to disk yet.
+  ///
+  /// @param [in] split_size_bytes
+  ///   The on-disk size of the data to cover with each token, or 0 to create
+  ///   one token per tablet (the default).
+  /// @return Operation result status.
+  Status SetSplitSizeBytes(uint64_t split_size_bytes) WARN_UNUSED_RESULT;
+
   /// Build the set of scan tokens.
   ///
   /// The builder may be reused after this call.
@@ -23,7 +23,8 @@ namespace client {
 
 KuduClientBuilder::Data::Data()
   : default_admin_operation_timeout_(MonoDelta::FromSeconds(30)),
-    default_rpc_timeout_(MonoDelta::FromSeconds(10)) {
+    default_rpc_timeout_(MonoDelta::FromSeconds(10)),
+    share_connections_(false) {
 }
 
 KuduClientBuilder::Data::~Data() {
@@ -37,6 +37,8 @@ class KuduClientBuilder::Data {
   MonoDelta default_admin_operation_timeout_;
   MonoDelta default_rpc_timeout_;
   std::string authn_creds_;
+  bool share_connections_;
+  MonoDelta table_metadata_cache_ttl_;
 
   DISALLOW_COPY_AND_ASSIGN(Data);
 };
@@ -86,8 +86,13 @@ namespace client {
 
 namespace internal {
 
+// For how long past their expiration tablet locations are still used while
+// being refreshed in the background. Beyond that, lookups block on the master.
+static const int kExpiredEntryGracePeriodMs = 60 * 1000;
+
 RemoteTabletServer::RemoteTabletServer(const master::TSInfoPB& pb)
-  : uuid_(pb.permanent_uuid()) {
+  : uuid_(pb.permanent_uuid()),
+    recent_rpc_queue_time_us_(-1) {
 
   Update(pb);
 }
@@ -154,12 +159,19 @@ void RemoteTabletServer::Update(const master::TSInfoPB& pb) {
   for (const HostPortPB& hostport_pb : pb.rpc_addresses()) {
     rpc_hostports_.emplace_back(hostport_pb.host(), hostport_pb.port());
   }
+  recent_rpc_queue_time_us_ = pb.has_recent_rpc_queue_time_us() ?
+      pb.recent_rpc_queue_time_us() : -1;
 }
 
 const string& RemoteTabletServer::permanent_uuid() const {
   return uuid_;
 }
 
+int64_t RemoteTabletServer::recent_rpc_queue_time_us() const {
+  std::lock_guard<simple_spinlock> l(lock_);
+  return recent_rpc_queue_time_us_;
+}
+
 shared_ptr<TabletServerServiceProxy> RemoteTabletServer::proxy() const {
   std::lock_guard<simple_spinlock> l(lock_);
   CHECK(proxy_);
@@ -322,6 +334,13 @@ bool MetaCacheEntry::stale() const {
          (!is_non_covered_range() && tablet_->stale());
 }
 
+bool MetaCacheEntry::usable_past_expiration() const {
+  DCHECK(Initialized());
+  return !is_non_covered_range() && !tablet_->stale() &&
+      MonoTime::Now() < expiration_time_ +
+                        MonoDelta::FromMilliseconds(kExpiredEntryGracePeriodMs);
+}
+
 string MetaCacheEntry::DebugString(const KuduTable* table) const {
   DCHECK(Initialized());
   const string& lower_bound = lower_bound_partition_key();
@@ -550,6 +569,16 @@ class LookupRpc : public Rpc {
   bool is_exact_lookup() const { return is_exact_lookup_; }
   const KuduTable* table() const { return table_; }
 
+  // Make this lookup a background refresh of the tablet starting at the
+  // partition key: it always goes to the master, unless a master lookup
+  // covering the tablet is already in flight.
+  void set_background_refresh() { background_refresh_ = true; }
+
+  bool background_refresh() const { return background_refresh_; }
+
+  // Set by the MetaCache while this lookup is registered as in flight.
+  void set_registered_inflight(bool registered) { registered_inflight_ = registered; }
+
  private:
   virtual void SendRpcCb(const Status& status) OVERRIDE;
 
@@ -599,6 +628,12 @@ class LookupRpc : public Rpc {
   // partition key. If false, the next tablet after the partition key should be
   // returned if the partition key falls in a non-covered partition range.
   bool is_exact_lookup_;
+
+  // See set_background_refresh().
+  bool background_refresh_;
+
+  // Whether this lookup is registered in the MetaCache's in-flight lookups.
+  bool registered_inflight_;
 };
 
 LookupRpc::LookupRpc(const scoped_refptr<MetaCache>& meta_cache,
@@ -617,7 +652,9 @@ LookupRpc::LookupRpc(const scoped_refptr<MetaCache>& meta_cache,
       remote_tablet_(remote_tablet),
       has_permit_(false),
       max_returned_locations_(max_returned_locations),
-      is_exact_lookup_(is_exact_lookup) {
+      is_exact_lookup_(is_exact_lookup),
+      background_refresh_(false),
+      registered_inflight_(false) {
   DCHECK(deadline.Initialized());
 }
 
@@ -625,15 +662,29 @@ LookupRpc::~LookupRpc() {
   if (has_permit_) {
     meta_cache_->ReleaseMasterLookupPermit();
   }
+  if (registered_inflight_) {
+    // The cache now has whatever this lookup fetched: let the lookups which
+    // were waiting for it try again.
+    for (LookupRpc* waiter : meta_cache_->InflightLookupFinished(this)) {
+      waiter->SendRpc();
+    }
+  }
 }
 
 void LookupRpc::SendRpc() {
-  // Fast path: lookup in the cache.
+  // Fast path: lookup in the cache. Expired tablet locations are still used,
+  // while being refreshed in the background.
   MetaCacheEntry entry;
-  while (PREDICT_TRUE(meta_cache_->LookupTabletByKeyFastPath(table_, partition_key_, &entry))
+  bool needs_refresh = false;
+  while (PREDICT_TRUE(!background_refresh_ &&
+                      meta_cache_->LookupTabletByKeyFastPath(table_, partition_key_, &entry,
+                                                             &needs_refresh))
          && (entry.is_non_covered_range() || entry.tablet()->HasLeader())) {
     VLOG(4) << "Fast lookup: found " << entry.DebugString(table_) << " for " << ToString();
     if (!entry.is_non_covered_range()) {
+      if (needs_refresh) {
+        meta_cache_->RefreshTabletLocationsAsync(table_, entry.lower_bound_partition_key());
+      }
       if (remote_tablet_) {
         *remote_tablet_ = entry.tablet();
       }
@@ -654,6 +705,18 @@ void LookupRpc::SendRpc() {
   VLOG(4) << "Fast lookup: no cache entry for " << ToString()
           << ": refreshing our metadata from the Master";
 
+  // Don't send the same request as a lookup which is already in flight:
+  // wait for it, and try the cache again once it's done.
+  if (!registered_inflight_ && meta_cache_->WaitForInflightLookup(this)) {
+    VLOG(4) << ToString() << ": waiting for an in-flight lookup";
+    if (background_refresh_) {
+      // The in-flight lookup will refresh the locations anyway.
+      user_cb_.Run(Status::OK());
+      delete this;
+    }
+    return;
+  }
+
   if (!has_permit_) {
     has_permit_ = meta_cache_->AcquireMasterLookupPermit();
   }
@@ -815,7 +878,9 @@ Status MetaCache::ProcessLookupResponse(const LookupRpc& rpc,
       MonoDelta::FromMilliseconds(rpc.resp().ttl_millis());
 
   std::lock_guard<rw_spinlock> l(lock_);
-  TabletMap& tablets_by_key = LookupOrInsert(&tablets_by_table_and_key_,
+  TableShard* shard = GetTableShard(rpc.table_id());
+  std::lock_guard<rw_spinlock> shard_lock(shard->lock);
+  TabletMap& tablets_by_key = LookupOrInsert(&shard->tablets_by_table_and_key,
                                              rpc.table_id(), TabletMap());
 
   const auto& tablet_locations = rpc.resp().tablet_locations();
@@ -952,11 +1017,20 @@ Status MetaCache::ProcessLookupResponse(const LookupRpc& rpc,
   return Status::OK();
 }
 
+MetaCache::TableShard* MetaCache::GetTableShard(const string& table_id) {
+  return &table_shards_[std::hash<string>()(table_id) % kNumTableShards];
+}
+
 bool MetaCache::LookupTabletByKeyFastPath(const KuduTable* table,
                                           const string& partition_key,
-                                          MetaCacheEntry* entry) {
-  shared_lock<rw_spinlock> l(lock_);
-  const TabletMap* tablets = FindOrNull(tablets_by_table_and_key_, table->id());
+                                          MetaCacheEntry* entry,
+                                          bool* needs_refresh) {
+  if (needs_refresh) {
+    *needs_refresh = false;
+  }
+  TableShard* shard = GetTableShard(table->id());
+  shared_lock<rw_spinlock> l(shard->lock);
+  const TabletMap* tablets = FindOrNull(shard->tablets_by_table_and_key, table->id());
   if (PREDICT_FALSE(!tablets)) {
     // No cache available for this table.
     return false;
@@ -968,9 +1042,13 @@ bool MetaCache::LookupTabletByKeyFastPath(const KuduTable* table,
     return false;
   }
 
-  // Stale entries must be re-fetched.
+  // Stale entries must be re-fetched, unless they have only expired and the
+  // caller is willing to refresh them in the background.
   if (e->stale()) {
-    return false;
+    if (!needs_refresh || !e->usable_past_expiration()) {
+      return false;
+    }
+    *needs_refresh = true;
   }
 
   if (e->Contains(partition_key)) {
@@ -981,11 +1059,74 @@ bool MetaCache::LookupTabletByKeyFastPath(const KuduTable* table,
   return false;
 }
 
+void MetaCache::LookupTabletsByKeysFastPath(
+    const KuduTable* table,
+    const vector<string>& partition_keys,
+    vector<scoped_refptr<RemoteTablet>>* remote_tablets) {
+  remote_tablets->clear();
+  remote_tablets->resize(partition_keys.size());
+  vector<string> to_refresh;
+  {
+    TableShard* shard = GetTableShard(table->id());
+    shared_lock<rw_spinlock> l(shard->lock);
+    const TabletMap* tablets = FindOrNull(shard->tablets_by_table_and_key, table->id());
+    if (PREDICT_FALSE(!tablets)) {
+      // No cache available for this table.
+      return;
+    }
+    const MetaCacheEntry* last = nullptr;
+    for (size_t i = 0; i < partition_keys.size(); i++) {
+      const string& partition_key = partition_keys[i];
+      const MetaCacheEntry* e = last;
+      if (!e || !e->Contains(partition_key)) {
+        e = FindFloorOrNull(*tablets, partition_key);
+        if (PREDICT_FALSE(!e || !e->Contains(partition_key))) {
+          continue;
+        }
+        if (e->stale()) {
+          // As in LookupRpc, expired locations are used while being refreshed.
+          if (!e->usable_past_expiration()) {
+            continue;
+          }
+          to_refresh.push_back(e->lower_bound_partition_key());
+        }
+        last = e;
+      }
+      if (!e->is_non_covered_range()) {
+        (*remote_tablets)[i] = e->tablet();
+      }
+    }
+  }
+
+  // Only tablets with a known leader can be written to without going
+  // through the slow path. Check this outside of the cache lock, since
+  // RemoteTablet has a lock of its own.
+  RemoteTablet* last_checked = nullptr;
+  bool last_has_leader = false;
+  for (auto& tablet : *remote_tablets) {
+    if (!tablet) {
+      continue;
+    }
+    if (tablet.get() != last_checked) {
+      last_checked = tablet.get();
+      last_has_leader = tablet->HasLeader();
+    }
+    if (!last_has_leader) {
+      tablet.reset();
+    }
+  }
+
+  for (auto& partition_key : to_refresh) {
+    RefreshTabletLocationsAsync(table, std::move(partition_key));
+  }
+}
+
 void MetaCache::ClearNonCoveredRangeEntries(const std::string& table_id) {
   VLOG(3) << "Clearing non-covered range entries of table " << table_id;
-  std::lock_guard<rw_spinlock> l(lock_);
+  TableShard* shard = GetTableShard(table_id);
+  std::lock_guard<rw_spinlock> l(shard->lock);
 
-  TabletMap* tablets = FindOrNull(tablets_by_table_and_key_, table_id);
+  TabletMap* tablets = FindOrNull(shard->tablets_by_table_and_key, table_id);
   if (PREDICT_FALSE(!tablets)) {
     // No cache available for this table.
     return;
@@ -1005,7 +1146,10 @@ void MetaCache::ClearCache() {
   std::lock_guard<rw_spinlock> l(lock_);
   STLDeleteValues(&ts_cache_);
   tablets_by_id_.clear();
-  tablets_by_table_and_key_.clear();
+  for (auto& shard : table_shards_) {
+    std::lock_guard<rw_spinlock> shard_lock(shard.lock);
+    shard.tablets_by_table_and_key.clear();
+  }
 }
 
 void MetaCache::LookupTabletByKey(const KuduTable* table,
@@ -1043,6 +1187,148 @@ void MetaCache::LookupTabletByKeyOrNext(const KuduTable* table,
   rpc->SendRpc();
 }
 
+namespace {
+// Completion callback of background refreshes, keeping the table alive
+// until then.
+void BackgroundRefreshDone(const sp::shared_ptr<const KuduTable>& /* table */,
+                           const Status& s) {
+  if (PREDICT_FALSE(!s.ok())) {
+    KLOG_EVERY_N_SECS(WARNING, 1) << "Failed to refresh tablet locations: " << s.ToString();
+  }
+}
+} // anonymous namespace
+
+void MetaCache::RefreshTabletLocationsAsync(const KuduTable* table,
+                                            string partition_key) {
+  VLOG(3) << "Refreshing expired tablet locations of table " << table->name();
+  LookupRpc* rpc = new LookupRpc(this,
+                                 Bind(&BackgroundRefreshDone, table->shared_from_this()),
+                                 table,
+                                 std::move(partition_key),
+                                 nullptr,
+                                 MonoTime::Now() + client_->default_admin_operation_timeout(),
+                                 client_->data_->messenger_,
+                                 kFetchTabletsPerPointLookup,
+                                 true);
+  rpc->set_background_refresh();
+  rpc->SendRpc();
+}
+
+bool MetaCache::WaitForInflightLookup(LookupRpc* rpc) {
+  std::lock_guard<simple_spinlock> l(inflight_lock_);
+  InflightLookupMap& inflight = inflight_lookups_[rpc->table_id()];
+  // A lookup fetches locations starting from its partition key, so the
+  // in-flight lookup with the closest partition key at or before this one
+  // is the one most likely to cover it.
+  auto it = inflight.upper_bound(rpc->partition_key());
+  if (it != inflight.begin()) {
+    --it;
+    if (!rpc->background_refresh()) {
+      it->second.push_back(rpc);
+    }
+    return true;
+  }
+  InsertOrDie(&inflight, rpc->partition_key(), vector<LookupRpc*>());
+  rpc->set_registered_inflight(true);
+  return false;
+}
+
+vector<LookupRpc*> MetaCache::InflightLookupFinished(LookupRpc* rpc) {
+  vector<LookupRpc*> waiters;
+  std::lock_guard<simple_spinlock> l(inflight_lock_);
+  InflightLookupMap& inflight = FindOrDie(inflight_lookups_, rpc->table_id());
+  auto it = inflight.find(rpc->partition_key());
+  DCHECK(it != inflight.end());
+  waiters.swap(it->second);
+  inflight.erase(it);
+  if (inflight.empty()) {
+    inflight_lookups_.erase(rpc->table_id());
+  }
+  rpc->set_registered_inflight(false);
+  return waiters;
+}
+
+// Populates the cache with the tablet locations covering a partition key
+// range, in chunks of kFetchTabletsPerRangeLookup tablets per master round trip.
+// Deletes itself once done.
+class RangePrefetch {
+ public:
+  RangePrefetch(scoped_refptr<MetaCache> meta_cache,
+                const KuduTable* table,
+                string lower_bound_partition_key,
+                string upper_bound_partition_key,
+                const MonoTime& deadline,
+                StatusCallback callback)
+      : meta_cache_(std::move(meta_cache)),
+        table_(table),
+        next_partition_key_(std::move(lower_bound_partition_key)),
+        upper_bound_partition_key_(std::move(upper_bound_partition_key)),
+        deadline_(deadline),
+        callback_(std::move(callback)) {
+  }
+
+  void Run() {
+    // Skip over the part of the range which is already cached.
+    MetaCacheEntry entry;
+    bool needs_refresh;
+    while (meta_cache_->LookupTabletByKeyFastPath(table_, next_partition_key_, &entry,
+                                                  &needs_refresh)) {
+      if (needs_refresh) {
+        meta_cache_->RefreshTabletLocationsAsync(table_, entry.lower_bound_partition_key());
+      }
+      const string& upper_bound = entry.upper_bound_partition_key();
+      if (upper_bound.empty() ||
+          (!upper_bound_partition_key_.empty() && upper_bound >= upper_bound_partition_key_)) {
+        Finish(Status::OK());
+        return;
+      }
+      next_partition_key_ = upper_bound;
+    }
+    meta_cache_->LookupTabletByKeyOrNext(table_, next_partition_key_, deadline_, nullptr,
+                                         Bind(&RangePrefetch::LookupFinished, Unretained(this)),
+                                         kFetchTabletsPerRangeLookup);
+  }
+
+ private:
+  void LookupFinished(const Status& s) {
+    if (s.IsNotFound()) {
+      // There are no more tablets past the partition key.
+      Finish(Status::OK());
+    } else if (!s.ok()) {
+      Finish(s);
+    } else {
+      // The looked up locations are cached now: continue from there.
+      Run();
+    }
+  }
+
+  void Finish(const Status& s) {
+    callback_.Run(s);
+    delete this;
+  }
+
+  const scoped_refptr<MetaCache> meta_cache_;
+  const KuduTable* const table_;
+  string next_partition_key_;
+  const string upper_bound_partition_key_;
+  const MonoTime deadline_;
+  const StatusCallback callback_;
+
+  DISALLOW_COPY_AND_ASSIGN(RangePrefetch);
+};
+
+void MetaCache::PrefetchTabletLocations(const KuduTable* table,
+                                        string lower_bound_partition_key,
+                                        string upper_bound_partition_key,
+                                        const MonoTime& deadline,
+                                        const StatusCallback& callback) {
+  RangePrefetch* prefetch = new RangePrefetch(this, table,
+                                              std::move(lower_bound_partition_key),
+                                              std::move(upper_bound_partition_key),
+                                              deadline, callback);
+  prefetch->Run();
+}
+
 void MetaCache::MarkTSFailed(RemoteTabletServer* ts,
                              const Status& status) {
   LOG(INFO) << "Marking tablet server " << ts->ToString() << " as failed.";
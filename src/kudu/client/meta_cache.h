@@ -19,6 +19,7 @@
 #ifndef KUDU_CLIENT_META_CACHE_H
 #define KUDU_CLIENT_META_CACHE_H
 
+#include <cstdint>
 #include <map>
 #include <memory>
 #include <set>
@@ -59,6 +60,7 @@ namespace client {
 
 class ClientTest_TestMasterLookupPermits_Test;
 class ClientTest_TestMetaCacheExpiry_Test;
+class ClientTest_TestMetaCacheLookupCoalescingAndPrefetch_Test;
 class KuduClient;
 class KuduTable;
 
@@ -74,6 +76,7 @@ const int kFetchTabletsPerRangeLookup = 1000;
 ////////////////////////////////////////////////////////////
 
 class LookupRpc;
+class RangePrefetch;
 class MetaCache;
 class RemoteTablet;
 
@@ -104,6 +107,10 @@ class RemoteTabletServer {
   // Returns the remote server's uuid.
   const std::string& permanent_uuid() const;
 
+  // Returns the recent mean time in microseconds RPCs spent queued on the
+  // server, as last reported by the master, or -1 if unknown.
+  int64_t recent_rpc_queue_time_us() const;
+
  private:
   // Internal callback for DNS resolution.
   void DnsResolutionFinished(const HostPort& hp,
@@ -117,6 +124,7 @@ class RemoteTabletServer {
 
   std::vector<HostPort> rpc_hostports_;
   std::shared_ptr<tserver::TabletServerServiceProxy> proxy_;
+  int64_t recent_rpc_queue_time_us_;
 
   DISALLOW_COPY_AND_ASSIGN(RemoteTabletServer);
 };
@@ -335,6 +343,11 @@ class MetaCacheEntry {
   // Returns true if this meta cache entry is stale.
   bool stale() const;
 
+  // Returns true if this entry has expired, but is still good to be used
+  // while its locations are refreshed in the background: it must be a tablet
+  // which hasn't been marked stale, and hasn't been expired for too long.
+  bool usable_past_expiration() const;
+
   // Returns a formatted string representation of the metacache suitable for
   // debug printing.
   //
@@ -396,6 +409,35 @@ class MetaCache : public RefCountedThreadSafe<MetaCache> {
                                const StatusCallback& callback,
                                int max_returned_locations = kFetchTabletsPerPointLookup);
 
+  // Look up the tablets hosting each of the given partition keys of a table,
+  // consulting only locally cached information. The cache lock is taken once
+  // for the whole batch, and consecutive keys falling into the same cached
+  // range are resolved without another map lookup.
+  //
+  // On return, 'remote_tablets' holds one entry per key. An entry is NULL if
+  // the key could not be resolved locally (no fresh cache entry, a non-covered
+  // range, or a tablet without a known leader); such keys must go through
+  // LookupTabletByKey().
+  void LookupTabletsByKeysFastPath(
+      const KuduTable* table,
+      const std::vector<std::string>& partition_keys,
+      std::vector<scoped_refptr<RemoteTablet>>* remote_tablets);
+
+  // Populate the cache with the locations of all the tablets covering the
+  // partition key range ['lower_bound_partition_key',
+  // 'upper_bound_partition_key') of a table, fetching them from the master
+  // in as few round trips as possible. An empty upper bound means the end
+  // of the key space. The callback is invoked once the whole range is cached,
+  // possibly inline with this call.
+  //
+  // NOTE: the memory referenced by 'table' must remain valid until 'callback'
+  // is invoked.
+  void PrefetchTabletLocations(const KuduTable* table,
+                               std::string lower_bound_partition_key,
+                               std::string upper_bound_partition_key,
+                               const MonoTime& deadline,
+                               const StatusCallback& callback);
+
   // Clears the non-covered range entries from a table's meta cache.
   void ClearNonCoveredRangeEntries(const std::string& table_id);
 
@@ -415,9 +457,11 @@ class MetaCache : public RefCountedThreadSafe<MetaCache> {
 
  private:
   friend class LookupRpc;
+  friend class RangePrefetch;
 
   FRIEND_TEST(client::ClientTest, TestMasterLookupPermits);
   FRIEND_TEST(client::ClientTest, TestMetaCacheExpiry);
+  FRIEND_TEST(client::ClientTest, TestMetaCacheLookupCoalescingAndPrefetch);
 
   // Called on the slow LookupTablet path when the master responds. Populates
   // the tablet caches and returns a reference to the first one.
@@ -427,9 +471,36 @@ class MetaCache : public RefCountedThreadSafe<MetaCache> {
 
   // Lookup the given tablet by key, only consulting local information.
   // Returns true and sets *remote_tablet if successful.
+  //
+  // If 'needs_refresh' is not NULL, an entry which has expired but is
+  // usable_past_expiration() is returned as well, and 'needs_refresh' is set
+  // to indicate that the caller should refresh it with
+  // RefreshTabletLocationsAsync().
   bool LookupTabletByKeyFastPath(const KuduTable* table,
                                  const std::string& partition_key,
-                                 MetaCacheEntry* entry);
+                                 MetaCacheEntry* entry,
+                                 bool* needs_refresh = nullptr);
+
+  // Refresh the locations of the tablet of 'table' starting at
+  // 'partition_key' from the master, without anybody waiting for the result.
+  // Does nothing if a master lookup which would cover the tablet is already
+  // in flight.
+  void RefreshTabletLocationsAsync(const KuduTable* table,
+                                   std::string partition_key);
+
+  // Called by a lookup which needs to go to the master. If another master
+  // lookup of the same table starting at or before the same partition key is
+  // already in flight, 'rpc' is queued to be re-sent once that lookup
+  // completes, and true is returned. Otherwise, 'rpc' is registered as in
+  // flight and false is returned.
+  //
+  // This coalesces the identical lookups of clients with many threads writing
+  // to the same tablets, e.g. right after a leader change.
+  bool WaitForInflightLookup(LookupRpc* rpc);
+
+  // Unregister a lookup registered by WaitForInflightLookup(), returning the
+  // lookups which were waiting for it.
+  std::vector<LookupRpc*> InflightLookupFinished(LookupRpc* rpc);
 
   // Update our information about the given tablet server.
   //
@@ -453,14 +524,24 @@ class MetaCache : public RefCountedThreadSafe<MetaCache> {
   TabletServerMap ts_cache_;
 
   // Cache of tablets, keyed by partition key.
-  //
-  // Protected by lock_.
   typedef std::map<std::string, MetaCacheEntry> TabletMap;
 
-  // Cache of tablets and non-covered ranges, keyed by table id.
+  // Cache of tablets and non-covered ranges of a subset of the tables, keyed
+  // by table id.
   //
-  // Protected by lock_.
-  std::unordered_map<std::string, TabletMap> tablets_by_table_and_key_;
+  // The tables are spread over several shards, each with its own lock, so that
+  // the fast lookup path of clients writing to several tables doesn't contend
+  // on a single lock.
+  struct TableShard {
+    rw_spinlock lock;
+    std::unordered_map<std::string, TabletMap> tablets_by_table_and_key;
+  };
+  static const int kNumTableShards = 16;
+
+  TableShard* GetTableShard(const std::string& table_id);
+
+  // Lock ordering: 'lock_' is acquired before any shard's lock.
+  TableShard table_shards_[kNumTableShards];
 
   // Cache of tablets, keyed by tablet ID.
   //
@@ -471,6 +552,14 @@ class MetaCache : public RefCountedThreadSafe<MetaCache> {
   // permits have been acquired.
   Semaphore master_lookup_sem_;
 
+  // Master lookups in flight, keyed by table id and then by the partition key
+  // they were sent for, along with the lookups waiting for each of them.
+  //
+  // Protected by inflight_lock_.
+  typedef std::map<std::string, std::vector<LookupRpc*>> InflightLookupMap;
+  std::unordered_map<std::string, InflightLookupMap> inflight_lookups_;
+  simple_spinlock inflight_lock_;
+
   DISALLOW_COPY_AND_ASSIGN(MetaCache);
 };
 
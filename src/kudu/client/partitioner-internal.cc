@@ -45,6 +45,14 @@ Status KuduPartitionerBuilder::Data::Build(KuduPartitioner** partitioner) {
   auto deadline = MonoTime::Now() + timeout_;
   auto mc = table_->client()->data_->meta_cache_;
 
+  // Fetch the locations of all the tablets of the table in bulk, so that
+  // the lookups below are served from the cache.
+  {
+    Synchronizer sync;
+    mc->PrefetchTabletLocations(table_.get(), "", "", deadline, sync.AsStatusCallback());
+    RETURN_NOT_OK(sync.Wait());
+  }
+
   // Insert a sentinel for the beginning of the table, in case they
   // query for any row which falls before the first partition.
   ret_data->partitions_by_start_key_[""] =  -1;
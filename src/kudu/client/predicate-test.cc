@@ -943,6 +943,54 @@ TEST_F(PredicateTest, TestDoublePredicates) {
   ASSERT_EQ(1, CountRows(table, { table->NewIsNullPredicate("value") }));
 }
 
+TEST_F(PredicateTest, TestInBloomFilterPredicates) {
+  shared_ptr<KuduTable> table = CreateAndOpenTable(KuduColumnSchema::INT64);
+  shared_ptr<KuduSession> session = CreateSession();
+  const int kNumRows = 1000;
+  for (int i = 0; i < kNumRows; i++) {
+    unique_ptr<KuduInsert> insert(table->NewInsert());
+    ASSERT_OK(insert->mutable_row()->SetInt64("key", i));
+    ASSERT_OK(insert->mutable_row()->SetInt64("value", i));
+    ASSERT_OK(session->Apply(insert.release()));
+  }
+  ASSERT_OK(session->Flush());
+
+  const auto make_values = [] () {
+    vector<KuduValue*> vals;
+    for (int i = 0; i < 500; i += 10) {
+      vals.push_back(KuduValue::FromInt(i));
+    }
+    return vals;
+  };
+
+  // All of the values match, and few others do: only those passing the
+  // filter between the smallest and the largest value.
+  vector<KuduValue*> vals = make_values();
+  int count = CountRows(table, { table->NewInBloomFilterPredicate("value", &vals, 0.01) });
+  ASSERT_GE(count, 50);
+  ASSERT_LT(count, 70);
+
+  // Combined with an IN list of the same values, only they match.
+  vals = make_values();
+  vector<KuduValue*> list_vals = make_values();
+  ASSERT_EQ(50, CountRows(table, { table->NewInBloomFilterPredicate("value", &vals, 0.01),
+                                   table->NewInListPredicate("value", &list_vals) }));
+
+  // A single value is an equality predicate.
+  vals = { KuduValue::FromInt(42) };
+  ASSERT_EQ(1, CountRows(table, { table->NewInBloomFilterPredicate("value", &vals, 0.01) }));
+
+  // No values match no rows.
+  vals.clear();
+  ASSERT_EQ(0, CountRows(table, { table->NewInBloomFilterPredicate("value", &vals, 0.01) }));
+
+  // The false positive rate must be within (0, 1).
+  vals = make_values();
+  KuduScanner scanner(table.get());
+  Status s = scanner.AddConjunctPredicate(table->NewInBloomFilterPredicate("value", &vals, 1));
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+}
+
 TEST_F(PredicateTest, TestStringPredicates) {
   shared_ptr<KuduTable> table = CreateAndOpenTable(KuduColumnSchema::STRING);
   shared_ptr<KuduSession> session = CreateSession();
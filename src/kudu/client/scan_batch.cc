@@ -68,6 +68,18 @@ Slice KuduScanBatch::indirect_data() const {
   return data_->indirect_data_;
 }
 
+Status KuduScanBatch::GetFixedLengthColumn(int idx, Slice* data) const {
+  return data_->GetFixedLengthColumn(idx, data);
+}
+
+Status KuduScanBatch::GetVariableLengthColumn(int idx, Slice* offsets, Slice* data) const {
+  return data_->GetVariableLengthColumn(idx, offsets, data);
+}
+
+Status KuduScanBatch::GetNonNullBitmapForColumn(int idx, Slice* data) const {
+  return data_->GetNonNullBitmapForColumn(idx, data);
+}
+
 ////////////////////////////////////////////////////////////
 // KuduScanBatch::RowPtr
 ////////////////////////////////////////////////////////////
@@ -143,6 +143,48 @@ class KUDU_EXPORT KuduScanBatch {
   ///
   /// @return a Slice that points to the raw indirect row data.
   Slice indirect_data() const;
+
+  /// Get the cell data of a fixed-length column, when the batch was
+  /// returned in columnar layout (see KuduScanner::COLUMNAR_LAYOUT).
+  ///
+  /// The cells are stored back to back in their in-memory representation.
+  /// The contents of NULL cells are undefined.
+  ///
+  /// @param [in] idx
+  ///   The index of the column in the projection schema.
+  /// @param [out] data
+  ///   The cell data of the column.
+  /// @return Operation result status. Returns an IllegalState status if the
+  ///   batch is not in columnar layout, and an InvalidArgument status if the
+  ///   column is out of range or is of a variable-length type.
+  Status GetFixedLengthColumn(int idx, Slice* data) const;
+
+  /// Get the data of a variable-length (STRING or BINARY) column, when the
+  /// batch was returned in columnar layout.
+  ///
+  /// @param [in] idx
+  ///   The index of the column in the projection schema.
+  /// @param [out] offsets
+  ///   NumRows() + 1 uint32 offsets into @c data. The value of row @c i
+  ///   spans the bytes [offsets[i], offsets[i + 1]).
+  /// @param [out] data
+  ///   The concatenated values of the column.
+  /// @return Operation result status. Returns an IllegalState status if the
+  ///   batch is not in columnar layout, and an InvalidArgument status if the
+  ///   column is out of range or is not of a variable-length type.
+  Status GetVariableLengthColumn(int idx, Slice* offsets, Slice* data) const;
+
+  /// Get the non-null bitmap of a column, when the batch was returned in
+  /// columnar layout. A set bit means the corresponding cell is not NULL.
+  ///
+  /// @param [in] idx
+  ///   The index of the column in the projection schema.
+  /// @param [out] data
+  ///   The non-null bitmap. Empty if the column is not nullable.
+  /// @return Operation result status. Returns an IllegalState status if the
+  ///   batch is not in columnar layout, and an InvalidArgument status if the
+  ///   column is out of range.
+  Status GetNonNullBitmapForColumn(int idx, Slice* data) const;
   ///@}
 
  private:
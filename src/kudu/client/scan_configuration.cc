@@ -41,6 +41,8 @@ namespace client {
 
 const uint64_t ScanConfiguration::kNoTimestamp = KuduClient::kNoTimestamp;
 const int ScanConfiguration::kHtTimestampBitsToShift = 12;
+const int64_t ScanConfiguration::kNoMaxStaleness = -1;
+const int64_t ScanConfiguration::kNoLimit = -1;
 
 ScanConfiguration::ScanConfiguration(KuduTable* table)
     : table_(table),
@@ -52,9 +54,14 @@ ScanConfiguration::ScanConfiguration(KuduTable* table)
       read_mode_(KuduScanner::READ_LATEST),
       is_fault_tolerant_(false),
       snapshot_timestamp_(kNoTimestamp),
+      max_staleness_ms_(kNoMaxStaleness),
       timeout_(MonoDelta::FromMilliseconds(KuduScanner::kScanTimeoutMillis)),
       arena_(256),
-      row_format_flags_(KuduScanner::NO_FLAGS) {
+      row_format_flags_(KuduScanner::NO_FLAGS),
+      prefetching_(false),
+      adaptive_batch_sizing_(false),
+      limit_(kNoLimit),
+      ordered_merge_(false) {
 }
 
 Status ScanConfiguration::SetProjectedColumnNames(const vector<string>& col_names) {
@@ -180,6 +187,10 @@ void ScanConfiguration::SetSnapshotRaw(uint64_t snapshot_timestamp) {
   snapshot_timestamp_ = snapshot_timestamp;
 }
 
+void ScanConfiguration::SetMaxStalenessMillis(int64_t max_staleness_ms) {
+  max_staleness_ms_ = max_staleness_ms;
+}
+
 void ScanConfiguration::SetTimeoutMillis(int millis) {
   timeout_ = MonoDelta::FromMilliseconds(millis);
 }
@@ -189,6 +200,67 @@ Status ScanConfiguration::SetRowFormatFlags(uint64_t flags) {
   return Status::OK();
 }
 
+void ScanConfiguration::SetPrefetching(bool prefetching) {
+  prefetching_ = prefetching;
+}
+
+void ScanConfiguration::SetAdaptiveBatchSizing(bool adaptive_batch_sizing) {
+  adaptive_batch_sizing_ = adaptive_batch_sizing;
+}
+
+void ScanConfiguration::AddAggregate(AggregationSpecPB::Function function,
+                                     const string& col_name) {
+  AggregationSpecPB::Aggregate* agg = aggregation_.add_aggregates();
+  agg->set_function(function);
+  if (!col_name.empty()) {
+    agg->set_column(col_name);
+  }
+}
+
+Status ScanConfiguration::SetGroupByKeyPrefix(int num_key_columns) {
+  if (num_key_columns < 0 ||
+      num_key_columns > static_cast<int>(table_->schema().num_key_columns())) {
+    return Status::InvalidArgument(strings::Substitute(
+        "cannot group by $0 key columns: the primary key has $1 columns",
+        num_key_columns, table_->schema().num_key_columns()));
+  }
+  aggregation_.set_group_by_key_prefix_len(num_key_columns);
+  return Status::OK();
+}
+
+Status ScanConfiguration::SetLimit(int64_t limit) {
+  if (limit < 0) {
+    return Status::InvalidArgument(strings::Substitute("invalid scan limit: $0", limit));
+  }
+  limit_ = limit;
+  return Status::OK();
+}
+
+void ScanConfiguration::SetOrderedMerge(bool ordered_merge) {
+  ordered_merge_ = ordered_merge;
+}
+
+void ScanConfiguration::CopyFrom(const ScanConfiguration& other) {
+  DCHECK_EQ(table_, other.table_);
+  projection_ = other.projection_;
+  client_projection_ = other.client_projection_;
+  spec_ = other.spec_;
+  has_batch_size_bytes_ = other.has_batch_size_bytes_;
+  batch_size_bytes_ = other.batch_size_bytes_;
+  selection_ = other.selection_;
+  read_mode_ = other.read_mode_;
+  is_fault_tolerant_ = other.is_fault_tolerant_;
+  snapshot_timestamp_ = other.snapshot_timestamp_;
+  max_staleness_ms_ = other.max_staleness_ms_;
+  timeout_ = other.timeout_;
+  row_format_flags_ = other.row_format_flags_;
+  prefetching_ = other.prefetching_;
+  adaptive_batch_sizing_ = other.adaptive_batch_sizing_;
+  aggregation_ = other.aggregation_;
+  limit_ = other.limit_;
+  ordered_merge_ = other.ordered_merge_;
+}
+
 void ScanConfiguration::OptimizeScanSpec() {
   spec_.OptimizeScan(*table_->schema().schema_,
                      &arena_,
@@ -25,6 +25,7 @@
 
 #include "kudu/client/client.h"
 #include "kudu/client/schema.h"
+#include "kudu/common/common.pb.h"
 #include "kudu/common/scan_spec.h"
 #include "kudu/gutil/port.h"
 #include "kudu/util/auto_release_pool.h"
@@ -86,10 +87,30 @@ class ScanConfiguration {
 
   void SetSnapshotRaw(uint64_t snapshot_timestamp);
 
+  void SetMaxStalenessMillis(int64_t max_staleness_ms);
+
   void SetTimeoutMillis(int millis);
 
   Status SetRowFormatFlags(uint64_t flags);
 
+  void SetPrefetching(bool prefetching);
+
+  void SetAdaptiveBatchSizing(bool adaptive_batch_sizing);
+
+  void AddAggregate(AggregationSpecPB::Function function, const std::string& col_name);
+
+  Status SetGroupByKeyPrefix(int num_key_columns) WARN_UNUSED_RESULT;
+
+  Status SetLimit(int64_t limit) WARN_UNUSED_RESULT;
+
+  void SetOrderedMerge(bool ordered_merge);
+
+  // Copies all the options of 'other', which must scan the same table, for
+  // a scanner of a single tablet within an ordered merge. The projection,
+  // the bounds and the predicates remain owned by 'other', which must outlive
+  // this configuration.
+  void CopyFrom(const ScanConfiguration& other);
+
   void OptimizeScanSpec();
 
   const KuduTable& table() {
@@ -144,6 +165,15 @@ class ScanConfiguration {
     return snapshot_timestamp_;
   }
 
+  bool has_max_staleness() const {
+    return max_staleness_ms_ != kNoMaxStaleness;
+  }
+
+  int64_t max_staleness_ms() const {
+    CHECK(has_max_staleness());
+    return max_staleness_ms_;
+  }
+
   const MonoDelta& timeout() const {
     return timeout_;
   }
@@ -152,6 +182,37 @@ class ScanConfiguration {
     return row_format_flags_;
   }
 
+  bool prefetching() const {
+    return prefetching_;
+  }
+
+  bool adaptive_batch_sizing() const {
+    return adaptive_batch_sizing_;
+  }
+
+  // Returns true if aggregates or group-by columns were set, in which case
+  // the tablet servers return partial aggregates instead of rows.
+  bool has_aggregation() const {
+    return aggregation_.aggregates_size() > 0 || aggregation_.group_by_key_prefix_len() > 0;
+  }
+
+  const AggregationSpecPB& aggregation() const {
+    return aggregation_;
+  }
+
+  bool has_limit() const {
+    return limit_ != kNoLimit;
+  }
+
+  int64_t limit() const {
+    CHECK(has_limit());
+    return limit_;
+  }
+
+  bool ordered_merge() const {
+    return ordered_merge_;
+  }
+
   Arena* arena() {
     return &arena_;
   }
@@ -160,6 +221,8 @@ class ScanConfiguration {
   friend class KuduScanTokenBuilder;
 
   static const uint64_t kNoTimestamp;
+  static const int64_t kNoMaxStaleness;
+  static const int64_t kNoLimit;
   static const int kHtTimestampBitsToShift;
 
   // Non-owned, non-null table.
@@ -184,6 +247,8 @@ class ScanConfiguration {
 
   uint64_t snapshot_timestamp_;
 
+  int64_t max_staleness_ms_;
+
   MonoDelta timeout_;
 
   // Manages interior allocations for the scan spec and copied bounds.
@@ -194,6 +259,16 @@ class ScanConfiguration {
   AutoReleasePool pool_;
 
   uint64_t row_format_flags_;
+
+  bool prefetching_;
+
+  bool adaptive_batch_sizing_;
+
+  AggregationSpecPB aggregation_;
+
+  int64_t limit_;
+
+  bool ordered_merge_;
 };
 
 } // namespace client
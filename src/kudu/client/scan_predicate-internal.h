@@ -117,6 +117,36 @@ class InListPredicateData : public KuduPredicate::Data {
   std::vector<KuduValue*> vals_;
 };
 
+// A bloom filter predicate for a column, built from a list of constant
+// values.
+class InBloomFilterPredicateData : public KuduPredicate::Data {
+ public:
+  InBloomFilterPredicateData(ColumnSchema col,
+                             std::vector<KuduValue*>* values,
+                             double false_positive_rate);
+
+  virtual ~InBloomFilterPredicateData();
+
+  Status AddToScanSpec(ScanSpec* spec, Arena* arena) override;
+
+  InBloomFilterPredicateData* Clone() const override {
+    std::vector<KuduValue*> values;
+    values.reserve(vals_.size());
+    for (KuduValue* val : vals_) {
+      values.push_back(val->Clone());
+    }
+
+    return new InBloomFilterPredicateData(col_, &values, false_positive_rate_);
+  }
+
+ private:
+  friend class KuduScanner;
+
+  ColumnSchema col_;
+  std::vector<KuduValue*> vals_;
+  double false_positive_rate_;
+};
+
 // A predicate for selecting non-null values.
 class IsNotNullPredicateData : public KuduPredicate::Data {
  public:
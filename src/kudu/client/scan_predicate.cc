@@ -17,6 +17,8 @@
 
 #include "kudu/client/scan_predicate.h"
 
+#include <cstdint>
+#include <cstring>
 #include <utility>
 #include <vector>
 
@@ -32,6 +34,9 @@
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/bloom_filter.h"
+#include "kudu/util/memory/arena.h"
+#include "kudu/util/slice.h"
 #include "kudu/util/status.h"
 
 using boost::optional;
@@ -40,9 +45,6 @@ using std::vector;
 using strings::Substitute;
 
 namespace kudu {
-
-class Arena;
-
 namespace client {
 
 KuduPredicate::KuduPredicate(Data* d)
@@ -146,5 +148,60 @@ Status InListPredicateData::AddToScanSpec(ScanSpec* spec, Arena* /*arena*/) {
   return Status::OK();
 }
 
+InBloomFilterPredicateData::InBloomFilterPredicateData(ColumnSchema col,
+                                                       vector<KuduValue*>* values,
+                                                       double false_positive_rate)
+    : col_(move(col)),
+      false_positive_rate_(false_positive_rate) {
+  vals_.swap(*values);
+}
+
+InBloomFilterPredicateData::~InBloomFilterPredicateData() {
+  STLDeleteElements(&vals_);
+}
+
+Status InBloomFilterPredicateData::AddToScanSpec(ScanSpec* spec, Arena* arena) {
+  if (vals_.empty()) {
+    spec->AddPredicate(ColumnPredicate::None(col_));
+    return Status::OK();
+  }
+
+  const TypeInfo* type_info = col_.type_info();
+  BloomFilterBuilder builder(BloomFilterSizing::ByCountAndFPRate(vals_.size(),
+                                                                 false_positive_rate_),
+                             SPLIT_BLOCK_BLOOM_FILTER);
+  const void* min_value = nullptr;
+  const void* max_value = nullptr;
+  for (auto value : vals_) {
+    void* val_void;
+    RETURN_NOT_OK(value->data_->CheckTypeAndGetPointer(col_.name(),
+                                                       type_info->physical_type(),
+                                                       &val_void));
+    builder.AddKey(BloomKeyProbe(ColumnPredicate::BloomFilterKey(type_info, val_void)));
+    if (min_value == nullptr || type_info->Compare(val_void, min_value) < 0) {
+      min_value = val_void;
+    }
+    if (max_value == nullptr || type_info->Compare(val_void, max_value) > 0) {
+      max_value = val_void;
+    }
+  }
+
+  // The filter is copied into the arena, which outlives the predicate.
+  Slice filter = builder.slice();
+  uint8_t* filter_copy = static_cast<uint8_t*>(arena->AllocateBytes(filter.size()));
+  memcpy(filter_copy, filter.data(), filter.size());
+  spec->AddPredicate(ColumnPredicate::InBloomFilter(
+      col_, { Slice(filter_copy, filter.size()) }, nullptr, nullptr));
+
+  // Bounding the filter by the smallest and largest values lets the tablet
+  // servers prune partitions, rowsets and primary key ranges with it.
+  optional<ColumnPredicate> bounds =
+      ColumnPredicate::InclusiveRange(col_, min_value, max_value, arena);
+  if (bounds) {
+    spec->AddPredicate(*bounds);
+  }
+  return Status::OK();
+}
+
 } // namespace client
 } // namespace kudu
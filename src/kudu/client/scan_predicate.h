@@ -55,6 +55,7 @@ class KUDU_EXPORT KuduPredicate {
  private:
   friend class ComparisonPredicateData;
   friend class ErrorPredicateData;
+  friend class InBloomFilterPredicateData;
   friend class InListPredicateData;
   friend class IsNotNullPredicateData;
   friend class IsNullPredicateData;
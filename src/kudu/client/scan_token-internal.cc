@@ -49,6 +49,9 @@
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/rpc/rpc_controller.h"
+#include "kudu/tserver/tserver.pb.h"
+#include "kudu/tserver/tserver_service.proxy.h"
 #include "kudu/util/async_util.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/net/net_util.h"
@@ -153,7 +156,7 @@ Status KuduScanToken::Data::PBIntoScanner(KuduClient* client,
   }
 
   if (message.has_limit()) {
-    // TODO(KUDU-16)
+    RETURN_NOT_OK(scan_builder->SetLimit(message.limit()));
   }
 
   if (message.has_read_mode()) {
@@ -192,7 +195,48 @@ Status KuduScanToken::Data::PBIntoScanner(KuduClient* client,
 }
 
 KuduScanTokenBuilder::Data::Data(KuduTable* table)
-    : configuration_(table) {
+    : configuration_(table),
+      split_size_bytes_(0) {
+}
+
+Status KuduScanTokenBuilder::Data::SplitTabletKeyRange(internal::RemoteTablet* tablet,
+                                                       const string& start_key,
+                                                       const string& stop_key,
+                                                       const MonoTime& deadline,
+                                                       vector<string>* split_keys) {
+  // Any replica can estimate the split, but the leader's data is the freshest.
+  internal::RemoteTabletServer* ts = tablet->LeaderTServer();
+  if (!ts) {
+    vector<internal::RemoteTabletServer*> servers;
+    tablet->GetRemoteTabletServers(&servers);
+    if (servers.empty()) {
+      return Status::ServiceUnavailable(
+          Substitute("no replica available for tablet $0", tablet->tablet_id()));
+    }
+    ts = servers[0];
+  }
+  Synchronizer sync;
+  ts->InitProxy(configuration_.table_->client(), sync.AsStatusCallback());
+  RETURN_NOT_OK(sync.Wait());
+
+  tserver::SplitKeyRangeRequestPB req;
+  tserver::SplitKeyRangeResponsePB resp;
+  req.set_tablet_id(tablet->tablet_id());
+  if (!start_key.empty()) {
+    req.set_start_primary_key(start_key);
+  }
+  if (!stop_key.empty()) {
+    req.set_stop_primary_key(stop_key);
+  }
+  req.set_target_chunk_size_bytes(split_size_bytes_);
+  rpc::RpcController controller;
+  controller.set_deadline(deadline);
+  RETURN_NOT_OK(ts->proxy()->SplitKeyRange(req, &resp, &controller));
+  if (resp.has_error()) {
+    return StatusFromPB(resp.error().status());
+  }
+  split_keys->assign(resp.split_primary_keys().begin(), resp.split_primary_keys().end());
+  return Status::OK();
 }
 
 Status KuduScanTokenBuilder::Data::Build(vector<KuduScanToken*>* tokens) {
@@ -291,46 +335,72 @@ Status KuduScanTokenBuilder::Data::Build(vector<KuduScanToken*>* tokens) {
     vector<internal::RemoteReplica> replicas;
     tablet->GetRemoteReplicas(&replicas);
 
-    vector<const KuduReplica*> client_replicas;
-    ElementDeleter deleter(&client_replicas);
-
     // Convert the replicas from their internal format to something appropriate
-    // for clients.
-    for (const auto& r : replicas) {
-      vector<HostPort> host_ports;
-      r.ts->GetHostPorts(&host_ports);
-      if (host_ports.empty()) {
-        return Status::IllegalState(Substitute(
-            "No host found for tablet server $0", r.ts->ToString()));
+    // for clients. Each token owns its own copy.
+    const auto new_client_tablet = [&](unique_ptr<KuduTablet>* client_tablet) {
+      vector<const KuduReplica*> client_replicas;
+      ElementDeleter deleter(&client_replicas);
+      for (const auto& r : replicas) {
+        vector<HostPort> host_ports;
+        r.ts->GetHostPorts(&host_ports);
+        if (host_ports.empty()) {
+          return Status::IllegalState(Substitute(
+              "No host found for tablet server $0", r.ts->ToString()));
+        }
+        unique_ptr<KuduTabletServer> client_ts(new KuduTabletServer);
+        client_ts->data_ = new KuduTabletServer::Data(r.ts->permanent_uuid(),
+                                                      host_ports[0]);
+        bool is_leader = r.role == consensus::RaftPeerPB::LEADER;
+        unique_ptr<KuduReplica> client_replica(new KuduReplica);
+        client_replica->data_ = new KuduReplica::Data(is_leader,
+                                                      std::move(client_ts));
+        client_replicas.push_back(client_replica.release());
+      }
+      client_tablet->reset(new KuduTablet);
+      (*client_tablet)->data_ = new KuduTablet::Data(tablet->tablet_id(),
+                                                     std::move(client_replicas));
+      client_replicas.clear();
+      return Status::OK();
+    };
+
+    // Split large tablets into several tokens, each covering a primary key
+    // range of about the requested size. Splitting is only an optimization,
+    // so a tablet which can't be split, e.g. because its tablet server
+    // predates splitting, gets a single token.
+    vector<string> split_keys;
+    if (split_size_bytes_ > 0) {
+      Status s = SplitTabletKeyRange(tablet.get(), pb.lower_bound_primary_key(),
+                                     pb.upper_bound_primary_key(), deadline, &split_keys);
+      if (!s.ok()) {
+        LOG(WARNING) << Substitute("Unable to split tablet $0 into scan tokens: $1",
+                                   tablet->tablet_id(), s.ToString());
+        split_keys.clear();
       }
-      unique_ptr<KuduTabletServer> client_ts(new KuduTabletServer);
-      client_ts->data_ = new KuduTabletServer::Data(r.ts->permanent_uuid(),
-                                                    host_ports[0]);
-      bool is_leader = r.role == consensus::RaftPeerPB::LEADER;
-      unique_ptr<KuduReplica> client_replica(new KuduReplica);
-      client_replica->data_ = new KuduReplica::Data(is_leader,
-                                                    std::move(client_ts));
-      client_replicas.push_back(client_replica.release());
     }
 
-    unique_ptr<KuduTablet> client_tablet(new KuduTablet);
-    client_tablet->data_ = new KuduTablet::Data(tablet->tablet_id(),
-                                                std::move(client_replicas));
-    client_replicas.clear();
-
-    // Create the scan token itself.
-    ScanTokenPB message;
-    message.CopyFrom(pb);
-    message.set_lower_bound_partition_key(
-        tablet->partition().partition_key_start());
-    message.set_upper_bound_partition_key(
-        tablet->partition().partition_key_end());
-    unique_ptr<KuduScanToken> client_scan_token(new KuduScanToken);
-    client_scan_token->data_ =
-        new KuduScanToken::Data(table,
-                                std::move(message),
-                                std::move(client_tablet));
-    tokens->push_back(client_scan_token.release());
+    // Create the scan tokens themselves.
+    for (int i = 0; i <= split_keys.size(); i++) {
+      unique_ptr<KuduTablet> client_tablet;
+      RETURN_NOT_OK(new_client_tablet(&client_tablet));
+      ScanTokenPB message;
+      message.CopyFrom(pb);
+      message.set_lower_bound_partition_key(
+          tablet->partition().partition_key_start());
+      message.set_upper_bound_partition_key(
+          tablet->partition().partition_key_end());
+      if (i > 0) {
+        message.set_lower_bound_primary_key(split_keys[i - 1]);
+      }
+      if (i < split_keys.size()) {
+        message.set_upper_bound_primary_key(split_keys[i]);
+      }
+      unique_ptr<KuduScanToken> client_scan_token(new KuduScanToken);
+      client_scan_token->data_ =
+          new KuduScanToken::Data(table,
+                                  std::move(message),
+                                  std::move(client_tablet));
+      tokens->push_back(client_scan_token.release());
+    }
     pruner.RemovePartitionKeyRange(tablet->partition().partition_key_end());
   }
   return Status::OK();
@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <vector>
@@ -27,8 +28,15 @@
 #include "kudu/util/status.h"
 
 namespace kudu {
+
+class MonoTime;
+
 namespace client {
 
+namespace internal {
+class RemoteTablet;
+} // namespace internal
+
 class KuduScanToken::Data {
  public:
   explicit Data(KuduTable* table,
@@ -72,8 +80,24 @@ class KuduScanTokenBuilder::Data {
     return &configuration_;
   }
 
+  void SetSplitSizeBytes(uint64_t split_size_bytes) {
+    split_size_bytes_ = split_size_bytes;
+  }
+
  private:
+  // Asks a tablet server hosting 'tablet' to split the primary key range
+  // [start_key, stop_key) of the tablet into chunks of 'split_size_bytes_',
+  // setting 'split_keys' to the keys to split at.
+  Status SplitTabletKeyRange(internal::RemoteTablet* tablet,
+                             const std::string& start_key,
+                             const std::string& stop_key,
+                             const MonoTime& deadline,
+                             std::vector<std::string>* split_keys);
+
   ScanConfiguration configuration_;
+
+  // If non-zero, the on-disk size of the data each token should cover.
+  uint64_t split_size_bytes_;
 };
 
 } // namespace client
@@ -17,6 +17,7 @@
 
 #include <atomic>
 #include <cstdint>
+#include <limits>
 #include <memory>
 #include <string>
 #include <thread>
@@ -42,8 +43,11 @@
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/mini-cluster/internal_mini_cluster.h"
+#include "kudu/tablet/tablet.h"
+#include "kudu/tablet/tablet_replica.h"
 #include "kudu/tserver/mini_tablet_server.h"
 #include "kudu/tserver/tablet_server.h"
+#include "kudu/tserver/ts_tablet_manager.h"
 #include "kudu/tserver/tserver.pb.h"
 #include "kudu/util/net/sockaddr.h"
 #include "kudu/util/status.h"
@@ -62,6 +66,7 @@ using std::thread;
 using std::unique_ptr;
 using std::unordered_set;
 using std::vector;
+using tablet::TabletReplica;
 using tserver::MiniTabletServer;
 
 class ScanTokenTest : public KuduTest {
@@ -572,5 +577,100 @@ TEST_F(ScanTokenTest, TestConcurrentAlterTable) {
   delete scanner_ptr;
 }
 
+TEST_F(ScanTokenTest, TestScanTokensSplitBySize) {
+  KuduSchema schema;
+  {
+    KuduSchemaBuilder builder;
+    builder.AddColumn("key")->NotNull()->Type(KuduColumnSchema::INT64)->PrimaryKey();
+    builder.AddColumn("val")->NotNull()->Type(KuduColumnSchema::STRING);
+    ASSERT_OK(builder.Build(&schema));
+  }
+
+  // A table with a single tablet.
+  shared_ptr<KuduTable> table;
+  {
+    unique_ptr<client::KuduTableCreator> table_creator(client_->NewTableCreator());
+    ASSERT_OK(table_creator->table_name("table")
+                            .schema(&schema)
+                            .set_range_partition_columns({ "key" })
+                            .num_replicas(1)
+                            .Create());
+    ASSERT_OK(client_->OpenTable("table", &table));
+  }
+
+  const int kNumRows = 10000;
+  shared_ptr<KuduSession> session = client_->NewSession();
+  session->SetTimeoutMillis(10000);
+  ASSERT_OK(session->SetFlushMode(KuduSession::AUTO_FLUSH_BACKGROUND));
+  for (int i = 0; i < kNumRows; i++) {
+    unique_ptr<KuduInsert> insert(table->NewInsert());
+    ASSERT_OK(insert->mutable_row()->SetInt64("key", i));
+    ASSERT_OK(insert->mutable_row()->SetStringCopy("val", string(100, 'x')));
+    ASSERT_OK(session->Apply(insert.release()));
+  }
+  ASSERT_OK(session->Flush());
+
+  string tablet_id;
+  {
+    vector<KuduScanToken*> tokens;
+    ElementDeleter deleter(&tokens);
+    ASSERT_OK(KuduScanTokenBuilder(table.get()).Build(&tokens));
+    ASSERT_EQ(1, tokens.size());
+    tablet_id = tokens[0]->tablet().id();
+  }
+
+  // Only data on disk is split.
+  scoped_refptr<TabletReplica> replica;
+  ASSERT_TRUE(cluster_->mini_tablet_server(0)->server()->tablet_manager()->LookupTablet(
+      tablet_id, &replica));
+  {
+    vector<KuduScanToken*> tokens;
+    ElementDeleter deleter(&tokens);
+    KuduScanTokenBuilder builder(table.get());
+    ASSERT_OK(builder.SetSplitSizeBytes(1024));
+    ASSERT_OK(builder.Build(&tokens));
+    ASSERT_EQ(1, tokens.size());
+  }
+  ASSERT_OK(replica->tablet()->Flush());
+  uint64_t data_size;
+  {
+    vector<string> split_keys;
+    vector<uint64_t> chunk_sizes;
+    ASSERT_OK(replica->tablet()->SplitKeyRange("", "", std::numeric_limits<uint64_t>::max(),
+                                               &split_keys, &chunk_sizes));
+    ASSERT_EQ(1, chunk_sizes.size());
+    data_size = chunk_sizes[0];
+  }
+
+  { // the whole tablet
+    vector<KuduScanToken*> tokens;
+    ElementDeleter deleter(&tokens);
+    KuduScanTokenBuilder builder(table.get());
+    ASSERT_OK(builder.SetSplitSizeBytes(data_size / 8));
+    ASSERT_OK(builder.Build(&tokens));
+    ASSERT_GT(tokens.size(), 1);
+    for (const KuduScanToken* token : tokens) {
+      ASSERT_EQ(tablet_id, token->tablet().id());
+    }
+    ASSERT_EQ(kNumRows, CountRows(tokens));
+  }
+
+  { // primary key bounds
+    vector<KuduScanToken*> tokens;
+    ElementDeleter deleter(&tokens);
+    KuduScanTokenBuilder builder(table.get());
+    unique_ptr<KuduPartialRow> lower_bound(schema.NewRow());
+    ASSERT_OK(lower_bound->SetInt64("key", 1000));
+    ASSERT_OK(builder.AddLowerBound(*lower_bound));
+    unique_ptr<KuduPartialRow> upper_bound(schema.NewRow());
+    ASSERT_OK(upper_bound->SetInt64("key", 9000));
+    ASSERT_OK(builder.AddUpperBound(*upper_bound));
+    ASSERT_OK(builder.SetSplitSizeBytes(data_size / 8));
+    ASSERT_OK(builder.Build(&tokens));
+    ASSERT_GT(tokens.size(), 1);
+    ASSERT_EQ(8000, CountRows(tokens));
+  }
+}
+
 } // namespace client
 } // namespace kudu
@@ -19,6 +19,11 @@
 
 #include <algorithm>
 #include <cstdint>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <ostream>
 #include <string>
 #include <unordered_map>
@@ -51,7 +56,9 @@
 using google::protobuf::FieldDescriptor;
 using google::protobuf::Reflection;
 using std::set;
+using std::shared_ptr;
 using std::string;
+using std::unique_ptr;
 using std::vector;
 
 namespace kudu {
@@ -66,16 +73,76 @@ namespace client {
 
 using internal::RemoteTabletServer;
 
+const uint32_t ScanBatchSizer::kDefaultBatchSizeBytes = 1024 * 1024;
+const uint32_t ScanBatchSizer::kMinBatchSizeBytes = 64 * 1024;
+const uint32_t ScanBatchSizer::kMaxBatchSizeBytes = 8 * 1024 * 1024;
+const int64_t ScanBatchSizer::kMaxBatchLatencyMs = 100;
+
+ScanBatchSizer::ScanBatchSizer(uint32_t initial_batch_size_bytes)
+    : batch_size_bytes_(initial_batch_size_bytes),
+      min_batch_size_bytes_(std::min(initial_batch_size_bytes, kMinBatchSizeBytes)) {
+}
+
+void ScanBatchSizer::RecordBatch(size_t batch_bytes,
+                                 const MonoDelta& rpc_time,
+                                 const MonoDelta& server_time,
+                                 const MonoDelta& consumer_time,
+                                 bool prefetching) {
+  const int64_t rpc_us = rpc_time.ToMicroseconds();
+  if (rpc_us > kMaxBatchLatencyMs * 1000) {
+    // Keep the latency of each batch bounded.
+    Shrink();
+    return;
+  }
+  const bool known_consumer = prefetching && consumer_time.Initialized();
+  if (known_consumer && consumer_time.ToMicroseconds() > rpc_us) {
+    // The application is the bottleneck: the next batch arrives before it's
+    // needed anyway, and smaller batches use less memory.
+    Shrink();
+    return;
+  }
+  if (batch_bytes < batch_size_bytes_ / 2) {
+    // The batch wasn't cut by its size, e.g. it ended the tablet, so it says
+    // nothing about larger batches.
+    return;
+  }
+  // Grow batches which mostly spend their time on the network, amortizing the
+  // per-RPC overhead, as long as the application waits for them and they stay
+  // well within the latency bound. The gap between the growth and shrink
+  // thresholds keeps the size from oscillating.
+  const bool network_bound = server_time.ToMicroseconds() * 2 < rpc_us;
+  const bool consumer_waits = !known_consumer || consumer_time.ToMicroseconds() * 2 < rpc_us;
+  if (network_bound && consumer_waits && rpc_us * 2 <= kMaxBatchLatencyMs * 1000) {
+    Grow();
+  }
+}
+
+void ScanBatchSizer::Grow() {
+  batch_size_bytes_ = std::min(kMaxBatchSizeBytes,
+                               std::max(batch_size_bytes_ * 2, kMinBatchSizeBytes));
+}
+
+void ScanBatchSizer::Shrink() {
+  batch_size_bytes_ = std::max(min_batch_size_bytes_, batch_size_bytes_ / 2);
+}
+
 KuduScanner::Data::Data(KuduTable* table)
   : configuration_(table),
     open_(false),
     data_in_open_(false),
     short_circuit_(false),
+    num_rows_returned_(0),
+    prefetch_in_flight_(false),
+    prefetch_done_(false),
     table_(DCHECK_NOTNULL(table)->shared_from_this()),
     scan_attempts_(0) {
 }
 
 KuduScanner::Data::~Data() {
+  // The prefetch response and controller must outlive the RPC.
+  if (prefetch_in_flight_) {
+    ignore_result(prefetch_sync_.Wait());
+  }
 }
 
 Status KuduScanner::Data::HandleError(const ScanRpcStatus& err,
@@ -157,6 +224,12 @@ Status KuduScanner::Data::HandleError(const ScanRpcStatus& err,
   if (backoff) {
     MonoDelta sleep =
         KuduClient::Data::ComputeExponentialBackoff(scan_attempts_);
+    // If the server shed the call because it's overloaded, back off for at
+    // least as long as it asked to.
+    const rpc::ErrorStatusPB* rpc_err = controller_.error_response();
+    if (rpc_err && rpc_err->has_retry_after_ms()) {
+      sleep = std::max(sleep, MonoDelta::FromMilliseconds(rpc_err->retry_after_ms()));
+    }
     MonoTime now = MonoTime::Now() + sleep;
     if (deadline < now) {
       Status ret = Status::TimedOut("unable to retry before timeout",
@@ -241,6 +314,15 @@ ScanRpcStatus KuduScanner::Data::AnalyzeResponse(const Status& rpc_status,
   Status server_status = StatusFromPB(last_response_.error().status());
   DCHECK(!server_status.ok());
   const tserver::TabletServerErrorPB& error = last_response_.error();
+  if (error.code() == tserver::TabletServerErrorPB::MISMATCHED_SCHEMA ||
+      error.code() == tserver::TabletServerErrorPB::INVALID_SCHEMA) {
+    // The table was likely altered since it was opened: the next opening of
+    // the table must not get the cached schema.
+    const auto& cache = table_->client()->data_->table_metadata_cache_;
+    if (cache) {
+      cache->InvalidateTableId(table_->id());
+    }
+  }
   switch (error.code()) {
     case tserver::TabletServerErrorPB::SCANNER_EXPIRED:
       return ScanRpcStatus{ScanRpcStatus::SCANNER_EXPIRED, server_status};
@@ -268,8 +350,9 @@ Status KuduScanner::Data::ReopenCurrentTablet(const MonoTime& deadline,
                     blacklist);
 }
 
-ScanRpcStatus KuduScanner::Data::SendScanRpc(const MonoTime& overall_deadline,
-                                             bool allow_time_for_failover) {
+MonoTime KuduScanner::Data::PrepareController(const MonoTime& overall_deadline,
+                                              bool allow_time_for_failover,
+                                              RpcController* controller) const {
   // The user has specified a timeout which should apply to the total time for each call
   // to NextBatch(). However, for fault-tolerant scans, or for when we are first opening
   // a scanner, it's preferable to set a shorter timeout (the "default RPC timeout") for
@@ -283,25 +366,154 @@ ScanRpcStatus KuduScanner::Data::SendScanRpc(const MonoTime& overall_deadline,
     rpc_deadline = overall_deadline;
   }
 
-  controller_.Reset();
-  controller_.set_deadline(rpc_deadline);
+  controller->Reset();
+  controller->set_deadline(rpc_deadline);
   if (!configuration_.spec().predicates().empty()) {
-    controller_.RequireServerFeature(TabletServerFeatures::COLUMN_PREDICATES);
+    controller->RequireServerFeature(TabletServerFeatures::COLUMN_PREDICATES);
   }
   if (configuration().row_format_flags() & KuduScanner::PAD_UNIXTIME_MICROS_TO_16_BYTES) {
-    controller_.RequireServerFeature(TabletServerFeatures::PAD_UNIXTIME_MICROS_TO_16_BYTES);
+    controller->RequireServerFeature(TabletServerFeatures::PAD_UNIXTIME_MICROS_TO_16_BYTES);
+  }
+  if (configuration().row_format_flags() & KuduScanner::COLUMNAR_LAYOUT) {
+    controller->RequireServerFeature(TabletServerFeatures::COLUMNAR_LAYOUT_FEATURE);
   }
-  ScanRpcStatus scan_status = AnalyzeResponse(
-      proxy_->Scan(next_req_,
-                   &last_response_,
-                   &controller_),
-      rpc_deadline, overall_deadline);
+  return rpc_deadline;
+}
+
+ScanRpcStatus KuduScanner::Data::SendScanRpc(const MonoTime& overall_deadline,
+                                             bool allow_time_for_failover) {
+  MonoTime rpc_deadline = PrepareController(overall_deadline, allow_time_for_failover,
+                                            &controller_);
+  MonoTime start = MonoTime::Now();
+  Status rpc_status = proxy_->Scan(next_req_, &last_response_, &controller_);
+  last_rpc_time_ = MonoTime::Now() - start;
+  ScanRpcStatus scan_status = AnalyzeResponse(rpc_status, rpc_deadline, overall_deadline);
   if (scan_status.result == ScanRpcStatus::OK) {
     UpdateResourceMetrics();
   }
   return scan_status;
 }
 
+void KuduScanner::Data::MaybeSendPrefetchRpc() {
+  DCHECK(!prefetch_in_flight_);
+  if (!configuration_.prefetching() || !last_response_.has_more_results() ||
+      ReachedLimit()) {
+    return;
+  }
+
+  VLOG(2) << "Prefetching " << DebugString();
+  SendPrefetchRpc();
+}
+
+void KuduScanner::Data::SendPrefetchRpc() {
+  DCHECK(!prefetch_in_flight_);
+  PrepareRequest(KuduScanner::Data::CONTINUE);
+  prefetch_overall_deadline_ = MonoTime::Now() + configuration_.timeout();
+  prefetch_rpc_deadline_ = PrepareController(prefetch_overall_deadline_,
+                                             configuration_.is_fault_tolerant(),
+                                             &prefetch_controller_);
+  prefetch_sync_.Reset();
+  {
+    std::lock_guard<simple_spinlock> l(prefetch_lock_);
+    prefetch_done_ = false;
+  }
+  prefetch_in_flight_ = true;
+  prefetch_sent_ = MonoTime::Now();
+  proxy_->ScanAsync(next_req_, &prefetch_response_, &prefetch_controller_,
+                    [this]() {
+                      prefetch_completed_ = MonoTime::Now();
+                      std::function<void()> cb;
+                      {
+                        std::lock_guard<simple_spinlock> l(prefetch_lock_);
+                        prefetch_done_ = true;
+                        cb.swap(prefetch_done_cb_);
+                      }
+                      prefetch_sync_.StatusCB(prefetch_controller_.status());
+                      if (cb) {
+                        cb();
+                      }
+                    });
+}
+
+void KuduScanner::Data::OnPrefetchRpcDone(std::function<void()> cb) {
+  DCHECK(prefetch_in_flight_);
+  {
+    std::lock_guard<simple_spinlock> l(prefetch_lock_);
+    if (!prefetch_done_) {
+      DCHECK(!prefetch_done_cb_);
+      prefetch_done_cb_ = std::move(cb);
+      return;
+    }
+  }
+  cb();
+}
+
+ScanRpcStatus KuduScanner::Data::WaitForPrefetchRpc() {
+  DCHECK(prefetch_in_flight_);
+  Status rpc_status = prefetch_sync_.Wait();
+  prefetch_in_flight_ = false;
+
+  last_response_.Swap(&prefetch_response_);
+  controller_.Swap(&prefetch_controller_);
+  last_rpc_time_ = prefetch_completed_ - prefetch_sent_;
+  ScanRpcStatus scan_status = AnalyzeResponse(rpc_status,
+                                              prefetch_rpc_deadline_,
+                                              prefetch_overall_deadline_);
+  if (scan_status.result == ScanRpcStatus::OK) {
+    UpdateResourceMetrics();
+  }
+  return scan_status;
+}
+
+Status KuduScanner::Data::ProcessContinueResult(ScanRpcStatus result,
+                                                const MonoTime& deadline,
+                                                KuduScanBatch::Data* batch) {
+  while (true) {
+    // Success case.
+    if (result.result == ScanRpcStatus::OK) {
+      if (last_response_.has_last_primary_key()) {
+        last_primary_key_ = last_response_.last_primary_key();
+      }
+      scan_attempts_ = 0;
+      RETURN_NOT_OK(MergeAggregateResults());
+      RETURN_NOT_OK(batch->Reset(
+          &controller_,
+          configuration_.projection(),
+          configuration_.client_projection(),
+          configuration_.row_format_flags(),
+          make_gscoped_ptr(last_response_.release_data()),
+          make_gscoped_ptr(last_response_.release_columnar_data())));
+      FinishBatch(batch);
+      return Status::OK();
+    }
+
+    scan_attempts_++;
+
+    // Error handling.
+    set<string> blacklist;
+    Status s = HandleError(result, deadline, &blacklist);
+    if (!s.ok()) {
+      LOG(WARNING) << "Scan at tablet server " << ts_->ToString() << " of tablet "
+                   << DebugString() << " failed: " << result.status.ToString();
+      return s;
+    }
+
+    if (configuration_.is_fault_tolerant()) {
+      LOG(WARNING) << "Attempting to retry scan of tablet " << DebugString()
+                   << " elsewhere.";
+      return ReopenCurrentTablet(deadline, &blacklist);
+    }
+
+    if (!blacklist.empty()) {
+      // If we blacklisted the current server, and it's not fault-tolerant, we can't
+      // retry anywhere, so just propagate the error.
+      return result.status;
+    }
+    // If we didn't blacklist the current server, we can just retry again.
+    result = SendScanRpc(deadline, configuration_.is_fault_tolerant());
+  }
+}
+
 Status KuduScanner::Data::OpenTablet(const string& partition_key,
                                      const MonoTime& deadline,
                                      set<string>* blacklist) {
@@ -323,6 +535,8 @@ Status KuduScanner::Data::OpenTablet(const string& partition_key,
       scan->set_read_mode(kudu::READ_AT_SNAPSHOT);
       if (configuration_.has_snapshot_timestamp()) {
         scan->set_snap_timestamp(configuration_.snapshot_timestamp());
+      } else if (configuration_.has_max_staleness()) {
+        scan->set_max_staleness_ms(configuration_.max_staleness_ms());
       }
       break;
     default:
@@ -343,6 +557,14 @@ Status KuduScanner::Data::OpenTablet(const string& partition_key,
 
   scan->set_cache_blocks(configuration_.spec().cache_blocks());
 
+  if (configuration_.has_limit()) {
+    scan->set_limit(std::max<int64_t>(0, configuration_.limit() - num_rows_returned_));
+  }
+
+  if (configuration_.has_aggregation()) {
+    scan->mutable_aggregation()->CopyFrom(configuration_.aggregation());
+  }
+
   // For consistent operations, propagate the timestamp among all operations
   // performed the context of the same client.
   const uint64_t lo_ts = table_->client()->data_->GetLatestObservedTimestamp();
@@ -444,7 +666,8 @@ Status KuduScanner::Data::OpenTablet(const string& partition_key,
   partition_pruner_.RemovePartitionKeyRange(remote_->partition().partition_key_end());
 
   next_req_.clear_new_scan_request();
-  data_in_open_ = last_response_.has_data() && last_response_.data().num_rows() > 0;
+  data_in_open_ = (last_response_.has_data() && last_response_.data().num_rows() > 0) ||
+      (last_response_.has_columnar_data() && last_response_.columnar_data().num_rows() > 0);
   if (last_response_.has_more_results()) {
     next_req_.set_scanner_id(last_response_.scanner_id());
     VLOG(2) << "Opened tablet " << remote_->tablet_id()
@@ -478,11 +701,17 @@ Status KuduScanner::Data::OpenTablet(const string& partition_key,
         last_response_.propagated_timestamp());
   }
 
-  return Status::OK();
+  return MergeAggregateResults();
 }
 
 Status KuduScanner::Data::KeepAlive() {
   if (!open_) return Status::IllegalState("Scanner was not open.");
+  if (configuration_.ordered_merge()) {
+    for (const auto& source : merge_sources_) {
+      RETURN_NOT_OK(source.scanner->KeepAlive());
+    }
+    return Status::OK();
+  }
   // If there is no scanner to keep alive, we still return Status::OK().
   if (!last_response_.IsInitialized() || !last_response_.has_more_results() ||
       !next_req_.has_scanner_id()) {
@@ -501,6 +730,190 @@ Status KuduScanner::Data::KeepAlive() {
   return Status::OK();
 }
 
+Status KuduScanner::Data::MergeAggregateResults() {
+  if (!aggregator_) {
+    return Status::OK();
+  }
+  return aggregator_->MergeFrom(last_response_.aggregate_groups());
+}
+
+void KuduScanner::Data::ApplyLimit(KuduScanBatch::Data* batch) {
+  int num_rows = batch->num_rows();
+  if (configuration_.has_limit()) {
+    int64_t remaining = std::max<int64_t>(0, configuration_.limit() - num_rows_returned_);
+    if (num_rows > remaining) {
+      // The tablet server returned more rows than asked for; it may not
+      // support limits.
+      num_rows = remaining;
+      batch->Truncate(num_rows);
+    }
+  }
+  num_rows_returned_ += num_rows;
+}
+
+void KuduScanner::Data::FinishBatch(KuduScanBatch::Data* batch) {
+  if (batch_sizer_) {
+    batch_sizer_->RecordBatch(batch->data_size_bytes(),
+                              last_rpc_time_,
+                              MonoDelta::FromMicroseconds(last_response_.scan_wall_time_us()),
+                              consumer_time_,
+                              configuration_.prefetching());
+  }
+  ApplyLimit(batch);
+  MaybeSendPrefetchRpc();
+  if (batch_sizer_) {
+    batch_handed_out_ = MonoTime::Now();
+  }
+}
+
+Status KuduScanner::Data::OpenOrderedMerge(const MonoTime& deadline) {
+  if (configuration_.row_format_flags() != KuduScanner::NO_FLAGS) {
+    return Status::InvalidArgument("An ordered merge requires the default row format");
+  }
+  const Schema& table_schema = *table_->schema().schema_;
+  const Schema& projection = *configuration_.projection();
+  merge_key_cols_.clear();
+  for (int i = 0; i < table_schema.num_key_columns(); i++) {
+    int idx = projection.find_column(table_schema.column(i).name());
+    if (idx == Schema::kColumnNotFound) {
+      return Status::InvalidArgument(Substitute(
+          "An ordered merge must project primary key column $0",
+          table_schema.column(i).name()));
+    }
+    merge_key_cols_.push_back(idx);
+  }
+
+  merge_sources_.clear();
+  merge_heap_.clear();
+  while (partition_pruner_.HasMorePartitionKeyRanges()) {
+    const string partition_key = partition_pruner_.NextPartitionKey();
+    scoped_refptr<internal::RemoteTablet> tablet;
+    Synchronizer sync;
+    table_->client()->data_->meta_cache_->LookupTabletByKeyOrNext(table_.get(),
+                                                                  partition_key,
+                                                                  deadline,
+                                                                  &tablet,
+                                                                  sync.AsStatusCallback());
+    Status s = sync.Wait();
+    if (s.IsNotFound()) {
+      // No more tablets in the table.
+      partition_pruner_.RemovePartitionKeyRange("");
+      break;
+    }
+    RETURN_NOT_OK(s);
+    const Partition& partition = tablet->partition();
+    bool prune = partition_key < partition.partition_key_start() &&
+        partition_pruner_.ShouldPrune(partition);
+    partition_pruner_.RemovePartitionKeyRange(partition.partition_key_end());
+    if (prune) {
+      continue;
+    }
+
+    // Scan the tablet in primary key order with a scanner of its own.
+    unique_ptr<KuduScanner> scanner(new KuduScanner(table_.get()));
+    ScanConfiguration* config = scanner->data_->mutable_configuration();
+    config->CopyFrom(configuration_);
+    config->SetOrderedMerge(false);
+    RETURN_NOT_OK(config->AddLowerBoundPartitionKeyRaw(partition.partition_key_start()));
+    RETURN_NOT_OK(config->AddUpperBoundPartitionKeyRaw(partition.partition_key_end()));
+    RETURN_NOT_OK(scanner->Open());
+
+    // Scan the other tablets at the same snapshot, for a consistent result.
+    if (!configuration_.has_snapshot_timestamp() &&
+        scanner->data_->configuration().has_snapshot_timestamp()) {
+      configuration_.SetSnapshotRaw(scanner->data_->configuration().snapshot_timestamp());
+    }
+
+    MergeSource source;
+    source.scanner = std::move(scanner);
+    RETURN_NOT_OK(FetchMergeSourceBatch(&source));
+    if (source.batch) {
+      merge_sources_.emplace_back(std::move(source));
+      merge_heap_.push_back(merge_sources_.size() - 1);
+    }
+  }
+  std::make_heap(merge_heap_.begin(), merge_heap_.end(),
+                 [this](int a, int b) { return MergeSourceGreater(a, b); });
+  return Status::OK();
+}
+
+Status KuduScanner::Data::FetchMergeSourceBatch(MergeSource* source) {
+  source->batch.reset();
+  source->next_row = 0;
+  while (source->scanner->HasMoreRows()) {
+    shared_ptr<KuduScanBatch> batch(new KuduScanBatch);
+    RETURN_NOT_OK(source->scanner->NextBatch(batch.get()));
+    if (batch->NumRows() > 0) {
+      source->batch = std::move(batch);
+      break;
+    }
+  }
+  return Status::OK();
+}
+
+const uint8_t* KuduScanner::Data::MergeSourceRow(const MergeSource& source) const {
+  const KuduScanBatch::Data* batch = source.batch->data_;
+  return batch->direct_data_.data() + source.next_row * batch->projected_row_size_;
+}
+
+bool KuduScanner::Data::MergeSourceGreater(int a, int b) const {
+  const Schema& projection = *configuration_.projection();
+  const uint8_t* row_a = MergeSourceRow(merge_sources_[a]);
+  const uint8_t* row_b = MergeSourceRow(merge_sources_[b]);
+  for (int idx : merge_key_cols_) {
+    size_t offset = projection.column_offset(idx);
+    int cmp = projection.column(idx).Compare(row_a + offset, row_b + offset);
+    if (cmp != 0) {
+      return cmp > 0;
+    }
+  }
+  // Tablets don't overlap, so this is only reached when comparing a source
+  // with itself.
+  return a > b;
+}
+
+Status KuduScanner::Data::NextMergedBatch(KuduScanBatch::Data* batch) {
+  const auto greater = [this](int a, int b) { return MergeSourceGreater(a, b); };
+  const int64_t max_rows = configuration_.has_limit() ?
+      configuration_.limit() - num_rows_returned_ : std::numeric_limits<int64_t>::max();
+  const size_t row_size = KuduScanBatch::Data::CalculateProjectedRowSize(
+      *configuration_.projection());
+
+  vector<shared_ptr<KuduScanBatch>> source_batches;
+  batch->merged_direct_data_.clear();
+  int num_rows = 0;
+  bool fetched = false;
+  while (!merge_heap_.empty() && num_rows < max_rows && !fetched) {
+    // Take the smallest row across all tablets.
+    std::pop_heap(merge_heap_.begin(), merge_heap_.end(), greater);
+    MergeSource* source = &merge_sources_[merge_heap_.back()];
+    batch->merged_direct_data_.append(MergeSourceRow(*source), row_size);
+    num_rows++;
+    if (std::find(source_batches.begin(), source_batches.end(), source->batch) ==
+        source_batches.end()) {
+      source_batches.push_back(source->batch);
+    }
+
+    if (++source->next_row == source->batch->NumRows()) {
+      RETURN_NOT_OK(FetchMergeSourceBatch(source));
+      fetched = true;
+      if (!source->batch) {
+        // The tablet is exhausted.
+        merge_heap_.pop_back();
+        continue;
+      }
+    }
+    std::push_heap(merge_heap_.begin(), merge_heap_.end(), greater);
+  }
+
+  batch->ResetMerged(configuration_.projection(),
+                     configuration_.client_projection(),
+                     num_rows,
+                     std::move(source_batches));
+  num_rows_returned_ += num_rows;
+  return Status::OK();
+}
+
 bool KuduScanner::Data::MoreTablets() const {
   CHECK(open_);
   // TODO(KUDU-565): add a test which has a scan end on a tablet boundary
@@ -510,6 +923,8 @@ bool KuduScanner::Data::MoreTablets() const {
 void KuduScanner::Data::PrepareRequest(RequestType state) {
   if (state == KuduScanner::Data::CLOSE) {
     next_req_.set_batch_size_bytes(0);
+  } else if (batch_sizer_) {
+    next_req_.set_batch_size_bytes(batch_sizer_->batch_size_bytes());
   } else if (configuration_.has_batch_size_bytes()) {
     next_req_.set_batch_size_bytes(configuration_.batch_size_bytes());
   } else {
@@ -546,13 +961,23 @@ Status KuduScanBatch::Data::Reset(RpcController* controller,
                                   const Schema* projection,
                                   const KuduSchema* client_projection,
                                   uint64_t row_format_flags,
-                                  gscoped_ptr<RowwiseRowBlockPB> resp_data) {
+                                  gscoped_ptr<RowwiseRowBlockPB> resp_data,
+                                  gscoped_ptr<ColumnarRowBlockPB> columnar_resp_data) {
   CHECK(controller->finished());
   controller_.Swap(controller);
   projection_ = projection;
   projected_row_size_ = CalculateProjectedRowSize(*projection_);
   client_projection_ = client_projection;
   row_format_flags_ = row_format_flags;
+  if (row_format_flags_ & KuduScanner::COLUMNAR_LAYOUT) {
+    columnar_columns_.clear();
+    if (!columnar_resp_data) {
+      columnar_resp_data_.Clear();
+      return Status::OK();
+    }
+    columnar_resp_data_.Swap(columnar_resp_data.get());
+    return ResetColumnar();
+  }
   if (!resp_data) {
     // No new data; just clear out the old stuff.
     resp_data_.Clear();
@@ -618,9 +1043,160 @@ void KuduScanBatch::Data::ExtractRows(vector<KuduScanBatch::RowPtr>* rows) {
   VLOG(2) << "Extracted " << rows->size() << " rows";
 }
 
+Status KuduScanBatch::Data::ResetColumnar() {
+  int64_t num_rows = columnar_resp_data_.num_rows();
+  if (PREDICT_FALSE(num_rows < 0)) {
+    return Status::Corruption("Server sent invalid response: negative row count");
+  }
+  // Batches with no rows may omit the per-column data altogether.
+  if (num_rows == 0 && columnar_resp_data_.columns_size() == 0) {
+    return Status::OK();
+  }
+  if (PREDICT_FALSE(columnar_resp_data_.columns_size() != projection_->num_columns())) {
+    return Status::Corruption(Substitute(
+        "Server sent invalid response: expected $0 columns, got $1",
+        projection_->num_columns(), columnar_resp_data_.columns_size()));
+  }
+
+  columnar_columns_.resize(projection_->num_columns());
+  for (int i = 0; i < projection_->num_columns(); i++) {
+    const ColumnSchema& col = projection_->column(i);
+    const ColumnarRowBlockPB::Column& col_pb = columnar_resp_data_.columns(i);
+    ColumnarColumn* dst = &columnar_columns_[i];
+
+    Status s = controller_.GetInboundSidecar(col_pb.data_sidecar(), &dst->data);
+    if (!s.ok()) {
+      return Status::Corruption(Substitute(
+          "Server sent invalid response: data sidecar index corrupt for column $0",
+          col.name()), s.ToString());
+    }
+
+    if (col.type_info()->physical_type() == BINARY) {
+      s = controller_.GetInboundSidecar(col_pb.varlen_data_sidecar(), &dst->varlen_data);
+      if (!s.ok()) {
+        return Status::Corruption(Substitute(
+            "Server sent invalid response: varlen data sidecar index corrupt for column $0",
+            col.name()), s.ToString());
+      }
+      if (PREDICT_FALSE(dst->data.size() != (num_rows + 1) * sizeof(uint32_t))) {
+        return Status::Corruption(Substitute(
+            "Server sent invalid response: column $0 has $1 bytes of offsets for $2 rows",
+            col.name(), dst->data.size(), num_rows));
+      }
+      uint32_t last_offset;
+      memcpy(&last_offset, dst->data.data() + num_rows * sizeof(uint32_t), sizeof(last_offset));
+      if (PREDICT_FALSE(last_offset > dst->varlen_data.size())) {
+        return Status::Corruption(Substitute(
+            "Server sent invalid response: column $0 offsets point past its $1 bytes of data",
+            col.name(), dst->varlen_data.size()));
+      }
+    } else if (PREDICT_FALSE(dst->data.size() != num_rows * col.type_info()->size())) {
+      return Status::Corruption(Substitute(
+          "Server sent invalid response: column $0 has $1 bytes of data for $2 rows",
+          col.name(), dst->data.size(), num_rows));
+    }
+
+    if (col.is_nullable()) {
+      s = controller_.GetInboundSidecar(col_pb.non_null_bitmap_sidecar(), &dst->non_null_bitmap);
+      if (!s.ok()) {
+        return Status::Corruption(Substitute(
+            "Server sent invalid response: non-null bitmap sidecar index corrupt for column $0",
+            col.name()), s.ToString());
+      }
+      if (PREDICT_FALSE(dst->non_null_bitmap.size() < BitmapSize(num_rows))) {
+        return Status::Corruption(Substitute(
+            "Server sent invalid response: column $0 has a $1-byte non-null bitmap for $2 rows",
+            col.name(), dst->non_null_bitmap.size(), num_rows));
+      }
+    }
+  }
+  return Status::OK();
+}
+
+Status KuduScanBatch::Data::CheckColumnarColumnIdx(int idx) const {
+  if (PREDICT_FALSE(!(row_format_flags_ & KuduScanner::COLUMNAR_LAYOUT))) {
+    return Status::IllegalState("batch is not in columnar layout");
+  }
+  if (PREDICT_FALSE(idx < 0 || idx >= projection_->num_columns())) {
+    return Status::InvalidArgument(Substitute("invalid column index: $0", idx));
+  }
+  return Status::OK();
+}
+
+Status KuduScanBatch::Data::GetFixedLengthColumn(int idx, Slice* data) const {
+  RETURN_NOT_OK(CheckColumnarColumnIdx(idx));
+  const ColumnSchema& col = projection_->column(idx);
+  if (PREDICT_FALSE(col.type_info()->physical_type() == BINARY)) {
+    return Status::InvalidArgument("column is of variable-length type", col.name());
+  }
+  *data = columnar_columns_.empty() ? Slice() : columnar_columns_[idx].data;
+  return Status::OK();
+}
+
+Status KuduScanBatch::Data::GetVariableLengthColumn(int idx, Slice* offsets, Slice* data) const {
+  RETURN_NOT_OK(CheckColumnarColumnIdx(idx));
+  const ColumnSchema& col = projection_->column(idx);
+  if (PREDICT_FALSE(col.type_info()->physical_type() != BINARY)) {
+    return Status::InvalidArgument("column is not of variable-length type", col.name());
+  }
+  if (columnar_columns_.empty()) {
+    *offsets = Slice();
+    *data = Slice();
+  } else {
+    *offsets = columnar_columns_[idx].data;
+    *data = columnar_columns_[idx].varlen_data;
+  }
+  return Status::OK();
+}
+
+Status KuduScanBatch::Data::GetNonNullBitmapForColumn(int idx, Slice* data) const {
+  RETURN_NOT_OK(CheckColumnarColumnIdx(idx));
+  *data = columnar_columns_.empty() ? Slice() : columnar_columns_[idx].non_null_bitmap;
+  return Status::OK();
+}
+
+void KuduScanBatch::Data::ResetMerged(const Schema* projection,
+                                      const KuduSchema* client_projection,
+                                      int num_rows,
+                                      vector<shared_ptr<KuduScanBatch>> source_batches) {
+  projection_ = projection;
+  projected_row_size_ = CalculateProjectedRowSize(*projection_);
+  client_projection_ = client_projection;
+  row_format_flags_ = KuduScanner::NO_FLAGS;
+  DCHECK_EQ(num_rows * projected_row_size_, merged_direct_data_.size());
+  resp_data_.Clear();
+  resp_data_.set_num_rows(num_rows);
+  direct_data_ = Slice(merged_direct_data_);
+  indirect_data_ = Slice();
+  merged_source_batches_ = std::move(source_batches);
+}
+
+void KuduScanBatch::Data::Truncate(int num_rows) {
+  DCHECK_LE(num_rows, this->num_rows());
+  if (row_format_flags_ & KuduScanner::COLUMNAR_LAYOUT) {
+    columnar_resp_data_.set_num_rows(num_rows);
+  } else {
+    resp_data_.set_num_rows(num_rows);
+  }
+}
+
+size_t KuduScanBatch::Data::data_size_bytes() const {
+  if (row_format_flags_ & KuduScanner::COLUMNAR_LAYOUT) {
+    size_t size = 0;
+    for (const auto& col : columnar_columns_) {
+      size += col.data.size() + col.varlen_data.size() + col.non_null_bitmap.size();
+    }
+    return size;
+  }
+  return direct_data_.size() + indirect_data_.size();
+}
+
 void KuduScanBatch::Data::Clear() {
   resp_data_.Clear();
+  columnar_resp_data_.Clear();
+  columnar_columns_.clear();
   controller_.Reset();
+  merged_source_batches_.clear();
 }
 
 } // namespace client
@@ -19,6 +19,7 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <memory>
 #include <ostream>
 #include <set>
@@ -34,6 +35,7 @@
 #include "kudu/client/scan_configuration.h"
 #include "kudu/client/shared_ptr.h"
 #include "kudu/client/schema.h"
+#include "kudu/common/aggregation.h"
 #include "kudu/common/partition_pruner.h"
 #include "kudu/common/scan_spec.h"
 #include "kudu/common/schema.h"
@@ -44,13 +46,15 @@
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/rpc/rpc_controller.h"
 #include "kudu/tserver/tserver.pb.h"
+#include "kudu/util/async_util.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/status.h"
 
 namespace kudu {
 
-class MonoTime;
-
 namespace tserver {
 class TabletServerServiceProxy;
 }
@@ -112,6 +116,50 @@ struct ScanRpcStatus {
   Status status;
 };
 
+// Adjusts the batch size of a scan from the time taken by its batches: by the
+// scan RPCs, by the tablet server producing them, and by the application
+// processing them. See KuduScanner::SetAdaptiveBatchSizing().
+class ScanBatchSizer {
+ public:
+  // The batch size of the tablet servers, when the scanner doesn't set one.
+  static const uint32_t kDefaultBatchSizeBytes;
+
+  // The bounds of the batch size. The tablet servers cap it at their own
+  // maximum too. The lower bound is that of the initial batch size, if smaller.
+  static const uint32_t kMinBatchSizeBytes;
+  static const uint32_t kMaxBatchSizeBytes;
+
+  // Batches whose RPC takes longer than this are shrunk.
+  static const int64_t kMaxBatchLatencyMs;
+
+  explicit ScanBatchSizer(uint32_t initial_batch_size_bytes);
+
+  // The batch size to request next.
+  uint32_t batch_size_bytes() const {
+    return batch_size_bytes_;
+  }
+
+  // Adjusts the batch size after a batch of 'batch_bytes' bytes was received.
+  //
+  // 'rpc_time' is the round trip time of its RPC, and 'server_time' the time
+  // the tablet server reported spending on it. 'consumer_time' is the time
+  // the application took to process the previous batch, or uninitialized if
+  // there is none. 'prefetching' is true if the RPC overlapped with that
+  // processing.
+  void RecordBatch(size_t batch_bytes,
+                   const MonoDelta& rpc_time,
+                   const MonoDelta& server_time,
+                   const MonoDelta& consumer_time,
+                   bool prefetching);
+
+ private:
+  void Grow();
+  void Shrink();
+
+  uint32_t batch_size_bytes_;
+  const uint32_t min_batch_size_bytes_;
+};
+
 class KuduScanner::Data {
  public:
 
@@ -127,6 +175,34 @@ class KuduScanner::Data {
   // The RPC and TS proxy should already have been prepared in next_req_, proxy_, etc.
   ScanRpcStatus SendScanRpc(const MonoTime& overall_deadline, bool allow_time_for_failover);
 
+  // If prefetching is enabled and the current tablet has more results, sends
+  // the continuation of the scan asynchronously, to be picked up by
+  // WaitForPrefetchRpc(). Must be called once the batch in 'last_response_'
+  // has been handed out, and only when no prefetch RPC is in flight.
+  void MaybeSendPrefetchRpc();
+
+  // Sends the continuation of the scan asynchronously, as a prefetch RPC.
+  // Must only be called when no prefetch RPC is in flight.
+  void SendPrefetchRpc();
+
+  // Calls 'cb' once the in-flight prefetch RPC completes: right away on the
+  // calling thread if it already has, otherwise on the reactor thread which
+  // completes it. At most one callback may be registered per RPC.
+  void OnPrefetchRpcDone(std::function<void()> cb);
+
+  // Waits for the in-flight prefetch RPC to complete, moving its response
+  // into 'last_response_' and 'controller_' as if it had been sent by
+  // SendScanRpc().
+  ScanRpcStatus WaitForPrefetchRpc();
+
+  // Processes the 'result' of a continuation RPC of the current tablet,
+  // resetting 'batch' to its rows on success. Otherwise, handles the error,
+  // possibly retrying the RPC or reopening the tablet elsewhere until
+  // 'deadline'. Only the success case is guaranteed not to block.
+  Status ProcessContinueResult(ScanRpcStatus result,
+                               const MonoTime& deadline,
+                               KuduScanBatch::Data* batch);
+
   // Called when KuduScanner::NextBatch or KuduScanner::Data::OpenTablet result in an RPC or
   // server error.
   //
@@ -158,6 +234,33 @@ class KuduScanner::Data {
 
   Status KeepAlive();
 
+  // If the scan has an aggregation, merges the partial aggregates of
+  // 'last_response_' into 'aggregator_'.
+  Status MergeAggregateResults();
+
+  // Returns true if the scan has a limit and returned that many rows.
+  bool ReachedLimit() const {
+    return configuration_.has_limit() && num_rows_returned_ >= configuration_.limit();
+  }
+
+  // Truncates 'batch' to the rows remaining before the scan's limit, if any,
+  // and counts its rows as returned.
+  void ApplyLimit(KuduScanBatch::Data* batch);
+
+  // Called once the rows of 'last_response_' were reset into 'batch', before
+  // it is handed out: adjusts the batch size if adaptive, applies the limit,
+  // and prefetches the next batch if enabled.
+  void FinishBatch(KuduScanBatch::Data* batch);
+
+  // Opens one scanner per tablet for an ordered merge, fetching the first
+  // batch of each. See KuduScanner::SetOrderedMerge().
+  Status OpenOrderedMerge(const MonoTime& deadline);
+
+  // Fills 'batch' with the next rows of the ordered merge, in primary key
+  // order. Returns early once a tablet's batch runs out and the next one was
+  // fetched, so that each call makes about one round trip.
+  Status NextMergedBatch(KuduScanBatch::Data* batch);
+
   // Returns whether there may exist more tablets to scan.
   //
   // This method does not take into account any non-covered range partitions
@@ -207,6 +310,58 @@ class KuduScanner::Data {
   // The encoded last primary key from the most recent tablet scan response.
   std::string last_primary_key_;
 
+  // Accumulates the partial aggregates returned by the tablet servers, if the
+  // scan has an aggregation. Reset whenever the scan is opened.
+  std::unique_ptr<ScanAggregator> aggregator_;
+
+  // The number of rows returned so far, counted against the scan's limit.
+  int64_t num_rows_returned_;
+
+  // Sizes the batches if adaptive batch sizing is enabled. Reset whenever the
+  // scan is opened.
+  std::unique_ptr<ScanBatchSizer> batch_sizer_;
+
+  // The round trip time of the RPC which returned 'last_response_'.
+  MonoDelta last_rpc_time_;
+
+  // When the last batch was handed out to the application, and how long the
+  // application took to ask for the next one after the one before.
+  MonoTime batch_handed_out_;
+  MonoDelta consumer_time_;
+
+  // A tablet scanned in an ordered merge, and its current batch of rows.
+  struct MergeSource {
+    std::unique_ptr<KuduScanner> scanner;
+
+    // The batch holding the next row to merge, or null once the tablet is
+    // exhausted. Shared with the merged batches which copied its rows, since
+    // the copies point into its indirect data.
+    std::shared_ptr<KuduScanBatch> batch;
+
+    // The index of the next row to merge in 'batch'.
+    int next_row;
+  };
+
+  // Fetches the next non-empty batch of 'source', if any.
+  static Status FetchMergeSourceBatch(MergeSource* source);
+
+  // Returns a pointer to the next row of 'source'.
+  const uint8_t* MergeSourceRow(const MergeSource& source) const;
+
+  // Returns true if the next row of merge source 'a' sorts after the next
+  // row of merge source 'b'.
+  bool MergeSourceGreater(int a, int b) const;
+
+  // The tablets of an ordered merge.
+  std::vector<MergeSource> merge_sources_;
+
+  // The indexes in 'merge_sources_' of the tablets with rows left, as a heap
+  // on their next row, so that the smallest row is always at the front.
+  std::vector<int> merge_heap_;
+
+  // The indexes of the primary key columns in the projection.
+  std::vector<int> merge_key_cols_;
+
   internal::RemoteTabletServer* ts_;
 
   // The proxy can be derived from the RemoteTabletServer, but this involves retaking the
@@ -224,6 +379,35 @@ class KuduScanner::Data {
   // RPC controller for the last in-flight RPC.
   rpc::RpcController controller_;
 
+  // Whether a prefetch RPC (see MaybeSendPrefetchRpc()) is in flight.
+  //
+  // Only one RPC can be in flight at a time for a given server-side scanner,
+  // since the tablet server requires the continuation requests to arrive in
+  // order of their call sequence IDs.
+  bool prefetch_in_flight_;
+
+  // The response, controller and deadlines of the prefetch RPC. The response
+  // and controller are swapped with 'last_response_' and 'controller_' once
+  // the prefetch RPC completes.
+  tserver::ScanResponsePB prefetch_response_;
+  rpc::RpcController prefetch_controller_;
+  MonoTime prefetch_overall_deadline_;
+  MonoTime prefetch_rpc_deadline_;
+
+  // When the prefetch RPC was sent and when it completed.
+  MonoTime prefetch_sent_;
+  MonoTime prefetch_completed_;
+
+  // Notified when the prefetch RPC completes.
+  Synchronizer prefetch_sync_;
+
+  // Whether the prefetch RPC completed, and the callback to call when it
+  // does, if any: see OnPrefetchRpcDone(). Protected by 'prefetch_lock_',
+  // since the RPC completes on a reactor thread.
+  bool prefetch_done_;
+  std::function<void()> prefetch_done_cb_;
+  simple_spinlock prefetch_lock_;
+
   // The table we're scanning.
   sp::shared_ptr<KuduTable> table_;
 
@@ -278,6 +462,12 @@ class KuduScanner::Data {
                                 const MonoTime& overall_deadline,
                                 const MonoTime& rpc_deadline);
 
+  // Resets 'controller' for a new scan RPC, returning the deadline to use for
+  // the RPC. See SendScanRpc() for the meaning of the arguments.
+  MonoTime PrepareController(const MonoTime& overall_deadline,
+                             bool allow_time_for_failover,
+                             rpc::RpcController* controller) const;
+
   void UpdateResourceMetrics();
 
   DISALLOW_COPY_AND_ASSIGN(Data);
@@ -292,9 +482,13 @@ class KuduScanBatch::Data {
                const Schema* projection,
                const KuduSchema* client_projection,
                uint64_t row_format_flags,
-               gscoped_ptr<RowwiseRowBlockPB> resp_data);
+               gscoped_ptr<RowwiseRowBlockPB> resp_data,
+               gscoped_ptr<ColumnarRowBlockPB> columnar_resp_data);
 
   int num_rows() const {
+    if (row_format_flags_ & KuduScanner::COLUMNAR_LAYOUT) {
+      return columnar_resp_data_.num_rows();
+    }
     return resp_data_.num_rows();
   }
 
@@ -308,8 +502,28 @@ class KuduScanBatch::Data {
     return KuduRowResult(projection_, &direct_data_[offset]);
   }
 
+  // Resets the batch to 'num_rows' rows of 'projection' merged from other
+  // batches. The rows must have been copied into 'merged_direct_data_', and
+  // point into the indirect data of 'source_batches'.
+  void ResetMerged(const Schema* projection,
+                   const KuduSchema* client_projection,
+                   int num_rows,
+                   std::vector<std::shared_ptr<KuduScanBatch>> source_batches);
+
+  // Drops all but the first 'num_rows' rows of the batch.
+  void Truncate(int num_rows);
+
+  // Returns the size of the row data received for the batch.
+  size_t data_size_bytes() const;
+
   void ExtractRows(std::vector<KuduScanBatch::RowPtr>* rows);
 
+  // Accessors for the data of batches in columnar layout.
+  // See the corresponding KuduScanBatch methods.
+  Status GetFixedLengthColumn(int idx, Slice* data) const;
+  Status GetVariableLengthColumn(int idx, Slice* offsets, Slice* data) const;
+  Status GetNonNullBitmapForColumn(int idx, Slice* data) const;
+
   void Clear();
 
   // Returns the size of a row for the given projection 'proj'.
@@ -327,17 +541,43 @@ class KuduScanBatch::Data {
   // by the members above.
   Slice direct_data_, indirect_data_;
 
+  // The PB which describes the data of a batch in columnar layout.
+  ColumnarRowBlockPB columnar_resp_data_;
+
+  // Slices into the sidecars of each column of a batch in columnar layout,
+  // indexed by the column's position in the projection.
+  struct ColumnarColumn {
+    Slice data;
+    Slice varlen_data;
+    Slice non_null_bitmap;
+  };
+  std::vector<ColumnarColumn> columnar_columns_;
+
   // The projection being scanned.
   const Schema* projection_;
   // The KuduSchema version of 'projection_'
   const KuduSchema* client_projection_;
 
+  // For batches merged from other batches: the copied rows, and the batches
+  // whose indirect data they point into.
+  faststring merged_direct_data_;
+  std::vector<std::shared_ptr<KuduScanBatch>> merged_source_batches_;
+
   // The row format flags that were passed to the KuduScanner.
   // See: KuduScanner::SetRowFormatFlags()
   uint64_t row_format_flags_;
 
   // The number of bytes of direct data for each row.
   size_t projected_row_size_;
+
+ private:
+  // Validates the columnar data in 'columnar_resp_data_' and sets up
+  // 'columnar_columns_' to point into the inbound sidecars.
+  Status ResetColumnar();
+
+  // Returns a bad Status if this isn't a columnar batch or if 'idx' is out
+  // of range.
+  Status CheckColumnarColumnIdx(int idx) const;
 };
 
 } // namespace client
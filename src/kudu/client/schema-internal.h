@@ -52,6 +52,9 @@ class KuduColumnSpec::Data {
         has_encoding(false),
         has_compression(false),
         has_block_size(false),
+        has_time_to_live(false),
+        secondary_index(false),
+        bloom_filter(false),
         has_nullable(false),
         primary_key(false),
         has_default(false),
@@ -78,6 +81,13 @@ class KuduColumnSpec::Data {
   bool has_block_size;
   int32_t block_size;
 
+  bool has_time_to_live;
+  int64_t time_to_live_sec;
+
+  bool secondary_index;
+
+  bool bloom_filter;
+
   bool has_nullable;
   bool nullable;
 
@@ -47,7 +47,7 @@ MAKE_ENUM_LIMITS(kudu::client::KuduColumnStorageAttributes::EncodingType,
 
 MAKE_ENUM_LIMITS(kudu::client::KuduColumnStorageAttributes::CompressionType,
                  kudu::client::KuduColumnStorageAttributes::DEFAULT_COMPRESSION,
-                 kudu::client::KuduColumnStorageAttributes::ZLIB);
+                 kudu::client::KuduColumnStorageAttributes::ZSTD);
 
 MAKE_ENUM_LIMITS(kudu::client::KuduColumnSchema::DataType,
                  kudu::client::KuduColumnSchema::INT8,
@@ -70,6 +70,7 @@ kudu::EncodingType ToInternalEncodingType(KuduColumnStorageAttributes::EncodingT
     case KuduColumnStorageAttributes::GROUP_VARINT: return kudu::GROUP_VARINT;
     case KuduColumnStorageAttributes::RLE: return kudu::RLE;
     case KuduColumnStorageAttributes::BIT_SHUFFLE: return kudu::BIT_SHUFFLE;
+    case KuduColumnStorageAttributes::FRAME_OF_REFERENCE: return kudu::FRAME_OF_REFERENCE;
     default: LOG(FATAL) << "Unexpected encoding type: " << type;
   }
 }
@@ -83,6 +84,7 @@ KuduColumnStorageAttributes::EncodingType FromInternalEncodingType(kudu::Encodin
     case kudu::GROUP_VARINT: return KuduColumnStorageAttributes::GROUP_VARINT;
     case kudu::RLE: return KuduColumnStorageAttributes::RLE;
     case kudu::BIT_SHUFFLE: return KuduColumnStorageAttributes::BIT_SHUFFLE;
+    case kudu::FRAME_OF_REFERENCE: return KuduColumnStorageAttributes::FRAME_OF_REFERENCE;
     default: LOG(FATAL) << "Unexpected internal encoding type: " << type;
   }
 }
@@ -94,6 +96,7 @@ kudu::CompressionType ToInternalCompressionType(KuduColumnStorageAttributes::Com
     case KuduColumnStorageAttributes::SNAPPY: return kudu::SNAPPY;
     case KuduColumnStorageAttributes::LZ4: return kudu::LZ4;
     case KuduColumnStorageAttributes::ZLIB: return kudu::ZLIB;
+    case KuduColumnStorageAttributes::ZSTD: return kudu::ZSTD;
     default: LOG(FATAL) << "Unexpected compression type" << type;
   }
 }
@@ -106,6 +109,7 @@ KuduColumnStorageAttributes::CompressionType FromInternalCompressionType(
     case kudu::SNAPPY: return KuduColumnStorageAttributes::SNAPPY;
     case kudu::LZ4: return KuduColumnStorageAttributes::LZ4;
     case kudu::ZLIB: return KuduColumnStorageAttributes::ZLIB;
+    case kudu::ZSTD: return KuduColumnStorageAttributes::ZSTD;
     default: LOG(FATAL) << "Unexpected internal compression type: " << type;
   }
 }
@@ -187,6 +191,22 @@ KuduColumnSpec* KuduColumnSpec::BlockSize(int32_t block_size) {
   return this;
 }
 
+KuduColumnSpec* KuduColumnSpec::TimeToLive(int64_t seconds) {
+  data_->has_time_to_live = true;
+  data_->time_to_live_sec = seconds;
+  return this;
+}
+
+KuduColumnSpec* KuduColumnSpec::SecondaryIndex() {
+  data_->secondary_index = true;
+  return this;
+}
+
+KuduColumnSpec* KuduColumnSpec::BloomFilter() {
+  data_->bloom_filter = true;
+  return this;
+}
+
 KuduColumnSpec* KuduColumnSpec::PrimaryKey() {
   data_->primary_key = true;
   return this;
@@ -264,6 +284,33 @@ Status KuduColumnSpec::ToColumnSchema(KuduColumnSchema* col) const {
                           default_val,
                           KuduColumnStorageAttributes(encoding, compression, block_size));
 
+  // The time-to-live, the secondary index and the bloom filter aren't part of
+  // the public storage attributes, so they're set on the internal column
+  // schema directly.
+  if (data_->has_time_to_live || data_->secondary_index || data_->bloom_filter) {
+    if (data_->has_time_to_live && data_->time_to_live_sec <= 0) {
+      return Status::InvalidArgument("time-to-live must be positive", data_->name);
+    }
+    if (data_->secondary_index && data_->primary_key) {
+      return Status::InvalidArgument("primary key column can't have a secondary index",
+                                     data_->name);
+    }
+    if (data_->bloom_filter && data_->primary_key) {
+      return Status::InvalidArgument("primary key column can't have a bloom filter",
+                                     data_->name);
+    }
+    const ColumnSchema& internal_col = *col->col_;
+    ColumnStorageAttributes attributes = internal_col.attributes();
+    if (data_->has_time_to_live) {
+      attributes.ttl_sec = data_->time_to_live_sec;
+    }
+    attributes.secondary_index = data_->secondary_index;
+    attributes.bloom_filter = data_->bloom_filter;
+    *col->col_ = ColumnSchema(internal_col.name(), internal_col.type_info()->type(),
+                              internal_col.is_nullable(), internal_col.read_default_value(),
+                              internal_col.write_default_value(), attributes);
+  }
+
   return Status::OK();
 }
 
@@ -277,6 +324,15 @@ Status KuduColumnSpec::ToColumnSchemaDelta(ColumnSchemaDelta* col_delta) const {
   if (data_->primary_key) {
     return Status::InvalidArgument("primary key set for column schema delta", data_->name);
   }
+  if (data_->has_time_to_live) {
+    return Status::InvalidArgument("time-to-live set for column schema delta", data_->name);
+  }
+  if (data_->secondary_index) {
+    return Status::InvalidArgument("secondary index set for column schema delta", data_->name);
+  }
+  if (data_->bloom_filter) {
+    return Status::InvalidArgument("bloom filter set for column schema delta", data_->name);
+  }
 
   if (data_->has_rename_to) {
     col_delta->new_name = boost::optional<string>(std::move(data_->rename_to));
@@ -71,6 +71,7 @@ class KUDU_EXPORT KuduColumnStorageAttributes {
     RLE = 4,
     DICT_ENCODING = 5,
     BIT_SHUFFLE = 6,
+    FRAME_OF_REFERENCE = 7,
 
     /// @deprecated GROUP_VARINT is not supported for valid types, and
     /// will fall back to another encoding on the server side.
@@ -84,6 +85,7 @@ class KUDU_EXPORT KuduColumnStorageAttributes {
     SNAPPY = 2,
     LZ4 = 3,
     ZLIB = 4,
+    ZSTD = 5,
   };
 
 
@@ -289,6 +291,46 @@ class KUDU_EXPORT KuduColumnSpec {
   /// @return Pointer to the modified object.
   KuduColumnSpec* BlockSize(int32_t block_size);
 
+  /// Make the column the table's time-to-live column.
+  ///
+  /// A row expires the given number of seconds after the time held in
+  /// this column. Expired rows are no longer returned by scans, and are
+  /// eventually removed from disk.
+  ///
+  /// @note The column must be a non-nullable UNIXTIME_MICROS column, and a
+  ///   table may have at most one time-to-live column. The time-to-live
+  ///   can't be changed after the table is created.
+  ///
+  /// @param [in] seconds
+  ///   The time-to-live of the table's rows, in seconds. Must be positive.
+  /// @return Pointer to the modified object.
+  KuduColumnSpec* TimeToLive(int64_t seconds);
+
+  /// Index the rows of the table by their value of the column.
+  ///
+  /// Each rowset on the tablet servers then stores an index from the
+  /// values of the column to its rows, so that scans with equality,
+  /// IN-list or narrow range predicates on the column read only the rows
+  /// which may match, rather than the whole rowset.
+  ///
+  /// @note The column must not be part of the primary key.
+  ///
+  /// @return Pointer to the modified object.
+  KuduColumnSpec* SecondaryIndex();
+
+  /// Keep a bloom filter of the values of the column.
+  ///
+  /// Each rowset on the tablet servers then stores a bloom filter of the
+  /// values of the column, so that scans with equality or IN-list
+  /// predicates on the column skip the rowsets which hold none of the
+  /// values. This suits lookups by a high-cardinality attribute, such as
+  /// a trace ID, which isn't part of the primary key.
+  ///
+  /// @note The column must not be part of the primary key.
+  ///
+  /// @return Pointer to the modified object.
+  KuduColumnSpec* BloomFilter();
+
   /// @name Operations only relevant for Create Table
   ///
   ///@{
@@ -20,6 +20,7 @@
 #include <memory>
 #include <mutex>
 #include <utility>
+#include <vector>
 
 #include <boost/bind.hpp> // IWYU pragma: keep
 #include <boost/function.hpp>
@@ -36,7 +37,9 @@
 #include "kudu/rpc/messenger.h"
 #include "kudu/util/logging.h"
 
+using std::pair;
 using std::unique_ptr;
+using std::vector;
 
 namespace kudu {
 
@@ -458,6 +461,158 @@ Status KuduSession::Data::ApplyWriteOp(KuduWriteOperation* write_op) {
   return Status::OK();
 }
 
+Status KuduSession::Data::ApplyWriteOps(const vector<KuduWriteOperation*>& write_ops) {
+  const size_t max_size = buffer_bytes_limit_;
+  FlushMode flush_mode;
+  {
+    std::lock_guard<Mutex> l(mutex_);
+    flush_mode = flush_mode_;
+  }
+  // In AUTO_FLUSH_BACKGROUND mode, chunks are limited by the flush watermark
+  // so that background flushing kicks in just like it does for a sequence
+  // of Apply() calls. A chunk always contains at least one operation.
+  const size_t chunk_limit = flush_mode == AUTO_FLUSH_BACKGROUND
+      ? buffer_bytes_limit_ * buffer_watermark_pct_ / 100 : max_size;
+
+  Status first_error;
+  vector<KuduWriteOperation*> chunk;
+  int64_t chunk_size = 0;
+  for (KuduWriteOperation* write_op : write_ops) {
+    Status s;
+    if (PREDICT_FALSE(!write_op)) {
+      s = Status::InvalidArgument("NULL operation");
+    } else if (PREDICT_FALSE(!write_op->row().IsKeySet())) {
+      s = Status::IllegalState("Key not specified", KUDU_REDACT(write_op->ToString()));
+    }
+    const int64_t required_size = s.ok() ? Batcher::GetOperationSizeInBuffer(write_op) : 0;
+    if (s.ok() && PREDICT_FALSE(required_size > max_size)) {
+      s = Status::Incomplete(strings::Substitute(
+          "buffer size limit is too small to fit operation: "
+          "required $0, size limit $1",
+          required_size, max_size));
+    }
+    if (PREDICT_FALSE(!s.ok())) {
+      if (write_op) {
+        error_collector_->AddError(unique_ptr<KuduError>(new KuduError(write_op, s)));
+      }
+      if (first_error.ok()) {
+        first_error = std::move(s);
+      }
+      continue;
+    }
+
+    if (!chunk.empty() && chunk_size + required_size > chunk_limit) {
+      Status chunk_status = ApplyWriteOpsChunk(chunk, chunk_size, flush_mode);
+      if (PREDICT_FALSE(!chunk_status.ok()) && first_error.ok()) {
+        first_error = std::move(chunk_status);
+      }
+      chunk.clear();
+      chunk_size = 0;
+    }
+    chunk.push_back(write_op);
+    chunk_size += required_size;
+  }
+  if (!chunk.empty()) {
+    Status chunk_status = ApplyWriteOpsChunk(chunk, chunk_size, flush_mode);
+    if (PREDICT_FALSE(!chunk_status.ok()) && first_error.ok()) {
+      first_error = std::move(chunk_status);
+    }
+  }
+  return first_error;
+}
+
+Status KuduSession::Data::ApplyWriteOpsChunk(const vector<KuduWriteOperation*>& write_ops,
+                                              int64_t chunk_size,
+                                              FlushMode flush_mode) {
+  const size_t max_size = buffer_bytes_limit_;
+  if (flush_mode == AUTO_FLUSH_BACKGROUND && PREDICT_TRUE(buffer_pre_flush_enabled_)) {
+    // See the comment in ApplyWriteOp() on the extra flush.
+    FlushCurrentBatcher(max_size - chunk_size + 1, nullptr);
+  }
+
+  Status first_error;
+  vector<pair<KuduWriteOperation*, Status>> failed_ops;
+  {
+    std::lock_guard<Mutex> l(mutex_);
+    size_t num_to_add = write_ops.size();
+    if (flush_mode == AUTO_FLUSH_BACKGROUND) {
+      // Block until there is enough buffer space for the whole chunk, just as
+      // Apply() blocks for a single operation.
+      while (buffer_bytes_used_ + chunk_size > max_size) {
+        condition_.Wait();
+      }
+    } else if (PREDICT_FALSE(buffer_bytes_used_ + chunk_size > max_size)) {
+      // Add as many operations as fit into the buffer, failing the rest
+      // just like a sequence of Apply() calls would.
+      int64_t fit_size = 0;
+      for (num_to_add = 0; num_to_add < write_ops.size(); num_to_add++) {
+        const int64_t required_size =
+            Batcher::GetOperationSizeInBuffer(write_ops[num_to_add]);
+        if (buffer_bytes_used_ + fit_size + required_size > max_size) {
+          break;
+        }
+        fit_size += required_size;
+      }
+      for (size_t i = num_to_add; i < write_ops.size(); i++) {
+        const int64_t required_size = Batcher::GetOperationSizeInBuffer(write_ops[i]);
+        Status s = Status::Incomplete(strings::Substitute(
+            "not enough mutation buffer space remaining for operation: "
+            "required additional $0 when $1 of $2 already used",
+            required_size, buffer_bytes_used_ + fit_size, max_size));
+        error_collector_->AddError(unique_ptr<KuduError>(new KuduError(write_ops[i], s)));
+        if (first_error.ok()) {
+          first_error = std::move(s);
+        }
+      }
+      chunk_size = fit_size;
+      if (num_to_add == 0) {
+        return first_error;
+      }
+    }
+
+    if (!batcher_) {
+      while (batchers_num_limit_ != 0 &&
+             batchers_num_ >= batchers_num_limit_) {
+        condition_.Wait();
+      }
+      DCHECK(!batcher_);
+      scoped_refptr<Batcher> batcher(
+          new Batcher(client_.get(), error_collector_, session_,
+                      external_consistency_mode_));
+      if (timeout_.Initialized()) {
+        batcher->SetTimeout(timeout_);
+      }
+      batcher.swap(batcher_);
+      ++batchers_num_;
+    }
+    if (num_to_add == write_ops.size()) {
+      batcher_->AddBatch(write_ops, &failed_ops);
+    } else {
+      const vector<KuduWriteOperation*> to_add(write_ops.begin(),
+                                               write_ops.begin() + num_to_add);
+      batcher_->AddBatch(to_add, &failed_ops);
+    }
+    for (auto& e : failed_ops) {
+      chunk_size -= Batcher::GetOperationSizeInBuffer(e.first);
+    }
+    buffer_bytes_used_ += chunk_size;
+  }
+
+  for (auto& e : failed_ops) {
+    error_collector_->AddError(unique_ptr<KuduError>(new KuduError(e.first, e.second)));
+    if (first_error.ok()) {
+      first_error = std::move(e.second);
+    }
+  }
+
+  if (flush_mode == AUTO_FLUSH_BACKGROUND) {
+    const size_t flush_watermark =
+        buffer_bytes_limit_ * buffer_watermark_pct_ / 100;
+    FlushCurrentBatcher(flush_watermark, nullptr);
+  }
+  return first_error;
+}
+
 void KuduSession::Data::TimeBasedFlushInit() {
   KuduSession::Data::TimeBasedFlushTask(
       Status::OK(), messenger_, session_, true);
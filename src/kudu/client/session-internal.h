@@ -20,6 +20,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <memory>
+#include <vector>
 
 #include <gtest/gtest_prod.h>
 
@@ -133,6 +134,18 @@ class KuduSession::Data {
   // Apply a write operation, i.e. push it through the batcher chain.
   Status ApplyWriteOp(KuduWriteOperation* write_op);
 
+  // Apply a batch of write operations. Operations are pushed into the current
+  // batcher in chunks, each chunk resolving its tablets in one pass. Returns
+  // the first error encountered; the failed operations are reported
+  // to the error collector and the rest of the batch is still applied.
+  Status ApplyWriteOps(const std::vector<KuduWriteOperation*>& write_ops);
+
+  // Push a chunk of already validated write operations of 'chunk_size' bytes
+  // in total into the current batcher. Used by ApplyWriteOps().
+  Status ApplyWriteOpsChunk(const std::vector<KuduWriteOperation*>& write_ops,
+                            int64_t chunk_size,
+                            FlushMode flush_mode);
+
   // Check and start the time-based flush task in background, if necessary.
   void TimeBasedFlushInit();
 
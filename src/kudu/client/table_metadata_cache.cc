@@ -0,0 +1,110 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/client/table_metadata_cache.h"
+
+#include <mutex>
+#include <utility>
+
+#include "kudu/gutil/map-util.h"
+
+using std::shared_ptr;
+using std::string;
+
+namespace kudu {
+namespace client {
+namespace internal {
+
+TableMetadataCache::TableMetadataCache(MonoDelta ttl)
+    : ttl_(ttl) {
+}
+
+shared_ptr<const TableMetadataCache::Entry> TableMetadataCache::Lookup(const string& table_name,
+                                                                       bool* refresh) {
+  *refresh = false;
+  MonoTime now = MonoTime::Now();
+  std::lock_guard<simple_spinlock> l(lock_);
+  CachedEntry* cached = FindOrNull(entries_by_name_, table_name);
+  if (!cached) {
+    return nullptr;
+  }
+  MonoDelta age = now - cached->entry->fetch_time;
+  if (age >= ttl_) {
+    EraseUnlocked(table_name);
+    return nullptr;
+  }
+  if (!cached->refreshing && age.ToNanoseconds() >= ttl_.ToNanoseconds() / 2) {
+    cached->refreshing = true;
+    *refresh = true;
+  }
+  return cached->entry;
+}
+
+void TableMetadataCache::Put(shared_ptr<const Entry> entry) {
+  std::lock_guard<simple_spinlock> l(lock_);
+  CachedEntry* cached = FindOrNull(entries_by_name_, entry->table_name);
+  if (cached && cached->entry->table_id == entry->table_id &&
+      cached->entry->schema_version > entry->schema_version) {
+    cached->refreshing = false;
+    return;
+  }
+  // The name may now belong to another table, and the table may have had
+  // another name.
+  EraseUnlocked(entry->table_name);
+  const string* old_name = FindOrNull(names_by_id_, entry->table_id);
+  if (old_name) {
+    EraseUnlocked(string(*old_name));
+  }
+  names_by_id_[entry->table_id] = entry->table_name;
+  string table_name = entry->table_name;
+  entries_by_name_[table_name] = { std::move(entry), false };
+}
+
+void TableMetadataCache::RefreshFailed(const string& table_name) {
+  std::lock_guard<simple_spinlock> l(lock_);
+  CachedEntry* cached = FindOrNull(entries_by_name_, table_name);
+  if (cached) {
+    cached->refreshing = false;
+  }
+}
+
+void TableMetadataCache::InvalidateTableId(const string& table_id) {
+  std::lock_guard<simple_spinlock> l(lock_);
+  const string* table_name = FindOrNull(names_by_id_, table_id);
+  if (table_name) {
+    // Copied, since erasing the entry erases the name.
+    EraseUnlocked(string(*table_name));
+  }
+}
+
+void TableMetadataCache::InvalidateTableName(const string& table_name) {
+  std::lock_guard<simple_spinlock> l(lock_);
+  EraseUnlocked(table_name);
+}
+
+void TableMetadataCache::EraseUnlocked(const string& table_name) {
+  auto it = entries_by_name_.find(table_name);
+  if (it == entries_by_name_.end()) {
+    return;
+  }
+  names_by_id_.erase(it->second.entry->table_id);
+  entries_by_name_.erase(it);
+}
+
+} // namespace internal
+} // namespace client
+} // namespace kudu
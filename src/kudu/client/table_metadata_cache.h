@@ -0,0 +1,104 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "kudu/common/partition.h"
+#include "kudu/common/schema.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/monotime.h"
+
+namespace kudu {
+namespace client {
+namespace internal {
+
+// Caches the metadata of the tables a client opens, so that opening a table
+// again needn't ask the master for it. Entries are looked up by table name,
+// which is how tables are opened, and are identified by the table's ID and
+// schema version, which is how tablet servers know them.
+//
+// An entry is served until 'ttl' after it was fetched. Looking up an entry
+// older than half of that asks the caller to refresh it in the background, so
+// that the tables a client keeps opening are seldom fetched synchronously.
+// Entries are dropped when a tablet server reports the client's schema of
+// their table to be mismatched, and when the client alters or deletes their
+// table itself.
+//
+// This class is thread-safe.
+class TableMetadataCache {
+ public:
+  // The metadata of a table as of one of its schema versions.
+  struct Entry {
+    std::string table_id;
+    std::string table_name;
+    uint32_t schema_version;
+    Schema schema;
+    PartitionSchema partition_schema;
+    int num_replicas;
+    MonoTime fetch_time;
+  };
+
+  explicit TableMetadataCache(MonoDelta ttl);
+
+  // Returns the metadata of table 'table_name', or nullptr if it's not cached
+  // or has expired. Sets 'refresh' to whether the caller is to refresh the
+  // returned entry; a single caller at a time is asked to, until it calls
+  // Put() or RefreshFailed().
+  std::shared_ptr<const Entry> Lookup(const std::string& table_name, bool* refresh);
+
+  // Caches 'entry', unless a newer schema version of the same table is cached
+  // already.
+  void Put(std::shared_ptr<const Entry> entry);
+
+  // Lets later lookups of 'table_name' ask for a refresh again after the one
+  // asked for by Lookup() failed.
+  void RefreshFailed(const std::string& table_name);
+
+  // Drops the metadata of the table with ID 'table_id'.
+  void InvalidateTableId(const std::string& table_id);
+
+  // Drops the metadata of the table named 'table_name'.
+  void InvalidateTableName(const std::string& table_name);
+
+ private:
+  struct CachedEntry {
+    std::shared_ptr<const Entry> entry;
+    bool refreshing;
+  };
+
+  void EraseUnlocked(const std::string& table_name);
+
+  const MonoDelta ttl_;
+
+  simple_spinlock lock_;
+
+  // The cached entries by table name, and the names of the tables by ID.
+  // Protected by 'lock_'.
+  std::unordered_map<std::string, CachedEntry> entries_by_name_;
+  std::unordered_map<std::string, std::string> names_by_id_;
+
+  DISALLOW_COPY_AND_ASSIGN(TableMetadataCache);
+};
+
+} // namespace internal
+} // namespace client
+} // namespace kudu
@@ -0,0 +1,139 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/client/write_flow_control.h"
+
+#include <algorithm>
+#include <mutex>
+#include <utility>
+
+#include <glog/logging.h>
+
+#include "kudu/gutil/map-util.h"
+
+using std::deque;
+using std::function;
+using std::string;
+
+namespace kudu {
+namespace client {
+namespace internal {
+
+const int WriteFlowControl::kMinWindow = 1;
+const int WriteFlowControl::kMaxWindow = 16;
+const int64_t WriteFlowControl::kMinBatchBytes = 64 * 1024;
+const int64_t WriteFlowControl::kMaxBatchBytes = 8 * 1024 * 1024;
+const int64_t WriteFlowControl::kOverloadedQueueTimeMs = 100;
+const int64_t WriteFlowControl::kDecreaseIntervalMs = 100;
+
+WriteFlowControl::TabletState::TabletState()
+    : window(kMaxWindow),
+      batch_bytes(kMaxBatchBytes),
+      in_flight(0) {
+}
+
+bool WriteFlowControl::TabletState::IsInitial() const {
+  return in_flight == 0 && queued.empty() &&
+      window >= kMaxWindow && batch_bytes >= kMaxBatchBytes;
+}
+
+void WriteFlowControl::PopSendable(TabletState* state, deque<function<void()>>* to_send) {
+  while (!state->queued.empty() && state->in_flight < static_cast<int>(state->window)) {
+    to_send->emplace_back(std::move(state->queued.front()));
+    state->queued.pop_front();
+    state->in_flight++;
+  }
+}
+
+void WriteFlowControl::Send(const string& tablet_id, function<void()> send) {
+  deque<function<void()>> to_send;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    TabletState* state = &tablets_[tablet_id];
+    state->queued.emplace_back(std::move(send));
+    PopSendable(state, &to_send);
+  }
+  // Send outside of the lock: the RPC may complete, and release its slot,
+  // before the call returns.
+  for (const auto& f : to_send) {
+    f();
+  }
+}
+
+void WriteFlowControl::Release(const string& tablet_id) {
+  deque<function<void()>> to_send;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    TabletState* state = FindOrNull(tablets_, tablet_id);
+    CHECK(state) << "no write RPC in flight to tablet " << tablet_id;
+    DCHECK_GT(state->in_flight, 0);
+    state->in_flight--;
+    PopSendable(state, &to_send);
+    if (state->IsInitial()) {
+      tablets_.erase(tablet_id);
+    }
+  }
+  for (const auto& f : to_send) {
+    f();
+  }
+}
+
+void WriteFlowControl::RecordResponse(const string& tablet_id, bool overloaded) {
+  std::lock_guard<simple_spinlock> l(lock_);
+  if (overloaded) {
+    TabletState* state = &tablets_[tablet_id];
+    const MonoTime now = MonoTime::Now();
+    if (state->last_decrease.Initialized() &&
+        now - state->last_decrease < MonoDelta::FromMilliseconds(kDecreaseIntervalMs)) {
+      return;
+    }
+    state->last_decrease = now;
+    state->window = std::max<double>(kMinWindow, state->window / 2);
+    state->batch_bytes = std::max(kMinBatchBytes, state->batch_bytes / 2);
+    VLOG(1) << "Tablet " << tablet_id << " is overloaded: limiting writes to "
+            << static_cast<int>(state->window) << " RPCs in flight of up to "
+            << state->batch_bytes << " bytes";
+    return;
+  }
+
+  TabletState* state = FindOrNull(tablets_, tablet_id);
+  if (!state) {
+    // The tablet already has the largest limits.
+    return;
+  }
+  state->window = std::min<double>(kMaxWindow, state->window + 1 / state->window);
+  state->batch_bytes = std::min(kMaxBatchBytes, state->batch_bytes + state->batch_bytes / 8);
+  if (state->IsInitial()) {
+    tablets_.erase(tablet_id);
+  }
+}
+
+int64_t WriteFlowControl::max_batch_bytes(const string& tablet_id) const {
+  std::lock_guard<simple_spinlock> l(lock_);
+  const TabletState* state = FindOrNull(tablets_, tablet_id);
+  return state ? state->batch_bytes : kMaxBatchBytes;
+}
+
+int WriteFlowControl::window(const string& tablet_id) const {
+  std::lock_guard<simple_spinlock> l(lock_);
+  const TabletState* state = FindOrNull(tablets_, tablet_id);
+  return state ? static_cast<int>(state->window) : kMaxWindow;
+}
+
+} // namespace internal
+} // namespace client
+} // namespace kudu
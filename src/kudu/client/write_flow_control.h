@@ -0,0 +1,119 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/monotime.h"
+
+namespace kudu {
+namespace client {
+namespace internal {
+
+// Adapts the rate of a client's writes to each tablet to the load of the
+// tablet servers, so that writes to a hot tablet server slow down instead of
+// piling up and being retried over and over.
+//
+// Each tablet has a window of write RPCs allowed in flight at once, and a
+// maximum size for the batches of operations sent in a single RPC. Both shrink
+// by half whenever a tablet server reports being overloaded, at most once per
+// kDecreaseInterval so that the responses to the RPCs which were already in
+// flight don't shrink them again, and grow back gradually with every response
+// from a tablet server which isn't.
+//
+// This class is thread-safe.
+class WriteFlowControl {
+ public:
+  // The bounds of the window of write RPCs in flight to a tablet. Tablets
+  // start with the largest window.
+  static const int kMinWindow;
+  static const int kMaxWindow;
+
+  // The bounds of the size of a batch of write operations sent to a tablet in
+  // a single RPC. Tablets start with the largest size, which is larger than
+  // the default mutation buffer of a session.
+  static const int64_t kMinBatchBytes;
+  static const int64_t kMaxBatchBytes;
+
+  // A tablet server which made a write wait this long in its service queue is
+  // considered overloaded.
+  static const int64_t kOverloadedQueueTimeMs;
+
+  // The minimum time between two decreases of the limits of a tablet.
+  static const int64_t kDecreaseIntervalMs;
+
+  WriteFlowControl() = default;
+
+  // Calls 'send' to send a write RPC to tablet 'tablet_id' right away if there
+  // are fewer RPCs in flight to it than its window allows. Otherwise, queues
+  // 'send' to be called once an RPC to the tablet completes.
+  //
+  // Every RPC sent must eventually be released with Release().
+  void Send(const std::string& tablet_id, std::function<void()> send);
+
+  // Releases the slot in the window of tablet 'tablet_id' of a completed RPC,
+  // sending queued RPCs which now fit in the window.
+  void Release(const std::string& tablet_id);
+
+  // Adapts the limits of tablet 'tablet_id' to a response of its tablet
+  // server, depending on whether the server was 'overloaded'.
+  void RecordResponse(const std::string& tablet_id, bool overloaded);
+
+  // Returns the maximum size of a batch of operations to send to tablet
+  // 'tablet_id' in a single RPC.
+  int64_t max_batch_bytes(const std::string& tablet_id) const;
+
+  // Returns the window of RPCs in flight of tablet 'tablet_id'.
+  int window(const std::string& tablet_id) const;
+
+ private:
+  struct TabletState {
+    TabletState();
+
+    // Whether the state is the initial one, so that it needn't be kept.
+    bool IsInitial() const;
+
+    // Fractional, to grow by about one RPC per window's worth of responses.
+    double window;
+    int64_t batch_bytes;
+    int in_flight;
+    MonoTime last_decrease;
+    std::deque<std::function<void()>> queued;
+  };
+
+  // Pops the queued RPCs of 'state' which fit in its window into 'to_send',
+  // counting them as in flight.
+  static void PopSendable(TabletState* state, std::deque<std::function<void()>>* to_send);
+
+  mutable simple_spinlock lock_;
+
+  // The state of each tablet whose limits aren't the initial ones, or with
+  // RPCs in flight. Protected by 'lock_'.
+  std::unordered_map<std::string, TabletState> tablets_;
+
+  DISALLOW_COPY_AND_ASSIGN(WriteFlowControl);
+};
+
+} // namespace internal
+} // namespace client
+} // namespace kudu
@@ -17,7 +17,10 @@
 
 #include "kudu/client/write_op.h"
 
+#include <cstring>
 #include <ostream>
+#include <utility>
+#include <vector>
 
 #include <glog/logging.h>
 
@@ -30,6 +33,8 @@
 #include "kudu/common/types.h"
 #include "kudu/common/wire_protocol.pb.h"
 #include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/port.h"
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/bitmap.h"
 #include "kudu/util/slice.h"
 
@@ -37,6 +42,7 @@ namespace kudu {
 namespace client {
 
 using sp::shared_ptr;
+using strings::Substitute;
 
 RowOperationsPB_Type ToInternalWriteType(KuduWriteOperation::Type type) {
   switch (type) {
@@ -129,6 +135,114 @@ KuduUpsert::KuduUpsert(const shared_ptr<KuduTable>& table)
 
 KuduUpsert::~KuduUpsert() {}
 
+// ColumnarInsertBuilder --------------------------------------------------------
+
+class KuduColumnarInsertBuilder::Data {
+ public:
+  struct ColumnValues {
+    const uint8_t* values = nullptr;
+    const uint8_t* non_null_bitmap = nullptr;
+  };
+
+  Data(shared_ptr<KuduTable> table, size_t num_rows)
+      : table_(std::move(table)),
+        schema_(table_->schema().schema_),
+        num_rows_(num_rows),
+        columns_(schema_->num_columns()) {
+  }
+
+  const shared_ptr<KuduTable> table_;
+  const Schema* const schema_;
+  const size_t num_rows_;
+
+  // The values provided for each column of the schema. A column is unset
+  // if its 'values' is NULL.
+  std::vector<ColumnValues> columns_;
+};
+
+KuduColumnarInsertBuilder::KuduColumnarInsertBuilder(const shared_ptr<KuduTable>& table,
+                                                     size_t num_rows)
+  : data_(new Data(table, num_rows)) {
+}
+
+KuduColumnarInsertBuilder::~KuduColumnarInsertBuilder() {
+  delete data_;
+}
+
+Status KuduColumnarInsertBuilder::SetColumn(const Slice& col_name,
+                                            const void* values,
+                                            const uint8_t* non_null_bitmap) {
+  int col_idx = data_->schema_->find_column(
+      StringPiece(reinterpret_cast<const char*>(col_name.data()), col_name.size()));
+  if (PREDICT_FALSE(col_idx == Schema::kColumnNotFound)) {
+    return Status::NotFound("No such column", col_name);
+  }
+  return SetColumn(col_idx, values, non_null_bitmap);
+}
+
+Status KuduColumnarInsertBuilder::SetColumn(int col_idx,
+                                            const void* values,
+                                            const uint8_t* non_null_bitmap) {
+  if (PREDICT_FALSE(col_idx < 0 || col_idx >= data_->schema_->num_columns())) {
+    return Status::InvalidArgument(Substitute("invalid column index $0", col_idx));
+  }
+  if (PREDICT_FALSE(!values)) {
+    return Status::InvalidArgument("NULL values array");
+  }
+  const ColumnSchema& col = data_->schema_->column(col_idx);
+  if (non_null_bitmap && !col.is_nullable() &&
+      PREDICT_FALSE(!BitMapIsAllSet(non_null_bitmap, 0, data_->num_rows_))) {
+    return Status::InvalidArgument("column not nullable", col.ToString());
+  }
+  Data::ColumnValues& dst = data_->columns_[col_idx];
+  dst.values = reinterpret_cast<const uint8_t*>(values);
+  dst.non_null_bitmap = col.is_nullable() ? non_null_bitmap : nullptr;
+  return Status::OK();
+}
+
+Status KuduColumnarInsertBuilder::Build(std::vector<KuduWriteOperation*>* ops) {
+  const Schema* schema = data_->schema_;
+  for (int i = 0; i < schema->num_key_columns(); i++) {
+    if (PREDICT_FALSE(!data_->columns_[i].values)) {
+      return Status::IllegalState("Key not specified", schema->column(i).ToString());
+    }
+  }
+
+  std::vector<gscoped_ptr<KuduInsert>> inserts(data_->num_rows_);
+  for (auto& insert : inserts) {
+    insert.reset(data_->table_->NewInsert());
+  }
+
+  // Fill the rows column by column, so the per-column work (type lookup,
+  // offsets, nullability) is done once for the whole batch.
+  for (int col_idx = 0; col_idx < schema->num_columns(); col_idx++) {
+    const Data::ColumnValues& src = data_->columns_[col_idx];
+    if (!src.values) {
+      continue;
+    }
+    const ColumnSchema& col = schema->column(col_idx);
+    const size_t cell_size = col.type_info()->size();
+    const size_t cell_offset = schema->column_offset(col_idx);
+    const bool nullable = col.is_nullable();
+    for (size_t row_idx = 0; row_idx < data_->num_rows_; row_idx++) {
+      KuduPartialRow* row = inserts[row_idx]->mutable_row();
+      BitmapSet(row->isset_bitmap_, col_idx);
+      const bool is_null = src.non_null_bitmap && !BitmapTest(src.non_null_bitmap, row_idx);
+      if (nullable) {
+        ContiguousRow(schema, row->row_data_).set_null(col_idx, is_null);
+      }
+      if (!is_null) {
+        memcpy(row->row_data_ + cell_offset, src.values + row_idx * cell_size, cell_size);
+      }
+    }
+  }
+
+  ops->reserve(ops->size() + inserts.size());
+  for (auto& insert : inserts) {
+    ops->push_back(insert.release());
+  }
+  return Status::OK();
+}
 
 } // namespace client
 } // namespace kudu
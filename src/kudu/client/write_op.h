@@ -20,6 +20,7 @@
 #include <stdint.h>
 
 #include <string>
+#include <vector>
 
 #include "kudu/client/shared_ptr.h" // IWYU pragma: keep
 #include "kudu/common/partial_row.h"
@@ -239,6 +240,85 @@ class KUDU_EXPORT KuduDelete : public KuduWriteOperation {
   explicit KuduDelete(const sp::shared_ptr<KuduTable>& table);
 };
 
+/// @brief A builder of INSERT operations for a batch of rows provided
+///   in columnar form.
+///
+/// Instead of setting every cell through the KuduPartialRow API, the values
+/// of each column are provided as a single array, along with an optional
+/// bitmap of non-null values. Column types are checked once per column,
+/// and the cells are copied straight into the rows' storage.
+///
+/// Typical usage example:
+/// @code
+///   KuduColumnarInsertBuilder builder(table, num_rows);
+///   KUDU_CHECK_OK(builder.SetColumn("key", keys));
+///   KUDU_CHECK_OK(builder.SetColumn("val", val_slices, val_non_null));
+///   std::vector<KuduWriteOperation*> ops;
+///   KUDU_CHECK_OK(builder.Build(&ops));
+///   KUDU_CHECK_OK(session->ApplyBatch(ops));
+/// @endcode
+class KUDU_EXPORT KuduColumnarInsertBuilder {
+ public:
+  /// Create a builder for the specified number of rows.
+  ///
+  /// @param [in] table
+  ///   The table to insert the rows into.
+  /// @param [in] num_rows
+  ///   Number of rows in the batch.
+  KuduColumnarInsertBuilder(const sp::shared_ptr<KuduTable>& table,
+                            size_t num_rows);
+
+  ~KuduColumnarInsertBuilder();
+
+  /// Set the values of a column for all the rows of the batch.
+  ///
+  /// The values are neither copied nor interpreted until Build() is called,
+  /// so the arrays must stay valid until then. The data referenced by
+  /// STRING and BINARY values is not copied at all: it must remain valid
+  /// for the lifetime of the built operations, as with
+  /// KuduPartialRow::SetStringNoCopy().
+  ///
+  /// @param [in] col_name
+  ///   Name of the target column.
+  /// @param [in] values
+  ///   Array of values, one per row, in the in-memory representation
+  ///   of the column's type: e.g. @c int32_t for INT32, @c int64_t for
+  ///   UNIXTIME_MICROS, @c bool for BOOL, and Slice for STRING and BINARY.
+  ///   The entries for null rows are ignored.
+  /// @param [in] non_null_bitmap
+  ///   Bitmap with a bit per row (least significant bit first) which is set
+  ///   for the rows with a non-null value. If NULL, all the values are
+  ///   non-null. Only nullable columns may contain nulls.
+  /// @return Operation result status.
+  Status SetColumn(const Slice& col_name, const void* values,
+                   const uint8_t* non_null_bitmap = NULL) WARN_UNUSED_RESULT;
+
+  /// @copydoc SetColumn(const Slice&, const void*, const uint8_t*)
+  ///
+  /// @param [in] col_idx
+  ///   Index of the target column.
+  Status SetColumn(int col_idx, const void* values,
+                   const uint8_t* non_null_bitmap = NULL) WARN_UNUSED_RESULT;
+
+  /// Build the INSERT operations for the batch.
+  ///
+  /// All the key columns must have been set. The columns which were not set
+  /// take their server-side default, as when unset in a KuduPartialRow.
+  ///
+  /// @param [out] ops
+  ///   The operations are appended to this vector. The caller takes
+  ///   ownership of them, typically by passing them to
+  ///   KuduSession::ApplyBatch().
+  /// @return Operation result status.
+  Status Build(std::vector<KuduWriteOperation*>* ops) WARN_UNUSED_RESULT;
+
+ private:
+  class KUDU_NO_EXPORT Data;
+  Data* data_;
+
+  DISALLOW_COPY_AND_ASSIGN(KuduColumnarInsertBuilder);
+};
+
 } // namespace client
 } // namespace kudu
 
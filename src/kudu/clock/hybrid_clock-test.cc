@@ -44,6 +44,7 @@
 
 
 DECLARE_bool(inject_unsync_time_errors);
+DECLARE_int32(ntp_max_error_cache_ms);
 DECLARE_string(time_source);
 
 using std::string;
@@ -351,6 +352,28 @@ TEST_F(HybridClockTest, TestRideOverNtpInterruption) {
 }
 
 #ifndef __APPLE__
+// Reads of the time reusing a cached error bound should report an error bound
+// at least as wide as the one read from the kernel along with the time.
+TEST_F(HybridClockTest, TestCachedNtpErrorBound) {
+  TimeService* ntp = clock_->time_service();
+  uint64_t cached_now_usec, cached_error_usec;
+  uint64_t now_usec, error_usec;
+  // Warm up the cache, then read through it.
+  ASSERT_OK(ntp->WalltimeWithError(&cached_now_usec, &cached_error_usec));
+  ASSERT_OK(ntp->WalltimeWithError(&cached_now_usec, &cached_error_usec));
+
+  FLAGS_ntp_max_error_cache_ms = 0;
+  ASSERT_OK(ntp->WalltimeWithError(&now_usec, &error_usec));
+  ASSERT_GE(cached_error_usec, error_usec);
+  ASSERT_GE(now_usec, cached_now_usec);
+  ASSERT_LT(now_usec - cached_now_usec, MonoTime::kMicrosecondsPerSecond);
+
+  // Unsynchronized clocks should be noticed regardless of the cache.
+  FLAGS_ntp_max_error_cache_ms = 1000;
+  FLAGS_inject_unsync_time_errors = true;
+  ASSERT_TRUE(ntp->WalltimeWithError(&now_usec, &error_usec).IsServiceUnavailable());
+}
+
 TEST_F(HybridClockTest, TestNtpDiagnostics) {
   vector<string> log;
   clock_->time_service()->DumpDiagnostics(&log);
@@ -137,7 +137,6 @@ Timestamp HybridClock::Now() {
   Timestamp now;
   uint64_t error;
 
-  std::lock_guard<simple_spinlock> lock(lock_);
   NowWithError(&now, &error);
   return now;
 }
@@ -146,10 +145,7 @@ Timestamp HybridClock::NowLatest() {
   Timestamp now;
   uint64_t error;
 
-  {
-    std::lock_guard<simple_spinlock> lock(lock_);
-    NowWithError(&now, &error);
-  }
+  NowWithError(&now, &error);
 
   uint64_t now_latest = GetPhysicalValueMicros(now) + error;
   uint64_t now_logical = GetLogicalValue(now);
@@ -176,16 +172,19 @@ void HybridClock::NowWithError(Timestamp* timestamp, uint64_t* max_error_usec) {
   // If the physical time from the system clock is higher than our last-returned
   // time, we should use the physical timestamp.
   uint64_t candidate_phys_timestamp = now_usec << kBitsToShift;
-  if (PREDICT_TRUE(candidate_phys_timestamp > next_timestamp_)) {
-    next_timestamp_ = candidate_phys_timestamp;
-    *timestamp = Timestamp(next_timestamp_++);
-    *max_error_usec = error_usec;
-    if (PREDICT_FALSE(VLOG_IS_ON(2))) {
-      VLOG(2) << "Current clock is higher than the last one. Resetting logical values."
-          << " Physical Value: " << now_usec << " usec Logical Value: 0  Error: "
-          << error_usec;
+  uint64_t next = next_timestamp_.load(std::memory_order_relaxed);
+  while (PREDICT_TRUE(candidate_phys_timestamp > next)) {
+    if (next_timestamp_.compare_exchange_weak(next, candidate_phys_timestamp + 1)) {
+      *timestamp = Timestamp(candidate_phys_timestamp);
+      *max_error_usec = error_usec;
+      if (PREDICT_FALSE(VLOG_IS_ON(2))) {
+        VLOG(2) << "Current clock is higher than the last one. Resetting logical values."
+            << " Physical Value: " << now_usec << " usec Logical Value: 0  Error: "
+            << error_usec;
+      }
+      return;
     }
-    return;
+    // Another thread moved the clock forward: 'next' now holds its value.
   }
 
   // We don't have the last time read max error since it might have originated
@@ -205,9 +204,9 @@ void HybridClock::NowWithError(Timestamp* timestamp, uint64_t* max_error_usec) {
   // always return: last - (now - e) as the new maximum error.
   // This broadens the error interval for both cases but always returns
   // a correct error interval.
-
-  *max_error_usec = (next_timestamp_ >> kBitsToShift) - (now_usec - error_usec);
-  *timestamp = Timestamp(next_timestamp_++);
+  next = next_timestamp_.fetch_add(1);
+  *max_error_usec = (next >> kBitsToShift) - (now_usec - error_usec);
+  *timestamp = Timestamp(next);
   if (PREDICT_FALSE(VLOG_IS_ON(2))) {
     VLOG(2) << "Current clock is lower than the last one. Returning last read and incrementing"
         " logical values. Clock: " + Stringify(*timestamp) << " Error: " << *max_error_usec;
@@ -215,7 +214,6 @@ void HybridClock::NowWithError(Timestamp* timestamp, uint64_t* max_error_usec) {
 }
 
 Status HybridClock::Update(const Timestamp& to_update) {
-  std::lock_guard<simple_spinlock> lock(lock_);
   Timestamp now;
   uint64_t error_ignored;
   NowWithError(&now, &error_ignored);
@@ -237,8 +235,12 @@ Status HybridClock::Update(const Timestamp& to_update) {
   }
 
   // Our next timestamp must be higher than the one that we are updating
-  // from.
-  next_timestamp_ = to_update.value() + 1;
+  // from. Other threads may have moved the clock further in the meantime, in
+  // which case there's nothing left to do.
+  uint64_t next = next_timestamp_.load(std::memory_order_relaxed);
+  while (next <= to_update.value() &&
+         !next_timestamp_.compare_exchange_weak(next, to_update.value() + 1)) {
+  }
   return Status::OK();
 }
 
@@ -259,10 +261,7 @@ Status HybridClock::WaitUntilAfter(const Timestamp& then,
   TRACE_EVENT0("clock", "HybridClock::WaitUntilAfter");
   Timestamp now;
   uint64_t error;
-  {
-    std::lock_guard<simple_spinlock> lock(lock_);
-    NowWithError(&now, &error);
-  }
+  NowWithError(&now, &error);
 
   // "unshift" the timestamps so that we can measure actual time
   uint64_t now_usec = GetPhysicalValueMicros(now);
@@ -303,10 +302,7 @@ Status HybridClock::WaitUntilAfterLocally(const Timestamp& then,
   while (true) {
     Timestamp now;
     uint64_t error;
-    {
-      std::lock_guard<simple_spinlock> lock(lock_);
-      NowWithError(&now, &error);
-    }
+    NowWithError(&now, &error);
     if (now > then) {
       return Status::OK();
     }
@@ -324,11 +320,7 @@ bool HybridClock::IsAfter(Timestamp t) {
   uint64_t error_usec;
   WalltimeWithErrorOrDie(&now_usec, &error_usec);
 
-  Timestamp now;
-  {
-    std::lock_guard<simple_spinlock> lock(lock_);
-    now = Timestamp(std::max(next_timestamp_, now_usec << kBitsToShift));
-  }
+  Timestamp now(std::max(next_timestamp_.load(), now_usec << kBitsToShift));
   return t.value() < now.value();
 }
 
@@ -370,9 +362,12 @@ Status HybridClock::WalltimeWithError(uint64_t* now_usec, uint64_t* error_usec)
     MonoTime read_time_max_likelihood = read_time_before +
         MonoDelta::FromMicroseconds(read_time_error_us);
 
-    std::unique_lock<simple_spinlock> l(last_clock_read_lock_);
-    if (!last_clock_read_time_.Initialized() ||
-        last_clock_read_time_ < read_time_max_likelihood) {
+    // If another thread is recording its own read concurrently, that one is
+    // as good a starting point for extrapolation as ours, so don't wait for it.
+    std::unique_lock<simple_spinlock> l(last_clock_read_lock_, std::try_to_lock);
+    if (l.owns_lock() &&
+        (!last_clock_read_time_.Initialized() ||
+         last_clock_read_time_ < read_time_max_likelihood)) {
       last_clock_read_time_ = read_time_max_likelihood;
       last_clock_read_physical_ = *now_usec;
       last_clock_read_error_ = *error_usec + read_time_error_us;
@@ -419,7 +414,6 @@ uint64_t HybridClock::ErrorForMetrics() {
   Timestamp now;
   uint64_t error;
 
-  std::lock_guard<simple_spinlock> lock(lock_);
   NowWithError(&now, &error);
   return error;
 }
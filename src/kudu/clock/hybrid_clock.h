@@ -16,6 +16,7 @@
 // under the License.
 #pragma once
 
+#include <atomic>
 #include <cstdint>
 #include <memory>
 #include <string>
@@ -179,11 +180,12 @@ class HybridClock : public Clock {
   // service.
   std::unique_ptr<clock::TimeService> time_service_;
 
-  mutable simple_spinlock lock_;
-
   // The next timestamp to be generated from this clock, assuming that
   // the physical clock hasn't advanced beyond the value stored here.
-  uint64_t next_timestamp_;
+  //
+  // Only ever moves forward, via compare-and-swap, so that concurrent
+  // callers of Now() don't serialize on a lock.
+  std::atomic<uint64_t> next_timestamp_;
 
   // The last valid clock reading we got from the time source, along
   // with the monotime that we took that reading.
@@ -21,22 +21,34 @@
 #include <sys/timex.h>
 
 #include <cerrno>
+#include <mutex>
 #include <ostream>
 #include <string>
 #include <vector>
 
-#include <gflags/gflags_declare.h>
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/strings/join.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/walltime.h"
 #include "kudu/util/errno.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/path_util.h"
 #include "kudu/util/status.h"
 #include "kudu/util/subprocess.h"
 
+DEFINE_int32(ntp_max_error_cache_ms, 100,
+             "How long the clock error bound read from the kernel is reused "
+             "for, widened by the maximum clock skew, before being read again. "
+             "Reading the time without the error bound doesn't require a "
+             "system call. 0 reads the error bound along with every read of "
+             "the time.");
+TAG_FLAG(ntp_max_error_cache_ms, advanced);
+TAG_FLAG(ntp_max_error_cache_ms, runtime);
+
 DECLARE_bool(inject_unsync_time_errors);
 
 using std::string;
@@ -102,6 +114,11 @@ void TryRun(vector<string> cmd, vector<string>* log) {
 
 } // anonymous namespace
 
+SystemNtp::SystemNtp()
+    : cached_error_mono_usec_(0),
+      cached_error_usec_(0) {
+}
+
 void SystemNtp::DumpDiagnostics(vector<string>* log) const {
   LOG_STRING(ERROR, log) << "Dumping NTP diagnostics";
   TryRun({"ntptime"}, log);
@@ -148,11 +165,43 @@ Status SystemNtp::Init() {
 }
 
 
-Status SystemNtp::WalltimeWithError(uint64_t *now_usec,
-                                    uint64_t *error_usec) {
+Status SystemNtp::WalltimeWithError(uint64_t* now_usec,
+                                    uint64_t* error_usec) {
+  const int64_t cache_usec = FLAGS_ntp_max_error_cache_ms * 1000L;
+  if (PREDICT_FALSE(cache_usec <= 0 || FLAGS_inject_unsync_time_errors)) {
+    return SlowWalltimeWithError(now_usec, error_usec);
+  }
+  const int64_t read_mono_usec = cached_error_mono_usec_.load(std::memory_order_acquire);
+  const uint64_t cached_error_usec = cached_error_usec_.load(std::memory_order_relaxed);
+  const int64_t mono_usec = GetMonoTimeMicros();
+  const int64_t elapsed_usec = mono_usec - read_mono_usec;
+  if (read_mono_usec == 0 || elapsed_usec >= cache_usec) {
+    return SlowWalltimeWithError(now_usec, error_usec);
+  }
+  *now_usec = GetCurrentTimeMicros();
+  // The kernel grows its error bound by the maximum skew once a second rather
+  // than continuously, so account for every second boundary that may have
+  // passed since the error bound was read, including a partial one.
+  *error_usec = cached_error_usec + skew_ppm_ * (elapsed_usec / kMicrosPerSec + 1);
+  return Status::OK();
+}
+
+Status SystemNtp::SlowWalltimeWithError(uint64_t* now_usec,
+                                        uint64_t* error_usec) {
+  // Take the monotonic time before reading the clock, so that the error bound
+  // extrapolated from the cache is an overestimate.
+  const int64_t mono_usec = GetMonoTimeMicros();
+
   // Read the time. This will return an error if the clock is not synchronized.
   timex tx;
-  RETURN_NOT_OK(CallAdjTime(&tx));
+  Status s = CallAdjTime(&tx);
+  std::unique_lock<simple_spinlock> l(cache_refresh_lock_, std::try_to_lock);
+  if (!s.ok()) {
+    if (l.owns_lock()) {
+      cached_error_mono_usec_.store(0, std::memory_order_release);
+    }
+    return s;
+  }
 
   if (tx.status & STA_NANO) {
     tx.time.tv_usec /= 1000;
@@ -161,6 +210,11 @@ Status SystemNtp::WalltimeWithError(uint64_t *now_usec,
 
   *now_usec = tx.time.tv_sec * kMicrosPerSec + tx.time.tv_usec;
   *error_usec = tx.maxerror;
+  if (l.owns_lock() &&
+      mono_usec > cached_error_mono_usec_.load(std::memory_order_relaxed)) {
+    cached_error_usec_.store(*error_usec, std::memory_order_relaxed);
+    cached_error_mono_usec_.store(mono_usec, std::memory_order_release);
+  }
   return Status::OK();
 }
 
@@ -16,12 +16,14 @@
 // under the License.
 #pragma once
 
+#include <atomic>
 #include <cstdint>
 #include <string>
 #include <vector>
 
 #include "kudu/clock/time_service.h"
 #include "kudu/gutil/macros.h"
+#include "kudu/util/locks.h"
 #include "kudu/util/status.h"
 
 namespace kudu {
@@ -33,9 +35,15 @@ namespace clock {
 //
 // This implementation relies on the ntpd service running on the local host
 // to keep the kernel's timekeeping up to date and in sync.
+//
+// Unless --ntp_max_error_cache_ms is 0, the error bound reported by the kernel
+// is cached: most reads of the time then only cost a clock_gettime() call,
+// which is serviced by the vDSO without entering the kernel, and the cached
+// error bound is widened by the maximum clock skew for the time elapsed since
+// it was read. The cache is refreshed by the first read after it expires.
 class SystemNtp : public TimeService {
  public:
-  SystemNtp() = default;
+  SystemNtp();
 
   // Ensure that the kernel's timekeeping status indicates that it is currently
   // in sync, and initialize various internal parameters.
@@ -56,9 +64,24 @@ class SystemNtp : public TimeService {
 
   static const uint64_t kMicrosPerSec;
 
+  // Reads the time and error bound from the kernel with ntp_adjtime(),
+  // refreshing the cached error bound if nobody else is doing so.
+  Status SlowWalltimeWithError(uint64_t* now_usec, uint64_t* error_usec);
+
   // The skew rate in PPM reported by the kernel.
   uint64_t skew_ppm_ = 0;
 
+  // The monotonic time, in microseconds, at which 'cached_error_usec_' was
+  // read from the kernel, or 0 if it isn't valid, e.g. because the clock was
+  // found unsynchronized. Stored after 'cached_error_usec_' with release
+  // semantics, so that a reader never pairs an error bound with a later
+  // read time than the one it was read at.
+  std::atomic<int64_t> cached_error_mono_usec_;
+  std::atomic<uint64_t> cached_error_usec_;
+
+  // Elects the single thread refreshing the cached error bound.
+  simple_spinlock cache_refresh_lock_;
+
   DISALLOW_COPY_AND_ASSIGN(SystemNtp);
 };
 
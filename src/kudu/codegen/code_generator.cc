@@ -23,6 +23,8 @@
 #include <cctype>
 #include <sstream>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include <gflags/gflags.h>
 #include <glog/logging.h>
@@ -39,6 +41,8 @@
 #include <llvm/Support/TargetSelect.h>
 #include <llvm/Target/TargetMachine.h>
 
+#include "kudu/codegen/row_key_functions.h"
+#include "kudu/codegen/row_predicate.h"
 #include "kudu/codegen/row_projector.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
@@ -226,5 +230,47 @@ Status CodeGenerator::CompileRowProjector(const Schema& base, const Schema& proj
   return Status::OK();
 }
 
+Status CodeGenerator::CompileRowPredicate(const Schema& base,
+                                          std::vector<RowPredicateTerm> terms,
+                                          scoped_refptr<RowPredicateFunctions>* out) {
+  RETURN_NOT_OK(CheckCodegenEnabled());
+
+  TargetMachine* tm;
+  RETURN_NOT_OK(RowPredicateFunctions::Create(base, std::move(terms), out, &tm));
+
+  if (FLAGS_codegen_dump_mc) {
+    static const int kInstrMax = 1500;
+    std::ostringstream sstr;
+    sstr << "Printing row predicate function:\n";
+    int instrs = DumpAsm((*out)->function(), *tm, &sstr, kInstrMax);
+    sstr << "Printed " << instrs << " instructions.";
+    LOG(INFO) << sstr.str();
+  }
+
+  return Status::OK();
+}
+
+Status CodeGenerator::CompileRowKeyFunctions(const Schema& schema,
+                                             scoped_refptr<RowKeyFunctions>* out) {
+  RETURN_NOT_OK(CheckCodegenEnabled());
+
+  TargetMachine* tm;
+  RETURN_NOT_OK(RowKeyFunctions::Create(schema, out, &tm));
+
+  if (FLAGS_codegen_dump_mc) {
+    static const int kInstrMax = 1500;
+    std::ostringstream sstr;
+    sstr << "Printing key encode function:\n";
+    int instrs = DumpAsm((*out)->encode(), *tm, &sstr, kInstrMax);
+    sstr << "Printed " << instrs << " instructions.\n";
+    sstr << "Printing key compare function:\n";
+    instrs = DumpAsm((*out)->compare(), *tm, &sstr, kInstrMax);
+    sstr << "Printed " << instrs << " instructions.";
+    LOG(INFO) << sstr.str();
+  }
+
+  return Status::OK();
+}
+
 } // namespace codegen
 } // namespace kudu
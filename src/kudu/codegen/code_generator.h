@@ -18,6 +18,8 @@
 #ifndef KUDU_CODEGEN_CODE_GENERATOR_H
 #define KUDU_CODEGEN_CODE_GENERATOR_H
 
+#include <vector>
+
 #include "kudu/gutil/macros.h"
 #include "kudu/util/status.h"
 
@@ -30,7 +32,10 @@ class Schema;
 
 namespace codegen {
 
+class RowKeyFunctions;
+class RowPredicateFunctions;
 class RowProjectorFunctions;
+struct RowPredicateTerm;
 
 // CodeGenerator is a top-level class that manages a per-module
 // LLVM context, ExecutionEngine initialization, native target loading,
@@ -67,6 +72,17 @@ class CodeGenerator {
   Status CompileRowProjector(const Schema& base, const Schema& proj,
                              scoped_refptr<RowProjectorFunctions>* out);
 
+  // Attempts to compile the conjunction of 'terms' over rows of the
+  // parameter schema. Writes to 'out' upon success.
+  Status CompileRowPredicate(const Schema& base,
+                             std::vector<RowPredicateTerm> terms,
+                             scoped_refptr<RowPredicateFunctions>* out);
+
+  // Attempts to compile the key functions for the key columns of the
+  // parameter schema. Writes to 'out' upon success.
+  Status CompileRowKeyFunctions(const Schema& schema,
+                                scoped_refptr<RowKeyFunctions>* out);
+
  private:
   static void GlobalInit();
 
@@ -30,15 +30,22 @@
 
 #include "kudu/codegen/code_generator.h"
 #include "kudu/codegen/compilation_manager.h"
+#include "kudu/codegen/row_key_functions.h"
+#include "kudu/codegen/row_predicate.h"
 #include "kudu/codegen/row_projector.h"
+#include "kudu/common/column_predicate.h"
 #include "kudu/common/common.pb.h"
 #include "kudu/common/row.h"
 #include "kudu/common/rowblock.h"
 #include "kudu/common/schema.h"
 #include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/integral_types.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/gutil/singleton.h"
+#include "kudu/gutil/strings/util.h"
+#include "kudu/util/env.h"
+#include "kudu/util/faststring.h"
 #include "kudu/util/logging_test_util.h"
 #include "kudu/util/memory/arena.h"
 #include "kudu/util/random.h"
@@ -53,6 +60,7 @@ using std::vector;
 
 DECLARE_bool(codegen_dump_mc);
 DECLARE_int32(codegen_cache_capacity);
+DECLARE_string(codegen_object_cache_dir);
 
 namespace kudu {
 
@@ -136,6 +144,17 @@ class CodegenTest : public KuduTest {
   Status CreatePartialSchema(const vector<size_t>& col_indexes,
                              Schema* out);
 
+  // Compares the results of the codegen conjunction of 'preds' on the
+  // test rows with those of evaluating each predicate separately.
+  void TestPredicates(const vector<ColumnPredicate>& preds);
+
+  Status CompileRowKeyFunctions(const Schema& schema,
+                                scoped_refptr<codegen::RowKeyFunctions>* out) {
+    return generator_.CompileRowKeyFunctions(schema, out);
+  }
+
+  const ConstContiguousRow& test_row(int i) const { return *test_rows_[i]; }
+
  private:
   // Projects the test rows into parameter rowblock using projector and
   // member projections_arena_ (should be Reset() manually).
@@ -236,6 +255,33 @@ Status CodegenTest::Generate(const Schema* proj, gscoped_ptr<CodegenRP>* out) {
   return Status::OK();
 }
 
+void CodegenTest::TestPredicates(const vector<ColumnPredicate>& preds) {
+  vector<codegen::RowPredicateTerm> terms;
+  ASSERT_OK(codegen::RowPredicateFunctions::MakeTerms(base_, preds, &terms));
+  scoped_refptr<codegen::RowPredicateFunctions> functions;
+  ASSERT_OK(generator_.CompileRowPredicate(base_, std::move(terms), &functions));
+  codegen::RowPredicate with(&base_, functions);
+
+  for (int i = 0; i < kNumTestRows; ++i) {
+    const ConstContiguousRow& row = *test_rows_[i];
+    bool expected = true;
+    for (const ColumnPredicate& pred : preds) {
+      int col_idx = base_.find_column(pred.column().name());
+      const ColumnSchema& col = base_.column(col_idx);
+      bool is_null = col.is_nullable() && row.is_null(col_idx);
+      if (pred.predicate_type() == PredicateType::IsNull) {
+        expected &= is_null;
+      } else if (is_null) {
+        expected = false;
+      } else {
+        expected &= pred.EvaluateCell(col.type_info()->physical_type(), row.cell_ptr(col_idx));
+      }
+    }
+    ASSERT_EQ(expected, with.Evaluate(row))
+      << "Row " << i << ": " << base_.DebugRow(row);
+  }
+}
+
 Status CodegenTest::CreatePartialSchema(const vector<size_t>& col_indexes,
                                         Schema* out) {
   vector<ColumnId> col_ids;
@@ -425,4 +471,195 @@ TEST_F(CodegenTest, TestCodeCache) {
   }
 }
 
+// Test that warming up the CompilationManager makes the following
+// request for a compatible projection hit the cache.
+TEST_F(CodegenTest, TestWarmUpRowProjector) {
+  Singleton<CompilationManager>::UnsafeReset();
+  CompilationManager* cm = CompilationManager::GetSingleton();
+
+  Schema proj = base_.CreateKeyProjection();
+  cm->WarmUpRowProjector(base_, proj);
+  cm->Wait();
+
+  gscoped_ptr<CodegenRP> projector;
+  ASSERT_TRUE(cm->RequestRowProjector(&base_, &proj, &projector));
+}
+
+// Test that compiled objects are persisted to, and reloaded from, the
+// on-disk object cache, except for those which embed pointers.
+TEST_F(CodegenTest, TestObjectCache) {
+  FLAGS_codegen_object_cache_dir = GetTestPath("codegen-objects");
+  auto count_objects = [&]() {
+    vector<string> children;
+    CHECK_OK(env_->GetChildren(FLAGS_codegen_object_cache_dir, &children));
+    return std::count_if(children.begin(), children.end(), [](const string& c) {
+        return HasSuffixString(c, ".o");
+      });
+  };
+
+  // Projections of base columns embed no pointers, so they are persisted,
+  // and compiling the same projection again loads the persisted object.
+  Schema ints;
+  vector<size_t> part_cols = { kI32Col, kI32NullValCol, kI32NullCol };
+  ASSERT_OK(CreatePartialSchema(part_cols, &ints));
+  TestProjection<true>(&ints);
+  ASSERT_EQ(1, count_objects());
+  TestProjection<true>(&ints);
+  ASSERT_EQ(1, count_objects());
+
+  // Projections with defaults refer to the default values in place.
+  Schema with_defaults;
+  part_cols = { kI32Col, kI32RCol };
+  ASSERT_OK(CreatePartialSchema(part_cols, &with_defaults));
+  TestProjection<true>(&with_defaults);
+  ASSERT_EQ(1, count_objects());
+}
+
+// Test that codegen'd conjunctions of predicates agree with the
+// interpreted evaluation of each predicate.
+TEST_F(CodegenTest, TestRowPredicates) {
+  const ColumnSchema& key_col = base_.column(kKeyCol);
+  const ColumnSchema& i32_col = base_.column(kI32Col);
+  const ColumnSchema& i32_null_val_col = base_.column(kI32NullValCol);
+  const ColumnSchema& i32_null_col = base_.column(kI32NullCol);
+  const ColumnSchema& str_col = base_.column(kStrCol);
+  const ColumnSchema& str_null_val_col = base_.column(kStrNullValCol);
+
+  uint64_t key_lower = 3;
+  uint64_t key_upper = 7;
+  int32_t zero = 0;
+  const void* i32_val = test_row(2).cell_ptr(kI32NullValCol);
+  Slice str_lower("a");
+  Slice str_upper("n");
+  const void* str_val = test_row(4).cell_ptr(kStrNullValCol);
+
+  ColumnPredicate key_range = ColumnPredicate::Range(key_col, &key_lower, &key_upper);
+  ColumnPredicate i32_lower = ColumnPredicate::Range(i32_col, &zero, nullptr);
+  ColumnPredicate i32_upper = ColumnPredicate::Range(i32_col, nullptr, &zero);
+  ColumnPredicate i32_eq = ColumnPredicate::Equality(i32_null_val_col, i32_val);
+  ColumnPredicate i32_is_null = ColumnPredicate::IsNull(i32_null_col);
+  ColumnPredicate i32_is_not_null = ColumnPredicate::IsNotNull(i32_null_val_col);
+  ColumnPredicate str_range = ColumnPredicate::Range(str_col, &str_lower, &str_upper);
+  ColumnPredicate str_eq = ColumnPredicate::Equality(str_null_val_col, str_val);
+  ColumnPredicate none = ColumnPredicate::None(str_col);
+
+  for (const auto& preds : vector<vector<ColumnPredicate>>({
+        { key_range },
+        { i32_lower },
+        { i32_upper },
+        { i32_eq },
+        { i32_is_null },
+        { i32_is_not_null },
+        { ColumnPredicate::IsNotNull(i32_null_col) },
+        { str_range },
+        { str_eq },
+        { none },
+        { key_range, i32_lower, str_range },
+        { i32_is_null, i32_is_not_null, str_eq },
+        { key_range, none } })) {
+    NO_FATALS(TestPredicates(preds));
+  }
+
+  // Predicates which cannot be compiled are rejected up front.
+  vector<const void*> in_values = { &key_lower, &key_upper };
+  vector<codegen::RowPredicateTerm> terms;
+  Status s = codegen::RowPredicateFunctions::MakeTerms(
+      base_, { ColumnPredicate::InList(key_col, &in_values) }, &terms);
+  ASSERT_TRUE(s.IsNotSupported()) << s.ToString();
+}
+
+// Test that the CompilationManager caches row predicates by their
+// schema, predicates, and bounds.
+TEST_F(CodegenTest, TestRowPredicateCache) {
+  Singleton<CompilationManager>::UnsafeReset();
+  CompilationManager* cm = CompilationManager::GetSingleton();
+
+  int32_t lower = 10;
+  int32_t other_lower = 20;
+  vector<ColumnPredicate> preds = {
+    ColumnPredicate::Range(base_.column(kI32Col), &lower, nullptr) };
+  vector<ColumnPredicate> other_preds = {
+    ColumnPredicate::Range(base_.column(kI32Col), &other_lower, nullptr) };
+
+  gscoped_ptr<codegen::RowPredicate> predicate;
+  ASSERT_FALSE(cm->RequestRowPredicate(&base_, preds, &predicate));
+  cm->Wait();
+  ASSERT_TRUE(cm->RequestRowPredicate(&base_, preds, &predicate));
+  ASSERT_TRUE(predicate);
+  ASSERT_FALSE(cm->RequestRowPredicate(&base_, other_preds, &predicate));
+}
+
+// Test that the codegen'd key functions of a composite key agree with
+// Schema::EncodeComparableKey() and Schema::Compare().
+TEST_F(CodegenTest, TestRowKeyFunctions) {
+  Schema schema({ ColumnSchema("k_int32", INT32),
+                  ColumnSchema("k_str", STRING),
+                  ColumnSchema("k_int8", INT8),
+                  ColumnSchema("k_bin", BINARY),
+                  ColumnSchema("k_uint64", UINT64),
+                  ColumnSchema("val", INT32, true) },
+                5);
+  ASSERT_TRUE(codegen::RowKeyFunctions::IsSupported(schema));
+  scoped_refptr<codegen::RowKeyFunctions> functions;
+  ASSERT_OK(CompileRowKeyFunctions(schema, &functions));
+
+  // Draw the cells from small domains, so that many keys share a prefix.
+  Random rng(SeedRandom());
+  const int kNumRows = 200;
+  const vector<string> strings = {
+    "", "a", string("a\0", 2), string("a\0b", 3), "ab", "b" };
+  Arena arena(1024);
+  RowBlock block(schema, kNumRows, &arena);
+  vector<faststring> encoded(kNumRows);
+  for (int i = 0; i < kNumRows; i++) {
+    RowBuilder rb(schema);
+    rb.AddInt32(static_cast<int32_t>(rng.Uniform(3)) - 1);
+    rb.AddString(strings[rng.Uniform(strings.size())]);
+    rb.AddInt8(static_cast<int8_t>(rng.Uniform(3)) - 1);
+    rb.AddBinary(strings[rng.Uniform(strings.size())]);
+    rb.AddUint64(rng.Uniform(2) ? kuint64max : rng.Uniform(2));
+    rb.AddNull();
+    RowBlockRow row = block.row(i);
+    ASSERT_OK(CopyRow(rb.row(), &row, &arena));
+
+    faststring expected;
+    schema.EncodeComparableKey(rb.row(), &expected);
+    functions->EncodeComparableKey(rb.row(), &encoded[i]);
+    ASSERT_EQ(Slice(expected), Slice(encoded[i])) << schema.DebugRow(rb.row());
+  }
+
+  for (int i = 0; i < kNumRows; i++) {
+    for (int j = 0; j < kNumRows; j++) {
+      RowBlockRow lhs = block.row(i);
+      RowBlockRow rhs = block.row(j);
+      int expected = schema.Compare(lhs, rhs);
+      int actual = functions->compare()(&lhs, &rhs);
+      ASSERT_EQ(expected < 0, actual < 0) << schema.DebugRow(lhs) << " " << schema.DebugRow(rhs);
+      ASSERT_EQ(expected == 0, actual == 0) << schema.DebugRow(lhs) << " " << schema.DebugRow(rhs);
+      // The encoded keys sort the same way.
+      ASSERT_EQ(expected < 0, Slice(encoded[i]).compare(Slice(encoded[j])) < 0);
+    }
+  }
+}
+
+// Test that the CompilationManager caches key functions by the types of
+// the key columns only.
+TEST_F(CodegenTest, TestRowKeyFunctionsCache) {
+  Singleton<CompilationManager>::UnsafeReset();
+  CompilationManager* cm = CompilationManager::GetSingleton();
+
+  Schema schema({ ColumnSchema("a", INT32), ColumnSchema("b", STRING),
+                  ColumnSchema("c", INT64, true) }, 2);
+  Schema renamed({ ColumnSchema("x", INT32), ColumnSchema("y", STRING) }, 2);
+  Schema other({ ColumnSchema("a", INT64), ColumnSchema("b", STRING) }, 2);
+
+  scoped_refptr<codegen::RowKeyFunctions> functions;
+  ASSERT_FALSE(cm->RequestRowKeyFunctions(schema, &functions));
+  cm->Wait();
+  ASSERT_TRUE(cm->RequestRowKeyFunctions(schema, &functions));
+  ASSERT_TRUE(functions);
+  ASSERT_TRUE(cm->RequestRowKeyFunctions(renamed, &functions));
+  ASSERT_FALSE(cm->RequestRowKeyFunctions(other, &functions));
+}
+
 } // namespace kudu
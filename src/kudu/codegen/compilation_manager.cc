@@ -21,6 +21,8 @@
 #include <memory>
 #include <ostream>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include <gflags/gflags.h>
 #include <glog/logging.h>
@@ -28,6 +30,8 @@
 #include "kudu/codegen/code_cache.h"
 #include "kudu/codegen/code_generator.h"
 #include "kudu/codegen/jit_wrapper.h"
+#include "kudu/codegen/row_key_functions.h"
+#include "kudu/codegen/row_predicate.h"
 #include "kudu/codegen/row_projector.h"
 #include "kudu/common/schema.h"
 #include "kudu/gutil/bind.h"
@@ -46,6 +50,7 @@
 #include "kudu/util/threadpool.h"
 
 using std::shared_ptr;
+using std::vector;
 
 DEFINE_bool(codegen_time_compilation, false, "Whether to print time that each code "
             "generation request took.");
@@ -122,6 +127,93 @@ class CompilationTask : public Runnable {
   DISALLOW_COPY_AND_ASSIGN(CompilationTask);
 };
 
+// A RowPredicateCompilationTask is the counterpart of CompilationTask for
+// a conjunction of predicates over a base schema. The terms own copies
+// of the predicate bounds, so the task does not depend on the scan which
+// requested it.
+class RowPredicateCompilationTask : public Runnable {
+ public:
+  // Requires that the cache and generator are valid for the lifetime
+  // of this object.
+  RowPredicateCompilationTask(const Schema& base, vector<RowPredicateTerm> terms,
+                              CodeCache* cache, CodeGenerator* generator)
+    : base_(base),
+      terms_(std::move(terms)),
+      cache_(cache),
+      generator_(generator) {}
+
+  // Can only be run once.
+  void Run() override {
+    WARN_NOT_OK(RunWithStatus(),
+                "Failed compilation of row predicate over base schema " +
+                base_.ToString());
+  }
+
+ private:
+  Status RunWithStatus() {
+    faststring key;
+    RETURN_NOT_OK(RowPredicateFunctions::EncodeKey(base_, terms_, &key));
+
+    // Check again to make sure we didn't compile it already.
+    if (cache_->Lookup(key)) return Status::OK();
+
+    scoped_refptr<RowPredicateFunctions> functions;
+    LOG_TIMING_IF(INFO, FLAGS_codegen_time_compilation, "code-generating row predicate") {
+      RETURN_NOT_OK(generator_->CompileRowPredicate(base_, std::move(terms_), &functions));
+    }
+
+    RETURN_NOT_OK(cache_->AddEntry(functions));
+    return Status::OK();
+  }
+
+  Schema base_;
+  vector<RowPredicateTerm> terms_;
+  CodeCache* const cache_;
+  CodeGenerator* const generator_;
+
+  DISALLOW_COPY_AND_ASSIGN(RowPredicateCompilationTask);
+};
+
+// The counterpart of CompilationTask for the key functions of a schema.
+class RowKeyCompilationTask : public Runnable {
+ public:
+  // Requires that the cache and generator are valid for the lifetime
+  // of this object.
+  RowKeyCompilationTask(const Schema& schema, CodeCache* cache, CodeGenerator* generator)
+    : schema_(schema.CreateKeyProjection()),
+      cache_(cache),
+      generator_(generator) {}
+
+  // Can only be run once.
+  void Run() override {
+    WARN_NOT_OK(RunWithStatus(),
+                "Failed compilation of key functions for schema " + schema_.ToString());
+  }
+
+ private:
+  Status RunWithStatus() {
+    faststring key;
+    RETURN_NOT_OK(RowKeyFunctions::EncodeKey(schema_, &key));
+
+    // Check again to make sure we didn't compile it already.
+    if (cache_->Lookup(key)) return Status::OK();
+
+    scoped_refptr<RowKeyFunctions> functions;
+    LOG_TIMING_IF(INFO, FLAGS_codegen_time_compilation, "code-generating key functions") {
+      RETURN_NOT_OK(generator_->CompileRowKeyFunctions(schema_, &functions));
+    }
+
+    RETURN_NOT_OK(cache_->AddEntry(functions));
+    return Status::OK();
+  }
+
+  Schema schema_;
+  CodeCache* const cache_;
+  CodeGenerator* const generator_;
+
+  DISALLOW_COPY_AND_ASSIGN(RowKeyCompilationTask);
+};
+
 } // anonymous namespace
 
 CompilationManager::CompilationManager()
@@ -199,5 +291,76 @@ bool CompilationManager::RequestRowProjector(const Schema* base_schema,
   return true;
 }
 
+void CompilationManager::WarmUpRowProjector(const Schema& base_schema,
+                                            const Schema& projection) {
+  faststring key;
+  Status s = RowProjectorFunctions::EncodeKey(base_schema, projection, &key);
+  WARN_NOT_OK(s, "RowProjector warm-up request failed");
+  if (!s.ok() || cache_.Lookup(key)) return;
+
+  shared_ptr<Runnable> task(
+    new CompilationTask(base_schema, projection, &cache_, &generator_));
+  WARN_NOT_OK(pool_->Submit(task), "RowProjector warm-up request failed");
+}
+
+bool CompilationManager::RequestRowPredicate(const Schema* base_schema,
+                                             const vector<ColumnPredicate>& predicates,
+                                             gscoped_ptr<RowPredicate>* out) {
+  // Predicates which cannot be compiled are routine (e.g. IN lists), so
+  // this is not worth a warning.
+  vector<RowPredicateTerm> terms;
+  if (!RowPredicateFunctions::MakeTerms(*base_schema, predicates, &terms).ok()) {
+    return false;
+  }
+  faststring key;
+  Status s = RowPredicateFunctions::EncodeKey(*base_schema, terms, &key);
+  WARN_NOT_OK(s, "RowPredicate compilation request failed");
+  if (!s.ok()) return false;
+  query_counter_.Increment();
+
+  scoped_refptr<RowPredicateFunctions> cached(
+    down_cast<RowPredicateFunctions*>(cache_.Lookup(key).get()));
+
+  // If not cached, add a request to compilation pool
+  if (!cached) {
+    shared_ptr<Runnable> task(
+      new RowPredicateCompilationTask(*base_schema, std::move(terms), &cache_, &generator_));
+    WARN_NOT_OK(pool_->Submit(task),
+                "RowPredicate compilation request failed");
+    return false;
+  }
+
+  hit_counter_.Increment();
+
+  out->reset(new RowPredicate(base_schema, cached));
+  return true;
+}
+
+bool CompilationManager::RequestRowKeyFunctions(const Schema& schema,
+                                                scoped_refptr<RowKeyFunctions>* out) {
+  if (!RowKeyFunctions::IsSupported(schema)) return false;
+  faststring key;
+  Status s = RowKeyFunctions::EncodeKey(schema, &key);
+  WARN_NOT_OK(s, "RowKeyFunctions compilation request failed");
+  if (!s.ok()) return false;
+  query_counter_.Increment();
+
+  scoped_refptr<RowKeyFunctions> cached(
+    down_cast<RowKeyFunctions*>(cache_.Lookup(key).get()));
+
+  // If not cached, add a request to compilation pool
+  if (!cached) {
+    shared_ptr<Runnable> task(new RowKeyCompilationTask(schema, &cache_, &generator_));
+    WARN_NOT_OK(pool_->Submit(task),
+                "RowKeyFunctions compilation request failed");
+    return false;
+  }
+
+  hit_counter_.Increment();
+
+  *out = std::move(cached);
+  return true;
+}
+
 } // namespace codegen
 } // namespace kudu
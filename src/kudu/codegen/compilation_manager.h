@@ -19,6 +19,7 @@
 #define KUDU_CODEGEN_COMPILATION_MANAGER_H
 
 #include <cstdint>
+#include <vector>
 
 #include "kudu/codegen/code_generator.h"
 #include "kudu/codegen/code_cache.h"
@@ -31,12 +32,15 @@
 
 namespace kudu {
 
+class ColumnPredicate;
 class MetricEntity;
 class Schema;
 class ThreadPool;
 
 namespace codegen {
 
+class RowKeyFunctions;
+class RowPredicate;
 class RowProjector;
 
 // The compilation manager is a top-level class which manages the actual
@@ -78,6 +82,27 @@ class CompilationManager {
                            const Schema* projection,
                            gscoped_ptr<RowProjector>* out);
 
+  // Enqueues a compilation task for the row projector from 'base_schema' to
+  // 'projection' unless one is already cached, so that later requests for
+  // compatible schemas hit the cache. Unlike RequestRowProjector(), this is
+  // not counted as a cache query.
+  void WarmUpRowProjector(const Schema& base_schema, const Schema& projection);
+
+  // As RequestRowProjector(), but for the code-generated conjunction of
+  // 'predicates' over rows of 'base_schema' (see codegen::RowPredicate).
+  // The predicates' columns are looked up in 'base_schema' by name.
+  // Returns false without enqueueing a task if any of the predicates
+  // cannot be compiled.
+  bool RequestRowPredicate(const Schema* base_schema,
+                           const std::vector<ColumnPredicate>& predicates,
+                           gscoped_ptr<RowPredicate>* out);
+
+  // As RequestRowProjector(), but for the code-generated encoding and
+  // comparison of the keys of 'schema' (see codegen::RowKeyFunctions).
+  // Returns false without enqueueing a task if the key cannot be compiled.
+  bool RequestRowKeyFunctions(const Schema& schema,
+                              scoped_refptr<RowKeyFunctions>* out);
+
   // Waits for all asynchronous compilation tasks to finish.
   void Wait();
 
@@ -49,7 +49,9 @@ typedef llvm::ExecutionEngine JITCodeOwner;
 class JITWrapper : public RefCountedThreadSafe<JITWrapper> {
  public:
   enum JITWrapperType {
-    ROW_PROJECTOR
+    ROW_PROJECTOR,
+    ROW_PREDICATE,
+    ROW_KEY
   };
 
   // Returns the key encoding (for the code cache) for this upon success.
@@ -27,6 +27,7 @@
 
 // NOTE: among the headers below, the MCJIT.h header file is needed
 //       for successful run-time operation of the code generator.
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <llvm/ADT/StringMap.h>
 #include <llvm/ADT/StringRef.h>
@@ -54,12 +55,23 @@
 #include <llvm/Transforms/IPO/AlwaysInliner.h>
 #include <llvm/Transforms/IPO/PassManagerBuilder.h>
 
+#include "kudu/codegen/object_cache.h"
 #include "kudu/codegen/precompiled.ll.h"
 #include "kudu/gutil/basictypes.h"
 #include "kudu/gutil/map-util.h"
+#include "kudu/gutil/once.h"
+#include "kudu/gutil/strings/join.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/env.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/status.h"
 
+DEFINE_string(codegen_object_cache_dir, "",
+              "Directory in which to persist code-generated objects, so that they "
+              "need not be compiled again after a restart. If empty, compiled "
+              "objects are only cached in memory.");
+TAG_FLAG(codegen_object_cache_dir, experimental);
+
 #ifndef CODEGEN_MODULE_BUILDER_DO_OPTIMIZATIONS
 #if NDEBUG
 #define CODEGEN_MODULE_BUILDER_DO_OPTIMIZATIONS 1
@@ -136,6 +148,7 @@ bool ModuleContains(const Module& m, const Function* fptr) {
 
 ModuleBuilder::ModuleBuilder()
   : state_(kUninitialized),
+    embeds_pointers_(false),
     context_(new LLVMContext()),
     builder_(*context_) {}
 
@@ -195,8 +208,9 @@ Type* ModuleBuilder::GetType(const string& name) {
   return CHECK_NOTNULL(module_->getTypeByName(name));
 }
 
-Value* ModuleBuilder::GetPointerValue(void* ptr) const {
+Value* ModuleBuilder::GetPointerValue(void* ptr) {
   CHECK_EQ(state_, kBuilding);
+  embeds_pointers_ = true;
   // No direct way of creating constant pointer values in LLVM, so
   // first a constant int has to be created and then casted to a pointer
   IntegerType* llvm_uintptr_t = Type::getIntNTy(*context_, 8 * sizeof(ptr));
@@ -297,6 +311,31 @@ vector<string> GetHostCPUAttrs() {
   return attrs;
 }
 
+DiskObjectCache* g_object_cache = nullptr;
+
+void InitObjectCache() {
+  const string& dir = FLAGS_codegen_object_cache_dir;
+  Status s = Env::Default()->CreateDir(dir);
+  if (!s.ok() && !s.IsAlreadyPresent()) {
+    LOG(WARNING) << "Could not create codegen object cache directory " << dir
+                 << ", compiled objects will not be persisted: " << s.ToString();
+    return;
+  }
+  // The objects are compiled for the host CPU and its features, so they
+  // are part of every key.
+  string host_id = Substitute("$0 $1\n", llvm::sys::getHostCPUName().str(),
+                              JoinStrings(GetHostCPUAttrs(), ","));
+  g_object_cache = new DiskObjectCache(dir, std::move(host_id));
+}
+
+// Returns the on-disk object cache, or NULL if it is disabled.
+DiskObjectCache* GetObjectCache() {
+  if (FLAGS_codegen_object_cache_dir.empty()) return nullptr;
+  static GoogleOnceType once = GOOGLE_ONCE_INIT;
+  GoogleOnceInit(&once, &InitObjectCache);
+  return g_object_cache;
+}
+
 } // anonymous namespace
 
 Status ModuleBuilder::Compile(unique_ptr<ExecutionEngine>* out) {
@@ -324,6 +363,13 @@ Status ModuleBuilder::Compile(unique_ptr<ExecutionEngine>* out) {
   }
   module->setDataLayout(target_->createDataLayout());
 
+  // Code which refers to addresses in this process cannot be reused by
+  // another one.
+  DiskObjectCache* object_cache = GetObjectCache();
+  if (object_cache && !embeds_pointers_) {
+    local_engine->setObjectCache(object_cache);
+  }
+
   DoOptimizations(module, GetFunctionNames());
 
   // Compile the module
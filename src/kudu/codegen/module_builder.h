@@ -84,8 +84,10 @@ class ModuleBuilder {
   llvm::Type* GetType(const std::string& name);
   // Retrieve a precompiled function
   llvm::Function* GetFunction(const std::string& name);
-  // Get the LLVM wrapper for a constant pointer value of type i8*
-  llvm::Value* GetPointerValue(void* ptr) const;
+  // Get the LLVM wrapper for a constant pointer value of type i8*.
+  // A module which embeds pointers is never persisted to the on-disk
+  // object cache (see --codegen_object_cache_dir).
+  llvm::Value* GetPointerValue(void* ptr);
 
   LLVMBuilder* builder() { return &builder_; }
 
@@ -137,6 +139,8 @@ class ModuleBuilder {
   std::unordered_set<std::string> GetFunctionNames() const;
 
   MBState state_;
+  // Whether GetPointerValue() has been called.
+  bool embeds_pointers_;
   std::vector<JITFuture> futures_;
   std::unique_ptr<llvm::LLVMContext> context_;
   std::unique_ptr<llvm::Module> module_;
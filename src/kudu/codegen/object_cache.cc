@@ -0,0 +1,99 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/codegen/object_cache.h"
+
+#include <utility>
+
+#include <glog/logging.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "kudu/gutil/hash/city.h"
+#include "kudu/gutil/int128.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/stringprintf.h"
+#include "kudu/util/env.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/path_util.h"
+#include "kudu/util/slice.h"
+#include "kudu/util/status.h"
+
+using std::string;
+using std::unique_ptr;
+using strings::Substitute;
+
+namespace kudu {
+namespace codegen {
+
+DiskObjectCache::DiskObjectCache(string dir, string host_id)
+  : dir_(std::move(dir)),
+    host_id_(std::move(host_id)) {}
+
+DiskObjectCache::~DiskObjectCache() {}
+
+string DiskObjectCache::ObjectPath(const llvm::Module* module) const {
+  string ir = host_id_;
+  llvm::raw_string_ostream os(ir);
+  module->print(os, nullptr);
+  os.flush();
+  uint128 hash = util_hash::CityHash128(ir.data(), ir.size());
+  return JoinPathSegments(dir_, StringPrintf("%016llx%016llx.o",
+                                             static_cast<unsigned long long>(Uint128High64(hash)),
+                                             static_cast<unsigned long long>(Uint128Low64(hash))));
+}
+
+void DiskObjectCache::notifyObjectCompiled(const llvm::Module* module,
+                                           llvm::MemoryBufferRef obj) {
+  Env* env = Env::Default();
+  string path = ObjectPath(module);
+  // Write to a temporary file first, so that a concurrent or later reader
+  // never sees a partially written object.
+  string tmp_path = Substitute("$0.tmp.$1", path, env->gettid());
+  Status s = WriteStringToFile(env, Slice(obj.getBufferStart(), obj.getBufferSize()), tmp_path);
+  if (s.ok()) {
+    s = env->RenameFile(tmp_path, path);
+  }
+  if (!s.ok()) {
+    WARN_NOT_OK(env->DeleteFile(tmp_path), "Could not delete temporary object file");
+    LOG(WARNING) << "Could not persist code-generated object to " << path
+                 << ": " << s.ToString();
+  }
+}
+
+unique_ptr<llvm::MemoryBuffer> DiskObjectCache::getObject(const llvm::Module* module) {
+  Env* env = Env::Default();
+  string path = ObjectPath(module);
+  if (!env->FileExists(path)) {
+    return nullptr;
+  }
+  faststring data;
+  Status s = ReadFileToString(env, path, &data);
+  if (!s.ok()) {
+    LOG(WARNING) << "Could not read code-generated object from " << path
+                 << ": " << s.ToString();
+    return nullptr;
+  }
+  VLOG(1) << "Loaded code-generated object from " << path;
+  return llvm::MemoryBuffer::getMemBufferCopy(
+      llvm::StringRef(reinterpret_cast<const char*>(data.data()), data.size()));
+}
+
+} // namespace codegen
+} // namespace kudu
@@ -0,0 +1,80 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef KUDU_CODEGEN_OBJECT_CACHE_H
+#define KUDU_CODEGEN_OBJECT_CACHE_H
+
+#include <memory>
+#include <string>
+
+#include <llvm/ExecutionEngine/ObjectCache.h>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/port.h"
+
+namespace llvm {
+class MemoryBuffer;
+class MemoryBufferRef;
+class Module;
+} // namespace llvm
+
+namespace kudu {
+namespace codegen {
+
+// An llvm::ObjectCache which persists compiled objects in a directory, so
+// that code generated before a restart need not be compiled again.
+//
+// Objects are keyed by a hash of the optimized module IR together with the
+// host CPU and its features, so a module is only ever loaded into a process
+// which would have compiled the same object. Modules which embed
+// addresses of the compiling process (see ModuleBuilder::GetPointerValue())
+// must not be handed to this cache.
+//
+// Failures to read or write the directory are logged and otherwise
+// ignored: the caller simply compiles the module.
+//
+// This class is thread-safe.
+//
+// NOTE: LLVM is built without RTTI, so object_cache.cc is as well (see
+// CMakeLists.txt); this header may not be included by code which needs
+// the type information of classes derived from LLVM's.
+class DiskObjectCache : public llvm::ObjectCache {
+ public:
+  // 'dir' must exist. 'host_id' identifies the target the objects are
+  // compiled for, and is mixed into every key.
+  DiskObjectCache(std::string dir, std::string host_id);
+  virtual ~DiskObjectCache();
+
+  void notifyObjectCompiled(const llvm::Module* module,
+                            llvm::MemoryBufferRef obj) OVERRIDE;
+
+  std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module* module) OVERRIDE;
+
+  // Returns the path of the object file for 'module'.
+  std::string ObjectPath(const llvm::Module* module) const;
+
+ private:
+  const std::string dir_;
+  const std::string host_id_;
+
+  DISALLOW_COPY_AND_ASSIGN(DiskObjectCache);
+};
+
+} // namespace codegen
+} // namespace kudu
+
+#endif
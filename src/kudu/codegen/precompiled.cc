@@ -36,10 +36,14 @@
 #include <cstdint>
 #include <cstring>
 
+#include "kudu/common/key_encoder.h"
 #include "kudu/common/rowblock.h"
+#include "kudu/common/types.h"
 #include "kudu/gutil/port.h"
 #include "kudu/util/bitmap.h"
+#include "kudu/util/faststring.h"
 #include "kudu/util/memory/arena.h"
+#include "kudu/util/slice.h"
 
 // Even though this file is only needed for IR purposes, we need to check for
 // IR_BUILD because we use a fake static library target to workaround a cmake
@@ -65,8 +69,6 @@ extern "C" void *__dso_handle __attribute__((__visibility__("hidden"))) = NULL;
 
 namespace kudu {
 
-class Slice;
-
 // Returns whether copy was successful (fails iff slice relocation fails,
 // which can only occur if is_string is true).
 // If arena is NULL, then no relocation occurs.
@@ -163,5 +165,81 @@ IR_ALWAYS_INLINE void _PrecompiledCopyCellToRowBlockSetNull(
   dst->cell(col).set_null(is_null);
 }
 
+// declare i32 @_PrecompiledCompareSlice(
+//   i8* cell, i8* data, i64 size)
+//
+//   Compares the Slice stored in the BINARY cell pointed to by 'cell' with
+//   the 'size' bytes at 'data', returning a value less than, equal to, or
+//   greater than zero as Slice::compare() does.
+IR_ALWAYS_INLINE int32_t _PrecompiledCompareSlice(
+    uint8_t* cell, uint8_t* data, uint64_t size) {
+  return reinterpret_cast<const Slice*>(cell)->compare(Slice(data, size));
+}
+
+// declare void @_PrecompiledEncodeKey<Type>(
+//   i8* cell, faststring* dst)
+//
+//   Appends the memcomparable encoding of the fixed-width key cell pointed
+//   to by 'cell' to 'dst', as KeyEncoder::Encode() does. One function is
+//   defined per physical integer type which may be part of a primary key.
+#define ENCODE_KEY_FUNCTION(Name, Type)                                     \
+  IR_ALWAYS_INLINE void _PrecompiledEncodeKey##Name(                        \
+      uint8_t* cell, faststring* dst) {                                     \
+    KeyEncoderTraits<Type, faststring>::Encode(cell, dst);                  \
+  }
+
+ENCODE_KEY_FUNCTION(Int8, INT8)
+ENCODE_KEY_FUNCTION(Int16, INT16)
+ENCODE_KEY_FUNCTION(Int32, INT32)
+ENCODE_KEY_FUNCTION(Int64, INT64)
+ENCODE_KEY_FUNCTION(Uint8, UINT8)
+ENCODE_KEY_FUNCTION(Uint16, UINT16)
+ENCODE_KEY_FUNCTION(Uint32, UINT32)
+ENCODE_KEY_FUNCTION(Uint64, UINT64)
+
+#undef ENCODE_KEY_FUNCTION
+
+// declare void @_PrecompiledEncodeKeyBinary(
+//   i8* cell, i1 is_last, faststring* dst)
+//
+//   Appends the memcomparable encoding of the BINARY key cell pointed to by
+//   'cell' to 'dst', escaping and terminating it unless it is the last
+//   column of the key.
+IR_ALWAYS_INLINE void _PrecompiledEncodeKeyBinary(
+    uint8_t* cell, bool is_last, faststring* dst) {
+  KeyEncoderTraits<BINARY, faststring>::EncodeWithSeparators(cell, is_last, dst);
+}
+
+// declare i32 @_PrecompiledCompareKey<Type>(
+//   RowBlockRow* lhs, RowBlockRow* rhs, i64 col)
+//
+//   Compares the cells of column 'col' of two rows, returning a value less
+//   than, equal to, or greater than zero as TypeInfo::Compare() does. As in
+//   _PrecompiledCopyCellToRowBlock, the cell pointers are computed from the
+//   statically known size of the type.
+#define COMPARE_KEY_FUNCTION(Name, Type)                                    \
+  IR_ALWAYS_INLINE int32_t _PrecompiledCompareKey##Name(                    \
+      RowBlockRow* lhs, RowBlockRow* rhs, uint64_t col) {                   \
+    typedef DataTypeTraits<Type> Traits;                                    \
+    const size_t size = sizeof(Traits::cpp_type);                           \
+    const uint8_t* lhs_cell = lhs->row_block()->column_data_base_ptr(col) + \
+        lhs->row_index() * size;                                            \
+    const uint8_t* rhs_cell = rhs->row_block()->column_data_base_ptr(col) + \
+        rhs->row_index() * size;                                            \
+    return Traits::Compare(lhs_cell, rhs_cell);                             \
+  }
+
+COMPARE_KEY_FUNCTION(Int8, INT8)
+COMPARE_KEY_FUNCTION(Int16, INT16)
+COMPARE_KEY_FUNCTION(Int32, INT32)
+COMPARE_KEY_FUNCTION(Int64, INT64)
+COMPARE_KEY_FUNCTION(Uint8, UINT8)
+COMPARE_KEY_FUNCTION(Uint16, UINT16)
+COMPARE_KEY_FUNCTION(Uint32, UINT32)
+COMPARE_KEY_FUNCTION(Uint64, UINT64)
+COMPARE_KEY_FUNCTION(Binary, BINARY)
+
+#undef COMPARE_KEY_FUNCTION
+
 } // extern "C"
 } // namespace kudu
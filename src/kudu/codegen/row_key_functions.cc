@@ -0,0 +1,301 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/codegen/row_key_functions.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gflags/gflags_declare.h>
+#include <llvm/ADT/Twine.h>
+#include <llvm/ADT/ilist_iterator.h>
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/IR/Argument.h>
+#include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/DerivedTypes.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/Type.h>
+#include <llvm/IR/Value.h>
+
+#include "kudu/codegen/jit_wrapper.h"
+#include "kudu/codegen/module_builder.h"
+#include "kudu/common/common.pb.h"
+#include "kudu/common/types.h"
+#include "kudu/gutil/strings/strcat.h"
+#include "kudu/gutil/strings/substitute.h"
+
+namespace llvm {
+class LLVMContext;
+} // namespace llvm
+
+using llvm::Argument;
+using llvm::BasicBlock;
+using llvm::Function;
+using llvm::FunctionType;
+using llvm::LLVMContext;
+using llvm::PointerType;
+using llvm::Type;
+using llvm::Value;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+using strings::Substitute;
+
+DECLARE_bool(codegen_dump_functions);
+
+namespace kudu {
+namespace codegen {
+
+namespace {
+
+// Returns the suffix of the precompiled functions which encode and compare
+// key cells of the given physical type, or NULL if there are none.
+const char* PrecompiledTypeSuffix(DataType type) {
+  switch (type) {
+    case INT8: return "Int8";
+    case INT16: return "Int16";
+    case INT32: return "Int32";
+    case INT64: return "Int64";
+    case UINT8: return "Uint8";
+    case UINT16: return "Uint16";
+    case UINT32: return "Uint32";
+    case UINT64: return "Uint64";
+    case BINARY: return "Binary";
+    default: return nullptr;
+  }
+}
+
+const char* PrecompiledTypeSuffix(const ColumnSchema& col) {
+  return PrecompiledTypeSuffix(col.type_info()->physical_type());
+}
+
+// Generates a function of the form:
+// void(int8_t* src, faststring* dst)
+// Requires src is a contiguous row whose key columns are those of the
+// schema. Appends the encoded key of the row to dst.
+llvm::Function* MakeEncodeFunction(const string& name,
+                                   ModuleBuilder* mbuilder,
+                                   const Schema& schema) {
+  ModuleBuilder::LLVMBuilder* builder = mbuilder->builder();
+  LLVMContext& context = builder->getContext();
+
+  vector<Type*> argtypes = {
+    Type::getInt8PtrTy(context),
+    PointerType::getUnqual(mbuilder->GetType("class.kudu::faststring"))
+  };
+  FunctionType* fty = FunctionType::get(Type::getVoidTy(context), argtypes, false);
+  Function* f = mbuilder->Create(fty, name);
+
+  Function::arg_iterator it = f->arg_begin();
+  Argument* src = &*it++;
+  Argument* dst = &*it++;
+  DCHECK(it == f->arg_end());
+  src->setName("src");
+  dst->setName("dst");
+
+  // Encode function in IR (values in angle brackets are constants
+  // determined at JIT time):
+  //
+  // define void @name(i8* %src, faststring* %dst)
+  // entry:
+  //   <for each key column>
+  //     %cell = getelementptr i8* %src, i64 <column offset>
+  //     <if BINARY>
+  //       call void @_PrecompiledEncodeKeyBinary(i8* %cell, i1 <is last>,
+  //                                              faststring* %dst)
+  //     <otherwise>
+  //       call void @_PrecompiledEncodeKey<type>(i8* %cell, faststring* %dst)
+  //     <end implicit if>
+  //   <end implicit for each>
+  //   ret void
+  builder->SetInsertPoint(BasicBlock::Create(context, "entry", f));
+  const size_t num_key_columns = schema.num_key_columns();
+  for (int i = 0; i < num_key_columns; i++) {
+    const ColumnSchema& col = schema.column(i);
+    Function* encode = mbuilder->GetFunction(
+        StrCat("_PrecompiledEncodeKey", PrecompiledTypeSuffix(col)));
+    Value* cell = builder->CreateConstGEP1_64(src, schema.column_offset(i));
+    cell->setName(StrCat("cell", i));
+    vector<Value*> args;
+    if (col.type_info()->physical_type() == BINARY) {
+      args = { cell, builder->getInt1(i == num_key_columns - 1), dst };
+    } else {
+      args = { cell, dst };
+    }
+    builder->CreateCall(encode, args);
+  }
+  builder->CreateRetVoid();
+
+  if (FLAGS_codegen_dump_functions) {
+    LOG(INFO) << "Dumping key encode function:";
+    f->dump();
+  }
+
+  return f;
+}
+
+// Generates a function of the form:
+// int32_t(RowBlockRow* lhs, RowBlockRow* rhs)
+// Requires lhs and rhs are rows of RowBlocks whose key columns are those
+// of the schema. Returns the comparison of their keys.
+llvm::Function* MakeCompareFunction(const string& name,
+                                    ModuleBuilder* mbuilder,
+                                    const Schema& schema) {
+  ModuleBuilder::LLVMBuilder* builder = mbuilder->builder();
+  LLVMContext& context = builder->getContext();
+
+  Type* rbrow_type = PointerType::getUnqual(mbuilder->GetType("class.kudu::RowBlockRow"));
+  vector<Type*> argtypes = { rbrow_type, rbrow_type };
+  FunctionType* fty = FunctionType::get(Type::getInt32Ty(context), argtypes, false);
+  Function* f = mbuilder->Create(fty, name);
+
+  Function::arg_iterator it = f->arg_begin();
+  Argument* lhs = &*it++;
+  Argument* rhs = &*it++;
+  DCHECK(it == f->arg_end());
+  lhs->setName("lhs");
+  rhs->setName("rhs");
+
+  // Compare function in IR (values in angle brackets are constants
+  // determined at JIT time). The first key column which differs decides.
+  //
+  // define i32 @name(RowBlockRow* %lhs, RowBlockRow* %rhs)
+  // entry:
+  //   <for each key column but the last>
+  //     %cmp = call i32 @_PrecompiledCompareKey<type>(
+  //       RowBlockRow* %lhs, RowBlockRow* %rhs, i64 <column index>)
+  //     %differ = icmp ne i32 %cmp, 0
+  //     br i1 %differ, label %differ_block, label %next
+  //   differ_block:
+  //     ret i32 %cmp
+  //   next:
+  //   <end implicit for each>
+  //   %cmp = call i32 @_PrecompiledCompareKey<type>(
+  //     RowBlockRow* %lhs, RowBlockRow* %rhs, i64 <last column index>)
+  //   ret i32 %cmp
+  builder->SetInsertPoint(BasicBlock::Create(context, "entry", f));
+  const size_t num_key_columns = schema.num_key_columns();
+  for (int i = 0; i < num_key_columns; i++) {
+    Function* compare = mbuilder->GetFunction(
+        StrCat("_PrecompiledCompareKey", PrecompiledTypeSuffix(schema.column(i))));
+    vector<Value*> args = { lhs, rhs, builder->getInt64(i) };
+    Value* cmp = builder->CreateCall(compare, args);
+    cmp->setName(StrCat("cmp", i));
+    if (i == num_key_columns - 1) {
+      builder->CreateRet(cmp);
+      break;
+    }
+    BasicBlock* differ = BasicBlock::Create(context, StrCat("differ", i), f);
+    BasicBlock* next = BasicBlock::Create(context, StrCat("next", i), f);
+    builder->CreateCondBr(builder->CreateICmpNE(cmp, builder->getInt32(0)), differ, next);
+    builder->SetInsertPoint(differ);
+    builder->CreateRet(cmp);
+    builder->SetInsertPoint(next);
+  }
+
+  if (FLAGS_codegen_dump_functions) {
+    LOG(INFO) << "Dumping key compare function:";
+    f->dump();
+  }
+
+  return f;
+}
+
+// Convenience method which appends to a faststring
+template<typename T>
+void AddNext(faststring* fs, const T& val) {
+  fs->append(&val, sizeof(T));
+}
+
+} // anonymous namespace
+
+bool RowKeyFunctions::IsSupported(const Schema& schema) {
+  if (schema.num_key_columns() == 0) return false;
+  for (int i = 0; i < schema.num_key_columns(); i++) {
+    const ColumnSchema& col = schema.column(i);
+    if (col.is_nullable() || PrecompiledTypeSuffix(col) == nullptr) return false;
+  }
+  return true;
+}
+
+RowKeyFunctions::RowKeyFunctions(const Schema& schema,
+                                 EncodeFunction encode_f,
+                                 CompareFunction compare_f,
+                                 unique_ptr<JITCodeOwner> owner)
+  : JITWrapper(std::move(owner)),
+    key_schema_(schema.CreateKeyProjection()),
+    encode_f_(encode_f),
+    compare_f_(compare_f) {
+  CHECK(encode_f != nullptr)
+    << "Promise to compile key encode function not fulfilled by ModuleBuilder";
+  CHECK(compare_f != nullptr)
+    << "Promise to compile key compare function not fulfilled by ModuleBuilder";
+}
+
+Status RowKeyFunctions::Create(const Schema& schema,
+                               scoped_refptr<RowKeyFunctions>* out,
+                               llvm::TargetMachine** tm) {
+  if (!IsSupported(schema)) {
+    return Status::NotSupported(
+        Substitute("cannot compile the key of schema $0", schema.ToString()));
+  }
+
+  ModuleBuilder builder;
+  RETURN_NOT_OK(builder.Init());
+
+  Function* encode = MakeEncodeFunction("EncodeRowKey", &builder, schema);
+  Function* compare = MakeCompareFunction("CompareRowKeys", &builder, schema);
+
+  EncodeFunction encode_f;
+  CompareFunction compare_f;
+  builder.AddJITPromise(encode, &encode_f);
+  builder.AddJITPromise(compare, &compare_f);
+
+  unique_ptr<JITCodeOwner> owner;
+  RETURN_NOT_OK(builder.Compile(&owner));
+
+  if (tm) {
+    *tm = builder.GetTargetMachine();
+  }
+  out->reset(new RowKeyFunctions(schema, encode_f, compare_f, std::move(owner)));
+  return Status::OK();
+}
+
+// Generates the code cache key for the key columns of a schema, encoded
+// as follows, in sequence.
+//
+// (1 byte) unique type identifier for RowKeyFunctions
+// (8 bytes) number, as unsigned long, of key columns
+// (4 bytes each) key column physical types, in order
+//
+// The column offsets and the encoding of the key are a function of the
+// column types alone. Key columns are never nullable.
+//
+// Writes to 'out' upon success.
+Status RowKeyFunctions::EncodeKey(const Schema& schema, faststring* out) {
+  AddNext(out, JITWrapper::ROW_KEY);
+  AddNext(out, schema.num_key_columns());
+  for (int i = 0; i < schema.num_key_columns(); i++) {
+    AddNext(out, schema.column(i).type_info()->physical_type());
+  }
+  return Status::OK();
+}
+
+} // namespace codegen
+} // namespace kudu
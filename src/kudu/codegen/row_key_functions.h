@@ -0,0 +1,118 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef KUDU_CODEGEN_ROW_KEY_FUNCTIONS_H
+#define KUDU_CODEGEN_ROW_KEY_FUNCTIONS_H
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+#include <glog/logging.h>
+
+#include "kudu/codegen/jit_wrapper.h"
+#include "kudu/common/generic_iterators.h"
+#include "kudu/common/rowblock.h"
+#include "kudu/common/schema.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/port.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/slice.h"
+#include "kudu/util/status.h"
+
+namespace llvm {
+class TargetMachine;
+} // namespace llvm
+
+namespace kudu {
+namespace codegen {
+
+// The code-generated encoding and comparison of the primary keys of a
+// schema. Only the types of the key columns are compiled in, so the same
+// functions serve every schema whose key columns have the same types:
+// a tablet's schema across ALTERs, its key projection, or any projection
+// which starts with the key columns.
+class RowKeyFunctions : public JITWrapper {
+ public:
+  // Returns whether the key columns of 'schema' can be compiled. This is
+  // the case for every schema which satisfies the constraints on keys.
+  static bool IsSupported(const Schema& schema);
+
+  // Compiles the key functions for the key columns of 'schema'.
+  // Writes the llvm::TargetMachine* used to 'tm' (if not NULL)
+  // and the functions to 'out' upon success.
+  static Status Create(const Schema& schema,
+                       scoped_refptr<RowKeyFunctions>* out,
+                       llvm::TargetMachine** tm = NULL);
+
+  // Appends the memcomparable encoding of the key of the contiguous row
+  // pointed to by the first argument to the second argument.
+  typedef void(*EncodeFunction)(const uint8_t*, faststring*);
+  EncodeFunction encode() const { return encode_f_; }
+
+  // Compares the keys of two rows of a RowBlock.
+  typedef int32_t(*CompareFunction)(const RowBlockRow*, const RowBlockRow*);
+  CompareFunction compare() const { return compare_f_; }
+
+  // Encodes the key of 'row' into 'dst', and returns it, with the same
+  // result as Schema::EncodeComparableKey().
+  template<class RowType>
+  Slice EncodeComparableKey(const RowType& row, faststring* dst) const {
+    DCHECK(key_schema_.KeyEquals(*row.schema(), ColumnSchema::COMPARE_TYPE));
+    dst->clear();
+    encode_f_(row.row_data(), dst);
+    return Slice(*dst);
+  }
+
+  virtual Status EncodeOwnKey(faststring* out) OVERRIDE {
+    return EncodeKey(key_schema_, out);
+  }
+
+  static Status EncodeKey(const Schema& schema, faststring* out);
+
+ private:
+  RowKeyFunctions(const Schema& schema, EncodeFunction encode_f,
+                  CompareFunction compare_f, std::unique_ptr<JITCodeOwner> owner);
+
+  // The key projection of the schema the functions were compiled for.
+  const Schema key_schema_;
+  const EncodeFunction encode_f_;
+  const CompareFunction compare_f_;
+};
+
+// Compares the keys of the rows of a MergeIterator with code-generated
+// functions.
+class RowKeyComparator : public kudu::RowKeyComparator {
+ public:
+  explicit RowKeyComparator(scoped_refptr<RowKeyFunctions> functions)
+    : functions_(std::move(functions)) {}
+
+  int Compare(const RowBlockRow& lhs, const RowBlockRow& rhs) const override {
+    return functions_->compare()(&lhs, &rhs);
+  }
+
+ private:
+  const scoped_refptr<RowKeyFunctions> functions_;
+
+  DISALLOW_COPY_AND_ASSIGN(RowKeyComparator);
+};
+
+} // namespace codegen
+} // namespace kudu
+
+#endif
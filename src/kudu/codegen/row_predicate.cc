@@ -0,0 +1,454 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/codegen/row_predicate.h"
+
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gflags/gflags_declare.h>
+#include <llvm/ADT/Twine.h>
+#include <llvm/ADT/ilist_iterator.h>
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/IR/Argument.h>
+#include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/DerivedTypes.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/Type.h>
+#include <llvm/IR/Value.h>
+
+#include "kudu/codegen/jit_wrapper.h"
+#include "kudu/codegen/module_builder.h"
+#include "kudu/common/common.pb.h"
+#include "kudu/common/types.h"
+#include "kudu/gutil/strings/strcat.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/slice.h"
+
+namespace llvm {
+class LLVMContext;
+} // namespace llvm
+
+using llvm::Argument;
+using llvm::BasicBlock;
+using llvm::ConstantFP;
+using llvm::Function;
+using llvm::FunctionType;
+using llvm::LLVMContext;
+using llvm::PointerType;
+using llvm::Type;
+using llvm::Value;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+using strings::Substitute;
+
+DECLARE_bool(codegen_dump_functions);
+
+namespace kudu {
+namespace codegen {
+
+namespace {
+
+// Returns whether cells of the given physical type can be compared by
+// the generated code.
+bool IsSupportedType(DataType type) {
+  switch (type) {
+    case BOOL:
+    case INT8:
+    case INT16:
+    case INT32:
+    case INT64:
+    case UINT8:
+    case UINT16:
+    case UINT32:
+    case UINT64:
+    case FLOAT:
+    case DOUBLE:
+    case BINARY:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool IsSigned(DataType type) {
+  return type == INT8 || type == INT16 || type == INT32 || type == INT64;
+}
+
+bool IsFloatingPoint(DataType type) {
+  return type == FLOAT || type == DOUBLE;
+}
+
+// Returns the bytes of a predicate bound as stored in a RowPredicateTerm.
+string BoundBytes(const TypeInfo* type_info, const void* value) {
+  if (value == nullptr) return string();
+  if (type_info->physical_type() == BINARY) {
+    return static_cast<const Slice*>(value)->ToString();
+  }
+  return string(static_cast<const char*>(value), type_info->size());
+}
+
+// Returns the LLVM constant for a fixed-width bound of the given type.
+Value* MakeConstant(ModuleBuilder::LLVMBuilder* builder, DataType type, const string& bytes) {
+  switch (type) {
+    case FLOAT: {
+      float v;
+      memcpy(&v, bytes.data(), sizeof(v));
+      return ConstantFP::get(builder->getFloatTy(), v);
+    }
+    case DOUBLE: {
+      double v;
+      memcpy(&v, bytes.data(), sizeof(v));
+      return ConstantFP::get(builder->getDoubleTy(), v);
+    }
+    default: {
+      // Integers are compared with sign-aware instructions, so the constant
+      // only needs the bit pattern of the cell.
+      uint64_t v = 0;
+      DCHECK_LE(bytes.size(), sizeof(v));
+      memcpy(&v, bytes.data(), bytes.size());
+      return builder->getIntN(bytes.size() * 8, v);
+    }
+  }
+}
+
+// Comparisons of a cell against a bound, matching the semantics of
+// DataTypeTraits<>::Compare() as used by ColumnPredicate::EvaluateCell().
+// For floating point cells Compare() treats NaN as equal to everything,
+// hence the unordered comparisons where the result must be true for NaN.
+Value* CreateLessThan(ModuleBuilder::LLVMBuilder* builder, DataType type,
+                      Value* cell, Value* bound) {
+  if (IsFloatingPoint(type)) return builder->CreateFCmpOLT(cell, bound);
+  if (IsSigned(type)) return builder->CreateICmpSLT(cell, bound);
+  return builder->CreateICmpULT(cell, bound);
+}
+
+Value* CreateGreaterOrEqual(ModuleBuilder::LLVMBuilder* builder, DataType type,
+                            Value* cell, Value* bound) {
+  if (IsFloatingPoint(type)) return builder->CreateFCmpUGE(cell, bound);
+  if (IsSigned(type)) return builder->CreateICmpSGE(cell, bound);
+  return builder->CreateICmpUGE(cell, bound);
+}
+
+Value* CreateEqual(ModuleBuilder::LLVMBuilder* builder, DataType type,
+                   Value* cell, Value* bound) {
+  if (IsFloatingPoint(type)) return builder->CreateFCmpUEQ(cell, bound);
+  return builder->CreateICmpEQ(cell, bound);
+}
+
+// Generates a function of the form:
+// bool(int8_t* src)
+// Requires src is a contiguous row of the base schema.
+// Returns whether the row satisfies every term of the conjunction.
+llvm::Function* MakePredicate(const string& name,
+                              ModuleBuilder* mbuilder,
+                              const Schema& base_schema,
+                              const vector<RowPredicateTerm>& terms) {
+  ModuleBuilder::LLVMBuilder* builder = mbuilder->builder();
+  LLVMContext& context = builder->getContext();
+
+  vector<Type*> argtypes = { Type::getInt8PtrTy(context) };
+  FunctionType* fty = FunctionType::get(Type::getInt1Ty(context), argtypes, false);
+  Function* f = mbuilder->Create(fty, name);
+
+  Function::arg_iterator it = f->arg_begin();
+  Argument* src = &*it++;
+  DCHECK(it == f->arg_end());
+  src->setName("src");
+
+  // Evaluate row function in IR (values in angle brackets are constants
+  // determined at JIT time). Every term branches to 'reject' as soon as
+  // it fails, so later terms are skipped as in a short-circuiting '&&'.
+  //
+  // define i1 @name(i8* %src)
+  // entry:
+  //   <for each term>
+  //     <if column is nullable>
+  //       %null_byte = load i8* (getelementptr i8* %src, i64 <bitmap byte offset>)
+  //       %is_null = icmp ne (and i8 %null_byte, <bit mask>), 0
+  //       <if IS NULL: br i1 %is_null, label %next, label %reject>
+  //       <otherwise: br i1 %is_null, label %reject, label %not_null>
+  //     <end implicit if>
+  //   not_null:
+  //     %cell = load <type>* (getelementptr i8* %src, i64 <column offset>)
+  //     %match = <comparisons of %cell against the bounds>**
+  //     br i1 %match, label %next, label %reject
+  //   next:
+  //   <end implicit for each>
+  //   ret i1 true
+  // reject:
+  //   ret i1 false
+  //
+  // **BINARY cells are compared with
+  //   call i32 @_PrecompiledCompareSlice(i8* %cell, i8* <bound data>, i64 <bound size>)
+  // and the sign of the result.
+  Function* compare_slice = mbuilder->GetFunction("_PrecompiledCompareSlice");
+
+  BasicBlock* entry = BasicBlock::Create(context, "entry", f);
+  BasicBlock* reject = BasicBlock::Create(context, "reject", f);
+  builder->SetInsertPoint(reject);
+  builder->CreateRet(builder->getInt1(false));
+  builder->SetInsertPoint(entry);
+
+  const size_t bitmap_offset = base_schema.byte_size();
+  for (int term_idx = 0; term_idx < terms.size(); term_idx++) {
+    const RowPredicateTerm& term = terms[term_idx];
+    const ColumnSchema& col = base_schema.column(term.col_idx);
+    const DataType type = col.type_info()->physical_type();
+
+    if (term.type == PredicateType::None) {
+      builder->CreateBr(reject);
+      // Anything after this term is unreachable; keep emitting into a
+      // detached block so that the IR stays well-formed.
+      builder->SetInsertPoint(BasicBlock::Create(context, StrCat("dead", term_idx), f));
+      continue;
+    }
+    if (term.type == PredicateType::IsNull && !col.is_nullable()) {
+      builder->CreateBr(reject);
+      builder->SetInsertPoint(BasicBlock::Create(context, StrCat("dead", term_idx), f));
+      continue;
+    }
+
+    BasicBlock* next = BasicBlock::Create(context, StrCat("term", term_idx, "_pass"), f);
+    if (col.is_nullable()) {
+      Value* null_byte_ptr = builder->CreateConstGEP1_64(src, bitmap_offset + term.col_idx / 8);
+      Value* null_byte = builder->CreateLoad(null_byte_ptr);
+      Value* null_bit = builder->CreateAnd(null_byte, builder->getInt8(1 << (term.col_idx % 8)));
+      Value* is_null = builder->CreateICmpNE(null_bit, builder->getInt8(0));
+      is_null->setName(StrCat("is_null", term.col_idx));
+      if (term.type == PredicateType::IsNull) {
+        builder->CreateCondBr(is_null, next, reject);
+        builder->SetInsertPoint(next);
+        continue;
+      }
+      BasicBlock* not_null = BasicBlock::Create(context, StrCat("term", term_idx, "_not_null"), f);
+      builder->CreateCondBr(is_null, reject, not_null);
+      builder->SetInsertPoint(not_null);
+    }
+    if (term.type == PredicateType::IsNotNull) {
+      builder->CreateBr(next);
+      builder->SetInsertPoint(next);
+      continue;
+    }
+
+    Value* cell_ptr = builder->CreateConstGEP1_64(src, base_schema.column_offset(term.col_idx));
+    cell_ptr->setName(StrCat("cell_ptr", term.col_idx));
+
+    Value* match = builder->getInt1(true);
+    if (type == BINARY) {
+      auto compare = [&](const string& bound) {
+        vector<Value*> args = {
+          cell_ptr,
+          mbuilder->GetPointerValue(const_cast<char*>(bound.data())),
+          builder->getInt64(bound.size())
+        };
+        return builder->CreateCall(compare_slice, args);
+      };
+      Value* zero = builder->getInt32(0);
+      if (term.type == PredicateType::Equality) {
+        match = builder->CreateICmpEQ(compare(term.lower), zero);
+      } else {
+        DCHECK(term.type == PredicateType::Range);
+        if (term.has_lower) {
+          match = builder->CreateICmpSGE(compare(term.lower), zero);
+        }
+        if (term.has_upper) {
+          match = builder->CreateAnd(match, builder->CreateICmpSLT(compare(term.upper), zero));
+        }
+      }
+    } else {
+      Type* cell_type;
+      switch (type) {
+        case FLOAT: cell_type = builder->getFloatTy(); break;
+        case DOUBLE: cell_type = builder->getDoubleTy(); break;
+        default: cell_type = builder->getIntNTy(col.type_info()->size() * 8); break;
+      }
+      Value* typed_ptr = builder->CreateBitCast(cell_ptr, PointerType::getUnqual(cell_type));
+      Value* cell = builder->CreateLoad(typed_ptr);
+      cell->setName(StrCat("cell", term.col_idx));
+      if (term.type == PredicateType::Equality) {
+        match = CreateEqual(builder, type, cell, MakeConstant(builder, type, term.lower));
+      } else {
+        DCHECK(term.type == PredicateType::Range);
+        if (term.has_lower) {
+          match = CreateGreaterOrEqual(builder, type, cell,
+                                       MakeConstant(builder, type, term.lower));
+        }
+        if (term.has_upper) {
+          match = builder->CreateAnd(match, CreateLessThan(builder, type, cell,
+                                                           MakeConstant(builder, type,
+                                                                        term.upper)));
+        }
+      }
+    }
+    match->setName(StrCat("match", term_idx));
+    builder->CreateCondBr(match, next, reject);
+    builder->SetInsertPoint(next);
+  }
+  builder->CreateRet(builder->getInt1(true));
+
+  if (FLAGS_codegen_dump_functions) {
+    LOG(INFO) << "Dumping row predicate:";
+    f->dump();
+  }
+
+  return f;
+}
+
+// Convenience method which appends to a faststring
+template<typename T>
+void AddNext(faststring* fs, const T& val) {
+  fs->append(&val, sizeof(T));
+}
+
+void AddNextString(faststring* fs, const string& val) {
+  AddNext(fs, val.size());
+  fs->append(val.data(), val.size());
+}
+
+} // anonymous namespace
+
+Status RowPredicateFunctions::MakeTerms(const Schema& base_schema,
+                                        const vector<ColumnPredicate>& predicates,
+                                        vector<RowPredicateTerm>* terms) {
+  terms->clear();
+  terms->reserve(predicates.size());
+  for (const ColumnPredicate& pred : predicates) {
+    int col_idx = base_schema.find_column(pred.column().name());
+    if (col_idx == Schema::kColumnNotFound) {
+      return Status::NotFound("predicate column not in base schema", pred.column().name());
+    }
+    const ColumnSchema& col = base_schema.column(col_idx);
+    if (!col.EqualsPhysicalType(pred.column()) ||
+        !IsSupportedType(col.type_info()->physical_type())) {
+      return Status::NotSupported("cannot compile predicate", pred.ToString());
+    }
+    switch (pred.predicate_type()) {
+      case PredicateType::None:
+      case PredicateType::Equality:
+      case PredicateType::Range:
+      case PredicateType::IsNotNull:
+      case PredicateType::IsNull:
+        break;
+      default:
+        return Status::NotSupported("cannot compile predicate", pred.ToString());
+    }
+    terms->push_back({ static_cast<size_t>(col_idx),
+                       pred.predicate_type(),
+                       pred.raw_lower() != nullptr,
+                       pred.raw_upper() != nullptr,
+                       BoundBytes(col.type_info(), pred.raw_lower()),
+                       BoundBytes(col.type_info(), pred.raw_upper()) });
+  }
+  return Status::OK();
+}
+
+RowPredicateFunctions::RowPredicateFunctions(const Schema& base_schema,
+                                             unique_ptr<const vector<RowPredicateTerm>> terms,
+                                             PredicateFunction f,
+                                             unique_ptr<JITCodeOwner> owner)
+  : JITWrapper(std::move(owner)),
+    base_schema_(base_schema),
+    terms_(std::move(terms)),
+    f_(f) {
+  CHECK(f != nullptr)
+    << "Promise to compile predicate function not fulfilled by ModuleBuilder";
+}
+
+Status RowPredicateFunctions::Create(const Schema& base_schema,
+                                     vector<RowPredicateTerm> terms,
+                                     scoped_refptr<RowPredicateFunctions>* out,
+                                     llvm::TargetMachine** tm) {
+  for (const RowPredicateTerm& term : terms) {
+    if (term.col_idx >= base_schema.num_columns()) {
+      return Status::InvalidArgument(
+          Substitute("predicate on column $0 of a schema with $1 columns",
+                     term.col_idx, base_schema.num_columns()));
+    }
+  }
+
+  ModuleBuilder builder;
+  RETURN_NOT_OK(builder.Init());
+
+  unique_ptr<const vector<RowPredicateTerm>> owned_terms(
+      new vector<RowPredicateTerm>(std::move(terms)));
+  Function* eval = MakePredicate("RowPredicate", &builder, base_schema, *owned_terms);
+
+  PredicateFunction f;
+  builder.AddJITPromise(eval, &f);
+
+  unique_ptr<JITCodeOwner> owner;
+  RETURN_NOT_OK(builder.Compile(&owner));
+
+  if (tm) {
+    *tm = builder.GetTargetMachine();
+  }
+  out->reset(new RowPredicateFunctions(base_schema, std::move(owned_terms), f,
+                                       std::move(owner)));
+  return Status::OK();
+}
+
+// Generates the code cache key for a conjunction over a base schema, encoded
+// as follows, in sequence.
+//
+// (1 byte) unique type identifier for RowPredicateFunctions
+// (8 bytes) number, as unsigned long, of base columns
+// (5 bytes each) base column types, in order
+//   4 bytes for enum type
+//   1 byte for nullability
+// (8 bytes) number, as unsigned long, of terms
+// (variable size) terms, in order
+//   8 bytes for the column index
+//   4 bytes for the predicate type
+//   1 byte each for the presence of the lower and upper bounds
+//   8 bytes for the lower bound size, followed by its data
+//   8 bytes for the upper bound size, followed by its data
+//
+// The column offsets are a function of the column types, so two schemas with
+// the same key share a layout. Bounds are part of the key because they are
+// compiled into the function as constants.
+//
+// Writes to 'out' upon success.
+Status RowPredicateFunctions::EncodeKey(const Schema& base,
+                                       const vector<RowPredicateTerm>& terms,
+                                       faststring* out) {
+  AddNext(out, JITWrapper::ROW_PREDICATE);
+  AddNext(out, base.num_columns());
+  for (const ColumnSchema& col : base.columns()) {
+    AddNext(out, col.type_info()->physical_type());
+    AddNext(out, col.is_nullable());
+  }
+  AddNext(out, terms.size());
+  for (const RowPredicateTerm& term : terms) {
+    AddNext(out, term.col_idx);
+    AddNext(out, term.type);
+    AddNext(out, term.has_lower);
+    AddNext(out, term.has_upper);
+    AddNextString(out, term.lower);
+    AddNextString(out, term.upper);
+  }
+  return Status::OK();
+}
+
+} // namespace codegen
+} // namespace kudu
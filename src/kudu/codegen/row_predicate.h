@@ -0,0 +1,139 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef KUDU_CODEGEN_ROW_PREDICATE_H
+#define KUDU_CODEGEN_ROW_PREDICATE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "kudu/codegen/jit_wrapper.h"
+#include "kudu/common/column_predicate.h"
+#include "kudu/common/schema.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/port.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/util/status.h"
+
+namespace llvm {
+class TargetMachine;
+} // namespace llvm
+
+namespace kudu {
+
+class faststring;
+
+namespace codegen {
+
+// One term of a compiled conjunction: a predicate over a single column of
+// the base schema. The bounds are copied out of the originating
+// ColumnPredicate so that a term (and the code compiled from it) may outlive
+// the scan which requested it. For BINARY columns the bounds hold the slice
+// data; for all other types they hold the in-memory cell.
+struct RowPredicateTerm {
+  size_t col_idx;
+  PredicateType type;
+  bool has_lower;
+  bool has_upper;
+  std::string lower;
+  std::string upper;
+};
+
+// The code-generated evaluation of a conjunction of column predicates over
+// contiguous rows of a fixed base schema. Only None, Equality, Range,
+// IsNotNull and IsNull predicates over fixed-width or BINARY columns
+// are compiled; other predicates fall back to the interpreted path.
+class RowPredicateFunctions : public JITWrapper {
+ public:
+  // Converts 'predicates', which are over columns of 'base_schema' as
+  // looked up by name, into the terms of a conjunction.
+  // Returns Status::NotSupported if any of the predicates cannot be compiled.
+  static Status MakeTerms(const Schema& base_schema,
+                          const std::vector<ColumnPredicate>& predicates,
+                          std::vector<RowPredicateTerm>* terms);
+
+  // Compiles the conjunction of 'terms' over rows of 'base_schema'.
+  // Writes the llvm::TargetMachine* used to 'tm' (if not NULL)
+  // and the function to 'out' upon success.
+  static Status Create(const Schema& base_schema,
+                       std::vector<RowPredicateTerm> terms,
+                       scoped_refptr<RowPredicateFunctions>* out,
+                       llvm::TargetMachine** tm = NULL);
+
+  const Schema& base_schema() { return base_schema_; }
+
+  // Returns whether the contiguous row pointed to by the argument
+  // satisfies every term of the conjunction.
+  typedef bool(*PredicateFunction)(const uint8_t*);
+  PredicateFunction function() const { return f_; }
+
+  virtual Status EncodeOwnKey(faststring* out) OVERRIDE {
+    return EncodeKey(base_schema_, *terms_, out);
+  }
+
+  static Status EncodeKey(const Schema& base,
+                          const std::vector<RowPredicateTerm>& terms,
+                          faststring* out);
+
+ private:
+  RowPredicateFunctions(const Schema& base_schema,
+                        std::unique_ptr<const std::vector<RowPredicateTerm>> terms,
+                        PredicateFunction f,
+                        std::unique_ptr<JITCodeOwner> owner);
+
+  const Schema base_schema_;
+
+  // The compiled code refers to the BINARY bounds in place, so the terms
+  // are heap-allocated to keep their addresses stable.
+  const std::unique_ptr<const std::vector<RowPredicateTerm>> terms_;
+  const PredicateFunction f_;
+};
+
+// Evaluates a code-generated conjunction of predicates on rows of the
+// base schema it was compiled for.
+class RowPredicate {
+ public:
+  // Requires that 'base_schema' remains valid for the lifetime of this
+  // object, and that it is compatible with the schema used to
+  // create 'functions'.
+  RowPredicate(const Schema* base_schema,
+               const scoped_refptr<RowPredicateFunctions>& functions)
+    : base_schema_(base_schema),
+      functions_(functions) {}
+
+  template<class ContiguousRowType>
+  bool Evaluate(const ContiguousRowType& row) const {
+    DCHECK_SCHEMA_EQ(*base_schema_, *row.schema());
+    return functions_->function()(row.row_data());
+  }
+
+ private:
+  const Schema* const base_schema_;
+  scoped_refptr<RowPredicateFunctions> functions_;
+
+  DISALLOW_COPY_AND_ASSIGN(RowPredicate);
+};
+
+} // namespace codegen
+} // namespace kudu
+
+#endif
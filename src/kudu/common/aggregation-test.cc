@@ -0,0 +1,270 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/common/aggregation.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "kudu/common/common.pb.h"
+#include "kudu/common/partial_row.h"
+#include "kudu/common/rowblock.h"
+#include "kudu/common/schema.h"
+#include "kudu/gutil/stl_util.h"
+#include "kudu/util/memory/arena.h"
+#include "kudu/util/slice.h"
+#include "kudu/util/status.h"
+#include "kudu/util/test_macros.h"
+#include "kudu/util/test_util.h"
+
+using google::protobuf::RepeatedPtrField;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+namespace kudu {
+
+static const int kBlockCapacity = 10;
+
+class AggregationTest : public KuduTest {
+ public:
+  AggregationTest()
+      : schema_({ ColumnSchema("host", STRING),
+                  ColumnSchema("ts", INT32),
+                  ColumnSchema("val", INT64, true),
+                  ColumnSchema("d", DOUBLE) },
+                2),
+        arena_(1024) {
+  }
+
+ protected:
+  struct TestRow {
+    const char* host;
+    int32_t ts;
+    // Negative values are NULL.
+    int64_t val;
+    double d;
+  };
+
+  // Fills 'block' with 'rows', selecting all of them.
+  void FillBlock(const vector<TestRow>& rows, RowBlock* block) {
+    block->Resize(rows.size());
+    block->selection_vector()->SetAllTrue();
+    for (int i = 0; i < rows.size(); i++) {
+      RowBlockRow row = block->row(i);
+      *reinterpret_cast<Slice*>(row.mutable_cell_ptr(0)) = Slice(rows[i].host);
+      *reinterpret_cast<int32_t*>(row.mutable_cell_ptr(1)) = rows[i].ts;
+      row.cell(2).set_null(rows[i].val < 0);
+      *reinterpret_cast<int64_t*>(row.mutable_cell_ptr(2)) = rows[i].val;
+      *reinterpret_cast<double*>(row.mutable_cell_ptr(3)) = rows[i].d;
+    }
+  }
+
+  static AggregationSpecPB::Aggregate* AddAggregate(AggregationSpecPB* spec,
+                                                    AggregationSpecPB::Function function,
+                                                    const string& column) {
+    auto* agg = spec->add_aggregates();
+    agg->set_function(function);
+    if (!column.empty()) {
+      agg->set_column(column);
+    }
+    return agg;
+  }
+
+  Schema schema_;
+  Arena arena_;
+};
+
+TEST_F(AggregationTest, TestWithoutGroupBy) {
+  AggregationSpecPB spec;
+  AddAggregate(&spec, AggregationSpecPB::COUNT, "");
+  AddAggregate(&spec, AggregationSpecPB::COUNT, "val");
+  AddAggregate(&spec, AggregationSpecPB::SUM, "val");
+  AddAggregate(&spec, AggregationSpecPB::MIN, "host");
+  AddAggregate(&spec, AggregationSpecPB::MAX, "val");
+  AddAggregate(&spec, AggregationSpecPB::SUM, "d");
+  unique_ptr<ScanAggregator> aggregator;
+  ASSERT_OK(ScanAggregator::Create(spec, schema_, &aggregator));
+  const Schema& result_schema = aggregator->result_schema();
+  ASSERT_EQ(6, result_schema.num_columns());
+  ASSERT_EQ("count(*)", result_schema.column(0).name());
+  ASSERT_EQ("sum(val)", result_schema.column(2).name());
+  ASSERT_EQ(STRING, result_schema.column(3).type_info()->type());
+  ASSERT_EQ(DOUBLE, result_schema.column(5).type_info()->type());
+
+  RowBlock block(schema_, kBlockCapacity, &arena_);
+  FillBlock({ { "b", 1, 10, 0.5 },
+              { "a", 2, -1, 1.5 },
+              { "c", 3, 30, 2.0 },
+              { "a", 4, 100, 4.0 } }, &block);
+  // Deselected rows, e.g. deleted ones, aren't aggregated.
+  block.selection_vector()->SetRowUnselected(3);
+  aggregator->AddRowBlock(block);
+  FillBlock({ { "d", 5, 5, 1.0 } }, &block);
+  aggregator->AddRowBlock(block);
+
+  vector<KuduPartialRow*> rows;
+  ElementDeleter d(&rows);
+  aggregator->GetResultRows(&rows);
+  ASSERT_EQ(1, rows.size());
+  int64_t i64;
+  ASSERT_OK(rows[0]->GetInt64(0, &i64));
+  ASSERT_EQ(4, i64);
+  ASSERT_OK(rows[0]->GetInt64(1, &i64));
+  ASSERT_EQ(3, i64);
+  ASSERT_OK(rows[0]->GetInt64(2, &i64));
+  ASSERT_EQ(45, i64);
+  Slice s;
+  ASSERT_OK(rows[0]->GetString(3, &s));
+  ASSERT_EQ("a", s.ToString());
+  ASSERT_OK(rows[0]->GetInt64(4, &i64));
+  ASSERT_EQ(30, i64);
+  double dbl;
+  ASSERT_OK(rows[0]->GetDouble(5, &dbl));
+  ASSERT_DOUBLE_EQ(5.0, dbl);
+}
+
+// Without any group-by column, an aggregation of no rows still has one
+// result row.
+TEST_F(AggregationTest, TestNoRows) {
+  AggregationSpecPB spec;
+  AddAggregate(&spec, AggregationSpecPB::COUNT, "");
+  AddAggregate(&spec, AggregationSpecPB::SUM, "val");
+  AddAggregate(&spec, AggregationSpecPB::MAX, "ts");
+  unique_ptr<ScanAggregator> aggregator;
+  ASSERT_OK(ScanAggregator::Create(spec, schema_, &aggregator));
+
+  RepeatedPtrField<AggregateGroupPB> groups;
+  aggregator->TakeResults(&groups);
+  ASSERT_EQ(0, groups.size());
+
+  vector<KuduPartialRow*> rows;
+  ElementDeleter d(&rows);
+  aggregator->GetResultRows(&rows);
+  ASSERT_EQ(1, rows.size());
+  int64_t count;
+  ASSERT_OK(rows[0]->GetInt64(0, &count));
+  ASSERT_EQ(0, count);
+  ASSERT_TRUE(rows[0]->IsNull(1));
+  ASSERT_TRUE(rows[0]->IsNull(2));
+}
+
+// Partial results of several aggregators, as computed by tablet servers,
+// merge into the same result as a single aggregation over all the rows.
+TEST_F(AggregationTest, TestGroupByAndMerge) {
+  AggregationSpecPB spec;
+  spec.set_group_by_key_prefix_len(1);
+  AddAggregate(&spec, AggregationSpecPB::COUNT, "");
+  AddAggregate(&spec, AggregationSpecPB::SUM, "val");
+  AddAggregate(&spec, AggregationSpecPB::MIN, "ts");
+  AddAggregate(&spec, AggregationSpecPB::MAX, "d");
+
+  vector<vector<TestRow>> tablets = {
+    { { "a", 1, 1, 1.0 }, { "a", 2, 2, 3.0 }, { "b", 1, -1, 2.0 } },
+    { { "b", 2, 5, 9.0 }, { "c", 7, 3, 0.5 } },
+    { { "a", 0, 4, 2.0 } },
+  };
+  RepeatedPtrField<AggregateGroupPB> groups;
+  for (const auto& tablet_rows : tablets) {
+    unique_ptr<ScanAggregator> tablet_aggregator;
+    ASSERT_OK(ScanAggregator::Create(spec, schema_, &tablet_aggregator));
+    RowBlock block(schema_, kBlockCapacity, &arena_);
+    FillBlock(tablet_rows, &block);
+    tablet_aggregator->AddRowBlock(block);
+    ASSERT_GT(tablet_aggregator->EstimatedResultSize(), 0);
+    tablet_aggregator->TakeResults(&groups);
+    ASSERT_EQ(0, tablet_aggregator->EstimatedResultSize());
+  }
+  ASSERT_EQ(5, groups.size());
+
+  unique_ptr<ScanAggregator> aggregator;
+  ASSERT_OK(ScanAggregator::Create(spec, schema_, &aggregator));
+  ASSERT_OK(aggregator->MergeFrom(groups));
+
+  vector<KuduPartialRow*> rows;
+  ElementDeleter d(&rows);
+  aggregator->GetResultRows(&rows);
+  ASSERT_EQ(3, rows.size());
+  ASSERT_EQ("string host=\"a\", int64 count(*)=3, int64 sum(val)=7, "
+            "int32 min(ts)=0, double max(d)=3",
+            rows[0]->ToString());
+  ASSERT_EQ("string host=\"b\", int64 count(*)=2, int64 sum(val)=5, "
+            "int32 min(ts)=1, double max(d)=9",
+            rows[1]->ToString());
+  ASSERT_EQ("string host=\"c\", int64 count(*)=1, int64 sum(val)=3, "
+            "int32 min(ts)=7, double max(d)=0.5",
+            rows[2]->ToString());
+
+  // Partial results which don't match the aggregation are rejected.
+  groups.Mutable(0)->add_key_values("x");
+  Status s = aggregator->MergeFrom(groups);
+  ASSERT_TRUE(s.IsCorruption()) << s.ToString();
+}
+
+TEST_F(AggregationTest, TestInvalidSpecs) {
+  const auto check_invalid = [&](const AggregationSpecPB& spec) {
+    unique_ptr<ScanAggregator> aggregator;
+    Status s = ScanAggregator::Create(spec, schema_, &aggregator);
+    ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+  };
+
+  // Nothing to aggregate.
+  check_invalid(AggregationSpecPB());
+  {
+    AggregationSpecPB spec;
+    AddAggregate(&spec, AggregationSpecPB::SUM, "host");
+    check_invalid(spec);
+  }
+  {
+    AggregationSpecPB spec;
+    AddAggregate(&spec, AggregationSpecPB::MIN, "");
+    check_invalid(spec);
+  }
+  {
+    AggregationSpecPB spec;
+    AddAggregate(&spec, AggregationSpecPB::COUNT, "missing");
+    check_invalid(spec);
+  }
+  {
+    AggregationSpecPB spec;
+    AddAggregate(&spec, AggregationSpecPB::UNKNOWN_FUNCTION, "val");
+    check_invalid(spec);
+  }
+  {
+    AggregationSpecPB spec;
+    AddAggregate(&spec, AggregationSpecPB::MAX, "val");
+    AddAggregate(&spec, AggregationSpecPB::MAX, "val");
+    check_invalid(spec);
+  }
+  {
+    // 'val' is nullable.
+    AggregationSpecPB spec;
+    spec.set_group_by_key_prefix_len(3);
+    check_invalid(spec);
+  }
+  {
+    AggregationSpecPB spec;
+    spec.set_group_by_key_prefix_len(5);
+    check_invalid(spec);
+  }
+}
+
+} // namespace kudu
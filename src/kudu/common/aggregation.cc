@@ -0,0 +1,460 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/common/aggregation.h"
+
+#include <ostream>
+#include <unordered_set>
+#include <utility>
+
+#include <glog/logging.h>
+
+#include "kudu/common/columnblock.h"
+#include "kudu/common/key_encoder.h"
+#include "kudu/common/partial_row.h"
+#include "kudu/common/rowblock.h"
+#include "kudu/common/types.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/slice.h"
+
+using google::protobuf::RepeatedPtrField;
+using std::string;
+using std::unique_ptr;
+using std::unordered_set;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+
+namespace {
+
+// Rough per-value overhead of a serialized AggregateGroupPB.
+const int64_t kValueOverheadBytes = 16;
+
+bool IsSummable(DataType type) {
+  switch (type) {
+    case INT8:
+    case INT16:
+    case INT32:
+    case INT64:
+    case FLOAT:
+    case DOUBLE:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool IsFloatingPoint(DataType type) {
+  return type == FLOAT || type == DOUBLE;
+}
+
+// Encodes the cell pointed to by 'cell' into 'dst' as the bound of a
+// ColumnPredicatePB::Range.
+void EncodeCell(const TypeInfo* type, const void* cell, string* dst) {
+  if (type->physical_type() == BINARY) {
+    const Slice* s = reinterpret_cast<const Slice*>(cell);
+    dst->assign(reinterpret_cast<const char*>(s->data()), s->size());
+  } else {
+    dst->assign(reinterpret_cast<const char*>(cell), type->size());
+  }
+}
+
+// Returns a pointer to a cell holding 'value', which was encoded with
+// EncodeCell(). For binary types, the cell is stored in 'slice'.
+const void* DecodeCell(const TypeInfo* type, const string& value, Slice* slice) {
+  if (type->physical_type() == BINARY) {
+    *slice = Slice(value);
+    return slice;
+  }
+  return value.data();
+}
+
+Status CheckEncodedCell(const TypeInfo* type, const string& value) {
+  if (type->physical_type() != BINARY && value.size() != type->size()) {
+    return Status::Corruption(Substitute("bad $0 value in aggregate results: $1 bytes",
+                                         type->name(), value.size()));
+  }
+  return Status::OK();
+}
+
+string AggregateColumnName(const AggregationSpecPB::Aggregate& agg) {
+  string function = AggregationSpecPB::Function_Name(agg.function());
+  for (char& c : function) {
+    c = tolower(c);
+  }
+  return Substitute("$0($1)", function, agg.has_column() ? agg.column() : "*");
+}
+
+} // anonymous namespace
+
+Status ScanAggregator::Create(const AggregationSpecPB& spec,
+                              const Schema& projection,
+                              unique_ptr<ScanAggregator>* aggregator) {
+  if (spec.aggregates_size() == 0 && spec.group_by_key_prefix_len() == 0) {
+    return Status::InvalidArgument("aggregation has no aggregates nor group-by columns");
+  }
+  if (spec.group_by_key_prefix_len() > projection.num_columns()) {
+    return Status::InvalidArgument(Substitute(
+        "cannot group by $0 columns of a projection with $1 columns",
+        spec.group_by_key_prefix_len(), projection.num_columns()));
+  }
+
+  vector<ColumnSchema> result_cols;
+  for (int i = 0; i < spec.group_by_key_prefix_len(); i++) {
+    const ColumnSchema& col = projection.column(i);
+    if (col.is_nullable()) {
+      return Status::InvalidArgument("cannot group by nullable column", col.name());
+    }
+    result_cols.emplace_back(col.name(), col.type_info()->type());
+  }
+
+  vector<Aggregate> aggregates;
+  unordered_set<string> agg_names;
+  for (const auto& agg_pb : spec.aggregates()) {
+    Aggregate agg;
+    agg.function = agg_pb.function();
+    agg.col_idx = -1;
+    agg.type = nullptr;
+    if (agg_pb.has_column()) {
+      agg.col_idx = projection.find_column(agg_pb.column());
+      if (agg.col_idx == Schema::kColumnNotFound) {
+        return Status::InvalidArgument("aggregated column is not projected", agg_pb.column());
+      }
+      agg.type = projection.column(agg.col_idx).type_info();
+    }
+
+    DataType result_type;
+    bool result_nullable = true;
+    switch (agg.function) {
+      case AggregationSpecPB::COUNT:
+        result_type = INT64;
+        result_nullable = false;
+        break;
+      case AggregationSpecPB::SUM:
+        if (!agg.type || !IsSummable(agg.type->type())) {
+          return Status::InvalidArgument(
+              "SUM requires an integer or floating point column", agg_pb.column());
+        }
+        result_type = IsFloatingPoint(agg.type->type()) ? DOUBLE : INT64;
+        break;
+      case AggregationSpecPB::MIN:
+      case AggregationSpecPB::MAX:
+        if (!agg.type) {
+          return Status::InvalidArgument(Substitute(
+              "$0 requires a column", AggregationSpecPB::Function_Name(agg.function)));
+        }
+        result_type = agg.type->type();
+        break;
+      default:
+        return Status::InvalidArgument(Substitute("unknown aggregate function: $0",
+                                                  agg.function));
+    }
+
+    string name = AggregateColumnName(agg_pb);
+    if (!agg_names.insert(name).second) {
+      return Status::InvalidArgument("duplicate aggregate", name);
+    }
+    result_cols.emplace_back(std::move(name), result_type, result_nullable);
+    aggregates.push_back(agg);
+  }
+
+  Schema result_schema;
+  RETURN_NOT_OK(result_schema.Reset(result_cols, spec.group_by_key_prefix_len()));
+
+  aggregator->reset(new ScanAggregator(std::move(aggregates),
+                                       spec.group_by_key_prefix_len(),
+                                       projection,
+                                       std::move(result_schema)));
+  return Status::OK();
+}
+
+ScanAggregator::ScanAggregator(vector<Aggregate> aggregates,
+                               int group_by_key_prefix_len,
+                               Schema projection,
+                               Schema result_schema)
+    : aggregates_(std::move(aggregates)),
+      group_by_key_prefix_len_(group_by_key_prefix_len),
+      projection_(std::move(projection)),
+      result_schema_(std::move(result_schema)),
+      result_size_(0) {
+}
+
+ScanAggregator::Group* ScanAggregator::LookupOrInsertGroup(const Slice& encoded_key,
+                                                          vector<string> key_values) {
+  auto it = groups_.lower_bound(encoded_key.ToString());
+  if (it != groups_.end() && Slice(it->first) == encoded_key) {
+    return &it->second;
+  }
+  result_size_ += encoded_key.size() + kValueOverheadBytes * aggregates_.size();
+  it = groups_.emplace_hint(it, encoded_key.ToString(), Group());
+  it->second.key_values = std::move(key_values);
+  it->second.accumulators.resize(aggregates_.size());
+  return &it->second;
+}
+
+void ScanAggregator::Accumulate(const Aggregate& agg, const void* cell, Accumulator* acc) {
+  acc->count++;
+  switch (agg.function) {
+    case AggregationSpecPB::COUNT:
+      break;
+    case AggregationSpecPB::SUM: {
+      // Integer sums wrap around on overflow rather than invoking undefined
+      // behavior.
+      uint64_t int_sum = static_cast<uint64_t>(acc->int_sum);
+      switch (agg.type->physical_type()) {
+        case INT8:
+          int_sum += *reinterpret_cast<const int8_t*>(cell);
+          break;
+        case INT16:
+          int_sum += *reinterpret_cast<const int16_t*>(cell);
+          break;
+        case INT32:
+          int_sum += *reinterpret_cast<const int32_t*>(cell);
+          break;
+        case INT64:
+          int_sum += *reinterpret_cast<const int64_t*>(cell);
+          break;
+        case FLOAT:
+          acc->double_sum += *reinterpret_cast<const float*>(cell);
+          break;
+        case DOUBLE:
+          acc->double_sum += *reinterpret_cast<const double*>(cell);
+          break;
+        default:
+          LOG(FATAL) << "unexpected type for SUM: " << agg.type->name();
+      }
+      acc->int_sum = static_cast<int64_t>(int_sum);
+      break;
+    }
+    case AggregationSpecPB::MIN:
+    case AggregationSpecPB::MAX:
+      MaybeUpdateExtremum(agg, cell, acc);
+      break;
+    default:
+      LOG(FATAL) << "unexpected aggregate function: " << agg.function;
+  }
+}
+
+void ScanAggregator::MaybeUpdateExtremum(const Aggregate& agg,
+                                         const void* cell,
+                                         Accumulator* acc) {
+  if (acc->has_extremum) {
+    Slice slice;
+    int cmp = agg.type->Compare(cell, DecodeCell(agg.type, acc->extremum, &slice));
+    if (agg.function == AggregationSpecPB::MIN ? cmp >= 0 : cmp <= 0) {
+      return;
+    }
+  }
+  EncodeCell(agg.type, cell, &acc->extremum);
+  acc->has_extremum = true;
+}
+
+void ScanAggregator::AddRowBlock(const RowBlock& block) {
+  const SelectionVector* sel = block.selection_vector();
+
+  if (group_by_key_prefix_len_ == 0) {
+    // Without grouping, evaluate each aggregate one column at a time.
+    if (!sel->AnySelected()) {
+      return;
+    }
+    Group* group = LookupOrInsertGroup(Slice(), {});
+    for (int i = 0; i < aggregates_.size(); i++) {
+      const Aggregate& agg = aggregates_[i];
+      Accumulator* acc = &group->accumulators[i];
+      if (agg.col_idx < 0) {
+        acc->count += sel->CountSelected();
+        continue;
+      }
+      ColumnBlock col = block.column_block(agg.col_idx);
+      for (size_t row = 0; row < block.nrows(); row++) {
+        if (!sel->IsRowSelected(row) || (col.is_nullable() && col.is_null(row))) {
+          continue;
+        }
+        Accumulate(agg, col.cell_ptr(row), acc);
+      }
+    }
+    return;
+  }
+
+  // Rows of the same group are usually adjacent, since the rows of each
+  // rowset are sorted by primary key, so avoid looking up the group of
+  // every row.
+  Group* group = nullptr;
+  faststring prev_key;
+  for (size_t row_idx = 0; row_idx < block.nrows(); row_idx++) {
+    if (!sel->IsRowSelected(row_idx)) {
+      continue;
+    }
+    RowBlockRow row = block.row(row_idx);
+    key_buf_.clear();
+    for (int i = 0; i < group_by_key_prefix_len_; i++) {
+      const TypeInfo* type = projection_.column(i).type_info();
+      GetKeyEncoder<faststring>(type).Encode(
+          row.cell_ptr(i), i == group_by_key_prefix_len_ - 1, &key_buf_);
+    }
+    if (group == nullptr || Slice(key_buf_) != Slice(prev_key)) {
+      vector<string> key_values(group_by_key_prefix_len_);
+      for (int i = 0; i < group_by_key_prefix_len_; i++) {
+        EncodeCell(projection_.column(i).type_info(), row.cell_ptr(i), &key_values[i]);
+      }
+      group = LookupOrInsertGroup(Slice(key_buf_), std::move(key_values));
+      prev_key.assign_copy(key_buf_.data(), key_buf_.size());
+    }
+
+    for (int i = 0; i < aggregates_.size(); i++) {
+      const Aggregate& agg = aggregates_[i];
+      Accumulator* acc = &group->accumulators[i];
+      if (agg.col_idx < 0) {
+        acc->count++;
+        continue;
+      }
+      if (projection_.column(agg.col_idx).is_nullable() && row.is_null(agg.col_idx)) {
+        continue;
+      }
+      Accumulate(agg, row.cell_ptr(agg.col_idx), acc);
+    }
+  }
+}
+
+Status ScanAggregator::MergeFrom(const RepeatedPtrField<AggregateGroupPB>& groups) {
+  for (const auto& group_pb : groups) {
+    if (group_pb.key_values_size() != group_by_key_prefix_len_ ||
+        group_pb.values_size() != aggregates_.size()) {
+      return Status::Corruption(Substitute(
+          "aggregate results have $0 key values and $1 values, expected $2 and $3",
+          group_pb.key_values_size(), group_pb.values_size(),
+          group_by_key_prefix_len_, aggregates_.size()));
+    }
+
+    key_buf_.clear();
+    for (int i = 0; i < group_by_key_prefix_len_; i++) {
+      const TypeInfo* type = projection_.column(i).type_info();
+      RETURN_NOT_OK(CheckEncodedCell(type, group_pb.key_values(i)));
+      Slice slice;
+      GetKeyEncoder<faststring>(type).Encode(
+          DecodeCell(type, group_pb.key_values(i), &slice),
+          i == group_by_key_prefix_len_ - 1, &key_buf_);
+    }
+    Group* group = LookupOrInsertGroup(
+        Slice(key_buf_),
+        vector<string>(group_pb.key_values().begin(), group_pb.key_values().end()));
+
+    for (int i = 0; i < aggregates_.size(); i++) {
+      const Aggregate& agg = aggregates_[i];
+      const AggregateGroupPB::Value& value = group_pb.values(i);
+      Accumulator* acc = &group->accumulators[i];
+      acc->count += value.count();
+      acc->int_sum = static_cast<int64_t>(static_cast<uint64_t>(acc->int_sum) +
+                                          static_cast<uint64_t>(value.int_sum()));
+      acc->double_sum += value.double_sum();
+      if (value.has_extremum()) {
+        if (agg.function != AggregationSpecPB::MIN && agg.function != AggregationSpecPB::MAX) {
+          return Status::Corruption("unexpected extremum in aggregate results");
+        }
+        RETURN_NOT_OK(CheckEncodedCell(agg.type, value.extremum()));
+        Slice slice;
+        MaybeUpdateExtremum(agg, DecodeCell(agg.type, value.extremum(), &slice), acc);
+      }
+    }
+  }
+  return Status::OK();
+}
+
+void ScanAggregator::TakeResults(RepeatedPtrField<AggregateGroupPB>* groups) {
+  groups->Reserve(groups->size() + groups_.size());
+  for (auto& entry : groups_) {
+    Group& group = entry.second;
+    AggregateGroupPB* group_pb = groups->Add();
+    for (auto& key_value : group.key_values) {
+      group_pb->add_key_values()->swap(key_value);
+    }
+    for (int i = 0; i < aggregates_.size(); i++) {
+      const Aggregate& agg = aggregates_[i];
+      Accumulator& acc = group.accumulators[i];
+      AggregateGroupPB::Value* value = group_pb->add_values();
+      value->set_count(acc.count);
+      if (agg.function == AggregationSpecPB::SUM) {
+        if (IsFloatingPoint(agg.type->type())) {
+          value->set_double_sum(acc.double_sum);
+        } else {
+          value->set_int_sum(acc.int_sum);
+        }
+      }
+      if (acc.has_extremum) {
+        value->mutable_extremum()->swap(acc.extremum);
+      }
+    }
+  }
+  groups_.clear();
+  result_size_ = 0;
+}
+
+void ScanAggregator::GetResultRows(vector<KuduPartialRow*>* rows) const {
+  // Without any group-by column, an empty aggregation still has a result,
+  // e.g. a zero COUNT.
+  Group empty_group;
+  empty_group.accumulators.resize(aggregates_.size());
+  std::map<string, Group> no_groups;
+  const std::map<string, Group>* groups = &groups_;
+  if (group_by_key_prefix_len_ == 0 && groups_.empty()) {
+    no_groups.emplace(string(), std::move(empty_group));
+    groups = &no_groups;
+  }
+
+  for (const auto& entry : *groups) {
+    const Group& group = entry.second;
+    unique_ptr<KuduPartialRow> row(new KuduPartialRow(&result_schema_));
+    for (int i = 0; i < group_by_key_prefix_len_; i++) {
+      Slice slice;
+      const TypeInfo* type = projection_.column(i).type_info();
+      CHECK_OK(row->Set(i, reinterpret_cast<const uint8_t*>(
+          DecodeCell(type, group.key_values[i], &slice))));
+    }
+    for (int i = 0; i < aggregates_.size(); i++) {
+      const Aggregate& agg = aggregates_[i];
+      const Accumulator& acc = group.accumulators[i];
+      int col_idx = group_by_key_prefix_len_ + i;
+      switch (agg.function) {
+        case AggregationSpecPB::COUNT:
+          CHECK_OK(row->SetInt64(col_idx, acc.count));
+          break;
+        case AggregationSpecPB::SUM:
+          if (acc.count == 0) {
+            CHECK_OK(row->SetNull(col_idx));
+          } else if (IsFloatingPoint(agg.type->type())) {
+            CHECK_OK(row->SetDouble(col_idx, acc.double_sum));
+          } else {
+            CHECK_OK(row->SetInt64(col_idx, acc.int_sum));
+          }
+          break;
+        default:
+          if (!acc.has_extremum) {
+            CHECK_OK(row->SetNull(col_idx));
+          } else {
+            Slice slice;
+            CHECK_OK(row->Set(col_idx, reinterpret_cast<const uint8_t*>(
+                DecodeCell(agg.type, acc.extremum, &slice))));
+          }
+          break;
+      }
+    }
+    rows->push_back(row.release());
+  }
+}
+
+} // namespace kudu
@@ -0,0 +1,159 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <google/protobuf/repeated_field.h>
+
+#include "kudu/common/common.pb.h"
+#include "kudu/common/schema.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+class KuduPartialRow;
+class RowBlock;
+class TypeInfo;
+
+// Evaluates the aggregates of an AggregationSpecPB over scanned rows, grouped
+// by a prefix of the primary key columns.
+//
+// Tablet servers feed the rows of each scan batch into an aggregator and
+// return its partial results in place of the rows. Clients merge the partial
+// results of every batch, across all tablets, into a single aggregator.
+//
+// This class is not thread-safe.
+class ScanAggregator {
+ public:
+  // Creates an aggregator evaluating 'spec' over rows of 'projection'.
+  //
+  // Returns InvalidArgument if the spec doesn't apply to the projection.
+  static Status Create(const AggregationSpecPB& spec,
+                       const Schema& projection,
+                       std::unique_ptr<ScanAggregator>* aggregator);
+
+  // Accumulates the selected rows of 'block'. The leading columns of the
+  // block's schema must match the projection the aggregator was created with.
+  void AddRowBlock(const RowBlock& block);
+
+  // Merges partial results, as returned by TakeResults().
+  //
+  // Returns Corruption if the results don't match the aggregation.
+  Status MergeFrom(const google::protobuf::RepeatedPtrField<AggregateGroupPB>& groups);
+
+  // Moves the partial results accumulated so far into 'groups', and resets
+  // the aggregator.
+  void TakeResults(google::protobuf::RepeatedPtrField<AggregateGroupPB>* groups);
+
+  // Returns the schema of the rows returned by GetResultRows(): the group-by
+  // columns, followed by one column per aggregate.
+  const Schema& result_schema() const {
+    return result_schema_;
+  }
+
+  // Appends one row per group to 'rows', in group-by key order. Without any
+  // group-by column, there is exactly one row even if no rows were
+  // aggregated. The caller takes ownership of the rows, which reference
+  // result_schema().
+  void GetResultRows(std::vector<KuduPartialRow*>* rows) const;
+
+  // Returns the approximate size in bytes of the results accumulated so far,
+  // once serialized.
+  int64_t EstimatedResultSize() const {
+    return result_size_;
+  }
+
+ private:
+  struct Aggregate {
+    AggregationSpecPB::Function function;
+
+    // The index of the input column in the projection, or -1 for a COUNT of
+    // rows.
+    int col_idx;
+
+    // The type of the input column, if any.
+    const TypeInfo* type;
+  };
+
+  struct Accumulator {
+    Accumulator()
+        : count(0),
+          int_sum(0),
+          double_sum(0),
+          has_extremum(false) {
+    }
+
+    int64_t count;
+    int64_t int_sum;
+    double double_sum;
+
+    // The MIN or MAX so far, encoded as in AggregateGroupPB.
+    bool has_extremum;
+    std::string extremum;
+  };
+
+  struct Group {
+    // The values of the group-by columns, encoded as in AggregateGroupPB.
+    std::vector<std::string> key_values;
+
+    // One accumulator per aggregate.
+    std::vector<Accumulator> accumulators;
+  };
+
+  ScanAggregator(std::vector<Aggregate> aggregates,
+                 int group_by_key_prefix_len,
+                 Schema projection,
+                 Schema result_schema);
+
+  // Returns the group with the given comparable-encoded key, creating it
+  // with 'key_values' if it doesn't exist yet.
+  Group* LookupOrInsertGroup(const Slice& encoded_key,
+                             std::vector<std::string> key_values);
+
+  // Accumulates the non-null 'cell' into 'acc'.
+  static void Accumulate(const Aggregate& agg, const void* cell, Accumulator* acc);
+
+  // Replaces the extremum of 'acc' with 'cell' if it's smaller (for MIN) or
+  // larger (for MAX), or if 'acc' has no extremum yet.
+  static void MaybeUpdateExtremum(const Aggregate& agg, const void* cell, Accumulator* acc);
+
+  const std::vector<Aggregate> aggregates_;
+  const int group_by_key_prefix_len_;
+  const Schema projection_;
+  const Schema result_schema_;
+
+  // The groups, keyed by their comparable-encoded group-by key so that
+  // they're ordered like the primary key.
+  std::map<std::string, Group> groups_;
+
+  int64_t result_size_;
+
+  // Scratch buffer for encoding group-by keys.
+  faststring key_buf_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScanAggregator);
+};
+
+} // namespace kudu
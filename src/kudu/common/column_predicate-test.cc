@@ -19,6 +19,7 @@
 
 #include <cmath>
 #include <cstdint>
+#include <cstring>
 #include <string>
 #include <vector>
 
@@ -26,18 +27,41 @@
 #include <gflags/gflags.h>
 #include <gtest/gtest.h>
 
+#include "kudu/common/columnblock.h"
 #include "kudu/common/common.pb.h"
+#include "kudu/common/rowblock.h"
 #include "kudu/common/schema.h"
 #include "kudu/common/types.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/bitmap.h"
+#include "kudu/util/bloom_filter.h"
 #include "kudu/util/memory/arena.h"
+#include "kudu/util/random.h"
 #include "kudu/util/slice.h"
+#include "kudu/util/test_macros.h"
 #include "kudu/util/test_util.h"
 
+DECLARE_bool(column_predicate_use_simd_kernels);
+
+using std::string;
 using std::vector;
 
 namespace kudu {
 
+// Returns a split-block bloom filter of 'values', a list of cells of the
+// column, which is stored in 'buf'.
+static Slice BuildBloomFilter(const ColumnSchema& column,
+                              const vector<const void*>& values,
+                              string* buf) {
+  BloomFilterBuilder builder(BloomFilterSizing::ByCountAndFPRate(values.size(), 0.01),
+                             SPLIT_BLOCK_BLOOM_FILTER);
+  for (const void* value : values) {
+    builder.AddKey(BloomKeyProbe(ColumnPredicate::BloomFilterKey(column.type_info(), value)));
+  }
+  buf->assign(reinterpret_cast<const char*>(builder.slice().data()), builder.n_bytes());
+  return Slice(*buf);
+}
+
 class TestColumnPredicate : public KuduTest {
  public:
 
@@ -1047,6 +1071,139 @@ TEST_F(TestColumnPredicate, TestInList) {
   }
 }
 
+// Test that IN lists large enough to be evaluated with a hash set of their
+// values match the same values as small ones.
+TEST_F(TestColumnPredicate, TestLargeInList) {
+  {
+    ColumnSchema column("c", INT64);
+    vector<int64_t> list;
+    for (int64_t i = 0; i < 100; i++) {
+      list.push_back(i * 3);
+    }
+    vector<const void*> values;
+    for (const int64_t& v : list) {
+      values.push_back(&v);
+    }
+    ColumnPredicate pred = ColumnPredicate::InList(column, &values);
+    ASSERT_EQ(PredicateType::InList, pred.predicate_type());
+    for (int64_t i = -10; i < 310; i++) {
+      ASSERT_EQ(i >= 0 && i < 300 && i % 3 == 0, pred.EvaluateCell<INT64>(&i)) << i;
+    }
+
+    // Merging retains the values of the list which are in range, and those
+    // may then be looked up.
+    int64_t lower = 30;
+    int64_t upper = 60;
+    ColumnPredicate range = ColumnPredicate::Range(column, &lower, &upper);
+    pred.Merge(range);
+    ASSERT_EQ(PredicateType::InList, pred.predicate_type());
+    ASSERT_EQ(10, pred.raw_values().size());
+    for (int64_t i = 0; i < 100; i++) {
+      ASSERT_EQ(i >= 30 && i < 60 && i % 3 == 0, pred.EvaluateCell<INT64>(&i)) << i;
+    }
+  }
+  {
+    ColumnSchema column("c", STRING);
+    vector<string> list;
+    for (int i = 0; i < 100; i++) {
+      list.push_back(strings::Substitute("v$0", i * 2));
+    }
+    vector<Slice> slices(list.begin(), list.end());
+    vector<const void*> values;
+    for (const Slice& v : slices) {
+      values.push_back(&v);
+    }
+    ColumnPredicate pred = ColumnPredicate::InList(column, &values);
+    ASSERT_EQ(PredicateType::InList, pred.predicate_type());
+    for (int i = 0; i < 200; i++) {
+      string value = strings::Substitute("v$0", i);
+      Slice cell(value);
+      ASSERT_EQ(i % 2 == 0, pred.EvaluateCell<BINARY>(&cell)) << value;
+    }
+
+    Slice present("v10");
+    ColumnPredicate equality = ColumnPredicate::Equality(column, &present);
+    equality.Merge(pred);
+    ASSERT_EQ(PredicateType::Equality, equality.predicate_type());
+    Slice absent("v11");
+    equality = ColumnPredicate::Equality(column, &absent);
+    equality.Merge(pred);
+    ASSERT_EQ(PredicateType::None, equality.predicate_type());
+  }
+}
+
+TEST_F(TestColumnPredicate, TestInBloomFilter) {
+  ColumnSchema column("c", INT32, true);
+  int32_t zero = 0;
+  int32_t five = 5;
+  int32_t ten = 10;
+  int32_t twenty = 20;
+  int32_t thirty = 30;
+  string buf;
+  Slice filter = BuildBloomFilter(column, { &five, &ten, &twenty }, &buf);
+  ColumnPredicate pred = ColumnPredicate::InBloomFilter(column, { filter }, nullptr, nullptr);
+  ASSERT_EQ(PredicateType::InBloomFilter, pred.predicate_type());
+  ASSERT_EQ("`c` IN BLOOM FILTER (1 filters)", pred.ToString());
+  ASSERT_TRUE(pred.EvaluateCell<INT32>(&five));
+  ASSERT_TRUE(pred.EvaluateCell<INT32>(&ten));
+  ASSERT_TRUE(pred.EvaluateCell<INT32>(&twenty));
+
+  // Most of the values which weren't added to the filter don't pass it.
+  int num_passed = 0;
+  for (int32_t i = 1000; i < 11000; i++) {
+    num_passed += pred.EvaluateCell<INT32>(&i);
+  }
+  ASSERT_LT(num_passed, 500);
+
+  // Range bounds are kept along with the filter.
+  ColumnPredicate range = ColumnPredicate::Range(column, &ten, &thirty);
+  ColumnPredicate bounded = ColumnPredicate::InBloomFilter(column, { filter }, &ten, &thirty);
+  NO_FATALS(TestMerge(pred, range, bounded, PredicateType::InBloomFilter));
+  ASSERT_FALSE(bounded.EvaluateCell<INT32>(&five));
+  ASSERT_TRUE(bounded.EvaluateCell<INT32>(&twenty));
+  ASSERT_EQ("`c` IN BLOOM FILTER (1 filters) AND `c` >= 10 AND `c` < 30", bounded.ToString());
+  ASSERT_EQ(PredicateType::None,
+            ColumnPredicate::InBloomFilter(column, { filter }, &thirty, &ten).predicate_type());
+
+  // Equality and IN list values are checked against the filter.
+  NO_FATALS(TestMerge(pred,
+                      ColumnPredicate::Equality(column, &ten),
+                      ColumnPredicate::Equality(column, &ten),
+                      PredicateType::Equality));
+  NO_FATALS(TestMerge(bounded,
+                      ColumnPredicate::Equality(column, &five),
+                      ColumnPredicate::None(column),
+                      PredicateType::None));
+  vector<const void*> values = { &zero, &five, &twenty, &thirty };
+  vector<const void*> expected_values = { &five, &twenty };
+  NO_FATALS(TestMerge(pred,
+                      ColumnPredicate::InList(column, &values),
+                      ColumnPredicate::InList(column, &expected_values),
+                      PredicateType::InList));
+
+  NO_FATALS(TestMerge(pred,
+                      ColumnPredicate::IsNotNull(column),
+                      pred,
+                      PredicateType::InBloomFilter));
+  NO_FATALS(TestMerge(pred,
+                      ColumnPredicate::IsNull(column),
+                      ColumnPredicate::None(column),
+                      PredicateType::None));
+  NO_FATALS(TestMerge(pred,
+                      ColumnPredicate::None(column),
+                      ColumnPredicate::None(column),
+                      PredicateType::None));
+
+  // Values must pass the filters of both predicates.
+  string other_buf;
+  Slice other_filter = BuildBloomFilter(column, { &ten, &thirty }, &other_buf);
+  ColumnPredicate both = pred;
+  both.Merge(ColumnPredicate::InBloomFilter(column, { other_filter }, nullptr, nullptr));
+  ASSERT_EQ(PredicateType::InBloomFilter, both.predicate_type());
+  ASSERT_EQ(2, both.raw_bloom_filters().size());
+  ASSERT_TRUE(both.EvaluateCell<INT32>(&ten));
+}
+
 // Test that column predicate comparison works correctly: ordered by predicate
 // type first, then size of the column type.
 TEST_F(TestColumnPredicate, TestSelectivity) {
@@ -1099,4 +1256,108 @@ TEST_F(TestColumnPredicate, TestRedaction) {
   ASSERT_EQ("`a` = <redacted>", ColumnPredicate::Equality(column_i32, &one_32).ToString());
 }
 
+// Evaluates predicates over random blocks both with and without the
+// vectorized predicate kernels, and checks that the selection vectors match
+// the result of evaluating each cell individually.
+class TestColumnPredicateKernels : public KuduTest {
+ public:
+  TestColumnPredicateKernels() : rng_(SeedRandom()) {}
+
+  template <DataType Type>
+  void TestType() {
+    typedef typename DataTypeTraits<Type>::cpp_type CppType;
+    // An odd number of rows exercises the trailing, partial byte of the
+    // selection vector.
+    const size_t kNumRows = 1003;
+    ColumnSchema column("c", Type, true);
+    ScopedColumnBlock<Type> block(kNumRows);
+    for (size_t i = 0; i < kNumRows; i++) {
+      // Use a small range of values so that equality predicates match.
+      block[i] = static_cast<CppType>(rng_.Uniform(32));
+      block.SetCellIsNull(i, rng_.OneIn(10));
+    }
+    if (Type == DOUBLE) {
+      for (size_t i = 0; i < kNumRows; i += 97) {
+        block[i] = static_cast<CppType>(std::nan(""));
+      }
+    }
+
+    CppType v0 = 3;
+    CppType v1 = 7;
+    CppType v2 = 20;
+    vector<const void*> values = { &v0, &v1, &v2 };
+    // A list which is evaluated with a hash set of its values.
+    vector<CppType> large_list;
+    for (int i = 0; i < 40; i++) {
+      large_list.push_back(static_cast<CppType>(i * 2));
+    }
+    vector<const void*> large_values;
+    for (const CppType& v : large_list) {
+      large_values.push_back(&v);
+    }
+    string filter_buf;
+    Slice filter = BuildBloomFilter(column, values, &filter_buf);
+    vector<ColumnPredicate> predicates = {
+      ColumnPredicate::Range(column, &v0, &v2),
+      ColumnPredicate::Range(column, &v1, nullptr),
+      ColumnPredicate::Range(column, nullptr, &v1),
+      ColumnPredicate::Equality(column, &v1),
+      ColumnPredicate::InList(column, &values),
+      ColumnPredicate::InList(column, &large_values),
+      ColumnPredicate::InBloomFilter(column, { filter }, nullptr, nullptr),
+      ColumnPredicate::InBloomFilter(column, { filter }, &v1, nullptr),
+      ColumnPredicate::IsNotNull(column),
+      ColumnPredicate::IsNull(column),
+    };
+    for (const ColumnPredicate& predicate : predicates) {
+      SCOPED_TRACE(predicate.ToString());
+      NO_FATALS(CheckPredicate(predicate, block));
+    }
+  }
+
+ private:
+  void CheckPredicate(const ColumnPredicate& predicate, const ColumnBlock& block) {
+    // Start from a random selection so that already-unselected rows are covered.
+    SelectionVector initial(block.nrows());
+    initial.SetAllTrue();
+    for (size_t i = 0; i < block.nrows(); i++) {
+      if (rng_.OneIn(8)) {
+        BitmapClear(initial.mutable_bitmap(), i);
+      }
+    }
+
+    for (bool use_kernels : { true, false }) {
+      SCOPED_TRACE(use_kernels);
+      FLAGS_column_predicate_use_simd_kernels = use_kernels;
+      SelectionVector sel(block.nrows());
+      memcpy(sel.mutable_bitmap(), initial.bitmap(), BitmapSize(block.nrows()));
+      predicate.Evaluate(block, &sel);
+      for (size_t i = 0; i < block.nrows(); i++) {
+        bool expected = initial.IsRowSelected(i);
+        if (block.is_null(i)) {
+          expected &= predicate.predicate_type() == PredicateType::IsNull;
+        } else {
+          expected &= predicate.EvaluateCell(block.type_info()->physical_type(),
+                                             block.cell_ptr(i));
+        }
+        ASSERT_EQ(expected, sel.IsRowSelected(i)) << "row " << i;
+      }
+    }
+  }
+
+  Random rng_;
+};
+
+TEST_F(TestColumnPredicateKernels, TestInt32) {
+  NO_FATALS(TestType<INT32>());
+}
+
+TEST_F(TestColumnPredicateKernels, TestInt64) {
+  NO_FATALS(TestType<INT64>());
+}
+
+TEST_F(TestColumnPredicateKernels, TestDouble) {
+  NO_FATALS(TestType<DOUBLE>());
+}
+
 } // namespace kudu
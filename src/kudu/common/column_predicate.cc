@@ -18,10 +18,15 @@
 #include "kudu/common/column_predicate.h"
 
 #include <algorithm>
+#include <cstdint>
 #include <cstring>
+#include <memory>
+#include <unordered_set>
 
 #include <boost/optional/optional.hpp>
+#include <gflags/gflags.h>
 
+#include "kudu/common/column_predicate_kernels.h"
 #include "kudu/common/columnblock.h"
 #include "kudu/common/key_util.h"
 #include "kudu/common/rowblock.h"
@@ -29,7 +34,16 @@
 #include "kudu/common/types.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/bitmap.h"
+#include "kudu/util/bloom_filter.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/memory/arena.h"
+#include "kudu/util/slice.h"
+
+DEFINE_bool(column_predicate_use_simd_kernels, true,
+            "Whether to evaluate column predicates over fixed-width columns "
+            "using the vectorized (SIMD) kernels where possible.");
+TAG_FLAG(column_predicate_use_simd_kernels, hidden);
+TAG_FLAG(column_predicate_use_simd_kernels, runtime);
 
 using std::move;
 using std::string;
@@ -37,6 +51,14 @@ using std::vector;
 
 namespace kudu {
 
+// IN lists with at least this many values are evaluated by probing a hash set
+// of the values rather than by binary searching them.
+static const size_t kMinInListValueSetSize = 32;
+
+// The number of rows whose bloom filter probes are computed, and whose filter
+// blocks are prefetched, before any of them is tested against the filters.
+static const size_t kBloomFilterProbeBatchSize = 32;
+
 ColumnPredicate::ColumnPredicate(PredicateType predicate_type,
                                  ColumnSchema column,
                                  const void* lower,
@@ -91,6 +113,22 @@ ColumnPredicate ColumnPredicate::InList(ColumnSchema column,
   return pred;
 }
 
+ColumnPredicate ColumnPredicate::InBloomFilter(ColumnSchema column,
+                                               const vector<Slice>& bloom_filters,
+                                               const void* lower,
+                                               const void* upper) {
+  CHECK(!bloom_filters.empty());
+  ColumnPredicate pred(PredicateType::InBloomFilter, move(column), lower, upper);
+  for (const Slice& data : bloom_filters) {
+    CHECK(!data.empty() && data.size() % BloomFilter::kSplitBlockBytes == 0)
+        << "bad split-block bloom filter size: " << data.size();
+    pred.bloom_filters_.emplace_back(data, BloomFilter::kSplitBlockHashes,
+                                     SPLIT_BLOCK_BLOOM_FILTER);
+  }
+  pred.Simplify();
+  return pred;
+}
+
 boost::optional<ColumnPredicate> ColumnPredicate::InclusiveRange(ColumnSchema column,
                                                                  const void* lower,
                                                                  const void* upper,
@@ -163,6 +201,40 @@ void ColumnPredicate::SetToNone() {
   predicate_type_ = PredicateType::None;
   lower_ = nullptr;
   upper_ = nullptr;
+  value_set_.reset();
+  bloom_filters_.clear();
+}
+
+void ColumnPredicate::IntersectBounds(const ColumnPredicate& other) {
+  // Set the lower bound to the larger of the two.
+  if (other.lower_ != nullptr &&
+      (lower_ == nullptr || column_.type_info()->Compare(lower_, other.lower_) < 0)) {
+    lower_ = other.lower_;
+  }
+
+  // Set the upper bound to the smaller of the two.
+  if (other.upper_ != nullptr &&
+      (upper_ == nullptr || column_.type_info()->Compare(upper_, other.upper_) > 0)) {
+    upper_ = other.upper_;
+  }
+}
+
+void ColumnPredicate::UpdateValueSet() {
+  // Floating point values which compare equal may have different
+  // representations, e.g. 0.0 and -0.0, so they can't be hashed.
+  DataType physical_type = column_.type_info()->physical_type();
+  if (predicate_type_ != PredicateType::InList ||
+      values_.size() < kMinInListValueSetSize ||
+      physical_type == FLOAT || physical_type == DOUBLE) {
+    value_set_.reset();
+    return;
+  }
+  auto value_set = std::make_shared<ValueSet>();
+  value_set->reserve(values_.size());
+  for (const void* value : values_) {
+    value_set->insert(BloomFilterKey(column_.type_info(), value));
+  }
+  value_set_ = move(value_set);
 }
 
 void ColumnPredicate::Simplify() {
@@ -223,6 +295,19 @@ void ColumnPredicate::Simplify() {
         upper_ = nullptr;
         values_.clear();
       }
+      UpdateValueSet();
+      return;
+    };
+    case PredicateType::InBloomFilter: {
+      if (lower_ != nullptr && upper_ != nullptr && type_info->Compare(lower_, upper_) >= 0) {
+        // If the range bounds are empty then no results can be returned.
+        SetToNone();
+      } else if (upper_ != nullptr && type_info->IsMinValue(upper_)) {
+        SetToNone();
+      } else if (lower_ != nullptr && type_info->IsMinValue(lower_)) {
+        // The lower bound doesn't constrain the non-null values.
+        lower_ = nullptr;
+      }
       return;
     };
   }
@@ -253,6 +338,10 @@ void ColumnPredicate::Merge(const ColumnPredicate& other) {
       MergeIntoInList(other);
       return;
     };
+    case PredicateType::InBloomFilter: {
+      MergeIntoBloomFilter(other);
+      return;
+    };
   }
   LOG(FATAL) << "unknown predicate type";
 }
@@ -267,18 +356,7 @@ void ColumnPredicate::MergeIntoRange(const ColumnPredicate& other) {
     };
 
     case PredicateType::Range: {
-      // Set the lower bound to the larger of the two.
-      if (other.lower_ != nullptr &&
-          (lower_ == nullptr || column_.type_info()->Compare(lower_, other.lower_) < 0)) {
-        lower_ = other.lower_;
-      }
-
-      // Set the upper bound to the smaller of the two.
-      if (other.upper_ != nullptr &&
-          (upper_ == nullptr || column_.type_info()->Compare(upper_, other.upper_) > 0)) {
-        upper_ = other.upper_;
-      }
-
+      IntersectBounds(other);
       Simplify();
       return;
     };
@@ -319,6 +397,14 @@ void ColumnPredicate::MergeIntoRange(const ColumnPredicate& other) {
       Simplify();
       return;
     };
+    case PredicateType::InBloomFilter: {
+      // The bloom filters are kept, bounded by both ranges.
+      predicate_type_ = PredicateType::InBloomFilter;
+      bloom_filters_ = other.bloom_filters_;
+      IntersectBounds(other);
+      Simplify();
+      return;
+    };
   }
   LOG(FATAL) << "unknown predicate type";
 }
@@ -356,6 +442,12 @@ void ColumnPredicate::MergeIntoEquality(const ColumnPredicate& other) {
       }
       return;
     };
+    case PredicateType::InBloomFilter: {
+      if (!other.CheckValueInBloomFilter(lower_)) {
+        SetToNone();
+      }
+      return;
+    };
   }
   LOG(FATAL) << "unknown predicate type";
 }
@@ -374,6 +466,8 @@ void ColumnPredicate::MergeIntoIsNotNull(const ColumnPredicate &other) {
       lower_ = other.lower_;
       upper_ = other.upper_;
       values_ = other.values_;
+      value_set_ = other.value_set_;
+      bloom_filters_ = other.bloom_filters_;
       return;
     }
   }
@@ -433,6 +527,7 @@ void ColumnPredicate::MergeIntoInList(const ColumnPredicate &other) {
         predicate_type_ = PredicateType::Equality;
         lower_ = other.lower_;
         upper_ = nullptr;
+        value_set_.reset();
       } else {
         SetToNone(); // Value does not fall in list
       }
@@ -495,6 +590,71 @@ void ColumnPredicate::MergeIntoInList(const ColumnPredicate &other) {
       Simplify();
       return;
     };
+    case PredicateType::InBloomFilter: {
+      // Only the values which pass the filters are retained.
+      values_.erase(std::remove_if(values_.begin(), values_.end(),
+                                   [&other] (const void* v) {
+                                     return !other.CheckValueInBloomFilter(v);
+                                   }), values_.end());
+      Simplify();
+      return;
+    };
+  }
+  LOG(FATAL) << "unknown predicate type";
+}
+
+void ColumnPredicate::MergeIntoBloomFilter(const ColumnPredicate& other) {
+  CHECK(predicate_type_ == PredicateType::InBloomFilter);
+
+  switch (other.predicate_type()) {
+    case PredicateType::None: {
+      SetToNone();
+      return;
+    };
+    case PredicateType::Range: {
+      IntersectBounds(other);
+      Simplify();
+      return;
+    };
+    case PredicateType::Equality: {
+      if (CheckValueInBloomFilter(other.lower_)) {
+        predicate_type_ = PredicateType::Equality;
+        lower_ = other.lower_;
+        upper_ = nullptr;
+        bloom_filters_.clear();
+      } else {
+        SetToNone();
+      }
+      return;
+    };
+    case PredicateType::IsNotNull: return;
+    case PredicateType::IsNull: {
+      SetToNone();
+      return;
+    };
+    case PredicateType::InList: {
+      // The IN list is more selective: only its values which pass the filters
+      // are retained.
+      values_ = other.values_;
+      values_.erase(std::remove_if(values_.begin(), values_.end(),
+                                   [this] (const void* v) {
+                                     return !CheckValueInBloomFilter(v);
+                                   }), values_.end());
+      predicate_type_ = PredicateType::InList;
+      lower_ = nullptr;
+      upper_ = nullptr;
+      bloom_filters_.clear();
+      Simplify();
+      return;
+    };
+    case PredicateType::InBloomFilter: {
+      // Values must pass the filters of both predicates.
+      bloom_filters_.insert(bloom_filters_.end(),
+                            other.bloom_filters_.begin(), other.bloom_filters_.end());
+      IntersectBounds(other);
+      Simplify();
+      return;
+    };
   }
   LOG(FATAL) << "unknown predicate type";
 }
@@ -520,11 +680,138 @@ void ApplyPredicate(const ColumnBlock& block, SelectionVector* sel, P p) {
     }
   }
 }
+
+// Evaluates 'pred' over 'block' with the vectorized predicate kernels for cell
+// type 'T'. Returns false, without modifying 'sel', if there is no kernel for
+// the predicate.
+template <typename T>
+bool EvaluateWithKernels(const ColumnPredicate& pred,
+                         const ColumnBlock& block,
+                         SelectionVector* sel) {
+  const auto& kernels = predicate_kernels::GetKernels<T>();
+  const T* cells = reinterpret_cast<const T*>(block.data());
+  uint8_t* sel_bitmap = sel->mutable_bitmap();
+  switch (pred.predicate_type()) {
+    case PredicateType::Range:
+      kernels.range(cells, block.nrows(),
+                    static_cast<const T*>(pred.raw_lower()),
+                    static_cast<const T*>(pred.raw_upper()),
+                    sel_bitmap);
+      break;
+    case PredicateType::Equality:
+      kernels.equality(cells, block.nrows(), *static_cast<const T*>(pred.raw_lower()),
+                       sel_bitmap);
+      break;
+    case PredicateType::InList: {
+      const vector<const void*>& values = pred.raw_values();
+      if (values.size() > predicate_kernels::kMaxInListSize) {
+        return false;
+      }
+      T list[predicate_kernels::kMaxInListSize];
+      for (size_t i = 0; i < values.size(); i++) {
+        list[i] = *static_cast<const T*>(values[i]);
+      }
+      kernels.in_list(cells, block.nrows(), list, values.size(), sel_bitmap);
+      break;
+    }
+    default:
+      return false;
+  }
+  // The kernels evaluate the cells regardless of whether they're NULL, whose
+  // rows must then be unselected.
+  if (block.is_nullable()) {
+    predicate_kernels::ApplyNonNullBitmap(block.null_bitmap(), block.nrows(),
+                                          false /* keep_nulls */, sel_bitmap);
+  }
+  return true;
+}
+
+// Dispatches to EvaluateWithKernels() for the physical types which have
+// predicate kernels.
+template <DataType PhysicalType>
+bool MaybeEvaluateWithKernels(const ColumnPredicate& /* pred */,
+                              const ColumnBlock& /* block */,
+                              SelectionVector* /* sel */) {
+  return false;
+}
+
+template <>
+bool MaybeEvaluateWithKernels<INT32>(const ColumnPredicate& pred,
+                                     const ColumnBlock& block,
+                                     SelectionVector* sel) {
+  return EvaluateWithKernels<int32_t>(pred, block, sel);
+}
+
+template <>
+bool MaybeEvaluateWithKernels<INT64>(const ColumnPredicate& pred,
+                                     const ColumnBlock& block,
+                                     SelectionVector* sel) {
+  return EvaluateWithKernels<int64_t>(pred, block, sel);
+}
+
+template <>
+bool MaybeEvaluateWithKernels<DOUBLE>(const ColumnPredicate& pred,
+                                      const ColumnBlock& block,
+                                      SelectionVector* sel) {
+  return EvaluateWithKernels<double>(pred, block, sel);
+}
 } // anonymous namespace
 
+template <DataType PhysicalType>
+void ColumnPredicate::EvaluateInBloomFilter(const ColumnBlock& block,
+                                            SelectionVector* sel) const {
+  // Apply the bounds first, so that the rows outside of them aren't hashed.
+  if (lower_ != nullptr || upper_ != nullptr) {
+    ApplyPredicate(block, sel, [this] (const void* cell) {
+      return (lower_ == nullptr || DataTypeTraits<PhysicalType>::Compare(cell, lower_) >= 0) &&
+             (upper_ == nullptr || DataTypeTraits<PhysicalType>::Compare(cell, upper_) < 0);
+    });
+  }
+
+  // The cells are hashed a batch at a time, and the filter blocks of the whole
+  // batch are prefetched before any of them is tested, so that the cache
+  // misses on a large filter overlap instead of stalling every row in turn.
+  uint8_t* sel_bitmap = sel->mutable_bitmap();
+  BloomKeyProbe probes[kBloomFilterProbeBatchSize];
+  size_t rows[kBloomFilterProbeBatchSize];
+  size_t row = 0;
+  while (row < block.nrows()) {
+    size_t n_probes = 0;
+    for (; row < block.nrows() && n_probes < kBloomFilterProbeBatchSize; row++) {
+      if (!sel->IsRowSelected(row)) continue;
+      if (block.is_nullable() && block.is_null(row)) {
+        BitmapClear(sel_bitmap, row);
+        continue;
+      }
+      probes[n_probes] = BloomKeyProbe(CellKey<PhysicalType>(block.cell_ptr(row)));
+      rows[n_probes++] = row;
+    }
+    for (const BloomFilter& bloom_filter : bloom_filters_) {
+      for (size_t i = 0; i < n_probes; i++) {
+        bloom_filter.Prefetch(probes[i]);
+      }
+      // Only the rows which pass this filter are probed in the next one.
+      size_t n_passed = 0;
+      for (size_t i = 0; i < n_probes; i++) {
+        if (bloom_filter.MayContainKey(probes[i])) {
+          probes[n_passed] = probes[i];
+          rows[n_passed++] = rows[i];
+        } else {
+          BitmapClear(sel_bitmap, rows[i]);
+        }
+      }
+      n_probes = n_passed;
+    }
+  }
+}
+
 template <DataType PhysicalType>
 void ColumnPredicate::EvaluateForPhysicalType(const ColumnBlock& block,
                                               SelectionVector* sel) const {
+  if (FLAGS_column_predicate_use_simd_kernels &&
+      MaybeEvaluateWithKernels<PhysicalType>(*this, block, sel)) {
+    return;
+  }
   switch (predicate_type()) {
     case PredicateType::Range: {
       if (lower_ == nullptr) {
@@ -551,13 +838,8 @@ void ColumnPredicate::EvaluateForPhysicalType(const ColumnBlock& block,
     };
     case PredicateType::IsNotNull: {
       if (!block.is_nullable()) return;
-      // TODO: make this more efficient by using bitwise operations on the
-      // null and selection vectors.
-      for (size_t i = 0; i < block.nrows(); i++) {
-        if (sel->IsRowSelected(i) && block.is_null(i)) {
-          BitmapClear(sel->mutable_bitmap(), i);
-        }
-      }
+      predicate_kernels::ApplyNonNullBitmap(block.null_bitmap(), block.nrows(),
+                                            false /* keep_nulls */, sel->mutable_bitmap());
       return;
     };
     case PredicateType::IsNull: {
@@ -565,24 +847,20 @@ void ColumnPredicate::EvaluateForPhysicalType(const ColumnBlock& block,
         BitmapChangeBits(sel->mutable_bitmap(), 0, block.nrows(), false);
         return;
       }
-      // TODO(wdberkeley): make this more efficient by using bitwise operations on the
-      // null and selection vectors.
-      for (size_t i = 0; i < block.nrows(); i++) {
-        if (sel->IsRowSelected(i) && !block.is_null(i)) {
-          BitmapClear(sel->mutable_bitmap(), i);
-        }
-      }
+      predicate_kernels::ApplyNonNullBitmap(block.null_bitmap(), block.nrows(),
+                                            true /* keep_nulls */, sel->mutable_bitmap());
       return;
     }
     case PredicateType::InList: {
       ApplyPredicate(block, sel, [this] (const void* cell) {
-        return std::binary_search(values_.begin(), values_.end(), cell,
-                                  [] (const void* lhs, const void* rhs) {
-                                    return DataTypeTraits<PhysicalType>::Compare(lhs, rhs) < 0;
-                                  });
+        return this->CheckCellInList<PhysicalType>(cell);
       });
       return;
     };
+    case PredicateType::InBloomFilter: {
+      EvaluateInBloomFilter<PhysicalType>(block, sel);
+      return;
+    };
     case PredicateType::None: LOG(FATAL) << "NONE predicate evaluation";
   }
   LOG(FATAL) << "unknown predicate type";
@@ -665,6 +943,19 @@ string ColumnPredicate::ToString() const {
       ss.append(")");
       return ss;
     };
+    case PredicateType::InBloomFilter: {
+      string ss = strings::Substitute("`$0` IN BLOOM FILTER ($1 filters)",
+                                      column_.name(), bloom_filters_.size());
+      if (lower_ != nullptr) {
+        ss.append(strings::Substitute(" AND `$0` >= $1", column_.name(),
+                                      column_.Stringify(lower_)));
+      }
+      if (upper_ != nullptr) {
+        ss.append(strings::Substitute(" AND `$0` < $1", column_.name(),
+                                      column_.Stringify(upper_)));
+      }
+      return ss;
+    };
   }
   LOG(FATAL) << "unknown predicate type";
 }
@@ -674,16 +965,17 @@ bool ColumnPredicate::operator==(const ColumnPredicate& other) const {
   if (predicate_type_ != other.predicate_type_) {
     return false;
   }
+  const auto bounds_equal = [&] () {
+    return (lower_ == other.lower_ ||
+            (lower_ != nullptr && other.lower_ != nullptr &&
+             column_.type_info()->Compare(lower_, other.lower_) == 0)) &&
+           (upper_ == other.upper_ ||
+            (upper_ != nullptr && other.upper_ != nullptr &&
+             column_.type_info()->Compare(upper_, other.upper_) == 0));
+  };
   switch (predicate_type_) {
     case PredicateType::Equality: return column_.type_info()->Compare(lower_, other.lower_) == 0;
-    case PredicateType::Range: {
-      return (lower_ == other.lower_ ||
-              (lower_ != nullptr && other.lower_ != nullptr &&
-               column_.type_info()->Compare(lower_, other.lower_) == 0)) &&
-             (upper_ == other.upper_ ||
-              (upper_ != nullptr && other.upper_ != nullptr &&
-               column_.type_info()->Compare(upper_, other.upper_) == 0));
-    };
+    case PredicateType::Range: return bounds_equal();
     case PredicateType::InList: {
       if (values_.size() != other.values_.size()) return false;
       for (int i = 0; i < values_.size(); i++) {
@@ -691,6 +983,13 @@ bool ColumnPredicate::operator==(const ColumnPredicate& other) const {
       }
       return true;
     };
+    case PredicateType::InBloomFilter: {
+      if (bloom_filters_.size() != other.bloom_filters_.size()) return false;
+      for (int i = 0; i < bloom_filters_.size(); i++) {
+        if (bloom_filters_[i].data() != other.bloom_filters_[i].data()) return false;
+      }
+      return bounds_equal();
+    };
     case PredicateType::None:
     case PredicateType::IsNotNull:
     case PredicateType::IsNull: return true;
@@ -705,12 +1004,31 @@ bool ColumnPredicate::CheckValueInRange(const void* value) const {
 }
 
 bool ColumnPredicate::CheckValueInList(const void* value) const {
+  if (value_set_) {
+    return value_set_->count(BloomFilterKey(column_.type_info(), value)) > 0;
+  }
   return std::binary_search(values_.begin(), values_.end(), value,
                             [this](const void* lhs, const void* rhs) {
                               return this->column_.type_info()->Compare(lhs, rhs) < 0;
                             });
 }
 
+bool ColumnPredicate::CheckValueInBloomFilter(const void* value) const {
+  CHECK(predicate_type_ == PredicateType::InBloomFilter);
+  const TypeInfo* type_info = column_.type_info();
+  if ((lower_ != nullptr && type_info->Compare(value, lower_) < 0) ||
+      (upper_ != nullptr && type_info->Compare(value, upper_) >= 0)) {
+    return false;
+  }
+  BloomKeyProbe probe(BloomFilterKey(type_info, value));
+  for (const BloomFilter& bloom_filter : bloom_filters_) {
+    if (!bloom_filter.MayContainKey(probe)) {
+      return false;
+    }
+  }
+  return true;
+}
+
 namespace {
 int SelectivityRank(const ColumnPredicate& predicate) {
   int rank;
@@ -719,8 +1037,9 @@ int SelectivityRank(const ColumnPredicate& predicate) {
     case PredicateType::IsNull: rank = 1; break;
     case PredicateType::Equality: rank = 2; break;
     case PredicateType::InList: rank = 3; break;
-    case PredicateType::Range: rank = 4; break;
-    case PredicateType::IsNotNull: rank = 5; break;
+    case PredicateType::InBloomFilter: rank = 4; break;
+    case PredicateType::Range: rank = 5; break;
+    case PredicateType::IsNotNull: rank = 6; break;
     default: LOG(FATAL) << "unknown predicate type";
   }
   return rank * (kLargestTypeSize + 1) + predicate.column().type_info()->size();
@@ -18,8 +18,12 @@
 #pragma once
 
 #include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <ostream>
 #include <string>
+#include <unordered_set>
 #include <vector>
 
 #include <boost/optional/optional.hpp>
@@ -28,6 +32,9 @@
 #include "kudu/common/common.pb.h"
 #include "kudu/common/schema.h"
 #include "kudu/common/types.h"
+#include "kudu/gutil/hash/city.h"
+#include "kudu/util/bloom_filter.h"
+#include "kudu/util/slice.h"
 
 namespace kudu {
 
@@ -56,6 +63,12 @@ enum class PredicateType {
   // A predicate which evaluates to true if the column value is present in
   // a value list.
   InList,
+
+  // A predicate which evaluates to true if the column value may be present
+  // in each of a set of bloom filters, and falls within an optional range.
+  // Values which were not added to the filters may pass it too: it filters
+  // rows early, e.g. for semi-joins, but is not an exact constraint.
+  InBloomFilter,
 };
 
 // A predicate which can be evaluated over a block of column values.
@@ -130,6 +143,18 @@ class ColumnPredicate {
   // The InList will be simplified into an Equality, Range or None if possible.
   static ColumnPredicate InList(ColumnSchema column, std::vector<const void*>* values);
 
+  // Creates a new IN BLOOM FILTER predicate for the column, which matches the
+  // values passing all of the given split-block bloom filters, and the
+  // optional inclusive lower and exclusive upper bounds. The filters hold the
+  // BloomFilterKey() of the values.
+  //
+  // The filter data and bounds are not copied, and must outlive the returned
+  // predicate.
+  static ColumnPredicate InBloomFilter(ColumnSchema column,
+                                       const std::vector<Slice>& bloom_filters,
+                                       const void* lower,
+                                       const void* upper);
+
   // Creates a new predicate which matches no values.
   static ColumnPredicate None(ColumnSchema column);
 
@@ -191,10 +216,10 @@ class ColumnPredicate {
         return false;
       };
       case PredicateType::InList: {
-        return std::binary_search(values_.begin(), values_.end(), cell,
-                                  [] (const void* lhs, const void* rhs) {
-                                    return DataTypeTraits<PhysicalType>::Compare(lhs, rhs) < 0;
-                                  });
+        return CheckCellInList<PhysicalType>(cell);
+      };
+      case PredicateType::InBloomFilter: {
+        return CheckCellInBloomFilter<PhysicalType>(cell);
       };
     }
     LOG(FATAL) << "unknown predicate type";
@@ -234,10 +259,44 @@ class ColumnPredicate {
     return values_;
   }
 
+  // Returns the bloom filters if this is an in-bloom-filter predicate.
+  const std::vector<BloomFilter>& raw_bloom_filters() const {
+    return bloom_filters_;
+  }
+
+  // Returns the bytes of 'value', a cell of the given type, which are added
+  // to and probed in the filters of an InBloomFilter predicate: the data of
+  // BINARY values, and the in-memory representation of other values.
+  static Slice BloomFilterKey(const TypeInfo* type_info, const void* value) {
+    if (type_info->physical_type() == BINARY) {
+      return *static_cast<const Slice*>(value);
+    }
+    return Slice(static_cast<const uint8_t*>(value), type_info->size());
+  }
+
  private:
 
   friend class TestColumnPredicate;
 
+  // Hashes the keys of the values of large IN lists.
+  struct KeyHash {
+    size_t operator()(const Slice& key) const {
+      return util_hash::CityHash64(reinterpret_cast<const char*>(key.data()), key.size());
+    }
+  };
+  typedef std::unordered_set<Slice, KeyHash> ValueSet;
+
+  // Returns the key of 'cell' in the value set of an InList predicate or in
+  // the filters of an InBloomFilter predicate.
+  template <DataType PhysicalType>
+  static Slice CellKey(const void* cell) {
+    if (PhysicalType == BINARY) {
+      return *static_cast<const Slice*>(cell);
+    }
+    return Slice(static_cast<const uint8_t*>(cell),
+                 sizeof(typename DataTypeTraits<PhysicalType>::cpp_type));
+  }
+
   // Creates a new range or equality column predicate.
   ColumnPredicate(PredicateType predicate_type,
                   ColumnSchema column,
@@ -276,6 +335,13 @@ class ColumnPredicate {
   // Merge another predicate into this InList predicate.
   void MergeIntoInList(const ColumnPredicate& other);
 
+  // Merge another predicate into this InBloomFilter predicate.
+  void MergeIntoBloomFilter(const ColumnPredicate& other);
+
+  // Narrows the bounds of this Range or InBloomFilter predicate to those of
+  // the other Range or InBloomFilter predicate.
+  void IntersectBounds(const ColumnPredicate& other);
+
   // For a Range type predicate, this helper function checks
   // whether a given value is in the range.
   bool CheckValueInRange(const void* value) const;
@@ -284,21 +350,70 @@ class ColumnPredicate {
   // whether a given value is in the list.
   bool CheckValueInList(const void* value) const;
 
+  // For an InBloomFilter type predicate, this helper function checks
+  // whether a given value is in the range and passes the filters.
+  bool CheckValueInBloomFilter(const void* value) const;
+
+  template <DataType PhysicalType>
+  bool CheckCellInList(const void* cell) const {
+    if (value_set_) {
+      return value_set_->count(CellKey<PhysicalType>(cell)) > 0;
+    }
+    return std::binary_search(values_.begin(), values_.end(), cell,
+                              [] (const void* lhs, const void* rhs) {
+                                return DataTypeTraits<PhysicalType>::Compare(lhs, rhs) < 0;
+                              });
+  }
+
+  template <DataType PhysicalType>
+  bool CheckCellInBloomFilter(const void* cell) const {
+    if ((lower_ != nullptr && DataTypeTraits<PhysicalType>::Compare(cell, lower_) < 0) ||
+        (upper_ != nullptr && DataTypeTraits<PhysicalType>::Compare(cell, upper_) >= 0)) {
+      return false;
+    }
+    BloomKeyProbe probe(CellKey<PhysicalType>(cell));
+    for (const BloomFilter& bloom_filter : bloom_filters_) {
+      if (!bloom_filter.MayContainKey(probe)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Evaluates an InBloomFilter predicate over the rows of the block which are
+  // selected in 'sel', probing the filters for batches of rows at a time.
+  template <DataType PhysicalType>
+  void EvaluateInBloomFilter(const ColumnBlock& block, SelectionVector* sel) const;
+
+  // Builds or drops the hash set of the values of an InList predicate,
+  // depending on the size of the list.
+  void UpdateValueSet();
+
   // The type of this predicate.
   PredicateType predicate_type_;
 
   // The data type of the column. TypeInfo instances have a static lifetime.
   ColumnSchema column_;
 
-  // The inclusive lower bound value if this is a Range predicate, or the
-  // equality value if this is an Equality predicate.
+  // The inclusive lower bound value if this is a Range or InBloomFilter
+  // predicate, or the equality value if this is an Equality predicate.
   const void* lower_;
 
-  // The exclusive upper bound value if this is a Range predicate.
+  // The exclusive upper bound value if this is a Range or InBloomFilter
+  // predicate.
   const void* upper_;
 
   // The list of values to check column against if this is an InList predicate.
   std::vector<const void*> values_;
+
+  // The set of the keys of values_ if this is an InList predicate with many
+  // values, which is probed rather than binary searching values_. Shared by
+  // the copies of the predicate.
+  std::shared_ptr<const ValueSet> value_set_;
+
+  // The filters which the column value must pass if this is an InBloomFilter
+  // predicate.
+  std::vector<BloomFilter> bloom_filters_;
 };
 
 // Compares predicates according to selectivity. Predicates that match fewer
@@ -0,0 +1,180 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// Instruction-set independent parts of the predicate kernels declared in
+// column_predicate_kernels.h.
+//
+// This file is included once per instruction set, each time with
+// KUDU_PREDICATE_KERNELS_ARCH defined to the name of the namespace to put the
+// kernels in. That keeps each compilation's template instantiations distinct,
+// so the linker can never substitute the AVX2 code for the SSE4.2 code.
+//
+// Before including it, the including file must define, in the same
+// namespace, an 'Ops<T>' traits class for each supported cell type T with:
+//
+//   typedef ... Vec;                     // a SIMD register
+//   static const int kLanes;             // the number of cells in a Vec
+//   static Vec Load(const T* cells);     // unaligned load of kLanes cells
+//   static Vec Set1(T v);                // broadcast of 'v'
+//   static Vec Lt(Vec a, Vec b);         // lanes for which Compare(a, b) < 0
+//   static Vec Ge(Vec a, Vec b);         // lanes for which Compare(a, b) >= 0
+//   static Vec Eq(Vec a, Vec b);         // lanes for which Compare(a, b) == 0
+//   static Vec And(Vec a, Vec b);
+//   static Vec Or(Vec a, Vec b);
+//   static Vec Zero();
+//   static uint32_t MoveMask(Vec v);     // one bit per lane, lowest lane first
+//
+// This file intentionally includes no headers of its own: anything it pulls
+// in would be compiled with the instruction set of the including file.
+
+#ifndef KUDU_PREDICATE_KERNELS_ARCH
+#error "KUDU_PREDICATE_KERNELS_ARCH must be defined"
+#endif
+
+namespace kudu {
+namespace predicate_kernels {
+namespace KUDU_PREDICATE_KERNELS_ARCH {
+
+// Scalar versions of the comparisons, used for the trailing cells which don't
+// fill a whole byte of the selection bitmap. These follow the semantics of
+// GenericCompare() in types.h, where NaN compares equal to everything.
+template <typename T>
+inline bool ScalarLt(T a, T b) {
+  return a < b;
+}
+
+template <typename T>
+inline bool ScalarGe(T a, T b) {
+  return !(a < b);
+}
+
+template <typename T>
+inline bool ScalarEq(T a, T b) {
+  return !(a < b) && !(b < a);
+}
+
+// Evaluates 'vec_pred' on every group of Ops<T>::kLanes cells, and 'scalar_pred'
+// on the trailing cells, ANDing the resulting bits into 'sel'.
+template <typename T, class VecPred, class ScalarPred>
+inline void ApplyKernel(const T* cells, size_t nrows, uint8_t* sel,
+                        const VecPred& vec_pred, const ScalarPred& scalar_pred) {
+  typedef Ops<T> O;
+  static_assert(8 % O::kLanes == 0, "lanes must evenly divide a bitmap byte");
+  const int kVecsPerByte = 8 / O::kLanes;
+
+  const size_t nbytes = nrows / 8;
+  for (size_t b = 0; b < nbytes; b++) {
+    // Skip the comparisons entirely when no row in this byte is selected.
+    if (sel[b] == 0) {
+      cells += 8;
+      continue;
+    }
+    uint32_t bits = 0;
+    for (int v = 0; v < kVecsPerByte; v++) {
+      bits |= O::MoveMask(vec_pred(O::Load(cells))) << (v * O::kLanes);
+      cells += O::kLanes;
+    }
+    sel[b] &= static_cast<uint8_t>(bits);
+  }
+
+  const size_t rem = nrows % 8;
+  if (rem != 0) {
+    // Preserve the bits past the end of the block.
+    uint8_t bits = static_cast<uint8_t>(0xff << rem);
+    for (size_t i = 0; i < rem; i++) {
+      if (scalar_pred(cells[i])) {
+        bits |= static_cast<uint8_t>(1 << i);
+      }
+    }
+    sel[nbytes] &= bits;
+  }
+}
+
+template <typename T>
+void Range(const T* cells, size_t nrows, const T* lower, const T* upper, uint8_t* sel) {
+  typedef Ops<T> O;
+  typedef typename O::Vec Vec;
+  if (lower != nullptr && upper != nullptr) {
+    const T lo = *lower;
+    const T up = *upper;
+    const Vec lo_vec = O::Set1(lo);
+    const Vec up_vec = O::Set1(up);
+    ApplyKernel(cells, nrows, sel,
+                [&](Vec x) { return O::And(O::Ge(x, lo_vec), O::Lt(x, up_vec)); },
+                [&](T x) { return ScalarGe(x, lo) && ScalarLt(x, up); });
+  } else if (lower != nullptr) {
+    const T lo = *lower;
+    const Vec lo_vec = O::Set1(lo);
+    ApplyKernel(cells, nrows, sel,
+                [&](Vec x) { return O::Ge(x, lo_vec); },
+                [&](T x) { return ScalarGe(x, lo); });
+  } else {
+    const T up = *upper;
+    const Vec up_vec = O::Set1(up);
+    ApplyKernel(cells, nrows, sel,
+                [&](Vec x) { return O::Lt(x, up_vec); },
+                [&](T x) { return ScalarLt(x, up); });
+  }
+}
+
+template <typename T>
+void Equality(const T* cells, size_t nrows, T value, uint8_t* sel) {
+  typedef Ops<T> O;
+  typedef typename O::Vec Vec;
+  const Vec value_vec = O::Set1(value);
+  ApplyKernel(cells, nrows, sel,
+              [&](Vec x) { return O::Eq(x, value_vec); },
+              [&](T x) { return ScalarEq(x, value); });
+}
+
+template <typename T>
+void InList(const T* cells, size_t nrows, const T* values, size_t num_values, uint8_t* sel) {
+  typedef Ops<T> O;
+  typedef typename O::Vec Vec;
+  Vec value_vecs[kMaxInListSize];
+  for (size_t i = 0; i < num_values; i++) {
+    value_vecs[i] = O::Set1(values[i]);
+  }
+  ApplyKernel(cells, nrows, sel,
+              [&](Vec x) {
+                Vec match = O::Zero();
+                for (size_t i = 0; i < num_values; i++) {
+                  match = O::Or(match, O::Eq(x, value_vecs[i]));
+                }
+                return match;
+              },
+              [&](T x) {
+                for (size_t i = 0; i < num_values; i++) {
+                  if (ScalarEq(x, values[i])) return true;
+                }
+                return false;
+              });
+}
+
+template <typename T>
+const KernelTable<T>& GetKernels() {
+  static const KernelTable<T> kKernels = { &Range<T>, &Equality<T>, &InList<T> };
+  return kKernels;
+}
+
+template const KernelTable<int32_t>& GetKernels<int32_t>();
+template const KernelTable<int64_t>& GetKernels<int64_t>();
+template const KernelTable<double>& GetKernels<double>();
+
+} // namespace KUDU_PREDICATE_KERNELS_ARCH
+} // namespace predicate_kernels
+} // namespace kudu
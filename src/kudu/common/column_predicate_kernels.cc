@@ -0,0 +1,161 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/common/column_predicate_kernels.h"
+
+#include <nmmintrin.h>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "kudu/gutil/cpu.h"
+
+using base::CPU;
+
+namespace kudu {
+namespace predicate_kernels {
+
+////////////////////////////////////////////////////////////
+// SSE4.2 kernels
+////////////////////////////////////////////////////////////
+
+namespace sse42 {
+
+template <typename T>
+struct Ops;
+
+template <>
+struct Ops<int32_t> {
+  typedef __m128i Vec;
+  static const int kLanes = 4;
+  static Vec Load(const int32_t* p) { return _mm_loadu_si128(reinterpret_cast<const Vec*>(p)); }
+  static Vec Set1(int32_t v) { return _mm_set1_epi32(v); }
+  static Vec Lt(Vec a, Vec b) { return _mm_cmpgt_epi32(b, a); }
+  static Vec Ge(Vec a, Vec b) { return _mm_andnot_si128(_mm_cmpgt_epi32(b, a), AllOnes()); }
+  static Vec Eq(Vec a, Vec b) { return _mm_cmpeq_epi32(a, b); }
+  static Vec And(Vec a, Vec b) { return _mm_and_si128(a, b); }
+  static Vec Or(Vec a, Vec b) { return _mm_or_si128(a, b); }
+  static Vec Zero() { return _mm_setzero_si128(); }
+  static Vec AllOnes() { return _mm_set1_epi32(-1); }
+  static uint32_t MoveMask(Vec v) { return _mm_movemask_ps(_mm_castsi128_ps(v)); }
+};
+
+template <>
+struct Ops<int64_t> {
+  typedef __m128i Vec;
+  static const int kLanes = 2;
+  static Vec Load(const int64_t* p) { return _mm_loadu_si128(reinterpret_cast<const Vec*>(p)); }
+  static Vec Set1(int64_t v) { return _mm_set1_epi64x(v); }
+  static Vec Lt(Vec a, Vec b) { return _mm_cmpgt_epi64(b, a); }
+  static Vec Ge(Vec a, Vec b) { return _mm_andnot_si128(_mm_cmpgt_epi64(b, a), AllOnes()); }
+  static Vec Eq(Vec a, Vec b) { return _mm_cmpeq_epi64(a, b); }
+  static Vec And(Vec a, Vec b) { return _mm_and_si128(a, b); }
+  static Vec Or(Vec a, Vec b) { return _mm_or_si128(a, b); }
+  static Vec Zero() { return _mm_setzero_si128(); }
+  static Vec AllOnes() { return _mm_set1_epi32(-1); }
+  static uint32_t MoveMask(Vec v) { return _mm_movemask_pd(_mm_castsi128_pd(v)); }
+};
+
+template <>
+struct Ops<double> {
+  typedef __m128d Vec;
+  static const int kLanes = 2;
+  static Vec Load(const double* p) { return _mm_loadu_pd(p); }
+  static Vec Set1(double v) { return _mm_set1_pd(v); }
+  // Ordered comparison: false if either operand is NaN.
+  static Vec Lt(Vec a, Vec b) { return _mm_cmplt_pd(a, b); }
+  // Unordered comparisons: true if either operand is NaN.
+  static Vec Ge(Vec a, Vec b) { return _mm_cmpnlt_pd(a, b); }
+  static Vec Eq(Vec a, Vec b) { return _mm_and_pd(_mm_cmpnlt_pd(a, b), _mm_cmpngt_pd(a, b)); }
+  static Vec And(Vec a, Vec b) { return _mm_and_pd(a, b); }
+  static Vec Or(Vec a, Vec b) { return _mm_or_pd(a, b); }
+  static Vec Zero() { return _mm_setzero_pd(); }
+  static uint32_t MoveMask(Vec v) { return _mm_movemask_pd(v); }
+};
+
+} // namespace sse42
+} // namespace predicate_kernels
+} // namespace kudu
+
+#define KUDU_PREDICATE_KERNELS_ARCH sse42
+#include "kudu/common/column_predicate_kernels-inl.h"
+#undef KUDU_PREDICATE_KERNELS_ARCH
+
+namespace kudu {
+namespace predicate_kernels {
+
+////////////////////////////////////////////////////////////
+// Runtime selection
+////////////////////////////////////////////////////////////
+
+namespace {
+const KernelTable<int32_t>* g_int32_kernels;
+const KernelTable<int64_t>* g_int64_kernels;
+const KernelTable<double>* g_double_kernels;
+} // anonymous namespace
+
+// When this translation unit is initialized, figure out the current CPU and
+// select the kernels for its architecture.
+//
+// This avoids an expensive 'cpuid' call in the hot path. See also
+// bitshuffle_arch_wrapper.cc.
+__attribute__((constructor))
+void SelectPredicateKernels() {
+  if (CPU().has_avx2()) {
+    g_int32_kernels = &avx2::GetKernels<int32_t>();
+    g_int64_kernels = &avx2::GetKernels<int64_t>();
+    g_double_kernels = &avx2::GetKernels<double>();
+  } else {
+    g_int32_kernels = &sse42::GetKernels<int32_t>();
+    g_int64_kernels = &sse42::GetKernels<int64_t>();
+    g_double_kernels = &sse42::GetKernels<double>();
+  }
+}
+
+template <>
+const KernelTable<int32_t>& GetKernels<int32_t>() {
+  return *g_int32_kernels;
+}
+
+template <>
+const KernelTable<int64_t>& GetKernels<int64_t>() {
+  return *g_int64_kernels;
+}
+
+template <>
+const KernelTable<double>& GetKernels<double>() {
+  return *g_double_kernels;
+}
+
+void ApplyNonNullBitmap(const uint8_t* non_null_bitmap, size_t nrows, bool keep_nulls,
+                        uint8_t* sel) {
+  // This is a simple enough loop for the compiler to vectorize on its own.
+  const uint8_t flip = keep_nulls ? 0xff : 0;
+  const size_t nbytes = nrows / 8;
+  for (size_t i = 0; i < nbytes; i++) {
+    sel[i] &= non_null_bitmap[i] ^ flip;
+  }
+  const size_t rem = nrows % 8;
+  if (rem != 0) {
+    // Preserve the bits past the end of the block.
+    const uint8_t tail_mask = static_cast<uint8_t>(0xff << rem);
+    sel[nbytes] &= (non_null_bitmap[nbytes] ^ flip) | tail_mask;
+  }
+}
+
+} // namespace predicate_kernels
+} // namespace kudu
@@ -0,0 +1,92 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// Vectorized kernels used by ColumnPredicate to evaluate predicates over
+// blocks of fixed-width cells.
+//
+// Each kernel evaluates a predicate over 'nrows' contiguous cells and clears
+// the bits of the selection bitmap 'sel' for the rows which do not satisfy
+// it. Bits of 'sel' for rows which are already unselected are never set, and
+// bits past 'nrows' are left untouched. The selection bitmap is updated a
+// byte (8 rows) at a time rather than one bit at a time.
+//
+// The cell comparisons follow the semantics of DataTypeTraits<>::Compare(),
+// including for NaN floating-point values.
+//
+// The kernels are compiled for SSE4.2 (the minimum instruction set required
+// by Kudu) and for AVX2. The best implementation for the running CPU is
+// selected at startup.
+#ifndef KUDU_COMMON_COLUMN_PREDICATE_KERNELS_H
+#define KUDU_COMMON_COLUMN_PREDICATE_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace kudu {
+namespace predicate_kernels {
+
+// The maximum number of values in an IN list predicate for which the
+// 'in_list' kernel is used. Each value costs a comparison per cell, so larger
+// lists are better served by a binary search.
+static const size_t kMaxInListSize = 8;
+
+template <typename T>
+struct KernelTable {
+  // Keeps the rows for which 'lower <= cell < upper'.
+  // Either of 'lower' or 'upper' may be NULL, but not both.
+  void (*range)(const T* cells, size_t nrows, const T* lower, const T* upper, uint8_t* sel);
+
+  // Keeps the rows for which 'cell == value'.
+  void (*equality)(const T* cells, size_t nrows, T value, uint8_t* sel);
+
+  // Keeps the rows whose cell is equal to one of the 'num_values' values in
+  // 'values'. 'num_values' must be at most kMaxInListSize.
+  void (*in_list)(const T* cells, size_t nrows, const T* values, size_t num_values,
+                  uint8_t* sel);
+};
+
+// Returns the kernels for the best instruction set supported by this CPU.
+//
+// Only instantiated for int32_t, int64_t and double.
+template <typename T>
+const KernelTable<T>& GetKernels();
+
+// Returns the kernels compiled for a specific instruction set. These are
+// exposed for testing; use GetKernels() instead.
+//
+// The AVX2 kernels must only be used if the CPU supports AVX2.
+namespace sse42 {
+template <typename T>
+const KernelTable<T>& GetKernels();
+} // namespace sse42
+namespace avx2 {
+template <typename T>
+const KernelTable<T>& GetKernels();
+} // namespace avx2
+
+// Combines the column non-null bitmap 'non_null_bitmap' into 'sel'.
+//
+// If 'keep_nulls' is false, the rows whose cells are NULL are unselected
+// (IS NOT NULL); otherwise, the rows whose cells are not NULL are unselected
+// (IS NULL).
+void ApplyNonNullBitmap(const uint8_t* non_null_bitmap, size_t nrows, bool keep_nulls,
+                        uint8_t* sel);
+
+} // namespace predicate_kernels
+} // namespace kudu
+
+#endif // KUDU_COMMON_COLUMN_PREDICATE_KERNELS_H
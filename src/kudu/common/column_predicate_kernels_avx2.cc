@@ -0,0 +1,98 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// AVX2 versions of the predicate kernels. This file is compiled with -mavx2,
+// so it must not include any headers with inline code that might be shared
+// with other translation units. The kernels are only called if the CPU
+// supports AVX2; see SelectPredicateKernels().
+
+#include <immintrin.h>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "kudu/common/column_predicate_kernels.h"
+
+namespace kudu {
+namespace predicate_kernels {
+namespace avx2 {
+
+template <typename T>
+struct Ops;
+
+template <>
+struct Ops<int32_t> {
+  typedef __m256i Vec;
+  static const int kLanes = 8;
+  static Vec Load(const int32_t* p) {
+    return _mm256_loadu_si256(reinterpret_cast<const Vec*>(p));
+  }
+  static Vec Set1(int32_t v) { return _mm256_set1_epi32(v); }
+  static Vec Lt(Vec a, Vec b) { return _mm256_cmpgt_epi32(b, a); }
+  static Vec Ge(Vec a, Vec b) { return _mm256_andnot_si256(_mm256_cmpgt_epi32(b, a), AllOnes()); }
+  static Vec Eq(Vec a, Vec b) { return _mm256_cmpeq_epi32(a, b); }
+  static Vec And(Vec a, Vec b) { return _mm256_and_si256(a, b); }
+  static Vec Or(Vec a, Vec b) { return _mm256_or_si256(a, b); }
+  static Vec Zero() { return _mm256_setzero_si256(); }
+  static Vec AllOnes() { return _mm256_set1_epi32(-1); }
+  static uint32_t MoveMask(Vec v) { return _mm256_movemask_ps(_mm256_castsi256_ps(v)); }
+};
+
+template <>
+struct Ops<int64_t> {
+  typedef __m256i Vec;
+  static const int kLanes = 4;
+  static Vec Load(const int64_t* p) {
+    return _mm256_loadu_si256(reinterpret_cast<const Vec*>(p));
+  }
+  static Vec Set1(int64_t v) { return _mm256_set1_epi64x(v); }
+  static Vec Lt(Vec a, Vec b) { return _mm256_cmpgt_epi64(b, a); }
+  static Vec Ge(Vec a, Vec b) { return _mm256_andnot_si256(_mm256_cmpgt_epi64(b, a), AllOnes()); }
+  static Vec Eq(Vec a, Vec b) { return _mm256_cmpeq_epi64(a, b); }
+  static Vec And(Vec a, Vec b) { return _mm256_and_si256(a, b); }
+  static Vec Or(Vec a, Vec b) { return _mm256_or_si256(a, b); }
+  static Vec Zero() { return _mm256_setzero_si256(); }
+  static Vec AllOnes() { return _mm256_set1_epi32(-1); }
+  static uint32_t MoveMask(Vec v) { return _mm256_movemask_pd(_mm256_castsi256_pd(v)); }
+};
+
+template <>
+struct Ops<double> {
+  typedef __m256d Vec;
+  static const int kLanes = 4;
+  static Vec Load(const double* p) { return _mm256_loadu_pd(p); }
+  static Vec Set1(double v) { return _mm256_set1_pd(v); }
+  // Ordered comparison: false if either operand is NaN.
+  static Vec Lt(Vec a, Vec b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+  // Unordered comparisons: true if either operand is NaN.
+  static Vec Ge(Vec a, Vec b) { return _mm256_cmp_pd(a, b, _CMP_NLT_UQ); }
+  static Vec Eq(Vec a, Vec b) {
+    return _mm256_and_pd(_mm256_cmp_pd(a, b, _CMP_NLT_UQ), _mm256_cmp_pd(a, b, _CMP_NGT_UQ));
+  }
+  static Vec And(Vec a, Vec b) { return _mm256_and_pd(a, b); }
+  static Vec Or(Vec a, Vec b) { return _mm256_or_pd(a, b); }
+  static Vec Zero() { return _mm256_setzero_pd(); }
+  static uint32_t MoveMask(Vec v) { return _mm256_movemask_pd(v); }
+};
+
+} // namespace avx2
+} // namespace predicate_kernels
+} // namespace kudu
+
+#define KUDU_PREDICATE_KERNELS_ARCH avx2
+#include "kudu/common/column_predicate_kernels-inl.h"
+#undef KUDU_PREDICATE_KERNELS_ARCH
@@ -158,12 +158,10 @@ void EncodedKeyBuilder::Reset() {
 void EncodedKeyBuilder::AddColumnKey(const void *raw_key) {
   DCHECK_LT(idx_, num_key_cols_);
 
-  const ColumnSchema &col = schema_->column(idx_);
-  DCHECK(!col.is_nullable());
+  DCHECK(!schema_->column(idx_).is_nullable());
 
-  const TypeInfo* ti = col.type_info();
   bool is_last = idx_ == num_key_cols_ - 1;
-  GetKeyEncoder<faststring>(ti).Encode(raw_key, is_last, &encoded_key_);
+  schema_->key_encoder(idx_).Encode(raw_key, is_last, &encoded_key_);
   raw_keys_.push_back(raw_key);
 
   ++idx_;
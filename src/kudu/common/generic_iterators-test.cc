@@ -42,17 +42,24 @@
 #include "kudu/gutil/casts.h"
 #include "kudu/gutil/mathlimits.h"
 #include "kudu/gutil/port.h"
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/memory/arena.h"
 #include "kudu/util/status.h"
 #include "kudu/util/stopwatch.h"
 #include "kudu/util/test_macros.h"
+#include "kudu/util/test_util.h"
+#include "kudu/util/threadpool.h"
 
 DEFINE_int32(num_lists, 3, "Number of lists to merge");
 DEFINE_int32(num_rows, 1000, "Number of entries per list");
 DEFINE_int32(num_iters, 1, "Number of times to run merge");
 
+DECLARE_int32(materializing_iterator_predicate_reorder_blocks);
+
+using std::get;
 using std::shared_ptr;
 using std::string;
+using std::unique_ptr;
 using std::vector;
 
 namespace kudu {
@@ -246,6 +253,209 @@ TEST(TestMergeIterator, TestMergePredicate2) {
   TestMerge(predicate);
 }
 
+// Drains 'iter' into 'results', checking that it never returns an empty block.
+static void CollectUnorderedResults(RowwiseIterator* iter, vector<uint32_t>* results) {
+  RowBlock dst(kIntSchema, 100, nullptr);
+  while (iter->HasNext()) {
+    ASSERT_OK(iter->NextBlock(&dst));
+    ASSERT_GT(dst.nrows(), 0) <<
+      "if HasNext() returns true, must return some rows";
+    for (int i = 0; i < dst.nrows(); i++) {
+      ASSERT_TRUE(dst.selection_vector()->IsRowSelected(i));
+      results->push_back(*kIntSchema.ExtractColumnFromRow<UINT32>(dst.row(i), 0));
+    }
+  }
+}
+
+TEST(TestParallelUnionIterator, TestUnion) {
+  const int kNumLists = 8;
+  TestIntRangePredicate predicate(FLAGS_num_rows / 2, FLAGS_num_rows * 2);
+  ScanSpec spec;
+  spec.AddPredicate(predicate.pred_);
+
+  vector<shared_ptr<RowwiseIterator>> to_union;
+  vector<uint32_t> expected;
+  for (int i = 0; i < kNumLists; i++) {
+    vector<uint32_t> ints;
+    for (int j = 0; j < FLAGS_num_rows; j++) {
+      uint32_t entry = rand() % (FLAGS_num_rows * 3);
+      ints.push_back(entry);
+      if (entry >= predicate.lower_ && entry < predicate.upper_) {
+        expected.push_back(entry);
+      }
+    }
+    // Vary the block sizes so that some blocks are split across several
+    // calls to NextBlock() and others are filtered out entirely.
+    shared_ptr<VectorIterator> it(new VectorIterator(ints));
+    it->set_block_size(1 + i * 50);
+    to_union.emplace_back(new MaterializingIterator(it));
+  }
+  // One of the inputs has no rows at all.
+  to_union.emplace_back(new MaterializingIterator(
+      shared_ptr<ColumnwiseIterator>(new VectorIterator({}))));
+
+  // The pool has fewer threads than the iterator may use.
+  gscoped_ptr<ThreadPool> pool;
+  ASSERT_OK(ThreadPoolBuilder("scan").set_max_threads(2).Build(&pool));
+  ParallelUnionIterator iter(to_union, pool.get(), 3, 2);
+  ASSERT_OK(iter.Init(&spec));
+  ASSERT_EQ(0, spec.predicates().size()) << "should have accepted all predicates";
+
+  vector<uint32_t> results;
+  NO_FATALS(CollectUnorderedResults(&iter, &results));
+
+  std::sort(expected.begin(), expected.end());
+  std::sort(results.begin(), results.end());
+  ASSERT_EQ(expected, results);
+}
+
+// Test that destroying the iterator before it is fully consumed stops the
+// pool threads, even those waiting for space in the queue.
+TEST(TestParallelUnionIterator, TestDestroyBeforeExhausted) {
+  vector<shared_ptr<RowwiseIterator>> to_union;
+  for (int i = 0; i < 4; i++) {
+    vector<uint32_t> ints(FLAGS_num_rows, i);
+    shared_ptr<VectorIterator> it(new VectorIterator(ints));
+    it->set_block_size(10);
+    to_union.emplace_back(new MaterializingIterator(it));
+  }
+
+  gscoped_ptr<ThreadPool> pool;
+  ASSERT_OK(ThreadPoolBuilder("scan").set_max_threads(4).Build(&pool));
+  ParallelUnionIterator iter(to_union, pool.get(), 4, 1);
+  ASSERT_OK(iter.Init(nullptr));
+  ASSERT_TRUE(iter.HasNext());
+  RowBlock dst(kIntSchema, 100, nullptr);
+  ASSERT_OK(iter.NextBlock(&dst));
+  ASSERT_GT(dst.nrows(), 0);
+}
+
+// Test that scans sharing a pool with a single thread each get all of their
+// rows, one scan's tasks waiting for those of the other to finish.
+TEST(TestParallelUnionIterator, TestSharedPool) {
+  gscoped_ptr<ThreadPool> pool;
+  ASSERT_OK(ThreadPoolBuilder("scan").set_max_threads(1).Build(&pool));
+
+  vector<unique_ptr<ParallelUnionIterator>> iters;
+  for (int scan = 0; scan < 2; scan++) {
+    vector<shared_ptr<RowwiseIterator>> to_union;
+    for (int i = 0; i < 3; i++) {
+      vector<uint32_t> ints(10, scan);
+      to_union.emplace_back(new MaterializingIterator(
+          shared_ptr<ColumnwiseIterator>(new VectorIterator(ints))));
+    }
+    // Each scan may queue all of its blocks, so that the single pool thread
+    // isn't held up by a scan which isn't read yet.
+    iters.emplace_back(new ParallelUnionIterator(to_union, pool.get(), 2, 3));
+    ASSERT_OK(iters.back()->Init(nullptr));
+  }
+  for (int scan = 1; scan >= 0; scan--) {
+    SCOPED_TRACE(scan);
+    vector<uint32_t> results;
+    NO_FATALS(CollectUnorderedResults(iters[scan].get(), &results));
+    ASSERT_EQ(vector<uint32_t>(30, scan), results);
+  }
+}
+
+// Interleaves more scans than there are pool threads, each with a queue too
+// small to hold all of its blocks. A pool task must not wait for a scan's
+// client to make room in its queue, or the scans would deadlock.
+TEST(TestParallelUnionIterator, TestSharedPoolSmallQueues) {
+  const int kNumScans = 4;
+  const int kNumRows = 100;
+  gscoped_ptr<ThreadPool> pool;
+  ASSERT_OK(ThreadPoolBuilder("scan").set_max_threads(1).Build(&pool));
+
+  vector<unique_ptr<ParallelUnionIterator>> iters;
+  for (int scan = 0; scan < kNumScans; scan++) {
+    vector<shared_ptr<RowwiseIterator>> to_union;
+    for (int i = 0; i < 3; i++) {
+      shared_ptr<VectorIterator> it(new VectorIterator(vector<uint32_t>(kNumRows, scan)));
+      it->set_block_size(10);
+      to_union.emplace_back(new MaterializingIterator(it));
+    }
+    iters.emplace_back(new ParallelUnionIterator(to_union, pool.get(), 2, 1));
+    ASSERT_OK(iters.back()->Init(nullptr));
+  }
+
+  // Read a block of each scan in turn until all of them are exhausted.
+  vector<vector<uint32_t>> results(kNumScans);
+  RowBlock dst(kIntSchema, 10, nullptr);
+  bool any_has_next = true;
+  while (any_has_next) {
+    any_has_next = false;
+    for (int scan = 0; scan < kNumScans; scan++) {
+      if (!iters[scan]->HasNext()) continue;
+      any_has_next = true;
+      ASSERT_OK(iters[scan]->NextBlock(&dst));
+      ASSERT_GT(dst.nrows(), 0);
+      for (int i = 0; i < dst.nrows(); i++) {
+        results[scan].push_back(*kIntSchema.ExtractColumnFromRow<UINT32>(dst.row(i), 0));
+      }
+    }
+  }
+  for (int scan = 0; scan < kNumScans; scan++) {
+    SCOPED_TRACE(scan);
+    ASSERT_EQ(vector<uint32_t>(3 * kNumRows, scan), results[scan]);
+  }
+}
+
+// Microbenchmark for merging inputs with varying degrees of overlap.
+//
+// Each of the 'num_inputs' inputs yields 'FLAGS_num_rows' consecutive integers.
+// With an overlap ratio of 0 the inputs cover disjoint key ranges (as with
+// rowsets produced by sequential inserts), whereas with an overlap ratio of 1
+// they all cover the same key range (as after heavy random upserts).
+void BenchmarkMerge(int num_inputs, double overlap) {
+  const int kBlockSize = 100;
+  const uint32_t stride = static_cast<uint32_t>(FLAGS_num_rows * (1 - overlap));
+  vector<shared_ptr<RowwiseIterator>> to_merge;
+  for (int i = 0; i < num_inputs; i++) {
+    vector<uint32_t> ints;
+    ints.reserve(FLAGS_num_rows);
+    for (int j = 0; j < FLAGS_num_rows; j++) {
+      ints.push_back(i * stride + j);
+    }
+    shared_ptr<VectorIterator> it(new VectorIterator(std::move(ints)));
+    it->set_block_size(kBlockSize);
+    to_merge.emplace_back(new MaterializingIterator(it));
+  }
+
+  MergeIterator merger(kIntSchema, std::move(to_merge));
+  ASSERT_OK(merger.Init(nullptr));
+
+  LOG_TIMING(INFO, strings::Substitute("merging $0 inputs with $1% overlap",
+                                       num_inputs, static_cast<int>(overlap * 100))) {
+    RowBlock dst(kIntSchema, kBlockSize, nullptr);
+    size_t total_rows = 0;
+    uint32_t prev = 0;
+    while (merger.HasNext()) {
+      ASSERT_OK(merger.NextBlock(&dst));
+      ASSERT_GT(dst.nrows(), 0);
+      for (int i = 0; i < dst.nrows(); i++) {
+        uint32_t this_row = *kIntSchema.ExtractColumnFromRow<UINT32>(dst.row(i), 0);
+        ASSERT_LE(prev, this_row) << "Yielded out of order at idx " << total_rows;
+        prev = this_row;
+        total_rows++;
+      }
+    }
+    ASSERT_EQ(static_cast<size_t>(num_inputs) * FLAGS_num_rows, total_rows);
+  }
+}
+
+TEST(TestMergeIterator, BenchmarkMergeOverlap) {
+  vector<int> num_inputs = { 2, 10, 100 };
+  if (AllowSlowTests()) {
+    num_inputs.push_back(300);
+  }
+  for (int n : num_inputs) {
+    for (double overlap : { 0.0, 0.5, 1.0 }) {
+      SCOPED_TRACE(strings::Substitute("$0 inputs, $1 overlap", n, overlap));
+      NO_FATALS(BenchmarkMerge(n, overlap));
+    }
+  }
+}
+
 // Test that the MaterializingIterator properly evaluates predicates when they apply
 // to single columns.
 TEST(TestMaterializingIterator, TestMaterializingPredicatePushdown) {
@@ -277,6 +487,125 @@ TEST(TestMaterializingIterator, TestMaterializingPredicatePushdown) {
   ASSERT_FALSE(dst.selection_vector()->IsRowSelected(30));
 }
 
+static const Schema kTwoIntSchema({ ColumnSchema("a", UINT32),
+                                    ColumnSchema("b", UINT32) }, 1);
+
+// Test iterator which yields rows of two integer columns from the provided
+// vectors.
+class TwoColumnVectorIterator : public ColumnwiseIterator {
+ public:
+  TwoColumnVectorIterator(vector<uint32_t> a, vector<uint32_t> b)
+      : cols_({ std::move(a), std::move(b) }),
+        cur_idx_(0),
+        prepared_(0) {
+    CHECK_EQ(cols_[0].size(), cols_[1].size());
+  }
+
+  Status Init(ScanSpec* spec) OVERRIDE {
+    return Status::OK();
+  }
+
+  Status PrepareBatch(size_t* nrows) OVERRIDE {
+    prepared_ = std::min(*nrows, cols_[0].size() - cur_idx_);
+    *nrows = prepared_;
+    return Status::OK();
+  }
+
+  Status InitializeSelectionVector(SelectionVector* sel_vec) OVERRIDE {
+    sel_vec->SetAllTrue();
+    return Status::OK();
+  }
+
+  Status MaterializeColumn(ColumnMaterializationContext* ctx) override {
+    ctx->SetDecoderEvalNotSupported();
+    const vector<uint32_t>& col = cols_[ctx->col_idx()];
+    for (size_t i = 0; i < prepared_; i++) {
+      ctx->block()->SetCellValue(i, &col[cur_idx_ + i]);
+    }
+    return Status::OK();
+  }
+
+  Status FinishBatch() OVERRIDE {
+    cur_idx_ += prepared_;
+    prepared_ = 0;
+    return Status::OK();
+  }
+
+  bool HasNext() const OVERRIDE {
+    return cur_idx_ < cols_[0].size();
+  }
+
+  string ToString() const OVERRIDE {
+    return string("TwoColumnVectorIterator");
+  }
+
+  const Schema& schema() const OVERRIDE {
+    return kTwoIntSchema;
+  }
+
+  void GetIteratorStats(vector<IteratorStats>* stats) const OVERRIDE {
+    stats->resize(schema().num_columns());
+  }
+
+ private:
+  const vector<vector<uint32_t>> cols_;
+  size_t cur_idx_;
+  size_t prepared_;
+};
+
+// Test that the MaterializingIterator moves the predicate which filters out the
+// most rows to the front, even when its estimated selectivity is worse, and that
+// the reordering doesn't change the results.
+TEST(TestMaterializingIterator, TestAdaptivePredicateOrder) {
+  google::FlagSaver saver;
+  FLAGS_materializing_iterator_predicate_reorder_blocks = 2;
+  const int kNumRows = 2000;
+  const int kBlockSize = 100;
+
+  // Every row passes the IN list on 'a', while only one in ten passes the range
+  // on 'b'. By estimate, the IN list is the more selective of the two.
+  vector<uint32_t> a;
+  vector<uint32_t> b;
+  for (int i = 0; i < kNumRows; i++) {
+    a.push_back(i % 10);
+    b.push_back(i % 100);
+  }
+  vector<uint32_t> in_values = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+  vector<const void*> in_list;
+  for (const auto& v : in_values) {
+    in_list.push_back(&v);
+  }
+  uint32_t lower = 0;
+  uint32_t upper = 10;
+  ScanSpec spec;
+  spec.AddPredicate(ColumnPredicate::InList(kTwoIntSchema.column(0), &in_list));
+  spec.AddPredicate(ColumnPredicate::Range(kTwoIntSchema.column(1), &lower, &upper));
+
+  shared_ptr<TwoColumnVectorIterator> colwise(new TwoColumnVectorIterator(a, b));
+  MaterializingIterator materializing(colwise);
+  ASSERT_OK(materializing.Init(&spec));
+  ASSERT_EQ(2, materializing.col_idx_predicates_.size());
+  ASSERT_EQ(0, get<0>(materializing.col_idx_predicates_[0]));
+
+  Arena arena(1024);
+  RowBlock dst(kTwoIntSchema, kBlockSize, &arena);
+  int num_selected = 0;
+  int row_offset = 0;
+  while (materializing.HasNext()) {
+    ASSERT_OK(materializing.NextBlock(&dst));
+    for (size_t i = 0; i < dst.nrows(); i++) {
+      ASSERT_EQ((row_offset + i) % 100 < 10, dst.selection_vector()->IsRowSelected(i));
+    }
+    num_selected += dst.selection_vector()->CountSelected();
+    row_offset += dst.nrows();
+  }
+  ASSERT_EQ(kNumRows, row_offset);
+  ASSERT_EQ(kNumRows / 10, num_selected);
+
+  // The range on 'b' should now be evaluated first.
+  ASSERT_EQ(1, get<0>(materializing.col_idx_predicates_[0]));
+}
+
 // Test that PredicateEvaluatingIterator will properly evaluate predicates on its
 // input.
 TEST(TestPredicateEvaluatingIterator, TestPredicateEvaluation) {
@@ -20,6 +20,7 @@
 #include <algorithm>
 #include <cstdint>
 #include <iterator>
+#include <limits>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -40,9 +41,12 @@
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/map-util.h"
+#include "kudu/gutil/strings/join.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/walltime.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/memory/arena.h"
+#include "kudu/util/threadpool.h"
 
 using std::all_of;
 using std::get;
@@ -50,6 +54,7 @@ using std::move;
 using std::remove_if;
 using std::shared_ptr;
 using std::sort;
+using std::stable_sort;
 using std::string;
 using std::tuple;
 using std::unique_ptr;
@@ -62,6 +67,14 @@ DEFINE_bool(materializing_iterator_decoder_eval, true,
             "Should MaterializingIterator do decoder-level evaluation");
 TAG_FLAG(materializing_iterator_decoder_eval, hidden);
 TAG_FLAG(materializing_iterator_decoder_eval, runtime);
+DEFINE_int32(materializing_iterator_predicate_reorder_blocks, 16,
+             "Number of blocks after which MaterializingIterator reorders the "
+             "predicates of a scan by their observed cost and selectivity, so "
+             "that the ones filtering out the most rows per unit of work are "
+             "evaluated first. If 0, the predicates keep the order given by their "
+             "estimated selectivity.");
+TAG_FLAG(materializing_iterator_predicate_reorder_blocks, advanced);
+TAG_FLAG(materializing_iterator_predicate_reorder_blocks, runtime);
 
 namespace kudu {
 namespace {
@@ -97,7 +110,7 @@ class MergeIterState {
       num_valid_(0)
   {}
 
-  const RowBlockRow& next_row() {
+  const RowBlockRow& next_row() const {
     DCHECK_LT(num_advanced_, num_valid_);
     return next_row_;
   }
@@ -142,10 +155,16 @@ class MergeIterState {
       DCHECK_LE(selection->CountSelected(), read_block_.nrows());
       num_valid_ = selection->CountSelected();
       VLOG(2) << selection->CountSelected() << "/" << read_block_.nrows() << " rows selected";
-      // Seek next_row_ to the first selected row.
+      // Seek next_row_ to the first selected row, and last_row_ to the last.
       for (next_row_idx_ = 0; next_row_idx_ < read_block_.nrows(); next_row_idx_++) {
         if (selection->IsRowSelected(next_row_idx_)) {
           next_row_.Reset(&read_block_, next_row_idx_);
+          for (size_t i = read_block_.nrows(); i-- > next_row_idx_;) {
+            if (selection->IsRowSelected(i)) {
+              last_row_.Reset(&read_block_, i);
+              break;
+            }
+          }
           return Status::OK();
         }
       }
@@ -159,6 +178,13 @@ class MergeIterState {
     return Status::OK();
   }
 
+  // The last selected row of the current block. Any rows in the current
+  // block sort at or before this one.
+  const RowBlockRow& last_row() const {
+    DCHECK_LT(num_advanced_, num_valid_);
+    return last_row_;
+  }
+
   size_t remaining_in_block() const {
     return num_valid_ - num_advanced_;
   }
@@ -172,6 +198,8 @@ class MergeIterState {
   RowBlock read_block_;
   // The row currently pointed to by the iterator.
   RowBlockRow next_row_;
+  // The last selected row in read_block_.
+  RowBlockRow last_row_;
   // Row index of next_row_ in read_block_.
   size_t next_row_idx_;
   // Number of rows we've advanced past in the current RowBlock.
@@ -180,11 +208,29 @@ class MergeIterState {
   size_t num_valid_;
 };
 
+// Orders MergeIterStates by their next row, such that the standard library
+// heap functions produce a min-heap.
+class MergeIterStateGreater {
+ public:
+  explicit MergeIterStateGreater(const MergeIterator* merge_iter)
+      : merge_iter_(merge_iter) {
+  }
+
+  bool operator()(const MergeIterState* a, const MergeIterState* b) const {
+    return merge_iter_->CompareKeys(a->next_row(), b->next_row()) > 0;
+  }
+
+ private:
+  const MergeIterator* merge_iter_;
+};
+
 
 MergeIterator::MergeIterator(
     const Schema& schema,
-    vector<shared_ptr<RowwiseIterator>> iters)
+    vector<shared_ptr<RowwiseIterator>> iters,
+    shared_ptr<const RowKeyComparator> key_comparator)
     : schema_(schema),
+      key_comparator_(std::move(key_comparator)),
       initted_(false),
       orig_iters_(std::move(iters)),
       finished_iter_stats_by_col_(schema_.num_columns()),
@@ -214,6 +260,12 @@ Status MergeIterator::Init(ScanSpec *spec) {
       }),
       iters_.end());
 
+  heap_.reserve(iters_.size());
+  for (const auto& state : iters_) {
+    heap_.push_back(state.get());
+  }
+  std::make_heap(heap_.begin(), heap_.end(), MergeIterStateGreater(this));
+
   initted_ = true;
   return Status::OK();
 }
@@ -272,42 +324,74 @@ Status MergeIterator::MaterializeBlock(RowBlock *dst) {
   // Initialize the selection vector.
   // MergeIterState only returns selected rows.
   dst->selection_vector()->SetAllTrue();
-  for (size_t dst_row_idx = 0; dst_row_idx < dst->nrows(); dst_row_idx++) {
-    RowBlockRow dst_row = dst->row(dst_row_idx);
-
-    // Find the sub-iterator which is currently smallest
-    MergeIterState *smallest = nullptr;
-    ssize_t smallest_idx = -1;
-
-    // Typically the number of iters_ is not that large, so using a priority
-    // queue is not worth it
-    for (size_t i = 0; i < iters_.size(); i++) {
-      unique_ptr<MergeIterState> &state = iters_[i];
-
-      if (smallest == nullptr ||
-          schema_.Compare(state->next_row(), smallest->next_row()) < 0) {
-        smallest = state.get();
-        smallest_idx = i;
-      }
-    }
-
+  size_t dst_row_idx = 0;
+  while (dst_row_idx < dst->nrows()) {
     // If no iterators had any row left, then we're done iterating.
-    if (PREDICT_FALSE(smallest == nullptr)) break;
+    if (PREDICT_FALSE(heap_.empty())) break;
+
+    // Pop the sub-iterator which is currently smallest. The new top of the
+    // heap bounds how far we can copy from it before switching.
+    MergeIterStateGreater greater(this);
+    std::pop_heap(heap_.begin(), heap_.end(), greater);
+    MergeIterState* smallest = heap_.back();
+    heap_.pop_back();
+    const MergeIterState* next = heap_.empty() ? nullptr : heap_.front();
+
+    RETURN_NOT_OK(CopyRowsFromSmallest(smallest, next, dst, &dst_row_idx));
+    ReturnToHeap(smallest);
+  }
 
-    // Otherwise, copy the row from the smallest one, and advance it
-    RETURN_NOT_OK(CopyRow(smallest->next_row(), &dst_row, dst->arena()));
-    RETURN_NOT_OK(smallest->Advance());
+  return Status::OK();
+}
 
-    if (smallest->IsFullyExhausted()) {
-      std::lock_guard<rw_spinlock> l(iters_lock_);
-      AddIterStats(*smallest->iter(), &finished_iter_stats_by_col_);
-      iters_.erase(iters_.begin() + smallest_idx);
+Status MergeIterator::CopyRowsFromSmallest(MergeIterState* state,
+                                           const MergeIterState* next,
+                                           RowBlock* dst,
+                                           size_t* dst_row_idx) {
+  bool copied_any = false;
+  while (*dst_row_idx < dst->nrows() && !state->IsFullyExhausted()) {
+    // Fast path: the rest of this block doesn't overlap any other
+    // sub-iterator, so copy it without comparing keys row by row.
+    if (next == nullptr || CompareKeys(state->last_row(), next->next_row()) < 0) {
+      size_t n = std::min(state->remaining_in_block(), dst->nrows() - *dst_row_idx);
+      for (size_t i = 0; i < n; i++) {
+        RowBlockRow dst_row = dst->row((*dst_row_idx)++);
+        RETURN_NOT_OK(CopyRow(state->next_row(), &dst_row, dst->arena()));
+        RETURN_NOT_OK(state->Advance());
+      }
+      copied_any = true;
+      continue;
     }
-  }
 
+    if (copied_any && CompareKeys(state->next_row(), next->next_row()) >= 0) {
+      break;
+    }
+    RowBlockRow dst_row = dst->row((*dst_row_idx)++);
+    RETURN_NOT_OK(CopyRow(state->next_row(), &dst_row, dst->arena()));
+    RETURN_NOT_OK(state->Advance());
+    copied_any = true;
+  }
   return Status::OK();
 }
 
+int MergeIterator::CompareKeys(const RowBlockRow& lhs, const RowBlockRow& rhs) const {
+  return key_comparator_ ? key_comparator_->Compare(lhs, rhs) : schema_.Compare(lhs, rhs);
+}
+
+void MergeIterator::ReturnToHeap(MergeIterState* state) {
+  if (!state->IsFullyExhausted()) {
+    heap_.push_back(state);
+    std::push_heap(heap_.begin(), heap_.end(), MergeIterStateGreater(this));
+    return;
+  }
+  std::lock_guard<rw_spinlock> l(iters_lock_);
+  AddIterStats(*state->iter(), &finished_iter_stats_by_col_);
+  iters_.erase(std::find_if(iters_.begin(), iters_.end(),
+                            [state](const unique_ptr<MergeIterState>& s) {
+                              return s.get() == state;
+                            }));
+}
+
 string MergeIterator::ToString() const {
   return strings::Substitute("Merge($0 iters)", num_orig_iters_);
 }
@@ -444,12 +528,298 @@ void UnionIterator::GetIteratorStats(std::vector<IteratorStats>* stats) const {
   }
 }
 
+////////////////////////////////////////////////////////////
+// Parallel union iterator
+////////////////////////////////////////////////////////////
+
+// The number of rows in each block read by the pool threads.
+static const int kParallelUnionBlockRows = 1000;
+
+// A block of rows read from a sub-iterator, along with the arena holding its
+// indirect data.
+struct ParallelUnionIterator::Batch {
+  explicit Batch(const Schema& schema)
+      : arena(32 * 1024),
+        block(schema, kParallelUnionBlockRows, &arena) {
+  }
+
+  Arena arena;
+  RowBlock block;
+};
+
+ParallelUnionIterator::ParallelUnionIterator(vector<shared_ptr<RowwiseIterator>> iters,
+                                             ThreadPool* pool, int num_threads,
+                                             int max_queued_blocks)
+    : initted_(false),
+      num_threads_(num_threads),
+      max_queued_blocks_(max_queued_blocks),
+      iters_(std::move(iters)),
+      pool_(CHECK_NOTNULL(pool)),
+      batch_available_(&lock_),
+      num_pending_(0),
+      num_tasks_(0),
+      next_iter_idx_(0),
+      num_running_(0),
+      stopping_(false),
+      cur_row_idx_(0) {
+  CHECK_GT(iters_.size(), 0);
+  CHECK_GT(num_threads_, 0);
+  CHECK_GT(max_queued_blocks_, 0);
+}
+
+ParallelUnionIterator::~ParallelUnionIterator() {
+  {
+    MutexLock l(lock_);
+    stopping_ = true;
+  }
+  if (token_) {
+    token_->Shutdown();
+  }
+}
+
+Status ParallelUnionIterator::Init(ScanSpec *spec) {
+  CHECK(!initted_);
+
+  RETURN_NOT_OK(InitSubIterators(spec));
+
+  schema_.reset(new Schema(iters_.front()->schema()));
+  for (const shared_ptr<RowwiseIterator> &iter : iters_) {
+    if (!iter->schema().Equals(*schema_)) {
+      return Status::InvalidArgument(
+        string("Schemas do not match: ") + schema_->ToString()
+        + " vs " + iter->schema().ToString());
+    }
+  }
+  finished_iter_stats_by_col_.resize(schema_->num_columns());
+
+  // Rather than submitting a task per sub-iterator, which would let a single
+  // scan take over the shared pool, submit up to 'num_threads_' tasks which
+  // each read sub-iterators one after the other.
+  token_ = pool_->NewToken(ThreadPool::ExecutionMode::CONCURRENT);
+  int num_tasks;
+  {
+    MutexLock l(lock_);
+    num_running_ = iters_.size();
+    num_tasks = NumTasksToSubmitUnlocked();
+  }
+  RETURN_NOT_OK(SubmitTasks(num_tasks));
+
+  initted_ = true;
+  return Status::OK();
+}
+
+Status ParallelUnionIterator::InitSubIterators(ScanSpec *spec) {
+  for (shared_ptr<RowwiseIterator> &iter : iters_) {
+    ScanSpec *spec_copy = spec != nullptr ? scan_spec_copies_.Construct(*spec) : nullptr;
+    RETURN_NOT_OK(PredicateEvaluatingIterator::InitAndMaybeWrap(&iter, spec_copy));
+  }
+  if (spec != nullptr) {
+    spec->RemovePredicates();
+  }
+  return Status::OK();
+}
+
+RowwiseIterator* ParallelUnionIterator::NextSubIteratorUnlocked() {
+  lock_.AssertAcquired();
+  if (!paused_iters_.empty()) {
+    RowwiseIterator* iter = paused_iters_.back();
+    paused_iters_.pop_back();
+    return iter;
+  }
+  if (next_iter_idx_ < iters_.size()) {
+    return iters_[next_iter_idx_++].get();
+  }
+  return nullptr;
+}
+
+int ParallelUnionIterator::NumTasksToSubmitUnlocked() {
+  lock_.AssertAcquired();
+  if (stopping_) {
+    return 0;
+  }
+  const int num_iters = paused_iters_.size() + (iters_.size() - next_iter_idx_);
+  const int room = max_queued_blocks_ - std::min(max_queued_blocks_,
+                                                 queue_.size() + num_pending_);
+  const int num_tasks = std::max(0, std::min({ num_threads_ - num_tasks_, num_iters, room }));
+  num_tasks_ += num_tasks;
+  return num_tasks;
+}
+
+Status ParallelUnionIterator::SubmitTasks(int num_tasks) {
+  for (int i = 0; i < num_tasks; i++) {
+    Status s = token_->SubmitFunc([this]() { this->DrainSubIterators(); });
+    if (PREDICT_FALSE(!s.ok())) {
+      MutexLock l(lock_);
+      num_tasks_ -= num_tasks - i;
+      if (status_.ok()) {
+        status_ = s;
+      }
+      stopping_ = true;
+      batch_available_.Broadcast();
+      return s;
+    }
+  }
+  return Status::OK();
+}
+
+void ParallelUnionIterator::DrainSubIterators() {
+  RowwiseIterator* iter = nullptr;
+  unique_ptr<Batch> batch;
+  while (true) {
+    {
+      MutexLock l(lock_);
+      if (iter == nullptr && !stopping_) {
+        iter = NextSubIteratorUnlocked();
+      }
+      // Rather than wait for the caller to make room in the queue, which
+      // would hold a thread of the shared pool for as long as the client
+      // takes to come back for more rows, leave the sub-iterator to a task
+      // submitted by NextBlock() once there's room.
+      if (stopping_ || iter == nullptr ||
+          queue_.size() + num_pending_ >= max_queued_blocks_) {
+        if (iter != nullptr && !stopping_) {
+          paused_iters_.push_back(iter);
+        }
+        num_tasks_--;
+        return;
+      }
+      num_pending_++;
+    }
+
+    Status s;
+    bool exhausted = !iter->HasNext();
+    if (!exhausted) {
+      if (!batch) {
+        batch.reset(new Batch(*schema_));
+      }
+      batch->arena.Reset();
+      s = iter->NextBlock(&batch->block);
+    }
+
+    MutexLock l(lock_);
+    num_pending_--;
+    if (PREDICT_FALSE(!s.ok())) {
+      if (status_.ok()) {
+        status_ = s.CloneAndPrepend(
+            strings::Substitute("Failed to read from $0", iter->ToString()));
+      }
+      stopping_ = true;
+      num_tasks_--;
+      batch_available_.Broadcast();
+      return;
+    }
+    if (exhausted) {
+      if (!stopping_) {
+        AddIterStats(*iter, &finished_iter_stats_by_col_);
+      }
+      iter = nullptr;
+      num_running_--;
+      batch_available_.Broadcast();
+      continue;
+    }
+    // Reuse the block rather than queueing it if the predicates filtered
+    // out all of its rows.
+    if (!batch->block.selection_vector()->AnySelected()) continue;
+    queue_.emplace_back(std::move(batch));
+    batch_available_.Signal();
+  }
+}
+
+void ParallelUnionIterator::WaitForBatchUnlocked() const {
+  lock_.AssertAcquired();
+  while (queue_.empty() && num_running_ > 0 && status_.ok()) {
+    batch_available_.Wait();
+  }
+}
+
+bool ParallelUnionIterator::CurBatchHasRows() const {
+  return cur_batch_ && cur_row_idx_ < cur_batch_->block.nrows();
+}
+
+bool ParallelUnionIterator::HasNext() const {
+  CHECK(initted_);
+  if (CurBatchHasRows()) return true;
+
+  MutexLock l(lock_);
+  WaitForBatchUnlocked();
+  return !queue_.empty() || !status_.ok();
+}
+
+Status ParallelUnionIterator::NextBlock(RowBlock* dst) {
+  CHECK(initted_);
+  if (dst->arena()) {
+    dst->arena()->Reset();
+  }
+
+  int num_tasks = 0;
+  if (!CurBatchHasRows()) {
+    // Only now release the previous block, since rows returned from it by the
+    // last call may still refer to its arena.
+    cur_batch_.reset();
+    MutexLock l(lock_);
+    WaitForBatchUnlocked();
+    RETURN_NOT_OK(status_);
+    if (queue_.empty()) {
+      dst->Resize(0);
+      return Status::OK();
+    }
+    cur_batch_ = std::move(queue_.front());
+    queue_.pop_front();
+    cur_row_idx_ = 0;
+    num_tasks = NumTasksToSubmitUnlocked();
+  }
+  RETURN_NOT_OK(SubmitTasks(num_tasks));
+
+  // Copy out the selected rows of the current block. Queued blocks always
+  // have at least one selected row, and 'cur_row_idx_' is always left at a
+  // selected row (or the end of the block), so this returns at least one row.
+  const RowBlock& src = cur_batch_->block;
+  const SelectionVector* src_sel = src.selection_vector();
+  dst->Resize(dst->row_capacity());
+  size_t dst_row_idx = 0;
+  while (dst_row_idx < dst->nrows() && cur_row_idx_ < src.nrows()) {
+    if (src_sel->IsRowSelected(cur_row_idx_)) {
+      RowBlockRow dst_row = dst->row(dst_row_idx++);
+      RETURN_NOT_OK(CopyRow(src.row(cur_row_idx_), &dst_row, dst->arena()));
+    }
+    cur_row_idx_++;
+  }
+  while (cur_row_idx_ < src.nrows() && !src_sel->IsRowSelected(cur_row_idx_)) {
+    cur_row_idx_++;
+  }
+  dst->Resize(dst_row_idx);
+  dst->selection_vector()->SetAllTrue();
+  return Status::OK();
+}
+
+string ParallelUnionIterator::ToString() const {
+  string s;
+  s.append("ParallelUnion(");
+  bool first = true;
+  for (const shared_ptr<RowwiseIterator> &iter : iters_) {
+    if (!first) {
+      s.append(", ");
+    }
+    first = false;
+    s.append(iter->ToString());
+  }
+  s.append(")");
+  return s;
+}
+
+void ParallelUnionIterator::GetIteratorStats(std::vector<IteratorStats>* stats) const {
+  CHECK(initted_);
+  MutexLock l(lock_);
+  *stats = finished_iter_stats_by_col_;
+}
+
 ////////////////////////////////////////////////////////////
 // Materializing iterator
 ////////////////////////////////////////////////////////////
 
 MaterializingIterator::MaterializingIterator(shared_ptr<ColumnwiseIterator> iter)
     : iter_(move(iter)),
+      blocks_since_reorder_(0),
       disallow_pushdown_for_tests_(!FLAGS_materializing_iterator_do_pushdown),
       disallow_decoder_eval_(!FLAGS_materializing_iterator_decoder_eval) {
 }
@@ -472,7 +842,7 @@ Status MaterializingIterator::Init(ScanSpec *spec) {
         return Status::InvalidArgument("No such column", col_pred.first);
       }
       VLOG(1) << "Pushing down predicate " << pred.ToString();
-      col_idx_predicates_.emplace_back(col_idx, col_pred.second);
+      col_idx_predicates_.emplace_back(col_idx, col_pred.second, PredicateStats());
     }
 
     for (int32_t col_idx = 0; col_idx < schema().num_columns(); col_idx++) {
@@ -491,12 +861,15 @@ Status MaterializingIterator::Init(ScanSpec *spec) {
     }
   }
 
-  // Sort the predicates by selectivity so that the most selective are evaluated earlier.
+  // Sort the predicates by selectivity so that the most selective are evaluated
+  // earlier. This is only an estimate until ReorderPredicates() has observed
+  // the predicates on some data.
   sort(col_idx_predicates_.begin(), col_idx_predicates_.end(),
-       [] (const tuple<int32_t, ColumnPredicate>& left,
-           const tuple<int32_t, ColumnPredicate>& right) {
-         return SelectivityComparator(get<1>(left), get<1>(right));
+       [] (const tuple<int32_t, ColumnPredicate, PredicateStats>& left,
+           const tuple<int32_t, ColumnPredicate, PredicateStats>& right) {
+         return SelectivityComparator(get<1>(left), get<1>(right)) < 0;
        });
+  blocks_since_reorder_ = 0;
 
   return Status::OK();
 }
@@ -524,7 +897,15 @@ Status MaterializingIterator::MaterializeBlock(RowBlock *dst) {
   // been deleted.
   RETURN_NOT_OK(iter_->InitializeSelectionVector(dst->selection_vector()));
 
-  for (const auto& col_pred : col_idx_predicates_) {
+  // With a single predicate there is no order to pick.
+  const int reorder_blocks = FLAGS_materializing_iterator_predicate_reorder_blocks;
+  const bool adaptive = reorder_blocks > 0 && col_idx_predicates_.size() > 1;
+  if (adaptive && blocks_since_reorder_++ >= reorder_blocks) {
+    ReorderPredicates();
+  }
+
+  size_t num_selected = adaptive ? dst->selection_vector()->CountSelected() : 0;
+  for (auto& col_pred : col_idx_predicates_) {
     // Materialize the column itself into the row block.
     ColumnBlock dst_col(dst->column_block(get<0>(col_pred)));
     ColumnMaterializationContext ctx(get<0>(col_pred),
@@ -536,14 +917,27 @@ Status MaterializingIterator::MaterializeBlock(RowBlock *dst) {
     if (disallow_decoder_eval_) {
       ctx.SetDecoderEvalNotSupported();
     }
+    const int64_t start_cycles = adaptive ? CycleClock::Now() : 0;
     RETURN_NOT_OK(iter_->MaterializeColumn(&ctx));
     if (ctx.DecoderEvalNotSupported()) {
       get<1>(col_pred).Evaluate(dst_col, dst->selection_vector());
     }
 
+    bool any_selected;
+    if (adaptive) {
+      PredicateStats* stats = &get<2>(col_pred);
+      stats->cycles += CycleClock::Now() - start_cycles;
+      stats->rows_in += num_selected;
+      num_selected = dst->selection_vector()->CountSelected();
+      stats->rows_passed += num_selected;
+      any_selected = num_selected > 0;
+    } else {
+      any_selected = dst->selection_vector()->AnySelected();
+    }
+
     // If after evaluating this predicate the entire row block has been filtered
     // out, we don't need to materialize other columns at all.
-    if (!dst->selection_vector()->AnySelected()) {
+    if (!any_selected) {
       DVLOG(1) << "0/" << dst->nrows() << " passed predicate";
       return Status::OK();
     }
@@ -564,6 +958,42 @@ Status MaterializingIterator::MaterializeBlock(RowBlock *dst) {
   return Status::OK();
 }
 
+void MaterializingIterator::ReorderPredicates() {
+  // Since each predicate only sees the rows passing the ones before it, rank
+  // them by the cycles spent per row they filter out. Predicates which have not
+  // filtered out any rows, or which have never been evaluated because earlier
+  // ones filtered out everything, go last in their current order.
+  auto rank = [] (const PredicateStats& stats) {
+    int64_t rows_dropped = stats.rows_in - stats.rows_passed;
+    if (rows_dropped <= 0) {
+      return std::numeric_limits<double>::infinity();
+    }
+    return static_cast<double>(stats.cycles) / rows_dropped;
+  };
+  stable_sort(col_idx_predicates_.begin(), col_idx_predicates_.end(),
+              [&] (const tuple<int32_t, ColumnPredicate, PredicateStats>& left,
+                   const tuple<int32_t, ColumnPredicate, PredicateStats>& right) {
+                return rank(get<2>(left)) < rank(get<2>(right));
+              });
+
+  // Halve the observations so that older blocks weigh less and the order can
+  // adapt to changes in the data over the course of the scan.
+  for (auto& col_pred : col_idx_predicates_) {
+    PredicateStats* stats = &get<2>(col_pred);
+    stats->rows_in /= 2;
+    stats->rows_passed /= 2;
+    stats->cycles /= 2;
+  }
+  blocks_since_reorder_ = 0;
+  if (VLOG_IS_ON(2)) {
+    vector<string> order;
+    for (const auto& col_pred : col_idx_predicates_) {
+      order.emplace_back(get<1>(col_pred).ToString());
+    }
+    VLOG(2) << "Reordered predicates: " << JoinStrings(order, ", ");
+  }
+}
+
 string MaterializingIterator::ToString() const {
   string s;
   s.append("Materializing(").append(iter_->ToString()).append(")");
@@ -604,7 +1034,10 @@ Status PredicateEvaluatingIterator::Init(ScanSpec *spec) {
   spec->RemovePredicates();
 
   // Sort the predicates by selectivity so that the most selective are evaluated earlier.
-  sort(col_idx_predicates_.begin(), col_idx_predicates_.end(), SelectivityComparator);
+  sort(col_idx_predicates_.begin(), col_idx_predicates_.end(),
+       [] (const ColumnPredicate& left, const ColumnPredicate& right) {
+         return SelectivityComparator(left, right) < 0;
+       });
 
   return Status::OK();
 }
@@ -36,7 +36,9 @@
 #include "kudu/common/schema.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/port.h"
+#include "kudu/util/condition_variable.h"
 #include "kudu/util/locks.h"
+#include "kudu/util/mutex.h"
 #include "kudu/util/object_pool.h"
 #include "kudu/util/status.h"
 
@@ -44,6 +46,19 @@ namespace kudu {
 
 class MergeIterState;
 class RowBlock;
+class RowBlockRow;
+class ThreadPool;
+class ThreadPoolToken;
+
+// Compares the keys of rows of a fixed schema, as Schema::Compare() does.
+// This lets the owners of a MergeIterator supply a comparison specialized
+// for the key columns of their schema (see codegen::RowKeyComparator).
+class RowKeyComparator {
+ public:
+  virtual ~RowKeyComparator() {}
+
+  virtual int Compare(const RowBlockRow& lhs, const RowBlockRow& rhs) const = 0;
+};
 
 // An iterator which merges the results of other iterators, comparing
 // based on keys.
@@ -52,8 +67,12 @@ class MergeIterator : public RowwiseIterator {
   // TODO: clarify whether schema is just the projection, or must include the merge
   // key columns. It should probably just be the required projection, which must be
   // a subset of the columns in 'iters'.
+  //
+  // If 'key_comparator' is not NULL, it is used to compare the keys of rows
+  // of 'schema' instead of Schema::Compare().
   MergeIterator(const Schema& schema,
-                std::vector<std::shared_ptr<RowwiseIterator>> iters);
+                std::vector<std::shared_ptr<RowwiseIterator>> iters,
+                std::shared_ptr<const RowKeyComparator> key_comparator = nullptr);
   virtual ~MergeIterator();
 
   // The passed-in iterators should be already initialized.
@@ -70,12 +89,35 @@ class MergeIterator : public RowwiseIterator {
   virtual Status NextBlock(RowBlock* dst) OVERRIDE;
 
  private:
+  friend class MergeIterStateGreater;
+
   void PrepareBatch(RowBlock* dst);
   Status MaterializeBlock(RowBlock* dst);
   Status InitSubIterators(ScanSpec *spec);
 
+  // Copies rows from 'state' into 'dst' starting at '*dst_row_idx', for as
+  // long as they sort before the next row of 'next' (the sub-iterator with
+  // the next smallest row, or NULL if there is none). At least one row is
+  // always copied. '*dst_row_idx' is advanced past the copied rows.
+  //
+  // If the remainder of the current block of 'state' sorts entirely before
+  // 'next', it is copied without any per-row comparisons.
+  Status CopyRowsFromSmallest(MergeIterState* state,
+                              const MergeIterState* next,
+                              RowBlock* dst,
+                              size_t* dst_row_idx);
+
+  // Adds 'state' to 'heap_' or, if it is fully exhausted, removes it from
+  // 'iters_' and accumulates its final statistics.
+  void ReturnToHeap(MergeIterState* state);
+
+  // Compares the keys of two rows of 'schema_'.
+  int CompareKeys(const RowBlockRow& lhs, const RowBlockRow& rhs) const;
+
   const Schema schema_;
 
+  const std::shared_ptr<const RowKeyComparator> key_comparator_;
+
   bool initted_;
 
   // Holds the subiterators until Init is called, at which point this is cleared.
@@ -87,6 +129,10 @@ class MergeIterator : public RowwiseIterator {
   mutable rw_spinlock iters_lock_;
   std::vector<std::unique_ptr<MergeIterState>> iters_;
 
+  // Min-heap (by next row key) of the non-exhausted sub-iterators in
+  // 'iters_', maintained with std::push_heap() and std::pop_heap().
+  std::vector<MergeIterState*> heap_;
+
   // Statistics (keyed by projection column index) accumulated so far by any
   // fully-consumed sub-iterators.
   std::vector<IteratorStats> finished_iter_stats_by_col_;
@@ -168,12 +214,151 @@ class UnionIterator : public RowwiseIterator {
   ObjectPool<ScanSpec> scan_spec_copies_;
 };
 
+// An iterator which unions the results of other iterators, like UnionIterator,
+// but reads up to 'num_threads' of them at once on 'pool', which is shared
+// with other scans and bounds how many threads they use altogether.
+//
+// Each sub-iterator is read by one pool task at a time into row blocks of
+// its own, which are handed over to the caller through a queue holding at
+// most 'max_queued_blocks' blocks. Once the queue is full, the pool tasks
+// return rather than wait, so that a scan whose client is slow neither holds
+// threads of the shared pool nor uses more memory; NextBlock() submits tasks
+// again as it makes room in the queue. The rows of the sub-iterators are
+// interleaved in no particular order, and only selected rows are returned.
+//
+// The passed-in iterators should not yet be initialized. As with UnionIterator,
+// they must be fully able to evaluate all predicates. They must also be safe
+// to drive from a thread other than the one which created them.
+class ParallelUnionIterator : public RowwiseIterator {
+ public:
+  ParallelUnionIterator(std::vector<std::shared_ptr<RowwiseIterator>> iters,
+                        ThreadPool* pool, int num_threads, int max_queued_blocks);
+
+  // Stops the pool tasks, waiting for any in-progress blocks to finish.
+  virtual ~ParallelUnionIterator();
+
+  Status Init(ScanSpec *spec) OVERRIDE;
+
+  // May block until a pool thread produces a block or all of the
+  // sub-iterators are exhausted.
+  bool HasNext() const OVERRIDE;
+
+  std::string ToString() const OVERRIDE;
+
+  const Schema &schema() const OVERRIDE {
+    CHECK(initted_);
+    return *CHECK_NOTNULL(schema_.get());
+  }
+
+  // Only includes the statistics of the sub-iterators which have been fully
+  // consumed, since the others are concurrently in use by the pool threads.
+  virtual void GetIteratorStats(std::vector<IteratorStats>* stats) const OVERRIDE;
+
+  // Indirect data of the returned rows is copied into the arena of 'dst' if it
+  // has one; otherwise it remains valid until the next call to NextBlock().
+  virtual Status NextBlock(RowBlock* dst) OVERRIDE;
+
+ private:
+  struct Batch;
+
+  Status InitSubIterators(ScanSpec *spec);
+
+  // Reads blocks of the sub-iterators, one sub-iterator after the other,
+  // until none is left or the queue is full. Runs on the pool, as one of up
+  // to 'num_threads_' tasks.
+  void DrainSubIterators();
+
+  // Returns the next sub-iterator for a task to read, or null if there's
+  // none. 'lock_' must be held.
+  RowwiseIterator* NextSubIteratorUnlocked();
+
+  // Returns how many more tasks to submit to fill the queue, and counts them
+  // as running. 'lock_' must be held.
+  int NumTasksToSubmitUnlocked();
+
+  // Submits 'num_tasks' tasks running DrainSubIterators().
+  Status SubmitTasks(int num_tasks);
+
+  // Waits until there is a queued block, a sub-iterator has failed, or all
+  // of them are exhausted. 'lock_' must be held.
+  void WaitForBatchUnlocked() const;
+
+  // Returns true if 'cur_batch_' still has rows to return.
+  bool CurBatchHasRows() const;
+
+  // Schema: initialized during Init()
+  gscoped_ptr<Schema> schema_;
+  bool initted_;
+
+  const int num_threads_;
+  const size_t max_queued_blocks_;
+
+  // Only modified by Init() before the pool threads start, so safe to read
+  // without 'lock_'.
+  std::vector<std::shared_ptr<RowwiseIterator>> iters_;
+
+  ThreadPool* const pool_;
+
+  // The token through which the tasks of this iterator are submitted to
+  // 'pool_'. Set by Init().
+  std::unique_ptr<ThreadPoolToken> token_;
+
+  // Protects all of the state shared with the pool threads, below.
+  mutable Mutex lock_;
+
+  // Signaled when a block is queued or a sub-iterator finishes.
+  ConditionVariable batch_available_;
+
+  std::deque<std::unique_ptr<Batch>> queue_;
+
+  // The number of blocks being read by the pool tasks, which have a place
+  // in the queue reserved for them.
+  size_t num_pending_;
+
+  // The number of pool tasks submitted which haven't returned yet.
+  int num_tasks_;
+
+  // The index in 'iters_' of the next sub-iterator for a pool task to start.
+  size_t next_iter_idx_;
+
+  // Sub-iterators which were started, but left by their task because the
+  // queue was full.
+  std::vector<RowwiseIterator*> paused_iters_;
+
+  // The number of sub-iterators which have not yet been fully drained.
+  int num_running_;
+
+  // Set when the pool threads should stop reading, either because the
+  // iterator is being destroyed or because a sub-iterator failed.
+  bool stopping_;
+
+  // The first error encountered by a sub-iterator, if any.
+  Status status_;
+
+  // Statistics (keyed by projection column index) accumulated so far by any
+  // fully-consumed sub-iterators.
+  std::vector<IteratorStats> finished_iter_stats_by_col_;
+
+  // The block currently being returned by NextBlock(), and the index of its
+  // next row to consider. Only accessed by the caller's thread.
+  std::unique_ptr<Batch> cur_batch_;
+  size_t cur_row_idx_;
+
+  // See UnionIterator::scan_spec_copies_.
+  ObjectPool<ScanSpec> scan_spec_copies_;
+};
+
 // An iterator which wraps a ColumnwiseIterator, materializing it into full rows.
 //
 // Column predicates are pushed down into this iterator. While materializing a
 // block, columns with associated predicates are materialized first, and the
 // predicates evaluated. If the predicates succeed in filtering out an entire
 // batch, then other columns may avoid doing any IO.
+//
+// The predicates are initially ordered by their estimated selectivity. As the
+// scan proceeds, the iterator tracks how many rows each predicate filters out
+// and how long it takes to do so, and periodically reorders them so that the
+// predicates which discard the most rows per unit of work are evaluated first.
 class MaterializingIterator : public RowwiseIterator {
  public:
   explicit MaterializingIterator(std::shared_ptr<ColumnwiseIterator> iter);
@@ -198,13 +383,35 @@ class MaterializingIterator : public RowwiseIterator {
  private:
   FRIEND_TEST(TestMaterializingIterator, TestPredicatePushdown);
   FRIEND_TEST(TestPredicateEvaluatingIterator, TestPredicateEvaluation);
+  FRIEND_TEST(TestMaterializingIterator, TestAdaptivePredicateOrder);
+
+  // The observed cost and selectivity of a pushed-down predicate.
+  struct PredicateStats {
+    // The number of rows which were selected before evaluating the predicate,
+    // and the number of them which passed it.
+    int64_t rows_in = 0;
+    int64_t rows_passed = 0;
+
+    // The CPU cycles spent materializing the column and evaluating the predicate.
+    int64_t cycles = 0;
+  };
 
   Status MaterializeBlock(RowBlock *dst);
 
+  // Reorders 'col_idx_predicates_' by the cost of each predicate per row it
+  // filters out, as observed so far, and decays the observations so that the
+  // order follows changes in the data.
+  void ReorderPredicates();
+
   std::shared_ptr<ColumnwiseIterator> iter_;
 
-  // List of (column index, predicate) in order of most to least selective.
-  std::vector<std::tuple<int32_t, ColumnPredicate>> col_idx_predicates_;
+  // List of (column index, predicate, observed stats) in the order in which
+  // the predicates are evaluated: initially from most to least selective by
+  // estimate, later by ReorderPredicates().
+  std::vector<std::tuple<int32_t, ColumnPredicate, PredicateStats>> col_idx_predicates_;
+
+  // The number of blocks materialized since the predicates were last reordered.
+  int blocks_since_reorder_;
 
   // List of column indexes without predicates to materialize.
   std::vector<int32_t> non_predicate_column_indexes_;
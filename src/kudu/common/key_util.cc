@@ -229,6 +229,9 @@ int PushUpperBoundKeyPredicates(ColIdxIter first,
         pushed_predicates++;
         break;
       case PredicateType::Range:
+      case PredicateType::InBloomFilter:
+        // The bounds of a bloom filter predicate are pushed as those of a
+        // range predicate.
         if (predicate->raw_upper() != nullptr) {
           memcpy(row->mutable_cell_ptr(*col_idx_it), predicate->raw_upper(), size);
           pushed_predicates++;
@@ -295,6 +298,7 @@ int PushLowerBoundKeyPredicates(ColIdxIter first,
 
     switch (predicate->predicate_type()) {
       case PredicateType::Range:
+      case PredicateType::InBloomFilter:
         if (predicate->raw_lower() == nullptr) {
           break_loop = true;
           break;
@@ -871,6 +871,82 @@ TEST_F(PartitionPrunerTest, TestMultiColumnInListHashPruning) {
         6, 2);
 }
 
+TEST_F(PartitionPrunerTest, TestInListRangePruning) {
+  // CREATE TABLE t
+  // (a INT8, b INT8)
+  // PRIMARY KEY (a, b)
+  // DISTRIBUTE BY HASH(b) INTO 2 BUCKETS,
+  //               RANGE(a) SPLIT ROWS [(0), (10), (20), (30)];
+  Schema schema({ ColumnSchema("a", INT8),
+                  ColumnSchema("b", INT8) },
+                { ColumnId(0), ColumnId(1) },
+                2);
+
+  PartitionSchema partition_schema;
+  auto pb = PartitionSchemaPB();
+  auto hash_component = pb.add_hash_bucket_schemas();
+  hash_component->add_columns()->set_name("b");
+  hash_component->set_num_buckets(2);
+  hash_component->set_seed(0);
+  pb.mutable_range_schema()->add_columns()->set_name("a");
+  ASSERT_OK(PartitionSchema::FromPB(pb, schema, &partition_schema));
+
+  vector<KuduPartialRow> splits;
+  for (int8_t split : { 0, 10, 20, 30 }) {
+    KuduPartialRow row(&schema);
+    ASSERT_OK(row.SetInt8("a", split));
+    splits.emplace_back(std::move(row));
+  }
+  vector<Partition> partitions;
+  ASSERT_OK(partition_schema.CreatePartitions(splits, {}, schema, &partitions));
+  ASSERT_EQ(10, partitions.size());
+
+  // Applies the specified predicates to a scan and checks that the expected
+  // number of partitions are pruned.
+  auto Check = [&] (const vector<ColumnPredicate>& predicates,
+                    size_t remaining_tablets,
+                    size_t pruner_ranges) {
+    ScanSpec spec;
+
+    for (const auto& pred : predicates) {
+      spec.AddPredicate(pred);
+    }
+
+    CheckPrunedPartitions(schema, partition_schema, partitions, spec,
+                          remaining_tablets, pruner_ranges);
+  };
+
+  int8_t zero = 0;
+  int8_t five = 5;
+  int8_t six = 6;
+  int8_t twenty_five = 25;
+  int8_t max = INT8_MAX;
+  vector<const void*> a_values;
+
+  // a = 5
+  Check({ ColumnPredicate::Equality(schema.column(0), &five) }, 2, 2);
+
+  // a in [5, 25]: only the tablets of each value are scanned, not those in
+  // between.
+  a_values = { &five, &twenty_five };
+  Check({ ColumnPredicate::InList(schema.column(0), &a_values) }, 4, 4);
+
+  // a in [5, 6]
+  a_values = { &five, &six };
+  Check({ ColumnPredicate::InList(schema.column(0), &a_values) }, 2, 4);
+
+  // a in [5, 25], b = 0
+  a_values = { &five, &twenty_five };
+  Check({ ColumnPredicate::InList(schema.column(0), &a_values),
+          ColumnPredicate::Equality(schema.column(1), &zero) },
+        2, 2);
+
+  // a in [5, 127]: the highest value has no exclusive upper bound, so the
+  // values are only used as bounds.
+  a_values = { &five, &max };
+  Check({ ColumnPredicate::InList(schema.column(0), &a_values) }, 8, 2);
+}
+
 TEST_F(PartitionPrunerTest, TestPruning) {
   // CREATE TABLE timeseries
   // (host STRING, metric STRING, time UNIXTIME_MICROS, value DOUBLE)
@@ -181,6 +181,85 @@ void EncodeRangeKeysFromPredicates(const Schema& schema,
     key_util::EncodeKey(col_idxs, row, range_key_end);
   }
 }
+
+// The maximum number of combinations of the values of the equality and IN-list
+// predicates on the range columns for which EncodeRangeKeysFromInListPredicates
+// generates a range key range per combination.
+const size_t kMaxRangeKeyCombinations = 1024;
+
+// If all the range columns have equality or IN-list predicates, at least one
+// of which is an IN-list, and there are no more than kMaxRangeKeyCombinations
+// combinations of their values, appends to 'range_keys' the range key range
+// of each combination, in increasing order, and returns true. Otherwise,
+// returns false: the range keys are then bounded by the lowest and highest
+// values of the IN-lists, and so are the partitions which are scanned.
+bool EncodeRangeKeysFromInListPredicates(const Schema& schema,
+                                         const unordered_map<string, ColumnPredicate>& predicates,
+                                         const vector<ColumnId>& range_columns,
+                                         vector<tuple<string, string>>* range_keys) {
+  vector<vector<const void*>> values;
+  values.reserve(range_columns.size());
+  size_t num_combinations = 1;
+  bool has_in_list = false;
+  for (ColumnId column : range_columns) {
+    const ColumnPredicate* predicate =
+        FindOrNull(predicates, schema.column_by_id(column).name());
+    if (predicate == nullptr) {
+      return false;
+    }
+    if (predicate->predicate_type() == PredicateType::Equality) {
+      values.push_back({ predicate->raw_lower() });
+    } else if (predicate->predicate_type() == PredicateType::InList) {
+      values.push_back(predicate->raw_values());
+      has_in_list = true;
+    } else {
+      return false;
+    }
+    num_combinations *= values.back().size();
+    if (num_combinations > kMaxRangeKeyCombinations) {
+      return false;
+    }
+  }
+  if (!has_in_list) {
+    // The range key bounds of the equality predicates are already exact.
+    return false;
+  }
+
+  // Enumerate the combinations in increasing order, the last column varying
+  // fastest, since the values of each IN-list are sorted.
+  vector<tuple<string, string>> combination_keys;
+  combination_keys.reserve(num_combinations);
+  vector<size_t> value_idxs(range_columns.size(), 0);
+  for (size_t i = 0; i < num_combinations; i++) {
+    unordered_map<string, ColumnPredicate> combination;
+    for (size_t col = 0; col < range_columns.size(); col++) {
+      const ColumnSchema& column = schema.column_by_id(range_columns[col]);
+      combination.emplace(column.name(),
+                          ColumnPredicate::Equality(column, values[col][value_idxs[col]]));
+    }
+    string lower;
+    string upper;
+    EncodeRangeKeysFromPredicates(schema, combination, range_columns, &lower, &upper);
+    if (upper.empty()) {
+      // The combination is the highest possible range key, which can't be
+      // turned into an exclusive upper bound.
+      return false;
+    }
+    combination_keys.emplace_back(move(lower), move(upper));
+
+    for (int col = range_columns.size() - 1; col >= 0; col--) {
+      if (++value_idxs[col] < values[col].size()) {
+        break;
+      }
+      value_idxs[col] = 0;
+    }
+  }
+  range_keys->insert(range_keys->end(),
+                     std::make_move_iterator(combination_keys.begin()),
+                     std::make_move_iterator(combination_keys.end()));
+  return true;
+}
+
 } // anonymous namespace
 
 vector<bool> PartitionPruner::PruneHashComponent(
@@ -301,12 +380,20 @@ void PartitionPruner::Init(const Schema& schema,
   //    since it is precisely these highly-hash-partitioned tables which get the
   //    most benefit from pruning.
 
-  // Step 1: Build the range portion of the partition key.
-  string range_lower_bound;
-  string range_upper_bound;
+  // Step 1: Build the range portion of the partition key. If the range
+  // columns are constrained to a small set of values by IN-list predicates,
+  // there is a range per combination of the values. Otherwise, there is a
+  // single range.
+  vector<tuple<string, string>> range_keys;
   const vector<ColumnId>& range_columns = partition_schema.range_schema_.column_ids;
-  if (!range_columns.empty()) {
-    if (AreRangeColumnsPrefixOfPrimaryKey(schema, range_columns)) {
+  if (range_columns.empty() ||
+      !EncodeRangeKeysFromInListPredicates(schema, scan_spec.predicates(), range_columns,
+                                           &range_keys)) {
+    string range_lower_bound;
+    string range_upper_bound;
+    if (range_columns.empty()) {
+      // The range component is unconstrained.
+    } else if (AreRangeColumnsPrefixOfPrimaryKey(schema, range_columns)) {
       EncodeRangeKeysFromPrimaryKeyBounds(schema,
                                           scan_spec,
                                           range_columns.size(),
@@ -319,7 +406,13 @@ void PartitionPruner::Init(const Schema& schema,
                                     &range_lower_bound,
                                     &range_upper_bound);
     }
+    range_keys.emplace_back(move(range_lower_bound), move(range_upper_bound));
   }
+  // The ranges are sorted, and only the last one may be unbounded above.
+  const bool range_constrained = range_keys.size() > 1 ||
+                                 !get<0>(range_keys.front()).empty() ||
+                                 !get<1>(range_keys.front()).empty();
+  const bool range_unbounded_above = get<1>(range_keys.back()).empty();
 
   // Step 2: Create the hash bucket portion of the partition key.
 
@@ -352,7 +445,7 @@ void PartitionPruner::Init(const Schema& schema,
 
   // The index of the final constrained component in the partition key.
   int constrained_index;
-  if (!range_lower_bound.empty() || !range_upper_bound.empty()) {
+  if (range_constrained) {
     // The range component is constrained.
     constrained_index = partition_schema.hash_bucket_schemas_.size();
   } else {
@@ -379,7 +472,7 @@ void PartitionPruner::Init(const Schema& schema,
     // bucket, and the range upper bound is empty. In this case we need to
     // increment the bucket on the upper bound to convert from inclusive to
     // exclusive.
-    bool is_last = hash_idx + 1 == constrained_index && range_upper_bound.empty();
+    bool is_last = hash_idx + 1 == constrained_index && range_unbounded_above;
 
     vector<tuple<string, string>> new_partition_key_ranges;
     for (const auto& partition_key_range : partition_key_ranges) {
@@ -399,10 +492,23 @@ void PartitionPruner::Init(const Schema& schema,
     partition_key_ranges.swap(new_partition_key_ranges);
   }
 
-  // Step 3: append the (possibly empty) range bounds to the partition key ranges.
-  for (auto& range : partition_key_ranges) {
-    get<0>(range).append(range_lower_bound);
-    get<1>(range).append(range_upper_bound);
+  // Step 3: append the (possibly empty) range bounds to the partition key
+  // ranges, once per range of the range component.
+  if (range_keys.size() == 1) {
+    for (auto& range : partition_key_ranges) {
+      get<0>(range).append(get<0>(range_keys.front()));
+      get<1>(range).append(get<1>(range_keys.front()));
+    }
+  } else {
+    vector<tuple<string, string>> new_partition_key_ranges;
+    new_partition_key_ranges.reserve(partition_key_ranges.size() * range_keys.size());
+    for (const auto& partition_key_range : partition_key_ranges) {
+      for (const auto& range_key : range_keys) {
+        new_partition_key_ranges.emplace_back(get<0>(partition_key_range) + get<0>(range_key),
+                                              get<1>(partition_key_range) + get<1>(range_key));
+      }
+    }
+    partition_key_ranges.swap(new_partition_key_ranges);
   }
 
   // Step 4: remove all partition key ranges past the scan spec's upper bound partition key.
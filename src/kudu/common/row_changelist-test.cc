@@ -190,6 +190,36 @@ TEST_F(TestRowChangeList, TestReinserts) {
             RowChangeList(Slice(buf2)).ToString(schema_));
 }
 
+TEST_F(TestRowChangeList, TestMergeUpdates) {
+  faststring buf1, buf2;
+  Slice first("first");
+  Slice second("second");
+  uint32_t val = 12345;
+  RowChangeListEncoder rcl1(&buf1);
+  rcl1.AddColumnUpdate(schema_.column(1), schema_.column_id(1), &first);
+  rcl1.AddColumnUpdate(schema_.column(2), schema_.column_id(2), &val);
+  RowChangeListEncoder rcl2(&buf2);
+  rcl2.AddColumnUpdate(schema_.column(3), schema_.column_id(3), nullptr);
+  rcl2.AddColumnUpdate(schema_.column(1), schema_.column_id(1), &second);
+
+  // The last update of each column wins.
+  faststring merged_buf;
+  RowChangeListEncoder merged(&merged_buf);
+  ASSERT_OK(RowChangeListDecoder::MergeUpdates({ RowChangeList(buf1), RowChangeList(buf2) },
+                                               &merged));
+  EXPECT_EQ(R"(SET col2="second", col3=12345, col4=NULL)",
+            RowChangeList(merged_buf).ToString(schema_));
+
+  // Only updates may be merged.
+  faststring delete_buf;
+  RowChangeListEncoder(&delete_buf).SetToDelete();
+  faststring out_buf;
+  RowChangeListEncoder out(&out_buf);
+  Status s = RowChangeListDecoder::MergeUpdates({ RowChangeList(buf1), RowChangeList(delete_buf) },
+                                                &out);
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+}
+
 TEST_F(TestRowChangeList, TestInvalid_EmptySlice) {
   RowChangeListDecoder decoder((RowChangeList(Slice())));
   ASSERT_STR_CONTAINS(decoder.Init().ToString(),
@@ -18,8 +18,10 @@
 #include <algorithm>
 #include <cstdint>
 #include <cstring>
+#include <map>
 #include <ostream>
 #include <string>
+#include <vector>
 
 #include "kudu/common/common.pb.h"
 #include "kudu/common/columnblock.h"
@@ -303,6 +305,30 @@ Status RowChangeListDecoder::RemoveColumnIdsFromChangeList(const RowChangeList&
   return Status::OK();
 }
 
+Status RowChangeListDecoder::MergeUpdates(const std::vector<RowChangeList>& updates,
+                                          RowChangeListEncoder* out) {
+  // Keyed by column ID, so that the merged update is encoded in column order.
+  std::map<int, DecodedUpdate> last_updates;
+  for (const auto& update : updates) {
+    RowChangeListDecoder decoder(update);
+    RETURN_NOT_OK(decoder.Init());
+    if (PREDICT_FALSE(!decoder.is_update())) {
+      return Status::InvalidArgument("only UPDATEs may be merged");
+    }
+    while (decoder.HasNext()) {
+      DecodedUpdate dec;
+      RETURN_NOT_OK(decoder.DecodeNext(&dec));
+      last_updates[dec.col_id] = dec;
+    }
+  }
+
+  out->SetToUpdate();
+  for (const auto& e : last_updates) {
+    out->EncodeColumnMutationRaw(e.first, e.second.null, e.second.raw_value);
+  }
+  return Status::OK();
+}
+
 Status RowChangeListDecoder::DecodeNext(DecodedUpdate* dec) {
   DCHECK_NE(type_, RowChangeList::kUninitialized) << "Must call Init()";
   // Decode the column id.
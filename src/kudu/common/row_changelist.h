@@ -375,6 +375,14 @@ class RowChangeListDecoder {
                                               const std::vector<ColumnId>& column_ids,
                                               RowChangeListEncoder* out);
 
+  // Collapse the given UPDATEs, in the order they were applied, into a single
+  // UPDATE encoded in 'out': each column is set to the value of the last
+  // update of the column. Returns InvalidArgument if any of the changelists
+  // is not an UPDATE. 'out' must be valid for the duration of this method, but not have been
+  // previously initialized.
+  static Status MergeUpdates(const std::vector<RowChangeList>& updates,
+                             RowChangeListEncoder* out);
+
   struct DecodedUpdate {
     // The updated column ID.
     ColumnId col_id;
@@ -0,0 +1,152 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/common/row_checksum.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "kudu/common/common.pb.h"
+#include "kudu/common/rowblock.h"
+#include "kudu/common/schema.h"
+#include "kudu/util/memory/arena.h"
+#include "kudu/util/slice.h"
+#include "kudu/util/test_util.h"
+
+using std::vector;
+
+namespace kudu {
+
+static const int kBlockCapacity = 10;
+
+class RowChecksumTest : public KuduTest {
+ public:
+  RowChecksumTest()
+      : schema_({ ColumnSchema("key", INT32),
+                  ColumnSchema("val", INT64, true),
+                  ColumnSchema("str", STRING, true),
+                  ColumnSchema("b", BOOL) },
+                1),
+        arena_(1024) {
+  }
+
+ protected:
+  struct TestRow {
+    int32_t key;
+    // Negative values are NULL.
+    int64_t val;
+    // nullptr is NULL.
+    const char* str;
+    bool b;
+  };
+
+  // Returns the checksum of 'rows', checksummed in blocks of 'rows_per_block'.
+  uint64_t Checksum(const vector<TestRow>& rows, int rows_per_block) {
+    ColumnarRowChecksummer checksummer;
+    RowBlock block(schema_, kBlockCapacity, &arena_);
+    uint64_t checksum = 0;
+    for (int start = 0; start < rows.size(); start += rows_per_block) {
+      int end = std::min<int>(start + rows_per_block, rows.size());
+      block.Resize(end - start);
+      block.selection_vector()->SetAllTrue();
+      for (int i = start; i < end; i++) {
+        RowBlockRow row = block.row(i - start);
+        *reinterpret_cast<int32_t*>(row.mutable_cell_ptr(0)) = rows[i].key;
+        row.cell(1).set_null(rows[i].val < 0);
+        // The contents of NULL cells are undefined.
+        *reinterpret_cast<int64_t*>(row.mutable_cell_ptr(1)) = rows[i].val < 0 ? i : rows[i].val;
+        row.cell(2).set_null(rows[i].str == nullptr);
+        *reinterpret_cast<Slice*>(row.mutable_cell_ptr(2)) =
+            rows[i].str == nullptr ? Slice("garbage") : Slice(rows[i].str);
+        *reinterpret_cast<bool*>(row.mutable_cell_ptr(3)) = rows[i].b;
+      }
+      checksum += checksummer.SumRowHashes(block, schema_.num_columns());
+    }
+    return checksum;
+  }
+
+  Schema schema_;
+  Arena arena_;
+};
+
+TEST_F(RowChecksumTest, TestChecksum) {
+  const vector<TestRow> rows = {
+    { 1, 10, "a", true },
+    { 2, -1, "b", false },
+    { 3, 30, nullptr, true },
+    { 4, 40, "", false },
+    { 5, -1, nullptr, true },
+  };
+  const uint64_t checksum = Checksum(rows, kBlockCapacity);
+  ASSERT_NE(0, checksum);
+
+  // The checksum doesn't depend on how the rows are split into blocks, nor on
+  // their order.
+  ASSERT_EQ(checksum, Checksum(rows, 1));
+  ASSERT_EQ(checksum, Checksum(rows, 2));
+  ASSERT_EQ(checksum, Checksum({ rows[4], rows[2], rows[0], rows[3], rows[1] }, 3));
+
+  // It is the sum of the checksums of the rows.
+  uint64_t sum = 0;
+  for (const auto& row : rows) {
+    sum += Checksum({ row }, 1);
+  }
+  ASSERT_EQ(checksum, sum);
+
+  // A change of any cell changes the checksum.
+  const vector<vector<TestRow>> changed = {
+    { { 1, 11, "a", true } },
+    { { 1, 10, "A", true } },
+    { { 1, 10, "a", false } },
+    { { 6, 10, "a", true } },
+    // NULL differs from 0 and from the empty string.
+    { { 1, 0, "a", true } },
+    { { 1, -1, "a", true } },
+    { { 1, 10, nullptr, true } },
+  };
+  const uint64_t first = Checksum({ rows[0] }, 1);
+  for (const auto& change : changed) {
+    ASSERT_NE(first, Checksum(change, 1));
+  }
+  ASSERT_NE(Checksum({ { 4, 40, "", false } }, 1), Checksum({ { 4, 40, nullptr, false } }, 1));
+}
+
+TEST_F(RowChecksumTest, TestUnselectedRows) {
+  ColumnarRowChecksummer checksummer;
+  RowBlock block(schema_, kBlockCapacity, &arena_);
+  block.Resize(2);
+  block.selection_vector()->SetAllTrue();
+  for (int i = 0; i < 2; i++) {
+    RowBlockRow row = block.row(i);
+    *reinterpret_cast<int32_t*>(row.mutable_cell_ptr(0)) = i;
+    row.cell(1).set_null(true);
+    row.cell(2).set_null(true);
+    *reinterpret_cast<bool*>(row.mutable_cell_ptr(3)) = false;
+  }
+  const uint64_t both = checksummer.SumRowHashes(block, schema_.num_columns());
+  block.selection_vector()->SetRowUnselected(1);
+  const uint64_t first = checksummer.SumRowHashes(block, schema_.num_columns());
+  ASSERT_NE(both, first);
+  block.selection_vector()->SetAllTrue();
+  block.selection_vector()->SetRowUnselected(0);
+  ASSERT_EQ(both, first + checksummer.SumRowHashes(block, schema_.num_columns()));
+}
+
+} // namespace kudu
@@ -0,0 +1,164 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/common/row_checksum.h"
+
+#include <cstring>
+
+#include <glog/logging.h>
+
+#include "kudu/common/columnblock.h"
+#include "kudu/common/common.pb.h"
+#include "kudu/common/rowblock.h"
+#include "kudu/common/types.h"
+#include "kudu/gutil/hash/city.h"
+#include "kudu/util/bitmap.h"
+#include "kudu/util/slice.h"
+
+namespace kudu {
+
+namespace {
+
+const uint64_t kSeed = 0x2545f4914f6cdd1dULL;
+const uint64_t kMul = 0x9ddfea08eb382d69ULL;
+
+// Mixes 'v' into the hash 'h'. Mixing isn't commutative, so the same values
+// in different columns hash differently.
+inline uint64_t Mix(uint64_t h, uint64_t v) {
+  h = (h ^ v) * kMul;
+  return h ^ (h >> 47);
+}
+
+// The finalizer of MurmurHash3, so that the sum of the hashes of similar rows
+// doesn't cancel out.
+inline uint64_t Finalize(uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+// Mixes the cells of a fixed-length column of 'sizeof(T)' bytes into
+// 'hashes'. The contents of NULL cells are undefined, so they're masked out,
+// and whether each cell is NULL is mixed in as well.
+template<typename T, bool IS_NULLABLE>
+void MixFixedLengthColumn(const ColumnBlock& column, size_t nrows, uint64_t* hashes) {
+  const uint8_t* data = column.data();
+  const uint8_t* null_bitmap = column.null_bitmap();
+  for (size_t i = 0; i < nrows; i++) {
+    T value;
+    memcpy(&value, data + i * sizeof(T), sizeof(T));
+    uint64_t v = static_cast<uint64_t>(value);
+    uint64_t h = hashes[i];
+    if (IS_NULLABLE) {
+      const uint64_t not_null = BitmapTest(null_bitmap, i);
+      h = Mix(h, not_null);
+      v &= -not_null;
+    }
+    hashes[i] = Mix(h, v);
+  }
+}
+
+template<bool IS_NULLABLE>
+void MixInt128Column(const ColumnBlock& column, size_t nrows, uint64_t* hashes) {
+  const uint8_t* data = column.data();
+  const uint8_t* null_bitmap = column.null_bitmap();
+  for (size_t i = 0; i < nrows; i++) {
+    uint64_t halves[2];
+    memcpy(halves, data + i * sizeof(halves), sizeof(halves));
+    uint64_t h = hashes[i];
+    if (IS_NULLABLE) {
+      const uint64_t not_null = BitmapTest(null_bitmap, i);
+      h = Mix(h, not_null);
+      halves[0] &= -not_null;
+      halves[1] &= -not_null;
+    }
+    hashes[i] = Mix(Mix(h, halves[0]), halves[1]);
+  }
+}
+
+void MixBinaryColumn(const ColumnBlock& column, size_t nrows, uint64_t* hashes) {
+  const Slice* cells = reinterpret_cast<const Slice*>(column.data());
+  const bool is_nullable = column.is_nullable();
+  for (size_t i = 0; i < nrows; i++) {
+    uint64_t h = hashes[i];
+    if (is_nullable) {
+      const bool not_null = !column.is_null(i);
+      h = Mix(h, not_null);
+      if (!not_null) {
+        hashes[i] = Mix(h, 0);
+        continue;
+      }
+    }
+    hashes[i] = Mix(h, util_hash::CityHash64(reinterpret_cast<const char*>(cells[i].data()),
+                                             cells[i].size()));
+  }
+}
+
+template<typename T>
+void MixFixedLengthColumn(const ColumnBlock& column, size_t nrows, uint64_t* hashes) {
+  if (column.is_nullable()) {
+    MixFixedLengthColumn<T, true>(column, nrows, hashes);
+  } else {
+    MixFixedLengthColumn<T, false>(column, nrows, hashes);
+  }
+}
+
+} // anonymous namespace
+
+uint64_t ColumnarRowChecksummer::SumRowHashes(const RowBlock& block, size_t num_columns) {
+  const size_t nrows = block.nrows();
+  hashes_.assign(nrows, kSeed);
+  uint64_t* hashes = hashes_.data();
+
+  for (size_t j = 0; j < num_columns; j++) {
+    const ColumnBlock column = block.column_block(j);
+    if (column.type_info()->physical_type() == BINARY) {
+      MixBinaryColumn(column, nrows, hashes);
+      continue;
+    }
+    switch (column.stride()) {
+      case 1: MixFixedLengthColumn<uint8_t>(column, nrows, hashes); break;
+      case 2: MixFixedLengthColumn<uint16_t>(column, nrows, hashes); break;
+      case 4: MixFixedLengthColumn<uint32_t>(column, nrows, hashes); break;
+      case 8: MixFixedLengthColumn<uint64_t>(column, nrows, hashes); break;
+      case 16:
+        if (column.is_nullable()) {
+          MixInt128Column<true>(column, nrows, hashes);
+        } else {
+          MixInt128Column<false>(column, nrows, hashes);
+        }
+        break;
+      default:
+        LOG(FATAL) << "unexpected cell size " << column.stride() << " of type "
+                   << column.type_info()->name();
+    }
+  }
+
+  uint64_t sum = 0;
+  const SelectionVector* selection = block.selection_vector();
+  for (size_t i = 0; i < nrows; i++) {
+    if (selection->IsRowSelected(i)) {
+      sum += Finalize(hashes[i]);
+    }
+  }
+  return sum;
+}
+
+} // namespace kudu
@@ -0,0 +1,54 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_COMMON_ROW_CHECKSUM_H
+#define KUDU_COMMON_ROW_CHECKSUM_H
+
+#include <cstdint>
+#include <vector>
+
+#include "kudu/gutil/macros.h"
+
+namespace kudu {
+
+class RowBlock;
+
+// Computes the checksums of checksum scans: the sum of a 64-bit hash of each
+// row. Since the sum doesn't depend on how the rows are split into blocks,
+// replicas whose rows are laid out differently on disk have the same
+// checksum.
+//
+// The hashes are computed a column at a time: each column's cells are mixed
+// into the hashes of all the rows of a block in a tight, branch-free loop per
+// cell size, rather than copying each row into a buffer to compute its CRC.
+class ColumnarRowChecksummer {
+ public:
+  ColumnarRowChecksummer() {}
+
+  // Returns the sum of the hashes of the selected rows of 'block', over its
+  // first 'num_columns' columns.
+  uint64_t SumRowHashes(const RowBlock& block, size_t num_columns);
+
+ private:
+  // The hash of each row of the current block.
+  std::vector<uint64_t> hashes_;
+
+  DISALLOW_COPY_AND_ASSIGN(ColumnarRowChecksummer);
+};
+
+} // namespace kudu
+
+#endif // KUDU_COMMON_ROW_CHECKSUM_H
@@ -707,4 +707,48 @@ TEST_F(RowOperationsTest, SplitKeyRoundTrip) {
   CHECK(!row2->IsColumnSet("missing"));
 }
 
+// Test decoding operations of every type into partial rows of a schema
+// whose columns are in a different order.
+TEST_F(RowOperationsTest, DecodeAsPartialRows) {
+  Schema client_schema({ ColumnSchema("key", INT32),
+                         ColumnSchema("int_val", INT32, true),
+                         ColumnSchema("string_val", STRING, true) },
+                       1);
+  Schema target_schema({ ColumnSchema("key", INT32),
+                         ColumnSchema("string_val", STRING, true),
+                         ColumnSchema("int_val", INT32, true),
+                         ColumnSchema("other", INT64, true) },
+                       1);
+
+  RowOperationsPB pb;
+  RowOperationsPBEncoder enc(&pb);
+  KuduPartialRow row(&client_schema);
+  ASSERT_OK(row.SetInt32("key", 1));
+  ASSERT_OK(row.SetNull("int_val"));
+  ASSERT_OK(row.SetStringNoCopy("string_val", "foo"));
+  enc.Add(RowOperationsPB::INSERT, row);
+  KuduPartialRow key(&client_schema);
+  ASSERT_OK(key.SetInt32("key", 2));
+  enc.Add(RowOperationsPB::DELETE, key);
+
+  RowOperationsPBDecoder decoder(&pb, &client_schema, &target_schema, nullptr);
+  vector<DecodedRowOperation> ops;
+  ASSERT_OK(decoder.DecodeAsPartialRows(&ops));
+  ASSERT_EQ(2, ops.size());
+  ASSERT_EQ(RowOperationsPB::INSERT, ops[0].type);
+  ASSERT_EQ(R"(int32 key=1, string string_val="foo", int32 int_val=NULL)",
+            ops[0].split_row->ToString());
+  ASSERT_EQ(RowOperationsPB::DELETE, ops[1].type);
+  ASSERT_EQ("int32 key=2", ops[1].split_row->ToString());
+
+  // Every column of the client schema must exist in the target schema.
+  Schema missing_schema({ ColumnSchema("key", INT32),
+                          ColumnSchema("int_val", INT32, true) },
+                        1);
+  RowOperationsPBDecoder bad_decoder(&pb, &client_schema, &missing_schema, nullptr);
+  ops.clear();
+  Status s = bad_decoder.DecodeAsPartialRows(&ops);
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+}
+
 } // namespace kudu
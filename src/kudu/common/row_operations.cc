@@ -153,6 +153,7 @@ RowOperationsPBDecoder::RowOperationsPBDecoder(const RowOperationsPB* pb,
     dst_arena_(dst_arena),
     bm_size_(BitmapSize(client_schema_->num_columns())),
     tablet_row_size_(ContiguousRowHelper::row_size(*tablet_schema_)),
+    identity_mapping_(false),
     src_(pb->rows().data(), pb->rows().size()) {
 }
 
@@ -317,6 +318,20 @@ class ClientServerMapping {
     return Status::OK();
   }
 
+  // Return true if every tablet column is mapped from the client column
+  // with the same index, i.e. the client wrote with the tablet's own schema.
+  bool IsIdentity() const {
+    if (client_to_tablet_.size() != tablet_schema_->num_columns()) {
+      return false;
+    }
+    for (int i = 0; i < client_to_tablet_.size(); i++) {
+      if (client_to_tablet_[i] != i) {
+        return false;
+      }
+    }
+    return true;
+  }
+
  private:
   const Schema* const client_schema_;
   const Schema* const tablet_schema_;
@@ -330,7 +345,7 @@ Status RowOperationsPBDecoder::DecodeInsertOrUpsert(const uint8_t* prototype_row
                                                     const ClientServerMapping& mapping,
                                                     DecodedRowOperation* op) {
   const uint8_t* client_isset_map;
-  const uint8_t* client_null_map;
+  const uint8_t* client_null_map = nullptr;
 
   // Read the null and isset bitmaps for the client-provided row.
   RETURN_NOT_OK(ReadIssetBitmap(&client_isset_map));
@@ -355,6 +370,27 @@ Status RowOperationsPBDecoder::DecodeInsertOrUpsert(const uint8_t* prototype_row
   memcpy(tablet_row_storage, prototype_row_storage, tablet_row_size_);
   ContiguousRow tablet_row(tablet_schema_, tablet_row_storage);
 
+  // Fast path for rows which set every column of the tablet's own schema, as
+  // produced by bulk loaders: no index translation and no defaults to check.
+  const int num_cols = client_schema_->num_columns();
+  if (identity_mapping_ && BitMapIsAllSet(client_isset_map, 0, num_cols)) {
+    memcpy(tablet_isset_bitmap, client_isset_map, BitmapSize(num_cols));
+    for (int col_idx = 0; col_idx < num_cols; col_idx++) {
+      const ColumnSchema& col = tablet_schema_->column(col_idx);
+      bool is_null = false;
+      if (col.is_nullable()) {
+        is_null = client_null_map && BitmapTest(client_null_map, col_idx);
+        tablet_row.set_null(col_idx, is_null);
+      }
+      if (!is_null) {
+        RETURN_NOT_OK(ReadColumn(col, tablet_row.mutable_cell_ptr(col_idx)));
+      }
+    }
+    op->row_data = tablet_row_storage;
+    op->isset_bitmap = tablet_isset_bitmap;
+    return Status::OK();
+  }
+
   // Now handle each of the columns passed by the user, replacing the defaults
   // from the prototype.
   for (int client_col_idx = 0; client_col_idx < client_schema_->num_columns(); client_col_idx++) {
@@ -557,6 +593,59 @@ Status RowOperationsPBDecoder::DecodeSplitRow(const ClientServerMapping& mapping
   return Status::OK();
 }
 
+Status RowOperationsPBDecoder::DecodePartialRow(const ClientServerMapping& mapping,
+                                                DecodedRowOperation* op) {
+  op->split_row.reset(new KuduPartialRow(tablet_schema_));
+
+  const uint8_t* client_isset_map;
+  const uint8_t* client_null_map = nullptr;
+  RETURN_NOT_OK(ReadIssetBitmap(&client_isset_map));
+  if (client_schema_->has_nullables()) {
+    RETURN_NOT_OK(ReadNullBitmap(&client_null_map));
+  }
+
+  for (int client_col_idx = 0; client_col_idx < client_schema_->num_columns(); client_col_idx++) {
+    if (!BitmapTest(client_isset_map, client_col_idx)) {
+      continue;
+    }
+    int tablet_col_idx = mapping.client_to_tablet_idx(client_col_idx);
+    DCHECK_GE(tablet_col_idx, 0);
+    const ColumnSchema& col = tablet_schema_->column(tablet_col_idx);
+    if (client_null_map && client_schema_->column(client_col_idx).is_nullable() &&
+        BitmapTest(client_null_map, client_col_idx)) {
+      RETURN_NOT_OK(op->split_row->SetNull(tablet_col_idx));
+      continue;
+    }
+    Slice column_slice;
+    RETURN_NOT_OK(GetColumnSlice(col, &column_slice));
+    const uint8_t* data;
+    if (col.type_info()->physical_type() == BINARY) {
+      data = reinterpret_cast<const uint8_t*>(&column_slice);
+    } else {
+      data = column_slice.data();
+    }
+    RETURN_NOT_OK(op->split_row->Set(tablet_col_idx, data));
+  }
+  return Status::OK();
+}
+
+Status RowOperationsPBDecoder::DecodeAsPartialRows(vector<DecodedRowOperation>* ops) {
+  ClientServerMapping mapping(client_schema_, tablet_schema_);
+  RETURN_NOT_OK(client_schema_->GetProjectionMapping(*tablet_schema_, &mapping));
+  DCHECK_EQ(mapping.num_mapped(), client_schema_->num_columns());
+
+  while (HasNext()) {
+    DecodedRowOperation op;
+    RETURN_NOT_OK(ReadOpType(&op.type));
+    if (op.type == RowOperationsPB::UNKNOWN) {
+      return Status::NotSupported("Unknown row operation type");
+    }
+    RETURN_NOT_OK(DecodePartialRow(mapping, &op));
+    ops->push_back(op);
+  }
+  return Status::OK();
+}
+
 Status RowOperationsPBDecoder::DecodeOperations(vector<DecodedRowOperation>* ops) {
   // TODO: there's a bug here, in that if a client passes some column
   // in its schema that has been deleted on the server, it will fail
@@ -572,6 +661,7 @@ Status RowOperationsPBDecoder::DecodeOperations(vector<DecodedRowOperation>* ops
   RETURN_NOT_OK(client_schema_->GetProjectionMapping(*tablet_schema_, &mapping));
   DCHECK_EQ(mapping.num_mapped(), client_schema_->num_columns());
   RETURN_NOT_OK(mapping.CheckAllRequiredColumnsPresent());
+  identity_mapping_ = mapping.IsIdentity();
 
   // Make a "prototype row" which has all the defaults filled in. We can copy
   // this to create a starting point for each row as we decode it, with
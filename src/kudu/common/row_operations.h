@@ -66,7 +66,8 @@ struct DecodedRowOperation {
   // For UPDATE and DELETE types, the changelist
   RowChangeList changelist;
 
-  // For SPLIT_ROW, the partial row to split on.
+  // For SPLIT_ROW, the partial row to split on. For any type of operation
+  // decoded by DecodeAsPartialRows(), the cells set by the client.
   std::shared_ptr<KuduPartialRow> split_row;
 
   // Stringifies, including redaction when appropriate.
@@ -83,6 +84,15 @@ class RowOperationsPBDecoder {
 
   Status DecodeOperations(std::vector<DecodedRowOperation>* ops);
 
+  // Decodes each operation, whatever its type, into a KuduPartialRow of
+  // 'tablet_schema' holding the cells set by the client, e.g. to send the
+  // operations to another cluster. The columns are mapped by name, so
+  // 'tablet_schema' need not have column IDs; every column of the client
+  // schema must exist in it.
+  //
+  // The partial rows point to the data of 'pb' rather than copying it.
+  Status DecodeAsPartialRows(std::vector<DecodedRowOperation>* ops);
+
  private:
   Status ReadOpType(RowOperationsPB::Type* type);
   Status ReadIssetBitmap(const uint8_t** bitmap);
@@ -106,6 +116,11 @@ class RowOperationsPBDecoder {
   Status DecodeSplitRow(const ClientServerMapping& mapping,
                         DecodedRowOperation* op);
 
+  // Decode the next encoded row, including its NULL cells, into
+  // 'op->split_row'.
+  Status DecodePartialRow(const ClientServerMapping& mapping,
+                          DecodedRowOperation* op);
+
   const RowOperationsPB* const pb_;
   const Schema* const client_schema_;
   const Schema* const tablet_schema_;
@@ -113,6 +128,11 @@ class RowOperationsPBDecoder {
 
   const int bm_size_;
   const int tablet_row_size_;
+
+  // Whether the client schema maps onto the tablet schema column by column.
+  // Set by DecodeOperations().
+  bool identity_mapping_;
+
   Slice src_;
 
 
@@ -154,6 +154,23 @@ class SelectionVectorView {
     DCHECK_LE(nrows, sel_vec_->nrows() - row_offset_);
     BitmapChangeBits(sel_vec_->mutable_bitmap(), row_offset_, nrows, false);
   }
+  // Clears 'nrows' bits starting at 'row_idx'.
+  void ClearBits(size_t row_idx, size_t nrows) {
+    DCHECK_LE(row_idx + nrows, sel_vec_->nrows() - row_offset_);
+    BitmapChangeBits(sel_vec_->mutable_bitmap(), row_offset_ + row_idx, nrows, false);
+  }
+  // Returns the index of the first row in [row_idx, end) whose bit is
+  // 'selected', or 'end' if there is none.
+  size_t FindFirst(size_t row_idx, size_t end, bool selected) const {
+    DCHECK_LE(row_idx, end);
+    DCHECK_LE(end, sel_vec_->nrows() - row_offset_);
+    size_t idx;
+    if (!BitmapFindFirst(sel_vec_->bitmap(), row_offset_ + row_idx, row_offset_ + end,
+                         selected, &idx)) {
+      return end;
+    }
+    return idx - row_offset_;
+  }
  private:
   SelectionVector* sel_vec_;
   size_t row_offset_;
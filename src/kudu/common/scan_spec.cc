@@ -180,9 +180,11 @@ void ScanSpec::PushPredicatesIntoPrimaryKeyBounds(const Schema& schema,
       } else if (type == PredicateType::Range) {
         RemovePredicate(column);
         break;
-      } else if (type == PredicateType::InList) {
+      } else if (type == PredicateType::InList || type == PredicateType::InBloomFilter) {
         // InList predicates should not be removed as the full constraints imposed by an InList
-        // cannot be translated into only a single set of lower and upper bound primary keys
+        // cannot be translated into only a single set of lower and upper bound primary keys.
+        // Neither can the bloom filters of InBloomFilter predicates, whose bounds alone are
+        // pushed.
         break;
       } else {
         LOG(FATAL) << "Can not remove unknown predicate type";
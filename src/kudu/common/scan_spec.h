@@ -38,7 +38,8 @@ class ScanSpec {
       exclusive_upper_bound_key_(nullptr),
       lower_bound_partition_key_(),
       exclusive_upper_bound_partition_key_(),
-      cache_blocks_(true) {
+      cache_blocks_(true),
+      cache_pages_(true) {
   }
 
   // Add a predicate on the column.
@@ -119,6 +120,19 @@ class ScanSpec {
     cache_blocks_ = cache_blocks;
   }
 
+  // Whether the data read by the scan may be left in the OS page cache. If
+  // not, and the scan doesn't cache blocks either, it reads ahead in large
+  // chunks and drops them from the page cache once it's done with them.
+  // Meant for scans which read data that's about to be deleted, e.g. the
+  // inputs of compactions.
+  bool cache_pages() const {
+    return cache_pages_;
+  }
+
+  void set_cache_pages(bool cache_pages) {
+    cache_pages_ = cache_pages;
+  }
+
   std::string ToString(const Schema& s) const;
 
  private:
@@ -149,6 +163,7 @@ class ScanSpec {
   std::string lower_bound_partition_key_;
   std::string exclusive_upper_bound_partition_key_;
   bool cache_blocks_;
+  bool cache_pages_;
 };
 
 } // namespace kudu
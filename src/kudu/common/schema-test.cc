@@ -366,6 +366,44 @@ TEST(TestKeyEncoder, TestKeyEncoder) {
   }
 }
 
+// Test that composite keys encoded with the schema's cached key encoders
+// match those encoded column by column, including after the schema is
+// copied or swapped.
+TEST_F(TestSchema, TestEncodeComparableKey) {
+  Schema schema({ ColumnSchema("col1", STRING),
+                  ColumnSchema("col2", INT32),
+                  ColumnSchema("col3", UINT64),
+                  ColumnSchema("col4", STRING) },
+                3);
+
+  RowBuilder rb(schema);
+  rb.AddString(Slice("foo"));
+  rb.AddInt32(-3);
+  rb.AddUint64(12345);
+  rb.AddString(Slice("not in key"));
+  ConstContiguousRow row(&rb.schema(), rb.data());
+
+  faststring expected;
+  GetKeyEncoder<faststring>(GetTypeInfo(STRING)).Encode(row.cell_ptr(0), false, &expected);
+  GetKeyEncoder<faststring>(GetTypeInfo(INT32)).Encode(row.cell_ptr(1), false, &expected);
+  GetKeyEncoder<faststring>(GetTypeInfo(UINT64)).Encode(row.cell_ptr(2), true, &expected);
+
+  faststring fs;
+  ASSERT_EQ(expected.ToString(), schema.EncodeComparableKey(row, &fs).ToString());
+
+  Schema copy(schema);
+  ASSERT_EQ(expected.ToString(), copy.EncodeComparableKey(row, &fs).ToString());
+
+  Schema swapped;
+  swapped.swap(copy);
+  ASSERT_EQ(expected.ToString(), swapped.EncodeComparableKey(row, &fs).ToString());
+
+  Arena arena(256);
+  uint8_t* buf = static_cast<uint8_t*>(arena.AllocateBytes(schema.key_byte_size()));
+  ASSERT_OK(schema.DecodeRowKey(Slice(expected), buf, &arena));
+  ASSERT_EQ(0, schema.Compare(row, ConstContiguousRow(&schema, buf)));
+}
+
 TEST_F(TestSchema, TestDecodeKeys_CompoundStringKey) {
   Schema schema({ ColumnSchema("col1", STRING),
                   ColumnSchema("col2", STRING),
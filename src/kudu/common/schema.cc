@@ -146,6 +146,7 @@ void Schema::CopyFrom(const Schema& other) {
     name_to_index_[col.name()] = i++;
   }
 
+  key_encoders_ = other.key_encoders_;
   has_nullables_ = other.has_nullables_;
 }
 
@@ -156,6 +157,7 @@ void Schema::swap(Schema& other) {
   col_offsets_.swap(other.col_offsets_);
   name_to_index_.swap(other.name_to_index_);
   id_to_index_.swap(other.id_to_index_);
+  key_encoders_.swap(other.key_encoders_);
   std::swap(has_nullables_, other.has_nullables_);
 }
 
@@ -219,6 +221,14 @@ Status Schema::Reset(const vector<ColumnSchema>& cols,
     id_to_index_.set(ids[i], i);
   }
 
+  // Resolve the key encoders of the key columns.
+  key_encoders_.clear();
+  key_encoders_.reserve(key_columns);
+  for (int i = 0; i < key_columns; ++i) {
+    const TypeInfo* ti = cols_[i].type_info();
+    key_encoders_.push_back(IsTypeAllowableInKey(ti) ? &GetKeyEncoder<faststring>(ti) : nullptr);
+  }
+
   // Determine whether any column is nullable
   has_nullables_ = false;
   for (const ColumnSchema& col : cols_) {
@@ -231,6 +241,15 @@ Status Schema::Reset(const vector<ColumnSchema>& cols,
   return Status::OK();
 }
 
+int Schema::find_ttl_column() const {
+  for (int i = 0; i < cols_.size(); i++) {
+    if (cols_[i].attributes().ttl_sec > 0) {
+      return i;
+    }
+  }
+  return kColumnNotFound;
+}
+
 Status Schema::CreateProjectionByNames(const std::vector<StringPiece>& col_names,
                                        Schema* out) const {
   vector<ColumnId> ids;
@@ -356,12 +375,11 @@ Status Schema::DecodeRowKey(Slice encoded_key,
 
   for (size_t col_idx = 0; col_idx < num_key_columns(); ++col_idx) {
     const ColumnSchema& col = column(col_idx);
-    const KeyEncoder<faststring>& key_encoder = GetKeyEncoder<faststring>(col.type_info());
     bool is_last = col_idx == (num_key_columns() - 1);
-    RETURN_NOT_OK_PREPEND(key_encoder.Decode(&encoded_key,
-                                             is_last,
-                                             arena,
-                                             row.mutable_cell_ptr(col_idx)),
+    RETURN_NOT_OK_PREPEND(key_encoder(col_idx).Decode(&encoded_key,
+                                                      is_last,
+                                                      arena,
+                                                      row.mutable_cell_ptr(col_idx)),
                           strings::Substitute("Error decoding composite key component '$0'",
                                               col.name()));
   }
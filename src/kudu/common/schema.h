@@ -96,13 +96,19 @@ struct ColumnStorageAttributes {
   ColumnStorageAttributes()
     : encoding(AUTO_ENCODING),
       compression(DEFAULT_COMPRESSION),
-      cfile_block_size(0) {
+      cfile_block_size(0),
+      ttl_sec(0),
+      secondary_index(false),
+      bloom_filter(false) {
   }
 
   ColumnStorageAttributes(EncodingType enc, CompressionType cmp)
     : encoding(enc),
       compression(cmp),
-      cfile_block_size(0) {
+      cfile_block_size(0),
+      ttl_sec(0),
+      secondary_index(false),
+      bloom_filter(false) {
   }
 
   std::string ToString() const;
@@ -113,6 +119,19 @@ struct ColumnStorageAttributes {
   // The preferred block size for cfile blocks. If 0, uses the
   // server-wide default.
   int32_t cfile_block_size;
+
+  // If positive, the column is the table's time-to-live column: rows expire
+  // this many seconds after the time held in the column. See
+  // ColumnSchemaPB::ttl_sec.
+  int64_t ttl_sec;
+
+  // Whether each rowset indexes its rows by their values of the column. See
+  // ColumnSchemaPB::secondary_index.
+  bool secondary_index;
+
+  // Whether each rowset stores a bloom filter of the values of the column.
+  // See ColumnSchemaPB::bloom_filter.
+  bool bloom_filter;
 };
 
 // A struct representing changes to a ColumnSchema.
@@ -454,6 +473,16 @@ class Schema {
     return col_offsets_[num_key_columns_];
   }
 
+  // Return the key encoder for the key column at 'idx'. The encoders are
+  // resolved when the schema is built, so that encoding a composite key
+  // does not look them up for every cell.
+  const KeyEncoder<faststring>& key_encoder(size_t idx) const {
+    DCHECK_LT(idx, num_key_columns_);
+    DCHECK(key_encoders_[idx] != nullptr)
+        << "type not allowed in key: " << cols_[idx].type_info()->name();
+    return *key_encoders_[idx];
+  }
+
   // Return the number of columns in this schema
   size_t num_columns() const {
     // Use name_to_index_.size() instead of cols_.size() since the former
@@ -517,6 +546,11 @@ class Schema {
     }
   }
 
+  // Returns the index of the table's time-to-live column, i.e. the column
+  // with a positive 'ttl_sec' storage attribute, or kColumnNotFound if there
+  // is none.
+  int find_ttl_column() const;
+
   // Returns true if the schema contains nullable columns
   bool has_nullables() const {
     return has_nullables_;
@@ -677,9 +711,8 @@ class Schema {
     dst->clear();
     for (size_t i = 0; i < num_key_columns_; i++) {
       DCHECK(!cols_[i].is_nullable());
-      const TypeInfo* ti = cols_[i].type_info();
       bool is_last = i == num_key_columns_ - 1;
-      GetKeyEncoder<faststring>(ti).Encode(row.cell_ptr(i), is_last, dst);
+      key_encoder(i).Encode(row.cell_ptr(i), is_last, dst);
     }
     return Slice(*dst);
   }
@@ -863,6 +896,10 @@ class Schema {
 
   IdMapping id_to_index_;
 
+  // Cached key encoders of the key columns, or NULL for key columns whose
+  // type is not allowed in keys.
+  std::vector<const KeyEncoder<faststring>*> key_encoders_;
+
   // Cached indicator whether any columns are nullable.
   bool has_nullables_;
 
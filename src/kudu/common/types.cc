@@ -51,10 +51,6 @@ void TypeInfo::AppendDebugStringForValue(const void *ptr, string *str) const {
   }
 }
 
-int TypeInfo::Compare(const void *lhs, const void *rhs) const {
-  return compare_func_(lhs, rhs);
-}
-
 bool TypeInfo::AreConsecutive(const void* a, const void* b) const {
   return are_consecutive_func_(a, b);
 }
@@ -62,7 +62,9 @@ class TypeInfo {
   const std::string& name() const { return name_; }
   const size_t size() const { return size_; }
   void AppendDebugStringForValue(const void *ptr, std::string *str) const;
-  int Compare(const void *lhs, const void *rhs) const;
+  int Compare(const void *lhs, const void *rhs) const {
+    return compare_func_(lhs, rhs);
+  }
   // Returns true if increment(a) is equal to b.
   bool AreConsecutive(const void* a, const void* b) const;
   void CopyMinValue(void* dst) const {
@@ -32,6 +32,7 @@
 #include "kudu/common/wire_protocol.h"
 #include "kudu/common/wire_protocol.pb.h"
 #include "kudu/util/bitmap.h"
+#include "kudu/util/bloom_filter.h"
 #include "kudu/util/faststring.h"
 #include "kudu/util/hexdump.h"
 #include "kudu/util/memory/arena.h"
@@ -332,6 +333,123 @@ TEST_F(WireProtocolTest, TestColumnarRowBlockToPBWithPadding) {
   }
 }
 
+// Serialize a block of rows using the columnar layout and check the contents
+// of the per-column buffers.
+TEST_F(WireProtocolTest, TestSerializeRowBlockColumnar) {
+  const int kNumRows = 10;
+  Arena arena(1024);
+  RowBlock block(schema_, kNumRows, &arena);
+  FillRowBlockWithTestRows(&block);
+
+  // Unselect the odd rows and null out one of the selected cells.
+  for (int i = 1; i < kNumRows; i += 2) {
+    block.selection_vector()->SetRowUnselected(i);
+  }
+  block.row(4).cell(2).set_null(true);
+
+  // Project the columns in a different order from the block's schema.
+  Schema proj_schema({ ColumnSchema("col3", UINT32, true /* nullable */),
+                       ColumnSchema("col1", STRING) }, 0);
+  ColumnarSerializedBatch batch(proj_schema);
+  SerializeRowBlockColumnar(block, &proj_schema, &batch);
+  // Serialize the block a second time to make sure appending works.
+  SerializeRowBlockColumnar(block, &proj_schema, &batch);
+  ASSERT_EQ(10, batch.num_rows);
+  ASSERT_EQ(2, batch.columns.size());
+
+  // Check the fixed-length, nullable column.
+  const auto& col3 = batch.columns[0];
+  ASSERT_FALSE(col3.varlen_data);
+  ASSERT_TRUE(col3.non_null_bitmap);
+  ASSERT_EQ(10 * sizeof(uint32_t), col3.data->size());
+  ASSERT_EQ(BitmapSize(10), col3.non_null_bitmap->size());
+  const uint32_t* col3_vals = reinterpret_cast<const uint32_t*>(col3.data->data());
+  for (int i = 0; i < 10; i++) {
+    int src_row = (i % 5) * 2;
+    if (src_row == 4) {
+      EXPECT_FALSE(BitmapTest(col3.non_null_bitmap->data(), i));
+      EXPECT_EQ(0, col3_vals[i]);
+    } else {
+      EXPECT_TRUE(BitmapTest(col3.non_null_bitmap->data(), i));
+      EXPECT_EQ(src_row, col3_vals[i]);
+    }
+  }
+
+  // Check the variable-length, non-nullable column.
+  const auto& col1 = batch.columns[1];
+  ASSERT_TRUE(col1.varlen_data);
+  ASSERT_FALSE(col1.non_null_bitmap);
+  ASSERT_EQ(11 * sizeof(uint32_t), col1.data->size());
+  const uint32_t* offsets = reinterpret_cast<const uint32_t*>(col1.data->data());
+  ASSERT_EQ(0, offsets[0]);
+  for (int i = 0; i < 10; i++) {
+    Slice val(col1.varlen_data->data() + offsets[i], offsets[i + 1] - offsets[i]);
+    EXPECT_EQ("hello world col1", val.ToString());
+  }
+  ASSERT_EQ(batch.TotalSize(),
+            col3.data->size() + col3.non_null_bitmap->size() +
+            col1.data->size() + col1.varlen_data->size());
+}
+
+// Serialize runs of selected rows of fixed-length columns, which are copied
+// a run at a time, in both the row-wise and columnar layouts.
+TEST_F(WireProtocolTest, TestSerializeFixedLengthRuns) {
+  const int kNumRows = 20;
+  Arena arena(1024);
+  Schema schema({ ColumnSchema("key", INT64),
+                  ColumnSchema("val", INT16, true /* nullable */) }, 1);
+  RowBlock block(schema, kNumRows, &arena);
+  block.selection_vector()->SetAllTrue();
+  for (int i = 0; i < kNumRows; i++) {
+    RowBlockRow row = block.row(i);
+    *reinterpret_cast<int64_t*>(row.mutable_cell_ptr(0)) = i;
+    *reinterpret_cast<int16_t*>(row.mutable_cell_ptr(1)) = i;
+    row.cell(1).set_null(i % 3 == 0);
+  }
+  // Unselect rows 5 through 9 and row 15, leaving runs of selected rows
+  // of different lengths.
+  for (int i = 5; i < 10; i++) {
+    block.selection_vector()->SetRowUnselected(i);
+  }
+  block.selection_vector()->SetRowUnselected(15);
+  vector<int> selected_rows;
+  for (int i = 0; i < kNumRows; i++) {
+    if (block.selection_vector()->IsRowSelected(i)) {
+      selected_rows.push_back(i);
+    }
+  }
+
+  ColumnarSerializedBatch batch(schema);
+  SerializeRowBlockColumnar(block, &schema, &batch);
+  ASSERT_EQ(selected_rows.size(), batch.num_rows);
+  const int64_t* keys = reinterpret_cast<const int64_t*>(batch.columns[0].data->data());
+  const int16_t* vals = reinterpret_cast<const int16_t*>(batch.columns[1].data->data());
+  const uint8_t* non_null_bitmap = batch.columns[1].non_null_bitmap->data();
+  for (int i = 0; i < selected_rows.size(); i++) {
+    int src_row = selected_rows[i];
+    EXPECT_EQ(src_row, keys[i]);
+    if (src_row % 3 == 0) {
+      EXPECT_FALSE(BitmapTest(non_null_bitmap, i));
+      EXPECT_EQ(0, vals[i]);
+    } else {
+      EXPECT_TRUE(BitmapTest(non_null_bitmap, i));
+      EXPECT_EQ(src_row, vals[i]);
+    }
+  }
+
+  RowwiseRowBlockPB pb;
+  faststring direct, indirect;
+  SerializeRowBlock(block, &pb, nullptr, &direct, &indirect);
+  vector<const uint8_t*> row_ptrs;
+  Slice direct_sidecar = direct;
+  ASSERT_OK(ExtractRowsFromRowBlockPB(schema, pb, indirect, &direct_sidecar, &row_ptrs));
+  ASSERT_EQ(selected_rows.size(), row_ptrs.size());
+  for (int i = 0; i < row_ptrs.size(); i++) {
+    ConstContiguousRow row(&schema, row_ptrs[i]);
+    EXPECT_EQ(schema.DebugRow(block.row(selected_rows[i])), schema.DebugRow(row));
+  }
+}
+
 #ifdef NDEBUG
 TEST_F(WireProtocolTest, TestColumnarRowBlockToPBBenchmark) {
   Arena arena(1024);
@@ -442,6 +560,27 @@ TEST_F(WireProtocolTest, TestColumnDefaultValue) {
   ASSERT_EQ(write_default_u32, *static_cast<const uint32_t *>(col5fpb.write_default_value()));
 }
 
+// Test that the time-to-live attribute survives a round trip through the PB,
+// even when the PB is built without the storage attributes.
+TEST_F(WireProtocolTest, TestColumnTimeToLive) {
+  ColumnStorageAttributes attrs;
+  attrs.ttl_sec = 3600;
+  ColumnSchema col1("ts", UNIXTIME_MICROS, false, nullptr, nullptr, attrs);
+  Schema schema({ ColumnSchema("key", INT64), col1 }, 1);
+  ASSERT_EQ(1, schema.find_ttl_column());
+
+  SchemaPB pb;
+  ASSERT_OK(SchemaToPB(schema, &pb, SCHEMA_PB_WITHOUT_STORAGE_ATTRIBUTES));
+  Schema schema_fpb;
+  ASSERT_OK(SchemaFromPB(pb, &schema_fpb));
+  ASSERT_EQ(1, schema_fpb.find_ttl_column());
+  ASSERT_EQ(3600, schema_fpb.column(1).attributes().ttl_sec);
+
+  ColumnSchemaPB col_pb;
+  ColumnSchemaToPB(ColumnSchema("col", UNIXTIME_MICROS), &col_pb);
+  ASSERT_FALSE(col_pb.has_ttl_sec());
+}
+
 TEST_F(WireProtocolTest, TestColumnPredicateInList) {
   ColumnSchema col1("col1", INT32);
   vector<ColumnSchema> cols = { col1 };
@@ -499,4 +638,47 @@ TEST_F(WireProtocolTest, TestColumnPredicateInList) {
     ASSERT_TRUE(ColumnPredicateFromPB(schema, &arena, pb, &predicate).IsInvalidArgument());
   }
 }
+
+TEST_F(WireProtocolTest, TestColumnPredicateInBloomFilter) {
+  ColumnSchema col1("col1", INT32);
+  vector<ColumnSchema> cols = { col1 };
+  Schema schema(cols, 1);
+  Arena arena(1024);
+  boost::optional<ColumnPredicate> predicate;
+
+  int five = 5;
+  int ten = 10;
+  BloomFilterBuilder builder(BloomFilterSizing::ByCountAndFPRate(2, 0.01),
+                             SPLIT_BLOCK_BLOOM_FILTER);
+  builder.AddKey(BloomKeyProbe(ColumnPredicate::BloomFilterKey(col1.type_info(), &five)));
+  builder.AddKey(BloomKeyProbe(ColumnPredicate::BloomFilterKey(col1.type_info(), &ten)));
+
+  { // col1 IN BLOOM FILTER AND col1 >= 5
+    ColumnPredicate cp = ColumnPredicate::InBloomFilter(col1, { builder.slice() }, &five, nullptr);
+    ColumnPredicatePB pb;
+    NO_FATALS(ColumnPredicateToPB(cp, &pb));
+    ASSERT_EQ(1, pb.in_bloom_filter().bloom_filters_size());
+    ASSERT_TRUE(pb.in_bloom_filter().has_lower());
+    ASSERT_FALSE(pb.in_bloom_filter().has_upper());
+
+    ASSERT_OK(ColumnPredicateFromPB(schema, &arena, pb, &predicate));
+    ASSERT_EQ(PredicateType::InBloomFilter, predicate->predicate_type());
+    ASSERT_EQ(cp, *predicate);
+    ASSERT_TRUE(predicate->EvaluateCell<INT32>(&ten));
+  }
+
+  { // No filters.
+    ColumnPredicatePB pb;
+    pb.set_column("col1");
+    pb.mutable_in_bloom_filter();
+    ASSERT_TRUE(ColumnPredicateFromPB(schema, &arena, pb, &predicate).IsInvalidArgument());
+  }
+
+  { // A filter which isn't made of whole blocks.
+    ColumnPredicatePB pb;
+    pb.set_column("col1");
+    pb.mutable_in_bloom_filter()->add_bloom_filters(string(BloomFilter::kSplitBlockBytes + 1, 0));
+    ASSERT_TRUE(ColumnPredicateFromPB(schema, &arena, pb, &predicate).IsInvalidArgument());
+  }
+}
 } // namespace kudu
@@ -40,6 +40,7 @@
 #include "kudu/gutil/strings/fastmem.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/bitmap.h"
+#include "kudu/util/bloom_filter.h"
 #include "kudu/util/compression/compression.pb.h"
 #include "kudu/util/faststring.h"
 #include "kudu/util/memory/arena.h"
@@ -216,6 +217,15 @@ void ColumnSchemaToPB(const ColumnSchema& col_schema, ColumnSchemaPB *pb, int fl
     pb->set_compression(col_schema.attributes().compression);
     pb->set_cfile_block_size(col_schema.attributes().cfile_block_size);
   }
+  if (col_schema.attributes().ttl_sec > 0) {
+    pb->set_ttl_sec(col_schema.attributes().ttl_sec);
+  }
+  if (col_schema.attributes().secondary_index) {
+    pb->set_secondary_index(true);
+  }
+  if (col_schema.attributes().bloom_filter) {
+    pb->set_bloom_filter(true);
+  }
   if (col_schema.has_read_default()) {
     if (col_schema.type_info()->physical_type() == BINARY) {
       const Slice *read_slice = static_cast<const Slice *>(col_schema.read_default_value());
@@ -269,6 +279,15 @@ ColumnSchema ColumnSchemaFromPB(const ColumnSchemaPB& pb) {
   if (pb.has_cfile_block_size()) {
     attributes.cfile_block_size = pb.cfile_block_size();
   }
+  if (pb.has_ttl_sec()) {
+    attributes.ttl_sec = pb.ttl_sec();
+  }
+  if (pb.has_secondary_index()) {
+    attributes.secondary_index = pb.secondary_index();
+  }
+  if (pb.has_bloom_filter()) {
+    attributes.bloom_filter = pb.bloom_filter();
+  }
   return ColumnSchema(pb.name(), pb.type(), pb.is_nullable(),
                       read_default_ptr, write_default_ptr,
                       attributes);
@@ -461,6 +480,24 @@ void ColumnPredicateToPB(const ColumnPredicate& predicate,
       }
       return;
     };
+    case PredicateType::InBloomFilter: {
+      auto* bloom_filter_pred = pb->mutable_in_bloom_filter();
+      for (const BloomFilter& bloom_filter : predicate.raw_bloom_filters()) {
+        Slice data = bloom_filter.data();
+        bloom_filter_pred->add_bloom_filters(data.data(), data.size());
+      }
+      if (predicate.raw_lower() != nullptr) {
+        CopyPredicateBoundToPB(predicate.column(),
+                               predicate.raw_lower(),
+                               bloom_filter_pred->mutable_lower());
+      }
+      if (predicate.raw_upper() != nullptr) {
+        CopyPredicateBoundToPB(predicate.column(),
+                               predicate.raw_upper(),
+                               bloom_filter_pred->mutable_upper());
+      }
+      return;
+    };
     case PredicateType::None: LOG(FATAL) << "None predicate may not be converted to protobuf";
   }
   LOG(FATAL) << "unknown predicate type";
@@ -522,6 +559,36 @@ Status ColumnPredicateFromPB(const Schema& schema,
       *predicate = ColumnPredicate::InList(col, &values);
       break;
     };
+    case ColumnPredicatePB::kInBloomFilter: {
+      const auto& in_bloom_filter = pb.in_bloom_filter();
+      if (in_bloom_filter.bloom_filters_size() == 0) {
+        return Status::InvalidArgument("Invalid in bloom filter predicate on column: no filters",
+                                       col.name());
+      }
+      vector<Slice> bloom_filters;
+      for (const string& pb_filter : in_bloom_filter.bloom_filters()) {
+        if (pb_filter.empty() || pb_filter.size() % BloomFilter::kSplitBlockBytes != 0) {
+          return Status::InvalidArgument(
+              strings::Substitute("Invalid in bloom filter predicate on column: "
+                                  "bad filter size $0", pb_filter.size()),
+              col.name());
+        }
+        uint8_t* data_copy = static_cast<uint8_t*>(arena->AllocateBytes(pb_filter.size()));
+        memcpy(data_copy, pb_filter.data(), pb_filter.size());
+        bloom_filters.emplace_back(data_copy, pb_filter.size());
+      }
+
+      const void* lower = nullptr;
+      const void* upper = nullptr;
+      if (in_bloom_filter.has_lower()) {
+        RETURN_NOT_OK(CopyPredicateBoundFromPB(col, in_bloom_filter.lower(), arena, &lower));
+      }
+      if (in_bloom_filter.has_upper()) {
+        RETURN_NOT_OK(CopyPredicateBoundFromPB(col, in_bloom_filter.upper(), arena, &upper));
+      }
+      *predicate = ColumnPredicate::InBloomFilter(col, bloom_filters, lower, upper);
+      break;
+    };
     case ColumnPredicatePB::kIsNotNull: {
       *predicate = ColumnPredicate::IsNotNull(col);
       break;
@@ -713,14 +780,20 @@ void AppendRowToString<RowBlockRow>(const RowBlockRow& row, string* buf) {
 // IS_NULLABLE: true if the column is nullable
 // IS_VARLEN: true if the column is of variable length
 //
+// CELL_SIZE: the size of a fixed-length cell, or 0 if it is only known at
+// runtime (always 0 for variable length columns)
+//
 // These are template parameters rather than normal function arguments
-// so that there are fewer branches inside the loop.
+// so that there are fewer branches inside the loop, and so that copies of
+// the common cell sizes compile down to a single load and store.
+//
+// The null bitmaps of the destination rows must have been zeroed.
 //
 // NOTE: 'dst_schema' must either be NULL or a subset of the specified's
 // RowBlock's schema. If not NULL, then column at 'col_idx' in 'block' will
 // be copied to column 'dst_col_idx' in the output protobuf; otherwise,
 // dst_col_idx must be equal to col_idx.
-template<bool IS_NULLABLE, bool IS_VARLEN>
+template<bool IS_NULLABLE, bool IS_VARLEN, size_t CELL_SIZE>
 static void CopyColumn(const RowBlock& block, int col_idx, int dst_col_idx, uint8_t* dst_base,
                        faststring* indirect_data, const Schema* dst_schema, size_t row_stride,
                        size_t schema_byte_size, size_t column_offset) {
@@ -729,7 +802,8 @@ static void CopyColumn(const RowBlock& block, int col_idx, int dst_col_idx, uint
   uint8_t* dst = dst_base + column_offset;
   size_t offset_to_null_bitmap = schema_byte_size - column_offset;
 
-  size_t cell_size = cblock.stride();
+  DCHECK(CELL_SIZE == 0 || CELL_SIZE == cblock.stride());
+  const size_t cell_size = CELL_SIZE != 0 ? CELL_SIZE : cblock.stride();
   const uint8_t* src = cblock.cell_ptr(0);
 
   BitmapIterator selected_row_iter(block.selection_vector()->bitmap(), block.nrows());
@@ -753,14 +827,10 @@ static void CopyColumn(const RowBlock& block, int col_idx, int dst_col_idx, uint
         Slice *dst_slice = reinterpret_cast<Slice *>(dst);
         *dst_slice = Slice(reinterpret_cast<const uint8_t*>(offset_in_indirect),
                            slice->size());
-        if (IS_NULLABLE) {
-          BitmapChange(dst + offset_to_null_bitmap, dst_col_idx, false);
-        }
-      } else { // non-string, non-null
+      } else if (CELL_SIZE != 0) { // non-string, non-null
+        memcpy(dst, src, CELL_SIZE);
+      } else {
         strings::memcpy_inlined(dst, src, cell_size);
-        if (IS_NULLABLE) {
-          BitmapChange(dst + offset_to_null_bitmap, dst_col_idx, false);
-        }
       }
       dst += row_stride;
       src += cell_size;
@@ -769,6 +839,26 @@ static void CopyColumn(const RowBlock& block, int col_idx, int dst_col_idx, uint
   }
 }
 
+// Dispatches CopyColumn() for a fixed-length column on its cell size.
+template<bool IS_NULLABLE>
+static void CopyFixedLengthColumn(const RowBlock& block, int col_idx, int dst_col_idx,
+                                  uint8_t* dst_base, const Schema* dst_schema,
+                                  size_t row_stride, size_t schema_byte_size,
+                                  size_t column_offset) {
+#define COPY_COLUMN(size) \
+  CopyColumn<IS_NULLABLE, false, size>(block, col_idx, dst_col_idx, dst_base, nullptr, \
+                                       dst_schema, row_stride, schema_byte_size, column_offset)
+  switch (block.schema().column(col_idx).type_info()->size()) {
+    case 1: COPY_COLUMN(1); break;
+    case 2: COPY_COLUMN(2); break;
+    case 4: COPY_COLUMN(4); break;
+    case 8: COPY_COLUMN(8); break;
+    case 16: COPY_COLUMN(16); break;
+    default: COPY_COLUMN(0); break;
+  }
+#undef COPY_COLUMN
+}
+
 // Because we use a faststring here, ASAN tests become unbearably slow
 // with the extra verifications.
 ATTRIBUTE_NO_ADDRESS_SAFETY_ANALYSIS
@@ -832,17 +922,17 @@ void SerializeRowBlock(const RowBlock& block,
     // even bigger gains, since we could inline the constant cell sizes and column
     // offsets.
     if (col.is_nullable() && col.type_info()->physical_type() == BINARY) {
-      CopyColumn<true, true>(block, t_schema_idx, p_schema_idx, base, indirect_data,
-                             projection_schema, row_stride, schema_byte_size, column_offset);
+      CopyColumn<true, true, 0>(block, t_schema_idx, p_schema_idx, base, indirect_data,
+                                projection_schema, row_stride, schema_byte_size, column_offset);
     } else if (col.is_nullable() && col.type_info()->physical_type() != BINARY) {
-      CopyColumn<true, false>(block, t_schema_idx, p_schema_idx, base, indirect_data,
-                              projection_schema, row_stride, schema_byte_size, column_offset);
+      CopyFixedLengthColumn<true>(block, t_schema_idx, p_schema_idx, base,
+                                  projection_schema, row_stride, schema_byte_size, column_offset);
     } else if (!col.is_nullable() && col.type_info()->physical_type() == BINARY) {
-      CopyColumn<false, true>(block, t_schema_idx, p_schema_idx, base, indirect_data,
-                              projection_schema, row_stride, schema_byte_size, column_offset);
+      CopyColumn<false, true, 0>(block, t_schema_idx, p_schema_idx, base, indirect_data,
+                                 projection_schema, row_stride, schema_byte_size, column_offset);
     } else if (!col.is_nullable() && col.type_info()->physical_type() != BINARY) {
-      CopyColumn<false, false>(block, t_schema_idx, p_schema_idx, base, indirect_data,
-                               projection_schema, row_stride, schema_byte_size, column_offset);
+      CopyFixedLengthColumn<false>(block, t_schema_idx, p_schema_idx, base,
+                                   projection_schema, row_stride, schema_byte_size, column_offset);
     } else {
       LOG(FATAL) << "cannot reach here";
     }
@@ -854,4 +944,148 @@ void SerializeRowBlock(const RowBlock& block,
   rowblock_pb->set_num_rows(rowblock_pb->num_rows() + num_rows);
 }
 
+ColumnarSerializedBatch::ColumnarSerializedBatch(const Schema& projection_schema)
+    : num_rows(0) {
+  columns.resize(projection_schema.num_columns());
+  for (int i = 0; i < projection_schema.num_columns(); i++) {
+    const ColumnSchema& col = projection_schema.column(i);
+    Column* dst = &columns[i];
+    dst->data.reset(new faststring());
+    if (col.type_info()->physical_type() == BINARY) {
+      dst->varlen_data.reset(new faststring());
+      // The offsets array always starts with the offset of the first cell.
+      uint32_t zero = 0;
+      dst->data->append(&zero, sizeof(zero));
+    }
+    if (col.is_nullable()) {
+      dst->non_null_bitmap.reset(new faststring());
+    }
+  }
+}
+
+int64_t ColumnarSerializedBatch::TotalSize() const {
+  int64_t total = 0;
+  for (const auto& col : columns) {
+    total += col.data->size();
+    if (col.varlen_data) {
+      total += col.varlen_data->size();
+    }
+    if (col.non_null_bitmap) {
+      total += col.non_null_bitmap->size();
+    }
+  }
+  return total;
+}
+
+// Copy the selected cells of a column from the given RowBlock into the
+// columnar buffers in 'dst_col', starting at output row 'dst_row_start'.
+//
+// See CopyColumn() above for the meaning of the template parameters.
+template<bool IS_NULLABLE, bool IS_VARLEN>
+static void CopyColumnColumnar(const RowBlock& block, int col_idx,
+                               int64_t dst_row_start, size_t num_selected,
+                               ColumnarSerializedBatch::Column* dst_col) {
+  ColumnBlock cblock = block.column_block(col_idx);
+  size_t cell_size = cblock.stride();
+  size_t dst_cell_size = IS_VARLEN ? sizeof(uint32_t) : cell_size;
+
+  faststring* data = dst_col->data.get();
+  size_t old_size = data->size();
+  data->resize(old_size + num_selected * dst_cell_size);
+  uint8_t* dst = data->data() + old_size;
+
+  uint8_t* non_null_bitmap = nullptr;
+  if (IS_NULLABLE) {
+    faststring* bitmap = DCHECK_NOTNULL(dst_col->non_null_bitmap.get());
+    size_t old_bitmap_size = bitmap->size();
+    size_t new_bitmap_size = BitmapSize(dst_row_start + num_selected);
+    bitmap->resize(new_bitmap_size);
+    memset(bitmap->data() + old_bitmap_size, 0, new_bitmap_size - old_bitmap_size);
+    non_null_bitmap = bitmap->data();
+  }
+
+  faststring* varlen_data = IS_VARLEN ? DCHECK_NOTNULL(dst_col->varlen_data.get()) : nullptr;
+
+  const uint8_t* src = cblock.cell_ptr(0);
+  int64_t dst_row = dst_row_start;
+  BitmapIterator selected_row_iter(block.selection_vector()->bitmap(), block.nrows());
+  int run_size;
+  bool selected;
+  int row_idx = 0;
+  while ((run_size = selected_row_iter.Next(&selected))) {
+    if (!selected) {
+      src += run_size * cell_size;
+      row_idx += run_size;
+      continue;
+    }
+    if (!IS_VARLEN) {
+      // The fixed-length cells of a run are contiguous in both the source
+      // and the destination, so copy them all at once. Null cells are
+      // zeroed below.
+      memcpy(dst, src, run_size * cell_size);
+      if (!IS_NULLABLE) {
+        dst += run_size * dst_cell_size;
+        src += run_size * cell_size;
+        row_idx += run_size;
+        dst_row += run_size;
+        continue;
+      }
+    }
+    for (int i = 0; i < run_size; i++) {
+      bool is_null = IS_NULLABLE && cblock.is_null(row_idx);
+      if (IS_NULLABLE && !is_null) {
+        BitmapSet(non_null_bitmap, dst_row);
+      }
+      if (IS_VARLEN) {
+        if (!is_null) {
+          const Slice* slice = reinterpret_cast<const Slice*>(src);
+          varlen_data->append(slice->data(), slice->size());
+        }
+        uint32_t end_offset = varlen_data->size();
+        memcpy(dst, &end_offset, sizeof(end_offset));
+      } else if (is_null) {
+        // Don't leak unrelated data to the client.
+        memset(dst, 0, cell_size);
+      }
+      dst += dst_cell_size;
+      src += cell_size;
+      row_idx++;
+      dst_row++;
+    }
+  }
+  DCHECK_EQ(dst_row, dst_row_start + num_selected);
+}
+
+void SerializeRowBlockColumnar(const RowBlock& block,
+                               const Schema* projection_schema,
+                               ColumnarSerializedBatch* batch) {
+  DCHECK_GT(block.nrows(), 0);
+  const Schema& tablet_schema = block.schema();
+
+  if (projection_schema == nullptr) {
+    projection_schema = &tablet_schema;
+  }
+  DCHECK_EQ(projection_schema->num_columns(), batch->columns.size());
+
+  size_t num_selected = block.selection_vector()->CountSelected();
+  for (int p_schema_idx = 0; p_schema_idx < projection_schema->num_columns(); p_schema_idx++) {
+    const ColumnSchema& col = projection_schema->column(p_schema_idx);
+    int t_schema_idx = tablet_schema.find_column(col.name());
+    DCHECK_NE(t_schema_idx, -1);
+    ColumnarSerializedBatch::Column* dst_col = &batch->columns[p_schema_idx];
+
+    bool is_varlen = col.type_info()->physical_type() == BINARY;
+    if (col.is_nullable() && is_varlen) {
+      CopyColumnColumnar<true, true>(block, t_schema_idx, batch->num_rows, num_selected, dst_col);
+    } else if (col.is_nullable() && !is_varlen) {
+      CopyColumnColumnar<true, false>(block, t_schema_idx, batch->num_rows, num_selected, dst_col);
+    } else if (!col.is_nullable() && is_varlen) {
+      CopyColumnColumnar<false, true>(block, t_schema_idx, batch->num_rows, num_selected, dst_col);
+    } else {
+      CopyColumnColumnar<false, false>(block, t_schema_idx, batch->num_rows, num_selected, dst_col);
+    }
+  }
+  batch->num_rows += num_selected;
+}
+
 } // namespace kudu
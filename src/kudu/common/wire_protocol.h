@@ -20,6 +20,7 @@
 #define KUDU_COMMON_WIRE_PROTOCOL_H
 
 #include <cstdint>
+#include <memory>
 #include <vector>
 
 #include "kudu/util/status.h"
@@ -52,6 +53,7 @@ class AppStatusPB;
 class ColumnPredicatePB;
 class ColumnSchemaDeltaPB;
 class ColumnSchemaPB;
+class ColumnarRowBlockPB;
 class HostPortPB;
 class RowwiseRowBlockPB;
 class SchemaPB;
@@ -154,6 +156,44 @@ void SerializeRowBlock(const RowBlock& block, RowwiseRowBlockPB* rowblock_pb,
                        faststring* data_buf, faststring* indirect_data,
                        bool pad_unixtime_micros_to_16_bytes = false);
 
+// The data of a row block serialized in columnar layout. Each column is
+// accumulated in separate buffers which are later attached to the response
+// as sidecars. See ColumnarRowBlockPB for the format of each buffer.
+struct ColumnarSerializedBatch {
+  struct Column {
+    // Fixed-length cell data, or uint32 offsets for variable-length columns.
+    std::unique_ptr<faststring> data;
+
+    // Only set for variable-length columns.
+    std::unique_ptr<faststring> varlen_data;
+
+    // Only set for nullable columns.
+    std::unique_ptr<faststring> non_null_bitmap;
+  };
+
+  explicit ColumnarSerializedBatch(const Schema& projection_schema);
+
+  // Returns the total number of bytes buffered across all the columns.
+  int64_t TotalSize() const;
+
+  std::vector<Column> columns;
+  int64_t num_rows;
+};
+
+// Encode the given row block into the per-column buffers of 'batch',
+// appending after any rows previously serialized into it.
+//
+// This only converts those rows whose selection vector entry is true.
+// If 'projection_schema' is not NULL, then only columns specified in
+// 'projection_schema' will be serialized, in that order; otherwise all
+// the columns in the block's schema are serialized. The columns in 'batch'
+// must have been set up for the same projection.
+//
+// Requires that block.nrows() > 0
+void SerializeRowBlockColumnar(const RowBlock& block,
+                               const Schema* projection_schema,
+                               ColumnarSerializedBatch* batch);
+
 // Rewrites the data pointed-to by row data slice 'row_data_slice' by replacing
 // relative indirect data pointers with absolute ones in 'indirect_data_slice'.
 // At the time of this writing, this rewriting is only done for STRING types.
@@ -15,12 +15,17 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <algorithm>
 #include <cstddef>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
+#include <gflags/gflags.h>
+#include <gflags/gflags_declare.h>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 
@@ -46,7 +51,9 @@
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/rpc/messenger.h"
+#include "kudu/rpc/response_callback.h"
 #include "kudu/tserver/tserver.pb.h"
+#include "kudu/util/locks.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/status.h"
@@ -54,6 +61,9 @@
 #include "kudu/util/test_util.h"
 #include "kudu/util/threadpool.h"
 
+DECLARE_int32(consensus_max_batch_size_bytes);
+DECLARE_int32(consensus_max_inflight_requests_per_peer);
+
 METRIC_DECLARE_entity(tablet);
 
 namespace kudu {
@@ -66,6 +76,7 @@ using rpc::MessengerBuilder;
 using std::shared_ptr;
 using std::string;
 using std::unique_ptr;
+using std::vector;
 
 const char* kTabletId = "test-peers-tablet";
 const char* kLeaderUuid = "peer-0";
@@ -355,6 +366,111 @@ TEST_F(ConsensusPeersTest, TestDontSendOneRpcPerWriteWhenPeerIsDown) {
   ASSERT_LT(mock_proxy->update_count(), 5);
 }
 
+// A follower which appends the ops of the requests it is sent in the order
+// they are sent, but only responds to them when told to, latest first.
+class ReorderingPeerProxy : public PeerProxy {
+ public:
+  ReorderingPeerProxy()
+      : max_inflight_(0) {
+    last_received_.CopyFrom(MinimumOpId());
+  }
+
+  void UpdateAsync(const ConsensusRequestPB* request,
+                   ConsensusResponsePB* response,
+                   rpc::RpcController* controller,
+                   const rpc::ResponseCallback& callback) override {
+    std::lock_guard<simple_spinlock> l(lock_);
+    response->Clear();
+    if (OpIdLessThan(last_received_, request->preceding_id())) {
+      ConsensusErrorPB* error = response->mutable_status()->mutable_error();
+      error->set_code(ConsensusErrorPB::PRECEDING_ENTRY_DIDNT_MATCH);
+      StatusToPB(Status::IllegalState(""), error->mutable_status());
+    } else if (request->ops_size() > 0) {
+      last_received_.CopyFrom(request->ops(request->ops_size() - 1).id());
+    }
+    response->set_responder_uuid(kFollowerUuid);
+    response->set_responder_term(request->caller_term());
+    response->mutable_status()->mutable_last_received()->CopyFrom(last_received_);
+    response->mutable_status()->mutable_last_received_current_leader()->CopyFrom(last_received_);
+    response->mutable_status()->set_last_committed_idx(last_received_.index());
+    callbacks_.push_back(callback);
+    max_inflight_ = std::max(max_inflight_, callbacks_.size());
+  }
+
+  void RequestConsensusVoteAsync(const VoteRequestPB* request,
+                                 VoteResponsePB* response,
+                                 rpc::RpcController* controller,
+                                 const rpc::ResponseCallback& callback) override {
+    LOG(FATAL) << "Not implemented";
+  }
+
+  // Responds to the requests awaiting a response, in the reverse order
+  // of their sending.
+  void RespondInReverseOrder() {
+    vector<rpc::ResponseCallback> callbacks;
+    {
+      std::lock_guard<simple_spinlock> l(lock_);
+      callbacks.swap(callbacks_);
+    }
+    for (auto it = callbacks.rbegin(); it != callbacks.rend(); ++it) {
+      (*it)();
+    }
+  }
+
+  size_t max_inflight() const {
+    std::lock_guard<simple_spinlock> l(lock_);
+    return max_inflight_;
+  }
+
+ private:
+  mutable simple_spinlock lock_;
+  OpId last_received_;
+  vector<rpc::ResponseCallback> callbacks_;
+  size_t max_inflight_;
+};
+
+// Tests that a peer pipelines requests, and processes their responses in
+// order even when they arrive out of order.
+TEST_F(ConsensusPeersTest, TestPipelinedRequests) {
+  google::FlagSaver saver;
+  FLAGS_consensus_max_inflight_requests_per_peer = 4;
+  // Make each request carry a single op.
+  const int kPayloadSize = 1024;
+  FLAGS_consensus_max_batch_size_bytes = kPayloadSize + kPayloadSize / 2;
+
+  message_queue_->SetLeaderMode(kMinimumOpIdIndex,
+                                kMinimumTerm,
+                                BuildRaftConfigPBForTests(3));
+
+  auto proxy = new ReorderingPeerProxy();
+  shared_ptr<Peer> peer;
+  ASSERT_OK(Peer::NewRemotePeer(FakeRaftPeerPB(kFollowerUuid),
+                                kTabletId,
+                                kLeaderUuid,
+                                message_queue_.get(),
+                                raft_pool_token_.get(),
+                                gscoped_ptr<PeerProxy>(proxy),
+                                messenger_,
+                                &peer));
+
+  const int kNumOps = 20;
+  AppendReplicateMessagesToQueue(message_queue_.get(), clock_, 1, kNumOps, kPayloadSize);
+  peer->SignalRequest();
+
+  ASSERT_EVENTUALLY([&]() {
+    proxy->RespondInReverseOrder();
+    ASSERT_GE(message_queue_->GetCommittedIndex(), kNumOps);
+  });
+  // Once in sync, the peer filled its window of requests, but never went
+  // beyond it.
+  ASSERT_EQ(FLAGS_consensus_max_inflight_requests_per_peer,
+            static_cast<int>(proxy->max_inflight()));
+  ASSERT_EQ(kNumOps, message_queue_->GetTrackedPeerForTests(kFollowerUuid).last_received.index());
+
+  peer->Close();
+  proxy->RespondInReverseOrder();
+}
+
 }  // namespace consensus
 }  // namespace kudu
 
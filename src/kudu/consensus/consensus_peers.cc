@@ -19,16 +19,19 @@
 
 #include <algorithm>
 #include <cstdlib>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <ostream>
 #include <string>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
 #include <gflags/gflags.h>
 #include <gflags/gflags_declare.h>
 #include <glog/logging.h>
+#include <google/protobuf/repeated_field.h>
 
 #include "kudu/common/common.pb.h"
 #include "kudu/common/wire_protocol.h"
@@ -38,17 +41,25 @@
 #include "kudu/consensus/consensus_queue.h"
 #include "kudu/consensus/metadata.pb.h"
 #include "kudu/consensus/opid_util.h"
+#include "kudu/consensus/ref_counted_replicate.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
+#include "kudu/gutil/map-util.h"
 #include "kudu/gutil/move.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/rpc/messenger.h"
 #include "kudu/rpc/periodic.h"
 #include "kudu/rpc/response_callback.h"
 #include "kudu/rpc/rpc_controller.h"
+#include "kudu/rpc/rpc_header.pb.h"
+#include "kudu/rpc/rpc_sidecar.h"
 #include "kudu/tserver/tserver.pb.h"
+#include "kudu/util/coding.h"
 #include "kudu/util/fault_injection.h"
+#include "kudu/util/faststring.h"
 #include "kudu/util/flag_tags.h"
+#include "kudu/util/locks.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/net/net_util.h"
@@ -56,6 +67,7 @@
 #include "kudu/util/pb_util.h"
 #include "kudu/util/status.h"
 #include "kudu/util/threadpool.h"
+#include "kudu/util/trace.h"
 
 DEFINE_int32(consensus_rpc_timeout_ms, 30000,
              "Timeout used for all consensus internal RPC communications.");
@@ -84,6 +96,27 @@ DEFINE_bool(enable_tablet_copy, true,
             "replica. For testing purposes only.");
 TAG_FLAG(enable_tablet_copy, unsafe);
 
+DEFINE_int32(consensus_max_inflight_requests_per_peer, 1,
+             "Maximum number of consensus update requests a leader may have in flight "
+             "to each follower. Up to that many requests are pipelined to followers "
+             "which are in sync, each with the ops following those of the previous "
+             "one, instead of waiting for each request's response before sending the "
+             "next.");
+TAG_FLAG(consensus_max_inflight_requests_per_peer, experimental);
+TAG_FLAG(consensus_max_inflight_requests_per_peer, runtime);
+
+DEFINE_bool(consensus_batch_heartbeats, false,
+            "Whether leaders batch the status-only requests (heartbeats) to the "
+            "replicas hosted by the same server into a single RPC.");
+TAG_FLAG(consensus_batch_heartbeats, experimental);
+
+DEFINE_int32(consensus_heartbeat_batch_window_ms, 20,
+             "How long batched status-only consensus requests are held for "
+             "others to the same server to join them. Only used if "
+             "--consensus_batch_heartbeats is set.");
+TAG_FLAG(consensus_heartbeat_batch_window_ms, experimental);
+TAG_FLAG(consensus_heartbeat_batch_window_ms, runtime);
+
 DECLARE_int32(raft_heartbeat_interval_ms);
 
 using kudu::pb_util::SecureShortDebugString;
@@ -91,8 +124,11 @@ using kudu::rpc::Messenger;
 using kudu::rpc::PeriodicTimer;
 using kudu::rpc::RpcController;
 using kudu::tserver::TabletServerErrorPB;
+using std::map;
+using std::pair;
 using std::shared_ptr;
 using std::string;
+using std::unique_ptr;
 using std::vector;
 using std::weak_ptr;
 using strings::Substitute;
@@ -135,6 +171,7 @@ Peer::Peer(RaftPeerPB peer_pb,
       proxy_(std::move(proxy)),
       queue_(queue),
       failed_attempts_(0),
+      last_sent_committed_index_(kMinimumOpIdIndex),
       messenger_(std::move(messenger)),
       raft_pool_token_(raft_pool_token) {
 }
@@ -178,14 +215,25 @@ Status Peer::SignalRequest(bool even_if_queue_empty) {
   return Status::OK();
 }
 
+Peer::UpdateRequest::~UpdateRequest() {
+  // We don't own the ops (the queue does).
+  request.mutable_ops()->ExtractSubrange(0, request.ops_size(), nullptr);
+}
+
 void Peer::SendNextRequest(bool even_if_queue_empty) {
   std::unique_lock<simple_spinlock> l(peer_lock_);
   if (PREDICT_FALSE(closed_)) {
     return;
   }
 
-  // Only allow one request at a time.
-  if (request_pending_) {
+  // Don't send updates while a tablet copy is being initiated.
+  if (tablet_copy_pending_) {
+    return;
+  }
+
+  // If requests are already in flight, at most pipeline more behind them.
+  if (!inflight_requests_.empty()) {
+    SendPipelinedRequests(&l);
     return;
   }
 
@@ -213,12 +261,10 @@ void Peer::SendNextRequest(bool even_if_queue_empty) {
 
   // The peer has no pending request nor is sending: send the request.
   bool needs_tablet_copy = false;
-  int64_t commit_index_before = request_.has_committed_index() ?
-      request_.committed_index() : kMinimumOpIdIndex;
-  Status s = queue_->RequestForPeer(peer_pb_.permanent_uuid(), &request_,
-                                    &replicate_msg_refs_, &needs_tablet_copy);
-  int64_t commit_index_after = request_.has_committed_index() ?
-      request_.committed_index() : kMinimumOpIdIndex;
+  unique_ptr<UpdateRequest> req(new UpdateRequest);
+  int64_t commit_index_before = last_sent_committed_index_;
+  Status s = queue_->RequestForPeer(peer_pb_.permanent_uuid(), &req->request,
+                                    &req->replicate_msg_refs, &needs_tablet_copy);
 
   if (PREDICT_FALSE(!s.ok())) {
     LOG_WITH_PREFIX_UNLOCKED(INFO) << "Could not obtain request from queue for peer: "
@@ -230,7 +276,7 @@ void Peer::SendNextRequest(bool even_if_queue_empty) {
     Status s = PrepareTabletCopyRequest();
     if (s.ok()) {
       controller_.Reset();
-      request_pending_ = true;
+      tablet_copy_pending_ = true;
       l.unlock();
       // Capture a shared_ptr reference into the RPC callback so that we're guaranteed
       // that this object outlives the RPC.
@@ -246,11 +292,9 @@ void Peer::SendNextRequest(bool even_if_queue_empty) {
     return;
   }
 
-  request_.set_tablet_id(tablet_id_);
-  request_.set_caller_uuid(leader_uuid_);
-  request_.set_dest_uuid(peer_pb_.permanent_uuid());
-
-  bool req_has_ops = request_.ops_size() > 0 || (commit_index_after > commit_index_before);
+  last_sent_committed_index_ = req->request.committed_index();
+  bool req_has_ops = req->request.ops_size() > 0 ||
+      (last_sent_committed_index_ > commit_index_before);
   // If the queue is empty, check if we were told to send a status-only
   // message, if not just return.
   if (PREDICT_FALSE(!req_has_ops && !even_if_queue_empty)) {
@@ -262,69 +306,117 @@ void Peer::SendNextRequest(bool even_if_queue_empty) {
     heartbeater_->Snooze();
   }
 
+  SendUpdateRequest(std::move(req), &l);
+
+  // If there are more ops to send, pipeline them behind the request.
+  l.lock();
+  SendPipelinedRequests(&l);
+}
+
+void Peer::SendPipelinedRequests(std::unique_lock<simple_spinlock>* l) {
+  while (!closed_ && !inflight_requests_.empty()) {
+    // Only pipeline behind a request with ops: the ops of the new request
+    // follow its last one. Status-only requests may precede a change of the
+    // index to send from, which is only known once their response is in.
+    const ConsensusRequestPB& last_request = inflight_requests_.back()->request;
+    if (static_cast<int>(inflight_requests_.size()) >=
+            FLAGS_consensus_max_inflight_requests_per_peer ||
+        failed_attempts_ > 0 ||
+        last_request.ops_size() == 0) {
+      return;
+    }
+    int64_t last_sent_index = last_request.ops(last_request.ops_size() - 1).id().index();
+
+    unique_ptr<UpdateRequest> req(new UpdateRequest);
+    Status s = queue_->PipelinedRequestForPeer(peer_pb_.permanent_uuid(), last_sent_index,
+                                               &req->request, &req->replicate_msg_refs);
+    if (!s.ok()) {
+      VLOG_WITH_PREFIX_UNLOCKED(2) << "Not pipelining request to peer: " << s.ToString();
+      return;
+    }
+    // There's no need for status-only requests while requests are in flight.
+    if (req->request.ops_size() == 0) {
+      return;
+    }
+    last_sent_committed_index_ = req->request.committed_index();
+    heartbeater_->Snooze();
+    SendUpdateRequest(std::move(req), l);
+    l->lock();
+  }
+}
+
+void Peer::SendUpdateRequest(unique_ptr<UpdateRequest> req,
+                             std::unique_lock<simple_spinlock>* l) {
+  DCHECK(l->owns_lock());
+  req->request.set_tablet_id(tablet_id_);
+  req->request.set_caller_uuid(leader_uuid_);
+  req->request.set_dest_uuid(peer_pb_.permanent_uuid());
+
   MAYBE_FAULT(FLAGS_fault_crash_on_leader_request_fraction);
 
 
   VLOG_WITH_PREFIX_UNLOCKED(2) << "Sending to peer " << peer_pb().permanent_uuid() << ": "
-      << SecureShortDebugString(request_);
-  controller_.Reset();
+      << SecureShortDebugString(req->request);
+
+  // The request is owned by 'inflight_requests_' until its response is
+  // processed, which can't happen before the callback below runs.
+  UpdateRequest* r = req.get();
+  r->send_time = MonoTime::Now();
+  inflight_requests_.emplace_back(std::move(req));
+  l->unlock();
+
+  // Ops already serialized by the log cache are sent as a sidecar, so that
+  // they're not serialized once again for every peer.
+  if (!r->replicate_msg_refs.empty() &&
+      !r->replicate_msg_refs.front()->serialized().empty()) {
+    unique_ptr<faststring> ops(new faststring());
+    for (const ReplicateRefPtr& msg : r->replicate_msg_refs) {
+      DCHECK(!msg->serialized().empty());
+      PutLengthPrefixedSlice(ops.get(), msg->serialized());
+    }
+    int idx;
+    CHECK_OK(r->controller.AddOutboundSidecar(rpc::RpcSidecar::FromFaststring(std::move(ops)),
+                                              &idx));
+    r->request.set_ops_sidecar_idx(idx);
+  }
+
+  // If any of the ops is replicated on behalf of a sampled distributed trace,
+  // send the request as part of that trace, so that the peer's handling of it
+  // is attributed to the operation.
+  scoped_refptr<Trace> trace;
+  for (const ReplicateRefPtr& msg : r->replicate_msg_refs) {
+    if (msg->span_context().sampled()) {
+      trace = new Trace();
+      trace->set_span_context(msg->span_context());
+      break;
+    }
+  }
+  ADOPT_TRACE(trace.get());
 
-  request_pending_ = true;
-  l.unlock();
   // Capture a shared_ptr reference into the RPC callback so that we're guaranteed
   // that this object outlives the RPC.
   shared_ptr<Peer> s_this = shared_from_this();
-  proxy_->UpdateAsync(&request_, &response_, &controller_,
-                      [s_this]() {
-                        s_this->ProcessResponse();
+  proxy_->UpdateAsync(&r->request, &r->response, &r->controller,
+                      [s_this, r]() {
+                        s_this->ProcessResponse(r);
                       });
 }
 
-void Peer::ProcessResponse() {
+void Peer::ProcessResponse(UpdateRequest* req) {
   // Note: This method runs on the reactor thread.
   std::unique_lock<simple_spinlock> lock(peer_lock_);
   if (closed_) {
     return;
   }
-  CHECK(request_pending_);
+  DCHECK(!inflight_requests_.empty());
 
   MAYBE_FAULT(FLAGS_fault_crash_after_leader_request_fraction);
 
-  // Process RpcController errors.
-  if (!controller_.status().ok()) {
-    auto ps = controller_.status().IsRemoteError() ?
-        PeerStatus::REMOTE_ERROR : PeerStatus::RPC_LAYER_ERROR;
-    queue_->UpdatePeerStatus(peer_pb_.permanent_uuid(), ps, controller_.status());
-    ProcessResponseError(controller_.status());
-    return;
-  }
-
-  // Process CANNOT_PREPARE.
-  // TODO(todd): there is no integration test coverage of this code path. Likely a bug in
-  // this path is responsible for KUDU-1779.
-  if (response_.status().has_error() &&
-      response_.status().error().code() == consensus::ConsensusErrorPB::CANNOT_PREPARE) {
-    Status response_status = StatusFromPB(response_.status().error().status());
-    queue_->UpdatePeerStatus(peer_pb_.permanent_uuid(), PeerStatus::CANNOT_PREPARE,
-                             response_status);
-    ProcessResponseError(response_status);
-    return;
-  }
-
-  // Process tserver-level errors.
-  if (response_.has_error()) {
-    Status response_status = StatusFromPB(response_.error().status());
-    PeerStatus ps;
-    if (response_.error().code() == TabletServerErrorPB::TABLET_FAILED) {
-      ps = PeerStatus::TABLET_FAILED;
-    } else if (response_.error().code() == TabletServerErrorPB::TABLET_NOT_FOUND) {
-      ps = PeerStatus::TABLET_NOT_FOUND;
-    } else {
-      // Unknown kind of error.
-      ps = PeerStatus::REMOTE_ERROR;
-    }
-    queue_->UpdatePeerStatus(peer_pb_.permanent_uuid(), ps, response_status);
-    ProcessResponseError(response_status);
+  req->done = true;
+  // Responses are processed in the order the requests were sent: a response
+  // arriving ahead of those to earlier requests waits for them, and the
+  // thread processing responses picks up any that arrive meanwhile.
+  if (processing_responses_ || inflight_requests_.front().get() != req) {
     return;
   }
 
@@ -338,30 +430,30 @@ void Peer::ProcessResponse() {
   weak_ptr<Peer> w_this = shared_from_this();
   Status s = raft_pool_token_->SubmitFunc([w_this]() {
     if (auto p = w_this.lock()) {
-      p->DoProcessResponse();
-
+      p->DoProcessResponses();
     }
   });
   if (PREDICT_FALSE(!s.ok())) {
     LOG_WITH_PREFIX_UNLOCKED(WARNING) << "Unable to process peer response: " << s.ToString()
-        << ": " << SecureShortDebugString(response_);
-    request_pending_ = false;
+        << ": " << SecureShortDebugString(req->response);
+    inflight_requests_.pop_front();
+    return;
   }
+  processing_responses_ = true;
 }
 
-void Peer::DoProcessResponse() {
-
-  VLOG_WITH_PREFIX_UNLOCKED(2) << "Response from peer " << peer_pb().permanent_uuid() << ": "
-      << SecureShortDebugString(response_);
-
-  bool more_pending;
-  queue_->ResponseFromPeer(peer_pb_.permanent_uuid(), response_, &more_pending);
-
+void Peer::DoProcessResponses() {
+  bool more_pending = false;
   {
     std::unique_lock<simple_spinlock> lock(peer_lock_);
-    CHECK(request_pending_);
-    failed_attempts_ = 0;
-    request_pending_ = false;
+    CHECK(processing_responses_);
+    while (!closed_ && !inflight_requests_.empty() && inflight_requests_.front()->done) {
+      // The request stays in flight until its response is handled, so that
+      // no request is sent meanwhile from the queue's outdated view of the peer.
+      more_pending = HandleResponse(*inflight_requests_.front(), &lock);
+      inflight_requests_.pop_front();
+    }
+    processing_responses_ = false;
   }
   // We're OK to read the state_ without a lock here -- if we get a race,
   // the worst thing that could happen is that we'll make one more request before
@@ -371,6 +463,62 @@ void Peer::DoProcessResponse() {
   }
 }
 
+bool Peer::HandleResponse(const UpdateRequest& req, std::unique_lock<simple_spinlock>* l) {
+  DCHECK(l->owns_lock());
+  const ConsensusResponsePB& response = req.response;
+
+  // Process RpcController errors.
+  if (!req.controller.status().ok()) {
+    auto ps = req.controller.status().IsRemoteError() ?
+        PeerStatus::REMOTE_ERROR : PeerStatus::RPC_LAYER_ERROR;
+    queue_->UpdatePeerStatus(peer_pb_.permanent_uuid(), ps, req.controller.status());
+    ProcessResponseError(response, req.controller.status());
+    return false;
+  }
+
+  // Process CANNOT_PREPARE.
+  // TODO(todd): there is no integration test coverage of this code path. Likely a bug in
+  // this path is responsible for KUDU-1779.
+  if (response.status().has_error() &&
+      response.status().error().code() == consensus::ConsensusErrorPB::CANNOT_PREPARE) {
+    Status response_status = StatusFromPB(response.status().error().status());
+    queue_->UpdatePeerStatus(peer_pb_.permanent_uuid(), PeerStatus::CANNOT_PREPARE,
+                             response_status);
+    ProcessResponseError(response, response_status);
+    return false;
+  }
+
+  // Process tserver-level errors.
+  if (response.has_error()) {
+    Status response_status = StatusFromPB(response.error().status());
+    PeerStatus ps;
+    if (response.error().code() == TabletServerErrorPB::TABLET_FAILED) {
+      ps = PeerStatus::TABLET_FAILED;
+    } else if (response.error().code() == TabletServerErrorPB::TABLET_NOT_FOUND) {
+      ps = PeerStatus::TABLET_NOT_FOUND;
+    } else {
+      // Unknown kind of error.
+      ps = PeerStatus::REMOTE_ERROR;
+    }
+    queue_->UpdatePeerStatus(peer_pb_.permanent_uuid(), ps, response_status);
+    ProcessResponseError(response, response_status);
+    return false;
+  }
+
+  VLOG_WITH_PREFIX_UNLOCKED(2) << "Response from peer " << peer_pb().permanent_uuid() << ": "
+      << SecureShortDebugString(response);
+
+  bool more_pending;
+  l->unlock();
+  if (!response.status().has_error()) {
+    queue_->LeaseGrantedByPeer(peer_pb_.permanent_uuid(), req.send_time);
+  }
+  queue_->ResponseFromPeer(peer_pb_.permanent_uuid(), response, &more_pending);
+  l->lock();
+  failed_attempts_ = 0;
+  return more_pending;
+}
+
 Status Peer::PrepareTabletCopyRequest() {
   if (!FLAGS_enable_tablet_copy) {
     failed_attempts_++;
@@ -388,8 +536,8 @@ void Peer::ProcessTabletCopyResponse() {
   if (closed_) {
     return;
   }
-  CHECK(request_pending_);
-  request_pending_ = false;
+  CHECK(tablet_copy_pending_);
+  tablet_copy_pending_ = false;
 
   // If the response is OK, or ALREADY_INPROGRESS, then consider the RPC successful.
   bool success =
@@ -411,13 +559,44 @@ void Peer::ProcessTabletCopyResponse() {
   }
 }
 
-void Peer::ProcessResponseError(const Status& status) {
+void Peer::StartElection() {
+  {
+    std::lock_guard<simple_spinlock> lock(peer_lock_);
+    if (closed_) return;
+  }
+  // The request, response and controller must outlive the asynchronous call.
+  // Unlike the other requests sent to the peer, several elections may be
+  // requested at once, so they are allocated per call and freed by the
+  // callback.
+  auto req = std::make_shared<RunLeaderElectionRequestPB>();
+  auto resp = std::make_shared<RunLeaderElectionResponsePB>();
+  auto controller = std::make_shared<RpcController>();
+  req->set_dest_uuid(peer_pb_.permanent_uuid());
+  req->set_tablet_id(tablet_id_);
+  controller->set_timeout(MonoDelta::FromMilliseconds(FLAGS_consensus_rpc_timeout_ms));
+  string log_prefix = LogPrefixUnlocked();
+  proxy_->StartElectionAsync(req.get(), resp.get(), controller.get(),
+                             [req, resp, controller, log_prefix]() {
+    Status s = controller->status();
+    if (s.ok() && resp->has_error()) {
+      s = StatusFromPB(resp->error().status());
+    }
+    if (s.ok()) {
+      LOG(INFO) << log_prefix << "Peer started a leader election";
+    } else {
+      LOG(WARNING) << log_prefix << "Unable to make peer start a leader election: "
+                   << s.ToString();
+    }
+  });
+}
+
+void Peer::ProcessResponseError(const ConsensusResponsePB& response, const Status& status) {
   failed_attempts_++;
   string resp_err_info;
-  if (response_.has_error()) {
+  if (response.has_error()) {
     resp_err_info = Substitute(" Error code: $0 ($1).",
-                               TabletServerErrorPB::Code_Name(response_.error().code()),
-                               response_.error().code());
+                               TabletServerErrorPB::Code_Name(response.error().code()),
+                               response.error().code());
   }
   LOG_WITH_PREFIX_UNLOCKED(WARNING) << "Couldn't send request to peer " << peer_pb_.permanent_uuid()
       << " for tablet " << tablet_id_ << "."
@@ -425,7 +604,6 @@ void Peer::ProcessResponseError(const Status& status) {
       << " Status: " << status.ToString() << "."
       << " Retrying in the next heartbeat period."
       << " Already tried " << failed_attempts_ << " times.";
-  request_pending_ = false;
 }
 
 string Peer::LogPrefixUnlocked() const {
@@ -451,15 +629,14 @@ Peer::~Peer() {
   if (heartbeater_) {
     heartbeater_->Stop();
   }
-
-  // We don't own the ops (the queue does).
-  request_.mutable_ops()->ExtractSubrange(0, request_.ops_size(), nullptr);
 }
 
 RpcPeerProxy::RpcPeerProxy(gscoped_ptr<HostPort> hostport,
-                           gscoped_ptr<ConsensusServiceProxy> consensus_proxy)
+                           gscoped_ptr<ConsensusServiceProxy> consensus_proxy,
+                           shared_ptr<RpcHeartbeatBatcher> batcher)
     : hostport_(std::move(hostport)),
-      consensus_proxy_(std::move(consensus_proxy)) {
+      consensus_proxy_(std::move(consensus_proxy)),
+      batcher_(std::move(batcher)) {
 }
 
 void RpcPeerProxy::UpdateAsync(const ConsensusRequestPB* request,
@@ -467,6 +644,23 @@ void RpcPeerProxy::UpdateAsync(const ConsensusRequestPB* request,
                                rpc::RpcController* controller,
                                const rpc::ResponseCallback& callback) {
   controller->set_timeout(MonoDelta::FromMilliseconds(FLAGS_consensus_rpc_timeout_ms));
+  // Requests with ops aren't batched: they may take a while to be handled,
+  // which would hold up the requests of the other tablets.
+  if (batcher_ && request->ops_size() == 0 && batcher_->supported()) {
+    batcher_->Add(request, response, controller, callback);
+    return;
+  }
+  if (request->has_ops_sidecar_idx()) {
+    // The ops are sent in a sidecar, so send a copy of the request without
+    // them. Nothing else accesses the request until the RPC completes.
+    auto* mutable_request = const_cast<ConsensusRequestPB*>(request);
+    google::protobuf::RepeatedPtrField<ReplicateMsg> ops;
+    ops.Swap(mutable_request->mutable_ops());
+    ConsensusRequestPB wire_request(*mutable_request);
+    ops.Swap(mutable_request->mutable_ops());
+    consensus_proxy_->UpdateConsensusAsync(wire_request, response, controller, callback);
+    return;
+  }
   consensus_proxy_->UpdateConsensusAsync(*request, response, controller, callback);
 }
 
@@ -484,6 +678,13 @@ void RpcPeerProxy::StartTabletCopy(const StartTabletCopyRequestPB* request,
   consensus_proxy_->StartTabletCopyAsync(*request, response, controller, callback);
 }
 
+void RpcPeerProxy::StartElectionAsync(const RunLeaderElectionRequestPB* request,
+                                      RunLeaderElectionResponsePB* response,
+                                      rpc::RpcController* controller,
+                                      const rpc::ResponseCallback& callback) {
+  consensus_proxy_->RunLeaderElectionAsync(*request, response, controller, callback);
+}
+
 RpcPeerProxy::~RpcPeerProxy() {}
 
 namespace {
@@ -504,6 +705,133 @@ Status CreateConsensusServiceProxyForHost(const shared_ptr<Messenger>& messenger
 
 } // anonymous namespace
 
+struct RpcHeartbeatBatcher::Batch {
+  vector<Entry> entries;
+  MultiConsensusRequestPB request;
+  MultiConsensusResponsePB response;
+  RpcController controller;
+};
+
+RpcHeartbeatBatcher::RpcHeartbeatBatcher(shared_ptr<Messenger> messenger,
+                                         string hostport,
+                                         gscoped_ptr<ConsensusServiceProxy> consensus_proxy)
+    : messenger_(std::move(messenger)),
+      hostport_(std::move(hostport)),
+      consensus_proxy_(std::move(consensus_proxy)),
+      supported_(true),
+      flush_scheduled_(false) {
+}
+
+RpcHeartbeatBatcher::~RpcHeartbeatBatcher() {
+  // Entries hold references to their peers, which hold references to the
+  // batcher, so the batcher can't go away before they are sent.
+  DCHECK(pending_.empty());
+}
+
+Status RpcHeartbeatBatcher::GetOrCreate(const shared_ptr<Messenger>& messenger,
+                                        const HostPort& hostport,
+                                        shared_ptr<RpcHeartbeatBatcher>* batcher) {
+  static simple_spinlock registry_lock;
+  static auto* batchers = new map<pair<Messenger*, string>, weak_ptr<RpcHeartbeatBatcher>>();
+  const auto key = std::make_pair(messenger.get(), hostport.ToString());
+  std::lock_guard<simple_spinlock> l(registry_lock);
+  weak_ptr<RpcHeartbeatBatcher>* existing = &LookupOrInsert(batchers, key, {});
+  *batcher = existing->lock();
+  if (*batcher) {
+    return Status::OK();
+  }
+  gscoped_ptr<ConsensusServiceProxy> proxy;
+  RETURN_NOT_OK(CreateConsensusServiceProxyForHost(messenger, hostport, &proxy));
+  batcher->reset(new RpcHeartbeatBatcher(messenger, hostport.ToString(), std::move(proxy)));
+  *existing = *batcher;
+
+  // Drop the batchers which are gone, so that the registry doesn't grow with
+  // every messenger and server ever used.
+  for (auto it = batchers->begin(); it != batchers->end();) {
+    if (it->second.expired()) {
+      it = batchers->erase(it);
+    } else {
+      ++it;
+    }
+  }
+  return Status::OK();
+}
+
+void RpcHeartbeatBatcher::Add(const ConsensusRequestPB* request,
+                              ConsensusResponsePB* response,
+                              RpcController* controller,
+                              const rpc::ResponseCallback& callback) {
+  std::lock_guard<simple_spinlock> l(lock_);
+  pending_.push_back({ request, response, controller, callback });
+  if (flush_scheduled_) {
+    return;
+  }
+  flush_scheduled_ = true;
+  // The batch is sent even if the messenger is shutting down, in which case
+  // its requests fail and their callbacks are called.
+  weak_ptr<RpcHeartbeatBatcher> w_this = shared_from_this();
+  messenger_->ScheduleOnReactor(
+      [w_this](const Status& /* s */) {
+        if (auto b = w_this.lock()) {
+          b->Flush();
+        }
+      },
+      MonoDelta::FromMilliseconds(FLAGS_consensus_heartbeat_batch_window_ms));
+}
+
+void RpcHeartbeatBatcher::Flush() {
+  shared_ptr<Batch> batch = std::make_shared<Batch>();
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    batch->entries.swap(pending_);
+    flush_scheduled_ = false;
+  }
+  if (batch->entries.empty()) {
+    return;
+  }
+  for (const auto& entry : batch->entries) {
+    batch->request.add_requests()->CopyFrom(*entry.request);
+  }
+  batch->controller.set_timeout(MonoDelta::FromMilliseconds(FLAGS_consensus_rpc_timeout_ms));
+  shared_ptr<RpcHeartbeatBatcher> s_this = shared_from_this();
+  consensus_proxy_->MultiUpdateConsensusAsync(batch->request, &batch->response,
+                                              &batch->controller,
+                                              [s_this, batch]() {
+                                                s_this->BatchDone(batch.get());
+                                              });
+}
+
+void RpcHeartbeatBatcher::BatchDone(Batch* batch) {
+  const Status& s = batch->controller.status();
+  if (PREDICT_TRUE(s.ok() && !batch->response.has_error() &&
+                   batch->response.responses_size() == batch->entries.size())) {
+    for (int i = 0; i < batch->entries.size(); i++) {
+      const Entry& entry = batch->entries[i];
+      entry.response->Swap(batch->response.mutable_responses(i));
+      entry.callback();
+    }
+    return;
+  }
+
+  const rpc::ErrorStatusPB* err = batch->controller.error_response();
+  if (s.IsRemoteError() && err && err->has_code() &&
+      err->code() == rpc::ErrorStatusPB::ERROR_NO_SUCH_METHOD) {
+    LOG(INFO) << "Server at " << hostport_ << " does not support "
+              << "batched consensus requests, sending them one by one";
+    supported_ = false;
+  } else {
+    KLOG_EVERY_N_SECS(WARNING, 60)
+        << "Couldn't send batch of " << batch->entries.size() << " consensus requests to "
+        << hostport_ << ", sending them one by one: "
+        << (s.ok() ? SecureShortDebugString(batch->response) : s.ToString());
+  }
+  // Retrying the requests individually also reports any error the right way.
+  for (const auto& entry : batch->entries) {
+    consensus_proxy_->UpdateConsensusAsync(*entry.request, entry.response, entry.controller,
+                                           entry.callback);
+  }
+}
+
 RpcPeerProxyFactory::RpcPeerProxyFactory(shared_ptr<Messenger> messenger)
     : messenger_(std::move(messenger)) {}
 
@@ -513,7 +841,11 @@ Status RpcPeerProxyFactory::NewProxy(const RaftPeerPB& peer_pb,
   RETURN_NOT_OK(HostPortFromPB(peer_pb.last_known_addr(), hostport.get()));
   gscoped_ptr<ConsensusServiceProxy> new_proxy;
   RETURN_NOT_OK(CreateConsensusServiceProxyForHost(messenger_, *hostport, &new_proxy));
-  proxy->reset(new RpcPeerProxy(std::move(hostport), std::move(new_proxy)));
+  shared_ptr<RpcHeartbeatBatcher> batcher;
+  if (FLAGS_consensus_batch_heartbeats) {
+    RETURN_NOT_OK(RpcHeartbeatBatcher::GetOrCreate(messenger_, *hostport, &batcher));
+  }
+  proxy->reset(new RpcPeerProxy(std::move(hostport), std::move(new_proxy), std::move(batcher)));
   return Status::OK();
 }
 
@@ -18,8 +18,11 @@
 #ifndef KUDU_CONSENSUS_CONSENSUS_PEERS_H_
 #define KUDU_CONSENSUS_CONSENSUS_PEERS_H_
 
+#include <atomic>
 #include <cstdint>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <ostream>
 #include <string>
 #include <vector>
@@ -30,10 +33,12 @@
 #include "kudu/consensus/metadata.pb.h"
 #include "kudu/consensus/ref_counted_replicate.h"
 #include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/macros.h"
 #include "kudu/gutil/port.h"
 #include "kudu/rpc/response_callback.h"
 #include "kudu/rpc/rpc_controller.h"
 #include "kudu/util/locks.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/status.h"
 
 namespace kudu {
@@ -52,13 +57,16 @@ class PeerMessageQueue;
 
 // A remote peer in consensus.
 //
-// Leaders use peers to update the remote replicas. Each peer
-// may have at most one outstanding request at a time. If a
-// request is signaled when there is already one outstanding,
-// the request will be generated once the outstanding one finishes.
+// Leaders use peers to update the remote replicas. Each peer may have up
+// to --consensus_max_inflight_requests_per_peer outstanding requests at a
+// time: while some are outstanding, a request is only generated if there are
+// ops following the ones already sent, and the last exchange with the remote
+// replica was successful. Otherwise, it is generated once the outstanding
+// ones finish. Responses are processed in the order the requests were sent,
+// whatever the order in which they arrive.
 //
 // Peers are owned by the consensus implementation and do not keep
-// state aside from the most recent request and response.
+// state aside from the outstanding requests and their responses.
 //
 // Peers are also responsible for sending periodic heartbeats
 // to assert liveness of the leader. The peer constructs a heartbeater
@@ -79,6 +87,10 @@ class Peer : public std::enable_shared_from_this<Peer> {
   // status-only requests.
   Status SignalRequest(bool even_if_queue_empty = false);
 
+  // Asks the peer to start a leader election right away, without waiting
+  // for the leader's failure to be detected. The outcome is only logged.
+  void StartElection();
+
   const RaftPeerPB& peer_pb() const { return peer_pb_; }
 
   // Stop sending requests and periodic heartbeats.
@@ -118,17 +130,55 @@ class Peer : public std::enable_shared_from_this<Peer> {
        gscoped_ptr<PeerProxy> proxy,
        std::shared_ptr<rpc::Messenger> messenger);
 
+  // A consensus update request sent to the peer, along with its response.
+  struct UpdateRequest {
+    ~UpdateRequest();
+
+    ConsensusRequestPB request;
+    ConsensusResponsePB response;
+    rpc::RpcController controller;
+
+    // Reference-counted pointers to the ReplicateMsgs in 'request'. We may
+    // have loaded these messages from the LogCache, in which case we are
+    // potentially sharing the same object as other peers. Since the PB
+    // request itself can't hold reference counts, this holds them.
+    std::vector<ReplicateRefPtr> replicate_msg_refs;
+
+    // The time at which the request was sent.
+    MonoTime send_time;
+
+    // Whether the response was received.
+    bool done = false;
+  };
+
   void SendNextRequest(bool even_if_queue_empty);
 
-  // Signals that a response was received from the peer.
-  //
-  // This method is called from the reactor thread and calls
-  // DoProcessResponse() on raft_pool_token_ to do any work that requires IO or
-  // lock-taking.
-  void ProcessResponse();
+  // Sends requests pipelined behind the ones in flight, as long as that is
+  // allowed and there are ops to send. 'l' must hold 'peer_lock_'.
+  void SendPipelinedRequests(std::unique_lock<simple_spinlock>* l);
+
+  // Sends 'req' to the peer, adding it to the requests in flight.
+  // 'l' must hold 'peer_lock_', and is released.
+  void SendUpdateRequest(std::unique_ptr<UpdateRequest> req,
+                         std::unique_lock<simple_spinlock>* l);
 
-  // Run on 'raft_pool_token'. Does response handling that requires IO or may block.
-  void DoProcessResponse();
+  // Signals that the response to 'req' was received from the peer.
+  //
+  // This method is called from the reactor thread and, once the responses
+  // to all the requests sent before 'req' were received, calls
+  // DoProcessResponses() on raft_pool_token_ to do any work that requires IO
+  // or lock-taking.
+  void ProcessResponse(UpdateRequest* req);
+
+  // Run on 'raft_pool_token'. Handles the received responses at the front
+  // of 'inflight_requests_', in order. Does response handling that requires
+  // IO or may block.
+  void DoProcessResponses();
+
+  // Handles the response to 'req', returning whether there is more to send
+  // to the peer. 'l' must hold 'peer_lock_', and is released while the queue
+  // handles a successful response.
+  bool HandleResponse(const UpdateRequest& req, std::unique_lock<simple_spinlock>* l);
 
   // Fetch the desired tablet copy request from the queue and set up
   // tc_request_ appropriately.
@@ -140,8 +190,9 @@ class Peer : public std::enable_shared_from_this<Peer> {
   // Handle RPC callback from initiating tablet copy.
   void ProcessTabletCopyResponse();
 
-  // Signals there was an error sending the request to the peer.
-  void ProcessResponseError(const Status& status);
+  // Signals there was an error sending a request to the peer, which got
+  // 'response'.
+  void ProcessResponseError(const ConsensusResponsePB& response, const Status& status);
 
   std::string LogPrefixUnlocked() const;
 
@@ -157,20 +208,20 @@ class Peer : public std::enable_shared_from_this<Peer> {
   PeerMessageQueue* queue_;
   uint64_t failed_attempts_;
 
-  // The latest consensus update request and response.
-  ConsensusRequestPB request_;
-  ConsensusResponsePB response_;
+  // The consensus update requests in flight to the peer, in the order they
+  // were sent.
+  std::deque<std::unique_ptr<UpdateRequest>> inflight_requests_;
+
+  // Whether responses from 'inflight_requests_' are being processed.
+  bool processing_responses_ = false;
+
+  // The committed index of the latest consensus update request assembled.
+  int64_t last_sent_committed_index_;
 
   // The latest tablet copy request and response.
   StartTabletCopyRequestPB tc_request_;
   StartTabletCopyResponsePB tc_response_;
 
-  // Reference-counted pointers to any ReplicateMsgs which are in-flight to the peer. We
-  // may have loaded these messages from the LogCache, in which case we are potentially
-  // sharing the same object as other peers. Since the PB request_ itself can't hold
-  // reference counts, this holds them.
-  std::vector<ReplicateRefPtr> replicate_msg_refs_;
-
   rpc::RpcController controller_;
 
   std::shared_ptr<rpc::Messenger> messenger_;
@@ -185,7 +236,7 @@ class Peer : public std::enable_shared_from_this<Peer> {
 
   // lock that protects Peer state changes, initialization, etc.
   mutable simple_spinlock peer_lock_;
-  bool request_pending_ = false;
+  bool tablet_copy_pending_ = false;
   bool closed_ = false;
   bool has_sent_first_request_ = false;
 
@@ -216,6 +267,14 @@ class PeerProxy {
     LOG(DFATAL) << "Not implemented";
   }
 
+  // Instructs a peer to start a leader election.
+  virtual void StartElectionAsync(const RunLeaderElectionRequestPB* request,
+                                  RunLeaderElectionResponsePB* response,
+                                  rpc::RpcController* controller,
+                                  const rpc::ResponseCallback& callback) {
+    LOG(DFATAL) << "Not implemented";
+  }
+
   virtual ~PeerProxy() {}
 };
 
@@ -232,11 +291,84 @@ class PeerProxyFactory {
   virtual const std::shared_ptr<rpc::Messenger>& messenger() const = 0;
 };
 
+// Batches the status-only consensus requests (heartbeats) that the leaders
+// on this server send to the replicas on another server into
+// MultiUpdateConsensus() RPCs.
+//
+// With many tablets, the heartbeats of idle replicas make up most of the
+// RPCs between servers, and a good part of their reactor and service thread
+// load. Instead, the requests are held for up to
+// --consensus_heartbeat_batch_window_ms and sent together, each getting its
+// own response. If a batch fails, for example because the destination server
+// doesn't support batches, its requests are sent one by one instead.
+//
+// This class is thread-safe.
+class RpcHeartbeatBatcher : public std::enable_shared_from_this<RpcHeartbeatBatcher> {
+ public:
+  RpcHeartbeatBatcher(std::shared_ptr<rpc::Messenger> messenger,
+                      std::string hostport,
+                      gscoped_ptr<ConsensusServiceProxy> consensus_proxy);
+
+  ~RpcHeartbeatBatcher();
+
+  // Returns the batcher for requests sent through 'messenger' to 'hostport',
+  // creating it if needed. The batcher is shared by all the proxies to that
+  // server, and lives as long as any of them keeps a reference to it.
+  static Status GetOrCreate(const std::shared_ptr<rpc::Messenger>& messenger,
+                            const HostPort& hostport,
+                            std::shared_ptr<RpcHeartbeatBatcher>* batcher);
+
+  // Whether the destination server is known to support batches.
+  bool supported() const {
+    return supported_;
+  }
+
+  // Adds a status-only request to the next batch. When the response is
+  // received, 'response' is set, and 'callback' is called. Same as with
+  // ConsensusServiceProxy::UpdateConsensusAsync(), if sending failed,
+  // the status of 'controller' is set instead.
+  void Add(const ConsensusRequestPB* request,
+           ConsensusResponsePB* response,
+           rpc::RpcController* controller,
+           const rpc::ResponseCallback& callback);
+
+ private:
+  struct Entry {
+    const ConsensusRequestPB* request;
+    ConsensusResponsePB* response;
+    rpc::RpcController* controller;
+    rpc::ResponseCallback callback;
+  };
+  struct Batch;
+
+  // Sends the requests added since the last batch.
+  void Flush();
+
+  // Called when the response to 'batch' is received.
+  void BatchDone(Batch* batch);
+
+  const std::shared_ptr<rpc::Messenger> messenger_;
+  const std::string hostport_;
+  const gscoped_ptr<ConsensusServiceProxy> consensus_proxy_;
+
+  std::atomic<bool> supported_;
+
+  simple_spinlock lock_;
+  // The requests of the next batch. Protected by 'lock_'.
+  std::vector<Entry> pending_;
+  // Whether the next batch is scheduled to be sent. Protected by 'lock_'.
+  bool flush_scheduled_;
+
+  DISALLOW_COPY_AND_ASSIGN(RpcHeartbeatBatcher);
+};
+
 // PeerProxy implementation that does RPC calls
 class RpcPeerProxy : public PeerProxy {
  public:
+  // If 'batcher' is set, status-only update requests are sent through it.
   RpcPeerProxy(gscoped_ptr<HostPort> hostport,
-               gscoped_ptr<ConsensusServiceProxy> consensus_proxy);
+               gscoped_ptr<ConsensusServiceProxy> consensus_proxy,
+               std::shared_ptr<RpcHeartbeatBatcher> batcher = nullptr);
 
   virtual void UpdateAsync(const ConsensusRequestPB* request,
                            ConsensusResponsePB* response,
@@ -253,11 +385,17 @@ class RpcPeerProxy : public PeerProxy {
                                     rpc::RpcController* controller,
                                     const rpc::ResponseCallback& callback) OVERRIDE;
 
+  virtual void StartElectionAsync(const RunLeaderElectionRequestPB* request,
+                                  RunLeaderElectionResponsePB* response,
+                                  rpc::RpcController* controller,
+                                  const rpc::ResponseCallback& callback) OVERRIDE;
+
   virtual ~RpcPeerProxy();
 
  private:
   gscoped_ptr<HostPort> hostport_;
   gscoped_ptr<ConsensusServiceProxy> consensus_proxy_;
+  const std::shared_ptr<RpcHeartbeatBatcher> batcher_;
 };
 
 // PeerProxyFactory implementation that generates RPCPeerProxies
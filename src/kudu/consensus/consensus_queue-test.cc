@@ -847,6 +847,45 @@ TEST_F(ConsensusQueueTest, TestTriggerTabletCopyIfTabletNotFound) {
             pb_util::SecureShortDebugString(tc_req.copy_peer_addr()));
 }
 
+// Tests that the leader lease lasts since the latest time a majority of the
+// voters granted it.
+TEST_F(ConsensusQueueTest, TestMajorityLeaseGrantTime) {
+  queue_->SetLeaderMode(kMinimumOpIdIndex, kMinimumTerm, BuildRaftConfigPBForTests(5));
+  queue_->TrackPeer("peer-1");
+  queue_->TrackPeer("peer-2");
+  queue_->TrackPeer("peer-3");
+  queue_->TrackPeer("peer-4");
+
+  // The local peer alone is not a majority.
+  ASSERT_EQ(MonoTime::Min(), queue_->GetMajorityLeaseGrantTime());
+
+  MonoTime t1 = MonoTime::Now();
+  MonoTime t2 = t1 + MonoDelta::FromMilliseconds(10);
+  MonoTime t3 = t1 + MonoDelta::FromMilliseconds(20);
+  queue_->LeaseGrantedByPeer("peer-1", t3);
+  ASSERT_EQ(MonoTime::Min(), queue_->GetMajorityLeaseGrantTime());
+  queue_->LeaseGrantedByPeer("peer-2", t1);
+  ASSERT_EQ(t1, queue_->GetMajorityLeaseGrantTime());
+  queue_->LeaseGrantedByPeer("peer-3", t2);
+  ASSERT_EQ(t2, queue_->GetMajorityLeaseGrantTime());
+
+  // The response to an earlier request doesn't shorten the lease.
+  queue_->LeaseGrantedByPeer("peer-3", t1);
+  ASSERT_EQ(t2, queue_->GetMajorityLeaseGrantTime());
+
+  // Leases are granted to the leader of a given term only.
+  queue_->SetLeaderMode(kMinimumOpIdIndex, kMinimumTerm + 1, BuildRaftConfigPBForTests(5));
+  ASSERT_EQ(MonoTime::Min(), queue_->GetMajorityLeaseGrantTime());
+
+  queue_->SetNonLeaderMode();
+  queue_->LeaseGrantedByPeer("peer-1", t3);
+  ASSERT_EQ(MonoTime::Min(), queue_->GetMajorityLeaseGrantTime());
+
+  // A single voter holds the lease on its own.
+  queue_->SetLeaderMode(kMinimumOpIdIndex, kMinimumTerm + 2, BuildRaftConfigPBForTests(1));
+  ASSERT_EQ(MonoTime::Max(), queue_->GetMajorityLeaseGrantTime());
+}
+
 TEST_F(ConsensusQueueTest, TestFollowerCommittedIndexAndMetrics) {
   queue_->SetNonLeaderMode();
 
@@ -18,6 +18,7 @@
 
 #include <algorithm>
 #include <cstdint>
+#include <functional>
 #include <iostream>
 #include <mutex>
 #include <string>
@@ -170,6 +171,10 @@ void PeerMessageQueue::SetLeaderMode(int64_t committed_index,
     CHECK_GT(current_term, queue_state_.current_term) << "Terms should only increase";
     queue_state_.first_index_in_current_term = boost::none;
     queue_state_.current_term = current_term;
+    // Leases are granted to the leader of a given term only.
+    for (const PeersMap::value_type& entry : peers_map_) {
+      entry.second->lease_grant_time = MonoTime::Min();
+    }
   }
 
   queue_state_.committed_index = committed_index;
@@ -199,6 +204,8 @@ void PeerMessageQueue::SetNonLeaderMode() {
   queue_state_.active_config.reset();
   queue_state_.mode = NON_LEADER;
   queue_state_.majority_size_ = -1;
+  successor_watch_in_progress_ = false;
+  designated_successor_uuid_ = boost::none;
 
   // Update this when stepping down, since it doesn't get tracked as LEADER.
   queue_state_.last_idx_appended_to_leader = queue_state_.last_appended.index();
@@ -207,6 +214,19 @@ void PeerMessageQueue::SetNonLeaderMode() {
   time_manager_->SetNonLeaderMode();
 }
 
+void PeerMessageQueue::BeginWatchForSuccessor(
+    const boost::optional<string>& successor_uuid) {
+  std::lock_guard<simple_spinlock> lock(queue_lock_);
+  successor_watch_in_progress_ = true;
+  designated_successor_uuid_ = successor_uuid;
+}
+
+void PeerMessageQueue::EndWatchForSuccessor() {
+  std::lock_guard<simple_spinlock> lock(queue_lock_);
+  successor_watch_in_progress_ = false;
+  designated_successor_uuid_ = boost::none;
+}
+
 void PeerMessageQueue::TrackPeer(const string& uuid) {
   std::lock_guard<simple_spinlock> lock(queue_lock_);
   TrackPeerUnlocked(uuid);
@@ -242,6 +262,7 @@ void PeerMessageQueue::UntrackPeer(const string& uuid) {
   if (peer != nullptr) {
     delete peer;
   }
+  log_cache_.DropReadAhead(uuid);
 }
 
 void PeerMessageQueue::CheckPeersInActiveConfigIfLeaderUnlocked() const {
@@ -433,6 +454,25 @@ Status PeerMessageQueue::RequestForPeer(const string& uuid,
                                         ConsensusRequestPB* request,
                                         vector<ReplicateRefPtr>* msg_refs,
                                         bool* needs_tablet_copy) {
+  return AssembleRequestForPeer(uuid, boost::none, request, msg_refs, needs_tablet_copy);
+}
+
+Status PeerMessageQueue::PipelinedRequestForPeer(const string& uuid,
+                                                 int64_t last_sent_index,
+                                                 ConsensusRequestPB* request,
+                                                 vector<ReplicateRefPtr>* msg_refs) {
+  bool needs_tablet_copy;
+  RETURN_NOT_OK(AssembleRequestForPeer(uuid, last_sent_index, request, msg_refs,
+                                       &needs_tablet_copy));
+  DCHECK(!needs_tablet_copy);
+  return Status::OK();
+}
+
+Status PeerMessageQueue::AssembleRequestForPeer(const string& uuid,
+                                                boost::optional<int64_t> last_sent_index,
+                                                ConsensusRequestPB* request,
+                                                vector<ReplicateRefPtr>* msg_refs,
+                                                bool* needs_tablet_copy) {
   // Maintain a thread-safe copy of necessary members.
   OpId preceding_id;
   int64_t current_term;
@@ -448,6 +488,10 @@ Status PeerMessageQueue::RequestForPeer(const string& uuid,
       return Status::NotFound("Peer not tracked or queue not in leader mode.");
     }
     peer = *peer_ptr;
+    if (last_sent_index && peer.last_exchange_status != PeerStatus::OK) {
+      return Status::IllegalState("Cannot pipeline requests to peer until it is in sync",
+                                  peer.ToString());
+    }
 
     // Clear the requests without deleting the entries, as they may be in use by other peers.
     request->mutable_ops()->ExtractSubrange(0, request->ops_size(), nullptr);
@@ -463,7 +507,8 @@ Status PeerMessageQueue::RequestForPeer(const string& uuid,
     request->set_caller_term(current_term);
     unreachable_time = MonoTime::Now() - peer.last_communication_time;
   }
-  if (unreachable_time.ToSeconds() > FLAGS_follower_unavailable_considered_failed_sec) {
+  if (!last_sent_index &&
+      unreachable_time.ToSeconds() > FLAGS_follower_unavailable_considered_failed_sec) {
     if (SafeToEvict(uuid)) {
       string msg = Substitute("Leader has been unable to successfully communicate "
                               "with Peer $0 for more than $1 seconds ($2)",
@@ -489,8 +534,10 @@ Status PeerMessageQueue::RequestForPeer(const string& uuid,
     vector<ReplicateRefPtr> messages;
     int max_batch_size = FLAGS_consensus_max_batch_size_bytes - request->ByteSize();
 
-    // We try to get the follower's next_index from our log.
-    Status s = log_cache_.ReadOps(peer.next_index - 1,
+    // We try to get the follower's next_index from our log, or the op
+    // following the ones already sent if pipelining.
+    Status s = log_cache_.ReadOps(uuid,
+                                  last_sent_index ? *last_sent_index : peer.next_index - 1,
                                   max_batch_size,
                                   &messages,
                                   &preceding_id);
@@ -749,6 +796,7 @@ void PeerMessageQueue::ResponseFromPeer(const std::string& peer_uuid,
   CHECK(!response.has_error());
 
   boost::optional<int64_t> updated_commit_index;
+  boost::optional<string> successor_uuid;
   Mode mode_copy;
   {
     std::lock_guard<simple_spinlock> scoped_lock(queue_lock_);
@@ -927,6 +975,21 @@ void PeerMessageQueue::ResponseFromPeer(const std::string& peer_uuid,
                                      << commit_index_before << " to "
                                      << *updated_commit_index;
       }
+
+      // If a successor is being watched for, and this peer qualifies and has
+      // caught up with the leader, it can take over. A witness has no data to
+      // serve, so it never qualifies.
+      if (successor_watch_in_progress_ &&
+          peer->uuid != local_peer_pb_.permanent_uuid() &&
+          OpIdEquals(peer->last_received, queue_state_.last_appended) &&
+          (designated_successor_uuid_ ?
+           peer->uuid == *designated_successor_uuid_ :
+           (IsRaftConfigVoter(peer->uuid, *queue_state_.active_config) &&
+            !IsRaftConfigWitness(peer->uuid, *queue_state_.active_config)))) {
+        successor_watch_in_progress_ = false;
+        designated_successor_uuid_ = boost::none;
+        successor_uuid = peer->uuid;
+      }
     }
 
     // If our log has the next request for the peer or if the peer's committed index is
@@ -942,6 +1005,9 @@ void PeerMessageQueue::ResponseFromPeer(const std::string& peer_uuid,
   if (mode_copy == LEADER && updated_commit_index != boost::none) {
     NotifyObserversOfCommitIndexChange(*updated_commit_index);
   }
+  if (successor_uuid) {
+    NotifyObserversOfPeerToStartElection(*successor_uuid);
+  }
 }
 
 PeerMessageQueue::TrackedPeer PeerMessageQueue::GetTrackedPeerForTests(const string& uuid) {
@@ -966,6 +1032,46 @@ bool PeerMessageQueue::IsCommittedIndexInCurrentTerm() const {
       queue_state_.committed_index >= *queue_state_.first_index_in_current_term;
 }
 
+void PeerMessageQueue::LeaseGrantedByPeer(const string& peer_uuid, MonoTime send_time) {
+  std::lock_guard<simple_spinlock> lock(queue_lock_);
+  if (queue_state_.mode != LEADER) {
+    return;
+  }
+  TrackedPeer* peer = FindPtrOrNull(peers_map_, peer_uuid);
+  if (PREDICT_FALSE(peer == nullptr)) {
+    return;
+  }
+  // Requests are pipelined, so their responses may be handled out of order.
+  if (send_time > peer->lease_grant_time) {
+    peer->lease_grant_time = send_time;
+  }
+}
+
+MonoTime PeerMessageQueue::GetMajorityLeaseGrantTime() const {
+  std::lock_guard<simple_spinlock> lock(queue_lock_);
+  if (queue_state_.mode != LEADER) {
+    return MonoTime::Min();
+  }
+  // The local peer always grants itself the lease.
+  int num_remote_grants = queue_state_.majority_size_ - 1;
+  if (num_remote_grants == 0) {
+    return MonoTime::Max();
+  }
+  vector<MonoTime> grant_times;
+  for (const PeersMap::value_type& entry : peers_map_) {
+    if (entry.first != local_peer_pb_.permanent_uuid() &&
+        IsRaftConfigVoter(entry.first, *queue_state_.active_config)) {
+      grant_times.push_back(entry.second->lease_grant_time);
+    }
+  }
+  if (grant_times.size() < static_cast<size_t>(num_remote_grants)) {
+    return MonoTime::Min();
+  }
+  std::nth_element(grant_times.begin(), grant_times.begin() + num_remote_grants - 1,
+                   grant_times.end(), std::greater<MonoTime>());
+  return grant_times[num_remote_grants - 1];
+}
+
 int64_t PeerMessageQueue::GetMajorityReplicatedIndexForTests() const {
   std::lock_guard<simple_spinlock> lock(queue_lock_);
   return queue_state_.majority_replicated_index;
@@ -1150,6 +1256,25 @@ void PeerMessageQueue::NotifyObserversOfFailedFollowerTask(const string& uuid,
   }
 }
 
+void PeerMessageQueue::NotifyObserversOfPeerToStartElection(const string& peer_uuid) {
+  WARN_NOT_OK(raft_pool_observers_token_->SubmitClosure(
+      Bind(&PeerMessageQueue::NotifyObserversOfPeerToStartElectionTask,
+           Unretained(this), peer_uuid)),
+              LogPrefixUnlocked() + "Unable to notify RaftConsensus of caught up successor.");
+}
+
+void PeerMessageQueue::NotifyObserversOfPeerToStartElectionTask(const string& peer_uuid) {
+  MAYBE_INJECT_RANDOM_LATENCY(FLAGS_consensus_inject_latency_ms_in_notifications);
+  std::vector<PeerMessageQueueObserver*> observers_copy;
+  {
+    std::lock_guard<simple_spinlock> lock(queue_lock_);
+    observers_copy = observers_;
+  }
+  for (PeerMessageQueueObserver* observer : observers_copy) {
+    observer->NotifyPeerToStartElection(peer_uuid);
+  }
+}
+
 PeerMessageQueue::~PeerMessageQueue() {
   Close();
 }
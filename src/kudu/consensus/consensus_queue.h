@@ -107,9 +107,10 @@ const char* PeerStatusToString(PeerStatus p);
 // This also takes care of pushing requests to peers as new operations are
 // added, and notifying RaftConsensus when the commit index advances.
 //
-// TODO(todd): Right now this class is able to track one outstanding operation
-// per peer. If we want to have more than one outstanding RPC we need to
-// modify it.
+// The queue only tracks the state of each peer as of the last response it
+// processed from it. Peers with several requests in flight (see
+// PipelinedRequestForPeer()) must hand their responses to the queue in the
+// order the requests were sent.
 class PeerMessageQueue {
  public:
   struct TrackedPeer {
@@ -120,6 +121,7 @@ class PeerMessageQueue {
           last_known_committed_index(MinimumOpId().index()),
           last_exchange_status(PeerStatus::NEW),
           last_communication_time(MonoTime::Now()),
+          lease_grant_time(MonoTime::Min()),
           last_seen_term_(0) {}
 
     TrackedPeer() = default;
@@ -165,6 +167,13 @@ class PeerMessageQueue {
     // successful communication ever took place.
     MonoTime last_communication_time;
 
+    // The time at which the leader sent the last request that the peer
+    // accepted in the current term. Having accepted it, the peer withholds
+    // its vote from other candidates for the minimum election timeout since
+    // it received the request, so this is a lower bound on the start of the
+    // leader lease granted by the peer.
+    MonoTime lease_grant_time;
+
     // Throttler for how often we will log status messages pertaining to this
     // peer (eg when it is lagging, etc).
     logging::LogThrottler status_log_throttler;
@@ -205,6 +214,15 @@ class PeerMessageQueue {
   // index or notify observers of its advancement.
   void SetNonLeaderMode();
 
+  // Starts watching for a successor to the local leader: the first time the
+  // peer with UUID 'successor_uuid' (or, if unset, any voter other than the
+  // leader) is found to have received every operation appended to the queue,
+  // observers are notified with NotifyPeerToStartElection() and the watch ends.
+  void BeginWatchForSuccessor(const boost::optional<std::string>& successor_uuid);
+
+  // Stops watching for a successor, if the queue was.
+  void EndWatchForSuccessor();
+
   // Makes the queue track this peer.
   void TrackPeer(const std::string& uuid);
 
@@ -263,6 +281,20 @@ class PeerMessageQueue {
                         std::vector<ReplicateRefPtr>* msg_refs,
                         bool* needs_tablet_copy);
 
+  // Like RequestForPeer(), but assembles a request to be pipelined behind the
+  // requests already in flight to the peer, whose last op had index
+  // 'last_sent_index'. The request starts right after that op instead of at
+  // the peer's next index.
+  //
+  // Returns Status::IllegalState if the last exchange with the peer wasn't
+  // successful, in which case the peer must wait for the responses to its
+  // requests in flight, since it may have to start over from another index.
+  // The request may contain no ops, if none follow 'last_sent_index' yet.
+  Status PipelinedRequestForPeer(const std::string& uuid,
+                                 int64_t last_sent_index,
+                                 ConsensusRequestPB* request,
+                                 std::vector<ReplicateRefPtr>* msg_refs);
+
   // Fill in a StartTabletCopyRequest for the specified peer.
   // If that peer should not initiate Tablet Copy, returns a non-OK status.
   // On success, also internally resets peer->needs_tablet_copy to false.
@@ -311,6 +343,17 @@ class PeerMessageQueue {
   // Return true if the committed index falls within the current term.
   bool IsCommittedIndexInCurrentTerm() const;
 
+  // Records that the peer with 'peer_uuid' accepted a request sent at
+  // 'send_time' by this leader, renewing the lease it grants the leader.
+  void LeaseGrantedByPeer(const std::string& peer_uuid, MonoTime send_time);
+
+  // Returns the latest time since which a majority of the voters, including
+  // the local peer, have granted this leader its lease, MonoTime::Max() if
+  // the local peer is a majority on its own, or MonoTime::Min() if a majority
+  // never granted the lease in the current term or the queue is not in
+  // leader mode.
+  MonoTime GetMajorityLeaseGrantTime() const;
+
   // Returns the current majority replicated index, for tests.
   int64_t GetMajorityReplicatedIndexForTests() const;
 
@@ -411,6 +454,14 @@ class PeerMessageQueue {
     std::string ToString() const;
   };
 
+  // Implements RequestForPeer() and, if 'last_sent_index' is set,
+  // PipelinedRequestForPeer().
+  Status AssembleRequestForPeer(const std::string& uuid,
+                                boost::optional<int64_t> last_sent_index,
+                                ConsensusRequestPB* request,
+                                std::vector<ReplicateRefPtr>* msg_refs,
+                                bool* needs_tablet_copy);
+
   // Returns true iff given 'desired_op' is found in the local WAL.
   // If the op is not found, returns false.
   // If the log cache returns some error other than NotFound, crashes with a
@@ -434,6 +485,9 @@ class PeerMessageQueue {
                                            int64_t term,
                                            const std::string& reason);
 
+  void NotifyObserversOfPeerToStartElection(const std::string& peer_uuid);
+  void NotifyObserversOfPeerToStartElectionTask(const std::string& peer_uuid);
+
   typedef std::unordered_map<std::string, TrackedPeer*> PeersMap;
 
   std::string ToStringUnlocked() const;
@@ -488,6 +542,11 @@ class PeerMessageQueue {
 
   QueueState queue_state_;
 
+  // Whether the queue is watching for a successor to the local leader, and
+  // the UUID of the designated successor, if any. Protected by 'queue_lock_'.
+  bool successor_watch_in_progress_ = false;
+  boost::optional<std::string> designated_successor_uuid_;
+
   // The currently tracked peers.
   PeersMap peers_map_;
   mutable simple_spinlock queue_lock_; // TODO: rename
@@ -520,6 +579,10 @@ class PeerMessageQueueObserver {
                                     int64_t term,
                                     const std::string& reason) = 0;
 
+  // Notify the observer that the peer with UUID 'peer_uuid' has received all
+  // the operations of the leader and should be asked to start an election.
+  virtual void NotifyPeerToStartElection(const std::string& peer_uuid) = 0;
+
   virtual ~PeerMessageQueueObserver() {}
 };
 
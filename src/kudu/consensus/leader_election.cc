@@ -28,6 +28,7 @@
 #include "kudu/common/wire_protocol.h"
 #include "kudu/consensus/consensus_peers.h"
 #include "kudu/consensus/metadata.pb.h"
+#include "kudu/consensus/quorum_util.h"
 #include "kudu/gutil/bind.h"
 #include "kudu/gutil/callback.h"
 #include "kudu/gutil/map-util.h"
@@ -169,7 +170,7 @@ LeaderElection::LeaderElection(const RaftConfigPB& config,
                         pb_util::SecureShortDebugString(config));
       continue;
     }
-    if (peer.member_type() != RaftPeerPB::VOTER) {
+    if (!IsVoterMemberType(peer.member_type())) {
       continue;
     }
     other_voter_uuids_.push_back(peer.permanent_uuid());
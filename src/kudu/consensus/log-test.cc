@@ -54,6 +54,7 @@
 #include "kudu/util/compression/compression.pb.h"
 #include "kudu/util/env.h"
 #include "kudu/util/metrics.h"
+#include "kudu/util/path_util.h"
 #include "kudu/util/random.h"
 #include "kudu/util/status.h"
 #include "kudu/util/stopwatch.h"
@@ -65,6 +66,8 @@ DEFINE_int32(num_batches, 10000,
 
 DECLARE_int32(log_min_segments_to_retain);
 DECLARE_int32(log_max_segments_to_retain);
+DECLARE_int32(log_max_recycled_segments);
+DECLARE_int32(log_append_shared_pool_threads);
 DECLARE_double(log_inject_io_error_on_preallocate_fraction);
 DECLARE_int64(fs_wal_dir_reserved_bytes);
 DECLARE_int64(disk_reserved_bytes_free_for_testing);
@@ -1127,6 +1130,72 @@ TEST_F(LogTest, TestDiskSpaceCheck) {
   // detect that we are past the preallocation limit.
 }
 
+// Test that garbage collected segments are written over by new segments, and
+// that the entries and footers left over from their earlier use are ignored.
+TEST_F(LogTest, TestRecycledSegments) {
+  FLAGS_log_compression_codec = "none";
+  FLAGS_log_max_recycled_segments = 1;
+  ASSERT_OK(BuildLog());
+  const string log_dir = JoinPathSegments(fs_manager_->GetWalsRootDir(), kTestTablet);
+  auto count_recycled_files = [&]() {
+    vector<string> files;
+    CHECK_OK(env_->GetChildren(log_dir, &files));
+    return std::count_if(files.begin(), files.end(), [](const string& f) {
+      return f.find("recycledsegment") != string::npos;
+    });
+  };
+
+  vector<LogAnchor*> anchors;
+  ElementDeleter deleter(&anchors);
+  OpId op_id = MakeOpId(1, 1);
+  ASSERT_OK(AppendMultiSegmentSequence(3, 10, &op_id, &anchors));
+
+  // GC the first two segments: only one of them is kept to be recycled.
+  ASSERT_OK(log_anchor_registry_->Unregister(anchors[0]));
+  ASSERT_OK(log_anchor_registry_->Unregister(anchors[1]));
+  RetentionIndexes retention;
+  ASSERT_OK(log_anchor_registry_->GetEarliestRegisteredLogIndex(&retention.for_durability));
+  int num_gced_segments;
+  ASSERT_OK(log_->GC(retention, &num_gced_segments));
+  ASSERT_EQ(2, num_gced_segments);
+  NO_FATALS(CheckRightNumberOfSegmentFiles(1));
+  ASSERT_EQ(1, count_recycled_files());
+
+  // The next segment writes over the recycled one, with fewer entries than it
+  // held.
+  ASSERT_OK(RollLog());
+  ASSERT_EQ(0, count_recycled_files());
+  ASSERT_OK(AppendNoOps(&op_id, 2));
+  const string path = log_->ActiveSegmentPathForTests();
+
+  // Reading the segment as after a crash finds the new entries only, despite
+  // the entries and the footer of the earlier segment which follow them.
+  {
+    scoped_refptr<ReadableLogSegment> segment;
+    ASSERT_OK(ReadableLogSegment::Open(env_, path, &segment));
+    ASSERT_EQ(1, segment->header().generation());
+    ASSERT_FALSE(segment->HasFooter());
+    vector<LogEntryPB*> entries;
+    ElementDeleter entries_deleter(&entries);
+    ASSERT_OK(segment->ReadEntries(&entries));
+    ASSERT_EQ(2, entries.size());
+  }
+
+  // Once closed, the segment has a footer of its own generation.
+  ASSERT_OK(log_->Close());
+  {
+    scoped_refptr<ReadableLogSegment> segment;
+    ASSERT_OK(ReadableLogSegment::Open(env_, path, &segment));
+    ASSERT_TRUE(segment->HasFooter());
+    ASSERT_EQ(1, segment->footer().generation());
+    ASSERT_EQ(2, segment->footer().num_entries());
+    vector<LogEntryPB*> entries;
+    ElementDeleter entries_deleter(&entries);
+    ASSERT_OK(segment->ReadEntries(&entries));
+    ASSERT_EQ(2, entries.size());
+  }
+}
+
 // Test that the append thread shuts itself down after it's idle.
 TEST_F(LogTest, TestAutoStopIdleAppendThread) {
   ASSERT_OK(BuildLog());
@@ -1146,6 +1215,31 @@ TEST_F(LogTest, TestAutoStopIdleAppendThread) {
     });
 }
 
+// Test that logs appending on the shared pool give up their thread as soon as
+// their queue is empty, and that what they appended is durable. The log
+// appends more groups than a task of the shared pool may before yielding.
+TEST_F(LogTest, TestSharedAppendPool) {
+  FLAGS_log_compression_codec = "none";
+  FLAGS_log_append_shared_pool_threads = 2;
+  ASSERT_OK(BuildLog());
+  OpId opid = MakeOpId(1, 1);
+  for (int i = 0; i < 50; i++) {
+    ASSERT_OK(AppendNoOpsToLogSync(clock_, log_.get(), &opid, 2));
+  }
+  ASSERT_EVENTUALLY([&]() {
+      ASSERT_FALSE(log_->append_thread_active_for_tests());
+    });
+  const string path = log_->ActiveSegmentPathForTests();
+  ASSERT_OK(log_->Close());
+
+  scoped_refptr<ReadableLogSegment> segment;
+  ASSERT_OK(ReadableLogSegment::Open(env_, path, &segment));
+  vector<LogEntryPB*> entries;
+  ElementDeleter entries_deleter(&entries);
+  ASSERT_OK(segment->ReadEntries(&entries));
+  ASSERT_EQ(100, entries.size());
+}
+
 // Test that Log::TotalSize() captures creation, addition, and deletion of log segments.
 TEST_P(LogTestOptionalCompression, TestTotalSize) {
   // Build a log. There is an active segment, so on-disk size should be positive.
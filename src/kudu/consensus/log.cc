@@ -19,6 +19,7 @@
 
 #include <cerrno>
 #include <cstdint>
+#include <deque>
 #include <memory>
 #include <mutex>
 #include <ostream>
@@ -28,6 +29,7 @@
 #include <gflags/gflags.h>
 
 #include "kudu/common/wire_protocol.h"
+#include "kudu/consensus/log_group_syncer.h"
 #include "kudu/consensus/log_index.h"
 #include "kudu/consensus/log_metrics.h"
 #include "kudu/consensus/log_reader.h"
@@ -39,11 +41,13 @@
 #include "kudu/gutil/dynamic_annotations.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/ref_counted.h"
+#include "kudu/gutil/singleton.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/gutil/walltime.h"
 #include "kudu/util/async_util.h"
 #include "kudu/util/compression/compression.pb.h"
 #include "kudu/util/compression/compression_codec.h"
+#include "kudu/util/condition_variable.h"
 #include "kudu/util/debug/trace_event.h"
 #include "kudu/util/env.h"
 #include "kudu/util/env_util.h"
@@ -53,8 +57,10 @@
 #include "kudu/util/logging.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/monotime.h"
+#include "kudu/util/mutex.h"
 #include "kudu/util/path_util.h"
 #include "kudu/util/pb_util.h"
+#include "kudu/util/probes.h"
 #include "kudu/util/random.h"
 #include "kudu/util/scoped_cleanup.h"
 #include "kudu/util/stopwatch.h"
@@ -91,12 +97,38 @@ DEFINE_int32(log_thread_idle_threshold_ms, 1000,
 TAG_FLAG(log_thread_idle_threshold_ms, experimental);
 TAG_FLAG(log_thread_idle_threshold_ms, hidden);
 
+DEFINE_int32(log_append_shared_pool_threads, 0,
+             "If positive, the logs of all the tablets on this server append on a "
+             "shared pool of this many threads, and give up their thread as soon as "
+             "their queue is empty instead of after --log_thread_idle_threshold_ms. "
+             "This bounds the number of append threads on servers hosting many "
+             "tablets. If 0, each log appends on its own thread while it's active.");
+TAG_FLAG(log_append_shared_pool_threads, experimental);
+
+DEFINE_bool(log_group_sync, false,
+            "Whether the logs of all the tablets on this server coalesce their "
+            "fsyncs: while one group of logs is being synced, the logs which "
+            "request a sync queue up, and are then synced together by one of "
+            "them. Only relevant if --log_force_fsync_all is set.");
+TAG_FLAG(log_group_sync, experimental);
+
+DEFINE_bool(log_pipelined_sync, true,
+            "Whether the log syncs each group of appended entries in the "
+            "background, appending the next groups in the meantime. Only "
+            "relevant if --log_force_fsync_all is set.");
+TAG_FLAG(log_pipelined_sync, evolving);
+
 // Compression configuration.
 // -----------------------------
 DEFINE_string(log_compression_codec, "LZ4",
               "Codec to use for compressing WAL segments.");
 TAG_FLAG(log_compression_codec, experimental);
 
+DEFINE_int32(log_zstd_compression_level, 1,
+             "Compression level to use for WAL segments when --log_compression_codec "
+             "is ZSTD. Higher levels compress better but are slower to write.");
+TAG_FLAG(log_zstd_compression_level, experimental);
+
 // Fault/latency injection flags.
 // -----------------------------
 DEFINE_bool(log_inject_latency, false,
@@ -142,6 +174,17 @@ DEFINE_double(log_inject_io_error_on_preallocate_fraction, 0.0,
 TAG_FLAG(log_inject_io_error_on_preallocate_fraction, unsafe);
 TAG_FLAG(log_inject_io_error_on_preallocate_fraction, runtime);
 
+DEFINE_int32(log_max_recycled_segments, 0,
+             "Maximum number of garbage collected WAL segments of each tablet "
+             "whose files are kept around to be written over by new segments, "
+             "rather than deleted. Writing over the blocks of an old segment "
+             "spares the filesystem the allocation of new blocks, and the "
+             "metadata updates of their syncs, as a segment fills up. Recycled "
+             "segments can't be read by versions of Kudu which predate the "
+             "recycling. 0 disables the recycling.");
+TAG_FLAG(log_max_recycled_segments, experimental);
+TAG_FLAG(log_max_recycled_segments, runtime);
+
 DEFINE_int64(fs_wal_dir_reserved_bytes, -1,
              "Number of bytes to reserve on the log directory filesystem for "
              "non-Kudu usage. The default, which is represented by -1, is that "
@@ -178,6 +221,37 @@ using std::vector;
 using std::unique_ptr;
 using strings::Substitute;
 
+namespace {
+
+// Infix of the names of the files of recycled segments.
+const char kRecycledSegmentInfix[] = ".recycledsegment-";
+
+// How many groups a task of the shared append pool appends before giving up
+// its thread to the tasks of the other logs.
+const int kMaxGroupsPerSharedTask = 16;
+
+// The pool on which all the logs append with --log_append_shared_pool_threads.
+class SharedAppendPool {
+ public:
+  static ThreadPool* Get() {
+    return Singleton<SharedAppendPool>::get()->pool_.get();
+  }
+
+ private:
+  friend class Singleton<SharedAppendPool>;
+
+  SharedAppendPool() {
+    CHECK_OK(ThreadPoolBuilder("wal-append")
+             .set_min_threads(0)
+             .set_max_threads(FLAGS_log_append_shared_pool_threads)
+             .Build(&pool_));
+  }
+
+  gscoped_ptr<ThreadPool> pool_;
+};
+
+} // anonymous namespace
+
 // Manages the thread which drains groups of batches from the log's queue and
 // appends them to the underlying log instance.
 //
@@ -200,6 +274,18 @@ using strings::Substitute;
 //    ensure that it doesn't miss a concurrent wake-up. This is done in GoIdle().
 //
 // See the implementation comments in Wake() and GoIdle() for details.
+//
+// With --log_append_shared_pool_threads, the tasks are instead submitted to a
+// serial token of a pool shared by all the logs, and a task finishes as soon
+// as the queue is empty, so that idle logs don't hold on to shared threads.
+// A busy log also resubmits its task after appending a few groups, letting
+// the other logs' tasks run in between.
+//
+// When every append is synced, the sync of a group can be pipelined with the
+// appending of the next ones: once a group is appended, it's handed to a
+// second single-thread pool, which syncs the log and runs the group's
+// callbacks while the next groups are compressed and written. A sync which
+// starts after several groups were appended covers all of them.
 class Log::AppendThread {
  public:
   explicit AppendThread(Log* log);
@@ -222,7 +308,22 @@ class Log::AppendThread {
     return base::subtle::NoBarrier_Load(&worker_state_) == WORKER_ACTIVE;
   }
 
+  // Waits until all the groups handed to the sync pool have been synced and
+  // their callbacks have run. Must be called before the active segment is
+  // closed. A no-op if syncs aren't pipelined.
+  void WaitForPendingSyncs();
+
  private:
+  // A group of batches which has been appended to the log, but not synced.
+  struct PendingGroup {
+    vector<LogEntryBatch*> entry_batches;
+    bool needs_sync;
+  };
+
+  // The maximum number of appended groups waiting to be synced. Once reached,
+  // appending waits for the syncs to catch up.
+  static const size_t kMaxPendingGroups = 8;
+
   // The task submitted to the threadpool which collects batches from the queue
   // and appends them, until it determines that the queue is idle.
   void DoWork();
@@ -237,6 +338,13 @@ class Log::AppendThread {
   // LogEntryBatch* pointers.
   void HandleGroup(vector<LogEntryBatch*> entry_batches);
 
+  // Runs the callbacks of 'entry_batches' with 's', deleting them.
+  void FinishGroup(const vector<LogEntryBatch*>& entry_batches, const Status& s);
+
+  // The task submitted to sync_pool_, which syncs and finishes the pending
+  // groups until there are none left.
+  void SyncPendingGroups();
+
   string LogPrefix() const;
 
   Log* const log_;
@@ -252,36 +360,66 @@ class Log::AppendThread {
   Atomic32 worker_state_ = WORKER_STOPPED;
 
   // Pool with a single thread, which handles shutting down the thread
-  // when idle.
+  // when idle. Not set if the log appends on the shared pool.
   gscoped_ptr<ThreadPool> append_pool_;
+
+  // Token of the shared append pool. Only set if the log appends on it.
+  unique_ptr<ThreadPoolToken> append_token_;
+
+  // Pool with a single thread which syncs the appended groups. Only set if
+  // syncs are pipelined.
+  gscoped_ptr<ThreadPool> sync_pool_;
+
+  // Protects the members below, and signals changes to them.
+  Mutex pending_lock_;
+  ConditionVariable pending_cond_;
+  std::deque<PendingGroup> pending_groups_;
+  // Whether a SyncPendingGroups() task is queued or running on sync_pool_.
+  bool sync_task_active_ = false;
 };
 
 
 Log::AppendThread::AppendThread(Log *log)
-  : log_(log) {
+  : log_(log),
+    pending_cond_(&pending_lock_) {
 }
 
 Status Log::AppendThread::Init() {
-  DCHECK(!append_pool_) << "Already initialized";
+  DCHECK(!append_pool_ && !append_token_) << "Already initialized";
   VLOG_WITH_PREFIX(1) << "Starting log append thread";
-  RETURN_NOT_OK(ThreadPoolBuilder("wal-append")
-                .set_min_threads(0)
-                // Only need one thread since we'll only schedule one
-                // task at a time.
-                .set_max_threads(1)
-                // No need for keeping idle threads, since the task itself
-                // handles waiting for work while idle.
-                .set_idle_timeout(MonoDelta::FromSeconds(0))
-                .Build(&append_pool_));
+  if (FLAGS_log_append_shared_pool_threads > 0) {
+    append_token_ = SharedAppendPool::Get()->NewToken(ThreadPool::ExecutionMode::SERIAL);
+  } else {
+    RETURN_NOT_OK(ThreadPoolBuilder("wal-append")
+                  .set_min_threads(0)
+                  // Only need one thread since we'll only schedule one
+                  // task at a time.
+                  .set_max_threads(1)
+                  // No need for keeping idle threads, since the task itself
+                  // handles waiting for work while idle.
+                  .set_idle_timeout(MonoDelta::FromSeconds(0))
+                  .Build(&append_pool_));
+  }
+  if (log_->force_sync_all_ && FLAGS_log_pipelined_sync) {
+    RETURN_NOT_OK(ThreadPoolBuilder("wal-sync")
+                  .set_min_threads(0)
+                  .set_max_threads(1)
+                  .Build(&sync_pool_));
+  }
   return Status::OK();
 }
 
 void Log::AppendThread::Wake() {
-  DCHECK(append_pool_);
+  DCHECK(append_pool_ || append_token_);
   auto old_status = base::subtle::NoBarrier_CompareAndSwap(
       &worker_state_, WORKER_STOPPED, WORKER_ACTIVE);
   if (old_status == WORKER_STOPPED) {
-    CHECK_OK(append_pool_->SubmitClosure(Bind(&Log::AppendThread::DoWork, Unretained(this))));
+    Closure task = Bind(&Log::AppendThread::DoWork, Unretained(this));
+    if (append_token_) {
+      CHECK_OK(append_token_->SubmitClosure(std::move(task)));
+    } else {
+      CHECK_OK(append_pool_->SubmitClosure(std::move(task)));
+    }
   }
 }
 
@@ -328,9 +466,12 @@ bool Log::AppendThread::GoIdle() {
 void Log::AppendThread::DoWork() {
   DCHECK_EQ(ANNOTATE_UNPROTECTED_READ(worker_state_), WORKER_ACTIVE);
   VLOG_WITH_PREFIX(2) << "WAL Appender going active";
+  // On the shared pool, waiting for more work would hold up the other logs.
+  const MonoDelta idle_threshold = append_token_ ? MonoDelta::FromMilliseconds(0) :
+      MonoDelta::FromMilliseconds(FLAGS_log_thread_idle_threshold_ms);
+  int num_groups = 0;
   while (true) {
-    MonoTime deadline = MonoTime::Now() +
-        MonoDelta::FromMilliseconds(FLAGS_log_thread_idle_threshold_ms);
+    MonoTime deadline = MonoTime::Now() + idle_threshold;
     vector<LogEntryBatch*> entry_batches;
     Status s = log_->entry_queue()->BlockingDrainTo(&entry_batches, deadline);
     if (PREDICT_FALSE(s.IsAborted())) {
@@ -340,6 +481,11 @@ void Log::AppendThread::DoWork() {
       continue;
     }
     HandleGroup(std::move(entry_batches));
+    if (append_token_ && ++num_groups >= kMaxGroupsPerSharedTask) {
+      // Stay active, but queue up behind the tasks of the other logs.
+      CHECK_OK(append_token_->SubmitClosure(Bind(&Log::AppendThread::DoWork, Unretained(this))));
+      return;
+    }
   }
   VLOG_WITH_PREFIX(2) << "WAL Appender going idle";
 }
@@ -372,10 +518,66 @@ void Log::AppendThread::HandleGroup(vector<LogEntryBatch*> entry_batches) {
     }
   }
 
+  if (sync_pool_) {
+    MutexLock l(pending_lock_);
+    while (pending_groups_.size() >= kMaxPendingGroups) {
+      pending_cond_.Wait();
+    }
+    pending_groups_.push_back({ std::move(entry_batches), !is_all_commits });
+    if (!sync_task_active_) {
+      sync_task_active_ = true;
+      CHECK_OK(sync_pool_->SubmitClosure(
+          Bind(&Log::AppendThread::SyncPendingGroups, Unretained(this))));
+    }
+    return;
+  }
+
   Status s;
   if (!is_all_commits) {
     s = log_->Sync();
   }
+  FinishGroup(entry_batches, s);
+}
+
+void Log::AppendThread::SyncPendingGroups() {
+  while (true) {
+    std::deque<PendingGroup> groups;
+    {
+      MutexLock l(pending_lock_);
+      if (pending_groups_.empty()) {
+        sync_task_active_ = false;
+        pending_cond_.Broadcast();
+        return;
+      }
+      groups.swap(pending_groups_);
+      pending_cond_.Broadcast();
+    }
+    bool needs_sync = false;
+    for (const PendingGroup& group : groups) {
+      needs_sync |= group.needs_sync;
+    }
+    Status s;
+    if (needs_sync) {
+      s = log_->Sync();
+    }
+    for (const PendingGroup& group : groups) {
+      FinishGroup(group.entry_batches, s);
+    }
+  }
+}
+
+void Log::AppendThread::WaitForPendingSyncs() {
+  if (!sync_pool_) {
+    return;
+  }
+  MutexLock l(pending_lock_);
+  while (sync_task_active_) {
+    pending_cond_.Wait();
+  }
+}
+
+void Log::AppendThread::FinishGroup(const vector<LogEntryBatch*>& entry_batches,
+                                    const Status& s) {
   if (PREDICT_FALSE(!s.ok())) {
     LOG_WITH_PREFIX(ERROR) << "Error syncing log: " << s.ToString();
     for (LogEntryBatch* entry_batch : entry_batches) {
@@ -406,6 +608,14 @@ void Log::AppendThread::Shutdown() {
     append_pool_->Wait();
     append_pool_->Shutdown();
   }
+  if (append_token_) {
+    append_token_->Wait();
+    append_token_->Shutdown();
+  }
+  if (sync_pool_) {
+    sync_pool_->Wait();
+    sync_pool_->Shutdown();
+  }
 }
 
 string Log::AppendThread::LogPrefix() const {
@@ -463,6 +673,7 @@ Log::Log(LogOptions options, FsManager* fs_manager, string log_path,
       schema_(schema),
       schema_version_(schema_version),
       active_segment_sequence_number_(0),
+      next_segment_generation_(0),
       log_state_(kLogInitialized),
       max_segment_size_(options_.segment_size_mb * 1024 * 1024),
       entry_batch_queue_(FLAGS_group_commit_queue_size_bytes),
@@ -471,6 +682,7 @@ Log::Log(LogOptions options, FsManager* fs_manager, string log_path,
       sync_disabled_(false),
       allocation_state_(kAllocationNotStarted),
       codec_(nullptr),
+      group_syncer_(nullptr),
       metric_entity_(metric_entity),
       on_disk_size_(0) {
   CHECK_OK(ThreadPoolBuilder("log-alloc").set_max_threads(1).Build(&allocation_pool_));
@@ -487,7 +699,8 @@ Status Log::Init() {
   if (!FLAGS_log_compression_codec.empty()) {
     auto codec_type = GetCompressionCodecType(FLAGS_log_compression_codec);
     if (codec_type != NO_COMPRESSION) {
-      RETURN_NOT_OK_PREPEND(GetCompressionCodec(codec_type, &codec_),
+      RETURN_NOT_OK_PREPEND(GetCompressionCodec(codec_type, FLAGS_log_zstd_compression_level,
+                                                &codec_),
                             "could not instantiate compression codec");
     }
   }
@@ -501,6 +714,7 @@ Status Log::Init() {
                                 tablet_id_,
                                 metric_entity_.get(),
                                 &reader_));
+  RETURN_NOT_OK(DeleteRecycledSegments());
 
   // The case where we are continuing an existing log.
   // We must pick up where the previous WAL left off in terms of
@@ -514,6 +728,10 @@ Status Log::Init() {
     active_segment_sequence_number_ = segments.back()->header().sequence_number();
   }
 
+  if (force_sync_all_ && FLAGS_log_group_sync) {
+    group_syncer_ = LogGroupSyncer::GetOrCreate(fs_manager_->GetWalsRootDir());
+  }
+
   if (force_sync_all_) {
     KLOG_FIRST_N(INFO, 1) << LogPrefix() << "Log is configured to fsync() on all Append() calls";
   } else {
@@ -563,6 +781,8 @@ Status Log::RollOver() {
 
   DCHECK_EQ(allocation_state(), kAllocationFinished);
 
+  // The segment may still be synced in the background.
+  append_thread_->WaitForPendingSyncs();
   RETURN_NOT_OK(Sync());
   RETURN_NOT_OK(CloseCurrentSegment());
 
@@ -624,6 +844,25 @@ Status Log::AsyncAppendCommit(gscoped_ptr<consensus::CommitMsg> commit_msg,
   return Status::OK();
 }
 
+Status Log::AsyncAppendCommits(vector<unique_ptr<consensus::CommitMsg>> commit_msgs,
+                               const StatusCallback& callback) {
+  DCHECK(!commit_msgs.empty());
+  MAYBE_FAULT(FLAGS_fault_crash_before_append_commit);
+
+  unique_ptr<LogEntryBatchPB> batch_pb(new LogEntryBatchPB);
+  batch_pb->mutable_entry()->Reserve(commit_msgs.size());
+  for (auto& commit_msg : commit_msgs) {
+    LogEntryPB* entry = batch_pb->add_entry();
+    entry->set_type(COMMIT);
+    entry->set_allocated_commit(commit_msg.release());
+  }
+
+  unique_ptr<LogEntryBatch> entry_batch;
+  RETURN_NOT_OK(CreateBatchFromPB(COMMIT, std::move(batch_pb), &entry_batch));
+  AsyncAppend(std::move(entry_batch), callback);
+  return Status::OK();
+}
+
 Status Log::DoAppend(LogEntryBatch* entry_batch) {
   size_t num_entries = entry_batch->count();
   DCHECK_GT(num_entries, 0) << "Cannot call DoAppend() with zero entries reserved";
@@ -663,7 +902,10 @@ Status Log::DoAppend(LogEntryBatch* entry_batch) {
     SCOPED_LATENCY_METRIC(metrics_, append_latency);
     SCOPED_WATCH_STACK(500);
 
-    RETURN_NOT_OK(active_segment_->WriteEntryBatch(entry_batch_data, codec_));
+    KUDU_PROBE(log_append_start, tablet_id_.c_str(), entry_batch_bytes);
+    Status s = active_segment_->WriteEntryBatch(entry_batch_data, codec_);
+    KUDU_PROBE(log_append_done, tablet_id_.c_str(), entry_batch_bytes);
+    RETURN_NOT_OK(s);
 
     // Update the reader on how far it can read the active segment.
     reader_->UpdateLastSegmentOffset(active_segment_->written_offset());
@@ -741,7 +983,15 @@ Status Log::Sync() {
 
   if (force_sync_all_ && !sync_disabled_) {
     LOG_SLOW_EXECUTION(WARNING, 50, Substitute("$0Fsync log took a long time", LogPrefix())) {
-      RETURN_NOT_OK(active_segment_->Sync());
+      KUDU_PROBE(log_sync_start, tablet_id_.c_str());
+      Status s;
+      if (group_syncer_) {
+        s = group_syncer_->Sync([this]() { return active_segment_->Sync(); });
+      } else {
+        s = active_segment_->Sync();
+      }
+      KUDU_PROBE(log_sync_done, tablet_id_.c_str());
+      RETURN_NOT_OK(s);
 
       if (log_hooks_) {
         RETURN_NOT_OK_PREPEND(log_hooks_->PostSyncIfFsyncEnabled(),
@@ -853,8 +1103,14 @@ Status Log::GC(RetentionIndexes retention_indexes, int32_t* num_gced) {
                              segment->footer().min_replicate_index(),
                              segment->footer().max_replicate_index());
       }
-      LOG_WITH_PREFIX(INFO) << "Deleting log segment in path: " << segment->path() << ops_str;
-      RETURN_NOT_OK(fs_manager_->env()->DeleteFile(segment->path()));
+      bool recycled;
+      RETURN_NOT_OK(MaybeRecycleSegment(segment, &recycled));
+      if (recycled) {
+        LOG_WITH_PREFIX(INFO) << "Recycled log segment in path: " << segment->path() << ops_str;
+      } else {
+        LOG_WITH_PREFIX(INFO) << "Deleting log segment in path: " << segment->path() << ops_str;
+        RETURN_NOT_OK(fs_manager_->env()->DeleteFile(segment->path()));
+      }
       (*num_gced)++;
     }
 
@@ -997,22 +1253,83 @@ Status Log::PreAllocateNewSegment() {
 
   WritableFileOptions opts;
   opts.sync_on_close = force_sync_all_;
-  RETURN_NOT_OK(CreatePlaceholderSegment(opts, &next_segment_path_, &next_segment_file_));
+  bool have_recycled = false;
+  RecycledSegment recycled;
+  {
+    std::lock_guard<simple_spinlock> l(recycled_segments_lock_);
+    if (!recycled_segments_.empty()) {
+      recycled = std::move(recycled_segments_.back());
+      recycled_segments_.pop_back();
+      have_recycled = true;
+    }
+  }
+  uint64_t recycled_size = 0;
+  if (have_recycled) {
+    // Write over the recycled file from its beginning, its existing blocks
+    // standing for preallocated space.
+    RETURN_NOT_OK(fs_manager_->env()->GetFileSize(recycled.path, &recycled_size));
+    opts.mode = Env::OPEN_EXISTING;
+    opts.overwrite = true;
+    unique_ptr<WritableFile> segment_file;
+    RETURN_NOT_OK(fs_manager_->env()->NewWritableFile(opts, recycled.path, &segment_file));
+    next_segment_file_.reset(segment_file.release());
+    next_segment_path_ = recycled.path;
+    next_segment_generation_ = recycled.generation;
+    VLOG_WITH_PREFIX(1) << "Reusing recycled WAL segment " << next_segment_path_
+                        << " of generation " << next_segment_generation_;
+  } else {
+    RETURN_NOT_OK(CreatePlaceholderSegment(opts, &next_segment_path_, &next_segment_file_));
+    next_segment_generation_ = 0;
+  }
 
   MAYBE_RETURN_FAILURE(FLAGS_log_inject_io_error_on_preallocate_fraction,
                        Status::IOError("Injected IOError in Log::PreAllocateNewSegment()"));
 
-  if (options_.preallocate_segments) {
-    TRACE("Preallocating $0 byte segment in $1", max_segment_size_, next_segment_path_);
+  if (options_.preallocate_segments && recycled_size < max_segment_size_) {
+    const uint64_t size = max_segment_size_ - recycled_size;
+    TRACE("Preallocating $0 bytes of segment in $1", size, next_segment_path_);
     RETURN_NOT_OK(env_util::VerifySufficientDiskSpace(fs_manager_->env(),
                                                       next_segment_path_,
-                                                      max_segment_size_,
+                                                      size,
                                                       FLAGS_fs_wal_dir_reserved_bytes));
     // TODO (perf) zero the new segments -- this could result in
     // additional performance improvements.
-    RETURN_NOT_OK(next_segment_file_->PreAllocate(max_segment_size_));
+    RETURN_NOT_OK(next_segment_file_->PreAllocate(size));
+  }
+
+  return Status::OK();
+}
+
+Status Log::MaybeRecycleSegment(const scoped_refptr<ReadableLogSegment>& segment,
+                                bool* recycled) {
+  *recycled = false;
+  // A segment still referenced elsewhere, e.g. by a reader catching a peer
+  // up, must not be written over under its feet.
+  if (!segment->HasOneRef()) {
+    return Status::OK();
+  }
+  std::lock_guard<simple_spinlock> l(recycled_segments_lock_);
+  if (static_cast<int>(recycled_segments_.size()) >= FLAGS_log_max_recycled_segments) {
+    return Status::OK();
   }
+  // The file is renamed so that it's no longer taken for a segment of the log
+  // if the server restarts before it's written over.
+  string path = JoinPathSegments(log_dir_, Substitute("$0$1$2", kTmpInfix, kRecycledSegmentInfix,
+                                                      segment->header().sequence_number()));
+  RETURN_NOT_OK(fs_manager_->env()->RenameFile(segment->path(), path));
+  recycled_segments_.push_back({ std::move(path), segment->header().generation() + 1 });
+  *recycled = true;
+  return Status::OK();
+}
 
+Status Log::DeleteRecycledSegments() {
+  vector<string> children;
+  RETURN_NOT_OK(fs_manager_->env()->GetChildren(log_dir_, &children));
+  for (const string& child : children) {
+    if (child.find(kRecycledSegmentInfix) != string::npos) {
+      RETURN_NOT_OK(fs_manager_->env()->DeleteFile(JoinPathSegments(log_dir_, child)));
+    }
+  }
   return Status::OK();
 }
 
@@ -1042,6 +1359,10 @@ Status Log::SwitchToAllocatedSegment() {
   if (codec_) {
     header.set_compression_codec(codec_->type());
   }
+  if (next_segment_generation_ > 0) {
+    header.set_generation(next_segment_generation_);
+    header.add_incompatible_features(LogSegmentHeaderPB::RECYCLED_SEGMENT);
+  }
 
   // Set up the new footer. This will be maintained as the segment is written.
   footer_builder_.Clear();
@@ -63,6 +63,7 @@ struct LogEntryBatchLogicalSize;
 struct LogMetrics;
 struct RetentionIndexes;
 class LogEntryBatch;
+class LogGroupSyncer;
 class LogIndex;
 class LogReader;
 
@@ -116,6 +117,12 @@ class Log : public RefCountedThreadSafe<Log> {
   Status AsyncAppendCommit(gscoped_ptr<consensus::CommitMsg> commit_msg,
                            const StatusCallback& callback);
 
+  // Append the given commit messages as a single batch, asynchronously.
+  //
+  // Returns a bad status if the log is already shut down.
+  Status AsyncAppendCommits(std::vector<std::unique_ptr<consensus::CommitMsg>> commit_msgs,
+                            const StatusCallback& callback);
+
 
   // Blocks the current thread until all the entries in the log queue
   // are flushed and fsynced (if fsync of log entries is enabled).
@@ -292,9 +299,21 @@ class Log : public RefCountedThreadSafe<Log> {
   // disk as the header, and sets active_segment_ to point to this new segment.
   Status SwitchToAllocatedSegment();
 
-  // Preallocates the space for a new segment.
+  // Preallocates the space for a new segment, or takes the file of a
+  // recycled segment if any.
   Status PreAllocateNewSegment();
 
+  // Keeps the file of the garbage collected 'segment' around to be written
+  // over by a later segment, if --log_max_recycled_segments allows it. Sets
+  // 'recycled' to whether the file was kept, otherwise it's up to the caller
+  // to delete it.
+  Status MaybeRecycleSegment(const scoped_refptr<ReadableLogSegment>& segment,
+                             bool* recycled);
+
+  // Deletes the files of the recycled segments left over by an earlier
+  // instance of the log.
+  Status DeleteRecycledSegments();
+
   // Writes serialized contents of 'entry' to the log. Called inside
   // AppenderThread.
   Status DoAppend(LogEntryBatch* entry_batch);
@@ -356,6 +375,21 @@ class Log : public RefCountedThreadSafe<Log> {
   // The path for the next allocated segment.
   std::string next_segment_path_;
 
+  // The generation of the next allocated segment: 0 for a new file, or one
+  // more than the generation of the recycled segment whose file it reuses.
+  uint64_t next_segment_generation_;
+
+  // The file of a garbage collected segment, kept around to be written over.
+  struct RecycledSegment {
+    std::string path;
+    uint64_t generation;
+  };
+
+  // Lock to protect 'recycled_segments_', which is accessed both by GC and by
+  // the segment allocation thread.
+  simple_spinlock recycled_segments_lock_;
+  std::vector<RecycledSegment> recycled_segments_;
+
   // Lock to protect mutations to log_state_ and other shared state variables.
   mutable percpu_rwlock state_lock_;
 
@@ -403,6 +437,10 @@ class Log : public RefCountedThreadSafe<Log> {
   // The codec used to compress entries, or nullptr if not configured.
   const CompressionCodec* codec_;
 
+  // The syncer shared with the other logs of the server, through which the
+  // active segment is synced. Only set if fsyncs are coalesced across logs.
+  LogGroupSyncer* group_syncer_;
+
   scoped_refptr<MetricEntity> metric_entity_;
   gscoped_ptr<LogMetrics> metrics_;
 
@@ -62,6 +62,8 @@ using strings::Substitute;
 
 DECLARE_int32(log_cache_size_limit_mb);
 DECLARE_int32(global_log_cache_size_limit_mb);
+DECLARE_bool(consensus_ops_in_sidecars);
+DECLARE_int32(log_cache_read_ahead_bytes);
 
 METRIC_DECLARE_entity(tablet);
 
@@ -181,6 +183,43 @@ TEST_F(LogCacheTest, TestAppendAndGetMessages) {
 // even if that message is larger than the batch size. This ensures
 // that we don't get "stuck" in the case that a large message enters
 // the cache.
+// Test that the ops read from the cache are serialized if they're to be sent
+// in sidecars, and that the serialized ops are accounted for.
+TEST_F(LogCacheTest, TestSerializedOps) {
+  FLAGS_consensus_ops_in_sidecars = true;
+  ASSERT_OK(AppendReplicateMessagesToCache(1, 10));
+  int64_t size_unserialized = cache_->BytesUsed();
+  ASSERT_EQ(size_unserialized, cache_->metrics_.log_cache_size->value());
+  log_->WaitUntilAllFlushed();
+
+  vector<ReplicateRefPtr> messages;
+  OpId preceding;
+  ASSERT_OK(cache_->ReadOps(0, 8 * 1024 * 1024, &messages, &preceding));
+  ASSERT_EQ(10, messages.size());
+  for (const auto& msg : messages) {
+    ReplicateMsg parsed;
+    ASSERT_TRUE(parsed.ParseFromArray(msg->serialized().data(), msg->serialized().size()));
+    ASSERT_EQ(OpIdToString(msg->get()->id()), OpIdToString(parsed.id()));
+  }
+  ASSERT_GT(cache_->BytesUsed(), size_unserialized);
+  ASSERT_EQ(cache_->BytesUsed(), cache_->metrics_.log_cache_size->value());
+
+  // Ops read again aren't serialized again.
+  int64_t size_serialized = cache_->BytesUsed();
+  messages.clear();
+  ASSERT_OK(cache_->ReadOps(5, 8 * 1024 * 1024, &messages, &preceding));
+  ASSERT_EQ(5, messages.size());
+  ASSERT_EQ(size_serialized, cache_->BytesUsed());
+
+  // Ops read from the log are serialized too.
+  messages.clear();
+  cache_->EvictThroughOp(10);
+  ASSERT_EQ(0, cache_->BytesUsed());
+  ASSERT_OK(cache_->ReadOps(0, 8 * 1024 * 1024, &messages, &preceding));
+  ASSERT_EQ(10, messages.size());
+  ASSERT_FALSE(messages[0]->serialized().empty());
+}
+
 TEST_F(LogCacheTest, TestAlwaysYieldsAtLeastOneMessage) {
   // generate a 2MB dummy payload
   const int kPayloadSize = 2 * 1024 * 1024;
@@ -202,6 +241,48 @@ TEST_F(LogCacheTest, TestAlwaysYieldsAtLeastOneMessage) {
   ASSERT_EQ(1, messages.size());
 }
 
+// Tests that the ops which follow those a peer had to read from disk are read
+// ahead on its behalf, and that its next batches are served from them.
+TEST_F(LogCacheTest, TestReadAheadForLaggingPeer) {
+  const int kPayloadSize = 1024;
+  const int kBatchSize = 16 * 1024;
+  FLAGS_log_cache_read_ahead_bytes = 32 * 1024;
+  ASSERT_OK(AppendReplicateMessagesToCache(1, 200, kPayloadSize));
+  log_->WaitUntilAllFlushed();
+  cache_->EvictThroughOp(200);
+
+  // Catch a peer up from the beginning of the log.
+  int64_t last_index = 0;
+  int num_batches = 0;
+  int first_batch_size = 0;
+  while (last_index < 200) {
+    vector<ReplicateRefPtr> messages;
+    OpId preceding;
+    ASSERT_OK(cache_->ReadOps("peer", last_index, kBatchSize, &messages, &preceding));
+    ASSERT_EQ(last_index, preceding.index());
+    ASSERT_FALSE(messages.empty());
+    for (const auto& msg : messages) {
+      ASSERT_EQ(++last_index, msg->get()->id().index());
+    }
+    if (num_batches++ == 0) {
+      first_batch_size = messages.size();
+    }
+  }
+  // Only the first batch was read from disk by the peer's own call.
+  ASSERT_GT(num_batches, 2);
+  ASSERT_EQ(200 - first_batch_size, cache_->metrics_.log_cache_read_ahead_ops->value());
+
+  // A peer which jumps elsewhere in the log doesn't use its stale buffer.
+  vector<ReplicateRefPtr> messages;
+  OpId preceding;
+  ASSERT_OK(cache_->ReadOps("other", 0, kBatchSize, &messages, &preceding));
+  messages.clear();
+  ASSERT_OK(cache_->ReadOps("other", 100, kBatchSize, &messages, &preceding));
+  ASSERT_FALSE(messages.empty());
+  ASSERT_EQ(101, messages[0]->get()->id().index());
+  cache_->DropReadAhead("other");
+}
+
 // Tests that the cache returns Status::NotFound() if queried for messages after an
 // index that is higher than it's latest, returns an empty set of messages when queried for
 // the the last index and returns all messages when queried for MinimumOpId().
@@ -18,6 +18,7 @@
 #include "kudu/consensus/log_cache.h"
 
 #include <map>
+#include <memory>
 #include <mutex>
 #include <ostream>
 #include <string>
@@ -47,6 +48,7 @@
 #include "kudu/util/mem_tracker.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/pb_util.h"
+#include "kudu/util/threadpool.h"
 
 DEFINE_int32(log_cache_size_limit_mb, 128,
              "The total per-tablet size of consensus entries which may be kept in memory. "
@@ -60,7 +62,23 @@ DEFINE_int32(global_log_cache_size_limit_mb, 1024,
              "caching log entries across all tablets is kept under this threshold.");
 TAG_FLAG(global_log_cache_size_limit_mb, advanced);
 
+DEFINE_bool(consensus_ops_in_sidecars, false,
+            "Whether leaders send the ops replicated to followers as RPC sidecars. Ops are "
+            "then serialized once, when first read from the log cache, instead of once "
+            "for every request sent with them. Should only be enabled once all the servers "
+            "of the cluster support it.");
+TAG_FLAG(consensus_ops_in_sidecars, experimental);
+
+DEFINE_int32(log_cache_read_ahead_bytes, 4 * 1024 * 1024,
+             "Size of the ops which are read ahead from the WAL in the background "
+             "on behalf of a peer whose ops had to be read from disk, so that the "
+             "next batch of ops sent to a lagging peer is already in memory. "
+             "0 disables the read-ahead.");
+TAG_FLAG(log_cache_read_ahead_bytes, experimental);
+TAG_FLAG(log_cache_read_ahead_bytes, runtime);
+
 using kudu::pb_util::SecureShortDebugString;
+using std::shared_ptr;
 using std::string;
 using std::vector;
 using strings::Substitute;
@@ -74,6 +92,10 @@ METRIC_DEFINE_gauge_int64(tablet, log_cache_num_ops, "Log Cache Operation Count"
 METRIC_DEFINE_gauge_int64(tablet, log_cache_size, "Log Cache Memory Usage",
                           MetricUnit::kBytes,
                           "Amount of memory in use for caching the local log.");
+METRIC_DEFINE_counter(tablet, log_cache_read_ahead_ops, "Log Cache Read-Ahead Operations",
+                      MetricUnit::kOperations,
+                      "Number of operations sent to peers from the buffers of operations "
+                      "read ahead from the log on their behalf.");
 
 static const char kParentMemTrackerId[] = "log_cache";
 
@@ -105,6 +127,8 @@ LogCache::LogCache(const scoped_refptr<MetricEntity>& metric_entity,
                                      local_uuid, tablet_id),
       parent_tracker_);
 
+  CHECK_OK(ThreadPoolBuilder("log-readahead").set_max_threads(1).Build(&read_ahead_pool_));
+
   // Put a fake message at index 0, since this simplifies a lot of our
   // code paths elsewhere.
   auto zero_op = new ReplicateMsg();
@@ -113,6 +137,7 @@ LogCache::LogCache(const scoped_refptr<MetricEntity>& metric_entity,
 }
 
 LogCache::~LogCache() {
+  read_ahead_pool_->Shutdown();
   tracker_->Release(tracker_->consumption());
   cache_.clear();
 }
@@ -136,6 +161,9 @@ void LogCache::TruncateOpsAfterUnlocked(int64_t index) {
   // to the last index, i.e. we're overwriting.
   CHECK_LE(first_to_truncate, next_sequential_op_index_);
 
+  // The buffers may have been read ahead before the truncation.
+  read_ahead_buffers_.clear();
+
   // Now remove the overwritten operations.
   for (int64_t i = first_to_truncate; i < next_sequential_op_index_; ++i) {
     ReplicateRefPtr msg = EraseKeyReturnValuePtr(&cache_, i);
@@ -165,7 +193,7 @@ Status LogCache::AppendOperations(const vector<ReplicateRefPtr>& msgs,
 
   int64_t mem_required = 0;
   for (const auto& msg : msgs) {
-    mem_required += msg->get()->SpaceUsed();
+    mem_required += msg->SpaceUsed();
   }
 
   // Try to consume the memory. If it can't be consumed, we may need to evict.
@@ -292,6 +320,14 @@ Status LogCache::ReadOps(int64_t after_op_index,
                          int max_size_bytes,
                          std::vector<ReplicateRefPtr>* messages,
                          OpId* preceding_op) {
+  return ReadOps("", after_op_index, max_size_bytes, messages, preceding_op);
+}
+
+Status LogCache::ReadOps(const string& peer_uuid,
+                         int64_t after_op_index,
+                         int max_size_bytes,
+                         std::vector<ReplicateRefPtr>* messages,
+                         OpId* preceding_op) {
   DCHECK_GE(after_op_index, 0);
   RETURN_NOT_OK(LookupOpId(after_op_index, preceding_op));
 
@@ -315,29 +351,72 @@ Status LogCache::ReadOps(int64_t after_op_index,
         up_to = iter->first - 1;
       }
 
+      // The peer's ops may have been read ahead already.
+      shared_ptr<ReadAheadBuffer> buffer;
+      if (!peer_uuid.empty()) {
+        buffer = EraseKeyReturnValuePtr(&read_ahead_buffers_, peer_uuid);
+      }
       l.unlock();
 
-      vector<ReplicateMsg*> raw_replicate_ptrs;
-      RETURN_NOT_OK_PREPEND(
-        log_->reader()->ReadReplicatesInRange(
-          next_index, up_to, remaining_space, &raw_replicate_ptrs),
-        Substitute("Failed to read ops $0..$1", next_index, up_to));
+      vector<ReplicateRefPtr> ops;
+      if (buffer && buffer->first_index == next_index) {
+        // If the read is still in flight, it's ahead of any read of our own.
+        buffer->done.Wait();
+        if (buffer->status.ok()) {
+          ops.swap(buffer->ops);
+        } else {
+          VLOG_WITH_PREFIX_UNLOCKED(1) << "Failed to read ahead ops from " << next_index
+                                       << ": " << buffer->status.ToString();
+        }
+      }
+      const bool from_buffer = !ops.empty();
+      if (!from_buffer) {
+        vector<ReplicateMsg*> raw_replicate_ptrs;
+        RETURN_NOT_OK_PREPEND(
+          log_->reader()->ReadReplicatesInRange(
+            next_index, up_to, remaining_space, &raw_replicate_ptrs),
+          Substitute("Failed to read ops $0..$1", next_index, up_to));
+        ops.reserve(raw_replicate_ptrs.size());
+        for (ReplicateMsg* msg : raw_replicate_ptrs) {
+          ops.push_back(make_scoped_refptr_replicate(msg));
+        }
+      }
       l.lock();
       VLOG_WITH_PREFIX_UNLOCKED(2)
-          << "Successfully read " << raw_replicate_ptrs.size() << " ops "
-          << "from disk (" << next_index << ".."
-          << (next_index + raw_replicate_ptrs.size() - 1) << ")";
-
-      for (ReplicateMsg* msg : raw_replicate_ptrs) {
-        CHECK_EQ(next_index, msg->id().index());
+          << "Successfully read " << ops.size() << " ops "
+          << "from " << (from_buffer ? "read-ahead buffer" : "disk")
+          << " (" << next_index << ".." << (next_index + ops.size() - 1) << ")";
+
+      size_t num_used = 0;
+      for (const ReplicateRefPtr& msg : ops) {
+        CHECK_EQ(next_index, msg->get()->id().index());
+        if (next_index > up_to) {
+          break;
+        }
 
-        remaining_space -= TotalByteSizeForMessage(*msg);
-        if (remaining_space > 0 || messages->empty()) {
-          messages->push_back(make_scoped_refptr_replicate(msg));
-          next_index++;
-        } else {
-          delete msg;
+        remaining_space -= TotalByteSizeForMessage(*msg->get());
+        if (remaining_space <= 0 && !messages->empty()) {
+          break;
         }
+        messages->push_back(msg);
+        if (FLAGS_consensus_ops_in_sidecars) {
+          messages->back()->Serialize();
+        }
+        next_index++;
+        num_used++;
+      }
+      if (from_buffer) {
+        metrics_.log_cache_read_ahead_ops->IncrementBy(num_used);
+      }
+
+      if (from_buffer && num_used < ops.size() && next_index <= up_to) {
+        // Keep the rest of the buffer for the peer's next call.
+        ops.erase(ops.begin(), ops.begin() + num_used);
+        buffer->first_index = next_index;
+        buffer->ops.swap(ops);
+        InsertIfNotPresent(&read_ahead_buffers_, peer_uuid, buffer);
+      } else {
+        ReadAheadUnlocked(peer_uuid, next_index, up_to);
       }
 
     } else {
@@ -354,6 +433,16 @@ Status LogCache::ReadOps(int64_t after_op_index,
           break;
         }
 
+        // The cached ops are serialized under the lock the first time they're
+        // read, before they may be shared with any peer.
+        if (FLAGS_consensus_ops_in_sidecars && msg->serialized().empty()) {
+          int64_t mem_before = msg->SpaceUsed();
+          msg->Serialize();
+          int64_t mem_serialized = msg->SpaceUsed() - mem_before;
+          tracker_->Consume(mem_serialized);
+          metrics_.log_cache_size->IncrementBy(mem_serialized);
+        }
+
         messages->push_back(msg);
         next_index++;
       }
@@ -363,6 +452,39 @@ Status LogCache::ReadOps(int64_t after_op_index,
 }
 
 
+void LogCache::ReadAheadUnlocked(const string& peer_uuid, int64_t first_index, int64_t up_to) {
+  DCHECK(lock_.is_locked());
+  const int64_t max_bytes = FLAGS_log_cache_read_ahead_bytes;
+  if (peer_uuid.empty() || max_bytes <= 0 || first_index > up_to ||
+      ContainsKey(read_ahead_buffers_, peer_uuid)) {
+    return;
+  }
+  shared_ptr<log::LogReader> reader = log_->reader();
+  if (!reader) {
+    return;
+  }
+  auto buffer = std::make_shared<ReadAheadBuffer>(first_index);
+  Status s = read_ahead_pool_->SubmitFunc([buffer, reader, up_to, max_bytes]() {
+    vector<ReplicateMsg*> raw_replicate_ptrs;
+    buffer->status = reader->ReadReplicatesInRange(
+        buffer->first_index, up_to, max_bytes, &raw_replicate_ptrs);
+    for (ReplicateMsg* msg : raw_replicate_ptrs) {
+      buffer->ops.push_back(make_scoped_refptr_replicate(msg));
+    }
+    buffer->done.CountDown();
+  });
+  if (!s.ok()) {
+    // The cache is being destroyed.
+    return;
+  }
+  InsertOrDie(&read_ahead_buffers_, peer_uuid, std::move(buffer));
+}
+
+void LogCache::DropReadAhead(const string& peer_uuid) {
+  std::lock_guard<simple_spinlock> l(lock_);
+  read_ahead_buffers_.erase(peer_uuid);
+}
+
 void LogCache::EvictThroughOp(int64_t index) {
   std::lock_guard<simple_spinlock> lock(lock_);
 
@@ -400,7 +522,7 @@ void LogCache::EvictSomeUnlocked(int64_t stop_after_index, int64_t bytes_to_evic
 
     VLOG_WITH_PREFIX_UNLOCKED(2) << "Evicting cache. Removing: " << msg->get()->id();
     AccountForMessageRemovalUnlocked(msg);
-    bytes_evicted += msg->get()->SpaceUsed();
+    bytes_evicted += msg->SpaceUsed();
     cache_.erase(iter++);
 
     if (bytes_evicted >= bytes_to_evict) {
@@ -411,8 +533,8 @@ void LogCache::EvictSomeUnlocked(int64_t stop_after_index, int64_t bytes_to_evic
 }
 
 void LogCache::AccountForMessageRemovalUnlocked(const ReplicateRefPtr& msg) {
-  tracker_->Release(msg->get()->SpaceUsed());
-  metrics_.log_cache_size->DecrementBy(msg->get()->SpaceUsed());
+  tracker_->Release(msg->SpaceUsed());
+  metrics_.log_cache_size->DecrementBy(msg->SpaceUsed());
   metrics_.log_cache_num_ops->Decrement();
 }
 
@@ -495,7 +617,8 @@ void LogCache::DumpToHtml(std::ostream& out) const {
   x.Instantiate(metric_entity, 0)
 LogCache::Metrics::Metrics(const scoped_refptr<MetricEntity>& metric_entity)
   : log_cache_num_ops(INSTANTIATE_METRIC(METRIC_log_cache_num_ops)),
-    log_cache_size(INSTANTIATE_METRIC(METRIC_log_cache_size)) {
+    log_cache_size(INSTANTIATE_METRIC(METRIC_log_cache_size)),
+    log_cache_read_ahead_ops(METRIC_log_cache_read_ahead_ops.Instantiate(metric_entity)) {
 }
 #undef INSTANTIATE_METRIC
 
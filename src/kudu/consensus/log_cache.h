@@ -22,13 +22,16 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <gtest/gtest_prod.h>
 
 #include "kudu/consensus/ref_counted_replicate.h"
+#include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/ref_counted.h"
+#include "kudu/util/countdown_latch.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/status.h"
@@ -37,6 +40,7 @@
 namespace kudu {
 
 class MemTracker;
+class ThreadPool;
 
 namespace log {
 class Log;
@@ -87,6 +91,19 @@ class LogCache {
                  std::vector<ReplicateRefPtr>* messages,
                  OpId* preceding_op);
 
+  // As above, but on behalf of the peer 'peer_uuid'. When ops have to be read
+  // from disk, the ops following them are read ahead in the background, up to
+  // --log_cache_read_ahead_bytes, into a staging buffer of the peer, so that
+  // its next call finds them in memory rather than reading them itself.
+  Status ReadOps(const std::string& peer_uuid,
+                 int64_t after_op_index,
+                 int max_size_bytes,
+                 std::vector<ReplicateRefPtr>* messages,
+                 OpId* preceding_op);
+
+  // Drops the read-ahead buffer of the peer 'peer_uuid', if any.
+  void DropReadAhead(const std::string& peer_uuid);
+
   // Append the operations into the log and the cache.
   // When the messages have completed writing into the on-disk log, fires 'callback'.
   //
@@ -145,10 +162,32 @@ class LogCache {
  private:
   FRIEND_TEST(LogCacheTest, TestAppendAndGetMessages);
   FRIEND_TEST(LogCacheTest, TestGlobalMemoryLimit);
+  FRIEND_TEST(LogCacheTest, TestReadAheadForLaggingPeer);
   FRIEND_TEST(LogCacheTest, TestReplaceMessages);
   FRIEND_TEST(LogCacheTest, TestTruncation);
   friend class LogCacheTest;
 
+  // The ops read ahead from disk on behalf of a peer.
+  struct ReadAheadBuffer {
+    explicit ReadAheadBuffer(int64_t first_index)
+        : first_index(first_index),
+          done(1) {
+    }
+
+    // The index of the first op of 'ops'.
+    int64_t first_index;
+
+    // Counted down once the read is done, and 'status' and 'ops' are set.
+    CountDownLatch done;
+
+    Status status;
+    std::vector<ReplicateRefPtr> ops;
+  };
+
+  // Starts reading ahead the ops in ['first_index', 'up_to'] on behalf of the
+  // peer 'peer_uuid', unless it already has a read-ahead buffer.
+  void ReadAheadUnlocked(const std::string& peer_uuid, int64_t first_index, int64_t up_to);
+
   // Try to evict the oldest operations from the queue, stopping either when
   // 'bytes_to_evict' bytes have been evicted, or the op with index
   // 'stop_after_index' has been evicted, whichever comes first.
@@ -210,6 +249,12 @@ class LogCache {
   // A MemTracker for this instance.
   std::shared_ptr<MemTracker> tracker_;
 
+  // The pool running the read-ahead reads.
+  gscoped_ptr<ThreadPool> read_ahead_pool_;
+
+  // The read-ahead buffers, by peer UUID. Protected by lock_.
+  std::unordered_map<std::string, std::shared_ptr<ReadAheadBuffer>> read_ahead_buffers_;
+
   struct Metrics {
     explicit Metrics(const scoped_refptr<MetricEntity>& metric_entity);
 
@@ -218,6 +263,9 @@ class LogCache {
 
     // Keeps track of the memory consumed by the cache, in bytes.
     scoped_refptr<AtomicGauge<int64_t> > log_cache_size;
+
+    // Counts the ops read from the read-ahead buffers of the peers.
+    scoped_refptr<Counter> log_cache_read_ahead_ops;
   };
   Metrics metrics_;
 
@@ -0,0 +1,108 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/consensus/log_group_syncer.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gflags/gflags_declare.h>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include "kudu/util/monotime.h"
+#include "kudu/util/status.h"
+#include "kudu/util/test_macros.h"
+#include "kudu/util/test_util.h"
+
+DECLARE_int32(log_group_sync_parallel_min_logs);
+
+using std::string;
+using std::thread;
+using std::vector;
+
+namespace kudu {
+namespace log {
+
+class LogGroupSyncerTest : public KuduTest {
+ protected:
+  // Runs 'kNumThreads' threads each syncing 'kSyncsPerThread' times through
+  // 'syncer', setting 'file_syncs' to the number of times a file was synced.
+  // The sync of the file of the first thread fails.
+  void RunSyncs(LogGroupSyncer* syncer, int* file_syncs) {
+    std::atomic<int> num_file_syncs(0);
+    vector<thread> threads;
+    for (int t = 0; t < kNumThreads; t++) {
+      threads.emplace_back([&, t]() {
+        auto sync_file = [&, t]() {
+          num_file_syncs++;
+          SleepFor(MonoDelta::FromMilliseconds(1));
+          return t == 0 ? Status::IOError("injected") : Status::OK();
+        };
+        for (int i = 0; i < kSyncsPerThread; i++) {
+          // Whichever thread synced the file, only the first thread sees the
+          // error.
+          Status s = syncer->Sync(sync_file);
+          if (t == 0) {
+            CHECK(s.IsIOError()) << s.ToString();
+          } else {
+            CHECK_OK(s);
+          }
+        }
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    *file_syncs = num_file_syncs;
+  }
+
+  static const int kNumThreads = 16;
+  static const int kSyncsPerThread = 50;
+};
+
+TEST_F(LogGroupSyncerTest, TestSmallGroupsSyncSerially) {
+  FLAGS_log_group_sync_parallel_min_logs = kNumThreads + 1;
+  LogGroupSyncer syncer;
+  int file_syncs;
+  NO_FATALS(RunSyncs(&syncer, &file_syncs));
+  ASSERT_EQ(kNumThreads * kSyncsPerThread, file_syncs);
+  ASSERT_EQ(0, syncer.num_parallel_group_syncs());
+}
+
+TEST_F(LogGroupSyncerTest, TestLargeGroupsSyncInParallel) {
+  FLAGS_log_group_sync_parallel_min_logs = 2;
+  LogGroupSyncer syncer;
+  int file_syncs;
+  NO_FATALS(RunSyncs(&syncer, &file_syncs));
+  // While one group is being synced, the other threads queue up behind it and
+  // have their files synced together. Every file is synced every time.
+  ASSERT_EQ(kNumThreads * kSyncsPerThread, file_syncs);
+  ASSERT_GT(syncer.num_parallel_group_syncs(), 0);
+}
+
+TEST_F(LogGroupSyncerTest, TestSharedPerDirectory) {
+  const string dir = GetTestDataDirectory();
+  LogGroupSyncer* syncer = LogGroupSyncer::GetOrCreate(dir);
+  ASSERT_EQ(syncer, LogGroupSyncer::GetOrCreate(dir));
+  ASSERT_NE(syncer, LogGroupSyncer::GetOrCreate(dir + "/other"));
+}
+
+} // namespace log
+} // namespace kudu
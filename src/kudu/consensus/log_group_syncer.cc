@@ -0,0 +1,150 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/consensus/log_group_syncer.h"
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "kudu/gutil/map-util.h"
+#include "kudu/gutil/port.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/threadpool.h"
+
+DEFINE_int32(log_group_sync_parallel_min_logs, 4,
+             "Minimum number of logs synced together for their files to be "
+             "synced in parallel rather than one after the other. Only used if "
+             "--log_group_sync is set.");
+TAG_FLAG(log_group_sync_parallel_min_logs, experimental);
+TAG_FLAG(log_group_sync_parallel_min_logs, runtime);
+
+DEFINE_int32(log_group_sync_max_threads, 8,
+             "Maximum number of threads syncing the files of a group of logs in "
+             "parallel, per WAL directory. Only used if --log_group_sync is set.");
+TAG_FLAG(log_group_sync_max_threads, experimental);
+
+using std::string;
+using std::unordered_map;
+using std::vector;
+
+namespace kudu {
+namespace log {
+
+struct LogGroupSyncer::Group {
+  struct Member {
+    const std::function<Status()>* sync_file;
+    Status status;
+  };
+  vector<Member> members;
+  bool done = false;
+};
+
+LogGroupSyncer::LogGroupSyncer()
+    : cond_(&lock_),
+      sync_in_progress_(false),
+      num_parallel_group_syncs_(0) {
+  CHECK_OK(ThreadPoolBuilder("wal-group-sync")
+           .set_min_threads(0)
+           .set_max_threads(FLAGS_log_group_sync_max_threads)
+           .Build(&sync_pool_));
+}
+
+LogGroupSyncer::~LogGroupSyncer() {
+  sync_pool_->Shutdown();
+}
+
+LogGroupSyncer* LogGroupSyncer::GetOrCreate(const string& dir) {
+  static simple_spinlock registry_lock;
+  static auto* syncers = new unordered_map<string, LogGroupSyncer*>();
+  std::lock_guard<simple_spinlock> l(registry_lock);
+  LogGroupSyncer** syncer = &LookupOrInsert(syncers, dir, nullptr);
+  if (*syncer == nullptr) {
+    *syncer = new LogGroupSyncer();
+  }
+  return *syncer;
+}
+
+Status LogGroupSyncer::Sync(const std::function<Status()>& sync_file) {
+  MutexLock l(lock_);
+  if (!pending_group_) {
+    pending_group_ = std::make_shared<Group>();
+  }
+  std::shared_ptr<Group> group = pending_group_;
+  const size_t idx = group->members.size();
+  group->members.push_back({ &sync_file, Status::OK() });
+
+  // Wait until either another thread synced the group, or the previous group
+  // is done and this thread is the first to notice, and so leads the group.
+  while (!group->done && sync_in_progress_) {
+    cond_.Wait();
+  }
+  if (group->done) {
+    return group->members[idx].status;
+  }
+
+  DCHECK_EQ(group.get(), pending_group_.get());
+  pending_group_.reset();
+  sync_in_progress_ = true;
+  l.Unlock();
+  SyncGroup(group.get());
+  l.Lock();
+  group->done = true;
+  sync_in_progress_ = false;
+  cond_.Broadcast();
+  return group->members[idx].status;
+}
+
+void LogGroupSyncer::SyncGroup(Group* group) {
+  // 'group' is not shared with any other thread until it's marked done. Only
+  // one group is synced at a time, so waiting for 'sync_pool_' to be idle
+  // waits for the syncs of this group only.
+  auto& members = group->members;
+  if (members.size() < static_cast<size_t>(FLAGS_log_group_sync_parallel_min_logs)) {
+    for (auto& member : members) {
+      member.status = (*member.sync_file)();
+    }
+    return;
+  }
+  // This thread syncs the first file itself. If a sync can't be submitted, the
+  // file is synced by this thread as well.
+  for (size_t i = 1; i < members.size(); i++) {
+    Group::Member* member = &members[i];
+    Status s = sync_pool_->SubmitFunc([member]() {
+        member->status = (*member->sync_file)();
+      });
+    if (PREDICT_FALSE(!s.ok())) {
+      member->status = (*member->sync_file)();
+    }
+  }
+  members[0].status = (*members[0].sync_file)();
+  sync_pool_->Wait();
+  MutexLock l(lock_);
+  num_parallel_group_syncs_++;
+}
+
+int64_t LogGroupSyncer::num_parallel_group_syncs() const {
+  MutexLock l(lock_);
+  return num_parallel_group_syncs_;
+}
+
+} // namespace log
+} // namespace kudu
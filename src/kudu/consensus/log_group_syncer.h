@@ -0,0 +1,98 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_CONSENSUS_LOG_GROUP_SYNCER_H
+#define KUDU_CONSENSUS_LOG_GROUP_SYNCER_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/util/condition_variable.h"
+#include "kudu/util/mutex.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+class ThreadPool;
+
+namespace log {
+
+// Coalesces the fsyncs of the logs of many tablets sharing a WAL directory.
+//
+// Each tablet's Log syncs its own segment file after every group commit. With
+// many active tablets on few WAL devices, those are a lot of small syncs, each
+// waited on by its own thread. Instead, the logs sync through the
+// LogGroupSyncer of their WAL directory: while one group of syncs is in
+// progress, the syncs requested by other logs queue up, and once it completes
+// the first of them leads the next group, syncing the segment file of each
+// member on its behalf.
+//
+// Large enough groups have their files synced in parallel by a pool of
+// threads, so that the device and the filesystem journal can merge them.
+// Each member still gets the status of the sync of its own file, and no
+// other data on the filesystem is written back.
+//
+// This class is thread-safe.
+class LogGroupSyncer {
+ public:
+  LogGroupSyncer();
+  ~LogGroupSyncer();
+
+  // Returns the syncer shared by all the logs under 'dir', creating it if
+  // needed. The syncer lives for the rest of the process.
+  static LogGroupSyncer* GetOrCreate(const std::string& dir);
+
+  // Makes the data written so far to a log durable by calling 'sync_file',
+  // which should sync that log's file, either from this thread or from the
+  // thread syncing the group this sync joins. Blocks until done, and returns
+  // the status of 'sync_file'.
+  Status Sync(const std::function<Status()>& sync_file);
+
+  // Returns the number of groups whose files were synced in parallel.
+  int64_t num_parallel_group_syncs() const;
+
+ private:
+  struct Group;
+
+  // Syncs the files of all the members of 'group', setting their statuses.
+  void SyncGroup(Group* group);
+
+  // The threads syncing the files of a group in parallel.
+  gscoped_ptr<ThreadPool> sync_pool_;
+
+  mutable Mutex lock_;
+  ConditionVariable cond_;
+
+  // The group which syncs requested from now on join. Only set if there are
+  // any such requests.
+  std::shared_ptr<Group> pending_group_;
+
+  // Whether a group is currently being synced.
+  bool sync_in_progress_;
+
+  int64_t num_parallel_group_syncs_;
+
+  DISALLOW_COPY_AND_ASSIGN(LogGroupSyncer);
+};
+
+} // namespace log
+} // namespace kudu
+
+#endif // KUDU_CONSENSUS_LOG_GROUP_SYNCER_H
@@ -97,6 +97,24 @@ const size_t kEntryHeaderSizeV2 = 16;
 // Maximum log segment header/footer size, in bytes (8 MB).
 const uint32_t kLogSegmentMaxHeaderOrFooterSize = 8 * 1024 * 1024;
 
+namespace {
+
+// Returns the CRC32C of the first 'len' bytes of the entry header 'data'. In
+// a recycled segment, the CRC is extended with the segment's generation, so
+// that the entries left over from earlier uses of the file don't pass for
+// entries of the current one.
+uint32_t EntryHeaderCrc(const uint8_t* data, size_t len, uint64_t generation) {
+  uint32_t crc = crc::Crc32c(data, len);
+  if (generation > 0) {
+    uint8_t buf[sizeof(generation)];
+    InlineEncodeFixed64(buf, generation);
+    crc = crc::Crc32c(buf, sizeof(buf), crc);
+  }
+  return crc;
+}
+
+} // anonymous namespace
+
 LogOptions::LogOptions()
 : segment_size_mb(FLAGS_log_segment_size_mb),
   force_fsync_all(FLAGS_log_force_fsync_all),
@@ -224,6 +242,12 @@ Status LogEntryReader::HandleReadError(const Status& s, EntryHeaderStatus status
     // "Corruption" so much as an expected EOF-type condition, so we'll just log
     // at VLOG(1) instead of INFO.
     VLOG(1) << "Reached preallocated space while reading log segment " << seg_->path_;
+  } else if (status_detail == EntryHeaderStatus::CRC_MISMATCH &&
+             seg_->header_.generation() > 0) {
+    // Likewise, the valid entries of a recycled segment are followed by the
+    // entries of an earlier use of the file.
+    VLOG(1) << "Reached the entries of an earlier generation of recycled log segment "
+            << seg_->path_;
   } else {
     LOG(INFO) << "Ignoring log segment corruption in " << seg_->path_ << " because "
               << "there are no log entries following the corrupted one. "
@@ -434,9 +458,11 @@ Status ReadableLogSegment::ReadHeader() {
                                                 header_size),
                         "Unable to parse protobuf");
 
-  if (header.incompatible_features_size() > 0) {
-    return Status::NotSupported("log segment uses a feature not supported by this version "
-                                "of Kudu");
+  for (int feature : header.incompatible_features()) {
+    if (feature != LogSegmentHeaderPB::RECYCLED_SEGMENT) {
+      return Status::NotSupported("log segment uses a feature not supported by this version "
+                                  "of Kudu");
+    }
   }
 
   header_.Swap(&header);
@@ -542,6 +568,13 @@ Status ReadableLogSegment::ReadFooter() {
                                                 footer_size),
                         "Unable to parse protobuf");
 
+  if (footer.generation() != header_.generation()) {
+    // The footer was left over from an earlier use of a recycled segment.
+    return Status::NotFound(Substitute("Footer not found. Found the footer of generation $0 "
+                                       "of a segment of generation $1",
+                                       footer.generation(), header_.generation()));
+  }
+
   footer_.Swap(&footer);
   return Status::OK();
 }
@@ -687,7 +720,7 @@ EntryHeaderStatus ReadableLogSegment::DecodeEntryHeader(
     header->msg_length = DecodeFixed32(&data[4]);
     header->msg_crc    = DecodeFixed32(&data[8]);
     header->header_crc = DecodeFixed32(&data[12]);
-    computed_header_crc = crc::Crc32c(&data[0], 12);
+    computed_header_crc = EntryHeaderCrc(&data[0], 12, header_.generation());
   } else {
     DCHECK_EQ(kEntryHeaderSizeV1, data.size());
     header->msg_length = DecodeFixed32(&data[0]);
@@ -813,14 +846,18 @@ Status WritableLogSegment::WriteFooterAndClose(const LogSegmentFooterPB& footer)
   DCHECK(!IsFooterWritten());
   DCHECK(footer.IsInitialized()) << footer.InitializationErrorString();
 
+  footer_.CopyFrom(footer);
+  if (header_.generation() > 0) {
+    footer_.set_generation(header_.generation());
+  }
+
   faststring buf;
-  pb_util::AppendToString(footer, &buf);
+  pb_util::AppendToString(footer_, &buf);
   buf.append(kLogSegmentFooterMagicString);
-  PutFixed32(&buf, footer.ByteSize());
+  PutFixed32(&buf, footer_.ByteSize());
 
   RETURN_NOT_OK_PREPEND(writable_file()->Append(Slice(buf)), "Could not write the footer");
 
-  footer_.CopyFrom(footer);
   is_footer_written_ = true;
 
   RETURN_NOT_OK(writable_file_->Close());
@@ -855,7 +892,8 @@ Status WritableLogSegment::WriteEntryBatch(const Slice& data,
   InlineEncodeFixed32(&header_buf[0], data_to_write.size());
   InlineEncodeFixed32(&header_buf[4], uncompressed_len);
   InlineEncodeFixed32(&header_buf[8], crc::Crc32c(data_to_write.data(), data_to_write.size()));
-  InlineEncodeFixed32(&header_buf[12], crc::Crc32c(&header_buf[0], kEntryHeaderSizeV2 - 4));
+  InlineEncodeFixed32(&header_buf[12], EntryHeaderCrc(&header_buf[0], kEntryHeaderSizeV2 - 4,
+                                                      header_.generation()));
 
   // Write the header to the file, followed by the batch data itself.
   Slice slices[2] = {
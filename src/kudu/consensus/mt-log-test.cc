@@ -68,6 +68,8 @@ DEFINE_bool(verify_log, true, "Whether to verify the log by reading it after the
 
 DECLARE_int32(log_thread_idle_threshold_ms);
 DECLARE_int32(log_inject_thread_lifecycle_latency_ms);
+DECLARE_bool(log_group_sync);
+DECLARE_bool(log_pipelined_sync);
 
 namespace kudu {
 namespace log {
@@ -244,6 +246,20 @@ TEST_F(MultiThreadedLogTest, TestAppends) {
   }
 }
 
+// Tests appends when every group is synced, with the syncs pipelined with
+// the appends and coalesced with the other logs of the server, while rolling
+// over segments frequently.
+TEST_F(MultiThreadedLogTest, TestAppendsWithPipelinedSyncs) {
+  FLAGS_log_pipelined_sync = true;
+  FLAGS_log_group_sync = true;
+  options_.force_fsync_all = true;
+  options_.segment_size_mb = 1;
+  ASSERT_OK(BuildLog());
+  ASSERT_NO_FATAL_FAILURE(Run());
+  ASSERT_OK(log_->Close());
+  ASSERT_NO_FATAL_FAILURE(VerifyLog());
+}
+
 // The lifecycle of the appender task starting and stopping is a bit complicated
 // (see Log::AppendThread::GoIdle for details). This injects some latency in key
 // points of that lifecycle to ensure that the different potential interleavings
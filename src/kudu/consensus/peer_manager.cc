@@ -108,6 +108,19 @@ void PeerManager::SignalRequest(bool force_if_queue_empty) {
   }
 }
 
+Status PeerManager::StartElection(const std::string& uuid) {
+  std::shared_ptr<Peer> peer;
+  {
+    std::lock_guard<simple_spinlock> lock(lock_);
+    peer = FindPtrOrNull(peers_, uuid);
+  }
+  if (!peer) {
+    return Status::NotFound("unknown peer");
+  }
+  peer->StartElection();
+  return Status::OK();
+}
+
 void PeerManager::Close() {
   {
     std::lock_guard<simple_spinlock> lock(lock_);
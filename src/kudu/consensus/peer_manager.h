@@ -62,6 +62,10 @@ class PeerManager {
   // Signals all peers of the current configuration that there is a new request pending.
   void SignalRequest(bool force_if_queue_empty = false);
 
+  // Asks the peer with the given UUID to start a leader election.
+  // Returns NotFound if no such peer is tracked.
+  Status StartElection(const std::string& uuid);
+
   // Closes all peers.
   void Close();
 
@@ -181,6 +181,9 @@ Status PendingRounds::AdvanceCommittedIndex(int64_t committed_index) {
 
     pending_txns_.erase(iter++);
     last_committed_op_id_ = round->id();
+    if (round->replicate_msg()->has_timestamp()) {
+      last_committed_timestamp_ = Timestamp(round->replicate_msg()->timestamp());
+    }
     time_manager_->AdvanceSafeTimeWithMessage(*round->replicate_msg());
     round->NotifyReplicationFinished(Status::OK());
   }
@@ -228,6 +231,10 @@ int64_t PendingRounds::GetCommittedIndex() const {
   return last_committed_op_id_.index();
 }
 
+Timestamp PendingRounds::GetLastCommittedTimestamp() const {
+  return last_committed_timestamp_;
+}
+
 int64_t PendingRounds::GetTermWithLastCommittedOp() const {
   return last_committed_op_id_.term();
 }
@@ -21,6 +21,7 @@
 #include <map>
 #include <string>
 
+#include "kudu/common/timestamp.h"
 #include "kudu/consensus/opid.pb.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/ref_counted.h"
@@ -91,6 +92,10 @@ class PendingRounds {
   int64_t GetCommittedIndex() const;
   int64_t GetTermWithLastCommittedOp() const;
 
+  // Returns the timestamp of the last op committed by AdvanceCommittedIndex(),
+  // or Timestamp::kInvalidTimestamp if no op was committed that way.
+  Timestamp GetLastCommittedTimestamp() const;
+
   // Checks that 'current' correctly follows 'previous'. Specifically it checks
   // that the term is the same or higher and that the index is sequential.
   static Status CheckOpInSequence(const OpId& previous, const OpId& current);
@@ -109,6 +114,9 @@ class PendingRounds {
   // The OpId of the round that was last committed. Initialized to MinimumOpId().
   OpId last_committed_op_id_;
 
+  // The timestamp of the round that was last committed.
+  Timestamp last_committed_timestamp_;
+
   scoped_refptr<TimeManager> time_manager_;
 
   DISALLOW_COPY_AND_ASSIGN(PendingRounds);
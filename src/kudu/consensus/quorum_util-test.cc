@@ -15,6 +15,7 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <cstdint>
 #include <string>
 
 #include <gtest/gtest.h>
@@ -191,5 +192,57 @@ TEST(QuorumUtilTest, TestIsRaftConfigVoter) {
   ASSERT_FALSE(ReplicaTypesEqual(*peer_b, *peer_c));
 }
 
+// Witnesses vote and count toward the majorities, but only as followers.
+TEST(QuorumUtilTest, TestWitness) {
+  ConsensusStatePB cstate;
+  RaftConfigPB* config = cstate.mutable_committed_config();
+  AddPeer(config, "A", RaftPeerPB::VOTER);
+  AddPeer(config, "B", RaftPeerPB::VOTER);
+  AddPeer(config, "C", RaftPeerPB::WITNESS);
+  AddPeer(config, "D", RaftPeerPB::NON_VOTER);
+  config->set_opid_index(1);
+  cstate.set_current_term(1);
+  cstate.set_leader_uuid("A");
+  ASSERT_OK(VerifyConsensusState(cstate));
+
+  ASSERT_TRUE(IsRaftConfigVoter("C", *config));
+  ASSERT_TRUE(IsRaftConfigWitness("C", *config));
+  ASSERT_FALSE(IsRaftConfigWitness("A", *config));
+  ASSERT_FALSE(IsRaftConfigWitness("D", *config));
+  ASSERT_EQ(3, CountVoters(*config));
+  ASSERT_EQ(2, MajoritySize(CountVoters(*config)));
+  ASSERT_EQ(RaftPeerPB::FOLLOWER, GetConsensusRole("C", cstate));
+  ASSERT_EQ(RaftPeerPB::LEARNER, GetConsensusRole("D", cstate));
+}
+
+TEST(QuorumUtilTest, TestConsensusStateDigest) {
+  ConsensusStatePB cstate;
+  cstate.set_current_term(2);
+  cstate.mutable_committed_config()->set_opid_index(5);
+  AddPeer(cstate.mutable_committed_config(), "A", RaftPeerPB::VOTER);
+  AddPeer(cstate.mutable_committed_config(), "B", RaftPeerPB::VOTER);
+  const uint64_t digest = ConsensusStateDigest(cstate);
+
+  // The leader and the pending config don't matter.
+  ConsensusStatePB other = cstate;
+  other.set_leader_uuid("A");
+  AddPeer(other.mutable_pending_config(), "C", RaftPeerPB::VOTER);
+  ASSERT_EQ(digest, ConsensusStateDigest(other));
+
+  // The term, the opid_index and the peers do.
+  other = cstate;
+  other.set_current_term(3);
+  ASSERT_NE(digest, ConsensusStateDigest(other));
+  other = cstate;
+  other.mutable_committed_config()->set_opid_index(6);
+  ASSERT_NE(digest, ConsensusStateDigest(other));
+  other = cstate;
+  other.mutable_committed_config()->mutable_peers(1)->set_member_type(RaftPeerPB::NON_VOTER);
+  ASSERT_NE(digest, ConsensusStateDigest(other));
+  other = cstate;
+  AddPeer(other.mutable_committed_config(), "C", RaftPeerPB::VOTER);
+  ASSERT_NE(digest, ConsensusStateDigest(other));
+}
+
 } // namespace consensus
 } // namespace kudu
@@ -25,8 +25,10 @@
 #include <glog/logging.h>
 
 #include "kudu/common/common.pb.h"
+#include "kudu/gutil/hash/city.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/strings/join.h"
+#include "kudu/gutil/strings/strcat.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/pb_util.h"
 #include "kudu/util/status.h"
@@ -54,12 +56,25 @@ bool IsRaftConfigMember(const std::string& uuid, const RaftConfigPB& config) {
 bool IsRaftConfigVoter(const std::string& uuid, const RaftConfigPB& config) {
   for (const RaftPeerPB& peer : config.peers()) {
     if (peer.permanent_uuid() == uuid) {
-      return peer.member_type() == RaftPeerPB::VOTER;
+      return IsVoterMemberType(peer.member_type());
     }
   }
   return false;
 }
 
+bool IsRaftConfigWitness(const std::string& uuid, const RaftConfigPB& config) {
+  for (const RaftPeerPB& peer : config.peers()) {
+    if (peer.permanent_uuid() == uuid) {
+      return peer.member_type() == RaftPeerPB::WITNESS;
+    }
+  }
+  return false;
+}
+
+bool IsVoterMemberType(RaftPeerPB::MemberType member_type) {
+  return member_type == RaftPeerPB::VOTER || member_type == RaftPeerPB::WITNESS;
+}
+
 bool IsVoterRole(RaftPeerPB::Role role) {
   return role == RaftPeerPB::LEADER || role == RaftPeerPB::FOLLOWER;
 }
@@ -107,7 +122,7 @@ bool ReplicaTypesEqual(const RaftPeerPB& peer1, const RaftPeerPB& peer2) {
 int CountVoters(const RaftConfigPB& config) {
   int voters = 0;
   for (const RaftPeerPB& peer : config.peers()) {
-    if (peer.member_type() == RaftPeerPB::VOTER) {
+    if (IsVoterMemberType(peer.member_type())) {
       voters++;
     }
   }
@@ -135,6 +150,7 @@ RaftPeerPB::Role GetConsensusRole(const std::string& uuid, const ConsensusStateP
     if (peer.permanent_uuid() == uuid) {
       switch (peer.member_type()) {
         case RaftPeerPB::VOTER:
+        case RaftPeerPB::WITNESS:
           return RaftPeerPB::FOLLOWER;
         default:
           return RaftPeerPB::LEARNER;
@@ -183,6 +199,19 @@ Status VerifyRaftConfig(const RaftConfigPB& config) {
     }
   }
 
+  // Only a voter which isn't a witness can become the leader.
+  int num_witnesses = 0;
+  for (const RaftPeerPB& peer : config.peers()) {
+    if (peer.member_type() == RaftPeerPB::WITNESS) {
+      num_witnesses++;
+    }
+  }
+  if (num_witnesses > 0 && num_witnesses == CountVoters(config)) {
+    return Status::IllegalState(
+        Substitute("RaftConfig has witnesses but no other voter. RaftConfig: $0",
+                   SecureShortDebugString(config)));
+  }
+
   return Status::OK();
 }
 
@@ -213,6 +242,16 @@ Status VerifyConsensusState(const ConsensusStatePB& cstate) {
   return Status::OK();
 }
 
+uint64_t ConsensusStateDigest(const ConsensusStatePB& cstate) {
+  const RaftConfigPB& config = cstate.committed_config();
+  string buf = Substitute("$0:$1", cstate.current_term(), config.opid_index());
+  for (const RaftPeerPB& peer : config.peers()) {
+    StrAppend(&buf, ":", peer.permanent_uuid(), "/",
+              RaftPeerPB::MemberType_Name(peer.member_type()));
+  }
+  return util_hash::CityHash64(buf.data(), buf.size());
+}
+
 std::string DiffRaftConfigs(const RaftConfigPB& old_config,
                             const RaftConfigPB& new_config) {
   // Create dummy ConsensusState objects so we can reuse the code
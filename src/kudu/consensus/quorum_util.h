@@ -18,6 +18,7 @@
 #ifndef KUDU_CONSENSUS_QUORUM_UTIL_H_
 #define KUDU_CONSENSUS_QUORUM_UTIL_H_
 
+#include <cstdint>
 #include <string>
 
 #include "kudu/consensus/metadata.pb.h"
@@ -33,7 +34,13 @@ enum RaftConfigState {
 };
 
 bool IsRaftConfigMember(const std::string& uuid, const RaftConfigPB& config);
+// Witnesses count as voters.
 bool IsRaftConfigVoter(const std::string& uuid, const RaftConfigPB& config);
+bool IsRaftConfigWitness(const std::string& uuid, const RaftConfigPB& config);
+
+// Whether a peer of the specified member type votes in leader elections and
+// counts toward the majorities.
+bool IsVoterMemberType(RaftPeerPB::MemberType member_type);
 
 // Whether the specified Raft role is attributed to a peer which can participate
 // in leader elections.
@@ -60,7 +67,7 @@ bool RemoveFromRaftConfig(RaftConfigPB* config, const std::string& uuid);
 // options.
 bool ReplicaTypesEqual(const RaftPeerPB& peer1, const RaftPeerPB& peer2);
 
-// Counts the number of voters in the configuration.
+// Counts the number of voters in the configuration, witnesses included.
 int CountVoters(const RaftConfigPB& config);
 
 // Calculates size of a configuration majority based on # of voters.
@@ -79,6 +86,11 @@ Status VerifyRaftConfig(const RaftConfigPB& config);
 // leader is a configuration voter, if it is set, and that a valid term is set.
 Status VerifyConsensusState(const ConsensusStatePB& cstate);
 
+// Returns a digest of the current term and of the committed configuration of
+// 'cstate'. Replicas which agree on both have the same digest, regardless of
+// the leader they know of and of their pending configuration.
+uint64_t ConsensusStateDigest(const ConsensusStatePB& cstate);
+
 // Provide a textual description of the difference between two consensus states,
 // suitable for logging.
 std::string DiffConsensusStates(const ConsensusStatePB& old_state,
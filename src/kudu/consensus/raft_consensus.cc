@@ -127,6 +127,24 @@ DEFINE_bool(raft_prepare_replacement_before_eviction, false,
 TAG_FLAG(raft_prepare_replacement_before_eviction, advanced);
 TAG_FLAG(raft_prepare_replacement_before_eviction, experimental);
 
+DEFINE_bool(raft_enable_leader_leases, false,
+            "When enabled, a replica that accepted a request from the leader "
+            "refuses to vote, even for itself or in an election that ignores "
+            "the live leader, for the minimum election timeout since, granting "
+            "the leader a lease to serve linearizable reads locally. This "
+            "delays leadership transfers by up to the election timeout. Must "
+            "be set on all the tablet servers to be effective.");
+TAG_FLAG(raft_enable_leader_leases, experimental);
+
+DEFINE_int32(raft_leader_lease_max_clock_drift_ppm, 500,
+             "The maximum rate, in parts per million, at which the monotonic clock "
+             "of a tablet server may drift from the clock of another. The leader "
+             "shortens its leases by this rate, since the replicas which grant them "
+             "time them with their own clocks. Only used with "
+             "--raft_enable_leader_leases.");
+TAG_FLAG(raft_leader_lease_max_clock_drift_ppm, advanced);
+TAG_FLAG(raft_leader_lease_max_clock_drift_ppm, experimental);
+
 DECLARE_int32(memory_limit_warn_threshold_percentage);
 
 // Metrics
@@ -149,6 +167,7 @@ using kudu::tserver::TabletServerErrorPB;
 using std::shared_ptr;
 using std::string;
 using std::unique_ptr;
+using std::vector;
 using std::weak_ptr;
 using strings::Substitute;
 
@@ -169,6 +188,8 @@ RaftConsensus::RaftConsensus(
       withhold_votes_until_(MonoTime::Min()),
       last_received_cur_leader_(MinimumOpId()),
       failed_elections_since_stable_leader_(0),
+      leader_transfer_in_progress_(false),
+      is_witness_(false),
       shutdown_(false),
       update_calls_for_tests_(0) {
   DCHECK(local_peer_pb_.has_permanent_uuid());
@@ -177,6 +198,8 @@ RaftConsensus::RaftConsensus(
 Status RaftConsensus::Init() {
   DCHECK_EQ(kNew, state_) << State_Name(state_);
   RETURN_NOT_OK(cmeta_manager_->Load(options_.tablet_id, &cmeta_));
+  // Set before Start() replays the pending operations, which may be writes.
+  is_witness_.Store(IsRaftConfigWitness(peer_uuid(), cmeta_->ActiveConfig()));
   SetStateUnlocked(kInitialized);
   return Status::OK();
 }
@@ -266,6 +289,18 @@ Status RaftConsensus::Start(const ConsensusBootstrapInfo& info,
       },
       MinimumElectionTimeout());
 
+  PeriodicTimer::Options opts;
+  opts.one_shot = true;
+  transfer_period_timer_ = PeriodicTimer::Create(
+      peer_proxy_factory_->messenger(),
+      [w]() {
+        if (auto consensus = w.lock()) {
+          consensus->LeaderTransferPeriodExpired();
+        }
+      },
+      MinimumElectionTimeout(),
+      opts);
+
   {
     ThreadRestrictions::AssertWaitAllowed();
     LockGuard l(lock_);
@@ -326,6 +361,15 @@ Status RaftConsensus::Start(const ConsensusBootstrapInfo& info,
     // Now assume non-leader replica duties.
     RETURN_NOT_OK(BecomeReplicaUnlocked(fd_initial_delta));
 
+    // The replica doesn't know whether it granted a lease to a leader before
+    // it restarted, so it withholds its vote for as long as such a lease may
+    // last. A new tablet never had a leader, and a single voter has nobody to
+    // grant a lease to.
+    if (FLAGS_raft_enable_leader_leases && CurrentTermUnlocked() > 0 &&
+        CountVoters(cmeta_->ActiveConfig()) > 1) {
+      withhold_votes_until_ = MonoTime::Now() + MinimumElectionTimeout();
+    }
+
     SetStateUnlocked(kRunning);
   }
 
@@ -422,6 +466,12 @@ Status RaftConsensus::StartElection(ElectionMode mode, ElectionReason reason) {
                                   "a non-participant in the Raft config",
                                   SecureShortDebugString(cmeta_->ActiveConfig()));
     }
+    if (FLAGS_raft_enable_leader_leases && MonoTime::Now() < withhold_votes_until_) {
+      // Voting for ourselves would break the lease granted to the leader.
+      return Status::IllegalState(Substitute(
+          "Not starting $0: the lease granted to leader $1 has not expired",
+          mode_str, GetLeaderUuidUnlocked()));
+    }
     LOG_WITH_PREFIX_UNLOCKED(INFO)
         << "Starting " << mode_str
         << " (" << ReasonString(reason, GetLeaderUuidUnlocked()) << ")";
@@ -525,6 +575,78 @@ Status RaftConsensus::StepDown(LeaderStepDownResponsePB* resp) {
   return Status::OK();
 }
 
+Status RaftConsensus::TransferLeadership(const boost::optional<string>& new_leader_uuid,
+                                         LeaderStepDownResponsePB* resp) {
+  TRACE_EVENT0("consensus", "RaftConsensus::TransferLeadership");
+  ThreadRestrictions::AssertWaitAllowed();
+  {
+    LockGuard l(lock_);
+    RETURN_NOT_OK(CheckRunningUnlocked());
+    if (cmeta_->active_role() != RaftPeerPB::LEADER) {
+      LOG_WITH_PREFIX_UNLOCKED(INFO) << "Rejecting request to transfer leadership while not leader";
+      resp->mutable_error()->set_code(TabletServerErrorPB::NOT_THE_LEADER);
+      StatusToPB(Status::IllegalState("Not currently leader"),
+                 resp->mutable_error()->mutable_status());
+      // We return OK so that the tablet service won't overwrite the error code.
+      return Status::OK();
+    }
+    if (new_leader_uuid) {
+      if (*new_leader_uuid == peer_uuid()) {
+        // Leadership is already where it was requested to be.
+        return Status::OK();
+      }
+      if (!IsRaftConfigVoter(*new_leader_uuid, cmeta_->ActiveConfig())) {
+        return Status::InvalidArgument(
+            Substitute("tablet server $0 is not a voter in the active config",
+                       *new_leader_uuid));
+      }
+      if (IsRaftConfigWitness(*new_leader_uuid, cmeta_->ActiveConfig())) {
+        return Status::InvalidArgument(
+            Substitute("tablet server $0 is a witness, which has no data to serve",
+                       *new_leader_uuid));
+      }
+    }
+    if (leader_transfer_in_progress_.Load()) {
+      return Status::ServiceUnavailable("leadership transfer already in progress");
+    }
+    LOG_WITH_PREFIX_UNLOCKED(INFO) << "Received request to transfer leadership"
+                                   << (new_leader_uuid ? " to TS " + *new_leader_uuid : "");
+    BeginLeaderTransferPeriodUnlocked(new_leader_uuid);
+  }
+  // Make the peers report their progress right away, so that a successor
+  // which has already caught up is found without waiting for a heartbeat.
+  peer_manager_->SignalRequest(true);
+  return Status::OK();
+}
+
+void RaftConsensus::BeginLeaderTransferPeriodUnlocked(
+    const boost::optional<string>& successor_uuid) {
+  DCHECK(lock_.is_locked());
+  leader_transfer_in_progress_.Store(true);
+  queue_->BeginWatchForSuccessor(successor_uuid);
+  transfer_period_timer_->Start();
+}
+
+void RaftConsensus::LeaderTransferPeriodExpired() {
+  // A witness which was elected to catch up the data replicas keeps watching
+  // for one of them to take over until it steps down.
+  if (is_witness_.Load() && leader_transfer_in_progress_.Load()) {
+    queue_->BeginWatchForSuccessor(boost::none);
+    transfer_period_timer_->Start();
+    return;
+  }
+  EndLeaderTransferPeriod();
+}
+
+void RaftConsensus::EndLeaderTransferPeriod() {
+  if (!leader_transfer_in_progress_.Exchange(false)) {
+    return;
+  }
+  transfer_period_timer_->Stop();
+  queue_->EndWatchForSuccessor();
+  LOG(INFO) << LogPrefixThreadSafe() << "Leadership transfer period ended";
+}
+
 scoped_refptr<ConsensusRound> RaftConsensus::NewRound(
     gscoped_ptr<ReplicateMsg> replicate_msg,
     ConsensusReplicatedCallback replicated_cb) {
@@ -583,7 +705,19 @@ Status RaftConsensus::BecomeLeaderUnlocked() {
       &DoNothingStatusCB,
       std::placeholders::_1));
 
-  return AppendNewRoundToQueueUnlocked(round);
+  RETURN_NOT_OK(AppendNewRoundToQueueUnlocked(round));
+
+  // A witness is only elected when it has operations which no data replica
+  // which could be elected has, e.g. after the leader failed with operations
+  // replicated to the witness only. It has no data to serve, so it refuses
+  // new operations and hands its leadership over to the first data replica
+  // to catch up with its log.
+  if (is_witness_.Load()) {
+    LOG_WITH_PREFIX_UNLOCKED(INFO) << "Elected as a witness: handing leadership over "
+                                   << "to the first data replica to catch up";
+    BeginLeaderTransferPeriodUnlocked(boost::none);
+  }
+  return Status::OK();
 }
 
 Status RaftConsensus::BecomeReplicaUnlocked(boost::optional<MonoDelta> fd_delta) {
@@ -600,6 +734,7 @@ Status RaftConsensus::BecomeReplicaUnlocked(boost::optional<MonoDelta> fd_delta)
   // Now that we're a replica, we can allow voting for other nodes.
   withhold_votes_until_ = MonoTime::Min();
 
+  EndLeaderTransferPeriod();
   queue_->UnRegisterObserver(this);
   // Deregister ourselves from the queue. We don't care what get's replicated, since
   // we're stepping down.
@@ -624,6 +759,26 @@ Status RaftConsensus::Replicate(const scoped_refptr<ConsensusRound>& round) {
   return Status::OK();
 }
 
+Status RaftConsensus::ReplicateBatch(const vector<scoped_refptr<ConsensusRound>>& rounds) {
+  DCHECK(!rounds.empty());
+
+  std::lock_guard<simple_spinlock> lock(update_lock_);
+  {
+    ThreadRestrictions::AssertWaitAllowed();
+    LockGuard l(lock_);
+    // Check all of the rounds before appending any of them, so that the batch
+    // is replicated either entirely or not at all.
+    for (const auto& round : rounds) {
+      RETURN_NOT_OK(CheckSafeToReplicateUnlocked(*round->replicate_msg()));
+      RETURN_NOT_OK(round->CheckBoundTerm(CurrentTermUnlocked()));
+    }
+    RETURN_NOT_OK(AppendNewRoundsToQueueUnlocked(rounds));
+  }
+
+  peer_manager_->SignalRequest();
+  return Status::OK();
+}
+
 Status RaftConsensus::CheckLeadershipAndBindTerm(const scoped_refptr<ConsensusRound>& round) {
   ThreadRestrictions::AssertWaitAllowed();
   LockGuard l(lock_);
@@ -645,6 +800,32 @@ Status RaftConsensus::AppendNewRoundToQueueUnlocked(const scoped_refptr<Consensu
   return Status::OK();
 }
 
+Status RaftConsensus::AppendNewRoundsToQueueUnlocked(
+    const vector<scoped_refptr<ConsensusRound>>& rounds) {
+  DCHECK(lock_.is_locked());
+
+  OpId next_id = queue_->GetNextOpId();
+  vector<ReplicateRefPtr> replicates;
+  replicates.reserve(rounds.size());
+  for (const auto& round : rounds) {
+    // Adding a pending operation can only fail for config changes, which
+    // keeps the batch all-or-nothing.
+    DCHECK_NE(CHANGE_CONFIG_OP, round->replicate_msg()->op_type());
+    *round->replicate_msg()->mutable_id() = next_id;
+    RETURN_NOT_OK(AddPendingOperationUnlocked(round));
+    replicates.push_back(round->replicate_scoped_refptr());
+    next_id.set_index(next_id.index() + 1);
+  }
+
+  // See AppendNewRoundToQueueUnlocked().
+  CHECK_OK_PREPEND(queue_->AppendOperations(
+                       replicates,
+                       Bind(CrashIfNotOkStatusCB,
+                            "Enqueued replicate operation failed to write to WAL")),
+                   Substitute("$0: could not append to queue", LogPrefixUnlocked()));
+  return Status::OK();
+}
+
 Status RaftConsensus::AddPendingOperationUnlocked(const scoped_refptr<ConsensusRound>& round) {
   DCHECK(lock_.is_locked());
   DCHECK(pending_);
@@ -734,6 +915,14 @@ void RaftConsensus::NotifyTermChange(int64_t term) {
   WARN_NOT_OK(HandleTermAdvanceUnlocked(term), "Couldn't advance consensus term.");
 }
 
+void RaftConsensus::NotifyPeerToStartElection(const string& peer_uuid) {
+  LOG(INFO) << LogPrefixThreadSafe() << "Instructing follower " << peer_uuid
+            << " to start an election";
+  WARN_NOT_OK(peer_manager_->StartElection(peer_uuid),
+              LogPrefixThreadSafe() + "Unable to instruct follower " + peer_uuid +
+              " to start an election");
+}
+
 void RaftConsensus::NotifyFailedFollower(const string& uuid,
                                          int64_t term,
                                          const std::string& reason) {
@@ -1100,6 +1289,7 @@ Status RaftConsensus::UpdateReplica(const ConsensusRequestPB* request,
                "tablet", options_.tablet_id);
   Synchronizer log_synchronizer;
   StatusCallback sync_status_cb = log_synchronizer.AsStatusCallback();
+  MonoTime wal_append_start;
 
 
   // The ordering of the following operations is crucial, read on for details.
@@ -1333,6 +1523,7 @@ Status RaftConsensus::UpdateReplica(const ConsensusRequestPB* request,
       //
       // Since we've prepared, we need to be able to append (or we risk trying to apply
       // later something that wasn't logged). We crash if we can't.
+      wal_append_start = MonoTime::Now();
       CHECK_OK(queue_->AppendOperations(deduped_req.messages, sync_status_cb));
     } else {
       last_from_leader = *deduped_req.preceding_opid;
@@ -1392,6 +1583,7 @@ Status RaftConsensus::UpdateReplica(const ConsensusRequestPB* request,
       }
     } while (s.IsTimedOut());
     RETURN_NOT_OK(s);
+    TRACE_SPAN("wal_append", wal_append_start);
 
     TRACE("finished");
   }
@@ -1510,7 +1702,11 @@ Status RaftConsensus::RequestVote(const VoteRequestPB* request,
   //
   // See also https://ramcloud.stanford.edu/~ongaro/thesis.pdf
   // section 4.2.3.
-  if (!request->ignore_live_leader() && MonoTime::Now() < withhold_votes_until_) {
+  //
+  // With leader leases, votes are withheld even from candidates that ignore
+  // the live leader, so that the lease granted to it holds.
+  if ((!request->ignore_live_leader() || FLAGS_raft_enable_leader_leases) &&
+      MonoTime::Now() < withhold_votes_until_) {
     return RequestVoteRespondLeaderIsAlive(request, response);
   }
 
@@ -1667,6 +1863,13 @@ Status RaftConsensus::ChangeConfig(const ChangeConfigRequestPB& req,
         if (ReplicaTypesEqual(*peer_pb, server)) {
           return Status::InvalidArgument("Cannot change replica type to same type");
         }
+        if (peer_pb->member_type() == RaftPeerPB::WITNESS ||
+            server.member_type() == RaftPeerPB::WITNESS) {
+          // A witness has no data, and the data of a replica turned into a
+          // witness would go stale: replace the replica instead.
+          return Status::InvalidArgument(
+              "Cannot change the type of a replica to or from WITNESS");
+        }
         peer_pb->set_member_type(server.member_type());
         // TODO(mpercy): Copy over replica intentions when implemented.
         break;
@@ -1875,6 +2078,7 @@ void RaftConsensus::Stop() {
   // Shut down things that might acquire locks during destruction.
   if (raft_pool_token_) raft_pool_token_->Shutdown();
   if (failure_detector_) DisableFailureDetector();
+  if (transfer_period_timer_) transfer_period_timer_->Stop();
 }
 
 void RaftConsensus::Shutdown() {
@@ -2058,11 +2262,38 @@ RaftPeerPB::Role RaftConsensus::role() const {
   return cmeta_->active_role();
 }
 
+bool RaftConsensus::IsWitness() const {
+  return is_witness_.Load();
+}
+
 int64_t RaftConsensus::CurrentTerm() const {
   LockGuard l(lock_);
   return CurrentTermUnlocked();
 }
 
+Status RaftConsensus::GetLeaderLeaseTimestamp(Timestamp* timestamp) {
+  if (!FLAGS_raft_enable_leader_leases) {
+    return Status::NotSupported("leader leases are disabled");
+  }
+  LockGuard l(lock_);
+  RETURN_NOT_OK(CheckRunningUnlocked());
+  RETURN_NOT_OK(CheckActiveLeaderUnlocked());
+  // Until the leader commits an operation in its term, operations committed
+  // by previous leaders may not be committed locally yet.
+  if (pending_->GetTermWithLastCommittedOp() != CurrentTermUnlocked()) {
+    return Status::IllegalState("leader has not committed an operation in its term yet");
+  }
+  MonoTime grant_time = queue_->GetMajorityLeaseGrantTime();
+  if (grant_time != MonoTime::Max() &&
+      (grant_time == MonoTime::Min() ||
+       MonoTime::Now() >= grant_time + LeaderLeaseDuration())) {
+    return Status::IllegalState("leader does not hold a valid lease");
+  }
+  *timestamp = pending_->GetLastCommittedTimestamp();
+  DCHECK_NE(Timestamp::kInvalidTimestamp, *timestamp);
+  return Status::OK();
+}
+
 void RaftConsensus::SetStateUnlocked(State new_state) {
   switch (new_state) {
     case kInitialized:
@@ -2360,8 +2591,18 @@ log::RetentionIndexes RaftConsensus::GetRetentionIndexes() {
   // separately -- the worst case is we see a relatively "out of date" watermark
   // which just means we'll retain slightly more than necessary in this invocation
   // of log GC.
-  return log::RetentionIndexes(queue_->GetCommittedIndex(), // for durability
-                               queue_->GetAllReplicatedIndex()); // for peers
+  int64_t for_durability = queue_->GetCommittedIndex();
+  const int64_t for_peers = queue_->GetAllReplicatedIndex();
+  if (is_witness_.Load()) {
+    // Nothing is applied to a witness, so nothing anchors its log: instead,
+    // it keeps the operations which aren't yet replicated to every other
+    // replica, since a write committed by the leader and the witness only
+    // would be lost if the leader failed before replicating it further. Until
+    // the leader reports the index, e.g. after a restart, this retains all of
+    // the log.
+    for_durability = std::min(for_durability, for_peers);
+  }
+  return log::RetentionIndexes(for_durability, for_peers);
 }
 
 void RaftConsensus::MarkDirty(const std::string& reason) {
@@ -2479,7 +2720,7 @@ void RaftConsensus::CompleteConfigChangeRoundUnlocked(ConsensusRound* round, con
 
 void RaftConsensus::EnableFailureDetector(boost::optional<MonoDelta> delta) {
   if (PREDICT_TRUE(FLAGS_enable_leader_failure_detection)) {
-    failure_detector_->Start(std::move(delta));
+    failure_detector_->Start(WitnessFailureDetectorDelta(std::move(delta)));
   }
 }
 
@@ -2490,6 +2731,10 @@ void RaftConsensus::DisableFailureDetector() {
 }
 
 void RaftConsensus::ToggleFailureDetector(boost::optional<MonoDelta> delta) {
+  // This is called whenever the active config changes. The type of a replica
+  // can't be changed to or from a witness, so this only ever sets the flag.
+  is_witness_.Store(IsRaftConfigWitness(peer_uuid(), cmeta_->ActiveConfig()));
+
   if (IsRaftConfigVoter(peer_uuid(), cmeta_->ActiveConfig())) {
     // A non-leader voter replica should run failure detector.
     EnableFailureDetector(std::move(delta));
@@ -2514,8 +2759,29 @@ void RaftConsensus::SnoozeFailureDetector(boost::optional<string> reason_for_log
     if (!delta) {
       delta = MinimumElectionTimeout();
     }
-    failure_detector_->Snooze(std::move(delta));
+    failure_detector_->Snooze(WitnessFailureDetectorDelta(std::move(delta)));
+  }
+}
+
+boost::optional<MonoDelta> RaftConsensus::WitnessFailureDetectorDelta(
+    boost::optional<MonoDelta> delta) const {
+  if (!is_witness_.Load()) {
+    return delta;
   }
+  // Give the data replicas an election timeout to elect one of them first.
+  const MonoDelta timeout = MinimumElectionTimeout();
+  return MonoDelta::FromNanoseconds((delta ? *delta : timeout).ToNanoseconds() +
+                                    timeout.ToNanoseconds());
+}
+
+MonoDelta RaftConsensus::LeaderLeaseDuration() const {
+  // A replica withholds its vote for the minimum election timeout as measured
+  // by its own clock, from the time it received the request, which is after
+  // the leader sent it. The leader's clock may run faster than the replica's,
+  // by up to the maximum drift rate.
+  const int64_t timeout_nanos = MinimumElectionTimeout().ToNanoseconds();
+  return MonoDelta::FromNanoseconds(
+      timeout_nanos - timeout_nanos / 1000000 * FLAGS_raft_leader_lease_max_clock_drift_ppm);
 }
 
 MonoDelta RaftConsensus::MinimumElectionTimeout() const {
@@ -2568,6 +2834,9 @@ Status RaftConsensus::CheckSafeToReplicateUnlocked(const ReplicateMsg& msg) cons
   DCHECK(lock_.is_locked());
   DCHECK(!msg.has_id()) << "Should not have an ID yet: " << SecureShortDebugString(msg);
   RETURN_NOT_OK(CheckRunningUnlocked());
+  if (PREDICT_FALSE(leader_transfer_in_progress_.Load())) {
+    return Status::ServiceUnavailable("leadership transfer in progress");
+  }
   return CheckActiveLeaderUnlocked();
 }
 
@@ -59,6 +59,7 @@ typedef gscoped_ptr<Lock> ScopedLock;
 class ThreadPool;
 class ThreadPoolToken;
 class Status;
+class Timestamp;
 
 template <typename Sig>
 class Callback;
@@ -161,6 +162,21 @@ class RaftConsensus : public std::enable_shared_from_this<RaftConsensus>,
   // Implement a LeaderStepDown() request.
   Status StepDown(LeaderStepDownResponsePB* resp);
 
+  // Implement a GRACEFUL LeaderStepDown() request: stop accepting new
+  // operations until either 'new_leader_uuid' (or, if unset, the first voter
+  // to catch up with the local log) was asked to start an election and won
+  // it, or an election timeout elapsed. See LeaderStepDownMode.
+  //
+  // Returns ServiceUnavailable if a transfer is already in progress.
+  Status TransferLeadership(const boost::optional<std::string>& new_leader_uuid,
+                            LeaderStepDownResponsePB* resp);
+
+  // Returns whether a leadership transfer started by TransferLeadership() is
+  // in progress.
+  bool leader_transfer_in_progress() const {
+    return leader_transfer_in_progress_.Load();
+  }
+
   // Creates a new ConsensusRound, the entity that owns all the data
   // structures required for a consensus round, such as the ReplicateMsg
   // (and later on the CommitMsg). ConsensusRound will also point to and
@@ -202,6 +218,14 @@ class RaftConsensus : public std::enable_shared_from_this<RaftConsensus>,
   // This method can only be called on the leader, i.e. role() == LEADER
   Status Replicate(const scoped_refptr<ConsensusRound>& round);
 
+  // Like Replicate(), but for several rounds at once. The rounds are assigned
+  // consecutive OpIds in the order given and appended to the queue (and
+  // hence the local log) together. Config changes may not be replicated this
+  // way.
+  //
+  // If a non-OK status is returned, none of the rounds were replicated.
+  Status ReplicateBatch(const std::vector<scoped_refptr<ConsensusRound>>& rounds);
+
   // Ensures that the consensus implementation is currently acting as LEADER,
   // and thus is allowed to submit operations to be prepared before they are
   // replicated. To avoid a time-of-check-to-time-of-use (TOCTOU) race, the
@@ -264,9 +288,25 @@ class RaftConsensus : public std::enable_shared_from_this<RaftConsensus>,
   // Returns the current Raft role of this instance.
   RaftPeerPB::Role role() const;
 
+  // Returns whether this replica is a witness in the active config, i.e. it
+  // votes and persists the WAL but doesn't apply the writes. Doesn't take
+  // 'lock_', so it may be called on every write.
+  bool IsWitness() const;
+
   // Returns the current term.
   int64_t CurrentTerm() const;
 
+  // If this replica is the leader, has committed an operation in its term and
+  // holds a valid leader lease, sets 'timestamp' to the timestamp of the last
+  // operation it committed. No other replica can have committed operations
+  // since, so reading the state as of 'timestamp' is linearizable without a
+  // round trip to the followers. Otherwise returns a non-OK status.
+  //
+  // A lease lasts for LeaderLeaseDuration() from the time the leader sent the
+  // last request accepted by a majority of the voters. Requires
+  // --raft_enable_leader_leases.
+  Status GetLeaderLeaseTimestamp(Timestamp* timestamp);
+
   // Returns the uuid of this peer.
   // Thread-safe.
   const std::string& peer_uuid() const;
@@ -317,6 +357,8 @@ class RaftConsensus : public std::enable_shared_from_this<RaftConsensus>,
                             int64_t term,
                             const std::string& reason);
 
+  void NotifyPeerToStartElection(const std::string& peer_uuid);
+
   // Return the log indexes which the consensus implementation would like to retain.
   //
   // The returned 'for_durability' index ensures that no logs are GCed before
@@ -440,6 +482,19 @@ class RaftConsensus : public std::enable_shared_from_this<RaftConsensus>,
   // 'lock_' must be held for configuration change before calling.
   Status BecomeReplicaUnlocked(boost::optional<MonoDelta> fd_delta = boost::none);
 
+  // Starts a leadership transfer period: new operations are refused, the
+  // queue watches for a successor which caught up with the local log, and
+  // 'transfer_period_timer_' is armed to end the period after an election
+  // timeout. 'lock_' must be held.
+  void BeginLeaderTransferPeriodUnlocked(const boost::optional<std::string>& successor_uuid);
+
+  // Ends the leadership transfer period, if any.
+  void EndLeaderTransferPeriod();
+
+  // Called by 'transfer_period_timer_'. Ends the leadership transfer period,
+  // unless the leader is a witness, which restarts it instead.
+  void LeaderTransferPeriodExpired();
+
   // Updates the state in a replica by storing the received operations in the log
   // and triggering the required transactions. This method won't return until all
   // operations have been stored in the log and all Prepares() have been completed,
@@ -584,10 +639,20 @@ class RaftConsensus : public std::enable_shared_from_this<RaftConsensus>,
   void SnoozeFailureDetector(boost::optional<std::string> reason_for_log = boost::none,
                              boost::optional<MonoDelta> delta = boost::none);
 
+  // Returns the failure period to use instead of 'delta' (or of the default
+  // period if unset): on a witness, it's extended by an election timeout so
+  // that the data replicas get to elect one of them first.
+  boost::optional<MonoDelta> WitnessFailureDetectorDelta(boost::optional<MonoDelta> delta) const;
+
   // Return the minimum election timeout. Due to backoff and random
   // jitter, election timeouts may be longer than this.
   MonoDelta MinimumElectionTimeout() const;
 
+  // Returns how long a leader lease lasts from the time the leader sent the
+  // request renewing it: the minimum election timeout, shortened by
+  // --raft_leader_lease_max_clock_drift_ppm.
+  MonoDelta LeaderLeaseDuration() const;
+
   // Calculates a snooze delta for leader election.
   //
   // The delta increases exponentially with the difference between the current
@@ -655,6 +720,10 @@ class RaftConsensus : public std::enable_shared_from_this<RaftConsensus>,
   // As a leader, append a new ConsensusRound to the queue.
   Status AppendNewRoundToQueueUnlocked(const scoped_refptr<ConsensusRound>& round);
 
+  // As a leader, append several new ConsensusRounds to the queue at once.
+  // None of them may be config changes.
+  Status AppendNewRoundsToQueueUnlocked(const std::vector<scoped_refptr<ConsensusRound>>& rounds);
+
   // As a follower, start a consensus round not associated with a Transaction.
   Status StartConsensusOnlyRoundUnlocked(const ReplicateRefPtr& msg);
 
@@ -784,6 +853,18 @@ class RaftConsensus : public std::enable_shared_from_this<RaftConsensus>,
 
   std::shared_ptr<rpc::PeriodicTimer> failure_detector_;
 
+  // Whether a leadership transfer is in progress, during which the leader
+  // refuses new operations. Only set while holding 'lock_'.
+  AtomicBool leader_transfer_in_progress_;
+
+  // Whether this replica is a witness in the active config. Only set while
+  // holding 'lock_'.
+  AtomicBool is_witness_;
+
+  // One-shot timer ending a leadership transfer that didn't complete within
+  // an election timeout.
+  std::shared_ptr<rpc::PeriodicTimer> transfer_period_timer_;
+
   // Lock held while starting a failure-triggered election.
   //
   // After reporting a failure and asynchronously starting an election, the
@@ -18,9 +18,14 @@
 #ifndef KUDU_CONSENSUS_REF_COUNTED_REPLICATE_H_
 #define KUDU_CONSENSUS_REF_COUNTED_REPLICATE_H_
 
+#include <cstdint>
+
 #include "kudu/consensus/consensus.pb.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/slice.h"
+#include "kudu/util/trace_spans.h"
 
 namespace kudu {
 namespace consensus {
@@ -34,8 +39,40 @@ class RefCountedReplicate : public RefCountedThreadSafe<RefCountedReplicate> {
     return msg_.get();
   }
 
+  // Serializes the message, so that it can be sent to any number of peers
+  // without being serialized again for each of them. Must be called before
+  // the message is shared with other threads, and the message must not be
+  // modified afterwards.
+  void Serialize() {
+    serialized_.resize(msg_->ByteSize());
+    msg_->SerializeWithCachedSizesToArray(serialized_.data());
+  }
+
+  // Returns the message serialized by Serialize(), or an empty slice if it
+  // wasn't serialized.
+  Slice serialized() const {
+    return Slice(serialized_);
+  }
+
+  // The span of the sampled distributed trace which the operation is
+  // replicated on behalf of, if any. Like Serialize(), set_span_context()
+  // must be called before the message is shared with other threads.
+  void set_span_context(const TraceSpanContext& context) {
+    span_context_ = context;
+  }
+  const TraceSpanContext& span_context() const {
+    return span_context_;
+  }
+
+  // Returns the memory used by the message, including its serialized form.
+  int64_t SpaceUsed() const {
+    return msg_->SpaceUsed() + serialized_.capacity();
+  }
+
  private:
   gscoped_ptr<ReplicateMsg> msg_;
+  faststring serialized_;
+  TraceSpanContext span_context_;
 };
 
 typedef scoped_refptr<RefCountedReplicate> ReplicateRefPtr;
@@ -32,6 +32,8 @@
 #include "kudu/tserver/tserver.pb.h"
 #include "kudu/util/countdown_latch.h"
 #include "kudu/util/flag_tags.h"
+#include "kudu/util/probes.h"
+#include "kudu/util/scoped_cleanup.h"
 
 DEFINE_bool(safe_time_advancement_without_writes, true,
             "Whether to enable the advancement of \"safe\" time in the absense of write "
@@ -237,6 +239,10 @@ Status TimeManager::WaitUntilSafe(Timestamp timestamp, const MonoTime& deadline)
     if (IsTimestampSafeUnlocked(timestamp)) return Status::OK();
     waiters_.push_back(&waiter);
   }
+  KUDU_PROBE(safe_time_wait_start, timestamp.ToUint64());
+  SCOPED_CLEANUP({
+    KUDU_PROBE(safe_time_wait_done, timestamp.ToUint64());
+  });
 
   // Wait until we get notified or 'deadline' elapses.
   if (waiter.latch->WaitUntil(deadline)) return Status::OK();
@@ -17,12 +17,16 @@
 
 #include "kudu/fs/block_manager.h"
 
+#include <memory>
 #include <mutex>
 #include <ostream>
+#include <utility>
+#include <vector>
 
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 
+#include "kudu/fs/block_id.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/env.h"
@@ -71,6 +75,8 @@ static bool ValidateMaxOpenFiles(const char* /*flagname*/, int64_t value) {
 }
 DEFINE_validator(block_manager_max_open_files, &ValidateMaxOpenFiles);
 
+using std::unique_ptr;
+using std::vector;
 using strings::Substitute;
 
 namespace kudu {
@@ -79,6 +85,29 @@ namespace fs {
 BlockManagerOptions::BlockManagerOptions()
   : read_only(false) {}
 
+Status BlockManager::OpenBlocks(const vector<BlockId>& block_ids,
+                                vector<unique_ptr<ReadableBlock>>* blocks) {
+  vector<unique_ptr<ReadableBlock>> opened(block_ids.size());
+  for (int i = 0; i < block_ids.size(); i++) {
+    RETURN_NOT_OK(OpenBlock(block_ids[i], &opened[i]));
+  }
+  *blocks = std::move(opened);
+  return Status::OK();
+}
+
+void BlockCreationTransaction::DropCommittedBlocksFromCache(BlockManager* block_manager,
+                                                            const vector<BlockId>& block_ids) {
+  for (const auto& block_id : block_ids) {
+    unique_ptr<ReadableBlock> block;
+    Status s = block_manager->OpenBlock(block_id, &block);
+    if (s.ok()) {
+      s = block->DropCache(0, 0);
+    }
+    WARN_NOT_OK(s, Substitute("could not drop block $0 from the page cache",
+                              block_id.ToString()));
+  }
+}
+
 int64_t GetFileCacheCapacityForBlockManager(Env* env) {
   // Maximize this process' open file limit first, if possible.
   static std::once_flag once;
@@ -31,6 +31,8 @@ namespace kudu {
 
 class BlockId;
 class Env;
+class FileMapping;
+class MaintenanceManager;
 class MemTracker;
 class Slice;
 
@@ -162,16 +164,54 @@ class ReadableBlock : public Block {
   // If an error was encountered, returns a non-OK status.
   virtual Status ReadV(uint64_t offset, ArrayView<Slice> results) const = 0;
 
+  // Advises the OS to drop the 'length' bytes at 'offset' in the block from
+  // its page cache, e.g. once a compaction has read them. See
+  // RandomAccessFile::DropCache().
+  virtual Status DropCache(uint64_t /* offset */, size_t /* length */) const {
+    return Status::OK();
+  }
+
+  // Advises the OS to read the 'length' bytes at 'offset' in the block into
+  // its page cache in the background. See RandomAccessFile::Prefetch().
+  virtual Status Prefetch(uint64_t /* offset */, size_t /* length */) const {
+    return Status::OK();
+  }
+
+  // If the block's data directory is read through memory mappings (see
+  // --fs_mmap_data_dirs), points 'result' at the 'length' bytes at 'offset'
+  // in the block, within a mapping which 'mapping' keeps alive, and returns
+  // true. Otherwise, or if the block can't be mapped, returns false, and the
+  // bytes must be read with Read() or ReadV() instead.
+  virtual bool ReadMapped(uint64_t /* offset */, size_t /* length */, Slice* /* result */,
+                          std::shared_ptr<const FileMapping>* /* mapping */) const {
+    return false;
+  }
+
   // Returns the memory usage of this object including the object itself.
   virtual size_t memory_footprint() const = 0;
 };
 
+// The class of storage media backing a data directory. See
+// --fs_slow_data_dirs.
+enum class DataDirStorageClass {
+  // Low-latency media, e.g. SSDs. Directories are fast unless configured
+  // otherwise.
+  FAST,
+
+  // High-capacity, high-latency media, e.g. spinning disks.
+  SLOW,
+};
+
 // Provides options and hints for block placement. This is used for identifying
-// the correct DataDirGroups to place blocks. In the future this may also be
-// used to specify directories based on block type (e.g. to prefer bloom block
-// placement into SSD-backed directories).
+// the correct DataDirGroups to place blocks, and the preferred class of
+// directory within the group.
 struct CreateBlockOptions {
   const std::string tablet_id;
+
+  // Blocks are placed in a directory of this class if the tablet's group has
+  // one that is healthy and not full, and in any directory of the group
+  // otherwise. Defaults to FAST.
+  const DataDirStorageClass storage_class;
 };
 
 // Block manager creation options.
@@ -242,6 +282,15 @@ class BlockManager {
   virtual Status OpenBlock(const BlockId& block_id,
                            std::unique_ptr<ReadableBlock>* block) = 0;
 
+  // Like OpenBlock(), but for several blocks at once, e.g. all the blocks of
+  // a rowset. Implementations may open the underlying files in parallel; the
+  // default implementation opens the blocks one at a time.
+  //
+  // On success, 'blocks' holds the blocks in the order of 'block_ids'.
+  // Does not modify 'blocks' on error.
+  virtual Status OpenBlocks(const std::vector<BlockId>& block_ids,
+                            std::vector<std::unique_ptr<ReadableBlock>>* blocks);
+
   // Constructs a block creation transaction to group a set of block creation
   // operations and closes the registered blocks together.
   virtual std::unique_ptr<BlockCreationTransaction> NewCreationTransaction() = 0;
@@ -268,6 +317,11 @@ class BlockManager {
 
   // Exposes the FsErrorManager used to handle fs errors.
   virtual FsErrorManager* error_manager() = 0;
+
+  // Registers the block manager's background maintenance ops, if it has any,
+  // with 'maintenance_manager'. The ops are unregistered when the block
+  // manager is destroyed.
+  virtual void RegisterMaintenanceOps(MaintenanceManager* /* maintenance_manager */) {}
 };
 
 // Group a set of block creations together in a transaction. This has two
@@ -280,6 +334,8 @@ class BlockManager {
 // thread safety.
 class BlockCreationTransaction {
  public:
+  BlockCreationTransaction() : drop_cache_on_commit_(false) {}
+
   virtual ~BlockCreationTransaction() = default;
 
   // Add a block to the creation transaction.
@@ -288,6 +344,19 @@ class BlockCreationTransaction {
   // Commit all the created blocks and close them together.
   // On success, guarantees that outstanding data is durable.
   virtual Status CommitCreatedBlocks() = 0;
+
+  // If set, CommitCreatedBlocks() drops the blocks' data from the OS page
+  // cache once it's durable, for blocks which aren't expected to be read
+  // soon, e.g. the outputs of compactions. Defaults to false.
+  void set_drop_cache_on_commit(bool drop) { drop_cache_on_commit_ = drop; }
+
+ protected:
+  // Drops the data of the committed blocks 'block_ids' of 'block_manager'
+  // from the OS page cache. Failures are only logged.
+  static void DropCommittedBlocksFromCache(BlockManager* block_manager,
+                                           const std::vector<BlockId>& block_ids);
+
+  bool drop_cache_on_commit_;
 };
 
 // Group a set of block deletions together in a transaction. Similar to
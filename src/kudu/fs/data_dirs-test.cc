@@ -261,6 +261,62 @@ TEST_F(DataDirsTest, TestFailedDirNotAddedToGroup) {
   ASSERT_TRUE(s.IsIOError());
 }
 
+TEST_F(DataDirsTest, TestStorageClassPreference) {
+  // Reopen the directories, with the first two backed by slow media.
+  const vector<string> dirs = GetDirNames(kNumDirs);
+  DataDirManagerOptions opts;
+  opts.metric_entity = entity_;
+  opts.slow_data_roots = { dirs[0], dirs[1] };
+  dd_manager_.reset();
+  ASSERT_OK(DataDirManager::OpenExistingForTests(env_, dirs, std::move(opts), &dd_manager_));
+
+  FLAGS_fs_target_data_dirs_per_tablet = kNumDirs;
+  ASSERT_OK(dd_manager_->CreateDataDirGroup(test_tablet_name_));
+  ASSERT_TRUE(dd_manager_->GroupHasStorageClass(test_tablet_name_, DataDirStorageClass::FAST));
+  ASSERT_TRUE(dd_manager_->GroupHasStorageClass(test_tablet_name_, DataDirStorageClass::SLOW));
+
+  // Blocks go to directories of the requested class.
+  const CreateBlockOptions slow_opts({ test_tablet_name_, DataDirStorageClass::SLOW });
+  set<DataDir*> slow_dirs;
+  DataDir* dd;
+  for (int i = 0; i < 20; i++) {
+    ASSERT_OK(dd_manager_->GetNextDataDir(test_block_opts_, &dd));
+    ASSERT_EQ(DataDirStorageClass::FAST, dd->storage_class());
+    ASSERT_OK(dd_manager_->GetNextDataDir(slow_opts, &dd));
+    ASSERT_EQ(DataDirStorageClass::SLOW, dd->storage_class());
+    slow_dirs.insert(dd);
+  }
+  ASSERT_EQ(2, slow_dirs.size());
+
+  // Once no slow directory is usable, blocks fall back to the fast ones.
+  for (DataDir* slow_dir : slow_dirs) {
+    int uuid_idx;
+    ASSERT_TRUE(dd_manager_->FindUuidIndexByDataDir(slow_dir, &uuid_idx));
+    ASSERT_OK(dd_manager_->MarkDataDirFailed(uuid_idx));
+  }
+  ASSERT_FALSE(dd_manager_->GroupHasStorageClass(test_tablet_name_, DataDirStorageClass::SLOW));
+  ASSERT_OK(dd_manager_->GetNextDataDir(slow_opts, &dd));
+  ASSERT_EQ(DataDirStorageClass::FAST, dd->storage_class());
+}
+
+TEST_F(DataDirsTest, TestMmapDataDirs) {
+  // Reopen the directories, with the first one read through memory mappings.
+  const vector<string> dirs = GetDirNames(kNumDirs);
+  DataDirManagerOptions opts;
+  opts.metric_entity = entity_;
+  opts.mmap_data_roots = { dirs[0] };
+  dd_manager_.reset();
+  ASSERT_OK(DataDirManager::OpenExistingForTests(env_, dirs, std::move(opts), &dd_manager_));
+
+  int num_mmap_dirs = 0;
+  for (const auto& dd : dd_manager_->data_dirs()) {
+    if (dd->mmap_reads()) {
+      num_mmap_dirs++;
+    }
+  }
+  ASSERT_EQ(1, num_mmap_dirs);
+}
+
 TEST_F(DataDirsTest, TestLoadBalancingDistribution) {
   FLAGS_fs_target_data_dirs_per_tablet = 3;
   const double kNumTablets = 20;
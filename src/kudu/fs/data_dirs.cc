@@ -45,6 +45,7 @@
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/strings/join.h"
+#include "kudu/gutil/strings/split.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/env.h"
 #include "kudu/util/env_util.h"
@@ -89,6 +90,27 @@ DEFINE_int32(fs_data_dirs_full_disk_cache_seconds, 30,
 TAG_FLAG(fs_data_dirs_full_disk_cache_seconds, advanced);
 TAG_FLAG(fs_data_dirs_full_disk_cache_seconds, evolving);
 
+DEFINE_string(fs_slow_data_dirs, "",
+              "Comma-separated list of the directories in --fs_data_dirs that are "
+              "backed by slow media, e.g. spinning disks. Tablets write new data to "
+              "the remaining, fast directories while they have room, and move rowsets "
+              "that are no longer written or read to the slow ones. If empty, all "
+              "directories are considered fast.");
+TAG_FLAG(fs_slow_data_dirs, advanced);
+TAG_FLAG(fs_slow_data_dirs, experimental);
+
+DEFINE_string(fs_mmap_data_dirs, "",
+              "Comma-separated list of the directories in --fs_data_dirs whose blocks "
+              "are read through memory mappings rather than pread(). Uncompressed "
+              "CFile blocks in these directories are decoded straight out of the page "
+              "cache and aren't inserted into the block cache, so hot data isn't held "
+              "in memory twice. Compressed blocks are still cached once decompressed. "
+              "Best suited to low-latency media, e.g. NVMe drives, on servers with "
+              "plenty of page cache. An IO error while reading a mapped block crashes "
+              "the server rather than failing the directory.");
+TAG_FLAG(fs_mmap_data_dirs, advanced);
+TAG_FLAG(fs_mmap_data_dirs, experimental);
+
 DEFINE_bool(fs_lock_data_dirs, true,
             "Lock the data directories to prevent concurrent usage. "
             "Note that read-only concurrent usage is still allowed.");
@@ -197,12 +219,16 @@ DataDirMetrics::DataDirMetrics(const scoped_refptr<MetricEntity>& entity)
 DataDir::DataDir(Env* env,
                  DataDirMetrics* metrics,
                  DataDirFsType fs_type,
+                 DataDirStorageClass storage_class,
+                 bool mmap_reads,
                  string dir,
                  unique_ptr<PathInstanceMetadataFile> metadata_file,
                  unique_ptr<ThreadPool> pool)
     : env_(env),
       metrics_(metrics),
       fs_type_(fs_type),
+      storage_class_(storage_class),
+      mmap_reads_(mmap_reads),
       dir_(std::move(dir)),
       metadata_file_(std::move(metadata_file)),
       pool_(std::move(pool)),
@@ -283,7 +309,9 @@ Status DataDir::RefreshIsFull(RefreshMode mode) {
 DataDirManagerOptions::DataDirManagerOptions()
   : block_manager_type(FLAGS_block_manager),
     read_only(false),
-    update_on_disk(false) {}
+    update_on_disk(false),
+    slow_data_roots(strings::Split(FLAGS_fs_slow_data_dirs, ",", strings::SkipEmpty())),
+    mmap_data_roots(strings::Split(FLAGS_fs_mmap_data_dirs, ",", strings::SkipEmpty())) {}
 
 vector<string> DataDirManager::GetRootNames(const CanonicalizedRootsList& root_list) {
   vector<string> roots;
@@ -630,6 +658,25 @@ Status DataDirManager::Open() {
     DCHECK(missing_roots.empty());
   }
 
+  // Figure out which data directories are backed by slow media, and which
+  // are read through memory mappings. The roots are matched both verbatim
+  // and canonicalized, like the data roots may be.
+  const auto data_dirs_of_roots = [&](const vector<string>& roots, const char* kind) {
+    unordered_set<string> dirs;
+    for (const auto& root : roots) {
+      dirs.insert(JoinPathSegments(root, kDataDirName));
+      string canonicalized_root;
+      Status s = env_->Canonicalize(root, &canonicalized_root);
+      WARN_NOT_OK(s, Substitute("could not canonicalize $0 data root $1", kind, root));
+      if (s.ok()) {
+        dirs.insert(JoinPathSegments(canonicalized_root, kDataDirName));
+      }
+    }
+    return dirs;
+  };
+  const unordered_set<string> slow_data_dirs = data_dirs_of_roots(opts_.slow_data_roots, "slow");
+  const unordered_set<string> mmap_data_dirs = data_dirs_of_roots(opts_.mmap_data_roots, "mmap");
+
   // All instances are present and accounted for. Time to create the in-memory
   // data directory structures.
   int i = 0;
@@ -659,8 +706,12 @@ Status DataDirManager::Open() {
       }
     }
 
+    DataDirStorageClass storage_class = ContainsKey(slow_data_dirs, data_dir) ?
+        DataDirStorageClass::SLOW : DataDirStorageClass::FAST;
+
     unique_ptr<DataDir> dd(new DataDir(
-        env_, metrics_.get(), fs_type, data_dir, std::move(instance),
+        env_, metrics_.get(), fs_type, storage_class, ContainsKey(mmap_data_dirs, data_dir),
+        data_dir, std::move(instance),
         unique_ptr<ThreadPool>(pool.release())));
     dds.emplace_back(std::move(dd));
     i++;
@@ -869,15 +920,21 @@ Status DataDirManager::GetNextDataDir(const CreateBlockOptions& opts, DataDir**
   iota(random_indices.begin(), random_indices.end(), 0);
   shuffle(random_indices.begin(), random_indices.end(), default_random_engine(rng_.Next()));
 
-  // Randomly select a member of the group that is not full.
-  for (int i : random_indices) {
-    int uuid_idx = (*group_uuid_indices)[i];
-    DataDir* candidate = FindOrDie(data_dir_by_uuid_idx_, uuid_idx);
-    Status s = candidate->RefreshIsFull(DataDir::RefreshMode::EXPIRED_ONLY);
-    WARN_NOT_OK(s, Substitute("failed to refresh fullness of $0", candidate->dir()));
-    if (s.ok() && !candidate->is_full()) {
-      *dir = candidate;
-      return Status::OK();
+  // Randomly select a member of the group that is not full, first among the
+  // directories of the requested storage class and then among the rest.
+  for (bool matching_class : { true, false }) {
+    for (int i : random_indices) {
+      int uuid_idx = (*group_uuid_indices)[i];
+      DataDir* candidate = FindOrDie(data_dir_by_uuid_idx_, uuid_idx);
+      if ((candidate->storage_class() == opts.storage_class) != matching_class) {
+        continue;
+      }
+      Status s = candidate->RefreshIsFull(DataDir::RefreshMode::EXPIRED_ONLY);
+      WARN_NOT_OK(s, Substitute("failed to refresh fullness of $0", candidate->dir()));
+      if (s.ok() && !candidate->is_full()) {
+        *dir = candidate;
+        return Status::OK();
+      }
     }
   }
   string tablet_id_str = "";
@@ -894,6 +951,22 @@ Status DataDirManager::GetNextDataDir(const CreateBlockOptions& opts, DataDir**
                          "", ENOSPC);
 }
 
+bool DataDirManager::GroupHasStorageClass(const string& tablet_id,
+                                          DataDirStorageClass storage_class) const {
+  shared_lock<rw_spinlock> lock(dir_group_lock_.get_lock());
+  const DataDirGroup* group = FindOrNull(group_by_tablet_map_, tablet_id);
+  if (group == nullptr) {
+    return false;
+  }
+  for (int uuid_idx : group->uuid_indices()) {
+    if (!ContainsKey(failed_data_dirs_, uuid_idx) &&
+        FindOrDie(data_dir_by_uuid_idx_, uuid_idx)->storage_class() == storage_class) {
+      return true;
+    }
+  }
+  return false;
+}
+
 void DataDirManager::DeleteDataDirGroup(const std::string& tablet_id) {
   std::lock_guard<percpu_rwlock> lock(dir_group_lock_);
   DataDirGroup* group = FindOrNull(group_by_tablet_map_, tablet_id);
@@ -1029,6 +1102,15 @@ bool DataDirManager::IsTabletInFailedDir(const string& tablet_id) const {
   return false;
 }
 
+bool DataDirManager::IsBackgroundIOBacklogged() const {
+  for (const auto& dd : data_dirs_) {
+    if (dd->io_scheduler()->IsBacklogged()) {
+      return true;
+    }
+  }
+  return false;
+}
+
 void DataDirManager::RemoveUnhealthyDataDirsUnlocked(const vector<int>& uuid_indices,
                                                      vector<int>* healthy_indices) const {
   if (PREDICT_TRUE(failed_data_dirs_.empty())) {
@@ -29,7 +29,9 @@
 #include <glog/logging.h>
 #include <gtest/gtest_prod.h>
 
+#include "kudu/fs/block_manager.h"
 #include "kudu/fs/fs.pb.h"
+#include "kudu/fs/io_scheduler.h"
 #include "kudu/gutil/callback.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/gutil/macros.h"
@@ -61,7 +63,6 @@ typedef std::unordered_map<int, std::string> UuidByUuidIndexMap;
 typedef std::unordered_map<std::string, int> UuidIndexByUuidMap;
 
 class PathInstanceMetadataFile;
-struct CreateBlockOptions;
 
 const char kInstanceMetadataFileName[] = "block_manager_instance";
 const char kDataDirName[] = "data";
@@ -133,6 +134,8 @@ class DataDir {
   DataDir(Env* env,
           DataDirMetrics* metrics,
           DataDirFsType fs_type,
+          DataDirStorageClass storage_class,
+          bool mmap_reads,
           std::string dir,
           std::unique_ptr<PathInstanceMetadataFile> metadata_file,
           std::unique_ptr<ThreadPool> pool);
@@ -168,6 +171,12 @@ class DataDir {
 
   DataDirFsType fs_type() const { return fs_type_; }
 
+  DataDirStorageClass storage_class() const { return storage_class_; }
+
+  // Whether blocks in this directory are read through memory mappings. See
+  // --fs_mmap_data_dirs.
+  bool mmap_reads() const { return mmap_reads_; }
+
   const std::string& dir() const { return dir_; }
 
   const PathInstanceMetadataFile* instance() const {
@@ -179,10 +188,16 @@ class DataDir {
     return is_full_;
   }
 
+  // Admits block IO to this directory. See DataDirIOScheduler for details.
+  DataDirIOScheduler* io_scheduler() { return &io_scheduler_; }
+  const DataDirIOScheduler* io_scheduler() const { return &io_scheduler_; }
+
  private:
   Env* env_;
   DataDirMetrics* metrics_;
   const DataDirFsType fs_type_;
+  const DataDirStorageClass storage_class_;
+  const bool mmap_reads_;
   const std::string dir_;
   const std::unique_ptr<PathInstanceMetadataFile> metadata_file_;
   const std::unique_ptr<ThreadPool> pool_;
@@ -194,6 +209,8 @@ class DataDir {
   MonoTime last_check_is_full_;
   bool is_full_;
 
+  DataDirIOScheduler io_scheduler_;
+
   DISALLOW_COPY_AND_ASSIGN(DataDir);
 };
 
@@ -226,6 +243,17 @@ struct DataDirManagerOptions {
   //
   // Currently only supports adding new data directories.
   bool update_on_disk;
+
+  // The data roots that are backed by slow media. Any other root is
+  // considered fast.
+  //
+  // Defaults to the value of FLAGS_fs_slow_data_dirs.
+  std::vector<std::string> slow_data_roots;
+
+  // The data roots whose blocks are read through memory mappings.
+  //
+  // Defaults to the value of FLAGS_fs_mmap_data_dirs.
+  std::vector<std::string> mmap_data_roots;
 };
 
 // Encapsulates knowledge of data directory management on behalf of block
@@ -317,10 +345,16 @@ class DataDirManager {
   // false if none exist.
   bool GetDataDirGroupPB(const std::string& tablet_id, DataDirGroupPB* pb) const;
 
-  // Returns a random directory from the specfied option's data dir group. If
-  // there is no room in the group, returns an error.
+  // Returns a random directory from the specfied option's data dir group,
+  // preferring those of the option's storage class. If there is no room in
+  // the group, returns an error.
   Status GetNextDataDir(const CreateBlockOptions& opts, DataDir** dir);
 
+  // Returns whether the tablet's data dir group contains a healthy directory
+  // of the given storage class.
+  bool GroupHasStorageClass(const std::string& tablet_id,
+                            DataDirStorageClass storage_class) const;
+
   // Finds the set of tablet_ids in the data dir specified by 'uuid_idx' and
   // returns a copy, returning an empty set if none are found.
   std::set<std::string> FindTabletsByDataDirUuidIdx(int uuid_idx) const;
@@ -346,6 +380,10 @@ class DataDirManager {
   // Returns whether the tablet's data is spread across a failed directory.
   bool IsTabletInFailedDir(const std::string& tablet_id) const;
 
+  // Returns whether background IO to any of the data directories is being
+  // held back by its IO scheduler.
+  bool IsBackgroundIOBacklogged() const;
+
   const std::set<int> GetFailedDataDirs() const {
     shared_lock<rw_spinlock> group_lock(dir_group_lock_.get_lock());
     return failed_data_dirs_;
@@ -35,6 +35,7 @@
 #include "kudu/fs/data_dirs.h"
 #include "kudu/fs/error_manager.h"
 #include "kudu/fs/fs_report.h"
+#include "kudu/fs/io_scheduler.h"
 #include "kudu/gutil/bind.h"
 #include "kudu/gutil/casts.h"
 #include "kudu/gutil/integral_types.h"
@@ -49,6 +50,7 @@
 #include "kudu/util/env.h"
 #include "kudu/util/env_util.h"
 #include "kudu/util/file_cache.h"
+#include "kudu/util/logging.h"
 #include "kudu/util/malloc.h"
 #include "kudu/util/mem_tracker.h"
 #include "kudu/util/metrics.h"
@@ -339,16 +341,17 @@ Status FileWritableBlock::Append(const Slice& data) {
 
 Status FileWritableBlock::AppendV(ArrayView<const Slice> data) {
   DCHECK(state_ == CLEAN || state_ == DIRTY) << "Invalid state: " << state_;
-  RETURN_NOT_OK_HANDLE_ERROR(writer_->AppendV(data));
-  RETURN_NOT_OK_HANDLE_ERROR(location_.data_dir()->RefreshIsFull(
-      DataDir::RefreshMode::ALWAYS));
-  state_ = DIRTY;
 
-  // Calculate the amount of data written
+  // Calculate the amount of data to write
   size_t bytes_written = accumulate(data.begin(), data.end(), static_cast<size_t>(0),
                                     [&](int sum, const Slice& curr) {
                                       return sum + curr.size();
                                     });
+  location_.data_dir()->io_scheduler()->Admit(bytes_written);
+  RETURN_NOT_OK_HANDLE_ERROR(writer_->AppendV(data));
+  RETURN_NOT_OK_HANDLE_ERROR(location_.data_dir()->RefreshIsFull(
+      DataDir::RefreshMode::ALWAYS));
+  state_ = DIRTY;
   bytes_appended_ += bytes_written;
   return Status::OK();
 }
@@ -447,6 +450,13 @@ class FileReadableBlock : public ReadableBlock {
 
   virtual Status ReadV(uint64_t offset, ArrayView<Slice> results) const OVERRIDE;
 
+  virtual Status DropCache(uint64_t offset, size_t length) const OVERRIDE;
+
+  virtual Status Prefetch(uint64_t offset, size_t length) const OVERRIDE;
+
+  virtual bool ReadMapped(uint64_t offset, size_t length, Slice* result,
+                          shared_ptr<const FileMapping>* mapping) const OVERRIDE;
+
   virtual size_t memory_footprint() const OVERRIDE;
 
   void HandleError(const Status& s) const;
@@ -521,20 +531,64 @@ Status FileReadableBlock::Read(uint64_t offset, Slice result) const {
 Status FileReadableBlock::ReadV(uint64_t offset, ArrayView<Slice> results) const {
   DCHECK(!closed_.Load());
 
+  // Calculate the read amount of data
+  size_t bytes_read = accumulate(results.begin(), results.end(), static_cast<size_t>(0),
+                                 [&](int sum, const Slice& curr) {
+                                   return sum + curr.size();
+                                 });
+  DataDir* dir = block_manager_->dd_manager_->FindDataDirByUuidIndex(
+      internal::FileBlockLocation::GetDataDirIdx(block_id_));
+  if (dir) {
+    dir->io_scheduler()->Admit(bytes_read);
+  }
   RETURN_NOT_OK_HANDLE_ERROR(reader_->ReadV(offset, results));
 
   if (block_manager_->metrics_) {
-    // Calculate the read amount of data
-    size_t bytes_read = accumulate(results.begin(), results.end(), static_cast<size_t>(0),
-                                   [&](int sum, const Slice& curr) {
-                                     return sum + curr.size();
-                                   });
     block_manager_->metrics_->total_bytes_read->IncrementBy(bytes_read);
   }
 
   return Status::OK();
 }
 
+Status FileReadableBlock::DropCache(uint64_t offset, size_t length) const {
+  DCHECK(!closed_.Load());
+
+  RETURN_NOT_OK_HANDLE_ERROR(reader_->DropCache(offset, length));
+  return Status::OK();
+}
+
+Status FileReadableBlock::Prefetch(uint64_t offset, size_t length) const {
+  DCHECK(!closed_.Load());
+
+  RETURN_NOT_OK_HANDLE_ERROR(reader_->Prefetch(offset, length));
+  return Status::OK();
+}
+
+bool FileReadableBlock::ReadMapped(uint64_t offset, size_t length, Slice* result,
+                                   shared_ptr<const FileMapping>* mapping) const {
+  DCHECK(!closed_.Load());
+
+  const DataDir* dir = block_manager_->dd_manager_->FindDataDirByUuidIndex(
+      internal::FileBlockLocation::GetDataDirIdx(block_id_));
+  if (!dir || !dir->mmap_reads()) {
+    return false;
+  }
+  // The file cache keeps the mapping of each file, so this only maps the
+  // file on the first call.
+  Status s = reader_->Mmap(offset + length, mapping);
+  if (!s.ok()) {
+    HandleError(s);
+    KLOG_EVERY_N_SECS(WARNING, 60) << Substitute("could not map block $0: $1",
+                                                 id().ToString(), s.ToString());
+    return false;
+  }
+  *result = Slice((*mapping)->data() + offset, length);
+  if (block_manager_->metrics_) {
+    block_manager_->metrics_->total_bytes_read->IncrementBy(length);
+  }
+  return true;
+}
+
 size_t FileReadableBlock::memory_footprint() const {
   DCHECK(reader_);
   return kudu_malloc_usable_size(this) + reader_->memory_footprint();
@@ -584,6 +638,14 @@ Status FileBlockCreationTransaction::CommitCreatedBlocks() {
   for (const auto& block : created_blocks_) {
     RETURN_NOT_OK(block->Close());
   }
+  if (drop_cache_on_commit_) {
+    vector<BlockId> block_ids;
+    block_ids.reserve(created_blocks_.size());
+    for (const auto& block : created_blocks_) {
+      block_ids.emplace_back(block->id());
+    }
+    DropCommittedBlocksFromCache(created_blocks_.front()->block_manager(), block_ids);
+  }
   created_blocks_.clear();
   return Status::OK();
 }
@@ -822,6 +884,33 @@ Status FileBlockManager::OpenBlock(const BlockId& block_id,
   return Status::OK();
 }
 
+Status FileBlockManager::OpenBlocks(const vector<BlockId>& block_ids,
+                                    vector<unique_ptr<ReadableBlock>>* blocks) {
+  vector<string> paths(block_ids.size());
+  for (int i = 0; i < block_ids.size(); i++) {
+    if (!FindBlockPath(block_ids[i], &paths[i])) {
+      return Status::NotFound(
+          Substitute("Block $0 not found", block_ids[i].ToString()));
+    }
+  }
+
+  // Open the block files in parallel through the file cache.
+  vector<shared_ptr<RandomAccessFile>> readers;
+  if (!file_cache_.OpenExistingFiles(paths, &readers).ok()) {
+    // Open the blocks one at a time to attribute the failure to the right
+    // block and data directory.
+    return BlockManager::OpenBlocks(block_ids, blocks);
+  }
+  vector<unique_ptr<ReadableBlock>> opened;
+  opened.reserve(block_ids.size());
+  for (int i = 0; i < block_ids.size(); i++) {
+    opened.emplace_back(new internal::FileReadableBlock(this, block_ids[i],
+                                                        std::move(readers[i])));
+  }
+  *blocks = std::move(opened);
+  return Status::OK();
+}
+
 Status FileBlockManager::DeleteBlock(const BlockId& block_id) {
   CHECK(!opts_.read_only);
 
@@ -88,6 +88,9 @@ class FileBlockManager : public BlockManager {
   Status OpenBlock(const BlockId& block_id,
                    std::unique_ptr<ReadableBlock>* block) override;
 
+  Status OpenBlocks(const std::vector<BlockId>& block_ids,
+                    std::vector<std::unique_ptr<ReadableBlock>>* blocks) override;
+
   std::unique_ptr<BlockCreationTransaction> NewCreationTransaction() override;
 
   std::shared_ptr<BlockDeletionTransaction> NewDeletionTransaction() override;
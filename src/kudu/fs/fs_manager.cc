@@ -123,6 +123,7 @@ const char *FsManager::kDataDirName = "data";
 const char *FsManager::kCorruptedSuffix = ".corrupted";
 const char *FsManager::kInstanceMetadataFileName = "instance";
 const char *FsManager::kConsensusMetadataDirName = "consensus-meta";
+const char *FsManager::kBlockCacheSnapshotFileName = "block-cache-snapshot";
 
 FsManagerOpts::FsManagerOpts()
   : wal_root(FLAGS_fs_wal_dir),
@@ -714,6 +715,11 @@ Status FsManager::OpenBlock(const BlockId& block_id, unique_ptr<ReadableBlock>*
   return block_manager_->OpenBlock(block_id, block);
 }
 
+Status FsManager::OpenBlocks(const vector<BlockId>& block_ids,
+                             vector<unique_ptr<ReadableBlock>>* blocks) {
+  return block_manager_->OpenBlocks(block_ids, blocks);
+}
+
 bool FsManager::BlockExists(const BlockId& block_id) const {
   unique_ptr<ReadableBlock> block;
   return block_manager_->OpenBlock(block_id, &block).ok();
@@ -175,6 +175,10 @@ class FsManager {
   Status OpenBlock(const BlockId& block_id,
                    std::unique_ptr<fs::ReadableBlock>* block);
 
+  // Opens several blocks at once. See BlockManager::OpenBlocks().
+  Status OpenBlocks(const std::vector<BlockId>& block_ids,
+                    std::vector<std::unique_ptr<fs::ReadableBlock>>* blocks);
+
   Status DeleteBlock(const BlockId& block_id);
 
   bool BlockExists(const BlockId& block_id) const;
@@ -221,6 +225,13 @@ class FsManager {
     return JoinPathSegments(GetConsensusMetadataDir(), tablet_id);
   }
 
+  // Return the path where the hottest blocks of the block cache are
+  // persisted across restarts.
+  std::string GetBlockCacheSnapshotPath() const {
+    DCHECK(initted_);
+    return JoinPathSegments(canonicalized_metadata_fs_root_.path, kBlockCacheSnapshotFileName);
+  }
+
   Env* env() { return env_; }
 
   bool read_only() const {
@@ -305,6 +316,7 @@ class FsManager {
   static const char *kInstanceMetadataMagicNumber;
   static const char *kTabletSuperBlockMagicNumber;
   static const char *kConsensusMetadataDirName;
+  static const char *kBlockCacheSnapshotFileName;
 
   // The environment to be used for all filesystem operations.
   Env* env_;
@@ -0,0 +1,91 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/fs/io_scheduler.h"
+
+#include <cstdint>
+
+#include <gflags/gflags_declare.h>
+#include <gtest/gtest.h>
+
+#include "kudu/util/monotime.h"
+#include "kudu/util/test_util.h"
+
+DECLARE_int64(fs_io_compaction_bytes_per_sec);
+DECLARE_int64(fs_io_flush_iops_per_sec);
+
+namespace kudu {
+namespace fs {
+
+class IOSchedulerTest : public KuduTest {
+};
+
+TEST_F(IOSchedulerTest, TestPriorityScopes) {
+  ASSERT_EQ(IOPriority::FOREGROUND, ScopedIOPriority::Current());
+  {
+    ScopedIOPriority p1(IOPriority::COMPACTION);
+    ASSERT_EQ(IOPriority::COMPACTION, ScopedIOPriority::Current());
+    {
+      ScopedIOPriority p2(IOPriority::TABLET_COPY);
+      ASSERT_EQ(IOPriority::TABLET_COPY, ScopedIOPriority::Current());
+    }
+    ASSERT_EQ(IOPriority::COMPACTION, ScopedIOPriority::Current());
+  }
+  ASSERT_EQ(IOPriority::FOREGROUND, ScopedIOPriority::Current());
+}
+
+// Test that only the configured IO class is throttled.
+TEST_F(IOSchedulerTest, TestThrottleBandwidth) {
+  const int64_t kBytesPerSec = 1024 * 1024;
+  FLAGS_fs_io_compaction_bytes_per_sec = kBytesPerSec;
+  DataDirIOScheduler scheduler;
+
+  // Foreground and flush IO aren't throttled.
+  MonoTime start = MonoTime::Now();
+  scheduler.Admit(100 * kBytesPerSec);
+  {
+    ScopedIOPriority p(IOPriority::FLUSH);
+    scheduler.Admit(100 * kBytesPerSec);
+  }
+  ASSERT_LT(MonoTime::Now() - start, MonoDelta::FromMilliseconds(100));
+  ASSERT_FALSE(scheduler.IsBacklogged());
+
+  // Compaction IO is. Each refill period admits a tenth of the rate, so half
+  // a second's worth of bytes takes at least four more periods, even though
+  // it's more than the throttler can hold at once.
+  ScopedIOPriority p(IOPriority::COMPACTION);
+  start = MonoTime::Now();
+  scheduler.Admit(kBytesPerSec / 2);
+  ASSERT_GE(MonoTime::Now() - start, MonoDelta::FromMilliseconds(300));
+  ASSERT_TRUE(scheduler.IsBacklogged());
+}
+
+TEST_F(IOSchedulerTest, TestThrottleIOPS) {
+  FLAGS_fs_io_flush_iops_per_sec = 10;
+  DataDirIOScheduler scheduler;
+
+  ScopedIOPriority p(IOPriority::FLUSH);
+  MonoTime start = MonoTime::Now();
+  for (int i = 0; i < 5; i++) {
+    scheduler.Admit(1);
+  }
+  ASSERT_GE(MonoTime::Now() - start, MonoDelta::FromMilliseconds(300));
+  ASSERT_TRUE(scheduler.IsBacklogged());
+}
+
+} // namespace fs
+} // namespace kudu
@@ -0,0 +1,189 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/fs/io_scheduler.h"
+
+#include <algorithm>
+#include <ostream>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "kudu/gutil/walltime.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/throttler.h"
+#include "kudu/util/trace.h"
+
+DEFINE_int64(fs_io_flush_bytes_per_sec, 0,
+             "Maximum number of bytes per second that flushes may read from "
+             "or write to each data directory. 0 means no limit.");
+TAG_FLAG(fs_io_flush_bytes_per_sec, experimental);
+
+DEFINE_int64(fs_io_flush_iops_per_sec, 0,
+             "Maximum number of IO operations per second that flushes may "
+             "perform on each data directory. 0 means no limit.");
+TAG_FLAG(fs_io_flush_iops_per_sec, experimental);
+
+DEFINE_int64(fs_io_compaction_bytes_per_sec, 0,
+             "Maximum number of bytes per second that compactions may read "
+             "from or write to each data directory. 0 means no limit.");
+TAG_FLAG(fs_io_compaction_bytes_per_sec, experimental);
+
+DEFINE_int64(fs_io_compaction_iops_per_sec, 0,
+             "Maximum number of IO operations per second that compactions may "
+             "perform on each data directory. 0 means no limit.");
+TAG_FLAG(fs_io_compaction_iops_per_sec, experimental);
+
+DEFINE_int64(fs_io_tablet_copy_bytes_per_sec, 0,
+             "Maximum number of bytes per second that tablet copies may read "
+             "from or write to each data directory. 0 means no limit.");
+TAG_FLAG(fs_io_tablet_copy_bytes_per_sec, experimental);
+
+DEFINE_int64(fs_io_tablet_copy_iops_per_sec, 0,
+             "Maximum number of IO operations per second that tablet copies "
+             "may perform on each data directory. 0 means no limit.");
+TAG_FLAG(fs_io_tablet_copy_iops_per_sec, experimental);
+
+DEFINE_double(fs_io_throttle_burst_factor, 1.0,
+              "Burst factor for background IO throttling. The maximum amount "
+              "of IO a throttled IO class may perform within a refill period "
+              "of the throttler is its rate limit multiplied by this factor.");
+TAG_FLAG(fs_io_throttle_burst_factor, experimental);
+
+namespace kudu {
+namespace fs {
+
+namespace {
+
+// The IO priority of the current thread.
+__thread IOPriority tls_io_priority = IOPriority::FOREGROUND;
+
+// How long a data directory is considered backlogged after a thread last
+// waited for its throttle.
+const int64_t kBacklogWindowMicros = 1000 * 1000;
+
+// How long a thread waiting for a throttle sleeps between attempts.
+const int64_t kWaitMicros = Throttler::kRefillPeriodMicros / 10;
+
+} // anonymous namespace
+
+const char* IOPriorityToString(IOPriority priority) {
+  switch (priority) {
+    case IOPriority::FOREGROUND: return "foreground";
+    case IOPriority::FLUSH: return "flush";
+    case IOPriority::COMPACTION: return "compaction";
+    case IOPriority::TABLET_COPY: return "tablet copy";
+  }
+  LOG(FATAL) << "Unknown IO priority: " << static_cast<int>(priority);
+  return "";
+}
+
+ScopedIOPriority::ScopedIOPriority(IOPriority priority)
+    : prev_(tls_io_priority) {
+  tls_io_priority = priority;
+}
+
+ScopedIOPriority::~ScopedIOPriority() {
+  tls_io_priority = prev_;
+}
+
+IOPriority ScopedIOPriority::Current() {
+  return tls_io_priority;
+}
+
+DataDirIOScheduler::DataDirIOScheduler()
+    : num_waiters_(0),
+      last_wait_end_micros_(0) {
+  struct {
+    IOPriority priority;
+    int64_t bytes_per_sec;
+    int64_t iops_per_sec;
+  } limits[] = {
+    { IOPriority::FLUSH,
+      FLAGS_fs_io_flush_bytes_per_sec, FLAGS_fs_io_flush_iops_per_sec },
+    { IOPriority::COMPACTION,
+      FLAGS_fs_io_compaction_bytes_per_sec, FLAGS_fs_io_compaction_iops_per_sec },
+    { IOPriority::TABLET_COPY,
+      FLAGS_fs_io_tablet_copy_bytes_per_sec, FLAGS_fs_io_tablet_copy_iops_per_sec },
+  };
+  const MonoTime now = MonoTime::Now();
+  for (const auto& l : limits) {
+    ClassThrottle* t = &throttles_[static_cast<int>(l.priority)];
+    t->max_bytes_per_take = 0;
+    const uint64_t bytes_per_sec = std::max<int64_t>(l.bytes_per_sec, 0);
+    const uint64_t iops_per_sec = std::max<int64_t>(l.iops_per_sec, 0);
+    if (bytes_per_sec == 0 && iops_per_sec == 0) {
+      continue;
+    }
+    t->throttler.reset(new Throttler(now, iops_per_sec, bytes_per_sec,
+                                     FLAGS_fs_io_throttle_burst_factor));
+
+    // The throttler never holds more than a refill period's worth of byte
+    // tokens (times the burst factor), so larger IOs must be admitted piece
+    // by piece.
+    const uint64_t refill_bytes = bytes_per_sec /
+        (MonoTime::kMicrosecondsPerSecond / Throttler::kRefillPeriodMicros);
+    t->max_bytes_per_take = static_cast<uint64_t>(
+        refill_bytes * FLAGS_fs_io_throttle_burst_factor);
+  }
+}
+
+DataDirIOScheduler::~DataDirIOScheduler() {}
+
+void DataDirIOScheduler::Admit(uint64_t bytes) {
+  const ClassThrottle& t = throttles_[static_cast<int>(ScopedIOPriority::Current())];
+  if (!t.throttler) {
+    return;
+  }
+
+  uint64_t ops = 1;
+  MicrosecondsInt64 wait_start = 0;
+  do {
+    const uint64_t take = t.max_bytes_per_take == 0 ?
+        bytes : std::min(bytes, t.max_bytes_per_take);
+    if (t.throttler->Take(MonoTime::Now(), ops, take)) {
+      bytes -= take;
+      ops = 0;
+      continue;
+    }
+    if (wait_start == 0) {
+      wait_start = GetMonoTimeMicros();
+      num_waiters_.Increment();
+    }
+    SleepFor(MonoDelta::FromMicroseconds(kWaitMicros));
+  } while (ops > 0 || bytes > 0);
+
+  if (wait_start != 0) {
+    const MicrosecondsInt64 wait_end = GetMonoTimeMicros();
+    last_wait_end_micros_.StoreMax(wait_end);
+    num_waiters_.IncrementBy(-1);
+    TRACE_COUNTER_INCREMENT("io_throttle_wait_us", wait_end - wait_start);
+  }
+}
+
+bool DataDirIOScheduler::IsBacklogged() const {
+  if (num_waiters_.Load() > 0) {
+    return true;
+  }
+  const int64_t last_wait_end = last_wait_end_micros_.Load();
+  return last_wait_end != 0 &&
+      GetMonoTimeMicros() - last_wait_end < kBacklogWindowMicros;
+}
+
+} // namespace fs
+} // namespace kudu
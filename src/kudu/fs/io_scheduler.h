@@ -0,0 +1,114 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/util/atomic.h"
+
+namespace kudu {
+
+class Throttler;
+
+namespace fs {
+
+// The class of work on whose behalf a thread performs block IO.
+//
+// Foreground IO (e.g. scans and writes on behalf of clients) is never
+// throttled. Each background class is throttled independently on every data
+// directory, as configured by the --fs_io_<class>_{bytes,iops}_per_sec flags.
+enum class IOPriority {
+  FOREGROUND,
+  FLUSH,
+  COMPACTION,
+  TABLET_COPY,
+};
+
+const int kNumIOPriorities = static_cast<int>(IOPriority::TABLET_COPY) + 1;
+
+const char* IOPriorityToString(IOPriority priority);
+
+// Sets the IO priority of the calling thread for the lifetime of the object,
+// restoring the previous priority when destroyed. Scopes may be nested.
+//
+// Example:
+//
+//   {
+//     ScopedIOPriority p(IOPriority::COMPACTION);
+//     RETURN_NOT_OK(tablet->Compact(...));
+//   }
+class ScopedIOPriority {
+ public:
+  explicit ScopedIOPriority(IOPriority priority);
+  ~ScopedIOPriority();
+
+  // Returns the IO priority of the calling thread.
+  static IOPriority Current();
+
+ private:
+  const IOPriority prev_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedIOPriority);
+};
+
+// Admits block IO to a single data directory, throttling the background IO
+// classes so that they can't crowd out foreground IO on the same disk.
+//
+// Thread-safe.
+class DataDirIOScheduler {
+ public:
+  // Configures the throttling of each IO class from the current values of
+  // the --fs_io_* flags.
+  DataDirIOScheduler();
+  ~DataDirIOScheduler();
+
+  // Blocks until the calling thread may perform one IO operation of 'bytes'
+  // bytes at its current IO priority.
+  void Admit(uint64_t bytes);
+
+  // Returns true if background IO to this directory is being held back by
+  // its throttle, i.e. if a thread is currently waiting in Admit() or has
+  // waited in the last second. Callers that schedule background work may use
+  // this to avoid queuing more of it.
+  bool IsBacklogged() const;
+
+ private:
+  struct ClassThrottle {
+    std::unique_ptr<Throttler> throttler;
+
+    // The largest number of bytes that may be taken from 'throttler' at
+    // once, or 0 if the class's bandwidth isn't throttled.
+    uint64_t max_bytes_per_take;
+  };
+
+  // Indexed by IOPriority. The throttler of unthrottled classes is null.
+  ClassThrottle throttles_[kNumIOPriorities];
+
+  // The number of threads waiting in Admit().
+  AtomicInt<int32_t> num_waiters_;
+
+  // The last time (in monotonic microseconds) a thread stopped waiting in
+  // Admit().
+  AtomicInt<int64_t> last_wait_end_micros_;
+
+  DISALLOW_COPY_AND_ASSIGN(DataDirIOScheduler);
+};
+
+} // namespace fs
+} // namespace kudu
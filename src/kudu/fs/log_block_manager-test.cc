@@ -20,6 +20,7 @@
 #include <cstdlib>
 #include <cstring>
 #include <deque>
+#include <limits>
 #include <memory>
 #include <ostream>
 #include <set>
@@ -75,10 +76,13 @@ using strings::Substitute;
 
 DECLARE_bool(cache_force_single_shard);
 DECLARE_bool(crash_on_eio);
+DECLARE_bool(log_block_manager_delete_dead_containers);
 DECLARE_double(env_inject_eio);
 DECLARE_double(log_container_excess_space_before_cleanup_fraction);
+DECLARE_double(log_container_live_data_before_compact_ratio);
 DECLARE_double(log_container_live_metadata_before_compact_ratio);
 DECLARE_int64(block_manager_max_open_files);
+DECLARE_int64(log_block_manager_checkpoint_interval_records);
 DECLARE_int64(log_container_max_blocks);
 DECLARE_string(block_manager_preflush_control);
 DECLARE_string(env_inject_eio_globs);
@@ -87,6 +91,7 @@ DECLARE_uint64(log_container_max_size);
 
 // Block manager metrics.
 METRIC_DECLARE_counter(block_manager_total_blocks_deleted);
+METRIC_DECLARE_counter(block_manager_total_disk_sync);
 
 // Log block manager metrics.
 METRIC_DECLARE_gauge_uint64(log_block_manager_bytes_under_management);
@@ -94,6 +99,7 @@ METRIC_DECLARE_gauge_uint64(log_block_manager_blocks_under_management);
 METRIC_DECLARE_counter(log_block_manager_holes_punched);
 METRIC_DECLARE_gauge_uint64(log_block_manager_containers);
 METRIC_DECLARE_gauge_uint64(log_block_manager_full_containers);
+METRIC_DECLARE_counter(log_block_manager_dead_containers_deleted);
 
 namespace kudu {
 namespace fs {
@@ -992,6 +998,51 @@ TEST_F(LogBlockManagerTest, StartupBenchmark) {
 }
 #endif
 
+// Tests that committing a transaction syncs each of its containers once,
+// however many blocks they hold, and that the metadata of all of its blocks
+// makes it to disk.
+TEST_F(LogBlockManagerTest, TestGroupCommit) {
+  MetricRegistry registry;
+  scoped_refptr<MetricEntity> entity = METRIC_ENTITY_server.Instantiate(&registry, "test");
+  ASSERT_OK(ReopenBlockManager(entity));
+
+  // Write to several containers at once, with several blocks each.
+  const int kNumContainers = 3;
+  const int kNumBlocksPerContainer = 10;
+  unique_ptr<BlockCreationTransaction> transaction = bm_->NewCreationTransaction();
+  vector<BlockId> created_blocks;
+  for (int i = 0; i < kNumBlocksPerContainer; i++) {
+    vector<unique_ptr<WritableBlock>> blocks;
+    for (int j = 0; j < kNumContainers; j++) {
+      unique_ptr<WritableBlock> block;
+      ASSERT_OK(bm_->CreateBlock(test_block_opts_, &block));
+      ASSERT_OK(block->Append("x"));
+      blocks.emplace_back(std::move(block));
+    }
+    for (auto& block : blocks) {
+      ASSERT_OK(block->Finalize());
+      created_blocks.push_back(block->id());
+      transaction->AddCreatedBlock(std::move(block));
+    }
+  }
+  ASSERT_EQ(kNumContainers, bm_->all_containers_by_name_.size());
+
+  // Each container's data and metadata are synced once, and the directory
+  // holding the new containers is synced once.
+  ASSERT_OK(transaction->CommitCreatedBlocks());
+  NO_FATALS(CheckCounterMetric(entity, 2 * kNumContainers + 1,
+                               &METRIC_block_manager_total_disk_sync));
+
+  ASSERT_OK(ReopenBlockManager());
+  vector<BlockId> block_ids;
+  ASSERT_OK(bm_->GetAllBlockIds(&block_ids));
+  ASSERT_EQ(created_blocks.size(), block_ids.size());
+  for (const auto& id : created_blocks) {
+    unique_ptr<ReadableBlock> block;
+    ASSERT_OK(bm_->OpenBlock(id, &block));
+  }
+}
+
 TEST_F(LogBlockManagerTest, TestFailMultipleTransactionsPerContainer) {
   // Create multiple transactions that will share a container.
   const int kNumTransactions = 3;
@@ -1477,6 +1528,160 @@ TEST_F(LogBlockManagerTest, TestDeleteDeadContainersAtStartup) {
   ASSERT_FALSE(env_->FileExists(metadata_file_name));
 }
 
+// Tests that with --log_block_manager_delete_dead_containers, a full container
+// is deleted as soon as all of its blocks are deleted and no longer read.
+TEST_F(LogBlockManagerTest, TestDeleteDeadContainersAtRuntime) {
+  FLAGS_log_block_manager_delete_dead_containers = true;
+  FLAGS_log_container_max_blocks = 4;
+  MetricRegistry registry;
+  scoped_refptr<MetricEntity> entity = METRIC_ENTITY_server.Instantiate(&registry, "test");
+  ASSERT_OK(ReopenBlockManager(entity));
+
+  // Fill two containers.
+  vector<BlockId> first_container_ids;
+  vector<BlockId> second_container_ids;
+  for (int i = 0; i < 2 * FLAGS_log_container_max_blocks; i++) {
+    unique_ptr<WritableBlock> block;
+    ASSERT_OK(bm_->CreateBlock(test_block_opts_, &block));
+    ASSERT_OK(block->Append("data"));
+    ASSERT_OK(block->Close());
+    (i < FLAGS_log_container_max_blocks ? first_container_ids : second_container_ids)
+        .emplace_back(block->id());
+  }
+  NO_FATALS(AssertNumContainers(2));
+
+  auto wait_for_closures = [&]() {
+    for (const auto& data_dir : dd_manager_->data_dirs()) {
+      data_dir->WaitOnClosures();
+    }
+  };
+  auto delete_blocks = [&](const vector<BlockId>& ids) {
+    shared_ptr<BlockDeletionTransaction> deletion_transaction =
+        bm_->NewDeletionTransaction();
+    for (const auto& id : ids) {
+      deletion_transaction->AddDeletedBlock(id);
+    }
+    vector<BlockId> deleted;
+    ASSERT_OK(deletion_transaction->CommitDeletedBlocks(&deleted));
+    ASSERT_EQ(ids.size(), deleted.size());
+  };
+
+  // Deleting some of the blocks of a container leaves it alone.
+  NO_FATALS(delete_blocks({ second_container_ids[0] }));
+  wait_for_closures();
+  NO_FATALS(AssertNumContainers(2));
+
+  // Delete all of the blocks of the first container, while one of them is
+  // still being read. The container is kept until the reader is done.
+  unique_ptr<ReadableBlock> open_block;
+  ASSERT_OK(bm_->OpenBlock(first_container_ids[0], &open_block));
+  NO_FATALS(delete_blocks(first_container_ids));
+  wait_for_closures();
+  NO_FATALS(AssertNumContainers(2));
+  uint64_t size;
+  ASSERT_OK(open_block->Size(&size));
+  ASSERT_EQ(4, size);
+  open_block.reset();
+  wait_for_closures();
+  NO_FATALS(AssertNumContainers(1));
+  NO_FATALS(CheckLogMetrics(entity,
+      { {3, &METRIC_log_block_manager_blocks_under_management},
+        {1, &METRIC_log_block_manager_containers},
+        {1, &METRIC_log_block_manager_full_containers} },
+      { {1, &METRIC_log_block_manager_dead_containers_deleted},
+        {5, &METRIC_block_manager_total_blocks_deleted} }));
+
+  // The remaining blocks survive a restart, and nothing is left of the
+  // deleted container.
+  FsReport report;
+  ASSERT_OK(ReopenBlockManager(nullptr, &report));
+  ASSERT_TRUE(report.incomplete_container_check->entries.empty());
+  vector<BlockId> block_ids;
+  ASSERT_OK(bm_->GetAllBlockIds(&block_ids));
+  ASSERT_EQ(3, block_ids.size());
+  NO_FATALS(AssertNumContainers(1));
+}
+
+// Tests that the live blocks of sparse full containers are moved to another
+// container, that readers of the moved blocks are unaffected, and that the
+// emptied containers are deleted at startup.
+TEST_F(LogBlockManagerTest, TestContainerCompaction) {
+  FLAGS_log_container_live_data_before_compact_ratio = 0.50;
+  FLAGS_log_container_max_blocks = 4;
+  ASSERT_OK(ReopenBlockManager());
+
+  // Fill three containers, then delete all but one block of each.
+  const int kNumContainers = 3;
+  vector<std::pair<BlockId, string>> live;
+  vector<BlockId> dead;
+  for (int i = 0; i < kNumContainers * FLAGS_log_container_max_blocks; i++) {
+    const string data = Substitute("block $0", i);
+    unique_ptr<WritableBlock> block;
+    ASSERT_OK(bm_->CreateBlock(test_block_opts_, &block));
+    ASSERT_OK(block->Append(data));
+    ASSERT_OK(block->Close());
+    if (i % FLAGS_log_container_max_blocks == 0) {
+      live.emplace_back(block->id(), data);
+    } else {
+      dead.emplace_back(block->id());
+    }
+  }
+  NO_FATALS(AssertNumContainers(kNumContainers));
+  {
+    shared_ptr<BlockDeletionTransaction> deletion_transaction =
+        bm_->NewDeletionTransaction();
+    for (const auto& id : dead) {
+      deletion_transaction->AddDeletedBlock(id);
+    }
+    vector<BlockId> deleted;
+    ASSERT_OK(deletion_transaction->CommitDeletedBlocks(&deleted));
+  }
+
+  auto check_block = [&](const ReadableBlock& block, const string& data) {
+    uint64_t size;
+    ASSERT_OK(block.Size(&size));
+    ASSERT_EQ(data.size(), size);
+    unique_ptr<uint8_t[]> buf(new uint8_t[size]);
+    Slice result(buf.get(), size);
+    ASSERT_OK(block.Read(0, result));
+    ASSERT_EQ(data, result.ToString());
+  };
+  auto check_live_blocks = [&]() {
+    vector<BlockId> block_ids;
+    ASSERT_OK(bm_->GetAllBlockIds(&block_ids));
+    ASSERT_EQ(live.size(), block_ids.size());
+    for (const auto& e : live) {
+      unique_ptr<ReadableBlock> block;
+      ASSERT_OK(bm_->OpenBlock(e.first, &block));
+      NO_FATALS(check_block(*block, e.second));
+    }
+  };
+
+  // Keep one of the blocks open for reading while it's moved.
+  unique_ptr<ReadableBlock> open_block;
+  ASSERT_OK(bm_->OpenBlock(live[0].first, &open_block));
+
+  vector<internal::LogBlockContainer*> sparse_containers;
+  int64_t num_containers;
+  bm_->FindSparseContainers(&sparse_containers, &num_containers);
+  ASSERT_EQ(kNumContainers, sparse_containers.size());
+  ASSERT_EQ(kNumContainers, num_containers);
+  ASSERT_OK(bm_->CompactContainers(std::numeric_limits<int64_t>::max()));
+
+  // The live blocks have all been moved to one new container.
+  bm_->FindSparseContainers(&sparse_containers, &num_containers);
+  ASSERT_TRUE(sparse_containers.empty());
+  ASSERT_EQ(kNumContainers + 1, num_containers);
+  NO_FATALS(check_block(*open_block, live[0].second));
+  open_block.reset();
+  NO_FATALS(check_live_blocks());
+
+  // The emptied containers are deleted at startup.
+  ASSERT_OK(ReopenBlockManager());
+  NO_FATALS(AssertNumContainers(1));
+  NO_FATALS(check_live_blocks());
+}
+
 TEST_F(LogBlockManagerTest, TestCompactFullContainerMetadataAtStartup) {
   // With this ratio, the metadata of a full container comprised of half dead
   // blocks will be compacted at startup.
@@ -1730,5 +1935,83 @@ TEST_F(LogBlockManagerTest, TestAbortBlock) {
   ASSERT_EQ(1, bm_->available_containers_by_data_dir_.begin()->second.size());
 }
 
+// Tests that the block map checkpoint written at startup, and refreshed as
+// metadata records are appended, yields the same set of blocks on the next
+// startup as a full replay of the container metadata would.
+TEST_F(LogBlockManagerTest, TestBlockMapCheckpoint) {
+  // Refresh the checkpoint frequently while the blocks are written.
+  FLAGS_log_block_manager_checkpoint_interval_records = 5;
+
+  const string checkpoint_path = JoinPathSegments(
+      dd_manager_->GetDataDirs()[0], LogBlockManager::kBlockMapCheckpointFileName);
+  ASSERT_TRUE(env_->FileExists(checkpoint_path));
+
+  auto create_blocks = [&](int num_blocks, vector<BlockId>* ids) {
+    for (int i = 0; i < num_blocks; i++) {
+      unique_ptr<WritableBlock> writer;
+      ASSERT_OK(bm_->CreateBlock(test_block_opts_, &writer));
+      ASSERT_OK(writer->Append("test data"));
+      ASSERT_OK(writer->Close());
+      ids->push_back(writer->id());
+    }
+  };
+  auto delete_blocks = [&](const vector<BlockId>& ids) {
+    shared_ptr<BlockDeletionTransaction> deletion_transaction =
+        bm_->NewDeletionTransaction();
+    for (const auto& id : ids) {
+      deletion_transaction->AddDeletedBlock(id);
+    }
+    vector<BlockId> deleted;
+    ASSERT_OK(deletion_transaction->CommitDeletedBlocks(&deleted));
+    ASSERT_EQ(ids.size(), deleted.size());
+  };
+  auto check_blocks = [&](const vector<BlockId>& live, const vector<BlockId>& dead) {
+    vector<BlockId> all_ids;
+    ASSERT_OK(bm_->GetAllBlockIds(&all_ids));
+    ASSERT_EQ(live.size(), all_ids.size());
+    for (const auto& id : live) {
+      unique_ptr<ReadableBlock> block;
+      ASSERT_OK(bm_->OpenBlock(id, &block));
+      uint64_t size;
+      ASSERT_OK(block->Size(&size));
+      ASSERT_EQ(9, size);
+    }
+    for (const auto& id : dead) {
+      unique_ptr<ReadableBlock> block;
+      ASSERT_TRUE(bm_->OpenBlock(id, &block).IsNotFound());
+    }
+  };
+
+  vector<BlockId> live;
+  vector<BlockId> dead;
+  NO_FATALS(create_blocks(20, &live));
+  FsReport report;
+  ASSERT_OK(ReopenBlockManager(nullptr, &report));
+  NO_FATALS(AssertEmptyReport(report));
+  NO_FATALS(check_blocks(live, dead));
+
+  // Delete some of the checkpointed blocks and add new ones, so that the next
+  // startup must combine the checkpoint with the tail of each container.
+  dead.assign(live.begin(), live.begin() + 5);
+  live.erase(live.begin(), live.begin() + 5);
+  NO_FATALS(delete_blocks(dead));
+  NO_FATALS(create_blocks(7, &live));
+  ASSERT_OK(ReopenBlockManager(nullptr, &report));
+  NO_FATALS(AssertEmptyReport(report));
+  NO_FATALS(check_blocks(live, dead));
+
+  // With checkpoints disabled, a full replay must find the same blocks.
+  FLAGS_log_block_manager_checkpoint_interval_records = 0;
+  ASSERT_OK(ReopenBlockManager());
+  NO_FATALS(check_blocks(live, dead));
+
+  // A missing checkpoint is rebuilt from a full replay.
+  FLAGS_log_block_manager_checkpoint_interval_records = 5;
+  ASSERT_OK(env_->DeleteFile(checkpoint_path));
+  ASSERT_OK(ReopenBlockManager());
+  NO_FATALS(check_blocks(live, dead));
+  ASSERT_TRUE(env_->FileExists(checkpoint_path));
+}
+
 } // namespace fs
 } // namespace kudu
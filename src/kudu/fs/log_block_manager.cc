@@ -36,6 +36,7 @@
 #include <gflags/gflags.h>
 #include <gflags/gflags_declare.h>
 #include <glog/logging.h>
+#include <google/protobuf/message.h>
 
 #include "kudu/fs/block_manager_metrics.h"
 #include "kudu/fs/block_manager_util.h"
@@ -43,10 +44,12 @@
 #include "kudu/fs/error_manager.h"
 #include "kudu/fs/fs.pb.h"
 #include "kudu/fs/fs_report.h"
+#include "kudu/fs/io_scheduler.h"
 #include "kudu/gutil/bind.h"
 #include "kudu/gutil/bind_helpers.h"
 #include "kudu/gutil/callback.h"
 #include "kudu/gutil/casts.h"
+#include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/stl_util.h"
@@ -55,24 +58,31 @@
 #include "kudu/gutil/strings/strip.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/gutil/strings/util.h"
+#include "kudu/gutil/sysinfo.h"
 #include "kudu/gutil/walltime.h"
 #include "kudu/util/alignment.h"
 #include "kudu/util/array_view.h"
 #include "kudu/util/env.h"
+#include "kudu/util/faststring.h"
 #include "kudu/util/file_cache.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/locks.h"
+#include "kudu/util/logging.h"
+#include "kudu/util/maintenance_manager.h"
 #include "kudu/util/malloc.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/monotime.h"
+#include "kudu/util/mutex.h"
 #include "kudu/util/path_util.h"
 #include "kudu/util/pb_util.h"
 #include "kudu/util/random.h"
 #include "kudu/util/random_util.h"
 #include "kudu/util/scoped_cleanup.h"
+#include "kudu/util/semaphore.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/sorted_disjoint_interval_list.h"
 #include "kudu/util/test_util_prod.h"
+#include "kudu/util/threadpool.h"
 #include "kudu/util/trace.h"
 
 DECLARE_bool(block_manager_lock_dirs);
@@ -108,11 +118,47 @@ DEFINE_double(log_container_live_metadata_before_compact_ratio, 0.50,
               "the container's metadata file will be compacted at startup.");
 TAG_FLAG(log_container_live_metadata_before_compact_ratio, experimental);
 
+DEFINE_double(log_container_live_data_before_compact_ratio, 0.10,
+              "Desired ratio of live data in full log containers. If the live "
+              "blocks of a full container make up less than this fraction of "
+              "the data written to it, a background maintenance operation "
+              "moves them to other containers, and the then empty container "
+              "is deleted at the next startup. If 0, containers are never "
+              "compacted this way.");
+TAG_FLAG(log_container_live_data_before_compact_ratio, experimental);
+
+DEFINE_int64(log_container_compaction_max_bytes, 1024 * 1024 * 1024,
+             "Maximum number of bytes of live blocks moved to other containers "
+             "by a single run of the log container compaction maintenance "
+             "operation.");
+TAG_FLAG(log_container_compaction_max_bytes, advanced);
+
 DEFINE_bool(log_block_manager_test_hole_punching, true,
             "Ensure hole punching is supported by the underlying filesystem");
 TAG_FLAG(log_block_manager_test_hole_punching, advanced);
 TAG_FLAG(log_block_manager_test_hole_punching, unsafe);
 
+DEFINE_int32(log_block_manager_open_threads, 0,
+             "Number of threads used to open log block containers at startup, "
+             "shared by all data directories. If 0, uses one thread per CPU.");
+TAG_FLAG(log_block_manager_open_threads, advanced);
+
+DEFINE_int64(log_block_manager_checkpoint_interval_records, 1000000,
+             "Number of block records appended to the containers of a data "
+             "directory after which the directory's block map checkpoint is "
+             "updated. At startup, only the records appended to a container "
+             "since the last checkpoint need to be read from its metadata file. "
+             "If 0, block map checkpoints are neither used nor written.");
+TAG_FLAG(log_block_manager_checkpoint_interval_records, advanced);
+TAG_FLAG(log_block_manager_checkpoint_interval_records, experimental);
+
+DEFINE_bool(log_block_manager_delete_dead_containers, false,
+            "Whether to delete full log block containers as soon as all of their "
+            "blocks are deleted and their space is reclaimed, e.g. when a tablet is "
+            "deleted or once a sparse container is compacted, instead of punching "
+            "holes in them and deleting them at the next startup.");
+TAG_FLAG(log_block_manager_delete_dead_containers, experimental);
+
 METRIC_DEFINE_gauge_uint64(server, log_block_manager_bytes_under_management,
                            "Bytes Under Management",
                            kudu::MetricUnit::kBytes,
@@ -138,6 +184,23 @@ METRIC_DEFINE_counter(server, log_block_manager_holes_punched,
                       kudu::MetricUnit::kHoles,
                       "Number of holes punched since service start");
 
+METRIC_DEFINE_counter(server, log_block_manager_dead_containers_deleted,
+                      "Number of Dead Block Containers Deleted",
+                      kudu::MetricUnit::kLogBlockContainers,
+                      "Number of full log block containers deleted since service start "
+                      "once all of their blocks were deleted");
+
+METRIC_DEFINE_gauge_uint32(server, log_block_manager_container_compactions_running,
+                           "Log Container Compactions Running",
+                           kudu::MetricUnit::kOperations,
+                           "Number of log container compactions currently running.");
+
+METRIC_DEFINE_histogram(server, log_block_manager_container_compaction_duration,
+                        "Log Container Compaction Duration",
+                        kudu::MetricUnit::kMilliseconds,
+                        "Time spent moving the live blocks of sparse log "
+                        "containers to other containers.", 3600000LU, 1);
+
 namespace kudu {
 
 namespace fs {
@@ -159,6 +222,129 @@ using std::unordered_set;
 using std::vector;
 using strings::Substitute;
 
+namespace {
+
+// Checks whether the metadata file opened by 'reader' still begins with the
+// records reflected in 'checkpoint'. If so, sets 'valid' and moves 'reader'
+// past those records; otherwise, 'reader' is left where it was.
+//
+// Returns an error only if the metadata file couldn't be read.
+Status SeekPastCheckpoint(const LogBlockContainerCheckpointPB& checkpoint,
+                          ReadablePBContainerFile* reader,
+                          bool* valid) {
+  *valid = false;
+  const uint64_t start_offset = reader->offset();
+  if (!checkpoint.has_last_record()) {
+    *valid = checkpoint.metadata_offset() == start_offset;
+    return Status::OK();
+  }
+
+  // Compaction rewrites metadata files, so the offsets in the checkpoint may
+  // no longer point at the same records. Verify that the last checkpointed
+  // record is still where it was.
+  reader->Seek(checkpoint.last_record_offset());
+  BlockRecordPB record;
+  Status s = reader->ReadNextPB(&record);
+  if (s.ok() &&
+      reader->offset() == checkpoint.metadata_offset() &&
+      record.SerializeAsString() == checkpoint.last_record().SerializeAsString()) {
+    *valid = true;
+    return Status::OK();
+  }
+  reader->Seek(start_offset);
+  if (s.ok() || s.IsEndOfFile() || s.IsIncomplete() || s.IsCorruption()) {
+    return Status::OK();
+  }
+  return s;
+}
+
+// Returns the length of a block at 'offset' with 'length' bytes, as counted
+// by LogBlock::fs_aligned_length().
+int64_t FsAlignedLength(int64_t offset, int64_t length, int64_t fs_block_size) {
+  if (PREDICT_TRUE(offset % fs_block_size == 0)) {
+    return KUDU_ALIGN_UP(length, fs_block_size);
+  }
+  return length;
+}
+
+// Brings 'checkpoint' up to date with the records appended to the container
+// metadata file at 'metadata_path' since it was taken, following the same
+// rules as LogBlockContainer::ProcessRecord(). If the checkpoint is stale,
+// it is rebuilt from the entire file.
+Status AdvanceCheckpoint(Env* env, const string& metadata_path, int64_t fs_block_size,
+                         LogBlockContainerCheckpointPB* checkpoint) {
+  unique_ptr<RandomAccessFile> file;
+  RETURN_NOT_OK(env->NewRandomAccessFile(metadata_path, &file));
+  ReadablePBContainerFile reader(std::move(file));
+  RETURN_NOT_OK(reader.Open());
+
+  bool valid;
+  RETURN_NOT_OK(SeekPastCheckpoint(*checkpoint, &reader, &valid));
+  unordered_map<uint64_t, BlockRecordPB> live_records;
+  if (valid) {
+    for (auto& r : *checkpoint->mutable_live_records()) {
+      live_records[r.block_id().id()].Swap(&r);
+    }
+  } else {
+    checkpoint->clear_last_record_offset();
+    checkpoint->clear_last_record();
+    checkpoint->set_next_block_offset(0);
+    checkpoint->set_total_bytes(0);
+    checkpoint->set_total_blocks(0);
+    checkpoint->set_max_block_id(0);
+  }
+  checkpoint->clear_live_records();
+
+  Status s;
+  while (true) {
+    uint64_t record_offset = reader.offset();
+    BlockRecordPB record;
+    s = reader.ReadNextPB(&record);
+    if (!s.ok()) {
+      break;
+    }
+    checkpoint->set_last_record_offset(record_offset);
+    *checkpoint->mutable_last_record() = record;
+
+    uint64_t block_id = record.block_id().id();
+    switch (record.op_type()) {
+      case CREATE:
+        // Malformed records are skipped, and reported when the container is
+        // next opened.
+        if (!record.has_offset() || !record.has_length() ||
+            record.offset() < 0 || record.length() < 0 ||
+            ContainsKey(live_records, block_id)) {
+          break;
+        }
+        checkpoint->set_next_block_offset(std::max<int64_t>(
+            checkpoint->next_block_offset(),
+            KUDU_ALIGN_UP(record.offset() + record.length(), fs_block_size)));
+        checkpoint->set_total_bytes(checkpoint->total_bytes() +
+                                    FsAlignedLength(record.offset(), record.length(),
+                                                    fs_block_size));
+        checkpoint->set_total_blocks(checkpoint->total_blocks() + 1);
+        checkpoint->set_max_block_id(std::max(checkpoint->max_block_id(), block_id));
+        live_records[block_id].Swap(&record);
+        break;
+      case DELETE:
+        live_records.erase(block_id);
+        break;
+      default:
+        break;
+    }
+  }
+  if (!s.IsEndOfFile() && !s.IsIncomplete()) {
+    return s;
+  }
+  checkpoint->set_metadata_offset(reader.offset());
+  for (auto& e : live_records) {
+    checkpoint->add_live_records()->Swap(&e.second);
+  }
+  return Status::OK();
+}
+
+} // anonymous namespace
+
 namespace internal {
 
 ////////////////////////////////////////////////////////////
@@ -182,6 +368,7 @@ struct LogBlockManagerMetrics {
   scoped_refptr<AtomicGauge<uint64_t>> full_containers;
 
   scoped_refptr<Counter> holes_punched;
+  scoped_refptr<Counter> dead_containers_deleted;
 };
 
 #define MINIT(x) x(METRIC_log_block_manager_##x.Instantiate(metric_entity))
@@ -192,7 +379,8 @@ LogBlockManagerMetrics::LogBlockManagerMetrics(const scoped_refptr<MetricEntity>
     GINIT(blocks_under_management),
     GINIT(containers),
     GINIT(full_containers),
-    MINIT(holes_punched) {
+    MINIT(holes_punched),
+    MINIT(dead_containers_deleted) {
 }
 #undef GINIT
 
@@ -292,10 +480,8 @@ class LogWritableBlock : public WritableBlock {
   // Starts an asynchronous flush of dirty block data to disk.
   Status FlushDataAsync();
 
-  // Write this block's metadata to disk.
-  //
-  // Does not synchronize the written data; that takes place in Close().
-  Status AppendMetadata();
+  // Fills in 'record' with the metadata record of this block's creation.
+  void BuildMetadataRecord(BlockRecordPB* record) const;
 
   LogBlockContainer* container() const { return container_; }
 
@@ -374,8 +560,11 @@ class LogBlockContainer {
   // The on-disk effects of this call are made durable only after SyncData().
   Status PunchHole(int64_t offset, int64_t length);
 
-  // Executes a hole punching operation at 'offset' with the given 'length'.
-  void ContainerDeletionAsync(int64_t offset, int64_t length);
+  // Executes a hole punching operation at 'offset' with the given 'length',
+  // reclaiming the space of 'num_blocks' deleted blocks. If they were the
+  // last blocks whose space was to be reclaimed, the container may be deleted
+  // afterwards, so it mustn't be used by the caller.
+  void ContainerDeletionAsync(int64_t offset, int64_t length, int64_t num_blocks);
 
   // Preallocate enough space to ensure that an append of 'next_append_length'
   // can be satisfied by this container. The offset of the beginning of this
@@ -398,11 +587,25 @@ class LogBlockContainer {
   // See RWFile::ReadV().
   Status ReadVData(int64_t offset, ArrayView<Slice> results) const;
 
+  // See RWFile::DropCache().
+  Status DropCache(int64_t offset, size_t length) const;
+
+  // See RWFile::Prefetch().
+  Status Prefetch(int64_t offset, size_t length) const;
+
+  // Points 'result' at the 'length' bytes at 'offset' in a mapping of the
+  // container's data file, which 'mapping' keeps alive. See RWFile::Mmap().
+  Status ReadMappedData(int64_t offset, size_t length, Slice* result,
+                        shared_ptr<const FileMapping>* mapping) const;
+
   // Appends 'pb' to this container's metadata file.
   //
   // The on-disk effects of this call are made durable only after SyncMetadata().
   Status AppendMetadata(const BlockRecordPB& pb);
 
+  // Like AppendMetadata(), but appends all of 'pbs' with a single write.
+  Status AppendMetadata(const vector<BlockRecordPB>& pbs);
+
   // Asynchronously flush this container's data file from 'offset' through
   // to 'length'.
   //
@@ -450,6 +653,16 @@ class LogBlockContainer {
   // 'dead_blocks'. Live records are written to 'live_block_records'. The
   // greatest block ID seen thus far in the container is written to 'max_block_id'.
   //
+  // If 'checkpoint' is not null and still matches the metadata file, the
+  // blocks it describes are loaded from it and only the subsequent records
+  // are read from disk. Deleted blocks covered by the checkpoint are not
+  // written to 'dead_blocks', and inconsistencies in the records it covers
+  // are not reported again.
+  //
+  // If 'new_checkpoint' is not null, it is set to a checkpoint of the
+  // container reflecting all of the records read, except for its container
+  // ID and live records, which are left to the caller.
+  //
   // Returns an error only if there was a problem accessing the container from
   // disk; such errors are fatal and effectively halt processing immediately.
   Status ProcessRecords(
@@ -457,7 +670,9 @@ class LogBlockContainer {
       LogBlockManager::UntrackedBlockMap* live_blocks,
       LogBlockManager::BlockRecordMap* live_block_records,
       std::vector<scoped_refptr<internal::LogBlock>>* dead_blocks,
-      uint64_t* max_block_id);
+      uint64_t* max_block_id,
+      const LogBlockContainerCheckpointPB* checkpoint = nullptr,
+      LogBlockContainerCheckpointPB* new_checkpoint = nullptr);
 
   // Updates internal bookkeeping state to reflect the creation of a block.
   void BlockCreated(const scoped_refptr<LogBlock>& block);
@@ -470,10 +685,56 @@ class LogBlockContainer {
   // Note: the container is not made "unfull"; containers remain sparse until deleted.
   void BlockDeleted(const scoped_refptr<LogBlock>& block);
 
+  // Updates internal bookkeeping state to reflect that the deletion of
+  // 'num_blocks' blocks is about to be recorded, and that their space will
+  // be reclaimed by a deletion transaction. Must be called before
+  // BlockDeleted(), so that the container isn't considered dead while the
+  // blocks may still be read.
+  void BlockDeletionsPending(int64_t num_blocks) {
+    pending_deletions_.IncrementBy(num_blocks);
+  }
+
+  // Updates internal bookkeeping state to reflect that the space of
+  // 'num_blocks' deleted blocks was reclaimed. Returns the number of deleted
+  // blocks whose space still awaits reclamation.
+  int64_t BlockDeletionsReclaimed(int64_t num_blocks) {
+    return pending_deletions_.IncrementBy(-num_blocks);
+  }
+
+  // Updates internal bookkeeping state to reflect that a block is being
+  // written to the container, or that it no longer is.
+  void WriterStarted() { num_writers_.Increment(); }
+  void WriterFinished() { num_writers_.IncrementBy(-1); }
+
+  // Returns whether the container is dead: it is full and writable, and none
+  // of its blocks are live, being written, or awaiting the reclamation of
+  // their space. Nothing refers to a dead container anymore, except the block
+  // manager's maps.
+  //
+  // Must be called with the block manager's lock held.
+  bool dead() const;
+
+  // Whether the container is being compacted. A container being compacted
+  // isn't dead.
+  //
+  // Must be called with the block manager's lock held.
+  bool compacting() const { return compacting_; }
+  void set_compacting(bool compacting) { compacting_ = compacting; }
+
   // Finalizes a fully written block. It updates the container data file's position,
   // truncates the container if full and marks the container as available.
   void FinalizeBlock(int64_t block_offset, int64_t block_length);
 
+  // Copies the data of 'blocks', which belong to other containers, to the end
+  // of this container and durably records their creation in its metadata.
+  // Blocks are copied in order until the container is full. The copies are
+  // returned in 'copies', and are not added to the block manager's maps.
+  //
+  // Like writing a block, this requires exclusive use of the container, and
+  // makes it available again when done.
+  Status CopyBlocks(const vector<scoped_refptr<LogBlock>>& blocks,
+                    vector<scoped_refptr<LogBlock>>* copies);
+
   // Runs a task on this container's data directory thread pool.
   //
   // Normally the task is performed asynchronously. However, if submission to
@@ -587,6 +848,17 @@ class LogBlockContainer {
   // The number of not-yet-deleted blocks in the container.
   AtomicInt<int64_t> live_blocks_;
 
+  // The number of deleted blocks of the container whose space hasn't been
+  // reclaimed yet.
+  AtomicInt<int64_t> pending_deletions_;
+
+  // The number of blocks being written to the container, or of block copies
+  // being made to it.
+  AtomicInt<int64_t> num_writers_;
+
+  // See compacting(). Protected by the block manager's lock.
+  bool compacting_;
+
   // The metrics. Not owned by the log container; it has the same lifespan
   // as the block manager.
   const LogBlockManagerMetrics* metrics_;
@@ -617,6 +889,9 @@ LogBlockContainer::LogBlockContainer(
       live_bytes_(0),
       live_bytes_aligned_(0),
       live_blocks_(0),
+      pending_deletions_(0),
+      num_writers_(0),
+      compacting_(false),
       metrics_(block_manager->metrics()) {
 }
 
@@ -711,11 +986,16 @@ Status LogBlockContainer::Open(LogBlockManager* block_manager,
   // of the server crashed due to "too many open files" just as it was trying
   // to create a data file. This orphans an empty metadata file, which we can
   // safely delete.
+  //
+  // A data file without a metadata file is left behind by a crash while
+  // deleting a dead container at runtime, which deletes the metadata file
+  // first. None of its blocks can be live, so it's safely deleted too.
   {
     uint64_t metadata_size = 0;
     uint64_t data_size = 0;
     Status s = env->GetFileSize(metadata_path, &metadata_size);
-    if (!s.IsNotFound()) {
+    const bool metadata_exists = !s.IsNotFound();
+    if (metadata_exists) {
       s = s.CloneAndPrepend("unable to determine metadata file size");
       RETURN_NOT_OK_CONTAINER_DISK_FAILURE(s);
     }
@@ -725,8 +1005,8 @@ Status LogBlockContainer::Open(LogBlockManager* block_manager,
       RETURN_NOT_OK_CONTAINER_DISK_FAILURE(s);
     }
 
-    if (metadata_size < pb_util::kPBContainerMinimumValidLength &&
-        data_size == 0) {
+    if (!metadata_exists ||
+        (metadata_size < pb_util::kPBContainerMinimumValidLength && data_size == 0)) {
       report->incomplete_container_check->entries.emplace_back(common_path);
       return Status::Aborted(Substitute("orphaned empty metadata and data files $0",
                                         common_path));
@@ -775,7 +1055,9 @@ Status LogBlockContainer::ProcessRecords(
     LogBlockManager::UntrackedBlockMap* live_blocks,
     LogBlockManager::BlockRecordMap* live_block_records,
     vector<scoped_refptr<internal::LogBlock>>* dead_blocks,
-    uint64_t* max_block_id) {
+    uint64_t* max_block_id,
+    const LogBlockContainerCheckpointPB* checkpoint,
+    LogBlockContainerCheckpointPB* new_checkpoint) {
   string metadata_path = metadata_file_->filename();
   unique_ptr<RandomAccessFile> metadata_reader;
   RETURN_NOT_OK_HANDLE_ERROR(block_manager()->env()->NewRandomAccessFile(
@@ -784,29 +1066,73 @@ Status LogBlockContainer::ProcessRecords(
   RETURN_NOT_OK_HANDLE_ERROR(pb_reader.Open());
 
   uint64_t data_file_size = 0;
+  boost::optional<uint64_t> last_record_offset;
+  BlockRecordPB last_record;
+  if (checkpoint) {
+    bool valid;
+    RETURN_NOT_OK_HANDLE_ERROR(SeekPastCheckpoint(*checkpoint, &pb_reader, &valid));
+    if (valid) {
+      // The checkpointed records are processed like any other, except that
+      // deleted blocks must still be accounted for in the container's size.
+      for (const auto& r : checkpoint->live_records()) {
+        BlockRecordPB record(r);
+        RETURN_NOT_OK(ProcessRecord(&record, report,
+                                    live_blocks, live_block_records, dead_blocks,
+                                    &data_file_size, max_block_id));
+      }
+      next_block_offset_.StoreMax(checkpoint->next_block_offset());
+      total_bytes_.Store(checkpoint->total_bytes());
+      total_blocks_.Store(checkpoint->total_blocks());
+      *max_block_id = std::max(*max_block_id, checkpoint->max_block_id());
+      if (checkpoint->has_last_record()) {
+        last_record_offset = checkpoint->last_record_offset();
+        last_record = checkpoint->last_record();
+      }
+      VLOG(1) << Substitute("Loaded $0 blocks of container $1 from its checkpoint",
+                            checkpoint->live_records_size(), ToString());
+    } else {
+      LOG(INFO) << Substitute("Checkpoint of container $0 is stale; "
+                              "reading its entire metadata file", ToString());
+    }
+  }
+
   Status read_status;
   while (true) {
+    uint64_t record_offset = pb_reader.offset();
     BlockRecordPB record;
     read_status = pb_reader.ReadNextPB(&record);
     if (!read_status.ok()) {
       break;
     }
+    if (new_checkpoint) {
+      last_record_offset = record_offset;
+      last_record = record;
+    }
     RETURN_NOT_OK(ProcessRecord(&record, report,
                                 live_blocks, live_block_records, dead_blocks,
                                 &data_file_size, max_block_id));
   }
 
   // NOTE: 'read_status' will never be OK here.
-  if (PREDICT_TRUE(read_status.IsEndOfFile())) {
-    // We've reached the end of the file without any problems.
-    return Status::OK();
-  }
-  if (read_status.IsIncomplete()) {
-    // We found a partial trailing record in a version of the pb container file
-    // format that can reliably detect this. Consider this a failed partial
-    // write and truncate the metadata file to remove this partial record.
-    report->partial_record_check->entries.emplace_back(ToString(),
-                                                       pb_reader.offset());
+  if (PREDICT_TRUE(read_status.IsEndOfFile() || read_status.IsIncomplete())) {
+    if (read_status.IsIncomplete()) {
+      // We found a partial trailing record in a version of the pb container file
+      // format that can reliably detect this. Consider this a failed partial
+      // write and truncate the metadata file to remove this partial record.
+      report->partial_record_check->entries.emplace_back(ToString(),
+                                                         pb_reader.offset());
+    }
+    if (new_checkpoint) {
+      new_checkpoint->set_metadata_offset(pb_reader.offset());
+      if (last_record_offset) {
+        new_checkpoint->set_last_record_offset(*last_record_offset);
+        new_checkpoint->mutable_last_record()->Swap(&last_record);
+      }
+      new_checkpoint->set_next_block_offset(next_block_offset());
+      new_checkpoint->set_total_bytes(total_bytes());
+      new_checkpoint->set_total_blocks(total_blocks());
+      new_checkpoint->set_max_block_id(*max_block_id);
+    }
     return Status::OK();
   }
   // If we've made it here, we've found (and are returning) an unrecoverable error.
@@ -916,10 +1242,14 @@ Status LogBlockContainer::DoCloseBlocks(const vector<LogWritableBlock*>& blocks,
 
     // Append metadata only after data is synced so that there's
     // no chance of metadata landing on the disk before the data.
-    for (auto* block : blocks) {
-      RETURN_NOT_OK_PREPEND(block->AppendMetadata(),
-                            "unable to append block's metadata during close");
+    //
+    // The records of all of the blocks are appended with a single write.
+    vector<BlockRecordPB> records(blocks.size());
+    for (int i = 0; i < blocks.size(); i++) {
+      blocks[i]->BuildMetadataRecord(&records[i]);
     }
+    RETURN_NOT_OK_PREPEND(AppendMetadata(records),
+                          "unable to append blocks' metadata during close");
 
     if (mode == SYNC) {
       VLOG(3) << "Syncing metadata file " << metadata_file_->filename();
@@ -967,15 +1297,16 @@ Status LogBlockContainer::WriteVData(int64_t offset, ArrayView<const Slice> data
   RETURN_NOT_OK_HANDLE_ERROR(read_only_status());
   DCHECK_GE(offset, next_block_offset());
 
+  size_t data_size = accumulate(data.begin(), data.end(), static_cast<size_t>(0),
+                                [&](int sum, const Slice& curr) {
+                                  return sum + curr.size();
+                                });
+  data_dir_->io_scheduler()->Admit(data_size);
   RETURN_NOT_OK_HANDLE_ERROR(data_file_->WriteV(offset, data));
 
   // This append may have changed the container size if:
   // 1. It was large enough that it blew out the preallocated space.
   // 2. Preallocation was disabled.
-  size_t data_size = accumulate(data.begin(), data.end(), static_cast<size_t>(0),
-                                [&](int sum, const Slice& curr) {
-                                  return sum + curr.size();
-                                });
   if (offset + data_size > preallocated_offset_) {
     RETURN_NOT_OK_HANDLE_ERROR(data_dir_->RefreshIsFull(DataDir::RefreshMode::ALWAYS));
   }
@@ -984,20 +1315,62 @@ Status LogBlockContainer::WriteVData(int64_t offset, ArrayView<const Slice> data
 
 Status LogBlockContainer::ReadData(int64_t offset, Slice result) const {
   DCHECK_GE(offset, 0);
+  data_dir_->io_scheduler()->Admit(result.size());
   RETURN_NOT_OK_HANDLE_ERROR(data_file_->Read(offset, result));
   return Status::OK();
 }
 Status LogBlockContainer::ReadVData(int64_t offset, ArrayView<Slice> results) const {
   DCHECK_GE(offset, 0);
+  data_dir_->io_scheduler()->Admit(accumulate(
+      results.begin(), results.end(), static_cast<size_t>(0),
+      [&](int sum, const Slice& curr) {
+        return sum + curr.size();
+      }));
   RETURN_NOT_OK_HANDLE_ERROR(data_file_->ReadV(offset, results));
   return Status::OK();
 }
 
+Status LogBlockContainer::DropCache(int64_t offset, size_t length) const {
+  DCHECK_GE(offset, 0);
+  RETURN_NOT_OK_HANDLE_ERROR(data_file_->DropCache(offset, length));
+  return Status::OK();
+}
+
+Status LogBlockContainer::Prefetch(int64_t offset, size_t length) const {
+  DCHECK_GE(offset, 0);
+  RETURN_NOT_OK_HANDLE_ERROR(data_file_->Prefetch(offset, length));
+  return Status::OK();
+}
+
+Status LogBlockContainer::ReadMappedData(int64_t offset, size_t length, Slice* result,
+                                         shared_ptr<const FileMapping>* mapping) const {
+  DCHECK_GE(offset, 0);
+  DCHECK(data_dir_->mmap_reads());
+  // The file cache keeps the mapping of the data file, which is only mapped
+  // again once blocks have been appended past it.
+  RETURN_NOT_OK_HANDLE_ERROR(data_file_->Mmap(offset + length, mapping));
+  *result = Slice((*mapping)->data() + offset, length);
+  return Status::OK();
+}
+
 Status LogBlockContainer::AppendMetadata(const BlockRecordPB& pb) {
   RETURN_NOT_OK_HANDLE_ERROR(read_only_status());
   // Note: We don't check for sufficient disk space for metadata writes in
   // order to allow for block deletion on full disks.
   RETURN_NOT_OK_HANDLE_ERROR(metadata_file_->Append(pb));
+  block_manager_->MetadataRecordAppended(data_dir_, 1);
+  return Status::OK();
+}
+
+Status LogBlockContainer::AppendMetadata(const vector<BlockRecordPB>& pbs) {
+  RETURN_NOT_OK_HANDLE_ERROR(read_only_status());
+  vector<const google::protobuf::Message*> msgs;
+  msgs.reserve(pbs.size());
+  for (const auto& pb : pbs) {
+    msgs.push_back(&pb);
+  }
+  RETURN_NOT_OK_HANDLE_ERROR(metadata_file_->AppendBatch(msgs));
+  block_manager_->MetadataRecordAppended(data_dir_, pbs.size());
   return Status::OK();
 }
 
@@ -1092,6 +1465,78 @@ void LogBlockContainer::FinalizeBlock(int64_t block_offset, int64_t block_length
   block_manager_->MakeContainerAvailable(this);
 }
 
+Status LogBlockContainer::CopyBlocks(const vector<scoped_refptr<LogBlock>>& blocks,
+                                     vector<scoped_refptr<LogBlock>>* copies) {
+  // Blocks are copied in chunks of this many bytes.
+  const int64_t kCopyChunkSize = 1024 * 1024;
+
+  // Until the copies are accounted for as live blocks, the container mustn't
+  // be considered dead.
+  WriterStarted();
+  SCOPED_CLEANUP({ WriterFinished(); });
+
+  auto copy_blocks = [&]() -> Status {
+    faststring buf;
+    vector<BlockRecordPB> records;
+    for (const auto& lb : blocks) {
+      // The copies are only accounted for in 'total_blocks_' once they're
+      // durable, so factor them into the block limit here.
+      if (full() ||
+          (max_num_blocks_ && total_blocks() + copies->size() >= *max_num_blocks_)) {
+        break;
+      }
+      const int64_t offset = next_block_offset();
+      for (int64_t copied = 0; copied < lb->length();) {
+        const int64_t len = std::min(kCopyChunkSize, lb->length() - copied);
+        buf.resize(len);
+        Slice chunk(buf.data(), len);
+        RETURN_NOT_OK(lb->container()->ReadData(lb->offset() + copied, chunk));
+        RETURN_NOT_OK(EnsurePreallocated(offset + copied, len));
+        RETURN_NOT_OK(WriteData(offset + copied, chunk));
+        copied += len;
+      }
+      UpdateNextBlockOffset(offset, lb->length());
+
+      scoped_refptr<LogBlock> copy(new LogBlock(this, lb->block_id(), offset, lb->length()));
+      records.emplace_back();
+      BlockRecordPB* record = &records.back();
+      copy->block_id().CopyToPB(record->mutable_block_id());
+      record->set_op_type(CREATE);
+      record->set_timestamp_us(GetCurrentTimeMicros());
+      record->set_offset(offset);
+      record->set_length(lb->length());
+      copies->emplace_back(std::move(copy));
+    }
+    if (records.empty()) {
+      return Status::OK();
+    }
+
+    // As when closing blocks, the data must be durable before the metadata.
+    RETURN_NOT_OK(SyncData());
+    RETURN_NOT_OK(AppendMetadata(records));
+    RETURN_NOT_OK(SyncMetadata());
+    RETURN_NOT_OK(block_manager()->SyncContainer(*this));
+    for (const auto& copy : *copies) {
+      BlockCreated(copy);
+    }
+    return Status::OK();
+  };
+
+  Status s = copy_blocks();
+  if (!s.ok()) {
+    copies->clear();
+    SetReadOnly(s);
+    return s;
+  }
+  WARN_NOT_OK(TruncateDataToNextBlockOffset(),
+              "could not truncate excess preallocated space");
+  if (full() && block_manager_->metrics()) {
+    block_manager_->metrics()->full_containers->Increment();
+  }
+  block_manager_->MakeContainerAvailable(this);
+  return Status::OK();
+}
+
 void LogBlockContainer::UpdateNextBlockOffset(int64_t block_offset, int64_t block_length) {
   DCHECK_GE(block_offset, 0);
 
@@ -1135,6 +1580,13 @@ void LogBlockContainer::BlockDeleted(const scoped_refptr<LogBlock>& block) {
   live_blocks_.IncrementBy(-1);
 }
 
+bool LogBlockContainer::dead() const {
+  // A full container isn't handed out to writers anymore, so once none are
+  // left after it became full, no block can become live again.
+  return full() && num_writers_.Load() == 0 && live_blocks() == 0 &&
+      pending_deletions_.Load() == 0 && !compacting_ && !read_only();
+}
+
 void LogBlockContainer::ExecClosure(const Closure& task) {
   data_dir_->ExecClosure(task);
 }
@@ -1154,12 +1606,17 @@ void LogBlockContainer::SetReadOnly(const Status& error) {
   read_only_status_ = error;
 }
 
-void LogBlockContainer::ContainerDeletionAsync(int64_t offset, int64_t length) {
+void LogBlockContainer::ContainerDeletionAsync(int64_t offset, int64_t length,
+                                               int64_t num_blocks) {
   VLOG(3) << "Freeing space belonging to container " << ToString();
   Status s = PunchHole(offset, length);
   if (s.ok() && metrics_) metrics_->holes_punched->Increment();
   WARN_NOT_OK(s, Substitute("could not delete blocks in container $0",
                             data_dir()->dir()));
+  if (BlockDeletionsReclaimed(num_blocks) == 0) {
+    // This may delete the container.
+    block_manager_->DeleteContainerIfDead(this);
+  }
 }
 
 ///////////////////////////////////////////////////////////
@@ -1168,7 +1625,9 @@ void LogBlockContainer::ContainerDeletionAsync(int64_t offset, int64_t length) {
 
 class LogBlockCreationTransaction : public BlockCreationTransaction {
  public:
-  LogBlockCreationTransaction() = default;
+  explicit LogBlockCreationTransaction(LogBlockManager* lbm)
+      : lbm_(lbm) {
+  }
 
   virtual ~LogBlockCreationTransaction() = default;
 
@@ -1177,6 +1636,9 @@ class LogBlockCreationTransaction : public BlockCreationTransaction {
   virtual Status CommitCreatedBlocks() override;
 
  private:
+  // The owning LogBlockManager. Must outlive the LogBlockCreationTransaction.
+  LogBlockManager* lbm_;
+
   std::vector<std::unique_ptr<LogWritableBlock>> created_blocks_;
 };
 
@@ -1206,9 +1668,54 @@ Status LogBlockCreationTransaction::CommitCreatedBlocks() {
   // Close all blocks and sync the blocks belonging to the same
   // container together to reduce fsync() usage, waiting for them
   // to become durable.
+  //
+  // Containers on different data directories are synced in parallel, while
+  // those on the same data directory are synced one after another, so as not
+  // to have a disk serve several syncs at once.
+  unordered_map<const DataDir*, vector<LogBlockContainer*>> containers_by_data_dir;
   for (const auto& entry : created_block_map) {
-    RETURN_NOT_OK(entry.first->DoCloseBlocks(entry.second,
+    containers_by_data_dir[entry.first->data_dir()].push_back(entry.first);
+  }
+  auto close_containers = [&](const vector<LogBlockContainer*>& containers) -> Status {
+    for (auto* container : containers) {
+      RETURN_NOT_OK(container->DoCloseBlocks(FindOrDie(created_block_map, container),
                                              LogBlockContainer::SyncMode::SYNC));
+    }
+    return Status::OK();
+  };
+
+  vector<Status> statuses(containers_by_data_dir.size());
+  unique_ptr<ThreadPoolToken> token;
+  if (containers_by_data_dir.size() > 1) {
+    token = lbm_->sync_pool_->NewToken(ThreadPool::ExecutionMode::CONCURRENT);
+  }
+  int i = 0;
+  for (const auto& entry : containers_by_data_dir) {
+    Status* s = &statuses[i++];
+    const vector<LogBlockContainer*>* containers = &entry.second;
+    // The last directory's containers are closed on this thread.
+    if (token && i < statuses.size()) {
+      if (token->SubmitFunc([&close_containers, s, containers]() {
+            *s = close_containers(*containers);
+          }).ok()) {
+        continue;
+      }
+    }
+    *s = close_containers(*containers);
+  }
+  if (token) {
+    token->Wait();
+  }
+  for (const auto& s : statuses) {
+    RETURN_NOT_OK(s);
+  }
+  if (drop_cache_on_commit_) {
+    vector<BlockId> block_ids;
+    block_ids.reserve(created_blocks_.size());
+    for (const auto& block : created_blocks_) {
+      block_ids.emplace_back(block->id());
+    }
+    DropCommittedBlocksFromCache(lbm_, block_ids);
   }
   created_blocks_.clear();
   return Status::OK();
@@ -1259,15 +1766,21 @@ void LogBlockDeletionTransaction::AddDeletedBlock(BlockId block) {
 LogBlockDeletionTransaction::~LogBlockDeletionTransaction() {
   for (auto& entry : deleted_interval_map_) {
     LogBlockContainer* container = entry.first;
+    const int64_t num_blocks = entry.second.size();
     CHECK_OK_PREPEND(CoalesceIntervals<int64_t>(&entry.second),
                      Substitute("could not coalesce hole punching for container: $0",
                                 container->ToString()));
 
-    for (const auto& interval : entry.second) {
+    // Each hole punch reclaims the space of at least one of the blocks, so
+    // that the container isn't deleted while some are still to run.
+    const int64_t num_intervals = entry.second.size();
+    for (int64_t i = 0; i < num_intervals; i++) {
+      const auto& interval = entry.second[i];
       container->ExecClosure(Bind(&LogBlockContainer::ContainerDeletionAsync,
                                   Unretained(container),
                                   interval.first,
-                                  interval.second - interval.first));
+                                  interval.second - interval.first,
+                                  i == num_intervals - 1 ? num_blocks - i : 1));
     }
   }
 }
@@ -1305,6 +1818,110 @@ void LogBlockDeletionTransaction::AddBlock(const scoped_refptr<internal::LogBloc
   deleted_interval_map_[lb->container()].emplace_back(block_interval);
 }
 
+////////////////////////////////////////////////////////////
+// LogBlockContainerCompactionOp
+////////////////////////////////////////////////////////////
+
+// Maintenance op that moves the live blocks of sparse full containers to
+// other containers. See LogBlockManager::CompactContainers().
+//
+// Only one instance of the op can run at a time.
+class LogBlockContainerCompactionOp : public MaintenanceOp {
+ public:
+  explicit LogBlockContainerCompactionOp(LogBlockManager* lbm);
+
+  void UpdateStats(MaintenanceOpStats* stats) override;
+
+  bool Prepare() override;
+
+  void Perform() override;
+
+  scoped_refptr<Histogram> DurationHistogram() const override;
+
+  scoped_refptr<AtomicGauge<uint32_t>> RunningGauge() const override;
+
+ private:
+  // Finding the sparse containers means visiting every container, so the
+  // result is only refreshed this often.
+  static const MonoDelta kStatsRefreshInterval;
+
+  LogBlockManager* const lbm_;
+
+  scoped_refptr<Histogram> duration_;
+  scoped_refptr<AtomicGauge<uint32_t>> running_;
+
+  // Protects 'last_stats_time_' and 'sparse_fraction_'.
+  simple_spinlock lock_;
+
+  // When the stats were last refreshed. Uninitialized if they must be
+  // refreshed at the next UpdateStats().
+  MonoTime last_stats_time_;
+
+  // The fraction of containers that were found to be sparse.
+  double sparse_fraction_;
+
+  mutable Semaphore sem_;
+};
+
+const MonoDelta LogBlockContainerCompactionOp::kStatsRefreshInterval =
+    MonoDelta::FromSeconds(10);
+
+LogBlockContainerCompactionOp::LogBlockContainerCompactionOp(LogBlockManager* lbm)
+    : MaintenanceOp("LogBlockContainerCompactionOp", MaintenanceOp::HIGH_IO_USAGE),
+      lbm_(lbm),
+      duration_(METRIC_log_block_manager_container_compaction_duration.Instantiate(
+          lbm->opts_.metric_entity)),
+      running_(METRIC_log_block_manager_container_compactions_running.Instantiate(
+          lbm->opts_.metric_entity, 0)),
+      sparse_fraction_(0),
+      sem_(1) {
+}
+
+void LogBlockContainerCompactionOp::UpdateStats(MaintenanceOpStats* stats) {
+  std::lock_guard<simple_spinlock> l(lock_);
+  const MonoTime now = MonoTime::Now();
+  if (!last_stats_time_.Initialized() || now - last_stats_time_ > kStatsRefreshInterval) {
+    vector<LogBlockContainer*> sparse_containers;
+    int64_t num_containers;
+    lbm_->FindSparseContainers(&sparse_containers, &num_containers);
+    sparse_fraction_ = num_containers == 0 ? 0 :
+        static_cast<double>(sparse_containers.size()) / num_containers;
+    last_stats_time_ = now;
+  }
+
+  // Compacting containers doesn't free much space, since the space of deleted
+  // blocks has already been reclaimed by hole punching. Rather, it reduces
+  // the number of containers, so the benefit is measured in those.
+  stats->set_perf_improvement(sparse_fraction_);
+  stats->set_runnable(sparse_fraction_ > 0 && sem_.GetValue() == 1);
+}
+
+bool LogBlockContainerCompactionOp::Prepare() {
+  return sem_.try_lock();
+}
+
+void LogBlockContainerCompactionOp::Perform() {
+  CHECK(!sem_.try_lock());
+
+  ScopedIOPriority io_priority(IOPriority::COMPACTION);
+  WARN_NOT_OK(lbm_->CompactContainers(FLAGS_log_container_compaction_max_bytes),
+              "Could not compact log block containers");
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    last_stats_time_ = MonoTime();
+  }
+
+  sem_.unlock();
+}
+
+scoped_refptr<Histogram> LogBlockContainerCompactionOp::DurationHistogram() const {
+  return duration_;
+}
+
+scoped_refptr<AtomicGauge<uint32_t>> LogBlockContainerCompactionOp::RunningGauge() const {
+  return running_;
+}
+
 ////////////////////////////////////////////////////////////
 // LogBlock (definition)
 ////////////////////////////////////////////////////////////
@@ -1358,6 +1975,7 @@ LogWritableBlock::LogWritableBlock(LogBlockContainer* container,
       state_(CLEAN) {
   DCHECK_GE(block_offset, 0);
   DCHECK_EQ(0, block_offset % container->instance()->filesystem_block_size_bytes());
+  container_->WriterStarted();
   if (container->metrics()) {
     container->metrics()->generic_metrics.blocks_open_writing->Increment();
     container->metrics()->generic_metrics.total_writable_blocks->Increment();
@@ -1369,6 +1987,7 @@ LogWritableBlock::~LogWritableBlock() {
     WARN_NOT_OK(Abort(), Substitute("Failed to abort block $0",
                                     id().ToString()));
   }
+  container_->WriterFinished();
 }
 
 Status LogWritableBlock::Close() {
@@ -1529,14 +2148,12 @@ void LogWritableBlock::DoClose() {
   state_ = CLOSED;
 }
 
-Status LogWritableBlock::AppendMetadata() {
-  BlockRecordPB record;
-  id().CopyToPB(record.mutable_block_id());
-  record.set_op_type(CREATE);
-  record.set_timestamp_us(GetCurrentTimeMicros());
-  record.set_offset(block_offset_);
-  record.set_length(block_length_);
-  return container_->AppendMetadata(record);
+void LogWritableBlock::BuildMetadataRecord(BlockRecordPB* record) const {
+  id().CopyToPB(record->mutable_block_id());
+  record->set_op_type(CREATE);
+  record->set_timestamp_us(GetCurrentTimeMicros());
+  record->set_offset(block_offset_);
+  record->set_length(block_length_);
 }
 
 ////////////////////////////////////////////////////////////
@@ -1563,6 +2180,13 @@ class LogReadableBlock : public ReadableBlock {
 
   virtual Status ReadV(uint64_t offset, ArrayView<Slice> results) const OVERRIDE;
 
+  virtual Status DropCache(uint64_t offset, size_t length) const OVERRIDE;
+
+  virtual Status Prefetch(uint64_t offset, size_t length) const OVERRIDE;
+
+  virtual bool ReadMapped(uint64_t offset, size_t length, Slice* result,
+                          shared_ptr<const FileMapping>* mapping) const OVERRIDE;
+
   virtual size_t memory_footprint() const OVERRIDE;
 
  private:
@@ -1655,6 +2279,52 @@ Status LogReadableBlock::ReadV(uint64_t offset, ArrayView<Slice> results) const
   return Status::OK();
 }
 
+Status LogReadableBlock::DropCache(uint64_t offset, size_t length) const {
+  DCHECK(!closed_.Load());
+
+  if (offset >= log_block_->length()) {
+    return Status::OK();
+  }
+  // Don't let a length of 0 drop the rest of the container.
+  if (length == 0 || offset + length > log_block_->length()) {
+    length = log_block_->length() - offset;
+  }
+  return container_->DropCache(log_block_->offset() + offset, length);
+}
+
+Status LogReadableBlock::Prefetch(uint64_t offset, size_t length) const {
+  DCHECK(!closed_.Load());
+
+  if (offset >= log_block_->length()) {
+    return Status::OK();
+  }
+  if (offset + length > log_block_->length()) {
+    length = log_block_->length() - offset;
+  }
+  return container_->Prefetch(log_block_->offset() + offset, length);
+}
+
+bool LogReadableBlock::ReadMapped(uint64_t offset, size_t length, Slice* result,
+                                  shared_ptr<const FileMapping>* mapping) const {
+  DCHECK(!closed_.Load());
+
+  if (!container_->data_dir()->mmap_reads() ||
+      log_block_->length() < offset + length) {
+    return false;
+  }
+  Status s = container_->ReadMappedData(log_block_->offset() + offset, length,
+                                        result, mapping);
+  if (!s.ok()) {
+    KLOG_EVERY_N_SECS(WARNING, 60) << Substitute("could not map block $0: $1",
+                                                 id().ToString(), s.ToString());
+    return false;
+  }
+  if (container_->metrics()) {
+    container_->metrics()->generic_metrics.total_bytes_read->IncrementBy(length);
+  }
+  return true;
+}
+
 size_t LogReadableBlock::memory_footprint() const {
   return kudu_malloc_usable_size(this);
 }
@@ -1667,6 +2337,7 @@ size_t LogReadableBlock::memory_footprint() const {
 
 const char* LogBlockManager::kContainerMetadataFileSuffix = ".metadata";
 const char* LogBlockManager::kContainerDataFileSuffix = ".data";
+const char* LogBlockManager::kBlockMapCheckpointFileName = "block_map_checkpoint";
 
 // These values were arrived at via experimentation. See commit 4923a74 for
 // more details.
@@ -1714,6 +2385,11 @@ LogBlockManager::LogBlockManager(Env* env,
 }
 
 LogBlockManager::~LogBlockManager() {
+  // Wait for any container compaction to finish.
+  if (compaction_op_) {
+    compaction_op_->Unregister();
+  }
+
   // Release all of the memory accounted by the blocks.
   int64_t mem = 0;
   for (const auto& entry : blocks_by_block_id_) {
@@ -1772,8 +2448,26 @@ Status LogBlockManager::Open(FsReport* report) {
           dd->dir(), *limit);
     }
     InsertOrDie(&block_limits_by_data_dir_, dd.get(), limit);
+    if (FLAGS_log_block_manager_checkpoint_interval_records > 0) {
+      CHECK(checkpoint_state_by_data_dir_.emplace(
+          dd.get(), unique_ptr<CheckpointState>(new CheckpointState())).second);
+    }
   }
 
+  // Blocks committed together are synced on this pool, one thread per data
+  // directory.
+  RETURN_NOT_OK(ThreadPoolBuilder("lbm-sync")
+                .set_max_threads(dd_manager_->data_dirs().size())
+                .Build(&sync_pool_));
+
+  // Containers are opened on a pool shared by all of the data directories, so
+  // that a directory with many containers doesn't hold up startup.
+  gscoped_ptr<ThreadPool> open_pool;
+  RETURN_NOT_OK(ThreadPoolBuilder("lbm-open")
+                .set_max_threads(FLAGS_log_block_manager_open_threads > 0 ?
+                                 FLAGS_log_block_manager_open_threads : base::NumCPUs())
+                .Build(&open_pool));
+
   vector<FsReport> reports(dd_manager_->data_dirs().size());
   vector<Status> statuses(dd_manager_->data_dirs().size());
   int i = -1;
@@ -1792,6 +2486,7 @@ Status LogBlockManager::Open(FsReport* report) {
         Bind(&LogBlockManager::OpenDataDir,
              Unretained(this),
              dd.get(),
+             open_pool.get(),
              &reports[i],
              &statuses[i]));
   }
@@ -1880,7 +2575,7 @@ Status LogBlockManager::OpenBlock(const BlockId& block_id,
 unique_ptr<BlockCreationTransaction> LogBlockManager::NewCreationTransaction() {
   CHECK(!opts_.read_only);
   return unique_ptr<internal::LogBlockCreationTransaction>(
-      new internal::LogBlockCreationTransaction());
+      new internal::LogBlockCreationTransaction(this));
 }
 
 shared_ptr<BlockDeletionTransaction> LogBlockManager::NewDeletionTransaction() {
@@ -1888,6 +2583,16 @@ shared_ptr<BlockDeletionTransaction> LogBlockManager::NewDeletionTransaction() {
   return std::make_shared<internal::LogBlockDeletionTransaction>(this);
 }
 
+void LogBlockManager::RegisterMaintenanceOps(MaintenanceManager* maintenance_manager) {
+  // The op's metrics need an entity to belong to.
+  if (opts_.read_only || !opts_.metric_entity) {
+    return;
+  }
+  CHECK(!compaction_op_);
+  compaction_op_.reset(new internal::LogBlockContainerCompactionOp(this));
+  maintenance_manager->RegisterOp(compaction_op_.get());
+}
+
 Status LogBlockManager::GetAllBlockIds(vector<BlockId>* block_ids) {
   std::lock_guard<simple_spinlock> l(lock_);
   block_ids->assign(open_block_ids_.begin(), open_block_ids_.end());
@@ -1910,7 +2615,8 @@ void LogBlockManager::AddNewContainerUnlocked(LogBlockContainer* container) {
   }
 }
 
-void LogBlockManager::RemoveFullContainerUnlocked(const string& container_name) {
+unique_ptr<LogBlockContainer> LogBlockManager::RemoveFullContainerUnlocked(
+    const string& container_name) {
   DCHECK(lock_.is_locked());
   unique_ptr<LogBlockContainer> to_delete(EraseKeyReturnValuePtr(
       &all_containers_by_name_, container_name));
@@ -1921,13 +2627,63 @@ void LogBlockManager::RemoveFullContainerUnlocked(const string& container_name)
     metrics()->containers->Decrement();
     metrics()->full_containers->Decrement();
   }
+  return to_delete;
+}
+
+void LogBlockManager::DeleteContainerIfDead(LogBlockContainer* container,
+                                            bool finished_compacting) {
+  unique_ptr<LogBlockContainer> to_delete;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    if (finished_compacting) {
+      container->set_compacting(false);
+    }
+    if (!FLAGS_log_block_manager_delete_dead_containers || !container->dead()) {
+      return;
+    }
+    // Containers are only made available while they aren't full, but
+    // --log_container_max_size may have been lowered since.
+    auto& available = available_containers_by_data_dir_[container->data_dir()];
+    available.erase(std::remove(available.begin(), available.end(), container),
+                    available.end());
+    to_delete = RemoveFullContainerUnlocked(container->ToString());
+  }
+  const string name = to_delete->ToString();
+  DataDir* dir = to_delete->data_dir();
+  // Close the container's files before deleting them.
+  to_delete.reset();
+
+  // The metadata file is deleted first: should the server crash before the
+  // data file is deleted too, the data file is found to be incomplete and
+  // deleted at the next startup.
+  string data_file_name = StrCat(name, kContainerDataFileSuffix);
+  string metadata_file_name = StrCat(name, kContainerMetadataFileSuffix);
+  Status s = file_cache_.DeleteFile(metadata_file_name);
+  if (s.ok()) {
+    s = file_cache_.DeleteFile(data_file_name);
+  }
+  if (s.ok()) {
+    s = env_->SyncDir(dir->dir());
+  }
+  HANDLE_DISK_FAILURE(s, error_manager_->RunErrorNotificationCb(dir));
+  WARN_NOT_OK(s, "Could not delete dead container " + name);
+  if (s.ok()) {
+    VLOG(1) << "Deleted dead container " << name;
+    if (metrics()) {
+      metrics()->dead_containers_deleted->Increment();
+    }
+  }
 }
 
 Status LogBlockManager::GetOrCreateContainer(const CreateBlockOptions& opts,
                                              LogBlockContainer** container) {
   DataDir* dir;
   RETURN_NOT_OK(dd_manager_->GetNextDataDir(opts, &dir));
+  return GetOrCreateContainerInDir(dir, container);
+}
 
+Status LogBlockManager::GetOrCreateContainerInDir(DataDir* dir,
+                                                  LogBlockContainer** container) {
   {
     std::lock_guard<simple_spinlock> l(lock_);
     auto& d = available_containers_by_data_dir_[DCHECK_NOTNULL(dir)];
@@ -1943,8 +2699,8 @@ Status LogBlockManager::GetOrCreateContainer(const CreateBlockOptions& opts,
   Status s = LogBlockContainer::Create(this, dir, &new_container);
 
   // We could create a container in a different directory, but there's
-  // currently no point in doing so. On disk failure, the tablet specified by
-  // 'opts' will be shut down, so the returned container would not be used.
+  // currently no point in doing so. On disk failure, the tablets using 'dir'
+  // will be shut down, so the returned container would not be used.
   HANDLE_DISK_FAILURE(s, error_manager_->RunErrorNotificationCb(dir));
   RETURN_NOT_OK_PREPEND(s, "Could not create new log block container at " + dir->dir());
   {
@@ -2083,34 +2839,49 @@ Status LogBlockManager::RemoveLogBlocks(vector<BlockId> block_ids,
     metrics()->bytes_under_management->DecrementBy(blocks_length);
   }
 
+  // Group the blocks by container, so that the deletion records of each
+  // container's blocks are appended with a single write. When deleting a
+  // tablet, that's one write per container instead of one per block.
+  unordered_map<LogBlockContainer*, vector<scoped_refptr<LogBlock>>> lbs_by_container;
   for (auto& lb : lbs) {
-    VLOG(3) << "Deleting block " << lb->block_id();
-    lb->container()->BlockDeleted(lb);
+    lbs_by_container[lb->container()].emplace_back(std::move(lb));
+  }
+  for (auto& e : lbs_by_container) {
+    LogBlockContainer* container = e.first;
+    vector<scoped_refptr<LogBlock>>& container_lbs = e.second;
+    container->BlockDeletionsPending(container_lbs.size());
+    vector<BlockRecordPB> records(container_lbs.size());
+    for (int i = 0; i < container_lbs.size(); i++) {
+      const auto& lb = container_lbs[i];
+      VLOG(3) << "Deleting block " << lb->block_id();
+      container->BlockDeleted(lb);
+      lb->block_id().CopyToPB(records[i].mutable_block_id());
+      records[i].set_op_type(DELETE);
+      records[i].set_timestamp_us(GetCurrentTimeMicros());
+    }
 
-    // Record the on-disk deletion.
+    // Record the on-disk deletions.
     //
-    // TODO(unknown): what if this fails? Should we restore the in-memory block?
-    BlockRecordPB record;
-    lb->block_id().CopyToPB(record.mutable_block_id());
-    record.set_op_type(DELETE);
-    record.set_timestamp_us(GetCurrentTimeMicros());
-    Status s = lb->container()->AppendMetadata(record);
-
     // We don't bother fsyncing the metadata append for deletes in order to avoid
     // the disk overhead. Even if we did fsync it, we'd still need to account for
     // garbage at startup time (in the event that we crashed just before the
     // fsync).
     //
+    // TODO(unknown): what if this fails? Should we restore the in-memory blocks?
     // TODO(KUDU-829): Implement GC of orphaned blocks.
-
+    Status s = container->AppendMetadata(records);
     if (!s.ok()) {
+      // The space of the blocks won't be reclaimed, which keeps the container
+      // from being deleted until the next startup.
       if (first_failure.ok()) {
         first_failure = s.CloneAndPrepend(
             "Unable to append deletion record to block metadata");
       }
     } else {
-      deleted->emplace_back(lb->block_id());
-      log_blocks->emplace_back(std::move(lb));
+      for (auto& lb : container_lbs) {
+        deleted->emplace_back(lb->block_id());
+        log_blocks->emplace_back(std::move(lb));
+      }
     }
   }
 
@@ -2147,21 +2918,220 @@ Status LogBlockManager::RemoveLogBlockUnlocked(const BlockId& block_id,
   return Status::OK();
 }
 
-void LogBlockManager::OpenDataDir(DataDir* dir,
-                                  FsReport* report,
-                                  Status* result_status) {
-  FsReport local_report;
-  local_report.data_dirs.push_back(dir->dir());
+void LogBlockManager::FindSparseContainers(vector<LogBlockContainer*>* containers,
+                                           int64_t* num_containers,
+                                           bool for_compaction) {
+  containers->clear();
+  const double ratio = FLAGS_log_container_live_data_before_compact_ratio;
+  const set<int> failed_dirs = dd_manager_->GetFailedDataDirs();
+  vector<std::pair<double, LogBlockContainer*>> sparse;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    *num_containers = all_containers_by_name_.size();
+    if (ratio <= 0) {
+      return;
+    }
+    for (const auto& e : all_containers_by_name_) {
+      LogBlockContainer* container = e.second;
+      // Containers without live blocks are deleted once the space of their
+      // blocks is reclaimed, or at startup.
+      if (!container->full() || container->read_only() || container->compacting() ||
+          container->live_blocks() == 0 || container->total_bytes() == 0) {
+        continue;
+      }
+      if (!failed_dirs.empty()) {
+        int uuid_idx;
+        CHECK(dd_manager_->FindUuidIndexByDataDir(container->data_dir(), &uuid_idx));
+        if (ContainsKey(failed_dirs, uuid_idx)) {
+          continue;
+        }
+      }
+      double live_ratio = static_cast<double>(container->live_bytes_aligned()) /
+                          container->total_bytes();
+      if (live_ratio < ratio) {
+        sparse.emplace_back(live_ratio, container);
+        if (for_compaction) {
+          container->set_compacting(true);
+        }
+      }
+    }
+  }
+  std::sort(sparse.begin(), sparse.end());
+  for (const auto& e : sparse) {
+    containers->push_back(e.second);
+  }
+}
+
+Status LogBlockManager::CompactContainers(int64_t max_bytes) {
+  vector<LogBlockContainer*> containers;
+  int64_t num_containers;
+  FindSparseContainers(&containers, &num_containers, /*for_compaction=*/true);
+
+  Status first_failure;
+  int64_t bytes_moved = 0;
+  for (LogBlockContainer* container : containers) {
+    // Compacting the container may leave it dead, in which case it may be
+    // deleted once it's done with.
+    SCOPED_CLEANUP({ DeleteContainerIfDead(container, /*finished_compacting=*/true); });
+    if (bytes_moved >= max_bytes || (compaction_op_ && compaction_op_->cancelled())) {
+      continue;
+    }
+    Status s = CompactContainer(container, &bytes_moved);
+    if (!s.ok()) {
+      HANDLE_DISK_FAILURE(s, error_manager_->RunErrorNotificationCb(container->data_dir()));
+      if (first_failure.ok()) {
+        first_failure = s.CloneAndPrepend(
+            Substitute("Could not compact container $0", container->ToString()));
+      }
+    }
+  }
+  return first_failure;
+}
+
+Status LogBlockManager::CompactContainer(LogBlockContainer* container, int64_t* bytes_moved) {
+  // Find the container's live blocks. Rather than scanning the whole block
+  // map under 'lock_', the container's metadata is read; blocks that were
+  // deleted since are filtered out by looking them up in the block map.
+  BlockIdSet live_block_ids;
+  {
+    unique_ptr<RandomAccessFile> file;
+    RETURN_NOT_OK(env_->NewRandomAccessFile(
+        StrCat(container->ToString(), kContainerMetadataFileSuffix), &file));
+    ReadablePBContainerFile reader(std::move(file));
+    RETURN_NOT_OK(reader.Open());
+    BlockRecordPB record;
+    Status s;
+    while ((s = reader.ReadNextPB(&record)).ok()) {
+      BlockId block_id = BlockId::FromPB(record.block_id());
+      if (record.op_type() == CREATE) {
+        live_block_ids.insert(block_id);
+      } else if (record.op_type() == DELETE) {
+        live_block_ids.erase(block_id);
+      }
+    }
+    // A trailing partial record may be one that is still being appended.
+    if (!s.IsEndOfFile() && !s.IsIncomplete()) {
+      return s;
+    }
+  }
+  vector<scoped_refptr<LogBlock>> blocks;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    for (const auto& block_id : live_block_ids) {
+      scoped_refptr<LogBlock> lb = FindPtrOrNull(blocks_by_block_id_, block_id);
+      if (lb && lb->container() == container) {
+        blocks.emplace_back(std::move(lb));
+      }
+    }
+  }
 
-  // We are going to perform these checks.
+  // Read the blocks in the order in which they're laid out.
+  std::sort(blocks.begin(), blocks.end(),
+            [](const scoped_refptr<LogBlock>& a, const scoped_refptr<LogBlock>& b) {
+              return a->offset() < b->offset();
+            });
+  const int num_blocks = blocks.size();
+  while (!blocks.empty()) {
+    LogBlockContainer* dest;
+    RETURN_NOT_OK(GetOrCreateContainerInDir(container->data_dir(), &dest));
+    vector<scoped_refptr<LogBlock>> copies;
+    RETURN_NOT_OK(dest->CopyBlocks(blocks, &copies));
+    if (PREDICT_FALSE(copies.empty())) {
+      return Status::IllegalState(Substitute("Could not copy blocks to container $0",
+                                             dest->ToString()));
+    }
+    for (const auto& copy : copies) {
+      *bytes_moved += copy->length();
+    }
+    vector<scoped_refptr<LogBlock>> originals(blocks.begin(),
+                                              blocks.begin() + copies.size());
+    blocks.erase(blocks.begin(), blocks.begin() + copies.size());
+    RETURN_NOT_OK(SwitchToBlockCopies(std::move(originals), std::move(copies)));
+  }
+  VLOG(1) << Substitute("Moved $0 live blocks out of container $1",
+                        num_blocks, container->ToString());
+  return Status::OK();
+}
+
+Status LogBlockManager::SwitchToBlockCopies(vector<scoped_refptr<LogBlock>> originals,
+                                            vector<scoped_refptr<LogBlock>> copies) {
+  DCHECK_EQ(originals.size(), copies.size());
+
+  // Point the block map at the copies. The copies of blocks that were deleted
+  // while being copied are deleted in turn.
+  vector<scoped_refptr<LogBlock>> moved;
+  vector<scoped_refptr<LogBlock>> orphaned;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    for (int i = 0; i < originals.size(); i++) {
+      scoped_refptr<LogBlock>* entry = FindOrNull(blocks_by_block_id_,
+                                                  originals[i]->block_id());
+      if (entry && entry->get() == originals[i].get()) {
+        *entry = copies[i];
+        moved.emplace_back(std::move(originals[i]));
+      } else {
+        orphaned.emplace_back(std::move(copies[i]));
+      }
+    }
+  }
+
+  // Record the deletion of the moved blocks from their original container
+  // (and of the orphaned copies from theirs), then reclaim their space once
+  // they're no longer being read.
   //
-  // Note: this isn't necessarily the complete set of FsReport checks; there
-  // may be checks that the LBM cannot perform.
-  local_report.full_container_space_check.emplace();
-  local_report.incomplete_container_check.emplace();
-  local_report.malformed_record_check.emplace();
-  local_report.misaligned_block_check.emplace();
-  local_report.partial_record_check.emplace();
+  // The deletion of the originals must be durable before their space is
+  // reclaimed: until then, either copy of a block may be kept at startup.
+  shared_ptr<LogBlockDeletionTransaction> transaction =
+      std::make_shared<LogBlockDeletionTransaction>(this);
+  for (auto* lbs : { &moved, &orphaned }) {
+    if (lbs->empty()) {
+      continue;
+    }
+    LogBlockContainer* container = lbs->front()->container();
+    vector<BlockRecordPB> records(lbs->size());
+    for (int i = 0; i < lbs->size(); i++) {
+      (*lbs)[i]->block_id().CopyToPB(records[i].mutable_block_id());
+      records[i].set_op_type(DELETE);
+      records[i].set_timestamp_us(GetCurrentTimeMicros());
+    }
+    RETURN_NOT_OK(container->AppendMetadata(records));
+    RETURN_NOT_OK(container->SyncMetadata());
+    container->BlockDeletionsPending(lbs->size());
+    for (const auto& lb : *lbs) {
+      container->BlockDeleted(lb);
+      lb->RegisterDeletion(transaction);
+      transaction->AddBlock(lb);
+    }
+  }
+  return Status::OK();
+}
+
+struct LogBlockManager::OpenDataDirState {
+  explicit OpenDataDirState(DataDir* d)
+      : dir(d),
+        last_opened_container_log_time(MonoTime::Now()) {
+    report.data_dirs.push_back(dir->dir());
+
+    // We are going to perform these checks.
+    //
+    // Note: this isn't necessarily the complete set of FsReport checks; there
+    // may be checks that the LBM cannot perform.
+    report.full_container_space_check.emplace();
+    report.incomplete_container_check.emplace();
+    report.malformed_record_check.emplace();
+    report.misaligned_block_check.emplace();
+    report.partial_record_check.emplace();
+  }
+
+  DataDir* const dir;
+
+  // Protects all of the below.
+  Mutex lock;
+
+  // The first error encountered while opening a container, if any.
+  Status status;
+
+  FsReport report;
 
   // Keep track of deleted blocks whose space hasn't been punched; they will
   // be repunched during repair.
@@ -2175,7 +3145,21 @@ void LogBlockManager::OpenDataDir(DataDir* dir,
   // files will be compacted during repair.
   unordered_map<string, vector<BlockRecordPB>> low_live_block_containers;
 
-  // Find all containers and open them.
+  MonoTime last_opened_container_log_time;
+
+  // The new block map checkpoint of the data directory, if one is being
+  // written.
+  unique_ptr<WritablePBContainerFile> checkpoint_writer;
+};
+
+void LogBlockManager::OpenDataDir(DataDir* dir,
+                                  ThreadPool* pool,
+                                  FsReport* report,
+                                  Status* result_status) {
+  OpenDataDirState state(dir);
+
+  // Find all containers.
+  vector<string> container_names;
   unordered_set<string> containers_seen;
   vector<string> children;
   Status s = env_->GetChildren(dir->dir(), &children);
@@ -2185,7 +3169,6 @@ void LogBlockManager::OpenDataDir(DataDir* dir,
         "Could not list children of $0", dir->dir()));
     return;
   }
-  MonoTime last_opened_container_log_time = MonoTime::Now();
   for (const string& child : children) {
     string container_name;
     if (!TryStripSuffixString(
@@ -2194,223 +3177,557 @@ void LogBlockManager::OpenDataDir(DataDir* dir,
             child, LogBlockManager::kContainerMetadataFileSuffix, &container_name)) {
       continue;
     }
-    if (!InsertIfNotPresent(&containers_seen, container_name)) {
-      continue;
+    if (InsertIfNotPresent(&containers_seen, container_name)) {
+      container_names.emplace_back(std::move(container_name));
     }
+  }
 
-    unique_ptr<LogBlockContainer> container;
-    s = LogBlockContainer::Open(
-        this, dir, &local_report, container_name, &container);
-    if (s.IsAborted()) {
-      // Skip the container. Open() added a record of it to 'local_report' for us.
-      continue;
+  // Checkpoints are optional: if the existing one can't be read, all of the
+  // metadata files are read in their entirety instead.
+  const bool use_checkpoints = FLAGS_log_block_manager_checkpoint_interval_records > 0;
+  const string checkpoint_path = JoinPathSegments(dir->dir(), kBlockMapCheckpointFileName);
+  unique_ptr<ReadablePBContainerFile> checkpoint_reader;
+  if (use_checkpoints) {
+    unique_ptr<RandomAccessFile> file;
+    s = env_->NewRandomAccessFile(checkpoint_path, &file);
+    if (s.ok()) {
+      checkpoint_reader.reset(new ReadablePBContainerFile(std::move(file)));
+      s = checkpoint_reader->Open();
     }
     if (!s.ok()) {
-      *result_status = s.CloneAndPrepend(Substitute(
-          "Could not open container $0", container_name));
-      return;
+      if (!s.IsNotFound()) {
+        HANDLE_DISK_FAILURE(s, error_manager_->RunErrorNotificationCb(dir));
+        WARN_NOT_OK(s, "Could not open block map checkpoint " + checkpoint_path);
+      }
+      checkpoint_reader.reset();
+    }
+  }
+  string tmp_checkpoint_path;
+  if (use_checkpoints && !opts_.read_only) {
+    unique_ptr<RWFile> file;
+    s = env_->NewTempRWFile(RWFileOptions(), checkpoint_path + kTmpInfix + ".XXXXXX",
+                            &tmp_checkpoint_path, &file);
+    if (s.ok()) {
+      state.checkpoint_writer.reset(new WritablePBContainerFile(std::move(file)));
+      s = state.checkpoint_writer->CreateNew(LogBlockContainerCheckpointPB());
     }
-
-    // Process the records, building a container-local map for live blocks and
-    // a list of dead blocks.
-    //
-    // It's important that we don't try to add these blocks to the global map
-    // incrementally as we see each record, since it's possible that one container
-    // has a "CREATE <b>" while another has a "CREATE <b> ; DELETE <b>" pair.
-    // If we processed those two containers in this order, then upon processing
-    // the second container, we'd think there was a duplicate block. Building
-    // the container-local map first ensures that we discount deleted blocks
-    // before checking for duplicate IDs.
-    //
-    // NOTE: Since KUDU-1538, we allocate sequential block IDs, which makes reuse
-    // exceedingly unlikely. However, we might have old data which still exhibits
-    // the above issue.
-    UntrackedBlockMap live_blocks;
-    BlockRecordMap live_block_records;
-    vector<scoped_refptr<internal::LogBlock>> dead_blocks;
-    uint64_t max_block_id = 0;
-    s = container->ProcessRecords(&local_report,
-                                  &live_blocks,
-                                  &live_block_records,
-                                  &dead_blocks,
-                                  &max_block_id);
     if (!s.ok()) {
-      *result_status = s.CloneAndPrepend(Substitute(
-          "Could not process records in container $0", container->ToString()));
+      HANDLE_DISK_FAILURE(s, error_manager_->RunErrorNotificationCb(dir));
+      WARN_NOT_OK(s, "Could not create block map checkpoint in " + dir->dir());
+      state.checkpoint_writer.reset();
+    }
+  }
+  auto tmp_checkpoint_deleter = MakeScopedCleanup([&]() {
+    if (state.checkpoint_writer) {
+      WARN_NOT_OK(env_->DeleteFile(tmp_checkpoint_path),
+                  "Could not delete file " + tmp_checkpoint_path);
+    }
+  });
+
+  // Open the containers in parallel. Containers with a checkpoint entry are
+  // opened in the order of the checkpoint, so it can be read as it goes
+  // rather than all at once; the number of containers queued at any time is
+  // bounded for the same reason.
+  static const int kMaxQueuedContainers = 64;
+  Semaphore queued_containers(kMaxQueuedContainers);
+  unique_ptr<ThreadPoolToken> token = pool->NewToken(ThreadPool::ExecutionMode::CONCURRENT);
+  auto open_container = [&](const string& container_name,
+                            shared_ptr<LogBlockContainerCheckpointPB> checkpoint) {
+    queued_containers.Acquire();
+    auto task = [this, &state, &queued_containers, container_name, checkpoint]() {
+      OpenContainer(&state, container_name, checkpoint.get());
+      queued_containers.Release();
+    };
+    if (!token->SubmitFunc(task).ok()) {
+      task();
+    }
+  };
+  if (checkpoint_reader) {
+    while (true) {
+      shared_ptr<LogBlockContainerCheckpointPB> checkpoint(new LogBlockContainerCheckpointPB());
+      s = checkpoint_reader->ReadNextPB(checkpoint.get());
+      if (!s.ok()) {
+        break;
+      }
+      if (containers_seen.erase(checkpoint->container_id())) {
+        open_container(checkpoint->container_id(), std::move(checkpoint));
+      }
+    }
+    if (!s.IsEndOfFile()) {
+      HANDLE_DISK_FAILURE(s, error_manager_->RunErrorNotificationCb(dir));
+      WARN_NOT_OK(s, "Could not read block map checkpoint " + checkpoint_path);
+    }
+  }
+  for (const auto& container_name : container_names) {
+    if (ContainsKey(containers_seen, container_name)) {
+      open_container(container_name, nullptr);
+    }
+  }
+  token->Wait();
+
+  if (!state.status.ok()) {
+    *result_status = state.status;
+    return;
+  }
+
+  // Like the rest of Open(), repairs are performed per data directory to take
+  // advantage of parallelism.
+  s = Repair(dir,
+             pool,
+             &state.report,
+             std::move(state.need_repunching),
+             std::move(state.dead_containers),
+             std::move(state.low_live_block_containers));
+  if (!s.ok()) {
+    *result_status = s.CloneAndPrepend(Substitute(
+        "fatal error while repairing inconsistencies in data directory $0",
+        dir->dir()));
+    return;
+  }
+
+  // Replace the old checkpoint with the new one. Failures are non-fatal.
+  if (state.checkpoint_writer) {
+    s = state.checkpoint_writer->Sync();
+    if (s.ok()) {
+      s = state.checkpoint_writer->Close();
+    }
+    if (s.ok()) {
+      s = env_->RenameFile(tmp_checkpoint_path, checkpoint_path);
+    }
+    if (s.ok()) {
+      tmp_checkpoint_deleter.cancel();
+      s = env_->SyncDir(dir->dir());
+    }
+    HANDLE_DISK_FAILURE(s, error_manager_->RunErrorNotificationCb(dir));
+    WARN_NOT_OK(s, "Could not write block map checkpoint " + checkpoint_path);
+  }
+
+  *report = std::move(state.report);
+  *result_status = Status::OK();
+}
+
+void LogBlockManager::OpenContainer(OpenDataDirState* state,
+                                    const string& container_name,
+                                    const LogBlockContainerCheckpointPB* checkpoint) {
+  DataDir* dir = state->dir;
+  bool write_checkpoint;
+  {
+    MutexLock l(state->lock);
+    if (!state->status.ok()) {
+      // Another container failed to open; don't bother with this one.
       return;
     }
+    write_checkpoint = state->checkpoint_writer != nullptr;
+  }
+  auto set_status = [&](const Status& s) {
+    MutexLock l(state->lock);
+    if (state->status.ok()) {
+      state->status = s;
+    }
+  };
 
-    // With deleted blocks out of the way, check for misaligned blocks.
-    //
-    // We could also enforce that the record's offset is aligned with the
-    // underlying filesystem's block size, an invariant maintained by the log
-    // block manager. However, due to KUDU-1793, that invariant may have been
-    // broken, so we'll note but otherwise allow it.
-    for (const auto& e : live_blocks) {
-      if (PREDICT_FALSE(e.second->offset() %
-                        container->instance()->filesystem_block_size_bytes() != 0)) {
-        local_report.misaligned_block_check->entries.emplace_back(
-            container->ToString(), e.first);
+  // The checks and stats of this container, merged into the directory's
+  // report at the end.
+  FsReport local_report;
+  local_report.full_container_space_check.emplace();
+  local_report.incomplete_container_check.emplace();
+  local_report.malformed_record_check.emplace();
+  local_report.misaligned_block_check.emplace();
+  local_report.partial_record_check.emplace();
+
+  unique_ptr<LogBlockContainer> container;
+  Status s = LogBlockContainer::Open(
+      this, dir, &local_report, container_name, &container);
+  if (s.IsAborted()) {
+    // Skip the container. Open() added a record of it to 'local_report' for us.
+    MutexLock l(state->lock);
+    state->report.MergeFrom(local_report);
+    return;
+  }
+  if (!s.ok()) {
+    set_status(s.CloneAndPrepend(Substitute(
+        "Could not open container $0", container_name)));
+    return;
+  }
+
+  // Process the records, building a container-local map for live blocks and
+  // a list of dead blocks.
+  //
+  // It's important that we don't try to add these blocks to the global map
+  // incrementally as we see each record, since it's possible that one container
+  // has a "CREATE <b>" while another has a "CREATE <b> ; DELETE <b>" pair.
+  // If we processed those two containers in this order, then upon processing
+  // the second container, we'd think there was a duplicate block. Building
+  // the container-local map first ensures that we discount deleted blocks
+  // before checking for duplicate IDs.
+  //
+  // NOTE: Since KUDU-1538, we allocate sequential block IDs, which makes reuse
+  // exceedingly unlikely. However, we might have old data which still exhibits
+  // the above issue.
+  UntrackedBlockMap live_blocks;
+  BlockRecordMap live_block_records;
+  vector<scoped_refptr<internal::LogBlock>> dead_blocks;
+  uint64_t max_block_id = 0;
+  LogBlockContainerCheckpointPB new_checkpoint;
+  s = container->ProcessRecords(&local_report,
+                                &live_blocks,
+                                &live_block_records,
+                                &dead_blocks,
+                                &max_block_id,
+                                checkpoint,
+                                write_checkpoint ? &new_checkpoint : nullptr);
+  if (!s.ok()) {
+    set_status(s.CloneAndPrepend(Substitute(
+        "Could not process records in container $0", container->ToString())));
+    return;
+  }
+
+  // With deleted blocks out of the way, check for misaligned blocks.
+  //
+  // We could also enforce that the record's offset is aligned with the
+  // underlying filesystem's block size, an invariant maintained by the log
+  // block manager. However, due to KUDU-1793, that invariant may have been
+  // broken, so we'll note but otherwise allow it.
+  for (const auto& e : live_blocks) {
+    if (PREDICT_FALSE(e.second->offset() %
+                      container->instance()->filesystem_block_size_bytes() != 0)) {
+      local_report.misaligned_block_check->entries.emplace_back(
+          container->ToString(), e.first);
 
-      }
     }
+  }
 
-    if (container->full()) {
-      // Full containers without any live blocks can be deleted outright.
+  // Whether the container's metadata file will survive repair as is, and can
+  // therefore be checkpointed.
+  bool checkpointable = true;
+  bool dead = false;
+  vector<BlockRecordPB> records_to_compact;
+  vector<scoped_refptr<internal::LogBlock>> need_repunching;
+  if (container->full()) {
+    // Full containers without any live blocks can be deleted outright.
+    //
+    // TODO(adar): this should be reported as an inconsistency once dead
+    // container deletion is also done in real time. Until then, it would be
+    // confusing to report it as such since it'll be a natural event at startup.
+    if (container->live_blocks() == 0) {
+      DCHECK(live_blocks.empty());
+      dead = true;
+      checkpointable = false;
+    } else if (static_cast<double>(container->live_blocks()) /
+        container->total_blocks() <= FLAGS_log_container_live_metadata_before_compact_ratio) {
+      // Metadata files of containers with very few live blocks will be compacted.
       //
-      // TODO(adar): this should be reported as an inconsistency once dead
-      // container deletion is also done in real time. Until then, it would be
-      // confusing to report it as such since it'll be a natural event at startup.
-      if (container->live_blocks() == 0) {
-        DCHECK(live_blocks.empty());
-        dead_containers.emplace_back(container->ToString());
-      } else if (static_cast<double>(container->live_blocks()) /
-          container->total_blocks() <= FLAGS_log_container_live_metadata_before_compact_ratio) {
-        // Metadata files of containers with very few live blocks will be compacted.
-        //
-        // TODO(adar): this should be reported as an inconsistency once
-        // container metadata compaction is also done in realtime. Until then,
-        // it would be confusing to report it as such since it'll be a natural
-        // event at startup.
-        vector<BlockRecordPB> records(live_block_records.size());
-        int i = 0;
-        for (auto& e : live_block_records) {
-          records[i].Swap(&e.second);
-          i++;
+      // TODO(adar): this should be reported as an inconsistency once
+      // container metadata compaction is also done in realtime. Until then,
+      // it would be confusing to report it as such since it'll be a natural
+      // event at startup.
+      vector<BlockRecordPB> records(live_block_records.size());
+      int i = 0;
+      for (auto& e : live_block_records) {
+        records[i].Swap(&e.second);
+        i++;
+      }
+
+      // Sort the records such that their ordering reflects the ordering in
+      // the pre-compacted metadata file.
+      //
+      // This is preferred to storing the records in an order-preserving
+      // container (such as std::map) because while records are temporarily
+      // retained for every container, only some containers will actually
+      // undergo metadata compaction.
+      std::sort(records.begin(), records.end(),
+                [](const BlockRecordPB& a, const BlockRecordPB& b) {
+        // Sort by timestamp.
+        if (a.timestamp_us() != b.timestamp_us()) {
+          return a.timestamp_us() < b.timestamp_us();
         }
 
-        // Sort the records such that their ordering reflects the ordering in
-        // the pre-compacted metadata file.
+        // If the timestamps match, sort by offset.
         //
-        // This is preferred to storing the records in an order-preserving
-        // container (such as std::map) because while records are temporarily
-        // retained for every container, only some containers will actually
-        // undergo metadata compaction.
-        std::sort(records.begin(), records.end(),
-                  [](const BlockRecordPB& a, const BlockRecordPB& b) {
-          // Sort by timestamp.
-          if (a.timestamp_us() != b.timestamp_us()) {
-            return a.timestamp_us() < b.timestamp_us();
-          }
-
-          // If the timestamps match, sort by offset.
-          //
-          // If the offsets also match (i.e. both blocks are of zero length),
-          // it doesn't matter which of the two records comes first.
-          return a.offset() < b.offset();
-        });
-
-        low_live_block_containers[container->ToString()] = std::move(records);
+        // If the offsets also match (i.e. both blocks are of zero length),
+        // it doesn't matter which of the two records comes first.
+        return a.offset() < b.offset();
+      });
+
+      records_to_compact = std::move(records);
+      checkpointable = false;
+    }
+
+    // Having processed the block records, let's check whether any full
+    // containers have any extra space (left behind after a crash or from an
+    // older version of Kudu).
+    //
+    // Filesystems are unpredictable beasts and may misreport the amount of
+    // space allocated to a file in various interesting ways. Some examples:
+    // - XFS's speculative preallocation feature may artificially enlarge the
+    //   container's data file without updating its file size. This makes the
+    //   file size untrustworthy for the purposes of measuring allocated space.
+    //   See KUDU-1856 for more details.
+    // - On el6.6/ext4 a container data file that consumed ~32K according to
+    //   its extent tree was actually reported as consuming an additional fs
+    //   block (2k) of disk space. A similar container data file (generated
+    //   via the same workload) on Ubuntu 16.04/ext4 did not exhibit this.
+    //   The suspicion is that older versions of ext4 include interior nodes
+    //   of the extent tree when reporting file block usage.
+    //
+    // To deal with these issues, our extra space cleanup code (deleted block
+    // repunching and container truncation) is gated on an "actual disk space
+    // consumed" heuristic. To prevent unnecessary triggering of the
+    // heuristic, we allow for some slop in our size measurements. The exact
+    // amount of slop is configurable via
+    // log_container_excess_space_before_cleanup_fraction.
+    //
+    // Too little slop and we'll do unnecessary work at startup. Too much and
+    // more unused space may go unreclaimed.
+    //
+    // Deleted blocks covered by a checkpoint aren't known here, so they can't
+    // be repunched; truncation still reclaims any space past the last block.
+    string data_filename = StrCat(container->ToString(), kContainerDataFileSuffix);
+    uint64_t reported_size;
+    s = env_->GetFileSizeOnDisk(data_filename, &reported_size);
+    if (!s.ok()) {
+      HANDLE_DISK_FAILURE(s, error_manager_->RunErrorNotificationCb(dir));
+      set_status(s.CloneAndPrepend(Substitute(
+          "Could not get on-disk file size of container $0", container->ToString())));
+      return;
+    }
+    int64_t cleanup_threshold_size = container->live_bytes_aligned() *
+        (1 + FLAGS_log_container_excess_space_before_cleanup_fraction);
+    if (reported_size > cleanup_threshold_size) {
+      local_report.full_container_space_check->entries.emplace_back(
+          container->ToString(), reported_size - container->live_bytes_aligned());
+
+      // If the container is to be deleted outright, don't bother repunching
+      // its blocks. The report entry remains, however, so it's clear that
+      // there was a space discrepancy.
+      if (container->live_blocks()) {
+        need_repunching = std::move(dead_blocks);
       }
+    }
 
-      // Having processed the block records, let's check whether any full
-      // containers have any extra space (left behind after a crash or from an
-      // older version of Kudu).
-      //
-      // Filesystems are unpredictable beasts and may misreport the amount of
-      // space allocated to a file in various interesting ways. Some examples:
-      // - XFS's speculative preallocation feature may artificially enlarge the
-      //   container's data file without updating its file size. This makes the
-      //   file size untrustworthy for the purposes of measuring allocated space.
-      //   See KUDU-1856 for more details.
-      // - On el6.6/ext4 a container data file that consumed ~32K according to
-      //   its extent tree was actually reported as consuming an additional fs
-      //   block (2k) of disk space. A similar container data file (generated
-      //   via the same workload) on Ubuntu 16.04/ext4 did not exhibit this.
-      //   The suspicion is that older versions of ext4 include interior nodes
-      //   of the extent tree when reporting file block usage.
-      //
-      // To deal with these issues, our extra space cleanup code (deleted block
-      // repunching and container truncation) is gated on an "actual disk space
-      // consumed" heuristic. To prevent unnecessary triggering of the
-      // heuristic, we allow for some slop in our size measurements. The exact
-      // amount of slop is configurable via
-      // log_container_excess_space_before_cleanup_fraction.
-      //
-      // Too little slop and we'll do unnecessary work at startup. Too much and
-      // more unused space may go unreclaimed.
-      string data_filename = StrCat(container->ToString(), kContainerDataFileSuffix);
-      uint64_t reported_size;
-      s = env_->GetFileSizeOnDisk(data_filename, &reported_size);
+    local_report.stats.lbm_full_container_count++;
+  }
+  local_report.stats.live_block_bytes += container->live_bytes();
+  local_report.stats.live_block_bytes_aligned += container->live_bytes_aligned();
+  local_report.stats.live_block_count += container->live_blocks();
+  local_report.stats.lbm_container_count++;
+
+  next_block_id_.StoreMax(max_block_id + 1);
+
+  if (checkpointable && write_checkpoint) {
+    new_checkpoint.set_container_id(container_name);
+    for (const auto& e : live_block_records) {
+      *new_checkpoint.add_live_records() = e.second;
+    }
+  }
+
+  // Under the lock, merge this map into the main block map and add
+  // the container.
+  const string container_path = container->ToString();
+  LogBlockContainer* const container_ptr = container.get();
+  vector<scoped_refptr<LogBlock>> duplicate_blocks;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    // To avoid cacheline contention during startup, we aggregate all of the
+    // memory in a local and add it to the mem-tracker in a single increment
+    // at the end of this loop.
+    int64_t mem_usage = 0;
+    for (UntrackedBlockMap::value_type& e : live_blocks) {
+      int block_mem = kudu_malloc_usable_size(e.second.get());
+      if (PREDICT_FALSE(!AddLogBlockUnlocked(e.second))) {
+        duplicate_blocks.emplace_back(std::move(e.second));
+        continue;
+      }
+      mem_usage += block_mem;
+    }
+
+    mem_tracker_->Consume(mem_usage);
+    AddNewContainerUnlocked(container.get());
+    MakeContainerAvailableUnlocked(container.release());
+  }
+
+  // A block is alive in two containers if the block manager stopped while
+  // moving it from one container to the other during a container compaction.
+  // Both copies hold the same data, so the copy that was found first is kept
+  // and the other is deleted.
+  if (PREDICT_FALSE(!duplicate_blocks.empty())) {
+    BlockIdSet duplicate_ids;
+    vector<BlockRecordPB> records(duplicate_blocks.size());
+    for (int i = 0; i < duplicate_blocks.size(); i++) {
+      const auto& lb = duplicate_blocks[i];
+      LOG(WARNING) << Substitute("Found duplicate CREATE record for block $0 which "
+                                 "already is alive from another container when "
+                                 "processing container $1",
+                                 lb->block_id().ToString(), container_path);
+      duplicate_ids.insert(lb->block_id());
+      lb->block_id().CopyToPB(records[i].mutable_block_id());
+      records[i].set_op_type(DELETE);
+      records[i].set_timestamp_us(GetCurrentTimeMicros());
+    }
+    if (opts_.read_only) {
+      duplicate_blocks.clear();
+    } else {
+      s = container_ptr->AppendMetadata(records);
+      if (s.ok()) {
+        s = container_ptr->SyncMetadata();
+      }
       if (!s.ok()) {
         HANDLE_DISK_FAILURE(s, error_manager_->RunErrorNotificationCb(dir));
-        *result_status = s.CloneAndPrepend(Substitute(
-            "Could not get on-disk file size of container $0", container->ToString()));
+        set_status(s.CloneAndPrepend(Substitute(
+            "Could not delete duplicate blocks of container $0", container_path)));
         return;
       }
-      int64_t cleanup_threshold_size = container->live_bytes_aligned() *
-          (1 + FLAGS_log_container_excess_space_before_cleanup_fraction);
-      if (reported_size > cleanup_threshold_size) {
-        local_report.full_container_space_check->entries.emplace_back(
-            container->ToString(), reported_size - container->live_bytes_aligned());
-
-        // If the container is to be deleted outright, don't bother repunching
-        // its blocks. The report entry remains, however, so it's clear that
-        // there was a space discrepancy.
-        if (container->live_blocks()) {
-          need_repunching.insert(need_repunching.end(),
-                                 dead_blocks.begin(), dead_blocks.end());
-        }
+      for (const auto& lb : duplicate_blocks) {
+        container_ptr->BlockDeleted(lb);
       }
-
-      local_report.stats.lbm_full_container_count++;
     }
-    local_report.stats.live_block_bytes += container->live_bytes();
-    local_report.stats.live_block_bytes_aligned += container->live_bytes_aligned();
-    local_report.stats.live_block_count += container->live_blocks();
-    local_report.stats.lbm_container_count++;
-
-    // Log number of containers opened every 10 seconds
-    MonoTime now = MonoTime::Now();
-    if ((now - last_opened_container_log_time).ToSeconds() > 10) {
-      LOG(INFO) << Substitute("Opened $0 log block containers in $1",
-                              local_report.stats.lbm_container_count, dir->dir());
-      last_opened_container_log_time = now;
+    // The duplicates mustn't be resurrected by a metadata compaction.
+    records_to_compact.erase(
+        std::remove_if(records_to_compact.begin(), records_to_compact.end(),
+                       [&](const BlockRecordPB& r) {
+                         return ContainsKey(duplicate_ids, BlockId::FromPB(r.block_id()));
+                       }),
+        records_to_compact.end());
+    need_repunching.insert(need_repunching.end(),
+                           duplicate_blocks.begin(), duplicate_blocks.end());
+  }
+
+  MutexLock l(state->lock);
+  if (dead) {
+    state->dead_containers.emplace_back(container_path);
+  }
+  if (!records_to_compact.empty()) {
+    state->low_live_block_containers[container_path] = std::move(records_to_compact);
+  }
+  state->need_repunching.insert(state->need_repunching.end(),
+                                need_repunching.begin(), need_repunching.end());
+  state->report.MergeFrom(local_report);
+  if (new_checkpoint.has_container_id() && state->checkpoint_writer) {
+    s = state->checkpoint_writer->Append(new_checkpoint);
+    if (!s.ok()) {
+      HANDLE_DISK_FAILURE(s, error_manager_->RunErrorNotificationCb(dir));
+      WARN_NOT_OK(s, "Could not append to block map checkpoint in " + dir->dir());
+      WARN_NOT_OK(env_->DeleteFile(state->checkpoint_writer->filename()),
+                  "Could not delete file " + state->checkpoint_writer->filename());
+      state->checkpoint_writer.reset();
     }
+  }
 
-    next_block_id_.StoreMax(max_block_id + 1);
+  // Log number of containers opened every 10 seconds
+  MonoTime now = MonoTime::Now();
+  if ((now - state->last_opened_container_log_time).ToSeconds() > 10) {
+    LOG(INFO) << Substitute("Opened $0 log block containers in $1",
+                            state->report.stats.lbm_container_count, dir->dir());
+    state->last_opened_container_log_time = now;
+  }
+}
 
-    // Under the lock, merge this map into the main block map and add
-    // the container.
-    {
-      std::lock_guard<simple_spinlock> l(lock_);
-      // To avoid cacheline contention during startup, we aggregate all of the
-      // memory in a local and add it to the mem-tracker in a single increment
-      // at the end of this loop.
-      int64_t mem_usage = 0;
-      for (UntrackedBlockMap::value_type& e : live_blocks) {
-        int block_mem = kudu_malloc_usable_size(e.second.get());
-        if (!AddLogBlockUnlocked(std::move(e.second))) {
-          // TODO(adar): track as an inconsistency?
-          LOG(FATAL) << "Found duplicate CREATE record for block " << e.first
-                     << " which already is alive from another container when "
-                     << " processing container " << container->ToString();
-        }
-        mem_usage += block_mem;
-      }
+void LogBlockManager::MetadataRecordAppended(DataDir* dir, int64_t num_records) {
+  const auto* state = FindOrNull(checkpoint_state_by_data_dir_, dir);
+  if (!state || FLAGS_log_block_manager_checkpoint_interval_records <= 0) {
+    // Checkpoints are disabled.
+    return;
+  }
+  CheckpointState* cs = state->get();
+  if (cs->records_since_checkpoint.IncrementBy(num_records) <
+      FLAGS_log_block_manager_checkpoint_interval_records) {
+    return;
+  }
+  if (!cs->in_progress.CompareAndSet(false, true)) {
+    return;
+  }
+  cs->records_since_checkpoint.Store(0);
+  dir->ExecClosure(Bind(&LogBlockManager::CheckpointDataDir, Unretained(this), dir));
+}
+
+void LogBlockManager::CheckpointDataDir(DataDir* dir) {
+  Status s = DoCheckpointDataDir(dir);
+  HANDLE_DISK_FAILURE(s, error_manager_->RunErrorNotificationCb(dir));
+  WARN_NOT_OK(s, "Could not update block map checkpoint of " + dir->dir());
+  FindOrDie(checkpoint_state_by_data_dir_, dir)->in_progress.Store(false);
+}
 
-      mem_tracker_->Consume(mem_usage);
-      AddNewContainerUnlocked(container.get());
-      MakeContainerAvailableUnlocked(container.release());
+Status LogBlockManager::DoCheckpointDataDir(DataDir* dir) {
+  // Maps the IDs of the directory's containers to their paths.
+  unordered_map<string, string> container_paths;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    for (const auto& e : all_containers_by_name_) {
+      if (e.second->data_dir() == dir) {
+        container_paths.emplace(BaseName(e.first), e.first);
+      }
     }
   }
+  const int64_t fs_block_size = dir->instance()->metadata()->filesystem_block_size_bytes();
+  const string checkpoint_path = JoinPathSegments(dir->dir(), kBlockMapCheckpointFileName);
 
-  // Like the rest of Open(), repairs are performed per data directory to take
-  // advantage of parallelism.
-  s = Repair(dir,
-             &local_report,
-             std::move(need_repunching),
-             std::move(dead_containers),
-             std::move(low_live_block_containers));
-  if (!s.ok()) {
-    *result_status = s.CloneAndPrepend(Substitute(
-        "fatal error while repairing inconsistencies in data directory $0",
-        dir->dir()));
-    return;
+  // As with metadata compaction, the new checkpoint is written to a temporary
+  // file and renamed over the old one.
+  unique_ptr<RWFile> tmp_file;
+  string tmp_path;
+  RETURN_NOT_OK(env_->NewTempRWFile(RWFileOptions(), checkpoint_path + kTmpInfix + ".XXXXXX",
+                                    &tmp_path, &tmp_file));
+  auto tmp_deleter = MakeScopedCleanup([&]() {
+    WARN_NOT_OK(env_->DeleteFile(tmp_path), "Could not delete file " + tmp_path);
+  });
+  WritablePBContainerFile writer(std::move(tmp_file));
+  RETURN_NOT_OK(writer.CreateNew(LogBlockContainerCheckpointPB()));
+
+  auto advance = [&](const string& container_path,
+                     LogBlockContainerCheckpointPB* checkpoint) -> Status {
+    Status s = AdvanceCheckpoint(env_, StrCat(container_path, kContainerMetadataFileSuffix),
+                                 fs_block_size, checkpoint);
+    if (s.IsNotFound()) {
+      // The container has since been deleted.
+      return Status::OK();
+    }
+    RETURN_NOT_OK(s);
+    return writer.Append(*checkpoint);
+  };
+
+  // Advance the containers of the old checkpoint, reading it one container at
+  // a time, then add the containers it doesn't know about.
+  unique_ptr<RandomAccessFile> file;
+  Status s = env_->NewRandomAccessFile(checkpoint_path, &file);
+  if (s.ok()) {
+    ReadablePBContainerFile reader(std::move(file));
+    s = reader.Open();
+    while (s.ok()) {
+      LogBlockContainerCheckpointPB checkpoint;
+      s = reader.ReadNextPB(&checkpoint);
+      if (!s.ok()) {
+        break;
+      }
+      string container_path;
+      if (!FindCopy(container_paths, checkpoint.container_id(), &container_path)) {
+        continue;
+      }
+      container_paths.erase(checkpoint.container_id());
+      RETURN_NOT_OK(advance(container_path, &checkpoint));
+    }
+    if (s.IsCorruption() || s.IsIncomplete()) {
+      LOG(WARNING) << Substitute("Ignoring the rest of block map checkpoint $0: $1",
+                                 checkpoint_path, s.ToString());
+    } else if (!s.IsEndOfFile()) {
+      return s;
+    }
+  } else if (!s.IsNotFound()) {
+    return s;
+  }
+  for (const auto& e : container_paths) {
+    LogBlockContainerCheckpointPB checkpoint;
+    checkpoint.set_container_id(e.first);
+    checkpoint.set_metadata_offset(0);
+    RETURN_NOT_OK(advance(e.second, &checkpoint));
   }
 
-  *report = std::move(local_report);
-  *result_status = Status::OK();
+  RETURN_NOT_OK(writer.Sync());
+  RETURN_NOT_OK(writer.Close());
+  RETURN_NOT_OK(env_->RenameFile(tmp_path, checkpoint_path));
+  tmp_deleter.cancel();
+  RETURN_NOT_OK(env_->SyncDir(dir->dir()));
+  VLOG(1) << "Updated block map checkpoint " << checkpoint_path;
+  return Status::OK();
 }
 
 #define RETURN_NOT_OK_LBM_DISK_FAILURE_PREPEND(status_expr, msg) do { \
@@ -2427,6 +3744,7 @@ void LogBlockManager::OpenDataDir(DataDir* dir,
 
 Status LogBlockManager::Repair(
     DataDir* dir,
+    ThreadPool* pool,
     FsReport* report,
     vector<scoped_refptr<internal::LogBlock>> need_repunching,
     vector<string> dead_containers,
@@ -2614,9 +3932,15 @@ Status LogBlockManager::Repair(
   need_repunching.clear();
 
   // "Compact" metadata files with few live blocks by rewriting them with only
-  // the live block records.
-  int64_t metadata_files_compacted = 0;
-  int64_t metadata_bytes_delta = 0;
+  // the live block records. Each rewrite syncs its new file, so the rewrites
+  // are done in parallel on 'pool'.
+  struct MetadataRewrite {
+    internal::LogBlockContainer* container;
+    const vector<BlockRecordPB>* records;
+    int64_t file_bytes_delta;
+    Status status;
+  };
+  vector<MetadataRewrite> rewrites;
   for (const auto& e : low_live_block_containers) {
     internal::LogBlockContainer* container = FindPtrOrNull(containers_by_name,
                                                            e.first);
@@ -2624,25 +3948,37 @@ Status LogBlockManager::Repair(
       // The container was deleted outright.
       continue;
     }
+    rewrites.push_back({ container, &e.second, 0, Status::OK() });
+  }
+  unique_ptr<ThreadPoolToken> token = pool->NewToken(ThreadPool::ExecutionMode::CONCURRENT);
+  for (auto& r : rewrites) {
+    auto task = [this, &r]() {
+      r.status = RewriteMetadataFile(*r.container, *r.records, &r.file_bytes_delta);
+    };
+    if (!token->SubmitFunc(task).ok()) {
+      task();
+    }
+  }
+  token->Wait();
 
-    // Rewrite this metadata file. Failures are non-fatal.
-    int64_t file_bytes_delta;
-    const auto& meta_path = StrCat(e.first, kContainerMetadataFileSuffix);
-    Status s = RewriteMetadataFile(*container, e.second, &file_bytes_delta);
-    if (!s.ok()) {
-      WARN_NOT_OK(s, "could not rewrite metadata file");
+  int64_t metadata_files_compacted = 0;
+  int64_t metadata_bytes_delta = 0;
+  for (const auto& r : rewrites) {
+    // Failures to rewrite a metadata file are non-fatal.
+    if (!r.status.ok()) {
+      WARN_NOT_OK(r.status, "could not rewrite metadata file");
       continue;
     }
 
     // However, we're hosed if we can't open the new metadata file.
-    RETURN_NOT_OK_PREPEND(container->ReopenMetadataWriter(),
+    RETURN_NOT_OK_PREPEND(r.container->ReopenMetadataWriter(),
                           "could not reopen new metadata file");
 
     metadata_files_compacted++;
-    metadata_bytes_delta += file_bytes_delta;
-    VLOG(1) << "Compacted metadata file " << meta_path
-            << " (saved " << file_bytes_delta << " bytes)";
-
+    metadata_bytes_delta += r.file_bytes_delta;
+    VLOG(1) << "Compacted metadata file "
+            << StrCat(r.container->ToString(), kContainerMetadataFileSuffix)
+            << " (saved " << r.file_bytes_delta << " bytes)";
   }
 
   // The data directory can be synchronized once for all of the new metadata files.
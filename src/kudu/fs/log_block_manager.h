@@ -33,6 +33,7 @@
 
 #include "kudu/fs/block_id.h"
 #include "kudu/fs/block_manager.h"
+#include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/util/atomic.h"
@@ -46,7 +47,10 @@ namespace kudu {
 
 class BlockRecordPB;
 class Env;
+class LogBlockContainerCheckpointPB;
+class MaintenanceManager;
 class RWFile;
+class ThreadPool;
 
 namespace fs {
 class DataDir;
@@ -57,6 +61,8 @@ struct FsReport;
 namespace internal {
 class LogBlock;
 class LogBlockContainer;
+class LogBlockContainerCompactionOp;
+class LogBlockCreationTransaction;
 class LogBlockDeletionTransaction;
 class LogWritableBlock;
 
@@ -181,6 +187,7 @@ class LogBlockManager : public BlockManager {
  public:
   static const char* kContainerMetadataFileSuffix;
   static const char* kContainerDataFileSuffix;
+  static const char* kBlockMapCheckpointFileName;
 
   // Note: all objects passed as pointers should remain alive for the lifetime
   // of the block manager.
@@ -209,6 +216,10 @@ class LogBlockManager : public BlockManager {
 
   FsErrorManager* error_manager() override { return error_manager_; }
 
+  // Registers a maintenance op which compacts sparse containers; see
+  // CompactContainers(). Only done if the block manager has a metric entity.
+  void RegisterMaintenanceOps(MaintenanceManager* maintenance_manager) override;
+
  private:
   FRIEND_TEST(LogBlockManagerTest, TestAbortBlock);
   FRIEND_TEST(LogBlockManagerTest, TestCloseFinalizedBlock);
@@ -221,8 +232,13 @@ class LogBlockManager : public BlockManager {
   FRIEND_TEST(LogBlockManagerTest, TestBumpBlockIds);
   FRIEND_TEST(LogBlockManagerTest, TestReuseBlockIds);
   FRIEND_TEST(LogBlockManagerTest, TestFailMultipleTransactionsPerContainer);
+  FRIEND_TEST(LogBlockManagerTest, TestBlockMapCheckpoint);
+  FRIEND_TEST(LogBlockManagerTest, TestGroupCommit);
+  FRIEND_TEST(LogBlockManagerTest, TestContainerCompaction);
 
   friend class internal::LogBlockContainer;
+  friend class internal::LogBlockContainerCompactionOp;
+  friend class internal::LogBlockCreationTransaction;
   friend class internal::LogBlockDeletionTransaction;
   friend class internal::LogWritableBlock;
 
@@ -267,11 +283,23 @@ class LogBlockManager : public BlockManager {
   // Must be called with 'lock_' held.
   void AddNewContainerUnlocked(internal::LogBlockContainer* container);
 
-  // Removes a previously added container from this block manager. The
-  // container must be full.
+  // Removes a previously added container from this block manager, returning
+  // it. The container must be full.
   //
   // Must be called with 'lock_' held.
-  void RemoveFullContainerUnlocked(const std::string& container_name);
+  std::unique_ptr<internal::LogBlockContainer> RemoveFullContainerUnlocked(
+      const std::string& container_name);
+
+  // Deletes 'container' from memory and disk if it's dead, i.e. it is full
+  // and none of its blocks are live, being written, or awaiting the
+  // reclamation of their space. Only done with
+  // --log_block_manager_delete_dead_containers.
+  //
+  // If 'finished_compacting' is true, the compaction of 'container' is
+  // finished first. The caller must not use 'container' afterwards unless it
+  // knows that the container can't be dead.
+  void DeleteContainerIfDead(internal::LogBlockContainer* container,
+                             bool finished_compacting = false);
 
   // Returns a container appropriate for the given CreateBlockOptions, creating
   // a new container if necessary.
@@ -282,6 +310,10 @@ class LogBlockManager : public BlockManager {
   Status GetOrCreateContainer(const CreateBlockOptions& opts,
                               internal::LogBlockContainer** container);
 
+  // Like GetOrCreateContainer(), but for a container in 'dir'.
+  Status GetOrCreateContainerInDir(DataDir* dir,
+                                   internal::LogBlockContainer** container);
+
   // Indicate that this container is no longer in use and can be handed out
   // to other writers.
   void MakeContainerAvailable(internal::LogBlockContainer* container);
@@ -331,16 +363,52 @@ class LogBlockManager : public BlockManager {
   Status RemoveLogBlockUnlocked(const BlockId& block_id,
                                 scoped_refptr<internal::LogBlock>* lb);
 
+  // Returns the full containers whose live blocks make up less than
+  // --log_container_live_data_before_compact_ratio of the data written to
+  // them, sparsest first. 'num_containers' is set to the total number of
+  // containers.
+  //
+  // If 'for_compaction' is true, containers already being compacted are
+  // skipped and the returned ones are marked as being compacted, so that
+  // they aren't deleted while in use; DeleteContainerIfDead() must then be
+  // called with 'finished_compacting' for each of them.
+  void FindSparseContainers(std::vector<internal::LogBlockContainer*>* containers,
+                            int64_t* num_containers,
+                            bool for_compaction = false);
+
+  // Compacts sparse containers, sparsest first, until at least 'max_bytes'
+  // of live blocks have been moved.
+  //
+  // A container is compacted by copying its live blocks to other containers
+  // in the same data directory, after which they're read from the copies and
+  // the original blocks are deleted. The container is thus left with no live
+  // blocks, and is deleted once the space of its blocks is reclaimed with
+  // --log_block_manager_delete_dead_containers, or at the next startup
+  // otherwise.
+  //
+  // Returns the first error encountered, if any.
+  Status CompactContainers(int64_t max_bytes);
+
+  // Compacts 'container', adding the number of bytes moved to 'bytes_moved'.
+  Status CompactContainer(internal::LogBlockContainer* container, int64_t* bytes_moved);
+
+  // Makes the block map point at 'copies' instead of the corresponding
+  // 'originals', and deletes the originals. The copies of any originals which
+  // were deleted in the meantime are deleted too.
+  Status SwitchToBlockCopies(std::vector<scoped_refptr<internal::LogBlock>> originals,
+                             std::vector<scoped_refptr<internal::LogBlock>> copies);
+
   // Repairs any inconsistencies for 'dir' described in 'report'.
   //
   // The following additional repairs will be performed:
   // 1. Blocks in 'need_repunching' will be punched out again.
   // 2. Containers in 'dead_containers' will be deleted from disk.
   // 3. Containers in 'low_live_block_containers' will have their metadata
-  //    files compacted.
+  //    files compacted, in parallel on 'pool'.
   //
   // Returns an error if repairing a fatal inconsistency failed.
   Status Repair(DataDir* dir,
+                ThreadPool* pool,
                 FsReport* report,
                 std::vector<scoped_refptr<internal::LogBlock>> need_repunching,
                 std::vector<std::string> dead_containers,
@@ -360,15 +428,51 @@ class LogBlockManager : public BlockManager {
                              const std::vector<BlockRecordPB>& records,
                              int64_t* file_bytes_delta);
 
+  // State shared by the tasks opening the containers of a data directory.
+  struct OpenDataDirState;
+
+  // Tracks when a data directory's block map checkpoint should be updated.
+  struct CheckpointState {
+    // The number of block records appended to the directory's containers
+    // since its checkpoint was last updated.
+    AtomicInt<int64_t> records_since_checkpoint { 0 };
+
+    // Whether a checkpoint update is scheduled or running.
+    AtomicBool in_progress { false };
+  };
+
   // Opens a particular data directory belonging to the block manager. The
   // results of consistency checking (and repair, if applicable) are written to
   // 'report'.
   //
+  // The directory's containers are opened in parallel on 'pool'. If the
+  // directory has a block map checkpoint, only the records appended to each
+  // container's metadata file since the checkpoint are read, and a new
+  // checkpoint is written once the directory has been opened.
+  //
   // Success or failure is set in 'result_status'.
   void OpenDataDir(DataDir* dir,
+                   ThreadPool* pool,
                    FsReport* report,
                    Status* result_status);
 
+  // Opens the container named 'container_name' and loads its blocks, merging
+  // the results into 'state'. If not null, 'checkpoint' is a previously taken
+  // checkpoint of the container.
+  void OpenContainer(OpenDataDirState* state,
+                     const std::string& container_name,
+                     const LogBlockContainerCheckpointPB* checkpoint);
+
+  // Called after 'num_records' block records have been appended to the
+  // metadata file of a container in 'dir'. Schedules an update of the directory's block map
+  // checkpoint if enough records have been appended since the last one.
+  void MetadataRecordAppended(DataDir* dir, int64_t num_records);
+
+  // Updates the block map checkpoint of 'dir' by replaying the records
+  // appended to its containers since the previous checkpoint.
+  void CheckpointDataDir(DataDir* dir);
+  Status DoCheckpointDataDir(DataDir* dir);
+
   // Perform basic initialization.
   Status Init();
 
@@ -417,6 +521,11 @@ class LogBlockManager : public BlockManager {
   std::unordered_map<const DataDir*,
                      boost::optional<int64_t>> block_limits_by_data_dir_;
 
+  // Maps a data directory to the state of its block map checkpoint. Only
+  // populated if checkpoints are enabled; not modified after Open().
+  std::unordered_map<const DataDir*,
+                     std::unique_ptr<CheckpointState>> checkpoint_state_by_data_dir_;
+
   // Manages files opened for reading.
   FileCache<RWFile> file_cache_;
 
@@ -462,6 +571,14 @@ class LogBlockManager : public BlockManager {
   // May be null if instantiated without metrics.
   std::unique_ptr<internal::LogBlockManagerMetrics> metrics_;
 
+  // Syncs the containers of a BlockCreationTransaction which span several
+  // data directories in parallel. Created by Open().
+  gscoped_ptr<ThreadPool> sync_pool_;
+
+  // Compacts sparse containers in the background. Null unless registered
+  // with a maintenance manager.
+  std::unique_ptr<internal::LogBlockContainerCompactionOp> compaction_op_;
+
   DISALLOW_COPY_AND_ASSIGN(LogBlockManager);
 };
 
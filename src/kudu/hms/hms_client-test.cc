@@ -19,14 +19,17 @@
 
 #include <cstdint>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
 #include <glog/stl_logging.h> // IWYU pragma: keep
 #include <gtest/gtest.h>
 
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/hms/hive_metastore_constants.h"
 #include "kudu/hms/hive_metastore_types.h"
+#include "kudu/hms/hms_client_pool.h"
 #include "kudu/hms/mini_hms.h"
 #include "kudu/util/status.h"
 #include "kudu/util/test_macros.h"
@@ -34,7 +37,9 @@
 
 using std::make_pair;
 using std::string;
+using std::thread;
 using std::vector;
+using strings::Substitute;
 
 namespace kudu {
 namespace hms {
@@ -42,10 +47,9 @@ namespace hms {
 class HmsClientTest : public KuduTest {
  public:
 
-  Status CreateTable(HmsClient* client,
-                     const string& database_name,
-                     const string& table_name,
-                     const string& table_id) {
+  static hive::Table MakeTable(const string& database_name,
+                               const string& table_name,
+                               const string& table_id) {
     hive::Table table;
     table.dbName = database_name;
     table.tableName = table_name;
@@ -57,17 +61,27 @@ class HmsClientTest : public KuduTest {
         make_pair(hive::g_hive_metastore_constants.META_TABLE_STORAGE,
                   HmsClient::kKuduStorageHandler),
     });
+    return table;
+  }
 
-    return client->CreateTable(table);
+  static hive::EnvironmentContext MakeDropContext(const string& table_id) {
+    hive::EnvironmentContext env_ctx;
+    env_ctx.__set_properties({ make_pair(HmsClient::kKuduTableIdKey, table_id) });
+    return env_ctx;
+  }
+
+  Status CreateTable(HmsClient* client,
+                     const string& database_name,
+                     const string& table_name,
+                     const string& table_id) {
+    return client->CreateTable(MakeTable(database_name, table_name, table_id));
   }
 
   Status DropTable(HmsClient* client,
                    const string& database_name,
                    const string& table_name,
                    const string& table_id) {
-    hive::EnvironmentContext env_ctx;
-    env_ctx.__set_properties({ make_pair(HmsClient::kKuduTableIdKey, table_id) });
-    return client->DropTableWithContext(database_name, table_name, env_ctx);
+    return client->DropTableWithContext(database_name, table_name, MakeDropContext(table_id));
   }
 };
 
@@ -196,6 +210,137 @@ TEST_F(HmsClientTest, TestHmsOperations) {
   ASSERT_OK(client.Stop());
 }
 
+// Test the bulk operations, which pipeline their calls, with more tables than
+// there may be calls in flight.
+TEST_F(HmsClientTest, TestBulkOperations) {
+  MiniHms hms;
+  ASSERT_OK(hms.Start());
+
+  HmsClient client(hms.address());
+  ASSERT_OK(client.Start());
+
+  const string database_name = "bulk_db";
+  hive::Database db;
+  db.name = database_name;
+  ASSERT_OK(client.CreateDatabase(db));
+
+  const int kNumTables = HmsClient::kMaxPipelinedCalls * 2 + 10;
+  vector<string> table_names;
+  vector<string> table_ids;
+  vector<hive::Table> tables;
+  for (int i = 0; i < kNumTables; i++) {
+    table_names.emplace_back(Substitute("table_$0", i));
+    table_ids.emplace_back(Substitute("table-id-$0", i));
+    tables.emplace_back(MakeTable(database_name, table_names.back(), table_ids.back()));
+  }
+  vector<Status> statuses;
+  ASSERT_OK(client.CreateTables(tables, &statuses));
+  ASSERT_EQ(kNumTables, statuses.size());
+  for (const auto& s : statuses) {
+    ASSERT_OK(s);
+  }
+
+  // The failure of some of the calls doesn't affect the others.
+  vector<hive::Table> more_tables = {
+    tables[0],
+    MakeTable(database_name, "another_table", "another-table-id"),
+  };
+  ASSERT_OK(client.CreateTables(more_tables, &statuses));
+  ASSERT_EQ(2, statuses.size());
+  ASSERT_TRUE(statuses[0].IsAlreadyPresent()) << statuses[0].ToString();
+  ASSERT_OK(statuses[1]);
+
+  // Retrieve the tables with a single call, skipping a missing one.
+  vector<hive::Table> retrieved;
+  ASSERT_OK(client.GetTables(database_name, { table_names[0], "missing", table_names[1] },
+                             &retrieved));
+  ASSERT_EQ(2, retrieved.size());
+  for (const auto& table : retrieved) {
+    ASSERT_EQ(database_name, table.dbName);
+  }
+
+  // Alter all the tables, one of them with a bogus table ID.
+  ASSERT_OK(client.GetTables(database_name, table_names, &retrieved));
+  ASSERT_EQ(kNumTables, retrieved.size());
+  vector<string> altered_names;
+  for (auto& altered : retrieved) {
+    altered_names.emplace_back(altered.tableName);
+    altered.parameters["comment"] = "altered";
+    if (altered.tableName == table_names[1]) {
+      altered.parameters[HmsClient::kKuduTableIdKey] = "bogus-table-id";
+    }
+  }
+  ASSERT_OK(client.AlterTables(database_name, altered_names, retrieved, &statuses));
+  for (int i = 0; i < kNumTables; i++) {
+    if (altered_names[i] == table_names[1]) {
+      ASSERT_TRUE(statuses[i].IsRuntimeError()) << statuses[i].ToString();
+    } else {
+      ASSERT_OK(statuses[i]);
+    }
+  }
+  hive::Table table;
+  ASSERT_OK(client.GetTable(database_name, table_names.back(), &table));
+  ASSERT_EQ("altered", table.parameters["comment"]);
+
+  // Drop all the tables.
+  vector<hive::EnvironmentContext> env_ctxs;
+  for (const auto& table_id : table_ids) {
+    env_ctxs.emplace_back(MakeDropContext(table_id));
+  }
+  ASSERT_OK(client.DropTablesWithContext(database_name, table_names, env_ctxs, &statuses));
+  for (const auto& s : statuses) {
+    ASSERT_OK(s);
+  }
+  vector<string> remaining;
+  ASSERT_OK(client.GetAllTables(database_name, &remaining));
+  ASSERT_EQ(vector<string>({ "another_table" }), remaining);
+  ASSERT_OK(client.Stop());
+}
+
+// Test that concurrent users of a client pool share its clients.
+TEST_F(HmsClientTest, TestClientPool) {
+  MiniHms hms;
+  ASSERT_OK(hms.Start());
+
+  HmsClientPool pool(hms.address(), 2);
+  const string database_name = "pool_db";
+  ASSERT_OK(pool.WithClient([&] (HmsClient* client) {
+    hive::Database db;
+    db.name = database_name;
+    return client->CreateDatabase(db);
+  }));
+
+  const int kNumThreads = 8;
+  vector<thread> threads;
+  vector<Status> results(kNumThreads);
+  for (int i = 0; i < kNumThreads; i++) {
+    threads.emplace_back([&, i] {
+      results[i] = pool.WithClient([&] (HmsClient* client) {
+        return CreateTable(client, database_name, Substitute("table_$0", i),
+                           Substitute("table-id-$0", i));
+      });
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  for (const auto& s : results) {
+    ASSERT_OK(s);
+  }
+
+  // Errors of the operations are returned as-is.
+  Status s = pool.WithClient([&] (HmsClient* client) {
+    return CreateTable(client, database_name, "table_0", "table-id-0");
+  });
+  ASSERT_TRUE(s.IsAlreadyPresent()) << s.ToString();
+
+  vector<string> tables;
+  ASSERT_OK(pool.WithClient([&] (HmsClient* client) {
+    return client->GetAllTables(database_name, &tables);
+  }));
+  ASSERT_EQ(kNumThreads, tables.size());
+}
+
 TEST_F(HmsClientTest, TestDeserializeJsonTable) {
   string json = R"#({"1":{"str":"table_name"},"2":{"str":"database_name"}})#";
   hive::Table table;
@@ -18,6 +18,7 @@
 #include "kudu/hms/hms_client.h"
 
 #include <algorithm>
+#include <functional>
 #include <memory>
 #include <string>
 #include <type_traits>
@@ -28,8 +29,10 @@
 #include <thrift/Thrift.h>
 #include <thrift/protocol/TBinaryProtocol.h>
 #include <thrift/protocol/TJSONProtocol.h>
+#include <thrift/protocol/TProtocolException.h>
 #include <thrift/transport/TBufferTransports.h>
 #include <thrift/transport/TSocket.h>
+#include <thrift/transport/TTransportException.h>
 
 #include "kudu/gutil/strings/split.h"
 #include "kudu/gutil/strings/strip.h"
@@ -43,9 +46,11 @@
 using apache::thrift::TException;
 using apache::thrift::protocol::TBinaryProtocol;
 using apache::thrift::protocol::TJSONProtocol;
+using apache::thrift::protocol::TProtocolException;
 using apache::thrift::transport::TBufferedTransport;
 using apache::thrift::transport::TMemoryBuffer;
 using apache::thrift::transport::TSocket;
+using apache::thrift::transport::TTransportException;
 using std::make_shared;
 using std::shared_ptr;
 using std::string;
@@ -89,8 +94,36 @@ const char* const HmsClient::kDbNotificationListener =
 const char* const HmsClient::kKuduMetastorePlugin =
   "org.apache.kudu.hive.metastore.KuduMetastorePlugin";
 
+// Deep enough to hide the round trips, but shallow enough that the requests
+// and responses in flight fit in the socket buffers, so that the HMS never
+// blocks on sending responses while the client is still sending requests.
+const int HmsClient::kMaxPipelinedCalls = 64;
+
 const int kSlowExecutionWarningThresholdMs = 500;
 
+namespace {
+
+// Runs 'call', translating the exceptions it throws to a status. Sets
+// 'broken' if the exception left the connection unusable, i.e. if it was
+// raised by the transport or the protocol rather than sent by the HMS.
+Status RunCall(const std::function<void()>& call, const string& msg, bool* broken) {
+  auto guarded_call = [&]() {
+    try {
+      call();
+    } catch (const TTransportException&) {
+      *broken = true;
+      throw;
+    } catch (const TProtocolException&) {
+      *broken = true;
+      throw;
+    }
+  };
+  HMS_RET_NOT_OK(guarded_call(), msg);
+  return Status::OK();
+}
+
+} // anonymous namespace
+
 HmsClient::HmsClient(const HostPort& hms_address)
     : client_(nullptr) {
   auto socket = make_shared<TSocket>(hms_address.host(), hms_address.port());
@@ -192,6 +225,97 @@ Status HmsClient::DropTableWithContext(const string& database_name,
   return Status::OK();
 }
 
+Status HmsClient::PipelineCalls(size_t num_calls,
+                                const std::function<void(size_t)>& send,
+                                const std::function<void(size_t)>& recv,
+                                const string& msg,
+                                vector<Status>* statuses) {
+  DCHECK(statuses);
+  statuses->assign(num_calls, Status::OK());
+  size_t num_sent = 0;
+  size_t num_received = 0;
+  bool broken = false;
+  Status connection_status;
+  while (num_received < num_calls) {
+    while (num_sent < num_calls &&
+           num_sent - num_received < static_cast<size_t>(kMaxPipelinedCalls)) {
+      connection_status = RunCall([&] { send(num_sent); }, msg, &broken);
+      if (!connection_status.ok()) {
+        // Whether or not the exception broke the connection, the calls which
+        // were sent are in an unknown state.
+        broken = true;
+        break;
+      }
+      num_sent++;
+    }
+    if (broken) {
+      break;
+    }
+    Status s = RunCall([&] { recv(num_received); }, msg, &broken);
+    if (broken) {
+      connection_status = s;
+      break;
+    }
+    (*statuses)[num_received++] = std::move(s);
+  }
+  for (size_t i = num_received; i < num_calls; i++) {
+    (*statuses)[i] = connection_status;
+  }
+  return connection_status;
+}
+
+Status HmsClient::CreateTables(const vector<hive::Table>& tables, vector<Status>* statuses) {
+  SCOPED_LOG_SLOW_EXECUTION(WARNING, kSlowExecutionWarningThresholdMs,
+                            strings::Substitute("create $0 HMS tables", tables.size()));
+  return PipelineCalls(tables.size(),
+                       [&] (size_t i) { client_.send_create_table(tables[i]); },
+                       [&] (size_t /* i */) { client_.recv_create_table(); },
+                       "failed to create Hive MetaStore table", statuses);
+}
+
+Status HmsClient::AlterTables(const string& database_name,
+                              const vector<string>& table_names,
+                              const vector<hive::Table>& tables,
+                              vector<Status>* statuses) {
+  DCHECK_EQ(table_names.size(), tables.size());
+  SCOPED_LOG_SLOW_EXECUTION(WARNING, kSlowExecutionWarningThresholdMs,
+                            strings::Substitute("alter $0 HMS tables", tables.size()));
+  return PipelineCalls(tables.size(),
+                       [&] (size_t i) {
+                         client_.send_alter_table(database_name, table_names[i], tables[i]);
+                       },
+                       [&] (size_t /* i */) { client_.recv_alter_table(); },
+                       "failed to alter Hive MetaStore table", statuses);
+}
+
+Status HmsClient::DropTablesWithContext(const string& database_name,
+                                        const vector<string>& table_names,
+                                        const vector<hive::EnvironmentContext>& env_ctxs,
+                                        vector<Status>* statuses) {
+  DCHECK_EQ(table_names.size(), env_ctxs.size());
+  SCOPED_LOG_SLOW_EXECUTION(WARNING, kSlowExecutionWarningThresholdMs,
+                            strings::Substitute("drop $0 HMS tables", table_names.size()));
+  return PipelineCalls(table_names.size(),
+                       [&] (size_t i) {
+                         client_.send_drop_table_with_environment_context(
+                             database_name, table_names[i], true, env_ctxs[i]);
+                       },
+                       [&] (size_t /* i */) {
+                         client_.recv_drop_table_with_environment_context();
+                       },
+                       "failed to drop Hive MetaStore table", statuses);
+}
+
+Status HmsClient::GetTables(const string& database_name,
+                            const vector<string>& table_names,
+                            vector<hive::Table>* tables) {
+  DCHECK(tables);
+  SCOPED_LOG_SLOW_EXECUTION(WARNING, kSlowExecutionWarningThresholdMs, "get HMS tables");
+  HMS_RET_NOT_OK(client_.get_table_objects_by_name(*tables, database_name, table_names),
+                 "failed to get Hive MetaStore tables");
+  return Status::OK();
+}
+
 Status HmsClient::GetAllTables(const string& database_name,
                                vector<string>* tables) {
   DCHECK(tables);
@@ -17,7 +17,9 @@
 
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <string>
 #include <vector> // IWYU pragma: keep
 
@@ -45,7 +47,8 @@ enum class Cascade {
 //
 // All operations are synchronous, and may block.
 //
-// HmsClient is not thread safe.
+// HmsClient is not thread safe. Concurrent users may share clients through
+// an HmsClientPool.
 //
 // TODO(dan): this client is lacking adequate failure handling, including:
 //  - Documentation of specific Status codes returned in error scenarios
@@ -66,6 +69,10 @@ class HmsClient {
   static const char* const kDbNotificationListener;
   static const char* const kKuduMetastorePlugin;
 
+  // The maximum number of calls in flight on the connection in the bulk
+  // operations.
+  static const int kMaxPipelinedCalls;
+
   explicit HmsClient(const HostPort& hms_address);
   ~HmsClient();
 
@@ -115,11 +122,38 @@ class HmsClient {
                               const std::string& table_name,
                               const hive::EnvironmentContext& env_ctx) WARN_UNUSED_RESULT;
 
+  // Bulk variants of the above, for DDL on many tables at once. The calls for
+  // the individual tables are pipelined on the connection: up to
+  // kMaxPipelinedCalls of them are sent before waiting for the response of the
+  // first one, so a batch costs one round trip to the HMS per
+  // kMaxPipelinedCalls tables rather than one per table.
+  //
+  // The result of the operation on the i-th table is returned in
+  // '(*statuses)[i]', with the same codes as the single-table operation. If
+  // the connection fails before all the tables are processed, the statuses
+  // of the unprocessed tables are set to the error, which is also returned.
+  Status CreateTables(const std::vector<hive::Table>& tables,
+                      std::vector<Status>* statuses) WARN_UNUSED_RESULT;
+  Status AlterTables(const std::string& database_name,
+                     const std::vector<std::string>& table_names,
+                     const std::vector<hive::Table>& tables,
+                     std::vector<Status>* statuses) WARN_UNUSED_RESULT;
+  Status DropTablesWithContext(const std::string& database_name,
+                               const std::vector<std::string>& table_names,
+                               const std::vector<hive::EnvironmentContext>& env_ctxs,
+                               std::vector<Status>* statuses) WARN_UNUSED_RESULT;
+
   // Retrieves an HMS table metadata.
   Status GetTable(const std::string& database_name,
                   const std::string& table_name,
                   hive::Table* table) WARN_UNUSED_RESULT;
 
+  // Retrieves the metadata of several HMS tables of a database with a single
+  // call. Tables which don't exist are omitted from 'tables'.
+  Status GetTables(const std::string& database_name,
+                   const std::vector<std::string>& table_names,
+                   std::vector<hive::Table>* tables) WARN_UNUSED_RESULT;
+
   // Retrieves all tables in an HMS database.
   Status GetAllTables(const std::string& database_name,
                       std::vector<std::string>* tables) WARN_UNUSED_RESULT;
@@ -142,6 +176,14 @@ class HmsClient {
   static Status DeserializeJsonTable(Slice json, hive::Table* table) WARN_UNUSED_RESULT;
 
  private:
+  // Issues 'num_calls' pipelined calls, sending the i-th with 'send(i)' and
+  // reading its response with 'recv(i)'. See CreateTables().
+  Status PipelineCalls(size_t num_calls,
+                       const std::function<void(size_t)>& send,
+                       const std::function<void(size_t)>& recv,
+                       const std::string& msg,
+                       std::vector<Status>* statuses);
+
   hive::ThriftHiveMetastoreClient client_;
 };
 
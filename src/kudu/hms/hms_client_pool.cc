@@ -0,0 +1,89 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/hms/hms_client_pool.h"
+
+#include <utility>
+
+#include <glog/logging.h>
+
+#include "kudu/hms/hms_client.h"
+
+using std::unique_ptr;
+
+namespace kudu {
+namespace hms {
+
+HmsClientPool::HmsClientPool(HostPort hms_address, int max_clients)
+    : hms_address_(std::move(hms_address)),
+      max_clients_(max_clients),
+      client_returned_(&lock_),
+      num_borrowed_(0) {
+  CHECK_GT(max_clients, 0);
+}
+
+HmsClientPool::~HmsClientPool() {
+  MutexLock l(lock_);
+  DCHECK_EQ(0, num_borrowed_) << "HMS client pool destroyed with clients in use";
+}
+
+Status HmsClientPool::WithClient(const std::function<Status(HmsClient*)>& op) {
+  unique_ptr<HmsClient> client;
+  RETURN_NOT_OK(Borrow(&client));
+  Status s = op(client.get());
+  Return(std::move(client), !s.IsNetworkError() && !s.IsIOError());
+  return s;
+}
+
+Status HmsClientPool::Borrow(unique_ptr<HmsClient>* client) {
+  {
+    MutexLock l(lock_);
+    while (idle_clients_.empty() && num_borrowed_ >= max_clients_) {
+      client_returned_.Wait();
+    }
+    num_borrowed_++;
+    if (!idle_clients_.empty()) {
+      *client = std::move(idle_clients_.back());
+      idle_clients_.pop_back();
+      return Status::OK();
+    }
+  }
+
+  // Connect without holding the lock, so that the other users of the pool
+  // aren't held up by a slow or unreachable HMS.
+  unique_ptr<HmsClient> new_client(new HmsClient(hms_address_));
+  Status s = new_client->Start();
+  if (!s.ok()) {
+    Return(nullptr, false);
+    return s;
+  }
+  *client = std::move(new_client);
+  return Status::OK();
+}
+
+void HmsClientPool::Return(unique_ptr<HmsClient> client, bool healthy) {
+  MutexLock l(lock_);
+  DCHECK_GT(num_borrowed_, 0);
+  num_borrowed_--;
+  if (client && healthy) {
+    idle_clients_.emplace_back(std::move(client));
+  }
+  client_returned_.Signal();
+}
+
+} // namespace hms
+} // namespace kudu
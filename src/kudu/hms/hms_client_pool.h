@@ -0,0 +1,84 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/port.h"
+#include "kudu/util/condition_variable.h"
+#include "kudu/util/mutex.h"
+#include "kudu/util/net/net_util.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+namespace hms {
+
+class HmsClient;
+
+// A pool of connections to the Hive MetaStore, shared by concurrent users.
+//
+// Since HmsClient is not thread safe and each of its calls waits for a round
+// trip to the HMS, concurrent DDL operations either serialize on one client
+// or pay for connecting on every operation. The pool instead keeps up to
+// 'max_clients' started clients, and lends each to one user at a time.
+//
+// HmsClientPool is thread safe.
+class HmsClientPool {
+ public:
+  HmsClientPool(HostPort hms_address, int max_clients);
+  ~HmsClientPool();
+
+  // Runs 'op' with a started client, and returns its result.
+  //
+  // Waits for a client to be returned to the pool if all 'max_clients'
+  // clients are in use. Clients are started on demand, and a client whose
+  // operation failed with a network or IO error is discarded rather than
+  // returned to the pool, so that the next user reconnects.
+  Status WithClient(const std::function<Status(HmsClient*)>& op) WARN_UNUSED_RESULT;
+
+ private:
+  // Takes an idle client out of the pool, or starts a new one.
+  Status Borrow(std::unique_ptr<HmsClient>* client) WARN_UNUSED_RESULT;
+
+  // Returns a borrowed client to the pool, or discards it if 'healthy' is
+  // false.
+  void Return(std::unique_ptr<HmsClient> client, bool healthy);
+
+  const HostPort hms_address_;
+  const int max_clients_;
+
+  // Protects the members below.
+  Mutex lock_;
+
+  // Signaled when a client is returned to the pool or discarded.
+  ConditionVariable client_returned_;
+
+  // The started clients which aren't in use.
+  std::vector<std::unique_ptr<HmsClient>> idle_clients_;
+
+  // The number of clients which are in use or being started.
+  int num_borrowed_;
+
+  DISALLOW_COPY_AND_ASSIGN(HmsClientPool);
+};
+
+} // namespace hms
+} // namespace kudu
@@ -661,6 +661,32 @@ Status LeaderStepDown(const TServerDetails* replica,
   return Status::OK();
 }
 
+Status TransferLeadership(const TServerDetails* replica,
+                          const string& tablet_id,
+                          const boost::optional<string>& new_leader_uuid,
+                          const MonoDelta& timeout,
+                          TabletServerErrorPB* error) {
+  LeaderStepDownRequestPB req;
+  req.set_dest_uuid(replica->uuid());
+  req.set_tablet_id(tablet_id);
+  req.set_mode(consensus::GRACEFUL);
+  if (new_leader_uuid) {
+    req.set_new_leader_uuid(*new_leader_uuid);
+  }
+  LeaderStepDownResponsePB resp;
+  RpcController rpc;
+  rpc.set_timeout(timeout);
+  RETURN_NOT_OK(replica->consensus_proxy->LeaderStepDown(req, &resp, &rpc));
+  if (resp.has_error()) {
+    if (error != nullptr) {
+      *error = resp.error();
+    }
+    return StatusFromPB(resp.error().status())
+      .CloneAndPrepend(Substitute("Code $0", TabletServerErrorPB::Code_Name(resp.error().code())));
+  }
+  return Status::OK();
+}
+
 Status WriteSimpleTestRow(const TServerDetails* replica,
                           const std::string& tablet_id,
                           RowOperationsPB::Type write_type,
@@ -1130,5 +1156,45 @@ Status GetInt64Metric(const HostPort& http_hp,
   return Status::NotFound(msg);
 }
 
+Status SumInt64Metric(const HostPort& http_hp,
+                      const MetricEntityPrototype* entity_proto,
+                      const MetricPrototype* metric_proto,
+                      const char* value_field,
+                      int64_t* sum) {
+  string url = Substitute(
+      "http://$0/jsonmetricz?metrics=$1",
+      http_hp.ToString(), metric_proto->name());
+  EasyCurl curl;
+  faststring dst;
+  RETURN_NOT_OK(curl.FetchURL(url, &dst));
+
+  JsonReader r(dst.ToString());
+  RETURN_NOT_OK(r.Init());
+  vector<const Value*> entities;
+  RETURN_NOT_OK(r.ExtractObjectArray(r.root(), nullptr, &entities));
+  int64_t total = 0;
+  for (const Value* entity : entities) {
+    string type;
+    RETURN_NOT_OK(r.ExtractString(entity, "type", &type));
+    if (type != entity_proto->name()) {
+      continue;
+    }
+    vector<const Value*> metrics;
+    RETURN_NOT_OK(r.ExtractObjectArray(entity, "metrics", &metrics));
+    for (const Value* metric : metrics) {
+      string name;
+      RETURN_NOT_OK(r.ExtractString(metric, "name", &name));
+      if (name != metric_proto->name()) {
+        continue;
+      }
+      int64_t value;
+      RETURN_NOT_OK(r.ExtractInt64(metric, value_field, &value));
+      total += value;
+    }
+  }
+  *sum = total;
+  return Status::OK();
+}
+
 } // namespace itest
 } // namespace kudu
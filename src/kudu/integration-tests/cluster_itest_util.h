@@ -256,6 +256,16 @@ Status LeaderStepDown(const TServerDetails* replica,
                       const MonoDelta& timeout,
                       tserver::TabletServerErrorPB* error = nullptr);
 
+// Cause a leader to gracefully transfer its leadership to the replica with
+// UUID 'new_leader_uuid' or, if unset, to the first voter to catch up with it.
+// The call returns once the transfer started; it does not wait for a new
+// leader to be elected.
+Status TransferLeadership(const TServerDetails* replica,
+                          const std::string& tablet_id,
+                          const boost::optional<std::string>& new_leader_uuid,
+                          const MonoDelta& timeout,
+                          tserver::TabletServerErrorPB* error = nullptr);
+
 // Write a "simple test schema" row to the specified tablet on the given
 // replica. This schema is commonly used by tests and is defined in
 // wire_protocol-test-util.h
@@ -414,6 +424,16 @@ Status GetInt64Metric(const HostPort& http_hp,
                       const char* value_field,
                       int64_t* value);
 
+// Like GetInt64Metric(), but returns in 'sum' the sum of the metric's
+// 'value_field' over all the entities of the type of 'entity_proto', e.g. over
+// all the tablets hosted by the server. Entities without the metric are
+// skipped.
+Status SumInt64Metric(const HostPort& http_hp,
+                      const MetricEntityPrototype* entity_proto,
+                      const MetricPrototype* metric_proto,
+                      const char* value_field,
+                      int64_t* sum);
+
 
 } // namespace itest
 } // namespace kudu
@@ -0,0 +1,399 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include "kudu/client/client-test-util.h"
+#include "kudu/client/client.h"
+#include "kudu/client/scan_batch.h"
+#include "kudu/client/schema.h"
+#include "kudu/client/shared_ptr.h"
+#include "kudu/client/write_op.h"
+#include "kudu/common/partial_row.h"
+#include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/integral_types.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/strings/split.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/integration-tests/cluster_itest_util.h"
+#include "kudu/integration-tests/external_mini_cluster-itest-base.h"
+#include "kudu/mini-cluster/external_mini_cluster.h"
+#include "kudu/util/atomic.h"
+#include "kudu/util/env.h"
+#include "kudu/util/hdr_histogram.h"
+#include "kudu/util/jsonwriter.h"
+#include "kudu/util/metrics.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/path_util.h"
+#include "kudu/util/slice.h"
+#include "kudu/util/status.h"
+#include "kudu/util/test_macros.h"
+#include "kudu/util/test_util.h"
+
+METRIC_DECLARE_entity(server);
+METRIC_DECLARE_entity(tablet);
+METRIC_DECLARE_counter(block_manager_total_bytes_read);
+METRIC_DECLARE_counter(block_manager_total_bytes_written);
+METRIC_DECLARE_counter(log_bytes_logged);
+METRIC_DECLARE_gauge_uint64(cpu_stime);
+METRIC_DECLARE_gauge_uint64(cpu_utime);
+
+DEFINE_int32(perf_num_tablet_servers, 3, "Number of tablet servers in the cluster");
+DEFINE_int32(perf_num_replicas, 3, "Replication factor of the table");
+DEFINE_int32(perf_num_tablets, 6, "Number of hash partitions of the table");
+DEFINE_int32(perf_num_threads, 4,
+             "Number of client threads running each scenario. The mixed "
+             "scenario splits them between writers and scanners");
+DEFINE_int32(perf_scenario_secs, 3, "How long each scenario runs for");
+DEFINE_int32(perf_write_batch_size, 100, "Number of rows per write batch");
+DEFINE_int64(perf_preload_rows, 10000,
+             "Number of rows written, unmeasured, before the scenarios run so "
+             "that scans have data to read");
+DEFINE_string(perf_scenarios, "write,scan,mixed",
+              "Comma-separated list of the scenarios to run, in order. "
+              "Possible values: write, scan, mixed");
+DEFINE_string(perf_tserver_flags, "",
+              "Space-separated list of extra flags for the tablet servers, "
+              "e.g. to compare configurations");
+DEFINE_string(perf_json_output, "",
+              "File to write the JSON results to. Defaults to perf.json in "
+              "the test's data directory");
+
+using kudu::client::KuduColumnSchema;
+using kudu::client::KuduInsert;
+using kudu::client::KuduScanBatch;
+using kudu::client::KuduScanner;
+using kudu::client::KuduSchema;
+using kudu::client::KuduSchemaBuilder;
+using kudu::client::KuduSession;
+using kudu::client::KuduTable;
+using kudu::client::KuduTableCreator;
+using kudu::cluster::ExternalMiniClusterOptions;
+using std::ostringstream;
+using std::string;
+using std::thread;
+using std::unique_ptr;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+
+namespace {
+
+const char* const kTableName = "perf";
+
+// Latencies are recorded in microseconds, up to a minute.
+const uint64_t kMaxLatencyUs = 60 * 1000 * 1000;
+
+// The server metrics scraped before and after each scenario. Each metric is
+// summed over the tablet servers and, for tablet metrics, over the tablets.
+struct ScrapedMetric {
+  const char* name;
+  const MetricEntityPrototype* entity;
+  const MetricPrototype* metric;
+};
+
+const ScrapedMetric kScrapedMetrics[] = {
+  { "cpu_user_ms", &METRIC_ENTITY_server, &METRIC_cpu_utime },
+  { "cpu_system_ms", &METRIC_ENTITY_server, &METRIC_cpu_stime },
+  { "block_bytes_written", &METRIC_ENTITY_server, &METRIC_block_manager_total_bytes_written },
+  { "block_bytes_read", &METRIC_ENTITY_server, &METRIC_block_manager_total_bytes_read },
+  { "wal_bytes_written", &METRIC_ENTITY_tablet, &METRIC_log_bytes_logged },
+};
+
+// The throughput and latency of one kind of operation in a scenario.
+struct OpStats {
+  OpStats() : latency_us(kMaxLatencyUs, 2), rows(0) {}
+
+  // Latency of each request: a write batch or a full table scan.
+  HdrHistogram latency_us;
+
+  // The number of rows written or scanned.
+  AtomicInt<int64_t> rows;
+};
+
+} // anonymous namespace
+
+// End-to-end performance regression harness.
+//
+// Starts an ExternalMiniCluster, runs the scenarios of --perf_scenarios
+// against it one after another, and emits JSON results with the throughput
+// and latency percentiles of each scenario, along with the CPU time and bytes
+// written and read by the tablet servers per operation. Comparing the results
+// of two versions, with the same flags and on the same machine, shows
+// performance regressions end to end.
+//
+// The default flags make for a short smoke run; use for example
+// --perf_scenario_secs=60 to get stable figures.
+class ClusterPerfITest : public ExternalMiniClusterITestBase {
+ protected:
+  void CreateTable() {
+    KuduSchema schema;
+    KuduSchemaBuilder b;
+    b.AddColumn("key")->Type(KuduColumnSchema::INT64)->NotNull()->PrimaryKey();
+    b.AddColumn("int_val")->Type(KuduColumnSchema::INT32)->NotNull();
+    b.AddColumn("string_val")->Type(KuduColumnSchema::STRING)->NotNull();
+    ASSERT_OK(b.Build(&schema));
+
+    gscoped_ptr<KuduTableCreator> table_creator(client_->NewTableCreator());
+    ASSERT_OK(table_creator->table_name(kTableName)
+              .schema(&schema)
+              .add_hash_partitions({ "key" }, FLAGS_perf_num_tablets)
+              .num_replicas(FLAGS_perf_num_replicas)
+              .Create());
+    ASSERT_OK(client_->OpenTable(kTableName, &table_));
+  }
+
+  // Writes batches of rows until 'stop' is set or 'max_rows' rows were
+  // written. Each writer owns a disjoint range of keys, so that its inserts
+  // never collide with another's, even across scenarios.
+  void WriteThread(int writer_idx, const AtomicBool* stop, int64_t max_rows, OpStats* stats) {
+    client::sp::shared_ptr<KuduSession> session = client_->NewSession();
+    session->SetTimeoutMillis(60000);
+    CHECK_OK(session->SetFlushMode(KuduSession::MANUAL_FLUSH));
+    int64_t* next_key = &next_keys_[writer_idx];
+    int64_t rows_written = 0;
+    while (!stop->Load() && rows_written < max_rows) {
+      for (int i = 0; i < FLAGS_perf_write_batch_size; i++) {
+        gscoped_ptr<KuduInsert> insert(table_->NewInsert());
+        KuduPartialRow* row = insert->mutable_row();
+        CHECK_OK(row->SetInt64("key", (*next_key)++));
+        CHECK_OK(row->SetInt32("int_val", i));
+        CHECK_OK(row->SetStringCopy("string_val", "perf harness row payload"));
+        CHECK_OK(session->Apply(insert.release()));
+      }
+      MonoTime start = MonoTime::Now();
+      Status s = session->Flush();
+      if (!s.ok()) {
+        client::LogSessionErrorsAndDie(session, s);
+      }
+      stats->latency_us.Increment((MonoTime::Now() - start).ToMicroseconds());
+      stats->rows.IncrementBy(FLAGS_perf_write_batch_size);
+      rows_written += FLAGS_perf_write_batch_size;
+    }
+  }
+
+  // Scans the whole table over and over until 'stop' is set.
+  void ScanThread(const AtomicBool* stop, OpStats* stats) {
+    while (!stop->Load()) {
+      KuduScanner scanner(table_.get());
+      MonoTime start = MonoTime::Now();
+      CHECK_OK(scanner.Open());
+      int64_t rows = 0;
+      KuduScanBatch batch;
+      while (scanner.HasMoreRows()) {
+        CHECK_OK(scanner.NextBatch(&batch));
+        rows += batch.NumRows();
+      }
+      stats->latency_us.Increment((MonoTime::Now() - start).ToMicroseconds());
+      stats->rows.IncrementBy(rows);
+    }
+  }
+
+  // Fills 'values' with the current value of each of 'kScrapedMetrics'.
+  Status ScrapeMetrics(vector<int64_t>* values) {
+    values->clear();
+    for (const auto& m : kScrapedMetrics) {
+      int64_t total = 0;
+      for (int i = 0; i < cluster_->num_tablet_servers(); i++) {
+        int64_t value;
+        RETURN_NOT_OK(itest::SumInt64Metric(cluster_->tablet_server(i)->bound_http_hostport(),
+                                            m.entity, m.metric, "value", &value));
+        total += value;
+      }
+      values->push_back(total);
+    }
+    return Status::OK();
+  }
+
+  // Runs the scenario named 'name' with 'num_writers' writing threads and
+  // 'num_scanners' scanning threads, and appends its results to 'jw'.
+  void RunScenario(const string& name, int num_writers, int num_scanners, JsonWriter* jw) {
+    LOG(INFO) << Substitute("Running scenario $0 with $1 writers and $2 scanners",
+                            name, num_writers, num_scanners);
+    vector<int64_t> metrics_before;
+    ASSERT_OK(ScrapeMetrics(&metrics_before));
+
+    OpStats write_stats;
+    OpStats scan_stats;
+    AtomicBool stop(false);
+    vector<thread> threads;
+    MonoTime start = MonoTime::Now();
+    for (int i = 0; i < num_writers; i++) {
+      threads.emplace_back([this, i, &stop, &write_stats]() {
+        this->WriteThread(i, &stop, kint64max, &write_stats);
+      });
+    }
+    for (int i = 0; i < num_scanners; i++) {
+      threads.emplace_back([this, &stop, &scan_stats]() {
+        this->ScanThread(&stop, &scan_stats);
+      });
+    }
+    SleepFor(MonoDelta::FromSeconds(FLAGS_perf_scenario_secs));
+    stop.Store(true);
+    for (auto& t : threads) {
+      t.join();
+    }
+    double elapsed_secs = (MonoTime::Now() - start).ToSeconds();
+
+    vector<int64_t> metrics_after;
+    ASSERT_OK(ScrapeMetrics(&metrics_after));
+
+    int64_t total_rows = write_stats.rows.Load() + scan_stats.rows.Load();
+    ASSERT_GT(total_rows, 0) << "scenario " << name << " made no progress";
+
+    jw->StartObject();
+    jw->String("name");
+    jw->String(name);
+    jw->String("duration_secs");
+    jw->Double(elapsed_secs);
+    jw->String("operations");
+    jw->StartObject();
+    if (num_writers > 0) {
+      jw->String("write");
+      WriteOpStats(write_stats, elapsed_secs, jw);
+    }
+    if (num_scanners > 0) {
+      jw->String("scan");
+      WriteOpStats(scan_stats, elapsed_secs, jw);
+    }
+    jw->EndObject();
+
+    // Deltas of the server metrics, in total and per row written or scanned.
+    jw->String("server_metrics");
+    jw->StartObject();
+    for (size_t i = 0; i < arraysize(kScrapedMetrics); i++) {
+      jw->String(kScrapedMetrics[i].name);
+      jw->Int64(metrics_after[i] - metrics_before[i]);
+    }
+    jw->EndObject();
+    jw->String("server_metrics_per_row");
+    jw->StartObject();
+    for (size_t i = 0; i < arraysize(kScrapedMetrics); i++) {
+      jw->String(kScrapedMetrics[i].name);
+      jw->Double(static_cast<double>(metrics_after[i] - metrics_before[i]) / total_rows);
+    }
+    jw->EndObject();
+    jw->EndObject();
+  }
+
+  static void WriteOpStats(const OpStats& stats, double elapsed_secs, JsonWriter* jw) {
+    const HdrHistogram& h = stats.latency_us;
+    jw->StartObject();
+    jw->String("requests");
+    jw->Int64(h.TotalCount());
+    jw->String("rows");
+    jw->Int64(stats.rows.Load());
+    jw->String("rows_per_sec");
+    jw->Double(stats.rows.Load() / elapsed_secs);
+    jw->String("latency_us");
+    jw->StartObject();
+    jw->String("mean");
+    jw->Double(h.MeanValue());
+    for (const auto& p : { std::make_pair("p50", 50.0),
+                           std::make_pair("p95", 95.0),
+                           std::make_pair("p99", 99.0),
+                           std::make_pair("p999", 99.9) }) {
+      jw->String(p.first);
+      jw->Uint64(h.ValueAtPercentile(p.second));
+    }
+    jw->String("max");
+    jw->Uint64(h.MaxValue());
+    jw->EndObject();
+    jw->EndObject();
+  }
+
+  client::sp::shared_ptr<KuduTable> table_;
+
+  // The next key to be written by each writer.
+  vector<int64_t> next_keys_;
+};
+
+TEST_F(ClusterPerfITest, RunScenarios) {
+  ExternalMiniClusterOptions opts;
+  opts.num_tablet_servers = FLAGS_perf_num_tablet_servers;
+  for (const auto& flag : strings::Split(FLAGS_perf_tserver_flags, " ", strings::SkipEmpty())) {
+    opts.extra_tserver_flags.emplace_back(flag.ToString());
+  }
+  NO_FATALS(StartClusterWithOpts(std::move(opts)));
+  NO_FATALS(CreateTable());
+
+  for (int i = 0; i < FLAGS_perf_num_threads; i++) {
+    next_keys_.push_back(static_cast<int64_t>(i) << 40);
+  }
+  if (FLAGS_perf_preload_rows > 0) {
+    OpStats preload_stats;
+    AtomicBool stop(false);
+    NO_FATALS(WriteThread(0, &stop, FLAGS_perf_preload_rows, &preload_stats));
+  }
+
+  ostringstream out;
+  JsonWriter jw(&out, JsonWriter::PRETTY);
+  jw.StartObject();
+  jw.String("topology");
+  jw.StartObject();
+  jw.String("num_tablet_servers");
+  jw.Int(FLAGS_perf_num_tablet_servers);
+  jw.String("num_replicas");
+  jw.Int(FLAGS_perf_num_replicas);
+  jw.String("num_tablets");
+  jw.Int(FLAGS_perf_num_tablets);
+  jw.String("num_threads");
+  jw.Int(FLAGS_perf_num_threads);
+  jw.String("write_batch_size");
+  jw.Int(FLAGS_perf_write_batch_size);
+  jw.String("tserver_flags");
+  jw.String(FLAGS_perf_tserver_flags);
+  jw.EndObject();
+
+  jw.String("scenarios");
+  jw.StartArray();
+  for (const auto& scenario : strings::Split(FLAGS_perf_scenarios, ",", strings::SkipEmpty())) {
+    if (scenario == "write") {
+      NO_FATALS(RunScenario("write", FLAGS_perf_num_threads, 0, &jw));
+    } else if (scenario == "scan") {
+      NO_FATALS(RunScenario("scan", 0, FLAGS_perf_num_threads, &jw));
+    } else if (scenario == "mixed") {
+      int num_writers = std::max(1, FLAGS_perf_num_threads / 2);
+      NO_FATALS(RunScenario("mixed", num_writers,
+                            std::max(1, FLAGS_perf_num_threads - num_writers), &jw));
+    } else {
+      FAIL() << "unknown scenario: " << scenario.ToString();
+    }
+  }
+  jw.EndArray();
+  jw.EndObject();
+
+  string path = FLAGS_perf_json_output.empty() ?
+      JoinPathSegments(GetTestDataDirectory(), "perf.json") : FLAGS_perf_json_output;
+  ASSERT_OK(WriteStringToFile(env_, out.str(), path));
+  LOG(INFO) << "Wrote results to " << path << ":\n" << out.str();
+}
+
+} // namespace kudu
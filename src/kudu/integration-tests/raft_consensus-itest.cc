@@ -67,6 +67,8 @@
 #include "kudu/tablet/metadata.pb.h"
 #include "kudu/tserver/tablet_server-test-base.h"
 #include "kudu/tserver/tserver.pb.h"
+#include "kudu/tserver/tserver_admin.pb.h"
+#include "kudu/tserver/tserver_admin.proxy.h"
 #include "kudu/tserver/tserver_service.proxy.h"
 #include "kudu/util/atomic.h"
 #include "kudu/util/countdown_latch.h"
@@ -87,8 +89,10 @@ DECLARE_int32(num_replicas);
 DECLARE_int32(num_tablet_servers);
 DECLARE_int32(rpc_timeout);
 
+METRIC_DECLARE_entity(server);
 METRIC_DECLARE_entity(tablet);
 METRIC_DECLARE_counter(transaction_memory_pressure_rejections);
+METRIC_DECLARE_histogram(handler_latency_kudu_consensus_ConsensusService_MultiUpdateConsensus);
 
 using kudu::client::KuduInsert;
 using kudu::client::KuduSession;
@@ -100,6 +104,8 @@ using kudu::consensus::ConsensusResponsePB;
 using kudu::consensus::ConsensusServiceProxy;
 using kudu::consensus::MajoritySize;
 using kudu::consensus::MakeOpId;
+using kudu::consensus::MultiConsensusRequestPB;
+using kudu::consensus::MultiConsensusResponsePB;
 using kudu::consensus::OpId;
 using kudu::consensus::RaftPeerPB;
 using kudu::consensus::ReplicateMsg;
@@ -111,6 +117,7 @@ using kudu::itest::RemoveServer;
 using kudu::itest::StartElection;
 using kudu::itest::TServerDetails;
 using kudu::itest::TabletServerMap;
+using kudu::itest::TransferLeadership;
 using kudu::itest::WAIT_FOR_LEADER;
 using kudu::itest::WaitForReplicasReportedToMaster;
 using kudu::itest::WaitUntilCommittedOpIdIndexIs;
@@ -1081,6 +1088,125 @@ TEST_F(RaftConsensusITest, TestLMPMismatchOnRestartedReplica) {
   EXPECT_EQ("2.2", OpIdToString(resp.status().last_received()));
 }
 
+// Test that each of the requests of a MultiUpdateConsensus() batch is handled
+// as if it were sent on its own, errors included.
+TEST_F(RaftConsensusITest, TestMultiUpdateConsensus) {
+  TServerDetails* replica_ts;
+  NO_FATALS(SetupSingleReplicaTest(&replica_ts));
+
+  ConsensusServiceProxy* c_proxy = CHECK_NOTNULL(replica_ts->consensus_proxy.get());
+  MultiConsensusRequestPB req;
+  MultiConsensusResponsePB resp;
+  RpcController rpc;
+
+  ConsensusRequestPB* update_req = req.add_requests();
+  update_req->set_tablet_id(tablet_id_);
+  update_req->set_dest_uuid(replica_ts->uuid());
+  update_req->set_caller_uuid("fake_caller");
+  update_req->set_caller_term(2);
+  update_req->set_all_replicated_index(0);
+  update_req->mutable_preceding_id()->CopyFrom(MakeOpId(1, 1));
+  // The same request, for a tablet which doesn't exist.
+  req.add_requests()->CopyFrom(*update_req);
+  req.mutable_requests(1)->set_tablet_id("missing-tablet");
+
+  ASSERT_OK(c_proxy->MultiUpdateConsensus(req, &resp, &rpc));
+  SCOPED_TRACE(SecureDebugString(resp));
+  ASSERT_FALSE(resp.has_error());
+  ASSERT_EQ(2, resp.responses_size());
+  ASSERT_FALSE(resp.responses(0).has_error());
+  ASSERT_EQ("1.1", OpIdToString(resp.responses(0).status().last_received()));
+  ASSERT_TRUE(resp.responses(1).has_error());
+  ASSERT_EQ(TabletServerErrorPB::TABLET_NOT_FOUND, resp.responses(1).error().code());
+}
+
+// Test that replication works with the heartbeats of the leaders batched,
+// and that they are indeed batched.
+TEST_F(RaftConsensusITest, TestBatchedHeartbeats) {
+  NO_FATALS(BuildAndStart({ "--consensus_batch_heartbeats=true",
+                            "--raft_heartbeat_interval_ms=100" }));
+
+  InsertTestRowsRemoteThread(0,
+                             FLAGS_client_inserts_per_thread,
+                             FLAGS_client_num_batches_per_thread,
+                             vector<CountDownLatch*>());
+  NO_FATALS(AssertAllReplicasAgree(FLAGS_client_inserts_per_thread));
+
+  ASSERT_EVENTUALLY([&]() {
+    int64_t num_batches = 0;
+    for (int i = 0; i < cluster_->num_tablet_servers(); i++) {
+      int64_t ts_num_batches;
+      ASSERT_OK(GetInt64Metric(
+          cluster_->tablet_server(i)->bound_http_hostport(),
+          &METRIC_ENTITY_server, "kudu.tabletserver",
+          &METRIC_handler_latency_kudu_consensus_ConsensusService_MultiUpdateConsensus,
+          "total_count", &ts_num_batches));
+      num_batches += ts_num_batches;
+    }
+    ASSERT_GT(num_batches, 0);
+  });
+}
+
+// Test that a leader gracefully hands its leadership over to the follower it
+// is asked to, or to any caught up follower, and that a tablet server can be
+// drained of all its leaders.
+TEST_F(RaftConsensusITest, TestGracefulLeadershipTransfer) {
+  const MonoDelta kTimeout = MonoDelta::FromSeconds(10);
+  NO_FATALS(BuildAndStart());
+  InsertTestRowsRemoteThread(0,
+                             FLAGS_client_inserts_per_thread,
+                             FLAGS_client_num_batches_per_thread,
+                             vector<CountDownLatch*>());
+
+  TServerDetails* leader;
+  ASSERT_OK(GetLeaderReplicaWithRetries(tablet_id_, &leader));
+  TServerDetails* successor = nullptr;
+  for (const auto& entry : tablet_servers_) {
+    if (entry.first != leader->uuid()) {
+      successor = entry.second;
+      break;
+    }
+  }
+  ASSERT_NE(nullptr, successor);
+
+  // Transfer to a designated successor.
+  ASSERT_OK(TransferLeadership(leader, tablet_id_, successor->uuid(), kTimeout));
+  ASSERT_OK(WaitUntilLeader(successor, tablet_id_, kTimeout));
+
+  // Transferring to a replica which isn't a voter fails.
+  Status s = TransferLeadership(successor, tablet_id_, string("not-a-peer"), kTimeout);
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+
+  // Drain the leaders of the successor's server.
+  ASSERT_EVENTUALLY([&]() {
+    DrainLeadersRequestPB req;
+    DrainLeadersResponsePB resp;
+    RpcController rpc;
+    rpc.set_timeout(kTimeout);
+    req.set_dest_uuid(successor->uuid());
+    ASSERT_OK(successor->tserver_admin_proxy->DrainLeaders(req, &resp, &rpc));
+    ASSERT_FALSE(resp.has_error()) << SecureShortDebugString(resp);
+    ASSERT_EQ(0, resp.num_leaders());
+  });
+  TServerDetails* new_leader;
+  ASSERT_OK(GetLeaderReplicaWithRetries(tablet_id_, &new_leader));
+  ASSERT_NE(successor->uuid(), new_leader->uuid());
+
+  // No write was lost along the way.
+  NO_FATALS(AssertAllReplicasAgree(FLAGS_client_inserts_per_thread));
+}
+
+// Test that replication works with the ops sent to followers in sidecars.
+TEST_F(RaftConsensusITest, TestOpsInSidecars) {
+  NO_FATALS(BuildAndStart({ "--consensus_ops_in_sidecars=true" }));
+
+  InsertTestRowsRemoteThread(0,
+                             FLAGS_client_inserts_per_thread,
+                             FLAGS_client_num_batches_per_thread,
+                             vector<CountDownLatch*>());
+  NO_FATALS(AssertAllReplicasAgree(FLAGS_client_inserts_per_thread));
+}
+
 // Test a scenario where a replica has pending operations with lock
 // dependencies on each other:
 //   2.2: UPSERT row 1
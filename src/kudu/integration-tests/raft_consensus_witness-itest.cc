@@ -0,0 +1,278 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gflags/gflags_declare.h>
+#include <gtest/gtest.h>
+
+#include "kudu/consensus/metadata.pb.h"
+#include "kudu/consensus/opid.pb.h"
+#include "kudu/gutil/strings/util.h"
+#include "kudu/integration-tests/cluster_itest_util.h"
+#include "kudu/integration-tests/cluster_verifier.h"
+#include "kudu/integration-tests/external_mini_cluster_fs_inspector.h"
+#include "kudu/integration-tests/raft_consensus-itest-base.h"
+#include "kudu/integration-tests/test_workload.h"
+#include "kudu/mini-cluster/external_mini_cluster.h"
+#include "kudu/tablet/metadata.pb.h"
+#include "kudu/tserver/tablet_server-test-base.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/status.h"
+#include "kudu/util/test_macros.h"
+#include "kudu/util/test_util.h"
+
+DECLARE_int32(num_replicas);
+DECLARE_int32(num_tablet_servers);
+
+using kudu::cluster::ExternalTabletServer;
+using kudu::consensus::OpId;
+using kudu::consensus::RaftPeerPB;
+using kudu::itest::AddServer;
+using kudu::itest::GetLastOpIdForReplica;
+using kudu::itest::LeaderStepDown;
+using kudu::itest::TServerDetails;
+using kudu::itest::WaitForNumTabletsOnTS;
+using kudu::itest::WaitForServersToAgree;
+using kudu::itest::WaitUntilAllReplicasHaveOp;
+using kudu::itest::WaitUntilLeader;
+using std::string;
+using std::vector;
+
+namespace kudu {
+namespace tserver {
+
+// Integration test for witness replicas, which vote and persist the WAL but
+// don't apply the writes. Uses the whole tablet server stack with
+// ExternalMiniCluster.
+class RaftConsensusWitnessITest : public RaftConsensusITestBase {
+ protected:
+  // Starts a cluster of 3 tablet servers with a tablet of 2 data replicas,
+  // writes 'num_rows' rows, and adds a witness replica of the tablet on the
+  // remaining server, which is copied from the leader.
+  void SetUpTabletWithWitness(vector<string> ts_flags,
+                              TServerDetails** witness,
+                              vector<TServerDetails*>* data_replicas,
+                              int64_t* num_rows);
+
+  // Asserts that a replica other than 'witness' is eventually the leader,
+  // and returns it.
+  void WaitForDataReplicaLeader(const TServerDetails* witness, TServerDetails** leader);
+
+  const MonoDelta kTimeout = MonoDelta::FromSeconds(60);
+};
+
+static bool IsConfigurationLeaderError(const Status& s) {
+  static const string kPattern = "*Replica * is not leader of this config*";
+  return s.IsIllegalState() && MatchPattern(s.ToString(), kPattern);
+}
+
+void RaftConsensusWitnessITest::SetUpTabletWithWitness(
+    vector<string> ts_flags,
+    TServerDetails** witness,
+    vector<TServerDetails*>* data_replicas,
+    int64_t* num_rows) {
+  const vector<string> kMasterFlags = {
+    // Allow replication factor of 2.
+    "--allow_unsafe_replication_factor=true",
+  };
+  // Flush the rows right away, so that the copy of the witness has blocks to
+  // skip.
+  ts_flags.emplace_back("--flush_threshold_mb=0");
+  FLAGS_num_tablet_servers = 3;
+  FLAGS_num_replicas = 2;
+  NO_FATALS(BuildAndStart(ts_flags, kMasterFlags));
+
+  data_replicas->clear();
+  for (const auto& e : tablet_replicas_) {
+    if (e.first == tablet_id_) {
+      data_replicas->push_back(e.second);
+    }
+  }
+  ASSERT_EQ(2, data_replicas->size());
+  *witness = nullptr;
+  for (const auto& e : tablet_servers_) {
+    if (e.second != (*data_replicas)[0] && e.second != (*data_replicas)[1]) {
+      *witness = e.second;
+    }
+  }
+  ASSERT_NE(nullptr, *witness);
+
+  TestWorkload workload(cluster_.get());
+  workload.set_table_name(kTableId);
+  workload.Setup();
+  workload.Start();
+  while (workload.rows_inserted() < 100) {
+    SleepFor(MonoDelta::FromMilliseconds(10));
+  }
+  workload.StopAndJoin();
+  *num_rows = workload.rows_inserted();
+
+  const MonoTime deadline = MonoTime::Now() + kTimeout;
+  while (true) {
+    ASSERT_LT(MonoTime::Now(), deadline) << "timed out adding the witness";
+    TServerDetails* leader = nullptr;
+    ASSERT_OK(WaitForLeaderWithCommittedOp(tablet_id_, kTimeout, &leader));
+    Status s = AddServer(leader, tablet_id_, *witness, RaftPeerPB::WITNESS, kTimeout);
+    if (IsConfigurationLeaderError(s)) {
+      // The leader has changed, retry.
+      continue;
+    }
+    ASSERT_OK(s);
+    break;
+  }
+  ASSERT_OK(WaitForNumTabletsOnTS(*witness, 1, kTimeout, nullptr, tablet::RUNNING));
+  ASSERT_OK(WaitForServersToAgree(kTimeout, tablet_servers_, tablet_id_, 1));
+}
+
+void RaftConsensusWitnessITest::WaitForDataReplicaLeader(const TServerDetails* witness,
+                                                         TServerDetails** leader) {
+  ASSERT_EVENTUALLY([&]() {
+    TServerDetails* l = nullptr;
+    ASSERT_OK(GetLeaderReplicaWithRetries(tablet_id_, &l));
+    ASSERT_NE(witness, l);
+    *leader = l;
+  });
+}
+
+// Writes, leader elections and bootstraps with a witness: the witness votes
+// so that the tablet keeps making progress when a data replica fails, but
+// doesn't stay the leader nor store the rows.
+TEST_F(RaftConsensusWitnessITest, WritesAndElections) {
+  TServerDetails* witness;
+  vector<TServerDetails*> data_replicas;
+  int64_t num_rows;
+  NO_FATALS(SetUpTabletWithWitness({}, &witness, &data_replicas, &num_rows));
+  const int witness_idx = cluster_->tablet_server_index_by_uuid(witness->uuid());
+
+  // The tablet copy didn't download any block.
+  {
+    tablet::TabletSuperBlockPB superblock;
+    ASSERT_OK(inspect_->ReadTabletSuperBlockOnTS(witness_idx, tablet_id_, &superblock));
+    ASSERT_EQ(0, superblock.rowsets_size());
+  }
+
+  TestWorkload workload(cluster_.get());
+  workload.set_table_name(kTableId);
+  workload.set_timeout_allowed(true);
+  workload.set_network_error_allowed(true);
+  workload.Setup();
+  workload.Start();
+
+  // Step the leader down a few times: the leader is always a data replica.
+  for (int i = 0; i < 3; i++) {
+    TServerDetails* leader = nullptr;
+    NO_FATALS(WaitForDataReplicaLeader(witness, &leader));
+    ASSERT_OK(LeaderStepDown(leader, tablet_id_, kTimeout));
+  }
+
+  // Kill the leader: the other data replica is elected with the vote of the
+  // witness, and the writes go on.
+  TServerDetails* leader = nullptr;
+  NO_FATALS(WaitForDataReplicaLeader(witness, &leader));
+  ExternalTabletServer* leader_ts = cluster_->tablet_server_by_uuid(leader->uuid());
+  leader_ts->Shutdown();
+  TServerDetails* other = data_replicas[0] == leader ? data_replicas[1] : data_replicas[0];
+  ASSERT_OK(WaitUntilLeader(other, tablet_id_, kTimeout));
+  int64_t rows_inserted = workload.rows_inserted();
+  ASSERT_EVENTUALLY([&]() {
+    ASSERT_GT(workload.rows_inserted(), rows_inserted + 100);
+  });
+  ASSERT_OK(leader_ts->Restart());
+
+  // Bootstrap the witness while writing.
+  ExternalTabletServer* witness_ts = cluster_->tablet_server(witness_idx);
+  witness_ts->Shutdown();
+  ASSERT_OK(witness_ts->Restart());
+  ASSERT_OK(WaitForNumTabletsOnTS(witness, 1, kTimeout, nullptr, tablet::RUNNING));
+  rows_inserted = workload.rows_inserted();
+  ASSERT_EVENTUALLY([&]() {
+    ASSERT_GT(workload.rows_inserted(), rows_inserted + 100);
+  });
+  workload.StopAndJoin();
+
+  ASSERT_OK(WaitForServersToAgree(kTimeout, tablet_servers_, tablet_id_, 1));
+  NO_FATALS(cluster_->AssertNoCrashes());
+  ClusterVerifier v(cluster_.get());
+  NO_FATALS(v.CheckRowCount(kTableId, ClusterVerifier::AT_LEAST,
+                            num_rows + workload.rows_inserted()));
+}
+
+// Writes committed by the leader and the witness only must survive the
+// failure of the leader, even though the witness rolled and GCed its log
+// meanwhile, and was restarted: the witness is elected with the vote of the
+// lagging data replica, catches it up and hands its leadership over to it.
+TEST_F(RaftConsensusWitnessITest, WitnessCatchesUpDataReplica) {
+  vector<string> ts_flags = {
+    // Keep the config unchanged while a data replica is unavailable.
+    "--evict_failed_followers=false",
+    "--log_min_seconds_to_retain=0",
+  };
+  AddFlagsForLogRolls(&ts_flags);
+  TServerDetails* witness;
+  vector<TServerDetails*> data_replicas;
+  int64_t num_rows;
+  NO_FATALS(SetUpTabletWithWitness(std::move(ts_flags), &witness, &data_replicas, &num_rows));
+
+  TServerDetails* leader = nullptr;
+  NO_FATALS(WaitForDataReplicaLeader(witness, &leader));
+  TServerDetails* follower = data_replicas[0] == leader ? data_replicas[1] : data_replicas[0];
+  ExternalTabletServer* follower_ts = cluster_->tablet_server_by_uuid(follower->uuid());
+  ExternalTabletServer* leader_ts = cluster_->tablet_server_by_uuid(leader->uuid());
+  ExternalTabletServer* witness_ts = cluster_->tablet_server_by_uuid(witness->uuid());
+
+  // Write a few log segments' worth of rows while the data follower is
+  // paused, so that they're committed by the leader and the witness only.
+  ASSERT_OK(follower_ts->Pause());
+  TestWorkload workload(cluster_.get());
+  workload.set_table_name(kTableId);
+  workload.set_payload_bytes(1000);
+  workload.set_num_write_threads(4);
+  workload.set_write_batch_size(10);
+  workload.Setup();
+  workload.Start();
+  while (workload.rows_inserted() < 5000) {
+    SleepFor(MonoDelta::FromMilliseconds(10));
+  }
+  workload.StopAndJoin();
+
+  // Restart the witness: it must keep the operations across its bootstrap.
+  witness_ts->Shutdown();
+  ASSERT_OK(witness_ts->Restart());
+  ASSERT_OK(WaitForNumTabletsOnTS(witness, 1, kTimeout, nullptr, tablet::RUNNING));
+  OpId last_op;
+  ASSERT_OK(GetLastOpIdForReplica(tablet_id_, leader, consensus::RECEIVED_OPID,
+                                  kTimeout, &last_op));
+  ASSERT_OK(WaitUntilAllReplicasHaveOp(last_op.index(), tablet_id_, { witness }, kTimeout));
+
+  // Kill the leader and resume the follower: only the witness has the rows.
+  leader_ts->Shutdown();
+  ASSERT_OK(follower_ts->Resume());
+  ASSERT_OK(WaitUntilLeader(follower, tablet_id_, kTimeout));
+
+  ClusterVerifier v(cluster_.get());
+  NO_FATALS(v.CheckRowCountWithRetries(kTableId, ClusterVerifier::EXACTLY,
+                                       num_rows + workload.rows_inserted(),
+                                       kTimeout));
+  NO_FATALS(cluster_->AssertNoCrashes());
+}
+
+}  // namespace tserver
+}  // namespace kudu
@@ -17,17 +17,44 @@
 
 #include "kudu/kserver/kserver.h"
 
+#include <cstdint>
 #include <limits>
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "kudu/gutil/strings/join.h"
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/rpc/messenger.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/hash_util.h"
 #include "kudu/util/metrics.h"
+#include "kudu/util/numa.h"
 #include "kudu/util/status.h"
 #include "kudu/util/threadpool.h"
 
 using std::string;
+using std::vector;
+using strings::Substitute;
+
+DEFINE_bool(tablet_apply_pool_work_stealing, false,
+            "Whether the server-wide pool which applies write operations to tablets "
+            "runs one queue per worker thread, with idle workers stealing from the "
+            "other queues, rather than a single queue shared by all of its threads.");
+TAG_FLAG(tablet_apply_pool_work_stealing, experimental);
+
+DEFINE_bool(numa_aware_tablet_placement, false,
+            "Whether to spread the tablets hosted by this server across the NUMA "
+            "nodes of the machine, and to prepare and apply the transactions of each "
+            "tablet on threads bound to the CPUs of its node, which allocate their "
+            "memory from the node. This keeps the write path of a tablet, including "
+            "its in-memory stores, local to one node. Has no effect on machines "
+            "with a single NUMA node.");
+TAG_FLAG(numa_aware_tablet_placement, experimental);
 
 namespace kudu {
 
@@ -40,21 +67,21 @@ METRIC_DEFINE_histogram(server, op_apply_queue_length, "Operation Apply Queue Le
                         "Number of operations waiting to be applied to the tablet. "
                         "High queue lengths indicate that the server is unable to process "
                         "operations as fast as they are being written to the WAL.",
-                        10000, 2);
+                        10000, 2, kudu::PER_CPU);
 
 METRIC_DEFINE_histogram(server, op_apply_queue_time, "Operation Apply Queue Time",
                         MetricUnit::kMicroseconds,
                         "Time that operations spent waiting in the apply queue before being "
                         "processed. High queue times indicate that the server is unable to "
                         "process operations as fast as they are being written to the WAL.",
-                        10000000, 2);
+                        10000000, 2, kudu::PER_CPU);
 
 METRIC_DEFINE_histogram(server, op_apply_run_time, "Operation Apply Run Time",
                         MetricUnit::kMicroseconds,
                         "Time that operations spent being applied to the tablet. "
                         "High values may indicate that the server is under-provisioned or "
                         "that operations consist of very large batches.",
-                        10000000, 2);
+                        10000000, 2, kudu::PER_CPU);
 
 
 KuduServer::KuduServer(string name,
@@ -72,7 +99,8 @@ Status KuduServer::Init() {
       METRIC_op_apply_run_time.Instantiate(metric_entity_)
   };
   RETURN_NOT_OK(ThreadPoolBuilder("apply")
-                .set_metrics(std::move(metrics))
+                .set_metrics(metrics)
+                .set_work_stealing(FLAGS_tablet_apply_pool_work_stealing)
                 .Build(&tablet_apply_pool_));
 
   // These pools are shared by all replicas hosted by this server.
@@ -91,9 +119,85 @@ Status KuduServer::Init() {
                 .set_max_threads(std::numeric_limits<int>::max())
                 .Build(&raft_pool_));
 
+  if (FLAGS_numa_aware_tablet_placement) {
+    RETURN_NOT_OK(InitNumaPools(metrics));
+  }
+
+  return Status::OK();
+}
+
+Status KuduServer::InitNumaPools(const ThreadPoolMetrics& apply_metrics) {
+  int num_nodes = NumNumaNodes();
+  for (int node = 0; node < num_nodes; node++) {
+    vector<int> cpus;
+    Status s = GetNumaNodeCpus(node, &cpus);
+    if (!s.ok() || cpus.empty()) {
+      // Nodes with memory only, or which are offline.
+      continue;
+    }
+    // The pools of each node are sized as the shared pools are, relative to
+    // the CPUs of the node.
+    gscoped_ptr<ThreadPool> apply_pool;
+    RETURN_NOT_OK(ThreadPoolBuilder(Substitute("apply-numa$0", node))
+                  .set_trace_metric_prefix("apply")
+                  .set_max_threads(cpus.size())
+                  .set_metrics(apply_metrics)
+                  .set_work_stealing(FLAGS_tablet_apply_pool_work_stealing)
+                  .set_numa_node(node)
+                  .Build(&apply_pool));
+    gscoped_ptr<ThreadPool> prepare_pool;
+    RETURN_NOT_OK(ThreadPoolBuilder(Substitute("prepare-numa$0", node))
+                  .set_trace_metric_prefix("prepare")
+                  .set_max_threads(std::numeric_limits<int>::max())
+                  .set_numa_node(node)
+                  .Build(&prepare_pool));
+    numa_nodes_.push_back(node);
+    numa_apply_pools_.emplace_back(apply_pool.release());
+    numa_prepare_pools_.emplace_back(prepare_pool.release());
+  }
+  if (numa_nodes_.size() < 2) {
+    LOG(INFO) << "Not assigning tablets to NUMA nodes: found " << numa_nodes_.size()
+              << " NUMA node(s) with CPUs";
+    for (const auto& pool : numa_apply_pools_) {
+      pool->Shutdown();
+    }
+    for (const auto& pool : numa_prepare_pools_) {
+      pool->Shutdown();
+    }
+    numa_nodes_.clear();
+    numa_apply_pools_.clear();
+    numa_prepare_pools_.clear();
+    return Status::OK();
+  }
+  LOG(INFO) << "Assigning tablets to NUMA nodes " << JoinInts(numa_nodes_, ",");
   return Status::OK();
 }
 
+int KuduServer::NumaNodeIndexForTablet(const string& tablet_id) const {
+  if (numa_nodes_.empty()) {
+    return -1;
+  }
+  // A hash which is stable across restarts, so that a tablet is assigned to
+  // the same node for the lifetime of the server's data.
+  uint64_t hash = HashUtil::MurmurHash2_64(tablet_id.data(), tablet_id.size(), 0);
+  return hash % numa_nodes_.size();
+}
+
+int KuduServer::NumaNodeForTablet(const string& tablet_id) const {
+  int idx = NumaNodeIndexForTablet(tablet_id);
+  return idx < 0 ? -1 : numa_nodes_[idx];
+}
+
+ThreadPool* KuduServer::tablet_prepare_pool(const string& tablet_id) const {
+  int idx = NumaNodeIndexForTablet(tablet_id);
+  return idx < 0 ? tablet_prepare_pool_.get() : numa_prepare_pools_[idx].get();
+}
+
+ThreadPool* KuduServer::tablet_apply_pool(const string& tablet_id) const {
+  int idx = NumaNodeIndexForTablet(tablet_id);
+  return idx < 0 ? tablet_apply_pool_.get() : numa_apply_pools_[idx].get();
+}
+
 Status KuduServer::Start() {
   RETURN_NOT_OK(ServerBase::Start());
   return Status::OK();
@@ -124,6 +228,12 @@ void KuduServer::Shutdown() {
   if (tablet_prepare_pool_) {
     tablet_prepare_pool_->Shutdown();
   }
+  for (const auto& pool : numa_apply_pools_) {
+    pool->Shutdown();
+  }
+  for (const auto& pool : numa_prepare_pools_) {
+    pool->Shutdown();
+  }
   ServerBase::Shutdown();
 }
 
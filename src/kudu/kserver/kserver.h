@@ -17,7 +17,9 @@
 
 #pragma once
 
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
@@ -60,7 +62,26 @@ class KuduServer : public server::ServerBase {
   ThreadPool* tablet_apply_pool() const { return tablet_apply_pool_.get(); }
   ThreadPool* raft_pool() const { return raft_pool_.get(); }
 
+  // Returns the pools on which the replica of tablet 'tablet_id' prepares and
+  // applies its transactions. With --numa_aware_tablet_placement, the tablets
+  // are spread across the NUMA nodes of the machine, and these are pools whose
+  // threads are bound to the node of the tablet. Otherwise, they're the pools
+  // shared by all the tablets.
+  ThreadPool* tablet_prepare_pool(const std::string& tablet_id) const;
+  ThreadPool* tablet_apply_pool(const std::string& tablet_id) const;
+
+  // Returns the NUMA node to which tablet 'tablet_id' is assigned, or -1 if
+  // tablets aren't assigned to NUMA nodes.
+  int NumaNodeForTablet(const std::string& tablet_id) const;
+
  private:
+  // Builds the pools of each NUMA node to which tablets are assigned, if the
+  // machine has several nodes with CPUs.
+  Status InitNumaPools(const ThreadPoolMetrics& apply_metrics);
+
+  // Returns the index in 'numa_nodes_' of the node to which tablet
+  // 'tablet_id' is assigned, or -1 if tablets aren't assigned to nodes.
+  int NumaNodeIndexForTablet(const std::string& tablet_id) const;
 
   // Thread pool for preparing transactions, shared between all tablets.
   gscoped_ptr<ThreadPool> tablet_prepare_pool_;
@@ -71,6 +92,15 @@ class KuduServer : public server::ServerBase {
   // Thread pool for Raft-related operations, shared between all tablets.
   gscoped_ptr<ThreadPool> raft_pool_;
 
+  // The NUMA nodes with CPUs to which tablets are assigned. Empty unless
+  // tablets are assigned to NUMA nodes.
+  std::vector<int> numa_nodes_;
+
+  // Thread pools for preparing and applying the transactions of the tablets
+  // assigned to each node of 'numa_nodes_', in the same order.
+  std::vector<std::unique_ptr<ThreadPool>> numa_prepare_pools_;
+  std::vector<std::unique_ptr<ThreadPool>> numa_apply_pools_;
+
   DISALLOW_COPY_AND_ASSIGN(KuduServer);
 };
 
@@ -19,6 +19,7 @@
 #include <string>
 #include <vector>
 
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 
@@ -28,11 +29,14 @@
 #include "kudu/master/catalog_manager.h"
 #include "kudu/master/master.pb.h"
 #include "kudu/master/ts_descriptor.h"
+#include "kudu/tablet/metadata.pb.h"
 #include "kudu/util/cow_object.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/test_macros.h"
 #include "kudu/util/test_util.h"
 
+DECLARE_bool(replica_placement_use_reported_load);
+
 using std::string;
 using std::vector;
 using strings::Substitute;
@@ -95,6 +99,32 @@ TEST(TableInfoTest, TestAssignmentRanges) {
   }
 }
 
+TEST(TableInfoTest, TestTabletLocationsCache) {
+  scoped_refptr<TableInfo> table(new TableInfo(CURRENT_TEST_NAME()));
+  TabletLocationsPB locs_pb;
+  ASSERT_FALSE(table->GetCachedTabletLocations("tablet", 1, &locs_pb));
+
+  TabletLocationsPB cached;
+  cached.set_tablet_id("tablet");
+  cached.add_replicas()->mutable_ts_info()->set_permanent_uuid("ts");
+  table->CacheTabletLocations("tablet", 1, cached);
+  ASSERT_TRUE(table->GetCachedTabletLocations("tablet", 1, &locs_pb));
+  ASSERT_EQ(cached.SerializeAsString(), locs_pb.SerializeAsString());
+  ASSERT_FALSE(table->GetCachedTabletLocations("other-tablet", 1, &locs_pb));
+
+  // Locations are only returned for the version they were built at.
+  ASSERT_FALSE(table->GetCachedTabletLocations("tablet", 2, &locs_pb));
+
+  // Caching locations of a newer version drops those of older versions, and
+  // locations of an older version than the cache's are never cached.
+  table->CacheTabletLocations("other-tablet", 2, cached);
+  ASSERT_FALSE(table->GetCachedTabletLocations("tablet", 1, &locs_pb));
+  table->CacheTabletLocations("tablet", 1, cached);
+  ASSERT_FALSE(table->GetCachedTabletLocations("tablet", 1, &locs_pb));
+  ASSERT_FALSE(table->GetCachedTabletLocations("tablet", 2, &locs_pb));
+  ASSERT_TRUE(table->GetCachedTabletLocations("other-tablet", 2, &locs_pb));
+}
+
 TEST(TestTSDescriptor, TestReplicaCreationsDecay) {
   TSDescriptor ts("test");
   ASSERT_EQ(0, ts.RecentReplicaCreations());
@@ -117,5 +147,94 @@ TEST(TestTSDescriptor, TestReplicaCreationsDecay) {
   }
 }
 
+TEST(TestTSDescriptor, TestRpcQueueTime) {
+  TSDescriptor ts("test");
+  TSLoadPB load_pb;
+  load_pb.set_rpcs_queued(100);
+  load_pb.set_rpc_queue_time_us(100000);
+  ts.UpdateLoad(load_pb);
+  // The first heartbeat only sets the baseline.
+  ASSERT_EQ(0, ts.load().rpc_queue_time_us);
+
+  // 100 RPCs queued for 50ms each, averaged with the initial zero.
+  load_pb.set_rpcs_queued(200);
+  load_pb.set_rpc_queue_time_us(5100000);
+  ts.UpdateLoad(load_pb);
+  ASSERT_DOUBLE_EQ(25000, ts.load().rpc_queue_time_us);
+
+  // No RPC queued since the last heartbeat leaves the queue time as is.
+  ts.UpdateLoad(load_pb);
+  ASSERT_DOUBLE_EQ(25000, ts.load().rpc_queue_time_us);
+
+  // The counts restart from zero when the tablet server restarts.
+  load_pb.set_rpcs_queued(10);
+  load_pb.set_rpc_queue_time_us(10);
+  ts.UpdateLoad(load_pb);
+  ASSERT_DOUBLE_EQ(25000, ts.load().rpc_queue_time_us);
+  load_pb.set_rpcs_queued(20);
+  load_pb.set_rpc_queue_time_us(20010);
+  ts.UpdateLoad(load_pb);
+  ASSERT_DOUBLE_EQ(13500, ts.load().rpc_queue_time_us);
+}
+
+TEST(TestTSDescriptor, TestHotTablets) {
+  TSDescriptor ts("test");
+  ASSERT_TRUE(ts.hot_tablets().empty());
+  TSLoadPB load_pb;
+  tablet::TabletHotKeysPB* hot = load_pb.add_hot_tablets();
+  hot->set_tablet_id("t1");
+  hot->set_estimated_ops(100);
+  ts.UpdateLoad(load_pb);
+  ASSERT_EQ(1, ts.hot_tablets().size());
+  ASSERT_EQ("t1", ts.hot_tablets()[0].tablet_id());
+  ASSERT_EQ(100, ts.hot_tablets()[0].estimated_ops());
+
+  // Each heartbeat replaces the hot tablets of the previous one.
+  ts.UpdateLoad(TSLoadPB());
+  ASSERT_TRUE(ts.hot_tablets().empty());
+}
+
+TEST(ReplicaPlacementTest, TestReplicaPlacementLoad) {
+  TSDescriptor::Load idle;
+  idle.reported = true;
+  idle.data_dirs_free_bytes = 900;
+  idle.data_dirs_capacity_bytes = 1000;
+
+  // Without reported load, only the replicas count.
+  TSDescriptor::Load unreported;
+  ASSERT_EQ(3, ReplicaPlacementLoad(3, unreported, idle));
+  ASSERT_EQ(3, ReplicaPlacementLoad(3, idle, unreported));
+
+  // The load of identical servers grows with their replicas.
+  ASSERT_LT(ReplicaPlacementLoad(2, idle, idle), ReplicaPlacementLoad(3, idle, idle));
+
+  // Leaders, activity, memory pressure and full disks all make a server
+  // more loaded than an otherwise identical idle one.
+  TSDescriptor::Load leaders = idle;
+  leaders.num_leaders = 2;
+  ASSERT_GT(ReplicaPlacementLoad(3, leaders, idle), ReplicaPlacementLoad(3, idle, leaders));
+
+  TSDescriptor::Load busy = idle;
+  busy.rows_written_per_sec = 1000;
+  busy.rows_scanned_per_sec = 1000;
+  ASSERT_GT(ReplicaPlacementLoad(3, busy, idle), ReplicaPlacementLoad(3, idle, busy));
+  // A busy server may still be chosen if the idle one has many more replicas.
+  ASSERT_LT(ReplicaPlacementLoad(3, busy, idle), ReplicaPlacementLoad(10, idle, busy));
+
+  TSDescriptor::Load memory_pressure = idle;
+  memory_pressure.memory_pressure = true;
+  ASSERT_GT(ReplicaPlacementLoad(3, memory_pressure, idle),
+            ReplicaPlacementLoad(3, idle, memory_pressure));
+
+  TSDescriptor::Load full = idle;
+  full.data_dirs_free_bytes = 50;
+  ASSERT_GT(ReplicaPlacementLoad(3, full, idle), ReplicaPlacementLoad(3, idle, full));
+
+  // The reported load can be ignored.
+  google::FlagSaver saver;
+  FLAGS_replica_placement_use_reported_load = false;
+  ASSERT_EQ(3, ReplicaPlacementLoad(3, full, idle));
+}
+
 } // namespace master
 } // namespace kudu
@@ -113,6 +113,7 @@
 #include "kudu/tserver/tserver_admin.pb.h"
 #include "kudu/tserver/tserver_admin.proxy.h"
 #include "kudu/util/condition_variable.h"
+#include "kudu/util/countdown_latch.h"
 #include "kudu/util/debug/trace_event.h"
 #include "kudu/util/fault_injection.h"
 #include "kudu/util/flag_tags.h"
@@ -213,6 +214,53 @@ DEFINE_int32(table_locations_ttl_ms, 5 * 60 * 1000, // 5 minutes
              "until after waiting for the ttl period.");
 TAG_FLAG(table_locations_ttl_ms, advanced);
 
+DEFINE_bool(replica_placement_use_reported_load, true,
+            "Whether to take the load reported by the tablet servers in their heartbeats "
+            "(free disk space, leaders, rows written and scanned, memory pressure) into "
+            "account when placing new tablet replicas, rather than only their numbers "
+            "of replicas.");
+TAG_FLAG(replica_placement_use_reported_load, advanced);
+TAG_FLAG(replica_placement_use_reported_load, runtime);
+
+DEFINE_bool(enable_rebalancer, false,
+            "Whether the leader master should periodically move tablet leaders and "
+            "replicas to even out the numbers of leaders and replicas per tablet "
+            "server and per table.");
+TAG_FLAG(enable_rebalancer, experimental);
+TAG_FLAG(enable_rebalancer, runtime);
+
+DEFINE_int32(rebalancer_interval_ms, 10 * 1000, // 10 sec
+             "Interval in milliseconds between the passes of the rebalancer.");
+TAG_FLAG(rebalancer_interval_ms, advanced);
+TAG_FLAG(rebalancer_interval_ms, runtime);
+
+DEFINE_int32(rebalancer_max_concurrent_replica_moves, 5,
+             "Maximum number of replica moves the rebalancer runs at once.");
+TAG_FLAG(rebalancer_max_concurrent_replica_moves, advanced);
+TAG_FLAG(rebalancer_max_concurrent_replica_moves, runtime);
+
+DEFINE_int32(rebalancer_max_leader_moves_per_pass, 10,
+             "Maximum number of leader step-downs the rebalancer requests per pass.");
+TAG_FLAG(rebalancer_max_leader_moves_per_pass, advanced);
+TAG_FLAG(rebalancer_max_leader_moves_per_pass, runtime);
+
+DEFINE_int32(rebalancer_move_timeout_ms, 10 * 60 * 1000, // 10 minutes
+             "Time in milliseconds after which the rebalancer abandons a replica move "
+             "which didn't complete, e.g. because the new replica failed to copy.");
+TAG_FLAG(rebalancer_move_timeout_ms, advanced);
+TAG_FLAG(rebalancer_move_timeout_ms, runtime);
+
+DEFINE_int32(tablet_report_batch_size, 1000,
+             "Number of tablets of a tablet report the master processes in a batch. "
+             "The batches of large reports are processed in parallel.");
+TAG_FLAG(tablet_report_batch_size, advanced);
+TAG_FLAG(tablet_report_batch_size, runtime);
+
+DEFINE_int32(tablet_report_processing_threads, 4,
+             "Maximum number of threads the master uses to process the batches of "
+             "large tablet reports.");
+TAG_FLAG(tablet_report_processing_threads, advanced);
+
 DEFINE_bool(catalog_manager_fail_ts_rpcs, false,
             "Whether all master->TS async calls should fail. Only for testing!");
 TAG_FLAG(catalog_manager_fail_ts_rpcs, hidden);
@@ -244,6 +292,7 @@ using consensus::ConsensusServiceProxy;
 using consensus::ConsensusStatePB;
 using consensus::GetConsensusRole;
 using consensus::IsRaftConfigMember;
+using consensus::IsRaftConfigVoter;
 using consensus::RaftConsensus;
 using consensus::RaftPeerPB;
 using consensus::StartTabletCopyRequestPB;
@@ -348,8 +397,10 @@ class TabletLoader : public TabletVisitor {
       // from clean state, which is uninitialized for these brand new tablets.
       TabletMetadataLock l(tablet.get(), LockMode::READ);
       table->AddRemoveTablets({ tablet }, {});
-      LOG(INFO) << Substitute("Loaded metadata for tablet $0 (table $1)",
-                              tablet_id, table->ToString());
+      // Catalogs may have hundreds of thousands of tablets: logging each one
+      // would noticeably slow down loading them.
+      VLOG(1) << Substitute("Loaded metadata for tablet $0 (table $1)",
+                            tablet_id, table->ToString());
     }
 
     VLOG(2) << Substitute("Metadata for tablet $0: $1",
@@ -501,6 +552,9 @@ void CatalogManagerBgTasks::Run() {
           }
         }
 
+        // Move leaders and replicas if the tablet servers are unbalanced.
+        catalog_manager_->RunRebalancer();
+
         // If this is the leader master, check if it's time to generate
         // and store a new TSK (Token Signing Key).
         Status s = catalog_manager_->TryGenerateNewTskUnlocked();
@@ -611,7 +665,8 @@ Status ProcessColumnPBDefaults(ColumnSchemaPB* col) {
 } // anonymous namespace
 
 CatalogManager::CatalogManager(Master *master)
-  : master_(master),
+  : tablet_mutations_(0),
+    master_(master),
     rng_(GetRandomSeed32()),
     state_(kConstructed),
     leader_ready_term_(-1),
@@ -622,6 +677,9 @@ CatalogManager::CatalogManager(Master *master)
            // closely timed consecutive elections).
            .set_max_threads(1)
            .Build(&leader_election_pool_));
+  CHECK_OK(ThreadPoolBuilder("tablet-report")
+           .set_max_threads(std::max(1, FLAGS_tablet_report_processing_threads))
+           .Build(&tablet_report_pool_));
 }
 
 CatalogManager::~CatalogManager() {
@@ -990,6 +1048,8 @@ Status CatalogManager::VisitTablesAndTabletsUnlocked() {
   TabletLoader tablet_loader(this);
   RETURN_NOT_OK_PREPEND(sys_catalog_->VisitTablets(&tablet_loader),
                         "Failed while visiting tablets in sys catalog");
+  LOG_WITH_PREFIX(INFO) << Substitute("Loaded metadata for $0 tables and $1 tablets",
+                                      table_ids_map_.size(), tablet_map_.size());
   return Status::OK();
 }
 
@@ -1082,6 +1142,7 @@ void CatalogManager::Shutdown() {
   // Must be done before shutting down the catalog, otherwise its TabletReplica
   // may be destroyed while still in use by the ElectedAsLeaderCb task.
   leader_election_pool_->Shutdown();
+  tablet_report_pool_->Shutdown();
 
   // Shut down the underlying storage for tables and tablets.
   if (sys_catalog_) {
@@ -1173,6 +1234,45 @@ Status ValidateClientSchema(const boost::optional<string>& name,
           Substitute("invalid encoding for column '$0'", col.name()));
     }
   }
+
+  // Check that there's at most one time-to-live column, and that it holds
+  // non-null timestamps.
+  int ttl_col_idx = Schema::kColumnNotFound;
+  for (int i = 0; i < schema.num_columns(); i++) {
+    const auto& col = schema.column(i);
+    if (col.attributes().ttl_sec < 0) {
+      return Status::InvalidArgument(Substitute(
+          "invalid time-to-live for column '$0': must not be negative", col.name()));
+    }
+    if (col.attributes().ttl_sec == 0) {
+      continue;
+    }
+    if (ttl_col_idx != Schema::kColumnNotFound) {
+      return Status::InvalidArgument(Substitute(
+          "columns '$0' and '$1' both have a time-to-live: at most one column may",
+          schema.column(ttl_col_idx).name(), col.name()));
+    }
+    if (col.type_info()->type() != UNIXTIME_MICROS || col.is_nullable()) {
+      return Status::InvalidArgument(Substitute(
+          "time-to-live column '$0' must be a non-nullable UNIXTIME_MICROS column",
+          col.name()));
+    }
+    ttl_col_idx = i;
+  }
+
+  // Check that only non-key columns have secondary indexes or bloom filters:
+  // the rows are already indexed and filtered by their primary key.
+  for (int i = 0; i < schema.num_key_columns(); i++) {
+    const auto& col = schema.column(i);
+    if (col.attributes().secondary_index) {
+      return Status::InvalidArgument(Substitute(
+          "primary key column '$0' can't have a secondary index", col.name()));
+    }
+    if (col.attributes().bloom_filter) {
+      return Status::InvalidArgument(Substitute(
+          "primary key column '$0' can't have a bloom filter", col.name()));
+    }
+  }
   return Status::OK();
 }
 
@@ -1610,6 +1710,7 @@ Status CatalogManager::DeleteTable(const DeleteTableRequestPB* req,
 
     // 5. Commit the dirty tablet state.
     lock.Commit();
+    InvalidateTabletLocations();
   }
 
   // 6. Commit the dirty table state.
@@ -2131,6 +2232,7 @@ Status CatalogManager::AlterTable(const AlterTableRequestPB* req,
   // GetTabletLocations returns a deleted tablet, the retry will never include
   // the tablet again.
   tablets_to_drop_lock.Commit();
+  InvalidateTabletLocations();
 
   if (!tablets_to_add.empty() || has_metadata_changes) {
     l.Commit();
@@ -2199,6 +2301,7 @@ Status CatalogManager::GetTableSchema(const GetTableSchemaRequestPB* req,
   } else {
     // There's no AlterTable, the regular schema is "fully applied".
     resp->mutable_schema()->CopyFrom(l.data().pb.schema());
+    resp->set_schema_version(l.data().pb.version());
   }
   resp->set_num_replicas(l.data().pb.num_replicas());
   resp->set_table_id(table->id());
@@ -2817,6 +2920,42 @@ class AsyncDeleteReplica : public RetrySpecificTSRpcTask {
   tserver::DeleteTabletResponsePB resp_;
 };
 
+double ReplicaPlacementLoad(double num_replicas,
+                            const TSDescriptor::Load& load,
+                            const TSDescriptor::Load& other_load) {
+  if (!FLAGS_replica_placement_use_reported_load ||
+      !load.reported || !other_load.reported) {
+    return num_replicas;
+  }
+
+  // Leader replicas do more work than followers: they serve the writes, and
+  // by default the scans, of their tablets. The extra one lets the factors
+  // below weigh servers without replicas too.
+  double result = 1 + num_replicas + 0.5 * load.num_leaders;
+
+  // The busier of the two servers, in rows written and scanned per second,
+  // counts up to twice its replicas.
+  double activity = load.rows_written_per_sec + load.rows_scanned_per_sec;
+  double total_activity = activity +
+      other_load.rows_written_per_sec + other_load.rows_scanned_per_sec;
+  if (total_activity > 0) {
+    result *= 1 + activity / total_activity;
+  }
+
+  if (load.memory_pressure) {
+    result *= 2;
+  }
+
+  // The load grows as the data directories fill up, steering new replicas
+  // away from servers which are running out of space.
+  if (load.data_dirs_capacity_bytes > 0) {
+    double free_fraction = static_cast<double>(load.data_dirs_free_bytes) /
+                           load.data_dirs_capacity_bytes;
+    result /= std::max(free_fraction, 0.01);
+  }
+  return result;
+}
+
 namespace {
 
 // Given exactly two choices in 'two_choices', pick the better tablet server on
@@ -2842,10 +2981,14 @@ shared_ptr<TSDescriptor> PickBetterReplicaLocation(const TSDescriptorVector& two
   // we batch the selection process before sending any creation commands to the
   // servers themselves.
   //
-  // TODO(wdberkeley): in the future we may want to factor in other items such
-  // as available disk space, actual request load, etc.
-  double load_a = a->RecentReplicaCreations() + a->num_live_replicas();
-  double load_b = b->RecentReplicaCreations() + b->num_live_replicas();
+  // Both are weighed by the load the servers report, if they do: see
+  // ReplicaPlacementLoad().
+  const TSDescriptor::Load reported_a = a->load();
+  const TSDescriptor::Load reported_b = b->load();
+  double load_a = ReplicaPlacementLoad(a->RecentReplicaCreations() + a->num_live_replicas(),
+                                       reported_a, reported_b);
+  double load_b = ReplicaPlacementLoad(b->RecentReplicaCreations() + b->num_live_replicas(),
+                                       reported_b, reported_a);
   if (load_a < load_b) {
     return a;
   }
@@ -3107,111 +3250,184 @@ void AsyncAddServerTask::HandleResponse(int attempt) {
   }
 }
 
-Status CatalogManager::ProcessTabletReport(
-    TSDescriptor* ts_desc,
-    const TabletReportPB& full_report,
-    TabletReportUpdatesPB* full_report_update,
-    RpcContext* rpc) {
-  int num_tablets = full_report.updated_tablets_size();
-  TRACE_EVENT2("master", "ProcessTabletReport",
-               "requestor", rpc->requestor_string(),
-               "num_tablets", num_tablets);
-  TRACE_COUNTER_INCREMENT("reported_tablets", num_tablets);
+// Asks a tablet leader replica to step down, so that another replica may be
+// elected leader. Used by the rebalancer to move leaders.
+class AsyncLeaderStepDownTask : public RetryingTSRpcTask {
+ public:
+  AsyncLeaderStepDownTask(Master* master,
+                          const scoped_refptr<TabletInfo>& tablet,
+                          const string& leader_uuid)
+    : RetryingTSRpcTask(master,
+                        gscoped_ptr<TSPicker>(new PickSpecificUUID(leader_uuid)),
+                        tablet->table()),
+      tablet_(tablet),
+      leader_uuid_(leader_uuid) {
+    deadline_ = start_ts_ + MonoDelta::FromMilliseconds(FLAGS_rebalancer_move_timeout_ms);
+  }
 
-  leader_lock_.AssertAcquiredForReading();
+  string type_name() const override { return "LeaderStepDown"; }
 
-  VLOG(2) << Substitute("Received tablet report from $0:\n$1",
-                        RequestorString(rpc), SecureDebugString(full_report));
+  string description() const override {
+    return Substitute("LeaderStepDown RPC for tablet $0 on TS $1",
+                      tablet_->id(), leader_uuid_);
+  }
 
-  // TODO(todd): on a full tablet report, we may want to iterate over the
-  // tablets we think the server should have, compare vs the ones being
-  // reported, and somehow mark any that have been "lost" (eg somehow the
-  // tablet metadata got corrupted or something).
+ protected:
+  bool SendRequest(int attempt) override {
+    req_.set_dest_uuid(leader_uuid_);
+    req_.set_tablet_id(tablet_->id());
+    VLOG(1) << Substitute("Sending LeaderStepDown request to $0 (attempt $1): $2",
+                          target_ts_desc_->ToString(), attempt, SecureDebugString(req_));
+    consensus_proxy_->LeaderStepDownAsync(req_, &resp_, &rpc_,
+                                          boost::bind(&AsyncLeaderStepDownTask::RpcCallback,
+                                                      this));
+    return true;
+  }
 
-  // Maps a tablet ID to its corresponding tablet report (owned by 'full_report').
-  unordered_map<string, const ReportedTabletPB*> reports;
+  void HandleResponse(int attempt) override {
+    if (!resp_.has_error()) {
+      MarkComplete();
+      LOG_WITH_PREFIX(INFO) << "Leader stepped down";
+      return;
+    }
+    Status status = StatusFromPB(resp_.error().status());
+    switch (resp_.error().code()) {
+      case TabletServerErrorPB::NOT_THE_LEADER:
+      case TabletServerErrorPB::TABLET_NOT_FOUND:
+        // The leader already moved: there is nothing left to do.
+        LOG_WITH_PREFIX(INFO) << "No further retry: " << status.ToString();
+        MarkFailed();
+        break;
+      default:
+        LOG_WITH_PREFIX(INFO) << Substitute("LeaderStepDown() failed with error $0. "
+            "This operation will be retried. Error detail: $1",
+            TabletServerErrorPB::Code_Name(resp_.error().code()), status.ToString());
+        break;
+    }
+  }
 
-  // Maps a tablet ID to its corresponding tablet report update (owned by
-  // 'full_report_update').
-  unordered_map<string, ReportedTabletUpdatesPB*> updates;
+ private:
+  string tablet_id() const override { return tablet_->id(); }
 
-  // Maps a tablet ID to its corresponding TabletInfo.
-  unordered_map<string, scoped_refptr<TabletInfo>> tablet_infos;
+  const scoped_refptr<TabletInfo> tablet_;
+  const string leader_uuid_;
 
-  // Keeps track of all RPCs that should be sent when we're done.
-  vector<unique_ptr<RetryingTSRpcTask>> rpcs;
+  consensus::LeaderStepDownRequestPB req_;
+  consensus::LeaderStepDownResponsePB resp_;
+};
 
-  // Locks the referenced tables (for READ) and tablets (for WRITE).
-  //
-  // We must hold the tablets' locks while writing to the catalog table, and
-  // since they're locked for WRITE, we have to lock them en masse in order to
-  // avoid deadlocking.
-  //
-  // We have more freedom with the table locks: we could acquire them en masse,
-  // or we could acquire, use, and release them one at a time. So why do we
-  // acquire en masse? Because it reduces the overall number of lock
-  // acquisitions by reusing locks for tablets belonging to the same table, and
-  // although one-at-a-time acquisition would reduce table lock contention when
-  // writing, table writes are very rare events.
-  TableMetadataGroupLock tables_lock(LockMode::RELEASED);
-  TabletMetadataGroupLock tablets_lock(LockMode::RELEASED);
+// Adds or removes a specific voter replica, on tablet server 'peer_uuid',
+// to or from the config of a tablet. Used by the rebalancer to move replicas.
+//
+// Like AsyncAddServerTask, the change is conditioned on the committed config
+// having opid_index 'cas_config_opid_index', and isn't retried once it
+// doesn't.
+class AsyncChangeConfigTask : public RetryingTSRpcTask {
+ public:
+  AsyncChangeConfigTask(Master* master,
+                        const scoped_refptr<TabletInfo>& tablet,
+                        consensus::ChangeConfigType type,
+                        string peer_uuid,
+                        int64_t cas_config_opid_index)
+    : RetryingTSRpcTask(master,
+                        gscoped_ptr<TSPicker>(new PickLeaderReplica(tablet)),
+                        tablet->table()),
+      tablet_(tablet),
+      type_(type),
+      peer_uuid_(std::move(peer_uuid)),
+      cas_config_opid_index_(cas_config_opid_index) {
+    deadline_ = start_ts_ + MonoDelta::FromMilliseconds(FLAGS_rebalancer_move_timeout_ms);
+  }
 
-  // 1. Set up local state.
-  full_report_update->mutable_tablets()->Reserve(num_tablets);
-  {
-    // We only need to acquire lock_ for the tablet_map_ access, but since it's
-    // acquired exclusively so rarely, it's probably cheaper to acquire and
-    // hold it for all tablets here than to acquire/release it for each tablet.
-    shared_lock<LockType> l(lock_);
-    for (const ReportedTabletPB& report : full_report.updated_tablets()) {
-      const string& tablet_id = report.tablet_id();
+  string type_name() const override {
+    return Substitute("$0 ChangeConfig", consensus::ChangeConfigType_Name(type_));
+  }
 
-      // 1a. Prepare an update entry for this tablet. Every tablet in the
-      // report gets one, even if there's no change to it.
-      ReportedTabletUpdatesPB* update = full_report_update->add_tablets();
-      update->set_tablet_id(tablet_id);
+  string description() const override {
+    return Substitute("$0 ChangeConfig RPC for tablet $1 and TS $2 "
+                      "with cas_config_opid_index $3",
+                      consensus::ChangeConfigType_Name(type_), tablet_->id(),
+                      peer_uuid_, cas_config_opid_index_);
+  }
 
-      // 1b. Find the tablet, deleting/skipping it if it can't be found.
-      scoped_refptr<TabletInfo> tablet = FindPtrOrNull(tablet_map_, tablet_id);
-      if (!tablet) {
-        // It'd be unsafe to ask the tserver to delete this tablet without first
-        // replicating something to our followers (i.e. to guarantee that we're
-        // the leader). For example, if we were a rogue master, we might be
-        // deleting a tablet created by a new master accidentally. But masters
-        // retain metadata for deleted tablets forever, so a tablet can only be
-        // truly unknown in the event of a serious misconfiguration, such as a
-        // tserver heartbeating to the wrong cluster. Therefore, it should be
-        // reasonable to ignore it and wait for an operator fix the situation.
-        LOG(WARNING) << "Ignoring report from unknown tablet " << tablet_id;
-        continue;
+ protected:
+  bool SendRequest(int attempt) override {
+    req_.set_dest_uuid(target_ts_desc_->permanent_uuid());
+    req_.set_tablet_id(tablet_->id());
+    req_.set_type(type_);
+    req_.set_cas_config_opid_index(cas_config_opid_index_);
+    RaftPeerPB* peer = req_.mutable_server();
+    peer->set_permanent_uuid(peer_uuid_);
+    if (type_ == consensus::ADD_SERVER) {
+      shared_ptr<TSDescriptor> peer_desc;
+      if (!master_->ts_manager()->LookupTSByUUID(peer_uuid_, &peer_desc)) {
+        LOG_WITH_PREFIX(WARNING) << "TS " << peer_uuid_ << " is not registered";
+        MarkFailed();
+        return false;
       }
+      ServerRegistrationPB peer_reg;
+      peer_desc->GetRegistration(&peer_reg);
+      CHECK_GT(peer_reg.rpc_addresses_size(), 0);
+      *peer->mutable_last_known_addr() = peer_reg.rpc_addresses(0);
+      peer->set_member_type(RaftPeerPB::VOTER);
+    }
+    VLOG(1) << Substitute("Sending $0 request to $1 (attempt $2): $3",
+                          type_name(), target_ts_desc_->ToString(), attempt,
+                          SecureDebugString(req_));
+    consensus_proxy_->ChangeConfigAsync(req_, &resp_, &rpc_,
+                                        boost::bind(&AsyncChangeConfigTask::RpcCallback, this));
+    return true;
+  }
 
-      // 1c. Found the tablet, update local state. If multiple tablets with the
-      // same ID are in the report, all but the last one will be ignored.
-      reports[tablet_id] = &report;
-      updates[tablet_id] = update;
-      tablet_infos[tablet_id] = tablet;
-      tables_lock.AddInfo(*tablet->table().get());
-      tablets_lock.AddMutableInfo(tablet.get());
+  void HandleResponse(int attempt) override {
+    if (!resp_.has_error()) {
+      MarkComplete();
+      LOG_WITH_PREFIX(INFO) << "Config change succeeded";
+      return;
+    }
+    Status status = StatusFromPB(resp_.error().status());
+    switch (resp_.error().code()) {
+      case TabletServerErrorPB::CAS_FAILED:
+        LOG_WITH_PREFIX(WARNING) << Substitute("ChangeConfig() failed with leader $0 "
+            "due to CAS failure. No further retry: $1",
+            target_ts_desc_->ToString(), status.ToString());
+        MarkFailed();
+        break;
+      default:
+        LOG_WITH_PREFIX(INFO) << Substitute("ChangeConfig() failed with leader $0 "
+            "due to error $1. This operation will be retried. Error detail: $2",
+            target_ts_desc_->ToString(),
+            TabletServerErrorPB::Code_Name(resp_.error().code()), status.ToString());
+        break;
     }
   }
 
-  // 2. Lock the affected tables and tablets.
-  tables_lock.Lock(LockMode::READ);
-  tablets_lock.Lock(LockMode::WRITE);
+ private:
+  string tablet_id() const override { return tablet_->id(); }
 
-  // 3. Process each tablet. This may not be in the order that the tablets
-  // appear in 'full_report', but that has no bearing on correctness.
-  vector<scoped_refptr<TabletInfo>> mutated_tablets;
-  for (const auto& e : tablet_infos) {
-    const string& tablet_id = e.first;
-    const scoped_refptr<TabletInfo>& tablet = e.second;
+  const scoped_refptr<TabletInfo> tablet_;
+  const consensus::ChangeConfigType type_;
+  const string peer_uuid_;
+  const int64_t cas_config_opid_index_;
+
+  consensus::ChangeConfigRequestPB req_;
+  consensus::ChangeConfigResponsePB resp_;
+};
+
+void CatalogManager::ProcessTabletReportBatch(
+    TSDescriptor* ts_desc,
+    const vector<ReportedTablet>& batch,
+    vector<unique_ptr<RetryingTSRpcTask>>* rpcs,
+    vector<scoped_refptr<TabletInfo>>* mutated_tablets) {
+  for (const ReportedTablet& reported_tablet : batch) {
+    const scoped_refptr<TabletInfo>& tablet = reported_tablet.tablet;
+    const string& tablet_id = tablet->id();
     const scoped_refptr<TableInfo>& table = tablet->table();
-    const ReportedTabletPB& report = *FindOrDie(reports, tablet_id);
-    ReportedTabletUpdatesPB* update = FindOrDie(updates, tablet_id);
+    const ReportedTabletPB& report = *reported_tablet.report;
+    ReportedTabletUpdatesPB* update = reported_tablet.update;
     bool tablet_was_mutated = false;
 
-    // 4. Delete the tablet if it (or its table) have been deleted.
+    // 4a. Delete the tablet if it (or its table) have been deleted.
     if (tablet->metadata().state().is_deleted() ||
         table->metadata().state().is_deleted()) {
       const string& msg = tablet->metadata().state().pb.state_msg();
@@ -3221,12 +3437,30 @@ Status CatalogManager::ProcessTabletReport(
 
       // TODO(unknown): Cancel tablet creation, instead of deleting, in cases
       // where that might be possible (tablet creation timeout & replacement).
-      rpcs.emplace_back(new AsyncDeleteReplica(
+      rpcs->emplace_back(new AsyncDeleteReplica(
           master_, ts_desc->permanent_uuid(), table, tablet_id,
           TABLET_DATA_DELETED, boost::none, msg));
       continue;
     }
 
+    // 4b. A compact report entry carries a digest of the replica's consensus
+    // state rather than the state itself. It stands for an entry which would
+    // change nothing if the digest matches the known consensus state, the
+    // server is a member of the config, and the tablet is running with a known
+    // leader. Otherwise, ask the tablet server to report the tablet in full.
+    if (report.has_consensus_state_digest()) {
+      const ConsensusStatePB& known_cstate = tablet->metadata().state().pb.consensus_state();
+      if (!tablet->metadata().state().is_running() ||
+          known_cstate.leader_uuid().empty() ||
+          !IsRaftConfigMember(ts_desc->permanent_uuid(), known_cstate.committed_config()) ||
+          report.consensus_state_digest() != consensus::ConsensusStateDigest(known_cstate)) {
+        VLOG(2) << Substitute("Requesting full report of tablet $0 from $1",
+                              tablet->ToString(), ts_desc->ToString());
+        update->set_needs_full_report(true);
+        continue;
+      }
+    }
+
     // 5. Tombstone a replica that is no longer part of the Raft config (and
     // not already tombstoned or deleted outright).
     //
@@ -3248,7 +3482,7 @@ Status CatalogManager::ProcessTabletReport(
       const string delete_msg = report_opid_index == consensus::kInvalidOpIdIndex ?
           "Replica has no consensus available" :
           Substitute("Replica with old config index $0", report_opid_index);
-      rpcs.emplace_back(new AsyncDeleteReplica(
+      rpcs->emplace_back(new AsyncDeleteReplica(
           master_, ts_desc->permanent_uuid(), table, tablet_id,
           TABLET_DATA_TOMBSTONED, prev_opid_index,
           Substitute("$0 (current committed config index is $1)",
@@ -3360,7 +3594,7 @@ Status CatalogManager::ProcessTabletReport(
           for (const auto& p : prev_cstate.committed_config().peers()) {
             const string& peer_uuid = p.permanent_uuid();
             if (!ContainsKey(current_member_uuids, peer_uuid)) {
-              rpcs.emplace_back(new AsyncDeleteReplica(
+              rpcs->emplace_back(new AsyncDeleteReplica(
                   master_, peer_uuid, table, tablet_id,
                   TABLET_DATA_TOMBSTONED, prev_cstate.committed_config().opid_index(),
                   Substitute("TS $0 not found in new config with opid_index $1",
@@ -3375,7 +3609,7 @@ Status CatalogManager::ProcessTabletReport(
         // committed config's opid_index.
         if (FLAGS_master_add_server_when_underreplicated &&
             CountVoters(cstate.committed_config()) < table->metadata().state().pb.num_replicas()) {
-          rpcs.emplace_back(new AsyncAddServerTask(master_, tablet, cstate, &rng_));
+          rpcs->emplace_back(new AsyncAddServerTask(master_, tablet, cstate, &rng_));
         }
       }
     }
@@ -3398,15 +3632,150 @@ Status CatalogManager::ProcessTabletReport(
       // It's possible that the tablet being reported is a laggy replica, and
       // in fact the leader has already received an AlterTable RPC. That's OK,
       // though -- it'll safely ignore it if we send another.
-      rpcs.emplace_back(new AsyncAlterTable(master_, tablet));
+      rpcs->emplace_back(new AsyncAlterTable(master_, tablet));
     }
 
     // 9. If the tablet was mutated, add it to the tablets to be re-persisted.
     //
     // Done here and not on a per-mutation basis to avoid duplicate entries.
     if (tablet_was_mutated) {
-      mutated_tablets.push_back(tablet);
+      mutated_tablets->push_back(tablet);
+    }
+  }
+}
+
+Status CatalogManager::ProcessTabletReport(
+    TSDescriptor* ts_desc,
+    const TabletReportPB& full_report,
+    TabletReportUpdatesPB* full_report_update,
+    RpcContext* rpc) {
+  int num_tablets = full_report.updated_tablets_size();
+  TRACE_EVENT2("master", "ProcessTabletReport",
+               "requestor", rpc->requestor_string(),
+               "num_tablets", num_tablets);
+  TRACE_COUNTER_INCREMENT("reported_tablets", num_tablets);
+
+  leader_lock_.AssertAcquiredForReading();
+
+  VLOG(2) << Substitute("Received tablet report from $0:\n$1",
+                        RequestorString(rpc), SecureDebugString(full_report));
+
+  // TODO(todd): on a full tablet report, we may want to iterate over the
+  // tablets we think the server should have, compare vs the ones being
+  // reported, and somehow mark any that have been "lost" (eg somehow the
+  // tablet metadata got corrupted or something).
+
+  // Maps a tablet ID to its corresponding tablet report (owned by 'full_report').
+  unordered_map<string, const ReportedTabletPB*> reports;
+
+  // Maps a tablet ID to its corresponding tablet report update (owned by
+  // 'full_report_update').
+  unordered_map<string, ReportedTabletUpdatesPB*> updates;
+
+  // Maps a tablet ID to its corresponding TabletInfo.
+  unordered_map<string, scoped_refptr<TabletInfo>> tablet_infos;
+
+  // Keeps track of all RPCs that should be sent when we're done.
+  vector<unique_ptr<RetryingTSRpcTask>> rpcs;
+
+  // Locks the referenced tables (for READ) and tablets (for WRITE).
+  //
+  // We must hold the tablets' locks while writing to the catalog table, and
+  // since they're locked for WRITE, we have to lock them en masse in order to
+  // avoid deadlocking.
+  //
+  // We have more freedom with the table locks: we could acquire them en masse,
+  // or we could acquire, use, and release them one at a time. So why do we
+  // acquire en masse? Because it reduces the overall number of lock
+  // acquisitions by reusing locks for tablets belonging to the same table, and
+  // although one-at-a-time acquisition would reduce table lock contention when
+  // writing, table writes are very rare events.
+  TableMetadataGroupLock tables_lock(LockMode::RELEASED);
+  TabletMetadataGroupLock tablets_lock(LockMode::RELEASED);
+
+  // 1. Set up local state.
+  full_report_update->mutable_tablets()->Reserve(num_tablets);
+  {
+    // We only need to acquire lock_ for the tablet_map_ access, but since it's
+    // acquired exclusively so rarely, it's probably cheaper to acquire and
+    // hold it for all tablets here than to acquire/release it for each tablet.
+    shared_lock<LockType> l(lock_);
+    for (const ReportedTabletPB& report : full_report.updated_tablets()) {
+      const string& tablet_id = report.tablet_id();
+
+      // 1a. Prepare an update entry for this tablet. Every tablet in the
+      // report gets one, even if there's no change to it.
+      ReportedTabletUpdatesPB* update = full_report_update->add_tablets();
+      update->set_tablet_id(tablet_id);
+
+      // 1b. Find the tablet, deleting/skipping it if it can't be found.
+      scoped_refptr<TabletInfo> tablet = FindPtrOrNull(tablet_map_, tablet_id);
+      if (!tablet) {
+        // It'd be unsafe to ask the tserver to delete this tablet without first
+        // replicating something to our followers (i.e. to guarantee that we're
+        // the leader). For example, if we were a rogue master, we might be
+        // deleting a tablet created by a new master accidentally. But masters
+        // retain metadata for deleted tablets forever, so a tablet can only be
+        // truly unknown in the event of a serious misconfiguration, such as a
+        // tserver heartbeating to the wrong cluster. Therefore, it should be
+        // reasonable to ignore it and wait for an operator fix the situation.
+        LOG(WARNING) << "Ignoring report from unknown tablet " << tablet_id;
+        continue;
+      }
+
+      // 1c. Found the tablet, update local state. If multiple tablets with the
+      // same ID are in the report, all but the last one will be ignored.
+      reports[tablet_id] = &report;
+      updates[tablet_id] = update;
+      tablet_infos[tablet_id] = tablet;
+      tables_lock.AddInfo(*tablet->table().get());
+      tablets_lock.AddMutableInfo(tablet.get());
+    }
+  }
+
+  // 2. Lock the affected tables and tablets.
+  tables_lock.Lock(LockMode::READ);
+  tablets_lock.Lock(LockMode::WRITE);
+
+  // 3. Process each tablet. This may not be in the order that the tablets
+  // appear in 'full_report', but that has no bearing on correctness.
+  //
+  // The tablets are independent of each other, so large reports (e.g. the full
+  // reports following a master failover) are split into batches which are
+  // processed in parallel.
+  vector<vector<ReportedTablet>> batches(1);
+  for (const auto& e : tablet_infos) {
+    if (batches.back().size() >= std::max<size_t>(1, FLAGS_tablet_report_batch_size)) {
+      batches.emplace_back();
+    }
+    batches.back().push_back({ e.second, FindOrDie(reports, e.first), FindOrDie(updates, e.first) });
+  }
+  vector<vector<unique_ptr<RetryingTSRpcTask>>> batch_rpcs(batches.size());
+  vector<vector<scoped_refptr<TabletInfo>>> batch_mutated_tablets(batches.size());
+  if (batches.size() == 1) {
+    ProcessTabletReportBatch(ts_desc, batches[0], &batch_rpcs[0], &batch_mutated_tablets[0]);
+  } else {
+    CountDownLatch latch(batches.size());
+    for (size_t i = 0; i < batches.size(); i++) {
+      auto process_batch = [&, i]() {
+        ProcessTabletReportBatch(ts_desc, batches[i], &batch_rpcs[i], &batch_mutated_tablets[i]);
+        latch.CountDown();
+      };
+      Status s = tablet_report_pool_->SubmitFunc(process_batch);
+      if (PREDICT_FALSE(!s.ok())) {
+        // The pool is shutting down: process the batch in this thread.
+        process_batch();
+      }
+    }
+    latch.Wait();
+  }
+  vector<scoped_refptr<TabletInfo>> mutated_tablets;
+  for (size_t i = 0; i < batches.size(); i++) {
+    for (auto& rpc : batch_rpcs[i]) {
+      rpcs.emplace_back(std::move(rpc));
     }
+    mutated_tablets.insert(mutated_tablets.end(),
+                           batch_mutated_tablets[i].begin(), batch_mutated_tablets[i].end());
   }
 
   // 10. Unlock the tables; we no longer need to access their state.
@@ -3431,6 +3800,7 @@ Status CatalogManager::ProcessTabletReport(
 
   // 12. Publish the in-memory tablet mutations and release the locks.
   tablets_lock.Commit();
+  InvalidateTabletLocations();
 
   // 13. Process all tablet schema version changes.
   //
@@ -3547,6 +3917,201 @@ void CatalogManager::ExtractTabletsToProcess(
 //   2) Try to write it to the system table.
 //   3) Pass it back to the TokenSigner on success.
 //   4) Check and switch TokenSigner to the new key if it's time to do so.
+void CatalogManager::RunRebalancer() {
+  leader_lock_.AssertAcquiredForReading();
+  if (!FLAGS_enable_rebalancer) {
+    return;
+  }
+  const MonoTime now = MonoTime::Now();
+  unordered_set<string> moving_tablet_ids;
+  {
+    std::lock_guard<simple_spinlock> l(rebalancer_lock_);
+    if (rebalancer_status_.last_pass.Initialized() &&
+        now - rebalancer_status_.last_pass <
+        MonoDelta::FromMilliseconds(FLAGS_rebalancer_interval_ms)) {
+      return;
+    }
+    rebalancer_status_.last_pass = now;
+    for (const auto& e : pending_replica_moves_) {
+      moving_tablet_ids.insert(e.first);
+    }
+  }
+
+  // 1. Take a snapshot of the live tablet servers and of the configs of the
+  //    running tablets. Only the tablets which are fully replicated on live
+  //    servers, have a leader, and have no config change in progress may
+  //    move.
+  TSDescriptorVector ts_descs;
+  master_->ts_manager()->GetAllLiveDescriptors(&ts_descs);
+  vector<string> ts_uuids;
+  unordered_set<string> live_uuids;
+  for (const auto& ts_desc : ts_descs) {
+    ts_uuids.push_back(ts_desc->permanent_uuid());
+    live_uuids.insert(ts_desc->permanent_uuid());
+  }
+
+  vector<scoped_refptr<TableInfo>> tables;
+  {
+    shared_lock<LockType> l(lock_);
+    AppendValuesFromMap(table_ids_map_, &tables);
+  }
+  unordered_map<string, pair<scoped_refptr<TabletInfo>, ConsensusStatePB>> tablets;
+  vector<TabletPlacement> placements;
+  for (const auto& table : tables) {
+    int num_replicas;
+    {
+      TableMetadataLock l(table.get(), LockMode::READ);
+      if (!l.data().is_running()) {
+        continue;
+      }
+      num_replicas = l.data().pb.num_replicas();
+    }
+    vector<scoped_refptr<TabletInfo>> table_tablets;
+    table->GetAllTablets(&table_tablets);
+    for (const auto& tablet : table_tablets) {
+      ConsensusStatePB cstate;
+      {
+        TabletMetadataLock l(tablet.get(), LockMode::READ);
+        if (!l.data().is_running() || !l.data().pb.has_consensus_state()) {
+          continue;
+        }
+        cstate = l.data().pb.consensus_state();
+      }
+      if (!ContainsKey(moving_tablet_ids, tablet->id())) {
+        const auto& config = cstate.committed_config();
+        bool movable = !cstate.has_pending_config() &&
+            !cstate.leader_uuid().empty() &&
+            config.peers_size() == num_replicas &&
+            CountVoters(config) == num_replicas;
+        TabletPlacement placement;
+        for (const auto& peer : config.peers()) {
+          movable &= ContainsKey(live_uuids, peer.permanent_uuid());
+          placement.voter_uuids.push_back(peer.permanent_uuid());
+        }
+        if (!movable) {
+          continue;
+        }
+        placement.tablet_id = tablet->id();
+        placement.table_id = table->id();
+        placement.leader_uuid = cstate.leader_uuid();
+        placements.emplace_back(std::move(placement));
+      }
+      tablets.emplace(tablet->id(), std::make_pair(tablet, std::move(cstate)));
+    }
+  }
+
+  vector<unique_ptr<RetryingTSRpcTask>> rpcs;
+  std::unique_lock<simple_spinlock> l(rebalancer_lock_);
+
+  // 2. Advance the replica moves in progress: once the replica was added to
+  //    the destination, step down the source if it's the leader, then remove
+  //    the source. The master tombstones the removed replica on its own.
+  const MonoDelta move_timeout = MonoDelta::FromMilliseconds(FLAGS_rebalancer_move_timeout_ms);
+  for (auto it = pending_replica_moves_.begin(); it != pending_replica_moves_.end();) {
+    PendingReplicaMove* pending = &it->second;
+    const RebalancingMove& move = pending->move;
+    const auto* tablet_and_cstate = FindOrNull(tablets, move.tablet_id);
+    if (!tablet_and_cstate) {
+      LOG(INFO) << "Rebalancer abandoning move of deleted tablet: " << move.ToString();
+      rebalancer_status_.replica_moves_abandoned++;
+      it = pending_replica_moves_.erase(it);
+      continue;
+    }
+    const scoped_refptr<TabletInfo>& tablet = tablet_and_cstate->first;
+    const ConsensusStatePB& cstate = tablet_and_cstate->second;
+    const auto& config = cstate.committed_config();
+    if (!IsRaftConfigMember(move.from_uuid, config)) {
+      LOG(INFO) << "Rebalancer completed: " << move.ToString();
+      rebalancer_status_.replica_moves_completed++;
+      it = pending_replica_moves_.erase(it);
+      continue;
+    }
+    if (now - pending->start > move_timeout) {
+      LOG(WARNING) << "Rebalancer abandoning move after " << move_timeout.ToString()
+                   << ": " << move.ToString();
+      rebalancer_status_.replica_moves_abandoned++;
+      it = pending_replica_moves_.erase(it);
+      continue;
+    }
+    if (!cstate.has_pending_config()) {
+      if (!IsRaftConfigMember(move.to_uuid, config)) {
+        if (pending->add_sent_opid_index < config.opid_index()) {
+          rpcs.emplace_back(new AsyncChangeConfigTask(
+              master_, tablet, consensus::ADD_SERVER, move.to_uuid, config.opid_index()));
+          pending->add_sent_opid_index = config.opid_index();
+        }
+      } else if (IsRaftConfigVoter(move.to_uuid, config)) {
+        if (cstate.leader_uuid() == move.from_uuid) {
+          rpcs.emplace_back(new AsyncLeaderStepDownTask(master_, tablet, move.from_uuid));
+          rebalancer_status_.leader_step_downs++;
+        } else if (!cstate.leader_uuid().empty() &&
+                   pending->remove_sent_opid_index < config.opid_index()) {
+          rpcs.emplace_back(new AsyncChangeConfigTask(
+              master_, tablet, consensus::REMOVE_SERVER, move.from_uuid, config.opid_index()));
+          pending->remove_sent_opid_index = config.opid_index();
+        }
+      }
+    }
+    ++it;
+  }
+
+  // 3. Plan and start new moves, up to the limits.
+  const int max_replica_moves = std::max<int>(
+      0, FLAGS_rebalancer_max_concurrent_replica_moves - pending_replica_moves_.size());
+  vector<RebalancingMove> moves;
+  PlanRebalancingMoves(ts_uuids, placements, max_replica_moves,
+                       FLAGS_rebalancer_max_leader_moves_per_pass, &moves);
+  for (auto& move : moves) {
+    LOG(INFO) << "Rebalancer starting: " << move.ToString();
+    const auto& tablet_and_cstate = FindOrDie(tablets, move.tablet_id);
+    const scoped_refptr<TabletInfo>& tablet = tablet_and_cstate.first;
+    if (move.type == RebalancingMove::LEADER_STEP_DOWN) {
+      rpcs.emplace_back(new AsyncLeaderStepDownTask(master_, tablet, move.from_uuid));
+      rebalancer_status_.leader_step_downs++;
+      continue;
+    }
+    const int64_t opid_index = tablet_and_cstate.second.committed_config().opid_index();
+    rpcs.emplace_back(new AsyncChangeConfigTask(
+        master_, tablet, consensus::ADD_SERVER, move.to_uuid, opid_index));
+    PendingReplicaMove pending;
+    pending.move = std::move(move);
+    pending.start = now;
+    pending.add_sent_opid_index = opid_index;
+    pending.remove_sent_opid_index = consensus::kInvalidOpIdIndex;
+    InsertOrDie(&pending_replica_moves_, pending.move.tablet_id, std::move(pending));
+    rebalancer_status_.replica_moves_started++;
+  }
+
+  // 4. Record the balance of the tablets which aren't moving, for the web UI.
+  rebalancer_status_.replicas_per_ts.clear();
+  rebalancer_status_.leaders_per_ts.clear();
+  for (const auto& uuid : ts_uuids) {
+    rebalancer_status_.replicas_per_ts[uuid] = 0;
+    rebalancer_status_.leaders_per_ts[uuid] = 0;
+  }
+  for (const auto& placement : placements) {
+    for (const auto& uuid : placement.voter_uuids) {
+      rebalancer_status_.replicas_per_ts[uuid]++;
+    }
+    rebalancer_status_.leaders_per_ts[placement.leader_uuid]++;
+  }
+  l.unlock();
+
+  for (auto& rpc : rpcs) {
+    rpc->table()->AddTask(rpc.get());
+    WARN_NOT_OK(rpc->Run(), Substitute("Failed to send $0", rpc->description()));
+    rpc.release();
+  }
+}
+
+void CatalogManager::GetRebalancerStatus(RebalancerStatus* status) const {
+  std::lock_guard<simple_spinlock> l(rebalancer_lock_);
+  *status = rebalancer_status_;
+  for (const auto& e : pending_replica_moves_) {
+    status->pending_replica_moves.push_back(e.second.move);
+  }
+}
+
 Status CatalogManager::TryGenerateNewTskUnlocked() {
   TokenSigner* signer = master_->token_signer();
   unique_ptr<security::TokenSigningPrivateKey> tsk;
@@ -3764,6 +4329,7 @@ Status CatalogManager::ProcessPendingAssignments(
   // Expose tablet metadata changes before the new tablets themselves.
   lock_out.Commit();
   lock_in.Commit();
+  InvalidateTabletLocations();
 
   for (const auto& t : deferred.tablets_to_add) {
     // We can't reuse the WRITE tablet locks from committer_out for this
@@ -3884,6 +4450,37 @@ void CatalogManager::SelectReplicas(const TSDescriptorVector& ts_descs,
   }
 }
 
+namespace {
+
+// Sets the recent RPC queue times of the tablet servers of the replicas of
+// 'locs_pb', as derived from their heartbeats. They change with every
+// heartbeat, so they're set after the locations are cached. 'queue_times'
+// memoizes the queue times of the servers already looked up, or -1 for
+// servers which didn't report their load.
+void SetRecentRpcQueueTimes(TSManager* ts_manager,
+                            TabletLocationsPB* locs_pb,
+                            unordered_map<string, int64_t>* queue_times) {
+  for (auto& replica_pb : *locs_pb->mutable_replicas()) {
+    TSInfoPB* tsinfo_pb = replica_pb.mutable_ts_info();
+    auto inserted = queue_times->emplace(tsinfo_pb->permanent_uuid(), -1);
+    int64_t* queue_time_us = &inserted.first->second;
+    if (inserted.second) {
+      shared_ptr<TSDescriptor> ts_desc;
+      if (ts_manager->LookupTSByUUID(tsinfo_pb->permanent_uuid(), &ts_desc)) {
+        TSDescriptor::Load load = ts_desc->load();
+        if (load.reported) {
+          *queue_time_us = static_cast<int64_t>(load.rpc_queue_time_us);
+        }
+      }
+    }
+    if (*queue_time_us >= 0) {
+      tsinfo_pb->set_recent_rpc_queue_time_us(*queue_time_us);
+    }
+  }
+}
+
+} // anonymous namespace
+
 Status CatalogManager::BuildLocationsForTablet(const scoped_refptr<TabletInfo>& tablet,
                                                TabletLocationsPB* locs_pb) {
   TabletMetadataLock l_tablet(tablet.get(), LockMode::READ);
@@ -3931,6 +4528,15 @@ Status CatalogManager::BuildLocationsForTablet(const scoped_refptr<TabletInfo>&
   return Status::OK();
 }
 
+int64_t CatalogManager::tablet_locations_version() const {
+  // Both counters only grow, so their sum changes whenever either does.
+  return tablet_mutations_.load() + master_->ts_manager()->registration_version();
+}
+
+void CatalogManager::InvalidateTabletLocations() {
+  tablet_mutations_++;
+}
+
 Status CatalogManager::GetTabletLocations(const string& tablet_id,
                                           TabletLocationsPB* locs_pb) {
   leader_lock_.AssertAcquiredForReading();
@@ -3945,7 +4551,10 @@ Status CatalogManager::GetTabletLocations(const string& tablet_id,
     }
   }
 
-  return BuildLocationsForTablet(tablet_info, locs_pb);
+  RETURN_NOT_OK(BuildLocationsForTablet(tablet_info, locs_pb));
+  unordered_map<string, int64_t> queue_times;
+  SetRecentRpcQueueTimes(master_->ts_manager(), locs_pb, &queue_times);
+  return Status::OK();
 }
 
 Status CatalogManager::GetTableLocations(const GetTableLocationsRequestPB* req,
@@ -3979,9 +4588,21 @@ Status CatalogManager::GetTableLocations(const GetTableLocationsRequestPB* req,
   vector<scoped_refptr<TabletInfo>> tablets_in_range;
   table->GetTabletsInRange(req, &tablets_in_range);
 
+  // The version must be read before building any locations, so that the
+  // locations built from state which is being mutated are never cached at
+  // the version following the mutation.
+  const int64_t locations_version = tablet_locations_version();
+  unordered_map<string, int64_t> queue_times;
   for (const auto& tablet : tablets_in_range) {
-    Status s = BuildLocationsForTablet(tablet, resp->add_tablet_locations());
+    TabletLocationsPB* locs_pb = resp->add_tablet_locations();
+    if (table->GetCachedTabletLocations(tablet->id(), locations_version, locs_pb)) {
+      SetRecentRpcQueueTimes(master_->ts_manager(), locs_pb, &queue_times);
+      continue;
+    }
+    Status s = BuildLocationsForTablet(tablet, locs_pb);
     if (s.ok()) {
+      table->CacheTabletLocations(tablet->id(), locations_version, *locs_pb);
+      SetRecentRpcQueueTimes(master_->ts_manager(), locs_pb, &queue_times);
       continue;
     } else if (s.IsNotFound()) {
       // The tablet has been deleted; force the client to retry. This is a
@@ -4280,7 +4901,10 @@ void PersistentTabletInfo::set_state(SysTabletsEntryPB::State state, const strin
 // TableInfo
 ////////////////////////////////////////////////////////////
 
-TableInfo::TableInfo(string table_id) : table_id_(std::move(table_id)) {}
+TableInfo::TableInfo(string table_id)
+    : table_id_(std::move(table_id)),
+      locations_cache_version_(-1) {
+}
 
 TableInfo::~TableInfo() {
 }
@@ -4349,6 +4973,36 @@ void TableInfo::GetTabletsInRange(const GetTableLocationsRequestPB* req,
   }
 }
 
+bool TableInfo::GetCachedTabletLocations(const string& tablet_id,
+                                         int64_t version,
+                                         TabletLocationsPB* locs_pb) const {
+  std::lock_guard<simple_spinlock> l(locations_cache_lock_);
+  if (locations_cache_version_ != version) {
+    return false;
+  }
+  const TabletLocationsPB* cached = FindOrNull(locations_cache_, tablet_id);
+  if (!cached) {
+    return false;
+  }
+  locs_pb->CopyFrom(*cached);
+  return true;
+}
+
+void TableInfo::CacheTabletLocations(const string& tablet_id,
+                                     int64_t version,
+                                     const TabletLocationsPB& locs_pb) {
+  std::lock_guard<simple_spinlock> l(locations_cache_lock_);
+  if (version < locations_cache_version_) {
+    // The locations are already stale.
+    return;
+  }
+  if (version > locations_cache_version_) {
+    locations_cache_.clear();
+    locations_cache_version_ = version;
+  }
+  locations_cache_[tablet_id] = locs_pb;
+}
+
 bool TableInfo::IsAlterInProgress(uint32_t version) const {
   shared_lock<rw_spinlock> l(lock_);
   auto it = schema_version_counts_.begin();
@@ -17,6 +17,7 @@
 #ifndef KUDU_MASTER_CATALOG_MANAGER_H
 #define KUDU_MASTER_CATALOG_MANAGER_H
 
+#include <atomic>
 #include <cstdint>
 #include <functional>
 #include <iosfwd>
@@ -39,6 +40,8 @@
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/master/master.pb.h"
+#include "kudu/master/rebalancer.h"
+#include "kudu/master/ts_descriptor.h"
 #include "kudu/master/ts_manager.h"
 #include "kudu/tserver/tablet_replica_lookup.h"
 #include "kudu/tserver/tserver.pb.h"
@@ -87,6 +90,7 @@ namespace master {
 
 class CatalogManagerBgTasks;
 class Master;
+class RetryingTSRpcTask;
 class SysCatalogTable;
 class TSDescriptor;
 class TableInfo;
@@ -284,6 +288,19 @@ class TableInfo : public RefCountedThreadSafe<TableInfo> {
     return tablet_map_.size();
   }
 
+  // Copies the cached locations of tablet 'tablet_id' into 'locs_pb' and
+  // returns true if they were built at tablet locations version 'version'.
+  // See CatalogManager::tablet_locations_version().
+  bool GetCachedTabletLocations(const std::string& tablet_id,
+                                int64_t version,
+                                TabletLocationsPB* locs_pb) const;
+
+  // Caches the locations of tablet 'tablet_id', built at tablet locations
+  // version 'version'.
+  void CacheTabletLocations(const std::string& tablet_id,
+                            int64_t version,
+                            const TabletLocationsPB& locs_pb);
+
  private:
   friend class RefCountedThreadSafe<TableInfo>;
   friend class TabletInfo;
@@ -322,6 +339,15 @@ class TableInfo : public RefCountedThreadSafe<TableInfo> {
   // tablet_map_ and summing up the tablets' reported schema versions.
   std::map<int64_t, int64_t> schema_version_counts_;
 
+  // The locations of the tablets returned by GetTableLocations RPCs, so that
+  // they needn't be built again for every RPC, e.g. when many clients
+  // reconnect at once. All of them were built at tablet locations version
+  // 'locations_cache_version_', and the cache is cleared when it changes.
+  // Protected by 'locations_cache_lock_'.
+  std::unordered_map<std::string, TabletLocationsPB> locations_cache_;
+  int64_t locations_cache_version_;
+  mutable simple_spinlock locations_cache_lock_;
+
   DISALLOW_COPY_AND_ASSIGN(TableInfo);
 };
 
@@ -588,6 +614,11 @@ class CatalogManager : public tserver::TabletReplicaLookupIf {
   // NOTE: This should only be used by tests or web-ui
   Status GetAllTables(std::vector<scoped_refptr<TableInfo>>* tables);
 
+  // Retrieve the progress of the rebalancer.
+  //
+  // NOTE: This should only be used by tests or web-ui
+  void GetRebalancerStatus(RebalancerStatus* status) const;
+
   // Check if a table exists by name, setting 'exist' appropriately. May fail
   // if the catalog manager is not yet running. Caller must hold leader_lock_.
   //
@@ -723,6 +754,14 @@ class CatalogManager : public tserver::TabletReplicaLookupIf {
   Status BuildLocationsForTablet(const scoped_refptr<TabletInfo>& tablet,
                                  TabletLocationsPB* locs_pb);
 
+  // Returns the version of the locations of all tablets: it changes whenever
+  // the state of a tablet or the addresses of a tablet server may have changed.
+  int64_t tablet_locations_version() const;
+
+  // Invalidates the cached locations of all tablets. Must be called after
+  // committing mutations of tablet metadata.
+  void InvalidateTabletLocations();
+
   // Looks up the table and locks it with the provided lock mode. If the table
   // does not exist, the lock is not acquired and the table is not modified.
   Status FindAndLockTable(const TableIdentifierPB& table_identifier,
@@ -730,9 +769,34 @@ class CatalogManager : public tserver::TabletReplicaLookupIf {
                           scoped_refptr<TableInfo>* table_info,
                           TableMetadataLock* table_lock) WARN_UNUSED_RESULT;
 
+  // A tablet of a tablet report.
+  struct ReportedTablet {
+    scoped_refptr<TabletInfo> tablet;
+
+    // The report of the tablet, and its update in the response.
+    const ReportedTabletPB* report;
+    ReportedTabletUpdatesPB* update;
+  };
+
+  // Processes the tablets of 'batch', reported by 'ts_desc', as part of
+  // ProcessTabletReport(): appends the RPCs to send to 'rpcs', and the tablets
+  // whose metadata changed to 'mutated_tablets'. The tables and tablets of
+  // 'batch' must be locked for READ and WRITE respectively.
+  void ProcessTabletReportBatch(
+      TSDescriptor* ts_desc,
+      const std::vector<ReportedTablet>& batch,
+      std::vector<std::unique_ptr<RetryingTSRpcTask>>* rpcs,
+      std::vector<scoped_refptr<TabletInfo>>* mutated_tablets);
+
   // Extract the set of tablets that must be processed because not running yet.
   void ExtractTabletsToProcess(std::vector<scoped_refptr<TabletInfo>>* tablets_to_process);
 
+  // If --enable_rebalancer is set and the last pass was at least
+  // --rebalancer_interval_ms ago, advances the replica moves in progress and
+  // starts moves of leaders and replicas which balance the tablet servers.
+  // Caller must hold leader_lock_.
+  void RunRebalancer();
+
   // Check if it's time to generate a new Token Signing Key for TokenSigner.
   // If so, generate one and persist it into the system table. After that,
   // push it into the TokenSigner's key queue.
@@ -850,6 +914,9 @@ class CatalogManager : public tserver::TabletReplicaLookupIf {
   // Tablet maps: tablet-id -> TabletInfo
   TabletInfoMap tablet_map_;
 
+  // Incremented by InvalidateTabletLocations(). See tablet_locations_version().
+  std::atomic<int64_t> tablet_mutations_;
+
   // Names of tables that are currently reserved by CreateTable() or
   // AlterTable().
   //
@@ -872,6 +939,26 @@ class CatalogManager : public tserver::TabletReplicaLookupIf {
 
   gscoped_ptr<SysCatalogTable> sys_catalog_;
 
+  // A replica move of the rebalancer in progress.
+  struct PendingReplicaMove {
+    RebalancingMove move;
+    MonoTime start;
+
+    // The opid_index of the config the last ADD_SERVER and REMOVE_SERVER
+    // config changes were sent for, so as to send them once per config.
+    int64_t add_sent_opid_index;
+    int64_t remove_sent_opid_index;
+  };
+
+  // Lock protecting pending_replica_moves_ and rebalancer_status_.
+  mutable simple_spinlock rebalancer_lock_;
+
+  // Tablet ID -> the replica move of the tablet in progress.
+  std::map<std::string, PendingReplicaMove> pending_replica_moves_;
+
+  // The progress of the rebalancer, but for the pending moves.
+  RebalancerStatus rebalancer_status_;
+
   // Background thread, used to execute the catalog manager tasks
   // like the assignment and cleaner
   friend class CatalogManagerBgTasks;
@@ -891,6 +978,9 @@ class CatalogManager : public tserver::TabletReplicaLookupIf {
   // Singleton pool that serializes invocations of ElectedAsLeaderCb().
   gscoped_ptr<ThreadPool> leader_election_pool_;
 
+  // Pool processing the batches of large tablet reports in parallel.
+  gscoped_ptr<ThreadPool> tablet_report_pool_;
+
   // This field is updated when a node becomes leader master,
   // waits for all outstanding uncommitted metadata (table and tablet metadata)
   // in the sys catalog to commit, and then reads that metadata into in-memory
@@ -917,6 +1007,14 @@ class CatalogManager : public tserver::TabletReplicaLookupIf {
   DISALLOW_COPY_AND_ASSIGN(CatalogManager);
 };
 
+// Returns the load of a tablet server for the placement of a new tablet
+// replica, in units of replicas. 'num_replicas' is the number of replicas the
+// server hosts or was recently chosen for, 'load' is the load it reported,
+// and 'other_load' the load reported by the server it is compared to.
+double ReplicaPlacementLoad(double num_replicas,
+                            const TSDescriptor::Load& load,
+                            const TSDescriptor::Load& other_load);
+
 } // namespace master
 } // namespace kudu
 #endif /* KUDU_MASTER_CATALOG_MANAGER_H */
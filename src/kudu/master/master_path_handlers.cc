@@ -20,6 +20,7 @@
 #include <algorithm>
 #include <array>
 #include <cstdint>
+#include <functional>
 #include <iosfwd>
 #include <map>
 #include <memory>
@@ -27,10 +28,12 @@
 #include <string>
 #include <type_traits>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
 #include <boost/bind.hpp> // IWYU pragma: keep
+#include <gflags/gflags_declare.h>
 #include <glog/logging.h>
 
 #include "kudu/common/common.pb.h"
@@ -51,11 +54,13 @@
 #include "kudu/master/master.h"
 #include "kudu/master/master.pb.h"
 #include "kudu/master/master_options.h"
+#include "kudu/master/rebalancer.h"
 #include "kudu/master/sys_catalog.h"
 #include "kudu/master/ts_descriptor.h"
 #include "kudu/master/ts_manager.h"
 #include "kudu/server/monitored_task.h"
 #include "kudu/server/webui_util.h"
+#include "kudu/tablet/metadata.pb.h"
 #include "kudu/util/cow_object.h"
 #include "kudu/util/easy_json.h"
 #include "kudu/util/jsonwriter.h"
@@ -67,6 +72,8 @@
 #include "kudu/util/url-coding.h"
 #include "kudu/util/web_callback_registry.h"
 
+DECLARE_bool(enable_rebalancer);
+
 namespace kudu {
 
 using consensus::ConsensusStatePB;
@@ -77,6 +84,7 @@ using std::ostringstream;
 using std::pair;
 using std::shared_ptr;
 using std::string;
+using std::unordered_set;
 using std::vector;
 using strings::Substitute;
 
@@ -188,6 +196,50 @@ void MasterPathHandlers::HandleCatalogManager(const Webserver::WebRequest& req,
   (*output).Set<int64_t>("num_tables", num_running_tables);
 }
 
+void MasterPathHandlers::HandleRebalancer(const Webserver::WebRequest& req,
+                                          Webserver::WebResponse* resp) {
+  EasyJson* output = resp->output;
+  CatalogManager::ScopedLeaderSharedLock l(master_->catalog_manager());
+  if (!l.catalog_status().ok()) {
+    (*output)["error"] = Substitute("Master is not ready: $0",  l.catalog_status().ToString());
+    return;
+  }
+  if (!l.leader_status().ok()) {
+    // Track redirects to prevent a redirect loop.
+    int redirects = ExtractRedirectsFromRequest(req);
+    SetupLeaderMasterRedirect("rebalancer?", redirects, output);
+    return;
+  }
+
+  RebalancerStatus status;
+  master_->catalog_manager()->GetRebalancerStatus(&status);
+  (*output)["enabled"] = FLAGS_enable_rebalancer;
+  if (status.last_pass.Initialized()) {
+    (*output)["time_since_last_pass"] = StringPrintf(
+        "%.1fs", (MonoTime::Now() - status.last_pass).ToSeconds());
+  }
+  output->Set<int64_t>("leader_step_downs", status.leader_step_downs);
+  output->Set<int64_t>("replica_moves_started", status.replica_moves_started);
+  output->Set<int64_t>("replica_moves_completed", status.replica_moves_completed);
+  output->Set<int64_t>("replica_moves_abandoned", status.replica_moves_abandoned);
+
+  EasyJson moves_json = output->Set("pending_replica_moves", EasyJson::kArray);
+  for (const auto& move : status.pending_replica_moves) {
+    EasyJson move_json = moves_json.PushBack(EasyJson::kObject);
+    move_json["tablet_id"] = move.tablet_id;
+    move_json["from_uuid"] = move.from_uuid;
+    move_json["to_uuid"] = move.to_uuid;
+  }
+
+  EasyJson tservers_json = output->Set("tservers", EasyJson::kArray);
+  for (const auto& e : status.replicas_per_ts) {
+    EasyJson ts_json = tservers_json.PushBack(EasyJson::kObject);
+    ts_json["uuid"] = e.first;
+    ts_json.Set<int64_t>("replicas", e.second);
+    ts_json.Set<int64_t>("leaders", FindWithDefault(status.leaders_per_ts, e.first, 0));
+  }
+}
+
 namespace {
 
 
@@ -368,6 +420,45 @@ void MasterPathHandlers::HandleTablePage(const Webserver::WebRequest& req,
     state_json["percentage"] = tablets.empty() ? "0.0" : StringPrintf("%.2f", percentage);
   }
 
+  // Roll up the hottest tablets and keys of the table, as reported by the
+  // tablet servers in their heartbeats.
+  {
+    static const int kMaxHotTablets = 10;
+    static const int kMaxHotKeys = 20;
+    unordered_set<string> tablet_ids;
+    for (const auto& tablet : tablets) {
+      tablet_ids.insert(tablet->id());
+    }
+    vector<tablet::TabletHotKeysPB> hot_tablets;
+    master_->ts_manager()->GetHotTablets(tablet_ids, &hot_tablets);
+    int64_t table_ops = 0;
+    vector<pair<int64_t, string>> hot_keys;
+    EasyJson hot_tablets_json = output->Set("hot_tablets", EasyJson::kArray);
+    for (int i = 0; i < hot_tablets.size(); i++) {
+      const auto& hot_tablet = hot_tablets[i];
+      table_ops += hot_tablet.estimated_ops();
+      if (i < kMaxHotTablets) {
+        EasyJson tablet_json = hot_tablets_json.PushBack(EasyJson::kObject);
+        tablet_json["id"] = hot_tablet.tablet_id();
+        tablet_json["estimated_ops"] = hot_tablet.estimated_ops();
+      }
+      for (const auto& key : hot_tablet.keys()) {
+        hot_keys.emplace_back(key.estimated_ops(),
+                              schema.DebugEncodedRowKey(key.encoded_key(), Schema::START_KEY));
+      }
+    }
+    (*output)["hot_tablets_estimated_ops"] = table_ops;
+    (*output)["has_no_hot_tablets"] = hot_tablets.empty();
+    (*output)["has_no_hot_keys"] = hot_keys.empty();
+    std::sort(hot_keys.begin(), hot_keys.end(), std::greater<pair<int64_t, string>>());
+    EasyJson hot_keys_json = output->Set("hot_keys", EasyJson::kArray);
+    for (int i = 0; i < hot_keys.size() && i < kMaxHotKeys; i++) {
+      EasyJson key_json = hot_keys_json.PushBack(EasyJson::kObject);
+      key_json["key"] = hot_keys[i].second;
+      key_json["estimated_ops"] = hot_keys[i].first;
+    }
+  }
+
   // Used to make the Impala CREATE TABLE statement.
   (*output)["master_addresses"] = MasterAddrsToCsv();
 
@@ -608,6 +699,10 @@ Status MasterPathHandlers::Register(Webserver* server) {
       "/masters", "Masters",
       boost::bind(&MasterPathHandlers::HandleMasters, this, _1, _2),
       is_styled, is_on_nav_bar);
+  server->RegisterPathHandler(
+      "/rebalancer", "Rebalancer",
+      boost::bind(&MasterPathHandlers::HandleRebalancer, this, _1, _2),
+      is_styled, false);
   server->RegisterPrerenderedPathHandler(
       "/dump-entities", "Dump Entities",
       boost::bind(&MasterPathHandlers::HandleDumpEntities, this, _1, _2),
@@ -142,6 +142,7 @@ void MasterServiceImpl::TSHeartbeat(const TSHeartbeatRequestPB* req,
   // 2. All responses contain this.
   resp->mutable_master_instance()->CopyFrom(server_->instance_pb());
   resp->set_leader_master(is_leader_master);
+  resp->set_supports_compact_tablet_reports(true);
 
   // 3. Register or look up the tserver.
   shared_ptr<TSDescriptor> ts_desc;
@@ -182,6 +183,9 @@ void MasterServiceImpl::TSHeartbeat(const TSHeartbeatRequestPB* req,
   // 4. Update tserver soft state based on the heartbeat contents.
   ts_desc->UpdateHeartbeatTime();
   ts_desc->set_num_live_replicas(req->num_live_tablets());
+  if (req->has_load()) {
+    ts_desc->UpdateLoad(req->load());
+  }
 
   // 5. Only leaders handle tablet reports.
   if (is_leader_master && req->has_tablet_report()) {
@@ -0,0 +1,247 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/master/rebalancer.h"
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include "kudu/gutil/strings/substitute.h"
+
+using std::map;
+using std::string;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+namespace master {
+
+namespace {
+
+vector<string> MakeTServers(int num_tservers) {
+  vector<string> ts_uuids;
+  for (int i = 0; i < num_tservers; i++) {
+    ts_uuids.push_back(Substitute("ts-$0", i));
+  }
+  return ts_uuids;
+}
+
+// Adds 'num_tablets' tablets of table 'table_id' with 'num_replicas' replicas
+// each, placed round-robin on 'ts_uuids' and led by their first replica.
+void AddTablets(const string& table_id,
+                int num_tablets,
+                int num_replicas,
+                const vector<string>& ts_uuids,
+                vector<TabletPlacement>* tablets) {
+  for (int i = 0; i < num_tablets; i++) {
+    TabletPlacement tablet;
+    tablet.tablet_id = Substitute("$0-tablet-$1", table_id, i);
+    tablet.table_id = table_id;
+    for (int r = 0; r < num_replicas; r++) {
+      tablet.voter_uuids.push_back(ts_uuids[(i + r) % ts_uuids.size()]);
+    }
+    tablet.leader_uuid = tablet.voter_uuids[0];
+    tablets->push_back(tablet);
+  }
+}
+
+map<string, int> CountLeaders(const vector<string>& ts_uuids,
+                              const vector<TabletPlacement>& tablets) {
+  map<string, int> counts;
+  for (const auto& uuid : ts_uuids) {
+    counts[uuid] = 0;
+  }
+  for (const auto& tablet : tablets) {
+    counts[tablet.leader_uuid]++;
+  }
+  return counts;
+}
+
+// Counts the replicas of table 'table_id', or of all tables if empty.
+map<string, int> CountReplicas(const vector<string>& ts_uuids,
+                               const vector<TabletPlacement>& tablets,
+                               const string& table_id = "") {
+  map<string, int> counts;
+  for (const auto& uuid : ts_uuids) {
+    counts[uuid] = 0;
+  }
+  for (const auto& tablet : tablets) {
+    if (table_id.empty() || tablet.table_id == table_id) {
+      for (const auto& uuid : tablet.voter_uuids) {
+        counts[uuid]++;
+      }
+    }
+  }
+  return counts;
+}
+
+int Skew(const map<string, int>& counts) {
+  int min = counts.begin()->second;
+  int max = counts.begin()->second;
+  for (const auto& e : counts) {
+    min = std::min(min, e.second);
+    max = std::max(max, e.second);
+  }
+  return max - min;
+}
+
+// Applies 'moves' to 'tablets', electing the follower with the fewest leaders
+// when a leader steps down.
+void ApplyMoves(const vector<string>& ts_uuids,
+                const vector<RebalancingMove>& moves,
+                vector<TabletPlacement>* tablets) {
+  for (const auto& move : moves) {
+    auto tablet = std::find_if(tablets->begin(), tablets->end(),
+                               [&](const TabletPlacement& t) {
+                                 return t.tablet_id == move.tablet_id;
+                               });
+    ASSERT_NE(tablets->end(), tablet);
+    ASSERT_EQ(1, std::count(tablet->voter_uuids.begin(), tablet->voter_uuids.end(),
+                            move.from_uuid)) << move.ToString();
+    if (move.type == RebalancingMove::MOVE_REPLICA) {
+      ASSERT_EQ(0, std::count(tablet->voter_uuids.begin(), tablet->voter_uuids.end(),
+                              move.to_uuid)) << move.ToString();
+      std::replace(tablet->voter_uuids.begin(), tablet->voter_uuids.end(),
+                   move.from_uuid, move.to_uuid);
+      if (tablet->leader_uuid == move.from_uuid) {
+        tablet->leader_uuid = move.to_uuid;
+      }
+      continue;
+    }
+    ASSERT_EQ(move.from_uuid, tablet->leader_uuid) << move.ToString();
+    map<string, int> leaders = CountLeaders(ts_uuids, *tablets);
+    string new_leader;
+    for (const auto& uuid : tablet->voter_uuids) {
+      if (uuid != move.from_uuid &&
+          (new_leader.empty() || leaders[uuid] < leaders[new_leader])) {
+        new_leader = uuid;
+      }
+    }
+    tablet->leader_uuid = new_leader;
+  }
+}
+
+// Runs passes of the rebalancer until it plans no more moves, checking that
+// each pass respects the limits. Returns the number of passes.
+int RebalanceUntilDone(const vector<string>& ts_uuids,
+                       int max_replica_moves,
+                       int max_leader_moves,
+                       vector<TabletPlacement>* tablets) {
+  for (int pass = 0; pass < 1000; pass++) {
+    vector<RebalancingMove> moves;
+    PlanRebalancingMoves(ts_uuids, *tablets, max_replica_moves, max_leader_moves, &moves);
+    if (moves.empty()) {
+      return pass;
+    }
+    int num_replica_moves = 0;
+    int num_leader_moves = 0;
+    for (const auto& move : moves) {
+      if (move.type == RebalancingMove::MOVE_REPLICA) {
+        num_replica_moves++;
+      } else {
+        num_leader_moves++;
+      }
+    }
+    CHECK_LE(num_replica_moves, max_replica_moves);
+    CHECK_LE(num_leader_moves, max_leader_moves);
+    ApplyMoves(ts_uuids, moves, tablets);
+    if (testing::Test::HasFatalFailure()) {
+      return -1;
+    }
+  }
+  LOG(FATAL) << "the rebalancer did not converge";
+  return -1;
+}
+
+} // anonymous namespace
+
+TEST(RebalancerTest, TestBalancedClusterHasNoMoves) {
+  const vector<string> ts_uuids = MakeTServers(3);
+  vector<TabletPlacement> tablets;
+  AddTablets("table-a", 9, 3, ts_uuids, &tablets);
+  vector<RebalancingMove> moves;
+  PlanRebalancingMoves(ts_uuids, tablets, 10, 10, &moves);
+  EXPECT_TRUE(moves.empty());
+}
+
+// A tablet server added to the cluster gets its share of the replicas.
+TEST(RebalancerTest, TestNewTabletServer) {
+  vector<string> ts_uuids = MakeTServers(3);
+  vector<TabletPlacement> tablets;
+  AddTablets("table-a", 12, 3, ts_uuids, &tablets);
+  AddTablets("table-b", 6, 3, ts_uuids, &tablets);
+  ts_uuids.emplace_back("ts-new");
+
+  ASSERT_GT(RebalanceUntilDone(ts_uuids, 2, 0, &tablets), 1);
+  EXPECT_LE(Skew(CountReplicas(ts_uuids, tablets)), 1);
+  EXPECT_LE(Skew(CountReplicas(ts_uuids, tablets, "table-a")), 1);
+  EXPECT_LE(Skew(CountReplicas(ts_uuids, tablets, "table-b")), 1);
+}
+
+// The replicas of each table are evened out, even if the cluster as a whole
+// is already balanced.
+TEST(RebalancerTest, TestPerTableBalance) {
+  const vector<string> ts_uuids = MakeTServers(4);
+  vector<TabletPlacement> tablets;
+  AddTablets("table-a", 4, 1, { "ts-0", "ts-1" }, &tablets);
+  AddTablets("table-b", 4, 1, { "ts-2", "ts-3" }, &tablets);
+  ASSERT_EQ(0, Skew(CountReplicas(ts_uuids, tablets)));
+
+  RebalanceUntilDone(ts_uuids, 10, 0, &tablets);
+  EXPECT_LE(Skew(CountReplicas(ts_uuids, tablets)), 1);
+  EXPECT_LE(Skew(CountReplicas(ts_uuids, tablets, "table-a")), 1);
+  EXPECT_LE(Skew(CountReplicas(ts_uuids, tablets, "table-b")), 1);
+}
+
+// Leaders concentrated on one tablet server are spread out by step-downs,
+// without moving any replica.
+TEST(RebalancerTest, TestLeaderBalance) {
+  const vector<string> ts_uuids = MakeTServers(3);
+  vector<TabletPlacement> tablets;
+  AddTablets("table-a", 9, 3, ts_uuids, &tablets);
+  for (auto& tablet : tablets) {
+    tablet.leader_uuid = "ts-0";
+  }
+  const vector<TabletPlacement> orig_tablets = tablets;
+
+  ASSERT_GT(RebalanceUntilDone(ts_uuids, 0, 2, &tablets), 1);
+  EXPECT_LE(Skew(CountLeaders(ts_uuids, tablets)), 1);
+  for (size_t i = 0; i < tablets.size(); i++) {
+    EXPECT_EQ(orig_tablets[i].voter_uuids, tablets[i].voter_uuids);
+  }
+}
+
+// Tablets with no leader don't count, and aren't stepped down.
+TEST(RebalancerTest, TestNoLeader) {
+  const vector<string> ts_uuids = MakeTServers(3);
+  vector<TabletPlacement> tablets;
+  AddTablets("table-a", 3, 3, ts_uuids, &tablets);
+  for (auto& tablet : tablets) {
+    tablet.leader_uuid.clear();
+  }
+  vector<RebalancingMove> moves;
+  PlanRebalancingMoves(ts_uuids, tablets, 10, 10, &moves);
+  EXPECT_TRUE(moves.empty());
+}
+
+} // namespace master
+} // namespace kudu
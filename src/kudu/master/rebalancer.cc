@@ -0,0 +1,250 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/master/rebalancer.h"
+
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+#include <glog/logging.h>
+
+#include "kudu/gutil/map-util.h"
+#include "kudu/gutil/strings/substitute.h"
+
+using std::function;
+using std::map;
+using std::string;
+using std::unordered_map;
+using std::unordered_set;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+namespace master {
+
+string RebalancingMove::ToString() const {
+  switch (type) {
+    case LEADER_STEP_DOWN:
+      return Substitute("step down leader of tablet $0 on $1", tablet_id, from_uuid);
+    case MOVE_REPLICA:
+      return Substitute("move replica of tablet $0 from $1 to $2",
+                        tablet_id, from_uuid, to_uuid);
+  }
+  LOG(FATAL) << "unknown move type " << type;
+  return "";
+}
+
+RebalancerStatus::RebalancerStatus()
+    : leader_step_downs(0),
+      replica_moves_started(0),
+      replica_moves_completed(0),
+      replica_moves_abandoned(0) {
+}
+
+namespace {
+
+// Tablet server UUID -> count.
+typedef unordered_map<string, int> CountMap;
+
+bool HasVoter(const TabletPlacement& tablet, const string& uuid) {
+  return std::find(tablet.voter_uuids.begin(), tablet.voter_uuids.end(), uuid) !=
+      tablet.voter_uuids.end();
+}
+
+// Finds the tablet servers of 'ts_uuids' with the most and the fewest of
+// 'counts', breaking ties with 'tiebreak' if set. Returns false if they differ
+// by at most one.
+bool FindSkew(const vector<string>& ts_uuids,
+              const CountMap& counts,
+              const CountMap* tiebreak,
+              string* most,
+              string* fewest) {
+  auto key = [&](const string& uuid) {
+    return std::make_pair(FindWithDefault(counts, uuid, 0),
+                          tiebreak ? FindWithDefault(*tiebreak, uuid, 0) : 0);
+  };
+  auto max = std::max_element(ts_uuids.begin(), ts_uuids.end(),
+                              [&](const string& a, const string& b) { return key(a) < key(b); });
+  auto min = std::min_element(ts_uuids.begin(), ts_uuids.end(),
+                              [&](const string& a, const string& b) { return key(a) < key(b); });
+  if (max == ts_uuids.end()) {
+    return false;
+  }
+  *most = *max;
+  *fewest = *min;
+  return key(*max).first - key(*min).first > 1;
+}
+
+// Returns a tablet of 'tablets' which wasn't 'moved' yet, with a voter on
+// 'from' but none on 'to', and which satisfies 'pred'. Tablets not led from
+// 'from' are preferred, since moving a leader replica requires a step-down.
+const TabletPlacement* FindMovableReplica(const vector<const TabletPlacement*>& tablets,
+                                          const string& from,
+                                          const string& to,
+                                          const unordered_set<string>& moved,
+                                          const function<bool(const TabletPlacement&)>& pred) {
+  const TabletPlacement* leader_candidate = nullptr;
+  for (const TabletPlacement* tablet : tablets) {
+    if (ContainsKey(moved, tablet->tablet_id) ||
+        !HasVoter(*tablet, from) || HasVoter(*tablet, to) || !pred(*tablet)) {
+      continue;
+    }
+    if (tablet->leader_uuid != from) {
+      return tablet;
+    }
+    if (!leader_candidate) {
+      leader_candidate = tablet;
+    }
+  }
+  return leader_candidate;
+}
+
+} // anonymous namespace
+
+void PlanRebalancingMoves(const vector<string>& ts_uuids,
+                          const vector<TabletPlacement>& tablets,
+                          int max_replica_moves,
+                          int max_leader_moves,
+                          vector<RebalancingMove>* moves) {
+  // The tablets of each table, ordered by table ID for deterministic plans.
+  map<string, vector<const TabletPlacement*>> tablets_by_table;
+  vector<const TabletPlacement*> all_tablets;
+  // The replicas of each server, in total and per table.
+  CountMap replicas;
+  unordered_map<string, CountMap> table_replicas;
+  for (const auto& tablet : tablets) {
+    tablets_by_table[tablet.table_id].push_back(&tablet);
+    all_tablets.push_back(&tablet);
+    for (const auto& uuid : tablet.voter_uuids) {
+      replicas[uuid]++;
+      table_replicas[tablet.table_id][uuid]++;
+    }
+  }
+
+  unordered_set<string> moved;
+  int num_replica_moves = 0;
+  auto add_replica_move = [&](const TabletPlacement& tablet,
+                              const string& from,
+                              const string& to) {
+    RebalancingMove move;
+    move.type = RebalancingMove::MOVE_REPLICA;
+    move.tablet_id = tablet.tablet_id;
+    move.from_uuid = from;
+    move.to_uuid = to;
+    moves->emplace_back(std::move(move));
+    moved.insert(tablet.tablet_id);
+    replicas[from]--;
+    replicas[to]++;
+    table_replicas[tablet.table_id][from]--;
+    table_replicas[tablet.table_id][to]++;
+    num_replica_moves++;
+  };
+
+  // 1. Even out the replicas of each table, moving them off the servers with
+  //    the most replicas overall first.
+  for (const auto& e : tablets_by_table) {
+    const string& table_id = e.first;
+    while (num_replica_moves < max_replica_moves) {
+      string most;
+      string fewest;
+      if (!FindSkew(ts_uuids, table_replicas[table_id], &replicas, &most, &fewest)) {
+        break;
+      }
+      const TabletPlacement* tablet = FindMovableReplica(
+          e.second, most, fewest, moved, [](const TabletPlacement& /*t*/) { return true; });
+      if (!tablet) {
+        break;
+      }
+      add_replica_move(*tablet, most, fewest);
+    }
+  }
+
+  // 2. Even out the replicas of all tables, only moving replicas of tables
+  //    which have more replicas on the source than on the destination, so as
+  //    not to skew them again.
+  while (num_replica_moves < max_replica_moves) {
+    string most;
+    string fewest;
+    if (!FindSkew(ts_uuids, replicas, nullptr, &most, &fewest)) {
+      break;
+    }
+    const TabletPlacement* tablet = FindMovableReplica(
+        all_tablets, most, fewest, moved, [&](const TabletPlacement& t) {
+          const CountMap& counts = table_replicas[t.table_id];
+          return FindWithDefault(counts, most, 0) > FindWithDefault(counts, fewest, 0);
+        });
+    if (!tablet) {
+      break;
+    }
+    add_replica_move(*tablet, most, fewest);
+  }
+
+  // 3. Even out the leaders of all tables among the tablets which don't move.
+  CountMap leaders;
+  for (const auto& tablet : tablets) {
+    if (!tablet.leader_uuid.empty()) {
+      leaders[tablet.leader_uuid]++;
+    }
+  }
+  int num_leader_moves = 0;
+  while (num_leader_moves < max_leader_moves) {
+    string most;
+    string fewest;
+    if (!FindSkew(ts_uuids, leaders, nullptr, &most, &fewest)) {
+      break;
+    }
+    // Step down a leader of 'most' with a follower on 'fewest', or failing
+    // that on any server with at least two fewer leaders.
+    const TabletPlacement* to_step_down = nullptr;
+    string new_leader;
+    for (const TabletPlacement* tablet : all_tablets) {
+      if (tablet->leader_uuid != most || ContainsKey(moved, tablet->tablet_id)) {
+        continue;
+      }
+      for (const auto& uuid : tablet->voter_uuids) {
+        if (uuid == most || leaders[uuid] + 1 >= leaders[most]) {
+          continue;
+        }
+        if (!to_step_down || leaders[uuid] < leaders[new_leader]) {
+          to_step_down = tablet;
+          new_leader = uuid;
+        }
+      }
+      if (to_step_down && new_leader == fewest) {
+        break;
+      }
+    }
+    if (!to_step_down) {
+      break;
+    }
+    RebalancingMove move;
+    move.type = RebalancingMove::LEADER_STEP_DOWN;
+    move.tablet_id = to_step_down->tablet_id;
+    move.from_uuid = most;
+    moves->emplace_back(std::move(move));
+    moved.insert(to_step_down->tablet_id);
+    leaders[most]--;
+    leaders[new_leader]++;
+    num_leader_moves++;
+  }
+}
+
+} // namespace master
+} // namespace kudu
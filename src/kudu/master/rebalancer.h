@@ -0,0 +1,107 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "kudu/util/monotime.h"
+
+namespace kudu {
+namespace master {
+
+// The placement of the replicas of a tablet, as seen by the rebalancer.
+struct TabletPlacement {
+  std::string tablet_id;
+  std::string table_id;
+
+  // The UUID of the tablet server of the leader replica.
+  std::string leader_uuid;
+
+  // The UUIDs of the tablet servers of the voter replicas, including the
+  // leader.
+  std::vector<std::string> voter_uuids;
+};
+
+// A move of the rebalancer.
+struct RebalancingMove {
+  enum Type {
+    // The leader replica of the tablet, on tablet server 'from_uuid', steps
+    // down, so that a replica on a tablet server with fewer leaders may take
+    // over.
+    LEADER_STEP_DOWN,
+
+    // The replica of the tablet on tablet server 'from_uuid' moves to tablet
+    // server 'to_uuid': a replica is added on 'to_uuid', then the one on
+    // 'from_uuid' is removed.
+    MOVE_REPLICA,
+  };
+
+  Type type;
+  std::string tablet_id;
+  std::string from_uuid;
+  std::string to_uuid;
+
+  std::string ToString() const;
+};
+
+// The progress of the rebalancer, for the master web UI.
+struct RebalancerStatus {
+  RebalancerStatus();
+
+  // When the last pass of the rebalancer ran, if any.
+  MonoTime last_pass;
+
+  // The numbers of leader step-downs requested, and of replica moves started,
+  // completed and abandoned, since the master started.
+  int64_t leader_step_downs;
+  int64_t replica_moves_started;
+  int64_t replica_moves_completed;
+  int64_t replica_moves_abandoned;
+
+  // The replica moves in progress.
+  std::vector<RebalancingMove> pending_replica_moves;
+
+  // The numbers of replicas and leaders of each tablet server, as of the last
+  // pass, not counting the tablets with moves in progress.
+  std::map<std::string, int> replicas_per_ts;
+  std::map<std::string, int> leaders_per_ts;
+};
+
+// Plans moves which even out the replicas and the leaders across the tablet
+// servers 'ts_uuids', given the placement of 'tablets':
+//
+// 1. Up to 'max_replica_moves' replica moves, which first even out the
+//    replicas of each table, then the replicas of all tables, without
+//    skewing any table again.
+// 2. Up to 'max_leader_moves' leader step-downs, which even out the leaders
+//    of all tables, assuming that the follower on the tablet server with the
+//    fewest leaders takes over.
+//
+// A server is balanced when its count differs from the others' by at most
+// one. Each tablet moves at most once. All of the voters of 'tablets' must be
+// on servers of 'ts_uuids'.
+void PlanRebalancingMoves(const std::vector<std::string>& ts_uuids,
+                          const std::vector<TabletPlacement>& tablets,
+                          int max_replica_moves,
+                          int max_leader_moves,
+                          std::vector<RebalancingMove>* moves);
+
+} // namespace master
+} // namespace kudu
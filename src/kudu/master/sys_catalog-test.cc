@@ -17,6 +17,7 @@
 
 #include <memory>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -28,6 +29,7 @@
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/ref_counted.h"
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/master/catalog_manager.h"
 #include "kudu/master/master.h"
 #include "kudu/master/master.pb.h"
@@ -54,7 +56,9 @@ using kudu::security::DataFormat;
 using kudu::security::PrivateKey;
 using std::shared_ptr;
 using std::string;
+using std::thread;
 using std::vector;
+using strings::Substitute;
 
 namespace google {
 namespace protobuf {
@@ -181,6 +185,49 @@ TEST_F(SysCatalogTest, TestSysCatalogTablesOperations) {
   ASSERT_EQ(0, loader.tables.size());
 }
 
+// Test that concurrent writes, which the sys-catalog may batch together, are
+// all applied.
+TEST_F(SysCatalogTest, TestConcurrentWrites) {
+  const int kNumThreads = 8;
+  const int kTablesPerThread = 20;
+  SysCatalogTable* sys_catalog = master_->catalog_manager()->sys_catalog();
+  vector<thread> threads;
+  vector<Status> statuses(kNumThreads);
+  for (int t = 0; t < kNumThreads; t++) {
+    threads.emplace_back([&, t]() {
+      for (int i = 0; i < kTablesPerThread; i++) {
+        scoped_refptr<TableInfo> table(new TableInfo(Substitute("table-$0-$1", t, i)));
+        TableMetadataLock l(table.get(), LockMode::WRITE);
+        l.mutable_data()->pb.set_name(table->id());
+        l.mutable_data()->pb.set_version(0);
+        l.mutable_data()->pb.set_num_replicas(1);
+        l.mutable_data()->pb.set_state(SysTablesEntryPB::PREPARING);
+        Status s = SchemaToPB(Schema(), l.mutable_data()->pb.mutable_schema());
+        if (s.ok()) {
+          SysCatalogTable::Actions actions;
+          actions.table_to_add = table.get();
+          s = sys_catalog->Write(actions);
+        }
+        if (!s.ok()) {
+          statuses[t] = s;
+          return;
+        }
+        l.Commit();
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  for (const auto& s : statuses) {
+    ASSERT_OK(s);
+  }
+
+  TestTableLoader loader;
+  ASSERT_OK(sys_catalog->VisitTables(&loader));
+  ASSERT_EQ(kNumThreads * kTablesPerThread, loader.tables.size());
+}
+
 // Verify that data mutations are not available from metadata() until commit.
 TEST_F(SysCatalogTest, TestTableInfoCommit) {
   scoped_refptr<TableInfo> table(new TableInfo("123"));
@@ -84,15 +84,29 @@
 #include "kudu/util/logging.h"
 #include "kudu/util/memory/arena.h"
 #include "kudu/util/monotime.h"
+#include "kudu/util/mutex.h"
 #include "kudu/util/net/net_util.h"
 #include "kudu/util/net/sockaddr.h"
 #include "kudu/util/pb_util.h"
 #include "kudu/util/slice.h"
+#include "kudu/util/threadpool.h"
 
 DEFINE_double(sys_catalog_fail_during_write, 0.0,
               "Fraction of the time when system table writes will fail");
 TAG_FLAG(sys_catalog_fail_during_write, hidden);
 
+DEFINE_int32(sys_catalog_max_write_batch_bytes, 4 * 1024 * 1024,
+             "Maximum size in bytes of the row operations of concurrent table and "
+             "tablet metadata updates which the master batches into a single write "
+             "to the system catalog. A single update may exceed it.");
+TAG_FLAG(sys_catalog_max_write_batch_bytes, advanced);
+TAG_FLAG(sys_catalog_max_write_batch_bytes, runtime);
+
+DEFINE_int32(sys_catalog_load_threads, 4,
+             "Number of threads the master uses to decode the entries of the system "
+             "catalog when loading them into memory, e.g. when becoming leader.");
+TAG_FLAG(sys_catalog_load_threads, advanced);
+
 using kudu::consensus::ConsensusMetadata;
 using kudu::consensus::ConsensusMetadataManager;
 using kudu::consensus::ConsensusStatePB;
@@ -158,7 +172,12 @@ SysCatalogTable::SysCatalogTable(Master* master,
     : metric_registry_(master->metric_registry()),
       master_(master),
       cmeta_manager_(new ConsensusMetadataManager(master_->fs_manager())),
-      leader_cb_(std::move(leader_cb)) {
+      leader_cb_(std::move(leader_cb)),
+      write_cond_(&write_lock_),
+      write_in_flight_(false) {
+  CHECK_OK(ThreadPoolBuilder("sys-catalog-load")
+           .set_max_threads(std::max(1, FLAGS_sys_catalog_load_threads))
+           .Build(&load_pool_));
 }
 
 SysCatalogTable::~SysCatalogTable() {
@@ -168,6 +187,7 @@ void SysCatalogTable::Shutdown() {
   if (tablet_replica_) {
     tablet_replica_->Shutdown();
   }
+  load_pool_->Shutdown();
 }
 
 Status SysCatalogTable::Load(FsManager *fs_manager) {
@@ -478,35 +498,77 @@ Schema SysCatalogTable::BuildTableSchema() {
   return builder.Build();
 }
 
-Status SysCatalogTable::Write(const Actions& actions) {
-  TRACE_EVENT0("master", "SysCatalogTable::Write");
+struct SysCatalogTable::WriteBatch {
+  WriteBatch() : done(false) {}
 
   WriteRequestPB req;
   WriteResponsePB resp;
-  req.set_tablet_id(kSysCatalogTabletId);
-  RETURN_NOT_OK(SchemaToPB(schema_, req.mutable_schema()));
+
+  // Whether the batch was written, and the result.
+  bool done;
+  Status status;
+};
+
+Status SysCatalogTable::Write(const Actions& actions) {
+  TRACE_EVENT0("master", "SysCatalogTable::Write");
+
+  // Concurrent writes are batched: each write adds its row operations to the
+  // last pending batch, and waits for the batch to be written. The writer
+  // which finds the oldest batch pending while no write is in flight writes
+  // it, as a single WriteRequestPB and thus a single Raft operation.
+  //
+  // The callers hold the write locks of the tables and tablets they update,
+  // so no two writes of a batch update the same row.
+  MutexLock l(write_lock_);
+  if (write_batches_.empty() ||
+      write_batches_.back()->req.row_operations().rows().size() +
+      write_batches_.back()->req.row_operations().indirect_data().size() >=
+      static_cast<size_t>(std::max(1, FLAGS_sys_catalog_max_write_batch_bytes))) {
+    shared_ptr<WriteBatch> batch = std::make_shared<WriteBatch>();
+    batch->req.set_tablet_id(kSysCatalogTabletId);
+    RETURN_NOT_OK(SchemaToPB(schema_, batch->req.mutable_schema()));
+    write_batches_.emplace_back(std::move(batch));
+  }
+  shared_ptr<WriteBatch> batch = write_batches_.back();
+  WriteRequestPB* req = &batch->req;
+  const size_t prev_rows_size = req->row_operations().rows().size();
 
   if (actions.table_to_add) {
-    ReqAddTable(&req, actions.table_to_add);
+    ReqAddTable(req, actions.table_to_add);
   }
   if (actions.table_to_update) {
-    ReqUpdateTable(&req, actions.table_to_update);
+    ReqUpdateTable(req, actions.table_to_update);
   }
   if (actions.table_to_delete) {
-    ReqDeleteTable(&req, actions.table_to_delete);
+    ReqDeleteTable(req, actions.table_to_delete);
   }
 
-  ReqAddTablets(&req, actions.tablets_to_add);
-  ReqUpdateTablets(&req, actions.tablets_to_update);
-  ReqDeleteTablets(&req, actions.tablets_to_delete);
+  ReqAddTablets(req, actions.tablets_to_add);
+  ReqUpdateTablets(req, actions.tablets_to_update);
+  ReqDeleteTablets(req, actions.tablets_to_delete);
 
-  if (req.row_operations().rows().empty()) {
+  if (req->row_operations().rows().size() == prev_rows_size) {
     // No actual changes were written (i.e the data to be updated matched the
     // previous version of the data).
     return Status::OK();
   }
-  RETURN_NOT_OK(SyncWrite(&req, &resp));
-  return Status::OK();
+
+  while (!batch->done) {
+    if (write_in_flight_ || write_batches_.front() != batch) {
+      write_cond_.Wait();
+      continue;
+    }
+    write_batches_.pop_front();
+    write_in_flight_ = true;
+    l.Unlock();
+    Status s = SyncWrite(&batch->req, &batch->resp);
+    l.Lock();
+    write_in_flight_ = false;
+    batch->status = s;
+    batch->done = true;
+    write_cond_.Broadcast();
+  }
+  return batch->status;
 }
 
 // ==================================================================
@@ -578,20 +640,14 @@ Status SysCatalogTable::VisitTables(TableVisitor* visitor) {
   return ProcessRows<SysTablesEntryPB, TABLES_ENTRY>(processor);
 }
 
-template<typename T>
-Status SysCatalogTable::GetEntryFromRow(
-    const RowBlockRow& row, string* entry_id, T* entry_data) const {
+void SysCatalogTable::GetEntryFromRow(
+    const RowBlockRow& row, string* entry_id, string* entry_data) const {
   const Slice* id = schema_.ExtractColumnFromRow<STRING>(
       row, schema_.find_column(kSysCatalogTableColId));
   const Slice* data = schema_.ExtractColumnFromRow<STRING>(
       row, schema_.find_column(kSysCatalogTableColMetadata));
-  string str_id = id->ToString();
-  RETURN_NOT_OK_PREPEND(
-      pb_util::ParseFromArray(entry_data, data->data(), data->size()),
-      "unable to parse metadata field for row " + str_id);
-  *entry_id = std::move(str_id);
-
-  return Status::OK();
+  *entry_id = id->ToString();
+  *entry_data = data->ToString();
 }
 
 // Scan for entries of the specified type and run the specified function
@@ -599,6 +655,10 @@ Status SysCatalogTable::GetEntryFromRow(
 template<typename T, SysCatalogTable::CatalogEntryType entry_type>
 Status SysCatalogTable::ProcessRows(
     function<Status(const string&, const T&)> processor) const {
+  // Number of entries decoded at once. Decoding dominates the cost of loading
+  // large catalogs, so it's spread across 'load_pool_'.
+  static const size_t kBatchSize = 8192;
+
   const int type_col_idx = schema_.find_column(kSysCatalogTableColType);
   CHECK(type_col_idx != Schema::kColumnNotFound)
       << "cannot find sys catalog table column " << kSysCatalogTableColType
@@ -614,6 +674,53 @@ Status SysCatalogTable::ProcessRows(
   RETURN_NOT_OK(tablet_replica_->tablet()->NewRowIterator(schema_, &iter));
   RETURN_NOT_OK(iter->Init(&spec));
 
+  vector<string> entry_ids;
+  vector<string> raw_entries;
+  vector<T> entries;
+  auto process_batch = [&]() -> Status {
+    const size_t num_entries = entry_ids.size();
+    entries.clear();
+    entries.resize(num_entries);
+
+    // Decode contiguous chunks of the batch in parallel, the last one on this
+    // thread.
+    const size_t num_chunks = std::min<size_t>(
+        num_entries, std::max(1, FLAGS_sys_catalog_load_threads));
+    vector<Status> statuses(num_chunks);
+    CountDownLatch latch(num_chunks);
+    auto decode_chunk = [&](size_t chunk) {
+      for (size_t i = num_entries * chunk / num_chunks;
+           i < num_entries * (chunk + 1) / num_chunks; i++) {
+        Status s = pb_util::ParseFromArray(
+            &entries[i], reinterpret_cast<const uint8_t*>(raw_entries[i].data()),
+            raw_entries[i].size());
+        if (PREDICT_FALSE(!s.ok())) {
+          statuses[chunk] = s.CloneAndPrepend(
+              "unable to parse metadata field for row " + entry_ids[i]);
+          break;
+        }
+      }
+      latch.CountDown();
+    };
+    for (size_t chunk = 0; chunk < num_chunks; chunk++) {
+      if (chunk + 1 == num_chunks ||
+          !load_pool_->SubmitFunc(std::bind(decode_chunk, chunk)).ok()) {
+        decode_chunk(chunk);
+      }
+    }
+    latch.Wait();
+    for (const auto& s : statuses) {
+      RETURN_NOT_OK(s);
+    }
+
+    for (size_t i = 0; i < num_entries; i++) {
+      RETURN_NOT_OK(processor(entry_ids[i], entries[i]));
+    }
+    entry_ids.clear();
+    raw_entries.clear();
+    return Status::OK();
+  };
+
   Arena arena(32 * 1024);
   RowBlock block(iter->schema(), 512, &arena);
   while (iter->HasNext()) {
@@ -623,13 +730,15 @@ Status SysCatalogTable::ProcessRows(
       if (!block.selection_vector()->IsRowSelected(i)) {
         continue;
       }
-      string entry_id;
-      T entry_data;
-      RETURN_NOT_OK(GetEntryFromRow(block.row(i), &entry_id, &entry_data));
-      RETURN_NOT_OK(processor(entry_id, entry_data));
+      entry_ids.emplace_back();
+      raw_entries.emplace_back();
+      GetEntryFromRow(block.row(i), &entry_ids.back(), &raw_entries.back());
+    }
+    if (entry_ids.size() >= kBatchSize) {
+      RETURN_NOT_OK(process_batch());
     }
   }
-  return Status::OK();
+  return process_batch();
 }
 
 Status SysCatalogTable::VisitTskEntries(TskEntryVisitor* visitor) {
@@ -18,7 +18,9 @@
 #define KUDU_MASTER_SYS_CATALOG_H_
 
 #include <cstdint>
+#include <deque>
 #include <functional>
+#include <memory>
 #include <set>
 #include <string>
 #include <vector>
@@ -28,10 +30,13 @@
 #include "kudu/common/schema.h"
 #include "kudu/consensus/metadata.pb.h"
 #include "kudu/gutil/callback.h"
+#include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/master/catalog_manager.h"
 #include "kudu/tablet/tablet_replica.h"
+#include "kudu/util/condition_variable.h"
+#include "kudu/util/mutex.h"
 #include "kudu/util/status.h"
 
 namespace kudu {
@@ -39,6 +44,7 @@ namespace kudu {
 class FsManager;
 class MetricRegistry;
 class RowBlockRow;
+class ThreadPool;
 
 namespace consensus {
 class ConsensusMetadataManager;
@@ -226,12 +232,14 @@ class SysCatalogTable {
   // tablets.
   Status WaitUntilRunning();
 
-  template<typename T>
-  Status GetEntryFromRow(const RowBlockRow& row,
-                         std::string* entry_id, T* entry_data) const;
+  // Extracts the ID and the serialized metadata of the entry of 'row'.
+  void GetEntryFromRow(const RowBlockRow& row,
+                       std::string* entry_id, std::string* entry_data) const;
 
+  // Scans the entries of 'entry_type' and runs 'processor' on each, in order.
+  // The entries are decoded in parallel by 'load_pool_'.
   template<typename T, CatalogEntryType entry_type>
-  Status ProcessRows(std::function<Status(const std::string&, const T&)>) const;
+  Status ProcessRows(std::function<Status(const std::string&, const T&)> processor) const;
 
   // Tablet related private methods.
 
@@ -255,6 +263,9 @@ class SysCatalogTable {
 
   static std::string TskSeqNumberToEntryId(int64_t seq_number);
 
+  // Row operations of concurrent calls to Write(), written as one.
+  struct WriteBatch;
+
   // Special string injected into SyncWrite() random failures (if enabled).
   //
   // Only useful for tests.
@@ -275,6 +286,19 @@ class SysCatalogTable {
   ElectedLeaderCallback leader_cb_;
 
   consensus::RaftPeerPB local_peer_pb_;
+
+  // Decodes the entries of the sys catalog when they are loaded.
+  gscoped_ptr<ThreadPool> load_pool_;
+
+  // Protects write_batches_, write_in_flight_ and the batches.
+  Mutex write_lock_;
+  ConditionVariable write_cond_;
+
+  // The batches of Write() pending, oldest first.
+  std::deque<std::shared_ptr<WriteBatch>> write_batches_;
+
+  // Whether a batch is being written.
+  bool write_in_flight_;
 };
 
 } // namespace master
@@ -31,6 +31,7 @@
 #include "kudu/common/wire_protocol.pb.h"
 #include "kudu/consensus/consensus.proxy.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/master/master.pb.h"
 #include "kudu/tserver/tserver_admin.proxy.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/net/net_util.h"
@@ -68,7 +69,22 @@ TSDescriptor::TSDescriptor(std::string perm_id)
       last_heartbeat_(MonoTime::Now()),
       recent_replica_creations_(0),
       last_replica_creations_decay_(MonoTime::Now()),
-      num_live_replicas_(0) {
+      num_live_replicas_(0),
+      last_rows_written_(0),
+      last_rows_scanned_(0),
+      last_rpcs_queued_(0),
+      last_rpc_queue_time_us_(0) {
+}
+
+TSDescriptor::Load::Load()
+    : reported(false),
+      data_dirs_free_bytes(0),
+      data_dirs_capacity_bytes(0),
+      num_leaders(0),
+      rows_written_per_sec(0),
+      rows_scanned_per_sec(0),
+      memory_pressure(false),
+      rpc_queue_time_us(0) {
 }
 
 TSDescriptor::~TSDescriptor() {
@@ -190,6 +206,53 @@ double TSDescriptor::RecentReplicaCreations() {
   return recent_replica_creations_;
 }
 
+void TSDescriptor::UpdateLoad(const TSLoadPB& load_pb) {
+  std::lock_guard<simple_spinlock> l(lock_);
+  MonoTime now = MonoTime::Now();
+  double secs_since_last_update = last_load_update_.Initialized() ?
+      (now - last_load_update_).ToSeconds() : 0;
+  // Weigh the latest heartbeat as much as all of the previous ones, so that
+  // a single burst doesn't swing the averages.
+  const double kWeight = 0.5;
+  // The row counts restart from zero when the tablet server restarts: the
+  // rates are only updated when they didn't.
+  if (secs_since_last_update > 0 &&
+      load_pb.rows_written() >= last_rows_written_ &&
+      load_pb.rows_scanned() >= last_rows_scanned_) {
+    double rows_written_per_sec =
+        (load_pb.rows_written() - last_rows_written_) / secs_since_last_update;
+    double rows_scanned_per_sec =
+        (load_pb.rows_scanned() - last_rows_scanned_) / secs_since_last_update;
+    load_.rows_written_per_sec = kWeight * rows_written_per_sec +
+                                 (1 - kWeight) * load_.rows_written_per_sec;
+    load_.rows_scanned_per_sec = kWeight * rows_scanned_per_sec +
+                                 (1 - kWeight) * load_.rows_scanned_per_sec;
+  }
+  // Likewise for the RPC counts. The queue time is left as is when no RPC was
+  // queued since the last heartbeat.
+  if (last_load_update_.Initialized() &&
+      load_pb.rpcs_queued() > last_rpcs_queued_ &&
+      load_pb.rpc_queue_time_us() >= last_rpc_queue_time_us_) {
+    double rpc_queue_time_us =
+        static_cast<double>(load_pb.rpc_queue_time_us() - last_rpc_queue_time_us_) /
+        (load_pb.rpcs_queued() - last_rpcs_queued_);
+    load_.rpc_queue_time_us = kWeight * rpc_queue_time_us +
+                              (1 - kWeight) * load_.rpc_queue_time_us;
+  }
+  last_rows_written_ = load_pb.rows_written();
+  last_rows_scanned_ = load_pb.rows_scanned();
+  last_rpcs_queued_ = load_pb.rpcs_queued();
+  last_rpc_queue_time_us_ = load_pb.rpc_queue_time_us();
+  last_load_update_ = now;
+
+  load_.reported = true;
+  load_.data_dirs_free_bytes = load_pb.data_dirs_free_bytes();
+  load_.data_dirs_capacity_bytes = load_pb.data_dirs_capacity_bytes();
+  load_.num_leaders = load_pb.num_leaders();
+  load_.memory_pressure = load_pb.memory_pressure();
+  hot_tablets_.assign(load_pb.hot_tablets().begin(), load_pb.hot_tablets().end());
+}
+
 void TSDescriptor::GetRegistration(ServerRegistrationPB* reg) const {
   std::lock_guard<simple_spinlock> l(lock_);
   CHECK(registration_) << "No registration";
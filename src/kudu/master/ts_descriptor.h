@@ -21,12 +21,14 @@
 #include <memory>
 #include <mutex>
 #include <string>
+#include <vector>
 
 #include <glog/logging.h>
 #include <gtest/gtest_prod.h>
 
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
+#include "kudu/tablet/metadata.pb.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/make_shared.h"
 #include "kudu/util/monotime.h"
@@ -52,6 +54,8 @@ class TabletServerAdminServiceProxy;
 
 namespace master {
 
+class TSLoadPB;
+
 // Master-side view of a single tablet server.
 //
 // Tracks the last heartbeat, status, instance identifier, etc.
@@ -119,12 +123,54 @@ class TSDescriptor {
     return num_live_replicas_;
   }
 
+  // The load of a tablet server, as of its latest heartbeats.
+  struct Load {
+    Load();
+
+    // Whether the tablet server reported its load at all. If not, the other
+    // fields are zero.
+    bool reported;
+
+    int64_t data_dirs_free_bytes;
+    int64_t data_dirs_capacity_bytes;
+    int num_leaders;
+
+    // The rows written to and returned by scans of the tablet server per
+    // second, averaged over the recent heartbeats.
+    double rows_written_per_sec;
+    double rows_scanned_per_sec;
+
+    bool memory_pressure;
+
+    // The mean time in microseconds RPCs spent queued on the tablet server
+    // before being handled, averaged over the recent heartbeats.
+    double rpc_queue_time_us;
+  };
+
+  // Updates the load of this TS from the load reported in a heartbeat.
+  void UpdateLoad(const TSLoadPB& load_pb);
+
+  // Return the load of this TS.
+  Load load() const {
+    std::lock_guard<simple_spinlock> l(lock_);
+    return load_;
+  }
+
+  // Return the hottest tablet replicas of this TS, with their hot keys, as of
+  // its latest heartbeat.
+  std::vector<tablet::TabletHotKeysPB> hot_tablets() const {
+    std::lock_guard<simple_spinlock> l(lock_);
+    return hot_tablets_;
+  }
+
   // Return a string form of this TS, suitable for printing.
   // Includes the UUID as well as last known host/port.
   std::string ToString() const;
 
  private:
   FRIEND_TEST(TestTSDescriptor, TestReplicaCreationsDecay);
+  FRIEND_TEST(TestTSDescriptor, TestRpcQueueTime);
+  FRIEND_TEST(TestTSDescriptor, TestHotTablets);
 
   explicit TSDescriptor(std::string perm_id);
 
@@ -151,6 +197,16 @@ class TSDescriptor {
   // The number of live replicas on this host, from the last heartbeat.
   int num_live_replicas_;
 
+  // The load of this host, from the last heartbeats, and the cumulative row
+  // counts of the last heartbeat, from which the rates of 'load_' derive.
+  Load load_;
+  int64_t last_rows_written_;
+  int64_t last_rows_scanned_;
+  int64_t last_rpcs_queued_;
+  int64_t last_rpc_queue_time_us_;
+  MonoTime last_load_update_;
+  std::vector<tablet::TabletHotKeysPB> hot_tablets_;
+
   gscoped_ptr<ServerRegistrationPB> registration_;
 
   std::shared_ptr<tserver::TabletServerAdminServiceProxy> ts_admin_proxy_;
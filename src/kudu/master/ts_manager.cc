@@ -17,7 +17,10 @@
 
 #include "kudu/master/ts_manager.h"
 
+#include <algorithm>
 #include <mutex>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include <glog/logging.h>
@@ -26,17 +29,21 @@
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/master/ts_descriptor.h"
+#include "kudu/tablet/metadata.pb.h"
 #include "kudu/util/pb_util.h"
 
 using std::shared_ptr;
 using std::string;
+using std::unordered_map;
+using std::unordered_set;
 using std::vector;
 using strings::Substitute;
 
 namespace kudu {
 namespace master {
 
-TSManager::TSManager() {
+TSManager::TSManager()
+    : registration_version_(0) {
 }
 
 TSManager::~TSManager() {
@@ -88,6 +95,7 @@ Status TSManager::RegisterTS(const NodeInstancePB& instance,
                             found->ToString());
     desc->swap(found);
   }
+  registration_version_++;
 
   return Status::OK();
 }
@@ -111,6 +119,40 @@ void TSManager::GetAllLiveDescriptors(vector<shared_ptr<TSDescriptor> > *descs)
   }
 }
 
+void TSManager::GetHotTablets(const unordered_set<string>& tablet_ids,
+                              vector<tablet::TabletHotKeysPB>* hot_tablets) const {
+  vector<shared_ptr<TSDescriptor>> descs;
+  GetAllLiveDescriptors(&descs);
+  unordered_map<string, tablet::TabletHotKeysPB> by_tablet_id;
+  for (const auto& desc : descs) {
+    for (auto& reported : desc->hot_tablets()) {
+      if (!ContainsKey(tablet_ids, reported.tablet_id())) {
+        continue;
+      }
+      // Writes are applied by every replica, but reads are mostly served by
+      // the leader: the busiest replica is the most representative.
+      tablet::TabletHotKeysPB* hottest = &by_tablet_id[reported.tablet_id()];
+      if (reported.estimated_ops() > hottest->estimated_ops()) {
+        *hottest = std::move(reported);
+      }
+    }
+  }
+  hot_tablets->clear();
+  hot_tablets->reserve(by_tablet_id.size());
+  for (auto& e : by_tablet_id) {
+    hot_tablets->emplace_back(std::move(e.second));
+  }
+  std::sort(hot_tablets->begin(), hot_tablets->end(),
+            [](const tablet::TabletHotKeysPB& a, const tablet::TabletHotKeysPB& b) {
+              return a.estimated_ops() > b.estimated_ops();
+            });
+}
+
+int64_t TSManager::registration_version() const {
+  shared_lock<rw_spinlock> l(lock_);
+  return registration_version_;
+}
+
 int TSManager::GetCount() const {
   shared_lock<rw_spinlock> l(lock_);
   return servers_by_id_.size();
@@ -17,9 +17,11 @@
 #ifndef KUDU_MASTER_TS_MANAGER_H
 #define KUDU_MASTER_TS_MANAGER_H
 
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "kudu/gutil/macros.h"
@@ -31,6 +33,10 @@ namespace kudu {
 class NodeInstancePB;
 class ServerRegistrationPB;
 
+namespace tablet {
+class TabletHotKeysPB;
+} // namespace tablet
+
 namespace master {
 
 class TSDescriptor;
@@ -80,12 +86,27 @@ class TSManager {
   // heartbeat recently, indicating that they're alive and well.
   void GetAllLiveDescriptors(std::vector<std::shared_ptr<TSDescriptor> >* descs) const;
 
+  // Rolls up the hot tablet replicas reported by the live tablet servers,
+  // for the tablets in 'tablet_ids', into 'hot_tablets': for each tablet, the
+  // report of its replica with the most estimated recent row operations. The
+  // tablets are in decreasing order of estimated recent row operations.
+  void GetHotTablets(const std::unordered_set<std::string>& tablet_ids,
+                     std::vector<tablet::TabletHotKeysPB>* hot_tablets) const;
+
   // Get the TS count.
   int GetCount() const;
 
+  // Returns the number of registrations and re-registrations of tablet
+  // servers so far: it changes whenever the addresses of a tablet server may
+  // have changed.
+  int64_t registration_version() const;
+
  private:
   mutable rw_spinlock lock_;
 
+  // See registration_version(). Protected by 'lock_'.
+  int64_t registration_version_;
+
   typedef std::unordered_map<
     std::string, std::shared_ptr<TSDescriptor> > TSDescriptorMap;
   TSDescriptorMap servers_by_id_;
@@ -17,8 +17,10 @@
 
 #include "kudu/rpc/acceptor_pool.h"
 
+#include <memory>
 #include <string>
 #include <ostream>
+#include <utility>
 #include <vector>
 
 #include <gflags/gflags.h>
@@ -46,6 +48,7 @@ class Message;
 
 using google::protobuf::Message;
 using std::string;
+using std::unique_ptr;
 
 METRIC_DEFINE_counter(server, rpc_connections_accepted,
                       "RPC Connections Accepted",
@@ -61,6 +64,13 @@ DEFINE_int32(rpc_acceptor_listen_backlog, 128,
              "new inbound connection requests.");
 TAG_FLAG(rpc_acceptor_listen_backlog, advanced);
 
+DEFINE_bool(rpc_acceptor_reuse_port, false,
+            "Whether every RPC reactor should listen for, and accept, connections "
+            "on a socket of its own, bound to the RPC address with SO_REUSEPORT "
+            "so that the kernel balances new connections across the sockets. "
+            "Helps accepting storms of new connections. Requires Linux 3.9 or later.");
+TAG_FLAG(rpc_acceptor_reuse_port, experimental);
+
 namespace kudu {
 namespace rpc {
 
@@ -80,15 +90,43 @@ AcceptorPool::~AcceptorPool() {
 Status AcceptorPool::Start(int num_threads) {
   RETURN_NOT_OK(socket_.Listen(FLAGS_rpc_acceptor_listen_backlog));
 
-  for (int i = 0; i < num_threads; i++) {
-    scoped_refptr<kudu::Thread> new_thread;
-    Status s = kudu::Thread::Create("acceptor pool", "acceptor",
-        &AcceptorPool::RunThread, this, &new_thread);
-    if (!s.ok()) {
-      Shutdown();
-      return s;
+  Status s;
+  if (FLAGS_rpc_acceptor_reuse_port) {
+    s = StartPerReactorThreads();
+  } else {
+    for (int i = 0; i < num_threads && s.ok(); i++) {
+      s = StartThread(&socket_, -1);
     }
-    threads_.push_back(new_thread);
+  }
+  if (!s.ok()) {
+    Shutdown();
+    return s;
+  }
+  return Status::OK();
+}
+
+Status AcceptorPool::StartThread(Socket* socket, int reactor_idx) {
+  scoped_refptr<kudu::Thread> new_thread;
+  RETURN_NOT_OK(kudu::Thread::Create("acceptor pool", "acceptor",
+      &AcceptorPool::RunThread, this, socket, reactor_idx, &new_thread));
+  threads_.push_back(new_thread);
+  return Status::OK();
+}
+
+Status AcceptorPool::StartPerReactorThreads() {
+  // The other sockets bind to the port 'socket_' got, in case any port was asked for.
+  Sockaddr bound_addr;
+  RETURN_NOT_OK(socket_.GetSocketAddress(&bound_addr));
+  RETURN_NOT_OK(StartThread(&socket_, 0));
+  for (int i = 1; i < messenger_->num_reactors(); i++) {
+    unique_ptr<Socket> sock(new Socket());
+    RETURN_NOT_OK(sock->Init(0));
+    RETURN_NOT_OK(sock->SetReuseAddr(true));
+    RETURN_NOT_OK(sock->SetReusePort(true));
+    RETURN_NOT_OK(sock->Bind(bound_addr));
+    RETURN_NOT_OK(sock->Listen(FLAGS_rpc_acceptor_listen_backlog));
+    reuse_port_sockets_.emplace_back(std::move(sock));
+    RETURN_NOT_OK(StartThread(reuse_port_sockets_.back().get(), i));
   }
   return Status::OK();
 }
@@ -106,6 +144,11 @@ void AcceptorPool::Shutdown() {
   WARN_NOT_OK(socket_.Shutdown(true, true),
               strings::Substitute("Could not shut down acceptor socket on $0",
                                   bind_address_.ToString()));
+  for (const auto& socket : reuse_port_sockets_) {
+    WARN_NOT_OK(socket->Shutdown(true, true),
+                strings::Substitute("Could not shut down acceptor socket on $0",
+                                    bind_address_.ToString()));
+  }
 #else
   // Calling shutdown on an accepting (non-connected) socket is illegal on most
   // platforms (but not Linux). Instead, the accepting threads are interrupted
@@ -129,6 +172,9 @@ void AcceptorPool::Shutdown() {
   // here, it would  necessary to wait until Messenger::Shutdown() is called for
   // the corresponding messenger object to close this socket.
   ignore_result(socket_.Close());
+  for (const auto& socket : reuse_port_sockets_) {
+    ignore_result(socket->Close());
+  }
 }
 
 Sockaddr AcceptorPool::bind_address() const {
@@ -139,13 +185,13 @@ Status AcceptorPool::GetBoundAddress(Sockaddr* addr) const {
   return socket_.GetSocketAddress(addr);
 }
 
-void AcceptorPool::RunThread() {
+void AcceptorPool::RunThread(Socket* socket, int reactor_idx) {
   while (true) {
     Socket new_sock;
     Sockaddr remote;
-    VLOG(2) << "calling accept() on socket " << socket_.GetFd()
+    VLOG(2) << "calling accept() on socket " << socket->GetFd()
             << " listening on " << bind_address_.ToString();
-    Status s = socket_.Accept(&new_sock, &remote, Socket::FLAG_NONBLOCKING);
+    Status s = socket->Accept(&new_sock, &remote, Socket::FLAG_NONBLOCKING);
     if (!s.ok()) {
       if (Release_Load(&closing_)) {
         break;
@@ -162,7 +208,11 @@ void AcceptorPool::RunThread() {
       continue;
     }
     rpc_connections_accepted_->Increment();
-    messenger_->RegisterInboundSocket(&new_sock, remote);
+    if (reactor_idx < 0) {
+      messenger_->RegisterInboundSocket(&new_sock, remote);
+    } else {
+      messenger_->RegisterInboundSocket(&new_sock, remote, reactor_idx);
+    }
   }
   VLOG(1) << "AcceptorPool shutting down.";
 }
@@ -18,6 +18,7 @@
 #ifndef KUDU_RPC_ACCEPTOR_POOL_H
 #define KUDU_RPC_ACCEPTOR_POOL_H
 
+#include <memory>
 #include <vector>
 
 #include "kudu/gutil/atomicops.h"
@@ -39,6 +40,12 @@ class Messenger;
 // A pool of threads calling accept() to create new connections.
 // Acceptor pool threads terminate when they notice that the messenger has been
 // shut down, if Shutdown() is called, or if the pool object is destructed.
+//
+// With --rpc_acceptor_reuse_port, every reactor of the messenger gets a
+// listening socket of its own, bound to the same address with SO_REUSEPORT,
+// and an acceptor thread which hands the connections accepted on the socket
+// to the reactor. The kernel then balances new connections across the
+// sockets, rather than all of the acceptor threads contending on one.
 class AcceptorPool {
  public:
   // Create a new acceptor pool.  Calls socket::Release to take ownership of the
@@ -47,7 +54,8 @@ class AcceptorPool {
   AcceptorPool(Messenger *messenger, Socket *socket, Sockaddr bind_address);
   ~AcceptorPool();
 
-  // Start listening and accepting connections.
+  // Start listening and accepting connections, with 'num_threads' acceptor
+  // threads, or with one thread per reactor with --rpc_acceptor_reuse_port.
   Status Start(int num_threads);
   void Shutdown();
 
@@ -61,10 +69,23 @@ class AcceptorPool {
   Status GetBoundAddress(Sockaddr* addr) const;
 
  private:
-  void RunThread();
+  // Starts a thread accepting connections on 'socket', and handing them to
+  // the reactor of index 'reactor_idx', or to the reactor their remote
+  // address maps to if negative.
+  Status StartThread(Socket* socket, int reactor_idx);
+
+  // Starts the acceptor threads of --rpc_acceptor_reuse_port.
+  Status StartPerReactorThreads();
+
+  void RunThread(Socket* socket, int reactor_idx);
 
   Messenger *messenger_;
   Socket socket_;
+
+  // With --rpc_acceptor_reuse_port, the listening sockets of the reactors
+  // other than the first one, which listens on 'socket_'.
+  std::vector<std::unique_ptr<Socket>> reuse_port_sockets_;
+
   Sockaddr bind_address_;
   std::vector<scoped_refptr<kudu::Thread> > threads_;
 
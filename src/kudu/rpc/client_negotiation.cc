@@ -187,17 +187,24 @@ Status ClientNegotiation::Negotiate(unique_ptr<ErrorStatusPB>* rpc_error) {
       tls_handshake_.set_verification_mode(security::TlsVerificationMode::VERIFY_NONE);
     }
 
+    Sockaddr peer;
+    if (ContainsKey(server_features_, TLS_SESSION_RESUMPTION) &&
+        socket_->GetPeerAddress(&peer).ok()) {
+      tls_session_peer_ = peer.ToString();
+      tls_context_->ResumeSession(*tls_session_peer_, &tls_handshake_);
+    }
+
     // To initiate the TLS handshake, we pretend as if the server sent us an
     // empty TLS_HANDSHAKE token.
     NegotiatePB initial;
     initial.set_step(NegotiatePB::TLS_HANDSHAKE);
     initial.set_tls_handshake("");
-    Status s = HandleTlsHandshake(initial);
+    Status s = HandleTlsHandshake(initial, &recv_buf, rpc_error);
 
     while (s.IsIncomplete()) {
       NegotiatePB response;
       RETURN_NOT_OK(RecvNegotiatePB(&response, &recv_buf, rpc_error));
-      s = HandleTlsHandshake(response);
+      s = HandleTlsHandshake(response, &recv_buf, rpc_error);
     }
     RETURN_NOT_OK(s);
     tls_negotiated_ = true;
@@ -458,7 +465,9 @@ Status ClientNegotiation::SendTlsHandshake(string tls_token) {
   return SendNegotiatePB(msg);
 }
 
-Status ClientNegotiation::HandleTlsHandshake(const NegotiatePB& response) {
+Status ClientNegotiation::HandleTlsHandshake(const NegotiatePB& response,
+                                             faststring* recv_buf,
+                                             unique_ptr<ErrorStatusPB>* rpc_error) {
   if (PREDICT_FALSE(response.step() != NegotiatePB::TLS_HANDSHAKE)) {
     return Status::NotAuthorized("expected TLS_HANDSHAKE step",
                                  NegotiatePB::NegotiateStep_Name(response.step()));
@@ -480,17 +489,34 @@ Status ClientNegotiation::HandleTlsHandshake(const NegotiatePB& response) {
   // an Incomplete status.
   RETURN_NOT_OK(s);
 
+  if (!token.empty()) {
+    // The handshake finished on this end first, as it does when resuming a
+    // session: the server still needs our final token, and responds once done.
+    RETURN_NOT_OK(SendTlsHandshake(std::move(token)));
+    NegotiatePB final_response;
+    RETURN_NOT_OK(RecvNegotiatePB(&final_response, recv_buf, rpc_error));
+    if (PREDICT_FALSE(final_response.step() != NegotiatePB::TLS_HANDSHAKE)) {
+      return Status::NotAuthorized("expected TLS_HANDSHAKE step",
+                                   NegotiatePB::NegotiateStep_Name(final_response.step()));
+    }
+  }
+  TRACE("TLS session $0", tls_handshake_.session_reused() ? "resumed" : "negotiated");
+
   // TLS handshake is finished.
   if (ContainsKey(server_features_, TLS_AUTHENTICATION_ONLY) &&
       ContainsKey(client_features_, TLS_AUTHENTICATION_ONLY)) {
     TRACE("Negotiated auth-only $0 with cipher $1",
           tls_handshake_.GetProtocol(), tls_handshake_.GetCipherDescription());
-    return tls_handshake_.FinishNoWrap(*socket_);
+    RETURN_NOT_OK(tls_handshake_.FinishNoWrap(*socket_));
+  } else {
+    TRACE("Negotiated $0 with cipher $1",
+          tls_handshake_.GetProtocol(), tls_handshake_.GetCipherDescription());
+    RETURN_NOT_OK(tls_handshake_.Finish(&socket_));
   }
-
-  TRACE("Negotiated $0 with cipher $1",
-        tls_handshake_.GetProtocol(), tls_handshake_.GetCipherDescription());
-  return tls_handshake_.Finish(&socket_);
+  if (tls_session_peer_) {
+    tls_context_->SaveSession(*tls_session_peer_, &tls_handshake_);
+  }
+  return Status::OK();
 }
 
 Status ClientNegotiation::AuthenticateBySasl(faststring* recv_buf,
@@ -169,7 +169,10 @@ class ClientNegotiation {
   Status SendTlsHandshake(std::string tls_token) WARN_UNUSED_RESULT;
 
   // Handle a TLS_HANDSHAKE response message from the server.
-  Status HandleTlsHandshake(const NegotiatePB& response) WARN_UNUSED_RESULT;
+  // 'recv_buf' allows a receive buffer to be reused.
+  Status HandleTlsHandshake(const NegotiatePB& response,
+                            faststring* recv_buf,
+                            std::unique_ptr<ErrorStatusPB>* rpc_error) WARN_UNUSED_RESULT;
 
   // Authenticate to the server using SASL.
   // 'recv_buf' allows a receive buffer to be reused.
@@ -223,6 +226,9 @@ class ClientNegotiation {
   // TLS state.
   const security::TlsContext* tls_context_;
   security::TlsHandshake tls_handshake_;
+  // The peer the TLS session of the handshake is saved for, if the server
+  // supports session resumption.
+  boost::optional<std::string> tls_session_peer_;
   const RpcEncryption encryption_;
   bool tls_negotiated_;
 
@@ -501,7 +501,7 @@ void Connection::ReadHandler(ev::io &watcher, int revents) {
 
   while (true) {
     if (!inbound_) {
-      inbound_.reset(new InboundTransfer());
+      inbound_.reset(new InboundTransfer(reactor_thread_->transfer_buffer_pool()));
     }
     Status status = inbound_->ReceiveBuffer(*socket_);
     if (PREDICT_FALSE(!status.ok())) {
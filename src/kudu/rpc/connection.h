@@ -111,6 +111,12 @@ class Connection : public RefCountedThreadSafe<Connection> {
   // message, and we have no outstanding calls.
   bool Idle() const;
 
+  // Returns the number of outbound calls queued on, or awaiting a response
+  // from, this connection. Must be called from the reactor thread.
+  size_t num_outstanding_calls() const {
+    return awaiting_response_.size();
+  }
+
   // Fail any calls which are currently queued or awaiting response.
   // Prohibits any future calls (they will be failed immediately with this
   // same Status).
@@ -202,6 +208,12 @@ class Connection : public RefCountedThreadSafe<Connection> {
     remote_features_ = std::move(remote_features);
   }
 
+  // The RPC features supported by the remote end. Set once negotiation is
+  // complete, and immutable thereafter.
+  const std::set<RpcFeatureFlag>& remote_features() const {
+    return remote_features_;
+  }
+
   void set_remote_user(RemoteUser user) {
     DCHECK_EQ(direction_, SERVER);
     remote_user_ = std::move(user);
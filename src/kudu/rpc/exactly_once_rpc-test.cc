@@ -400,9 +400,9 @@ TEST_F(ExactlyOnceRpcTest, TestExactlyOnceSemanticsAfterRpcCompleted) {
     // Send the request the first time.
     ASSERT_OK(proxy_->AddExactlyOnce(req, &original_resp, &controller));
 
-    // The incremental usage of a new client is the size of the response itself
+    // The incremental usage of a new client is the size of the serialized response
     // plus some fixed overhead for the client-tracking structure.
-    int expected_incremental_usage = original_resp.SpaceUsed() + 200;
+    int expected_incremental_usage = original_resp.ByteSize() + 200;
 
     int mem_consumption_after = mem_tracker_->consumption();
     ASSERT_GT(mem_consumption_after - mem_consumption, expected_incremental_usage);
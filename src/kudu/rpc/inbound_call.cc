@@ -17,28 +17,38 @@
 
 #include "kudu/rpc/inbound_call.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <memory>
 #include <ostream>
 
+#include <boost/algorithm/string/predicate.hpp>
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <google/protobuf/message.h>
 #include <google/protobuf/message_lite.h>
 
+#include "kudu/gutil/map-util.h"
 #include "kudu/gutil/move.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/rpc/connection.h"
+#include "kudu/rpc/reactor.h"
 #include "kudu/rpc/rpc_introspection.pb.h"
 #include "kudu/rpc/rpc_sidecar.h"
 #include "kudu/rpc/rpcz_store.h"
 #include "kudu/rpc/serialization.h"
 #include "kudu/rpc/service_if.h"
 #include "kudu/rpc/transfer.h"
+#include "kudu/util/compression/compression.pb.h"
+#include "kudu/util/compression/compression_codec.h"
 #include "kudu/util/debug/trace_event.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/net/sockaddr.h"
+#include "kudu/util/probes.h"
 #include "kudu/util/trace.h"
+#include "kudu/util/trace_spans.h"
 
 namespace google {
 namespace protobuf {
@@ -54,9 +64,36 @@ using std::unique_ptr;
 using std::vector;
 using strings::Substitute;
 
+DEFINE_string(rpc_sidecar_compression_codec, "none",
+              "The codec with which RPC servers compress the sidecars of their "
+              "responses, which carry e.g. scan results, for the clients supporting "
+              "it. One of 'none', 'lz4', 'snappy', 'zlib' or 'zstd'. Worth its CPU "
+              "cost on bandwidth-limited networks.");
+TAG_FLAG(rpc_sidecar_compression_codec, experimental);
+TAG_FLAG(rpc_sidecar_compression_codec, runtime);
+
+DEFINE_int32(rpc_sidecar_compression_min_bytes, 64 * 1024,
+             "The minimum size of the RPC response sidecars compressed per "
+             "--rpc_sidecar_compression_codec, in bytes.");
+TAG_FLAG(rpc_sidecar_compression_min_bytes, experimental);
+TAG_FLAG(rpc_sidecar_compression_min_bytes, runtime);
+
+static bool ValidateSidecarCompressionCodec(const char* flagname, const std::string& value) {
+  if (kudu::GetCompressionCodecType(value) == kudu::NO_COMPRESSION &&
+      !boost::iequals(value, "none")) {
+    LOG(ERROR) << "Invalid value for " << flagname << ": " << value;
+    return false;
+  }
+  return true;
+}
+DEFINE_validator(rpc_sidecar_compression_codec, &ValidateSidecarCompressionCodec);
+
 namespace kudu {
 namespace rpc {
 
+const char* RPC_QUEUE_TIME_METRIC_NAME = "rpc_queue_time_us";
+const char* RPC_HANDLER_CPU_TIME_METRIC_NAME = "rpc_handler_cpu_time_us";
+
 InboundCall::InboundCall(Connection* conn)
   : conn_(conn),
     trace_(new Trace),
@@ -81,6 +118,14 @@ Status InboundCall::ParseFrom(gscoped_ptr<InboundTransfer> transfer) {
   }
   remote_method_.FromPB(header_.remote_method());
 
+  // Continue the caller's distributed trace, or start sampling a new one.
+  if (header_.has_trace_context() && header_.trace_context().trace_id() != 0) {
+    trace_->StartSpan(header_.trace_context().trace_id(),
+                      header_.trace_context().parent_span_id());
+  } else if (TraceSpanCollector::ShouldSampleNewTrace()) {
+    trace_->StartSpan(TraceSpanCollector::NewId(), 0);
+  }
+
   if (header_.sidecar_offsets_size() > TransferLimits::kMaxSidecars) {
     return Status::Corruption(strings::Substitute(
             "Received $0 additional payload slices, expected at most %d",
@@ -126,6 +171,16 @@ void InboundCall::RespondFailure(ErrorStatusPB::RpcErrorCodePB error_code,
   Respond(err, false);
 }
 
+void InboundCall::RespondServerTooBusy(const Status& status, const MonoDelta& retry_after) {
+  TRACE_EVENT0("rpc", "InboundCall::RespondServerTooBusy");
+  ErrorStatusPB err;
+  err.set_message(status.ToString());
+  err.set_code(ErrorStatusPB::ERROR_SERVER_TOO_BUSY);
+  err.set_retry_after_ms(std::max<int64_t>(retry_after.ToMilliseconds(), 1));
+
+  Respond(err, false);
+}
+
 void InboundCall::RespondApplicationError(int error_ext_id, const std::string& message,
                                           const MessageLite& app_error_pb) {
   ErrorStatusPB err;
@@ -177,6 +232,7 @@ void InboundCall::SerializeResponseBuffer(const MessageLite& response,
   ResponseHeader resp_hdr;
   resp_hdr.set_call_id(header_.call_id());
   resp_hdr.set_is_error(!is_success);
+  MaybeCompressSidecars(&resp_hdr);
   uint32_t absolute_sidecar_offset = protobuf_msg_size;
   for (const unique_ptr<RpcSidecar>& car : outbound_sidecars_) {
     resp_hdr.add_sidecar_offsets(absolute_sidecar_offset);
@@ -191,6 +247,41 @@ void InboundCall::SerializeResponseBuffer(const MessageLite& response,
                                  &response_hdr_buf_);
 }
 
+void InboundCall::MaybeCompressSidecars(ResponseHeader* resp_hdr) {
+  const size_t min_bytes = std::max(FLAGS_rpc_sidecar_compression_min_bytes, 0);
+  const CompressionCodec* codec = nullptr;
+  for (size_t i = 0; i < outbound_sidecars_.size(); i++) {
+    Slice sidecar = outbound_sidecars_[i]->AsSlice();
+    if (sidecar.size() < min_bytes) {
+      continue;
+    }
+    if (!codec) {
+      CompressionType type = GetCompressionCodecType(FLAGS_rpc_sidecar_compression_codec);
+      if (type == NO_COMPRESSION ||
+          !ContainsKey(conn_->remote_features(), SIDECAR_COMPRESSION) ||
+          !GetCompressionCodec(type, &codec).ok()) {
+        return;
+      }
+    }
+    unique_ptr<RpcSidecar> compressed = RpcSidecar::Compress(*codec, sidecar);
+    if (!compressed) {
+      continue;
+    }
+    CompressedSidecarPB* pb = resp_hdr->add_compressed_sidecars();
+    pb->set_idx(i);
+    pb->set_codec(codec->type());
+    pb->set_uncompressed_size(sidecar.size());
+
+    ReactorThread* reactor_thread = conn_->reactor_thread();
+    if (reactor_thread->sidecar_bytes_compressed()) {
+      reactor_thread->sidecar_bytes_compressed()->IncrementBy(sidecar.size());
+      reactor_thread->sidecar_compression_bytes_saved()->IncrementBy(
+          sidecar.size() - compressed->AsSlice().size());
+    }
+    outbound_sidecars_[i] = std::move(compressed);
+  }
+}
+
 size_t InboundCall::SerializeResponseTo(TransferPayload* slices) const {
   TRACE_EVENT0("rpc", "InboundCall::SerializeResponseTo");
   DCHECK_GT(response_hdr_buf_.size(), 0);
@@ -270,14 +361,25 @@ void InboundCall::RecordHandlingStarted(scoped_refptr<Histogram> incoming_queue_
   DCHECK(incoming_queue_time != nullptr);
   DCHECK(!timing_.time_handled.Initialized());  // Protect against multiple calls.
   timing_.time_handled = MonoTime::Now();
-  incoming_queue_time->Increment(
-      (timing_.time_handled - timing_.time_received).ToMicroseconds());
+  int64_t queue_time_us = (timing_.time_handled - timing_.time_received).ToMicroseconds();
+  KUDU_PROBE(rpc_queue_exit, remote_method_.method_name().c_str(), call_id(), queue_time_us);
+  incoming_queue_time->Increment(queue_time_us);
+  trace_->metrics()->Increment(RPC_QUEUE_TIME_METRIC_NAME, queue_time_us);
+  trace_->RecordChildSpan("queue_wait", timing_.time_received, timing_.time_handled);
+  if (method_info_ && method_info_->queue_time_histogram) {
+    method_info_->queue_time_histogram->Increment(queue_time_us);
+  }
 }
 
 void InboundCall::RecordHandlingCompleted() {
   DCHECK(!timing_.time_completed.Initialized());  // Protect against multiple calls.
   timing_.time_completed = MonoTime::Now();
 
+  if (trace_->span_context().sampled()) {
+    trace_->RecordSpan(remote_method_.ToString(), timing_.time_received, timing_.time_completed,
+                       { { "peer", remote_address().ToString() } });
+  }
+
   if (!timing_.time_handled.Initialized()) {
     // Sometimes we respond to a call before we begin handling it (e.g. due to queue
     // overflow, etc). These cases should not be counted against the histogram.
@@ -59,6 +59,12 @@ class RemoteUser;
 class RpcCallInProgressPB;
 class RpcSidecar;
 
+// Names of the trace metrics recording the microseconds an inbound call waited
+// in the service queue, and the CPU time the thread handling it spent in the
+// service's handler.
+extern const char* RPC_QUEUE_TIME_METRIC_NAME;
+extern const char* RPC_HANDLER_CPU_TIME_METRIC_NAME;
+
 struct InboundCallTiming {
   MonoTime time_received;   // Time the call was first accepted.
   MonoTime time_handled;    // Time the call handler was kicked off.
@@ -114,6 +120,10 @@ class InboundCall {
   void RespondFailure(ErrorStatusPB::RpcErrorCodePB error_code,
                       const Status &status);
 
+  // Like RespondFailure() with ERROR_SERVER_TOO_BUSY, additionally hinting
+  // the client to wait at least 'retry_after' before retrying the call.
+  void RespondServerTooBusy(const Status& status, const MonoDelta& retry_after);
+
   void RespondUnsupportedFeature(const std::vector<uint32_t>& unsupported_features);
 
   void RespondApplicationError(int error_ext_id, const std::string& message,
@@ -172,8 +182,9 @@ class InboundCall {
   void RecordCallReceived();
 
   // When RPC call Handle() was called on the server side.
-  // Updates the Histogram with time elapsed since the call was received,
-  // and should only be called once on a given instance.
+  // Updates the Histogram, the method's queue time histogram and the trace
+  // with time elapsed since the call was received, and should only be called
+  // once on a given instance.
   // Not thread-safe. Should only be called by the current "owner" thread.
   void RecordHandlingStarted(scoped_refptr<Histogram> incoming_queue_time);
 
@@ -219,6 +230,10 @@ class InboundCall {
   void SerializeResponseBuffer(const google::protobuf::MessageLite& response,
                                bool is_success);
 
+  // Compresses the outbound sidecars per --rpc_sidecar_compression_codec, if
+  // the client supports it, and describes the compressed ones in 'resp_hdr'.
+  void MaybeCompressSidecars(ResponseHeader* resp_hdr);
+
   // When RPC call Handle() completed execution on the server side.
   // Updates the Histogram with time elapsed since the call was started,
   // and should only be called once on a given instance.
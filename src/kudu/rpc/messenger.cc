@@ -119,6 +119,7 @@ TAG_FLAG(rpc_default_keepalive_time_ms, advanced);
 
 DECLARE_string(keytab_file);
 DECLARE_bool(allow_world_readable_credentials);
+DECLARE_bool(rpc_acceptor_reuse_port);
 
 namespace boost {
 template <typename Signature> class function;
@@ -409,6 +410,9 @@ Status Messenger::AddAcceptorPool(const Sockaddr &accept_addr,
   Socket sock;
   RETURN_NOT_OK(sock.Init(0));
   RETURN_NOT_OK(sock.SetReuseAddr(true));
+  if (FLAGS_rpc_acceptor_reuse_port) {
+    RETURN_NOT_OK(sock.SetReusePort(true));
+  }
   RETURN_NOT_OK(sock.Bind(accept_addr));
   Sockaddr remote;
   RETURN_NOT_OK(sock.GetSocketAddress(&remote));
@@ -488,6 +492,13 @@ void Messenger::RegisterInboundSocket(Socket *new_socket, const Sockaddr &remote
   reactor->RegisterInboundSocket(new_socket, remote);
 }
 
+void Messenger::RegisterInboundSocket(Socket *new_socket, const Sockaddr &remote,
+                                      int reactor_idx) {
+  DCHECK_GE(reactor_idx, 0);
+  DCHECK_LT(reactor_idx, reactors_.size());
+  reactors_[reactor_idx]->RegisterInboundSocket(new_socket, remote);
+}
+
 Messenger::Messenger(const MessengerBuilder &bld)
   : name_(bld.name_),
     closing_(false),
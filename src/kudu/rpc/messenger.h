@@ -215,6 +215,10 @@ class Messenger {
   // Take ownership of the socket via Socket::Release
   void RegisterInboundSocket(Socket *new_socket, const Sockaddr &remote);
 
+  // As above, but hands the socket to the reactor of index 'reactor_idx'
+  // rather than to the one 'remote' maps to.
+  void RegisterInboundSocket(Socket *new_socket, const Sockaddr &remote, int reactor_idx);
+
   // Dump the current RPCs into the given protobuf.
   Status DumpRunningRpcs(const DumpRunningRpcsRequestPB& req,
                          DumpRunningRpcsResponsePB* resp);
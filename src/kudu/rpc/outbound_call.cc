@@ -44,6 +44,7 @@
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/kernel_stack_watchdog.h"
 #include "kudu/util/net/sockaddr.h"
+#include "kudu/util/trace.h"
 
 // 100M cycles should be about 50ms on a 2Ghz box. This should be high
 // enough that involuntary context switches don't trigger it, but low enough
@@ -103,6 +104,15 @@ OutboundCall::OutboundCall(const ConnectionId& conn_id,
   if (controller_->request_id_) {
     header_.set_allocated_request_id(controller_->request_id_.release());
   }
+
+  // If this call is made on behalf of a sampled distributed trace, propagate
+  // it so that the callee's spans are recorded as children of the caller's.
+  const Trace* trace = Trace::CurrentTrace();
+  if (trace && trace->span_context().sampled()) {
+    TraceContextPB* context = header_.mutable_trace_context();
+    context->set_trace_id(trace->span_context().trace_id);
+    context->set_parent_span_id(trace->span_context().span_id);
+  }
 }
 
 OutboundCall::~OutboundCall() {
@@ -515,6 +525,8 @@ Status CallResponse::ParseFrom(gscoped_ptr<InboundTransfer> transfer) {
   // Use information from header to extract the payload slices.
   RETURN_NOT_OK(RpcSidecar::ParseSidecars(header_.sidecar_offsets(),
           serialized_response_, sidecar_slices_));
+  RETURN_NOT_OK(RpcSidecar::UncompressSidecars(header_.compressed_sidecars(),
+          header_.sidecar_offsets_size(), sidecar_slices_, &uncompressed_sidecars_));
 
   if (header_.sidecar_offsets_size() > 0) {
     serialized_response_ =
@@ -331,9 +331,13 @@ class CallResponse {
   // This slice refers to memory allocated by transfer_
   Slice serialized_response_;
 
-  // Slices of data for rpc sidecars. They point into memory owned by transfer_.
+  // Slices of data for rpc sidecars. They point into memory owned by transfer_,
+  // or by uncompressed_sidecars_ for the sidecars received compressed.
   Slice sidecar_slices_[TransferLimits::kMaxSidecars];
 
+  // The sidecars received compressed, uncompressed.
+  std::vector<std::unique_ptr<faststring>> uncompressed_sidecars_;
+
   // The incoming transfer data - retained because serialized_response_
   // and sidecar_slices_ refer into its data.
   gscoped_ptr<InboundTransfer> transfer_;
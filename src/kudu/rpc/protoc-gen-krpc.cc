@@ -208,6 +208,9 @@ class MethodSubstitutions : public Substituter {
     bool track_result = static_cast<bool>(method_->options().GetExtension(track_rpc_result));
     (*map)["track_result"] = track_result ? " true" : "false";
     (*map)["authz_method"] = GetAuthzMethod(*method_).get_value_or("AuthorizeAllowAll");
+    (*map)["queue_class"] = RpcQueueClassPB_Name(method_->options().GetExtension(queue_class));
+    bool on_reactor = static_cast<bool>(method_->options().GetExtension(run_on_reactor));
+    (*map)["run_on_reactor"] = on_reactor ? "true" : "false";
   }
 
   // Strips the package from method arguments if they are in the same package as
@@ -468,7 +471,20 @@ class CodeGenerator : public ::google::protobuf::compiler::CodeGenerator {
           "  \"$rpc_full_name$ RPC Time\",\n"
           "  kudu::MetricUnit::kMicroseconds,\n"
           "  \"Microseconds spent handling $rpc_full_name$() RPC requests\",\n"
-          "  60000000LU, 2);\n"
+          "  60000000LU, 2, kudu::PER_CPU);\n"
+          "\n"
+          "METRIC_DEFINE_histogram(server, queue_time_$rpc_full_name_plainchars$,\n"
+          "  \"$rpc_full_name$ RPC Queue Time\",\n"
+          "  kudu::MetricUnit::kMicroseconds,\n"
+          "  \"Microseconds $rpc_full_name$() RPC requests waited in the service queue\",\n"
+          "  60000000LU, 2, kudu::PER_CPU);\n"
+          "\n"
+          "METRIC_DEFINE_histogram(server, handler_cpu_time_$rpc_full_name_plainchars$,\n"
+          "  \"$rpc_full_name$ RPC CPU Time\",\n"
+          "  kudu::MetricUnit::kMicroseconds,\n"
+          "  \"Microseconds of CPU time spent by the threads handling \"\n"
+          "  \"$rpc_full_name$() RPC requests, until handing them off or responding\",\n"
+          "  60000000LU, 2, kudu::PER_CPU);\n"
           "\n");
         subs->Pop();
       }
@@ -505,6 +521,7 @@ class CodeGenerator : public ::google::protobuf::compiler::CodeGenerator {
         Print(printer, *subs,
               "  {\n"
               "    scoped_refptr<RpcMethodInfo> mi(new RpcMethodInfo());\n"
+              "    mi->full_name = \"$rpc_full_name$\";\n"
               "    mi->req_prototype.reset(new $request$());\n"
               "    mi->resp_prototype.reset(new $response$());\n"
               "    mi->authz_method = [this](const Message* req, Message* resp,\n"
@@ -514,8 +531,14 @@ class CodeGenerator : public ::google::protobuf::compiler::CodeGenerator {
               "                           ctx);\n"
               "    };\n"
               "    mi->track_result = $track_result$;\n"
+              "    mi->queue_class = ::kudu::rpc::$queue_class$;\n"
+              "    mi->run_on_reactor = $run_on_reactor$;\n"
               "    mi->handler_latency_histogram =\n"
               "        METRIC_handler_latency_$rpc_full_name_plainchars$.Instantiate(entity);\n"
+              "    mi->queue_time_histogram =\n"
+              "        METRIC_queue_time_$rpc_full_name_plainchars$.Instantiate(entity);\n"
+              "    mi->handler_cpu_time_histogram =\n"
+              "        METRIC_handler_cpu_time_$rpc_full_name_plainchars$.Instantiate(entity);\n"
               "    mi->func = [this](const Message* req, Message* resp, RpcContext* ctx) {\n"
               "      this->$rpc_name$(static_cast<const $request$*>(req),\n"
               "                       static_cast<$response$*>(resp),\n"
@@ -17,12 +17,14 @@
 
 #include "kudu/rpc/reactor.h"
 
+#include <algorithm>
 #include <cerrno>
 #include <memory>
 #include <mutex>
 #include <ostream>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include <boost/bind.hpp> // IWYU pragma: keep
 #include <boost/intrusive/list.hpp>
@@ -34,6 +36,7 @@
 #include "kudu/gutil/bind.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/gutil/stringprintf.h"
+#include "kudu/gutil/sysinfo.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/rpc/client_negotiation.h"
 #include "kudu/rpc/connection.h"
@@ -42,6 +45,7 @@
 #include "kudu/rpc/outbound_call.h"
 #include "kudu/rpc/rpc_introspection.pb.h"
 #include "kudu/rpc/server_negotiation.h"
+#include "kudu/rpc/transfer.h"
 #include "kudu/util/countdown_latch.h"
 #include "kudu/util/debug/sanitizer_scopes.h"
 #include "kudu/util/flag_tags.h"
@@ -49,6 +53,7 @@
 #include "kudu/util/monotime.h"
 #include "kudu/util/net/sockaddr.h"
 #include "kudu/util/net/socket.h"
+#include "kudu/util/numa.h"
 #include "kudu/util/status.h"
 #include "kudu/util/thread.h"
 #include "kudu/util/thread_restrictions.h"
@@ -67,6 +72,7 @@ static const int kDefaultLibEvFlags = ev::AUTO;
 using std::string;
 using std::shared_ptr;
 using std::unique_ptr;
+using std::vector;
 using strings::Substitute;
 
 DEFINE_int64(rpc_negotiation_timeout_ms, 3000,
@@ -85,13 +91,87 @@ DEFINE_bool(rpc_reopen_outbound_connections, false,
 TAG_FLAG(rpc_reopen_outbound_connections, unsafe);
 TAG_FLAG(rpc_reopen_outbound_connections, runtime);
 
+DEFINE_int32(rpc_max_calls_per_connection, 0,
+             "Maximum number of outstanding calls to multiplex over a single "
+             "outbound connection. Once every connection to a server has that "
+             "many calls outstanding, new calls spill over to an additional "
+             "connection. 0 means no limit, so that a single connection per "
+             "server and user is used.");
+TAG_FLAG(rpc_max_calls_per_connection, advanced);
+TAG_FLAG(rpc_max_calls_per_connection, runtime);
+
+DEFINE_int32(rpc_transfer_buffer_pool_capacity_mb, 16,
+             "Maximum size, in MB, of the free buffers which each reactor thread "
+             "keeps around to receive inbound RPC messages into, sparing the "
+             "allocation of a buffer for every message. If 0, every message is "
+             "received into a buffer of its own.");
+TAG_FLAG(rpc_transfer_buffer_pool_capacity_mb, advanced);
+
+DEFINE_bool(rpc_pin_reactor_threads, false,
+            "Whether to pin each RPC reactor thread to a CPU of its own, the "
+            "N-th reactor to the N-th CPU not in --rpc_busy_poll_reactor_cpus, "
+            "wrapping around if there are more reactors than CPUs. Keeps the connections of a reactor, and the "
+            "memory they receive messages into, local to a CPU.");
+TAG_FLAG(rpc_pin_reactor_threads, experimental);
+
+DEFINE_int32(rpc_busy_poll_reactors, 0,
+             "Number of RPC reactor threads of each messenger, starting from "
+             "the first, which busy-poll for network activity instead of "
+             "sleeping in epoll_wait(). This saves the latency of waking up "
+             "for every RPC at the cost of using up a whole CPU per "
+             "busy-polling reactor, which should be dedicated to it with "
+             "--rpc_busy_poll_reactor_cpus. Their busy time is still "
+             "reported by the reactor_load_percent metric.");
+TAG_FLAG(rpc_busy_poll_reactors, experimental);
+
+DEFINE_string(rpc_busy_poll_reactor_cpus, "",
+              "The CPUs to pin the busy-polling RPC reactor threads to, as a "
+              "list of CPU ids and ranges, e.g. '2-3,6'. The N-th busy-polling "
+              "reactor of each messenger is pinned to the N-th CPU of the list, "
+              "wrapping around if there are more such reactors than CPUs. The "
+              "reactors pinned by --rpc_pin_reactor_threads keep off these CPUs. "
+              "If empty, busy-polling reactors are only pinned as any other "
+              "reactor is. See --rpc_busy_poll_reactors.");
+TAG_FLAG(rpc_busy_poll_reactor_cpus, experimental);
+
+DEFINE_int32(rpc_busy_poll_usec, 50,
+             "If positive, the SO_BUSY_POLL value, in microseconds, set on "
+             "the sockets of the connections handled by busy-polling "
+             "reactors, letting the kernel poll the network device queue "
+             "for packets rather than waiting for an interrupt. Only used "
+             "if --rpc_busy_poll_reactors is positive.");
+TAG_FLAG(rpc_busy_poll_usec, experimental);
+
+namespace {
+
+bool ValidateBusyPollReactorCpus(const char* flagname, const string& value) {
+  vector<int> cpus;
+  kudu::Status s = kudu::ParseCpuList(value, &cpus);
+  if (!s.ok()) {
+    LOG(ERROR) << Substitute("Invalid value for --$0: $1", flagname, s.ToString());
+    return false;
+  }
+  for (int cpu : cpus) {
+    if (cpu >= base::NumCPUs()) {
+      LOG(ERROR) << Substitute("Invalid value for --$0: CPU $1 out of the $2 CPUs "
+                               "of this machine", flagname, cpu, base::NumCPUs());
+      return false;
+    }
+  }
+  return true;
+}
+DEFINE_validator(rpc_busy_poll_reactor_cpus, &ValidateBusyPollReactorCpus);
+
+} // anonymous namespace
+
 METRIC_DEFINE_histogram(server, reactor_load_percent,
                         "Reactor Thread Load Percentage",
                         kudu::MetricUnit::kUnits,
                         "The percentage of time that the reactor is busy "
                         "(not blocked awaiting network activity). If this metric "
                         "shows significant samples nears 100%, increasing the "
-                        "number of reactors may be beneficial.", 100, 2);
+                        "number of reactors may be beneficial.", 100, 2,
+                        kudu::PER_CPU);
 
 METRIC_DEFINE_histogram(server, reactor_active_latency_us,
                         "Reactor Thread Active Latency",
@@ -100,7 +180,19 @@ METRIC_DEFINE_histogram(server, reactor_active_latency_us,
                         "The reactor thread is responsible for all network I/O and "
                         "therefore outliers in this latency histogram directly contribute "
                         "to the latency of both inbound and outbound RPCs.",
-                        1000000, 2);
+                        1000000, 2, kudu::PER_CPU);
+
+METRIC_DEFINE_counter(server, rpc_sidecar_bytes_compressed,
+                      "RPC Sidecar Bytes Compressed",
+                      kudu::MetricUnit::kBytes,
+                      "Number of bytes of RPC response sidecars compressed before "
+                      "being sent. See --rpc_sidecar_compression_codec.");
+
+METRIC_DEFINE_counter(server, rpc_sidecar_compression_bytes_saved,
+                      "RPC Sidecar Compression Bytes Saved",
+                      kudu::MetricUnit::kBytes,
+                      "Number of bytes of RPC response sidecars not sent thanks to "
+                      "their compression. See --rpc_sidecar_compression_codec.");
 
 namespace kudu {
 namespace rpc {
@@ -128,6 +220,31 @@ void DoInitLibEv() {
   ev::set_syserr_cb(LibevSysErr);
 }
 
+// Returns the CPU to pin the thread of the reactor with index 'index' to, or
+// -1 if it isn't to be pinned. Busy-polling reactors go to the CPUs of
+// --rpc_busy_poll_reactor_cpus, and the reactors pinned by
+// --rpc_pin_reactor_threads to the remaining CPUs.
+int ReactorCpu(int index, bool busy_poll) {
+  vector<int> busy_poll_cpus;
+  CHECK_OK(ParseCpuList(FLAGS_rpc_busy_poll_reactor_cpus, &busy_poll_cpus));
+  if (busy_poll && !busy_poll_cpus.empty()) {
+    return busy_poll_cpus[index % busy_poll_cpus.size()];
+  }
+  if (!FLAGS_rpc_pin_reactor_threads) {
+    return -1;
+  }
+  vector<int> cpus;
+  for (int cpu = 0; cpu < base::NumCPUs(); cpu++) {
+    if (std::find(busy_poll_cpus.begin(), busy_poll_cpus.end(), cpu) == busy_poll_cpus.end()) {
+      cpus.push_back(cpu);
+    }
+  }
+  if (cpus.empty()) {
+    return index % base::NumCPUs();
+  }
+  return cpus[index % cpus.size()];
+}
+
 } // anonymous namespace
 
 ReactorThread::ReactorThread(Reactor *reactor, const MessengerBuilder& bld)
@@ -137,6 +254,10 @@ ReactorThread::ReactorThread(Reactor *reactor, const MessengerBuilder& bld)
     reactor_(reactor),
     connection_keepalive_time_(bld.connection_keepalive_time_),
     coarse_timer_granularity_(bld.coarse_timer_granularity_),
+    transfer_buffer_pool_(FLAGS_rpc_transfer_buffer_pool_capacity_mb > 0 ?
+        std::make_shared<TransferBufferPool>(
+            static_cast<int64_t>(FLAGS_rpc_transfer_buffer_pool_capacity_mb) * 1024 * 1024) :
+        nullptr),
     total_client_conns_cnt_(0),
     total_server_conns_cnt_(0) {
 
@@ -145,6 +266,10 @@ ReactorThread::ReactorThread(Reactor *reactor, const MessengerBuilder& bld)
         METRIC_reactor_active_latency_us.Instantiate(bld.metric_entity_);
     load_percent_histogram_ =
         METRIC_reactor_load_percent.Instantiate(bld.metric_entity_);
+    sidecar_bytes_compressed_ =
+        METRIC_rpc_sidecar_bytes_compressed.Instantiate(bld.metric_entity_);
+    sidecar_compression_bytes_saved_ =
+        METRIC_rpc_sidecar_compression_bytes_saved.Instantiate(bld.metric_entity_);
   }
 }
 
@@ -169,20 +294,40 @@ Status ReactorThread::Init() {
   ev_set_loop_release_cb(loop_, &ReactorThread::AboutToPollCb, &ReactorThread::PollCompleteCb);
   ev_set_invoke_pending_cb(loop_, &ReactorThread::InvokePendingCb);
 
+  busy_poll_ = reactor_->index() < FLAGS_rpc_busy_poll_reactors;
+
   // Create Reactor thread.
-  return kudu::Thread::Create("reactor", "rpc reactor", &ReactorThread::RunThread, this, &thread_);
+  RETURN_NOT_OK(kudu::Thread::Create("reactor", "rpc reactor",
+                                     &ReactorThread::RunThread, this, &thread_));
+  int cpu = ReactorCpu(reactor_->index(), busy_poll_);
+  if (cpu >= 0) {
+    WARN_NOT_OK(thread_->SetCpuAffinity(cpu), "Could not pin reactor thread");
+  }
+  return Status::OK();
 }
 
 void ReactorThread::InvokePendingCb(struct ev_loop* loop) {
+  ReactorThread* thr = static_cast<ReactorThread*>(ev_userdata(loop));
+  if (thr->busy_poll_ && ev_pending_count(loop) == 0) {
+    // The iteration of the busy-polling loop found nothing to do: account all
+    // of it as polling, so that the reactor's load reflects the time spent
+    // handling events, as it does for reactors sleeping in epoll_wait().
+    int64_t now = CycleClock::Now();
+    thr->total_poll_cycles_ += now - thr->busy_iteration_start_cycles_;
+    thr->busy_iteration_start_cycles_ = now;
+    return;
+  }
+
   // Calculate the number of cycles spent calling our callbacks.
   // This is called quite frequently so we use CycleClock rather than MonoTime
   // since it's a bit faster.
   int64_t start = CycleClock::Now();
   ev_invoke_pending(loop);
-  int64_t dur_cycles = CycleClock::Now() - start;
+  int64_t end = CycleClock::Now();
+  int64_t dur_cycles = end - start;
+  thr->busy_iteration_start_cycles_ = end;
 
   // Contribute this to our histogram.
-  ReactorThread* thr = static_cast<ReactorThread*>(ev_userdata(loop));
   if (thr->invoke_us_histogram_) {
     thr->invoke_us_histogram_->Increment(dur_cycles * 1e6 / base::CyclesPerSecond());
   }
@@ -206,7 +351,10 @@ void ReactorThread::PollCompleteCb(struct ev_loop* loop) noexcept {
 
   int64_t poll_cycles = cycle_clock_after_poll - thr->cycle_clock_before_poll_;
   thr->cycle_clock_before_poll_ = -1;
-  thr->total_poll_cycles_ += poll_cycles;
+  // Busy-polling reactors account their polling in InvokePendingCb().
+  if (!thr->busy_poll_) {
+    thr->total_poll_cycles_ += poll_cycles;
+  }
 }
 
 void ReactorThread::Shutdown(Messenger::ShutdownMode mode) {
@@ -301,6 +449,7 @@ void ReactorThread::AsyncHandler(ev::async& /*watcher*/, int /*revents*/) {
 
   if (PREDICT_FALSE(reactor_->closing())) {
     ShutdownInternal();
+    loop_stopped_ = true;
     loop_.break_loop(); // break the epoll loop and terminate the thread
     return;
   }
@@ -470,7 +619,16 @@ void ReactorThread::RunThread() {
   ThreadRestrictions::SetWaitAllowed(false);
   ThreadRestrictions::SetIOAllowed(false);
   DVLOG(6) << "Calling ReactorThread::RunThread()...";
-  loop_.run(0);
+  if (busy_poll_) {
+    // Poll with a zero timeout over and over, never going to sleep, until the
+    // loop is stopped.
+    busy_iteration_start_cycles_ = CycleClock::Now();
+    while (!loop_stopped_) {
+      loop_.run(EVRUN_NOWAIT);
+    }
+  } else {
+    loop_.run(0);
+  }
   VLOG(1) << name() << " thread exiting.";
 
   // No longer need the messenger. This causes the messenger to
@@ -493,7 +651,8 @@ bool ReactorThread::FindConnection(const ConnectionId& conn_id,
     //   shutdown. This process converges: any connection that satisfies the
     //   PRIMARY_CREDENTIALS policy automatically satisfies the ANY_CREDENTIALS
     //   policy as well. The idea is to keep only one usable connection
-    //   identified by the specified 'conn_id'.
+    //   identified by the specified 'conn_id', unless calls spill over to
+    //   additional connections per --rpc_max_calls_per_connection.
     //
     // * If the test-only 'one-connection-per-RPC' mode is enabled, connections
     //   are re-established at every RPC call.
@@ -509,15 +668,21 @@ bool ReactorThread::FindConnection(const ConnectionId& conn_id,
         continue;
       }
       c->set_scheduled_for_shutdown();
-    } else {
-      DCHECK(!found_conn);
-      found_conn = c;
+    } else if (!found_conn ||
+               c->num_outstanding_calls() < found_conn->num_outstanding_calls()) {
       // Appropriate connection is found; continue further to take care of the
       // rest of connections to mark them for shutdown if they are not
-      // satisfying the policy.
+      // satisfying the policy, and to find the least loaded one.
+      found_conn = c;
     }
     ++it;
   }
+  const int max_calls = FLAGS_rpc_max_calls_per_connection;
+  if (found_conn && max_calls > 0 &&
+      found_conn->num_outstanding_calls() >= static_cast<size_t>(max_calls)) {
+    // Every usable connection is at capacity: spill over to a new one.
+    return false;
+  }
   if (found_conn) {
     // Found matching not-to-be-shutdown connection: return it as the result.
     conn->swap(found_conn);
@@ -604,6 +769,11 @@ void ReactorThread::CompleteConnectionNegotiation(
     return;
   }
 
+  if (busy_poll_ && FLAGS_rpc_busy_poll_usec > 0) {
+    WARN_NOT_OK(conn->socket()->SetBusyPoll(FLAGS_rpc_busy_poll_usec),
+                "Unable to enable busy-polling on connection");
+  }
+
   conn->MarkNegotiationComplete();
   conn->EpollRegister(loop_);
 }
@@ -711,6 +881,7 @@ Reactor::Reactor(shared_ptr<Messenger> messenger,
                  int index, const MessengerBuilder& bld)
     : messenger_(std::move(messenger)),
       name_(StringPrintf("%s_R%03d", messenger_->name().c_str(), index)),
+      index_(index),
       closing_(false),
       thread_(this, bld) {
   static std::once_flag libev_once;
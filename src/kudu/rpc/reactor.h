@@ -55,6 +55,7 @@ class DumpRunningRpcsResponsePB;
 class OutboundCall;
 class Reactor;
 class ReactorThread;
+class TransferBufferPool;
 enum class CredentialsPolicy;
 
 // Simple metrics information from within a reactor.
@@ -176,6 +177,20 @@ class ReactorThread {
 
   MonoTime cur_time() const;
 
+  // The pool of the buffers which the connections of this reactor thread
+  // receive messages into, or null if buffers aren't pooled.
+  const std::shared_ptr<TransferBufferPool>& transfer_buffer_pool() const {
+    return transfer_buffer_pool_;
+  }
+
+  // Counters of the bytes of response sidecars compressed, and of the bytes
+  // saved by compressing them, or null without a metric entity. May be
+  // updated from any thread.
+  Counter* sidecar_bytes_compressed() const { return sidecar_bytes_compressed_.get(); }
+  Counter* sidecar_compression_bytes_saved() const {
+    return sidecar_compression_bytes_saved_.get();
+  }
+
   // This may be called from another thread.
   Reactor *reactor();
 
@@ -221,7 +236,9 @@ class ReactorThread {
   static void PollCompleteCb(struct ev_loop* loop) noexcept;
 
   // Find a connection to the given remote and returns it in 'conn'.
-  // Returns true if a connection is found. Returns false otherwise.
+  // Returns true if a connection is found. Returns false otherwise, including
+  // when every usable connection has --rpc_max_calls_per_connection calls
+  // outstanding.
   bool FindConnection(const ConnectionId& conn_id,
                       CredentialsPolicy cred_policy,
                       scoped_refptr<Connection>* conn);
@@ -308,9 +325,15 @@ class ReactorThread {
   // Scan for idle connections on this granularity.
   const MonoDelta coarse_timer_granularity_;
 
+  // See transfer_buffer_pool(). Shared with the inbound transfers, which may
+  // outlive the reactor thread.
+  const std::shared_ptr<TransferBufferPool> transfer_buffer_pool_;
+
   // Metrics.
   scoped_refptr<Histogram> invoke_us_histogram_;
   scoped_refptr<Histogram> load_percent_histogram_;
+  scoped_refptr<Counter> sidecar_bytes_compressed_;
+  scoped_refptr<Counter> sidecar_compression_bytes_saved_;
 
   // Total number of client connections opened during Reactor's lifetime.
   uint64_t total_client_conns_cnt_;
@@ -323,9 +346,22 @@ class ReactorThread {
   int64_t cycle_clock_before_poll_ = -1;
 
   // The total number of cycles spent in epoll_wait() since this thread
-  // started.
+  // started. For busy-polling reactors, this also includes the whole of the
+  // loop iterations which found nothing to do.
   int64_t total_poll_cycles_ = 0;
 
+  // Whether the reactor busy-polls rather than blocking in epoll_wait().
+  // See --rpc_busy_poll_reactors. Set before the thread starts.
+  bool busy_poll_ = false;
+
+  // Whether the loop was asked to stop. Only used by busy-polling reactors,
+  // whose loop runs one non-blocking iteration at a time.
+  bool loop_stopped_ = false;
+
+  // The cycle-time at which the current iteration of the busy-polling loop
+  // started.
+  int64_t busy_iteration_start_cycles_ = -1;
+
   // Accounting for determining load average in each cycle of TimerHandler.
   struct {
     // The cycle-time at which the load average was last calculated.
@@ -351,6 +387,11 @@ class Reactor {
 
   const std::string &name() const;
 
+  // The index of the reactor among the reactors of its messenger.
+  int index() const {
+    return index_;
+  }
+
   // Collect metrics about the reactor.
   Status GetMetrics(ReactorMetrics *metrics);
 
@@ -408,6 +449,8 @@ class Reactor {
 
   const std::string name_;
 
+  const int index_;
+
   // Whether the reactor is shutting down.
   // Guarded by lock_.
   bool closing_;
@@ -18,6 +18,7 @@
 #include "kudu/rpc/result_tracker.h"
 
 #include <algorithm>
+#include <functional>
 #include <mutex>
 #include <ostream>
 
@@ -76,6 +77,19 @@ using std::vector;
 using strings::Substitute;
 using strings::SubstituteAndAppend;
 
+namespace {
+
+// The number of shards of the ClientStates.
+const int kNumShards = 16;
+
+// The resolution and the number of slots of the GC timer wheels. A revolution of a wheel
+// spans about 10 seconds: ClientStates due later than that stay in their slot across
+// revolutions.
+const int64_t kGCWheelTickMs = 10;
+const int kGCWheelSlots = 1024;
+
+} // anonymous namespace
+
 // This tracks the size changes of anything that has a memory_footprint() method.
 // It must be instantiated before the updates, and it makes sure that the MemTracker
 // is updated on scope exit.
@@ -103,11 +117,21 @@ struct ScopedMemTrackerUpdater {
   bool cancelled;
 };
 
+ResultTracker::Shard::Shard(shared_ptr<MemTracker> mem_tracker, int num_gc_wheel_slots)
+    : clients(ClientStateMap::key_compare(),
+              ClientStateMapAllocator(std::move(mem_tracker))),
+      gc_wheel(num_gc_wheel_slots),
+      last_gc_tick(0) {
+}
+
 ResultTracker::ResultTracker(shared_ptr<MemTracker> mem_tracker)
     : mem_tracker_(std::move(mem_tracker)),
-      clients_(ClientStateMap::key_compare(),
-               ClientStateMapAllocator(mem_tracker_)),
-      gc_thread_stop_latch_(1) {}
+      gc_wheel_epoch_(MonoTime::Now()),
+      gc_thread_stop_latch_(1) {
+  for (int i = 0; i < kNumShards; i++) {
+    shards_.emplace_back(new Shard(mem_tracker_, kGCWheelSlots));
+  }
+}
 
 ResultTracker::~ResultTracker() {
   if (gc_thread_) {
@@ -115,36 +139,47 @@ ResultTracker::~ResultTracker() {
     gc_thread_->Join();
   }
 
-  lock_guard<simple_spinlock> l(lock_);
   // Release all the memory for the stuff we'll delete on destruction.
-  for (auto& client_state : clients_) {
-    client_state.second->GCCompletionRecords(
-        mem_tracker_, [] (SequenceNumber, CompletionRecord*){ return true; });
-    mem_tracker_->Release(client_state.second->memory_footprint());
+  for (auto& shard : shards_) {
+    lock_guard<simple_spinlock> l(shard->lock);
+    for (auto& client_state : shard->clients) {
+      client_state.second->GCCompletionRecords(
+          mem_tracker_, [] (SequenceNumber, CompletionRecord*){ return true; });
+      mem_tracker_->Release(client_state.second->memory_footprint());
+    }
   }
 }
 
+ResultTracker::Shard* ResultTracker::ShardFor(const string& client_id) const {
+  return shards_[std::hash<string>()(client_id) % shards_.size()].get();
+}
+
 ResultTracker::RpcState ResultTracker::TrackRpc(const RequestIdPB& request_id,
                                                 Message* response,
                                                 RpcContext* context) {
-  lock_guard<simple_spinlock> l(lock_);
-  return TrackRpcUnlocked(request_id, response, context);
+  Shard* shard = ShardFor(request_id.client_id());
+  lock_guard<simple_spinlock> l(shard->lock);
+  return TrackRpcUnlocked(shard, request_id, response, context);
 }
 
-ResultTracker::RpcState ResultTracker::TrackRpcUnlocked(const RequestIdPB& request_id,
+ResultTracker::RpcState ResultTracker::TrackRpcUnlocked(Shard* shard,
+                                                        const RequestIdPB& request_id,
                                                         Message* response,
                                                         RpcContext* context) {
-  ClientState* client_state = ComputeIfAbsent(
-      &clients_,
-      request_id.client_id(),
-      [&]{
-        unique_ptr<ClientState> client_state(new ClientState(mem_tracker_));
-        mem_tracker_->Consume(client_state->memory_footprint());
-        client_state->stale_before_seq_no = request_id.first_incomplete_seq_no();
-        return client_state;
-      })->get();
+  MonoTime now = MonoTime::Now();
+  auto client_iter = shard->clients.find(request_id.client_id());
+  if (PREDICT_FALSE(client_iter == shard->clients.end())) {
+    unique_ptr<ClientState> client_state(new ClientState(mem_tracker_));
+    mem_tracker_->Consume(client_state->memory_footprint());
+    client_state->stale_before_seq_no = request_id.first_incomplete_seq_no();
+    client_iter = shard->clients.emplace(request_id.client_id(), std::move(client_state)).first;
+    // Nothing of the client may be GCed before the earliest of the TTLs passed.
+    ScheduleGCUnlocked(shard, client_iter, now + MonoDelta::FromMilliseconds(
+        std::min(FLAGS_remember_clients_ttl_ms, FLAGS_remember_responses_ttl_ms)));
+  }
+  ClientState* client_state = client_iter->second.get();
 
-  client_state->last_heard_from = MonoTime::Now();
+  client_state->last_heard_from = now;
 
   // If the arriving request is older than our per-client GC watermark, report its
   // staleness to the client.
@@ -191,14 +226,16 @@ ResultTracker::RpcState ResultTracker::TrackRpcUnlocked(const RequestIdPB& reque
     return RpcState::NEW;
   }
 
-  completion_record->last_updated = MonoTime::Now();
+  completion_record->last_updated = now;
   switch (completion_record->state) {
     case RpcState::COMPLETED: {
       // If the RPC is COMPLETED and the request originates from a client (context, response are
       // non-null) copy the response and reply immediately. If there is no context/response
       // do nothing.
       if (context != nullptr) {
-        DCHECK_NOTNULL(response)->CopyFrom(*completion_record->response);
+        CHECK(DCHECK_NOTNULL(response)->ParseFromString(completion_record->response))
+            << "could not parse the cached response to request "
+            << SecureShortDebugString(request_id);
         context->call_->RespondSuccess(*response);
         delete context;
       }
@@ -222,12 +259,13 @@ ResultTracker::RpcState ResultTracker::TrackRpcUnlocked(const RequestIdPB& reque
 }
 
 ResultTracker::RpcState ResultTracker::TrackRpcOrChangeDriver(const RequestIdPB& request_id) {
-  lock_guard<simple_spinlock> l(lock_);
-  RpcState state = TrackRpcUnlocked(request_id, nullptr, nullptr);
+  Shard* shard = ShardFor(request_id.client_id());
+  lock_guard<simple_spinlock> l(shard->lock);
+  RpcState state = TrackRpcUnlocked(shard, request_id, nullptr, nullptr);
 
   if (state != RpcState::IN_PROGRESS) return state;
 
-  CompletionRecord* completion_record = FindCompletionRecordOrDieUnlocked(request_id);
+  CompletionRecord* completion_record = FindCompletionRecordOrDieUnlocked(shard, request_id);
   ScopedMemTrackerUpdater<CompletionRecord> updater(mem_tracker_.get(), completion_record);
 
   // ... if we did find a CompletionRecord change the driver and return true.
@@ -242,8 +280,9 @@ ResultTracker::RpcState ResultTracker::TrackRpcOrChangeDriver(const RequestIdPB&
 }
 
 bool ResultTracker::IsCurrentDriver(const RequestIdPB& request_id) {
-  lock_guard<simple_spinlock> l(lock_);
-  CompletionRecord* completion_record = FindCompletionRecordOrNullUnlocked(request_id);
+  Shard* shard = ShardFor(request_id.client_id());
+  lock_guard<simple_spinlock> l(shard->lock);
+  CompletionRecord* completion_record = FindCompletionRecordOrNullUnlocked(shard, request_id);
 
   // If we couldn't find the CompletionRecord, someone might have called FailAndRespond() so
   // just return false.
@@ -288,14 +327,16 @@ void ResultTracker::LogAndTraceFailure(RpcContext* context,
 }
 
 ResultTracker::CompletionRecord* ResultTracker::FindCompletionRecordOrDieUnlocked(
-    const RequestIdPB& request_id) {
-  ClientState* client_state = DCHECK_NOTNULL(FindPointeeOrNull(clients_, request_id.client_id()));
+    Shard* shard, const RequestIdPB& request_id) {
+  ClientState* client_state =
+      DCHECK_NOTNULL(FindPointeeOrNull(shard->clients, request_id.client_id()));
   return DCHECK_NOTNULL(FindPointeeOrNull(client_state->completion_records, request_id.seq_no()));
 }
 
 pair<ResultTracker::ClientState*, ResultTracker::CompletionRecord*>
-ResultTracker::FindClientStateAndCompletionRecordOrNullUnlocked(const RequestIdPB& request_id) {
-  ClientState* client_state = FindPointeeOrNull(clients_, request_id.client_id());
+ResultTracker::FindClientStateAndCompletionRecordOrNullUnlocked(Shard* shard,
+                                                                const RequestIdPB& request_id) {
+  ClientState* client_state = FindPointeeOrNull(shard->clients, request_id.client_id());
   CompletionRecord* completion_record = nullptr;
   if (client_state != nullptr) {
     completion_record = FindPointeeOrNull(client_state->completion_records, request_id.seq_no());
@@ -304,26 +345,28 @@ ResultTracker::FindClientStateAndCompletionRecordOrNullUnlocked(const RequestIdP
 }
 
 ResultTracker::CompletionRecord*
-ResultTracker::FindCompletionRecordOrNullUnlocked(const RequestIdPB& request_id) {
-  return FindClientStateAndCompletionRecordOrNullUnlocked(request_id).second;
+ResultTracker::FindCompletionRecordOrNullUnlocked(Shard* shard, const RequestIdPB& request_id) {
+  return FindClientStateAndCompletionRecordOrNullUnlocked(shard, request_id).second;
 }
 
 void ResultTracker::RecordCompletionAndRespond(const RequestIdPB& request_id,
                                                const Message* response) {
   vector<OnGoingRpcInfo> to_respond;
   {
-    lock_guard<simple_spinlock> l(lock_);
+    Shard* shard = ShardFor(request_id.client_id());
+    lock_guard<simple_spinlock> l(shard->lock);
 
-    CompletionRecord* completion_record = FindCompletionRecordOrDieUnlocked(request_id);
+    CompletionRecord* completion_record = FindCompletionRecordOrDieUnlocked(shard, request_id);
     ScopedMemTrackerUpdater<CompletionRecord> updater(mem_tracker_.get(), completion_record);
 
     CHECK_EQ(completion_record->driver_attempt_no, request_id.attempt_no())
         << "Called RecordCompletionAndRespond() from an executor identified with an "
         << "attempt number that was not marked as the driver for the RPC. RequestId: "
-        << SecureShortDebugString(request_id) << "\nTracker state:\n " << ToStringUnlocked();
+        << SecureShortDebugString(request_id) << "\nTracker state:\n "
+        << ShardToStringUnlocked(*shard);
     DCHECK_EQ(completion_record->state, RpcState::IN_PROGRESS);
-    completion_record->response.reset(DCHECK_NOTNULL(response)->New());
-    completion_record->response->CopyFrom(*response);
+    CHECK(DCHECK_NOTNULL(response)->SerializeToString(&completion_record->response))
+        << "could not serialize the response to request " << SecureShortDebugString(request_id);
     completion_record->state = RpcState::COMPLETED;
     completion_record->last_updated = MonoTime::Now();
 
@@ -364,11 +407,12 @@ void ResultTracker::FailAndRespondInternal(const RequestIdPB& request_id,
                                            HandleOngoingRpcFunc func) {
   vector<OnGoingRpcInfo> to_handle;
   {
-    lock_guard<simple_spinlock> l(lock_);
-    auto state_and_record = FindClientStateAndCompletionRecordOrNullUnlocked(request_id);
+    Shard* shard = ShardFor(request_id.client_id());
+    lock_guard<simple_spinlock> l(shard->lock);
+    auto state_and_record = FindClientStateAndCompletionRecordOrNullUnlocked(shard, request_id);
     if (PREDICT_FALSE(state_and_record.first == nullptr)) {
       LOG(FATAL) << "Couldn't find ClientState for request: " << SecureShortDebugString(request_id)
-                 << ". \nTracker state:\n" << ToStringUnlocked();
+                 << ". \nTracker state:\n" << ShardToStringUnlocked(*shard);
     }
 
     CompletionRecord* completion_record = state_and_record.second;
@@ -470,64 +514,121 @@ void ResultTracker::RunGCThread() {
   }
 }
 
+int64_t ResultTracker::GCTick(MonoTime time) const {
+  return (time - gc_wheel_epoch_).ToMilliseconds() / kGCWheelTickMs;
+}
+
+void ResultTracker::ScheduleGCUnlocked(Shard* shard,
+                                       ClientStateMap::iterator client,
+                                       MonoTime due) {
+  // A tick which GC already processed is only visited again on the next revolution of the
+  // wheel, except for the last one.
+  int64_t due_tick = std::max(GCTick(due), shard->last_gc_tick);
+  shard->gc_wheel[due_tick % shard->gc_wheel.size()].push_back({ due_tick, client });
+}
+
 void ResultTracker::GCResults() {
-  lock_guard<simple_spinlock> l(lock_);
   MonoTime now = MonoTime::Now();
-  // Calculate the instants before which we'll start GCing ClientStates and CompletionRecords.
-  MonoTime time_to_gc_clients_from = now;
-  time_to_gc_clients_from.AddDelta(
-      MonoDelta::FromMilliseconds(-FLAGS_remember_clients_ttl_ms));
-  MonoTime time_to_gc_responses_from = now;
-  time_to_gc_responses_from.AddDelta(
-      MonoDelta::FromMilliseconds(-FLAGS_remember_responses_ttl_ms));
-
-  // Now go through the ClientStates. If we haven't heard from a client in a while
-  // GC it and all its completion records (making sure there isn't actually one in progress first).
-  // If we've heard from a client recently, but some of its responses are old, GC those responses.
-  for (auto iter = clients_.begin(); iter != clients_.end();) {
-    auto& client_state = iter->second;
-    if (client_state->last_heard_from < time_to_gc_clients_from) {
-      // Client should be GCed.
-      bool ongoing_request = false;
-      client_state->GCCompletionRecords(
-          mem_tracker_,
-          [&] (SequenceNumber, CompletionRecord* completion_record) {
-            if (PREDICT_FALSE(completion_record->state == RpcState::IN_PROGRESS)) {
-              ongoing_request = true;
-              return false;
-            }
-            return true;
-          });
-      // Don't delete the client state if there is still a request in execution.
-      if (PREDICT_FALSE(ongoing_request)) {
-        ++iter;
-        continue;
+  int64_t now_tick = GCTick(now);
+  for (auto& shard : shards_) {
+    lock_guard<simple_spinlock> l(shard->lock);
+    // Visit the slots of the ticks since the last run, including the last run's tick, to
+    // which clients may have been scheduled since. One revolution visits every slot.
+    int64_t first_tick = std::max(shard->last_gc_tick,
+                                  now_tick - static_cast<int64_t>(shard->gc_wheel.size()) + 1);
+    vector<pair<ClientStateMap::iterator, MonoTime>> to_schedule;
+    for (int64_t tick = first_tick; tick <= now_tick; tick++) {
+      auto& slot = shard->gc_wheel[tick % shard->gc_wheel.size()];
+      for (size_t i = 0; i < slot.size();) {
+        if (slot[i].due_tick > now_tick) {
+          // Due in a later revolution.
+          i++;
+          continue;
+        }
+        auto client = slot[i].client;
+        slot[i] = slot.back();
+        slot.pop_back();
+        MonoTime next_due;
+        if (GCClientUnlocked(shard.get(), client, now, &next_due)) {
+          to_schedule.emplace_back(client, next_due);
+        }
       }
-      mem_tracker_->Release(client_state->memory_footprint());
-      iter = clients_.erase(iter);
-    } else {
-      // Client can't be GCed, but its calls might be GCable.
-      iter->second->GCCompletionRecords(
-          mem_tracker_,
-          [&] (SequenceNumber, CompletionRecord* completion_record) {
-            return completion_record->state != RpcState::IN_PROGRESS &&
-                completion_record->last_updated < time_to_gc_responses_from;
-          });
-      ++iter;
+    }
+    shard->last_gc_tick = now_tick;
+    for (const auto& e : to_schedule) {
+      ScheduleGCUnlocked(shard.get(), e.first, e.second);
+    }
+  }
+}
+
+bool ResultTracker::GCClientUnlocked(Shard* shard,
+                                     ClientStateMap::iterator client,
+                                     MonoTime now,
+                                     MonoTime* next_due) {
+  const MonoDelta clients_ttl = MonoDelta::FromMilliseconds(FLAGS_remember_clients_ttl_ms);
+  const MonoDelta responses_ttl = MonoDelta::FromMilliseconds(FLAGS_remember_responses_ttl_ms);
+  auto& client_state = client->second;
+
+  // If we haven't heard from a client in a while GC it and all its completion records
+  // (making sure there isn't actually one in progress first). If we've heard from a client
+  // recently, but some of its responses are old, GC those responses.
+  if (client_state->last_heard_from + clients_ttl < now) {
+    // Client should be GCed.
+    bool ongoing_request = false;
+    client_state->GCCompletionRecords(
+        mem_tracker_,
+        [&] (SequenceNumber, CompletionRecord* completion_record) {
+          if (PREDICT_FALSE(completion_record->state == RpcState::IN_PROGRESS)) {
+            ongoing_request = true;
+            return false;
+          }
+          return true;
+        });
+    // Don't delete the client state if there is still a request in execution.
+    if (PREDICT_FALSE(ongoing_request)) {
+      *next_due = now + std::min(clients_ttl, responses_ttl);
+      return true;
+    }
+    mem_tracker_->Release(client_state->memory_footprint());
+    shard->clients.erase(client);
+    return false;
+  }
+
+  // Client can't be GCed, but its calls might be GCable.
+  client_state->GCCompletionRecords(
+      mem_tracker_,
+      [&] (SequenceNumber, CompletionRecord* completion_record) {
+        return completion_record->state != RpcState::IN_PROGRESS &&
+            completion_record->last_updated + responses_ttl < now;
+      });
+
+  // Records are GCed in order, so the next GC is due once either the client or its oldest
+  // record expires. Records created from now on expire after 'responses_ttl' at the
+  // earliest, as do the in-progress ones once they complete.
+  *next_due = std::min(client_state->last_heard_from + clients_ttl, now + responses_ttl);
+  if (!client_state->completion_records.empty()) {
+    const auto& oldest = client_state->completion_records.begin()->second;
+    if (oldest->state != RpcState::IN_PROGRESS) {
+      *next_due = std::min(*next_due, oldest->last_updated + responses_ttl);
     }
   }
+  return true;
 }
 
 string ResultTracker::ToString() {
-  lock_guard<simple_spinlock> l(lock_);
-  return ToStringUnlocked();
+  string result = Substitute("ResultTracker[this: $0, Client States:\n", this);
+  for (const auto& shard : shards_) {
+    lock_guard<simple_spinlock> l(shard->lock);
+    result.append(ShardToStringUnlocked(*shard));
+  }
+  result.append("]");
+  return result;
 }
 
-string ResultTracker::ToStringUnlocked() const {
-  string result = Substitute("ResultTracker[this: $0, Num. Client States: $1, Client States:\n",
-                             this, clients_.size());
-  for (auto& cs : clients_) {
-    SubstituteAndAppend(&result, Substitute("\n\tClient: $0, $1", cs.first, cs.second->ToString()));
+string ResultTracker::ShardToStringUnlocked(const Shard& shard) {
+  string result = Substitute("Shard[Num. Client States: $0", shard.clients.size());
+  for (auto& cs : shard.clients) {
+    SubstituteAndAppend(&result, "\n\tClient: $0, $1", cs.first, cs.second->ToString());
   }
   result.append("]");
   return result;
@@ -576,7 +677,8 @@ string ResultTracker::CompletionRecord::ToString() const {
                              "Cached response: $2, $3 OngoingRpcs:",
                              state,
                              driver_attempt_no,
-                             response ? SecureShortDebugString(*response) : "None",
+                             response.empty() ? "None" : Substitute("$0 bytes",
+                                                                    response.size()),
                              ongoing_rpcs.size());
   for (auto& orpc : ongoing_rpcs) {
     SubstituteAndAppend(&result, Substitute("\n\t$0", orpc.ToString()));
@@ -231,13 +231,16 @@ class ResultTracker : public RefCountedThreadSafe<ResultTracker> {
   void StartGCThread();
 
   // Runs time-based garbage collection on the results this result tracker is caching.
-  // When garbage collection runs, it goes through all ClientStates and:
+  // When garbage collection runs, it goes through the ClientStates which are due for
+  // examination (see Shard::gc_wheel) and:
   // - If a ClientState is older than the 'remember_clients_ttl_ms' flag and no
   //   requests are in progress, GCs the ClientState and all its CompletionRecords.
   // - If a ClientState is newer than the 'remember_clients_ttl_ms' flag, goes
   //   through all CompletionRecords and:
   //   - If the CompletionRecord is older than the 'remember_responses_ttl_secs' flag,
   //     GCs the CompletionRecord and advances the 'stale_before_seq_no' watermark.
+  // The ClientStates it keeps are then scheduled for examination at the time their
+  // oldest CompletionRecord, or the ClientState itself, may be GCed.
   //
   // Typically this is invoked from an internal thread started by 'StartGCThread()'.
   void GCResults();
@@ -271,8 +274,9 @@ class ResultTracker : public RefCountedThreadSafe<ResultTracker> {
     // The timestamp of the last CompletionRecord update.
     MonoTime last_updated;
 
-    // The cached response, if this RPC is in COMPLETED state.
-    std::unique_ptr<google::protobuf::Message> response;
+    // The cached response, if this RPC is in COMPLETED state. The response is kept
+    // serialized: that's far more compact than a message object, and retries are rare.
+    std::string response;
 
     // The set of ongoing RPCs that correspond to this record.
     std::vector<OnGoingRpcInfo> ongoing_rpcs;
@@ -283,7 +287,7 @@ class ResultTracker : public RefCountedThreadSafe<ResultTracker> {
     int64_t memory_footprint() const {
       return kudu_malloc_usable_size(this)
           + (ongoing_rpcs.capacity() > 0 ? kudu_malloc_usable_size(ongoing_rpcs.data()) : 0)
-          + (response.get() != nullptr ? response->SpaceUsed() : 0);
+          + (response.empty() ? 0 : response.capacity());
     }
   };
 
@@ -333,7 +337,58 @@ class ResultTracker : public RefCountedThreadSafe<ResultTracker> {
     }
   };
 
-  RpcState TrackRpcUnlocked(const RequestIdPB& request_id,
+  typedef MemTrackerAllocator<std::pair<const std::string,
+                                        std::unique_ptr<ClientState>>> ClientStateMapAllocator;
+  typedef std::map<std::string,
+                   std::unique_ptr<ClientState>,
+                   std::less<std::string>,
+                   ClientStateMapAllocator> ClientStateMap;
+
+  // An entry of the GC timer wheel of a Shard: a ClientState and the tick at which GC is
+  // due to examine it.
+  struct GCWheelEntry {
+    int64_t due_tick;
+    ClientStateMap::iterator client;
+  };
+
+  // A shard of the ClientStates. Clients are assigned to shards by the hash of their IDs,
+  // so that the RPCs of different clients rarely contend on the same lock.
+  struct Shard {
+    Shard(std::shared_ptr<MemTracker> mem_tracker, int num_gc_wheel_slots);
+
+    // Lock that protects access to 'clients', to the state contained in each
+    // ClientState, and to the GC timer wheel.
+    simple_spinlock lock;
+
+    ClientStateMap clients;
+
+    // A hashed timer wheel of the GC of 'clients': each ClientState is in exactly one
+    // slot, the one of the tick at which GC is due to examine it, whichever revolution
+    // of the wheel that tick falls in. GC thus only visits the clients with something
+    // to GC, rather than all clients on every run. Only GC erases ClientStates, which
+    // keeps the map iterators of the entries valid.
+    std::vector<std::vector<GCWheelEntry>> gc_wheel;
+
+    // The latest tick which GC processed the slot of.
+    int64_t last_gc_tick;
+  };
+
+  Shard* ShardFor(const std::string& client_id) const;
+
+  // Returns the tick of the GC timer wheels that 'time' falls in.
+  int64_t GCTick(MonoTime time) const;
+
+  // Schedules the examination of 'client' by GC at 'due', or at the next GC run if that's
+  // already passed.
+  void ScheduleGCUnlocked(Shard* shard, ClientStateMap::iterator client, MonoTime due);
+
+  // Examines 'client' for GC as described in GCResults(). Returns false if the ClientState
+  // was GCed, or true along with the time of its next examination in 'next_due' otherwise.
+  bool GCClientUnlocked(Shard* shard, ClientStateMap::iterator client, MonoTime now,
+                        MonoTime* next_due);
+
+  RpcState TrackRpcUnlocked(Shard* shard,
+                            const RequestIdPB& request_id,
                             google::protobuf::Message* response,
                             RpcContext* context);
 
@@ -344,10 +399,12 @@ class ResultTracker : public RefCountedThreadSafe<ResultTracker> {
   void FailAndRespondInternal(const rpc::RequestIdPB& request_id,
                               HandleOngoingRpcFunc func);
 
-  CompletionRecord* FindCompletionRecordOrNullUnlocked(const RequestIdPB& request_id);
-  CompletionRecord* FindCompletionRecordOrDieUnlocked(const RequestIdPB& request_id);
-  std::pair<ClientState*, CompletionRecord*> FindClientStateAndCompletionRecordOrNullUnlocked(
-      const RequestIdPB& request_id);
+  static CompletionRecord* FindCompletionRecordOrNullUnlocked(Shard* shard,
+                                                              const RequestIdPB& request_id);
+  static CompletionRecord* FindCompletionRecordOrDieUnlocked(Shard* shard,
+                                                             const RequestIdPB& request_id);
+  static std::pair<ClientState*, CompletionRecord*>
+  FindClientStateAndCompletionRecordOrNullUnlocked(Shard* shard, const RequestIdPB& request_id);
 
   // A handler must handle an RPC attempt if:
   // 1 - It's its own attempt. I.e. it has the same attempt number of the handler.
@@ -369,26 +426,18 @@ class ResultTracker : public RefCountedThreadSafe<ResultTracker> {
   void LogAndTraceFailure(RpcContext* context, ErrorStatusPB_RpcErrorCodePB err,
                           const Status& status);
 
-  std::string ToStringUnlocked() const;
+  // Describes the ClientStates of 'shard'.
+  static std::string ShardToStringUnlocked(const Shard& shard);
 
   void RunGCThread();
 
   // The memory tracker that tracks this ResultTracker's memory consumption.
   std::shared_ptr<kudu::MemTracker> mem_tracker_;
 
-  // Lock that protects access to 'clients_' and to the state contained in each
-  // ClientState.
-  // TODO consider a per-ClientState lock if we find this too coarse grained.
-  simple_spinlock lock_;
-
-  typedef MemTrackerAllocator<std::pair<const std::string,
-                                        std::unique_ptr<ClientState>>> ClientStateMapAllocator;
-  typedef std::map<std::string,
-                   std::unique_ptr<ClientState>,
-                   std::less<std::string>,
-                   ClientStateMapAllocator> ClientStateMap;
+  std::vector<std::unique_ptr<Shard>> shards_;
 
-  ClientStateMap clients_;
+  // The time the ticks of the GC timer wheels count from.
+  const MonoTime gc_wheel_epoch_;
 
   // The thread which runs GC, and a latch to stop it.
   scoped_refptr<Thread> gc_thread_;
@@ -15,6 +15,7 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <algorithm>
 #include <cstdint>
 #include <functional>
 #include <memory>
@@ -31,16 +32,24 @@
 
 #include "kudu/gutil/atomicops.h"
 #include "kudu/gutil/ref_counted.h"
+#include "kudu/gutil/strings/numbers.h"
+#include "kudu/gutil/strings/split.h"
 #include "kudu/rpc/messenger.h"
+#include "kudu/rpc/response_callback.h"
 #include "kudu/rpc/rpc-test-base.h"
 #include "kudu/rpc/rpc_controller.h"
+#include "kudu/rpc/rpc_sidecar.h"
 #include "kudu/rpc/rtest.pb.h"
 #include "kudu/rpc/rtest.proxy.h"
+#include "kudu/rpc/transfer.h"
 #include "kudu/util/countdown_latch.h"
 #include "kudu/util/hdr_histogram.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/net/sockaddr.h"
+#include "kudu/util/random.h"
+#include "kudu/util/random_util.h"
+#include "kudu/util/slice.h"
 #include "kudu/util/status.h"
 #include "kudu/util/stopwatch.h"
 #include "kudu/util/test_util.h"
@@ -55,7 +64,8 @@ using std::vector;
 DEFINE_int32(client_threads, 16,
              "Number of client threads. For the synchronous benchmark, each thread has "
              "a single outstanding synchronous request at a time. For the async "
-             "benchmark, this determines the number of client reactors.");
+             "benchmark, this determines the number of client reactors. Either way, "
+             "each thread or reactor has a messenger, and thus a connection, of its own.");
 
 DEFINE_int32(async_call_concurrency, 60,
              "Number of concurrent requests that will be outstanding at a time for the "
@@ -70,7 +80,21 @@ DEFINE_int32(server_reactors, 4,
 
 DEFINE_int32(run_seconds, 1, "Seconds to run the test");
 
+DEFINE_int32(payload_bytes, 0,
+             "Size of the payload each call carries to the server and back, in "
+             "bytes. If 0, the calls are Add calls carrying no payload to speak of.");
+
+DEFINE_int32(payload_sidecars, 0,
+             "Number of sidecars the payload of each call is split across, both in "
+             "the request and in the response. If 0, the payload is carried in the "
+             "protobuf messages themselves.");
+
+DEFINE_string(payload_sweep_sizes, "64,1024,16384,262144,4194304,67108864",
+              "Comma-separated payload sizes, in bytes, of the calls made by the "
+              "payload size sweep benchmark.");
+
 DECLARE_bool(rpc_encrypt_loopback_connections);
+DECLARE_int32(rpc_max_message_size);
 DEFINE_bool(enable_encryption, false, "Whether to enable TLS encryption for rpc-bench");
 
 METRIC_DECLARE_histogram(reactor_load_percent);
@@ -79,6 +103,26 @@ METRIC_DECLARE_histogram(reactor_active_latency_us);
 namespace kudu {
 namespace rpc {
 
+// The highest call latency tracked, in microseconds.
+static const uint64_t kMaxLatencyUs = 60 * 1000 * 1000;
+
+// The most payload bytes the payload size sweep keeps in flight at once.
+static const int kMaxPayloadBytesInFlight = 256 * 1024 * 1024;
+
+// A call of the kind configured by the flags: an Add call, or a call echoing
+// the payload either in a protobuf field or in sidecars.
+struct BenchCall {
+  RpcController controller;
+  MonoTime start;
+
+  AddRequestPB add_req;
+  AddResponsePB add_resp;
+  EchoRequestPB echo_req;
+  EchoResponsePB echo_resp;
+  EchoSidecarsRequestPB sidecars_req;
+  EchoSidecarsResponsePB sidecars_resp;
+};
+
 class RpcBench : public RpcTestBase {
  public:
   RpcBench()
@@ -88,20 +132,102 @@ class RpcBench : public RpcTestBase {
 
   void SetUp() override {
     OverrideFlagForSlowTests("run_seconds", "10");
+    CHECK_LE(FLAGS_payload_sidecars, TransferLimits::kMaxSidecars);
 
     n_worker_threads_ = FLAGS_worker_threads;
     n_server_reactor_threads_ = FLAGS_server_reactors;
 
+    // Leave room for the largest payloads of the sweep.
+    FLAGS_rpc_max_message_size = std::max(FLAGS_rpc_max_message_size, 128 * 1024 * 1024);
+    SetPayloadSize(FLAGS_payload_bytes);
+    ResetLatencies();
+
     // Set up server.
     FLAGS_rpc_encrypt_loopback_connections = FLAGS_enable_encryption;
     StartTestServerWithGeneratedCode(&server_addr_, FLAGS_enable_encryption);
   }
 
-  void SummarizePerf(CpuTimes elapsed, int total_reqs, bool sync) {
+  void SetPayloadSize(int size) {
+    Random r(SeedRandom());
+    payload_.resize(size);
+    RandomString(&payload_[0], size, &r);
+  }
+
+  void ResetLatencies() {
+    latencies_us_.reset(new HdrHistogram(kMaxLatencyUs, 2));
+  }
+
+  // Prepares 'call' to be sent as the 'seq'-th call of its client.
+  void PrepareCall(int seq, BenchCall* call) const {
+    call->controller.Reset();
+    call->controller.set_timeout(MonoDelta::FromSeconds(60));
+    call->start = MonoTime::Now();
+    if (payload_.empty()) {
+      call->add_req.set_x(seq);
+      call->add_req.set_y(seq);
+    } else if (FLAGS_payload_sidecars == 0) {
+      call->echo_req.set_data(payload_);
+    } else {
+      call->sidecars_req.Clear();
+      size_t chunk_size = payload_.size() / FLAGS_payload_sidecars;
+      for (int i = 0; i < FLAGS_payload_sidecars; i++) {
+        size_t offset = i * chunk_size;
+        size_t size = i == FLAGS_payload_sidecars - 1 ? payload_.size() - offset : chunk_size;
+        int idx;
+        CHECK_OK(call->controller.AddOutboundSidecar(
+            RpcSidecar::FromSlice(Slice(payload_.data() + offset, size)), &idx));
+        call->sidecars_req.add_sidecar_idx(idx);
+      }
+    }
+  }
+
+  Status SendCallSync(CalculatorServiceProxy* p, BenchCall* call) const {
+    if (payload_.empty()) {
+      return p->Add(call->add_req, &call->add_resp, &call->controller);
+    }
+    if (FLAGS_payload_sidecars == 0) {
+      return p->Echo(call->echo_req, &call->echo_resp, &call->controller);
+    }
+    return p->EchoSidecars(call->sidecars_req, &call->sidecars_resp, &call->controller);
+  }
+
+  void SendCallAsync(CalculatorServiceProxy* p, BenchCall* call,
+                     const ResponseCallback& callback) const {
+    if (payload_.empty()) {
+      p->AddAsync(call->add_req, &call->add_resp, &call->controller, callback);
+    } else if (FLAGS_payload_sidecars == 0) {
+      p->EchoAsync(call->echo_req, &call->echo_resp, &call->controller, callback);
+    } else {
+      p->EchoSidecarsAsync(call->sidecars_req, &call->sidecars_resp, &call->controller,
+                           callback);
+    }
+  }
+
+  // Checks the response to 'call', and records its latency.
+  void FinishCall(const BenchCall& call) {
+    CHECK_OK(call.controller.status());
+    if (payload_.empty()) {
+      CHECK_EQ(call.add_req.x() + call.add_req.y(), call.add_resp.result());
+    } else if (FLAGS_payload_sidecars == 0) {
+      CHECK_EQ(payload_.size(), call.echo_resp.data().size());
+    } else {
+      size_t echoed_size = 0;
+      for (uint32_t idx : call.sidecars_resp.sidecar_idx()) {
+        Slice sidecar;
+        CHECK_OK(call.controller.GetInboundSidecar(idx, &sidecar));
+        echoed_size += sidecar.size();
+      }
+      CHECK_EQ(payload_.size(), echoed_size);
+    }
+    latencies_us_->Increment((MonoTime::Now() - call.start).ToMicroseconds());
+  }
+
+  void SummarizePerf(CpuTimes elapsed, int total_reqs, int client_threads, bool sync) {
     float reqs_per_second = static_cast<float>(total_reqs / elapsed.wall_seconds());
     float user_cpu_micros_per_req = static_cast<float>(elapsed.user / 1000.0 / total_reqs);
     float sys_cpu_micros_per_req = static_cast<float>(elapsed.system / 1000.0 / total_reqs);
     float csw_per_req = static_cast<float>(elapsed.context_switches) / total_reqs;
+    float mbytes_per_second = reqs_per_second * payload_.size() / (1024 * 1024);
 
     HdrHistogram reactor_load(*METRIC_reactor_load_percent.Instantiate(
         server_messenger_->metric_entity())->histogram_for_tests());
@@ -110,20 +236,29 @@ class RpcBench : public RpcTestBase {
 
     LOG(INFO) << "Mode:            " << (sync ? "Sync" : "Async");
     if (sync) {
-      LOG(INFO) << "Client threads:   " << FLAGS_client_threads;
+      LOG(INFO) << "Client threads:   " << client_threads;
     } else {
-      LOG(INFO) << "Client reactors:  " << FLAGS_client_threads;
+      LOG(INFO) << "Client reactors:  " << client_threads;
       LOG(INFO) << "Call concurrency: " << FLAGS_async_call_concurrency;
     }
 
     LOG(INFO) << "Worker threads:   " << FLAGS_worker_threads;
     LOG(INFO) << "Server reactors:  " << FLAGS_server_reactors;
     LOG(INFO) << "Encryption:       " << FLAGS_enable_encryption;
+    LOG(INFO) << "Payload bytes:    " << payload_.size();
+    LOG(INFO) << "Payload sidecars: " << FLAGS_payload_sidecars;
     LOG(INFO) << "----------------------------------";
     LOG(INFO) << "Reqs/sec:         " << reqs_per_second;
+    LOG(INFO) << "MB/sec:           " << mbytes_per_second;
     LOG(INFO) << "User CPU per req: " << user_cpu_micros_per_req << "us";
     LOG(INFO) << "Sys CPU per req:  " << sys_cpu_micros_per_req << "us";
     LOG(INFO) << "Ctx Sw. per req:  " << csw_per_req;
+    LOG(INFO) << "Latency (mean):   " << latencies_us_->MeanValue() << "us";
+    LOG(INFO) << "Latency (50p):    " << latencies_us_->ValueAtPercentile(50) << "us";
+    LOG(INFO) << "Latency (95p):    " << latencies_us_->ValueAtPercentile(95) << "us";
+    LOG(INFO) << "Latency (99p):    " << latencies_us_->ValueAtPercentile(99) << "us";
+    LOG(INFO) << "Latency (99.9p):  " << latencies_us_->ValueAtPercentile(99.9) << "us";
+    LOG(INFO) << "Latency (max):    " << latencies_us_->MaxValue() << "us";
     LOG(INFO) << "Server Reactor load (mean):     "
               << reactor_load.MeanValue() << "%";
     LOG(INFO) << "Server Reactor load (95p):      "
@@ -139,9 +274,19 @@ class RpcBench : public RpcTestBase {
   friend class ClientThread;
   friend class ClientAsyncWorkload;
 
+  // Makes synchronous calls from 'num_threads' client threads for
+  // --run_seconds, and summarizes their performance.
+  void RunSyncBenchmark(int num_threads);
+
   Sockaddr server_addr_;
   Atomic32 should_run_;
   CountDownLatch stop_;
+
+  // The payload of the calls, if any.
+  string payload_;
+
+  // The latencies of the calls, in microseconds.
+  unique_ptr<HdrHistogram> latencies_us_;
 };
 
 class ClientThread {
@@ -164,15 +309,11 @@ class ClientThread {
 
     CalculatorServiceProxy p(client_messenger, bench_->server_addr_, "localhost");
 
-    AddRequestPB req;
-    AddResponsePB resp;
+    BenchCall call;
     while (Acquire_Load(&bench_->should_run_)) {
-      req.set_x(request_count_);
-      req.set_y(request_count_);
-      RpcController controller;
-      controller.set_timeout(MonoDelta::FromSeconds(10));
-      CHECK_OK(p.Add(req, &resp, &controller));
-      CHECK_EQ(req.x() + req.y(), resp.result());
+      bench_->PrepareCall(request_count_, &call);
+      CHECK_OK(bench_->SendCallSync(&p, &call));
+      bench_->FinishCall(call);
       request_count_++;
     }
   }
@@ -182,14 +323,15 @@ class ClientThread {
   int request_count_;
 };
 
+void RpcBench::RunSyncBenchmark(int num_threads) {
+  Release_Store(&should_run_, true);
+  ResetLatencies();
 
-// Test making successful RPC calls.
-TEST_F(RpcBench, BenchmarkCalls) {
   Stopwatch sw(Stopwatch::ALL_THREADS);
   sw.start();
 
   vector<unique_ptr<ClientThread>> threads;
-  for (int i = 0; i < FLAGS_client_threads; i++) {
+  for (int i = 0; i < num_threads; i++) {
     threads.emplace_back(new ClientThread(this));
     threads.back()->Start();
   }
@@ -205,7 +347,30 @@ TEST_F(RpcBench, BenchmarkCalls) {
   }
   sw.stop();
 
-  SummarizePerf(sw.elapsed(), total_reqs, true);
+  SummarizePerf(sw.elapsed(), total_reqs, num_threads, true);
+}
+
+// Test making successful RPC calls.
+TEST_F(RpcBench, BenchmarkCalls) {
+  RunSyncBenchmark(FLAGS_client_threads);
+}
+
+// Benchmark synchronous calls carrying payloads of each of the sizes of
+// --payload_sweep_sizes in turn, in protobuf fields or in sidecars per
+// --payload_sidecars.
+TEST_F(RpcBench, BenchmarkPayloadSizes) {
+  vector<string> sizes = strings::Split(FLAGS_payload_sweep_sizes, ",",
+                                        strings::SkipEmpty());
+  for (const string& size_str : sizes) {
+    int32_t size;
+    CHECK(safe_strto32(size_str, &size) && size >= 0)
+        << "invalid payload size: " << size_str;
+    SetPayloadSize(size);
+    // Bound the memory used by the largest payloads.
+    int num_threads = std::max(1, std::min(FLAGS_client_threads,
+                                           kMaxPayloadBytesInFlight / std::max(size, 1)));
+    RunSyncBenchmark(num_threads);
+  }
 }
 
 class ClientAsyncWorkload {
@@ -214,27 +379,20 @@ class ClientAsyncWorkload {
     : bench_(bench),
       messenger_(std::move(messenger)),
       request_count_(0) {
-    controller_.set_timeout(MonoDelta::FromSeconds(10));
     proxy_.reset(new CalculatorServiceProxy(messenger_, bench_->server_addr_, "localhost"));
   }
 
   void CallOneRpc() {
     if (request_count_ > 0) {
-      CHECK_OK(controller_.status());
-      CHECK_EQ(req_.x() + req_.y(), resp_.result());
+      bench_->FinishCall(call_);
     }
     if (!Acquire_Load(&bench_->should_run_)) {
       bench_->stop_.CountDown();
       return;
     }
-    controller_.Reset();
-    req_.set_x(request_count_);
-    req_.set_y(request_count_);
+    bench_->PrepareCall(request_count_, &call_);
     request_count_++;
-    proxy_->AddAsync(req_,
-                     &resp_,
-                     &controller_,
-                     bind(&ClientAsyncWorkload::CallOneRpc, this));
+    bench_->SendCallAsync(proxy_.get(), &call_, bind(&ClientAsyncWorkload::CallOneRpc, this));
   }
 
   void Start() {
@@ -245,9 +403,7 @@ class ClientAsyncWorkload {
   shared_ptr<Messenger> messenger_;
   unique_ptr<CalculatorServiceProxy> proxy_;
   uint32_t request_count_;
-  RpcController controller_;
-  AddRequestPB req_;
-  AddResponsePB resp_;
+  BenchCall call_;
 };
 
 TEST_F(RpcBench, BenchmarkCallsAsync) {
@@ -285,9 +441,8 @@ TEST_F(RpcBench, BenchmarkCallsAsync) {
     total_reqs += workloads[i]->request_count_;
   }
 
-  SummarizePerf(sw.elapsed(), total_reqs, false);
+  SummarizePerf(sw.elapsed(), total_reqs, threads, false);
 }
 
 } // namespace rpc
 } // namespace kudu
-
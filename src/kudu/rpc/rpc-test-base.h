@@ -61,6 +61,8 @@ using kudu::rpc_test::CalculatorServiceIf;
 using kudu::rpc_test::CalculatorServiceProxy;
 using kudu::rpc_test::EchoRequestPB;
 using kudu::rpc_test::EchoResponsePB;
+using kudu::rpc_test::EchoSidecarsRequestPB;
+using kudu::rpc_test::EchoSidecarsResponsePB;
 using kudu::rpc_test::ExactlyOnceRequestPB;
 using kudu::rpc_test::ExactlyOnceResponsePB;
 using kudu::rpc_test::FeatureFlags;
@@ -81,6 +83,21 @@ using kudu::rpc_test::WhoAmIResponsePB;
 using kudu::rpc_test_diff_package::ReqDiffPackagePB;
 using kudu::rpc_test_diff_package::RespDiffPackagePB;
 
+// Fills 'str' with 'size' random bytes, or with a short random pattern
+// repeated over and over if 'compressible' is true.
+inline void FillString(faststring* str, size_t size, bool compressible, Random* rng) {
+  str->resize(size);
+  if (!compressible) {
+    RandomString(str->data(), size, rng);
+    return;
+  }
+  uint8_t pattern[64];
+  RandomString(pattern, sizeof(pattern), rng);
+  for (size_t i = 0; i < size; i++) {
+    str->data()[i] = pattern[i % sizeof(pattern)];
+  }
+}
+
 // Implementation of CalculatorService which just implements the generic
 // RPC handler (no generated code).
 class GenericCalculatorService : public ServiceIf {
@@ -149,11 +166,8 @@ class GenericCalculatorService : public ServiceIf {
     std::unique_ptr<faststring> second(new faststring);
 
     Random r(req.random_seed());
-    first->resize(req.size1());
-    RandomString(first->data(), req.size1(), &r);
-
-    second->resize(req.size2());
-    RandomString(second->data(), req.size2(), &r);
+    FillString(first.get(), req.size1(), req.compressible(), &r);
+    FillString(second.get(), req.size2(), req.compressible(), &r);
 
     SendTwoStringsResponsePB resp;
     int idx1, idx2;
@@ -290,6 +304,20 @@ class CalculatorService : public CalculatorServiceIf {
     context->RespondSuccess();
   }
 
+  void EchoSidecars(const EchoSidecarsRequestPB* req,
+                    EchoSidecarsResponsePB* resp,
+                    RpcContext* context) override {
+    // The inbound sidecars remain valid until the response has been sent.
+    for (uint32_t idx : req->sidecar_idx()) {
+      Slice sidecar;
+      CHECK_OK(context->GetInboundSidecar(idx, &sidecar));
+      int echoed_idx;
+      CHECK_OK(context->AddOutboundSidecar(RpcSidecar::FromSlice(sidecar), &echoed_idx));
+      resp->add_sidecar_idx(echoed_idx);
+    }
+    context->RespondSuccess();
+  }
+
   void WhoAmI(const WhoAmIRequestPB* /*req*/,
               WhoAmIResponsePB* resp,
               RpcContext* context) override {
@@ -466,13 +494,14 @@ class RpcTestBase : public KuduTest {
     return Status::OK();
   }
 
-  void DoTestSidecar(const Proxy &p, int size1, int size2) {
+  void DoTestSidecar(const Proxy &p, int size1, int size2, bool compressible = false) {
     const uint32_t kSeed = 12345;
 
     SendTwoStringsRequestPB req;
     req.set_size1(size1);
     req.set_size2(size2);
     req.set_random_seed(kSeed);
+    req.set_compressible(compressible);
 
     SendTwoStringsResponsePB resp;
     RpcController controller;
@@ -485,12 +514,10 @@ class RpcTestBase : public KuduTest {
     Random rng(kSeed);
     faststring expected;
 
-    expected.resize(size1);
-    RandomString(expected.data(), size1, &rng);
+    FillString(&expected, size1, compressible, &rng);
     CHECK_EQ(0, first.compare(Slice(expected)));
 
-    expected.resize(size2);
-    RandomString(expected.data(), size2, &rng);
+    FillString(&expected, size2, compressible, &rng);
     CHECK_EQ(0, second.compare(Slice(expected)));
   }
 
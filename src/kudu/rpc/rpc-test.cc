@@ -66,11 +66,23 @@
 #include "kudu/util/test_util.h"
 #include "kudu/util/thread.h"
 
+METRIC_DECLARE_histogram(handler_cpu_time_kudu_rpc_test_CalculatorService_Sleep);
 METRIC_DECLARE_histogram(handler_latency_kudu_rpc_test_CalculatorService_Sleep);
+METRIC_DECLARE_histogram(queue_time_kudu_rpc_test_CalculatorService_Sleep);
 METRIC_DECLARE_histogram(rpc_incoming_queue_time);
+METRIC_DECLARE_counter(rpc_sidecar_bytes_compressed);
+METRIC_DECLARE_counter(rpc_sidecar_compression_bytes_saved);
 
+DECLARE_bool(rpc_acceptor_reuse_port);
 DECLARE_bool(rpc_reopen_outbound_connections);
+DECLARE_int32(rpc_busy_poll_reactors);
+DECLARE_int32(rpc_max_calls_per_connection);
 DECLARE_int32(rpc_negotiation_inject_delay_ms);
+DECLARE_int32(rpc_service_queue_delay_interval_ms);
+DECLARE_int32(rpc_service_queue_target_delay_ms);
+DECLARE_int32(rpc_sidecar_compression_min_bytes);
+DECLARE_string(rpc_busy_poll_reactor_cpus);
+DECLARE_string(rpc_sidecar_compression_codec);
 DECLARE_string(rpc_certificate_file);
 DECLARE_string(rpc_ca_certificate_file);
 DECLARE_string(rpc_private_key_file);
@@ -130,6 +142,25 @@ TEST_P(TestRpc, TestAcceptorPoolStartStop) {
   }
 }
 
+// Test that with SO_REUSEPORT, every reactor accepts connections on a listening
+// socket of its own, and that connections made to the shared address are served.
+TEST_P(TestRpc, TestAcceptorPoolReusePort) {
+  FLAGS_rpc_acceptor_reuse_port = true;
+  bool enable_ssl = GetParam();
+  shared_ptr<Messenger> server_messenger(
+      CreateMessenger("TestAcceptorPoolReusePort", 4, enable_ssl));
+  Sockaddr server_addr;
+  StartTestServerWithCustomMessenger(&server_addr, server_messenger, enable_ssl);
+
+  // Separate client messengers make separate connections.
+  for (int i = 0; i < 8; i++) {
+    shared_ptr<Messenger> client_messenger(CreateMessenger("Client", 1, enable_ssl));
+    Proxy p(client_messenger, server_addr, server_addr.host(),
+            GenericCalculatorService::static_service_name());
+    ASSERT_OK(DoTestSyncCall(p, GenericCalculatorService::kAddMethodName));
+  }
+}
+
 TEST_F(TestRpc, TestConnHeaderValidation) {
   MessengerBuilder mb("TestRpc.TestConnHeaderValidation");
   const int conn_hdr_len = kMagicNumberLength + kHeaderFlagsLength;
@@ -184,6 +215,27 @@ TEST_P(TestRpc, TestCall) {
   }
 }
 
+// Test that calls go through, and messengers shut down, with the reactors of
+// both the client and the server busy-polling, pinned to the first CPU.
+TEST_P(TestRpc, TestBusyPollReactors) {
+  FLAGS_rpc_busy_poll_reactors = 1;
+  FLAGS_rpc_busy_poll_reactor_cpus = "0";
+
+  // Set up server.
+  Sockaddr server_addr;
+  bool enable_ssl = GetParam();
+  StartTestServer(&server_addr, enable_ssl);
+
+  // Set up client.
+  shared_ptr<Messenger> client_messenger(CreateMessenger("Client", 1, enable_ssl));
+  Proxy p(client_messenger, server_addr, server_addr.host(),
+          GenericCalculatorService::static_service_name());
+  for (int i = 0; i < 10; i++) {
+    ASSERT_OK(DoTestSyncCall(p, GenericCalculatorService::kAddMethodName));
+  }
+  client_messenger->Shutdown();
+}
+
 TEST_P(TestRpc, TestCallWithChainCerts) {
   bool enable_ssl = GetParam();
   // We're only interested in running this test with TLS enabled.
@@ -391,6 +443,102 @@ TEST_P(TestRpc, TestConnectionKeepalive) {
   ASSERT_EQ(0, metrics.num_client_connections_) << "Client should have 0 client connections";
 }
 
+// Test that calls spill over to additional outbound connections to the same
+// server once every connection has --rpc_max_calls_per_connection calls
+// outstanding.
+TEST_P(TestRpc, TestMaxCallsPerConnection) {
+  FLAGS_rpc_max_calls_per_connection = 1;
+
+  // Set up server.
+  Sockaddr server_addr;
+  bool enable_ssl = GetParam();
+  StartTestServer(&server_addr, enable_ssl);
+
+  // Set up client.
+  shared_ptr<Messenger> client_messenger(CreateMessenger("Client", 1, enable_ssl));
+  Proxy p(client_messenger, server_addr, server_addr.host(),
+          GenericCalculatorService::static_service_name());
+
+  // Keep several calls outstanding at once.
+  const int kNumCalls = 3;
+  SleepRequestPB req;
+  req.set_sleep_micros(100 * 1000);
+  vector<unique_ptr<RpcController>> controllers;
+  vector<unique_ptr<SleepResponsePB>> resps;
+  CountDownLatch latch(kNumCalls);
+  for (int i = 0; i < kNumCalls; i++) {
+    controllers.emplace_back(new RpcController());
+    resps.emplace_back(new SleepResponsePB());
+    p.AsyncRequest(GenericCalculatorService::kSleepMethodName, req, resps.back().get(),
+                   controllers.back().get(),
+                   boost::bind(&CountDownLatch::CountDown, boost::ref(latch)));
+  }
+  latch.Wait();
+  for (const auto& controller : controllers) {
+    ASSERT_OK(controller->status());
+  }
+
+  // Every call had a connection of its own.
+  ReactorMetrics metrics;
+  ASSERT_OK(client_messenger->reactors_[0]->GetMetrics(&metrics));
+  ASSERT_EQ(kNumCalls, metrics.total_client_connections_);
+
+  // Calls made one at a time reuse the connections.
+  ASSERT_OK(DoTestSyncCall(p, GenericCalculatorService::kAddMethodName));
+  ASSERT_OK(client_messenger->reactors_[0]->GetMetrics(&metrics));
+  ASSERT_EQ(kNumCalls, metrics.total_client_connections_);
+}
+
+// Test that, once the service queue holds a standing backlog, calls are shed
+// with a hint telling their clients when to retry them.
+TEST_P(TestRpc, TestServiceQueueShedding) {
+  FLAGS_rpc_service_queue_target_delay_ms = 1;
+  FLAGS_rpc_service_queue_delay_interval_ms = 10;
+  n_worker_threads_ = 1;
+
+  // Set up server.
+  Sockaddr server_addr;
+  bool enable_ssl = GetParam();
+  StartTestServer(&server_addr, enable_ssl);
+
+  // Set up client.
+  shared_ptr<Messenger> client_messenger(CreateMessenger("Client", 1, enable_ssl));
+  Proxy p(client_messenger, server_addr, server_addr.host(),
+          GenericCalculatorService::static_service_name());
+
+  // Each call keeps the single service thread busy for longer than the
+  // interval, so that the queued calls wait well past the target.
+  const int kNumCalls = 10;
+  SleepRequestPB req;
+  req.set_sleep_micros(20 * 1000);
+  vector<unique_ptr<RpcController>> controllers;
+  vector<unique_ptr<SleepResponsePB>> resps;
+  CountDownLatch latch(kNumCalls);
+  for (int i = 0; i < kNumCalls; i++) {
+    controllers.emplace_back(new RpcController());
+    resps.emplace_back(new SleepResponsePB());
+    p.AsyncRequest(GenericCalculatorService::kSleepMethodName, req, resps.back().get(),
+                   controllers.back().get(),
+                   boost::bind(&CountDownLatch::CountDown, boost::ref(latch)));
+  }
+  latch.Wait();
+
+  int num_shed = 0;
+  for (const auto& controller : controllers) {
+    if (controller->status().ok()) {
+      continue;
+    }
+    ASSERT_TRUE(controller->status().IsRemoteError()) << controller->status().ToString();
+    const ErrorStatusPB* err = controller->error_response();
+    ASSERT_EQ(ErrorStatusPB::ERROR_SERVER_TOO_BUSY, err->code());
+    ASSERT_GE(err->retry_after_ms(), 1);
+    num_shed++;
+  }
+  ASSERT_GT(num_shed, 0);
+  ASSERT_LT(num_shed, kNumCalls);
+  ASSERT_EQ(num_shed, service_pool_->RpcsShedFromQueueMetricForTests()->value());
+}
+
 // Test that outbound connections to the same server are reopen upon every RPC
 // call when the 'rpc_reopen_outbound_connections' flag is set.
 TEST_P(TestRpc, TestReopenOutboundConnections) {
@@ -535,6 +683,38 @@ TEST_P(TestRpc, TestCallLongerThanKeepalive) {
 }
 
 // Test that the RpcSidecar transfers the expected messages.
+// Test that the buffers which inbound transfers receive messages into are
+// reused, up to the capacity of the pool.
+TEST_F(TestRpc, TestTransferBufferPool) {
+  const int kMin = TransferBufferPool::kMinBufferSize;
+  TransferBufferPool pool(4 * kMin);
+
+  // Buffers of the same size class are reused.
+  uint8_t* buf = pool.Acquire(100);
+  pool.Release(buf, 100);
+  ASSERT_EQ(kMin, pool.cached_bytes());
+  ASSERT_EQ(buf, pool.Acquire(kMin));
+  ASSERT_EQ(0, pool.cached_bytes());
+  pool.Release(buf, kMin);
+
+  // Buffers of another size class aren't.
+  uint8_t* larger_buf = pool.Acquire(kMin + 1);
+  ASSERT_NE(buf, larger_buf);
+  pool.Release(larger_buf, kMin + 1);
+  ASSERT_EQ(3 * kMin, pool.cached_bytes());
+
+  // Buffers which don't fit in the pool any more are freed.
+  uint8_t* bufs[2] = { pool.Acquire(3 * kMin), pool.Acquire(3 * kMin) };
+  pool.Release(bufs[0], 3 * kMin);
+  pool.Release(bufs[1], 3 * kMin);
+  ASSERT_EQ(3 * kMin, pool.cached_bytes());
+
+  // Neither are buffers too large to be pooled.
+  const int kHuge = TransferBufferPool::kMaxBufferSize + 1;
+  pool.Release(pool.Acquire(kHuge), kHuge);
+  ASSERT_EQ(3 * kMin, pool.cached_bytes());
+}
+
 TEST_P(TestRpc, TestRpcSidecar) {
   // Set up server.
   Sockaddr server_addr;
@@ -561,6 +741,39 @@ TEST_P(TestRpc, TestRpcSidecar) {
   DoTestOutgoingSidecarExpectOK(p, 3000 * 1024, 2000 * 1024);
 }
 
+// Test that large response sidecars are compressed if so configured, and
+// transparently uncompressed by the client.
+TEST_P(TestRpc, TestSidecarCompression) {
+  FLAGS_rpc_sidecar_compression_codec = "lz4";
+  FLAGS_rpc_sidecar_compression_min_bytes = 1024;
+
+  Sockaddr server_addr;
+  bool enable_ssl = GetParam();
+  StartTestServer(&server_addr, enable_ssl);
+  shared_ptr<Messenger> client_messenger(CreateMessenger("Client", 1, enable_ssl));
+  Proxy p(client_messenger, server_addr, server_addr.host(),
+          GenericCalculatorService::static_service_name());
+
+  auto metric_map = server_messenger_->metric_entity()->UnsafeMetricsMapForTests();
+  auto* bytes_compressed = down_cast<Counter*>(
+      FindOrDie(metric_map, &METRIC_rpc_sidecar_bytes_compressed).get());
+  auto* bytes_saved = down_cast<Counter*>(
+      FindOrDie(metric_map, &METRIC_rpc_sidecar_compression_bytes_saved).get());
+
+  // Sidecars below the threshold, or which don't compress, are sent as they are.
+  DoTestSidecar(p, 123, 456, /*compressible=*/true);
+  DoTestSidecar(p, 3000 * 1024, 2000 * 1024);
+  ASSERT_EQ(0, bytes_compressed->value());
+
+  // Only the sidecar above the threshold is compressed.
+  DoTestSidecar(p, 123, 3000 * 1024, /*compressible=*/true);
+  ASSERT_EQ(3000 * 1024, bytes_compressed->value());
+  ASSERT_GT(bytes_saved->value(), 2000 * 1024);
+
+  // Sidecars of requests are unaffected.
+  DoTestOutgoingSidecarExpectOK(p, 3000 * 1024, 2000 * 1024);
+}
+
 TEST_P(TestRpc, TestRpcSidecarLimits) {
   {
     // Test that the limits on the number of sidecars is respected.
@@ -824,6 +1037,19 @@ TEST_P(TestRpc, TestRpcHandlerLatencyMetric) {
   // TODO: Implement an incoming queue latency test.
   // For now we just assert that the metric exists.
   ASSERT_TRUE(FindOrDie(metric_map, &METRIC_rpc_incoming_queue_time));
+
+  // The per-method queue time is recorded before the call is handled, and
+  // the handler's CPU time once the deferred call has been handed off.
+  scoped_refptr<Histogram> queue_time_histogram = down_cast<Histogram *>(
+      FindOrDie(metric_map, &METRIC_queue_time_kudu_rpc_test_CalculatorService_Sleep).get());
+  ASSERT_EQ(1, queue_time_histogram->TotalCount());
+  scoped_refptr<Histogram> cpu_time_histogram = down_cast<Histogram *>(
+      FindOrDie(metric_map,
+                &METRIC_handler_cpu_time_kudu_rpc_test_CalculatorService_Sleep).get());
+  ASSERT_EVENTUALLY([&]() {
+    ASSERT_EQ(1, cpu_time_histogram->TotalCount());
+  });
+  ASSERT_LT(cpu_time_histogram->MaxValueForTests(), sleep_micros);
 }
 
 static void DestroyMessengerCallback(shared_ptr<Messenger>* messenger,
@@ -17,6 +17,7 @@
 
 #include "kudu/rpc/rpc.h"
 
+#include <algorithm>
 #include <cstdlib>
 #include <string>
 
@@ -69,6 +70,12 @@ void RpcRetrier::DelayedRetry(Rpc* rpc, const Status& why_status) {
   // If the delay causes us to miss our deadline, RetryCb will fail the
   // RPC on our behalf.
   int num_ms = ++attempt_num_ + ((rand() % 5));
+  // If the server shed the call because it's overloaded, back off for at
+  // least as long as it asked to.
+  const ErrorStatusPB* err = controller_.error_response();
+  if (err && err->has_retry_after_ms()) {
+    num_ms = std::max<int>(num_ms, err->retry_after_ms());
+  }
   messenger_->ScheduleOnReactor(boost::bind(&RpcRetrier::DelayedRetryCb,
                                             this,
                                             rpc, _1),
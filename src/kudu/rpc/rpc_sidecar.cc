@@ -21,14 +21,20 @@
 #include <memory>
 #include <utility>
 
+#include <gflags/gflags_declare.h>
 #include <google/protobuf/repeated_field.h>
 
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/rpc/rpc_header.pb.h"
 #include "kudu/rpc/transfer.h"
+#include "kudu/util/compression/compression_codec.h"
 #include "kudu/util/faststring.h"
 #include "kudu/util/status.h"
 
+DECLARE_int32(rpc_max_message_size);
+
 using std::unique_ptr;
+using std::vector;
 
 namespace kudu {
 namespace rpc {
@@ -104,6 +110,45 @@ Status RpcSidecar::ParseSidecars(
   return Status::OK();
 }
 
+unique_ptr<RpcSidecar> RpcSidecar::Compress(const CompressionCodec& codec,
+                                            const Slice& sidecar) {
+  unique_ptr<faststring> buf(new faststring());
+  buf->resize(codec.MaxCompressedLength(sidecar.size()));
+  size_t compressed_size;
+  if (!codec.Compress(sidecar, buf->data(), &compressed_size).ok() ||
+      compressed_size >= sidecar.size()) {
+    return nullptr;
+  }
+  buf->resize(compressed_size);
+  return FromFaststring(std::move(buf));
+}
+
+Status RpcSidecar::UncompressSidecars(
+    const ::google::protobuf::RepeatedPtrField<CompressedSidecarPB>& compressed,
+    int num_sidecars, Slice* sidecars, vector<unique_ptr<faststring>>* bufs) {
+  for (const auto& pb : compressed) {
+    if (pb.idx() >= static_cast<uint32_t>(num_sidecars)) {
+      return Status::Corruption(strings::Substitute(
+          "Compressed sidecar $0 does not exist, only $1 were received",
+          pb.idx(), num_sidecars));
+    }
+    if (static_cast<int64_t>(pb.uncompressed_size()) > FLAGS_rpc_max_message_size) {
+      return Status::Corruption(strings::Substitute(
+          "Compressed sidecar $0 has uncompressed size $1, larger than the "
+          "maximum RPC message size", pb.idx(), pb.uncompressed_size()));
+    }
+    const CompressionCodec* codec;
+    RETURN_NOT_OK(GetCompressionCodec(pb.codec(), &codec));
+    unique_ptr<faststring> buf(new faststring());
+    buf->resize(pb.uncompressed_size());
+    RETURN_NOT_OK_PREPEND(codec->Uncompress(sidecars[pb.idx()], buf->data(), buf->size()),
+                          strings::Substitute("Could not uncompress sidecar $0", pb.idx()));
+    sidecars[pb.idx()] = Slice(*buf);
+    bufs->emplace_back(std::move(buf));
+  }
+  return Status::OK();
+}
+
 
 } // namespace rpc
 } // namespace kudu
@@ -18,6 +18,7 @@
 #define KUDU_RPC_RPC_SIDECAR_H
 
 #include <memory>
+#include <vector>
 
 #include <google/protobuf/repeated_field.h> // IWYU pragma: keep
 #include <google/protobuf/stubs/port.h>
@@ -26,11 +27,14 @@
 
 namespace kudu {
 
+class CompressionCodec;
 class Status;
 class faststring;
 
 namespace rpc {
 
+class CompressedSidecarPB;
+
 // An RpcSidecar is a mechanism which allows replies to RPCs to reference blocks of data
 // without extra copies. In other words, whenever a protobuf would have a large field
 // where additional copies become expensive, one may opt instead to use an RpcSidecar.
@@ -61,6 +65,18 @@ class RpcSidecar {
       const ::google::protobuf::RepeatedField<::google::protobuf::uint32>& offsets,
       Slice buffer, Slice* sidecars);
 
+  // Compresses 'sidecar' with 'codec'. Returns the compressed sidecar, or
+  // nullptr if compression doesn't make it smaller.
+  static std::unique_ptr<RpcSidecar> Compress(const CompressionCodec& codec,
+                                              const Slice& sidecar);
+
+  // Uncompresses the sidecars among the 'num_sidecars' of 'sidecars', parsed by
+  // ParseSidecars(), which 'compressed' describes. The uncompressed sidecars
+  // are appended to 'bufs', and their slices in 'sidecars' point into them.
+  static Status UncompressSidecars(
+      const ::google::protobuf::RepeatedPtrField<CompressedSidecarPB>& compressed,
+      int num_sidecars, Slice* sidecars, std::vector<std::unique_ptr<faststring>>* bufs);
+
   // Returns a Slice representation of the sidecar's data.
   virtual Slice AsSlice() const = 0;
   virtual ~RpcSidecar() { }
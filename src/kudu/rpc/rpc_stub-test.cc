@@ -471,6 +471,41 @@ TEST_F(RpcStubTest, TestDontHandleTimedOutCalls) {
   ASSERT_EQ(1, timed_out_in_queue->value());
 }
 
+// Test that calls of methods which run on reactor threads are handled even
+// while all of the service threads are busy.
+TEST_F(RpcStubTest, TestRunOnReactor) {
+  CalculatorServiceProxy p(client_messenger_, server_addr_, server_addr_.host());
+  vector<AsyncSleep*> sleeps;
+  ElementDeleter d(&sleeps);
+
+  // Send enough sleep calls to occupy the worker threads.
+  for (int i = 0; i < n_worker_threads_; i++) {
+    gscoped_ptr<AsyncSleep> sleep(new AsyncSleep);
+    sleep->rpc.set_timeout(MonoDelta::FromSeconds(10));
+    sleep->req.set_sleep_micros(1000 * 1000); // 1s
+    p.SleepAsync(sleep->req, &sleep->resp, &sleep->rpc,
+                 boost::bind(&CountDownLatch::CountDown, &sleep->latch));
+    sleeps.push_back(sleep.release());
+  }
+  const Histogram* queue_time_metric = service_pool_->IncomingQueueTimeMetricForTests();
+  while (queue_time_metric->TotalCount() < n_worker_threads_) {
+    SleepFor(MonoDelta::FromMilliseconds(1));
+  }
+
+  // WhoAmI doesn't wait for a service thread to free up.
+  RpcController rpc;
+  rpc.set_timeout(MonoDelta::FromMilliseconds(500));
+  WhoAmIRequestPB req;
+  WhoAmIResponsePB resp;
+  ASSERT_OK(p.WhoAmI(req, &resp, &rpc));
+  ASSERT_TRUE(resp.has_credentials());
+  ASSERT_EQ(n_worker_threads_ + 1, queue_time_metric->TotalCount());
+
+  for (AsyncSleep* s : sleeps) {
+    s->latch.Wait();
+  }
+}
+
 // Test which ensures that the RPC queue accepts requests with the earliest
 // deadline first (EDF), and upon overflow rejects requests with the latest deadlines.
 //
@@ -634,6 +669,14 @@ TEST_F(RpcStubTest, TestDumpSampledCalls) {
                       "    }");
   ASSERT_STR_CONTAINS(SecureDebugString(sampled_rpcs), "SleepRequestPB");
   ASSERT_STR_CONTAINS(SecureDebugString(sampled_rpcs), "duration_ms");
+
+  // The samples break the calls' time down into phases. Sleeping takes
+  // hardly any CPU time.
+  ASSERT_EQ(2, sampled_rpcs.methods(0).samples_size());
+  for (const auto& sample : sampled_rpcs.methods(0).samples()) {
+    ASSERT_TRUE(sample.timing().has_queue_time_us());
+    ASSERT_LT(sample.timing().cpu_time_us(), 100 * 1000);
+  }
 }
 
 namespace {
@@ -87,6 +87,10 @@ class MethodSampler {
                               const string& child_path,
                               RpczSamplePB* sample_pb);
 
+  // Sum up the trace metrics from 't' and its children into the phases
+  // of 'timing_pb'.
+  static void GetCallTiming(const Trace& t, RpcCallTimingPB* timing_pb);
+
   // An individual recorded sample.
   struct Sample {
     RequestHeader header;
@@ -186,6 +190,32 @@ void MethodSampler::GetTraceMetrics(const Trace& t,
   }
 }
 
+void MethodSampler::GetCallTiming(const Trace& t, RpcCallTimingPB* timing_pb) {
+  // The metrics are keyed by pointers which aren't necessarily the same for
+  // the same name, so compare them by value.
+  for (const auto& e : t.metrics().Get()) {
+    StringPiece name(e.first);
+    int64_t value = e.second;
+    if (name == RPC_QUEUE_TIME_METRIC_NAME) {
+      timing_pb->set_queue_time_us(timing_pb->queue_time_us() + value);
+    } else if (name.ends_with(".queue_time_us")) {
+      timing_pb->set_pool_queue_time_us(timing_pb->pool_queue_time_us() + value);
+    } else if (name == RPC_HANDLER_CPU_TIME_METRIC_NAME || name.ends_with(".run_cpu_time_us")) {
+      timing_pb->set_cpu_time_us(timing_pb->cpu_time_us() + value);
+    } else if (name == "row_lock_wait_us" || name == "mutex_wait_us") {
+      timing_pb->set_lock_wait_us(timing_pb->lock_wait_us() + value);
+    } else if (name == "fsync_us" || name == "fdatasync_us") {
+      timing_pb->set_io_wait_us(timing_pb->io_wait_us() + value);
+    } else if (name == "replication_time_us") {
+      timing_pb->set_replication_time_us(timing_pb->replication_time_us() + value);
+    }
+  }
+
+  for (const auto& child_pair : t.ChildTraces()) {
+    GetCallTiming(*child_pair.second.get(), timing_pb);
+  }
+}
+
 void MethodSampler::GetSamplePBs(RpczMethodPB* method_pb) {
   for (auto& bucket : buckets_) {
     if (bucket.last_sample_time.Load() == 0) continue;
@@ -196,6 +226,7 @@ void MethodSampler::GetSamplePBs(RpczMethodPB* method_pb) {
     sample_pb->set_trace(bucket.sample.trace->DumpToString(Trace::INCLUDE_TIME_DELTAS));
 
     GetTraceMetrics(*bucket.sample.trace.get(), "", sample_pb);
+    GetCallTiming(*bucket.sample.trace.get(), sample_pb->mutable_timing());
     sample_pb->set_duration_ms(bucket.sample.duration_ms);
   }
 }
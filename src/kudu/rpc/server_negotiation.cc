@@ -73,6 +73,7 @@ TAG_FLAG(rpc_inject_invalid_authn_token_ratio, runtime);
 TAG_FLAG(rpc_inject_invalid_authn_token_ratio, unsafe);
 
 DECLARE_bool(rpc_encrypt_loopback_connections);
+DECLARE_bool(rpc_tls_session_resumption);
 
 DEFINE_string(trusted_subnets,
               "127.0.0.0/8,10.0.0.0/8,172.16.0.0/12,192.168.0.0/16,169.254.0.0/16",
@@ -502,6 +503,9 @@ Status ServerNegotiation::HandleNegotiate(const NegotiatePB& request) {
   server_features_ = kSupportedServerRpcFeatureFlags;
   if (tls_context_->has_cert() && encryption_ != RpcEncryption::DISABLED) {
     server_features_.insert(TLS);
+    if (FLAGS_rpc_tls_session_resumption) {
+      server_features_.insert(TLS_SESSION_RESUMPTION);
+    }
     // If the remote peer is local, then we allow using TLS for authentication
     // without encryption or integrity.
     if (socket_->IsLoopbackConnection() && !FLAGS_rpc_encrypt_loopback_connections) {
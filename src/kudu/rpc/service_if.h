@@ -26,6 +26,7 @@
 #include <google/protobuf/message.h>
 
 #include "kudu/gutil/ref_counted.h"
+#include "kudu/rpc/rpc_header.pb.h"
 #include "kudu/util/metrics.h"
 
 namespace kudu {
@@ -41,6 +42,10 @@ class RpcContext;
 // by GeneratedServiceIf look up the RpcMethodInfo in order to handle
 // each RPC.
 struct RpcMethodInfo : public RefCountedThreadSafe<RpcMethodInfo> {
+  // The fully-qualified name of the method, e.g.
+  // "kudu.tserver.TabletServerService.Write".
+  std::string full_name;
+
   // Prototype protobufs for requests and responses.
   // These are empty protobufs which are cloned in order to provide an
   // instance for each request.
@@ -49,9 +54,21 @@ struct RpcMethodInfo : public RefCountedThreadSafe<RpcMethodInfo> {
 
   scoped_refptr<Histogram> handler_latency_histogram;
 
+  // Microseconds this method's calls waited in the service queue, and of CPU
+  // time the threads handling them spent in 'func'.
+  scoped_refptr<Histogram> queue_time_histogram;
+  scoped_refptr<Histogram> handler_cpu_time_histogram;
+
   // Whether we should track this method's result, using ResultTracker.
   bool track_result;
 
+  // The class of the service queue which this method's calls wait in.
+  RpcQueueClassPB queue_class;
+
+  // Whether this method's calls may be handled inline on the reactor thread
+  // which received them, rather than being queued for a service thread.
+  bool run_on_reactor;
+
   // The authorization function for this RPC. If this function
   // returns false, the RPC has already been handled (i.e. rejected)
   // by the authorization function.
@@ -26,6 +26,7 @@
 #include <vector>
 
 #include <boost/optional/optional.hpp>
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 
 #include "kudu/gutil/basictypes.h"
@@ -34,17 +35,24 @@
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/gutil/strings/join.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/sysinfo.h"
+#include "kudu/gutil/walltime.h"
 #include "kudu/rpc/inbound_call.h"
 #include "kudu/rpc/remote_method.h"
 #include "kudu/rpc/rpc_header.pb.h"
 #include "kudu/rpc/service_if.h"
 #include "kudu/rpc/service_queue.h"
+#include "kudu/util/debug-util.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/metrics.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/net/sockaddr.h"
+#include "kudu/util/probes.h"
 #include "kudu/util/status.h"
 #include "kudu/util/thread.h"
 #include "kudu/util/trace.h"
+#include "kudu/util/trace_metrics.h"
 
 using std::shared_ptr;
 using std::string;
@@ -55,13 +63,28 @@ METRIC_DEFINE_histogram(server, rpc_incoming_queue_time,
                         "RPC Queue Time",
                         kudu::MetricUnit::kMicroseconds,
                         "Number of microseconds incoming RPC requests spend in the worker queue",
-                        60000000LU, 3);
+                        60000000LU, 3, kudu::PER_CPU);
+
+METRIC_DEFINE_histogram(server, rpc_incoming_queue_time_default_class,
+                        "RPC Queue Time (Default Class)",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Number of microseconds incoming RPC requests of the default "
+                        "queue class spend in the worker queue",
+                        60000000LU, 3, kudu::PER_CPU);
+
+METRIC_DEFINE_histogram(server, rpc_incoming_queue_time_control_class,
+                        "RPC Queue Time (Control Class)",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Number of microseconds incoming RPC requests of the control "
+                        "queue class, e.g. Raft heartbeats, spend in the worker queue",
+                        60000000LU, 3, kudu::PER_CPU);
 
 METRIC_DEFINE_counter(server, rpcs_timed_out_in_queue,
                       "RPC Queue Timeouts",
                       kudu::MetricUnit::kRequests,
                       "Number of RPCs whose timeout elapsed while waiting "
-                      "in the service queue, and thus were not processed.");
+                      "to be handled, mostly in the service queue, and thus "
+                      "were not processed.");
 
 METRIC_DEFINE_counter(server, rpcs_queue_overflow,
                       "RPC Queue Overflows",
@@ -69,18 +92,99 @@ METRIC_DEFINE_counter(server, rpcs_queue_overflow,
                       "Number of RPCs dropped because the service queue "
                       "was full.");
 
+METRIC_DEFINE_counter(server, rpcs_shed_from_queue,
+                      "RPC Queue Sheds",
+                      kudu::MetricUnit::kRequests,
+                      "Number of RPCs rejected, rather than processed, after "
+                      "waiting too long in a service queue holding a standing "
+                      "backlog. See --rpc_service_queue_target_delay_ms.");
+
+DEFINE_int32(rpc_default_queue_class_weight, 1,
+             "Weight of the default class of incoming RPCs, relative to the other "
+             "classes, when service threads pick the next queued RPC to handle. "
+             "Each class of RPCs of a service is queued separately.");
+TAG_FLAG(rpc_default_queue_class_weight, advanced);
+
+DEFINE_int32(rpc_control_queue_class_weight, 4,
+             "Weight of the control class of incoming RPCs, e.g. Raft heartbeats "
+             "and pings, relative to the other classes, when service threads pick "
+             "the next queued RPC to handle. Each class of RPCs of a service is "
+             "queued separately.");
+TAG_FLAG(rpc_control_queue_class_weight, advanced);
+
+DEFINE_bool(rpc_run_methods_on_reactor, true,
+            "Whether to handle the calls of RPC methods declared cheap and "
+            "non-blocking inline on the reactor thread which received them, "
+            "sparing them the wait in the service queue and the hand-off to a "
+            "service thread.");
+TAG_FLAG(rpc_run_methods_on_reactor, advanced);
+TAG_FLAG(rpc_run_methods_on_reactor, runtime);
+
+DEFINE_bool(rpc_pin_service_threads, false,
+            "Whether to pin the threads of each RPC service pool to CPUs, the "
+            "N-th thread of a pool to the N-th CPU, wrapping around if there "
+            "are more threads than CPUs.");
+TAG_FLAG(rpc_pin_service_threads, experimental);
+
+DEFINE_int32(rpc_service_queue_target_delay_ms, 0,
+             "Target for the time incoming RPCs of the default queue class wait "
+             "in the service queue. If even the RPC which waited the least during "
+             "an interval of --rpc_service_queue_delay_interval_ms waited longer "
+             "than this, the RPCs which waited more than twice this long are "
+             "rejected, hinting their clients to back off, until the backlog "
+             "clears. If 0, RPCs are only rejected when the queue is full.");
+TAG_FLAG(rpc_service_queue_target_delay_ms, experimental);
+
+DEFINE_int32(rpc_service_queue_delay_interval_ms, 100,
+             "Interval over which the minimum time incoming RPCs wait in the "
+             "service queue is compared with --rpc_service_queue_target_delay_ms.");
+TAG_FLAG(rpc_service_queue_delay_interval_ms, experimental);
+
+static bool ValidateQueueClassWeight(const char* flagname, int32_t value) {
+  if (value <= 0) {
+    LOG(ERROR) << Substitute("$0 must be positive, value $1 is invalid", flagname, value);
+    return false;
+  }
+  return true;
+}
+DEFINE_validator(rpc_default_queue_class_weight, &ValidateQueueClassWeight);
+DEFINE_validator(rpc_control_queue_class_weight, &ValidateQueueClassWeight);
+
 namespace kudu {
 namespace rpc {
 
+namespace {
+
+// Returns the class of the service queue which 'call' waits in.
+int QueueClassOf(InboundCall* call) {
+  const RpcMethodInfo* method_info = call->method_info();
+  return method_info ? method_info->queue_class : DEFAULT_QUEUE_CLASS;
+}
+
+} // anonymous namespace
+
 ServicePool::ServicePool(gscoped_ptr<ServiceIf> service,
                          const scoped_refptr<MetricEntity>& entity,
                          size_t service_queue_length)
   : service_(std::move(service)),
-    service_queue_(service_queue_length),
+    service_queue_(service_queue_length,
+                   { FLAGS_rpc_default_queue_class_weight,
+                     FLAGS_rpc_control_queue_class_weight }),
     incoming_queue_time_(METRIC_rpc_incoming_queue_time.Instantiate(entity)),
+    class_incoming_queue_time_(
+        { METRIC_rpc_incoming_queue_time_default_class.Instantiate(entity),
+          METRIC_rpc_incoming_queue_time_control_class.Instantiate(entity) }),
     rpcs_timed_out_in_queue_(METRIC_rpcs_timed_out_in_queue.Instantiate(entity)),
     rpcs_queue_overflow_(METRIC_rpcs_queue_overflow.Instantiate(entity)),
+    rpcs_shed_from_queue_(METRIC_rpcs_shed_from_queue.Instantiate(entity)),
     closing_(false) {
+  static_assert(RpcQueueClassPB_ARRAYSIZE == 2,
+                "every queue class must have a weight and a metric");
+  if (FLAGS_rpc_service_queue_target_delay_ms > 0) {
+    queue_delay_controller_.reset(new QueueDelayController(
+        MonoDelta::FromMilliseconds(FLAGS_rpc_service_queue_target_delay_ms),
+        MonoDelta::FromMilliseconds(FLAGS_rpc_service_queue_delay_interval_ms)));
+  }
 }
 
 ServicePool::~ServicePool() {
@@ -92,6 +196,10 @@ Status ServicePool::Init(int num_threads) {
     scoped_refptr<kudu::Thread> new_thread;
     CHECK_OK(kudu::Thread::Create("service pool", "rpc worker",
         &ServicePool::RunThread, this, &new_thread));
+    if (FLAGS_rpc_pin_service_threads) {
+      WARN_NOT_OK(new_thread->SetCpuAffinity(i % base::NumCPUs()),
+                  "Could not pin service thread");
+    }
     threads_.push_back(new_thread);
   }
   return Status::OK();
@@ -134,6 +242,32 @@ void ServicePool::RejectTooBusy(InboundCall* c) {
              << service_queue_.ToString();
 }
 
+bool ServicePool::ShouldShed(InboundCall* call) {
+  if (!queue_delay_controller_ || QueueClassOf(call) != DEFAULT_QUEUE_CLASS) {
+    return false;
+  }
+  const InboundCallTiming& timing = call->timing();
+  return queue_delay_controller_->ShouldShed(timing.time_handled - timing.time_received,
+                                             timing.time_handled);
+}
+
+void ServicePool::RejectShed(InboundCall* c) {
+  const InboundCallTiming& timing = c->timing();
+  MonoDelta retry_after = queue_delay_controller_->standing_delay();
+  string err_msg =
+      Substitute("$0 request on $1 from $2 shed due to overload. It waited $3 "
+                 "in the service queue, where every call waited at least $4 "
+                 "recently.",
+                 c->remote_method().method_name(),
+                 service_->service_name(),
+                 c->remote_address().ToString(),
+                 (timing.time_handled - timing.time_received).ToString(),
+                 retry_after.ToString());
+  rpcs_shed_from_queue_->Increment();
+  KLOG_EVERY_N_SECS(WARNING, 1) << err_msg;
+  c->RespondServerTooBusy(Status::ServiceUnavailable(err_msg), retry_after);
+}
+
 RpcMethodInfo* ServicePool::LookupMethod(const RemoteMethod& method) {
   return service_->LookupMethod(method);
 }
@@ -156,11 +290,29 @@ Status ServicePool::QueueInboundCall(gscoped_ptr<InboundCall> call) {
                                            ", "));
   }
 
+  if (PREDICT_FALSE(c->ClientTimedOut())) {
+    // The call may have waited long for the reactor to read it in full.
+    TRACE_TO(c->trace(), "Skipping call since client already timed out");
+    rpcs_timed_out_in_queue_->Increment();
+    c->RespondFailure(ErrorStatusPB::ERROR_SERVER_TOO_BUSY,
+                      Status::TimedOut("Call timed out before being queued"));
+    return Status::OK();
+  }
+
+  const RpcMethodInfo* method_info = c->method_info();
+  if (method_info && method_info->run_on_reactor && FLAGS_rpc_run_methods_on_reactor) {
+    TRACE_TO(c->trace(), "Handling call on reactor thread");
+    RecordHandlingStarted(c);
+    HandleCall(c);
+    return Status::OK();
+  }
+
   TRACE_TO(c->trace(), "Inserting onto call queue");
+  KUDU_PROBE(rpc_queue_enter, c->remote_method().method_name().c_str(), c->call_id());
 
   // Queue message on service queue
   boost::optional<InboundCall*> evicted;
-  auto queue_status = service_queue_.Put(c, &evicted);
+  auto queue_status = service_queue_.Put(c, &evicted, QueueClassOf(c));
   if (queue_status == QUEUE_FULL) {
     RejectTooBusy(c);
     return Status::OK();
@@ -196,7 +348,7 @@ void ServicePool::RunThread() {
       return;
     }
 
-    incoming->RecordHandlingStarted(incoming_queue_time_);
+    RecordHandlingStarted(incoming.get());
     ADOPT_TRACE(incoming->trace());
 
     if (PREDICT_FALSE(incoming->ClientTimedOut())) {
@@ -215,11 +367,45 @@ void ServicePool::RunThread() {
       continue;
     }
 
+    if (PREDICT_FALSE(ShouldShed(incoming.get()))) {
+      TRACE_TO(incoming->trace(), "Shedding call since the service queue is backlogged");
+      RejectShed(incoming.release());
+      continue;
+    }
+
     TRACE_TO(incoming->trace(), "Handling call");
 
     // Release the InboundCall pointer -- when the call is responded to,
     // it will get deleted at that point.
-    service_->Handle(incoming.release());
+    HandleCall(incoming.release());
+  }
+}
+
+void ServicePool::RecordHandlingStarted(InboundCall* call) {
+  call->RecordHandlingStarted(incoming_queue_time_);
+  const InboundCallTiming& timing = call->timing();
+  class_incoming_queue_time_[QueueClassOf(call)]->Increment(
+      (timing.time_handled - timing.time_received).ToMicroseconds());
+}
+
+void ServicePool::HandleCall(InboundCall* call) {
+  // The call may have been responded to, and deleted, by the time Handle()
+  // returns.
+  scoped_refptr<Trace> trace(call->trace());
+  scoped_refptr<RpcMethodInfo> method_info(call->method_info());
+
+  MicrosecondsInt64 start_cpu_us = GetThreadCpuTimeMicros();
+  {
+    // Attribute stack samples taken while handling the call to its method.
+    // 'method_info' keeps the name alive until the tag is cleared.
+    ScopedThreadStackTag tag(method_info ? method_info->full_name.c_str() : nullptr);
+    service_->Handle(call);
+  }
+  int64_t cpu_us = GetThreadCpuTimeMicros() - start_cpu_us;
+
+  trace->metrics()->Increment(RPC_HANDLER_CPU_TIME_METRIC_NAME, cpu_us);
+  if (method_info && method_info->handler_cpu_time_histogram) {
+    method_info->handler_cpu_time_histogram->Increment(cpu_us);
   }
 }
 
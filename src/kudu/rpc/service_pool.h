@@ -19,6 +19,7 @@
 #define KUDU_SERVICE_POOL_H
 
 #include <cstddef>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -26,6 +27,7 @@
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/ref_counted.h"
+#include "kudu/rpc/rpc_header.pb.h"
 #include "kudu/rpc/rpc_service.h"
 #include "kudu/rpc/service_queue.h"
 #include "kudu/util/mutex.h"
@@ -48,6 +50,10 @@ struct RpcMethodInfo;
 
 // A pool of threads that handle new incoming RPC calls.
 // Also includes a queue that calls get pushed onto for handling by the pool.
+// Calls are queued separately per the queue class of their method (see
+// RpcQueueClassPB), and dequeued in proportion to the classes' weights.
+// Calls of methods which may run on reactor threads are handled inline,
+// without being queued.
 class ServicePool : public RpcService {
  public:
   ServicePool(gscoped_ptr<ServiceIf> service,
@@ -73,22 +79,53 @@ class ServicePool : public RpcService {
     return incoming_queue_time_.get();
   }
 
+  const Histogram* ClassIncomingQueueTimeMetricForTests(RpcQueueClassPB queue_class) const {
+    return class_incoming_queue_time_[queue_class].get();
+  }
+
   const Counter* RpcsQueueOverflowMetric() const {
     return rpcs_queue_overflow_.get();
   }
 
+  const Counter* RpcsShedFromQueueMetricForTests() const {
+    return rpcs_shed_from_queue_.get();
+  }
+
   const std::string service_name() const;
 
  private:
   void RunThread();
   void RejectTooBusy(InboundCall* c);
 
+  // Returns true if 'call', just dequeued, should be shed because the service
+  // queue holds a standing backlog. See QueueDelayController.
+  bool ShouldShed(InboundCall* call);
+
+  // Rejects 'c', shed because of a standing backlog, hinting its client when
+  // to retry it.
+  void RejectShed(InboundCall* c);
+
+  // Records that the handling of 'call' started, in the queue time metrics.
+  void RecordHandlingStarted(InboundCall* call);
+
+  // Hands 'call' to the service, recording the CPU time the current thread
+  // spends doing so in the call's trace and its method's histogram.
+  void HandleCall(InboundCall* call);
+
   gscoped_ptr<ServiceIf> service_;
   std::vector<scoped_refptr<kudu::Thread> > threads_;
   LifoServiceQueue service_queue_;
   scoped_refptr<Histogram> incoming_queue_time_;
+  // The queue time of the calls of each queue class, indexed by class.
+  std::vector<scoped_refptr<Histogram>> class_incoming_queue_time_;
   scoped_refptr<Counter> rpcs_timed_out_in_queue_;
   scoped_refptr<Counter> rpcs_queue_overflow_;
+  scoped_refptr<Counter> rpcs_shed_from_queue_;
+
+  // Sheds the calls of the default queue class once it holds a standing
+  // backlog, or null if --rpc_service_queue_target_delay_ms is 0. The calls
+  // of the control class are never shed.
+  std::unique_ptr<QueueDelayController> queue_delay_controller_;
 
   mutable Mutex shutdown_lock_;
   bool closing_;
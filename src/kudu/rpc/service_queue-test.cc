@@ -19,6 +19,7 @@
 #include <cstdint>
 #include <memory>
 #include <ostream>
+#include <set>
 #include <string>
 #include <thread>
 #include <vector>
@@ -29,6 +30,7 @@
 #include <gtest/gtest.h>
 
 #include "kudu/gutil/atomicops.h"
+#include "kudu/gutil/map-util.h"
 #include "kudu/gutil/port.h"
 #include "kudu/rpc/inbound_call.h"
 #include "kudu/rpc/service_queue.h"
@@ -36,6 +38,7 @@
 #include "kudu/util/stopwatch.h"
 #include "kudu/util/test_util.h"
 
+using std::set;
 using std::shared_ptr;
 using std::string;
 using std::unique_ptr;
@@ -147,5 +150,86 @@ TEST(TestServiceQueue, LifoServiceQueuePerf) {
   LOG(INFO) << "Avg idle workers:     " << total_idle_workers / static_cast<double>(total_sample);
 }
 
+// Test that each class of calls is bounded on its own, and that calls are
+// dequeued from the classes in proportion to their weights.
+TEST(TestServiceQueue, TestQueueClasses) {
+  LifoServiceQueue queue(3, { 1, 3 });
+  ASSERT_EQ(2, queue.num_classes());
+
+  // Fill up the queue of each class.
+  set<InboundCall*> class0_calls;
+  for (int queue_class = 0; queue_class < 2; queue_class++) {
+    for (int i = 0; i < 3; i++) {
+      InboundCall* call = new InboundCall(nullptr);
+      boost::optional<InboundCall*> evicted;
+      ASSERT_EQ(QUEUE_SUCCESS, queue.Put(call, &evicted, queue_class));
+      ASSERT_TRUE(evicted == boost::none);
+      if (queue_class == 0) {
+        class0_calls.insert(call);
+      }
+    }
+  }
+  ASSERT_EQ(6, queue.estimated_queue_length());
+
+  // Another call of class 0 can only take the place of a call of class 0.
+  {
+    InboundCall* call = new InboundCall(nullptr);
+    boost::optional<InboundCall*> evicted;
+    ASSERT_EQ(QUEUE_SUCCESS, queue.Put(call, &evicted, 0));
+    ASSERT_TRUE(evicted != boost::none);
+    ASSERT_EQ(1, class0_calls.erase(evicted.get()));
+    delete evicted.get();
+    class0_calls.insert(call);
+  }
+  ASSERT_EQ(6, queue.estimated_queue_length());
+
+  // Dequeue from another thread, since consumers are bound to their queue.
+  vector<int> dequeued_classes;
+  std::thread consumer([&]() {
+    unique_ptr<InboundCall> call;
+    for (int i = 0; i < 6; i++) {
+      CHECK(queue.BlockingGet(&call));
+      dequeued_classes.push_back(ContainsKey(class0_calls, call.get()) ? 0 : 1);
+    }
+  });
+  consumer.join();
+  queue.Shutdown();
+
+  // Class 1 gets three turns for every turn of class 0.
+  ASSERT_EQ(vector<int>({ 0, 1, 1, 1, 0, 0 }), dequeued_classes);
+}
+
+// Test that calls are only shed while the queue holds a standing backlog,
+// rather than during bursts.
+TEST(TestServiceQueue, TestQueueDelayController) {
+  const auto kTarget = MonoDelta::FromMilliseconds(5);
+  const auto kInterval = MonoDelta::FromMilliseconds(100);
+  const auto ms = [](int64_t n) { return MonoDelta::FromMilliseconds(n); };
+  QueueDelayController controller(kTarget, kInterval);
+  MonoTime now = MonoTime::Now();
+
+  // A burst of calls: some wait long, but others meet the target.
+  ASSERT_FALSE(controller.ShouldShed(ms(50), now));
+  ASSERT_FALSE(controller.ShouldShed(ms(1), now + ms(10)));
+  ASSERT_FALSE(controller.ShouldShed(ms(50), now + ms(20)));
+  ASSERT_FALSE(controller.ShouldShed(ms(50), now + ms(110)));
+  ASSERT_EQ(ms(1), controller.standing_delay());
+
+  // A whole interval during which no call meets the target.
+  ASSERT_FALSE(controller.ShouldShed(ms(20), now + ms(150)));
+  ASSERT_FALSE(controller.ShouldShed(ms(30), now + ms(200)));
+
+  // The calls waiting more than twice the target are now shed.
+  ASSERT_TRUE(controller.ShouldShed(ms(30), now + ms(220)));
+  ASSERT_EQ(ms(20), controller.standing_delay());
+  ASSERT_FALSE(controller.ShouldShed(ms(8), now + ms(230)));
+  ASSERT_TRUE(controller.ShouldShed(ms(11), now + ms(240)));
+
+  // Once an interval passes with a call meeting the target, shedding stops.
+  ASSERT_FALSE(controller.ShouldShed(ms(2), now + ms(250)));
+  ASSERT_FALSE(controller.ShouldShed(ms(50), now + ms(330)));
+  ASSERT_EQ(ms(2), controller.standing_delay());
+}
+
 } // namespace rpc
 } // namespace kudu
@@ -17,8 +17,10 @@
 
 #include "kudu/rpc/service_queue.h"
 
+#include <algorithm>
 #include <mutex>
 #include <ostream>
+#include <vector>
 
 #include <boost/optional/optional.hpp>
 
@@ -27,16 +29,30 @@
 namespace kudu {
 namespace rpc {
 
+constexpr uint64_t LifoServiceQueue::kStride;
+
 __thread LifoServiceQueue::ConsumerState* LifoServiceQueue::tl_consumer_ = nullptr;
 
 LifoServiceQueue::LifoServiceQueue(int max_size)
+    : LifoServiceQueue(max_size, { 1 }) {
+}
+
+LifoServiceQueue::LifoServiceQueue(int max_size, const std::vector<int>& class_weights)
    : shutdown_(false),
-     max_queue_size_(max_size) {
+     max_queue_size_(max_size),
+     queue_length_(0),
+     virtual_time_(0) {
   CHECK_GT(max_queue_size_, 0);
+  CHECK(!class_weights.empty());
+  classes_.reserve(class_weights.size());
+  for (int weight : class_weights) {
+    CHECK_GT(weight, 0);
+    classes_.emplace_back(weight);
+  }
 }
 
 LifoServiceQueue::~LifoServiceQueue() {
-  DCHECK(queue_.empty())
+  DCHECK_EQ(queue_length_, 0)
       << "ServiceQueue holds bare pointers at destruction time";
 }
 
@@ -51,10 +67,8 @@ bool LifoServiceQueue::BlockingGet(std::unique_ptr<InboundCall>* out) {
   while (true) {
     {
       std::lock_guard<simple_spinlock> l(lock_);
-      if (!queue_.empty()) {
-        auto it = queue_.begin();
-        out->reset(*it);
-        queue_.erase(it);
+      if (queue_length_ > 0) {
+        out->reset(PopNextCallUnlocked());
         return true;
       }
       if (PREDICT_FALSE(shutdown_)) {
@@ -74,16 +88,19 @@ bool LifoServiceQueue::BlockingGet(std::unique_ptr<InboundCall>* out) {
 }
 
 QueueStatus LifoServiceQueue::Put(InboundCall* call,
-                                  boost::optional<InboundCall*>* evicted) {
+                                  boost::optional<InboundCall*>* evicted,
+                                  int queue_class) {
+  DCHECK_GE(queue_class, 0);
+  DCHECK_LT(queue_class, classes_.size());
   std::unique_lock<simple_spinlock> l(lock_);
   if (PREDICT_FALSE(shutdown_)) {
     return QUEUE_SHUTDOWN;
   }
 
-  DCHECK(!(waiting_consumers_.size() > 0 && queue_.size() > 0));
+  DCHECK(!(waiting_consumers_.size() > 0 && queue_length_ > 0));
 
   // fast path
-  if (queue_.empty() && waiting_consumers_.size() > 0) {
+  if (queue_length_ == 0 && waiting_consumers_.size() > 0) {
     auto consumer = waiting_consumers_[waiting_consumers_.size() - 1];
     waiting_consumers_.pop_back();
     // Notify condition var(and wake up consumer thread) takes time,
@@ -93,23 +110,51 @@ QueueStatus LifoServiceQueue::Put(InboundCall* call,
     return QUEUE_SUCCESS;
   }
 
-  if (PREDICT_FALSE(queue_.size() >= max_queue_size_)) {
+  QueueClass* c = &classes_[queue_class];
+  if (PREDICT_FALSE(c->calls.size() >= max_queue_size_)) {
     // eviction
-    DCHECK_EQ(queue_.size(), max_queue_size_);
-    auto it = queue_.end();
+    DCHECK_EQ(c->calls.size(), max_queue_size_);
+    auto it = c->calls.end();
     --it;
     if (DeadlineLess(*it, call)) {
       return QUEUE_FULL;
     }
 
     *evicted = *it;
-    queue_.erase(it);
+    c->calls.erase(it);
+    queue_length_--;
   }
 
-  queue_.insert(call);
+  if (c->calls.empty()) {
+    c->pass = std::max(c->pass, virtual_time_);
+  }
+  c->calls.insert(call);
+  queue_length_++;
   return QUEUE_SUCCESS;
 }
 
+InboundCall* LifoServiceQueue::PopNextCallUnlocked() {
+  DCHECK(lock_.is_locked());
+  DCHECK_GT(queue_length_, 0);
+
+  // Dequeue from the non-empty class which is due the earliest.
+  QueueClass* next = nullptr;
+  for (auto& c : classes_) {
+    if (!c.calls.empty() && (next == nullptr || c.pass < next->pass)) {
+      next = &c;
+    }
+  }
+  DCHECK(next != nullptr);
+  virtual_time_ = next->pass;
+  next->pass += kStride / next->weight;
+
+  auto it = next->calls.begin();
+  InboundCall* call = *it;
+  next->calls.erase(it);
+  queue_length_--;
+  return call;
+}
+
 void LifoServiceQueue::Shutdown() {
   std::lock_guard<simple_spinlock> l(lock_);
   shutdown_ = true;
@@ -123,7 +168,7 @@ void LifoServiceQueue::Shutdown() {
 
 bool LifoServiceQueue::empty() const {
   std::lock_guard<simple_spinlock> l(lock_);
-  return queue_.empty();
+  return queue_length_ == 0;
 }
 
 int LifoServiceQueue::max_size() const {
@@ -134,12 +179,44 @@ std::string LifoServiceQueue::ToString() const {
   std::string ret;
 
   std::lock_guard<simple_spinlock> l(lock_);
-  for (const auto* t : queue_) {
-    ret.append(t->ToString());
-    ret.append("\n");
+  for (const auto& c : classes_) {
+    for (const auto* t : c.calls) {
+      ret.append(t->ToString());
+      ret.append("\n");
+    }
   }
   return ret;
 }
 
+QueueDelayController::QueueDelayController(const MonoDelta& target,
+                                           const MonoDelta& interval)
+    : target_(target),
+      interval_(interval),
+      standing_delay_(MonoDelta::FromNanoseconds(0)) {
+  DCHECK(target_.Initialized());
+  DCHECK(interval_.Initialized());
+}
+
+bool QueueDelayController::ShouldShed(const MonoDelta& queue_time, const MonoTime& now) {
+  std::lock_guard<simple_spinlock> l(lock_);
+  if (!interval_end_.Initialized()) {
+    interval_end_ = now + interval_;
+    interval_min_delay_ = queue_time;
+  } else if (now >= interval_end_) {
+    standing_delay_ = interval_min_delay_;
+    interval_end_ = now + interval_;
+    interval_min_delay_ = queue_time;
+  } else if (queue_time < interval_min_delay_) {
+    interval_min_delay_ = queue_time;
+  }
+  return standing_delay_ > target_ &&
+      queue_time.ToNanoseconds() > 2 * target_.ToNanoseconds();
+}
+
+MonoDelta QueueDelayController::standing_delay() const {
+  std::lock_guard<simple_spinlock> l(lock_);
+  return standing_delay_;
+}
+
 } // namespace rpc
 } // namespace kudu
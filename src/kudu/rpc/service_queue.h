@@ -17,6 +17,7 @@
 #ifndef KUDU_UTIL_SERVICE_QUEUE_H
 #define KUDU_UTIL_SERVICE_QUEUE_H
 
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <set>
@@ -72,30 +73,43 @@ enum QueueStatus {
 //   work rate, the queue implementation itself is never used. Thus, we can
 //   have a priority queue without paying extra for it in the common case.
 //
+// The queue may hold several classes of calls, each with its own bound and
+// weight: calls of a class only compete with the calls of the same class for
+// space in the queue, and only ever evict calls of the same class. Consumers
+// dequeue from the classes in proportion to their weights (using stride
+// scheduling), so that a class of expensive calls filling up its queue does
+// not hold up the calls of other classes, while none of the classes starves.
+//
 // NOTE: because of the use of thread-local consumer records, once a consumer
 // thread accesses one LifoServiceQueue, it becomes "bound" to that queue and
 // must never access any other instance.
 class LifoServiceQueue {
  public:
+  // Constructs a queue with a single class of calls.
   explicit LifoServiceQueue(int max_size);
 
+  // Constructs a queue with one class of calls per element of 'class_weights',
+  // each holding at most 'max_size' calls. Weights must be positive.
+  LifoServiceQueue(int max_size, const std::vector<int>& class_weights);
+
   ~LifoServiceQueue();
 
   // Get an element from the queue.  Returns false if we were shut down prior to
   // getting the element.
   bool BlockingGet(std::unique_ptr<InboundCall>* out);
 
-  // Add a new call to the queue.
+  // Add a new call of class 'queue_class' to the queue.
   // Returns:
   // - QUEUE_SHUTDOWN if Shutdown() has already been called.
-  // - QUEUE_FULL if the queue is full and 'call' has a later deadline than any
-  //   RPC already in the queue.
+  // - QUEUE_FULL if the queue of the class is full and 'call' has a later
+  //   deadline than any RPC of the class already in the queue.
   // - QUEUE_SUCCESS if 'call' was enqueued.
   //
   // In the case of a 'QUEUE_SUCCESS' response, the new element may have bumped
-  // another call out of the queue. In that case, *evicted will be set to the
-  // call that was bumped.
-  QueueStatus Put(InboundCall* call, boost::optional<InboundCall*>* evicted);
+  // another call of the class out of the queue. In that case, *evicted will be
+  // set to the call that was bumped.
+  QueueStatus Put(InboundCall* call, boost::optional<InboundCall*>* evicted,
+                  int queue_class = 0);
 
   // Shut down the queue.
   // When a blocking queue is shut down, no more elements can be added to it,
@@ -106,18 +120,19 @@ class LifoServiceQueue {
 
   bool empty() const;
 
+  // The maximum number of calls of each class.
   int max_size() const;
 
+  int num_classes() const {
+    return classes_.size();
+  }
+
   std::string ToString() const;
 
   // Return an estimate of the current queue length.
   int estimated_queue_length() const {
     ANNOTATE_IGNORE_READS_BEGIN();
-    // The C++ standard says that std::multiset::size must be constant time,
-    // so this method won't try to traverse any actual nodes of the underlying
-    // RB tree. Investigation of the libstdcxx implementation confirms that
-    // size() is a simple field access of the _Rb_tree structure.
-    int ret = queue_.size();
+    int ret = queue_length_;
     ANNOTATE_IGNORE_READS_END();
     return ret;
   }
@@ -200,6 +215,32 @@ class LifoServiceQueue {
     LifoServiceQueue* bound_queue_;
   };
 
+  // The queued calls of a class.
+  struct QueueClass {
+    explicit QueueClass(int weight)
+        : weight(weight),
+          pass(0) {
+    }
+
+    // The share of the consumers' time given to the class, relative to the
+    // other classes.
+    const int weight;
+
+    // The virtual time at which the class is next due to be dequeued from.
+    // Advances by kStride / 'weight' with every dequeued call.
+    uint64_t pass;
+
+    // The actual queue. Work is only added to the queue when there were no
+    // consumers available for a "direct hand-off".
+    std::multiset<InboundCall*, DeadlineLessStruct> calls;
+  };
+
+  // The stride of a class of weight 1.
+  static constexpr uint64_t kStride = 1 << 20;
+
+  // Removes the next call to handle from the queue, which must not be empty.
+  InboundCall* PopNextCallUnlocked();
+
   static __thread ConsumerState* tl_consumer_;
 
   mutable simple_spinlock lock_;
@@ -209,9 +250,16 @@ class LifoServiceQueue {
   // Stack of consumer threads which are currently waiting for work.
   std::vector<ConsumerState*> waiting_consumers_;
 
-  // The actual queue. Work is only added to the queue when there were no
-  // consumers available for a "direct hand-off".
-  std::multiset<InboundCall*, DeadlineLessStruct> queue_;
+  // The classes of queued calls, indexed by class.
+  std::vector<QueueClass> classes_;
+
+  // The total number of queued calls, over all the classes.
+  int queue_length_;
+
+  // The pass of the class last dequeued from. A class whose queue becomes
+  // non-empty catches up with it, so that it can't use up the time it spent
+  // idle by monopolizing the consumers afterwards.
+  uint64_t virtual_time_;
 
   // The total set of consumers who have ever accessed this queue.
   std::vector<std::unique_ptr<ConsumerState>> consumers_;
@@ -219,6 +267,46 @@ class LifoServiceQueue {
   DISALLOW_COPY_AND_ASSIGN(LifoServiceQueue);
 };
 
+// Decides which of the calls dequeued from a service queue to shed, using
+// the CoDel ("controlled delay") algorithm. If even the call which spent the
+// least time in the queue during an interval waited longer than the target
+// delay, the queue holds a standing backlog rather than a passing burst. Then,
+// until an interval passes in which some call met the target, the calls which
+// waited more than twice the target are shed, so that their clients back off
+// rather than the server doing work which they may have given up on.
+//
+// This class is thread-safe.
+class QueueDelayController {
+ public:
+  QueueDelayController(const MonoDelta& target, const MonoDelta& interval);
+
+  // Records that a call dequeued at 'now' spent 'queue_time' in the queue.
+  // Returns true if the call should be shed.
+  bool ShouldShed(const MonoDelta& queue_time, const MonoTime& now);
+
+  // The minimum time the calls dequeued during the last full interval spent
+  // in the queue: the time after which the clients of shed calls should
+  // retry them.
+  MonoDelta standing_delay() const;
+
+ private:
+  const MonoDelta target_;
+  const MonoDelta interval_;
+
+  mutable simple_spinlock lock_;
+
+  // The end of the current interval.
+  MonoTime interval_end_;
+
+  // The minimum queue time of the calls dequeued during the current interval.
+  MonoDelta interval_min_delay_;
+
+  // The minimum queue time of the calls dequeued during the last interval.
+  MonoDelta standing_delay_;
+
+  DISALLOW_COPY_AND_ASSIGN(QueueDelayController);
+};
+
 } // namespace rpc
 } // namespace kudu
 
@@ -19,13 +19,18 @@
 
 #include <sys/uio.h>
 
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
 #include <iostream>
+#include <mutex>
 #include <set>
+#include <utility>
 
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 
+#include "kudu/gutil/bits.h"
 #include "kudu/gutil/endian.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/strings/substitute.h"
@@ -55,6 +60,7 @@ namespace rpc {
 
 using std::ostringstream;
 using std::set;
+using std::shared_ptr;
 using std::string;
 using strings::Substitute;
 
@@ -69,10 +75,79 @@ using strings::Substitute;
 TransferCallbacks::~TransferCallbacks()
 {}
 
-InboundTransfer::InboundTransfer()
-  : total_length_(kMsgLengthPrefixLength),
+TransferBufferPool::TransferBufferPool(int64_t capacity_bytes)
+    : capacity_bytes_(capacity_bytes),
+      cached_bytes_(0),
+      free_buffers_(SizeClass(kMaxBufferSize) + 1) {
+}
+
+TransferBufferPool::~TransferBufferPool() {
+  for (auto& buffers : free_buffers_) {
+    for (uint8_t* buf : buffers) {
+      delete[] buf;
+    }
+  }
+}
+
+int TransferBufferPool::SizeClass(int32_t size) {
+  if (size > kMaxBufferSize) {
+    return -1;
+  }
+  return Bits::Log2Ceiling(std::max<int32_t>(size, kMinBufferSize)) -
+      Bits::Log2Ceiling(kMinBufferSize);
+}
+
+uint8_t* TransferBufferPool::Acquire(int32_t size) {
+  int size_class = SizeClass(size);
+  if (size_class < 0) {
+    return new uint8_t[size];
+  }
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    auto& buffers = free_buffers_[size_class];
+    if (!buffers.empty()) {
+      uint8_t* buf = buffers.back();
+      buffers.pop_back();
+      cached_bytes_ -= kMinBufferSize << size_class;
+      return buf;
+    }
+  }
+  return new uint8_t[kMinBufferSize << size_class];
+}
+
+void TransferBufferPool::Release(uint8_t* buf, int32_t size) {
+  int size_class = SizeClass(size);
+  if (size_class >= 0) {
+    int64_t buf_size = kMinBufferSize << size_class;
+    std::lock_guard<simple_spinlock> l(lock_);
+    if (cached_bytes_ + buf_size <= capacity_bytes_) {
+      free_buffers_[size_class].push_back(buf);
+      cached_bytes_ += buf_size;
+      return;
+    }
+  }
+  delete[] buf;
+}
+
+int64_t TransferBufferPool::cached_bytes() const {
+  std::lock_guard<simple_spinlock> l(lock_);
+  return cached_bytes_;
+}
+
+InboundTransfer::InboundTransfer(shared_ptr<TransferBufferPool> buffer_pool)
+  : buffer_pool_(std::move(buffer_pool)),
+    buf_size_(kMsgLengthPrefixLength),
+    buf_pooled_(false),
+    total_length_(kMsgLengthPrefixLength),
     cur_offset_(0) {
-  buf_.resize(kMsgLengthPrefixLength);
+  own_buf_.resize(kMsgLengthPrefixLength);
+  buf_ = own_buf_.data();
+}
+
+InboundTransfer::~InboundTransfer() {
+  if (buf_pooled_) {
+    buffer_pool_->Release(buf_, buf_size_);
+  }
 }
 
 Status InboundTransfer::ReceiveBuffer(Socket &socket) {
@@ -98,7 +173,7 @@ Status InboundTransfer::ReceiveBuffer(Socket &socket) {
 
     // The length prefix doesn't include its own 4 bytes, so we have to
     // add that back in.
-    total_length_ = NetworkByteOrder::Load32(&buf_[0]) + kMsgLengthPrefixLength;
+    total_length_ = NetworkByteOrder::Load32(buf_) + kMsgLengthPrefixLength;
     if (total_length_ > FLAGS_rpc_max_message_size) {
       return Status::NetworkError(Substitute(
           "RPC frame had a length of $0, but we only support messages up to $1 bytes "
@@ -108,7 +183,16 @@ Status InboundTransfer::ReceiveBuffer(Socket &socket) {
       return Status::NetworkError(Substitute("RPC frame had invalid length of $0",
                                              total_length_));
     }
-    buf_.resize(total_length_);
+    if (buffer_pool_) {
+      uint8_t* buf = buffer_pool_->Acquire(total_length_);
+      memcpy(buf, buf_, kMsgLengthPrefixLength);
+      buf_ = buf;
+      buf_pooled_ = true;
+    } else {
+      own_buf_.resize(total_length_);
+      buf_ = own_buf_.data();
+    }
+    buf_size_ = total_length_;
 
     // Fall through to receive the message body, which is likely to be already
     // available on the socket.
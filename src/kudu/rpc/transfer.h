@@ -21,7 +21,9 @@
 #include <array>
 #include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include <boost/intrusive/list_hook.hpp>
 #include <gflags/gflags_declare.h>
@@ -30,6 +32,7 @@
 #include "kudu/gutil/macros.h"
 #include "kudu/rpc/constants.h"
 #include "kudu/util/faststring.h"
+#include "kudu/util/locks.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/status.h"
 
@@ -55,6 +58,57 @@ class TransferLimits {
 
 typedef std::array<Slice, TransferLimits::kMaxPayloadSlices> TransferPayload;
 
+// A pool of the buffers which the inbound transfers of a reactor thread
+// receive messages into, so that receiving a message seldom has to allocate
+// memory for it. Buffers come in power-of-two size classes, from
+// kMinBufferSize to kMaxBufferSize bytes; larger messages are received into
+// buffers of their own.
+//
+// Buffers may be given back from any thread: the call or call response parsed
+// out of a transfer references its message in place, so the buffer is only
+// given back once the call is done with. Transfers share ownership of the
+// pool for the same reason.
+//
+// This class is thread-safe.
+class TransferBufferPool {
+ public:
+  enum {
+    kMinBufferSize = 4 * 1024,
+    kMaxBufferSize = 8 * 1024 * 1024
+  };
+
+  // Constructs a pool which keeps up to 'capacity_bytes' of free buffers.
+  explicit TransferBufferPool(int64_t capacity_bytes);
+  ~TransferBufferPool();
+
+  // Returns a buffer of at least 'size' bytes. It must be given back with
+  // Release(), for the same 'size'.
+  uint8_t* Acquire(int32_t size);
+
+  // Gives back 'buf', acquired for 'size' bytes.
+  void Release(uint8_t* buf, int32_t size);
+
+  // Returns the number of bytes of free buffers kept in the pool.
+  int64_t cached_bytes() const;
+
+ private:
+  // Returns the size class of buffers of 'size' bytes, or -1 if they are too
+  // large to be pooled.
+  static int SizeClass(int32_t size);
+
+  const int64_t capacity_bytes_;
+
+  // Protects 'cached_bytes_' and 'free_buffers_'.
+  mutable simple_spinlock lock_;
+
+  int64_t cached_bytes_;
+
+  // The free buffers of each size class, indexed by size class.
+  std::vector<std::vector<uint8_t*>> free_buffers_;
+
+  DISALLOW_COPY_AND_ASSIGN(TransferBufferPool);
+};
+
 // This class is used internally by the RPC layer to represent an inbound
 // transfer in progress.
 //
@@ -64,7 +118,10 @@ typedef std::array<Slice, TransferLimits::kMaxPayloadSlices> TransferPayload;
 class InboundTransfer {
  public:
 
-  InboundTransfer();
+  // If 'buffer_pool' is not null, the message is received into a buffer of the
+  // pool rather than into a buffer of its own.
+  explicit InboundTransfer(std::shared_ptr<TransferBufferPool> buffer_pool = nullptr);
+  ~InboundTransfer();
 
   // read from the socket into our buffer
   Status ReceiveBuffer(Socket &socket);
@@ -76,7 +133,7 @@ class InboundTransfer {
   bool TransferFinished() const;
 
   Slice data() const {
-    return Slice(buf_);
+    return Slice(buf_, buf_size_);
   }
 
   // Return a string indicating the status of this transfer (number of bytes received, etc)
@@ -87,7 +144,18 @@ class InboundTransfer {
 
   Status ProcessInboundHeader();
 
-  faststring buf_;
+  // The pool to receive the message into a buffer of, if any.
+  const std::shared_ptr<TransferBufferPool> buffer_pool_;
+
+  // Receives the length prefix, and the message itself unless it is received
+  // into a buffer of 'buffer_pool_'.
+  faststring own_buf_;
+
+  // The buffer the message is received into, and the number of bytes of it
+  // which are to be received: either 'own_buf_', or a pooled buffer.
+  uint8_t* buf_;
+  int32_t buf_size_;
+  bool buf_pooled_;
 
   int32_t total_length_;
   int32_t cur_offset_;
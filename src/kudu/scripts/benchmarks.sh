@@ -42,6 +42,7 @@ LOCAL_STATS_BASE="local-stats"
 NUM_MT_TABLET_TESTS=5
 MT_TABLET_TEST=mt-tablet-test
 RPC_BENCH_TEST=RpcBenchBenchmark
+RPC_BENCH_PAYLOAD_TEST=RpcBenchPayloadBenchmark
 CBTREE_TEST=cbtree-test
 BLOOM_TEST=BloomfileBenchmark
 MT_BLOOM_TEST=MultithreadedBloomfileBenchmark
@@ -197,6 +198,13 @@ run_benchmarks() {
       --gtest_filter=*BenchmarkCalls &> $LOGDIR/$RPC_BENCH_TEST$i.log
   done
 
+  # run rpc-bench payload size sweep 5 times. 10 seconds per payload size per run
+  for i in $(seq 1 $NUM_SAMPLES); do
+    KUDU_ALLOW_SLOW_TESTS=true ./build/latest/bin/rpc-bench \
+      --gtest_filter=*BenchmarkPayloadSizes --payload_sidecars=1 \
+      &> $LOGDIR/$RPC_BENCH_PAYLOAD_TEST$i.log
+  done
+
   # run cbtree-test 5 times. 20 seconds per run
   for i in $(seq 1 $NUM_SAMPLES); do
     KUDU_ALLOW_SLOW_TESTS=true ./build/latest/bin/cbtree-test \
@@ -370,6 +378,17 @@ parse_and_record_all_results() {
     record_result $BUILD_IDENTIFIER $RPC_BENCH_TEST $i $rate
   done
 
+  # parse the throughput per payload size out of the pairs of
+  # "Payload bytes:" and "MB/sec:" lines of the rpc-bench payload size sweep
+  for i in $(seq 1 $NUM_SAMPLES); do
+    paste -d ' ' \
+      <(grep "Payload bytes:" $LOGDIR/$RPC_BENCH_PAYLOAD_TEST$i.log | awk '{print $NF}') \
+      <(grep "MB/sec:" $LOGDIR/$RPC_BENCH_PAYLOAD_TEST$i.log | awk '{print $NF}') |
+    while read size rate; do
+      record_result $BUILD_IDENTIFIER ${RPC_BENCH_PAYLOAD_TEST}_$size $i $rate
+    done
+  done
+
   # parse latency numbers from single-threaded tserver benchmark
   for i in $(seq 1 $NUM_SAMPLES); do
     for metric in min mean percentile_95 percentile_99 percentile_99_9 ; do
@@ -502,6 +521,7 @@ load_stats_and_generate_plots() {
   load_and_generate_plot $WIRE_PROTOCOL_TEST wire-protocol-test
 
   load_and_generate_plot $RPC_BENCH_TEST rpc-bench-test
+  load_and_generate_plot "${RPC_BENCH_PAYLOAD_TEST}%" rpc-bench-payload-test
 
   load_and_generate_plot "${TS_INSERT_LATENCY}%" ts-insert-latency
 
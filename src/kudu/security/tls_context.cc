@@ -27,6 +27,7 @@
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <openssl/err.h>
+#include <openssl/rand.h>
 #include <openssl/ssl.h>
 #include <openssl/x509.h>
 #include <openssl/x509v3.h>
@@ -48,6 +49,7 @@
 
 using strings::Substitute;
 using std::string;
+using std::lock_guard;
 using std::unique_lock;
 using std::vector;
 
@@ -82,6 +84,27 @@ DEFINE_string(rpc_tls_min_protocol, "TLSv1",
               "'TLSv1.2'.");
 TAG_FLAG(rpc_tls_min_protocol, advanced);
 
+DEFINE_bool(rpc_tls_session_resumption, true,
+            "Whether to resume TLS sessions when reconnecting to RPC servers, "
+            "by session ticket or session ID. Resumed sessions skip the public "
+            "key operations of full TLS handshakes.");
+TAG_FLAG(rpc_tls_session_resumption, advanced);
+
+DEFINE_int32(rpc_tls_session_timeout_s, 3600,
+             "The time after which the TLS sessions established by an RPC server "
+             "may no longer be resumed by its clients, in seconds.");
+TAG_FLAG(rpc_tls_session_timeout_s, advanced);
+
+DEFINE_bool(rpc_tls_kernel_offload, false,
+            "Whether to hand the encryption and decryption of the records of "
+            "TLS-secured RPC connections over to the kernel (Linux kTLS), which "
+            "saves copies between user space and the kernel and may in turn "
+            "offload the work to a capable NIC. Only applies to TLSv1.2 "
+            "sessions with AES-GCM ciphers, so enabling it also limits the "
+            "negotiated protocol to TLSv1.2. Connections whose sessions can't "
+            "be offloaded keep being encrypted by OpenSSL.");
+TAG_FLAG(rpc_tls_kernel_offload, experimental);
+
 namespace kudu {
 namespace security {
 
@@ -94,6 +117,21 @@ template<> struct SslTypeTraits<X509_STORE_CTX> {
   static constexpr auto kFreeFunc = &X509_STORE_CTX_free;
 };
 
+namespace {
+
+// The maximum number of client sessions saved by a TlsContext.
+constexpr size_t kMaxClientSessions = 1024;
+
+// Session ID context of the sessions of servers, required by OpenSSL to resume
+// sessions of handshakes which verify the peer cert.
+constexpr unsigned char kSessionIdContext[] = "kudu-rpc";
+
+string ClientSessionKey(const string& peer, TlsVerificationMode mode) {
+  return Substitute("$0/$1", peer, static_cast<int>(mode));
+}
+
+} // anonymous namespace
+
 TlsContext::TlsContext()
     : lock_(RWMutex::Priority::PREFER_READING),
       trusted_cert_count_(0),
@@ -147,8 +185,31 @@ Status TlsContext::Init() {
                                    FLAGS_rpc_tls_min_protocol);
   }
 
+  if (!FLAGS_rpc_tls_session_resumption) {
+    options |= SSL_OP_NO_TICKET;
+  }
+#ifdef SSL_OP_NO_TLSv1_3
+  // The kernel can only take over the record layer of TLSv1.2 sessions: with
+  // TLSv1.3, post-handshake messages shift the record sequence numbers.
+  if (FLAGS_rpc_tls_kernel_offload) {
+    options |= SSL_OP_NO_TLSv1_3;
+  }
+#endif
   SSL_CTX_set_options(ctx_.get(), options);
 
+  // Let the clients of servers resume their sessions. Clients save sessions
+  // themselves, in SaveSession().
+  if (FLAGS_rpc_tls_session_resumption) {
+    OPENSSL_RET_NOT_OK(
+        SSL_CTX_set_session_id_context(ctx_.get(), kSessionIdContext,
+                                       sizeof(kSessionIdContext) - 1),
+        "failed to set TLS session ID context");
+    SSL_CTX_set_session_cache_mode(ctx_.get(), SSL_SESS_CACHE_SERVER);
+    SSL_CTX_set_timeout(ctx_.get(), FLAGS_rpc_tls_session_timeout_s);
+  } else {
+    SSL_CTX_set_session_cache_mode(ctx_.get(), SSL_SESS_CACHE_OFF);
+  }
+
   OPENSSL_RET_NOT_OK(
       SSL_CTX_set_cipher_list(ctx_.get(), FLAGS_rpc_tls_ciphers.c_str()),
       "failed to set TLS ciphers");
@@ -413,6 +474,7 @@ Status TlsContext::AdoptSignedCert(const Cert& cert) {
   OPENSSL_CHECK_OK(SSL_CTX_check_private_key(ctx_.get()))
     << "certificate does not match the private key";
 
+  RETURN_NOT_OK(ResetServerSessionsUnlocked());
   csr_ = boost::none;
 
   return Status::OK();
@@ -481,5 +543,57 @@ Status TlsContext::InitiateHandshake(TlsHandshakeType handshake_type,
   return Status::OK();
 }
 
+void TlsContext::ResumeSession(const string& peer, TlsHandshake* handshake) const {
+  SCOPED_OPENSSL_NO_PENDING_ERRORS;
+  CHECK(handshake->ssl_);
+  CHECK(!handshake->has_started_);
+  if (!FLAGS_rpc_tls_session_resumption) {
+    return;
+  }
+  c_unique_ptr<SSL_SESSION> session;
+  {
+    lock_guard<simple_spinlock> l(sessions_lock_);
+    auto it = client_sessions_.find(ClientSessionKey(peer, handshake->verification_mode_));
+    if (it == client_sessions_.end()) {
+      return;
+    }
+    session = std::move(it->second);
+    client_sessions_.erase(it);
+  }
+  // A session which can't be used only results in a full handshake.
+  if (SSL_set_session(handshake->ssl(), session.get()) != 1) {
+    ERR_clear_error();
+  }
+}
+
+void TlsContext::SaveSession(const string& peer, TlsHandshake* handshake) const {
+  if (!FLAGS_rpc_tls_session_resumption || !handshake->session_) {
+    return;
+  }
+  c_unique_ptr<SSL_SESSION> session = std::move(handshake->session_);
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+  // With TLS 1.3, sessions may only be resumed once the server sent a ticket.
+  if (!SSL_SESSION_is_resumable(session.get())) {
+    return;
+  }
+#endif
+  lock_guard<simple_spinlock> l(sessions_lock_);
+  if (client_sessions_.size() >= kMaxClientSessions) {
+    client_sessions_.erase(client_sessions_.begin());
+  }
+  client_sessions_[ClientSessionKey(peer, handshake->verification_mode_)] = std::move(session);
+}
+
+Status TlsContext::ResetServerSessionsUnlocked() {
+  // Drop the sessions cached by ID...
+  SSL_CTX_flush_sessions(ctx_.get(), 0);
+  // ... and rotate the keys encrypting session tickets.
+  unsigned char keys[48];
+  OPENSSL_RET_NOT_OK(RAND_bytes(keys, sizeof(keys)), "failed to generate session ticket keys");
+  OPENSSL_RET_NOT_OK(SSL_CTX_set_tlsext_ticket_keys(ctx_.get(), keys, sizeof(keys)),
+                     "failed to set session ticket keys");
+  return Status::OK();
+}
+
 } // namespace security
 } // namespace kudu
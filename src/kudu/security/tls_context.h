@@ -20,6 +20,7 @@
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <boost/optional/optional.hpp>
@@ -161,6 +162,19 @@ class TlsContext {
   Status InitiateHandshake(TlsHandshakeType handshake_type,
                            TlsHandshake* handshake) const WARN_UNUSED_RESULT;
 
+  // Arranges for the client 'handshake' with 'peer' to resume the session of
+  // the last handshake with 'peer' saved by SaveSession(), if any, which
+  // spares both ends the public key operations of a full handshake. A saved
+  // session is resumed at most once.
+  //
+  // Must be called after setting the verification mode of 'handshake', and
+  // before the first call to TlsHandshake::Continue().
+  void ResumeSession(const std::string& peer, TlsHandshake* handshake) const;
+
+  // Saves the session of the client 'handshake' with 'peer', which must have
+  // been finished successfully, for the next handshake with 'peer' to resume.
+  void SaveSession(const std::string& peer, TlsHandshake* handshake) const;
+
   // Return the number of certs that have been marked as trusted.
   // Used by tests.
   int trusted_cert_count_for_tests() const {
@@ -174,6 +188,10 @@ class TlsContext {
 
   Status VerifyCertChainUnlocked(const Cert& cert) WARN_UNUSED_RESULT;
 
+  // Prevents the resumption of the sessions established so far by the
+  // clients of this server, which refer to the cert being replaced.
+  Status ResetServerSessionsUnlocked() WARN_UNUSED_RESULT;
+
   // Protects all members.
   //
   // Taken in write mode when any changes are modifying the underlying SSL_CTX
@@ -185,6 +203,12 @@ class TlsContext {
   bool has_cert_;
   bool is_external_cert_;
   boost::optional<CertSignRequest> csr_;
+
+  // Protects client_sessions_.
+  mutable simple_spinlock sessions_lock_;
+
+  // The sessions saved by SaveSession(), keyed by peer and verification mode.
+  mutable std::unordered_map<std::string, c_unique_ptr<SSL_SESSION>> client_sessions_;
 };
 
 } // namespace security
@@ -34,6 +34,7 @@
 #include "kudu/security/security-test-util.h"
 #include "kudu/security/tls_context.h"
 #include "kudu/util/monotime.h"
+#include "kudu/util/net/socket.h"
 #include "kudu/util/scoped_cleanup.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/status.h"
@@ -127,6 +128,47 @@ class TestTlsHandshakeBase : public KuduTest {
     return Status::OK();
   }
 
+  // Run a handshake with 'peer' which resumes the session saved by the
+  // previous one, if any, and saves its own session. Sets 'session_reused' to
+  // whether the session was resumed.
+  Status RunResumableHandshake(const string& peer, bool* session_reused) {
+    TlsHandshake client, server;
+    RETURN_NOT_OK(client_tls_.InitiateHandshake(TlsHandshakeType::CLIENT, &client));
+    RETURN_NOT_OK(server_tls_.InitiateHandshake(TlsHandshakeType::SERVER, &server));
+    client.set_verification_mode(TlsVerificationMode::VERIFY_NONE);
+    server.set_verification_mode(TlsVerificationMode::VERIFY_NONE);
+    client_tls_.ResumeSession(peer, &client);
+
+    // When resuming a session, the client is done before the server.
+    bool client_done = false, server_done = false;
+    string to_client;
+    string to_server;
+    while (!server_done) {
+      if (!client_done) {
+        Status s = client.Continue(to_client, &to_server);
+        if (!s.ok() && !s.IsIncomplete()) {
+          return s.CloneAndPrepend("client error");
+        }
+        client_done = s.ok();
+      }
+      Status s = server.Continue(to_server, &to_client);
+      if (!s.ok() && !s.IsIncomplete()) {
+        return s.CloneAndPrepend("server error");
+      }
+      server_done = s.ok();
+    }
+    if (!client_done) {
+      RETURN_NOT_OK(client.Continue(to_client, &to_server));
+    }
+    *session_reused = client.session_reused();
+
+    Socket socket;
+    RETURN_NOT_OK(client.FinishNoWrap(socket));
+    RETURN_NOT_OK(server.FinishNoWrap(socket));
+    client_tls_.SaveSession(peer, &client);
+    return Status::OK();
+  }
+
   TlsContext client_tls_;
   TlsContext server_tls_;
 
@@ -215,6 +257,37 @@ TEST_F(TestTlsHandshake, TestHandshakeSequence) {
   ASSERT_EQ(buf2.size(), 0);
 }
 
+// Tests that clients resume the TLS sessions they saved for the same peer, and
+// that the server doesn't let sessions with its former cert be resumed.
+TEST_F(TestTlsHandshake, TestSessionResumption) {
+  ASSERT_OK(server_tls_.GenerateSelfSignedCertAndKey());
+
+  bool reused;
+  ASSERT_OK(RunResumableHandshake("server", &reused));
+  ASSERT_FALSE(reused);
+  ASSERT_OK(RunResumableHandshake("server", &reused));
+  ASSERT_TRUE(reused);
+  ASSERT_OK(RunResumableHandshake("server", &reused));
+  ASSERT_TRUE(reused);
+
+  // Sessions are saved per peer.
+  ASSERT_OK(RunResumableHandshake("other-server", &reused));
+  ASSERT_FALSE(reused);
+
+  // Once the server adopts a signed cert, it negotiates new sessions.
+  PrivateKey ca_key;
+  Cert ca_cert;
+  ASSERT_OK(GenerateSelfSignedCAForTests(&ca_key, &ca_cert));
+  Cert cert;
+  ASSERT_OK(CertSigner(&ca_cert, &ca_key).Sign(*server_tls_.GetCsrIfNecessary(), &cert));
+  ASSERT_OK(server_tls_.AddTrustedCertificate(ca_cert));
+  ASSERT_OK(server_tls_.AdoptSignedCert(cert));
+  ASSERT_OK(RunResumableHandshake("server", &reused));
+  ASSERT_FALSE(reused);
+  ASSERT_OK(RunResumableHandshake("server", &reused));
+  ASSERT_TRUE(reused);
+}
+
 // Tests that the TlsContext can transition from self signed cert to signed
 // cert, and that it rejects invalid certs along the way. We are testing this
 // here instead of in a dedicated TlsContext test because it requires completing
@@ -20,6 +20,7 @@
 #include <memory>
 #include <string>
 
+#include <gflags/gflags_declare.h>
 #include <openssl/ssl.h>
 #include <openssl/x509.h>
 #include <openssl/x509v3.h>
@@ -35,6 +36,8 @@
 #include "kudu/security/x509_check_host.h"
 #endif // OPENSSL_VERSION_NUMBER
 
+DECLARE_bool(rpc_tls_kernel_offload);
+
 using std::string;
 using std::unique_ptr;
 using strings::Substitute;
@@ -199,6 +202,7 @@ Status TlsHandshake::Finish(unique_ptr<Socket>* socket) {
   SCOPED_OPENSSL_NO_PENDING_ERRORS;
   RETURN_NOT_OK(GetCerts());
   RETURN_NOT_OK(Verify(**socket));
+  session_ = ssl_make_unique(SSL_get1_session(ssl_.get()));
 
   int fd = (*socket)->Release();
 
@@ -210,7 +214,11 @@ Status TlsHandshake::Finish(unique_ptr<Socket>* socket) {
   }
 
   // Transfer the SSL instance to the socket.
-  socket->reset(new TlsSocket(fd, std::move(ssl_)));
+  TlsSocket* tls_socket = new TlsSocket(fd, std::move(ssl_));
+  socket->reset(tls_socket);
+  if (FLAGS_rpc_tls_kernel_offload) {
+    tls_socket->EnableKernelTls();
+  }
 
   return Status::OK();
 }
@@ -218,7 +226,9 @@ Status TlsHandshake::Finish(unique_ptr<Socket>* socket) {
 Status TlsHandshake::FinishNoWrap(const Socket& socket) {
   SCOPED_OPENSSL_NO_PENDING_ERRORS;
   RETURN_NOT_OK(GetCerts());
-  return Verify(socket);
+  RETURN_NOT_OK(Verify(socket));
+  session_ = ssl_make_unique(SSL_get1_session(ssl_.get()));
+  return Status::OK();
 }
 
 Status TlsHandshake::GetLocalCert(Cert* cert) const {
@@ -251,6 +261,11 @@ string TlsHandshake::GetProtocol() const {
   return SSL_get_version(ssl_.get());
 }
 
+bool TlsHandshake::session_reused() const {
+  CHECK(has_started_);
+  return SSL_session_reused(ssl_.get());
+}
+
 string TlsHandshake::GetCipherDescription() const {
   SCOPED_OPENSSL_NO_PENDING_ERRORS;
   CHECK(has_started_);
@@ -134,6 +134,11 @@ class TlsHandshake {
   // Only valid to call after the handshake is complete and before 'Finish()'.
   std::string GetCipherDescription() const;
 
+  // Returns true if the handshake resumed a previous TLS session rather than
+  // negotiating a new one. Only valid to call after the handshake is complete
+  // and before 'Finish()'.
+  bool session_reused() const;
+
  private:
   friend class TlsContext;
 
@@ -165,6 +170,10 @@ class TlsHandshake {
 
   Cert local_cert_;
   Cert remote_cert_;
+
+  // The session of the handshake, once verified by 'Finish' or 'FinishNoWrap'.
+  // Saved by TlsContext::SaveSession() for later resumption.
+  c_unique_ptr<SSL_SESSION> session_;
 };
 
 } // namespace security
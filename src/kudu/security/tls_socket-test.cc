@@ -34,11 +34,14 @@
 #include <thread>
 #include <vector>
 
+#include <gflags/gflags_declare.h>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 
+#include "kudu/gutil/casts.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/security/tls_context.h"
+#include "kudu/security/tls_socket.h"
 #include "kudu/util/countdown_latch.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/net/sockaddr.h"
@@ -50,6 +53,8 @@
 #include "kudu/util/test_macros.h"
 #include "kudu/util/test_util.h"
 
+DECLARE_bool(rpc_tls_kernel_offload);
+
 using std::string;
 using std::thread;
 using std::unique_ptr;
@@ -335,5 +340,58 @@ TEST_F(TlsSocketTest, TestNonBlockingWritev) {
   ASSERT_OK(client_sock->Close());
 }
 
+class KernelTlsSocketTest : public TlsSocketTest {
+ public:
+  void SetUp() override {
+    // The TLS contexts of both ends of the connections are initialized after
+    // the flag is set.
+    FLAGS_rpc_tls_kernel_offload = true;
+    TlsSocketTest::SetUp();
+  }
+};
+
+// Test that data makes it through connections whose records may be encrypted
+// by the kernel, both ways and with vectored writes. Hosts without kTLS
+// support fall back to OpenSSL.
+TEST_F(KernelTlsSocketTest, TestEcho) {
+  Random rng(GetRandomSeed32());
+
+  EchoServer server;
+  NO_FATALS(server.Start());
+
+  unique_ptr<Socket> client_sock;
+  NO_FATALS(ConnectClient(server.listen_addr(), &client_sock));
+  const auto* tls_sock = down_cast<TlsSocket*>(client_sock.get());
+  LOG(INFO) << "kernel TLS transmission: " << tls_sock->kernel_tls_tx()
+            << ", reception: " << tls_sock->kernel_tls_rx();
+
+  unique_ptr<uint8_t[]> buf(new uint8_t[kEchoChunkSize]);
+  unique_ptr<uint8_t[]> rbuf(new uint8_t[kEchoChunkSize]);
+  for (int i = 0; i < 3; i++) {
+    RandomString(buf.get(), kEchoChunkSize, &rng);
+    vector<struct iovec> iov = ChunkIOVec(&rng, buf.get(), kEchoChunkSize, 1024 * 1024);
+    while (!iov.empty()) {
+      int32_t n;
+      ASSERT_OK(client_sock->Writev(&iov[0], iov.size(), &n));
+      while (n > 0 && n >= iov[0].iov_len) {
+        n -= iov[0].iov_len;
+        iov.erase(iov.begin());
+      }
+      if (n > 0) {
+        iov[0].iov_len -= n;
+        iov[0].iov_base = reinterpret_cast<uint8_t*>(iov[0].iov_base) + n;
+      }
+    }
+
+    size_t nread;
+    ASSERT_OK(client_sock->BlockingRecv(rbuf.get(), kEchoChunkSize, &nread,
+        MonoTime::Now() + kTimeout));
+    ASSERT_EQ(0, memcmp(buf.get(), rbuf.get(), kEchoChunkSize));
+  }
+
+  server.Stop();
+  ASSERT_OK(client_sock->Close());
+}
+
 } // namespace security
 } // namespace kudu
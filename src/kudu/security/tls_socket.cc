@@ -17,25 +17,202 @@
 
 #include "kudu/security/tls_socket.h"
 
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
 #include <sys/uio.h>
 
 #include <cerrno>
+#include <cstring>
 #include <utility>
 
 #include <glog/logging.h>
 #include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
 
 #include "kudu/gutil/basictypes.h"
 #include "kudu/security/openssl_util.h"
 #include "kudu/util/errno.h"
 #include "kudu/util/net/socket.h"
 
+// Kernel TLS needs the Linux kTLS UAPI, and OpenSSL 1.1.0 or later for the
+// TLS PRF and the accessors of the session's master key and randoms.
+#if defined(__linux__) && OPENSSL_VERSION_NUMBER >= 0x10100000L && defined(__has_include)
+#if __has_include(<linux/tls.h>)
+#include <linux/tls.h>
+#include <openssl/kdf.h>
+#define KUDU_HAS_KERNEL_TLS 1
+#endif
+#endif
+
+#ifdef KUDU_HAS_KERNEL_TLS
+// Not all libc headers define these yet.
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+#ifndef TCP_ULP
+#define TCP_ULP 31
+#endif
+#endif
+
 namespace kudu {
 namespace security {
 
+#ifdef KUDU_HAS_KERNEL_TLS
+template<> struct SslTypeTraits<EVP_PKEY_CTX> {
+  static constexpr auto kFreeFunc = &EVP_PKEY_CTX_free;
+};
+
+namespace {
+
+// Computes the first 'len' bytes of the key block of the TLS 1.2 session of
+// 'ssl' (RFC 5246, section 6.3), using the PRF hashing with 'md'.
+Status DeriveKeyBlock(SSL* ssl, const EVP_MD* md, uint8_t* key_block, size_t len) {
+  uint8_t master_key[SSL_MAX_MASTER_KEY_LENGTH];
+  size_t master_key_len = SSL_SESSION_get_master_key(
+      SSL_get_session(ssl), master_key, sizeof(master_key));
+  uint8_t client_random[SSL3_RANDOM_SIZE];
+  uint8_t server_random[SSL3_RANDOM_SIZE];
+  if (master_key_len == 0 ||
+      SSL_get_client_random(ssl, client_random, sizeof(client_random)) != sizeof(client_random) ||
+      SSL_get_server_random(ssl, server_random, sizeof(server_random)) != sizeof(server_random)) {
+    return Status::IllegalState("TLS session keys are not available");
+  }
+
+  static const char kLabel[] = "key expansion";
+  auto ctx = ssl_make_unique(EVP_PKEY_CTX_new_id(EVP_PKEY_TLS1_PRF, nullptr));
+  OPENSSL_RET_IF_NULL(ctx, "failed to create TLS PRF context");
+  OPENSSL_RET_NOT_OK(EVP_PKEY_derive_init(ctx.get()), "failed to initialize TLS PRF");
+  OPENSSL_RET_NOT_OK(EVP_PKEY_CTX_set_tls1_prf_md(ctx.get(), md), "failed to set TLS PRF digest");
+  OPENSSL_RET_NOT_OK(EVP_PKEY_CTX_set1_tls1_prf_secret(ctx.get(), master_key, master_key_len),
+                     "failed to set TLS PRF secret");
+  OPENSSL_RET_NOT_OK(EVP_PKEY_CTX_add1_tls1_prf_seed(
+                         ctx.get(), reinterpret_cast<const uint8_t*>(kLabel), sizeof(kLabel) - 1),
+                     "failed to set TLS PRF seed");
+  OPENSSL_RET_NOT_OK(EVP_PKEY_CTX_add1_tls1_prf_seed(ctx.get(), server_random,
+                                                     sizeof(server_random)),
+                     "failed to set TLS PRF seed");
+  OPENSSL_RET_NOT_OK(EVP_PKEY_CTX_add1_tls1_prf_seed(ctx.get(), client_random,
+                                                     sizeof(client_random)),
+                     "failed to set TLS PRF seed");
+  OPENSSL_RET_NOT_OK(EVP_PKEY_derive(ctx.get(), key_block, &len), "failed to derive TLS keys");
+  OPENSSL_cleanse(master_key, sizeof(master_key));
+  return Status::OK();
+}
+
+// Installs the state of one direction ('optname' is TLS_TX or TLS_RX) of an
+// AES-GCM TLS 1.2 session into the kernel, given the direction's write key
+// and implicit nonce (the 'salt'). CryptoInfo is one of the kernel's
+// tls12_crypto_info_aes_gcm_* structures.
+template<typename CryptoInfo>
+Status InstallCryptoInfo(int fd, int optname, uint16_t cipher_type,
+                         const uint8_t* key, const uint8_t* salt) {
+  CryptoInfo info;
+  memset(&info, 0, sizeof(info));
+  info.info.version = TLS_1_2_VERSION;
+  info.info.cipher_type = cipher_type;
+  memcpy(info.key, key, sizeof(info.key));
+  memcpy(info.salt, salt, sizeof(info.salt));
+  // The Finished message of the handshake was the first record protected by
+  // the session's keys in either direction, so application data starts at
+  // sequence number 1. Like OpenSSL, the kernel uses the sequence number as
+  // the explicit part of the nonce.
+  info.rec_seq[sizeof(info.rec_seq) - 1] = 1;
+  memcpy(info.iv, info.rec_seq, sizeof(info.iv));
+  int ret = setsockopt(fd, SOL_TLS, optname, &info, sizeof(info));
+  int err = errno;
+  OPENSSL_cleanse(&info, sizeof(info));
+  if (ret != 0) {
+    return Status::NetworkError("failed to install TLS keys into the kernel",
+                                ErrnoToString(err), err);
+  }
+  return Status::OK();
+}
+
+} // anonymous namespace
+#endif // KUDU_HAS_KERNEL_TLS
+
 TlsSocket::TlsSocket(int fd, c_unique_ptr<SSL> ssl)
     : Socket(fd),
-      ssl_(std::move(ssl)) {
+      ssl_(std::move(ssl)),
+      kernel_tls_tx_(false),
+      kernel_tls_rx_(false) {
+}
+
+void TlsSocket::EnableKernelTls() {
+#ifdef KUDU_HAS_KERNEL_TLS
+  SCOPED_OPENSSL_NO_PENDING_ERRORS;
+  CHECK(ssl_);
+  if (SSL_version(ssl_.get()) != TLS1_2_VERSION) {
+    return;
+  }
+  uint16_t cipher_type;
+  size_t key_len;
+  const EVP_MD* md;
+  switch (SSL_CIPHER_get_cipher_nid(SSL_get_current_cipher(ssl_.get()))) {
+    case NID_aes_128_gcm:
+      cipher_type = TLS_CIPHER_AES_GCM_128;
+      key_len = TLS_CIPHER_AES_GCM_128_KEY_SIZE;
+      md = EVP_sha256();
+      break;
+#ifdef TLS_CIPHER_AES_GCM_256
+    case NID_aes_256_gcm:
+      cipher_type = TLS_CIPHER_AES_GCM_256;
+      key_len = TLS_CIPHER_AES_GCM_256_KEY_SIZE;
+      md = EVP_sha384();
+      break;
+#endif
+    default:
+      return;
+  }
+
+  // AES-GCM suites have no MAC keys: the key block starts with the client and
+  // server write keys, followed by their 4-byte implicit nonces.
+  constexpr size_t kSaltLen = TLS_CIPHER_AES_GCM_128_SALT_SIZE;
+  uint8_t key_block[2 * (32 + kSaltLen)];
+  Status s = DeriveKeyBlock(ssl_.get(), md, key_block, 2 * (key_len + kSaltLen));
+  if (!s.ok()) {
+    VLOG(1) << "not offloading TLS to the kernel: " << s.ToString();
+    return;
+  }
+  const uint8_t* client_key = key_block;
+  const uint8_t* server_key = client_key + key_len;
+  const uint8_t* client_salt = server_key + key_len;
+  const uint8_t* server_salt = client_salt + kSaltLen;
+  bool is_server = SSL_is_server(ssl_.get());
+  const uint8_t* tx_key = is_server ? server_key : client_key;
+  const uint8_t* tx_salt = is_server ? server_salt : client_salt;
+  const uint8_t* rx_key = is_server ? client_key : server_key;
+  const uint8_t* rx_salt = is_server ? client_salt : server_salt;
+
+  static const char kUlp[] = "tls";
+  if (setsockopt(GetFd(), IPPROTO_TCP, TCP_ULP, kUlp, sizeof(kUlp)) != 0) {
+    int err = errno;
+    VLOG(1) << "not offloading TLS to the kernel: " << ErrnoToString(err);
+    OPENSSL_cleanse(key_block, sizeof(key_block));
+    return;
+  }
+  // The directions are independent: OpenSSL keeps its own sequence numbers
+  // for a direction which stays with it.
+  auto install = [&](int optname, const uint8_t* key, const uint8_t* salt) {
+#ifdef TLS_CIPHER_AES_GCM_256
+    if (cipher_type == TLS_CIPHER_AES_GCM_256) {
+      return InstallCryptoInfo<tls12_crypto_info_aes_gcm_256>(
+          GetFd(), optname, cipher_type, key, salt);
+    }
+#endif
+    return InstallCryptoInfo<tls12_crypto_info_aes_gcm_128>(
+        GetFd(), optname, cipher_type, key, salt);
+  };
+  s = install(TLS_TX, tx_key, tx_salt);
+  kernel_tls_tx_ = s.ok();
+  VLOG_IF(1, !s.ok()) << "not offloading TLS transmission to the kernel: " << s.ToString();
+  s = install(TLS_RX, rx_key, rx_salt);
+  kernel_tls_rx_ = s.ok();
+  VLOG_IF(1, !s.ok()) << "not offloading TLS reception to the kernel: " << s.ToString();
+  OPENSSL_cleanse(key_block, sizeof(key_block));
+#endif // KUDU_HAS_KERNEL_TLS
 }
 
 TlsSocket::~TlsSocket() {
@@ -43,6 +220,9 @@ TlsSocket::~TlsSocket() {
 }
 
 Status TlsSocket::Write(const uint8_t *buf, int32_t amt, int32_t *nwritten) {
+  if (kernel_tls_tx_) {
+    return Socket::Write(buf, amt, nwritten);
+  }
   CHECK(ssl_);
   SCOPED_OPENSSL_NO_PENDING_ERRORS;
 
@@ -75,6 +255,10 @@ Status TlsSocket::Write(const uint8_t *buf, int32_t amt, int32_t *nwritten) {
 }
 
 Status TlsSocket::Writev(const struct ::iovec *iov, int iov_len, int32_t *nwritten) {
+  if (kernel_tls_tx_) {
+    // The kernel frames the records itself.
+    return Socket::Writev(iov, iov_len, nwritten);
+  }
   SCOPED_OPENSSL_NO_PENDING_ERRORS;
   CHECK(ssl_);
   int32_t total_written = 0;
@@ -106,6 +290,15 @@ Status TlsSocket::Recv(uint8_t *buf, int32_t amt, int32_t *nread) {
   SCOPED_OPENSSL_NO_PENDING_ERRORS;
   const char* kErrString = "failed to read from TLS socket";
 
+  if (kernel_tls_rx_) {
+    Status s = Socket::Recv(buf, amt, nread);
+    if (s.posix_code() == EIO) {
+      // The kernel hands no records but application data to recv(): this is
+      // an alert, most likely the peer's close_notify.
+      return Status::NetworkError(kErrString, ErrnoToString(ESHUTDOWN), ESHUTDOWN);
+    }
+    return s;
+  }
   CHECK(ssl_);
   errno = 0;
   int32_t bytes_read = SSL_read(ssl_.get(), buf, amt);
@@ -157,8 +350,10 @@ Status TlsSocket::Close() {
   }
 
   // Start the TLS shutdown processes. We don't care about waiting for the
-  // response, since the underlying socket will not be reused.
-  int32_t ret = SSL_shutdown(ssl_.get());
+  // response, since the underlying socket will not be reused. OpenSSL can't
+  // write the close_notify alert once the kernel encrypts the records: the
+  // peer then sees the connection closing without one.
+  int32_t ret = kernel_tls_tx_ ? 0 : SSL_shutdown(ssl_.get());
   Status ssl_shutdown;
   if (ret >= 0) {
     ssl_shutdown = Status::OK();
@@ -46,14 +46,31 @@ class TlsSocket : public Socket {
 
   Status Close() override WARN_UNUSED_RESULT;
 
+  // Whether the kernel encrypts the records written to, or decrypts the
+  // records read from, the socket. See EnableKernelTls().
+  bool kernel_tls_tx() const { return kernel_tls_tx_; }
+  bool kernel_tls_rx() const { return kernel_tls_rx_; }
+
  private:
 
   friend class TlsHandshake;
 
   TlsSocket(int fd, c_unique_ptr<SSL> ssl);
 
+  // Hands the record layer of the just-established TLS session over to the
+  // kernel (Linux kTLS), so that reads and writes are plain socket calls and
+  // vectored writes reach the kernel as one call. Each direction is offloaded
+  // independently; a direction that can't be offloaded (the kernel lacks kTLS
+  // support, or the session uses a protocol or cipher the kernel doesn't
+  // implement) keeps going through OpenSSL. Must be called before any
+  // application data has been sent or received on the socket.
+  void EnableKernelTls();
+
   // Owned SSL handle.
   c_unique_ptr<SSL> ssl_;
+
+  bool kernel_tls_tx_;
+  bool kernel_tls_rx_;
 };
 
 } // namespace security
@@ -38,6 +38,7 @@
 #include "kudu/util/test_macros.h"
 #include "kudu/util/test_util.h"
 
+DECLARE_int32(authn_token_verification_cache_size);
 DECLARE_int32(tsk_num_rsa_bits);
 
 using std::string;
@@ -542,6 +543,42 @@ TEST_F(TokenTest, TestEndToEnd_Valid) {
   ASSERT_EQ(VerificationResult::VALID, verifier.VerifyTokenSignature(signed_token, &token));
 }
 
+// Test that the verified signatures cached by the TokenVerifier are only
+// accepted along with the very token data they were verified for.
+TEST_F(TokenTest, TestVerificationCache) {
+  TokenSigner signer(10, 10);
+  {
+    std::unique_ptr<TokenSigningPrivateKey> key;
+    ASSERT_OK(signer.CheckNeedKey(&key));
+    ASSERT_NE(nullptr, key.get());
+    ASSERT_OK(signer.AddKey(std::move(key)));
+  }
+  TokenVerifier verifier;
+  ASSERT_OK(verifier.ImportKeys(signer.verifier().ExportKeys()));
+
+  SignedTokenPB signed_token = MakeUnsignedToken(WallTime_Now() + 600);
+  ASSERT_OK(signer.SignToken(&signed_token));
+  TokenPB token;
+  for (int i = 0; i < 3; i++) {
+    ASSERT_EQ(VerificationResult::VALID, verifier.VerifyTokenSignature(signed_token, &token));
+  }
+
+  // Other token data with the cached signature.
+  SignedTokenPB other_token = MakeUnsignedToken(WallTime_Now() + 1200);
+  other_token.set_signature(signed_token.signature());
+  other_token.set_signing_key_seq_num(signed_token.signing_key_seq_num());
+  ASSERT_EQ(VerificationResult::INVALID_SIGNATURE,
+            verifier.VerifyTokenSignature(other_token, &token));
+
+  // Tokens evicted from a full cache are verified again.
+  FLAGS_authn_token_verification_cache_size = 1;
+  ASSERT_OK(signer.SignToken(&other_token));
+  for (int i = 0; i < 3; i++) {
+    ASSERT_EQ(VerificationResult::VALID, verifier.VerifyTokenSignature(signed_token, &token));
+    ASSERT_EQ(VerificationResult::VALID, verifier.VerifyTokenSignature(other_token, &token));
+  }
+}
+
 // Test all of the possible cases covered by token verification.
 // See VerificationResult.
 TEST_F(TokenTest, TestEndToEnd_InvalidCases) {
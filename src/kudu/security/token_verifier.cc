@@ -25,25 +25,50 @@
 #include <utility>
 #include <vector>
 
+#include <gflags/gflags.h>
 #include <glog/logging.h>
+#include <openssl/evp.h>
 
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/walltime.h"
 #include "kudu/security/token.pb.h"
 #include "kudu/security/token_signing_key.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/status.h"
 
 using std::lock_guard;
+using std::make_pair;
 using std::string;
 using std::transform;
 using std::unique_ptr;
 using std::vector;
 
+DEFINE_int32(authn_token_verification_cache_size, 10000,
+             "Maximum number of authentication tokens whose verified signature "
+             "is cached by servers, sparing the signature verification when "
+             "clients present the same tokens again. 0 disables the cache.");
+TAG_FLAG(authn_token_verification_cache_size, advanced);
+
 namespace kudu {
 namespace security {
 
+namespace {
+
+// Returns the SHA-256 digest of the serialized 'signed_token'. Unlike the
+// serialized token, the digest is of fixed size, and as collision-resistant
+// as the signature itself.
+string SignedTokenDigest(const SignedTokenPB& signed_token) {
+  const string data = signed_token.SerializeAsString();
+  unsigned char md[EVP_MAX_MD_SIZE];
+  unsigned int md_len = 0;
+  CHECK_EQ(1, EVP_Digest(data.data(), data.size(), md, &md_len, EVP_sha256(), nullptr));
+  return string(reinterpret_cast<const char*>(md), md_len);
+}
+
+} // anonymous namespace
+
 TokenVerifier::TokenVerifier() {
 }
 
@@ -87,6 +112,9 @@ Status TokenVerifier::ImportKeys(const vector<TokenSigningPublicKeyPB>& keys) {
   for (auto&& tsk_ptr : tsks) {
     keys_by_seq_.emplace(tsk_ptr->pb().key_seq_num(), std::move(tsk_ptr));
   }
+  lock_guard<simple_spinlock> cache_l(verified_signatures_lock_);
+  verified_signatures_.clear();
+  verified_signatures_lru_.clear();
   return Status::OK();
 }
 
@@ -138,14 +166,59 @@ VerificationResult TokenVerifier::VerifyTokenSignature(const SignedTokenPB& sign
     if (tsk->pb().expire_unix_epoch_seconds() < now) {
       return VerificationResult::EXPIRED_SIGNING_KEY;
     }
+    const bool use_cache = FLAGS_authn_token_verification_cache_size > 0;
+    string digest;
+    if (use_cache) {
+      // The digest covers the whole signed token: the same signature must
+      // not be accepted with other token data, or for another signing key.
+      digest = SignedTokenDigest(signed_token);
+      if (IsVerifiedSignatureCached(digest, now)) {
+        return VerificationResult::VALID;
+      }
+    }
     if (!tsk->VerifySignature(signed_token)) {
       return VerificationResult::INVALID_SIGNATURE;
     }
+    if (use_cache) {
+      CacheVerifiedSignature(std::move(digest), token->expire_unix_epoch_seconds());
+    }
   }
 
   return VerificationResult::VALID;
 }
 
+bool TokenVerifier::IsVerifiedSignatureCached(const string& digest, int64_t now) const {
+  lock_guard<simple_spinlock> l(verified_signatures_lock_);
+  auto it = verified_signatures_.find(digest);
+  if (it == verified_signatures_.end()) {
+    return false;
+  }
+  if (it->second->second < now) {
+    verified_signatures_lru_.erase(it->second);
+    verified_signatures_.erase(it);
+    return false;
+  }
+  verified_signatures_lru_.splice(verified_signatures_lru_.begin(),
+                                  verified_signatures_lru_, it->second);
+  return true;
+}
+
+void TokenVerifier::CacheVerifiedSignature(string digest,
+                                           int64_t expire_unix_epoch_seconds) const {
+  const size_t capacity = FLAGS_authn_token_verification_cache_size;
+  lock_guard<simple_spinlock> l(verified_signatures_lock_);
+  if (ContainsKey(verified_signatures_, digest)) {
+    // Verified concurrently by another thread.
+    return;
+  }
+  while (!verified_signatures_lru_.empty() && verified_signatures_lru_.size() >= capacity) {
+    verified_signatures_.erase(verified_signatures_lru_.back().first);
+    verified_signatures_lru_.pop_back();
+  }
+  verified_signatures_lru_.emplace_front(make_pair(digest, expire_unix_epoch_seconds));
+  verified_signatures_.emplace(std::move(digest), verified_signatures_lru_.begin());
+}
+
 const char* VerificationResultToString(VerificationResult r) {
   switch (r) {
     case security::VerificationResult::VALID:
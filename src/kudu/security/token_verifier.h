@@ -17,12 +17,17 @@
 #pragma once
 
 #include <cstdint>
+#include <list>
 #include <map>
 #include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/port.h"
+#include "kudu/util/locks.h"
 #include "kudu/util/rw_mutex.h"
 
 namespace kudu {
@@ -59,6 +64,11 @@ enum class VerificationResult;
 // slow leak is not worrisome. If this class is adopted for any use cases
 // with frequent rotation, GC of expired tokens will need to be added.
 //
+// The signatures verified successfully are cached in a bounded LRU cache, so
+// that clients presenting the same token again, e.g. when reconnecting, do not
+// cost another public key operation. Token and key expiration are still
+// checked every time.
+//
 // This class is thread-safe.
 class TokenVerifier {
  public:
@@ -95,6 +105,25 @@ class TokenVerifier {
   mutable RWMutex lock_;
   KeysMap keys_by_seq_;
 
+  // Returns whether the signature of the token whose digest is 'digest' was
+  // verified successfully already, and hasn't expired since, as of 'now'.
+  bool IsVerifiedSignatureCached(const std::string& digest, int64_t now) const;
+
+  // Caches the successful verification of the signature of the token whose
+  // digest is 'digest', and which expires at 'expire_unix_epoch_seconds'.
+  void CacheVerifiedSignature(std::string digest, int64_t expire_unix_epoch_seconds) const;
+
+  // Lock protecting the verified signatures cache below.
+  mutable simple_spinlock verified_signatures_lock_;
+
+  // The SHA-256 digests of the serialized signed tokens whose signature was
+  // verified successfully, along with the expiration time of the tokens, most
+  // recently used first. Cleared whenever keys are imported, as they may
+  // replace known keys.
+  typedef std::list<std::pair<std::string, int64_t>> VerifiedSignatureList;
+  mutable VerifiedSignatureList verified_signatures_lru_;
+  mutable std::unordered_map<std::string, VerifiedSignatureList::iterator> verified_signatures_;
+
   DISALLOW_COPY_AND_ASSIGN(TokenVerifier);
 };
 
@@ -49,6 +49,7 @@
 #include "kudu/util/faststring.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/flags.h"
+#include "kudu/util/hugepage_allocator.h"
 #include "kudu/util/jsonwriter.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/mem_tracker.h"
@@ -210,6 +211,40 @@ static void MemTrackersHandler(const Webserver::WebRequest& /*req*/,
                             peak_consumption_str);
   }
   *output << "</tbody></table>\n";
+
+  HugePageSlabAllocator::Stats slab_stats;
+  HugePageSlabAllocator::Get()->GetStats(&slab_stats);
+  if (slab_stats.capacity_bytes == 0) {
+    return;
+  }
+  *output << "<h1>Huge page slab allocator</h1>\n";
+  *output << "<table class='table table-striped'>\n";
+  *output << Substitute("  <tr><th>Capacity</th><td>$0</td></tr>\n",
+                        HumanReadableNumBytes::ToString(slab_stats.capacity_bytes));
+  *output << Substitute("  <tr><th>Committed</th><td>$0</td></tr>\n",
+                        HumanReadableNumBytes::ToString(slab_stats.committed_bytes));
+  *output << Substitute("  <tr><th>Allocated</th><td>$0</td></tr>\n",
+                        HumanReadableNumBytes::ToString(slab_stats.allocated_bytes));
+  if (slab_stats.committed_bytes > 0) {
+    double fragmentation = 100 * (1 - static_cast<double>(slab_stats.allocated_bytes) /
+                                  slab_stats.committed_bytes);
+    *output << Substitute("  <tr><th>Fragmentation</th><td>$0%</td></tr>\n",
+                          StringPrintf("%.2f", fragmentation));
+  }
+  *output << "</table>\n";
+  *output << "<table class='table table-striped'>\n";
+  *output << "  <thead><tr><th>Object size</th><th>Slabs</th><th>Allocated objects</th>"
+      "<th>Free objects</th></tr></thead>\n";
+  *output << "<tbody>\n";
+  for (const auto& size_class : slab_stats.size_classes) {
+    int64_t num_objects = size_class.num_slabs *
+        (HugePageSlabAllocator::kSlabSize / size_class.object_size);
+    (*output) << Substitute("  <tr><td>$0</td><td>$1</td><td>$2</td><td>$3</td></tr>\n",
+                            HumanReadableNumBytes::ToString(size_class.object_size),
+                            size_class.num_slabs, size_class.num_allocated,
+                            num_objects - size_class.num_allocated);
+  }
+  *output << "</tbody></table>\n";
 }
 
 static void ConfigurationHandler(const Webserver::WebRequest& /* req */,
@@ -265,13 +300,51 @@ void AddDefaultPathHandlers(Webserver* webserver) {
 }
 
 
+// Parses the arguments of a request for metrics into 'requested_metrics'
+// and 'opts':
+// - metrics: the comma-separated substrings of the names of the metrics or
+//   of the IDs of the entities to output. Defaults to all of them.
+// - types: the comma-separated types of the entities to output.
+// - modified_since_epoch: only output the metrics modified in or after this
+//   epoch, as returned in the X-Kudu-Metrics-Epoch header of a previous
+//   response.
+static void ParseMetricsRequest(const Webserver::WebRequest& req,
+                                vector<string>* requested_metrics,
+                                MetricJsonOptions* opts) {
+  const string* requested_metrics_param = FindOrNull(req.parsed_args, "metrics");
+  if (requested_metrics_param != nullptr) {
+    SplitStringUsing(*requested_metrics_param, ",", requested_metrics);
+  } else {
+    // Default to including all metrics.
+    requested_metrics->emplace_back("*");
+  }
+  const string* types_param = FindOrNull(req.parsed_args, "types");
+  if (types_param != nullptr) {
+    SplitStringUsing(*types_param, ",", &opts->entity_types);
+  }
+  const string* epoch_param = FindOrNull(req.parsed_args, "modified_since_epoch");
+  if (epoch_param != nullptr) {
+    int64_t epoch;
+    if (safe_strto64(*epoch_param, &epoch) && epoch > 0) {
+      opts->only_modified_in_or_after_epoch = epoch;
+    }
+  }
+}
+
+// Starts a new modification epoch for the metrics, and returns it in a header
+// of 'resp', for the client to pass it as 'modified_since_epoch' next time.
+// The metrics modified while the response is written are returned again next
+// time, so no modification is missed.
+static void StartMetricsEpoch(Webserver::StreamingWebResponse* resp) {
+  resp->response_headers["X-Kudu-Metrics-Epoch"] = std::to_string(Metric::IncrementEpoch());
+}
+
 static void WriteMetricsAsJson(const MetricRegistry* const metrics,
                                const Webserver::WebRequest& req,
-                               Webserver::PrerenderedWebResponse* resp) {
-  std::ostringstream* output = resp->output;
-  const string* requested_metrics_param = FindOrNull(req.parsed_args, "metrics");
+                               Webserver::StreamingWebResponse* resp) {
   vector<string> requested_metrics;
   MetricJsonOptions opts;
+  ParseMetricsRequest(req, &requested_metrics, &opts);
 
   {
     string arg = FindWithDefault(req.parsed_args, "include_raw_histograms", "false");
@@ -288,32 +361,36 @@ static void WriteMetricsAsJson(const MetricRegistry* const metrics,
       JsonWriter::COMPACT : JsonWriter::PRETTY;
   }
 
-  JsonWriter writer(output, json_mode);
-
-  if (requested_metrics_param != nullptr) {
-    SplitStringUsing(*requested_metrics_param, ",", &requested_metrics);
-  } else {
-    // Default to including all metrics.
-    requested_metrics.emplace_back("*");
-  }
-
+  StartMetricsEpoch(resp);
+  JsonWriter writer(resp->output, json_mode);
   WARN_NOT_OK(metrics->WriteAsJson(&writer, requested_metrics, opts),
               "Couldn't write JSON metrics over HTTP");
 }
 
+static void WriteMetricsAsPrometheus(const MetricRegistry* const metrics,
+                                     const Webserver::WebRequest& req,
+                                     Webserver::StreamingWebResponse* resp) {
+  vector<string> requested_metrics;
+  MetricJsonOptions opts;
+  ParseMetricsRequest(req, &requested_metrics, &opts);
+  StartMetricsEpoch(resp);
+  metrics->WriteAsPrometheus(resp->output, requested_metrics, opts);
+}
+
 void RegisterMetricsJsonHandler(Webserver* webserver, const MetricRegistry* const metrics) {
-  Webserver::PrerenderedPathHandlerCallback callback = boost::bind(WriteMetricsAsJson, metrics,
-                                                                   _1, _2);
-  bool not_styled = false;
+  Webserver::StreamingPathHandlerCallback callback = boost::bind(WriteMetricsAsJson, metrics,
+                                                                 _1, _2);
   bool not_on_nav_bar = false;
   bool is_on_nav_bar = true;
-  webserver->RegisterPrerenderedPathHandler("/metrics", "Metrics", callback,
-                                            not_styled, is_on_nav_bar);
+  webserver->RegisterStreamingPathHandler("/metrics", "Metrics", callback, is_on_nav_bar);
 
   // The old name -- this is preserved for compatibility with older releases of
   // monitoring software which expects the old name.
-  webserver->RegisterPrerenderedPathHandler("/jsonmetricz", "Metrics", callback,
-                                            not_styled, not_on_nav_bar);
+  webserver->RegisterStreamingPathHandler("/jsonmetricz", "Metrics", callback, not_on_nav_bar);
+
+  webserver->RegisterStreamingPathHandler(
+      "/metrics_prometheus", "Metrics (Prometheus)",
+      boost::bind(WriteMetricsAsPrometheus, metrics, _1, _2), not_on_nav_bar);
 }
 
 } // namespace kudu
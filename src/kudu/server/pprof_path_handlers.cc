@@ -22,6 +22,9 @@
 #include <cstdint>
 #include <cstdlib>
 #include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <utility>
@@ -45,7 +48,9 @@
 #include "kudu/util/faststring.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/spinlock_profiling.h"
+#include "kudu/util/stack_sampler.h"
 #include "kudu/util/status.h"
+#include "kudu/util/url-coding.h"
 #include "kudu/util/web_callback_registry.h"
 
 DECLARE_bool(enable_process_lifetime_heap_profiling);
@@ -54,8 +59,10 @@ DECLARE_string(heap_profile_path);
 
 using std::endl;
 using std::ifstream;
+using std::map;
 using std::ostringstream;
 using std::string;
+using std::unique_ptr;
 using std::vector;
 
 // GLog already implements symbolization. Just import their hidden symbol.
@@ -70,6 +77,7 @@ bool Symbolize(void *pc, char *out, int out_size);
 namespace kudu {
 
 const int kPprofDefaultSampleSecs = 30; // pprof default sample time in seconds.
+const int kStackSamplesDefaultMins = 5;
 
 // pprof asks for the url /pprof/cmdline to figure out what application it's profiling.
 // The server should respond by sending the executable path.
@@ -243,6 +251,101 @@ static void PprofSymbolHandler(const Webserver::WebRequest& req,
       pieces.size(), invalid_addrs, missing_symbols);
 }
 
+// Continuous stack samples, in the "folded stacks" format which can be fed to
+// flamegraph.pl or speedscope: one line per distinct stack, with the frames
+// separated by semicolons, followed by a space and the number of samples.
+static void StackSamplesHandler(const Webserver::WebRequest& req,
+                                Webserver::PrerenderedWebResponse* resp) {
+  string mins_str = FindWithDefault(req.parsed_args, "mins", "");
+  int32_t mins = ParseLeadingInt32Value(mins_str.c_str(), kStackSamplesDefaultMins);
+  map<string, int64_t> folded;
+  StackSampler::GetInstance()->GetFoldedStacks(MonoDelta::FromSeconds(mins * 60), &folded);
+  for (const auto& entry : folded) {
+    *resp->output << entry.first << " " << entry.second << endl;
+  }
+}
+
+namespace {
+
+// A frame in the flame graph, and the samples which passed through it.
+struct FlameNode {
+  int64_t samples = 0;
+  map<string, unique_ptr<FlameNode>> children;
+};
+
+// Frames narrower than this fraction of all samples are not rendered.
+const double kMinFlameNodeFraction = 0.001;
+
+void RenderFlameNode(const string& name, const FlameNode& node, int64_t parent_samples,
+                     int64_t total_samples, ostringstream* out) {
+  if (node.samples < total_samples * kMinFlameNodeFraction) {
+    return;
+  }
+  string escaped = EscapeForHtmlToString(name);
+  // Color frames by name so that the same function is recognizable across the graph.
+  int hue = std::hash<string>()(name) % 60;
+  *out << "<div class='flame-node' style='width:"
+       << 100.0 * node.samples / parent_samples << "%'>"
+       << "<div class='flame-frame' style='background-color:hsl(" << hue << ",80%,65%)'"
+       << " title='" << escaped << " (" << node.samples << " samples, "
+       << 100.0 * node.samples / total_samples << "%)'>" << escaped << "</div>"
+       << "<div class='flame-children'>";
+  for (const auto& child : node.children) {
+    RenderFlameNode(child.first, *child.second, node.samples, total_samples, out);
+  }
+  *out << "</div></div>";
+}
+
+} // anonymous namespace
+
+// The continuous stack samples rendered as an icicle-style flame graph, with
+// the thread names (and so thread pools) at the top.
+static void FlameGraphHandler(const Webserver::WebRequest& req,
+                              Webserver::PrerenderedWebResponse* resp) {
+  ostringstream* output = resp->output;
+  string mins_str = FindWithDefault(req.parsed_args, "mins", "");
+  int32_t mins = ParseLeadingInt32Value(mins_str.c_str(), kStackSamplesDefaultMins);
+  map<string, int64_t> folded;
+  StackSampler::GetInstance()->GetFoldedStacks(MonoDelta::FromSeconds(mins * 60), &folded);
+
+  FlameNode root;
+  for (const auto& entry : folded) {
+    FlameNode* node = &root;
+    node->samples += entry.second;
+    for (StringPiece frame : strings::Split(entry.first, ";")) {
+      unique_ptr<FlameNode>& child = node->children[frame.ToString()];
+      if (!child) {
+        child.reset(new FlameNode());
+      }
+      node = child.get();
+      node->samples += entry.second;
+    }
+  }
+
+  *output << "<h1>Stack Samples</h1>" << endl;
+  *output << "<p>" << root.samples << " samples of running threads over the last "
+          << mins << " minute(s). Show the last ";
+  for (int m : { 1, 5, 15, 60 }) {
+    *output << "<a href='/flamegraph?mins=" << m << "'>" << m << "</a> ";
+  }
+  *output << "minute(s), or the <a href='/pprof/stack-samples?mins=" << mins
+          << "'>folded stacks</a>.</p>" << endl;
+  if (root.samples == 0) {
+    return;
+  }
+  *output << "<style>"
+          << ".flame-node { float: left; overflow: hidden; }"
+          << ".flame-frame { font-size: 11px; white-space: nowrap; overflow: hidden;"
+          << " border: 1px solid white; padding: 1px; }"
+          << ".flame-children { display: flex; }"
+          << "</style>" << endl;
+  *output << "<div class='flame-children'>";
+  for (const auto& child : root.children) {
+    RenderFlameNode(child.first, *child.second, root.samples, root.samples, output);
+  }
+  *output << "</div>" << endl;
+}
+
 void AddPprofPathHandlers(Webserver* webserver) {
   // Path handlers for remote pprof profiling. For information see:
   // https://gperftools.googlecode.com/svn/trunk/doc/pprof_remote_servers.html
@@ -255,6 +358,10 @@ void AddPprofPathHandlers(Webserver* webserver) {
   webserver->RegisterPrerenderedPathHandler("/pprof/symbol", "", PprofSymbolHandler, false, false);
   webserver->RegisterPrerenderedPathHandler("/pprof/contention", "", PprofContentionHandler,
                                             false, false);
+  webserver->RegisterPrerenderedPathHandler("/pprof/stack-samples", "", StackSamplesHandler,
+                                            false, false);
+  webserver->RegisterPrerenderedPathHandler("/flamegraph", "Stack Samples", FlameGraphHandler,
+                                            true, false);
 }
 
 } // namespace kudu
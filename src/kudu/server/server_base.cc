@@ -74,6 +74,7 @@
 #include "kudu/util/rolling_log.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/spinlock_profiling.h"
+#include "kudu/util/stack_sampler.h"
 #include "kudu/util/thread.h"
 #include "kudu/util/user.h"
 #include "kudu/util/version_info.h"
@@ -172,6 +173,8 @@ ServerBase::ServerBase(string name, const ServerBaseOptions& options,
   }
 
   CHECK_OK(StartThreadInstrumentation(metric_entity_, web_server_.get()));
+  // Start the process-wide continuous stack sampling served at /flamegraph.
+  StackSampler::GetInstance();
   CHECK_OK(codegen::CompilationManager::GetSingleton()->StartInstrumentation(
                metric_entity_));
 }
@@ -33,6 +33,7 @@
 #include "kudu/util/jsonwriter.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/status.h"
+#include "kudu/util/trace_spans.h"
 #include "kudu/util/web_callback_registry.h"
 #include "kudu/util/zlib.h"
 
@@ -59,7 +60,8 @@ enum Handler {
   kGetBufferPercentFull,
   kEndRecording,
   kEndRecordingCompressed,
-  kSimpleDump
+  kSimpleDump,
+  kSpans
 };
 
 namespace {
@@ -236,6 +238,10 @@ Status DoHandleRequest(Handler handler,
     case kSimpleDump:
       HandleTraceJsonPage(req.parsed_args, output);
       break;
+    case kSpans:
+      // The spans of sampled distributed traces, in the Zipkin v2 format.
+      TraceSpanCollector::GetInstance()->WriteAsZipkinJson(output);
+      break;
   }
 
   return Status::OK();
@@ -270,7 +276,8 @@ void TracingPathHandlers::RegisterHandlers(Webserver* server) {
     { "/tracing/json/get_buffer_percent_full", kGetBufferPercentFull },
     { "/tracing/json/end_recording", kEndRecording },
     { "/tracing/json/end_recording_compressed", kEndRecordingCompressed },
-    { "/tracing/json/simple_dump", kSimpleDump } };
+    { "/tracing/json/simple_dump", kSimpleDump },
+    { "/tracing/json/spans", kSpans } };
 
   typedef pair<const string, Handler> HandlerPair;
   for (const HandlerPair& e : handlers) {
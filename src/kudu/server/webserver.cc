@@ -26,7 +26,9 @@
 #include <map>
 #include <memory>
 #include <mutex>
+#include <ostream>
 #include <sstream>
+#include <streambuf>
 #include <string>
 #include <unordered_set>
 #include <utility>
@@ -110,6 +112,112 @@ namespace {
 
 namespace kudu {
 
+namespace {
+
+// Returns the status line and the headers of a response to a request handled
+// by 'handler_alias', ending with the empty line which precedes the body.
+// 'length_header' is either the Content-Length or the Transfer-Encoding header.
+string BuildResponseHeaders(const string& handler_alias,
+                            HttpStatusCode status_code,
+                            const char* content_type,
+                            const string& length_header,
+                            const WebCallbackRegistry::HttpResponseHeaders& response_headers) {
+  ostringstream headers_stream;
+  headers_stream << Substitute("HTTP/1.1 $0\r\n", HttpStatusCodeToString(status_code));
+  headers_stream << Substitute("Content-Type: $0\r\n", content_type);
+  headers_stream << length_header << "\r\n";
+  headers_stream << Substitute("X-Frame-Options: $0\r\n", FLAGS_webserver_x_frame_options);
+  std::unordered_set<string> invalid_headers{"Content-Type", "Content-Length",
+                                             "Transfer-Encoding", "X-Frame-Options"};
+  for (const auto& entry : response_headers) {
+    // It's forbidden to override the above headers.
+    if (ContainsKey(invalid_headers, entry.first)) {
+      LOG(FATAL) << "Reserved header " << entry.first << " was overridden "
+          "by handler for " << handler_alias;
+    }
+    headers_stream << Substitute("$0: $1\r\n", entry.first, entry.second);
+  }
+  headers_stream << "\r\n";
+  return headers_stream.str();
+}
+
+// A stream buffer which sends what's written to it to a connection as the
+// chunks of a response with chunked transfer encoding. The status line and
+// the headers of the response are sent along with the first chunk.
+class ChunkedResponseBuffer : public std::streambuf {
+ public:
+  ChunkedResponseBuffer(struct sq_connection* connection,
+                        string handler_alias,
+                        const WebCallbackRegistry::StreamingWebResponse* resp)
+      : connection_(connection),
+        handler_alias_(std::move(handler_alias)),
+        resp_(resp),
+        headers_sent_(false),
+        failed_(false),
+        buf_(kChunkSize) {
+    setp(buf_.data(), buf_.data() + buf_.size());
+  }
+
+  // Sends the rest of the body, and the last chunk.
+  void Finish() {
+    SendChunk();
+    Write("0\r\n\r\n", 5);
+  }
+
+ protected:
+  int overflow(int c) override {
+    SendChunk();
+    if (c != traits_type::eof()) {
+      *pptr() = traits_type::to_char_type(c);
+      pbump(1);
+    }
+    return traits_type::not_eof(c);
+  }
+
+  int sync() override {
+    SendChunk();
+    return failed_ ? -1 : 0;
+  }
+
+ private:
+  static const size_t kChunkSize = 64 * 1024;
+
+  void SendChunk() {
+    if (!headers_sent_) {
+      string headers = BuildResponseHeaders(handler_alias_, resp_->status_code, "text/plain",
+                                            "Transfer-Encoding: chunked",
+                                            resp_->response_headers);
+      Write(headers.data(), headers.size());
+      headers_sent_ = true;
+    }
+    const size_t len = pptr() - pbase();
+    if (len > 0) {
+      string size_line = Substitute("$0\r\n", FastHex64ToBuffer(len, hex_buf_));
+      Write(size_line.data(), size_line.size());
+      Write(pbase(), len);
+      Write("\r\n", 2);
+    }
+    setp(buf_.data(), buf_.data() + buf_.size());
+  }
+
+  // Once the client is gone, the rest of the response is dropped.
+  void Write(const char* data, size_t len) {
+    if (!failed_ && sq_write(connection_, data, len) <= 0) {
+      failed_ = true;
+    }
+  }
+
+  struct sq_connection* const connection_;
+  const string handler_alias_;
+  const WebCallbackRegistry::StreamingWebResponse* const resp_;
+  bool headers_sent_;
+  bool failed_;
+  vector<char> buf_;
+  char hex_buf_[kFastToBufferSize];
+};
+
+} // anonymous namespace
+
 Webserver::Webserver(const WebserverOptions& opts)
   : opts_(opts),
     context_(nullptr) {
@@ -453,6 +561,22 @@ int Webserver::RunPathHandler(const PathHandler& handler,
     }
   }
 
+  if (handler.is_streaming()) {
+    StreamingWebResponse resp { HttpStatusCode::Ok, HttpResponseHeaders{}, nullptr };
+    ChunkedResponseBuffer buf(connection, handler.alias(), &resp);
+    std::ostream output(&buf);
+    resp.output = &output;
+    if (kudu::g_should_redact == kudu::RedactContext::ALL) {
+      handler.streaming_callback()(req, &resp);
+    } else {
+      ScopedDisableRedaction s;
+      handler.streaming_callback()(req, &resp);
+    }
+    output.flush();
+    buf.Finish();
+    return 1;
+  }
+
   if (!handler.is_styled() || ContainsKey(req.parsed_args, "raw")) {
     use_style = false;
   }
@@ -477,22 +601,9 @@ int Webserver::RunPathHandler(const PathHandler& handler,
     full_content = content.str();
   }
 
-  ostringstream headers_stream;
-  headers_stream << Substitute("HTTP/1.1 $0\r\n", HttpStatusCodeToString(resp.status_code));
-  headers_stream << Substitute("Content-Type: $0\r\n", use_style ? "text/html" : "text/plain");
-  headers_stream << Substitute("Content-Length: $0\r\n", full_content.length());
-  headers_stream << Substitute("X-Frame-Options: $0\r\n", FLAGS_webserver_x_frame_options);
-  std::unordered_set<string> invalid_headers{"Content-Type", "Content-Length", "X-Frame-Options"};
-  for (const auto& entry : resp.response_headers) {
-    // It's forbidden to override the above headers.
-    if (ContainsKey(invalid_headers, entry.first)) {
-      LOG(FATAL) << "Reserved header " << entry.first << " was overridden "
-          "by handler for " << handler.alias();
-    }
-    headers_stream << Substitute("$0: $1\r\n", entry.first, entry.second);
-  }
-  headers_stream << "\r\n";
-  string headers = headers_stream.str();
+  string headers = BuildResponseHeaders(
+      handler.alias(), resp.status_code, use_style ? "text/html" : "text/plain",
+      Substitute("Content-Length: $0", full_content.length()), resp.response_headers);
 
   // Make sure to use sq_write for printing the body; sq_printf truncates at 8KB.
   sq_write(connection, headers.c_str(), headers.length());
@@ -522,6 +633,12 @@ void Webserver::RegisterPrerenderedPathHandler(const string& path, const string&
   InsertOrDie(&path_handlers_, path, new PathHandler(is_styled, is_on_nav_bar, alias, callback));
 }
 
+void Webserver::RegisterStreamingPathHandler(const string& path, const string& alias,
+    const StreamingPathHandlerCallback& callback, bool is_on_nav_bar) {
+  std::lock_guard<RWMutex> l(lock_);
+  InsertOrDie(&path_handlers_, path, new PathHandler(is_on_nav_bar, alias, callback));
+}
+
 string Webserver::MustachePartialTag(const string& path) const {
   return Substitute("{{> $0.mustache}}", path);
 }
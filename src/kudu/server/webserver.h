@@ -78,6 +78,12 @@ class Webserver : public WebCallbackRegistry {
                                       bool is_styled,
                                       bool is_on_nav_bar) override;
 
+  // Register a route 'path' whose response is streamed out with chunked
+  // transfer encoding.
+  void RegisterStreamingPathHandler(const std::string& path, const std::string& alias,
+                                    const StreamingPathHandlerCallback& callback,
+                                    bool is_on_nav_bar) override;
+
   // Change the footer HTML to be displayed at the bottom of all styled web pages.
   void set_footer_html(const std::string& html);
 
@@ -95,10 +101,22 @@ class Webserver : public WebCallbackRegistry {
           alias_(std::move(alias)),
           callback_(std::move(callback)) {}
 
+    // Streaming pages are never styled.
+    PathHandler(bool is_on_nav_bar, std::string alias,
+                StreamingPathHandlerCallback callback)
+        : is_styled_(false),
+          is_on_nav_bar_(is_on_nav_bar),
+          alias_(std::move(alias)),
+          streaming_callback_(std::move(callback)) {}
+
     bool is_styled() const { return is_styled_; }
     bool is_on_nav_bar() const { return is_on_nav_bar_; }
+    bool is_streaming() const { return !streaming_callback_.empty(); }
     const std::string& alias() const { return alias_; }
     const PrerenderedPathHandlerCallback& callback() const { return callback_; }
+    const StreamingPathHandlerCallback& streaming_callback() const {
+      return streaming_callback_;
+    }
 
    private:
     // If true, the page appears is rendered styled.
@@ -112,6 +130,9 @@ class Webserver : public WebCallbackRegistry {
 
     // Callback to render output for this page.
     PrerenderedPathHandlerCallback callback_;
+
+    // Callback to stream out the output of this page, if it's streamed.
+    StreamingPathHandlerCallback streaming_callback_;
   };
 
   bool static_pages_available() const;
@@ -18,6 +18,7 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <memory>
 #include <string>
 #include <thread>
 #include <unordered_set>
@@ -33,12 +34,16 @@
 #include "kudu/util/debug/sanitizer_scopes.h"
 #include "kudu/util/faststring.h"
 #include "kudu/util/hexdump.h"
+#include "kudu/util/mem_tracker.h"
 #include "kudu/util/memory/arena.h"
+#include "kudu/util/memory/memory.h"
 #include "kudu/util/memory/overwrite.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/stopwatch.h"
+#include "kudu/util/test_macros.h"
 #include "kudu/util/test_util.h"
 
+using std::shared_ptr;
 using std::string;
 using std::thread;
 using std::unordered_set;
@@ -786,6 +791,104 @@ TEST_F(TestCBTree, TestScanPerformance) {
   }
 }
 
+// Insert keys in strictly ascending order, which exercises the append
+// fast path of the leaf and internal node key search.
+TEST_F(TestCBTree, TestInsertAscending) {
+  CBTree<SmallFanoutTraits> t;
+  char kbuf[64];
+  char vbuf[64];
+  const int n_keys = 10000;
+
+  for (int i = 0; i < n_keys; i++) {
+    snprintf(kbuf, sizeof(kbuf), "key_%08d", i);
+    snprintf(vbuf, sizeof(vbuf), "val_%d", i);
+    ASSERT_TRUE(t.Insert(Slice(kbuf), Slice(vbuf))) << "Failed insert at iteration " << i;
+    // The key just inserted is the largest one, so re-inserting it must
+    // be detected as a duplicate.
+    ASSERT_FALSE(t.Insert(Slice(kbuf), Slice(vbuf))) << "Allowed duplicate at iteration " << i;
+  }
+  ASSERT_EQ(n_keys, static_cast<int>(t.count()));
+
+  for (int i = 0; i < n_keys; i++) {
+    snprintf(kbuf, sizeof(kbuf), "key_%08d", i);
+    snprintf(vbuf, sizeof(vbuf), "val_%d", i);
+    NO_FATALS(VerifyGet(t, Slice(kbuf), Slice(vbuf)));
+  }
+}
+
+struct PerCpuArenaTraits : public BTreeTraits {
+  typedef PerCpuMemoryTrackingArena ArenaType;
+};
+
+// Inserts 'keys_per_thread' keys from each of 'num_threads' threads into
+// 'tree', returning the wall time taken in seconds.
+template<class Traits>
+static double TimeConcurrentInserts(CBTree<Traits>* tree,
+                                    int num_threads,
+                                    int keys_per_thread) {
+  Barrier go_barrier(num_threads + 1);
+  vector<thread> threads;
+  for (int t = 0; t < num_threads; t++) {
+    threads.emplace_back([&, t]() {
+      char kbuf[64];
+      char vbuf[64];
+      go_barrier.Wait();
+      for (int i = 0; i < keys_per_thread; i++) {
+        // Interleave the threads' keys so that they contend on the same
+        // region of the key space.
+        int key = i * num_threads + t;
+        MakeKey(kbuf, sizeof(kbuf), key);
+        snprintf(vbuf, sizeof(vbuf), "val_%d", key);
+        CHECK(tree->Insert(Slice(kbuf), Slice(vbuf)));
+      }
+    });
+  }
+  Stopwatch sw;
+  sw.start();
+  go_barrier.Wait();
+  for (thread& thr : threads) {
+    thr.join();
+  }
+  sw.stop();
+  return sw.elapsed().wall_seconds();
+}
+
+// Measure how insert throughput scales with the number of concurrent
+// writers, comparing a single shared arena against a per-CPU striped one
+// like the MemRowSet uses.
+TEST_F(TestCBTree, TestConcurrentInsertScaling) {
+#ifdef NDEBUG
+  int total_keys = 2000000;
+#else
+  int total_keys = 64000;
+#endif
+  if (AllowSlowTests()) {
+    total_keys *= 4;
+  }
+  shared_ptr<MemTracker> tracker = MemTracker::CreateTracker(-1, "cbtree-test");
+  shared_ptr<MemoryTrackingBufferAllocator> allocator(
+      new MemoryTrackingBufferAllocator(HeapBufferAllocator::Get(), tracker));
+
+  for (int num_threads = 1; num_threads <= 64; num_threads *= 2) {
+    int keys_per_thread = total_keys / num_threads;
+    int n_keys = keys_per_thread * num_threads;
+
+    CBTree<BTreeTraits> shared_tree;
+    double shared_secs = TimeConcurrentInserts(&shared_tree, num_threads, keys_per_thread);
+    ASSERT_EQ(n_keys, static_cast<int>(shared_tree.count()));
+
+    CBTree<PerCpuArenaTraits> percpu_tree(
+        std::make_shared<PerCpuMemoryTrackingArena>(4 * 1024, allocator));
+    double percpu_secs = TimeConcurrentInserts(&percpu_tree, num_threads, keys_per_thread);
+    ASSERT_EQ(n_keys, static_cast<int>(percpu_tree.count()));
+
+    LOG(INFO) << StringPrintf("%2d threads: %d keys, shared arena %.0f inserts/sec, "
+                              "per-CPU arena %.0f inserts/sec",
+                              num_threads, n_keys,
+                              n_keys / shared_secs, n_keys / percpu_secs);
+  }
+}
+
 } // namespace btree
 } // namespace tablet
 } // namespace kudu
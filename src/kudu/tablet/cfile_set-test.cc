@@ -15,6 +15,7 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <memory>
@@ -31,6 +32,7 @@
 #include "kudu/common/column_predicate.h"
 #include "kudu/common/columnblock.h"
 #include "kudu/common/common.pb.h"
+#include "kudu/common/encoded_key.h"
 #include "kudu/common/generic_iterators.h"
 #include "kudu/common/iterator.h"
 #include "kudu/common/iterator_stats.h"
@@ -39,21 +41,29 @@
 #include "kudu/common/rowid.h"
 #include "kudu/common/scan_spec.h"
 #include "kudu/common/schema.h"
+#include "kudu/fs/block_id.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/integral_types.h"
+#include "kudu/gutil/map-util.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/stringprintf.h"
 #include "kudu/gutil/strings/stringpiece.h"
 #include "kudu/tablet/cfile_set.h"
 #include "kudu/tablet/diskrowset.h"
+#include "kudu/tablet/metadata.pb.h"
+#include "kudu/tablet/rowset_metadata.h"
 #include "kudu/tablet/tablet-test-util.h"
 #include "kudu/util/auto_release_pool.h"
 #include "kudu/util/bloom_filter.h"
 #include "kudu/util/mem_tracker.h"
 #include "kudu/util/memory/arena.h"
+#include "kudu/util/slice.h"
 #include "kudu/util/status.h"
 #include "kudu/util/test_macros.h"
 
+DECLARE_bool(consult_column_bloom_filters);
+DECLARE_bool(enable_secondary_index_scan);
+DECLARE_bool(enable_skip_scan);
 DECLARE_int32(cfile_default_block_size);
 
 using std::shared_ptr;
@@ -348,6 +358,485 @@ TEST_F(TestCFileSet, TestRangePredicates2) {
   DoTestRangeScan(fileset, kNumRows * 10, kNoBound);
 }
 
+class TestCFileSetSkipScan : public KuduRowSetTest {
+ public:
+  TestCFileSetSkipScan()
+      : KuduRowSetTest(Schema({ ColumnSchema("host", STRING),
+                                ColumnSchema("ts", INT64),
+                                ColumnSchema("val", INT32) }, 2)) {
+  }
+
+  void SetUp() override {
+    KuduRowSetTest::SetUp();
+    FLAGS_cfile_default_block_size = 512;
+  }
+
+  // Writes a rowset with a row for each of 'num_ts' timestamps of each of
+  // 'num_hosts' hosts, and opens it.
+  void WriteTestRowSet(int num_hosts, int num_ts) {
+    DiskRowSetWriter rsw(rowset_meta_.get(), &schema_,
+                         BloomFilterSizing::BySizeAndFPRate(32*1024, 0.01f));
+    ASSERT_OK(rsw.Open());
+    RowBuilder rb(schema_);
+    for (int h = 0; h < num_hosts; h++) {
+      const string host = StringPrintf("h%04d", h);
+      for (int64_t ts = 0; ts < num_ts; ts++) {
+        rb.Reset();
+        rb.AddString(host);
+        rb.AddInt64(ts);
+        rb.AddInt32(h);
+        ASSERT_OK_FAST(WriteRow(rb.data(), &rsw));
+      }
+    }
+    ASSERT_OK(rsw.Finish());
+    ASSERT_OK(CFileSet::Open(rowset_meta_, MemTracker::GetRootTracker(), &fileset_));
+  }
+
+  // Scans the rowset with 'spec', returning the number of rows which matched
+  // in 'num_matched', and the number of rows read, matching or not, in
+  // 'num_read'.
+  void Scan(ScanSpec* spec, int* num_matched, int* num_read) {
+    Arena arena(1024);
+    AutoReleasePool pool;
+    spec->OptimizeScan(schema_, &arena, &pool, true);
+    shared_ptr<CFileSet::Iterator> cfile_iter(fileset_->NewIterator(&schema_));
+    gscoped_ptr<RowwiseIterator> iter(new MaterializingIterator(cfile_iter));
+    ASSERT_OK(iter->Init(spec));
+    RowBlock block(schema_, 100, &arena);
+    *num_matched = 0;
+    *num_read = 0;
+    while (iter->HasNext()) {
+      ASSERT_OK_FAST(iter->NextBlock(&block));
+      *num_read += block.nrows();
+      *num_matched += block.selection_vector()->CountSelected();
+    }
+  }
+
+ protected:
+  shared_ptr<CFileSet> fileset_;
+};
+
+TEST_F(TestCFileSetSkipScan, TestSkipScan) {
+  NO_FATALS(WriteTestRowSet(10, 1000));
+  int num_matched;
+  int num_read;
+
+  // Only the matching rows of each host are read.
+  {
+    ScanSpec spec;
+    int64_t lower = 100;
+    int64_t upper = 110;
+    spec.AddPredicate(ColumnPredicate::Range(schema_.column(1), &lower, &upper));
+    NO_FATALS(Scan(&spec, &num_matched, &num_read));
+    ASSERT_EQ(100, num_matched);
+    ASSERT_EQ(100, num_read);
+  }
+  {
+    ScanSpec spec;
+    int64_t ts = 500;
+    spec.AddPredicate(ColumnPredicate::Equality(schema_.column(1), &ts));
+    NO_FATALS(Scan(&spec, &num_matched, &num_read));
+    ASSERT_EQ(10, num_matched);
+    ASSERT_EQ(10, num_read);
+  }
+  {
+    ScanSpec spec;
+    int64_t lower = 995;
+    spec.AddPredicate(ColumnPredicate::Range(schema_.column(1), &lower, nullptr));
+    NO_FATALS(Scan(&spec, &num_matched, &num_read));
+    ASSERT_EQ(50, num_matched);
+    ASSERT_EQ(50, num_read);
+  }
+  {
+    ScanSpec spec;
+    int64_t upper = 1;
+    spec.AddPredicate(ColumnPredicate::Range(schema_.column(1), nullptr, &upper));
+    NO_FATALS(Scan(&spec, &num_matched, &num_read));
+    ASSERT_EQ(10, num_matched);
+    ASSERT_EQ(10, num_read);
+  }
+
+  // The skip scan is combined with the bounds of the scan on the key.
+  {
+    ScanSpec spec;
+    Slice first_host("h0005");
+    int64_t lower = 100;
+    int64_t upper = 110;
+    spec.AddPredicate(ColumnPredicate::Range(schema_.column(0), &first_host, nullptr));
+    spec.AddPredicate(ColumnPredicate::Range(schema_.column(1), &lower, &upper));
+    NO_FATALS(Scan(&spec, &num_matched, &num_read));
+    ASSERT_EQ(50, num_matched);
+    ASSERT_EQ(50, num_read);
+  }
+
+  // Without the skip scan, all the rows are read.
+  FLAGS_enable_skip_scan = false;
+  {
+    ScanSpec spec;
+    int64_t lower = 100;
+    int64_t upper = 110;
+    spec.AddPredicate(ColumnPredicate::Range(schema_.column(1), &lower, &upper));
+    NO_FATALS(Scan(&spec, &num_matched, &num_read));
+    ASSERT_EQ(100, num_matched);
+    ASSERT_EQ(10000, num_read);
+  }
+}
+
+// Test that the keys of a rowset with a compound key can be sampled.
+TEST_F(TestCFileSetSkipScan, TestSampleKeys) {
+  NO_FATALS(WriteTestRowSet(10, 100));
+  vector<string> keys;
+  ASSERT_OK(fileset_->SampleKeys(4, &keys));
+  ASSERT_EQ(4, keys.size());
+  string min_key;
+  string max_key;
+  ASSERT_OK(fileset_->GetBounds(&min_key, &max_key));
+  ASSERT_EQ(min_key, keys[0]);
+  ASSERT_TRUE(std::is_sorted(keys.begin(), keys.end()));
+
+  // The third sample is the first row of the sixth host.
+  RowBuilder rb(schema_.CreateKeyProjection());
+  rb.AddString(Slice("h0005"));
+  rb.AddInt64(0);
+  ASSERT_EQ(EncodedKey::FromContiguousRow(rb.row())->encoded_key().ToString(), keys[2]);
+}
+
+// Test that the skip scan gives up when the first key column has too many
+// distinct values for seeking through them to pay off.
+TEST_F(TestCFileSetSkipScan, TestSkipScanManyDistinctValues) {
+  NO_FATALS(WriteTestRowSet(1000, 10));
+  ScanSpec spec;
+  int64_t ts = 5;
+  spec.AddPredicate(ColumnPredicate::Equality(schema_.column(1), &ts));
+  int num_matched;
+  int num_read;
+  NO_FATALS(Scan(&spec, &num_matched, &num_read));
+  ASSERT_EQ(1000, num_matched);
+  // The first hosts are skip scanned, the rest of the rows are all read.
+  ASSERT_GT(num_read, 1000);
+  ASSERT_LT(num_read, 10000);
+}
+
+class TestCFileSetSecondaryIndex : public KuduRowSetTest {
+ public:
+  TestCFileSetSecondaryIndex()
+      : KuduRowSetTest(Schema({ ColumnSchema("key", INT32),
+                                ColumnSchema("user", STRING, true, nullptr, nullptr,
+                                             GetIndexedStorage()),
+                                ColumnSchema("val", INT32, false, nullptr, nullptr,
+                                             GetIndexedStorage()) }, 1)) {
+  }
+
+  void SetUp() override {
+    KuduRowSetTest::SetUp();
+    FLAGS_cfile_default_block_size = 512;
+  }
+
+  // Writes a rowset of 'num_rows' rows, and opens it. The user of row 'i'
+  // is 'i' modulo 1000, or NULL if that's 999, and its value is a
+  // permutation of the rows' keys.
+  void WriteTestRowSet(int num_rows) {
+    DiskRowSetWriter rsw(rowset_meta_.get(), &schema_,
+                         BloomFilterSizing::BySizeAndFPRate(32*1024, 0.01f));
+    ASSERT_OK(rsw.Open());
+    RowBuilder rb(schema_);
+    for (int i = 0; i < num_rows; i++) {
+      rb.Reset();
+      rb.AddInt32(i);
+      if (i % 1000 == 999) {
+        rb.AddNull();
+      } else {
+        rb.AddString(StringPrintf("u%03d", i % 1000));
+      }
+      rb.AddInt32(static_cast<int32_t>((static_cast<int64_t>(i) * 7919) % num_rows));
+      ASSERT_OK_FAST(WriteRow(rb.data(), &rsw));
+    }
+    ASSERT_OK(rsw.Finish());
+    ASSERT_OK(CFileSet::Open(rowset_meta_, MemTracker::GetRootTracker(), &fileset_));
+  }
+
+  // Scans the rowset with 'spec', using the secondary indexes if
+  // 'use_indexes' is true, returning the number of rows which matched in
+  // 'num_matched', and the number of rows read in 'num_read'.
+  void Scan(ScanSpec* spec, bool use_indexes, int* num_matched, int* num_read) {
+    Arena arena(1024);
+    AutoReleasePool pool;
+    spec->OptimizeScan(schema_, &arena, &pool, true);
+    shared_ptr<CFileSet::Iterator> cfile_iter(fileset_->NewIterator(&schema_));
+    if (use_indexes) {
+      cfile_iter->set_secondary_index_col_ids(fileset_->secondary_index_col_ids());
+    }
+    gscoped_ptr<RowwiseIterator> iter(new MaterializingIterator(cfile_iter));
+    ASSERT_OK(iter->Init(spec));
+    RowBlock block(schema_, 100, &arena);
+    *num_matched = 0;
+    *num_read = 0;
+    while (iter->HasNext()) {
+      ASSERT_OK_FAST(iter->NextBlock(&block));
+      *num_read += block.nrows();
+      *num_matched += block.selection_vector()->CountSelected();
+    }
+  }
+
+ private:
+  static ColumnStorageAttributes GetIndexedStorage() {
+    ColumnStorageAttributes attr;
+    attr.secondary_index = true;
+    return attr;
+  }
+
+ protected:
+  shared_ptr<CFileSet> fileset_;
+};
+
+TEST_F(TestCFileSetSecondaryIndex, TestScan) {
+  const int kNumRows = 10000;
+  NO_FATALS(WriteTestRowSet(kNumRows));
+  ASSERT_EQ(2, fileset_->secondary_index_col_ids().size());
+  int num_matched;
+  int num_read;
+
+  // Only the matching rows are read.
+  {
+    ScanSpec spec;
+    Slice user("u042");
+    spec.AddPredicate(ColumnPredicate::Equality(schema_.column(1), &user));
+    NO_FATALS(Scan(&spec, true, &num_matched, &num_read));
+    ASSERT_EQ(10, num_matched);
+    ASSERT_EQ(10, num_read);
+  }
+  {
+    ScanSpec spec;
+    Slice users[] = { Slice("u001"), Slice("u500"), Slice("u998"), Slice("zzz") };
+    vector<const void*> values = { &users[0], &users[1], &users[2], &users[3] };
+    spec.AddPredicate(ColumnPredicate::InList(schema_.column(1), &values));
+    NO_FATALS(Scan(&spec, true, &num_matched, &num_read));
+    ASSERT_EQ(30, num_matched);
+    ASSERT_EQ(30, num_read);
+  }
+  {
+    ScanSpec spec;
+    int32_t lower = 100;
+    int32_t upper = 120;
+    spec.AddPredicate(ColumnPredicate::Range(schema_.column(2), &lower, &upper));
+    NO_FATALS(Scan(&spec, true, &num_matched, &num_read));
+    ASSERT_EQ(20, num_matched);
+    // Rows close to each other are read as a single range.
+    ASSERT_GE(num_read, 20);
+    ASSERT_LT(num_read, 20 * 65);
+  }
+
+  // If no row matches, none are read.
+  {
+    ScanSpec spec;
+    Slice user("u999");
+    spec.AddPredicate(ColumnPredicate::Equality(schema_.column(1), &user));
+    NO_FATALS(Scan(&spec, true, &num_matched, &num_read));
+    ASSERT_EQ(0, num_matched);
+    ASSERT_EQ(0, num_read);
+  }
+
+  // The index is combined with the bounds of the scan on the key.
+  {
+    ScanSpec spec;
+    int32_t lower_key = 5000;
+    Slice user("u042");
+    spec.AddPredicate(ColumnPredicate::Range(schema_.column(0), &lower_key, nullptr));
+    spec.AddPredicate(ColumnPredicate::Equality(schema_.column(1), &user));
+    NO_FATALS(Scan(&spec, true, &num_matched, &num_read));
+    ASSERT_EQ(5, num_matched);
+    ASSERT_EQ(5, num_read);
+  }
+
+  // If too many rows may match, they're all read.
+  {
+    ScanSpec spec;
+    int32_t upper = kNumRows / 2;
+    spec.AddPredicate(ColumnPredicate::Range(schema_.column(2), nullptr, &upper));
+    NO_FATALS(Scan(&spec, true, &num_matched, &num_read));
+    ASSERT_EQ(kNumRows / 2, num_matched);
+    ASSERT_EQ(kNumRows, num_read);
+  }
+
+  // The indexes aren't used unless the caller allows it, or if disabled.
+  for (bool use_indexes : { false, true }) {
+    FLAGS_enable_secondary_index_scan = use_indexes;
+    ScanSpec spec;
+    Slice user("u042");
+    spec.AddPredicate(ColumnPredicate::Equality(schema_.column(1), &user));
+    NO_FATALS(Scan(&spec, !use_indexes, &num_matched, &num_read));
+    ASSERT_EQ(10, num_matched);
+    ASSERT_EQ(kNumRows, num_read);
+  }
+}
+
+// Test that the secondary indexes are persisted in the rowset metadata, and
+// are dropped along with the data of their column.
+TEST_F(TestCFileSetSecondaryIndex, TestMetadata) {
+  NO_FATALS(WriteTestRowSet(1000));
+  const auto index_blocks = rowset_meta_->GetSecondaryIndexBlocksById();
+  ASSERT_EQ(2, index_blocks.size());
+
+  RowSetDataPB pb;
+  rowset_meta_->ToProtobuf(&pb);
+  ASSERT_EQ(2, pb.secondary_indexes_size());
+  rowset_meta_->LoadFromPB(pb);
+  ASSERT_TRUE(index_blocks == rowset_meta_->GetSecondaryIndexBlocksById());
+
+  // Replacing the data of a column drops its index.
+  const ColumnId user_col_id = schema_.column_id(1);
+  const BlockId user_index_block = FindOrDie(index_blocks, user_col_id);
+  RowSetMetadataUpdate update;
+  update.ReplaceColumnId(user_col_id, rowset_meta_->column_data_block_for_col_id(user_col_id));
+  vector<BlockId> removed;
+  rowset_meta_->CommitUpdate(update, &removed);
+  ASSERT_EQ(1, rowset_meta_->GetSecondaryIndexBlocksById().size());
+  ASSERT_NE(removed.end(), std::find(removed.begin(), removed.end(), user_index_block));
+}
+
+class TestCFileSetBloomFilter : public KuduRowSetTest {
+ public:
+  TestCFileSetBloomFilter()
+      : KuduRowSetTest(Schema({ ColumnSchema("key", INT32),
+                                ColumnSchema("trace", STRING, true, nullptr, nullptr,
+                                             GetBloomFilterStorage()) }, 1)) {
+  }
+
+  // Writes a rowset of 'num_rows' rows, and opens it. The trace of row 'i' is
+  // 't<i / 10>', or NULL for every tenth row.
+  void WriteTestRowSet(int num_rows) {
+    DiskRowSetWriter rsw(rowset_meta_.get(), &schema_,
+                         BloomFilterSizing::BySizeAndFPRate(32*1024, 0.01f));
+    ASSERT_OK(rsw.Open());
+    RowBuilder rb(schema_);
+    for (int i = 0; i < num_rows; i++) {
+      rb.Reset();
+      rb.AddInt32(i);
+      if (i % 10 == 9) {
+        rb.AddNull();
+      } else {
+        rb.AddString(StringPrintf("t%d", i / 10));
+      }
+      ASSERT_OK_FAST(WriteRow(rb.data(), &rsw));
+    }
+    ASSERT_OK(rsw.Finish());
+    ASSERT_OK(CFileSet::Open(rowset_meta_, MemTracker::GetRootTracker(), &fileset_));
+  }
+
+  // Scans the rowset with 'spec', consulting the bloom filters if
+  // 'use_blooms' is true, returning the number of rows which matched in
+  // 'num_matched', and the number of rows read in 'num_read'.
+  void Scan(ScanSpec* spec, bool use_blooms, int* num_matched, int* num_read) {
+    Arena arena(1024);
+    AutoReleasePool pool;
+    spec->OptimizeScan(schema_, &arena, &pool, true);
+    shared_ptr<CFileSet::Iterator> cfile_iter(fileset_->NewIterator(&schema_));
+    if (use_blooms) {
+      cfile_iter->set_bloom_filter_col_ids(fileset_->bloom_filter_col_ids());
+    }
+    gscoped_ptr<RowwiseIterator> iter(new MaterializingIterator(cfile_iter));
+    ASSERT_OK(iter->Init(spec));
+    RowBlock block(schema_, 100, &arena);
+    *num_matched = 0;
+    *num_read = 0;
+    while (iter->HasNext()) {
+      ASSERT_OK_FAST(iter->NextBlock(&block));
+      *num_read += block.nrows();
+      *num_matched += block.selection_vector()->CountSelected();
+    }
+  }
+
+ private:
+  static ColumnStorageAttributes GetBloomFilterStorage() {
+    ColumnStorageAttributes attr;
+    attr.bloom_filter = true;
+    return attr;
+  }
+
+ protected:
+  shared_ptr<CFileSet> fileset_;
+};
+
+TEST_F(TestCFileSetBloomFilter, TestScan) {
+  const int kNumRows = 10000;
+  NO_FATALS(WriteTestRowSet(kNumRows));
+  ASSERT_EQ(1, fileset_->bloom_filter_col_ids().size());
+  int num_matched;
+  int num_read;
+
+  // A value which the rowset holds can't be ruled out.
+  {
+    ScanSpec spec;
+    Slice trace("t42");
+    spec.AddPredicate(ColumnPredicate::Equality(schema_.column(1), &trace));
+    NO_FATALS(Scan(&spec, true, &num_matched, &num_read));
+    ASSERT_EQ(9, num_matched);
+    ASSERT_EQ(kNumRows, num_read);
+  }
+  {
+    ScanSpec spec;
+    Slice traces[] = { Slice("t1"), Slice("x1"), Slice("x2") };
+    vector<const void*> values = { &traces[0], &traces[1], &traces[2] };
+    spec.AddPredicate(ColumnPredicate::InList(schema_.column(1), &values));
+    NO_FATALS(Scan(&spec, true, &num_matched, &num_read));
+    ASSERT_EQ(9, num_matched);
+    ASSERT_EQ(kNumRows, num_read);
+  }
+
+  // Otherwise, none of the rowset is read.
+  {
+    ScanSpec spec;
+    Slice trace("x42");
+    spec.AddPredicate(ColumnPredicate::Equality(schema_.column(1), &trace));
+    NO_FATALS(Scan(&spec, true, &num_matched, &num_read));
+    ASSERT_EQ(0, num_matched);
+    ASSERT_EQ(0, num_read);
+  }
+  {
+    ScanSpec spec;
+    Slice traces[] = { Slice("x1"), Slice("x2"), Slice("x3") };
+    vector<const void*> values = { &traces[0], &traces[1], &traces[2] };
+    spec.AddPredicate(ColumnPredicate::InList(schema_.column(1), &values));
+    NO_FATALS(Scan(&spec, true, &num_matched, &num_read));
+    ASSERT_EQ(0, num_matched);
+    ASSERT_EQ(0, num_read);
+  }
+
+  // The bloom filters aren't consulted unless the caller allows it, or if
+  // disabled.
+  for (bool use_blooms : { false, true }) {
+    FLAGS_consult_column_bloom_filters = use_blooms;
+    ScanSpec spec;
+    Slice trace("x42");
+    spec.AddPredicate(ColumnPredicate::Equality(schema_.column(1), &trace));
+    NO_FATALS(Scan(&spec, !use_blooms, &num_matched, &num_read));
+    ASSERT_EQ(0, num_matched);
+    ASSERT_EQ(kNumRows, num_read);
+  }
+}
+
+// Test that the bloom filters are persisted in the rowset metadata, and are
+// dropped along with the data of their column.
+TEST_F(TestCFileSetBloomFilter, TestMetadata) {
+  NO_FATALS(WriteTestRowSet(1000));
+  const auto bloom_blocks = rowset_meta_->GetColumnBloomFilterBlocksById();
+  ASSERT_EQ(1, bloom_blocks.size());
+
+  RowSetDataPB pb;
+  rowset_meta_->ToProtobuf(&pb);
+  ASSERT_EQ(1, pb.column_bloom_filters_size());
+  rowset_meta_->LoadFromPB(pb);
+  ASSERT_TRUE(bloom_blocks == rowset_meta_->GetColumnBloomFilterBlocksById());
+
+  const ColumnId trace_col_id = schema_.column_id(1);
+  const BlockId trace_bloom_block = FindOrDie(bloom_blocks, trace_col_id);
+  RowSetMetadataUpdate update;
+  update.RemoveColumnId(trace_col_id);
+  vector<BlockId> removed;
+  rowset_meta_->CommitUpdate(update, &removed);
+  ASSERT_TRUE(rowset_meta_->GetColumnBloomFilterBlocksById().empty());
+  ASSERT_NE(removed.end(), std::find(removed.begin(), removed.end(), trace_bloom_block));
+}
 
 } // namespace tablet
 } // namespace kudu
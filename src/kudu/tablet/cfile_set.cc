@@ -16,9 +16,11 @@
 // under the License.
 
 #include <algorithm>
+#include <cmath>
 #include <memory>
 #include <ostream>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <boost/optional/optional.hpp>
@@ -26,36 +28,77 @@
 #include <glog/logging.h>
 
 #include "kudu/cfile/bloomfile.h"
+#include "kudu/cfile/cfile.pb.h"
 #include "kudu/cfile/cfile_reader.h"
 #include "kudu/cfile/cfile_util.h"
 #include "kudu/common/column_materialization_context.h"
+#include "kudu/common/column_predicate.h"
 #include "kudu/common/columnblock.h"
 #include "kudu/common/encoded_key.h"
 #include "kudu/common/iterator_stats.h"
+#include "kudu/common/key_encoder.h"
 #include "kudu/common/rowblock.h"
 #include "kudu/common/rowid.h"
 #include "kudu/common/scan_spec.h"
 #include "kudu/common/schema.h"
+#include "kudu/common/types.h"
 #include "kudu/fs/block_id.h"
 #include "kudu/fs/block_manager.h"
 #include "kudu/fs/fs_manager.h"
 #include "kudu/gutil/dynamic_annotations.h"
+#include "kudu/gutil/endian.h"
 #include "kudu/gutil/macros.h"
+#include "kudu/gutil/map-util.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/stringprintf.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/strings/util.h"
 #include "kudu/tablet/cfile_set.h"
 #include "kudu/tablet/diskrowset.h"
 #include "kudu/tablet/rowset.h"
 #include "kudu/tablet/rowset_metadata.h"
+#include "kudu/util/bloom_filter.h"
+#include "kudu/util/faststring.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/logging.h"
+#include "kudu/util/memory/arena.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/status.h"
 
 DEFINE_bool(consult_bloom_filters, true, "Whether to consult bloom filters on row presence checks");
 TAG_FLAG(consult_bloom_filters, hidden);
 
+DEFINE_bool(enable_skip_scan, true,
+            "Whether scans with a predicate on the second column of a compound "
+            "primary key may seek through the distinct values of the first "
+            "column, rather than read all the rows of each rowset.");
+TAG_FLAG(enable_skip_scan, advanced);
+TAG_FLAG(enable_skip_scan, runtime);
+
+DEFINE_bool(enable_secondary_index_scan, true,
+            "Whether scans with a predicate on a column with a secondary index "
+            "may read only the rows of each rowset which the index finds may "
+            "match it.");
+TAG_FLAG(enable_secondary_index_scan, advanced);
+TAG_FLAG(enable_secondary_index_scan, runtime);
+
+DEFINE_double(secondary_index_scan_max_row_fraction, 0.05,
+              "Fraction of the rows of a rowset which a secondary index may find "
+              "to match the predicate of a scan for it to be used. Past it, the "
+              "rows are read sequentially.");
+TAG_FLAG(secondary_index_scan_max_row_fraction, advanced);
+TAG_FLAG(secondary_index_scan_max_row_fraction, runtime);
+
+DEFINE_bool(consult_column_bloom_filters, true,
+            "Whether scans with an equality or IN-list predicate on a column "
+            "with a bloom filter skip the rowsets whose bloom filter shows "
+            "that they hold none of the predicate's values.");
+TAG_FLAG(consult_column_bloom_filters, advanced);
+TAG_FLAG(consult_column_bloom_filters, runtime);
+
+DECLARE_bool(cfile_late_materialization);
+DECLARE_bool(cfile_lazy_open);
+
 namespace kudu {
 
 class MemTracker;
@@ -75,17 +118,17 @@ using std::unique_ptr;
 using std::vector;
 using strings::Substitute;
 
+// The number of rows between two rows found by a secondary index up to which
+// they're scanned as a single range.
+static const rowid_t kSecondaryIndexMaxRowGap = 64;
+
 ////////////////////////////////////////////////////////////
 // Utilities
 ////////////////////////////////////////////////////////////
 
-static Status OpenReader(FsManager* fs,
+static Status OpenReader(unique_ptr<ReadableBlock> block,
                          shared_ptr<MemTracker> parent_mem_tracker,
-                         const BlockId& block_id,
                          unique_ptr<CFileReader>* new_reader) {
-  unique_ptr<ReadableBlock> block;
-  RETURN_NOT_OK(fs->OpenBlock(block_id, &block));
-
   ReaderOptions opts;
   opts.parent_mem_tracker = std::move(parent_mem_tracker);
   return CFileReader::OpenNoInit(std::move(block),
@@ -100,7 +143,9 @@ static Status OpenReader(FsManager* fs,
 CFileSet::CFileSet(shared_ptr<RowSetMetadata> rowset_metadata,
                    shared_ptr<MemTracker> parent_mem_tracker)
     : rowset_metadata_(std::move(rowset_metadata)),
-      parent_mem_tracker_(std::move(parent_mem_tracker)) {
+      parent_mem_tracker_(std::move(parent_mem_tracker)),
+      num_rows_(0),
+      num_batches_scanned_(0) {
 }
 
 CFileSet::~CFileSet() {
@@ -121,16 +166,40 @@ Status CFileSet::DoOpen() {
   RETURN_NOT_OK(OpenBloomReader());
 
   // Lazily open the column data cfiles. Each one will be fully opened
-  // later, when the first iterator seeks for the first time.
-  RowSetMetadata::ColumnIdToBlockIdMap block_map = rowset_metadata_->GetColumnBlocksById();
-  for (const RowSetMetadata::ColumnIdToBlockIdMap::value_type& e : block_map) {
+  // later, when the first iterator seeks for the first time. The blocks of
+  // all the cfiles are opened in one go, so that the block manager may open
+  // their files in parallel.
+  const RowSetMetadata::ColumnIdToBlockIdMap block_map =
+      rowset_metadata_->GetColumnBlocksById();
+  const RowSetMetadata::ColumnIdToBlockIdMap index_block_map =
+      rowset_metadata_->GetSecondaryIndexBlocksById();
+  const RowSetMetadata::ColumnIdToBlockIdMap bloom_block_map =
+      rowset_metadata_->GetColumnBloomFilterBlocksById();
+  vector<BlockId> block_ids;
+  block_ids.reserve(block_map.size() + index_block_map.size() + bloom_block_map.size() + 1);
+  for (const auto& e : block_map) {
+    block_ids.emplace_back(e.second);
+  }
+  for (const auto& e : index_block_map) {
+    block_ids.emplace_back(e.second);
+  }
+  for (const auto& e : bloom_block_map) {
+    block_ids.emplace_back(e.second);
+  }
+  if (rowset_metadata_->has_adhoc_index_block()) {
+    block_ids.emplace_back(rowset_metadata_->adhoc_index_block());
+  }
+  vector<unique_ptr<ReadableBlock>> blocks;
+  RETURN_NOT_OK(rowset_metadata_->fs_manager()->OpenBlocks(block_ids, &blocks));
+
+  int block_idx = 0;
+  for (const auto& e : block_map) {
     ColumnId col_id = e.first;
     DCHECK(!ContainsKey(readers_by_col_id_, col_id)) << "already open";
 
     unique_ptr<CFileReader> reader;
-    RETURN_NOT_OK(OpenReader(rowset_metadata_->fs_manager(),
+    RETURN_NOT_OK(OpenReader(std::move(blocks[block_idx++]),
                              parent_mem_tracker_,
-                             rowset_metadata_->column_data_block_for_col_id(col_id),
                              &reader));
     readers_by_col_id_[col_id] = std::move(reader);
     VLOG(1) << "Successfully opened cfile for column id " << col_id
@@ -138,20 +207,55 @@ Status CFileSet::DoOpen() {
   }
   readers_by_col_id_.shrink_to_fit();
 
+  for (const auto& e : index_block_map) {
+    unique_ptr<CFileReader> reader;
+    RETURN_NOT_OK(OpenReader(std::move(blocks[block_idx++]),
+                             parent_mem_tracker_,
+                             &reader));
+    secondary_index_readers_by_col_id_[e.first] = std::move(reader);
+  }
+  secondary_index_readers_by_col_id_.shrink_to_fit();
+
+  for (const auto& e : bloom_block_map) {
+    ReaderOptions opts;
+    opts.parent_mem_tracker = parent_mem_tracker_;
+    unique_ptr<BloomFileReader> reader;
+    RETURN_NOT_OK(BloomFileReader::OpenNoInit(std::move(blocks[block_idx++]),
+                                              std::move(opts),
+                                              &reader));
+    bloom_readers_by_col_id_[e.first] = std::move(reader);
+  }
+  bloom_readers_by_col_id_.shrink_to_fit();
+
   if (rowset_metadata_->has_adhoc_index_block()) {
-    RETURN_NOT_OK(OpenReader(rowset_metadata_->fs_manager(),
+    RETURN_NOT_OK(OpenReader(std::move(blocks[block_idx++]),
                              parent_mem_tracker_,
-                             rowset_metadata_->adhoc_index_block(),
                              &ad_hoc_idx_reader_));
   }
+  DCHECK_EQ(block_ids.size(), block_idx);
 
-  // However, the key reader should always be fully opened, so that we
-  // can figure out where in the rowset tree we belong.
-  RETURN_NOT_OK(key_index_reader()->Init());
+  // Determine the upper and lower key bounds and the size of this CFileSet,
+  // so that we can figure out where in the rowset tree we belong.
+  return LoadBaseDataSummary();
+}
 
-  // Determine the upper and lower key bounds for this CFileSet.
-  RETURN_NOT_OK(LoadMinMaxKeys());
+Status CFileSet::LoadBaseDataSummary() {
+  // The metadata of rowsets written by recent versions records the bounds and
+  // size, in which case the key reader is opened lazily, like the others.
+  RowSetMetadata::BaseDataSummary summary;
+  if (FLAGS_cfile_lazy_open && rowset_metadata_->GetBaseDataSummary(&summary)) {
+    min_encoded_key_ = std::move(summary.min_encoded_key);
+    max_encoded_key_ = std::move(summary.max_encoded_key);
+    num_rows_ = summary.num_rows;
+    return Status::OK();
+  }
 
+  // Otherwise, fully open the key reader to read them, and record them in the
+  // metadata for the next time the rowset is opened.
+  RETURN_NOT_OK(key_index_reader()->Init());
+  RETURN_NOT_OK(LoadMinMaxKeys());
+  RETURN_NOT_OK(key_index_reader()->CountRows(&num_rows_));
+  rowset_metadata_->SetBaseDataSummary({ min_encoded_key_, max_encoded_key_, num_rows_ });
   return Status::OK();
 }
 
@@ -203,6 +307,24 @@ CFileReader* CFileSet::key_index_reader() const {
   return FindOrDie(readers_by_col_id_, key_col_id).get();
 }
 
+vector<ColumnId> CFileSet::secondary_index_col_ids() const {
+  vector<ColumnId> col_ids;
+  col_ids.reserve(secondary_index_readers_by_col_id_.size());
+  for (const auto& e : secondary_index_readers_by_col_id_) {
+    col_ids.emplace_back(e.first);
+  }
+  return col_ids;
+}
+
+vector<ColumnId> CFileSet::bloom_filter_col_ids() const {
+  vector<ColumnId> col_ids;
+  col_ids.reserve(bloom_readers_by_col_id_.size());
+  for (const auto& e : bloom_readers_by_col_id_) {
+    col_ids.emplace_back(e.first);
+  }
+  return col_ids;
+}
+
 Status CFileSet::NewColumnIterator(ColumnId col_id, CFileReader::CacheControl cache_blocks,
                                    CFileIterator **iter) const {
   return FindOrDie(readers_by_col_id_, col_id)->NewIterator(iter, cache_blocks);
@@ -213,7 +335,8 @@ CFileSet::Iterator *CFileSet::NewIterator(const Schema *projection) const {
 }
 
 Status CFileSet::CountRows(rowid_t *count) const {
-  return key_index_reader()->CountRows(count);
+  *count = num_rows_;
+  return Status::OK();
 }
 
 Status CFileSet::GetBounds(string* min_encoded_key,
@@ -299,6 +422,160 @@ Status CFileSet::CheckRowPresent(const RowSetKeyProbe &probe, bool *present,
   return Status::OK();
 }
 
+Status CFileSet::CheckRowsPresent(const vector<const RowSetKeyProbe*>& probes,
+                                  const vector<ProbeStats*>& stats,
+                                  bool* present,
+                                  rowid_t* rowids) const {
+  DCHECK_EQ(probes.size(), stats.size());
+  const size_t n = probes.size();
+  if (n == 0) {
+    return Status::OK();
+  }
+  // Until ruled out by the blooms, every key may be present.
+  std::fill(present, present + n, true);
+
+  if (FLAGS_consult_bloom_filters) {
+    // Fully open the BloomFileReader if it was lazily opened earlier.
+    //
+    // If it's already initialized, this is a no-op.
+    RETURN_NOT_OK(bloom_reader_->Init());
+
+    vector<const BloomKeyProbe*> bloom_probes(n);
+    for (size_t i = 0; i < n; i++) {
+      stats[i]->blooms_consulted++;
+      bloom_probes[i] = &probes[i]->bloom_probe();
+    }
+    Status s = bloom_reader_->CheckKeysPresent(bloom_probes.data(), n, present);
+    if (!s.ok()) {
+      KLOG_EVERY_N_SECS(WARNING, 1) << Substitute("Unable to query bloom in $0: $1",
+          rowset_metadata_->bloom_block().ToString(), s.ToString());
+      if (PREDICT_FALSE(s.IsDiskFailure())) {
+        // If the bloom lookup failed because of a disk failure, return early
+        // since I/O to the tablet should be stopped.
+        return s;
+      }
+      // Continue with the slow path for all of the keys.
+      std::fill(present, present + n, true);
+    }
+  }
+
+  unique_ptr<CFileIterator> key_iter;
+  for (size_t i = 0; i < n; i++) {
+    if (!present[i]) continue;
+    DCHECK(i == 0 || probes[i - 1]->encoded_key_slice().compare(
+        probes[i]->encoded_key_slice()) <= 0) << "probes must be sorted";
+
+    if (!key_iter) {
+      CFileIterator *tmp = nullptr;
+      RETURN_NOT_OK(NewKeyIterator(&tmp));
+      key_iter.reset(tmp);
+    }
+    stats[i]->keys_consulted++;
+    bool exact;
+    Status s = key_iter->SeekForwardAtOrAfter(probes[i]->encoded_key(), &exact);
+    if (s.IsNotFound()) {
+      // All of the following keys are also past the end of the file.
+      std::fill(present + i, present + n, false);
+      break;
+    }
+    RETURN_NOT_OK(s);
+    present[i] = exact;
+    if (exact) {
+      rowids[i] = key_iter->GetCurrentOrdinal();
+    }
+  }
+  return Status::OK();
+}
+
+Status CFileSet::RowsMayMatch(ColumnId col_id,
+                              const ColumnPredicate& pred,
+                              bool* may_match) const {
+  *may_match = true;
+  if (!has_data_for_column_id(col_id)) {
+    return Status::OK();
+  }
+  rowid_t num_rows;
+  RETURN_NOT_OK(CountRows(&num_rows));
+  if (num_rows == 0) {
+    *may_match = false;
+    return Status::OK();
+  }
+
+  CFileIterator* tmp;
+  RETURN_NOT_OK(NewColumnIterator(col_id, CFileReader::CACHE_BLOCK, &tmp));
+  unique_ptr<CFileIterator> col_iter(tmp);
+  return col_iter->RowsMayMatch(0, num_rows, pred, may_match);
+}
+
+Status CFileSet::GetColumnStatistics(ColumnId col_id,
+                                     cfile::ColumnStatisticsPB* stats) const {
+  if (!has_data_for_column_id(col_id)) {
+    return Status::NotFound("no data for column", Substitute("$0", col_id));
+  }
+  CFileReader* reader = FindOrDie(readers_by_col_id_, col_id).get();
+  RETURN_NOT_OK(reader->Init());
+  if (!reader->footer().has_statistics()) {
+    return Status::NotFound("no statistics for column", Substitute("$0", col_id));
+  }
+  *stats = reader->footer().statistics();
+  return Status::OK();
+}
+
+Status CFileSet::SampleKeys(int num_samples, vector<string>* encoded_keys) const {
+  encoded_keys->clear();
+  rowid_t num_rows;
+  RETURN_NOT_OK(CountRows(&num_rows));
+  if (num_rows == 0 || num_samples <= 0) {
+    return Status::OK();
+  }
+
+  // The ad hoc index of a compound key can't be sought by ordinal, so the
+  // keys are read from the key columns themselves and encoded.
+  const Schema& schema = tablet_schema();
+  const size_t num_key_cols = schema.num_key_columns();
+  Arena arena(1024);
+  vector<unique_ptr<CFileIterator>> key_col_iters;
+  vector<unique_ptr<uint8_t[]>> cells;
+  vector<ColumnBlock> blocks;
+  key_col_iters.reserve(num_key_cols);
+  cells.reserve(num_key_cols);
+  blocks.reserve(num_key_cols);
+  for (size_t i = 0; i < num_key_cols; i++) {
+    CFileIterator* tmp;
+    RETURN_NOT_OK(NewColumnIterator(schema.column_id(i), CFileReader::CACHE_BLOCK, &tmp));
+    key_col_iters.emplace_back(tmp);
+    const TypeInfo* type = schema.column(i).type_info();
+    cells.emplace_back(new uint8_t[type->size()]);
+    blocks.emplace_back(type, nullptr, cells.back().get(), 1, &arena);
+  }
+  SelectionVector sel(1);
+  EncodedKeyBuilder key_builder(&schema);
+
+  int64_t prev_ord = -1;
+  for (int i = 0; i < num_samples; i++) {
+    const int64_t ord = static_cast<int64_t>(num_rows) * i / num_samples;
+    if (ord == prev_ord) {
+      continue;
+    }
+    prev_ord = ord;
+
+    arena.Reset();
+    key_builder.Reset();
+    for (size_t j = 0; j < num_key_cols; j++) {
+      ColumnMaterializationContext ctx(j, nullptr, &blocks[j], &sel);
+      ctx.SetDecoderEvalNotSupported();
+      RETURN_NOT_OK(key_col_iters[j]->SeekToOrdinal(ord));
+      size_t n = 1;
+      RETURN_NOT_OK(key_col_iters[j]->CopyNextValues(&n, &ctx));
+      DCHECK_EQ(1, n);
+      key_builder.AddColumnKey(blocks[j].cell_ptr(0));
+    }
+    gscoped_ptr<EncodedKey> key(key_builder.BuildEncodedKey());
+    encoded_keys->emplace_back(key->encoded_key().ToString());
+  }
+  return Status::OK();
+}
+
 Status CFileSet::NewKeyIterator(CFileIterator **key_iter) const {
   return key_index_reader()->NewIterator(key_iter, CFileReader::CACHE_BLOCK);
 }
@@ -316,7 +593,8 @@ Status CFileSet::Iterator::CreateColumnIterators(const ScanSpec* spec) {
 
   CFileReader::CacheControl cache_blocks = CFileReader::CACHE_BLOCK;
   if (spec && !spec->cache_blocks()) {
-    cache_blocks = CFileReader::DONT_CACHE_BLOCK;
+    cache_blocks = spec->cache_pages() ? CFileReader::DONT_CACHE_BLOCK :
+                                         CFileReader::DONT_CACHE_BLOCK_OR_PAGES;
   }
 
   for (int proj_col_idx = 0;
@@ -368,8 +646,24 @@ Status CFileSet::Iterator::Init(ScanSpec *spec) {
   // Don't actually seek -- we'll seek when we first actually read the
   // data.
   cur_idx_ = lower_bound_idx_;
+  range_end_idx_ = upper_bound_idx_;
   Unprepare(); // Reset state.
-  return Status::OK();
+
+  // If the bloom filters rule out the whole rowset, none of it is read.
+  bool may_match;
+  RETURN_NOT_OK(ColumnBloomFiltersMayMatch(spec, &may_match));
+  if (!may_match) {
+    cur_idx_ = upper_bound_idx_;
+    return Status::OK();
+  }
+
+  // These may move 'cur_idx_' forward to the first rows which may match.
+  bool used_index;
+  RETURN_NOT_OK(InitSecondaryIndexScan(spec, &used_index));
+  if (used_index) {
+    return Status::OK();
+  }
+  return InitSkipScan(spec);
 }
 
 Status CFileSet::Iterator::PushdownRangeScanPredicate(ScanSpec *spec) {
@@ -432,6 +726,382 @@ Status CFileSet::Iterator::PushdownRangeScanPredicate(ScanSpec *spec) {
   return Status::OK();
 }
 
+Status CFileSet::Iterator::ColumnBloomFiltersMayMatch(const ScanSpec* spec, bool* may_match) {
+  *may_match = true;
+  if (!FLAGS_consult_column_bloom_filters || spec == nullptr ||
+      bloom_filter_col_ids_.empty() || cur_idx_ >= upper_bound_idx_) {
+    return Status::OK();
+  }
+
+  const Schema& tablet_schema = base_data_->tablet_schema();
+  for (const auto& e : spec->predicates()) {
+    const ColumnPredicate& pred = e.second;
+    vector<const void*> values;
+    switch (pred.predicate_type()) {
+      case PredicateType::Equality:
+        values.push_back(pred.raw_lower());
+        break;
+      case PredicateType::InList:
+        values = pred.raw_values();
+        break;
+      default:
+        continue;
+    }
+    const int col_idx = tablet_schema.find_column(e.first);
+    if (col_idx == Schema::kColumnNotFound) {
+      continue;
+    }
+    const ColumnId col_id = tablet_schema.column_id(col_idx);
+    if (std::find(bloom_filter_col_ids_.begin(), bloom_filter_col_ids_.end(), col_id) ==
+        bloom_filter_col_ids_.end()) {
+      continue;
+    }
+    const auto* reader = FindOrNull(base_data_->bloom_readers_by_col_id_, col_id);
+    if (reader == nullptr) {
+      continue;
+    }
+    BloomFileReader* bloom_reader = reader->get();
+    RETURN_NOT_OK(bloom_reader->Init());
+
+    // The filter holds the key encodings of the values. Those of an IN list
+    // are sorted, so that neighboring ones fall in the same bloom block.
+    const KeyEncoder<faststring>& encoder = GetKeyEncoder<faststring>(pred.column().type_info());
+    vector<string> keys(values.size());
+    vector<BloomKeyProbe> probes(values.size());
+    vector<const BloomKeyProbe*> probe_ptrs(values.size());
+    faststring buf;
+    for (size_t i = 0; i < values.size(); i++) {
+      buf.clear();
+      encoder.Encode(values[i], /*is_last=*/false, &buf);
+      keys[i] = buf.ToString();
+      probes[i] = BloomKeyProbe(Slice(keys[i]));
+      probe_ptrs[i] = &probes[i];
+    }
+    unique_ptr<bool[]> present(new bool[values.size()]);
+    Status s = bloom_reader->CheckKeysPresent(probe_ptrs.data(), values.size(), present.get());
+    if (!s.ok()) {
+      KLOG_EVERY_N_SECS(WARNING, 1) << Substitute("Unable to query bloom filter of column $0 "
+                                                  "in $1: $2", pred.column().name(),
+                                                  base_data_->ToString(), s.ToString());
+      if (PREDICT_FALSE(s.IsDiskFailure())) {
+        return s;
+      }
+      continue;
+    }
+    if (std::none_of(present.get(), present.get() + values.size(),
+                     [](bool p) { return p; })) {
+      VLOG(1) << "Skipping " << base_data_->ToString() << ": its bloom filter rules out "
+              << pred.ToString();
+      *may_match = false;
+      return Status::OK();
+    }
+  }
+  return Status::OK();
+}
+
+Status CFileSet::Iterator::InitSecondaryIndexScan(const ScanSpec* spec, bool* used) {
+  *used = false;
+  if (!FLAGS_enable_secondary_index_scan || spec == nullptr ||
+      secondary_index_col_ids_.empty() || cur_idx_ >= upper_bound_idx_) {
+    return Status::OK();
+  }
+
+  // Find a predicate which the index of its column can look up, as ranges of
+  // encoded values.
+  const Schema& tablet_schema = base_data_->tablet_schema();
+  const ColumnPredicate* pred = nullptr;
+  CFileReader* index_reader = nullptr;
+  for (const auto& e : spec->predicates()) {
+    const PredicateType type = e.second.predicate_type();
+    if (type != PredicateType::Equality && type != PredicateType::InList &&
+        type != PredicateType::Range) {
+      continue;
+    }
+    const int col_idx = tablet_schema.find_column(e.first);
+    if (col_idx == Schema::kColumnNotFound) {
+      continue;
+    }
+    const ColumnId col_id = tablet_schema.column_id(col_idx);
+    if (std::find(secondary_index_col_ids_.begin(), secondary_index_col_ids_.end(), col_id) ==
+        secondary_index_col_ids_.end()) {
+      continue;
+    }
+    const auto* reader = FindOrNull(base_data_->secondary_index_readers_by_col_id_, col_id);
+    if (reader == nullptr) {
+      continue;
+    }
+    pred = &e.second;
+    index_reader = reader->get();
+    break;
+  }
+  if (pred == nullptr) {
+    return Status::OK();
+  }
+
+  // Values are encoded as the prefixes of the entries of the index, which
+  // are followed by the ordinals of their rows.
+  const KeyEncoder<faststring>& encoder = GetKeyEncoder<faststring>(pred->column().type_info());
+  const auto encode = [&](const void* value) {
+    faststring buf;
+    encoder.Encode(value, /*is_last=*/false, &buf);
+    return buf.ToString();
+  };
+  vector<std::pair<string, string>> bounds;
+  switch (pred->predicate_type()) {
+    case PredicateType::Equality: {
+      string value = encode(pred->raw_lower());
+      bounds.emplace_back(value, PrefixSuccessor(value));
+      break;
+    }
+    case PredicateType::InList:
+      for (const void* raw_value : pred->raw_values()) {
+        string value = encode(raw_value);
+        bounds.emplace_back(value, PrefixSuccessor(value));
+      }
+      break;
+    case PredicateType::Range:
+      bounds.emplace_back(pred->raw_lower() == nullptr ? string() : encode(pred->raw_lower()),
+                          pred->raw_upper() == nullptr ? string() : encode(pred->raw_upper()));
+      break;
+    default:
+      LOG(FATAL) << "unexpected predicate " << pred->ToString();
+  }
+
+  // Past a fraction of the rows, reading them sequentially costs less than
+  // seeking to each of them.
+  const size_t max_ordinals = static_cast<size_t>(
+      (upper_bound_idx_ - cur_idx_) * FLAGS_secondary_index_scan_max_row_fraction);
+  CFileIterator* tmp;
+  RETURN_NOT_OK(index_reader->NewIterator(&tmp, CFileReader::CACHE_BLOCK));
+  unique_ptr<CFileIterator> index_iter(tmp);
+  vector<rowid_t> ordinals;
+  for (const auto& b : bounds) {
+    Status s = ReadSecondaryIndexRange(index_iter.get(), b.first, b.second,
+                                       max_ordinals, &ordinals);
+    if (s.IsIncomplete()) {
+      VLOG(1) << "Not using the secondary index of " << base_data_->ToString() << " for "
+              << pred->ToString() << ": too many rows may match";
+      return Status::OK();
+    }
+    RETURN_NOT_OK(s);
+  }
+  std::sort(ordinals.begin(), ordinals.end());
+
+  // Rows close to each other are read as a single range, since skipping a
+  // few rows doesn't save reading their blocks.
+  index_ranges_.clear();
+  for (rowid_t ordinal : ordinals) {
+    if (!index_ranges_.empty() &&
+        ordinal <= index_ranges_.back().second + kSecondaryIndexMaxRowGap) {
+      index_ranges_.back().second = std::max(index_ranges_.back().second, ordinal + 1);
+    } else {
+      index_ranges_.emplace_back(ordinal, ordinal + 1);
+    }
+  }
+  VLOG(1) << "Scanning " << ordinals.size() << " rows in " << index_ranges_.size()
+          << " ranges of " << base_data_->ToString() << " found by the secondary index for "
+          << pred->ToString();
+  *used = true;
+  next_index_range_ = 0;
+  SeekToNextIndexRange();
+  return Status::OK();
+}
+
+Status CFileSet::Iterator::ReadSecondaryIndexRange(CFileIterator* index_iter,
+                                                   const string& lower,
+                                                   const string& upper,
+                                                   size_t max_ordinals,
+                                                   vector<rowid_t>* ordinals) {
+  // The index is a single BINARY key column.
+  faststring buf;
+  buf.assign_copy(lower);
+  Slice lower_slice(lower);
+  vector<const void*> raw_keys = { &lower_slice };
+  EncodedKey key(&buf, &raw_keys, 1);
+  bool exact;
+  Status s = index_iter->SeekAtOrAfter(key, &exact);
+  if (s.IsNotFound()) {
+    return Status::OK();
+  }
+  RETURN_NOT_OK(s);
+
+  const size_t kBatchSize = 1024;
+  Arena arena(32 * 1024);
+  unique_ptr<Slice[]> entries(new Slice[kBatchSize]);
+  ColumnBlock cb(GetTypeInfo(BINARY), nullptr, entries.get(), kBatchSize, &arena);
+  SelectionVector sel(kBatchSize);
+  while (index_iter->HasNext()) {
+    arena.Reset();
+    ColumnMaterializationContext ctx(0, nullptr, &cb, &sel);
+    ctx.SetDecoderEvalNotSupported();
+    size_t n = kBatchSize;
+    RETURN_NOT_OK(index_iter->CopyNextValues(&n, &ctx));
+    for (size_t i = 0; i < n; i++) {
+      const Slice& entry = entries[i];
+      if (!upper.empty() && entry.compare(upper) >= 0) {
+        return Status::OK();
+      }
+      if (PREDICT_FALSE(entry.size() < sizeof(rowid_t))) {
+        return Status::Corruption("invalid secondary index entry",
+                                  KUDU_REDACT(entry.ToDebugString()));
+      }
+      const rowid_t ordinal = BigEndian::Load32(entry.data() + entry.size() - sizeof(rowid_t));
+      if (ordinal < cur_idx_ || ordinal >= upper_bound_idx_) {
+        continue;
+      }
+      if (ordinals->size() >= max_ordinals) {
+        return Status::Incomplete("too many matching rows");
+      }
+      ordinals->push_back(ordinal);
+    }
+  }
+  return Status::OK();
+}
+
+void CFileSet::Iterator::SeekToNextIndexRange() {
+  if (next_index_range_ == index_ranges_.size()) {
+    cur_idx_ = upper_bound_idx_;
+    range_end_idx_ = upper_bound_idx_;
+    return;
+  }
+  const auto& range = index_ranges_[next_index_range_++];
+  DCHECK_GE(range.first, cur_idx_);
+  cur_idx_ = range.first;
+  range_end_idx_ = range.second;
+}
+
+Status CFileSet::Iterator::InitSkipScan(const ScanSpec* spec) {
+  const Schema& tablet_schema = base_data_->tablet_schema();
+  if (!FLAGS_enable_skip_scan || spec == nullptr ||
+      tablet_schema.num_key_columns() < 2 || cur_idx_ >= upper_bound_idx_) {
+    return Status::OK();
+  }
+  const ColumnSchema& col = tablet_schema.column(1);
+  const ColumnPredicate* pred = FindOrNull(spec->predicates(), col.name());
+  if (pred == nullptr) {
+    return Status::OK();
+  }
+
+  // The bounds are encoded as the suffixes of keys whose first column is
+  // already encoded.
+  const bool is_last = tablet_schema.num_key_columns() == 2;
+  const KeyEncoder<faststring>& encoder = GetKeyEncoder<faststring>(col.type_info());
+  faststring buf;
+  switch (pred->predicate_type()) {
+    case PredicateType::Equality:
+      encoder.Encode(pred->raw_lower(), is_last, &buf);
+      skip_scan_lower_ = buf.ToString();
+      skip_scan_equality_ = true;
+      break;
+    case PredicateType::Range:
+      if (pred->raw_lower() != nullptr) {
+        encoder.Encode(pred->raw_lower(), is_last, &buf);
+        skip_scan_lower_ = buf.ToString();
+        buf.clear();
+      }
+      if (pred->raw_upper() != nullptr) {
+        encoder.Encode(pred->raw_upper(), is_last, &buf);
+        skip_scan_upper_ = buf.ToString();
+      }
+      break;
+    default:
+      return Status::OK();
+  }
+
+  CFileIterator* iter;
+  RETURN_NOT_OK(base_data_->NewColumnIterator(tablet_schema.column_id(0),
+                                              CFileReader::CACHE_BLOCK, &iter));
+  skip_scan_iter_.reset(iter);
+  // Each value of the first key column takes a few seeks, which pay off as
+  // long as there are far fewer values than rows.
+  skip_scan_max_prefixes_ = std::max<int64_t>(
+      1, static_cast<int64_t>(sqrt(upper_bound_idx_ - cur_idx_)));
+  VLOG(1) << "Skip scanning " << base_data_->ToString() << " for " << pred->ToString();
+  return SeekToNextSkipScanRange();
+}
+
+Status CFileSet::Iterator::SeekToNextSkipScanRange() {
+  DCHECK(skip_scan_iter_);
+  while (cur_idx_ < upper_bound_idx_) {
+    if (skip_scan_num_prefixes_ >= skip_scan_max_prefixes_) {
+      VLOG(1) << "Giving up skip scanning " << base_data_->ToString() << " after "
+              << skip_scan_num_prefixes_ << " distinct values of the first key column";
+      skip_scan_iter_.reset();
+      range_end_idx_ = upper_bound_idx_;
+      return Status::OK();
+    }
+    skip_scan_num_prefixes_++;
+    RETURN_NOT_OK(ReadSkipScanPrefix(cur_idx_));
+
+    const string lower_key = skip_scan_prefix_ + skip_scan_lower_;
+    string upper_key;
+    if (skip_scan_equality_) {
+      upper_key = PrefixSuccessor(lower_key);
+    } else if (!skip_scan_upper_.empty()) {
+      upper_key = skip_scan_prefix_ + skip_scan_upper_;
+    } else {
+      upper_key = PrefixSuccessor(skip_scan_prefix_);
+    }
+    rowid_t start;
+    rowid_t end;
+    RETURN_NOT_OK(SeekSkipScanKey(lower_key, &start));
+    RETURN_NOT_OK(SeekSkipScanKey(upper_key, &end));
+    start = std::max<rowid_t>(start, cur_idx_);
+    if (start < end) {
+      cur_idx_ = start;
+      range_end_idx_ = end;
+      return Status::OK();
+    }
+
+    // None of the rows with this value of the first key column may match.
+    rowid_t next;
+    RETURN_NOT_OK(SeekSkipScanKey(PrefixSuccessor(skip_scan_prefix_), &next));
+    DCHECK_GT(next, cur_idx_);
+    cur_idx_ = next;
+  }
+  return Status::OK();
+}
+
+Status CFileSet::Iterator::ReadSkipScanPrefix(rowid_t idx) {
+  const ColumnSchema& col = base_data_->tablet_schema().column(0);
+  Arena arena(256);
+  unique_ptr<uint8_t[]> cell(new uint8_t[col.type_info()->size()]);
+  ColumnBlock cb(col.type_info(), nullptr, cell.get(), 1, &arena);
+  SelectionVector sel(1);
+  ColumnMaterializationContext ctx(0, nullptr, &cb, &sel);
+  ctx.SetDecoderEvalNotSupported();
+
+  RETURN_NOT_OK(skip_scan_iter_->SeekToOrdinal(idx));
+  size_t n = 1;
+  RETURN_NOT_OK(skip_scan_iter_->CopyNextValues(&n, &ctx));
+  DCHECK_EQ(1, n);
+
+  faststring buf;
+  GetKeyEncoder<faststring>(col.type_info()).Encode(cb.cell_ptr(0), /*is_last=*/false, &buf);
+  skip_scan_prefix_ = buf.ToString();
+  return Status::OK();
+}
+
+Status CFileSet::Iterator::SeekSkipScanKey(const string& encoded_key, rowid_t* idx) {
+  if (encoded_key.empty()) {
+    *idx = upper_bound_idx_;
+    return Status::OK();
+  }
+  faststring buf;
+  buf.assign_copy(encoded_key);
+  vector<const void*> raw_keys;
+  EncodedKey key(&buf, &raw_keys, base_data_->tablet_schema().num_key_columns());
+  bool exact;
+  Status s = key_iter_->SeekAtOrAfter(key, &exact);
+  if (s.IsNotFound()) {
+    *idx = upper_bound_idx_;
+    return Status::OK();
+  }
+  RETURN_NOT_OK(s);
+  *idx = std::min<rowid_t>(key_iter_->GetCurrentOrdinal(), upper_bound_idx_);
+  return Status::OK();
+}
+
 void CFileSet::Iterator::Unprepare() {
   prepared_count_ = 0;
   cols_prepared_.assign(col_iters_.size(), false);
@@ -440,12 +1110,13 @@ void CFileSet::Iterator::Unprepare() {
 Status CFileSet::Iterator::PrepareBatch(size_t *n) {
   DCHECK_EQ(prepared_count_, 0) << "Already prepared";
 
-  size_t remaining = upper_bound_idx_ - cur_idx_;
+  size_t remaining = range_end_idx_ - cur_idx_;
   if (*n > remaining) {
     *n = remaining;
   }
 
   prepared_count_ = *n;
+  base_data_->num_batches_scanned_.Increment();
 
   // Lazily prepare the first column when it is materialized.
   return Status::OK();
@@ -496,9 +1167,29 @@ Status CFileSet::Iterator::InitializeSelectionVector(SelectionVector *sel_vec) {
 Status CFileSet::Iterator::MaterializeColumn(ColumnMaterializationContext *ctx) {
   CHECK_EQ(prepared_count_, ctx->block()->nrows());
   DCHECK_LT(ctx->col_idx(), col_iters_.size());
+  ColumnIterator* iter = col_iters_[ctx->col_idx()].get();
+
+  // A column without a predicate only needs to be read for the selected rows;
+  // if there are none, the column's blocks needn't even be read.
+  if (FLAGS_cfile_late_materialization && ctx->pred() == nullptr &&
+      ctx->sel() != nullptr && !ctx->sel()->AnySelected()) {
+    return Status::OK();
+  }
+
+  // If the column's zone maps show that none of the batch's rows can match
+  // the predicate, skip reading the column altogether. Zone maps describe the
+  // base data, so this is only done if decoder evaluation is allowed, i.e.
+  // the rows have no updates.
+  if (ctx->DecoderEvalNotDisabled()) {
+    bool may_match;
+    RETURN_NOT_OK(iter->RowsMayMatch(cur_idx_, prepared_count_, *ctx->pred(), &may_match));
+    if (!may_match) {
+      ctx->sel()->SetAllFalse();
+      return Status::OK();
+    }
+  }
 
   RETURN_NOT_OK(PrepareColumn(ctx));
-  ColumnIterator* iter = col_iters_[ctx->col_idx()].get();
 
   RETURN_NOT_OK(iter->Scan(ctx));
 
@@ -521,6 +1212,19 @@ Status CFileSet::Iterator::FinishBatch() {
   cur_idx_ += prepared_count_;
   Unprepare();
 
+  if (!index_ranges_.empty() && cur_idx_ == range_end_idx_) {
+    SeekToNextIndexRange();
+    return Status::OK();
+  }
+
+  if (skip_scan_iter_ && cur_idx_ == range_end_idx_ && cur_idx_ < upper_bound_idx_) {
+    // The rows of the current range are exhausted, and the rest of the rows
+    // with the same value of the first key column can't match.
+    rowid_t next;
+    RETURN_NOT_OK(SeekSkipScanKey(PrefixSuccessor(skip_scan_prefix_), &next));
+    cur_idx_ = std::max<size_t>(cur_idx_, next);
+    RETURN_NOT_OK(SeekToNextSkipScanRange());
+  }
   return Status::OK();
 }
 
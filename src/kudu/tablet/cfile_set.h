@@ -38,6 +38,7 @@
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/port.h"
 #include "kudu/tablet/rowset_metadata.h"
+#include "kudu/util/atomic.h"
 #include "kudu/util/status.h"
 
 namespace boost {
@@ -48,6 +49,7 @@ class optional;
 namespace kudu {
 
 class ColumnMaterializationContext;
+class ColumnPredicate;
 class MemTracker;
 class ScanSpec;
 class SelectionVector;
@@ -55,6 +57,7 @@ struct IteratorStats;
 
 namespace cfile {
 class BloomFileReader;
+class ColumnStatisticsPB;
 }
 
 namespace tablet {
@@ -111,11 +114,56 @@ class CFileSet : public std::enable_shared_from_this<CFileSet> {
   Status CheckRowPresent(const RowSetKeyProbe &probe, bool *present,
                          rowid_t *rowid, ProbeStats* stats) const;
 
+  // Like CheckRowPresent(), for a batch of 'probes' sorted by increasing
+  // encoded key, setting present[i] and rowids[i] for probes[i].
+  //
+  // The bloom filters are consulted for the whole batch at once, and a
+  // single key index iterator is used for the remaining keys, so that
+  // neighboring keys reuse the index and data blocks decoded for the
+  // previous ones.
+  Status CheckRowsPresent(const std::vector<const RowSetKeyProbe*>& probes,
+                          const std::vector<ProbeStats*>& stats,
+                          bool* present,
+                          rowid_t* rowids) const;
+
+  // Reads the encoded keys of up to 'num_samples' rows evenly spaced through
+  // this cfile set, in increasing key order, into 'encoded_keys'. The first
+  // key is always that of the first row.
+  //
+  // Used to split the key range of a compaction.
+  Status SampleKeys(int num_samples, std::vector<std::string>* encoded_keys) const;
+
+  // Sets '*may_match' to false if it's certain, from the zone maps of the
+  // column with ID 'col_id', that none of the rows of this cfile set satisfy
+  // 'pred'. Otherwise, e.g. if the column has no zone maps, sets it to true.
+  //
+  // Like the zone maps themselves, this only describes the base data.
+  Status RowsMayMatch(ColumnId col_id, const ColumnPredicate& pred, bool* may_match) const;
+
+  // Sets 'stats' to the statistics stored in the footer of the cfile of the
+  // column with ID 'col_id'. Returns NotFound if the cfile has none, e.g.
+  // because it was written by an older version.
+  Status GetColumnStatistics(ColumnId col_id, cfile::ColumnStatisticsPB* stats) const;
+
+  // Returns the number of row batches prepared by iterators over this
+  // cfile set, as a measure of how heavily it is scanned.
+  int64_t num_batches_scanned() const {
+    return num_batches_scanned_.Load();
+  }
+
   // Return true if there exists a CFile for the given column ID.
   bool has_data_for_column_id(ColumnId col_id) const {
     return ContainsKey(readers_by_col_id_, col_id);
   }
 
+  // Returns the IDs of the columns which have a secondary index. See
+  // MultiColumnWriter for their format.
+  std::vector<ColumnId> secondary_index_col_ids() const;
+
+  // Returns the IDs of the columns which have a bloom filter of their values.
+  // See MultiColumnWriter for their format.
+  std::vector<ColumnId> bloom_filter_col_ids() const;
+
   virtual ~CFileSet();
 
  private:
@@ -131,6 +179,7 @@ class CFileSet : public std::enable_shared_from_this<CFileSet> {
   Status OpenBloomReader();
   Status OpenAdHocIndexReader();
   Status LoadMinMaxKeys();
+  Status LoadBaseDataSummary();
 
   Status NewColumnIterator(ColumnId col_id,
                            cfile::CFileReader::CacheControl cache_blocks,
@@ -148,6 +197,7 @@ class CFileSet : public std::enable_shared_from_this<CFileSet> {
 
   std::string min_encoded_key_;
   std::string max_encoded_key_;
+  rowid_t num_rows_;
 
   // Map of column ID to reader. These are lazily initialized as needed.
   // We use flat_map here since it's the most memory-compact while
@@ -160,6 +210,19 @@ class CFileSet : public std::enable_shared_from_this<CFileSet> {
   // index pertains to more than one column, as in the case of composite keys.
   std::unique_ptr<cfile::CFileReader> ad_hoc_idx_reader_;
   std::unique_ptr<cfile::BloomFileReader> bloom_reader_;
+
+  // Map of column ID to the reader of the column's secondary index. These are
+  // lazily initialized as needed, like the column readers.
+  ReaderMap secondary_index_readers_by_col_id_;
+
+  // Map of column ID to the reader of the bloom filter of the column's
+  // values. These are lazily initialized as needed.
+  typedef boost::container::flat_map<int, std::unique_ptr<cfile::BloomFileReader>>
+      BloomReaderMap;
+  BloomReaderMap bloom_readers_by_col_id_;
+
+  // See num_batches_scanned().
+  mutable AtomicInt<int64_t> num_batches_scanned_;
 };
 
 
@@ -204,6 +267,26 @@ class CFileSet::Iterator : public ColumnwiseIterator {
   // Collect the IO statistics for each of the underlying columns.
   virtual void GetIteratorStats(std::vector<IteratorStats> *stats) const OVERRIDE;
 
+  // Sets the IDs of the columns whose secondary indexes Init() may use to
+  // find the rows matching the predicates of the scan. The indexes describe
+  // the base data, so these must be columns whose values aren't changed by
+  // the deltas of the rowset as of the scan's snapshot. By default, none
+  // are used.
+  void set_secondary_index_col_ids(std::vector<ColumnId> col_ids) {
+    DCHECK(!initted_);
+    secondary_index_col_ids_ = std::move(col_ids);
+  }
+
+  // Sets the IDs of the columns whose bloom filters Init() may consult to
+  // rule out the whole rowset for the equality and IN-list predicates of the
+  // scan. Like the secondary indexes, the bloom filters describe the base
+  // data, so these must be columns whose values aren't changed by the deltas
+  // of the rowset as of the scan's snapshot. By default, none are used.
+  void set_bloom_filter_col_ids(std::vector<ColumnId> col_ids) {
+    DCHECK(!initted_);
+    bloom_filter_col_ids_ = std::move(col_ids);
+  }
+
   virtual ~Iterator();
  private:
   DISALLOW_COPY_AND_ASSIGN(Iterator);
@@ -216,7 +299,12 @@ class CFileSet::Iterator : public ColumnwiseIterator {
         projection_(projection),
         initted_(false),
         cur_idx_(0),
-        prepared_count_(0) {
+        prepared_count_(0),
+        range_end_idx_(0),
+        skip_scan_equality_(false),
+        skip_scan_num_prefixes_(0),
+        skip_scan_max_prefixes_(0),
+        next_index_range_(0) {
     CHECK_OK(base_data_->CountRows(&row_count_));
   }
 
@@ -228,6 +316,56 @@ class CFileSet::Iterator : public ColumnwiseIterator {
   // store it in member fields.
   Status PushdownRangeScanPredicate(ScanSpec *spec);
 
+  // Looks for an equality, IN-list or range predicate in 'spec' on a column
+  // with a usable secondary index, and if there's one, reads the ordinals of
+  // the rows which may match it from the index. If they're few enough, the
+  // scan then only reads the ranges of rows around them, and '*used' is set
+  // to true. The predicate remains in 'spec', so the index only narrows down
+  // the rows read.
+  Status InitSecondaryIndexScan(const ScanSpec* spec, bool* used);
+
+  // Sets '*may_match' to false if the bloom filter of a column in
+  // 'bloom_filter_col_ids_' shows that the rowset holds none of the values
+  // of an equality or IN-list predicate of 'spec' on it.
+  Status ColumnBloomFiltersMayMatch(const ScanSpec* spec, bool* may_match);
+
+  // Appends to 'ordinals' the ordinals of the rows within the bounds of the
+  // iterator whose entries in the secondary index read by 'index_iter' are in
+  // ['lower', 'upper'), or in ['lower', end of the index) if 'upper' is empty.
+  // Returns Incomplete once there are more than 'max_ordinals' of them.
+  Status ReadSecondaryIndexRange(cfile::CFileIterator* index_iter,
+                                 const std::string& lower,
+                                 const std::string& upper,
+                                 size_t max_ordinals,
+                                 std::vector<rowid_t>* ordinals);
+
+  // Moves 'cur_idx_' to the start of the next range of rows found by the
+  // secondary index, and sets 'range_end_idx_' to its end. If there's none,
+  // 'cur_idx_' is set to 'upper_bound_idx_'.
+  void SeekToNextIndexRange();
+
+  // Sets up a skip scan if the key is compound, and 'spec' has an equality
+  // or range predicate on its second column: the scan then seeks, for each
+  // distinct value of the first key column, to the rows which may match that
+  // predicate, rather than reading all the rows in between. The predicate
+  // remains in 'spec', so the skip scan only narrows down the rows read.
+  Status InitSkipScan(const ScanSpec* spec);
+
+  // Moves 'cur_idx_' forward to the start of the next range of rows of the
+  // skip scan, and sets 'range_end_idx_' to its end. If there's none,
+  // 'cur_idx_' is set to 'upper_bound_idx_'. 'cur_idx_' must be at the first
+  // row of the ranges left to scan with a given value of the first key column.
+  Status SeekToNextSkipScanRange();
+
+  // Reads the value of the first key column of row 'idx', and sets
+  // 'skip_scan_prefix_' to its encoding as the prefix of a compound key.
+  Status ReadSkipScanPrefix(rowid_t idx);
+
+  // Returns in 'idx' the ordinal of the first row whose encoded key is at or
+  // after 'encoded_key', or 'upper_bound_idx_' if there is none or it is after
+  // that bound. An empty 'encoded_key' stands for the end of the key space.
+  Status SeekSkipScanKey(const std::string& encoded_key, rowid_t* idx);
+
   void Unprepare();
 
   // Prepare the given column if not already prepared.
@@ -260,6 +398,43 @@ class CFileSet::Iterator : public ColumnwiseIterator {
   // materialized, it doesn't need to be read off disk.
   std::vector<bool> cols_prepared_;
 
+  // The end (exclusive) of the range of rows being scanned, when the rows
+  // are scanned in several ranges by a skip scan or through a secondary
+  // index. Otherwise 'upper_bound_idx_'.
+  rowid_t range_end_idx_;
+
+  // Skip scan state; see InitSkipScan(). Ranges are scanned while
+  // 'skip_scan_iter_' is set.
+  //
+  // 'skip_scan_iter_' reads the first key column, and 'skip_scan_prefix_'
+  // holds the encoding of its value in the current range. 'skip_scan_lower_'
+  // and 'skip_scan_upper_' hold the encodings of the bounds of the predicate
+  // on the second key column, as key suffixes. 'skip_scan_upper_' is empty if
+  // there's no upper bound, or if the predicate is an equality predicate, in
+  // which case 'skip_scan_equality_' is set.
+  gscoped_ptr<cfile::CFileIterator> skip_scan_iter_;
+  std::string skip_scan_prefix_;
+  std::string skip_scan_lower_;
+  std::string skip_scan_upper_;
+  bool skip_scan_equality_;
+
+  // The number of distinct values of the first key column the skip scan has
+  // visited, and the number past which it gives up and scans the remaining
+  // rows sequentially, since seeking per value then costs more than reading
+  // the rows.
+  int64_t skip_scan_num_prefixes_;
+  int64_t skip_scan_max_prefixes_;
+
+  // See set_secondary_index_col_ids().
+  std::vector<ColumnId> secondary_index_col_ids_;
+
+  // See set_bloom_filter_col_ids().
+  std::vector<ColumnId> bloom_filter_col_ids_;
+
+  // Secondary index scan state; see InitSecondaryIndexScan(). The ranges of
+  // rows to scan, and the index of the next one to scan.
+  std::vector<std::pair<rowid_t, rowid_t>> index_ranges_;
+  size_t next_index_range_;
 };
 
 } // namespace tablet
@@ -20,6 +20,7 @@
 #include <cstdio>
 #include <cstdlib>
 #include <memory>
+#include <mutex>
 #include <numeric>
 #include <ostream>
 #include <string>
@@ -33,6 +34,7 @@
 
 #include "kudu/clock/logical_clock.h"
 #include "kudu/common/common.pb.h"
+#include "kudu/common/encoded_key.h"
 #include "kudu/common/partial_row.h"
 #include "kudu/common/row.h"
 #include "kudu/common/row_changelist.h"
@@ -87,9 +89,13 @@ DEFINE_int32(merge_benchmark_num_rows_per_rowset, 500000,
              "Number of rowsets as input to the merge");
 
 DECLARE_string(block_manager);
+DECLARE_int32(tablet_column_writer_threads);
+DECLARE_int32(tablet_compaction_max_partitions);
+DECLARE_int32(tablet_compaction_min_partition_size_mb);
 
 using std::shared_ptr;
 using std::string;
+using std::unique_ptr;
 using std::vector;
 
 namespace kudu {
@@ -537,6 +543,45 @@ TEST_F(TestCompaction, TestFlushMRSWithRolling) {
             rows[1]);
 }
 
+// Tests that flushing with the columns written by worker threads yields the
+// same rows as flushing with them written inline, and still rolls.
+TEST_F(TestCompaction, TestFlushMRSWithColumnWriterThreads) {
+  shared_ptr<MemRowSet> mrs;
+  ASSERT_OK(MemRowSet::Create(0, schema_, log_anchor_registry_.get(),
+                              mem_trackers_.tablet_tracker, &mrs));
+  InsertRows(mrs.get(), 10000, 0);
+
+  vector<string> expected;
+  {
+    shared_ptr<DiskRowSet> rs;
+    FlushMRSAndReopenNoRoll(*mrs, schema_, &rs);
+    ASSERT_NO_FATAL_FAILURE();
+    rs->DebugDump(&expected);
+  }
+  ASSERT_EQ(10000, expected.size());
+
+  FLAGS_tablet_column_writer_threads = 4;
+  vector<string> rows;
+  {
+    shared_ptr<DiskRowSet> rs;
+    FlushMRSAndReopenNoRoll(*mrs, schema_, &rs);
+    ASSERT_NO_FATAL_FAILURE();
+    rs->DebugDump(&rows);
+  }
+  ASSERT_EQ(expected, rows);
+
+  vector<shared_ptr<DiskRowSet>> rowsets;
+  FlushMRSAndReopen(*mrs, schema_, kSmallRollThreshold, &rowsets);
+  ASSERT_GT(rowsets.size(), 1);
+  rows.clear();
+  for (const shared_ptr<DiskRowSet>& rs : rowsets) {
+    vector<string> rs_rows;
+    rs->DebugDump(&rs_rows);
+    rows.insert(rows.end(), rs_rows.begin(), rs_rows.end());
+  }
+  ASSERT_EQ(expected.size(), rows.size());
+}
+
 TEST_F(TestCompaction, TestRowSetInput) {
   // Create a memrowset with a bunch of rows, flush and reopen.
   shared_ptr<DiskRowSet> rs;
@@ -575,6 +620,86 @@ TEST_F(TestCompaction, TestRowSetInput) {
             out[9]);
 }
 
+// Tests that the key ranges chosen by RowSetsInCompaction::SplitKeyRange()
+// partition the compaction input: together the bounded inputs yield exactly
+// the rows of the whole input, in the same order.
+TEST_F(TestCompaction, TestKeyRangePartitionedInput) {
+  const int kNumRowSets = 3;
+  const int kRowsPerRowSet = 1000;
+  const int kNumRanges = 4;
+
+  // Create overlapping rowsets, the i-th of which holds the keys ending in i.
+  vector<shared_ptr<DiskRowSet>> rowsets;
+  for (int i = 0; i < kNumRowSets; i++) {
+    shared_ptr<MemRowSet> mrs;
+    ASSERT_OK(MemRowSet::Create(i, schema_, log_anchor_registry_.get(),
+                                mem_trackers_.tablet_tracker, &mrs));
+    InsertRows(mrs.get(), kRowsPerRowSet, i);
+    shared_ptr<DiskRowSet> rs;
+    FlushMRSAndReopenNoRoll(*mrs, schema_, &rs);
+    ASSERT_NO_FATAL_FAILURE();
+    UpdateRows(rs.get(), kRowsPerRowSet / 2, i, 1);
+    rowsets.push_back(rs);
+  }
+
+  RowSetsInCompaction input;
+  for (const shared_ptr<DiskRowSet>& rs : rowsets) {
+    std::unique_lock<std::mutex> lock(*rs->compact_flush_lock());
+    input.AddRowSet(rs, std::move(lock));
+  }
+
+  MvccSnapshot snap(mvcc_);
+  vector<string> expected;
+  {
+    shared_ptr<CompactionInput> ci;
+    ASSERT_OK(input.CreateCompactionInput(snap, &schema_, &ci));
+    IterateInput(ci.get(), &expected);
+  }
+  ASSERT_EQ(kNumRowSets * kRowsPerRowSet, expected.size());
+
+  vector<string> split_keys;
+  ASSERT_OK(input.SplitKeyRange(kNumRanges, &split_keys));
+  ASSERT_EQ(kNumRanges - 1, split_keys.size());
+  for (int i = 1; i < split_keys.size(); i++) {
+    ASSERT_LT(split_keys[i - 1], split_keys[i]);
+  }
+
+  vector<unique_ptr<EncodedKey>> bounds;
+  for (const string& key : split_keys) {
+    gscoped_ptr<EncodedKey> bound;
+    ASSERT_OK(EncodedKey::DecodeEncodedString(schema_, &arena_, key, &bound));
+    bounds.emplace_back(bound.release());
+  }
+
+  // The position of a row within its block depends on how the input is
+  // divided into blocks, so compare the rows without it.
+  auto strip_idx = [](const string& row) {
+    return row.substr(row.find("; ") + 2);
+  };
+  vector<string> actual;
+  for (int i = 0; i <= bounds.size(); i++) {
+    shared_ptr<CompactionInput> ci;
+    ASSERT_OK(input.CreateCompactionInput(snap, &schema_,
+                                          i == 0 ? nullptr : bounds[i - 1].get(),
+                                          i == bounds.size() ? nullptr : bounds[i].get(),
+                                          &ci));
+    vector<string> out;
+    IterateInput(ci.get(), &out);
+    LOG(INFO) << Substitute("Key range $0 has $1 rows", i, out.size());
+
+    // The ranges are chosen from samples, so they're only roughly even.
+    ASSERT_GT(out.size(), expected.size() / kNumRanges / 2);
+    ASSERT_LT(out.size(), expected.size() / kNumRanges * 2);
+    for (const string& row : out) {
+      actual.push_back(strip_idx(row));
+    }
+  }
+  ASSERT_EQ(expected.size(), actual.size());
+  for (int i = 0; i < expected.size(); i++) {
+    ASSERT_EQ(strip_idx(expected[i]), actual[i]);
+  }
+}
+
 // Tests that the same rows, duplicated in three DRSs, ghost in two of them
 // appears only once on the compaction output but that the resulting row
 // includes reinserts for the ghost and all its mutations.
@@ -1104,6 +1229,43 @@ TEST_F(TestCompaction, TestCompactionFreesDiskSpace) {
   }
 }
 
+// Tests that a compaction split into key ranges compacted in parallel yields
+// the same rows as the compaction's input.
+TEST_F(TestCompaction, TestParallelCompaction) {
+  FLAGS_tablet_compaction_max_partitions = 4;
+  FLAGS_tablet_compaction_min_partition_size_mb = 0;
+  {
+    LocalTabletWriter writer(tablet().get(), &client_schema());
+    KuduPartialRow row(&client_schema());
+    for (int i = 0; i < 3; i++) {
+      for (int j = 0; j < 1000; j++) {
+        int val = j * 3 + i;
+        ASSERT_OK(row.SetStringCopy("key", Substitute("hello $0", val)));
+        ASSERT_OK(row.SetInt32("val", val));
+        ASSERT_OK(writer.Insert(row));
+      }
+      ASSERT_OK(tablet()->Flush());
+    }
+    // Update some of the rows so that the compaction has deltas to rewrite.
+    for (int val = 0; val < 3000; val += 7) {
+      ASSERT_OK(row.SetStringCopy("key", Substitute("hello $0", val)));
+      ASSERT_OK(row.SetInt32("val", -val));
+      ASSERT_OK(writer.Update(row));
+    }
+  }
+
+  vector<string> before;
+  ASSERT_OK(DumpTablet(*tablet(), client_schema(), &before));
+  ASSERT_EQ(3000, before.size());
+
+  ASSERT_OK(tablet()->Compact(Tablet::FORCE_COMPACT_ALL));
+  ASSERT_GT(tablet()->num_rowsets(), 1);
+
+  vector<string> after;
+  ASSERT_OK(DumpTablet(*tablet(), client_schema(), &after));
+  ASSERT_EQ(before, after);
+}
+
 // Regression test for KUDU-1237, a bug in which empty flushes or compactions
 // would result in orphaning near-empty cfile blocks on the disk.
 TEST_F(TestCompaction, TestEmptyFlushDoesntLeakBlocks) {
@@ -24,12 +24,15 @@
 #include <ostream>
 #include <string>
 #include <type_traits>
+#include <utility>
 #include <unordered_set>
 #include <vector>
 
+#include <gflags/gflags_declare.h>
 #include <glog/logging.h>
 
 #include "kudu/clock/hybrid_clock.h"
+#include "kudu/common/encoded_key.h"
 #include "kudu/common/generic_iterators.h"
 #include "kudu/common/iterator.h"
 #include "kudu/common/row.h"
@@ -57,9 +60,11 @@
 #include "kudu/util/debug/trace_event.h"
 #include "kudu/util/faststring.h"
 #include "kudu/util/memory/arena.h"
+#include "kudu/util/slice.h"
 
 using kudu::clock::HybridClock;
 using std::deque;
+using std::pair;
 using std::shared_ptr;
 using std::string;
 using std::unique_ptr;
@@ -67,6 +72,8 @@ using std::unordered_set;
 using std::vector;
 using strings::Substitute;
 
+DECLARE_bool(tablet_compaction_bypass_page_cache);
+
 namespace kudu {
 namespace tablet {
 
@@ -193,12 +200,21 @@ class MemRowSetCompactionInput : public CompactionInput {
 // CompactionInput yielding rows and mutations from an on-disk DiskRowSet.
 class DiskRowSetCompactionInput : public CompactionInput {
  public:
+  // 'base_cfile_iter' is the iterator over the base data which 'base_iter'
+  // materializes. If 'lower_bound' or 'upper_bound' are non-null, only the
+  // rows within ['lower_bound', 'upper_bound') are yielded.
   DiskRowSetCompactionInput(gscoped_ptr<RowwiseIterator> base_iter,
+                            const CFileSet::Iterator* base_cfile_iter,
                             unique_ptr<DeltaIterator> redo_delta_iter,
-                            unique_ptr<DeltaIterator> undo_delta_iter)
+                            unique_ptr<DeltaIterator> undo_delta_iter,
+                            const EncodedKey* lower_bound,
+                            const EncodedKey* upper_bound)
       : base_iter_(std::move(base_iter)),
+        base_cfile_iter_(base_cfile_iter),
         redo_delta_iter_(std::move(redo_delta_iter)),
         undo_delta_iter_(std::move(undo_delta_iter)),
+        lower_bound_(lower_bound),
+        upper_bound_(upper_bound),
         arena_(32 * 1024),
         block_(base_iter_->schema(), kRowsPerBlock, &arena_),
         redo_mutation_block_(kRowsPerBlock, static_cast<Mutation *>(nullptr)),
@@ -208,11 +224,22 @@ class DiskRowSetCompactionInput : public CompactionInput {
   Status Init() override {
     ScanSpec spec;
     spec.set_cache_blocks(false);
+    spec.set_cache_pages(!FLAGS_tablet_compaction_bypass_page_cache);
+    if (lower_bound_) {
+      spec.SetLowerBoundKey(lower_bound_);
+    }
+    if (upper_bound_) {
+      spec.SetExclusiveUpperBoundKey(upper_bound_);
+    }
     RETURN_NOT_OK(base_iter_->Init(&spec));
+
+    // The key bounds were pushed down into a range of row ordinals; the
+    // deltas must start from the first row in that range.
+    first_rowid_in_block_ = base_cfile_iter_->cur_ordinal_idx();
     RETURN_NOT_OK(redo_delta_iter_->Init(&spec));
-    RETURN_NOT_OK(redo_delta_iter_->SeekToOrdinal(0));
+    RETURN_NOT_OK(redo_delta_iter_->SeekToOrdinal(first_rowid_in_block_));
     RETURN_NOT_OK(undo_delta_iter_->Init(&spec));
-    RETURN_NOT_OK(undo_delta_iter_->SeekToOrdinal(0));
+    RETURN_NOT_OK(undo_delta_iter_->SeekToOrdinal(first_rowid_in_block_));
     return Status::OK();
   }
 
@@ -260,9 +287,13 @@ class DiskRowSetCompactionInput : public CompactionInput {
  private:
   DISALLOW_COPY_AND_ASSIGN(DiskRowSetCompactionInput);
   gscoped_ptr<RowwiseIterator> base_iter_;
+  const CFileSet::Iterator* base_cfile_iter_;
   unique_ptr<DeltaIterator> redo_delta_iter_;
   unique_ptr<DeltaIterator> undo_delta_iter_;
 
+  const EncodedKey* lower_bound_;
+  const EncodedKey* upper_bound_;
+
   Arena arena_;
 
   // The current block of data which has come from the input iterator
@@ -840,9 +871,19 @@ Status CompactionInput::Create(const DiskRowSet &rowset,
                                const Schema* projection,
                                const MvccSnapshot &snap,
                                gscoped_ptr<CompactionInput>* out) {
+  return Create(rowset, projection, snap, nullptr, nullptr, out);
+}
+
+Status CompactionInput::Create(const DiskRowSet &rowset,
+                               const Schema* projection,
+                               const MvccSnapshot &snap,
+                               const EncodedKey* lower_bound,
+                               const EncodedKey* upper_bound,
+                               gscoped_ptr<CompactionInput>* out) {
   CHECK(projection->has_column_ids());
 
-  shared_ptr<ColumnwiseIterator> base_cwise(rowset.base_data_->NewIterator(projection));
+  CFileSet::Iterator* base_cfile_iter = rowset.base_data_->NewIterator(projection);
+  shared_ptr<ColumnwiseIterator> base_cwise(base_cfile_iter);
   gscoped_ptr<RowwiseIterator> base_iter(new MaterializingIterator(base_cwise));
 
   // Creates a DeltaIteratorMerger that will only include the relevant REDO deltas.
@@ -857,8 +898,11 @@ Status CompactionInput::Create(const DiskRowSet &rowset,
       DeltaTracker::UNDOS_ONLY, &undo_deltas), "Could not open UNDOs");
 
   out->reset(new DiskRowSetCompactionInput(std::move(base_iter),
+                                           base_cfile_iter,
                                            std::move(redo_deltas),
-                                           std::move(undo_deltas)));
+                                           std::move(undo_deltas),
+                                           lower_bound,
+                                           upper_bound));
   return Status::OK();
 }
 
@@ -899,6 +943,87 @@ Status RowSetsInCompaction::CreateCompactionInput(const MvccSnapshot &snap,
   return Status::OK();
 }
 
+Status RowSetsInCompaction::CreateCompactionInput(const MvccSnapshot &snap,
+                                                  const Schema* schema,
+                                                  const EncodedKey* lower_bound,
+                                                  const EncodedKey* upper_bound,
+                                                  shared_ptr<CompactionInput> *out) const {
+  CHECK(schema->has_column_ids());
+
+  vector<shared_ptr<CompactionInput> > inputs;
+  for (const shared_ptr<RowSet> &rs : rowsets_) {
+    string min_key;
+    string max_key;
+    RETURN_NOT_OK(rs->GetBounds(&min_key, &max_key));
+    if ((lower_bound && Slice(max_key).compare(lower_bound->encoded_key()) < 0) ||
+        (upper_bound && Slice(min_key).compare(upper_bound->encoded_key()) >= 0)) {
+      continue;
+    }
+    gscoped_ptr<CompactionInput> input;
+    RETURN_NOT_OK_PREPEND(CompactionInput::Create(*down_cast<DiskRowSet*>(rs.get()),
+                                                  schema, snap, lower_bound, upper_bound,
+                                                  &input),
+                          Substitute("Could not create compaction input for rowset $0",
+                                     rs->ToString()));
+    inputs.push_back(shared_ptr<CompactionInput>(input.release()));
+  }
+
+  if (inputs.size() == 1) {
+    out->swap(inputs[0]);
+  } else {
+    out->reset(CompactionInput::Merge(inputs, schema));
+  }
+
+  return Status::OK();
+}
+
+Status RowSetsInCompaction::SplitKeyRange(int num_ranges, vector<string>* split_keys) const {
+  // The number of keys sampled from each rowset per requested range. More
+  // samples even out the ranges better, at the cost of more index lookups.
+  const int kSamplesPerRange = 8;
+
+  split_keys->clear();
+  if (num_ranges <= 1) {
+    return Status::OK();
+  }
+
+  // Each sampled key stands for the rows of its rowset from that key up to
+  // the next sampled key.
+  vector<pair<string, double>> samples;
+  double total_rows = 0;
+  for (const shared_ptr<RowSet> &rs : rowsets_) {
+    const DiskRowSet* drs = down_cast<DiskRowSet*>(rs.get());
+    rowid_t num_rows;
+    RETURN_NOT_OK(drs->CountRows(&num_rows));
+    vector<string> keys;
+    RETURN_NOT_OK(drs->SampleKeys(num_ranges * kSamplesPerRange, &keys));
+    if (keys.empty()) {
+      continue;
+    }
+    const double rows_per_key = static_cast<double>(num_rows) / keys.size();
+    for (string& key : keys) {
+      samples.emplace_back(std::move(key), rows_per_key);
+    }
+    total_rows += num_rows;
+  }
+  std::sort(samples.begin(), samples.end());
+
+  // Split before the first sample at which the rows with smaller keys reach
+  // the next multiple of the target range size.
+  double rows_before = 0;
+  for (const auto& sample : samples) {
+    if (split_keys->size() == num_ranges - 1) {
+      break;
+    }
+    if (rows_before >= total_rows * (split_keys->size() + 1) / num_ranges &&
+        (split_keys->empty() || split_keys->back() < sample.first)) {
+      split_keys->push_back(sample.first);
+    }
+    rows_before += sample.second;
+  }
+  return Status::OK();
+}
+
 void RowSetsInCompaction::DumpToLog() const {
   LOG(INFO) << "Selected " << rowsets_.size() << " rowsets to compact:";
   // Dump the selected rowsets to the log, and collect corresponding iterators.
@@ -1074,6 +1199,77 @@ Status ApplyMutationsAndGenerateUndos(const MvccSnapshot& snap,
   #undef ERROR_LOG_CONTEXT
 }
 
+namespace {
+
+// Returns true if 'row', which holds the state of a row as of a compaction's
+// snapshot, expired before the ancient history mark and has no retained
+// history: 'undo_head' and 'redo_head' are the row's mutations as returned by
+// RemoveAncientUndos(). Like a row deleted before the ancient history mark,
+// such a row isn't visible to any scan and can be removed from disk.
+bool IsExpiredBeforeAncientHistory(const HistoryGcOpts& history_gc_opts,
+                                   const RowBlockRow& row,
+                                   const Mutation* undo_head,
+                                   const Mutation* redo_head) {
+  if (!history_gc_opts.ttl_enabled() || undo_head != nullptr || redo_head != nullptr) {
+    return false;
+  }
+  const Schema* schema = row.schema();
+  int col_idx = schema->find_column_by_id(history_gc_opts.ttl_col_id());
+  if (col_idx == Schema::kColumnNotFound ||
+      (schema->column(col_idx).is_nullable() && row.is_null(col_idx))) {
+    return false;
+  }
+  int64_t ttl_col_micros = *reinterpret_cast<const int64_t*>(row.cell_ptr(col_idx));
+  return history_gc_opts.IsExpiredBeforeAncientHistory(ttl_col_micros);
+}
+
+// Copies the base row of 'input_row' into 'dst_row' and applies the row's
+// history as of 'snap', collecting its new UNDO and REDO mutations and
+// removing the ancient UNDOs. Sets 'is_garbage_collected' to true if the row
+// should be removed from disk altogether.
+//
+// Shared by both passes of a compaction, so that they agree on which rows
+// were removed.
+Status ApplyRowHistory(const MvccSnapshot& snap,
+                       const HistoryGcOpts& history_gc_opts,
+                       CompactionInputRow* input_row,
+                       Arena* arena,
+                       RowBlockRow* dst_row,
+                       Mutation** new_undos_head,
+                       Mutation** new_redos_head,
+                       bool* is_garbage_collected) {
+  RETURN_NOT_OK(CopyRow(input_row->row, dst_row, static_cast<Arena*>(nullptr)));
+
+  DVLOG(4) << "Input Row: " << CompactionInputRowToString(*input_row);
+
+  // Collect the new UNDO/REDO mutations.
+  *new_undos_head = nullptr;
+  *new_redos_head = nullptr;
+  RETURN_NOT_OK(ApplyMutationsAndGenerateUndos(snap,
+                                               *input_row,
+                                               new_undos_head,
+                                               new_redos_head,
+                                               arena,
+                                               dst_row));
+
+  // Merge the histories of 'input_row' with previous ghosts, if there are any.
+  RETURN_NOT_OK(MergeDuplicatedRowHistory(input_row, new_undos_head, arena));
+
+  // Remove ancient UNDOS and check whether the row should be garbage collected,
+  // either because it was deleted or because it expired before the AHM.
+  RemoveAncientUndos(history_gc_opts,
+                     new_undos_head,
+                     *new_redos_head,
+                     is_garbage_collected);
+  if (!*is_garbage_collected) {
+    *is_garbage_collected = IsExpiredBeforeAncientHistory(
+        history_gc_opts, *dst_row, *new_undos_head, *new_redos_head);
+  }
+  return Status::OK();
+}
+
+} // anonymous namespace
+
 Status FlushCompactionInput(CompactionInput* input,
                             const MvccSnapshot& snap,
                             const HistoryGcOpts& history_gc_opts,
@@ -1098,32 +1294,17 @@ Status FlushCompactionInput(CompactionInput* input,
       DCHECK(schema->has_column_ids());
 
       RowBlockRow dst_row = block.row(n);
-      RETURN_NOT_OK(CopyRow(input_row->row, &dst_row, static_cast<Arena*>(nullptr)));
-
-      DVLOG(4) << "Input Row: " << CompactionInputRowToString(*input_row);
-
-      // Collect the new UNDO/REDO mutations.
-      Mutation* new_undos_head = nullptr;
-      Mutation* new_redos_head = nullptr;
-
-      RETURN_NOT_OK(ApplyMutationsAndGenerateUndos(snap,
-                                                   *input_row,
-                                                   &new_undos_head,
-                                                   &new_redos_head,
-                                                   input->PreparedBlockArena(),
-                                                   &dst_row));
-
-      // Merge the histories of 'input_row' with previous ghosts, if there are any.
-      RETURN_NOT_OK(MergeDuplicatedRowHistory(input_row,
-                                              &new_undos_head,
-                                              input->PreparedBlockArena()));
-
-      // Remove ancient UNDOS and check whether the row should be garbage collected.
+      Mutation* new_undos_head;
+      Mutation* new_redos_head;
       bool is_garbage_collected;
-      RemoveAncientUndos(history_gc_opts,
-                         &new_undos_head,
-                         new_redos_head,
-                         &is_garbage_collected);
+      RETURN_NOT_OK(ApplyRowHistory(snap,
+                                    history_gc_opts,
+                                    input_row,
+                                    input->PreparedBlockArena(),
+                                    &dst_row,
+                                    &new_undos_head,
+                                    &new_redos_head,
+                                    &is_garbage_collected));
 
       DVLOG(4) << "Output Row: " << RowToString(dst_row, new_redos_head, new_undos_head) <<
           "; Was garbage collected? " << is_garbage_collected;
@@ -1205,13 +1386,43 @@ Status ReupdateMissedDeltas(const string &tablet_name,
   RETURN_NOT_OK(key_projector.Init());
   faststring buf;
 
+  // Rows which expired before the AHM can't be told apart by their REDOs
+  // alone, so if they may have been removed by the first pass, replay the
+  // history of each row the way FlushCompactionInput() did.
+  unique_ptr<RowBlock> replay_block;
+  if (history_gc_opts.ttl_enabled()) {
+    replay_block.reset(new RowBlock(*schema, 1, nullptr));
+  }
+
   rowid_t output_row_offset = 0;
   while (input->HasMoreBlocks()) {
     RETURN_NOT_OK(input->PrepareBlock(&rows));
 
-    for (const CompactionInputRow &row : rows) {
+    for (CompactionInputRow& row : rows) {
       DVLOG(4) << "Revisiting row: " << CompactionInputRowToString(row);
 
+      if (replay_block) {
+        RowBlockRow replay_row = replay_block->row(0);
+        Mutation* undos_head;
+        Mutation* redos_head;
+        bool was_garbage_collected;
+        RETURN_NOT_OK(ApplyRowHistory(snap_to_exclude,
+                                      history_gc_opts,
+                                      &row,
+                                      input->PreparedBlockArena(),
+                                      &replay_row,
+                                      &undos_head,
+                                      &redos_head,
+                                      &was_garbage_collected));
+        if (was_garbage_collected) {
+          // Any mutations the row missed can be dropped along with it, and
+          // the row doesn't take up an output row offset.
+          DVLOG(4) << "Skipping GCed input row: " << schema->DebugRow(row.row)
+                   << " while reupdating missed deltas";
+          continue;
+        }
+      }
+
       bool is_garbage_collected = false;
       for (const Mutation *mut = row.redo_head;
            mut != nullptr;
@@ -18,6 +18,7 @@
 #define KUDU_TABLET_COMPACTION_H
 
 #include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -27,6 +28,7 @@
 #include <glog/logging.h>
 
 #include "kudu/common/rowblock.h"
+#include "kudu/common/schema.h"
 #include "kudu/common/timestamp.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/tablet/rowset.h"
@@ -35,6 +37,7 @@
 namespace kudu {
 
 class Arena;
+class EncodedKey;
 class Schema;
 
 namespace tablet {
@@ -50,11 +53,21 @@ struct CompactionInputRow;
 class HistoryGcOpts {
  public:
   static HistoryGcOpts Enabled(Timestamp ahm) {
-    return HistoryGcOpts(true, ahm);
+    return HistoryGcOpts(true, ahm, false, ColumnId(), 0);
   }
 
   static HistoryGcOpts Disabled() {
-    return HistoryGcOpts(false, Timestamp(0));
+    return HistoryGcOpts(false, Timestamp(0), false, ColumnId(), 0);
+  }
+
+  // Returns a copy of these options under which rows which expired before the
+  // ancient history mark are also garbage-collected: rows whose time-to-live
+  // column, 'ttl_col_id', holds a value lower than 'ttl_cutoff_micros'.
+  //
+  // Has no effect if GC is disabled.
+  HistoryGcOpts WithTimeToLive(ColumnId ttl_col_id, int64_t ttl_cutoff_micros) const {
+    return HistoryGcOpts(gc_enabled_, ancient_history_mark_, true,
+                         ttl_col_id, ttl_cutoff_micros);
   }
 
   // Returns true if Timestamp 't' is considered "ancient history" and is
@@ -74,10 +87,39 @@ class HistoryGcOpts {
     return ancient_history_mark_;
   }
 
+  // Returns true if rows which expired before the ancient history mark are
+  // garbage-collected.
+  bool ttl_enabled() const {
+    return gc_enabled_ && ttl_enabled_;
+  }
+
+  // Returns the ID of the time-to-live column. Only valid if ttl_enabled().
+  ColumnId ttl_col_id() const {
+    DCHECK(ttl_enabled());
+    return ttl_col_id_;
+  }
+
+  // Returns true if a row whose time-to-live column holds 'ttl_col_micros'
+  // expired before the ancient history mark.
+  bool IsExpiredBeforeAncientHistory(int64_t ttl_col_micros) const {
+    return ttl_enabled() && ttl_col_micros < ttl_cutoff_micros_;
+  }
+
+  // Returns the lowest value of the time-to-live column of rows which hadn't
+  // expired yet as of the ancient history mark. Only valid if ttl_enabled().
+  int64_t ttl_cutoff_micros() const {
+    DCHECK(ttl_enabled());
+    return ttl_cutoff_micros_;
+  }
+
  private:
-  HistoryGcOpts(bool gc_enabled, Timestamp ahm)
+  HistoryGcOpts(bool gc_enabled, Timestamp ahm, bool ttl_enabled,
+                ColumnId ttl_col_id, int64_t ttl_cutoff_micros)
       : gc_enabled_(gc_enabled),
-        ancient_history_mark_(ahm) {
+        ancient_history_mark_(ahm),
+        ttl_enabled_(ttl_enabled),
+        ttl_col_id_(ttl_col_id),
+        ttl_cutoff_micros_(ttl_cutoff_micros) {
   }
 
   // Whether historical records prior to the ancient history mark should be
@@ -87,6 +129,15 @@ class HistoryGcOpts {
   // A timestamp prior to which no history will be preserved.
   // Ignored if 'enabled' != GC_ENABLED.
   const Timestamp ancient_history_mark_;
+
+  // Whether rows which expired before the ancient history mark should be
+  // garbage-collected.
+  const bool ttl_enabled_;
+
+  // The time-to-live column, and the value of that column below which a row
+  // had expired as of the ancient history mark. Ignored unless 'ttl_enabled_'.
+  const ColumnId ttl_col_id_;
+  const int64_t ttl_cutoff_micros_;
 };
 
 // Interface for an input feeding into a compaction or flush.
@@ -106,6 +157,17 @@ class CompactionInput {
                        const MvccSnapshot &snap,
                        gscoped_ptr<CompactionInput>* out);
 
+  // Like the above, but only yields the rows whose keys fall within
+  // ['lower_bound', 'upper_bound'). Either bound may be null, meaning the
+  // range is unbounded on that side. The bounds must remain valid for the
+  // lifetime of the returned input.
+  static Status Create(const DiskRowSet &rowset,
+                       const Schema* projection,
+                       const MvccSnapshot &snap,
+                       const EncodedKey* lower_bound,
+                       const EncodedKey* upper_bound,
+                       gscoped_ptr<CompactionInput>* out);
+
   // Create an input which reads from the given memrowset, yielding base rows and updates
   // prior to the given snapshot.
   static CompactionInput *Create(const MemRowSet &memrowset,
@@ -153,6 +215,26 @@ class RowSetsInCompaction {
                                const Schema* schema,
                                std::shared_ptr<CompactionInput> *out) const;
 
+  // Like the above, but only yields the rows whose keys fall within
+  // ['lower_bound', 'upper_bound'), skipping the rowsets which can't contain
+  // any. Either bound may be null. All of the rowsets must be DiskRowSets.
+  //
+  // The bounds must remain valid for the lifetime of the returned input.
+  Status CreateCompactionInput(const MvccSnapshot &snap,
+                               const Schema* schema,
+                               const EncodedKey* lower_bound,
+                               const EncodedKey* upper_bound,
+                               std::shared_ptr<CompactionInput> *out) const;
+
+  // Chooses up to 'num_ranges - 1' encoded keys, in increasing order, which
+  // split the rows of the rowsets into key ranges of roughly equal size. The
+  // ranges may be compacted independently: every version of a row falls into
+  // the same range.
+  //
+  // The ranges' sizes are estimated from keys sampled from each rowset's key
+  // index. All of the rowsets must be DiskRowSets.
+  Status SplitKeyRange(int num_ranges, std::vector<std::string>* split_keys) const;
+
   // Dump a log message indicating the chosen rowsets.
   void DumpToLog() const;
 
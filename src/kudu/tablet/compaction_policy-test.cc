@@ -22,10 +22,12 @@
 #include <unordered_set>
 #include <vector>
 
+#include <gflags/gflags_declare.h>
 #include <glog/logging.h>
 #include <glog/stl_logging.h>
 #include <gtest/gtest.h>
 
+#include "kudu/gutil/map-util.h"
 #include "kudu/gutil/stringprintf.h"
 #include "kudu/gutil/strings/numbers.h"
 #include "kudu/gutil/strings/split.h"
@@ -42,10 +44,14 @@
 #include "kudu/util/test_macros.h"
 #include "kudu/util/test_util.h"
 
+using std::shared_ptr;
 using std::unordered_set;
 using std::string;
 using std::vector;
 
+DECLARE_double(compaction_access_weight);
+DECLARE_int32(compaction_max_exact_solves);
+
 namespace kudu {
 namespace tablet {
 
@@ -142,6 +148,110 @@ TEST_F(TestCompactionPolicy, TestSignificantOverlap) {
   ASSERT_EQ(picked.size(), kBudgetMb);
 }
 
+// Test that, for the same compaction budget, the policy prefers compacting
+// the overlapping rowsets of a hot key range over those of a cold key range
+// which would otherwise yield a bigger reduction in average height.
+TEST_F(TestCompactionPolicy, TestPrefersHotKeyRanges) {
+  vector<shared_ptr<MockDiskRowSet>> cold;
+  vector<shared_ptr<MockDiskRowSet>> hot;
+  RowSetVector vec;
+  for (int i = 0; i < 3; i++) {
+    cold.push_back(std::make_shared<MockDiskRowSet>("c0000", "c9999"));
+    vec.push_back(cold.back());
+  }
+  for (int i = 0; i < 2; i++) {
+    hot.push_back(std::make_shared<MockDiskRowSet>("h0000", "h9999"));
+    vec.push_back(hot.back());
+  }
+
+  // Only one of the two groups fits into the budget. With no accesses
+  // recorded, the cold group wins since it overlaps more.
+  const int kBudgetMb = 3;
+  unordered_set<RowSet*> picked;
+  double quality = 0;
+  NO_FATALS(RunTestCase(vec, kBudgetMb, &picked, &quality));
+  ASSERT_EQ(3, picked.size());
+  for (const auto& rs : cold) {
+    ASSERT_TRUE(ContainsKey(picked, rs.get()));
+  }
+
+  // Once the hot group's rowsets serve all the accesses, it wins instead.
+  for (const auto& rs : hot) {
+    rs->set_access_count(100000);
+  }
+  picked.clear();
+  NO_FATALS(RunTestCase(vec, kBudgetMb, &picked, &quality));
+  ASSERT_EQ(2, picked.size());
+  for (const auto& rs : hot) {
+    ASSERT_TRUE(ContainsKey(picked, rs.get()));
+  }
+
+  // Unless access statistics are disabled.
+  FLAGS_compaction_access_weight = 0;
+  picked.clear();
+  NO_FATALS(RunTestCase(vec, kBudgetMb, &picked, &quality));
+  ASSERT_EQ(3, picked.size());
+}
+
+// Benchmark of the repeated polls of a tablet with thousands of small,
+// overlapping rowsets, as left behind by a bulk load. Only the first poll
+// should solve the knapsack problems; the next ones reuse its solution until
+// the rowsets change.
+TEST_F(TestCompactionPolicy, TestRepeatedPollsOfManyRowsets) {
+  const int kNumRowSets = AllowSlowTests() ? 5000 : 1000;
+  RowSetVector vec;
+  for (int i = 0; i < kNumRowSets; i++) {
+    vec.emplace_back(new MockDiskRowSet(
+        StringPrintf("%010d", i * 10000),
+        StringPrintf("%010d", (i + 5) * 10000)));
+  }
+  RowSetTree tree;
+  ASSERT_OK(tree.Reset(vec));
+
+  const int kBudgetMb = 128;
+  BudgetedCompactionPolicy policy(kBudgetMb);
+  unordered_set<RowSet*> first_picked;
+  double first_quality = 0;
+  Stopwatch sw;
+  sw.start();
+  ASSERT_OK(policy.PickRowSets(tree, &first_picked, &first_quality, nullptr));
+  sw.stop();
+  LOG(INFO) << "First poll: " << sw.elapsed().ToString();
+  ASSERT_GT(first_quality, 0);
+  ASSERT_LE(first_picked.size(), kBudgetMb);
+
+  const int kNumPolls = 100;
+  sw.start();
+  for (int i = 0; i < kNumPolls; i++) {
+    unordered_set<RowSet*> picked;
+    double quality = 0;
+    ASSERT_OK(policy.PickRowSets(tree, &picked, &quality, nullptr));
+    ASSERT_EQ(first_picked, picked);
+    ASSERT_DOUBLE_EQ(first_quality, quality);
+  }
+  sw.stop();
+  LOG(INFO) << kNumPolls << " more polls: " << sw.elapsed().ToString();
+
+  // Once the rowsets change, the solution is computed again.
+  vec.emplace_back(new MockDiskRowSet(StringPrintf("%010d", 0),
+                                      StringPrintf("%010d", kNumRowSets * 10000)));
+  ASSERT_OK(tree.Reset(vec));
+  unordered_set<RowSet*> picked;
+  double quality = 0;
+  ASSERT_OK(policy.PickRowSets(tree, &picked, &quality, nullptr));
+  ASSERT_GT(quality, 0);
+  ASSERT_LE(picked.size(), kBudgetMb);
+
+  // Bounding the number of exact solves still yields a solution within the
+  // budget.
+  FLAGS_compaction_max_exact_solves = 1;
+  BudgetedCompactionPolicy bounded_policy(kBudgetMb);
+  picked.clear();
+  ASSERT_OK(bounded_policy.PickRowSets(tree, &picked, &quality, nullptr));
+  ASSERT_GT(quality, 0);
+  ASSERT_LE(picked.size(), kBudgetMb);
+}
+
 // Return the directory of the currently-running executable.
 static string GetExecutableDir() {
   string exec;
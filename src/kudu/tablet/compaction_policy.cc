@@ -18,6 +18,8 @@
 #include "kudu/tablet/compaction_policy.h"
 
 #include <algorithm>
+#include <cmath>
+#include <numeric>
 #include <ostream>
 #include <queue>
 #include <string>
@@ -55,6 +57,22 @@ DEFINE_double(compaction_minimum_improvement, 0.01f,
               "improve the average height of DiskRowSets by at least this amount, the "
               "compaction will be considered ineligible.");
 
+DEFINE_double(compaction_access_weight, 1.0,
+              "How strongly the budgeted compaction policy favors compacting rowsets "
+              "which are frequently probed by writes or read by scans. Each rowset's "
+              "data is weighted by 1 plus this value times its accesses per byte "
+              "relative to the tablet's average, and the compaction's projected gain "
+              "is scaled up for tablets with a high recent access rate. A value of 0 "
+              "ignores access statistics.");
+TAG_FLAG(compaction_access_weight, experimental);
+
+DEFINE_int32(compaction_max_exact_solves, 1000,
+             "The maximum number of exact knapsack problems the budgeted compaction "
+             "policy solves when picking rowsets, most promising first, which bounds "
+             "the time taken by tablets with many overlapping rowsets. 0 means no limit.");
+TAG_FLAG(compaction_max_exact_solves, advanced);
+TAG_FLAG(compaction_max_exact_solves, experimental);
+
 namespace kudu {
 namespace tablet {
 
@@ -77,6 +95,10 @@ namespace tablet {
 // here.
 static const double kSupportAdjust = 1.01;
 
+// How far, in the CDF, the key range of a rowset may move before a cached
+// solution is solved again.
+static const double kCachedCdfTolerance = 0.001;
+
 ////////////////////////////////////////////////////////////
 // BudgetedCompactionPolicy
 ////////////////////////////////////////////////////////////
@@ -302,10 +324,19 @@ void BudgetedCompactionPolicy::RunExact(
     const vector<double>& best_upper_bounds,
     SolutionAndValue* best_solution) {
 
+  // Consider the most promising left-most rowsets first: once a bound is too low,
+  // so are all the remaining ones.
+  vector<int> order(asc_min_key.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+    return best_upper_bounds[a] > best_upper_bounds[b];
+  });
+
   KnapsackSolver<KnapsackTraits> solver;
   vector<const RowSetInfo*> inrange_candidates;
   inrange_candidates.reserve(asc_min_key.size());
-  for (int i = 0; i < asc_min_key.size(); i++) {
+  int num_solves = 0;
+  for (int i : order) {
     const RowSetInfo& cc_a = asc_min_key[i];
     const double upper_bound = best_upper_bounds[i];
 
@@ -317,7 +348,13 @@ void BudgetedCompactionPolicy::RunExact(
     // to just be better than the current solution, but needs to be better by at least
     // the approximation ratio before we bother looking for it.
     if (upper_bound <= best_solution->value * FLAGS_compaction_approximation_ratio) {
-      continue;
+      break;
+    }
+    if (FLAGS_compaction_max_exact_solves > 0 &&
+        num_solves >= FLAGS_compaction_max_exact_solves) {
+      VLOG(1) << "Stopped the exact compaction calculation after " << num_solves
+              << " knapsack problems";
+      break;
     }
 
     inrange_candidates.clear();
@@ -334,6 +371,7 @@ void BudgetedCompactionPolicy::RunExact(
     }
     if (inrange_candidates.empty()) continue;
 
+    num_solves++;
     solver.Reset(size_budget_mb_, &inrange_candidates);
     ab_max = cc_a.cdf_max_key();
 
@@ -363,25 +401,9 @@ void BudgetedCompactionPolicy::RunExact(
   }
 }
 
-// See docs/design-docs/compaction-policy.md for an overview of the compaction
-// policy implemented in this function.
-Status BudgetedCompactionPolicy::PickRowSets(const RowSetTree &tree,
-                                             std::unordered_set<RowSet*>* picked,
-                                             double* quality,
-                                             std::vector<std::string>* log) {
-  vector<RowSetInfo> asc_min_key, asc_max_key;
-  SetupKnapsackInput(tree, &asc_min_key, &asc_max_key);
-  if (asc_max_key.empty()) {
-    if (log) {
-      LOG_STRING(INFO, log) << "No rowsets to compact";
-    }
-    // nothing to compact.
-    return Status::OK();
-  }
-
-  // The best set of rowsets chosen so far, and the value attained by that choice.
-  SolutionAndValue best_solution;
-
+void BudgetedCompactionPolicy::ComputeBestSolution(const vector<RowSetInfo>& asc_min_key,
+                                                   const vector<RowSetInfo>& asc_max_key,
+                                                   SolutionAndValue* best_solution) {
   // The algorithm proceeds in two passes. The first is based on an approximation
   // of the knapsack problem, and computes some upper and lower bounds. The second
   // pass looks again over the input for any cases where the upper bound tells us
@@ -427,17 +449,18 @@ Status BudgetedCompactionPolicy::PickRowSets(const RowSetTree &tree,
   // 2) 'best_solution' and 'best_solution->value': the best approximate solution
   //     found.
   vector<double> best_upper_bounds;
-  RunApproximation(asc_min_key, asc_max_key, &best_upper_bounds, &best_solution);
+  RunApproximation(asc_min_key, asc_max_key, &best_upper_bounds, best_solution);
 
   // If the best solution found above is less than some tiny threshold, we don't
   // need to bother searching for the exact solution, since it could be at most twice
   // the approximate solution.
-  if (best_solution.value * 2 <= FLAGS_compaction_minimum_improvement ||
+  if (best_solution->value * 2 <= FLAGS_compaction_minimum_improvement ||
       *std::max_element(best_upper_bounds.begin(), best_upper_bounds.end()) <=
       FLAGS_compaction_minimum_improvement) {
     VLOG(1) << "Approximation algorithm short-circuited exact compaction calculation";
-    *quality = 0;
-    return Status::OK();
+    best_solution->rowsets.clear();
+    best_solution->value = 0;
+    return;
   }
 
   // Pass 2 (precise)
@@ -446,7 +469,63 @@ Status BudgetedCompactionPolicy::PickRowSets(const RowSetTree &tree,
   // In cases where the upper bound indicates we could do substantially better than
   // our current best solution, we use the exact knapsack solver to find the improved
   // solution.
-  RunExact(asc_min_key, asc_max_key, best_upper_bounds, &best_solution);
+  RunExact(asc_min_key, asc_max_key, best_upper_bounds, best_solution);
+}
+
+bool BudgetedCompactionPolicy::GetCachedSolution(const vector<RowSetInfo>& asc_min_key,
+                                                 SolutionAndValue* best_solution) const {
+  if (cached_input_.size() != asc_min_key.size()) {
+    return false;
+  }
+  for (int i = 0; i < asc_min_key.size(); i++) {
+    const CachedRowSetInput& cached = cached_input_[i];
+    const RowSetInfo& cur = asc_min_key[i];
+    if (cached.rowset != cur.rowset() ||
+        cached.size_mb != cur.size_mb() ||
+        std::fabs(cached.cdf_min_key - cur.cdf_min_key()) > kCachedCdfTolerance ||
+        std::fabs(cached.cdf_max_key - cur.cdf_max_key()) > kCachedCdfTolerance) {
+      return false;
+    }
+  }
+
+  *best_solution = cached_solution_;
+  return true;
+}
+
+void BudgetedCompactionPolicy::CacheSolution(const vector<RowSetInfo>& asc_min_key,
+                                             const SolutionAndValue& solution) {
+  cached_input_.clear();
+  cached_input_.reserve(asc_min_key.size());
+  for (const RowSetInfo& cur : asc_min_key) {
+    cached_input_.push_back({ cur.rowset(), cur.size_mb(), cur.cdf_min_key(), cur.cdf_max_key() });
+  }
+  cached_solution_ = solution;
+}
+
+// See docs/design-docs/compaction-policy.md for an overview of the compaction
+// policy implemented in this function.
+Status BudgetedCompactionPolicy::PickRowSets(const RowSetTree &tree,
+                                             std::unordered_set<RowSet*>* picked,
+                                             double* quality,
+                                             std::vector<std::string>* log) {
+  vector<RowSetInfo> asc_min_key, asc_max_key;
+  SetupKnapsackInput(tree, &asc_min_key, &asc_max_key);
+  if (asc_max_key.empty()) {
+    if (log) {
+      LOG_STRING(INFO, log) << "No rowsets to compact";
+    }
+    // nothing to compact.
+    return Status::OK();
+  }
+
+  // The best set of rowsets chosen, and the value attained by that choice.
+  SolutionAndValue best_solution;
+  if (GetCachedSolution(asc_min_key, &best_solution)) {
+    VLOG(1) << "Reusing the cached compaction selection";
+  } else {
+    ComputeBestSolution(asc_min_key, asc_max_key, &best_solution);
+    CacheSolution(asc_min_key, best_solution);
+  }
 
   // Log the input and output of the selection.
   if (VLOG_IS_ON(1) || log != nullptr) {
@@ -74,6 +74,13 @@ class CompactionPolicy {
 // tries to pick a set of RowSets which fit into that budget and minimize the
 // future cost of operations on the tablet.
 //
+// The solution is cached between calls: as long as the same rowsets are
+// available for compaction with the same sizes, and their key ranges have
+// moved by no more than a small tolerance in the CDF (e.g. because of new
+// accesses), the cached solution is returned instead of solved again. This
+// keeps the maintenance manager's polls of tablets with thousands of rowsets
+// cheap.
+//
 // See src/kudu/tablet/compaction-policy.txt for details.
 class BudgetedCompactionPolicy : public CompactionPolicy {
  public:
@@ -92,6 +99,29 @@ class BudgetedCompactionPolicy : public CompactionPolicy {
     double value = 0;
   };
 
+  // The input of the knapsack problem a solution was computed for.
+  struct CachedRowSetInput {
+    RowSet* rowset;
+    int size_mb;
+    double cdf_min_key;
+    double cdf_max_key;
+  };
+
+  // Runs both passes of the algorithm below, leaving 'best_solution' empty if
+  // no solution improves the tablet by at least the minimum improvement.
+  void ComputeBestSolution(const std::vector<RowSetInfo>& asc_min_key,
+                           const std::vector<RowSetInfo>& asc_max_key,
+                           SolutionAndValue* best_solution);
+
+  // If the cached solution was computed for an input close enough to
+  // 'asc_min_key', sets 'best_solution' to it and returns true.
+  bool GetCachedSolution(const std::vector<RowSetInfo>& asc_min_key,
+                         SolutionAndValue* best_solution) const;
+
+  // Caches 'solution' as the solution for 'asc_min_key'.
+  void CacheSolution(const std::vector<RowSetInfo>& asc_min_key,
+                     const SolutionAndValue& solution);
+
   // Sets up the 'asc_min_key' and 'asc_max_key' vectors necessary
   // for both the approximate and exact solutions below.
   void SetupKnapsackInput(const RowSetTree &tree,
@@ -113,11 +143,13 @@ class BudgetedCompactionPolicy : public CompactionPolicy {
 
   // Runs the second pass of the algorithm.
   //
-  // For each i in asc_min_key, first checks if best_upper_bounds[i] indicates that a
-  // solution containing asc_min_key[i] may be a better solution than the current
-  // 'best_solution' by at least the configured approximation ratio. If so, runs the full
-  // knapsack algorithm to determine the value of that solution and, if it is indeed
-  // better, replaces '*best_solution' with the new best solution.
+  // For each i in asc_min_key, in descending order of best_upper_bounds[i], first
+  // checks if best_upper_bounds[i] indicates that a solution containing asc_min_key[i]
+  // may be a better solution than the current 'best_solution' by at least the
+  // configured approximation ratio. If so, runs the full knapsack algorithm to
+  // determine the value of that solution and, if it is indeed better, replaces
+  // '*best_solution' with the new best solution. At most
+  // --compaction_max_exact_solves knapsack problems are solved.
   void RunExact(
       const std::vector<RowSetInfo>& asc_min_key,
       const std::vector<RowSetInfo>& asc_max_key,
@@ -125,6 +157,11 @@ class BudgetedCompactionPolicy : public CompactionPolicy {
       SolutionAndValue* best_solution);
 
   size_t size_budget_mb_;
+
+  // The input, in ascending min key order, and the solution of the last
+  // problem solved. The solution is empty if nothing was worth compacting.
+  std::vector<CachedRowSetInput> cached_input_;
+  SolutionAndValue cached_solution_;
 };
 
 } // namespace tablet
@@ -316,6 +316,20 @@ size_t FindInSliceArray(const InlineSlice<N, true> *array, ssize_t num_entries,
     return 0;
   }
 
+  // Fast path for append-heavy workloads (e.g. monotonically increasing
+  // keys): if the key sorts at or after the last entry, there's no need
+  // for the binary search, which shortens the time the leaf stays locked
+  // during an insert.
+  int last_compare = array[num_entries - 1].as_slice().compare(key);
+  if (last_compare < 0) {
+    *exact = false;
+    return num_entries;
+  }
+  if (last_compare == 0) {
+    *exact = true;
+    return num_entries - 1;
+  }
+
   size_t left = 0;
   size_t right = num_entries - 1;
 
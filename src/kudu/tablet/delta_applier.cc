@@ -46,7 +46,8 @@ DeltaApplier::DeltaApplier(shared_ptr<CFileSet::Iterator> base_iter,
                            unique_ptr<DeltaIterator> delta_iter)
     : base_iter_(std::move(base_iter)),
       delta_iter_(std::move(delta_iter)),
-      first_prepare_(true) {}
+      first_prepare_(true),
+      next_delta_idx_(0) {}
 
 DeltaApplier::~DeltaApplier() {
 }
@@ -84,12 +85,13 @@ Status DeltaApplier::PrepareBatch(size_t *nrows) {
   // The initial seek is deferred from Init() into the first PrepareBatch()
   // because it requires a loaded delta file, and we don't want to require
   // that at Init() time.
-  if (first_prepare_) {
+  if (first_prepare_ || base_iter_->cur_ordinal_idx() != next_delta_idx_) {
     RETURN_NOT_OK(delta_iter_->SeekToOrdinal(base_iter_->cur_ordinal_idx()));
     first_prepare_ = false;
   }
   RETURN_NOT_OK(base_iter_->PrepareBatch(nrows));
   RETURN_NOT_OK(delta_iter_->PrepareBatch(*nrows, DeltaIterator::PREPARE_FOR_APPLY));
+  next_delta_idx_ = base_iter_->cur_ordinal_idx() + *nrows;
   return Status::OK();
 }
 
@@ -25,6 +25,7 @@
 #include <gtest/gtest_prod.h>
 
 #include "kudu/common/iterator.h"
+#include "kudu/common/rowid.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/port.h"
 #include "kudu/tablet/cfile_set.h"
@@ -86,6 +87,11 @@ class DeltaApplier : public ColumnwiseIterator {
   std::unique_ptr<DeltaIterator> delta_iter_;
 
   bool first_prepare_;
+
+  // The ordinal the delta iterator is positioned at. The base iterator may
+  // skip over rows between batches, in which case the delta iterator must be
+  // seeked along.
+  rowid_t next_delta_idx_;
 };
 
 } // namespace tablet
@@ -17,12 +17,14 @@
 
 #include "kudu/tablet/delta_compaction.h"
 
+#include <algorithm>
 #include <map>
 #include <ostream>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include <gflags/gflags_declare.h>
 #include <glog/logging.h>
 
 #include "kudu/common/generic_iterators.h"
@@ -51,6 +53,8 @@
 
 using std::shared_ptr;
 
+DECLARE_bool(tablet_compaction_bypass_page_cache);
+
 namespace kudu {
 
 using fs::BlockCreationTransaction;
@@ -78,15 +82,19 @@ MajorDeltaCompaction::MajorDeltaCompaction(
     vector<shared_ptr<DeltaStore> > included_stores,
     vector<ColumnId> col_ids,
     HistoryGcOpts history_gc_opts,
-    string tablet_id)
+    string tablet_id,
+    fs::DataDirStorageClass storage_class)
     : fs_manager_(fs_manager),
       base_schema_(base_schema),
       column_ids_(std::move(col_ids)),
       history_gc_opts_(std::move(history_gc_opts)),
+      owns_redo_deltas_(true),
+      redo_col_ids_to_remove_(column_ids_),
       base_data_(base_data),
       included_stores_(std::move(included_stores)),
       delta_iter_(std::move(delta_iter)),
       tablet_id_(std::move(tablet_id)),
+      storage_class_(storage_class),
       redo_delta_mutations_written_(0),
       undo_delta_mutations_written_(0),
       state_(kInitialized) {
@@ -96,6 +104,13 @@ MajorDeltaCompaction::MajorDeltaCompaction(
 MajorDeltaCompaction::~MajorDeltaCompaction() {
 }
 
+void MajorDeltaCompaction::SetColumnGroup(bool owns_redo_deltas, vector<ColumnId> all_col_ids) {
+  CHECK_EQ(state_, kInitialized);
+  owns_redo_deltas_ = owns_redo_deltas;
+  std::sort(all_col_ids.begin(), all_col_ids.end());
+  redo_col_ids_to_remove_ = std::move(all_col_ids);
+}
+
 string MajorDeltaCompaction::ColumnNamesToString() const {
   std::string result;
   for (ColumnId col_id : column_ids_) {
@@ -117,6 +132,7 @@ Status MajorDeltaCompaction::FlushRowSetAndDeltas() {
 
   ScanSpec spec;
   spec.set_cache_blocks(false);
+  spec.set_cache_pages(!FLAGS_tablet_compaction_bypass_page_cache);
   RETURN_NOT_OK_PREPEND(
       old_base_data_rwise->Init(&spec),
       "Unable to open iterator for specified columns (" + partial_schema_.ToString() + ")");
@@ -203,12 +219,18 @@ Status MajorDeltaCompaction::FlushRowSetAndDeltas() {
     // 4) Write the new base data.
     RETURN_NOT_OK(base_data_writer_->AppendBlock(block));
 
+    nrows += n;
+    if (!owns_redo_deltas_) {
+      continue;
+    }
+
     // 5) Remove the columns that we've done our major REDO delta compaction on
     //    from this delta flush, except keep all the delete and reinsert
     //    mutations.
     arena.Reset();
     vector<DeltaKeyAndUpdate> out;
-    RETURN_NOT_OK(delta_iter_->FilterColumnIdsAndCollectDeltas(column_ids_, &out, &arena));
+    RETURN_NOT_OK(delta_iter_->FilterColumnIdsAndCollectDeltas(redo_col_ids_to_remove_,
+                                                               &out, &arena));
 
     // We only create a new redo delta file if we need to.
     if (!out.empty() && !new_redo_delta_writer_) {
@@ -227,11 +249,11 @@ Status MajorDeltaCompaction::FlushRowSetAndDeltas() {
                   "Failed to update stats");
     }
     redo_delta_mutations_written_ += out.size();
-    nrows += n;
   }
 
   BlockManager* bm = fs_manager_->block_manager();
   unique_ptr<BlockCreationTransaction> transaction = bm->NewCreationTransaction();
+  transaction->set_drop_cache_on_commit(FLAGS_tablet_compaction_bypass_page_cache);
   RETURN_NOT_OK(base_data_writer_->FinishAndReleaseBlocks(transaction.get()));
 
   if (redo_delta_mutations_written_ > 0) {
@@ -241,6 +263,7 @@ Status MajorDeltaCompaction::FlushRowSetAndDeltas() {
 
   if (undo_delta_mutations_written_ > 0) {
     new_undo_delta_writer_->WriteDeltaStats(undo_stats);
+    new_undo_delta_timestamps_ = { undo_stats.min_timestamp(), undo_stats.max_timestamp() };
     RETURN_NOT_OK(new_undo_delta_writer_->FinishAndReleaseBlock(transaction.get()));
   }
   transaction->CommitCreatedBlocks();
@@ -262,7 +285,8 @@ Status MajorDeltaCompaction::OpenBaseDataWriter() {
 
   gscoped_ptr<MultiColumnWriter> w(new MultiColumnWriter(fs_manager_,
                                                          &partial_schema_,
-                                                         tablet_id_));
+                                                         tablet_id_,
+                                                         storage_class_));
   RETURN_NOT_OK(w->Open());
   base_data_writer_.swap(w);
   return Status::OK();
@@ -270,7 +294,7 @@ Status MajorDeltaCompaction::OpenBaseDataWriter() {
 
 Status MajorDeltaCompaction::OpenRedoDeltaFileWriter() {
   unique_ptr<WritableBlock> block;
-  CreateBlockOptions opts({ tablet_id_ });
+  CreateBlockOptions opts({ tablet_id_, storage_class_ });
   RETURN_NOT_OK_PREPEND(fs_manager_->CreateNewBlock(opts, &block),
                         "Unable to create REDO delta output block");
   new_redo_delta_block_ = block->id();
@@ -280,7 +304,7 @@ Status MajorDeltaCompaction::OpenRedoDeltaFileWriter() {
 
 Status MajorDeltaCompaction::OpenUndoDeltaFileWriter() {
   unique_ptr<WritableBlock> block;
-  CreateBlockOptions opts({ tablet_id_ });
+  CreateBlockOptions opts({ tablet_id_, storage_class_ });
   RETURN_NOT_OK_PREPEND(fs_manager_->CreateNewBlock(opts, &block),
                         "Unable to create UNDO delta output block");
   new_undo_delta_block_ = block->id();
@@ -317,16 +341,18 @@ void MajorDeltaCompaction::CreateMetadataUpdate(
     compacted_delta_blocks.push_back(dfr->block_id());
   }
 
-  vector<BlockId> new_delta_blocks;
-  if (redo_delta_mutations_written_ > 0) {
-    new_delta_blocks.push_back(new_redo_delta_block_);
-  }
+  if (owns_redo_deltas_) {
+    vector<BlockId> new_delta_blocks;
+    if (redo_delta_mutations_written_ > 0) {
+      new_delta_blocks.push_back(new_redo_delta_block_);
+    }
 
-  update->ReplaceRedoDeltaBlocks(compacted_delta_blocks,
-                                 new_delta_blocks);
+    update->ReplaceRedoDeltaBlocks(compacted_delta_blocks,
+                                   new_delta_blocks);
+  }
 
   if (undo_delta_mutations_written_ > 0) {
-    update->SetNewUndoBlock(new_undo_delta_block_);
+    update->AddNewUndoBlock(new_undo_delta_block_, new_undo_delta_timestamps_);
   }
 
   // Replace old column blocks with new ones
@@ -338,10 +364,23 @@ void MajorDeltaCompaction::CreateMetadataUpdate(
   // For those deleted columns, we just remove the old column data.
   CHECK_LE(new_column_blocks.size(), column_ids_.size());
 
+  // The secondary indexes and bloom filters of the compacted columns are
+  // rebuilt along with their data.
+  std::map<ColumnId, BlockId> new_index_blocks;
+  base_data_writer_->GetFlushedSecondaryIndexBlocksByColumnId(&new_index_blocks);
+  std::map<ColumnId, BlockId> new_bloom_blocks;
+  base_data_writer_->GetFlushedBloomFilterBlocksByColumnId(&new_bloom_blocks);
+
   for (ColumnId col_id : column_ids_) {
     BlockId new_block;
     if (FindCopy(new_column_blocks, col_id, &new_block)) {
       update->ReplaceColumnId(col_id, new_block);
+      if (FindCopy(new_index_blocks, col_id, &new_block)) {
+        update->ReplaceSecondaryIndex(col_id, new_block);
+      }
+      if (FindCopy(new_bloom_blocks, col_id, &new_block)) {
+        update->ReplaceColumnBloomFilter(col_id, new_block);
+      }
     } else {
       // The column has been deleted.
       // If the base data has a block for this column, we need to remove it.
@@ -357,15 +396,9 @@ void MajorDeltaCompaction::CreateMetadataUpdate(
   }
 }
 
-// We're called under diskrowset's component_lock_ and delta_tracker's compact_flush_lock_
-// so both AtomicUpdateStores calls can be done separately and still be seen as one atomic
-// operation.
-Status MajorDeltaCompaction::UpdateDeltaTracker(DeltaTracker* tracker) {
+Status MajorDeltaCompaction::OpenNewDeltaStores(DeltaTracker* tracker) {
   CHECK_EQ(state_, kFinished);
 
-  // 1. Get all the necessary I/O out of the way. It's OK to fail here
-  //    because we haven't updated any in-memory state.
-  //
   // TODO(awong): pull the OpenDeltaReaders() calls out of the critical path of
   // diskrowset's component_lock_. They touch disk and may block other
   // diskrowset operations.
@@ -375,29 +408,34 @@ Status MajorDeltaCompaction::UpdateDeltaTracker(DeltaTracker* tracker) {
   if (redo_delta_mutations_written_ > 0) {
     new_redo_blocks.push_back(new_redo_delta_block_);
   }
-  SharedDeltaStoreVector new_redo_stores;
-  RETURN_NOT_OK(tracker->OpenDeltaReaders(new_redo_blocks, &new_redo_stores, REDO));
+  RETURN_NOT_OK(tracker->OpenDeltaReaders(new_redo_blocks, &new_redo_stores_, REDO));
 
   // Create blocks for the new undo deltas.
-  SharedDeltaStoreVector new_undo_stores;
   if (undo_delta_mutations_written_ > 0) {
     vector<BlockId> new_undo_blocks;
     new_undo_blocks.push_back(new_undo_delta_block_);
-    RETURN_NOT_OK(tracker->OpenDeltaReaders(new_undo_blocks, &new_undo_stores, UNDO));
+    RETURN_NOT_OK(tracker->OpenDeltaReaders(new_undo_blocks, &new_undo_stores_, UNDO));
   }
+  return Status::OK();
+}
 
-  // 2. Only now that we cannot fail do we update the in-memory state.
+// We're called under diskrowset's component_lock_ and delta_tracker's compact_flush_lock_
+// so both AtomicUpdateStores calls can be done separately and still be seen as one atomic
+// operation.
+void MajorDeltaCompaction::UpdateDeltaTracker(DeltaTracker* tracker) {
+  CHECK_EQ(state_, kFinished);
 
   // Even if we didn't create any new redo blocks, we still need to update the
   // tracker so it removes the included_stores_.
-  tracker->AtomicUpdateStores(included_stores_, new_redo_stores, REDO);
+  if (owns_redo_deltas_) {
+    tracker->AtomicUpdateStores(included_stores_, new_redo_stores_, REDO);
+  }
 
   // We only call AtomicUpdateStores() for UNDOs if we wrote UNDOs. We're not
   // removing stores so we don't need to call it otherwise.
-  if (!new_undo_stores.empty()) {
-    tracker->AtomicUpdateStores({}, new_undo_stores, UNDO);
+  if (!new_undo_stores_.empty()) {
+    tracker->AtomicUpdateStores({}, new_undo_stores_, UNDO);
   }
-  return Status::OK();
 }
 
 } // namespace tablet
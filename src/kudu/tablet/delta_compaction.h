@@ -24,9 +24,11 @@
 
 #include "kudu/common/schema.h"
 #include "kudu/fs/block_id.h"
+#include "kudu/fs/block_manager.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/tablet/compaction.h"
 #include "kudu/tablet/delta_store.h"
+#include "kudu/tablet/rowset_metadata.h"
 #include "kudu/util/status.h"
 
 namespace kudu {
@@ -39,7 +41,6 @@ class CFileSet;
 class DeltaFileWriter;
 class DeltaTracker;
 class MultiColumnWriter;
-class RowSetMetadataUpdate;
 
 // Handles major delta compaction: applying deltas to specific columns
 // of a DiskRowSet, writing out an updated DiskRowSet without re-writing the
@@ -60,9 +61,23 @@ class MajorDeltaCompaction {
       std::vector<std::shared_ptr<DeltaStore> > included_stores,
       std::vector<ColumnId> col_ids,
       HistoryGcOpts history_gc_opts,
-      std::string tablet_id);
+      std::string tablet_id,
+      fs::DataDirStorageClass storage_class);
   ~MajorDeltaCompaction();
 
+  // Makes this compaction one of several which compact disjoint groups of
+  // the columns of the same delta stores in parallel. Only the one which
+  // 'owns_redo_deltas' rewrites the REDO deltas, without the updates of any
+  // of 'all_col_ids', and replaces the compacted delta stores; the others
+  // only write their columns and UNDO deltas.
+  //
+  // The REDO deltas must include no DELETEs or REINSERTs: the UNDO deltas of
+  // each group only restore the columns of the group.
+  void SetColumnGroup(bool owns_redo_deltas, std::vector<ColumnId> all_col_ids);
+
+  // The REDO delta stores being compacted.
+  const SharedDeltaStoreVector& included_stores() const { return included_stores_; }
+
   // Executes the compaction.
   // This has no effect on the metadata of the tablet, etc.
   Status Compact();
@@ -73,8 +88,13 @@ class MajorDeltaCompaction {
   // 3) adds the new REDO delta which contains any uncompacted deltas
   void CreateMetadataUpdate(RowSetMetadataUpdate* update);
 
-  // Apply the changes to the given delta tracker.
-  Status UpdateDeltaTracker(DeltaTracker* tracker);
+  // After a compaction is successful, opens the delta stores it wrote. It's
+  // OK for this to fail: no in-memory state has been updated yet.
+  Status OpenNewDeltaStores(DeltaTracker* tracker);
+
+  // Apply the changes to the given delta tracker, swapping in the delta
+  // stores opened by OpenNewDeltaStores().
+  void UpdateDeltaTracker(DeltaTracker* tracker);
 
  private:
   std::string ColumnNamesToString() const;
@@ -109,6 +129,11 @@ class MajorDeltaCompaction {
 
   const HistoryGcOpts history_gc_opts_;
 
+  // Whether this compaction rewrites the REDO deltas, and the columns whose
+  // updates it drops from them. See SetColumnGroup().
+  bool owns_redo_deltas_;
+  std::vector<ColumnId> redo_col_ids_to_remove_;
+
   // Inputs:
   //-----------------
 
@@ -124,6 +149,9 @@ class MajorDeltaCompaction {
   // The ID of the tablet being compacted.
   const std::string tablet_id_;
 
+  // The class of data directory the rowset's blocks are placed in.
+  const fs::DataDirStorageClass storage_class_;
+
   // Outputs:
   gscoped_ptr<MultiColumnWriter> base_data_writer_;
   // The following two may not be initialized if we don't need to write a delta file.
@@ -132,6 +160,11 @@ class MajorDeltaCompaction {
 
   gscoped_ptr<DeltaFileWriter> new_undo_delta_writer_;
   BlockId new_undo_delta_block_;
+  RowSetMetadata::UndoTimestamps new_undo_delta_timestamps_;
+
+  // The delta stores opened by OpenNewDeltaStores().
+  SharedDeltaStoreVector new_redo_stores_;
+  SharedDeltaStoreVector new_undo_stores_;
 
   size_t redo_delta_mutations_written_;
   size_t undo_delta_mutations_written_;
@@ -20,6 +20,7 @@
 #include <algorithm>
 #include <cstdlib>
 
+#include <gflags/gflags_declare.h>
 #include <glog/logging.h>
 
 #include "kudu/common/row_changelist.h"
@@ -33,9 +34,13 @@
 #include "kudu/tablet/deltafile.h"
 #include "kudu/util/memory/arena.h"
 
+DECLARE_bool(tablet_compaction_bypass_page_cache);
+
 namespace kudu {
 namespace tablet {
 
+const char* DELTA_MUTATIONS_APPLIED_METRIC_NAME = "delta_mutations_applied";
+
 using std::shared_ptr;
 using std::string;
 using std::vector;
@@ -58,6 +63,7 @@ Status DebugDumpDeltaIterator(DeltaType type,
                               vector<std::string>* out) {
   ScanSpec spec;
   spec.set_cache_blocks(false);
+  spec.set_cache_pages(!FLAGS_tablet_compaction_bypass_page_cache);
   RETURN_NOT_OK(iter->Init(&spec));
   RETURN_NOT_OK(iter->SeekToOrdinal(0));
 
@@ -45,6 +45,10 @@ class DeltaStats;
 class Mutation;
 class MvccSnapshot;
 
+// The name of the trace metric counting the mutations which delta iterators
+// decoded to apply them to the rows being read.
+extern const char* DELTA_MUTATIONS_APPLIED_METRIC_NAME;
+
 // Interface for the pieces of the system that track deltas/updates.
 // This is implemented by DeltaMemStore and by DeltaFileReader.
 class DeltaStore {
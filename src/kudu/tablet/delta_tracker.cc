@@ -53,6 +53,7 @@
 #include "kudu/util/logging.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/status.h"
+#include "kudu/util/trace.h"
 
 namespace kudu {
 
@@ -373,7 +374,8 @@ Status DeltaTracker::CompactStores(int start_idx, int end_idx) {
   // Open a writer for the new destination delta block
   FsManager* fs = rowset_metadata_->fs_manager();
   unique_ptr<WritableBlock> block;
-  CreateBlockOptions opts({ rowset_metadata_->tablet_metadata()->tablet_id() });
+  CreateBlockOptions opts({ rowset_metadata_->tablet_metadata()->tablet_id(),
+                            rowset_metadata_->storage_class() });
   RETURN_NOT_OK_PREPEND(fs->CreateNewBlock(opts, &block),
                         "Could not allocate delta block");
   BlockId new_block_id(block->id());
@@ -396,6 +398,21 @@ Status DeltaTracker::CompactStores(int start_idx, int end_idx) {
   return Status::OK();
 }
 
+bool DeltaTracker::GetUndoMaxTimestamp(DeltaStore* undo, Timestamp* max_timestamp) const {
+  if (undo->Initted()) {
+    *max_timestamp = undo->delta_stats().max_timestamp();
+    return true;
+  }
+  // This is always a safe downcast because UNDO deltas are always on disk.
+  const BlockId& block_id = down_cast<DeltaFileReader*>(undo)->block_id();
+  RowSetMetadata::UndoTimestamps timestamps;
+  if (!rowset_metadata_->GetUndoDeltaTimestamps(block_id, &timestamps)) {
+    return false;
+  }
+  *max_timestamp = timestamps.max;
+  return true;
+}
+
 Status DeltaTracker::EstimateBytesInPotentiallyAncientUndoDeltas(Timestamp ancient_history_mark,
                                                                  int64_t* bytes) {
   DCHECK_NE(Timestamp::kInvalidTimestamp, ancient_history_mark);
@@ -405,9 +422,11 @@ Status DeltaTracker::EstimateBytesInPotentiallyAncientUndoDeltas(Timestamp ancie
 
   int64_t tmp_bytes = 0;
   for (const auto& undo : boost::adaptors::reverse(undos_newest_first)) {
-    // Short-circuit once we hit an initialized delta block with 'max_timestamp' > AHM.
-    if (undo->Initted() &&
-        undo->delta_stats().max_timestamp() >= ancient_history_mark) {
+    // Short-circuit once we hit a delta block with 'max_timestamp' > AHM. Blocks
+    // whose timestamps aren't known yet are counted as potentially ancient.
+    Timestamp max_timestamp;
+    if (GetUndoMaxTimestamp(undo.get(), &max_timestamp) &&
+        max_timestamp >= ancient_history_mark) {
       break;
     }
     tmp_bytes += undo->EstimateSize(); // Can be called before Init().
@@ -430,15 +449,26 @@ Status DeltaTracker::InitUndoDeltas(Timestamp ancient_history_mark,
   for (auto& undo : boost::adaptors::reverse(undos_newest_first)) {
     if (deadline.Initialized() && MonoTime::Now() >= deadline) break;
 
-    if (!undo->Initted()) {
+    // Blocks whose timestamps are recorded in the rowset metadata don't need
+    // to be read at all.
+    Timestamp max_timestamp;
+    if (!GetUndoMaxTimestamp(undo.get(), &max_timestamp)) {
       RETURN_NOT_OK(undo->Init());
       tmp_blocks_initialized++;
+
+      // Record the block's timestamps so that it needn't be initialized
+      // again, even after a restart.
+      const DeltaStats& stats = undo->delta_stats();
+      rowset_metadata_->SetUndoDeltaTimestamps(
+          down_cast<DeltaFileReader*>(undo.get())->block_id(),
+          { stats.min_timestamp(), stats.max_timestamp() });
+      max_timestamp = stats.max_timestamp();
     }
 
     // Stop initializing delta files once we start hitting newer deltas that
     // are not GC'able.
     if (ancient_history_mark != Timestamp::kInvalidTimestamp &&
-        undo->delta_stats().max_timestamp() >= ancient_history_mark) break;
+        max_timestamp >= ancient_history_mark) break;
 
     // We only want to count the bytes in the ancient undos so this needs to
     // come after the short-circuit above.
@@ -478,8 +508,10 @@ Status DeltaTracker::DeleteAncientUndoDeltas(Timestamp ancient_history_mark,
 
   // Traverse oldest-first.
   for (auto& undo : boost::adaptors::reverse(undos_newest_first)) {
-    if (!undo->Initted()) break; // Never initialize the deltas in this code path (it's slow).
-    if (undo->delta_stats().max_timestamp() >= ancient_history_mark) break;
+    // Never initialize the deltas in this code path (it's slow).
+    Timestamp max_timestamp;
+    if (!GetUndoMaxTimestamp(undo.get(), &max_timestamp)) break;
+    if (max_timestamp >= ancient_history_mark) break;
     tmp_blocks_deleted++;
     tmp_bytes_deleted += undo->EstimateSize();
     // This is always a safe downcast because UNDO deltas are always on disk.
@@ -529,11 +561,15 @@ Status DeltaTracker::DoCompactStores(size_t start_idx, size_t end_idx,
 }
 
 void DeltaTracker::CollectStores(vector<shared_ptr<DeltaStore>>* deltas,
-                                 WhichStores which) const {
+                                 WhichStores which,
+                                 size_t* num_undos) const {
   std::lock_guard<rw_spinlock> lock(component_lock_);
   if (which != REDOS_ONLY) {
     deltas->assign(undo_delta_stores_.begin(), undo_delta_stores_.end());
   }
+  if (num_undos) {
+    *num_undos = deltas->size();
+  }
   if (which != UNDOS_ONLY) {
     deltas->insert(deltas->end(), redo_delta_stores_.begin(), redo_delta_stores_.end());
     deltas->push_back(dms_);
@@ -545,10 +581,36 @@ Status DeltaTracker::NewDeltaIterator(const Schema* schema,
                                       WhichStores which,
                                       unique_ptr<DeltaIterator>* out) const {
   std::vector<shared_ptr<DeltaStore> > stores;
-  CollectStores(&stores, which);
+  size_t num_undos;
+  CollectStores(&stores, which, &num_undos);
+  CullUndoStoresForSnapshot(snap, num_undos, &stores);
   return DeltaIteratorMerger::Create(stores, schema, snap, out);
 }
 
+void DeltaTracker::CullUndoStoresForSnapshot(const MvccSnapshot& snap,
+                                             size_t num_undos,
+                                             vector<shared_ptr<DeltaStore>>* stores) const {
+  int64_t culled = 0;
+  auto undos_end = stores->begin() + num_undos;
+  auto new_undos_end = std::remove_if(
+      stores->begin(), undos_end,
+      [&](const shared_ptr<DeltaStore>& undo) {
+        // An UNDO store only matters to a snapshot which doesn't include some
+        // of its deltas, i.e. a snapshot in the past of its newest delta.
+        Timestamp max_timestamp;
+        if (GetUndoMaxTimestamp(undo.get(), &max_timestamp) &&
+            !snap.MayHaveUncommittedTransactionsAtOrBefore(max_timestamp)) {
+          culled++;
+          return true;
+        }
+        return false;
+      });
+  stores->erase(new_undos_end, undos_end);
+  if (culled > 0) {
+    TRACE_COUNTER_INCREMENT("undo_delta_stores_culled", culled);
+  }
+}
+
 Status DeltaTracker::NewDeltaFileIterator(
     const Schema* schema,
     const MvccSnapshot& snap,
@@ -635,12 +697,12 @@ Status DeltaTracker::CheckRowDeleted(rowid_t row_idx, bool *deleted,
 }
 
 Status DeltaTracker::FlushDMS(DeltaMemStore* dms,
-                              shared_ptr<DeltaFileReader>* dfr,
-                              MetadataFlushType flush_type) {
+                              shared_ptr<DeltaFileReader>* dfr) {
   // Open file for write.
   FsManager* fs = rowset_metadata_->fs_manager();
   unique_ptr<WritableBlock> writable_block;
-  CreateBlockOptions opts({ rowset_metadata_->tablet_metadata()->tablet_id() });
+  CreateBlockOptions opts({ rowset_metadata_->tablet_metadata()->tablet_id(),
+                            rowset_metadata_->storage_class() });
   RETURN_NOT_OK_PREPEND(fs->CreateNewBlock(opts, &writable_block),
                         "Unable to allocate new delta data writable_block");
   BlockId block_id(writable_block->id());
@@ -667,13 +729,6 @@ Status DeltaTracker::FlushDMS(DeltaMemStore* dms,
                                             std::move(options),
                                             dfr));
   LOG_WITH_PREFIX(INFO) << "Reopened delta block for read: " << block_id.ToString();
-
-  RETURN_NOT_OK(rowset_metadata_->CommitRedoDeltaDataBlock(dms->id(), block_id));
-  if (flush_type == FLUSH_METADATA) {
-    RETURN_NOT_OK_PREPEND(rowset_metadata_->Flush(),
-                          Substitute("Unable to commit Delta block metadata for: $0",
-                                     block_id.ToString()));
-  }
   return Status::OK();
 }
 
@@ -722,7 +777,7 @@ Status DeltaTracker::Flush(MetadataFlushType flush_type) {
   // TODO(todd): need another lock to prevent concurrent flushers
   // at some point.
   shared_ptr<DeltaFileReader> dfr;
-  CHECK_OK(FlushDMS(old_dms.get(), &dfr, flush_type));
+  CHECK_OK(FlushDMS(old_dms.get(), &dfr));
 
   // Now, re-take the lock and swap in the DeltaFileReader in place of
   // of the DeltaMemStore
@@ -733,8 +788,48 @@ Status DeltaTracker::Flush(MetadataFlushType flush_type) {
     CHECK_EQ(redo_delta_stores_[idx], old_dms)
         << "Another thread modified the delta store list during flush";
     redo_delta_stores_[idx] = dfr;
+
+    // Commit the block under the lock, so that CountLiveRows() never counts
+    // the deletes of 'old_dms' both in the metadata and in the store list.
+    CHECK_OK(rowset_metadata_->CommitRedoDeltaDataBlock(old_dms->id(),
+                                                        old_dms->deleted_row_count(),
+                                                        dfr->block_id()));
   }
 
+  if (flush_type == FLUSH_METADATA) {
+    RETURN_NOT_OK_PREPEND(rowset_metadata_->Flush(),
+                          Substitute("Unable to commit Delta block metadata for: $0",
+                                     dfr->block_id().ToString()));
+  }
+  return Status::OK();
+}
+
+Status DeltaTracker::CountLiveRows(int64_t* live_row_count) const {
+  shared_lock<rw_spinlock> lock(component_lock_);
+  int64_t count;
+  if (!rowset_metadata_->GetLiveRowCount(&count)) {
+    // The rowset was written before live rows were counted: count the deletes
+    // of its REDO delta files once, and record the result in the metadata.
+    count = num_rows_;
+    for (const auto& ds : redo_delta_stores_) {
+      if (dynamic_cast<DeltaMemStore*>(ds.get()) != nullptr) {
+        continue;
+      }
+      RETURN_NOT_OK(ds->Init());
+      count -= ds->delta_stats().delete_count();
+    }
+    rowset_metadata_->SetLiveRowCount(count);
+  }
+  // Deletes which haven't been committed to the metadata yet: those of the
+  // DMS, and of a DMS being flushed.
+  for (const auto& ds : redo_delta_stores_) {
+    const auto* dms = dynamic_cast<const DeltaMemStore*>(ds.get());
+    if (dms != nullptr) {
+      count -= dms->deleted_row_count();
+    }
+  }
+  count -= dms_->deleted_row_count();
+  *live_row_count = count;
   return Status::OK();
 }
 
@@ -791,6 +886,86 @@ void DeltaTracker::GetColumnIdsWithUpdates(std::vector<ColumnId>* col_ids) const
   col_ids->assign(column_ids_with_updates.begin(), column_ids_with_updates.end());
 }
 
+Status DeltaTracker::MayMutateColumn(ColumnId col_id,
+                                     Timestamp ancient_history_mark,
+                                     bool* may_mutate) {
+  *may_mutate = true;
+  SharedDeltaStoreVector undos;
+  CollectStores(&undos, UNDOS_ONLY);
+  SharedDeltaStoreVector redos;
+  CollectStores(&redos, REDOS_ONLY);
+
+  const auto mutates_column = [&](const DeltaStats& stats) {
+    return stats.reinsert_count() > 0 || stats.update_count_for_col_id(col_id) > 0;
+  };
+  for (const auto& undo : undos) {
+    RETURN_NOT_OK(undo->Init());
+    if (undo->delta_stats().max_timestamp() >= ancient_history_mark &&
+        mutates_column(undo->delta_stats())) {
+      return Status::OK();
+    }
+  }
+  for (const auto& redo : redos) {
+    RETURN_NOT_OK(redo->Init());
+    if (mutates_column(redo->delta_stats())) {
+      return Status::OK();
+    }
+  }
+  *may_mutate = false;
+  return Status::OK();
+}
+
+Status DeltaTracker::RemoveMutatedColumnIds(const MvccSnapshot& snap,
+                                            vector<ColumnId>* col_ids) const {
+  SharedDeltaStoreVector stores;
+  size_t num_undos;
+  CollectStores(&stores, UNDOS_AND_REDOS, &num_undos);
+  // The DMS comes last.
+  if (!down_cast<DeltaMemStore*>(stores.back().get())->Empty()) {
+    col_ids->clear();
+    return Status::OK();
+  }
+  stores.pop_back();
+
+  for (size_t i = 0; i < stores.size() && !col_ids->empty(); i++) {
+    DeltaStore* store = stores[i].get();
+    Timestamp max_timestamp;
+    if (i < num_undos && GetUndoMaxTimestamp(store, &max_timestamp) &&
+        !snap.MayHaveUncommittedTransactionsAtOrBefore(max_timestamp)) {
+      continue;
+    }
+    RETURN_NOT_OK(store->Init());
+    const DeltaStats& stats = store->delta_stats();
+    if (stats.reinsert_count() > 0) {
+      col_ids->clear();
+      break;
+    }
+    col_ids->erase(std::remove_if(col_ids->begin(), col_ids->end(),
+                                  [&](ColumnId col_id) {
+                                    return stats.update_count_for_col_id(col_id) > 0;
+                                  }),
+                   col_ids->end());
+  }
+  return Status::OK();
+}
+
+Status DeltaTracker::MayHaveDeltasSince(Timestamp timestamp, bool* may_have_deltas) {
+  *may_have_deltas = true;
+  if (!DeltaMemStoreEmpty()) {
+    return Status::OK();
+  }
+  SharedDeltaStoreVector stores;
+  CollectStores(&stores, UNDOS_AND_REDOS);
+  for (const auto& store : stores) {
+    RETURN_NOT_OK(store->Init());
+    if (store->delta_stats().max_timestamp() >= timestamp) {
+      return Status::OK();
+    }
+  }
+  *may_have_deltas = false;
+  return Status::OK();
+}
+
 Status DeltaTracker::InitAllDeltaStoresForTests(WhichStores stores) {
   shared_lock<rw_spinlock> lock(component_lock_);
   if (stores == UNDOS_AND_REDOS || stores == UNDOS_ONLY) {
@@ -246,6 +246,10 @@ class DeltaTracker {
   // Return the number of redo delta stores, not including the DeltaMemStore.
   size_t CountRedoDeltaStores() const;
 
+  // Sets 'live_row_count' to the number of rows of the rowset which haven't
+  // been deleted, as of the latest applied deletes.
+  Status CountLiveRows(int64_t* live_row_count) const;
+
   // Return the size on-disk of UNDO deltas, in bytes.
   uint64_t UndoDeltaOnDiskSize() const;
 
@@ -255,6 +259,33 @@ class DeltaTracker {
   // Retrieves the list of column indexes that currently have updates.
   void GetColumnIdsWithUpdates(std::vector<ColumnId>* col_ids) const;
 
+  // Sets '*may_mutate' to false if it's certain that, as of any snapshot at or
+  // after 'ancient_history_mark', no row holds a different value of column
+  // 'col_id' than the base data: i.e. neither the REDO deltas nor the UNDO
+  // deltas which aren't ancient update the column or reinsert rows.
+  // Otherwise sets it to true. Deletes are ignored.
+  //
+  // Initializes the delta stores whose stats are needed.
+  Status MayMutateColumn(ColumnId col_id, Timestamp ancient_history_mark, bool* may_mutate);
+
+  // Removes from 'col_ids' the columns of which a row may hold a different
+  // value as of 'snap' than the base data: those updated by the REDO deltas,
+  // or by the UNDO deltas which aren't all committed in 'snap'. All of them
+  // are removed if any of those deltas reinsert rows, or if the DMS isn't
+  // empty, since it doesn't track the columns it updates. Deletes are
+  // ignored.
+  //
+  // Initializes the delta stores whose stats are needed.
+  Status RemoveMutatedColumnIds(const MvccSnapshot& snap, std::vector<ColumnId>* col_ids) const;
+
+  // Sets '*may_have_deltas' to false if it's certain that no delta was
+  // committed at or after 'timestamp': the DMS is empty and neither the UNDO
+  // nor the REDO delta files hold deltas that recent. Otherwise sets it to
+  // true.
+  //
+  // Initializes the delta stores whose stats are needed.
+  Status MayHaveDeltasSince(Timestamp timestamp, bool* may_have_deltas);
+
   Mutex* compact_flush_lock() {
     return &compact_flush_lock_;
   }
@@ -275,13 +306,28 @@ class DeltaTracker {
 
   Status DoOpen();
 
+  // Returns in 'max_timestamp' the newest timestamp of the deltas in the UNDO
+  // store 'undo', taken from its stats if it is initialized and otherwise from
+  // the rowset metadata. Returns false if neither knows it.
+  bool GetUndoMaxTimestamp(DeltaStore* undo, Timestamp* max_timestamp) const;
+
   Status FlushDMS(DeltaMemStore* dms,
-                  std::shared_ptr<DeltaFileReader>* dfr,
-                  MetadataFlushType flush_type);
+                  std::shared_ptr<DeltaFileReader>* dfr);
 
-  // This collects undo and/or redo stores into '*stores'.
+  // This collects undo and/or redo stores into '*stores'. The undo stores
+  // come first; if 'num_undos' is not null, it is set to their number.
   void CollectStores(std::vector<std::shared_ptr<DeltaStore>>* stores,
-                     WhichStores which) const;
+                     WhichStores which,
+                     size_t* num_undos = nullptr) const;
+
+  // Removes from the first 'num_undos' stores of 'stores', which must be UNDO
+  // stores, those whose deltas are all committed in 'snap'. Unlike the culling
+  // done by the stores themselves, this also applies to stores that haven't
+  // been initialized yet, using the timestamps in the rowset metadata, so
+  // they needn't be opened.
+  void CullUndoStoresForSnapshot(const MvccSnapshot& snap,
+                                 size_t num_undos,
+                                 std::vector<std::shared_ptr<DeltaStore>>* stores) const;
 
   // Performs the actual compaction. Results of compaction are written to "block",
   // while delta stores that underwent compaction are appended to "compacted_stores", while
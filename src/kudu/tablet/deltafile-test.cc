@@ -18,6 +18,7 @@
 #include <algorithm>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <memory>
 #include <ostream>
 #include <string>
@@ -356,6 +357,215 @@ TEST_F(TestDeltaFile, TestSkipsDeltasOutOfRange) {
   iter.reset(raw_iter);
 }
 
+// Tests that the latest relevant mutation of each row is applied, in order,
+// when several rows of a batch have several mutations.
+TEST_F(TestDeltaFile, TestApplyMultipleMutationsPerRow) {
+  unique_ptr<WritableBlock> block;
+  ASSERT_OK(fs_manager_->CreateNewBlock({}, &block));
+  test_block_ = block->id();
+  {
+    DeltaFileWriter dfw(std::move(block));
+    ASSERT_OK(dfw.Start());
+    DeltaStats stats;
+    faststring buf;
+    auto append = [&](rowid_t row_idx, int64_t timestamp, const char* type, uint32_t val) {
+      buf.clear();
+      RowChangeListEncoder enc(&buf);
+      if (strcmp(type, "DELETE") == 0) {
+        enc.SetToDelete();
+      } else {
+        if (strcmp(type, "REINSERT") == 0) {
+          enc.SetToReinsert();
+        } else {
+          enc.SetToUpdate();
+        }
+        enc.EncodeColumnMutation(schema_.column(0), schema_.column_id(0), &val);
+      }
+      DeltaKey key(row_idx, Timestamp(timestamp));
+      RowChangeList rcl(buf);
+      ASSERT_OK(dfw.AppendDelta<REDO>(key, rcl));
+      ASSERT_OK(stats.UpdateStats(key.timestamp(), rcl));
+    };
+    append(0, 1, "UPDATE", 1);
+    append(0, 2, "UPDATE", 2);
+    append(1, 1, "DELETE", 0);
+    append(2, 1, "DELETE", 0);
+    append(2, 2, "REINSERT", 5);
+    append(3, 1, "UPDATE", 7);
+    append(3, 5, "UPDATE", 9);
+    dfw.WriteDeltaStats(stats);
+    ASSERT_OK(dfw.Finish());
+  }
+
+  shared_ptr<DeltaFileReader> reader;
+  ASSERT_OK(OpenDeltaFileReader(test_block_, &reader));
+  DeltaIterator* raw_iter;
+  ASSERT_OK(reader->NewDeltaIterator(&schema_, MvccSnapshot(Timestamp(3)), &raw_iter));
+  gscoped_ptr<DeltaIterator> iter(raw_iter);
+  ASSERT_OK(iter->Init(nullptr));
+  ASSERT_OK(iter->SeekToOrdinal(0));
+
+  RowBlock rb(schema_, 10, &arena_);
+  rb.ZeroMemory();
+  ASSERT_OK(iter->PrepareBatch(rb.nrows(), DeltaIterator::PREPARE_FOR_APPLY));
+  ASSERT_TRUE(iter->MayHaveDeltas());
+  ColumnBlock dst_col = rb.column_block(0);
+  ASSERT_OK(iter->ApplyUpdates(0, &dst_col));
+  SelectionVector sel(rb.nrows());
+  sel.SetAllTrue();
+  ASSERT_OK(iter->ApplyDeletes(&sel));
+
+  const uint32_t* vals = reinterpret_cast<const uint32_t*>(dst_col.data());
+  EXPECT_EQ(2, vals[0]);
+  EXPECT_FALSE(sel.IsRowSelected(1));
+  EXPECT_TRUE(sel.IsRowSelected(2));
+  EXPECT_EQ(5, vals[2]);
+  EXPECT_EQ(7, vals[3]);
+  EXPECT_EQ(rb.nrows() - 1, sel.CountSelected());
+
+  // The next batch has no mutations.
+  ASSERT_OK(iter->PrepareBatch(rb.nrows(), DeltaIterator::PREPARE_FOR_APPLY));
+  ASSERT_FALSE(iter->MayHaveDeltas());
+}
+
+// Tests that the deletes recorded in a delta file's deleted rows are applied
+// according to the snapshot, whether or not the snapshot includes all of them.
+TEST_F(TestDeltaFile, TestDeletedRows) {
+  const int kNumRows = 1000;
+  unique_ptr<WritableBlock> block;
+  ASSERT_OK(fs_manager_->CreateNewBlock({}, &block));
+  test_block_ = block->id();
+  {
+    // Delete a run of rows at timestamp 1, and every seventh row after it at
+    // timestamp 2.
+    DeltaFileWriter dfw(std::move(block));
+    ASSERT_OK(dfw.Start());
+    DeltaStats stats;
+    for (rowid_t row = 0; row < kNumRows; row++) {
+      int64_t timestamp;
+      if (row >= 100 && row < 300) {
+        timestamp = 1;
+      } else if (row >= 300 && row % 7 == 0) {
+        timestamp = 2;
+      } else {
+        continue;
+      }
+      DeltaKey key(row, Timestamp(timestamp));
+      RowChangeList rcl = RowChangeList::CreateDelete();
+      ASSERT_OK(dfw.AppendDelta<REDO>(key, rcl));
+      ASSERT_OK(stats.UpdateStats(key.timestamp(), rcl));
+    }
+    dfw.WriteDeltaStats(stats);
+    ASSERT_OK(dfw.Finish());
+  }
+
+  shared_ptr<DeltaFileReader> reader;
+  ASSERT_OK(OpenDeltaFileReader(test_block_, &reader));
+  for (int64_t snap_ts : { 2, 3 }) {
+    SCOPED_TRACE(snap_ts);
+    DeltaIterator* raw_iter;
+    ASSERT_OK(reader->NewDeltaIterator(&schema_, MvccSnapshot(Timestamp(snap_ts)), &raw_iter));
+    gscoped_ptr<DeltaIterator> iter(raw_iter);
+    ASSERT_OK(iter->Init(nullptr));
+    ASSERT_OK(iter->SeekToOrdinal(0));
+
+    // Use batches which don't line up with the bytes of the bitmaps.
+    const int kBatchSize = 93;
+    for (rowid_t start = 0; start < kNumRows; start += kBatchSize) {
+      RowBlock rb(schema_, kBatchSize, &arena_);
+      ASSERT_OK(iter->PrepareBatch(rb.nrows(), DeltaIterator::PREPARE_FOR_APPLY));
+      SelectionVector sel(rb.nrows());
+      sel.SetAllTrue();
+      if (iter->MayHaveDeltas()) {
+        ASSERT_OK(iter->ApplyDeletes(&sel));
+      }
+      for (int i = 0; i < rb.nrows(); i++) {
+        const rowid_t row = start + i;
+        const bool deleted = (row >= 100 && row < 300) ||
+            (snap_ts > 2 && row >= 300 && row < kNumRows && row % 7 == 0);
+        ASSERT_EQ(!deleted, sel.IsRowSelected(i)) << "row " << row;
+      }
+    }
+  }
+}
+
+// Tests that the delta blocks which only update unprojected columns aren't
+// read when applying deltas.
+TEST_F(TestDeltaFile, TestSkipsBlocksOfUnprojectedColumns) {
+  google::FlagSaver saver;
+  FLAGS_deltafile_default_block_size = 256;
+  const int kNumRows = 1000;
+  SchemaBuilder builder;
+  ASSERT_OK(builder.AddColumn("a", UINT32));
+  ASSERT_OK(builder.AddColumn("b", UINT32));
+  const Schema schema = builder.Build();
+
+  // Update column 'a' of every row, and column 'b' of rows 500 to 599.
+  unique_ptr<WritableBlock> block;
+  ASSERT_OK(fs_manager_->CreateNewBlock({}, &block));
+  test_block_ = block->id();
+  {
+    DeltaFileWriter dfw(std::move(block));
+    ASSERT_OK(dfw.Start());
+    DeltaStats stats;
+    faststring buf;
+    for (rowid_t row = 0; row < kNumRows; row++) {
+      buf.clear();
+      RowChangeListEncoder update(&buf);
+      update.AddColumnUpdate(schema.column(0), schema.column_id(0), &row);
+      if (row >= 500 && row < 600) {
+        update.AddColumnUpdate(schema.column(1), schema.column_id(1), &row);
+      }
+      DeltaKey key(row, Timestamp(1));
+      RowChangeList rcl(buf);
+      ASSERT_OK(dfw.AppendDelta<REDO>(key, rcl));
+      ASSERT_OK(stats.UpdateStats(key.timestamp(), rcl));
+    }
+    dfw.WriteDeltaStats(stats);
+    ASSERT_OK(dfw.Finish());
+  }
+
+  // Applies the deltas of the file to a projection of 'col_name', returning
+  // how many bytes were read.
+  auto apply = [&](const char* col_name, size_t* bytes_read) {
+    Schema projection;
+    ASSERT_OK(schema.CreateProjectionByNames({ col_name }, &projection));
+    unique_ptr<ReadableBlock> block;
+    ASSERT_OK(fs_manager_->OpenBlock(test_block_, &block));
+    *bytes_read = 0;
+    unique_ptr<ReadableBlock> count_block(
+        new CountingReadableBlock(std::move(block), bytes_read));
+    shared_ptr<DeltaFileReader> reader;
+    ASSERT_OK(DeltaFileReader::Open(std::move(count_block), REDO, ReaderOptions(), &reader));
+    DeltaIterator* raw_iter;
+    ASSERT_OK(reader->NewDeltaIterator(
+        &projection, MvccSnapshot::CreateSnapshotIncludingAllTransactions(), &raw_iter));
+    gscoped_ptr<DeltaIterator> iter(raw_iter);
+    ASSERT_OK(iter->Init(nullptr));
+    ASSERT_OK(iter->SeekToOrdinal(0));
+
+    const bool is_b = strcmp(col_name, "b") == 0;
+    RowBlock rb(projection, 100, &arena_);
+    for (rowid_t start = 0; start < kNumRows; start += rb.nrows()) {
+      rb.ZeroMemory();
+      ASSERT_OK(iter->PrepareBatch(rb.nrows(), DeltaIterator::PREPARE_FOR_APPLY));
+      ColumnBlock dst_col = rb.column_block(0);
+      ASSERT_OK(iter->ApplyUpdates(0, &dst_col));
+      const uint32_t* vals = reinterpret_cast<const uint32_t*>(dst_col.data());
+      for (int i = 0; i < rb.nrows(); i++) {
+        const rowid_t row = start + i;
+        const bool updated = !is_b || (row >= 500 && row < 600);
+        ASSERT_EQ(updated ? row : 0, vals[i]) << "row " << row;
+      }
+    }
+  };
+  size_t bytes_read_b;
+  NO_FATALS(apply("b", &bytes_read_b));
+  size_t bytes_read_a;
+  NO_FATALS(apply("a", &bytes_read_a));
+  ASSERT_LT(bytes_read_b, bytes_read_a);
+}
+
 TEST_F(TestDeltaFile, TestLazyInit) {
   WriteTestFile();
 
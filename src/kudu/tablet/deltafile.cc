@@ -17,10 +17,14 @@
 
 #include "kudu/tablet/deltafile.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <memory>
 #include <ostream>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include <gflags/gflags.h>
 #include <gflags/gflags_declare.h>
@@ -42,12 +46,15 @@
 #include "kudu/fs/block_manager.h"
 #include "kudu/fs/fs_manager.h"
 #include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/map-util.h"
 #include "kudu/gutil/mathlimits.h"
 #include "kudu/gutil/stringprintf.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/tablet/mutation.h"
 #include "kudu/tablet/mvcc.h"
 #include "kudu/tablet/tablet.pb.h"
+#include "kudu/util/bitmap.h"
+#include "kudu/util/coding.h"
 #include "kudu/util/compression/compression_codec.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/memory/arena.h"
@@ -87,14 +94,22 @@ using fs::WritableBlock;
 namespace tablet {
 
 const char * const DeltaFileReader::kDeltaStatsEntryName = "deltafilestats";
+const char * const DeltaFileReader::kDeletedRowsEntryName = "deletedrows";
+const char * const DeltaFileReader::kUpdatedRowsEntryName = "updatedrows";
 
 namespace {
 
+// Flags of the encoded deleted rows.
+const uint32_t kDeletedRowsDeletesOnly = 1 << 0;
+
 } // namespace
 
 DeltaFileWriter::DeltaFileWriter(unique_ptr<WritableBlock> block)
+    : redo_max_delete_timestamp_(Timestamp::kMin),
+      has_redo_updates_(false),
+      has_redo_reinserts_(false)
 #ifndef NDEBUG
- : has_appended_(false)
+      , has_appended_(false)
 #endif
 { // NOLINT(*)
   cfile::WriterOptions opts;
@@ -124,11 +139,64 @@ Status DeltaFileWriter::FinishAndReleaseBlock(BlockCreationTransaction* transact
   if (writer_->written_value_count() == 0) {
     return Status::Aborted("no deltas written");
   }
+  WriteDeletedRows();
+  WriteUpdatedRows();
   return writer_->FinishAndReleaseBlock(transaction);
 }
 
+void DeltaFileWriter::WriteDeletedRows() {
+  // A reinsert would make a deleted row live again.
+  if (redo_deleted_rows_.empty() || has_redo_reinserts_) {
+    return;
+  }
+
+  // The rows are encoded as the differences between consecutive rows, so
+  // that runs of deleted rows take a byte per row.
+  faststring buf;
+  PutVarint32(&buf, has_redo_updates_ ? 0 : kDeletedRowsDeletesOnly);
+  PutVarint64(&buf, redo_max_delete_timestamp_.value());
+  PutVarint32(&buf, redo_deleted_rows_.size());
+  rowid_t prev_row = 0;
+  for (rowid_t row : redo_deleted_rows_) {
+    PutVarint32(&buf, row - prev_row);
+    prev_row = row;
+  }
+  writer_->AddMetadataPair(DeltaFileReader::kDeletedRowsEntryName, buf.ToString());
+}
+
+void DeltaFileWriter::WriteUpdatedRows() {
+  // Encoded like the deleted rows, column by column. An empty entry tells
+  // readers that no column is updated.
+  faststring buf;
+  PutVarint32(&buf, updated_rows_by_col_.size());
+  for (const auto& entry : updated_rows_by_col_) {
+    PutVarint32(&buf, entry.first);
+    PutVarint32(&buf, entry.second.size());
+    rowid_t prev_row = 0;
+    for (rowid_t row : entry.second) {
+      PutVarint32(&buf, row - prev_row);
+      prev_row = row;
+    }
+  }
+  writer_->AddMetadataPair(DeltaFileReader::kUpdatedRowsEntryName, buf.ToString());
+}
+
 Status DeltaFileWriter::DoAppendDelta(const DeltaKey &key,
                                       const RowChangeList &delta) {
+  if (!delta.is_delete()) {
+    RowChangeListDecoder decoder(delta);
+    RETURN_NOT_OK(decoder.Init());
+    vector<ColumnId> col_ids;
+    RETURN_NOT_OK(decoder.GetIncludedColumnIds(&col_ids));
+    for (ColumnId col_id : col_ids) {
+      // Rows are appended in ascending order, possibly several times.
+      vector<rowid_t>& rows = updated_rows_by_col_[col_id];
+      if (rows.empty() || rows.back() != key.row_idx()) {
+        rows.push_back(key.row_idx());
+      }
+    }
+  }
+
   Slice delta_slice(delta.slice());
   tmp_buf_.clear();
 
@@ -157,6 +225,19 @@ Status DeltaFileWriter::AppendDelta<REDO>(
   last_key_ = key;
 #endif
 
+  if (delta.is_delete()) {
+    // A row is deleted at most once, but be lenient.
+    if (redo_deleted_rows_.empty() || redo_deleted_rows_.back() != key.row_idx()) {
+      redo_deleted_rows_.push_back(key.row_idx());
+    }
+    if (key.timestamp() > redo_max_delete_timestamp_) {
+      redo_max_delete_timestamp_ = key.timestamp();
+    }
+  } else if (delta.is_reinsert()) {
+    has_redo_reinserts_ = true;
+  } else {
+    has_redo_updates_ = true;
+  }
   return DoAppendDelta(key, delta);
 }
 
@@ -248,6 +329,10 @@ Status DeltaFileReader::InitOnce() {
 
   // Initialize delta file stats
   RETURN_NOT_OK(ReadDeltaStats());
+  if (delta_type_ == REDO) {
+    RETURN_NOT_OK(ReadDeletedRows());
+  }
+  RETURN_NOT_OK(ReadUpdatedRows());
   return Status::OK();
 }
 
@@ -267,6 +352,83 @@ Status DeltaFileReader::ReadDeltaStats() {
   return Status::OK();
 }
 
+Status DeltaFileReader::ReadDeletedRows() {
+  string buf;
+  if (!reader_->GetMetadataEntry(kDeletedRowsEntryName, &buf)) {
+    return Status::OK();
+  }
+
+  Slice input(buf);
+  uint32_t flags;
+  uint64_t max_timestamp;
+  uint32_t count;
+  if (!GetVarint32(&input, &flags) ||
+      !GetVarint64(&input, &max_timestamp) ||
+      !GetVarint32(&input, &count) ||
+      count == 0) {
+    return Status::Corruption("unable to parse the deleted rows of the delta file");
+  }
+  vector<rowid_t> rows;
+  rows.reserve(count);
+  rowid_t row = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t diff;
+    if (!GetVarint32(&input, &diff) || (i > 0 && diff == 0) || row + diff < row) {
+      return Status::Corruption("unable to parse the deleted rows of the delta file");
+    }
+    row += diff;
+    rows.push_back(row);
+  }
+
+  gscoped_ptr<DeletedRows> deleted_rows(new DeletedRows());
+  deleted_rows->first_row = rows.front();
+  deleted_rows->num_rows = rows.back() - rows.front() + 1;
+  deleted_rows->bitmap.resize(BitmapSize(deleted_rows->num_rows));
+  for (rowid_t r : rows) {
+    BitmapSet(deleted_rows->bitmap.data(), r - deleted_rows->first_row);
+  }
+  deleted_rows->max_timestamp = Timestamp(max_timestamp);
+  deleted_rows->deletes_only = flags & kDeletedRowsDeletesOnly;
+  deleted_rows_.swap(deleted_rows);
+  return Status::OK();
+}
+
+Status DeltaFileReader::ReadUpdatedRows() {
+  string buf;
+  if (!reader_->GetMetadataEntry(kUpdatedRowsEntryName, &buf)) {
+    return Status::OK();
+  }
+
+  const Status corruption = Status::Corruption(
+      "unable to parse the updated rows of the delta file");
+  Slice input(buf);
+  uint32_t num_cols;
+  if (!GetVarint32(&input, &num_cols)) {
+    return corruption;
+  }
+  gscoped_ptr<UpdatedRows> updated_rows(new UpdatedRows());
+  for (uint32_t c = 0; c < num_cols; c++) {
+    uint32_t col_id;
+    uint32_t count;
+    if (!GetVarint32(&input, &col_id) || !GetVarint32(&input, &count) || count == 0) {
+      return corruption;
+    }
+    vector<rowid_t>& rows = (*updated_rows)[ColumnId(col_id)];
+    rows.reserve(count);
+    rowid_t row = 0;
+    for (uint32_t i = 0; i < count; i++) {
+      uint32_t diff;
+      if (!GetVarint32(&input, &diff) || (i > 0 && diff == 0) || row + diff < row) {
+        return corruption;
+      }
+      row += diff;
+      rows.push_back(row);
+    }
+  }
+  updated_rows_.swap(updated_rows);
+  return Status::OK();
+}
+
 bool DeltaFileReader::IsRelevantForSnapshot(const MvccSnapshot& snap) const {
   if (!init_once_.init_succeeded()) {
     // If we're not initted, it means we have no delta stats and must
@@ -389,6 +551,9 @@ DeltaFileIterator::DeltaFileIterator(shared_ptr<DeltaFileReader> dfr,
       prepared_(false),
       exhausted_(false),
       initted_(false),
+      needs_seek_(false),
+      prepared_for_apply_(false),
+      use_deleted_rows_(false),
       delta_type_(delta_type),
       cache_blocks_(CFileReader::CACHE_BLOCK) {}
 
@@ -396,8 +561,12 @@ Status DeltaFileIterator::Init(ScanSpec *spec) {
   DCHECK(!initted_) << "Already initted";
 
   if (spec) {
-    cache_blocks_ = spec->cache_blocks() ? CFileReader::CACHE_BLOCK :
-                                           CFileReader::DONT_CACHE_BLOCK;
+    if (spec->cache_blocks()) {
+      cache_blocks_ = CFileReader::CACHE_BLOCK;
+    } else {
+      cache_blocks_ = spec->cache_pages() ? CFileReader::DONT_CACHE_BLOCK :
+                                            CFileReader::DONT_CACHE_BLOCK_OR_PAGES;
+    }
   }
 
   initted_ = true;
@@ -420,6 +589,15 @@ Status DeltaFileIterator::SeekToOrdinal(rowid_t idx) {
     return Status::OK();
   }
 
+  RETURN_NOT_OK(SeekIndex(idx));
+  prepared_idx_ = idx;
+  prepared_count_ = 0;
+  prepared_ = false;
+  prepared_for_apply_ = false;
+  return Status::OK();
+}
+
+Status DeltaFileIterator::SeekIndex(rowid_t idx) {
   if (!index_iter_) {
     index_iter_.reset(IndexTreeIterator::Create(
         dfr_->cfile_reader().get(),
@@ -441,14 +619,35 @@ Status DeltaFileIterator::SeekToOrdinal(rowid_t idx) {
   }
   RETURN_NOT_OK(s);
 
-  prepared_idx_ = idx;
-  prepared_count_ = 0;
-  prepared_ = false;
   delta_blocks_.clear();
   exhausted_ = false;
+  needs_seek_ = false;
   return Status::OK();
 }
 
+bool DeltaFileIterator::CanSkipDeltaBlocks(rowid_t start_row, rowid_t stop_row) const {
+  const DeltaFileReader::UpdatedRows* updated_rows = dfr_->updated_rows_.get();
+  if (!updated_rows) {
+    return false;
+  }
+  // Without the deleted rows, the deletes and reinserts have to be decoded.
+  const DeltaStats& stats = dfr_->delta_stats();
+  if (!use_deleted_rows_ && (stats.delete_count() > 0 || stats.reinsert_count() > 0)) {
+    return false;
+  }
+  for (int i = 0; i < projection_->num_columns(); i++) {
+    const vector<rowid_t>* rows = FindOrNull(*updated_rows, projection_->column_id(i));
+    if (!rows) {
+      continue;
+    }
+    auto it = std::lower_bound(rows->begin(), rows->end(), start_row);
+    if (it != rows->end() && *it <= stop_row) {
+      return false;
+    }
+  }
+  return true;
+}
+
 Status DeltaFileIterator::ReadCurrentBlockOntoQueue() {
   DCHECK(initted_) << "Must call Init()";
   DCHECK(index_iter_) << "Must call SeekToOrdinal()";
@@ -524,6 +723,31 @@ Status DeltaFileIterator::PrepareBatch(size_t nrows, PrepareFlag flag) {
     delta_blocks_.pop_front();
   }
 
+  const DeltaFileReader::DeletedRows* deleted_rows = dfr_->deleted_rows_.get();
+  use_deleted_rows_ = flag == PREPARE_FOR_APPLY && deleted_rows &&
+      !mvcc_snap_.MayHaveUncommittedTransactionsAtOrBefore(deleted_rows->max_timestamp);
+
+  // A range which none of the projected columns update doesn't need its
+  // delta blocks, as long as its deletes are known without them. This keeps
+  // scans of some columns from reading the deltas of the others.
+  if (flag == PREPARE_FOR_APPLY && CanSkipDeltaBlocks(start_row, stop_row)) {
+    delta_blocks_.clear();
+    needs_seek_ = !exhausted_;
+    for (UpdatesForColumn& ufc : updates_by_col_) {
+      ufc.clear();
+    }
+    liveness_changes_.clear();
+    prepared_idx_ = start_row;
+    prepared_count_ = nrows;
+    prepared_ = true;
+    prepared_for_apply_ = true;
+    TRACE_COUNTER_INCREMENT("delta_blocks_skipped_ranges", 1);
+    return Status::OK();
+  }
+  if (needs_seek_) {
+    RETURN_NOT_OK(SeekIndex(start_row));
+  }
+
   while (!exhausted_) {
     rowid_t next_block_rowidx;
     RETURN_NOT_OK(GetFirstRowIndexInCurrentBlock(&next_block_rowidx));
@@ -564,6 +788,21 @@ Status DeltaFileIterator::PrepareBatch(size_t nrows, PrepareFlag flag) {
   prepared_idx_ = start_row;
   prepared_count_ = nrows;
   prepared_ = true;
+  prepared_for_apply_ = false;
+
+  if (flag == PREPARE_FOR_APPLY) {
+    if (use_deleted_rows_ && deleted_rows->deletes_only) {
+      // There's nothing to decode: all there is to apply are the deletes.
+      for (UpdatesForColumn& ufc : updates_by_col_) {
+        ufc.clear();
+      }
+      liveness_changes_.clear();
+    } else {
+      // Decode the mutations once, rather than once per column to apply.
+      RETURN_NOT_OK(DecodePreparedMutations());
+    }
+    prepared_for_apply_ = true;
+  }
   return Status::OK();
 }
 
@@ -661,140 +900,167 @@ inline bool IsUndoRelevant(const MvccSnapshot& snap,
   return true;
 }
 
+// Visitor which decodes each mutation, for later application to the
+// prepared row range. See DeltaFileIterator::DecodeMutation().
 template<DeltaType Type>
-struct ApplyingVisitor {
+struct DecodingVisitor {
 
   Status Visit(const DeltaKey &key, const Slice &deltas, bool* continue_visit);
 
-  inline Status ApplyMutation(const DeltaKey &key, const Slice &deltas) {
-    int64_t rel_idx = key.row_idx() - dfi->prepared_idx_;
-    DCHECK_GE(rel_idx, 0);
-
-    // TODO: this code looks eerily similar to DMSIterator::ApplyUpdates!
-    // I bet it can be combined.
-
-    const Schema* schema = dfi->projection_;
-    RowChangeListDecoder decoder((RowChangeList(deltas)));
-    RETURN_NOT_OK(decoder.Init());
-    if (decoder.is_update() || decoder.is_reinsert()) {
-      return decoder.ApplyToOneColumn(rel_idx, dst, *schema, col_to_apply, dst->arena());
-    }
-
-    DCHECK(decoder.is_delete());
-    // If it's a DELETE, then it will be processed by LivenessVisitor.
-    return Status::OK();
-  }
-
   DeltaFileIterator *dfi;
-  size_t col_to_apply;
-  ColumnBlock *dst;
+
+  // The number of mutations decoded.
+  int64_t num_decoded;
 };
 
 template<>
-inline Status ApplyingVisitor<REDO>::Visit(const DeltaKey& key,
+inline Status DecodingVisitor<REDO>::Visit(const DeltaKey& key,
                                            const Slice& deltas,
                                            bool* continue_visit) {
   if (IsRedoRelevant(dfi->mvcc_snap_, key.timestamp(), continue_visit)) {
-    DVLOG(3) << "Applied redo delta";
-    return ApplyMutation(key, deltas);
+    DVLOG(3) << "Decoded redo delta";
+    num_decoded++;
+    return dfi->DecodeMutation(key, deltas);
   }
-  DVLOG(3) << "Redo delta uncommitted, skipped applying.";
+  DVLOG(3) << "Redo delta uncommitted, skipped decoding.";
   return Status::OK();
 }
 
 template<>
-inline Status ApplyingVisitor<UNDO>::Visit(const DeltaKey& key,
+inline Status DecodingVisitor<UNDO>::Visit(const DeltaKey& key,
                                            const Slice& deltas,
                                            bool* continue_visit) {
   if (IsUndoRelevant(dfi->mvcc_snap_, key.timestamp(), continue_visit)) {
-    DVLOG(3) << "Applied undo delta";
-    return ApplyMutation(key, deltas);
+    DVLOG(3) << "Decoded undo delta";
+    num_decoded++;
+    return dfi->DecodeMutation(key, deltas);
   }
-  DVLOG(3) << "Undo delta committed, skipped applying.";
+  DVLOG(3) << "Undo delta committed, skipped decoding.";
   return Status::OK();
 }
 
-Status DeltaFileIterator::ApplyUpdates(size_t col_to_apply, ColumnBlock *dst) {
-  DCHECK_LE(prepared_count_, dst->nrows());
+Status DeltaFileIterator::DecodeMutation(const DeltaKey& key, const Slice& deltas) {
+  const rowid_t row_idx = key.row_idx();
+  DCHECK_GE(row_idx, prepared_idx_);
 
-  if (delta_type_ == REDO) {
-    DVLOG(3) << "Applying REDO mutations to " << col_to_apply;
-    ApplyingVisitor<REDO> visitor = {this, col_to_apply, dst};
-    return VisitMutations(&visitor);
+  RowChangeListDecoder decoder((RowChangeList(deltas)));
+  RETURN_NOT_OK(decoder.Init());
+  if (decoder.is_delete()) {
+    if (!use_deleted_rows_) {
+      liveness_changes_.push_back({ row_idx, false });
+    }
+    return Status::OK();
+  }
+  if (decoder.is_reinsert()) {
+    liveness_changes_.push_back({ row_idx, true });
+  } else {
+    DCHECK(decoder.is_update());
   }
-  DVLOG(3) << "Applying UNDO mutations to " << col_to_apply;
-  ApplyingVisitor<UNDO> visitor = {this, col_to_apply, dst};
-  return VisitMutations(&visitor);
-}
-
-// Visitor which establishes the liveness of a row by applying deletes and reinserts.
-template<DeltaType Type>
-struct LivenessVisitor {
-
-  Status Visit(const DeltaKey &key, const Slice &deltas, bool* continue_visit);
-
-  inline Status ApplyDelete(const DeltaKey &key, const Slice &deltas) {
-    int64_t rel_idx = key.row_idx() - dfi->prepared_idx_;
-    DCHECK_GE(rel_idx, 0);
 
-    RowChangeListDecoder decoder((RowChangeList(deltas)));
-    RETURN_NOT_OK(decoder.Init());
-    if (decoder.is_update()) {
-      DVLOG(3) << "Didn't delete row (update)";
-      // If this is an update the row must be selected.
-      DCHECK(sel_vec->IsRowSelected(rel_idx));
-      return Status::OK();
+  while (decoder.HasNext()) {
+    RowChangeListDecoder::DecodedUpdate dec;
+    RETURN_NOT_OK(decoder.DecodeNext(&dec));
+    int col_idx;
+    const void* col_val;
+    RETURN_NOT_OK(dec.Validate(*projection_, &col_idx, &col_val));
+    if (col_idx == -1) {
+      // This column isn't being projected.
+      continue;
     }
 
-    if (decoder.is_delete()) {
-      DVLOG(3) << "Row deleted";
-      sel_vec->SetRowUnselected(rel_idx);
-      return Status::OK();
+    // A later mutation of the same cell overwrites the earlier one.
+    UpdatesForColumn& updates = updates_by_col_[col_idx];
+    if (updates.empty() || updates.back().row_id != row_idx) {
+      updates.emplace_back();
+      updates.back().row_id = row_idx;
+    }
+    ColumnUpdate& cu = updates.back();
+    cu.is_null = col_val == nullptr;
+    if (!cu.is_null) {
+      const size_t col_size = projection_->column(col_idx).type_info()->size();
+      DCHECK_LE(col_size, sizeof(cu.new_val_buf));
+      memcpy(cu.new_val_buf, col_val, col_size);
     }
-
-    DCHECK(decoder.is_reinsert());
-    DVLOG(3) << "Re-selected the row (reinsert)";
-    // If this is a reinsert the row must be unselected.
-    DCHECK(!sel_vec->IsRowSelected(rel_idx));
-    sel_vec->SetRowSelected(rel_idx);
-    return Status::OK();
   }
+  return Status::OK();
+}
 
-  DeltaFileIterator *dfi;
-  SelectionVector *sel_vec;
-};
-
-template<>
-inline Status LivenessVisitor<REDO>::Visit(const DeltaKey& key,
-                                           const Slice& deltas,
-                                           bool* continue_visit) {
-  if (IsRedoRelevant(dfi->mvcc_snap_, key.timestamp(), continue_visit)) {
-    return ApplyDelete(key, deltas);
+Status DeltaFileIterator::DecodePreparedMutations() {
+  if (updates_by_col_.empty()) {
+    updates_by_col_.resize(projection_->num_columns());
   }
-  return Status::OK();
+  for (UpdatesForColumn& ufc : updates_by_col_) {
+    ufc.clear();
+  }
+  liveness_changes_.clear();
+  Status s;
+  int64_t num_decoded;
+  if (delta_type_ == REDO) {
+    DecodingVisitor<REDO> visitor = { this, 0 };
+    s = VisitMutations(&visitor);
+    num_decoded = visitor.num_decoded;
+  } else {
+    DecodingVisitor<UNDO> visitor = { this, 0 };
+    s = VisitMutations(&visitor);
+    num_decoded = visitor.num_decoded;
+  }
+  if (num_decoded > 0) {
+    TRACE_COUNTER_INCREMENT(DELTA_MUTATIONS_APPLIED_METRIC_NAME, num_decoded);
+  }
+  return s;
 }
 
-template<>
-inline Status LivenessVisitor<UNDO>::Visit(const DeltaKey& key,
-                                           const Slice& deltas, bool*
-                                           continue_visit) {
-  if (IsUndoRelevant(dfi->mvcc_snap_, key.timestamp(), continue_visit)) {
-    return ApplyDelete(key, deltas);
+Status DeltaFileIterator::ApplyUpdates(size_t col_to_apply, ColumnBlock *dst) {
+  DCHECK(prepared_for_apply_) << "must Prepare for apply";
+  DCHECK_LE(prepared_count_, dst->nrows());
+
+  const ColumnSchema* col_schema = &projection_->column(col_to_apply);
+  for (const ColumnUpdate& cu : updates_by_col_[col_to_apply]) {
+    SimpleConstCell src(col_schema, cu.is_null ? nullptr : cu.new_val_buf);
+    ColumnBlock::Cell dst_cell = dst->cell(cu.row_id - prepared_idx_);
+    RETURN_NOT_OK(CopyCell(src, &dst_cell, dst->arena()));
   }
   return Status::OK();
 }
 
+void DeltaFileIterator::GetPreparedDeletedRowsRange(size_t* start, size_t* end) const {
+  const DeltaFileReader::DeletedRows& deleted_rows = *dfr_->deleted_rows_;
+  const uint64_t first_row = deleted_rows.first_row;
+  const uint64_t last_row = first_row + deleted_rows.num_rows;
+  const uint64_t batch_start = std::min<uint64_t>(prepared_idx_, last_row);
+  const uint64_t batch_end = std::min<uint64_t>(prepared_idx_ + prepared_count_, last_row);
+  *start = std::max(batch_start, first_row) - first_row;
+  *end = std::max(batch_end, first_row) - first_row;
+}
 
 Status DeltaFileIterator::ApplyDeletes(SelectionVector *sel_vec) {
+  DCHECK(prepared_for_apply_) << "must Prepare for apply";
   DCHECK_LE(prepared_count_, sel_vec->nrows());
-  if (delta_type_ == REDO) {
-    DVLOG(3) << "Applying REDO deletes";
-    LivenessVisitor<REDO> visitor = { this, sel_vec };
-    return VisitMutations(&visitor);
+
+  if (use_deleted_rows_) {
+    const DeltaFileReader::DeletedRows& deleted_rows = *dfr_->deleted_rows_;
+    size_t idx;
+    size_t end;
+    GetPreparedDeletedRowsRange(&idx, &end);
+    while (BitmapFindFirstSet(deleted_rows.bitmap.data(), idx, end, &idx)) {
+      sel_vec->SetRowUnselected(deleted_rows.first_row + idx - prepared_idx_);
+      idx++;
+    }
   }
-  DVLOG(3) << "Applying UNDO deletes";
-  LivenessVisitor<UNDO> visitor = { this, sel_vec };
-  return VisitMutations(&visitor);
+
+  for (const LivenessChange& lc : liveness_changes_) {
+    const rowid_t rel_idx = lc.row_id - prepared_idx_;
+    if (lc.is_reinsert) {
+      DVLOG(3) << "Re-selected the row (reinsert)";
+      // If this is a reinsert the row must be unselected.
+      DCHECK(!sel_vec->IsRowSelected(rel_idx));
+      sel_vec->SetRowSelected(rel_idx);
+    } else {
+      DVLOG(3) << "Row deleted";
+      sel_vec->SetRowUnselected(rel_idx);
+    }
+  }
+  return Status::OK();
 }
 
 // Visitor which, for each mutation, adds it into a ColumnBlock of
@@ -858,13 +1124,20 @@ bool DeltaFileIterator::HasNext() {
 bool DeltaFileIterator::MayHaveDeltas() {
   // TODO: change the API to take in the col_to_apply and check for deltas on
   // that column only.
-  DCHECK(prepared_) << "must Prepare";
-  for (auto& block : delta_blocks_) {
-    BinaryPlainBlockDecoder& bpd = *block->decoder_;
-    if (PREDICT_FALSE(prepared_idx_ > block->last_updated_idx_)) {
-      continue;
+  DCHECK(prepared_for_apply_) << "must Prepare for apply";
+  if (!liveness_changes_.empty()) {
+    return true;
+  }
+  if (use_deleted_rows_) {
+    size_t start;
+    size_t end;
+    GetPreparedDeletedRowsRange(&start, &end);
+    if (start < end && !BitmapIsAllZero(dfr_->deleted_rows_->bitmap.data(), start, end)) {
+      return true;
     }
-    if (block->prepared_block_start_idx_ < bpd.Count()) {
+  }
+  for (const auto& col : updates_by_col_) {
+    if (!col.empty()) {
       return true;
     }
   }
@@ -20,8 +20,10 @@
 #include <cstddef>
 #include <cstdint>
 #include <deque>
+#include <map>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <glog/logging.h>
@@ -33,6 +35,8 @@
 #include "kudu/cfile/cfile_writer.h"
 #include "kudu/cfile/index_btree.h"
 #include "kudu/common/rowid.h"
+#include "kudu/common/schema.h" // IWYU pragma: keep
+#include "kudu/common/timestamp.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/port.h"
@@ -57,7 +61,6 @@ class RowChangeList;
 class ScanSpec;
 class Schema;
 class SelectionVector;
-struct ColumnId;
 
 namespace cfile {
 struct ReaderOptions;
@@ -73,11 +76,9 @@ namespace tablet {
 
 class Mutation;
 template<DeltaType Type>
-struct ApplyingVisitor;
-template<DeltaType Type>
 struct CollectingVisitor;
 template<DeltaType Type>
-struct LivenessVisitor;
+struct DecodingVisitor;
 
 class DeltaFileWriter {
  public:
@@ -111,8 +112,31 @@ class DeltaFileWriter {
  private:
   Status DoAppendDelta(const DeltaKey &key, const RowChangeList &delta);
 
+  // Records the rows deleted by the REDO deltas in the file's metadata, so
+  // that scans may skip them without decoding the deltas. See
+  // DeltaFileReader::DeletedRows.
+  void WriteDeletedRows();
+
+  // Records the rows updated in each column in the file's metadata, so that
+  // scans may skip the delta blocks which don't update any of the columns
+  // they project. See DeltaFileReader::UpdatedRows.
+  void WriteUpdatedRows();
+
   std::unique_ptr<cfile::CFileWriter> writer_;
 
+  // The rows deleted by the REDO deltas appended so far, in ascending order,
+  // and the timestamp of the latest of those deletes.
+  std::vector<rowid_t> redo_deleted_rows_;
+  Timestamp redo_max_delete_timestamp_;
+
+  // Whether any REDO deltas other than deletes were appended.
+  bool has_redo_updates_;
+  bool has_redo_reinserts_;
+
+  // The rows updated or reinserted by the deltas appended so far, in
+  // ascending order, by column.
+  std::map<ColumnId, std::vector<rowid_t>> updated_rows_by_col_;
+
   // Buffer used as a temporary for storing the serialized form
   // of the deltas
   faststring tmp_buf_;
@@ -132,6 +156,8 @@ class DeltaFileReader : public DeltaStore,
                         public std::enable_shared_from_this<DeltaFileReader> {
  public:
   static const char * const kDeltaStatsEntryName;
+  static const char * const kDeletedRowsEntryName;
+  static const char * const kUpdatedRowsEntryName;
 
   // Fully open a delta file using a previously opened block.
   //
@@ -207,9 +233,38 @@ class DeltaFileReader : public DeltaStore,
 
   Status ReadDeltaStats();
 
+  Status ReadDeletedRows();
+
+  Status ReadUpdatedRows();
+
   std::shared_ptr<cfile::CFileReader> reader_;
   gscoped_ptr<DeltaStats> delta_stats_;
 
+  // The rows deleted by a REDO delta file, as recorded by DeltaFileWriter.
+  // Files with reinserts, and files written before deleted rows were
+  // recorded, have none.
+  struct DeletedRows {
+    // Bit 'i' of 'bitmap' is set if the row 'first_row + i' is deleted, for
+    // 'i' in [0, 'num_rows').
+    rowid_t first_row;
+    rowid_t num_rows;
+    std::vector<uint8_t> bitmap;
+
+    // The timestamp of the latest delete. Snapshots which include every
+    // transaction up to it see all of the rows as deleted.
+    Timestamp max_timestamp;
+
+    // Whether the file contains nothing but deletes.
+    bool deletes_only;
+  };
+  gscoped_ptr<DeletedRows> deleted_rows_;
+
+  // The rows updated or reinserted in each column by the deltas of the file,
+  // in ascending order, as recorded by DeltaFileWriter. Files written before
+  // updated rows were recorded have none.
+  typedef std::unordered_map<ColumnId, std::vector<rowid_t>> UpdatedRows;
+  gscoped_ptr<UpdatedRows> updated_rows_;
+
   // The type of this delta, i.e. UNDO or REDO.
   const DeltaType delta_type_;
 
@@ -237,12 +292,10 @@ class DeltaFileIterator : public DeltaIterator {
 
  private:
   friend class DeltaFileReader;
-  friend struct ApplyingVisitor<REDO>;
-  friend struct ApplyingVisitor<UNDO>;
   friend struct CollectingVisitor<REDO>;
   friend struct CollectingVisitor<UNDO>;
-  friend struct LivenessVisitor<REDO>;
-  friend struct LivenessVisitor<UNDO>;
+  friend struct DecodingVisitor<REDO>;
+  friend struct DecodingVisitor<UNDO>;
   friend struct FilterAndAppendVisitor;
 
   DISALLOW_COPY_AND_ASSIGN(DeltaFileIterator);
@@ -290,6 +343,16 @@ class DeltaFileIterator : public DeltaIterator {
                     const Schema *projection, MvccSnapshot snap,
                     DeltaType delta_type);
 
+  // Positions 'index_iter_' at the delta block which may hold the first
+  // deltas of row 'idx', dropping the blocks read so far.
+  Status SeekIndex(rowid_t idx);
+
+  // Returns whether the range [start_row, stop_row] may be prepared for
+  // apply without reading its delta blocks: its deletes are known from the
+  // reader's deleted rows, and none of the projected columns are updated.
+  // Must be called after 'use_deleted_rows_' is set.
+  bool CanSkipDeltaBlocks(rowid_t start_row, rowid_t stop_row) const;
+
   // Determine the row index of the first update in the block currently
   // pointed to by index_iter_.
   Status GetFirstRowIndexInCurrentBlock(rowid_t *idx);
@@ -307,6 +370,19 @@ class DeltaFileIterator : public DeltaIterator {
   template<class Visitor>
   Status VisitMutations(Visitor *visitor);
 
+  // Decodes the mutations of the prepared row range which are relevant to the
+  // snapshot, replacing those previously decoded.
+  Status DecodePreparedMutations();
+
+  // Returns the range [*start, *end) of the bits of the reader's deleted
+  // rows bitmap that correspond to the prepared rows.
+  void GetPreparedDeletedRowsRange(size_t* start, size_t* end) const;
+
+  // Decodes a mutation relevant to the snapshot into 'updates_by_col_' and
+  // 'liveness_changes_'. Mutations must be decoded in the order in which
+  // they're to be applied.
+  Status DecodeMutation(const DeltaKey& key, const Slice& deltas);
+
   // Log a FATAL error message about a bad delta.
   void FatalUnexpectedDelta(const DeltaKey &key, const Slice &deltas,
                             const std::string &msg);
@@ -328,10 +404,46 @@ class DeltaFileIterator : public DeltaIterator {
   bool exhausted_;
   bool initted_;
 
+  // Set when the delta blocks of a prepared range were skipped, so that
+  // 'index_iter_' must be positioned again before reading the next blocks.
+  bool needs_seek_;
+
   // After PrepareBatch(), the set of delta blocks in the delta file
   // which correspond to prepared_block_.
   std::deque<std::unique_ptr<PreparedDeltaBlock>> delta_blocks_;
 
+  // State when prepared with PREPARE_FOR_APPLY: the mutations of the
+  // prepared row range, decoded once so that they can be applied to each
+  // column without decoding them again.
+  // ------------------------------------------------------------
+  bool prepared_for_apply_;
+
+  // Whether the deletes of the prepared rows are taken from the reader's
+  // deleted rows bitmap, rather than decoded from the deltas. Set when the
+  // snapshot includes every delete in the file.
+  bool use_deleted_rows_;
+
+  // The latest value of a cell.
+  struct ColumnUpdate {
+    rowid_t row_id;
+    bool is_null;
+
+    // The cell's new value, if not null. Indirect data points into the
+    // delta blocks in 'delta_blocks_'.
+    uint8_t new_val_buf[16];
+  };
+
+  // The updates to each column in the projection, in row order.
+  typedef std::vector<ColumnUpdate> UpdatesForColumn;
+  std::vector<UpdatesForColumn> updates_by_col_;
+
+  // The deletes and reinserts of the prepared rows, in the order they apply.
+  struct LivenessChange {
+    rowid_t row_id;
+    bool is_reinsert;
+  };
+  std::vector<LivenessChange> liveness_changes_;
+
   // Temporary buffer used in seeking.
   faststring tmp_buf_;
 
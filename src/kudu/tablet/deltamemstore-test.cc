@@ -23,6 +23,7 @@
 #include <memory>
 #include <ostream>
 #include <string>
+#include <thread>
 #include <unordered_set>
 #include <utility>
 #include <vector>
@@ -32,6 +33,7 @@
 #include <gtest/gtest.h>
 
 #include "kudu/clock/clock.h"
+#include "kudu/cfile/cfile_util.h"
 #include "kudu/clock/logical_clock.h"
 #include "kudu/common/columnblock.h"
 #include "kudu/common/common.pb.h"
@@ -42,12 +44,15 @@
 #include "kudu/consensus/log_anchor_registry.h"
 #include "kudu/consensus/opid.pb.h"
 #include "kudu/consensus/opid_util.h"
+#include "kudu/fs/block_id.h"
 #include "kudu/fs/block_manager.h"
 #include "kudu/fs/fs_manager.h"
 #include "kudu/gutil/casts.h"
 #include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/map-util.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/ref_counted.h"
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/tablet/delta_stats.h"
 #include "kudu/tablet/delta_store.h"
 #include "kudu/tablet/deltafile.h"
@@ -57,6 +62,7 @@
 #include "kudu/util/faststring.h"
 #include "kudu/util/mem_tracker.h"
 #include "kudu/util/memory/arena.h"
+#include "kudu/util/random.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/status.h"
 #include "kudu/util/stopwatch.h"
@@ -64,9 +70,11 @@
 #include "kudu/util/test_util.h"
 
 DEFINE_int32(benchmark_num_passes, 100, "Number of passes to apply deltas in the benchmark");
+DECLARE_int32(deltamemstore_num_partitions);
 
 using std::shared_ptr;
 using std::string;
+using std::thread;
 using std::unique_ptr;
 using std::unordered_set;
 using std::vector;
@@ -74,7 +82,10 @@ using std::vector;
 namespace kudu {
 namespace tablet {
 
+using cfile::ReaderOptions;
+using fs::ReadableBlock;
 using fs::WritableBlock;
+using strings::Substitute;
 
 class TestDeltaMemStore : public KuduTest {
  public:
@@ -242,6 +253,127 @@ TEST_F(TestDeltaMemStore, TestDMSSparseUpdates) {
   }
 }
 
+// Test that the updates of a DMS partitioned into several trees are read back
+// and flushed in row order.
+TEST_F(TestDeltaMemStore, TestPartitionedUpdates) {
+  FLAGS_deltamemstore_num_partitions = 4;
+  ASSERT_OK(DeltaMemStore::Create(0, 0, new log::LogAnchorRegistry(),
+                                  MemTracker::GetRootTracker(), &dms_));
+  ASSERT_EQ(4, dms_->num_partitions());
+
+  srand(12345);
+  unordered_set<uint32_t> indexes_to_update;
+  GenerateRandomIndexes(1000, 400, &indexes_to_update);
+  UpdateIntsAtIndexes(indexes_to_update);
+  // Update some rows twice, so that they have several deltas.
+  UpdateIntsAtIndexes(vector<uint32_t>({ 0, 63, 64, 500, 999 }));
+  int num_updated = indexes_to_update.size();
+  for (uint32_t idx : { 0, 63, 64, 500, 999 }) {
+    num_updated += ContainsKey(indexes_to_update, idx) ? 1 : 2;
+    indexes_to_update.insert(idx);
+  }
+  ASSERT_EQ(num_updated, dms_->Count());
+
+  // Read back the updates from the start and from the middle.
+  MvccSnapshot snap(mvcc_);
+  for (uint32_t start_row : { 0, 130 }) {
+    SCOPED_TRACE(start_row);
+    const int nrows = 1000 - start_row;
+    ScopedColumnBlock<UINT32> read_back(nrows);
+    for (int i = 0; i < nrows; i++) {
+      read_back[i] = 0xDEADBEEF;
+    }
+    NO_FATALS(ApplyUpdates(snap, start_row, kIntColumn, &read_back));
+    for (int i = 0; i < nrows; i++) {
+      const uint32_t row_idx = start_row + i;
+      if (ContainsKey(indexes_to_update, row_idx)) {
+        ASSERT_EQ(row_idx * 10, read_back[i]);
+      } else {
+        ASSERT_EQ(0xDEADBEEF, read_back[i]);
+      }
+    }
+  }
+
+  // The flush merges the trees back into (rowid, timestamp) order.
+  unique_ptr<WritableBlock> block;
+  ASSERT_OK(fs_manager_->CreateNewBlock({}, &block));
+  BlockId block_id = block->id();
+  DeltaFileWriter dfw(std::move(block));
+  ASSERT_OK(dfw.Start());
+  gscoped_ptr<DeltaStats> stats;
+  ASSERT_OK(dms_->FlushToFile(&dfw, &stats));
+  ASSERT_EQ(num_updated, stats->update_count_for_col_id(schema_.column_id(kIntColumn)));
+  dfw.WriteDeltaStats(*stats);
+  ASSERT_OK(dfw.Finish());
+
+  unique_ptr<ReadableBlock> read_block;
+  ASSERT_OK(fs_manager_->OpenBlock(block_id, &read_block));
+  shared_ptr<DeltaFileReader> reader;
+  ASSERT_OK(DeltaFileReader::Open(std::move(read_block), REDO, ReaderOptions(), &reader));
+  DeltaIterator* raw_iter;
+  ASSERT_OK(reader->NewDeltaIterator(
+      &schema_, MvccSnapshot::CreateSnapshotIncludingAllTransactions(), &raw_iter));
+  gscoped_ptr<DeltaIterator> iter(raw_iter);
+  ASSERT_OK(iter->Init(nullptr));
+  ASSERT_OK(iter->SeekToOrdinal(0));
+  ASSERT_OK(iter->PrepareBatch(1000, DeltaIterator::PREPARE_FOR_COLLECT));
+  Arena arena(1024);
+  vector<DeltaKeyAndUpdate> deltas;
+  ASSERT_OK(iter->FilterColumnIdsAndCollectDeltas(vector<ColumnId>(), &deltas, &arena));
+  ASSERT_EQ(num_updated, deltas.size());
+  unordered_set<uint32_t> flushed_rows;
+  for (int i = 0; i < deltas.size(); i++) {
+    if (i > 0) {
+      ASSERT_LT(deltas[i - 1].key.CompareTo<REDO>(deltas[i].key), 0)
+          << deltas[i - 1].key.ToString() << " flushed before " << deltas[i].key.ToString();
+    }
+    flushed_rows.insert(deltas[i].key.row_idx());
+  }
+  ASSERT_EQ(indexes_to_update, flushed_rows);
+}
+
+// Benchmark for concurrent updates of a small set of hot rows, as in
+// counter workloads, with and without partitioning the DMS.
+TEST_F(TestDeltaMemStore, BenchmarkConcurrentHotRowUpdates) {
+  const int kNumThreads = 8;
+  const int kNumHotRows = 2000;
+  const int kUpdatesPerThread = AllowSlowTests() ? 200000 : 20000;
+
+  for (int num_partitions : { 1, 8 }) {
+    FLAGS_deltamemstore_num_partitions = num_partitions;
+    ASSERT_OK(DeltaMemStore::Create(0, 0, new log::LogAnchorRegistry(),
+                                    MemTracker::GetRootTracker(), &dms_));
+    ASSERT_OK(dms_->Init());
+
+    Stopwatch sw;
+    sw.start();
+    vector<thread> threads;
+    for (int t = 0; t < kNumThreads; t++) {
+      threads.emplace_back([&, t]() {
+        Random rng(t);
+        faststring buf;
+        RowChangeListEncoder update(&buf);
+        for (int i = 0; i < kUpdatesPerThread; i++) {
+          update.Reset();
+          uint32_t row_idx = rng.Uniform(kNumHotRows);
+          uint32_t new_val = i;
+          update.AddColumnUpdate(schema_.column(kIntColumn),
+                                 schema_.column_id(kIntColumn), &new_val);
+          CHECK_OK(dms_->Update(clock_->Now(), row_idx, RowChangeList(buf), op_id_));
+        }
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    sw.stop();
+
+    ASSERT_EQ(kNumThreads * kUpdatesPerThread, dms_->Count());
+    LOG(INFO) << Substitute("$0 partitions: $1 updates/sec", num_partitions,
+                            kNumThreads * kUpdatesPerThread / sw.elapsed().wall_seconds());
+  }
+}
+
 // Performance test for KUDU-749: zipfian workloads can cause a lot
 // of updates to a single row. This benchmark updates a single row many
 // times and times how long it takes to apply those updates during
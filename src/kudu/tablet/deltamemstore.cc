@@ -15,10 +15,12 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <algorithm>
 #include <cstring>
 #include <ostream>
 #include <utility>
 
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 
 #include "kudu/common/columnblock.h"
@@ -36,9 +38,20 @@
 #include "kudu/tablet/mutation.h"
 #include "kudu/tablet/mvcc.h"
 #include "kudu/util/debug-util.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/memcmpable_varint.h"
 #include "kudu/util/memory/memory.h"
 #include "kudu/util/status.h"
+#include "kudu/util/trace.h"
+
+DEFINE_int32(deltamemstore_num_partitions, 1,
+             "Number of partitions, each with its own tree and arena, to spread "
+             "the updates of each delta memstore over by row index. More "
+             "partitions reduce the contention between concurrent updates of a "
+             "set of hot rows, e.g. of counters, at the cost of merging them when "
+             "scanning and flushing.");
+TAG_FLAG(deltamemstore_num_partitions, experimental);
+TAG_FLAG(deltamemstore_num_partitions, advanced);
 
 namespace kudu {
 namespace tablet {
@@ -75,12 +88,58 @@ DeltaMemStore::DeltaMemStore(int64_t id,
   : id_(id),
     rs_id_(rs_id),
     allocator_(new MemoryTrackingBufferAllocator(
-        HeapBufferAllocator::Get(), std::move(parent_tracker))),
-    arena_(new ThreadSafeMemoryTrackingArena(kInitialArenaSize, allocator_)),
-    tree_(arena_),
+        HugePageBufferAllocator::Get(), std::move(parent_tracker))),
     anchorer_(log_anchor_registry,
               Substitute("Rowset-$0/DeltaMemStore-$1", rs_id_, id_)),
-    disambiguator_sequence_number_(0) {
+    disambiguator_sequence_number_(0),
+    deleted_row_count_(0) {
+  const int num_partitions = std::max(FLAGS_deltamemstore_num_partitions, 1);
+  partitions_.reserve(num_partitions);
+  for (int i = 0; i < num_partitions; i++) {
+    partitions_.emplace_back(new Partition(allocator_));
+  }
+}
+
+DeltaMemStore::Partition::Partition(
+    const shared_ptr<MemoryTrackingBufferAllocator>& allocator)
+    : arena(new ThreadSafeMemoryTrackingArena(kInitialArenaSize, allocator)),
+      tree(arena) {
+}
+
+DeltaMemStore::DMSTree* DeltaMemStore::TreeForRow(rowid_t row_idx) const {
+  if (partitions_.size() == 1) {
+    return &partitions_[0]->tree;
+  }
+  return &partitions_[row_idx % partitions_.size()]->tree;
+}
+
+uint64_t DeltaMemStore::EstimateSize() const {
+  uint64_t size = 0;
+  for (const auto& partition : partitions_) {
+    size += partition->arena->memory_footprint();
+  }
+  return size;
+}
+
+DMSMergedTreeIter* DeltaMemStore::NewMergedIterator() const {
+  return new DMSMergedTreeIter(*this);
+}
+
+size_t DeltaMemStore::Count() const {
+  size_t count = 0;
+  for (const auto& partition : partitions_) {
+    count += partition->tree.count();
+  }
+  return count;
+}
+
+bool DeltaMemStore::Empty() const {
+  for (const auto& partition : partitions_) {
+    if (!partition->tree.empty()) {
+      return false;
+    }
+  }
+  return true;
 }
 
 Status DeltaMemStore::Init() {
@@ -98,8 +157,9 @@ Status DeltaMemStore::Update(Timestamp timestamp,
   key.EncodeTo(&buf);
 
   Slice key_slice(buf);
+  DMSTree* tree = TreeForRow(row_idx);
   btree::PreparedMutation<DMSTreeTraits> mutation(key_slice);
-  mutation.Prepare(&tree_);
+  mutation.Prepare(tree);
   if (PREDICT_FALSE(mutation.exists())) {
     // We already have a delta for this row at the same timestamp.
     // Try again with a disambiguating sequence number appended to the key.
@@ -107,7 +167,7 @@ Status DeltaMemStore::Update(Timestamp timestamp,
     PutMemcmpableVarint64(&buf, seq);
     key_slice = Slice(buf);
     mutation.Reset(key_slice);
-    mutation.Prepare(&tree_);
+    mutation.Prepare(tree);
     CHECK(!mutation.exists())
       << "Appended a sequence number but still hit a duplicate "
       << "for rowid " << row_idx << " at timestamp " << timestamp;
@@ -116,6 +176,10 @@ Status DeltaMemStore::Update(Timestamp timestamp,
     return Status::IOError("Unable to insert into tree");
   }
 
+  if (update.is_delete()) {
+    deleted_row_count_.Increment();
+  }
+
   anchorer_.AnchorIfMinimum(op_id.index());
 
   return Status::OK();
@@ -125,7 +189,7 @@ Status DeltaMemStore::FlushToFile(DeltaFileWriter *dfw,
                                   gscoped_ptr<DeltaStats>* stats_ret) {
   gscoped_ptr<DeltaStats> stats(new DeltaStats());
 
-  gscoped_ptr<DMSTreeIter> iter(tree_.NewIterator());
+  gscoped_ptr<DMSMergedTreeIter> iter(NewMergedIterator());
   iter->SeekToStart();
   while (iter->IsValid()) {
     Slice key_slice, val;
@@ -160,8 +224,9 @@ Status DeltaMemStore::CheckRowDeleted(rowid_t row_idx, bool *deleted) const {
 
   bool exact;
 
+  // All the deltas of the row are in the same tree.
   // TODO(unknown): can we avoid the allocation here?
-  gscoped_ptr<DMSTreeIter> iter(tree_.NewIterator());
+  gscoped_ptr<DMSTreeIter> iter(TreeForRow(row_idx)->NewIterator());
   if (!iter->SeekAtOrAfter(key_slice, &exact)) {
     return Status::OK();
   }
@@ -187,7 +252,65 @@ Status DeltaMemStore::CheckRowDeleted(rowid_t row_idx, bool *deleted) const {
 }
 
 void DeltaMemStore::DebugPrint() const {
-  tree_.DebugPrint();
+  for (const auto& partition : partitions_) {
+    partition->tree.DebugPrint();
+  }
+}
+
+////////////////////////////////////////////////////////////
+// DMSMergedTreeIter
+////////////////////////////////////////////////////////////
+
+DMSMergedTreeIter::DMSMergedTreeIter(const DeltaMemStore& dms)
+    : cur_(nullptr) {
+  iters_.reserve(dms.partitions_.size());
+  for (const auto& partition : dms.partitions_) {
+    iters_.emplace_back(partition->tree.NewIterator());
+  }
+}
+
+void DMSMergedTreeIter::SeekToStart() {
+  for (auto& iter : iters_) {
+    iter->SeekToStart();
+  }
+  FindLowest();
+}
+
+bool DMSMergedTreeIter::SeekAtOrAfter(const Slice& key, bool* exact) {
+  *exact = false;
+  for (auto& iter : iters_) {
+    bool iter_exact;
+    iter->SeekAtOrAfter(key, &iter_exact);
+    *exact |= iter_exact;
+  }
+  FindLowest();
+  return IsValid();
+}
+
+void DMSMergedTreeIter::Next() {
+  DCHECK(cur_);
+  cur_->Next();
+  FindLowest();
+}
+
+void DMSMergedTreeIter::FindLowest() {
+  cur_ = nullptr;
+  Slice lowest_key;
+  for (auto& iter : iters_) {
+    if (!iter->IsValid()) {
+      continue;
+    }
+    // Single-tree fast path: no key to compare.
+    if (iters_.size() == 1) {
+      cur_ = iter.get();
+      return;
+    }
+    Slice key = iter->GetCurrentKey();
+    if (cur_ == nullptr || key.compare(lowest_key) < 0) {
+      cur_ = iter.get();
+      lowest_key = key;
+    }
+  }
 }
 
 ////////////////////////////////////////////////////////////
@@ -198,7 +321,7 @@ DMSIterator::DMSIterator(const shared_ptr<const DeltaMemStore>& dms,
                          const Schema* projection, MvccSnapshot snapshot)
     : dms_(dms),
       mvcc_snapshot_(std::move(snapshot)),
-      iter_(dms->tree_.NewIterator()),
+      iter_(dms->NewMergedIterator()),
       initted_(false),
       prepared_idx_(0),
       prepared_count_(0),
@@ -251,6 +374,7 @@ Status DMSIterator::PrepareBatch(size_t nrows, PrepareFlag flag) {
   deleted_.clear();
   prepared_deltas_.clear();
 
+  int64_t num_applied = 0;
   while (iter_->IsValid()) {
     Slice key_slice, val;
     iter_->GetCurrentEntry(&key_slice, &val);
@@ -267,6 +391,7 @@ Status DMSIterator::PrepareBatch(size_t nrows, PrepareFlag flag) {
     }
 
     if (flag == PREPARE_FOR_APPLY) {
+      num_applied++;
       RowChangeListDecoder decoder((RowChangeList(val)));
       decoder.InitNoSafetyChecks();
       DCHECK(!decoder.is_reinsert()) << "Reinserts are not supported in the DeltaMemStore.";
@@ -315,6 +440,9 @@ Status DMSIterator::PrepareBatch(size_t nrows, PrepareFlag flag) {
 
     iter_->Next();
   }
+  if (num_applied > 0) {
+    TRACE_COUNTER_INCREMENT(DELTA_MUTATIONS_APPLIED_METRIC_NAME, num_applied);
+  }
   prepared_idx_ = start_row;
   prepared_count_ = nrows;
   prepared_for_ = flag == PREPARE_FOR_APPLY ? PREPARED_FOR_APPLY : PREPARED_FOR_COLLECT;
@@ -62,6 +62,7 @@ class OpId;
 namespace tablet {
 
 class DeltaFileWriter;
+class DMSMergedTreeIter;
 class Mutation;
 
 struct DMSTreeTraits : public btree::BTreeTraits {
@@ -71,6 +72,13 @@ struct DMSTreeTraits : public btree::BTreeTraits {
 // In-memory storage for data which has been recently updated.
 // This essentially tracks a 'diff' per row, which contains the
 // modified columns.
+//
+// The deltas may be spread over several partitions, as per
+// --deltamemstore_num_partitions, each with its own tree and arena, so that
+// concurrent updates of a set of hot rows don't all contend on the same
+// leaves and arena: rows are assigned to the partitions by row index modulo
+// their number, which spreads neighbouring rows. Readers merge the trees
+// back into (rowid, timestamp) order.
 
 class DeltaMemStore : public DeltaStore,
                       public std::enable_shared_from_this<DeltaMemStore> {
@@ -93,12 +101,13 @@ class DeltaMemStore : public DeltaStore,
                 const RowChangeList &update,
                 const consensus::OpId& op_id);
 
-  size_t Count() const {
-    return tree_.count();
-  }
+  size_t Count() const;
 
-  bool Empty() const {
-    return tree_.empty();
+  bool Empty() const;
+
+  // Returns the number of rows deleted by the deltas of this DMS.
+  int64_t deleted_row_count() const {
+    return deleted_row_count_.Load();
   }
 
   // Dump a debug version of the tree to the logs. This is not thread-safe, so
@@ -127,15 +136,18 @@ class DeltaMemStore : public DeltaStore,
 
   virtual Status CheckRowDeleted(rowid_t row_idx, bool *deleted) const OVERRIDE;
 
-  virtual uint64_t EstimateSize() const OVERRIDE {
-    return arena_->memory_footprint();
-  }
+  virtual uint64_t EstimateSize() const OVERRIDE;
 
   const int64_t id() const { return id_; }
 
   typedef btree::CBTree<DMSTreeTraits> DMSTree;
   typedef btree::CBTreeIterator<DMSTreeTraits> DMSTreeIter;
 
+  // The number of partitions the deltas are spread over.
+  int num_partitions() const {
+    return partitions_.size();
+  }
+
   virtual std::string ToString() const OVERRIDE {
     return "DMS";
   }
@@ -152,25 +164,34 @@ class DeltaMemStore : public DeltaStore,
 
  private:
   friend class DMSIterator;
+  friend class DMSMergedTreeIter;
 
   DeltaMemStore(int64_t id,
                 int64_t rs_id,
                 log::LogAnchorRegistry* log_anchor_registry,
                 std::shared_ptr<MemTracker> parent_tracker);
 
-  const DMSTree& tree() const {
-    return tree_;
-  }
+  // Returns the tree storing the deltas of the row 'row_idx'.
+  DMSTree* TreeForRow(rowid_t row_idx) const;
+
+  // Returns a new iterator over the deltas of all the trees.
+  DMSMergedTreeIter* NewMergedIterator() const;
 
   const int64_t id_;    // DeltaMemStore ID.
   const int64_t rs_id_; // Rowset ID.
 
   std::shared_ptr<MemoryTrackingBufferAllocator> allocator_;
 
-  std::shared_ptr<ThreadSafeMemoryTrackingArena> arena_;
+  // A concurrent B-Tree storing <key index> -> RowChangeList, and the
+  // arena it allocates its nodes and deltas from. The deltas of row R are
+  // stored in partition R % partitions_.size().
+  struct Partition {
+    explicit Partition(const std::shared_ptr<MemoryTrackingBufferAllocator>& allocator);
 
-  // Concurrent B-Tree storing <key index> -> RowChangeList
-  DMSTree tree_;
+    std::shared_ptr<ThreadSafeMemoryTrackingArena> arena;
+    DMSTree tree;
+  };
+  std::vector<std::unique_ptr<Partition>> partitions_;
 
   log::MinLogIndexAnchorer anchorer_;
 
@@ -184,9 +205,49 @@ class DeltaMemStore : public DeltaStore,
   // number, and is only used in the case that such a collision occurs.
   AtomicInt<Atomic32> disambiguator_sequence_number_;
 
+  // The number of DELETE deltas. A row can only be deleted once in a DMS:
+  // a deleted row of a DiskRowSet is never reinserted into it.
+  AtomicInt<int64_t> deleted_row_count_;
+
   DISALLOW_COPY_AND_ASSIGN(DeltaMemStore);
 };
 
+// Iterator over the entries of all the trees of a DeltaMemStore, in key
+// order. With a single tree, it's a thin wrapper over the tree's iterator.
+class DMSMergedTreeIter {
+ public:
+  explicit DMSMergedTreeIter(const DeltaMemStore& dms);
+
+  void SeekToStart();
+
+  // Seeks each tree to the first key at or after 'key'. Returns false if
+  // there is no such key in any of the trees. Sets 'exact' to whether the
+  // first such key is 'key'.
+  bool SeekAtOrAfter(const Slice& key, bool* exact);
+
+  bool IsValid() const {
+    return cur_ != nullptr;
+  }
+
+  void GetCurrentEntry(Slice* key, Slice* val) const {
+    cur_->GetCurrentEntry(key, val);
+  }
+
+  void Next();
+
+ private:
+  // Points 'cur_' to the valid iterator with the lowest key, if any.
+  void FindLowest();
+
+  std::vector<std::unique_ptr<DeltaMemStore::DMSTreeIter>> iters_;
+
+  // The iterator positioned at the lowest key, or NULL if all the iterators
+  // are exhausted.
+  DeltaMemStore::DMSTreeIter* cur_;
+
+  DISALLOW_COPY_AND_ASSIGN(DMSMergedTreeIter);
+};
+
 // Iterator over the deltas currently in the delta memstore.
 // This iterator is a wrapper around the underlying tree iterator
 // which snapshots sets of deltas on a per-block basis, and allows
@@ -238,7 +299,7 @@ class DMSIterator : public DeltaIterator {
   // MVCC state which allows us to ignore uncommitted transactions.
   const MvccSnapshot mvcc_snapshot_;
 
-  gscoped_ptr<DeltaMemStore::DMSTreeIter> iter_;
+  gscoped_ptr<DMSMergedTreeIter> iter_;
 
   bool initted_;
 
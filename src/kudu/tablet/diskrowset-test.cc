@@ -22,6 +22,7 @@
 #include <string>
 #include <type_traits>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include <gflags/gflags.h>
@@ -49,6 +50,7 @@
 #include "kudu/tablet/deltamemstore.h"
 #include "kudu/tablet/diskrowset-test-base.h"
 #include "kudu/tablet/diskrowset.h"
+#include "kudu/tablet/metadata.pb.h"
 #include "kudu/tablet/mvcc.h"
 #include "kudu/tablet/rowset.h"
 #include "kudu/tablet/rowset_metadata.h"
@@ -57,13 +59,16 @@
 #include "kudu/tablet/tablet.pb.h"
 #include "kudu/util/bloom_filter.h"
 #include "kudu/util/faststring.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/status.h"
 #include "kudu/util/stopwatch.h"
 #include "kudu/util/test_macros.h"
+#include "kudu/util/trace.h"
 
 DEFINE_double(update_fraction, 0.1f, "fraction of rows to update");
 DECLARE_bool(cfile_lazy_open);
+DECLARE_bool(consult_bloom_filters);
 DECLARE_bool(crash_on_eio);
 DECLARE_int32(cfile_default_block_size);
 DECLARE_double(env_inject_eio);
@@ -160,6 +165,64 @@ TEST_F(TestRowSet, TestRowSetRoundTrip) {
   }
 }
 
+// Test that a batch presence check agrees with checking each key in turn,
+// including for keys which fall between, before, and after the rows in the
+// rowset, and for deleted rows.
+TEST_F(TestRowSet, TestBatchCheckRowPresent) {
+  WriteTestRowSet();
+  shared_ptr<DiskRowSet> rs;
+  ASSERT_OK(OpenTestRowSet(&rs));
+
+  // Delete every fifth row.
+  for (int i = 0; i < n_rows_; i += 5) {
+    OperationResultPB result;
+    ASSERT_OK(DeleteRow(rs.get(), i, &result));
+  }
+
+  // Build the sorted list of keys to check: every row, a key right after
+  // every seventh row, and keys before and after all of the rows.
+  vector<string> keys;
+  keys.emplace_back("h");
+  for (int i = 0; i < n_rows_; i++) {
+    char buf[256];
+    FormatKey(i, buf, sizeof(buf));
+    keys.emplace_back(buf);
+    if (i % 7 == 0) {
+      keys.emplace_back(string(buf) + "x");
+    }
+  }
+  keys.emplace_back("z");
+  ASSERT_TRUE(is_sorted(keys.begin(), keys.end()));
+
+  vector<unique_ptr<RowBuilder>> rbs;
+  vector<unique_ptr<RowSetKeyProbe>> probes;
+  vector<const RowSetKeyProbe*> probe_ptrs;
+  vector<ProbeStats> stats(keys.size());
+  vector<ProbeStats*> stats_ptrs;
+  for (int i = 0; i < keys.size(); i++) {
+    rbs.emplace_back(new RowBuilder(schema_.CreateKeyProjection()));
+    rbs.back()->AddString(Slice(keys[i]));
+    probes.emplace_back(new RowSetKeyProbe(rbs.back()->row()));
+    probe_ptrs.push_back(probes.back().get());
+    stats_ptrs.push_back(&stats[i]);
+  }
+
+  for (bool consult_blooms : { true, false }) {
+    FLAGS_consult_bloom_filters = consult_blooms;
+    unique_ptr<bool[]> present(new bool[keys.size()]);
+    ASSERT_OK(rs->CheckRowsPresent(probe_ptrs, stats_ptrs, present.get()));
+    int num_present = 0;
+    for (int i = 0; i < keys.size(); i++) {
+      bool expected;
+      ProbeStats single_stats;
+      ASSERT_OK(rs->CheckRowPresent(*probes[i], &expected, &single_stats));
+      ASSERT_EQ(expected, present[i]) << "key " << keys[i];
+      num_present += present[i];
+    }
+    ASSERT_EQ(n_rows_ - (n_rows_ + 4) / 5, num_present);
+  }
+}
+
 // Test writing a rowset, and then updating some rows in it.
 TEST_F(TestRowSet, TestRowSetUpdate) {
   WriteTestRowSet();
@@ -631,6 +694,153 @@ TEST_F(TestRowSet, TestGCAncientStores) {
   ASSERT_EQ(0, dt->CountRedoDeltaStores());
 }
 
+// Test that the timestamps of UNDO delta blocks are kept in the rowset
+// metadata, so that ancient blocks can be found without initializing them.
+TEST_F(TestRowSet, TestUndoDeltaTimestampsInMetadata) {
+  // Disable lazy open so that major delta compactions don't require manual REDO initialization.
+  FLAGS_cfile_lazy_open = false;
+
+  WriteTestRowSet();
+  shared_ptr<DiskRowSet> rs;
+  ASSERT_OK(OpenTestRowSet(&rs));
+  Timestamp before_updates = clock_->Now();
+  UpdateExistingRows(rs.get(), FLAGS_update_fraction, nullptr);
+  ASSERT_OK(rs->FlushDeltas());
+  ASSERT_OK(rs->MajorCompactDeltaStores(HistoryGcOpts::Disabled()));
+  Timestamp after_updates = clock_->Now();
+  vector<BlockId> undo_blocks = rowset_meta_->undo_delta_blocks();
+  ASSERT_EQ(1, undo_blocks.size());
+
+  RowSetMetadata::UndoTimestamps timestamps;
+  ASSERT_TRUE(rowset_meta_->GetUndoDeltaTimestamps(undo_blocks[0], &timestamps));
+  ASSERT_LT(before_updates, timestamps.min);
+  ASSERT_LE(timestamps.min, timestamps.max);
+  ASSERT_LT(timestamps.max, after_updates);
+
+  // Simulate metadata written before the timestamps were recorded.
+  RowSetDataPB pb;
+  rowset_meta_->ToProtobuf(&pb);
+  ASSERT_TRUE(pb.undo_deltas(0).has_max_timestamp());
+  pb.mutable_undo_deltas(0)->clear_min_timestamp();
+  pb.mutable_undo_deltas(0)->clear_max_timestamp();
+  rowset_meta_->LoadFromPB(pb);
+  ASSERT_FALSE(rowset_meta_->GetUndoDeltaTimestamps(undo_blocks[0], &timestamps));
+
+  // Without them, an uninitialized block can't be GCed, and is assumed to be
+  // ancient when estimating.
+  FLAGS_cfile_lazy_open = true;
+  ASSERT_OK(OpenTestRowSet(&rs));
+  int64_t bytes;
+  ASSERT_OK(rs->EstimateBytesInPotentiallyAncientUndoDeltas(before_updates, &bytes));
+  ASSERT_GT(bytes, 0);
+  int64_t blocks_deleted;
+  int64_t bytes_deleted;
+  ASSERT_OK(rs->DeleteAncientUndoDeltas(after_updates, &blocks_deleted, &bytes_deleted));
+  ASSERT_EQ(0, blocks_deleted);
+
+  // Initializing the block records its timestamps again. From then on the
+  // estimate is exact and the block can be GCed without being read, even
+  // once the rowset is reopened.
+  int64_t blocks_initialized;
+  ASSERT_OK(rs->InitUndoDeltas(Timestamp::kInvalidTimestamp, MonoTime(),
+                               &blocks_initialized, nullptr));
+  ASSERT_EQ(1, blocks_initialized);
+  ASSERT_TRUE(rowset_meta_->GetUndoDeltaTimestamps(undo_blocks[0], &timestamps));
+  ASSERT_OK(OpenTestRowSet(&rs));
+  ASSERT_OK(rs->EstimateBytesInPotentiallyAncientUndoDeltas(before_updates, &bytes));
+  ASSERT_EQ(0, bytes);
+  ASSERT_OK(rs->InitUndoDeltas(after_updates, MonoTime(), &blocks_initialized, &bytes));
+  ASSERT_EQ(0, blocks_initialized);
+  ASSERT_GT(bytes, 0);
+  ASSERT_OK(rs->DeleteAncientUndoDeltas(after_updates, &blocks_deleted, &bytes_deleted));
+  ASSERT_EQ(1, blocks_deleted);
+  ASSERT_EQ(bytes, bytes_deleted);
+  ASSERT_TRUE(rowset_meta_->undo_delta_blocks().empty());
+}
+
+// Test that snapshot scans skip UNDO delta blocks whose timestamps, as
+// recorded in the rowset metadata, show they're irrelevant to the snapshot,
+// without opening them.
+TEST_F(TestRowSet, TestUndoDeltaBlocksCulledByMetadata) {
+  // Disable lazy open so that major delta compactions don't require manual REDO initialization.
+  FLAGS_cfile_lazy_open = false;
+
+  WriteTestRowSet();
+  shared_ptr<DiskRowSet> rs;
+  ASSERT_OK(OpenTestRowSet(&rs));
+  Timestamp before_updates = clock_->Now();
+  UpdateExistingRows(rs.get(), FLAGS_update_fraction, nullptr);
+  ASSERT_OK(rs->FlushDeltas());
+  ASSERT_OK(rs->MajorCompactDeltaStores(HistoryGcOpts::Disabled()));
+  Timestamp after_updates = clock_->Now();
+  ASSERT_EQ(1, rowset_meta_->undo_delta_blocks().size());
+
+  FLAGS_cfile_lazy_open = true;
+  for (const auto& snap_and_culled : { std::make_pair(MvccSnapshot(after_updates), true),
+                                       std::make_pair(MvccSnapshot(before_updates), false) }) {
+    SCOPED_TRACE(snap_and_culled.first.ToString());
+    ASSERT_OK(OpenTestRowSet(&rs));
+    scoped_refptr<Trace> trace(new Trace);
+    vector<string> rows;
+    {
+      ADOPT_TRACE(trace.get());
+      gscoped_ptr<RowwiseIterator> iter;
+      ASSERT_OK(rs->NewRowIterator(&schema_, snap_and_culled.first, UNORDERED, &iter));
+      ASSERT_OK(iter->Init(nullptr));
+      ASSERT_OK(IterateToStringList(iter.get(), &rows));
+    }
+    ASSERT_EQ(n_rows_, rows.size());
+    ASSERT_EQ(snap_and_culled.second,
+              trace->MetricsAsJSON().find("\"undo_delta_stores_culled\":1") != string::npos)
+        << trace->MetricsAsJSON();
+  }
+}
+
+// Test that the bounds and size of a rowset are recorded in its metadata, so
+// that it can be opened without reading its key index.
+TEST_F(TestRowSet, TestBaseDataSummaryInMetadata) {
+  FLAGS_cfile_lazy_open = true;
+  WriteTestRowSet();
+  RowSetMetadata::BaseDataSummary summary;
+  ASSERT_TRUE(rowset_meta_->GetBaseDataSummary(&summary));
+  ASSERT_EQ(n_rows_, summary.num_rows);
+  ASSERT_LT(summary.min_encoded_key, summary.max_encoded_key);
+
+  // The rowset is opened using the summary, and its key index is only read
+  // once needed.
+  shared_ptr<DiskRowSet> rs;
+  ASSERT_OK(OpenTestRowSet(&rs));
+  rowid_t count;
+  ASSERT_OK(rs->CountRows(&count));
+  ASSERT_EQ(n_rows_, count);
+  string min_key;
+  string max_key;
+  ASSERT_OK(rs->GetBounds(&min_key, &max_key));
+  ASSERT_EQ(summary.min_encoded_key, min_key);
+  ASSERT_EQ(summary.max_encoded_key, max_key);
+  bool present;
+  ASSERT_OK(CheckRowPresent(*rs, n_rows_ - 1, &present));
+  ASSERT_TRUE(present);
+
+  // Simulate metadata written before the summary was recorded. Opening the
+  // rowset reads the summary from its key index and records it.
+  RowSetDataPB pb;
+  rowset_meta_->ToProtobuf(&pb);
+  ASSERT_TRUE(pb.has_num_rows());
+  pb.clear_min_encoded_key();
+  pb.clear_max_encoded_key();
+  pb.clear_num_rows();
+  rowset_meta_->LoadFromPB(pb);
+  ASSERT_FALSE(rowset_meta_->GetBaseDataSummary(&summary));
+  ASSERT_OK(OpenTestRowSet(&rs));
+  ASSERT_OK(rs->CountRows(&count));
+  ASSERT_EQ(n_rows_, count);
+  ASSERT_TRUE(rowset_meta_->GetBaseDataSummary(&summary));
+  ASSERT_EQ(n_rows_, summary.num_rows);
+  ASSERT_EQ(min_key, summary.min_encoded_key);
+  ASSERT_EQ(max_key, summary.max_encoded_key);
+}
+
 TEST_F(TestRowSet, TestDiskSizeEstimation) {
   // Force the files to be opened so the stats are read.
   FLAGS_cfile_lazy_open = false;
@@ -19,6 +19,7 @@
 
 #include <algorithm>
 #include <map>
+#include <memory>
 #include <ostream>
 #include <vector>
 
@@ -30,6 +31,7 @@
 #include "kudu/cfile/bloomfile.h"
 #include "kudu/cfile/cfile_util.h"
 #include "kudu/cfile/cfile_writer.h"
+#include "kudu/common/column_predicate.h"
 #include "kudu/common/generic_iterators.h"
 #include "kudu/common/iterator.h"
 #include "kudu/common/rowblock.h"
@@ -58,6 +60,7 @@
 #include "kudu/util/scoped_cleanup.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/status.h"
+#include "kudu/util/threadpool.h"
 
 DEFINE_int32(tablet_delta_store_minor_compact_max, 1000,
              "How many delta stores are required before forcing a minor delta compaction "
@@ -73,6 +76,25 @@ DEFINE_int32(default_composite_key_index_block_size_bytes, 4096,
              "Block size used for composite key indexes.");
 TAG_FLAG(default_composite_key_index_block_size_bytes, experimental);
 
+DEFINE_int32(tablet_major_delta_compaction_column_groups, 1,
+             "Maximum number of groups of columns a major delta compaction of a "
+             "rowset is split into. The groups are rewritten by separate threads, "
+             "each writing its own column and UNDO delta files, and swapped in "
+             "with a single metadata update. Only compactions of deltas which "
+             "hold no DELETEs or REINSERTs are split.");
+TAG_FLAG(tablet_major_delta_compaction_column_groups, experimental);
+TAG_FLAG(tablet_major_delta_compaction_column_groups, runtime);
+
+DEFINE_bool(tablet_compaction_bypass_page_cache, true,
+            "Whether flushes and compactions keep their IO out of the OS page "
+            "cache. Compactions have the OS read their inputs, which are about to "
+            "be deleted, ahead in large chunks and drop them from the page cache "
+            "once read, and flushes and compactions drop their outputs from the "
+            "page cache once synced. This keeps them from evicting the working set of scans. "
+            "Compaction inputs are never inserted into the block cache regardless.");
+TAG_FLAG(tablet_compaction_bypass_page_cache, advanced);
+TAG_FLAG(tablet_compaction_bypass_page_cache, runtime);
+
 namespace kudu {
 
 class Mutex;
@@ -113,7 +135,8 @@ Status DiskRowSetWriter::Open() {
 
   FsManager* fs = rowset_metadata_->fs_manager();
   const string& tablet_id = rowset_metadata_->tablet_metadata()->tablet_id();
-  col_writer_.reset(new MultiColumnWriter(fs, schema_, tablet_id));
+  col_writer_.reset(new MultiColumnWriter(fs, schema_, tablet_id,
+                                          rowset_metadata_->storage_class()));
   RETURN_NOT_OK(col_writer_->Open());
 
   // Open bloom filter.
@@ -132,8 +155,9 @@ Status DiskRowSetWriter::InitBloomFileWriter() {
   unique_ptr<WritableBlock> block;
   FsManager* fs = rowset_metadata_->fs_manager();
   const string& tablet_id = rowset_metadata_->tablet_metadata()->tablet_id();
-  RETURN_NOT_OK_PREPEND(fs->CreateNewBlock(CreateBlockOptions({ tablet_id }),
-                                           &block),
+  RETURN_NOT_OK_PREPEND(fs->CreateNewBlock(
+                            CreateBlockOptions({ tablet_id, rowset_metadata_->storage_class() }),
+                            &block),
                         "Couldn't allocate a block for bloom filter");
   rowset_metadata_->set_bloom_block(block->id());
 
@@ -147,8 +171,9 @@ Status DiskRowSetWriter::InitAdHocIndexWriter() {
   unique_ptr<WritableBlock> block;
   FsManager* fs = rowset_metadata_->fs_manager();
   const string& tablet_id = rowset_metadata_->tablet_metadata()->tablet_id();
-  RETURN_NOT_OK_PREPEND(fs->CreateNewBlock(CreateBlockOptions({ tablet_id }),
-                                           &block),
+  RETURN_NOT_OK_PREPEND(fs->CreateNewBlock(
+                            CreateBlockOptions({ tablet_id, rowset_metadata_->storage_class() }),
+                            &block),
                         "Couldn't allocate a block for compoound index");
 
   rowset_metadata_->set_adhoc_index_block(block->id());
@@ -256,6 +281,11 @@ Status DiskRowSetWriter::FinishAndReleaseBlocks(BlockCreationTransaction* transa
       << "First Key not <= Last key: first_key=" << KUDU_REDACT(first_enc_slice.ToDebugString())
       << "   last_key=" << KUDU_REDACT(last_enc_slice.ToDebugString());
   key_index_writer()->AddMetadataPair(DiskRowSet::kMaxKeyMetaEntryName, last_enc_slice);
+  rowset_metadata_->SetBaseDataSummary(
+      { first_encoded_key, last_encoded_key_.ToString(), written_count_ });
+  // Any deletes of the rows are accounted for as their REDO deltas are
+  // committed.
+  rowset_metadata_->SetLiveRowCount(written_count_);
 
   // Finish writing the columns themselves.
   RETURN_NOT_OK(col_writer_->FinishAndReleaseBlocks(transaction));
@@ -264,6 +294,10 @@ Status DiskRowSetWriter::FinishAndReleaseBlocks(BlockCreationTransaction* transa
   std::map<ColumnId, BlockId> flushed_blocks;
   col_writer_->GetFlushedBlocksByColumnId(&flushed_blocks);
   rowset_metadata_->SetColumnDataBlocks(flushed_blocks);
+  col_writer_->GetFlushedSecondaryIndexBlocksByColumnId(&flushed_blocks);
+  rowset_metadata_->SetSecondaryIndexBlocks(flushed_blocks);
+  col_writer_->GetFlushedBloomFilterBlocksByColumnId(&flushed_blocks);
+  rowset_metadata_->SetColumnBloomFilterBlocks(flushed_blocks);
 
   if (ad_hoc_index_writer_ != nullptr) {
     Status s = ad_hoc_index_writer_->FinishAndReleaseBlock(transaction);
@@ -317,12 +351,14 @@ RollingDiskRowSetWriter::RollingDiskRowSetWriter(
       schema_(schema),
       bloom_sizing_(bloom_sizing),
       target_rowset_size_(target_rowset_size),
+      storage_class_(fs::DataDirStorageClass::FAST),
       row_idx_in_cur_drs_(0),
       can_roll_(false),
       written_count_(0),
       written_size_(0) {
   BlockManager* bm = tablet_metadata->fs_manager()->block_manager();
   block_transaction_ = bm->NewCreationTransaction();
+  block_transaction_->set_drop_cache_on_commit(FLAGS_tablet_compaction_bypass_page_cache);
   CHECK(schema.has_column_ids());
 }
 
@@ -341,6 +377,7 @@ Status RollingDiskRowSetWriter::RollWriter() {
   RETURN_NOT_OK(FinishCurrentWriter());
 
   RETURN_NOT_OK(tablet_metadata_->CreateRowSet(&cur_drs_metadata_));
+  cur_drs_metadata_->set_storage_class(storage_class_);
 
   cur_writer_.reset(new DiskRowSetWriter(cur_drs_metadata_.get(), &schema_, bloom_sizing_));
   RETURN_NOT_OK(cur_writer_->Open());
@@ -348,10 +385,9 @@ Status RollingDiskRowSetWriter::RollWriter() {
   FsManager* fs = tablet_metadata_->fs_manager();
   unique_ptr<WritableBlock> undo_data_block;
   unique_ptr<WritableBlock> redo_data_block;
-  RETURN_NOT_OK(fs->CreateNewBlock(CreateBlockOptions({ tablet_metadata_->tablet_id() }),
-                                   &undo_data_block));
-  RETURN_NOT_OK(fs->CreateNewBlock(CreateBlockOptions({ tablet_metadata_->tablet_id() }),
-                                   &redo_data_block));
+  const CreateBlockOptions block_opts({ tablet_metadata_->tablet_id(), storage_class_ });
+  RETURN_NOT_OK(fs->CreateNewBlock(block_opts, &undo_data_block));
+  RETURN_NOT_OK(fs->CreateNewBlock(block_opts, &redo_data_block));
   cur_undo_ds_block_id_ = undo_data_block->id();
   cur_redo_ds_block_id_ = redo_data_block->id();
   cur_undo_writer_.reset(new DeltaFileWriter(std::move(undo_data_block)));
@@ -446,7 +482,9 @@ Status RollingDiskRowSetWriter::FinishCurrentWriter() {
     Status s = cur_undo_writer_->FinishAndReleaseBlock(block_transaction_.get());
     if (!s.IsAborted()) {
       RETURN_NOT_OK(s);
-      cur_drs_metadata_->CommitUndoDeltaDataBlock(cur_undo_ds_block_id_);
+      cur_drs_metadata_->CommitUndoDeltaDataBlock(
+          cur_undo_ds_block_id_,
+          { cur_undo_delta_stats->min_timestamp(), cur_undo_delta_stats->max_timestamp() });
     } else {
       DCHECK_EQ(cur_undo_delta_stats->min_timestamp(), Timestamp::kMax);
     }
@@ -455,7 +493,8 @@ Status RollingDiskRowSetWriter::FinishCurrentWriter() {
     s = cur_redo_writer_->FinishAndReleaseBlock(block_transaction_.get());
     if (!s.IsAborted()) {
       RETURN_NOT_OK(s);
-      cur_drs_metadata_->CommitRedoDeltaDataBlock(0, cur_redo_ds_block_id_);
+      cur_drs_metadata_->CommitRedoDeltaDataBlock(0, cur_redo_delta_stats->delete_count(),
+                                                  cur_redo_ds_block_id_);
     } else {
       DCHECK_EQ(cur_redo_delta_stats->min_timestamp(), Timestamp::kMax);
     }
@@ -517,7 +556,9 @@ DiskRowSet::DiskRowSet(shared_ptr<RowSetMetadata> rowset_metadata,
     : rowset_metadata_(std::move(rowset_metadata)),
       open_(false),
       log_anchor_registry_(log_anchor_registry),
-      mem_trackers_(std::move(mem_trackers)) {}
+      mem_trackers_(std::move(mem_trackers)),
+      batches_scanned_in_replaced_base_data_(0),
+      num_key_probes_(0) {}
 
 Status DiskRowSet::Open() {
   TRACE_EVENT0("tablet", "DiskRowSet::Open");
@@ -566,10 +607,33 @@ Status DiskRowSet::MajorCompactDeltaStoresWithColumnIds(const vector<ColumnId>&
   std::lock_guard<Mutex> l(*delta_tracker()->compact_flush_lock());
 
   // TODO(todd): do we need to lock schema or anything here?
-  gscoped_ptr<MajorDeltaCompaction> compaction;
-  RETURN_NOT_OK(NewMajorDeltaCompaction(col_ids, std::move(history_gc_opts), &compaction));
-
-  RETURN_NOT_OK(compaction->Compact());
+  vector<unique_ptr<MajorDeltaCompaction>> compactions;
+  RETURN_NOT_OK(NewMajorDeltaCompactions(col_ids, history_gc_opts, &compactions));
+
+  // The first group is compacted by this thread, the others by a pool.
+  vector<Status> statuses(compactions.size());
+  gscoped_ptr<ThreadPool> pool;
+  if (compactions.size() > 1) {
+    RETURN_NOT_OK(ThreadPoolBuilder("delta-compact")
+                  .set_max_threads(compactions.size() - 1)
+                  .Build(&pool));
+    for (int i = 1; i < compactions.size(); i++) {
+      MajorDeltaCompaction* compaction = compactions[i].get();
+      Status* s = &statuses[i];
+      Status submit_status = pool->SubmitFunc([compaction, s]() { *s = compaction->Compact(); });
+      if (PREDICT_FALSE(!submit_status.ok())) {
+        pool->Wait();
+        return submit_status;
+      }
+    }
+  }
+  statuses[0] = compactions[0]->Compact();
+  if (pool) {
+    pool->Wait();
+  }
+  for (const auto& s : statuses) {
+    RETURN_NOT_OK(s);
+  }
 
   // Before updating anything, create a copy of the rowset metadata so we can
   // revert changes in case of error.
@@ -582,7 +646,9 @@ Status DiskRowSet::MajorCompactDeltaStoresWithColumnIds(const vector<ColumnId>&
 
   // Prepare the changes to the metadata.
   RowSetMetadataUpdate update;
-  compaction->CreateMetadataUpdate(&update);
+  for (const auto& compaction : compactions) {
+    compaction->CreateMetadataUpdate(&update);
+  }
   vector<BlockId> removed_blocks;
   rowset_metadata_->CommitUpdate(update, &removed_blocks);
 
@@ -595,7 +661,13 @@ Status DiskRowSet::MajorCompactDeltaStoresWithColumnIds(const vector<ColumnId>&
   {
     // Update the delta tracker and the base data with the changes.
     std::lock_guard<rw_spinlock> lock(component_lock_);
-    RETURN_NOT_OK(compaction->UpdateDeltaTracker(delta_tracker_.get()));
+    for (const auto& compaction : compactions) {
+      RETURN_NOT_OK(compaction->OpenNewDeltaStores(delta_tracker_.get()));
+    }
+    for (const auto& compaction : compactions) {
+      compaction->UpdateDeltaTracker(delta_tracker_.get());
+    }
+    batches_scanned_in_replaced_base_data_ += base_data_->num_batches_scanned();
     base_data_.swap(new_base);
   }
 
@@ -610,6 +682,40 @@ Status DiskRowSet::MajorCompactDeltaStoresWithColumnIds(const vector<ColumnId>&
   return rowset_metadata_->Flush();
 }
 
+Status DiskRowSet::NewMajorDeltaCompactions(
+    const vector<ColumnId>& col_ids,
+    const HistoryGcOpts& history_gc_opts,
+    vector<unique_ptr<MajorDeltaCompaction>>* out) const {
+  gscoped_ptr<MajorDeltaCompaction> compaction;
+  RETURN_NOT_OK(NewMajorDeltaCompaction(col_ids, history_gc_opts, &compaction));
+  const int num_groups = std::min<int>(FLAGS_tablet_major_delta_compaction_column_groups,
+                                       col_ids.size());
+  bool only_updates = num_groups > 1;
+  for (const auto& store : compaction->included_stores()) {
+    if (!only_updates) break;
+    RETURN_NOT_OK(store->Init());
+    const DeltaStats& stats = store->delta_stats();
+    only_updates = stats.delete_count() == 0 && stats.reinsert_count() == 0;
+  }
+  out->clear();
+  if (!only_updates) {
+    out->emplace_back(compaction.release());
+    return Status::OK();
+  }
+
+  // Since our caller holds the delta tracker's compact_flush_lock_, the
+  // compactions of all the groups include the same delta stores.
+  compaction.reset();
+  for (int i = 0; i < num_groups; i++) {
+    vector<ColumnId> group_col_ids(col_ids.begin() + col_ids.size() * i / num_groups,
+                                   col_ids.begin() + col_ids.size() * (i + 1) / num_groups);
+    RETURN_NOT_OK(NewMajorDeltaCompaction(group_col_ids, history_gc_opts, &compaction));
+    compaction->SetColumnGroup(i == 0, col_ids);
+    out->emplace_back(compaction.release());
+  }
+  return Status::OK();
+}
+
 Status DiskRowSet::NewMajorDeltaCompaction(const vector<ColumnId>& col_ids,
                                            HistoryGcOpts history_gc_opts,
                                            gscoped_ptr<MajorDeltaCompaction>* out) const {
@@ -634,7 +740,8 @@ Status DiskRowSet::NewMajorDeltaCompaction(const vector<ColumnId>& col_ids,
                                       std::move(included_stores),
                                       col_ids,
                                       std::move(history_gc_opts),
-                                      rowset_metadata_->tablet_metadata()->tablet_id()));
+                                      rowset_metadata_->tablet_metadata()->tablet_id(),
+                                      rowset_metadata_->storage_class()));
   return Status::OK();
 }
 
@@ -646,6 +753,19 @@ Status DiskRowSet::NewRowIterator(const Schema *projection,
   shared_lock<rw_spinlock> l(component_lock_);
 
   shared_ptr<CFileSet::Iterator> base_iter(base_data_->NewIterator(projection));
+  vector<ColumnId> index_col_ids = base_data_->secondary_index_col_ids();
+  if (!index_col_ids.empty()) {
+    // The secondary indexes describe the base data, so they may only be used
+    // for the columns which the deltas visible to the scan don't change.
+    RETURN_NOT_OK(delta_tracker_->RemoveMutatedColumnIds(mvcc_snap, &index_col_ids));
+    base_iter->set_secondary_index_col_ids(std::move(index_col_ids));
+  }
+  vector<ColumnId> bloom_col_ids = base_data_->bloom_filter_col_ids();
+  if (!bloom_col_ids.empty()) {
+    // Likewise for the bloom filters.
+    RETURN_NOT_OK(delta_tracker_->RemoveMutatedColumnIds(mvcc_snap, &bloom_col_ids));
+    base_iter->set_bloom_filter_col_ids(std::move(bloom_col_ids));
+  }
   gscoped_ptr<ColumnwiseIterator> col_iter;
   RETURN_NOT_OK(delta_tracker_->WrapIterator(base_iter, mvcc_snap, &col_iter));
 
@@ -667,6 +787,7 @@ Status DiskRowSet::MutateRow(Timestamp timestamp,
                              ProbeStats* stats,
                              OperationResultPB* result) {
   DCHECK(open_);
+  num_key_probes_.Increment();
   shared_lock<rw_spinlock> l(component_lock_);
 
   boost::optional<rowid_t> row_idx;
@@ -692,6 +813,7 @@ Status DiskRowSet::CheckRowPresent(const RowSetKeyProbe &probe,
                                    bool* present,
                                    ProbeStats* stats) const {
   DCHECK(open_);
+  num_key_probes_.Increment();
   shared_lock<rw_spinlock> l(component_lock_);
 
   rowid_t row_idx;
@@ -708,6 +830,40 @@ Status DiskRowSet::CheckRowPresent(const RowSetKeyProbe &probe,
   return Status::OK();
 }
 
+Status DiskRowSet::CheckRowsPresent(const vector<const RowSetKeyProbe*>& probes,
+                                    const vector<ProbeStats*>& stats,
+                                    bool* present) const {
+  DCHECK(open_);
+  num_key_probes_.IncrementBy(probes.size());
+  shared_lock<rw_spinlock> l(component_lock_);
+
+  vector<rowid_t> row_idxs(probes.size());
+  RETURN_NOT_OK(base_data_->CheckRowsPresent(probes, stats, present, row_idxs.data()));
+  for (size_t i = 0; i < probes.size(); i++) {
+    if (!present[i]) continue;
+    // It might be in the base data but deleted.
+    bool deleted = false;
+    RETURN_NOT_OK(delta_tracker_->CheckRowDeleted(row_idxs[i], &deleted, stats[i]));
+    present[i] = !deleted;
+  }
+  return Status::OK();
+}
+
+uint64_t DiskRowSet::AccessCount() const {
+  DCHECK(open_);
+  shared_lock<rw_spinlock> l(component_lock_);
+  return num_key_probes_.Load() +
+      batches_scanned_in_replaced_base_data_ +
+      base_data_->num_batches_scanned();
+}
+
+Status DiskRowSet::GetColumnStatistics(ColumnId col_id,
+                                       cfile::ColumnStatisticsPB* stats) const {
+  DCHECK(open_);
+  shared_lock<rw_spinlock> l(component_lock_);
+  return base_data_->GetColumnStatistics(col_id, stats);
+}
+
 Status DiskRowSet::CountRows(rowid_t *count) const {
   DCHECK(open_);
   shared_lock<rw_spinlock> l(component_lock_);
@@ -715,6 +871,11 @@ Status DiskRowSet::CountRows(rowid_t *count) const {
   return base_data_->CountRows(count);
 }
 
+Status DiskRowSet::CountLiveRows(int64_t* count) const {
+  DCHECK(open_);
+  return delta_tracker_->CountLiveRows(count);
+}
+
 Status DiskRowSet::GetBounds(std::string* min_encoded_key,
                              std::string* max_encoded_key) const {
   DCHECK(open_);
@@ -722,6 +883,12 @@ Status DiskRowSet::GetBounds(std::string* min_encoded_key,
   return base_data_->GetBounds(min_encoded_key, max_encoded_key);
 }
 
+Status DiskRowSet::SampleKeys(int num_samples, vector<string>* encoded_keys) const {
+  DCHECK(open_);
+  shared_lock<rw_spinlock> l(component_lock_);
+  return base_data_->SampleKeys(num_samples, encoded_keys);
+}
+
 void DiskRowSet::GetDiskRowSetSpaceUsage(DiskRowSetSpace* drss) const {
   DCHECK(open_);
   shared_lock<rw_spinlock> l(component_lock_);
@@ -834,6 +1001,52 @@ Status DiskRowSet::DeleteAncientUndoDeltas(Timestamp ancient_history_mark,
                                                  blocks_deleted, bytes_deleted);
 }
 
+Status DiskRowSet::IsExpiredBeforeAncientHistory(const HistoryGcOpts& history_gc_opts,
+                                                 bool* expired) {
+  DCHECK(open_);
+  *expired = false;
+  if (!history_gc_opts.ttl_enabled()) {
+    return Status::OK();
+  }
+  const Schema& schema = rowset_metadata_->tablet_schema();
+  const ColumnId col_id = history_gc_opts.ttl_col_id();
+  int col_idx = schema.find_column_by_id(col_id);
+  if (col_idx == Schema::kColumnNotFound) {
+    return Status::OK();
+  }
+
+  shared_ptr<CFileSet> base_data;
+  {
+    shared_lock<rw_spinlock> l(component_lock_);
+    base_data = base_data_;
+  }
+
+  // Every row of the base data must have expired...
+  const int64_t cutoff_micros = history_gc_opts.ttl_cutoff_micros();
+  ColumnPredicate live_pred = ColumnPredicate::Range(schema.column(col_idx),
+                                                     &cutoff_micros, nullptr);
+  bool may_match;
+  RETURN_NOT_OK(base_data->RowsMayMatch(col_id, live_pred, &may_match));
+  if (may_match) {
+    return Status::OK();
+  }
+
+  // ...and remain so as of any snapshot that may still be scanned.
+  bool may_mutate;
+  RETURN_NOT_OK(delta_tracker_->MayMutateColumn(col_id,
+                                                history_gc_opts.ancient_history_mark(),
+                                                &may_mutate));
+  *expired = !may_mutate;
+  return Status::OK();
+}
+
+Status DiskRowSet::MayHaveWritesSince(Timestamp timestamp, bool* may_have_writes) {
+  DCHECK(open_);
+  // Inserts into the base data are recorded as UNDO deltas, so the deltas
+  // account for every write.
+  return delta_tracker_->MayHaveDeltasSince(timestamp, may_have_writes);
+}
+
 Status DiskRowSet::DebugDump(vector<string> *lines) {
   // Using CompactionInput to dump our data is an easy way of seeing all the
   // rows and deltas.
@@ -36,6 +36,7 @@
 #include "kudu/common/rowid.h"
 #include "kudu/common/schema.h"
 #include "kudu/fs/block_id.h"
+#include "kudu/fs/block_manager.h"
 #include "kudu/fs/fs_manager.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
@@ -47,6 +48,7 @@
 #include "kudu/tablet/rowset_metadata.h"
 #include "kudu/tablet/tablet_mem_trackers.h"
 #include "kudu/tablet/tablet_metadata.h"
+#include "kudu/util/atomic.h"
 #include "kudu/util/bloom_filter.h"
 #include "kudu/util/faststring.h"
 #include "kudu/util/locks.h"
@@ -63,6 +65,7 @@ class Timestamp;
 namespace cfile {
 class BloomFileWriter;
 class CFileWriter;
+class ColumnStatisticsPB;
 }
 
 namespace consensus {
@@ -172,6 +175,13 @@ class RollingDiskRowSetWriter {
                           size_t target_rowset_size);
   ~RollingDiskRowSetWriter();
 
+  // Sets the class of data directory in which the new rowsets are placed.
+  // Defaults to FAST. Must be called before Open().
+  void set_storage_class(fs::DataDirStorageClass storage_class) {
+    DCHECK_EQ(state_, kInitialized);
+    storage_class_ = storage_class;
+  }
+
   Status Open();
 
   // The block is written to all column writers as well as the bloom filter,
@@ -245,6 +255,7 @@ class RollingDiskRowSetWriter {
   std::shared_ptr<RowSetMetadata> cur_drs_metadata_;
   const BloomFilterSizing bloom_sizing_;
   const size_t target_rowset_size_;
+  fs::DataDirStorageClass storage_class_;
 
   gscoped_ptr<DiskRowSetWriter> cur_writer_;
 
@@ -351,6 +362,10 @@ class DiskRowSet : public RowSet {
                          bool *present,
                          ProbeStats* stats) const OVERRIDE;
 
+  Status CheckRowsPresent(const std::vector<const RowSetKeyProbe*>& probes,
+                          const std::vector<ProbeStats*>& stats,
+                          bool* present) const OVERRIDE;
+
   ////////////////////
   // Read functions.
   ////////////////////
@@ -366,10 +381,15 @@ class DiskRowSet : public RowSet {
   // Count the number of rows in this rowset.
   Status CountRows(rowid_t *count) const OVERRIDE;
 
+  Status CountLiveRows(int64_t* count) const OVERRIDE;
+
   // See RowSet::GetBounds(...)
   virtual Status GetBounds(std::string* min_encoded_key,
                            std::string* max_encoded_key) const OVERRIDE;
 
+  // See CFileSet::SampleKeys(...)
+  Status SampleKeys(int num_samples, std::vector<std::string>* encoded_keys) const OVERRIDE;
+
   void GetDiskRowSetSpaceUsage(DiskRowSetSpace* drss) const;
 
   uint64_t OnDiskSize() const OVERRIDE;
@@ -399,9 +419,20 @@ class DiskRowSet : public RowSet {
   Status DeleteAncientUndoDeltas(Timestamp ancient_history_mark,
                                  int64_t* blocks_deleted, int64_t* bytes_deleted) OVERRIDE;
 
+  // Checks the zone maps of the time-to-live column's base data, and makes
+  // sure no deltas that are still visible could change that column.
+  Status IsExpiredBeforeAncientHistory(const HistoryGcOpts& history_gc_opts,
+                                       bool* expired) OVERRIDE;
+
+  Status MayHaveWritesSince(Timestamp timestamp, bool* may_have_writes) OVERRIDE;
+
   // Major compacts all the delta files for all the columns.
   Status MajorCompactDeltaStores(HistoryGcOpts history_gc_opts);
 
+  uint64_t AccessCount() const OVERRIDE;
+
+  Status GetColumnStatistics(ColumnId col_id, cfile::ColumnStatisticsPB* stats) const OVERRIDE;
+
   std::mutex *compact_flush_lock() OVERRIDE {
     return &compact_flush_lock_;
   }
@@ -451,6 +482,15 @@ class DiskRowSet : public RowSet {
   Status MajorCompactDeltaStoresWithColumnIds(const std::vector<ColumnId>& col_ids,
                                               HistoryGcOpts history_gc_opts);
 
+  // Create the major delta compactions of the specified columns: a single
+  // one, or, if --tablet_major_delta_compaction_column_groups allows it and
+  // the deltas only hold UPDATEs, one per group of columns, to be run in
+  // parallel.
+  Status NewMajorDeltaCompactions(
+      const std::vector<ColumnId>& col_ids,
+      const HistoryGcOpts& history_gc_opts,
+      std::vector<std::unique_ptr<MajorDeltaCompaction>>* out) const;
+
   std::shared_ptr<RowSetMetadata> rowset_metadata_;
 
   bool open_;
@@ -464,6 +504,13 @@ class DiskRowSet : public RowSet {
   std::shared_ptr<CFileSet> base_data_;
   gscoped_ptr<DeltaTracker> delta_tracker_;
 
+  // Row batches scanned from base data that has since been replaced by a
+  // major delta compaction. Protected by 'component_lock_'.
+  int64_t batches_scanned_in_replaced_base_data_;
+
+  // Number of keys probed for presence or mutation. See AccessCount().
+  mutable AtomicInt<int64_t> num_key_probes_;
+
   // Lock governing this rowset's inclusion in a compact/flush. If locked,
   // no other compactor will attempt to include this rowset.
   std::mutex compact_flush_lock_;
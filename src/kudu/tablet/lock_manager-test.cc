@@ -21,6 +21,7 @@
 #include <mutex>
 #include <ostream>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <gflags/gflags.h>
@@ -44,6 +45,9 @@ using std::vector;
 
 DEFINE_int32(num_test_threads, 10, "number of stress test client threads");
 DEFINE_int32(num_iterations, 1000, "number of iterations per client thread");
+DEFINE_int32(max_scaling_threads, 16,
+             "maximum number of threads used by the batch locking scalability test");
+DEFINE_int32(rows_per_batch, 100, "number of rows locked per batch in the scalability test");
 
 namespace kudu {
 namespace tablet {
@@ -117,6 +121,62 @@ TEST_F(LockManagerTest, TestMoveLock) {
   ASSERT_FALSE(row_lock.acquired()); // NOLINT(misc-use-after-move)
 }
 
+TEST_F(LockManagerTest, TestBatchLockUnlock) {
+  Slice key_a("a"), key_b("b"), key_c("c");
+  // Repeated and out-of-order keys in a batch are fine.
+  vector<Slice> keys = { key_c, key_a, key_b, key_a };
+  vector<ScopedRowLock> locks;
+  lock_manager_.AcquireLocks(kFakeTransaction, keys, LockManager::LOCK_EXCLUSIVE, &locks);
+  ASSERT_EQ(keys.size(), locks.size());
+  for (const auto& l : locks) {
+    ASSERT_TRUE(l.acquired());
+  }
+  VerifyAlreadyLocked(key_a);
+  VerifyAlreadyLocked(key_b);
+  VerifyAlreadyLocked(key_c);
+
+  vector<ScopedRowLock*> to_release;
+  for (auto& l : locks) {
+    to_release.push_back(&l);
+  }
+  ScopedRowLock::ReleaseBatch(to_release);
+  for (const auto& l : locks) {
+    ASSERT_FALSE(l.acquired());
+  }
+
+  // All the rows are available again.
+  for (const Slice& key : keys) {
+    ScopedRowLock l(&lock_manager_, kFakeTransaction, key, LockManager::LOCK_EXCLUSIVE);
+    ASSERT_TRUE(l.acquired());
+  }
+}
+
+// Two transactions locking the same rows in opposite orders can't deadlock,
+// since the batch is locked in key order.
+TEST_F(LockManagerTest, TestBatchLockOrdering) {
+  vector<string> key_strings;
+  for (int i = 0; i < 100; i++) {
+    key_strings.push_back(StringPrintf("key%03d", i));
+  }
+  vector<Slice> forward(key_strings.begin(), key_strings.end());
+  vector<Slice> backward(forward.rbegin(), forward.rend());
+
+  vector<std::thread> threads;
+  for (int t = 0; t < 2; t++) {
+    threads.emplace_back([&, t]() {
+        const TransactionState* txn = reinterpret_cast<TransactionState*>(t + 1);
+        for (int i = 0; i < FLAGS_num_iterations; i++) {
+          vector<ScopedRowLock> locks;
+          lock_manager_.AcquireLocks(txn, t == 0 ? forward : backward,
+                                     LockManager::LOCK_EXCLUSIVE, &locks);
+        }
+      });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+}
+
 class LmTestResource {
  public:
   explicit LmTestResource(const Slice* id)
@@ -295,5 +355,48 @@ TEST_F(LockManagerTest, TestUncontended) {
   runPerformanceTest("Uncontended", &threads);
 }
 
+// Measure how batch locking scales with the number of threads, each locking
+// its own rows, as a write workload over distinct keys would.
+TEST_F(LockManagerTest, TestBatchLockScalability) {
+  for (int num_threads = 1; num_threads <= FLAGS_max_scaling_threads; num_threads *= 2) {
+    vector<vector<string>> key_strings(num_threads);
+    for (int t = 0; t < num_threads; t++) {
+      for (int i = 0; i < FLAGS_rows_per_batch; i++) {
+        key_strings[t].push_back(StringPrintf("thread%03d-row%06d", t, i));
+      }
+    }
+
+    Stopwatch sw(Stopwatch::ALL_THREADS);
+    sw.start();
+    vector<std::thread> threads;
+    for (int t = 0; t < num_threads; t++) {
+      threads.emplace_back([&, t]() {
+          const TransactionState* txn = reinterpret_cast<TransactionState*>(t + 1);
+          vector<Slice> keys(key_strings[t].begin(), key_strings[t].end());
+          vector<ScopedRowLock> locks;
+          vector<ScopedRowLock*> to_release;
+          for (int i = 0; i < FLAGS_num_iterations; i++) {
+            lock_manager_.AcquireLocks(txn, keys, LockManager::LOCK_EXCLUSIVE, &locks);
+            to_release.clear();
+            for (auto& l : locks) {
+              to_release.push_back(&l);
+            }
+            ScopedRowLock::ReleaseBatch(to_release);
+          }
+        });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    sw.stop();
+
+    double rows = static_cast<double>(num_threads) * FLAGS_num_iterations * FLAGS_rows_per_batch;
+    LOG(INFO) << num_threads << " threads: "
+              << rows / sw.elapsed().wall_seconds() << " row lock/unlock cycles per second, "
+              << (sw.elapsed().user + sw.elapsed().system) / 1000.0 / rows
+              << "us CPU per cycle";
+  }
+}
+
 } // namespace tablet
 } // namespace kudu
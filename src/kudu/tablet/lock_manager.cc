@@ -17,10 +17,13 @@
 
 #include "kudu/tablet/lock_manager.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <mutex>
+#include <numeric>
 #include <ostream>
 #include <string>
+#include <vector>
 
 #include <glog/logging.h>
 
@@ -29,21 +32,40 @@
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/hash/city.h"
 #include "kudu/gutil/port.h"
+#include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/walltime.h"
 #include "kudu/util/faststring.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/monotime.h"
+#include "kudu/util/probes.h"
 #include "kudu/util/semaphore.h"
 #include "kudu/util/trace.h"
 
 using base::subtle::NoBarrier_Load;
+using std::vector;
 
 namespace kudu {
 namespace tablet {
 
 class TransactionState;
 
+namespace {
+
+// The number of stripes in the lock table. Each stripe has its own table
+// lock and is resized independently of the others, so that concurrent
+// writers rarely touch the same lock word.
+const int kNumStripes = 16;
+
+// The maximum number of free LockEntry objects cached by each stripe.
+const size_t kMaxCachedEntriesPerStripe = 64;
+
+uint64_t HashKey(const Slice& key) {
+  return util_hash::CityHash64(reinterpret_cast<const char *>(key.data()), key.size());
+}
+
+} // anonymous namespace
+
 // ============================================================================
 //  LockTable
 // ============================================================================
@@ -52,12 +74,13 @@ class TransactionState;
 // Callers should generally use ScopedRowLock (see below).
 class LockEntry {
  public:
-  explicit LockEntry(const Slice& key)
+  LockEntry()
   : sem(1),
-    recursion_(0) {
-    key_hash_ = util_hash::CityHash64(reinterpret_cast<const char *>(key.data()), key.size());
-    key_ = key;
-    refs_ = 1;
+    recursion_(0),
+    ht_next_(nullptr),
+    key_hash_(0),
+    refs_(0),
+    holder_(nullptr) {
   }
 
   bool Equals(const Slice& key, uint64_t hash) const {
@@ -76,9 +99,15 @@ class LockEntry {
   friend class LockTable;
   friend class LockManager;
 
-  void CopyKey() {
-    key_buf_.assign_copy(key_.data(), key_.size());
+  // Prepare this (unused) entry to be inserted in the table for 'key'.
+  void Init(const Slice& key, uint64_t hash) {
+    key_buf_.assign_copy(key.data(), key.size());
     key_ = Slice(key_buf_);
+    key_hash_ = hash;
+    refs_ = 1;
+    recursion_ = 0;
+    holder_ = nullptr;
+    ht_next_ = nullptr;
   }
 
   // Pointer to the next entry in the same hash table bucket
@@ -93,13 +122,72 @@ class LockEntry {
   // number of users that are referencing this object
   uint64_t refs_;
 
-  // buffer of the key, allocated on insertion by CopyKey()
+  // buffer of the key, allocated on insertion by Init(). Reused entries
+  // keep their buffer, so that they generally don't need to allocate.
   faststring key_buf_;
 
   // The transaction currently holding the lock
   const TransactionState* holder_;
 };
 
+// A cache of unused LockEntry objects, so that locking a row usually doesn't
+// need to allocate a new entry.
+//
+// The locks of a transaction are often released by a different thread than
+// the one which acquired them, so per-thread caches would fill up on the
+// threads releasing locks and stay empty on those acquiring them. Instead,
+// each stripe of the lock table has its own cache, to which the entries
+// removed from the stripe are returned. At most kMaxCachedEntriesPerStripe
+// entries are kept by each stripe; any beyond that are deleted.
+//
+// This class is thread-safe.
+class LockEntryCache {
+ public:
+  LockEntryCache() {
+    free_.reserve(kMaxCachedEntriesPerStripe);
+  }
+
+  ~LockEntryCache() {
+    STLDeleteElements(&free_);
+  }
+
+  LockEntry* Get() {
+    {
+      std::lock_guard<simple_spinlock> l(lock_);
+      if (!free_.empty()) {
+        LockEntry* entry = free_.back();
+        free_.pop_back();
+        return entry;
+      }
+    }
+    return new LockEntry();
+  }
+
+  // Caches the 'n' entries in 'entries'.
+  void Put(LockEntry* const* entries, int n) {
+    int i = 0;
+    {
+      std::lock_guard<simple_spinlock> l(lock_);
+      for (; i < n && free_.size() < kMaxCachedEntriesPerStripe; i++) {
+        free_.push_back(entries[i]);
+      }
+    }
+    for (; i < n; i++) {
+      delete entries[i];
+    }
+  }
+
+ private:
+  simple_spinlock lock_;
+  vector<LockEntry*> free_;
+
+  DISALLOW_COPY_AND_ASSIGN(LockEntryCache);
+};
+
+// A chained hash table of the LockEntries which are currently referenced,
+// split into kNumStripes independent stripes. The stripe of a key is chosen
+// from the high bits of its hash and the bucket within the stripe from the
+// low bits.
 class LockTable {
  private:
   struct Bucket {
@@ -109,17 +197,43 @@ class LockTable {
     Bucket() : chain_head(nullptr) {}
   };
 
+  struct Stripe {
+    // Taken in shared mode to access the buckets, and in exclusive mode
+    // to resize the stripe.
+    rw_spinlock lock;
+    // size - 1 used to lookup the bucket (hash & mask)
+    uint64_t mask;
+    // number of buckets in the stripe
+    uint64_t size;
+    // stripe buckets
+    gscoped_array<Bucket> buckets;
+    // number of items in the stripe
+    base::subtle::Atomic64 item_count;
+    // unused entries, to be inserted in the stripe
+    LockEntryCache cache;
+
+    Stripe() : mask(0), size(0), item_count(0) {}
+
+    Bucket *FindBucket(uint64_t hash) const {
+      return &(buckets[hash & mask]);
+    }
+  } CACHELINE_ALIGNED;
+
  public:
-  LockTable() : mask_(0), size_(0), item_count_(0) {
-    Resize();
+  LockTable() {
+    for (auto& stripe : stripes_) {
+      Resize(&stripe);
+    }
   }
 
   ~LockTable() {
     // Sanity checks: The table shouldn't be destructed when there are any entries in it.
-    DCHECK_EQ(0, NoBarrier_Load(&(item_count_))) << "There are some unreleased locks";
-    for (size_t i = 0; i < size_; ++i) {
-      for (LockEntry *p = buckets_[i].chain_head; p != nullptr; p = p->ht_next_) {
-        DCHECK(p == nullptr) << "The entry " << p->ToString() << " was not released";
+    for (const auto& stripe : stripes_) {
+      DCHECK_EQ(0, NoBarrier_Load(&(stripe.item_count))) << "There are some unreleased locks";
+      for (size_t i = 0; i < stripe.size; ++i) {
+        for (LockEntry *p = stripe.buckets[i].chain_head; p != nullptr; p = p->ht_next_) {
+          DCHECK(p == nullptr) << "The entry " << p->ToString() << " was not released";
+        }
       }
     }
   }
@@ -127,9 +241,17 @@ class LockTable {
   LockEntry *GetLockEntry(const Slice &key);
   void ReleaseLockEntry(LockEntry *entry);
 
+  // Like GetLockEntry() for each of the 'n' keys in 'keys', storing the entry
+  // for keys[i] in entries[i]. Keys which fall in the same stripe are looked
+  // up under a single acquisition of that stripe's lock.
+  void GetLockEntries(const Slice* keys, size_t n, LockEntry** entries);
+
+  // Like ReleaseLockEntry() for each of the 'n' entries in 'entries'.
+  void ReleaseLockEntries(LockEntry* const* entries, size_t n);
+
  private:
-  Bucket *FindBucket(uint64_t hash) const {
-    return &(buckets_[hash & mask_]);
+  Stripe *FindStripe(uint64_t hash) {
+    return &stripes_[(hash >> 32) % kNumStripes];
   }
 
   // Return a pointer to slot that points to a lock entry that
@@ -155,92 +277,169 @@ class LockTable {
     return nullptr;
   }
 
-  void Resize();
+  // Return the entry for 'key', inserting an entry from the stripe's cache if
+  // there isn't one yet, in which case 'inserted' is set to true.
+  // The stripe lock must be held in shared mode.
+  LockEntry *GetLockEntryUnlocked(Stripe *stripe, const Slice& key, uint64_t hash,
+                                  bool* inserted);
 
- private:
-  // table rwlock used as write on resize
-  percpu_rwlock lock_;
-  // size - 1 used to lookup the bucket (hash & mask_)
-  uint64_t mask_;
-  // number of buckets in the table
-  uint64_t size_;
-  // table buckets
-  gscoped_array<Bucket> buckets_;
-  // number of items in the table
-  base::subtle::Atomic64 item_count_;
-};
+  // Drop a reference to 'entry', returning true if it was the last one, in
+  // which case the entry has been removed from the table.
+  // The stripe lock must be held in shared mode.
+  bool ReleaseLockEntryUnlocked(Stripe *stripe, LockEntry *entry);
 
-LockEntry *LockTable::GetLockEntry(const Slice& key) {
-  auto new_entry = new LockEntry(key);
-  LockEntry *old_entry;
+  // Account for 'n' newly inserted entries in 'stripe', growing it if needed.
+  void EntriesInserted(Stripe *stripe, int n);
 
-  {
-    shared_lock<rw_spinlock> l(lock_.get_lock());
-    Bucket *bucket = FindBucket(new_entry->key_hash_);
-    {
-      std::lock_guard<simple_spinlock> bucket_lock(bucket->lock);
-      LockEntry **node = FindSlot(bucket, new_entry->key_, new_entry->key_hash_);
-      old_entry = *node;
-      if (old_entry != nullptr) {
-        old_entry->refs_++;
-      } else {
-        new_entry->ht_next_ = nullptr;
-        new_entry->CopyKey();
-        *node = new_entry;
-      }
-    }
+  // Account for the removal of the 'n' entries in 'removed', which are
+  // returned to the stripe's cache.
+  void EntriesRemoved(Stripe *stripe, LockEntry* const* removed, int n);
+
+  void Resize(Stripe *stripe);
+
+  Stripe stripes_[kNumStripes];
+};
+
+LockEntry *LockTable::GetLockEntryUnlocked(Stripe *stripe, const Slice& key, uint64_t hash,
+                                           bool* inserted) {
+  Bucket *bucket = stripe->FindBucket(hash);
+  std::lock_guard<simple_spinlock> bucket_lock(bucket->lock);
+  LockEntry **node = FindSlot(bucket, key, hash);
+  if (*node != nullptr) {
+    (*node)->refs_++;
+    return *node;
   }
+  LockEntry *new_entry = stripe->cache.Get();
+  new_entry->Init(key, hash);
+  *node = new_entry;
+  *inserted = true;
+  return new_entry;
+}
 
-  if (old_entry != nullptr) {
-    delete new_entry;
-    return old_entry;
+bool LockTable::ReleaseLockEntryUnlocked(Stripe *stripe, LockEntry *entry) {
+  Bucket *bucket = stripe->FindBucket(entry->key_hash_);
+  std::lock_guard<simple_spinlock> bucket_lock(bucket->lock);
+  LockEntry **node = FindEntry(bucket, entry);
+  DCHECK(node != nullptr) << "Unable to find LockEntry on release";
+  if (PREDICT_FALSE(node == nullptr)) {
+    return false;
   }
+  // ASSUMPTION: There are few updates, so locking the same row at the same time is rare
+  if (--entry->refs_ > 0) {
+    return false;
+  }
+  *node = entry->ht_next_;
+  return true;
+}
 
-  if (base::subtle::NoBarrier_AtomicIncrement(&item_count_, 1) > size_) {
-    std::unique_lock<percpu_rwlock> table_wrlock(lock_, std::try_to_lock);
+void LockTable::EntriesInserted(Stripe *stripe, int n) {
+  if (base::subtle::NoBarrier_AtomicIncrement(&stripe->item_count, n) > stripe->size) {
+    std::unique_lock<rw_spinlock> stripe_wrlock(stripe->lock, std::try_to_lock);
     // if we can't take the lock, means that someone else is resizing.
-    // (The percpu_rwlock try_lock waits for readers to complete)
-    if (table_wrlock.owns_lock()) {
-      Resize();
+    // (The rw_spinlock try_lock waits for readers to complete)
+    if (stripe_wrlock.owns_lock()) {
+      Resize(stripe);
     }
   }
+}
 
-  return new_entry;
+void LockTable::EntriesRemoved(Stripe *stripe, LockEntry* const* removed, int n) {
+  if (n == 0) {
+    return;
+  }
+  base::subtle::NoBarrier_AtomicIncrement(&stripe->item_count, -n);
+  stripe->cache.Put(removed, n);
+}
+
+LockEntry *LockTable::GetLockEntry(const Slice& key) {
+  uint64_t hash = HashKey(key);
+  Stripe *stripe = FindStripe(hash);
+  bool inserted = false;
+  LockEntry *entry;
+  {
+    shared_lock<rw_spinlock> l(stripe->lock);
+    entry = GetLockEntryUnlocked(stripe, key, hash, &inserted);
+  }
+  if (inserted) {
+    EntriesInserted(stripe, 1);
+  }
+  return entry;
 }
 
 void LockTable::ReleaseLockEntry(LockEntry *entry) {
-  bool removed = false;
+  Stripe *stripe = FindStripe(entry->key_hash_);
+  bool removed;
   {
-    std::lock_guard<rw_spinlock> table_rdlock(lock_.get_lock());
-    Bucket *bucket = FindBucket(entry->key_hash_);
+    shared_lock<rw_spinlock> l(stripe->lock);
+    removed = ReleaseLockEntryUnlocked(stripe, entry);
+  }
+  if (removed) {
+    EntriesRemoved(stripe, &entry, 1);
+  }
+}
+
+void LockTable::GetLockEntries(const Slice* keys, size_t n, LockEntry** entries) {
+  vector<uint64_t> hashes(n);
+  vector<size_t> order(n);
+  for (size_t i = 0; i < n; i++) {
+    hashes[i] = HashKey(keys[i]);
+    order[i] = i;
+  }
+  // Group the keys by stripe.
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+      return FindStripe(hashes[a]) < FindStripe(hashes[b]);
+    });
+
+  size_t i = 0;
+  while (i < n) {
+    Stripe *stripe = FindStripe(hashes[order[i]]);
+    int num_inserted = 0;
     {
-      std::lock_guard<simple_spinlock> bucket_lock(bucket->lock);
-      LockEntry **node = FindEntry(bucket, entry);
-      if (node != nullptr) {
-        // ASSUMPTION: There are few updates, so locking the same row at the same time is rare
-        // TODO: Move out this if we're going with the TryLock
-        if (--entry->refs_ > 0)
-          return;
-
-        *node = entry->ht_next_;
-        removed = true;
+      shared_lock<rw_spinlock> l(stripe->lock);
+      for (; i < n && FindStripe(hashes[order[i]]) == stripe; i++) {
+        size_t idx = order[i];
+        bool inserted = false;
+        entries[idx] = GetLockEntryUnlocked(stripe, keys[idx], hashes[idx], &inserted);
+        num_inserted += inserted;
       }
     }
+    if (num_inserted > 0) {
+      EntriesInserted(stripe, num_inserted);
+    }
   }
+}
 
-  DCHECK(removed) << "Unable to find LockEntry on release";
-  base::subtle::NoBarrier_AtomicIncrement(&item_count_, -1);
-  delete entry;
+void LockTable::ReleaseLockEntries(LockEntry* const* entries, size_t n) {
+  vector<LockEntry*> sorted(entries, entries + n);
+  std::sort(sorted.begin(), sorted.end(), [&](LockEntry* a, LockEntry* b) {
+      return FindStripe(a->key_hash_) < FindStripe(b->key_hash_);
+    });
+
+  vector<LockEntry*> removed;
+  size_t i = 0;
+  while (i < n) {
+    Stripe *stripe = FindStripe(sorted[i]->key_hash_);
+    removed.clear();
+    {
+      shared_lock<rw_spinlock> l(stripe->lock);
+      for (; i < n && FindStripe(sorted[i]->key_hash_) == stripe; i++) {
+        if (ReleaseLockEntryUnlocked(stripe, sorted[i])) {
+          removed.push_back(sorted[i]);
+        }
+      }
+    }
+    EntriesRemoved(stripe, removed.data(), removed.size());
+  }
 }
 
-void LockTable::Resize() {
-  // Calculate a new table size
+void LockTable::Resize(Stripe *stripe) {
+  // Calculate a new stripe size
   size_t new_size = 16;
-  while (new_size < base::subtle::NoBarrier_Load(&item_count_)) {
+  while (new_size < base::subtle::NoBarrier_Load(&stripe->item_count)) {
     new_size <<= 1;
   }
 
-  if (PREDICT_FALSE(size_ >= new_size))
+  if (PREDICT_FALSE(stripe->size >= new_size))
     return;
 
   // Allocate a new bucket list
@@ -248,8 +447,8 @@ void LockTable::Resize() {
   size_t new_mask = new_size - 1;
 
   // Copy entries
-  for (size_t i = 0; i < size_; ++i) {
-    LockEntry *p = buckets_[i].chain_head;
+  for (size_t i = 0; i < stripe->size; ++i) {
+    LockEntry *p = stripe->buckets[i].chain_head;
     while (p != nullptr) {
       LockEntry *next = p->ht_next_;
 
@@ -263,9 +462,9 @@ void LockTable::Resize() {
   }
 
   // Swap the bucket
-  mask_ = new_mask;
-  size_ = new_size;
-  buckets_.swap(new_buckets);
+  stripe->mask = new_mask;
+  stripe->size = new_size;
+  stripe->buckets.swap(new_buckets);
 }
 
 // ============================================================================
@@ -320,6 +519,15 @@ void ScopedRowLock::Release() {
   }
 }
 
+void ScopedRowLock::ReleaseBatch(const vector<ScopedRowLock*>& locks) {
+  for (const ScopedRowLock* l : locks) {
+    if (l->entry_) {
+      l->manager_->ReleaseBatch(locks);
+      return;
+    }
+  }
+}
+
 // ============================================================================
 //  LockManager
 // ============================================================================
@@ -337,11 +545,15 @@ LockManager::LockStatus LockManager::Lock(const Slice& key,
                                           LockManager::LockMode mode,
                                           LockEntry** entry) {
   *entry = locks_->GetLockEntry(key);
+  AcquireEntry(*entry, key, tx);
+  return LOCK_ACQUIRED;
+}
 
+void LockManager::AcquireEntry(LockEntry* entry, const Slice& key, const TransactionState* tx) {
   // We expect low contention, so just try to try_lock first. This is faster
   // than a timed_lock, since we don't have to do a syscall to get the current
   // time.
-  if (!(*entry)->sem.TryAcquire()) {
+  if (!entry->sem.TryAcquire()) {
     // If the current holder of this lock is the same transaction just return
     // a LOCK_ALREADY_ACQUIRED status without actually acquiring the mutex.
     //
@@ -351,9 +563,9 @@ LockManager::LockStatus LockManager::Lock(const Slice& key,
     // obtained and released at the same time). If at any time in the future
     // we opt to perform more fine grained locking, possibly letting transactions
     // release a portion of the locks they no longer need, this no longer is OK.
-    if (ANNOTATE_UNPROTECTED_READ((*entry)->holder_) == tx) {
-      (*entry)->recursion_++;
-      return LOCK_ACQUIRED;
+    if (ANNOTATE_UNPROTECTED_READ(entry->holder_) == tx) {
+      entry->recursion_++;
+      return;
     }
 
     // If we couldn't immediately acquire the lock, do a timed lock so we can
@@ -361,25 +573,55 @@ LockManager::LockStatus LockManager::Lock(const Slice& key,
     // TODO: would be nice to hook in some histogram metric about lock acquisition
     // time. For now we just associate with per-request metrics.
     TRACE_COUNTER_INCREMENT("row_lock_wait_count", 1);
-    MicrosecondsInt64 start_wait_us = GetMonoTimeMicros();
+    KUDU_PROBE(row_lock_wait_start, key.data(), key.size());
+    MonoTime start_wait = MonoTime::Now();
     int waited_seconds = 0;
-    while (!(*entry)->sem.TimedAcquire(MonoDelta::FromSeconds(1))) {
-      const TransactionState* cur_holder = ANNOTATE_UNPROTECTED_READ((*entry)->holder_);
+    while (!entry->sem.TimedAcquire(MonoDelta::FromSeconds(1))) {
+      const TransactionState* cur_holder = ANNOTATE_UNPROTECTED_READ(entry->holder_);
       LOG(WARNING) << "Waited " << (++waited_seconds) << " seconds to obtain row lock on key "
                    << KUDU_REDACT(key.ToDebugString()) << " cur holder: " << cur_holder;
       // TODO(unknown): would be nice to also include some info about the blocking transaction,
       // but it's a bit tricky to do in a non-racy fashion (the other transaction may
       // complete at any point)
     }
-    MicrosecondsInt64 wait_us = GetMonoTimeMicros() - start_wait_us;
+    MicrosecondsInt64 wait_us = (MonoTime::Now() - start_wait).ToMicroseconds();
+    KUDU_PROBE(row_lock_wait_done, key.data(), key.size(), wait_us);
     TRACE_COUNTER_INCREMENT("row_lock_wait_us", wait_us);
+    TRACE_SPAN("row_lock_wait", start_wait);
     if (wait_us > 100 * 1000) {
       TRACE("Waited $0us for lock on $1", wait_us, KUDU_REDACT(key.ToDebugString()));
     }
   }
 
-  (*entry)->holder_ = tx;
-  return LOCK_ACQUIRED;
+  entry->holder_ = tx;
+}
+
+void LockManager::AcquireLocks(const TransactionState* tx,
+                               const vector<Slice>& keys,
+                               LockManager::LockMode mode,
+                               vector<ScopedRowLock>* locks) {
+  const size_t n = keys.size();
+  vector<LockEntry*> entries(n);
+  locks_->GetLockEntries(keys.data(), n, entries.data());
+
+  // Take the locks in key order so that batches can't deadlock. Repeated
+  // keys share an entry, and are counted as recursive acquisitions.
+  vector<size_t> order(n);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+      return keys[a].compare(keys[b]) < 0;
+    });
+
+  locks->clear();
+  locks->resize(n);
+  for (size_t idx : order) {
+    AcquireEntry(entries[idx], keys[idx], tx);
+    ScopedRowLock* l = &(*locks)[idx];
+    l->manager_ = this;
+    l->entry_ = entries[idx];
+    l->ls_ = LOCK_ACQUIRED;
+    l->acquired_ = true;
+  }
 }
 
 LockManager::LockStatus LockManager::TryLock(const Slice& key,
@@ -396,7 +638,7 @@ LockManager::LockStatus LockManager::TryLock(const Slice& key,
   return LOCK_ACQUIRED;
 }
 
-void LockManager::Release(LockEntry *lock, LockStatus ls) {
+void LockManager::ReleaseEntry(LockEntry *lock, LockStatus ls) {
   DCHECK_NOTNULL(lock)->holder_ = nullptr;
   if (ls == LOCK_ACQUIRED) {
     if (lock->recursion_ > 0) {
@@ -405,8 +647,26 @@ void LockManager::Release(LockEntry *lock, LockStatus ls) {
       lock->sem.Release();
     }
   }
+}
+
+void LockManager::Release(LockEntry *lock, LockStatus ls) {
+  ReleaseEntry(lock, ls);
   locks_->ReleaseLockEntry(lock);
 }
 
+void LockManager::ReleaseBatch(const vector<ScopedRowLock*>& locks) {
+  vector<LockEntry*> entries;
+  entries.reserve(locks.size());
+  for (ScopedRowLock* l : locks) {
+    if (!l->entry_) continue;
+    DCHECK_EQ(this, l->manager_);
+    ReleaseEntry(l->entry_, l->ls_);
+    entries.push_back(l->entry_);
+    l->acquired_ = false;
+    l->entry_ = nullptr;
+  }
+  locks_->ReleaseLockEntries(entries.data(), entries.size());
+}
+
 } // namespace tablet
 } // namespace kudu
@@ -18,6 +18,7 @@
 #define KUDU_TABLET_LOCK_MANAGER_H
 
 #include <cstddef>
+#include <vector>
 
 #include "kudu/gutil/macros.h"
 #include "kudu/util/slice.h"
@@ -26,6 +27,7 @@ namespace kudu { namespace tablet {
 
 class LockTable;
 class LockEntry;
+class ScopedRowLock;
 class TransactionState;
 
 // Super-simple lock manager implementation. This only supports exclusive
@@ -49,6 +51,18 @@ class LockManager {
     LOCK_EXCLUSIVE
   };
 
+  // Lock all of the rows in 'keys' on behalf of 'tx', replacing the contents
+  // of 'locks' so that (*locks)[i] holds the lock on keys[i]. The 'keys'
+  // slices must remain valid and un-changed for as long as the locks are held.
+  //
+  // The rows are locked in key order regardless of the order of 'keys', so
+  // two batches with overlapping keys can't deadlock against each other.
+  // Keys may be repeated within a batch.
+  void AcquireLocks(const TransactionState* tx,
+                    const std::vector<Slice>& keys,
+                    LockMode mode,
+                    std::vector<ScopedRowLock>* locks);
+
  private:
   friend class ScopedRowLock;
   friend class LockManagerTest;
@@ -59,6 +73,16 @@ class LockManager {
                      LockMode mode, LockEntry **entry);
   void Release(LockEntry *lock, LockStatus ls);
 
+  // Wait for the lock on 'entry', the table entry for 'key', to be
+  // available and take it on behalf of 'tx'.
+  void AcquireEntry(LockEntry* entry, const Slice& key, const TransactionState* tx);
+
+  // Release the lock on 'lock' without dropping the table reference.
+  void ReleaseEntry(LockEntry *lock, LockStatus ls);
+
+  // Like Release(), for every lock in 'locks'.
+  void ReleaseBatch(const std::vector<ScopedRowLock*>& locks);
+
   LockTable *locks_;
 
   DISALLOW_COPY_AND_ASSIGN(LockManager);
@@ -109,6 +133,11 @@ class ScopedRowLock {
 
   void Release();
 
+  // Release all of the locks in 'locks', which must belong to the same
+  // LockManager. This is cheaper than releasing them one at a time.
+  // Locks which aren't held are ignored.
+  static void ReleaseBatch(const std::vector<ScopedRowLock*>& locks);
+
   bool acquired() const { return acquired_; }
 
   LockManager::LockStatus GetLockStatusForTests() { return ls_; }
@@ -116,6 +145,8 @@ class ScopedRowLock {
   ~ScopedRowLock();
 
  private:
+  friend class LockManager;
+
   void TakeState(ScopedRowLock* other);
 
   LockManager *manager_;
@@ -23,6 +23,7 @@
 #include <unordered_set>
 #include <vector>
 
+#include <gflags/gflags_declare.h>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 
@@ -30,10 +31,13 @@
 #include "kudu/common/iterator.h"
 #include "kudu/common/partial_row.h"
 #include "kudu/common/schema.h"
+#include "kudu/gutil/casts.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/stringprintf.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/tablet/delta_tracker.h"
+#include "kudu/tablet/diskrowset.h"
 #include "kudu/tablet/local_tablet_writer.h"
 #include "kudu/tablet/mvcc.h"
 #include "kudu/tablet/rowset.h"
@@ -42,6 +46,8 @@
 #include "kudu/util/status.h"
 #include "kudu/util/test_macros.h"
 
+DECLARE_int32(tablet_major_delta_compaction_column_groups);
+
 using std::shared_ptr;
 using std::string;
 using std::unordered_set;
@@ -267,6 +273,48 @@ TEST_F(TestMajorDeltaCompaction, TestUndos) {
   ASSERT_NO_FATAL_FAILURE(VerifyData());
 }
 
+// Test that a major delta compaction split into groups of columns compacts all
+// of them, keeps the deltas of the other columns, and writes readable UNDOs.
+TEST_F(TestMajorDeltaCompaction, TestCompactColumnGroups) {
+  FLAGS_tablet_major_delta_compaction_column_groups = 3;
+  const int kNumRows = 100;
+  ASSERT_NO_FATAL_FAILURE(WriteTestTablet(kNumRows));
+  ASSERT_OK(tablet()->Flush());
+
+  vector<shared_ptr<RowSet> > all_rowsets;
+  tablet()->GetRowSetsForTests(&all_rowsets);
+  shared_ptr<RowSet> rs = all_rowsets.front();
+  DeltaTracker* dt = down_cast<DiskRowSet*>(rs.get())->delta_tracker();
+
+  MvccSnapshot snap(*tablet()->mvcc_manager());
+  vector<ExpectedRow> old_state(expected_state_);
+  ASSERT_NO_FATAL_FAILURE(UpdateRows(kNumRows, false));
+  ASSERT_OK(tablet()->FlushBiggestDMS());
+  ASSERT_NO_FATAL_FAILURE(UpdateRows(kNumRows, true));
+  ASSERT_OK(tablet()->FlushBiggestDMS());
+  ASSERT_EQ(2, dt->CountRedoDeltaStores());
+  const size_t num_undo_stores = dt->CountUndoDeltaStores();
+
+  // Each group of columns writes its own UNDO file, and the updates of the
+  // column left out are carried over to a new REDO file.
+  vector<ColumnId> col_ids_to_compact = { schema_.column_id(1),
+                                          schema_.column_id(3) };
+  ASSERT_OK(tablet()->DoMajorDeltaCompaction(col_ids_to_compact, rs));
+  ASSERT_EQ(num_undo_stores + 2, dt->CountUndoDeltaStores());
+  ASSERT_EQ(1, dt->CountRedoDeltaStores());
+  ASSERT_NO_FATAL_FAILURE(VerifyData());
+  ASSERT_NO_FATAL_FAILURE(VerifyDataWithMvccAndExpectedState(snap, old_state));
+
+  ASSERT_NO_FATAL_FAILURE(UpdateRows(kNumRows, false));
+  ASSERT_OK(tablet()->FlushBiggestDMS());
+  col_ids_to_compact.push_back(schema_.column_id(4));
+  ASSERT_OK(tablet()->DoMajorDeltaCompaction(col_ids_to_compact, rs));
+  ASSERT_EQ(num_undo_stores + 5, dt->CountUndoDeltaStores());
+  ASSERT_EQ(0, dt->CountRedoDeltaStores());
+  ASSERT_NO_FATAL_FAILURE(VerifyData());
+  ASSERT_NO_FATAL_FAILURE(VerifyDataWithMvccAndExpectedState(snap, old_state));
+}
+
 // Test that the delete REDO mutations are written back and not filtered out.
 TEST_F(TestMajorDeltaCompaction, TestCarryDeletesOver) {
   const int kNumRows = 100;
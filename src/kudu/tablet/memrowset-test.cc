@@ -41,6 +41,7 @@
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/gutil/stringprintf.h"
 #include "kudu/tablet/memrowset.h"
+#include "kudu/tablet/mutation.h"
 #include "kudu/tablet/mvcc.h"
 #include "kudu/tablet/rowset.h"
 #include "kudu/tablet/tablet-test-util.h"
@@ -54,6 +55,8 @@
 #include "kudu/util/test_macros.h"
 #include "kudu/util/test_util.h"
 
+DECLARE_int32(mrs_mutation_chain_compaction_threshold);
+
 DEFINE_int32(roundtrip_num_rows, 10000,
              "Number of rows to use for the round-trip test");
 DEFINE_int32(num_scan_passes, 1,
@@ -561,5 +564,109 @@ TEST_F(TestMemRowSet, TestUpdateMVCC) {
   }
 }
 
+// Test that the updates of a frequently updated row which are older than the
+// compaction watermark are collapsed, without changing what the snapshots
+// allowed by the watermark read.
+TEST_F(TestMemRowSet, TestCompactMutationChain) {
+  FLAGS_mrs_mutation_chain_compaction_threshold = 8;
+  shared_ptr<MemRowSet> mrs;
+  ASSERT_OK(MemRowSet::Create(0, schema_, log_anchor_registry_.get(),
+                              MemTracker::GetRootTracker(), &mrs));
+  ASSERT_OK(InsertRow(mrs.get(), "my row", 0));
+
+  const auto chain_length = [&]() {
+    gscoped_ptr<MemRowSet::Iterator> iter(mrs->NewIterator());
+    CHECK_OK(iter->Init(nullptr));
+    CHECK(iter->HasNext());
+    MRSRow row = iter->GetCurrentRow();
+    int len = 0;
+    for (const Mutation* mut = row.acquire_redo_head(); mut != nullptr; mut = mut->next()) {
+      len++;
+    }
+    return len;
+  };
+
+  // Until the watermark moves, the mutations of the row pile up.
+  vector<MvccSnapshot> snapshots;
+  for (uint32_t i = 1; i <= 15; i++) {
+    OperationResultPB result;
+    ASSERT_OK(UpdateRow(mrs.get(), "my row", i, &result));
+    snapshots.emplace_back(mvcc_);
+  }
+  ASSERT_EQ(15, chain_length());
+
+  // Once it does, the next update collapses the 15 updates below it.
+  mrs->AdvanceMutationCompactionWatermark(clock_->Now());
+  for (uint32_t i = 16; i <= 20; i++) {
+    OperationResultPB result;
+    ASSERT_OK(UpdateRow(mrs.get(), "my row", i, &result));
+    snapshots.emplace_back(mvcc_);
+  }
+  ASSERT_EQ(6, chain_length());
+
+  for (uint32_t i = 15; i <= 20; i++) {
+    SCOPED_TRACE(i);
+    vector<string> rows;
+    ASSERT_OK(kudu::tablet::DumpRowSet(*mrs, schema_, snapshots[i - 1], &rows));
+    ASSERT_EQ(1, rows.size());
+    EXPECT_EQ(StringPrintf(R"((string key="my row", uint32 val=%d))", i), rows[0]);
+  }
+}
+
+// Test that the mutations an open iterator may still read aren't collapsed
+// when the compaction watermark moves past its snapshot, and that they are
+// once the iterator is destroyed.
+TEST_F(TestMemRowSet, TestCompactMutationChainWithOpenIterator) {
+  FLAGS_mrs_mutation_chain_compaction_threshold = 8;
+  shared_ptr<MemRowSet> mrs;
+  ASSERT_OK(MemRowSet::Create(0, schema_, log_anchor_registry_.get(),
+                              MemTracker::GetRootTracker(), &mrs));
+  ASSERT_OK(InsertRow(mrs.get(), "my row", 0));
+  for (uint32_t i = 1; i <= 5; i++) {
+    OperationResultPB result;
+    ASSERT_OK(UpdateRow(mrs.get(), "my row", i, &result));
+  }
+
+  // Open a scan which reads the row as of the 5th update, before the
+  // watermark moves past its snapshot and the row is updated many more times.
+  gscoped_ptr<MemRowSet::Iterator> iter(mrs->NewIterator(&schema_, MvccSnapshot(mvcc_)));
+  ASSERT_OK(iter->Init(nullptr));
+  for (uint32_t i = 6; i <= 20; i++) {
+    OperationResultPB result;
+    ASSERT_OK(UpdateRow(mrs.get(), "my row", i, &result));
+  }
+  mrs->AdvanceMutationCompactionWatermark(clock_->Now());
+  for (uint32_t i = 21; i <= 25; i++) {
+    OperationResultPB result;
+    ASSERT_OK(UpdateRow(mrs.get(), "my row", i, &result));
+  }
+
+  vector<string> rows;
+  ASSERT_OK(IterateToStringList(iter.get(), &rows));
+  ASSERT_EQ(1, rows.size());
+  EXPECT_EQ(R"((string key="my row", uint32 val=5))", rows[0]);
+
+  // Once the scan is done, all the updates below the watermark may be
+  // collapsed.
+  iter.reset();
+  mrs->AdvanceMutationCompactionWatermark(clock_->Now());
+  OperationResultPB result;
+  ASSERT_OK(UpdateRow(mrs.get(), "my row", 26, &result));
+  iter.reset(mrs->NewIterator());
+  ASSERT_OK(iter->Init(nullptr));
+  ASSERT_TRUE(iter->HasNext());
+  MRSRow row = iter->GetCurrentRow();
+  int len = 0;
+  for (const Mutation* mut = row.acquire_redo_head(); mut != nullptr; mut = mut->next()) {
+    len++;
+  }
+  EXPECT_EQ(2, len);
+
+  rows.clear();
+  ASSERT_OK(kudu::tablet::DumpRowSet(*mrs, schema_, MvccSnapshot(mvcc_), &rows));
+  ASSERT_EQ(1, rows.size());
+  EXPECT_EQ(R"((string key="my row", uint32 val=26))", rows[0]);
+}
+
 } // namespace tablet
 } // namespace kudu
@@ -17,6 +17,8 @@
 
 #include "kudu/tablet/memrowset.h"
 
+#include <algorithm>
+#include <deque>
 #include <memory>
 #include <string>
 #include <type_traits>
@@ -27,7 +29,10 @@
 #include <glog/logging.h>
 
 #include "kudu/codegen/compilation_manager.h"
+#include "kudu/codegen/row_key_functions.h"
+#include "kudu/codegen/row_predicate.h"
 #include "kudu/codegen/row_projector.h"
+#include "kudu/common/column_predicate.h"
 #include "kudu/common/columnblock.h"
 #include "kudu/common/common.pb.h"
 #include "kudu/common/encoded_key.h"
@@ -37,20 +42,37 @@
 #include "kudu/common/scan_spec.h"
 #include "kudu/consensus/log_anchor_registry.h"
 #include "kudu/consensus/opid.pb.h"
+#include "kudu/gutil/atomicops.h"
 #include "kudu/gutil/dynamic_annotations.h"
 #include "kudu/gutil/move.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/tablet/compaction.h"
 #include "kudu/tablet/mutation.h"
 #include "kudu/tablet/tablet.pb.h"
+#include "kudu/util/faststring.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/mem_tracker.h"
 #include "kudu/util/memory/memory.h"
 
 DEFINE_bool(mrs_use_codegen, true, "whether the memrowset should use code "
-            "generation for iteration");
+            "generation for iteration and key encoding");
 TAG_FLAG(mrs_use_codegen, hidden);
 
+DEFINE_bool(mrs_codegen_warm_up, true, "whether to compile the memrowset row "
+            "projectors for a tablet's full schema and key projection in the "
+            "background while the tablet is opening");
+TAG_FLAG(mrs_codegen_warm_up, experimental);
+
+DEFINE_int32(mrs_mutation_chain_compaction_threshold, 32,
+             "Length of the mutation list of a memrowset row past which the "
+             "updates of the row that are older than the snapshots of the open "
+             "scans and of any scan which may still be started are collapsed "
+             "into one, so that reads and updates "
+             "of frequently updated rows do not slow down until the next "
+             "flush. 0 disables the compaction.");
+TAG_FLAG(mrs_mutation_chain_compaction_threshold, advanced);
+TAG_FLAG(mrs_mutation_chain_compaction_threshold, runtime);
+
 using std::shared_ptr;
 using std::string;
 using std::vector;
@@ -95,6 +117,14 @@ shared_ptr<MemTracker> CreateMemTrackerForMemRowSet(
 
 } // anonymous namespace
 
+void MemRowSet::WarmUpCodegen(const Schema& schema) {
+  if (!FLAGS_mrs_use_codegen || !FLAGS_mrs_codegen_warm_up) return;
+  codegen::CompilationManager* cm = codegen::CompilationManager::GetSingleton();
+  // Scans of every column, and of the key alone (e.g. to count rows).
+  cm->WarmUpRowProjector(schema, schema);
+  cm->WarmUpRowProjector(schema, schema.CreateKeyProjection());
+}
+
 Status MemRowSet::Create(int64_t id,
                          const Schema &schema,
                          LogAnchorRegistry* log_anchor_registry,
@@ -113,14 +143,23 @@ MemRowSet::MemRowSet(int64_t id,
                      shared_ptr<MemTracker> parent_tracker)
   : id_(id),
     schema_(schema),
-    allocator_(new MemoryTrackingBufferAllocator(HeapBufferAllocator::Get(),
-                                                 CreateMemTrackerForMemRowSet(id, parent_tracker))),
-    arena_(new ThreadSafeMemoryTrackingArena(kInitialArenaSize, allocator_)),
+    allocator_(new MemoryTrackingBufferAllocator(
+        HugePageBufferAllocator::Get(), CreateMemTrackerForMemRowSet(id, parent_tracker))),
+    arena_(new PerCpuMemoryTrackingArena(kInitialArenaSize, allocator_)),
     tree_(arena_),
     debug_insert_count_(0),
     debug_update_count_(0),
+    live_row_count_(0),
+    mutation_compaction_watermark_(Timestamp::kMin.value()),
     anchorer_(log_anchor_registry, Substitute("MemRowSet-$0", id_)) {
   CHECK(schema.has_column_ids());
+  if (FLAGS_mrs_use_codegen) {
+    // The key functions only depend on the key column types, so they are
+    // compiled once per table: unless this is the tablet's first memrowset,
+    // they are most likely cached already.
+    codegen::CompilationManager::GetSingleton()->RequestRowKeyFunctions(schema_,
+                                                                        &key_functions_);
+  }
   ANNOTATE_BENIGN_RACE(&debug_insert_count_, "insert count isnt accurate");
   ANNOTATE_BENIGN_RACE(&debug_update_count_, "update count isnt accurate");
 }
@@ -153,8 +192,7 @@ Status MemRowSet::Insert(Timestamp timestamp,
 
   {
     faststring enc_key_buf;
-    schema_.EncodeComparableKey(row, &enc_key_buf);
-    Slice enc_key(enc_key_buf);
+    Slice enc_key = EncodeComparableKey(row, &enc_key_buf);
 
     btree::PreparedMutation<MSBTreeTraits> mutation(enc_key);
     mutation.Prepare(&tree_);
@@ -191,9 +229,17 @@ Status MemRowSet::Insert(Timestamp timestamp,
   anchorer_.AnchorIfMinimum(op_id.index());
 
   debug_insert_count_++;
+  live_row_count_.Increment();
   return Status::OK();
 }
 
+Slice MemRowSet::EncodeComparableKey(const ConstContiguousRow& row, faststring* dst) const {
+  if (key_functions_) {
+    return key_functions_->EncodeComparableKey(row, dst);
+  }
+  return schema_.EncodeComparableKey(row, dst);
+}
+
 Status MemRowSet::Reinsert(Timestamp timestamp, const ConstContiguousRow& row, MRSRow *ms_row) {
   DCHECK_SCHEMA_EQ(schema_, *row.schema());
 
@@ -210,6 +256,7 @@ Status MemRowSet::Reinsert(Timestamp timestamp, const ConstContiguousRow& row, M
   // for the mutation are fully published before any concurrent reader sees
   // the appended mutation.
   mut->AppendToListAtomic(&ms_row->header_->redo_head);
+  live_row_count_.Increment();
   return Status::OK();
 }
 
@@ -242,10 +289,18 @@ Status MemRowSet::MutateRow(Timestamp timestamp,
     // This function has "release" semantics which ensures that the memory writes
     // for the mutation are fully published before any concurrent reader sees
     // the appended mutation.
-    mut->AppendToListAtomic(&row.header_->redo_head);
+    int chain_len = mut->AppendToListAtomic(&row.header_->redo_head);
+    int threshold = FLAGS_mrs_mutation_chain_compaction_threshold;
+    if (PREDICT_FALSE(threshold > 0 && chain_len >= threshold)) {
+      WARN_NOT_OK(CompactMutationChainUnlocked(&row.header_->redo_head),
+                  "failed to compact the mutations of a memrowset row");
+    }
 
     MemStoreTargetPB* target = result->add_mutated_stores();
     target->set_mrs_id(id_);
+    if (delta.is_delete()) {
+      live_row_count_.IncrementBy(-1);
+    }
   }
 
   stats->mrs_consulted++;
@@ -255,6 +310,103 @@ Status MemRowSet::MutateRow(Timestamp timestamp,
   return Status::OK();
 }
 
+Timestamp MemRowSet::EffectiveMutationCompactionWatermark() const {
+  Timestamp watermark(mutation_compaction_watermark_.Load());
+  std::lock_guard<simple_spinlock> l(iterator_snapshots_lock_);
+  if (!iterator_snapshots_.empty()) {
+    watermark = std::min(watermark, *iterator_snapshots_.begin());
+  }
+  return watermark;
+}
+
+void MemRowSet::RegisterIteratorSnapshot(Timestamp all_committed_before) const {
+  std::lock_guard<simple_spinlock> l(iterator_snapshots_lock_);
+  iterator_snapshots_.insert(all_committed_before);
+}
+
+void MemRowSet::UnregisterIteratorSnapshot(Timestamp all_committed_before) const {
+  std::lock_guard<simple_spinlock> l(iterator_snapshots_lock_);
+  auto it = iterator_snapshots_.find(all_committed_before);
+  DCHECK(it != iterator_snapshots_.end());
+  iterator_snapshots_.erase(it);
+}
+
+Status MemRowSet::CompactMutationChainUnlocked(Mutation** redo_head) {
+  // An open iterator reads the mutation list of the row again for each of
+  // its batches, so a run of mutations may only be collapsed if each open
+  // snapshot sees either all of it or none of it.
+  const Timestamp watermark = EffectiveMutationCompactionWatermark();
+
+  // Mutations of a row are ordered by timestamp, so the ones which may be
+  // collapsed are a prefix of the list. DELETEs and REINSERTs are kept as
+  // they are, so that the liveness history of the row is unchanged.
+  vector<std::pair<Timestamp, RowChangeList>> compacted;
+  std::deque<faststring> merged_bufs;
+  vector<RowChangeList> run;
+  Timestamp run_timestamp;
+  int num_collapsed = 0;
+  const auto flush_run = [&]() -> Status {
+    if (run.size() > 1) {
+      merged_bufs.emplace_back();
+      RowChangeListEncoder enc(&merged_bufs.back());
+      RETURN_NOT_OK(RowChangeListDecoder::MergeUpdates(run, &enc));
+      compacted.emplace_back(run_timestamp, RowChangeList(merged_bufs.back()));
+      num_collapsed += run.size() - 1;
+    } else if (run.size() == 1) {
+      compacted.emplace_back(run_timestamp, run[0]);
+    }
+    run.clear();
+    return Status::OK();
+  };
+  bool below_watermark = true;
+  for (const Mutation* mut = *redo_head; mut != nullptr; mut = mut->next()) {
+    const RowChangeList rcl = mut->changelist();
+    below_watermark = below_watermark && mut->timestamp() < watermark;
+    if (below_watermark && !rcl.is_delete() && !rcl.is_reinsert()) {
+      run.push_back(rcl);
+      run_timestamp = mut->timestamp();
+      continue;
+    }
+    RETURN_NOT_OK(flush_run());
+    compacted.emplace_back(mut->timestamp(), rcl);
+  }
+  RETURN_NOT_OK(flush_run());
+
+  // Copying the list only pays off if it gets much shorter; this also bounds
+  // the arena memory spent on copies of the list to a constant factor.
+  if (num_collapsed < std::max(1, FLAGS_mrs_mutation_chain_compaction_threshold / 2)) {
+    return Status::OK();
+  }
+
+  size_t total_size = 0;
+  for (const auto& e : compacted) {
+    total_size += Mutation::AlignedSize(e.second);
+  }
+  uint8_t* storage = static_cast<uint8_t*>(
+      arena_->AllocateBytesAligned(total_size, BASE_PORT_H_ALIGN_OF(Mutation)));
+  if (PREDICT_FALSE(storage == nullptr)) {
+    return Status::RuntimeError("failed to allocate storage from arena");
+  }
+  Mutation* head = nullptr;
+  Mutation* prev = nullptr;
+  for (const auto& e : compacted) {
+    Mutation* mut = Mutation::CreateAt(storage, e.first, e.second);
+    storage += Mutation::AlignedSize(e.second);
+    if (prev == nullptr) {
+      head = mut;
+    } else {
+      prev->set_next(mut);
+    }
+    prev = mut;
+  }
+
+  // Publish the new list with "release" semantics, so that concurrent readers
+  // see either the old list or the fully built new one.
+  base::subtle::Release_Store(reinterpret_cast<AtomicWord*>(redo_head),
+                              reinterpret_cast<AtomicWord>(head));
+  return Status::OK();
+}
+
 Status MemRowSet::CheckRowPresent(const RowSetKeyProbe &probe, bool *present,
                                   ProbeStats* stats) const {
   // Use a PreparedMutation here even though we don't plan to mutate. Even though
@@ -393,6 +545,7 @@ MemRowSet::Iterator::Iterator(const std::shared_ptr<const MemRowSet>& mrs,
           GenerateAppropriateProjector(&mrs->schema_nonvirtual(), projection)),
       delta_projector_(&mrs->schema_nonvirtual(), projection),
       state_(kUninitialized) {
+  memrowset_->RegisterIteratorSnapshot(mvcc_snap_.all_committed_before());
   // TODO: various code assumes that a newly constructed iterator
   // is pointed at the beginning of the dataset. This causes a redundant
   // seek. Could make this lazy instead, or change the semantics so that
@@ -400,7 +553,9 @@ MemRowSet::Iterator::Iterator(const std::shared_ptr<const MemRowSet>& mrs,
   iter_->SeekToStart();
 }
 
-MemRowSet::Iterator::~Iterator() {}
+MemRowSet::Iterator::~Iterator() {
+  memrowset_->UnregisterIteratorSnapshot(mvcc_snap_.all_committed_before());
+}
 
 Status MemRowSet::Iterator::Init(ScanSpec *spec) {
   DCHECK_EQ(state_, kUninitialized);
@@ -424,16 +579,44 @@ Status MemRowSet::Iterator::Init(ScanSpec *spec) {
     exclusive_upper_bound_.reset(upper_bound);
   }
 
+  if (FLAGS_mrs_use_codegen && spec && !spec->predicates().empty()) {
+    MaybeGenerateRowPredicate(*spec);
+  }
+
   state_ = kScanning;
   return Status::OK();
 }
 
+void MemRowSet::Iterator::MaybeGenerateRowPredicate(const ScanSpec& spec) {
+  const Schema& base = memrowset_->schema_nonvirtual();
+  vector<ColumnPredicate> predicates;
+  predicates.reserve(spec.predicates().size());
+  for (const auto& col_pred : spec.predicates()) {
+    // The compiled predicate looks columns up in the memrowset schema by
+    // name, so it can only be used if every predicate column is read from
+    // the memrowset under that name (and not, e.g., filled in with the
+    // default of a column which was added after the memrowset was created).
+    int proj_idx = projection_->find_column(col_pred.first);
+    bool found = false;
+    for (const auto& mapping : projector_->base_cols_mapping()) {
+      if (mapping.first == proj_idx) {
+        found = base.column(mapping.second).name() == col_pred.first;
+        break;
+      }
+    }
+    if (!found) return;
+    predicates.push_back(col_pred.second);
+  }
+  codegen::CompilationManager::GetSingleton()->RequestRowPredicate(
+      &base, predicates, &row_predicate_);
+}
+
 Status MemRowSet::Iterator::SeekAtOrAfter(const Slice &key, bool *exact) {
   DCHECK_NE(state_, kUninitialized) << "not initted";
 
   if (key.size() > 0) {
     ConstContiguousRow row_slice(&memrowset_->schema(), key);
-    memrowset_->schema().EncodeComparableKey(row_slice, &tmp_buf);
+    memrowset_->EncodeComparableKey(row_slice, &tmp_buf);
   } else {
     // Seeking to empty key shouldn't try to run any encoding.
     tmp_buf.resize(0);
@@ -501,11 +684,16 @@ Status MemRowSet::Iterator::FetchRows(RowBlock* dst, size_t* fetched) {
       if (has_upper_bound() && out_of_bounds(k)) {
         state_ = kFinished;
         break;
+      }
+      Mutation* redo_head = reinterpret_cast<Mutation*>(
+          base::subtle::Acquire_Load(reinterpret_cast<AtomicWord*>(&row.header_->redo_head)));
+      if (redo_head == nullptr && row_predicate_ && !row_predicate_->Evaluate(row)) {
+        // The row was never mutated, so the inserted values are the ones the
+        // predicates would see after projection: skip the copy.
+        dst->selection_vector()->SetRowUnselected(*fetched);
       } else {
         RETURN_NOT_OK(projector_->ProjectRowForRead(row, &dst_row, dst->arena()));
 
-        Mutation* redo_head = reinterpret_cast<Mutation*>(
-            base::subtle::Acquire_Load(reinterpret_cast<AtomicWord*>(&row.header_->redo_head)));
         // Roll-forward MVCC for committed updates.
         RETURN_NOT_OK(ApplyMutationsToProjectedRow(
             redo_head, &dst_row, dst->arena()));
@@ -22,6 +22,7 @@
 #include <memory>
 #include <mutex>
 #include <ostream>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -39,11 +40,14 @@
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/port.h"
+#include "kudu/gutil/ref_counted.h"
 #include "kudu/tablet/concurrent_btree.h"
 #include "kudu/tablet/mvcc.h"
 #include "kudu/tablet/rowset.h"
 #include "kudu/tablet/rowset_metadata.h"
+#include "kudu/util/atomic.h"
 #include "kudu/util/faststring.h"
+#include "kudu/util/locks.h"
 #include "kudu/util/memory/arena.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/slice.h"
@@ -59,6 +63,11 @@ class RowChangeList;
 class ScanSpec;
 struct IteratorStats;
 
+namespace codegen {
+class RowKeyFunctions;
+class RowPredicate;
+} // namespace codegen
+
 namespace consensus {
 class OpId;
 }
@@ -78,6 +87,8 @@ namespace tablet {
 //
 // NOTE: all allocations done by the MemRowSet are done inside its associated
 // thread-safe arena, and then freed in bulk when the MemRowSet is destructed.
+// The arena is striped per-CPU so that concurrent inserters running on
+// different cores don't contend on a single allocation pointer.
 
 class CompactionInput;
 class MemRowSet;
@@ -181,7 +192,7 @@ class MRSRow {
 };
 
 struct MSBTreeTraits : public btree::BTreeTraits {
-  typedef ThreadSafeMemoryTrackingArena ArenaType;
+  typedef PerCpuMemoryTrackingArena ArenaType;
 };
 
 // Define an MRSRow instance using on-stack storage.
@@ -207,6 +218,12 @@ class MemRowSet : public RowSet,
  public:
   class Iterator;
 
+  // Requests background compilation of the row projectors which scans of a
+  // memrowset with the given schema are most likely to use, so that the
+  // first scans after a tablet opens need not take the slow path.
+  // Does nothing unless code generation is enabled for memrowsets.
+  static void WarmUpCodegen(const Schema& schema);
+
   static Status Create(int64_t id,
                        const Schema &schema,
                        log::LogAnchorRegistry* log_anchor_registry,
@@ -240,6 +257,17 @@ class MemRowSet : public RowSet,
                            ProbeStats* stats,
                            OperationResultPB *result) OVERRIDE;
 
+  // Allow the mutations which committed before 'ts' to be collapsed together
+  // once the mutation list of a row grows long (see
+  // --mrs_mutation_chain_compaction_threshold). The caller guarantees that
+  // no new iterator of this memrowset uses a snapshot in which some mutation
+  // before 'ts' isn't committed; iterators which are already open keep the
+  // mutations they may still read from being collapsed until they're
+  // destroyed. The watermark never moves backwards.
+  void AdvanceMutationCompactionWatermark(Timestamp ts) {
+    mutation_compaction_watermark_.StoreMax(ts.value());
+  }
+
   // Return the number of entries in the memrowset.
   // NOTE: this requires iterating all data, and is thus
   // not very fast.
@@ -253,6 +281,11 @@ class MemRowSet : public RowSet,
     return Status::OK();
   }
 
+  Status CountLiveRows(int64_t* count) const OVERRIDE {
+    *count = live_row_count_.Load();
+    return Status::OK();
+  }
+
   virtual Status GetBounds(std::string *min_encoded_key,
                            std::string *max_encoded_key) const OVERRIDE;
 
@@ -330,6 +363,12 @@ class MemRowSet : public RowSet,
     return id_;
   }
 
+  // The code-generated key functions for this memrowset's schema, or NULL
+  // if they weren't compiled yet when the memrowset was created.
+  const codegen::RowKeyFunctions* key_functions() const {
+    return key_functions_.get();
+  }
+
   std::shared_ptr<RowSetMetadata> metadata() OVERRIDE {
     return std::shared_ptr<RowSetMetadata>(
         reinterpret_cast<RowSetMetadata *>(NULL));
@@ -392,6 +431,17 @@ class MemRowSet : public RowSet,
     return Status::OK();
   }
 
+  Status IsExpiredBeforeAncientHistory(const HistoryGcOpts& /*history_gc_opts*/,
+                                       bool* expired) OVERRIDE {
+    *expired = false;
+    return Status::OK();
+  }
+
+  Status MayHaveWritesSince(Timestamp /*timestamp*/, bool* may_have_writes) OVERRIDE {
+    *may_have_writes = true;
+    return Status::OK();
+  }
+
   Status FlushDeltas() OVERRIDE { return Status::OK(); }
 
   Status MinorCompactDeltaStores() OVERRIDE { return Status::OK(); }
@@ -410,13 +460,38 @@ class MemRowSet : public RowSet,
                   const ConstContiguousRow& row,
                   MRSRow *ms_row);
 
+  // Encodes the key of 'row' into 'dst' as Schema::EncodeComparableKey()
+  // does, with the code-generated key functions if there are any.
+  Slice EncodeComparableKey(const ConstContiguousRow& row, faststring* dst) const;
+
+  // Replace the mutation list at 'redo_head' with a copy in which every run
+  // of consecutive UPDATEs older than the compaction watermark is collapsed
+  // into one, laid out contiguously in the arena. Concurrent readers of the
+  // old list are unaffected: its mutations stay in the arena until the
+  // memrowset is destroyed. Does nothing unless enough mutations collapse
+  // to pay for the copy.
+  //
+  // Requires that the row is locked against concurrent mutation.
+  Status CompactMutationChainUnlocked(Mutation** redo_head);
+
+  // Returns the timestamp before which mutations may be collapsed: the
+  // compaction watermark, unless an open iterator uses a snapshot in which
+  // some mutation before it isn't committed.
+  Timestamp EffectiveMutationCompactionWatermark() const;
+
+  // Register and unregister the snapshot of an open iterator, by the
+  // timestamp before which all of its mutations are committed.
+  void RegisterIteratorSnapshot(Timestamp all_committed_before) const;
+  void UnregisterIteratorSnapshot(Timestamp all_committed_before) const;
+
   typedef btree::CBTree<MSBTreeTraits> MSBTree;
 
   int64_t id_;
 
   const Schema schema_;
+  scoped_refptr<codegen::RowKeyFunctions> key_functions_;
   std::shared_ptr<MemoryTrackingBufferAllocator> allocator_;
-  std::shared_ptr<ThreadSafeMemoryTrackingArena> arena_;
+  std::shared_ptr<PerCpuMemoryTrackingArena> arena_;
 
   typedef btree::CBTreeIterator<MSBTreeTraits> MSBTIter;
 
@@ -428,6 +503,17 @@ class MemRowSet : public RowSet,
   volatile uint64_t debug_insert_count_;
   volatile uint64_t debug_update_count_;
 
+  // The number of rows inserted or reinserted, less the number deleted.
+  AtomicInt<int64_t> live_row_count_;
+
+  // The value of the timestamp before which mutations may be collapsed.
+  AtomicInt<uint64_t> mutation_compaction_watermark_;
+
+  // The snapshots of the open iterators of this memrowset, as registered with
+  // RegisterIteratorSnapshot(), which bound the compaction watermark.
+  mutable simple_spinlock iterator_snapshots_lock_;
+  mutable std::multiset<Timestamp> iterator_snapshots_;
+
   std::mutex compact_flush_lock_;
 
   log::MinLogIndexAnchorer anchorer_;
@@ -532,6 +618,10 @@ class MemRowSet::Iterator : public RowwiseIterator {
            MemRowSet::MSBTIter *iter, const Schema *projection,
            MvccSnapshot mvcc_snap);
 
+  // Requests a code-generated evaluator for the predicates of 'spec',
+  // setting 'row_predicate_' if one is already compiled.
+  void MaybeGenerateRowPredicate(const ScanSpec& spec);
+
   // Various helper functions called while getting the next RowBlock
   Status FetchRows(RowBlock* dst, size_t* fetched);
   Status ApplyMutationsToProjectedRow(const Mutation *mutation_head,
@@ -553,6 +643,12 @@ class MemRowSet::Iterator : public RowwiseIterator {
   gscoped_ptr<MRSRowProjector> projector_;
   DeltaProjector delta_projector_;
 
+  // Code-generated conjunction of the scan's predicates over the memrowset
+  // schema, if one is available. Used to skip projecting rows which cannot
+  // match; the predicates themselves are still evaluated on the projected
+  // rows by the caller, since mutations may change the values they refer to.
+  gscoped_ptr<codegen::RowPredicate> row_predicate_;
+
   // Temporary buffer used for RowChangeList projection.
   faststring delta_buf_;
 
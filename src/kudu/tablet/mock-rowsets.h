@@ -64,6 +64,10 @@ class MockRowSet : public RowSet {
     LOG(FATAL) << "Unimplemented";
     return Status::OK();
   }
+  virtual Status CountLiveRows(int64_t* count) const OVERRIDE {
+    LOG(FATAL) << "Unimplemented";
+    return Status::OK();
+  }
   virtual std::string ToString() const OVERRIDE {
     LOG(FATAL) << "Unimplemented";
     return "";
@@ -148,6 +152,18 @@ class MockRowSet : public RowSet {
     return Status::OK();
   }
 
+  virtual Status IsExpiredBeforeAncientHistory(const HistoryGcOpts& /*history_gc_opts*/,
+                                               bool* /*expired*/) OVERRIDE {
+    LOG(FATAL) << "Unimplemented";
+    return Status::OK();
+  }
+
+  virtual Status MayHaveWritesSince(Timestamp /*timestamp*/,
+                                    bool* /*may_have_writes*/) OVERRIDE {
+    LOG(FATAL) << "Unimplemented";
+    return Status::OK();
+  }
+
   virtual bool IsAvailableForCompaction() OVERRIDE {
     return true;
   }
@@ -160,7 +176,8 @@ class MockDiskRowSet : public MockRowSet {
                  int size = 1000000)
       : first_key_(std::move(first_key)),
         last_key_(std::move(last_key)),
-        size_(size) {}
+        size_(size),
+        access_count_(0) {}
 
   virtual Status GetBounds(std::string* min_encoded_key,
                            std::string* max_encoded_key) const OVERRIDE {
@@ -181,6 +198,14 @@ class MockDiskRowSet : public MockRowSet {
     return size_;
   }
 
+  virtual uint64_t AccessCount() const OVERRIDE {
+    return access_count_;
+  }
+
+  void set_access_count(uint64_t access_count) {
+    access_count_ = access_count;
+  }
+
   virtual std::string ToString() const OVERRIDE {
     return strings::Substitute("mock[$0, $1]",
                                Slice(first_key_).ToDebugString(),
@@ -191,6 +216,7 @@ class MockDiskRowSet : public MockRowSet {
   const std::string first_key_;
   const std::string last_key_;
   const uint64_t size_;
+  uint64_t access_count_;
 };
 
 // Mock which acts like a MemRowSet and has no known bounds.
@@ -17,21 +17,67 @@
 
 #include "kudu/tablet/multi_column_writer.h"
 
+#include <algorithm>
+#include <cstring>
 #include <memory>
 #include <ostream>
 #include <string>
 #include <utility>
 
+#include <gflags/gflags.h>
+
+#include "kudu/cfile/bloomfile.h"
 #include "kudu/cfile/cfile_util.h"
 #include "kudu/cfile/cfile_writer.h"
 #include "kudu/common/columnblock.h"
+#include "kudu/common/key_encoder.h"
 #include "kudu/common/rowblock.h"
 #include "kudu/common/schema.h"
+#include "kudu/common/types.h"
 #include "kudu/fs/block_id.h"
 #include "kudu/fs/block_manager.h"
 #include "kudu/fs/fs_manager.h"
+#include "kudu/fs/io_scheduler.h"
+#include "kudu/gutil/endian.h"
 #include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/ref_counted.h"
 #include "kudu/gutil/stl_util.h"
+#include "kudu/util/bitmap.h"
+#include "kudu/util/bloom_filter.h"
+#include "kudu/util/countdown_latch.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/memory/arena.h"
+#include "kudu/util/slice.h"
+#include "kudu/util/threadpool.h"
+#include "kudu/util/trace.h"
+
+DEFINE_int32(tablet_column_writer_threads, 0,
+             "Number of threads with which each rowset writer encodes and "
+             "compresses its columns, in the background of the flush or "
+             "compaction producing the rows. If 0, the columns are written "
+             "one after another by the flush or compaction's thread.");
+TAG_FLAG(tablet_column_writer_threads, experimental);
+TAG_FLAG(tablet_column_writer_threads, runtime);
+
+DEFINE_int32(tablet_secondary_index_max_size_mb, 256,
+             "Size of the entries of a column's secondary index which each "
+             "rowset writer buffers at most until the index is written out. "
+             "Past it, the rowset is written without an index of the column.");
+TAG_FLAG(tablet_secondary_index_max_size_mb, advanced);
+TAG_FLAG(tablet_secondary_index_max_size_mb, runtime);
+
+DEFINE_int32(tablet_column_bloom_filter_max_size_mb, 256,
+             "Size of the distinct values of a column with a bloom filter "
+             "which each rowset writer buffers at most until the filter is "
+             "written out. Past it, the rowset is written without a bloom "
+             "filter of the column.");
+TAG_FLAG(tablet_column_bloom_filter_max_size_mb, advanced);
+TAG_FLAG(tablet_column_bloom_filter_max_size_mb, runtime);
+
+DECLARE_int32(default_composite_key_index_block_size_bytes);
+DECLARE_int32(tablet_bloom_block_size);
+DECLARE_double(tablet_bloom_target_fp_rate);
 
 namespace kudu {
 namespace tablet {
@@ -39,19 +85,140 @@ namespace tablet {
 using cfile::CFileWriter;
 using fs::BlockCreationTransaction;
 using fs::CreateBlockOptions;
+using fs::IOPriority;
+using fs::ScopedIOPriority;
 using fs::WritableBlock;
+using std::shared_ptr;
+using std::string;
 using std::unique_ptr;
+using std::vector;
+
+namespace {
+
+// The maximum number of blocks which may be pending at once. Bounds the
+// memory used by the copies of the blocks.
+const size_t kMaxPendingBlocks = 4;
+
+Status AppendColumnBlock(CFileWriter* writer, const ColumnBlock& column) {
+  if (column.is_nullable()) {
+    return writer->AppendNullableEntries(column.null_bitmap(),
+                                         column.data(), column.nrows());
+  }
+  return writer->AppendEntries(column.data(), column.nrows());
+}
+
+} // anonymous namespace
+
+struct MultiColumnWriter::PendingBlock {
+  explicit PendingBlock(int num_columns)
+      : arena(32 * 1024),
+        latch(num_columns),
+        statuses(num_columns) {
+  }
+
+  // Copies 'column', including its indirect data, into 'arena' and appends
+  // the copy to 'columns'.
+  void AddColumnCopy(const ColumnBlock& column) {
+    const size_t data_size = column.stride() * column.nrows();
+    uint8_t* data = static_cast<uint8_t*>(arena.AllocateBytesAligned(data_size, 16));
+    CHECK(data);
+    memcpy(data, column.data(), data_size);
+
+    uint8_t* null_bitmap = nullptr;
+    if (column.is_nullable()) {
+      const size_t bitmap_size = BitmapSize(column.nrows());
+      null_bitmap = static_cast<uint8_t*>(arena.AllocateBytes(bitmap_size));
+      CHECK(null_bitmap);
+      memcpy(null_bitmap, column.null_bitmap(), bitmap_size);
+    }
+
+    if (column.type_info()->physical_type() == BINARY) {
+      Slice* cells = reinterpret_cast<Slice*>(data);
+      for (size_t i = 0; i < column.nrows(); i++) {
+        if (null_bitmap == nullptr || BitmapTest(null_bitmap, i)) {
+          CHECK(arena.RelocateSlice(cells[i], &cells[i]));
+        }
+      }
+    }
+    columns.emplace_back(column.type_info(), null_bitmap, data, column.nrows(), &arena);
+  }
+
+  Arena arena;
+  vector<ColumnBlock> columns;
+
+  // Counted down as each column's worker finishes with the block.
+  CountDownLatch latch;
+
+  // The result of writing each column. Only valid once 'latch' reaches 0.
+  vector<Status> statuses;
+};
+
+struct MultiColumnWriter::SecondaryIndexBuilder {
+  explicit SecondaryIndexBuilder(int col_idx)
+      : col_idx(col_idx),
+        size(0),
+        abandoned(false) {
+  }
+
+  // The index of the column in the schema.
+  const int col_idx;
+
+  vector<string> entries;
+
+  // The total size of 'entries', in bytes.
+  size_t size;
+
+  // Set once the entries grow too large, after which they're dropped.
+  bool abandoned;
+
+  // The block the index was written to, once finished.
+  BlockId block_id;
+};
+
+struct MultiColumnWriter::BloomFilterBuilder {
+  explicit BloomFilterBuilder(int col_idx)
+      : col_idx(col_idx),
+        size(0),
+        abandoned(false) {
+  }
+
+  // The index of the column in the schema.
+  const int col_idx;
+
+  // The key encodings of the values of the column. Runs of equal values are
+  // only added once.
+  vector<string> keys;
+
+  // The total size of 'keys', in bytes.
+  size_t size;
+
+  // Set once the keys grow too large, after which they're dropped.
+  bool abandoned;
+
+  // The block the bloom filter was written to, once finished.
+  BlockId block_id;
+};
 
 MultiColumnWriter::MultiColumnWriter(FsManager* fs,
                                      const Schema* schema,
-                                     std::string tablet_id)
+                                     std::string tablet_id,
+                                     fs::DataDirStorageClass storage_class)
   : fs_(fs),
     schema_(schema),
     finished_(false),
-    tablet_id_(std::move(tablet_id)) {
+    tablet_id_(std::move(tablet_id)),
+    storage_class_(storage_class),
+    first_async_col_idx_(schema->num_columns()),
+    failed_(false),
+    num_rows_(0) {
 }
 
 MultiColumnWriter::~MultiColumnWriter() {
+  // The workers must be done with the writers before they're destroyed.
+  col_tokens_.clear();
+  if (pool_) {
+    pool_->Shutdown();
+  }
   STLDeleteElements(&cfile_writers_);
 }
 
@@ -59,7 +226,7 @@ Status MultiColumnWriter::Open() {
   CHECK(cfile_writers_.empty());
 
   // Open columns.
-  const CreateBlockOptions block_opts({ tablet_id_ });
+  const CreateBlockOptions block_opts({ tablet_id_, storage_class_ });
   for (int i = 0; i < schema_->num_columns(); i++) {
     const ColumnSchema &col = schema_->column(i);
 
@@ -82,6 +249,15 @@ Status MultiColumnWriter::Open() {
       opts.write_validx = true;
     }
 
+    // Allow scans to skip blocks based on their min/max values.
+    opts.write_zone_map = true;
+
+    // Allow query planners to estimate the selectivity of predicates.
+    opts.write_statistics = true;
+
+    // Pick the encoding of columns which don't specify one from their data.
+    opts.adaptive_encoding = true;
+
     // Open file for write.
     unique_ptr<WritableBlock> block;
     RETURN_NOT_OK_PREPEND(fs_->CreateNewBlock(block_opts, &block),
@@ -102,25 +278,249 @@ Status MultiColumnWriter::Open() {
   }
   LOG(INFO) << "Opened CFile writers for " << cfile_writers_.size() << " column(s)";
 
+  // The rows are already indexed by their primary key.
+  for (int i = schema_->num_key_columns(); i < schema_->num_columns(); i++) {
+    if (schema_->column(i).attributes().secondary_index) {
+      index_builders_.emplace_back(new SecondaryIndexBuilder(i));
+    }
+    if (schema_->column(i).attributes().bloom_filter) {
+      bloom_builders_.emplace_back(new BloomFilterBuilder(i));
+    }
+  }
+
+  // The caller may use the writer of a single-column key as the key index
+  // (see DiskRowSetWriter::key_index_writer()), so it's written inline.
+  const int num_threads = FLAGS_tablet_column_writer_threads;
+  const int first_async_col_idx = schema_->num_key_columns() == 1 ? 1 : 0;
+  if (num_threads > 0 && schema_->num_columns() - first_async_col_idx > 1) {
+    RETURN_NOT_OK(ThreadPoolBuilder("column-writer")
+                  .set_max_threads(num_threads)
+                  .Build(&pool_));
+    first_async_col_idx_ = first_async_col_idx;
+    const int num_async_cols = schema_->num_columns() - first_async_col_idx_;
+    for (int i = 0; i < num_async_cols; i++) {
+      col_tokens_.emplace_back(pool_->NewToken(ThreadPool::ExecutionMode::SERIAL));
+    }
+    vector<std::atomic<size_t>> sizes(num_async_cols);
+    for (auto& size : sizes) {
+      size = 0;
+    }
+    async_col_written_sizes_.swap(sizes);
+  }
+
   return Status::OK();
 }
 
 Status MultiColumnWriter::AppendBlock(const RowBlock& block) {
-  for (int i = 0; i < schema_->num_columns(); i++) {
-    ColumnBlock column = block.column_block(i);
-    if (column.is_nullable()) {
-      RETURN_NOT_OK(cfile_writers_[i]->AppendNullableEntries(column.null_bitmap(),
-          column.data(), column.nrows()));
-    } else {
-      RETURN_NOT_OK(cfile_writers_[i]->AppendEntries(column.data(), column.nrows()));
+  for (const auto& builder : index_builders_) {
+    AddSecondaryIndexEntries(block, builder.get());
+  }
+  for (const auto& builder : bloom_builders_) {
+    AddBloomFilterKeys(block, builder.get());
+  }
+  num_rows_ += block.nrows();
+
+  for (int i = 0; i < first_async_col_idx_; i++) {
+    RETURN_NOT_OK(AppendColumnBlock(cfile_writers_[i], block.column_block(i)));
+  }
+  if (first_async_col_idx_ == schema_->num_columns()) {
+    return Status::OK();
+  }
+
+  // Make room for the block, and return any error hit by the workers so far.
+  RETURN_NOT_OK(WaitForPendingBlocks(kMaxPendingBlocks - 1));
+
+  const int num_async_cols = col_tokens_.size();
+  shared_ptr<PendingBlock> pending(new PendingBlock(num_async_cols));
+  for (int i = first_async_col_idx_; i < schema_->num_columns(); i++) {
+    pending->AddColumnCopy(block.column_block(i));
+  }
+  pending_blocks_.push_back(pending);
+
+  // The workers write on behalf of the caller.
+  const IOPriority priority = ScopedIOPriority::Current();
+  scoped_refptr<Trace> trace(Trace::CurrentTrace());
+  for (int j = 0; j < num_async_cols; j++) {
+    CFileWriter* writer = cfile_writers_[first_async_col_idx_ + j];
+    Status s = col_tokens_[j]->SubmitFunc([this, pending, j, writer, priority, trace]() {
+      ADOPT_TRACE(trace.get());
+      ScopedIOPriority p(priority);
+      if (!failed_) {
+        Status s = AppendColumnBlock(writer, pending->columns[j]);
+        if (!s.ok()) {
+          pending->statuses[j] = s;
+          failed_ = true;
+        }
+        async_col_written_sizes_[j] = writer->written_size();
+      }
+      pending->latch.CountDown();
+    });
+    if (PREDICT_FALSE(!s.ok())) {
+      failed_ = true;
+      pending->statuses[j] = s;
+      pending->latch.CountDown(num_async_cols - j);
+      return s;
+    }
+  }
+  return Status::OK();
+}
+
+void MultiColumnWriter::AddSecondaryIndexEntries(const RowBlock& block,
+                                                 SecondaryIndexBuilder* builder) {
+  if (builder->abandoned) {
+    return;
+  }
+  const ColumnBlock column = block.column_block(builder->col_idx);
+  const KeyEncoder<faststring>& encoder = GetKeyEncoder<faststring>(column.type_info());
+  const size_t max_size = static_cast<size_t>(FLAGS_tablet_secondary_index_max_size_mb) << 20;
+  faststring buf;
+  for (size_t i = 0; i < column.nrows(); i++) {
+    // NULLs match no predicate which the index is used for.
+    if (column.is_nullable() && column.is_null(i)) {
+      continue;
+    }
+    buf.clear();
+    encoder.Encode(column.cell_ptr(i), /*is_last=*/false, &buf);
+    uint8_t ordinal[sizeof(rowid_t)];
+    BigEndian::Store32(ordinal, num_rows_ + i);
+    buf.append(ordinal, sizeof(ordinal));
+
+    builder->size += buf.size();
+    if (builder->size > max_size) {
+      LOG(INFO) << "Abandoning the secondary index of column "
+                << schema_->column(builder->col_idx).name() << " after "
+                << builder->entries.size() << " entries";
+      builder->abandoned = true;
+      vector<string>().swap(builder->entries);
+      return;
     }
+    builder->entries.emplace_back(buf.ToString());
+  }
+}
+
+Status MultiColumnWriter::FinishSecondaryIndex(SecondaryIndexBuilder* builder,
+                                               BlockCreationTransaction* transaction) {
+  // There's nothing to look up in an empty index.
+  if (builder->abandoned || builder->entries.empty()) {
+    return Status::OK();
+  }
+  std::sort(builder->entries.begin(), builder->entries.end());
+
+  unique_ptr<WritableBlock> block;
+  RETURN_NOT_OK_PREPEND(fs_->CreateNewBlock(CreateBlockOptions({ tablet_id_, storage_class_ }),
+                                            &block),
+                        "Unable to open output file for secondary index");
+  BlockId block_id(block->id());
+
+  // Like the ad hoc index of compound keys, the entries are only looked up
+  // by value.
+  cfile::WriterOptions opts;
+  opts.write_validx = true;
+  opts.write_posidx = false;
+  opts.storage_attributes.encoding = PREFIX_ENCODING;
+  opts.storage_attributes.compression = LZ4;
+  opts.storage_attributes.cfile_block_size = FLAGS_default_composite_key_index_block_size_bytes;
+  CFileWriter writer(opts, GetTypeInfo(BINARY), false, std::move(block));
+  RETURN_NOT_OK(writer.Start());
+  for (const string& entry : builder->entries) {
+    Slice slice(entry);
+    RETURN_NOT_OK(writer.AppendEntries(&slice, 1));
   }
+  RETURN_NOT_OK(writer.FinishAndReleaseBlock(transaction));
+  vector<string>().swap(builder->entries);
+  builder->block_id = block_id;
   return Status::OK();
 }
 
+void MultiColumnWriter::AddBloomFilterKeys(const RowBlock& block,
+                                           BloomFilterBuilder* builder) {
+  if (builder->abandoned) {
+    return;
+  }
+  const ColumnBlock column = block.column_block(builder->col_idx);
+  const KeyEncoder<faststring>& encoder = GetKeyEncoder<faststring>(column.type_info());
+  const size_t max_size =
+      static_cast<size_t>(FLAGS_tablet_column_bloom_filter_max_size_mb) << 20;
+  faststring buf;
+  for (size_t i = 0; i < column.nrows(); i++) {
+    // NULLs match no predicate which the filter is used for.
+    if (column.is_nullable() && column.is_null(i)) {
+      continue;
+    }
+    buf.clear();
+    encoder.Encode(column.cell_ptr(i), /*is_last=*/false, &buf);
+    if (!builder->keys.empty() && Slice(builder->keys.back()) == Slice(buf)) {
+      continue;
+    }
+    builder->size += buf.size();
+    if (builder->size > max_size) {
+      LOG(INFO) << "Abandoning the bloom filter of column "
+                << schema_->column(builder->col_idx).name() << " after "
+                << builder->keys.size() << " values";
+      builder->abandoned = true;
+      vector<string>().swap(builder->keys);
+      return;
+    }
+    builder->keys.emplace_back(buf.ToString());
+  }
+}
+
+Status MultiColumnWriter::FinishBloomFilter(BloomFilterBuilder* builder,
+                                            BlockCreationTransaction* transaction) {
+  // A column which is NULL in every row is left without a filter.
+  if (builder->abandoned || builder->keys.empty()) {
+    return Status::OK();
+  }
+  // The bloom file splits the keys into blocks by range, like those of the
+  // primary key bloom filter, so they're sorted first. Only the distinct ones
+  // need to be added.
+  std::sort(builder->keys.begin(), builder->keys.end());
+  builder->keys.erase(std::unique(builder->keys.begin(), builder->keys.end()),
+                      builder->keys.end());
+
+  unique_ptr<WritableBlock> block;
+  RETURN_NOT_OK_PREPEND(fs_->CreateNewBlock(CreateBlockOptions({ tablet_id_, storage_class_ }),
+                                            &block),
+                        "Unable to open output file for bloom filter");
+  BlockId block_id(block->id());
+  cfile::BloomFileWriter writer(std::move(block),
+                                BloomFilterSizing::BySizeAndFPRate(
+                                    FLAGS_tablet_bloom_block_size,
+                                    FLAGS_tablet_bloom_target_fp_rate));
+  RETURN_NOT_OK(writer.Start());
+  for (const string& key : builder->keys) {
+    Slice slice(key);
+    RETURN_NOT_OK(writer.AppendKeys(&slice, 1));
+  }
+  RETURN_NOT_OK(writer.FinishAndReleaseBlock(transaction));
+  vector<string>().swap(builder->keys);
+  builder->block_id = block_id;
+  return Status::OK();
+}
+
+Status MultiColumnWriter::WaitForPendingBlocks(size_t max_pending) {
+  Status ret;
+  while (pending_blocks_.size() > max_pending) {
+    const shared_ptr<PendingBlock>& pending = pending_blocks_.front();
+    pending->latch.Wait();
+    for (const Status& s : pending->statuses) {
+      if (ret.ok() && !s.ok()) {
+        ret = s;
+      }
+    }
+    pending_blocks_.pop_front();
+  }
+  if (ret.ok() && failed_) {
+    // The error belongs to a block which is still pending.
+    return WaitForPendingBlocks(0);
+  }
+  return ret;
+}
+
 Status MultiColumnWriter::FinishAndReleaseBlocks(
     BlockCreationTransaction* transaction) {
   CHECK(!finished_);
+  RETURN_NOT_OK_PREPEND(WaitForPendingBlocks(0), "Unable to write columns");
   for (int i = 0; i < schema_->num_columns(); i++) {
     CFileWriter *writer = cfile_writers_[i];
     Status s = writer->FinishAndReleaseBlock(transaction);
@@ -130,6 +530,16 @@ Status MultiColumnWriter::FinishAndReleaseBlocks(
       return s;
     }
   }
+  for (const auto& builder : index_builders_) {
+    RETURN_NOT_OK_PREPEND(FinishSecondaryIndex(builder.get(), transaction),
+                          "Unable to write secondary index of column " +
+                          schema_->column(builder->col_idx).ToString());
+  }
+  for (const auto& builder : bloom_builders_) {
+    RETURN_NOT_OK_PREPEND(FinishBloomFilter(builder.get(), transaction),
+                          "Unable to write bloom filter of column " +
+                          schema_->column(builder->col_idx).ToString());
+  }
   finished_ = true;
   return Status::OK();
 }
@@ -142,10 +552,36 @@ void MultiColumnWriter::GetFlushedBlocksByColumnId(std::map<ColumnId, BlockId>*
   }
 }
 
+void MultiColumnWriter::GetFlushedSecondaryIndexBlocksByColumnId(
+    std::map<ColumnId, BlockId>* ret) const {
+  CHECK(finished_);
+  ret->clear();
+  for (const auto& builder : index_builders_) {
+    if (!builder->block_id.IsNull()) {
+      (*ret)[schema_->column_id(builder->col_idx)] = builder->block_id;
+    }
+  }
+}
+
+void MultiColumnWriter::GetFlushedBloomFilterBlocksByColumnId(
+    std::map<ColumnId, BlockId>* ret) const {
+  CHECK(finished_);
+  ret->clear();
+  for (const auto& builder : bloom_builders_) {
+    if (!builder->block_id.IsNull()) {
+      (*ret)[schema_->column_id(builder->col_idx)] = builder->block_id;
+    }
+  }
+}
+
 size_t MultiColumnWriter::written_size() const {
   size_t size = 0;
-  for (const CFileWriter *writer : cfile_writers_) {
-    size += writer->written_size();
+  for (int i = 0; i < cfile_writers_.size(); i++) {
+    if (i < first_async_col_idx_ || finished_) {
+      size += cfile_writers_[i]->written_size();
+    } else {
+      size += async_col_written_sizes_[i - first_async_col_idx_];
+    }
   }
   return size;
 }
@@ -17,22 +17,31 @@
 #ifndef KUDU_TABLET_MULTI_COLUMN_WRITER_H
 #define KUDU_TABLET_MULTI_COLUMN_WRITER_H
 
+#include <atomic>
 #include <cstddef>
+#include <deque>
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
 #include <glog/logging.h>
 
+#include "kudu/common/rowid.h"
 #include "kudu/fs/block_id.h"
+#include "kudu/fs/block_manager.h"
+#include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/util/status.h"
 
 namespace kudu {
 
+class ColumnBlock;
 class FsManager;
 class RowBlock;
 class Schema;
+class ThreadPool;
+class ThreadPoolToken;
 struct ColumnId;
 
 namespace cfile {
@@ -47,11 +56,35 @@ namespace tablet {
 
 // Wrapper which writes several columns in parallel corresponding to some
 // Schema. Written blocks will fall in the tablet_id's data dir group.
+//
+// If --tablet_column_writer_threads is positive, the columns are encoded and
+// compressed by a pool of worker threads: AppendBlock() copies each column of
+// the block and hands it to the column's worker, returning while earlier
+// blocks are still being written. Each column's blocks are written in order,
+// and at most a few blocks may be pending at once. A single-column primary
+// key is still written by the calling thread, so that the key index can be
+// used by the caller between calls.
+//
+// The columns with the 'secondary_index' storage attribute are also indexed
+// by value: once all the rows are appended, a cfile is written for each of
+// them, holding an entry per non-null cell, sorted by value. Each entry is
+// the key encoding of the value, followed by the big-endian ordinal of its
+// row, so that the rows holding a value or a range of values are found by
+// seeking in the cfile's value index. The entries are buffered in memory
+// until then, and a column's index is abandoned if they exceed
+// --tablet_secondary_index_max_size_mb.
+//
+// Similarly, a bloom filter file is written for each column with the
+// 'bloom_filter' storage attribute, holding the key encodings of its distinct
+// non-null values, so that scans may rule out the whole rowset for a value.
+// The values are buffered until then too, up to
+// --tablet_column_bloom_filter_max_size_mb.
 class MultiColumnWriter {
  public:
   MultiColumnWriter(FsManager* fs,
                     const Schema* schema,
-                    std::string tablet_id);
+                    std::string tablet_id,
+                    fs::DataDirStorageClass storage_class);
 
   virtual ~MultiColumnWriter();
 
@@ -67,11 +100,17 @@ class MultiColumnWriter {
   // blocks and releasing them to 'transaction'.
   Status FinishAndReleaseBlocks(fs::BlockCreationTransaction* transaction);
 
-  // Return the number of bytes written so far.
+  // Return the number of bytes written so far. While blocks are pending,
+  // this doesn't account for them.
   size_t written_size() const;
 
+  // Returns the writer of the i-th column.
+  //
+  // Unless the writer is finished, only the writer of a column the calling
+  // thread writes itself may be used: that of a single-column primary key.
   cfile::CFileWriter* writer_for_col_idx(int i) {
     DCHECK_LT(i, cfile_writers_.size());
+    DCHECK(finished_ || i < first_async_col_idx_);
     return cfile_writers_[i];
   }
 
@@ -80,17 +119,88 @@ class MultiColumnWriter {
   // REQUIRES: Finish() already called.
   void GetFlushedBlocksByColumnId(std::map<ColumnId, BlockId>* ret) const;
 
+  // Return the block IDs of the written secondary indexes, keyed by the ID of
+  // the indexed column. Columns whose index was abandoned have none.
+  //
+  // REQUIRES: Finish() already called.
+  void GetFlushedSecondaryIndexBlocksByColumnId(std::map<ColumnId, BlockId>* ret) const;
+
+  // Return the block IDs of the written bloom filters, keyed by the ID of
+  // their column. Columns whose filter was abandoned have none.
+  //
+  // REQUIRES: Finish() already called.
+  void GetFlushedBloomFilterBlocksByColumnId(std::map<ColumnId, BlockId>* ret) const;
+
  private:
+  // The entries of the secondary index of a column, buffered until the
+  // column is finished.
+  struct SecondaryIndexBuilder;
+
+  // Adds the entries of the cells of 'block' to 'builder'.
+  void AddSecondaryIndexEntries(const RowBlock& block, SecondaryIndexBuilder* builder);
+
+  // Sorts the entries of 'builder' and writes them out into a new block,
+  // releasing it to 'transaction'.
+  Status FinishSecondaryIndex(SecondaryIndexBuilder* builder,
+                              fs::BlockCreationTransaction* transaction);
+
+  // The values of a column with a bloom filter, buffered until the column is
+  // finished.
+  struct BloomFilterBuilder;
+
+  // Adds the values of the cells of 'block' to 'builder'.
+  void AddBloomFilterKeys(const RowBlock& block, BloomFilterBuilder* builder);
+
+  // Writes the distinct values of 'builder' out into a new bloom file,
+  // releasing it to 'transaction'.
+  Status FinishBloomFilter(BloomFilterBuilder* builder,
+                           fs::BlockCreationTransaction* transaction);
+
+  // A block whose columns are being written by the worker threads.
+  struct PendingBlock;
+
+  // Waits until no more than 'max_pending' blocks are pending, returning the
+  // first error encountered writing the blocks waited for.
+  Status WaitForPendingBlocks(size_t max_pending);
+
   FsManager* const fs_;
   const Schema* const schema_;
 
   bool finished_;
 
   const std::string tablet_id_;
+  const fs::DataDirStorageClass storage_class_;
 
   std::vector<cfile::CFileWriter *> cfile_writers_;
   std::vector<BlockId> block_ids_;
 
+  // The index of the first column written by the worker threads. The columns
+  // before it are written by the calling thread. Equal to the number of
+  // columns if there are no worker threads.
+  int first_async_col_idx_;
+
+  // The worker threads, and a serial token per column written by them,
+  // indexed by column index minus 'first_async_col_idx_'.
+  gscoped_ptr<ThreadPool> pool_;
+  std::vector<std::unique_ptr<ThreadPoolToken>> col_tokens_;
+
+  // The written size of each column written by the worker threads, as of
+  // the last block written to it.
+  std::vector<std::atomic<size_t>> async_col_written_sizes_;
+
+  // Set once writing a column has failed, after which pending blocks are
+  // dropped.
+  std::atomic<bool> failed_;
+
+  std::deque<std::shared_ptr<PendingBlock>> pending_blocks_;
+
+  // The number of rows appended so far.
+  rowid_t num_rows_;
+
+  std::vector<std::unique_ptr<SecondaryIndexBuilder>> index_builders_;
+
+  std::vector<std::unique_ptr<BloomFilterBuilder>> bloom_builders_;
+
   DISALLOW_COPY_AND_ASSIGN(MultiColumnWriter);
 };
 
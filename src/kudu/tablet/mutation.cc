@@ -51,20 +51,23 @@ std::string Mutation::StringifyMutationList(const Schema &schema, const Mutation
   return ret;
 }
 
-void Mutation::AppendToListAtomic(Mutation **list) {
+int Mutation::AppendToListAtomic(Mutation **list) {
   next_ = nullptr;
   if (*list == nullptr) {
     Release_Store(reinterpret_cast<AtomicWord*>(list),
                   reinterpret_cast<AtomicWord>(this));
-  } else {
-    // Find tail and append.
-    Mutation *tail = *list;
-    while (tail->next_ != nullptr) {
-      tail = tail->next_;
-    }
-    Release_Store(reinterpret_cast<AtomicWord*>(&tail->next_),
-                  reinterpret_cast<AtomicWord>(this));
+    return 1;
+  }
+  // Find tail and append.
+  int len = 2;
+  Mutation *tail = *list;
+  while (tail->next_ != nullptr) {
+    tail = tail->next_;
+    len++;
   }
+  Release_Store(reinterpret_cast<AtomicWord*>(&tail->next_),
+                reinterpret_cast<AtomicWord>(this));
+  return len;
 }
 
 } // namespace tablet
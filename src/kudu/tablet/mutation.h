@@ -18,6 +18,7 @@
 #ifndef KUDU_TABLET_MUTATION_H
 #define KUDU_TABLET_MUTATION_H
 
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
 #include <new>
@@ -54,6 +55,19 @@ class Mutation {
   static Mutation *CreateInArena(
     ArenaType *arena, Timestamp timestamp, const RowChangeList &rcl);
 
+  // Create a new Mutation object with a copy of the given changelist in
+  // 'storage', which must be suitably aligned and hold at least
+  // AlignedSize(rcl) bytes. Used to lay out whole mutation lists
+  // contiguously.
+  static Mutation* CreateAt(void* storage, Timestamp timestamp, const RowChangeList& rcl);
+
+  // Return the size of a Mutation holding the given changelist, rounded up
+  // so that a Mutation placed right after it is suitably aligned.
+  static size_t AlignedSize(const RowChangeList& rcl) {
+    const size_t align = BASE_PORT_H_ALIGN_OF(Mutation);
+    return (sizeof(Mutation) + rcl.slice().size() + align - 1) & ~(align - 1);
+  }
+
   RowChangeList changelist() const {
     return RowChangeList(Slice(changelist_data_, changelist_size_));
   }
@@ -79,11 +93,12 @@ class Mutation {
   // This should only be used for debugging/logging.
   static std::string StringifyMutationList(const Schema &schema, const Mutation *head);
 
-  // Append this mutation to the list at the given pointer.
+  // Append this mutation to the list at the given pointer, and return the
+  // length of the list, including this mutation.
   // This operation uses "Release" memory semantics
   // (see atomicops.h). The pointer as well as all of the mutations in the list
   // must be word-aligned.
-  void AppendToListAtomic(Mutation **list);
+  int AppendToListAtomic(Mutation **list);
 
   void PrependToList(Mutation** list) {
     this->next_ = *list;
@@ -124,9 +139,14 @@ inline Mutation *Mutation::CreateInArena(
   size_t size = sizeof(Mutation) + rcl.slice().size();
   void *storage = arena->AllocateBytesAligned(size, BASE_PORT_H_ALIGN_OF(Mutation));
   CHECK(storage) << "failed to allocate storage from arena";
+  return CreateAt(storage, timestamp, rcl);
+}
+
+inline Mutation* Mutation::CreateAt(void* storage, Timestamp timestamp, const RowChangeList& rcl) {
+  DCHECK(!rcl.is_null());
   auto ret = new (storage) Mutation();
   ret->timestamp_ = timestamp;
-  ret->next_ = NULL;
+  ret->next_ = nullptr;
   ret->changelist_size_ = rcl.slice().size();
   memcpy(ret->changelist_data_, rcl.slice().data(), rcl.slice().size());
   return ret;
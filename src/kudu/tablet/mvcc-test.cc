@@ -306,8 +306,8 @@ TEST_F(MvccTest, TestPointInTimeSnapshot) {
 TEST_F(MvccTest, TestMayHaveCommittedTransactionsAtOrAfter) {
   MvccSnapshot snap;
   snap.all_committed_before_ = Timestamp(10);
-  snap.committed_timestamps_.push_back(11);
-  snap.committed_timestamps_.push_back(13);
+  snap.AddCommittedTimestamp(Timestamp(11));
+  snap.AddCommittedTimestamp(Timestamp(13));
   snap.none_committed_at_or_after_ = Timestamp(14);
 
   ASSERT_TRUE(snap.MayHaveCommittedTransactionsAtOrAfter(Timestamp(9)));
@@ -342,8 +342,8 @@ TEST_F(MvccTest, TestMayHaveCommittedTransactionsAtOrAfter) {
 TEST_F(MvccTest, TestMayHaveUncommittedTransactionsBefore) {
   MvccSnapshot snap;
   snap.all_committed_before_ = Timestamp(10);
-  snap.committed_timestamps_.push_back(11);
-  snap.committed_timestamps_.push_back(13);
+  snap.AddCommittedTimestamp(Timestamp(11));
+  snap.AddCommittedTimestamp(Timestamp(13));
   snap.none_committed_at_or_after_ = Timestamp(14);
 
   ASSERT_FALSE(snap.MayHaveUncommittedTransactionsAtOrBefore(Timestamp(9)));
@@ -382,7 +382,7 @@ TEST_F(MvccTest, TestMayHaveUncommittedTransactionsBefore) {
   // still report that there can't be any uncommitted transactions before.
   MvccSnapshot snap2;
   snap2.all_committed_before_ = Timestamp(10);
-  snap2.committed_timestamps_.push_back(10);
+  snap2.AddCommittedTimestamp(Timestamp(10));
 
   ASSERT_FALSE(snap2.MayHaveUncommittedTransactionsAtOrBefore(Timestamp(10)));
 }
@@ -427,6 +427,25 @@ TEST_F(MvccTest, TestAreAllTransactionsCommitted) {
   ASSERT_TRUE(mgr.AreAllTransactionsCommitted(Timestamp(3)));
 }
 
+TEST_F(MvccTest, TestGetEarliestInFlightTimestamp) {
+  MvccManager mgr;
+  ASSERT_EQ(Timestamp::kMax, mgr.GetEarliestInFlightTimestamp());
+
+  Timestamp tx1 = clock_->Now();
+  mgr.StartTransaction(tx1);
+  Timestamp tx2 = clock_->Now();
+  mgr.StartTransaction(tx2);
+  ASSERT_EQ(tx1, mgr.GetEarliestInFlightTimestamp());
+
+  mgr.StartApplyingTransaction(tx1);
+  mgr.CommitTransaction(tx1);
+  ASSERT_EQ(tx2, mgr.GetEarliestInFlightTimestamp());
+
+  mgr.StartApplyingTransaction(tx2);
+  mgr.CommitTransaction(tx2);
+  ASSERT_EQ(Timestamp::kMax, mgr.GetEarliestInFlightTimestamp());
+}
+
 TEST_F(MvccTest, TestWaitForCleanSnapshot_SnapWithNoInflights) {
   MvccManager mgr;
   Timestamp to_wait_for = clock_->Now();
@@ -659,6 +678,102 @@ TEST_F(MvccTest, TestAutomaticCleanTimeMoveToSafeTimeOnCommit) {
   ASSERT_EQ(mgr.cur_snap_.ToString(), "MvccSnapshot[committed={T|T < 15 or (T in {15})}]");
 }
 
+TEST_F(MvccTest, TestCommitTransactionsInBatch) {
+  MvccManager mgr;
+  clock_->Update(Timestamp(20));
+
+  mgr.StartTransaction(Timestamp(10));
+  mgr.StartTransaction(Timestamp(12));
+  mgr.StartTransaction(Timestamp(15));
+  mgr.AdjustSafeTime(Timestamp(15));
+
+  // Committing a batch which doesn't include the earliest in-flight
+  // transaction doesn't move the clean time.
+  mgr.StartApplyingTransaction(Timestamp(15));
+  mgr.CommitTransactions({ Timestamp(15) });
+  ASSERT_EQ(Timestamp(10), mgr.GetEarliestInFlightTimestamp());
+  ASSERT_EQ(mgr.cur_snap_.ToString(), "MvccSnapshot[committed={T|T < 10 or (T in {15})}]");
+
+  // Committing the rest, in any order, moves it to the safe time at once.
+  mgr.StartApplyingTransaction(Timestamp(10));
+  mgr.StartApplyingTransaction(Timestamp(12));
+  mgr.CommitTransactions({ Timestamp(12), Timestamp(10) });
+  ASSERT_EQ(Timestamp::kMax, mgr.GetEarliestInFlightTimestamp());
+  ASSERT_EQ(mgr.cur_snap_.ToString(), "MvccSnapshot[committed={T|T < 15 or (T in {15})}]");
+}
+
+// Test that snapshots share their set of committed timestamps with the
+// manager until either side changes it.
+TEST_F(MvccTest, TestSnapshotsShareCommittedTimestamps) {
+  MvccManager mgr;
+  Timestamp t1 = clock_->Now();
+  Timestamp t2 = clock_->Now();
+  Timestamp t3 = clock_->Now();
+  for (Timestamp t : { t1, t2, t3 }) {
+    mgr.StartTransaction(t);
+    mgr.StartApplyingTransaction(t);
+  }
+  mgr.CommitTransaction(t2);
+
+  MvccSnapshot snap1;
+  mgr.TakeSnapshot(&snap1);
+  MvccSnapshot snap2;
+  mgr.TakeSnapshot(&snap2);
+  ASSERT_EQ(mgr.cur_snap_.committed_timestamps_, snap1.committed_timestamps_);
+  ASSERT_EQ(mgr.cur_snap_.committed_timestamps_, snap2.committed_timestamps_);
+
+  // Committing another transaction copies the manager's set, leaving the
+  // snapshots as they were.
+  mgr.CommitTransaction(t3);
+  ASSERT_NE(mgr.cur_snap_.committed_timestamps_, snap1.committed_timestamps_);
+  ASSERT_TRUE(snap1.IsCommitted(t2));
+  ASSERT_FALSE(snap1.IsCommitted(t3));
+  MvccSnapshot snap3;
+  mgr.TakeSnapshot(&snap3);
+  ASSERT_TRUE(snap3.IsCommitted(t3));
+
+  // Snapshots copy the set they share before changing it too.
+  snap1.AddCommittedTimestamps({ t1 });
+  ASSERT_TRUE(snap1.IsCommitted(t1));
+  ASSERT_FALSE(snap2.IsCommitted(t1));
+  ASSERT_EQ("MvccSnapshot[committed={T|T < 1 or (T in {1,2})}]", snap1.ToString());
+  ASSERT_EQ("MvccSnapshot[committed={T|T < 1 or (T in {2})}]", snap2.ToString());
+
+  // Once the clean time passes them, the committed timestamps are dropped.
+  mgr.CommitTransaction(t1);
+  mgr.AdjustSafeTime(Timestamp(t3.value() + 1));
+  mgr.TakeSnapshot(&snap3);
+  ASSERT_TRUE(snap3.is_clean());
+  ASSERT_EQ("MvccSnapshot[committed={T|T < 4}]", snap3.ToString());
+}
+
+TEST_F(MvccTest, TestScopedTransactionCommitBatch) {
+  MvccManager mgr;
+  MvccSnapshot snap;
+
+  {
+    ScopedTransaction t1(&mgr, clock_->Now());
+    ScopedTransaction t2(&mgr, clock_->Now());
+    ScopedTransaction t3(&mgr, clock_->Now());
+
+    t1.StartApplying();
+    t2.StartApplying();
+    ScopedTransaction::CommitBatch({ &t1, &t2 });
+
+    mgr.TakeSnapshot(&snap);
+    ASSERT_TRUE(snap.IsCommitted(t1.timestamp()));
+    ASSERT_TRUE(snap.IsCommitted(t2.timestamp()));
+    ASSERT_FALSE(snap.IsCommitted(t3.timestamp()));
+  }
+
+  // The committed transactions going out of scope leaves them committed,
+  // while t3 is aborted.
+  mgr.TakeSnapshot(&snap);
+  ASSERT_TRUE(snap.IsCommitted(Timestamp(1)));
+  ASSERT_TRUE(snap.IsCommitted(Timestamp(2)));
+  ASSERT_FALSE(snap.IsCommitted(Timestamp(3)));
+}
+
 // Various death tests which ensure that we can only transition in one of the following
 // valid ways:
 //
@@ -18,9 +18,12 @@
 #include "kudu/tablet/mvcc.h"
 
 #include <algorithm>
+#include <atomic>
+#include <memory>
 #include <mutex>
 #include <ostream>
 #include <utility>
+#include <vector>
 
 #include <glog/logging.h>
 
@@ -31,10 +34,13 @@
 #include "kudu/util/countdown_latch.h"
 #include "kudu/util/debug/trace_event.h"
 #include "kudu/util/monotime.h"
+#include "kudu/util/probes.h"
+#include "kudu/util/scoped_cleanup.h"
 
 namespace kudu {
 namespace tablet {
 
+using std::vector;
 using strings::Substitute;
 
 MvccManager::MvccManager()
@@ -126,6 +132,30 @@ void MvccManager::CommitTransaction(Timestamp timestamp) {
   }
 }
 
+void MvccManager::CommitTransactions(const vector<Timestamp>& timestamps) {
+  std::lock_guard<LockType> l(lock_);
+
+  // Only advance the earliest in-flight timestamp once all the transactions
+  // are committed, rather than after each of them.
+  const Timestamp earliest = earliest_in_flight_;
+  bool earliest_committed = false;
+  for (Timestamp timestamp : timestamps) {
+    TxnState old_state = RemoveInFlightAndGetStateUnlocked(timestamp);
+    CHECK_EQ(old_state, APPLYING)
+      << "Trying to commit a transaction which never entered APPLYING state: "
+      << timestamp.ToString() << " state=" << old_state;
+    cur_snap_.AddCommittedTimestamp(timestamp);
+    earliest_committed |= timestamp == earliest;
+  }
+
+  if (earliest_committed) {
+    AdvanceEarliestInFlightTimestamp();
+    if (safe_time_ >= earliest) {
+      AdjustCleanTime();
+    }
+  }
+}
+
 MvccManager::TxnState MvccManager::RemoveInFlightAndGetStateUnlocked(Timestamp ts) {
   DCHECK(lock_.is_locked());
 
@@ -190,18 +220,6 @@ void MvccManager::AdjustSafeTime(Timestamp safe_time) {
   AdjustCleanTime();
 }
 
-// Remove any elements from 'v' which are < the given watermark.
-static void FilterTimestamps(std::vector<Timestamp::val_type>* v,
-                             Timestamp::val_type watermark) {
-  int j = 0;
-  for (const auto& ts : *v) {
-    if (ts >= watermark) {
-      (*v)[j++] = ts;
-    }
-  }
-  v->resize(j);
-}
-
 void MvccManager::Close() {
   open_.store(false);
   std::lock_guard<LockType> l(lock_);
@@ -234,7 +252,7 @@ void MvccManager::AdjustCleanTime() {
   }
 
   // Filter out any committed timestamps that now fall below the watermark
-  FilterTimestamps(&cur_snap_.committed_timestamps_, cur_snap_.all_committed_before_.value());
+  cur_snap_.TrimCommittedTimestamps();
 
   // it may also have unblocked some waiters.
   // Check if someone is waiting for transactions to be committed.
@@ -270,6 +288,10 @@ Status MvccManager::WaitUntil(WaitFor wait_for, Timestamp ts, const MonoTime& de
     if (IsDoneWaitingUnlocked(waiting_state)) return Status::OK();
     waiters_.push_back(&waiting_state);
   }
+  KUDU_PROBE(mvcc_wait_start, static_cast<int>(wait_for), ts.ToUint64());
+  SCOPED_CLEANUP({
+    KUDU_PROBE(mvcc_wait_done, static_cast<int>(wait_for), ts.ToUint64());
+  });
   if (waiting_state.latch->WaitUntil(deadline)) {
     // If the wait ended because MVCC is shutting down, return an error.
     return CheckOpen();
@@ -383,6 +405,11 @@ Timestamp MvccManager::GetCleanTimestamp() const {
   return cur_snap_.all_committed_before_;
 }
 
+Timestamp MvccManager::GetEarliestInFlightTimestamp() const {
+  std::lock_guard<LockType> l(lock_);
+  return earliest_in_flight_;
+}
+
 void MvccManager::GetApplyingTransactionsTimestamps(std::vector<Timestamp>* timestamps) const {
   std::lock_guard<LockType> l(lock_);
   timestamps->reserve(timestamps_in_flight_.size());
@@ -424,11 +451,11 @@ MvccSnapshot MvccSnapshot::CreateSnapshotIncludingNoTransactions() {
 }
 
 bool MvccSnapshot::IsCommittedFallback(const Timestamp& timestamp) const {
-  for (const Timestamp::val_type& v : committed_timestamps_) {
-    if (v == timestamp.value()) return true;
+  if (!committed_timestamps_) {
+    return false;
   }
-
-  return false;
+  return std::binary_search(committed_timestamps_->begin(), committed_timestamps_->end(),
+                            timestamp.value());
 }
 
 bool MvccSnapshot::MayHaveCommittedTransactionsAtOrAfter(const Timestamp& timestamp) const {
@@ -447,7 +474,7 @@ bool MvccSnapshot::MayHaveUncommittedTransactionsAtOrBefore(const Timestamp& tim
 std::string MvccSnapshot::ToString() const {
   std::string ret("MvccSnapshot[committed={T|");
 
-  if (committed_timestamps_.size() == 0) {
+  if (is_clean()) {
     StrAppend(&ret, "T < ", all_committed_before_.ToString(),"}]");
     return ret;
   }
@@ -455,7 +482,7 @@ std::string MvccSnapshot::ToString() const {
             " or (T in {");
 
   bool first = true;
-  for (Timestamp::val_type t : committed_timestamps_) {
+  for (Timestamp::val_type t : *committed_timestamps_) {
     if (!first) {
       ret.push_back(',');
     }
@@ -475,7 +502,11 @@ void MvccSnapshot::AddCommittedTimestamps(const std::vector<Timestamp>& timestam
 void MvccSnapshot::AddCommittedTimestamp(Timestamp timestamp) {
   if (IsCommitted(timestamp)) return;
 
-  committed_timestamps_.push_back(timestamp.value());
+  // Transactions mostly commit in timestamp order, so this is usually an
+  // append.
+  auto* committed = MutableCommittedTimestamps();
+  committed->insert(std::upper_bound(committed->begin(), committed->end(), timestamp.value()),
+                    timestamp.value());
 
   // If this is a new upper bound commit mark, update it.
   if (none_committed_at_or_after_ <= timestamp) {
@@ -483,6 +514,35 @@ void MvccSnapshot::AddCommittedTimestamp(Timestamp timestamp) {
   }
 }
 
+void MvccSnapshot::TrimCommittedTimestamps() {
+  if (is_clean()) return;
+  const auto& committed = *committed_timestamps_;
+  const auto num_trimmed = std::lower_bound(committed.begin(), committed.end(),
+                                            all_committed_before_.value()) - committed.begin();
+  if (num_trimmed == 0) return;
+  if (num_trimmed == committed.size()) {
+    committed_timestamps_.reset();
+    return;
+  }
+  auto* mutable_committed = MutableCommittedTimestamps();
+  mutable_committed->erase(mutable_committed->begin(),
+                           mutable_committed->begin() + num_trimmed);
+}
+
+vector<Timestamp::val_type>* MvccSnapshot::MutableCommittedTimestamps() {
+  if (!committed_timestamps_) {
+    committed_timestamps_ = std::make_shared<vector<Timestamp::val_type>>();
+  } else if (committed_timestamps_.use_count() > 1) {
+    committed_timestamps_ = std::make_shared<vector<Timestamp::val_type>>(*committed_timestamps_);
+  } else {
+    // This snapshot is the only owner of the vector. Synchronize with the
+    // release of the last other snapshot that shared it, so that its reads of
+    // the vector happen before our writes.
+    std::atomic_thread_fence(std::memory_order_acquire);
+  }
+  return committed_timestamps_.get();
+}
+
 ////////////////////////////////////////////////////////////
 // ScopedTransaction
 ////////////////////////////////////////////////////////////
@@ -513,5 +573,20 @@ void ScopedTransaction::Abort() {
   done_ = true;
 }
 
+void ScopedTransaction::CommitBatch(const vector<ScopedTransaction*>& txns) {
+  if (txns.empty()) {
+    return;
+  }
+  vector<Timestamp> timestamps;
+  timestamps.reserve(txns.size());
+  for (ScopedTransaction* txn : txns) {
+    DCHECK_EQ(txns[0]->manager_, txn->manager_);
+    DCHECK(!txn->done_);
+    timestamps.push_back(txn->timestamp_);
+    txn->done_ = true;
+  }
+  txns[0]->manager_->CommitTransactions(timestamps);
+}
+
 } // namespace tablet
 } // namespace kudu
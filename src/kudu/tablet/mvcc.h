@@ -18,6 +18,7 @@
 #pragma once
 
 #include <atomic>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <unordered_map>
@@ -101,7 +102,13 @@ class MvccSnapshot {
   // transactions with timestamps less than some timestamp to be committed,
   // and all other transactions to be uncommitted.
   bool is_clean() const {
-    return committed_timestamps_.empty();
+    return !committed_timestamps_ || committed_timestamps_->empty();
+  }
+
+  // Returns the timestamp below which all transactions are considered
+  // committed in this snapshot.
+  Timestamp all_committed_before() const {
+    return all_committed_before_;
   }
 
   // Consider the given list of timestamps to be committed in this snapshot,
@@ -115,12 +122,21 @@ class MvccSnapshot {
   friend class MvccManager;
   FRIEND_TEST(MvccTest, TestMayHaveCommittedTransactionsAtOrAfter);
   FRIEND_TEST(MvccTest, TestMayHaveUncommittedTransactionsBefore);
+  FRIEND_TEST(MvccTest, TestSnapshotsShareCommittedTimestamps);
   FRIEND_TEST(MvccTest, TestWaitUntilAllCommitted_SnapAtTimestampWithInFlights);
 
   bool IsCommittedFallback(const Timestamp& timestamp) const;
 
   void AddCommittedTimestamp(Timestamp timestamp);
 
+  // Removes the committed timestamps which are lower than
+  // 'all_committed_before_', since the watermark covers them.
+  void TrimCommittedTimestamps();
+
+  // Returns 'committed_timestamps_' for modification, first copying it if
+  // it's shared with other snapshots.
+  std::vector<Timestamp::val_type>* MutableCommittedTimestamps();
+
   // Summary rule:
   //   A transaction T is committed if and only if:
   //      T < all_committed_before_ or
@@ -141,18 +157,24 @@ class MvccSnapshot {
 
   // A transaction ID at or beyond which no transactions have been committed.
   // For any timestamp X, if X >= none_committed_after_, then X is uncommitted.
-  // This is equivalent to max(committed_timestamps_) + 1, but since
-  // that vector is unsorted, we cache it.
+  // This is equivalent to max(committed_timestamps_) + 1, cached so that the
+  // common case of IsCommitted() doesn't dereference the vector.
   Timestamp none_committed_at_or_after_;
 
-  // The set of transactions higher than all_committed_before_timestamp_ which
-  // are committed in this snapshot.
+  // The sorted set of transactions higher than all_committed_before_timestamp_
+  // which are committed in this snapshot, or NULL if there are none.
   // It might seem like using an unordered_set<> or a set<> would be faster here,
   // but in practice, this list tends to be stay pretty small, and is only
   // rarely consulted (most data will be culled by 'all_committed_before_'
   // or none_committed_at_or_after_. So, using the compact vector structure fits
   // the whole thing on one or two cache lines, and it ends up going faster.
-  std::vector<Timestamp::val_type> committed_timestamps_;
+  //
+  // Copies of a snapshot share the vector, which is copied on write only while
+  // shared. Taking a snapshot of the MvccManager is then a reference count
+  // increment rather than an allocation and a copy under its lock, and the
+  // vector is copied at most once per commit no matter how many scanners take
+  // snapshots in between.
+  std::shared_ptr<std::vector<Timestamp::val_type>> committed_timestamps_;
 
 };
 
@@ -218,6 +240,10 @@ class MvccManager {
   // StartApplyingTransaction(), or else this logs a FATAL error.
   void CommitTransaction(Timestamp timestamp);
 
+  // Commits the given transactions at once, as CommitTransaction() would
+  // one by one, but taking the lock and adjusting the clean time only once.
+  void CommitTransactions(const std::vector<Timestamp>& timestamps);
+
   // Adjusts the safe time so that the MvccManager can trim state.
   //
   // This must only be called when there is a guarantee that there won't be
@@ -262,6 +288,11 @@ class MvccManager {
   // All timestamps before this one are guaranteed to be committed.
   Timestamp GetCleanTimestamp() const;
 
+  // Returns the timestamp of the earliest transaction in flight, or
+  // Timestamp::kMax if there are none. Snapshots at timestamps before it can
+  // be taken without waiting for transactions to commit.
+  Timestamp GetEarliestInFlightTimestamp() const;
+
   // Return the timestamps of all transactions which are currently 'APPLYING'
   // (i.e. those which have started to apply their operations to in-memory data
   // structures). Other transactions may have reserved their timestamps via
@@ -288,6 +319,8 @@ class MvccManager {
   FRIEND_TEST(MvccTest, TestAreAllTransactionsCommitted);
   FRIEND_TEST(MvccTest, TestTxnAbort);
   FRIEND_TEST(MvccTest, TestAutomaticCleanTimeMoveToSafeTimeOnCommit);
+  FRIEND_TEST(MvccTest, TestCommitTransactionsInBatch);
+  FRIEND_TEST(MvccTest, TestSnapshotsShareCommittedTimestamps);
   FRIEND_TEST(MvccTest, TestWaitForApplyingTransactionsToCommit);
   FRIEND_TEST(MvccTest, TestWaitForCleanSnapshot_SnapAfterSafeTimeWithInFlights);
   FRIEND_TEST(MvccTest, TestDontWaitAfterClose);
@@ -419,6 +452,12 @@ class ScopedTransaction {
   // Requires that StartApplying() has NOT been called.
   void Abort();
 
+  // Commits the given in-flight transactions, which must all belong to the
+  // same MvccManager, through MvccManager::CommitTransactions().
+  //
+  // Requires that StartApplying() has been called for each of them.
+  static void CommitBatch(const std::vector<ScopedTransaction*>& txns);
+
  private:
   bool done_;
   MvccManager * const manager_;
@@ -0,0 +1,94 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/tablet/projection_cache.h"
+
+#include <memory>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "kudu/common/common.pb.h"
+#include "kudu/common/schema.h"
+#include "kudu/util/test_util.h"
+
+using std::shared_ptr;
+using std::string;
+
+namespace kudu {
+namespace tablet {
+
+class ProjectionCacheTest : public KuduTest {
+};
+
+namespace {
+string Signature(const Schema& projection) {
+  string signature;
+  ProjectionCache::AppendSignature(projection, &signature);
+  return signature;
+}
+} // anonymous namespace
+
+TEST_F(ProjectionCacheTest, TestSignature) {
+  Schema projection({ ColumnSchema("key", INT32), ColumnSchema("val", STRING, true) }, 1);
+  ASSERT_EQ(Signature(projection), Signature(Schema(projection)));
+
+  // Anything which changes how the projection is mapped changes the signature.
+  ASSERT_NE(Signature(projection),
+            Signature(Schema({ ColumnSchema("key", INT32), ColumnSchema("val", STRING) }, 1)));
+  ASSERT_NE(Signature(projection),
+            Signature(Schema({ ColumnSchema("key", INT32), ColumnSchema("val", BINARY, true) },
+                             1)));
+  ASSERT_NE(Signature(projection),
+            Signature(Schema({ ColumnSchema("key", INT32), ColumnSchema("val2", STRING, true) },
+                             1)));
+  ASSERT_NE(Signature(projection),
+            Signature(Schema({ ColumnSchema("key", INT32), ColumnSchema("val", STRING, true) },
+                             2)));
+
+  // So does the schema version.
+  ASSERT_NE(ProjectionCache::MakeKey(ProjectionCache::MAPPED_PROJECTION, 1, Signature(projection)),
+            ProjectionCache::MakeKey(ProjectionCache::MAPPED_PROJECTION, 2, Signature(projection)));
+}
+
+TEST_F(ProjectionCacheTest, TestLookupAndInsert) {
+  ProjectionCache cache(2);
+  shared_ptr<const Schema> projection(new Schema({ ColumnSchema("key", INT32) }, 1));
+  ASSERT_EQ(nullptr, cache.Lookup("a"));
+  cache.Insert("a", projection);
+  ASSERT_EQ(projection.get(), cache.Lookup("a").get());
+  cache.Insert("b", projection);
+  ASSERT_EQ(2, cache.num_entries());
+
+  // Replacing an entry doesn't clear the full cache, but a new entry does.
+  cache.Insert("b", projection);
+  ASSERT_EQ(2, cache.num_entries());
+  cache.Insert("c", projection);
+  ASSERT_EQ(1, cache.num_entries());
+  ASSERT_EQ(nullptr, cache.Lookup("a"));
+  ASSERT_EQ(projection.get(), cache.Lookup("c").get());
+}
+
+TEST_F(ProjectionCacheTest, TestDisabled) {
+  ProjectionCache cache(0);
+  cache.Insert("a", shared_ptr<const Schema>(new Schema({ ColumnSchema("key", INT32) }, 1)));
+  ASSERT_EQ(0, cache.num_entries());
+  ASSERT_EQ(nullptr, cache.Lookup("a"));
+}
+
+} // namespace tablet
+} // namespace kudu
@@ -0,0 +1,72 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/tablet/projection_cache.h"
+
+#include <mutex>
+#include <utility>
+
+#include "kudu/common/schema.h"
+#include "kudu/common/types.h"
+#include "kudu/gutil/map-util.h"
+#include "kudu/gutil/strings/substitute.h"
+
+using std::shared_ptr;
+using std::string;
+using strings::Substitute;
+
+namespace kudu {
+namespace tablet {
+
+ProjectionCache::ProjectionCache(int capacity)
+    : capacity_(capacity) {
+}
+
+string ProjectionCache::MakeKey(Kind kind, uint32_t schema_version, const string& signature) {
+  return Substitute("$0:$1:$2", kind, schema_version, signature);
+}
+
+void ProjectionCache::AppendSignature(const Schema& projection, string* signature) {
+  // These are the fields checked by Schema::VerifyProjectionCompatibility()
+  // and used by Schema::GetMappedReadProjection().
+  signature->append(Substitute("$0,$1;", projection.num_key_columns(),
+                               projection.has_column_ids()));
+  for (const ColumnSchema& col : projection.columns()) {
+    signature->append(col.name());
+    signature->push_back('\0');
+    signature->append(Substitute("$0,$1;", col.type_info()->type(), col.is_nullable()));
+  }
+}
+
+shared_ptr<const Schema> ProjectionCache::Lookup(const string& key) const {
+  shared_lock<rw_spinlock> l(lock_);
+  return FindPtrOrNull(entries_, key);
+}
+
+void ProjectionCache::Insert(const string& key, shared_ptr<const Schema> projection) {
+  if (capacity_ <= 0) {
+    return;
+  }
+  std::lock_guard<rw_spinlock> l(lock_);
+  if (entries_.size() >= capacity_ && !ContainsKey(entries_, key)) {
+    entries_.clear();
+  }
+  entries_[key] = std::move(projection);
+}
+
+} // namespace tablet
+} // namespace kudu
@@ -0,0 +1,92 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_TABLET_PROJECTION_CACHE_H
+#define KUDU_TABLET_PROJECTION_CACHE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/util/locks.h"
+
+namespace kudu {
+
+class Schema;
+
+namespace tablet {
+
+// A cache of the projections resolved by the scans of a tablet, so that the
+// scans with the same projection, as is typical of point lookups, share the
+// same Schema objects rather than each rebuilding them along with their name
+// and ID maps.
+//
+// The entries are keyed by the kind of projection, the version of the tablet
+// schema they were resolved against, and a signature of what they were
+// resolved from, so that an entry is never returned once the schema has
+// been altered. When the cache is full, it's cleared: scans tend to use few
+// distinct projections, which don't warrant the bookkeeping of an LRU.
+//
+// This class is thread-safe.
+class ProjectionCache {
+ public:
+  enum Kind {
+    // A client projection, resolved from its ColumnSchemaPBs.
+    CLIENT_PROJECTION,
+    // A client projection along with the columns the scan needs on top of it,
+    // e.g. for its predicates.
+    SCAN_PROJECTION,
+    // A projection mapped onto the tablet schema, with its column IDs.
+    MAPPED_PROJECTION,
+  };
+
+  // A 'capacity' of 0 disables the cache.
+  explicit ProjectionCache(int capacity);
+
+  // Returns the key of a 'kind' projection resolved from 'signature' against
+  // the version 'schema_version' of the tablet schema.
+  static std::string MakeKey(Kind kind, uint32_t schema_version, const std::string& signature);
+
+  // Appends to 'signature' the fields of 'projection' which determine how
+  // it's mapped onto a tablet schema.
+  static void AppendSignature(const Schema& projection, std::string* signature);
+
+  // Returns the projection cached for 'key', or null.
+  std::shared_ptr<const Schema> Lookup(const std::string& key) const;
+
+  // Caches 'projection' for 'key', replacing any projection already cached.
+  void Insert(const std::string& key, std::shared_ptr<const Schema> projection);
+
+  int64_t num_entries() const {
+    shared_lock<rw_spinlock> l(lock_);
+    return entries_.size();
+  }
+
+ private:
+  const int capacity_;
+
+  mutable rw_spinlock lock_;
+  std::unordered_map<std::string, std::shared_ptr<const Schema>> entries_;
+
+  DISALLOW_COPY_AND_ASSIGN(ProjectionCache);
+};
+
+} // namespace tablet
+} // namespace kudu
+
+#endif // KUDU_TABLET_PROJECTION_CACHE_H
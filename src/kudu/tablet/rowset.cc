@@ -23,6 +23,8 @@
 #include <utility>
 #include <vector>
 
+#include "kudu/codegen/row_key_functions.h"
+#include "kudu/common/encoded_key.h"
 #include "kudu/common/generic_iterators.h"
 #include "kudu/common/iterator.h"
 #include "kudu/common/schema.h"
@@ -37,6 +39,44 @@ using strings::Substitute;
 
 namespace kudu { namespace tablet {
 
+RowSetKeyProbe::RowSetKeyProbe(ConstContiguousRow row_key,
+                               const codegen::RowKeyFunctions* key_functions)
+    : row_key_(row_key) {
+  if (key_functions == nullptr) {
+    encoded_key_ = EncodedKey::FromContiguousRow(row_key_);
+  } else {
+    const size_t num_key_cols = row_key_.schema()->num_key_columns();
+    faststring buf;
+    key_functions->EncodeComparableKey(row_key_, &buf);
+    vector<const void*> raw_keys(num_key_cols);
+    for (size_t i = 0; i < num_key_cols; i++) {
+      raw_keys[i] = row_key_.cell_ptr(i);
+    }
+    encoded_key_.reset(new EncodedKey(&buf, &raw_keys, num_key_cols));
+  }
+  bloom_probe_ = BloomKeyProbe(encoded_key_slice());
+}
+
+Status RowSet::CheckRowsPresent(const vector<const RowSetKeyProbe*>& probes,
+                                const vector<ProbeStats*>& stats,
+                                bool* present) const {
+  DCHECK_EQ(probes.size(), stats.size());
+  for (size_t i = 0; i < probes.size(); i++) {
+    RETURN_NOT_OK(CheckRowPresent(*probes[i], &present[i], stats[i]));
+  }
+  return Status::OK();
+}
+
+Status RowSet::GetColumnStatistics(ColumnId /*col_id*/,
+                                   cfile::ColumnStatisticsPB* /*stats*/) const {
+  return Status::NotSupported("rowset has no column statistics");
+}
+
+Status RowSet::SampleKeys(int /*num_samples*/,
+                          vector<string>* /*encoded_keys*/) const {
+  return Status::NotSupported("rowset can't be sampled");
+}
+
 DuplicatingRowSet::DuplicatingRowSet(RowSetVector old_rowsets,
                                      RowSetVector new_rowsets)
     : old_rowsets_(std::move(old_rowsets)),
@@ -198,6 +238,17 @@ Status DuplicatingRowSet::CountRows(rowid_t *count) const {
   return Status::OK();
 }
 
+Status DuplicatingRowSet::CountLiveRows(int64_t* count) const {
+  int64_t accumulated_count = 0;
+  for (const shared_ptr<RowSet>& rs : old_rowsets_) {
+    int64_t this_count;
+    RETURN_NOT_OK(rs->CountLiveRows(&this_count));
+    accumulated_count += this_count;
+  }
+  *count = accumulated_count;
+  return Status::OK();
+}
+
 Status DuplicatingRowSet::GetBounds(string* min_encoded_key,
                                     string* max_encoded_key) const {
   // The range out of the output rowset always spans the full range
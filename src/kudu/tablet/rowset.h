@@ -47,6 +47,15 @@ class RowChangeList;
 class RowwiseIterator;
 class Schema;
 class Slice;
+struct ColumnId;
+
+namespace cfile {
+class ColumnStatisticsPB;
+}
+
+namespace codegen {
+class RowKeyFunctions;
+}
 
 namespace consensus {
 class OpId;
@@ -55,6 +64,7 @@ class OpId;
 namespace tablet {
 
 class CompactionInput;
+class HistoryGcOpts;
 class OperationResultPB;
 class MvccSnapshot;
 class RowSetKeyProbe;
@@ -78,6 +88,16 @@ class RowSet {
   virtual Status CheckRowPresent(const RowSetKeyProbe &probe, bool *present,
                                  ProbeStats* stats) const = 0;
 
+  // Like CheckRowPresent(), for a batch of 'probes' sorted by increasing
+  // encoded key. Sets present[i] for probes[i], accounting the probe in
+  // stats[i].
+  //
+  // The default implementation checks each key in turn. Rowsets which can
+  // share the work between neighboring keys override it.
+  virtual Status CheckRowsPresent(const std::vector<const RowSetKeyProbe*>& probes,
+                                  const std::vector<ProbeStats*>& stats,
+                                  bool* present) const;
+
   // Update/delete a row in this rowset.
   // The 'update_schema' is the client schema used to encode the 'update' RowChangeList.
   //
@@ -110,6 +130,11 @@ class RowSet {
   // Count the number of rows in this rowset.
   virtual Status CountRows(rowid_t *count) const = 0;
 
+  // Count the number of rows in this rowset which haven't been deleted, as
+  // of the latest applied writes. Unlike CountRows(), this doesn't need to
+  // read any data.
+  virtual Status CountLiveRows(int64_t* count) const = 0;
+
   // Return the bounds for this RowSet. 'min_encoded_key' and 'max_encoded_key'
   // are set to the first and last encoded keys for this RowSet.
   //
@@ -162,7 +187,9 @@ class RowSet {
   // Compact delta stores if more than one.
   virtual Status MinorCompactDeltaStores() = 0;
 
-  // Estimate the number of bytes in ancient undo delta stores. This may be an
+  // Estimate the number of bytes in ancient undo delta stores. This is exact
+  // when the timestamps of every undo delta block are recorded in the rowset
+  // metadata or the blocks are initialized, and may otherwise be an
   // overestimate. The argument 'ancient_history_mark' must be valid (it may
   // not be equal to Timestamp::kInvalidTimestamp).
   virtual Status EstimateBytesInPotentiallyAncientUndoDeltas(Timestamp ancient_history_mark,
@@ -170,7 +197,9 @@ class RowSet {
 
   // Initialize undo delta blocks until the given 'deadline' is passed, or
   // until all undo delta blocks with a max timestamp older than
-  // 'ancient_history_mark' have been initialized.
+  // 'ancient_history_mark' have been initialized. Blocks whose timestamps are
+  // recorded in the rowset metadata are skipped; those of the blocks that get
+  // initialized are recorded there.
   //
   // Invoking this method may also improve the estimate given by
   // EstimateBytesInPotentiallyAncientUndoDeltas().
@@ -191,8 +220,9 @@ class RowSet {
                                 int64_t* delta_blocks_initialized,
                                 int64_t* bytes_in_ancient_undos) = 0;
 
-  // Delete all initialized undo delta blocks with a max timestamp earlier than
-  // the specified 'ancient_history_mark'.
+  // Delete all undo delta blocks with a max timestamp earlier than the
+  // specified 'ancient_history_mark', stopping at the first block that is
+  // neither initialized nor has its timestamps recorded in the rowset metadata.
   //
   // Note: This method does not flush updates to the rowset metadata. If this
   // method returns OK, the caller is responsible for persisting changes to the
@@ -212,8 +242,41 @@ class RowSet {
                                          int64_t* blocks_deleted,
                                          int64_t* bytes_deleted) = 0;
 
+  // Sets '*expired' to true if it's certain that every row of this rowset
+  // expired before the ancient history mark of 'history_gc_opts', so that the
+  // whole rowset may be removed without a compaction. See
+  // HistoryGcOpts::WithTimeToLive(). Otherwise sets it to false.
+  virtual Status IsExpiredBeforeAncientHistory(const HistoryGcOpts& history_gc_opts,
+                                               bool* expired) = 0;
+
+  // Sets '*may_have_writes' to false if it's certain that no insert or
+  // mutation of this rowset was committed at or after 'timestamp'. Otherwise
+  // sets it to true. Writes whose UNDO deltas were garbage collected are
+  // older than the ancient history mark, and aren't accounted for.
+  virtual Status MayHaveWritesSince(Timestamp timestamp, bool* may_have_writes) = 0;
+
   virtual ~RowSet() {}
 
+  // Returns the number of accesses served by this rowset since it was opened:
+  // keys probed for presence or mutation, plus row batches read by scans.
+  // The compaction policy uses this to favor compacting hot key ranges.
+  virtual uint64_t AccessCount() const {
+    return 0;
+  }
+
+  // Sets 'stats' to the statistics written with the base data of the column
+  // with ID 'col_id'. They don't account for any mutations applied since.
+  //
+  // Returns NotFound if the column has no statistics, and NotSupported if
+  // this type of rowset doesn't keep any (the default).
+  virtual Status GetColumnStatistics(ColumnId col_id, cfile::ColumnStatisticsPB* stats) const;
+
+  // Sets 'encoded_keys' to the encoded primary keys of up to 'num_samples'
+  // rows evenly spaced through the base data, in increasing key order.
+  //
+  // Returns NotSupported if this type of rowset can't be sampled (the default).
+  virtual Status SampleKeys(int num_samples, std::vector<std::string>* encoded_keys) const;
+
   // Return true if this RowSet is available for compaction, based on
   // the current state of the compact_flush_lock. This should only be
   // used under the Tablet's compaction selection lock, or else the
@@ -250,6 +313,11 @@ class RowSetKeyProbe {
     bloom_probe_ = BloomKeyProbe(encoded_key_slice());
   }
 
+  // As above, but encodes the key with the code-generated 'key_functions'
+  // unless it is NULL.
+  RowSetKeyProbe(ConstContiguousRow row_key,
+                 const codegen::RowKeyFunctions* key_functions);
+
   // RowSetKeyProbes are usually allocated on the stack, which means that we
   // must copy it if we require it later (e.g. Table::Mutate()).
   //
@@ -342,6 +410,10 @@ class DuplicatingRowSet : public RowSet {
 
   Status CountRows(rowid_t *count) const OVERRIDE;
 
+  // Counts the live rows of the input rowsets, to which writes are applied
+  // first.
+  Status CountLiveRows(int64_t* count) const OVERRIDE;
+
   virtual Status GetBounds(std::string* min_encoded_key,
                            std::string* max_encoded_key) const OVERRIDE;
 
@@ -412,6 +484,17 @@ class DuplicatingRowSet : public RowSet {
     return Status::OK();
   }
 
+  Status IsExpiredBeforeAncientHistory(const HistoryGcOpts& /*history_gc_opts*/,
+                                       bool* expired) OVERRIDE {
+    *expired = false;
+    return Status::OK();
+  }
+
+  Status MayHaveWritesSince(Timestamp /*timestamp*/, bool* may_have_writes) OVERRIDE {
+    *may_have_writes = true;
+    return Status::OK();
+  }
+
   Status MinorCompactDeltaStores() OVERRIDE { return Status::OK(); }
 
  private:
@@ -27,10 +27,12 @@
 #include <unordered_map>
 #include <utility>
 
+#include <gflags/gflags_declare.h>
 #include <glog/logging.h>
 
 #include "kudu/gutil/casts.h"
 #include "kudu/gutil/endian.h"
+#include "kudu/gutil/map-util.h"
 #include "kudu/gutil/stringprintf.h"
 #include "kudu/tablet/rowset.h"
 #include "kudu/tablet/rowset_tree.h"
@@ -43,6 +45,8 @@ using std::string;
 using std::unordered_map;
 using std::vector;
 
+DECLARE_double(compaction_access_weight);
+
 // Enforce a minimum size of 1MB, since otherwise the knapsack algorithm
 // will always pick up small rowsets no matter what.
 static const int kMinSizeMb = 1;
@@ -135,6 +139,9 @@ double StringFractionInRange(const RowSetInfo* rsi,
 // multiplying the fraction that the interval takes up in the keyspace of
 // each rowset by the rowset's size (assumes distribution of rows is somewhat
 // uniform).
+//
+// Each rowset's data is further scaled by its access weight, so that hot key
+// ranges look wider to the compaction policy than cold ones of the same size.
 // Requires: [prev, next] contained in each rowset in "active"
 double WidthByDataSize(const Slice& prev, const Slice& next,
                        const unordered_map<RowSet*, RowSetInfo*>& active) {
@@ -142,12 +149,42 @@ double WidthByDataSize(const Slice& prev, const Slice& next,
 
   for (const auto& rs_rsi : active) {
     double fraction = StringFractionInRange(rs_rsi.second, prev, next);
-    weight += rs_rsi.second->size_bytes() * fraction;
+    weight += rs_rsi.second->size_bytes() * rs_rsi.second->access_weight() * fraction;
   }
 
   return weight;
 }
 
+// Computes the access weight of each of 'rowsets': 1 plus
+// --compaction_access_weight times the ratio of the rowset's accesses per
+// byte to the average over all of 'rowsets'. If none of the rowsets have been
+// accessed, every weight is 1.
+unordered_map<RowSet*, double> ComputeAccessWeights(const RowSetVector& rowsets) {
+  unordered_map<RowSet*, double> weights;
+  uint64_t total_accesses = 0;
+  uint64_t total_bytes = 0;
+  vector<std::pair<uint64_t, uint64_t>> accesses_and_bytes;
+  accesses_and_bytes.reserve(rowsets.size());
+  for (const auto& rs : rowsets) {
+    uint64_t accesses = rs->AccessCount();
+    uint64_t bytes = std::max<uint64_t>(rs->OnDiskBaseDataSizeWithRedos(), 1);
+    accesses_and_bytes.emplace_back(accesses, bytes);
+    total_accesses += accesses;
+    total_bytes += bytes;
+  }
+  double mean_density = static_cast<double>(total_accesses) / total_bytes;
+  for (size_t i = 0; i < rowsets.size(); i++) {
+    double weight = 1;
+    if (total_accesses > 0 && FLAGS_compaction_access_weight > 0) {
+      double density = static_cast<double>(accesses_and_bytes[i].first) /
+                       accesses_and_bytes[i].second;
+      weight += FLAGS_compaction_access_weight * density / mean_density;
+    }
+    weights.emplace(rowsets[i].get(), weight);
+  }
+  return weights;
+}
+
 
 void CheckCollectOrderedCorrectness(const vector<RowSetInfo>& min_key,
                                     const vector<RowSetInfo>& max_key,
@@ -210,6 +247,9 @@ void RowSetInfo::CollectOrdered(const RowSetTree& tree,
     }
   }
 
+  const unordered_map<RowSet*, double> access_weights =
+      ComputeAccessWeights(available_rowsets);
+
   RowSetTree available_rs_tree;
   available_rs_tree.Reset(available_rowsets);
   for (const RowSetTree::RSEndpoint& rse :
@@ -231,6 +271,7 @@ void RowSetInfo::CollectOrdered(const RowSetTree& tree,
     // Add/remove current RowSetInfo
     if (rse.endpoint_ == RowSetTree::START) {
       min_key->push_back(RowSetInfo(rs, total_width));
+      min_key->back().extra_->access_weight = FindOrDie(access_weights, rs);
       // Store reference from vector. This is safe b/c of reserve() above.
       active.insert(std::make_pair(rs, &min_key->back()));
     } else if (rse.endpoint_ == RowSetTree::STOP) {
@@ -261,6 +302,7 @@ RowSetInfo::RowSetInfo(RowSet* rs, double init_cdf)
       cdf_max_key_(init_cdf),
       extra_(new ExtraData()) {
   extra_->rowset = rs;
+  extra_->access_weight = 1;
   extra_->size_bytes = rs->OnDiskBaseDataSizeWithRedos();
   extra_->has_bounds = rs->GetBounds(&extra_->min_key, &extra_->max_key).ok();
   size_mb_ = std::max(implicit_cast<int>(extra_->size_bytes / 1024 / 1024), kMinSizeMb);
@@ -286,6 +328,9 @@ string RowSetInfo::ToString() const {
   ret.append(rowset()->ToString());
   StringAppendF(&ret, "(% 3dM) [%.04f, %.04f]", size_mb_,
                 cdf_min_key_, cdf_max_key_);
+  if (extra_->access_weight != 1) {
+    StringAppendF(&ret, " (access weight %.02f)", extra_->access_weight);
+  }
   if (extra_->has_bounds) {
     ret.append(" [").append(KUDU_REDACT(Slice(extra_->min_key).ToDebugString()));
     ret.append(",").append(KUDU_REDACT(Slice(extra_->max_key).ToDebugString()));
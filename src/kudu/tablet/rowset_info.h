@@ -66,6 +66,10 @@ class RowSetInfo {
 
   double density() const { return density_; }
 
+  // Return the factor by which this rowset's data is scaled in the CDF to
+  // account for how heavily it is accessed. See RowSet::AccessCount().
+  double access_weight() const { return extra_->access_weight; }
+
   RowSet* rowset() const { return extra_->rowset; }
 
   std::string ToString() const;
@@ -100,6 +104,9 @@ class RowSetInfo {
     // Cached version of rowset_->OnDiskBaseDataSize().
     int size_bytes;
 
+    // See access_weight().
+    double access_weight;
+
     // True if the RowSet has known bounds.
     // MemRowSets in particular do not.
     bool has_bounds;
@@ -76,6 +76,8 @@ Status RowSetMetadata::InitFromPB(const RowSetDataPB& pb) {
 void RowSetMetadata::LoadFromPB(const RowSetDataPB& pb) {
   std::lock_guard<LockType> l(lock_);
   id_ = pb.id();
+  storage_class_ = pb.slow_storage() ? fs::DataDirStorageClass::SLOW :
+                                       fs::DataDirStorageClass::FAST;
 
   // Load Bloom File.
   bloom_block_ = BlockId();
@@ -96,6 +98,20 @@ void RowSetMetadata::LoadFromPB(const RowSetDataPB& pb) {
     blocks_by_col_id_[col_id] = BlockId::FromPB(col_pb.block());
   }
 
+  // Load the secondary indexes.
+  secondary_index_blocks_by_col_id_.clear();
+  for (const ColumnDataPB& index_pb : pb.secondary_indexes()) {
+    ColumnId col_id = ColumnId(index_pb.column_id());
+    secondary_index_blocks_by_col_id_[col_id] = BlockId::FromPB(index_pb.block());
+  }
+
+  // Load the column bloom filters.
+  bloom_filter_blocks_by_col_id_.clear();
+  for (const ColumnDataPB& bloom_pb : pb.column_bloom_filters()) {
+    ColumnId col_id = ColumnId(bloom_pb.column_id());
+    bloom_filter_blocks_by_col_id_[col_id] = BlockId::FromPB(bloom_pb.block());
+  }
+
   // Load redo delta files.
   redo_delta_blocks_.clear();
   for (const DeltaDataPB& redo_delta_pb : pb.redo_deltas()) {
@@ -104,10 +120,25 @@ void RowSetMetadata::LoadFromPB(const RowSetDataPB& pb) {
 
   last_durable_redo_dms_id_ = pb.last_durable_dms_id();
 
+  // Load the summary of the base data.
+  has_base_data_summary_ = pb.has_min_encoded_key() && pb.has_max_encoded_key() &&
+      pb.has_num_rows();
+  base_data_summary_ = { pb.min_encoded_key(), pb.max_encoded_key(), pb.num_rows() };
+
+  has_live_row_count_ = pb.has_live_row_count();
+  live_row_count_ = pb.live_row_count();
+
   // Load undo delta files.
   undo_delta_blocks_.clear();
+  undo_delta_timestamps_.clear();
   for (const DeltaDataPB& undo_delta_pb : pb.undo_deltas()) {
-    undo_delta_blocks_.push_back(BlockId::FromPB(undo_delta_pb.block()));
+    BlockId block_id = BlockId::FromPB(undo_delta_pb.block());
+    undo_delta_blocks_.push_back(block_id);
+    if (undo_delta_pb.has_min_timestamp() && undo_delta_pb.has_max_timestamp()) {
+      UndoTimestamps timestamps = { Timestamp(undo_delta_pb.min_timestamp()),
+                                    Timestamp(undo_delta_pb.max_timestamp()) };
+      InsertOrDie(&undo_delta_timestamps_, block_id, timestamps);
+    }
   }
 }
 
@@ -126,6 +157,20 @@ void RowSetMetadata::ToProtobuf(RowSetDataPB *pb) {
     col_data->set_column_id(col_id);
   }
 
+  // Write the secondary indexes.
+  for (const ColumnIdToBlockIdMap::value_type& e : secondary_index_blocks_by_col_id_) {
+    ColumnDataPB *index_data = pb->add_secondary_indexes();
+    e.second.CopyToPB(index_data->mutable_block());
+    index_data->set_column_id(e.first);
+  }
+
+  // Write the column bloom filters.
+  for (const ColumnIdToBlockIdMap::value_type& e : bloom_filter_blocks_by_col_id_) {
+    ColumnDataPB *bloom_data = pb->add_column_bloom_filters();
+    e.second.CopyToPB(bloom_data->mutable_block());
+    bloom_data->set_column_id(e.first);
+  }
+
   // Write Delta Files
   pb->set_last_durable_dms_id(last_durable_redo_dms_id_);
 
@@ -137,6 +182,11 @@ void RowSetMetadata::ToProtobuf(RowSetDataPB *pb) {
   for (const BlockId& undo_delta_block : undo_delta_blocks_) {
     DeltaDataPB *undo_delta_pb = pb->add_undo_deltas();
     undo_delta_block.CopyToPB(undo_delta_pb->mutable_block());
+    const UndoTimestamps* timestamps = FindOrNull(undo_delta_timestamps_, undo_delta_block);
+    if (timestamps) {
+      undo_delta_pb->set_min_timestamp(timestamps->min.ToUint64());
+      undo_delta_pb->set_max_timestamp(timestamps->max.ToUint64());
+    }
   }
 
   // Write Bloom File
@@ -148,6 +198,20 @@ void RowSetMetadata::ToProtobuf(RowSetDataPB *pb) {
   if (!adhoc_index_block_.IsNull()) {
     adhoc_index_block_.CopyToPB(pb->mutable_adhoc_index_block());
   }
+
+  if (storage_class_ == fs::DataDirStorageClass::SLOW) {
+    pb->set_slow_storage(true);
+  }
+
+  if (has_base_data_summary_) {
+    pb->set_min_encoded_key(base_data_summary_.min_encoded_key);
+    pb->set_max_encoded_key(base_data_summary_.max_encoded_key);
+    pb->set_num_rows(base_data_summary_.num_rows);
+  }
+
+  if (has_live_row_count_) {
+    pb->set_live_row_count(live_row_count_);
+  }
 }
 
 const std::string RowSetMetadata::ToString() const {
@@ -161,20 +225,50 @@ void RowSetMetadata::SetColumnDataBlocks(const std::map<ColumnId, BlockId>& bloc
   blocks_by_col_id_ = std::move(new_map);
 }
 
+void RowSetMetadata::SetSecondaryIndexBlocks(
+    const std::map<ColumnId, BlockId>& blocks_by_col_id) {
+  ColumnIdToBlockIdMap new_map(blocks_by_col_id.begin(), blocks_by_col_id.end());
+  new_map.shrink_to_fit();
+  std::lock_guard<LockType> l(lock_);
+  secondary_index_blocks_by_col_id_ = std::move(new_map);
+}
+
+void RowSetMetadata::SetColumnBloomFilterBlocks(
+    const std::map<ColumnId, BlockId>& blocks_by_col_id) {
+  ColumnIdToBlockIdMap new_map(blocks_by_col_id.begin(), blocks_by_col_id.end());
+  new_map.shrink_to_fit();
+  std::lock_guard<LockType> l(lock_);
+  bloom_filter_blocks_by_col_id_ = std::move(new_map);
+}
+
 Status RowSetMetadata::CommitRedoDeltaDataBlock(int64_t dms_id,
+                                                int64_t num_deleted_rows,
                                                 const BlockId& block_id) {
   std::lock_guard<LockType> l(lock_);
   last_durable_redo_dms_id_ = dms_id;
   redo_delta_blocks_.push_back(block_id);
+  live_row_count_ -= num_deleted_rows;
   return Status::OK();
 }
 
-Status RowSetMetadata::CommitUndoDeltaDataBlock(const BlockId& block_id) {
+Status RowSetMetadata::CommitUndoDeltaDataBlock(const BlockId& block_id,
+                                                const UndoTimestamps& timestamps) {
   std::lock_guard<LockType> l(lock_);
   undo_delta_blocks_.push_back(block_id);
+  InsertOrDie(&undo_delta_timestamps_, block_id, timestamps);
   return Status::OK();
 }
 
+void RowSetMetadata::SetUndoDeltaTimestamps(const BlockId& block_id,
+                                            const UndoTimestamps& timestamps) {
+  std::lock_guard<LockType> l(lock_);
+  if (std::find(undo_delta_blocks_.begin(), undo_delta_blocks_.end(), block_id) ==
+      undo_delta_blocks_.end()) {
+    return;
+  }
+  InsertIfNotPresent(&undo_delta_timestamps_, block_id, timestamps);
+}
+
 void RowSetMetadata::CommitUpdate(const RowSetMetadataUpdate& update,
                                   vector<BlockId>* removed) {
   removed->clear();
@@ -215,6 +309,7 @@ void RowSetMetadata::CommitUpdate(const RowSetMetadataUpdate& update,
       if (ContainsKey(undos_to_remove, *iter)) {
         removed->push_back(*iter);
         undos_to_remove.erase(*iter);
+        undo_delta_timestamps_.erase(*iter);
         iter = undo_delta_blocks_.erase(iter);
       } else {
         ++iter;
@@ -228,9 +323,10 @@ void RowSetMetadata::CommitUpdate(const RowSetMetadataUpdate& update,
         << vector<BlockId>(undos_to_remove.begin(), undos_to_remove.end())
         << " }";
 
-    if (!update.new_undo_block_.IsNull()) {
+    for (const auto& e : update.new_undo_blocks_) {
       // Front-loading to keep the UNDO files in their natural order.
-      undo_delta_blocks_.insert(undo_delta_blocks_.begin(), update.new_undo_block_);
+      undo_delta_blocks_.insert(undo_delta_blocks_.begin(), e.first);
+      InsertOrDie(&undo_delta_timestamps_, e.first, e.second);
     }
 
     for (const ColumnIdToBlockIdMap::value_type& e : update.cols_to_replace_) {
@@ -241,16 +337,46 @@ void RowSetMetadata::CommitUpdate(const RowSetMetadataUpdate& update,
       if (UpdateReturnCopy(&blocks_by_col_id_, e.first, e.second, &old_block_id)) {
         removed->push_back(old_block_id);
       }
+      // The old secondary index and bloom filter describe the old data of
+      // the column.
+      if (FindCopy(secondary_index_blocks_by_col_id_, e.first, &old_block_id)) {
+        secondary_index_blocks_by_col_id_.erase(e.first);
+        removed->push_back(old_block_id);
+      }
+      if (FindCopy(bloom_filter_blocks_by_col_id_, e.first, &old_block_id)) {
+        bloom_filter_blocks_by_col_id_.erase(e.first);
+        removed->push_back(old_block_id);
+      }
+    }
+
+    for (const ColumnIdToBlockIdMap::value_type& e : update.secondary_indexes_to_replace_) {
+      DCHECK(ContainsKey(update.cols_to_replace_, e.first));
+      InsertOrDie(&secondary_index_blocks_by_col_id_, e.first, e.second);
+    }
+
+    for (const ColumnIdToBlockIdMap::value_type& e : update.bloom_filters_to_replace_) {
+      DCHECK(ContainsKey(update.cols_to_replace_, e.first));
+      InsertOrDie(&bloom_filter_blocks_by_col_id_, e.first, e.second);
     }
 
     for (const ColumnId& col_id : update.col_ids_to_remove_) {
       BlockId old = FindOrDie(blocks_by_col_id_, col_id);
       CHECK_EQ(1, blocks_by_col_id_.erase(col_id));
       removed->push_back(old);
+      if (FindCopy(secondary_index_blocks_by_col_id_, col_id, &old)) {
+        secondary_index_blocks_by_col_id_.erase(col_id);
+        removed->push_back(old);
+      }
+      if (FindCopy(bloom_filter_blocks_by_col_id_, col_id, &old)) {
+        bloom_filter_blocks_by_col_id_.erase(col_id);
+        removed->push_back(old);
+      }
     }
   }
 
   blocks_by_col_id_.shrink_to_fit();
+  secondary_index_blocks_by_col_id_.shrink_to_fit();
+  bloom_filter_blocks_by_col_id_.shrink_to_fit();
 }
 
 vector<BlockId> RowSetMetadata::GetAllBlocks() {
@@ -263,6 +389,8 @@ vector<BlockId> RowSetMetadata::GetAllBlocks() {
     blocks.push_back(bloom_block_);
   }
   AppendValuesFromMap(blocks_by_col_id_, &blocks);
+  AppendValuesFromMap(secondary_index_blocks_by_col_id_, &blocks);
+  AppendValuesFromMap(bloom_filter_blocks_by_col_id_, &blocks);
 
   blocks.insert(blocks.end(),
                 undo_delta_blocks_.begin(), undo_delta_blocks_.end());
@@ -288,6 +416,18 @@ RowSetMetadataUpdate& RowSetMetadataUpdate::RemoveColumnId(ColumnId col_id) {
   return *this;
 }
 
+RowSetMetadataUpdate& RowSetMetadataUpdate::ReplaceSecondaryIndex(ColumnId col_id,
+                                                                  const BlockId& block_id) {
+  InsertOrDie(&secondary_indexes_to_replace_, col_id, block_id);
+  return *this;
+}
+
+RowSetMetadataUpdate& RowSetMetadataUpdate::ReplaceColumnBloomFilter(ColumnId col_id,
+                                                                     const BlockId& block_id) {
+  InsertOrDie(&bloom_filters_to_replace_, col_id, block_id);
+  return *this;
+}
+
 RowSetMetadataUpdate& RowSetMetadataUpdate::ReplaceRedoDeltaBlocks(
     const std::vector<BlockId>& to_remove,
     const std::vector<BlockId>& to_add) {
@@ -303,8 +443,9 @@ RowSetMetadataUpdate& RowSetMetadataUpdate::RemoveUndoDeltaBlocks(
   return *this;
 }
 
-RowSetMetadataUpdate& RowSetMetadataUpdate::SetNewUndoBlock(const BlockId& undo_block) {
-  new_undo_block_ = undo_block;
+RowSetMetadataUpdate& RowSetMetadataUpdate::AddNewUndoBlock(
+    const BlockId& undo_block, const RowSetMetadata::UndoTimestamps& timestamps) {
+  new_undo_blocks_.emplace_back(undo_block, timestamps);
   return *this;
 }
 
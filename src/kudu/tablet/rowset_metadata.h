@@ -22,14 +22,19 @@
 #include <memory>
 #include <mutex>
 #include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <boost/container/flat_map.hpp>
 #include <boost/container/vector.hpp>
 #include <glog/logging.h>
 
+#include "kudu/common/rowid.h"
 #include "kudu/common/schema.h"
+#include "kudu/common/timestamp.h"
 #include "kudu/fs/block_id.h"
+#include "kudu/fs/block_manager.h"
 #include "kudu/fs/fs_manager.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/map-util.h"
@@ -72,6 +77,22 @@ class RowSetMetadata {
   // objects.
   typedef boost::container::flat_map<ColumnId, BlockId> ColumnIdToBlockIdMap;
 
+  // The range of timestamps of the deltas in an UNDO delta block.
+  struct UndoTimestamps {
+    Timestamp min;
+    Timestamp max;
+  };
+  typedef std::unordered_map<BlockId, UndoTimestamps, BlockIdHash, BlockIdEqual>
+      UndoTimestampsMap;
+
+  // The bounds and size of the base data of a rowset, which are needed to open
+  // it. Recording them in the metadata saves reading the key index at startup.
+  struct BaseDataSummary {
+    std::string min_encoded_key;
+    std::string max_encoded_key;
+    rowid_t num_rows;
+  };
+
   // Create a new RowSetMetadata
   static Status CreateNew(TabletMetadata* tablet_metadata,
                           int64_t id,
@@ -115,9 +136,83 @@ class RowSetMetadata {
 
   void SetColumnDataBlocks(const std::map<ColumnId, BlockId>& blocks_by_col_id);
 
-  Status CommitRedoDeltaDataBlock(int64_t dms_id, const BlockId& block_id);
+  void SetSecondaryIndexBlocks(const std::map<ColumnId, BlockId>& blocks_by_col_id);
+
+  void SetColumnBloomFilterBlocks(const std::map<ColumnId, BlockId>& blocks_by_col_id);
+
+  // Commits the REDO delta block flushed from the DMS 'dms_id', whose deltas
+  // delete 'num_deleted_rows' rows.
+  Status CommitRedoDeltaDataBlock(int64_t dms_id, int64_t num_deleted_rows,
+                                  const BlockId& block_id);
+
+  Status CommitUndoDeltaDataBlock(const BlockId& block_id,
+                                  const UndoTimestamps& timestamps);
 
-  Status CommitUndoDeltaDataBlock(const BlockId& block_id);
+  // Records the timestamp range of an UNDO delta block whose range was not
+  // yet known, e.g. because it was committed by an older version. It is
+  // persisted the next time the metadata is flushed. Does nothing if the block
+  // is no longer part of this rowset.
+  void SetUndoDeltaTimestamps(const BlockId& block_id, const UndoTimestamps& timestamps);
+
+  // Returns the timestamp range of the given UNDO delta block in 'timestamps',
+  // or false if it isn't known.
+  bool GetUndoDeltaTimestamps(const BlockId& block_id, UndoTimestamps* timestamps) const {
+    std::lock_guard<LockType> l(lock_);
+    return FindCopy(undo_delta_timestamps_, block_id, timestamps);
+  }
+
+  // Records the summary of the base data of the rowset. It is persisted the
+  // next time the metadata is flushed.
+  void SetBaseDataSummary(BaseDataSummary summary) {
+    std::lock_guard<LockType> l(lock_);
+    base_data_summary_ = std::move(summary);
+    has_base_data_summary_ = true;
+  }
+
+  // Returns the summary of the base data of the rowset in 'summary', or false
+  // if it isn't known, e.g. because the rowset was written by an older
+  // version.
+  bool GetBaseDataSummary(BaseDataSummary* summary) const {
+    std::lock_guard<LockType> l(lock_);
+    if (!has_base_data_summary_) {
+      return false;
+    }
+    *summary = base_data_summary_;
+    return true;
+  }
+
+  // Records the number of rows of the rowset which aren't deleted by its
+  // committed REDO delta blocks. It is kept up to date as REDO delta blocks
+  // are committed, and persisted the next time the metadata is flushed.
+  void SetLiveRowCount(int64_t live_row_count) {
+    std::lock_guard<LockType> l(lock_);
+    live_row_count_ = live_row_count;
+    has_live_row_count_ = true;
+  }
+
+  // Returns the number of rows recorded by SetLiveRowCount() in
+  // 'live_row_count', or false if it isn't known, e.g. because the rowset
+  // was written by an older version.
+  bool GetLiveRowCount(int64_t* live_row_count) const {
+    std::lock_guard<LockType> l(lock_);
+    if (!has_live_row_count_) {
+      return false;
+    }
+    *live_row_count = live_row_count_;
+    return true;
+  }
+
+  // The class of data directory in which the blocks of this rowset are
+  // placed. Must be set before any blocks are written.
+  fs::DataDirStorageClass storage_class() const {
+    std::lock_guard<LockType> l(lock_);
+    return storage_class_;
+  }
+
+  void set_storage_class(fs::DataDirStorageClass storage_class) {
+    std::lock_guard<LockType> l(lock_);
+    storage_class_ = storage_class;
+  }
 
   BlockId bloom_block() const {
     std::lock_guard<LockType> l(lock_);
@@ -144,6 +239,20 @@ class RowSetMetadata {
     return blocks_by_col_id_;
   }
 
+  // Returns the blocks of the secondary indexes of the base data, keyed by
+  // the ID of the indexed column.
+  ColumnIdToBlockIdMap GetSecondaryIndexBlocksById() const {
+    std::lock_guard<LockType> l(lock_);
+    return secondary_index_blocks_by_col_id_;
+  }
+
+  // Returns the blocks of the bloom filters of the values of the base data,
+  // keyed by the ID of their column.
+  ColumnIdToBlockIdMap GetColumnBloomFilterBlocksById() const {
+    std::lock_guard<LockType> l(lock_);
+    return bloom_filter_blocks_by_col_id_;
+  }
+
   std::vector<BlockId> redo_delta_blocks() const {
     std::lock_guard<LockType> l(lock_);
     return redo_delta_blocks_;
@@ -199,6 +308,10 @@ class RowSetMetadata {
   explicit RowSetMetadata(TabletMetadata *tablet_metadata)
     : tablet_metadata_(tablet_metadata),
       initted_(false),
+      storage_class_(fs::DataDirStorageClass::FAST),
+      has_base_data_summary_(false),
+      has_live_row_count_(false),
+      live_row_count_(0),
       last_durable_redo_dms_id_(kNoDurableMemStore) {
   }
 
@@ -207,6 +320,10 @@ class RowSetMetadata {
     : tablet_metadata_(DCHECK_NOTNULL(tablet_metadata)),
       initted_(true),
       id_(id),
+      storage_class_(fs::DataDirStorageClass::FAST),
+      has_base_data_summary_(false),
+      has_live_row_count_(false),
+      live_row_count_(0),
       last_durable_redo_dms_id_(kNoDurableMemStore) {
   }
 
@@ -219,14 +336,32 @@ class RowSetMetadata {
   // Protects the below mutable fields.
   mutable LockType lock_;
 
+  fs::DataDirStorageClass storage_class_;
+
   BlockId bloom_block_;
   BlockId adhoc_index_block_;
 
   // Map of column ID to block ID.
   ColumnIdToBlockIdMap blocks_by_col_id_;
+
+  // Map of column ID to the block ID of the column's secondary index.
+  ColumnIdToBlockIdMap secondary_index_blocks_by_col_id_;
+
+  // Map of column ID to the block ID of the bloom filter of the column's values.
+  ColumnIdToBlockIdMap bloom_filter_blocks_by_col_id_;
   std::vector<BlockId> redo_delta_blocks_;
   std::vector<BlockId> undo_delta_blocks_;
 
+  // Timestamp ranges of the blocks in 'undo_delta_blocks_', where known.
+  UndoTimestampsMap undo_delta_timestamps_;
+
+  // Summary of the base data, where known.
+  bool has_base_data_summary_;
+  BaseDataSummary base_data_summary_;
+
+  bool has_live_row_count_;
+  int64_t live_row_count_;
+
   int64_t last_durable_redo_dms_id_;
 
   DISALLOW_COPY_AND_ASSIGN(RowSetMetadata);
@@ -251,19 +386,34 @@ class RowSetMetadataUpdate {
   // Remove the specified undo delta blocks.
   RowSetMetadataUpdate& RemoveUndoDeltaBlocks(const std::vector<BlockId>& to_remove);
 
-  // Replace the CFile for the given column ID.
+  // Replace the CFile for the given column ID. Its secondary index and bloom
+  // filter, if any, are removed, unless replaced by ReplaceSecondaryIndex()
+  // and ReplaceColumnBloomFilter().
   RowSetMetadataUpdate& ReplaceColumnId(ColumnId col_id, const BlockId& block_id);
 
-  // Remove the CFile for the given column ID.
+  // Remove the CFile for the given column ID, and its secondary index and
+  // bloom filter if any.
   RowSetMetadataUpdate& RemoveColumnId(ColumnId col_id);
 
-  // Add a new UNDO delta block to the list of UNDO files.
+  // Replace the secondary index of the given column ID, whose CFile must be
+  // replaced too.
+  RowSetMetadataUpdate& ReplaceSecondaryIndex(ColumnId col_id, const BlockId& block_id);
+
+  // Replace the bloom filter of the given column ID, whose CFile must be
+  // replaced too.
+  RowSetMetadataUpdate& ReplaceColumnBloomFilter(ColumnId col_id, const BlockId& block_id);
+
+  // Add a new UNDO delta block to the list of UNDO files. May be called
+  // several times, e.g. by compactions of disjoint groups of columns.
   // We'll need to replace them instead when we start GCing.
-  RowSetMetadataUpdate& SetNewUndoBlock(const BlockId& undo_block);
+  RowSetMetadataUpdate& AddNewUndoBlock(const BlockId& undo_block,
+                                        const RowSetMetadata::UndoTimestamps& timestamps);
 
  private:
   friend class RowSetMetadata;
   RowSetMetadata::ColumnIdToBlockIdMap cols_to_replace_;
+  RowSetMetadata::ColumnIdToBlockIdMap secondary_indexes_to_replace_;
+  RowSetMetadata::ColumnIdToBlockIdMap bloom_filters_to_replace_;
   std::vector<ColumnId> col_ids_to_remove_;
   std::vector<BlockId> new_redo_blocks_;
 
@@ -274,7 +424,7 @@ class RowSetMetadataUpdate {
   std::vector<ReplaceDeltaBlocks> replace_redo_blocks_;
 
   std::vector<BlockId> remove_undo_blocks_;
-  BlockId new_undo_block_;
+  std::vector<std::pair<BlockId, RowSetMetadata::UndoTimestamps>> new_undo_blocks_;
 
   DISALLOW_COPY_AND_ASSIGN(RowSetMetadataUpdate);
 };
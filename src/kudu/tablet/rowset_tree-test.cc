@@ -22,6 +22,7 @@
 #include <string>
 #include <vector>
 
+#include <gflags/gflags_declare.h>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 
@@ -35,11 +36,15 @@
 #include "kudu/util/test_macros.h"
 #include "kudu/util/test_util.h"
 
+using std::pair;
 using std::shared_ptr;
 using std::string;
 using std::unordered_set;
 using std::vector;
 
+DECLARE_bool(rowset_tree_flattened_lookups);
+DECLARE_int32(rowset_tree_flattened_max_entries_per_rowset);
+
 namespace kudu { namespace tablet {
 
 class TestRowSetTree : public KuduTest {
@@ -60,6 +65,31 @@ static RowSetVector GenerateRandomRowSets(int num_sets) {
   return vec;
 }
 
+// Generates 'num_sets' small rowsets, each covering a random run of up to
+// 'max_width' keys out of 'num_sets' * 'max_width', like the many small
+// rowsets left behind by frequent flushes of sequential inserts.
+static RowSetVector GenerateSmallRowSets(int num_sets, int max_width) {
+  RowSetVector vec;
+  for (int i = 0; i < num_sets; i++) {
+    int min = rand() % (num_sets * max_width);
+    int max = min + rand() % max_width;
+    vec.push_back(shared_ptr<RowSet>(new MockDiskRowSet(StringPrintf("%08d", min),
+                                                        StringPrintf("%08d", max))));
+  }
+  return vec;
+}
+
+// Returns the (rowset, key index) pairs yielded by a batch query, sorted.
+static vector<pair<RowSet*, int>> BatchQuery(const RowSetTree& tree,
+                                             const vector<Slice>& keys) {
+  vector<pair<RowSet*, int>> ret;
+  tree.ForEachRowSetContainingKeys(keys, [&](RowSet* rs, int idx) {
+      ret.emplace_back(rs, idx);
+    });
+  std::sort(ret.begin(), ret.end());
+  return ret;
+}
+
 } // anonymous namespace
 
 TEST_F(TestRowSetTree, TestTree) {
@@ -192,6 +222,139 @@ TEST_P(TestRowSetTreePerformance, TestPerformance) {
                             batch_total ? (oat_total / batch_total) : 0);
 }
 
+// Check that the flattened index answers the same as the interval tree,
+// including for keys equal to rowset bounds and outside of all rowsets.
+TEST_F(TestRowSetTree, TestFlattenedMatchesIntervalTree) {
+  SeedRandom();
+  for (int max_width : { 1, 10, 1000 }) {
+    RowSetVector vec = GenerateSmallRowSets(200, max_width);
+    vec.push_back(shared_ptr<RowSet>(new MockMemRowSet()));
+
+    FLAGS_rowset_tree_flattened_lookups = true;
+    FLAGS_rowset_tree_flattened_max_entries_per_rowset = 1000000;
+    RowSetTree flat;
+    ASSERT_OK(flat.Reset(vec));
+    ASSERT_TRUE(flat.flattened());
+
+    FLAGS_rowset_tree_flattened_lookups = false;
+    RowSetTree tree;
+    ASSERT_OK(tree.Reset(vec));
+    ASSERT_FALSE(tree.flattened());
+
+    // Query every rowset bound, plus random keys in and around the key space.
+    vector<string> queries;
+    for (const auto& rs : vec) {
+      string min, max;
+      if (rs->GetBounds(&min, &max).ok()) {
+        queries.emplace_back(std::move(min));
+        queries.emplace_back(std::move(max));
+      }
+    }
+    for (int i = 0; i < 500; i++) {
+      queries.emplace_back(StringPrintf("%08d", rand() % (220 * max_width)));
+    }
+    queries.emplace_back("");
+    queries.emplace_back("~");
+    std::sort(queries.begin(), queries.end());
+
+    vector<Slice> query_slices;
+    for (const auto& q : queries) {
+      vector<RowSet*> flat_out;
+      vector<RowSet*> tree_out;
+      flat.FindRowSetsWithKeyInRange(q, &flat_out);
+      tree.FindRowSetsWithKeyInRange(q, &tree_out);
+      std::sort(flat_out.begin(), flat_out.end());
+      std::sort(tree_out.begin(), tree_out.end());
+      ASSERT_EQ(tree_out, flat_out) << "mismatch for key " << q;
+      query_slices.emplace_back(q);
+    }
+    ASSERT_EQ(BatchQuery(tree, query_slices), BatchQuery(flat, query_slices));
+
+    // Results of a batch query must be grouped by rowset, with increasing
+    // keys within each group.
+    unordered_set<RowSet*> seen;
+    RowSet* prev_rs = nullptr;
+    int prev_idx = -1;
+    flat.ForEachRowSetContainingKeys(query_slices, [&](RowSet* rs, int idx) {
+        if (rs == prev_rs) {
+          EXPECT_LT(prev_idx, idx);
+        } else {
+          EXPECT_TRUE(InsertIfNotPresent(&seen, rs)) << "rowset visited in two groups";
+        }
+        prev_rs = rs;
+        prev_idx = idx;
+      });
+  }
+}
+
+// Heavily overlapping rowsets would make the flattened index quadratic in
+// size, so the tree must fall back to the interval tree for them.
+TEST_F(TestRowSetTree, TestFlattenedFallback) {
+  RowSetVector vec;
+  for (int i = 0; i < 1000; i++) {
+    vec.push_back(shared_ptr<RowSet>(new MockDiskRowSet(StringPrintf("%04d", i),
+                                                        StringPrintf("%04d", 2000 - i))));
+  }
+  RowSetTree tree;
+  ASSERT_OK(tree.Reset(vec));
+  ASSERT_FALSE(tree.flattened());
+
+  vector<RowSet*> out;
+  tree.FindRowSetsWithKeyInRange("1000", &out);
+  ASSERT_EQ(1000, out.size());
+}
+
+// Compare lookups through the flattened index and the interval tree for a
+// tablet with thousands of small, mostly disjoint rowsets.
+TEST_F(TestRowSetTree, TestFlattenedLookupPerformance) {
+  const int kNumRowSets = AllowSlowTests() ? 10000 : 2000;
+  const int kNumQueries = 1000;
+  const int kNumIterations = AllowSlowTests() ? 1000 : 20;
+  SeedRandom();
+
+  RowSetVector vec = GenerateSmallRowSets(kNumRowSets, 10);
+  vector<string> queries;
+  for (int i = 0; i < kNumQueries; i++) {
+    queries.emplace_back(StringPrintf("%08d", rand() % (kNumRowSets * 10)));
+  }
+  std::sort(queries.begin(), queries.end());
+  vector<Slice> query_slices(queries.begin(), queries.end());
+
+  for (bool flattened : { false, true }) {
+    FLAGS_rowset_tree_flattened_lookups = flattened;
+    RowSetTree tree;
+    ASSERT_OK(tree.Reset(vec));
+    ASSERT_EQ(flattened, tree.flattened());
+
+    Stopwatch one_at_time_timer;
+    Stopwatch batch_timer;
+    int matches = 0;
+    vector<RowSet*> out;
+    for (int i = 0; i < kNumIterations; i++) {
+      one_at_time_timer.resume();
+      for (const auto& q : query_slices) {
+        out.clear();
+        tree.FindRowSetsWithKeyInRange(q, &out);
+        matches += out.size();
+      }
+      one_at_time_timer.stop();
+
+      batch_timer.resume();
+      tree.ForEachRowSetContainingKeys(query_slices, [&](RowSet* rs, int idx) {
+          matches--;
+        });
+      batch_timer.stop();
+    }
+    ASSERT_EQ(0, matches);
+
+    LOG(INFO) << StringPrintf("R=%d Q=%d %14s: 1-by-1 %d ms, batched %d ms",
+                              kNumRowSets, kNumQueries,
+                              flattened ? "flattened" : "interval tree",
+                              static_cast<int>(one_at_time_timer.elapsed().user / 1e6),
+                              static_cast<int>(batch_timer.elapsed().user / 1e6));
+  }
+}
+
 TEST_F(TestRowSetTree, TestEndpointsConsistency) {
   const int kNumRowSets = 1000;
   RowSetVector vec = GenerateRandomRowSets(kNumRowSets);
@@ -22,18 +22,35 @@
 #include <functional>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 #include <ostream>
 
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 
 #include "kudu/gutil/stl_util.h"
 #include "kudu/tablet/rowset.h"
 #include "kudu/tablet/rowset_metadata.h"
 #include "kudu/util/interval_tree-inl.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/interval_tree.h"
 #include "kudu/util/slice.h"
 
+DEFINE_bool(rowset_tree_flattened_lookups, true,
+            "Whether point lookups into the tablet's RowSetTree should use a flattened, "
+            "sorted-array index of the rowset bounds when the rowsets overlap little "
+            "enough for it to stay small. Otherwise, lookups go through the interval tree.");
+TAG_FLAG(rowset_tree_flattened_lookups, hidden);
+
+DEFINE_int32(rowset_tree_flattened_max_entries_per_rowset, 16,
+             "Maximum average number of flattened index entries per rowset for the "
+             "RowSetTree to build its flattened point-lookup index. Heavily overlapping "
+             "rowsets would make the index quadratic in size, so past this bound "
+             "lookups fall back to the interval tree.");
+TAG_FLAG(rowset_tree_flattened_max_entries_per_rowset, hidden);
+
+using std::pair;
 using std::vector;
 using std::shared_ptr;
 using std::string;
@@ -104,7 +121,8 @@ struct RowSetIntervalTraits {
 };
 
 RowSetTree::RowSetTree()
-  : initted_(false) {
+  : flattened_(false),
+    initted_(false) {
 }
 
 Status RowSetTree::Reset(const RowSetVector &rowsets) {
@@ -168,11 +186,106 @@ Status RowSetTree::Reset(const RowSetVector &rowsets) {
     }
   }
 
+  if (FLAGS_rowset_tree_flattened_lookups) {
+    BuildFlattenedIndex();
+  }
+
   initted_ = true;
 
   return Status::OK();
 }
 
+void RowSetTree::BuildFlattenedIndex() {
+  // Collect the distinct endpoint keys. 'key_endpoints_' is already sorted
+  // by key, so adjacent duplicates are all there is to skip.
+  vector<Slice> distinct;
+  distinct.reserve(key_endpoints_.size());
+  size_t key_bytes = 0;
+  for (const auto& rse : key_endpoints_) {
+    if (distinct.empty() || distinct.back() != rse.slice_) {
+      distinct.push_back(rse.slice_);
+      key_bytes += rse.slice_.size();
+    }
+  }
+
+  // Compute the range of slots covered by each rowset, and from there the
+  // number of rowsets in each slot.
+  const auto find_key = [&](const Slice& key) -> size_t {
+    auto it = std::lower_bound(distinct.begin(), distinct.end(), key,
+                               [](const Slice& a, const Slice& b) {
+                                 return a.compare(b) < 0;
+                               });
+    DCHECK(it != distinct.end() && *it == key);
+    return it - distinct.begin();
+  };
+  const size_t num_slots = 2 * distinct.size() + 1;
+  vector<pair<size_t, size_t>> slot_ranges;
+  slot_ranges.reserve(entries_.size());
+  vector<int64_t> counts(num_slots + 1, 0);
+  for (const RowSetWithBounds* e : entries_) {
+    size_t first = 2 * find_key(e->min_key) + 1;
+    size_t last = 2 * find_key(e->max_key) + 1;
+    slot_ranges.emplace_back(first, last);
+    counts[first]++;
+    counts[last + 1]--;
+  }
+  int64_t total = 0;
+  int64_t covering = 0;
+  for (size_t i = 0; i < num_slots; i++) {
+    covering += counts[i];
+    counts[i] = covering;
+    total += covering;
+  }
+  const int64_t max_entries =
+      std::max<int64_t>(1024, entries_.size() * FLAGS_rowset_tree_flattened_max_entries_per_rowset);
+  if (total > max_entries) {
+    VLOG(2) << "Not flattening RowSetTree of " << entries_.size() << " rowsets: "
+            << total << " entries exceeds " << max_entries;
+    return;
+  }
+
+  // Copy the keys into one contiguous buffer so the binary search touches as
+  // few cache lines as possible.
+  flat_key_data_.reserve(key_bytes);
+  for (const Slice& k : distinct) {
+    flat_key_data_.append(reinterpret_cast<const char*>(k.data()), k.size());
+  }
+  flat_keys_.reserve(distinct.size());
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(flat_key_data_.data());
+  for (const Slice& k : distinct) {
+    flat_keys_.emplace_back(data, k.size());
+    data += k.size();
+  }
+
+  flat_slot_offsets_.resize(num_slots + 1);
+  flat_slot_offsets_[0] = 0;
+  for (size_t i = 0; i < num_slots; i++) {
+    flat_slot_offsets_[i + 1] = flat_slot_offsets_[i] + counts[i];
+  }
+  flat_rowsets_.resize(total);
+  vector<uint32_t> cursors(flat_slot_offsets_.begin(), flat_slot_offsets_.end() - 1);
+  for (size_t i = 0; i < entries_.size(); i++) {
+    for (size_t slot = slot_ranges[i].first; slot <= slot_ranges[i].second; slot++) {
+      flat_rowsets_[cursors[slot]++] = entries_[i]->rowset;
+    }
+  }
+  flattened_ = true;
+}
+
+size_t RowSetTree::FindFlatSlot(const Slice& key, size_t from) const {
+  DCHECK(flattened_);
+  DCHECK_LE(from, flat_keys_.size());
+  auto it = std::lower_bound(flat_keys_.begin() + from, flat_keys_.end(), key,
+                             [](const Slice& a, const Slice& b) {
+                               return a.compare(b) < 0;
+                             });
+  size_t idx = it - flat_keys_.begin();
+  if (it != flat_keys_.end() && *it == key) {
+    return 2 * idx + 1;
+  }
+  return 2 * idx;
+}
+
 void RowSetTree::FindRowSetsIntersectingInterval(const Slice &lower_bound,
                                                  const Slice &upper_bound,
                                                  vector<RowSet *> *rowsets) const {
@@ -207,6 +320,14 @@ void RowSetTree::FindRowSetsWithKeyInRange(const Slice &encoded_key,
     rowsets->push_back(rs.get());
   }
 
+  if (flattened_) {
+    size_t slot = FindFlatSlot(encoded_key);
+    rowsets->insert(rowsets->end(),
+                    flat_rowsets_.begin() + flat_slot_offsets_[slot],
+                    flat_rowsets_.begin() + flat_slot_offsets_[slot + 1]);
+    return;
+  }
+
   // Query the interval tree to efficiently find rowsets with known bounds
   // whose ranges overlap the probe key.
   vector<RowSetWithBounds *> from_tree;
@@ -231,6 +352,26 @@ void RowSetTree::ForEachRowSetContainingKeys(
     }
   }
 
+  if (flattened_) {
+    // Walk the sorted keys through the flattened index, resuming each search
+    // where the previous key landed. Callers expect the results grouped by
+    // rowset, with increasing keys within each group, so collect the matches
+    // as (rowset, key index) pairs and sort them.
+    vector<pair<RowSet*, int>> matches;
+    size_t slot = 0;
+    for (int i = 0; i < encoded_keys.size(); i++) {
+      slot = FindFlatSlot(encoded_keys[i], slot / 2);
+      for (uint32_t j = flat_slot_offsets_[slot]; j < flat_slot_offsets_[slot + 1]; j++) {
+        matches.emplace_back(flat_rowsets_[j], i);
+      }
+    }
+    std::sort(matches.begin(), matches.end());
+    for (const auto& m : matches) {
+      cb(m.first, m.second);
+    }
+    return;
+  }
+
   // The interval tree batch query callback would naturally just give us back
   // the matching Slices, but that won't allow us to easily tell the caller
   // which specific operation _index_ matched the RowSet. So, we make a vector
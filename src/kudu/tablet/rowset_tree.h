@@ -19,6 +19,7 @@
 
 #include <cstdint>
 #include <functional>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
@@ -100,11 +101,42 @@ class RowSetTree {
   // its stop slice, equivalent to its GetBounds() values.
   const std::vector<RSEndpoint>& key_endpoints() const { return key_endpoints_; }
 
+  // Returns true if point lookups are served by the flattened index rather
+  // than by the interval tree. Exposed for tests.
+  bool flattened() const { return flattened_; }
+
  private:
+  // Builds the flattened point-lookup index over the bounded rowsets, if it
+  // fits within the size budget. See the comment on 'flat_keys_'.
+  void BuildFlattenedIndex();
+
+  // Returns the slot of the flattened index which holds 'key'. Only the
+  // flattened keys at index 'from' or later are searched, which lets sorted
+  // batch queries resume from the slot of the previous key.
+  size_t FindFlatSlot(const Slice& key, size_t from = 0) const;
+
   // Interval tree of the rowsets. Used to efficiently find rowsets which might contain
   // a probe row.
   gscoped_ptr<IntervalTree<RowSetIntervalTraits> > tree_;
 
+  // Flattened point-lookup index. The distinct rowset bounds, in sorted order,
+  // partition the key space into 2 * N + 1 "slots": slot 2i + 1 is exactly
+  // flat_keys_[i], and slot 2i is the open interval between flat_keys_[i - 1]
+  // and flat_keys_[i] (unbounded at either end). The rowsets whose bounds
+  // contain the keys of slot j are
+  //   flat_rowsets_[flat_slot_offsets_[j], flat_slot_offsets_[j + 1])
+  // in the order in which they were passed to Reset().
+  //
+  // A point lookup is thus a binary search over one contiguous array of keys,
+  // followed by a sequential read of the candidate rowsets. The index is only
+  // built when the rowsets overlap little enough that it stays small; when
+  // 'flattened_' is false, lookups go through the interval tree.
+  bool flattened_;
+  std::string flat_key_data_;
+  std::vector<Slice> flat_keys_;
+  std::vector<uint32_t> flat_slot_offsets_;
+  std::vector<RowSet*> flat_rowsets_;
+
   // Ordered map of all the interval endpoints, holding the implicit contiguous
   // intervals
   // TODO map to usage statistics as well. See KUDU-???
@@ -32,6 +32,8 @@
 #include "kudu/cfile/cfile_util.h"
 #include "kudu/common/common.pb.h"
 #include "kudu/common/iterator.h"
+#include "kudu/common/partial_row.h"
+#include "kudu/common/row.h"
 #include "kudu/common/rowblock.h"
 #include "kudu/common/schema.h"
 #include "kudu/common/timestamp.h"
@@ -46,6 +48,7 @@
 #include "kudu/tablet/delta_stats.h"
 #include "kudu/tablet/deltafile.h"
 #include "kudu/tablet/local_tablet_writer.h"
+#include "kudu/tablet/metadata.pb.h"
 #include "kudu/tablet/mvcc.h"
 #include "kudu/tablet/rowset_metadata.h"
 #include "kudu/tablet/tablet-test-base.h"
@@ -56,6 +59,7 @@
 #include "kudu/tablet/tablet_metrics.h" // IWYU pragma: keep
 #include "kudu/util/faststring.h"
 #include "kudu/util/jsonwriter.h"
+#include "kudu/util/memory/arena.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/status.h"
 #include "kudu/util/stopwatch.h"
@@ -68,6 +72,8 @@ DEFINE_int32(testiterator_num_inserts, 1000,
 DEFINE_int32(testcompaction_num_rows, 1000,
              "Number of rows per rowset in TestCompaction");
 
+DECLARE_int32(tablet_hot_keys_sample_interval);
+
 using std::shared_ptr;
 using std::string;
 using std::unique_ptr;
@@ -1101,6 +1107,244 @@ TYPED_TEST(TestTablet, TestMetricsInit) {
   ASSERT_OK(registry->WriteAsJson(&writer, { "*" }, MetricJsonOptions()));
 }
 
+TYPED_TEST(TestTablet, TestSplitKeyRange) {
+  vector<string> split_keys;
+  vector<uint64_t> chunk_sizes;
+  Status s = this->tablet()->SplitKeyRange("", "", 0, &split_keys, &chunk_sizes);
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+
+  // Data which hasn't been flushed yet isn't accounted for.
+  uint64_t max_rows = this->ClampRowCount(FLAGS_testflush_num_inserts);
+  this->InsertTestRows(0, max_rows, 0);
+  ASSERT_OK(this->tablet()->SplitKeyRange("", "", 1, &split_keys, &chunk_sizes));
+  ASSERT_TRUE(split_keys.empty());
+  ASSERT_EQ(vector<uint64_t>({ 0 }), chunk_sizes);
+
+  ASSERT_OK(this->tablet()->Flush());
+
+  // A range smaller than the target isn't split.
+  ASSERT_OK(this->tablet()->SplitKeyRange("", "", this->tablet()->OnDiskDataSize() * 2,
+                                          &split_keys, &chunk_sizes));
+  ASSERT_TRUE(split_keys.empty());
+  ASSERT_EQ(1, chunk_sizes.size());
+  const uint64_t base_data_size = chunk_sizes[0];
+  ASSERT_GT(base_data_size, 0);
+  ASSERT_LE(base_data_size, this->tablet()->OnDiskDataSize());
+
+  ASSERT_OK(this->tablet()->SplitKeyRange("", "", base_data_size / 4,
+                                          &split_keys, &chunk_sizes));
+  ASSERT_GE(split_keys.size(), 2);
+  ASSERT_EQ(split_keys.size() + 1, chunk_sizes.size());
+  ASSERT_TRUE(std::is_sorted(split_keys.begin(), split_keys.end()));
+  uint64_t total_size = 0;
+  for (uint64_t size : chunk_sizes) {
+    ASSERT_GT(size, 0);
+    total_size += size;
+  }
+  ASSERT_NEAR(base_data_size, total_size, chunk_sizes.size());
+
+  // A bounded range is only split within its bounds.
+  const string start_key = split_keys.front();
+  const string stop_key = split_keys.back();
+  ASSERT_OK(this->tablet()->SplitKeyRange(start_key, stop_key, base_data_size / 16,
+                                          &split_keys, &chunk_sizes));
+  ASSERT_FALSE(split_keys.empty());
+  ASSERT_GT(split_keys.front(), start_key);
+  ASSERT_LT(split_keys.back(), stop_key);
+}
+
+TYPED_TEST(TestTablet, TestGetRows) {
+  LocalTabletWriter writer(this->tablet().get(), &this->client_schema_);
+
+  // Row 1 is updated after being flushed, row 2 is deleted after being
+  // flushed and reinserted in the MRS, row 3 is only in the MRS and row 4
+  // doesn't exist.
+  ASSERT_OK(this->InsertTestRow(&writer, 1, 0));
+  ASSERT_OK(this->InsertTestRow(&writer, 2, 0));
+  ASSERT_OK(this->tablet()->Flush());
+  ASSERT_OK(this->UpdateTestRow(&writer, 1, 10));
+  ASSERT_OK(this->DeleteTestRow(&writer, 2));
+  ASSERT_OK(this->InsertTestRow(&writer, 2, 20));
+  ASSERT_OK(this->InsertTestRow(&writer, 3, 30));
+
+  const Schema& key_schema = this->tablet()->key_schema();
+  Arena arena(1024);
+  vector<ConstContiguousRow> keys;
+  for (int64_t key_idx : { 4, 3, 2, 1 }) {
+    KuduPartialRow row(&this->client_schema_);
+    this->setup_.BuildRowKey(&row, key_idx);
+    string encoded;
+    ASSERT_OK(row.EncodeRowKey(&encoded));
+    uint8_t* key_data = static_cast<uint8_t*>(arena.AllocateBytes(key_schema.key_byte_size()));
+    ASSERT_OK(key_schema.DecodeRowKey(encoded, key_data, &arena));
+    keys.emplace_back(&key_schema, key_data);
+  }
+
+  RowBlock block(this->client_schema_, keys.size(), &arena);
+  ASSERT_OK(this->tablet()->GetRows(this->client_schema_, keys, &block));
+  ASSERT_EQ(keys.size(), block.nrows());
+  ASSERT_FALSE(block.selection_vector()->IsRowSelected(0));
+  ASSERT_TRUE(block.selection_vector()->IsRowSelected(1));
+  NO_FATALS(this->VerifyRow(block.row(1), 3, 30));
+  ASSERT_TRUE(block.selection_vector()->IsRowSelected(2));
+  NO_FATALS(this->VerifyRow(block.row(2), 2, 20));
+  ASSERT_TRUE(block.selection_vector()->IsRowSelected(3));
+  ASSERT_EQ(this->setup_.FormatDebugRow(1, 10, true),
+            this->schema_.DebugRow(block.row(3)));
+  ASSERT_EQ(keys.size(), this->tablet()->metrics()->rows_looked_up->value());
+}
+
+// Test that the ops of an unordered batch, which are applied in key order,
+// are applied in the order of the batch for each row, and that their results
+// are returned in the order of the batch.
+TYPED_TEST(TestTablet, TestUnorderedBatch) {
+  LocalTabletWriter writer(this->tablet().get(), &this->client_schema_);
+  vector<unique_ptr<KuduPartialRow>> rows;
+  vector<LocalTabletWriter::Op> ops;
+  const auto AddOp = [&](RowOperationsPB::Type type, int64_t key_idx, int32_t val) {
+    rows.emplace_back(new KuduPartialRow(&this->client_schema_));
+    if (type == RowOperationsPB::DELETE) {
+      this->setup_.BuildRowKey(rows.back().get(), key_idx);
+    } else {
+      this->setup_.BuildRow(rows.back().get(), key_idx, val);
+    }
+    ops.emplace_back(type, rows.back().get());
+  };
+  AddOp(RowOperationsPB::INSERT, 5, 0);
+  AddOp(RowOperationsPB::INSERT, 3, 0);
+  AddOp(RowOperationsPB::DELETE, 5, 0);
+  AddOp(RowOperationsPB::INSERT, 1, 0);
+  AddOp(RowOperationsPB::INSERT, 5, 2);
+  AddOp(RowOperationsPB::INSERT, 1, 9);
+  Status s = writer.WriteBatch(ops);
+  ASSERT_TRUE(s.IsAlreadyPresent()) << s.ToString();
+  ASSERT_TRUE(writer.last_op_result().has_failed_status());
+
+  vector<string> results;
+  ASSERT_OK(this->IterateToStringList(&results));
+  ASSERT_EQ(3, results.size());
+  std::sort(results.begin(), results.end());
+  vector<string> expected = { this->setup_.FormatDebugRow(1, 0, false),
+                              this->setup_.FormatDebugRow(3, 0, false),
+                              this->setup_.FormatDebugRow(5, 2, false) };
+  std::sort(expected.begin(), expected.end());
+  ASSERT_EQ(expected, results);
+}
+
+TYPED_TEST(TestTablet, TestCountLiveRows) {
+  LocalTabletWriter writer(this->tablet().get(), &this->client_schema_);
+  auto CheckLiveRowCount = [&](uint64_t expected) {
+    uint64_t count;
+    ASSERT_OK(this->tablet()->CountLiveRows(&count));
+    ASSERT_EQ(expected, count);
+  };
+
+  // Inserts, deletes and reinserts in the MRS.
+  this->InsertTestRows(0, 10, 0);
+  NO_FATALS(CheckLiveRowCount(10));
+  ASSERT_OK(this->DeleteTestRow(&writer, 0));
+  ASSERT_OK(this->DeleteTestRow(&writer, 1));
+  NO_FATALS(CheckLiveRowCount(8));
+  ASSERT_OK(this->InsertTestRow(&writer, 0, 1));
+  NO_FATALS(CheckLiveRowCount(9));
+
+  // Failed operations don't change the count.
+  ASSERT_FALSE(this->InsertTestRow(&writer, 0, 2).ok());
+  ASSERT_FALSE(this->DeleteTestRow(&writer, 1).ok());
+  NO_FATALS(CheckLiveRowCount(9));
+
+  // Neither do updates, nor upserts of existing rows.
+  ASSERT_OK(this->UpdateTestRow(&writer, 2, 10));
+  this->UpsertTestRows(2, 2, 20);
+  NO_FATALS(CheckLiveRowCount(9));
+
+  // Deletes in the DMS of a DRS, before and after it's flushed.
+  ASSERT_OK(this->tablet()->Flush());
+  NO_FATALS(CheckLiveRowCount(9));
+  ASSERT_OK(this->DeleteTestRow(&writer, 2));
+  NO_FATALS(CheckLiveRowCount(8));
+  ASSERT_OK(this->tablet()->FlushBiggestDMS());
+  NO_FATALS(CheckLiveRowCount(8));
+  ASSERT_OK(this->DeleteTestRow(&writer, 3));
+  ASSERT_OK(this->tablet()->FlushBiggestDMS());
+  NO_FATALS(CheckLiveRowCount(7));
+
+  // A row reinserted in the MRS after being deleted from a DRS.
+  ASSERT_OK(this->InsertTestRow(&writer, 2, 30));
+  NO_FATALS(CheckLiveRowCount(8));
+
+  ASSERT_OK(this->tablet()->Flush());
+  ASSERT_OK(this->tablet()->CompactWorstDeltas(RowSet::MINOR_DELTA_COMPACTION));
+  NO_FATALS(CheckLiveRowCount(8));
+  ASSERT_OK(this->tablet()->Compact(Tablet::FORCE_COMPACT_ALL));
+  NO_FATALS(CheckLiveRowCount(8));
+
+  vector<string> rows;
+  ASSERT_OK(this->IterateToStringList(&rows));
+  ASSERT_EQ(8, rows.size());
+}
+
+TYPED_TEST(TestTablet, TestHotKeys) {
+  FLAGS_tablet_hot_keys_sample_interval = 1;
+  LocalTabletWriter writer(this->tablet().get(), &this->client_schema_);
+  for (int i = 0; i < 10; i++) {
+    ASSERT_OK(this->InsertTestRow(&writer, i, 0));
+  }
+  for (int i = 0; i < 20; i++) {
+    ASSERT_OK(this->UpdateTestRow(&writer, 5, i));
+  }
+
+  // There are fewer keys than the capacity of the sketch: the counts are
+  // exact.
+  TabletHotKeysPB hot_keys;
+  this->tablet()->GetHotKeys(1, &hot_keys);
+  ASSERT_EQ(this->tablet()->tablet_id(), hot_keys.tablet_id());
+  ASSERT_EQ(30, hot_keys.estimated_ops());
+  ASSERT_EQ(1, hot_keys.keys_size());
+  KuduPartialRow row(&this->client_schema_);
+  this->setup_.BuildRowKey(&row, 5);
+  string encoded;
+  ASSERT_OK(row.EncodeRowKey(&encoded));
+  ASSERT_EQ(encoded, hot_keys.keys(0).encoded_key());
+  ASSERT_EQ(21, hot_keys.keys(0).estimated_ops());
+  ASSERT_EQ(0, hot_keys.keys(0).max_overestimate());
+}
+
+TYPED_TEST(TestTablet, TestFindSplitKey) {
+  string split_key;
+  Status s = this->tablet()->FindSplitKey(&split_key);
+  ASSERT_TRUE(s.IsNotFound()) << s.ToString();
+
+  uint64_t max_rows = this->ClampRowCount(FLAGS_testflush_num_inserts);
+  this->InsertTestRows(0, max_rows, 0);
+  ASSERT_OK(this->tablet()->Flush());
+  ASSERT_OK(this->tablet()->FindSplitKey(&split_key));
+  ASSERT_FALSE(split_key.empty());
+
+  // The tablet is much smaller than --tablet_split_size_threshold_mb, so
+  // splitting it isn't proposed.
+  string proposed_split_key;
+  ASSERT_FALSE(this->tablet()->GetProposedSplitKey(&proposed_split_key));
+
+  // The key splits the data about evenly.
+  vector<string> split_keys;
+  vector<uint64_t> chunk_sizes;
+  ASSERT_OK(this->tablet()->SplitKeyRange("", "", this->tablet()->OnDiskDataSize() * 2,
+                                          &split_keys, &chunk_sizes));
+  const uint64_t base_data_size = chunk_sizes[0];
+  uint64_t sizes[2];
+  for (int half = 0; half < 2; half++) {
+    ASSERT_OK(this->tablet()->SplitKeyRange(half == 0 ? "" : split_key,
+                                            half == 0 ? split_key : "",
+                                            this->tablet()->OnDiskDataSize() * 2,
+                                            &split_keys, &chunk_sizes));
+    ASSERT_EQ(1, chunk_sizes.size());
+    sizes[half] = chunk_sizes[0];
+    ASSERT_GT(sizes[half], 0);
+  }
+  ASSERT_NEAR(sizes[0], sizes[1], base_data_size / 2);
+}
+
 // Test that we find the correct log segment size for different indexes.
 TEST(TestTablet, TestGetReplaySizeForIndex) {
   std::map<int64_t, int64_t> replay_size_map;
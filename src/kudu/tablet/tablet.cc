@@ -21,8 +21,10 @@
 #include <cstdlib>
 #include <cstring>
 #include <iterator>
+#include <limits>
 #include <memory>
 #include <mutex>
+#include <numeric>
 #include <ostream>
 #include <type_traits>
 #include <unordered_map>
@@ -33,7 +35,12 @@
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 
+#include "kudu/cfile/cfile.pb.h"
+#include "kudu/cfile/column_statistics.h"
 #include "kudu/clock/hybrid_clock.h"
+#include "kudu/codegen/compilation_manager.h"
+#include "kudu/codegen/row_key_functions.h"
+#include "kudu/common/column_predicate.h"
 #include "kudu/common/common.pb.h"
 #include "kudu/common/encoded_key.h"
 #include "kudu/common/generic_iterators.h"
@@ -42,6 +49,7 @@
 #include "kudu/common/row.h"
 #include "kudu/common/row_changelist.h"
 #include "kudu/common/row_operations.h"
+#include "kudu/common/rowblock.h"
 #include "kudu/common/rowid.h"
 #include "kudu/common/scan_spec.h"
 #include "kudu/common/schema.h"
@@ -50,7 +58,9 @@
 #include "kudu/common/wire_protocol.pb.h"
 #include "kudu/consensus/log_anchor_registry.h"
 #include "kudu/consensus/opid.pb.h"
+#include "kudu/fs/data_dirs.h"
 #include "kudu/fs/fs_manager.h"
+#include "kudu/fs/io_scheduler.h"
 #include "kudu/gutil/bind.h"
 #include "kudu/gutil/bind_helpers.h"
 #include "kudu/gutil/casts.h"
@@ -76,6 +86,7 @@
 #include "kudu/tablet/transactions/write_transaction.h"
 #include "kudu/tserver/tserver.pb.h"
 #include "kudu/util/bitmap.h"
+#include "kudu/util/auto_release_pool.h"
 #include "kudu/util/bloom_filter.h"
 #include "kudu/util/debug/trace_event.h"
 #include "kudu/util/faststring.h"
@@ -84,10 +95,14 @@
 #include "kudu/util/locks.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/maintenance_manager.h"
+#include "kudu/util/memory/arena.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/monotime.h"
+#include "kudu/util/scoped_cleanup.h"
 #include "kudu/util/slice.h"
+#include "kudu/util/space_saving.h"
 #include "kudu/util/status_callback.h"
+#include "kudu/util/threadpool.h"
 #include "kudu/util/throttler.h"
 #include "kudu/util/trace.h"
 #include "kudu/util/url-coding.h"
@@ -138,6 +153,13 @@ DEFINE_int32(tablet_history_max_age_sec, 15 * 60,
              "To disable history removal, set to -1.");
 TAG_FLAG(tablet_history_max_age_sec, advanced);
 
+DEFINE_int32(tablet_cold_rowset_min_age_sec, 24 * 60 * 60,
+             "Rowsets which hold no writes newer than this many seconds, and which "
+             "are rarely accessed, are moved to the data directories listed in "
+             "--fs_slow_data_dirs. See --tablet_cold_rowset_max_accesses_per_sec.");
+TAG_FLAG(tablet_cold_rowset_min_age_sec, experimental);
+TAG_FLAG(tablet_cold_rowset_min_age_sec, runtime);
+
 DEFINE_int32(max_cell_size_bytes, 64 * 1024,
              "The maximum size of any individual cell in a table. Attempting to store "
              "string or binary columns with a size greater than this will result "
@@ -162,6 +184,87 @@ DEFINE_bool(enable_undo_delta_block_gc, true,
     "To change what is considered ancient history use --tablet_history_max_age_sec");
 TAG_FLAG(enable_undo_delta_block_gc, evolving);
 
+DEFINE_int32(tablet_compaction_max_partitions, 4,
+             "Maximum number of key ranges into which a rowset compaction is split. The "
+             "ranges are compacted in parallel, each by its own thread and into its own "
+             "output rowsets. If 1, compactions are single-threaded.");
+TAG_FLAG(tablet_compaction_max_partitions, experimental);
+TAG_FLAG(tablet_compaction_max_partitions, runtime);
+
+DEFINE_int32(tablet_compaction_min_partition_size_mb, 32,
+             "Minimum amount of input base data, in MB, per key range of a parallel "
+             "rowset compaction. Smaller compactions are split into fewer ranges. If 0, "
+             "every compaction is split into --tablet_compaction_max_partitions ranges.");
+TAG_FLAG(tablet_compaction_min_partition_size_mb, experimental);
+TAG_FLAG(tablet_compaction_min_partition_size_mb, runtime);
+
+DEFINE_int32(tablet_unordered_scan_threads, 1,
+             "Number of threads with which an unordered scan of a tablet reads its "
+             "rowsets in parallel. The threads are taken from a pool shared by all "
+             "the scans of the tablet server: see --scan_pool_max_threads. If 1, the "
+             "rowsets are read one after the other by the thread handling the scan "
+             "request.");
+TAG_FLAG(tablet_unordered_scan_threads, experimental);
+TAG_FLAG(tablet_unordered_scan_threads, runtime);
+
+DEFINE_int32(tablet_unordered_scan_queue_blocks, 4,
+             "When --tablet_unordered_scan_threads is greater than 1, the number of row "
+             "blocks which may be read per scan thread ahead of the client.");
+TAG_FLAG(tablet_unordered_scan_queue_blocks, experimental);
+TAG_FLAG(tablet_unordered_scan_queue_blocks, runtime);
+
+DEFINE_bool(tablet_ordered_scan_use_codegen, true,
+            "Whether ordered scans of a tablet should merge the rows of its rowsets "
+            "with code-generated comparisons of their primary keys.");
+TAG_FLAG(tablet_ordered_scan_use_codegen, hidden);
+
+DEFINE_int32(tablet_hot_keys_capacity, 32,
+             "Number of primary keys of each tablet replica to keep track of to find its "
+             "hot keys, i.e. those with the most row operations, from a sample of the "
+             "rows written to and looked up in it. If 0, hot keys aren't tracked.");
+TAG_FLAG(tablet_hot_keys_capacity, advanced);
+TAG_FLAG(tablet_hot_keys_capacity, experimental);
+
+DEFINE_int32(tablet_hot_keys_sample_interval, 16,
+             "One in how many row operations on a tablet replica are sampled to find its "
+             "hot keys.");
+TAG_FLAG(tablet_hot_keys_sample_interval, advanced);
+TAG_FLAG(tablet_hot_keys_sample_interval, experimental);
+TAG_FLAG(tablet_hot_keys_sample_interval, runtime);
+
+DEFINE_int32(tablet_hot_keys_half_life_secs, 60,
+             "Period, in seconds, after which the estimated numbers of row operations on "
+             "the hot keys of a tablet replica are halved, so that they reflect recent "
+             "operations.");
+TAG_FLAG(tablet_hot_keys_half_life_secs, advanced);
+TAG_FLAG(tablet_hot_keys_half_life_secs, experimental);
+TAG_FLAG(tablet_hot_keys_half_life_secs, runtime);
+
+DEFINE_int32(tablet_projection_cache_capacity, 64,
+             "Number of the projections resolved by the scans of a tablet replica which "
+             "are cached for the next scans with the same projection, so that they don't "
+             "each rebuild the same schemas. 0 disables the cache.");
+TAG_FLAG(tablet_projection_cache_capacity, advanced);
+TAG_FLAG(tablet_projection_cache_capacity, experimental);
+
+DEFINE_bool(tablet_apply_ops_in_key_order, true,
+            "Whether the row operations of a write batch are applied in the order of "
+            "their primary keys rather than in the order of the batch, so that the "
+            "MemRowSet and the key indexes of the DiskRowSets are walked in key order. "
+            "Operations on the same row are still applied in the order of the batch.");
+TAG_FLAG(tablet_apply_ops_in_key_order, advanced);
+TAG_FLAG(tablet_apply_ops_in_key_order, runtime);
+
+DEFINE_int64(tablet_split_size_threshold_mb, 50 * 1024,
+             "On-disk size in MiB above which the tablet server proposes a key at "
+             "which to split a tablet, in the status of the tablet replica. Tablets "
+             "much larger than others are hard to balance, and slow to copy and "
+             "compact. The key is recomputed after flushes and compactions which "
+             "changed the size of the tablet's data by enough to move it. 0 "
+             "disables the proposals.");
+TAG_FLAG(tablet_split_size_threshold_mb, advanced);
+TAG_FLAG(tablet_split_size_threshold_mb, runtime);
+
 METRIC_DEFINE_entity(tablet);
 METRIC_DEFINE_gauge_size(tablet, memrowset_size, "MemRowSet Memory Usage",
                          kudu::MetricUnit::kBytes,
@@ -177,6 +280,8 @@ using std::ostream;
 using std::pair;
 using std::shared_ptr;
 using std::string;
+using std::unique_ptr;
+using std::unordered_map;
 using std::unordered_set;
 using std::vector;
 using strings::Substitute;
@@ -213,8 +318,13 @@ Tablet::Tablet(const scoped_refptr<TabletMetadata>& metadata,
     metadata_(metadata),
     log_anchor_registry_(log_anchor_registry),
     mem_trackers_(tablet_id(), parent_mem_tracker),
+    hot_keys_last_decay_(MonoTime::Now()),
+    hot_keys_num_ops_(0),
+    split_key_tablet_size_(0),
+    uncommitted_live_rows_(0),
     next_mrs_id_(0),
     clock_(clock),
+    projection_cache_(FLAGS_tablet_projection_cache_capacity),
     rowsets_flush_sem_(1),
     state_(kInitialized) {
       CHECK(schema()->has_column_ids());
@@ -236,6 +346,10 @@ Tablet::Tablet(const scoped_refptr<TabletMetadata>& metadata,
       ->AutoDetach(&metric_detacher_);
   }
 
+  if (FLAGS_tablet_hot_keys_capacity > 0) {
+    hot_keys_.reset(new SpaceSaving(FLAGS_tablet_hot_keys_capacity));
+  }
+
   if (FLAGS_tablet_throttler_rpc_per_sec > 0 || FLAGS_tablet_throttler_bytes_per_sec > 0) {
     throttler_.reset(new Throttler(MonoTime::Now(),
                                    FLAGS_tablet_throttler_rpc_per_sec,
@@ -260,7 +374,7 @@ Status Tablet::Open() {
   TRACE_EVENT0("tablet", "Tablet::Open");
   RETURN_IF_STOPPED_OR_CHECK_STATE(kInitialized);
 
-  std::lock_guard<rw_spinlock> lock(component_lock_);
+  std::unique_lock<rw_spinlock> lock(component_lock_);
   CHECK(schema()->has_column_ids());
 
   next_mrs_id_ = metadata_->last_durable_mrs_id() + 1;
@@ -292,6 +406,13 @@ Status Tablet::Open() {
                                   mem_trackers_.tablet_tracker,
                                   &new_mrs));
   components_ = new TabletComponents(new_mrs, new_rowset_tree);
+  MemRowSet::WarmUpCodegen(*schema());
+  lock.unlock();
+
+  // The tablet may have grown past --tablet_split_size_threshold_mb before it
+  // was last shut down: propose where to split it right away rather than
+  // after its next flush or compaction.
+  UpdateProposedSplitKey();
 
   {
     std::lock_guard<simple_spinlock> l(state_lock_);
@@ -353,9 +474,22 @@ void Tablet::Shutdown() {
 }
 
 Status Tablet::GetMappedReadProjection(const Schema& projection,
-                                       Schema *mapped_projection) const {
+                                       shared_ptr<const Schema>* mapped_projection) const {
+  const uint32_t schema_version = metadata_->schema_version();
   const Schema* cur_schema = schema();
-  return cur_schema->GetMappedReadProjection(projection, mapped_projection);
+  string signature;
+  ProjectionCache::AppendSignature(projection, &signature);
+  const string key = ProjectionCache::MakeKey(ProjectionCache::MAPPED_PROJECTION,
+                                              schema_version, signature);
+  *mapped_projection = projection_cache_.Lookup(key);
+  if (*mapped_projection) {
+    return Status::OK();
+  }
+  shared_ptr<Schema> mapped(new Schema);
+  RETURN_NOT_OK(cur_schema->GetMappedReadProjection(projection, mapped.get()));
+  projection_cache_.Insert(key, mapped);
+  *mapped_projection = std::move(mapped);
+  return Status::OK();
 }
 
 BloomFilterSizing Tablet::DefaultBloomSizing() {
@@ -364,23 +498,123 @@ BloomFilterSizing Tablet::DefaultBloomSizing() {
 }
 
 Status Tablet::NewRowIterator(const Schema &projection,
-                              gscoped_ptr<RowwiseIterator> *iter) const {
+                              gscoped_ptr<RowwiseIterator> *iter,
+                              ThreadPool* scan_pool) const {
   // Yield current rows.
   MvccSnapshot snap(mvcc_);
-  return NewRowIterator(projection, snap, UNORDERED, iter);
+  return NewRowIterator(projection, snap, UNORDERED, iter, scan_pool);
 }
 
 
 Status Tablet::NewRowIterator(const Schema &projection,
                               const MvccSnapshot &snap,
                               const OrderMode order,
-                              gscoped_ptr<RowwiseIterator> *iter) const {
+                              gscoped_ptr<RowwiseIterator> *iter,
+                              ThreadPool* scan_pool) const {
   RETURN_IF_STOPPED_OR_CHECK_STATE(kOpen);
   if (metrics_) {
     metrics_->scans_started->Increment();
   }
   VLOG_WITH_PREFIX(2) << "Created new Iterator under snap: " << snap.ToString();
-  iter->reset(new Iterator(this, projection, snap, order));
+  iter->reset(new Iterator(this, projection, snap, order, scan_pool));
+  return Status::OK();
+}
+
+Status Tablet::GetRows(const Schema& projection,
+                       const vector<ConstContiguousRow>& keys,
+                       RowBlock* block) const {
+  TRACE_EVENT1("tablet", "Tablet::GetRows", "num_keys", keys.size());
+  RETURN_IF_STOPPED_OR_CHECK_STATE(kOpen);
+  DCHECK_SCHEMA_EQ(projection, block->schema());
+  DCHECK_GE(block->row_capacity(), keys.size());
+
+  shared_ptr<const Schema> mapped_projection_ptr;
+  RETURN_NOT_OK(GetMappedReadProjection(projection, &mapped_projection_ptr));
+  const Schema& mapped_projection = *mapped_projection_ptr;
+
+  // Expired rows are filtered out as in Tablet::Iterator, when the projection
+  // includes the time-to-live column.
+  const Schema* tablet_schema = schema();
+  const int ttl_col_idx = tablet_schema->find_ttl_column();
+  int64_t ttl_cutoff_micros = 0;
+  const bool filter_expired =
+      ttl_col_idx != Schema::kColumnNotFound &&
+      mapped_projection.find_column_by_id(tablet_schema->column_id(ttl_col_idx)) !=
+          Schema::kColumnNotFound &&
+      GetTimeToLiveCutoff(clock_->Now(), &ttl_cutoff_micros);
+
+  MvccSnapshot snap(mvcc_);
+  scoped_refptr<TabletComponents> comps;
+  GetComponents(&comps);
+
+  block->Resize(keys.size());
+  block->selection_vector()->SetAllFalse();
+
+  Arena arena(1024);
+  AutoReleasePool pool;
+  RowBlock row(mapped_projection, 1, &arena);
+  vector<ProbeStats> stats(keys.size());
+  vector<RowSet*> candidates;
+  for (int i = 0; i < keys.size(); i++) {
+    const ConstContiguousRow& key = keys[i];
+    RowSetKeyProbe probe(key, comps->memrowset->key_functions());
+    SampleKeyAccess(probe.encoded_key_slice());
+
+    // Only one rowset may hold a live version of the row: the first one to
+    // claim it is the one to read it from.
+    candidates.clear();
+    candidates.push_back(comps->memrowset.get());
+    comps->rowsets->FindRowSetsWithKeyInRange(probe.encoded_key_slice(), &candidates);
+    RowSet* holder = nullptr;
+    for (RowSet* rs : candidates) {
+      bool present;
+      RETURN_NOT_OK(rs->CheckRowPresent(probe, &present, &stats[i]));
+      if (present) {
+        holder = rs;
+        break;
+      }
+    }
+    if (!holder) {
+      continue;
+    }
+
+    // Read the row by scanning the rowset over the single key. The rowset's
+    // iterator seeks to the key using its key index.
+    ScanSpec spec;
+    for (int col_idx = 0; col_idx < key_schema_.num_key_columns(); col_idx++) {
+      spec.AddPredicate(ColumnPredicate::Equality(key_schema_.column(col_idx),
+                                                  key.cell_ptr(col_idx)));
+    }
+    if (filter_expired) {
+      spec.AddPredicate(ColumnPredicate::Range(tablet_schema->column(ttl_col_idx),
+                                               &ttl_cutoff_micros, nullptr));
+    }
+    spec.OptimizeScan(*tablet_schema, &arena, &pool, true);
+
+    gscoped_ptr<RowwiseIterator> rs_iter;
+    RETURN_NOT_OK(holder->NewRowIterator(&mapped_projection, snap, UNORDERED, &rs_iter));
+    shared_ptr<RowwiseIterator> iter(rs_iter.release());
+    RETURN_NOT_OK(PredicateEvaluatingIterator::InitAndMaybeWrap(&iter, &spec));
+    while (iter->HasNext()) {
+      RETURN_NOT_OK(iter->NextBlock(&row));
+      if (row.nrows() == 0 || !row.selection_vector()->IsRowSelected(0)) {
+        continue;
+      }
+      RowBlockRow src = row.row(0);
+      RowBlockRow dst = block->row(i);
+      for (int col_idx = 0; col_idx < projection.num_columns(); col_idx++) {
+        RowBlockRow::Cell dst_cell = dst.cell(col_idx);
+        RETURN_NOT_OK(CopyCell(src.cell(col_idx), &dst_cell, block->arena()));
+      }
+      block->selection_vector()->SetRowSelected(i);
+      break;
+    }
+  }
+
+  if (metrics_) {
+    metrics_->rows_looked_up->IncrementBy(keys.size());
+    metrics_->AddProbeStats(stats.data(), stats.size(), &arena);
+  }
   return Status::OK();
 }
 
@@ -419,8 +653,28 @@ Status Tablet::AcquireRowLocks(WriteTransactionState* tx_state) {
   TRACE_EVENT1("tablet", "Tablet::AcquireRowLocks",
                "num_locks", tx_state->row_ops().size());
   TRACE("PREPARE: Acquiring locks for $0 operations", tx_state->row_ops().size());
-  for (RowOp* op : tx_state->row_ops()) {
-    RETURN_NOT_OK(AcquireLockForOp(tx_state, op));
+  const vector<RowOp*>& row_ops = tx_state->row_ops();
+  // The key columns can't be altered, so the key functions of any
+  // memrowset of this tablet serve to encode the keys.
+  scoped_refptr<TabletComponents> comps;
+  GetComponents(&comps);
+  const codegen::RowKeyFunctions* key_functions = comps->memrowset->key_functions();
+  vector<Slice> keys;
+  keys.reserve(row_ops.size());
+  for (RowOp* op : row_ops) {
+    ConstContiguousRow row_key(&key_schema_, op->decoded_op.row_data);
+    op->key_probe.reset(new tablet::RowSetKeyProbe(row_key, key_functions));
+    RETURN_NOT_OK(CheckRowInTablet(row_key));
+    keys.push_back(op->key_probe->encoded_key_slice());
+  }
+
+  // Lock the whole batch at once: this is cheaper than locking one row at a
+  // time, and takes the locks in key order so that concurrent transactions
+  // can't deadlock.
+  vector<ScopedRowLock> locks;
+  lock_manager_.AcquireLocks(tx_state, keys, LockManager::LOCK_EXCLUSIVE, &locks);
+  for (size_t i = 0; i < row_ops.size(); i++) {
+    row_ops[i]->row_lock = std::move(locks[i]);
   }
   TRACE("PREPARE: locks acquired");
   return Status::OK();
@@ -443,8 +697,10 @@ Status Tablet::CheckRowInTablet(const ConstContiguousRow& row) const {
 }
 
 Status Tablet::AcquireLockForOp(WriteTransactionState* tx_state, RowOp* op) {
+  scoped_refptr<TabletComponents> comps;
+  GetComponents(&comps);
   ConstContiguousRow row_key(&key_schema_, op->decoded_op.row_data);
-  op->key_probe.reset(new tablet::RowSetKeyProbe(row_key));
+  op->key_probe.reset(new tablet::RowSetKeyProbe(row_key, comps->memrowset->key_functions()));
   RETURN_NOT_OK(CheckRowInTablet(row_key));
 
   op->row_lock = ScopedRowLock(&lock_manager_,
@@ -602,6 +858,7 @@ Status Tablet::InsertOrUpsertUnlocked(WriteTransactionState *tx_state,
   Status s = comps->memrowset->Insert(ts, row, tx_state->op_id());
   if (s.ok()) {
     op->SetInsertSucceeded(comps->memrowset->mrs_id());
+    tx_state->AddUncommittedLiveRows(this, 1);
   } else {
     if (s.IsAlreadyPresent()) {
       if (is_upsert) {
@@ -728,6 +985,9 @@ Status Tablet::MutateRowUnlocked(WriteTransactionState *tx_state,
                                       result.get());
   if (PREDICT_TRUE(s.ok())) {
     mutate->SetMutateSucceeded(std::move(result));
+    if (mutate->decoded_op.changelist.is_delete()) {
+      tx_state->AddUncommittedLiveRows(this, -1);
+    }
   } else {
     if (s.IsNotFound()) {
       // Replace internal error messages with one more suitable for users.
@@ -809,6 +1069,10 @@ Status Tablet::BulkCheckPresence(WriteTransactionState* tx_state) {
   // 'pending_group' and then calls 'ProcessPendingGroup' when the next group
   // begins.
   vector<pair<RowSet*, int>> pending_group;
+  vector<int> group_op_idxs;
+  vector<const RowSetKeyProbe*> group_probes;
+  vector<ProbeStats*> group_stats;
+  std::unique_ptr<bool[]> group_present(new bool[keys.size()]);
   Status s;
   const auto& ProcessPendingGroup = [&]() {
     if (pending_group.empty() || !s.ok()) return;
@@ -822,6 +1086,9 @@ Status Tablet::BulkCheckPresence(WriteTransactionState* tx_state) {
                             return s_a.compare(s_b) < 0;
                           }));
     RowSet* rs = pending_group[0].first;
+    group_op_idxs.clear();
+    group_probes.clear();
+    group_stats.clear();
     for (auto it = pending_group.begin();
          it != pending_group.end();
          ++it) {
@@ -832,19 +1099,26 @@ Status Tablet::BulkCheckPresence(WriteTransactionState* tx_state) {
         // Already found this op present somewhere.
         continue;
       }
-
-      bool present = false;
-      s = rs->CheckRowPresent(*op->key_probe, &present, tx_state->mutable_op_stats(op_idx));
-      if (PREDICT_FALSE(!s.ok())) {
-        LOG(WARNING) << Substitute("Tablet $0 failed to check row presence for op $1: $2",
-            tablet_id(), op->ToString(key_schema_), s.ToString());
-        return;
-      }
-      if (present) {
-        op->present_in_rowset = rs;
-      }
+      group_op_idxs.push_back(op_idx);
+      group_probes.push_back(op->key_probe.get());
+      group_stats.push_back(tx_state->mutable_op_stats(op_idx));
     }
     pending_group.clear();
+    if (group_probes.empty()) return;
+
+    // Check the whole group at once: the keys are sorted, so the rowset can
+    // share its bloom and key index lookups between neighboring keys.
+    s = rs->CheckRowsPresent(group_probes, group_stats, group_present.get());
+    if (PREDICT_FALSE(!s.ok())) {
+      LOG(WARNING) << Substitute("Tablet $0 failed to check row presence in $1: $2",
+          tablet_id(), rs->ToString(), s.ToString());
+      return;
+    }
+    for (int i = 0; i < group_op_idxs.size(); i++) {
+      if (group_present[i]) {
+        row_ops_base[group_op_idxs[i]]->present_in_rowset = rs;
+      }
+    }
   };
 
   const TabletComponents* comps = DCHECK_NOTNULL(tx_state->tablet_components());
@@ -894,11 +1168,30 @@ Status Tablet::ApplyRowOperations(WriteTransactionState* tx_state) {
 
   RETURN_NOT_OK(BulkCheckPresence(tx_state));
 
+  // Randomly ordered batches are applied in key order. The results of the ops
+  // are recorded in the ops themselves, so they are still returned in the
+  // order of the batch.
+  const auto& KeyLess = [](const RowOp* a, const RowOp* b) {
+    return a->key_probe->encoded_key_slice().compare(b->key_probe->encoded_key_slice()) < 0;
+  };
+  vector<int> apply_order;
+  if (FLAGS_tablet_apply_ops_in_key_order && num_ops > 1 &&
+      !std::is_sorted(tx_state->row_ops().begin(), tx_state->row_ops().end(), KeyLess)) {
+    apply_order.resize(num_ops);
+    std::iota(apply_order.begin(), apply_order.end(), 0);
+    // A stable sort keeps the ops on the same row in the order of the batch.
+    std::stable_sort(apply_order.begin(), apply_order.end(), [&](int a, int b) {
+      return KeyLess(tx_state->row_ops()[a], tx_state->row_ops()[b]);
+    });
+  }
+
   // Actually apply the ops.
-  for (int op_idx = 0; op_idx < num_ops; op_idx++) {
+  for (int i = 0; i < num_ops; i++) {
+    const int op_idx = apply_order.empty() ? i : apply_order[i];
     RowOp* row_op = tx_state->row_ops()[op_idx];
     if (row_op->has_result()) continue;
 
+    SampleKeyAccess(row_op->key_probe->encoded_key_slice());
     RETURN_NOT_OK(ApplyRowOperation(tx_state, row_op, tx_state->mutable_op_stats(op_idx)));
     DCHECK(row_op->has_result());
   }
@@ -1017,6 +1310,7 @@ void Tablet::AtomicSwapRowSetsUnlocked(const RowSetVector &to_remove,
                    to_remove, to_add, new_tree.get());
 
   components_ = new TabletComponents(components_->memrowset, new_tree);
+  MarkMaintenanceOpsDirty();
 }
 
 Status Tablet::DoMajorDeltaCompaction(const vector<ColumnId>& col_ids,
@@ -1024,6 +1318,7 @@ Status Tablet::DoMajorDeltaCompaction(const vector<ColumnId>& col_ids,
   RETURN_IF_STOPPED_OR_CHECK_STATE(kOpen);
   Status s = down_cast<DiskRowSet*>(input_rs.get())
       ->MajorCompactDeltaStoresWithColumnIds(col_ids, GetHistoryGcOpts());
+  MarkMaintenanceOpsDirty();
   return s;
 }
 
@@ -1049,14 +1344,52 @@ bool Tablet::GetTabletAncientHistoryMark(Timestamp* ancient_history_mark) const
   return true;
 }
 
+bool Tablet::GetTimeToLiveCutoff(Timestamp timestamp, int64_t* cutoff_micros) const {
+  if (!clock_->HasPhysicalComponent()) {
+    return false;
+  }
+  const Schema* s = schema();
+  int ttl_col_idx = s->find_ttl_column();
+  if (ttl_col_idx == Schema::kColumnNotFound) {
+    return false;
+  }
+  // Rows expire 'ttl_sec' after the time in their TTL column, so the rows
+  // which are still live hold a time no older than that.
+  *cutoff_micros = static_cast<int64_t>(HybridClock::GetPhysicalValueMicros(timestamp)) -
+      s->column(ttl_col_idx).attributes().ttl_sec * 1000000LL;
+  return true;
+}
+
 HistoryGcOpts Tablet::GetHistoryGcOpts() const {
   Timestamp ancient_history_mark;
   if (GetTabletAncientHistoryMark(&ancient_history_mark)) {
-    return HistoryGcOpts::Enabled(ancient_history_mark);
+    HistoryGcOpts opts = HistoryGcOpts::Enabled(ancient_history_mark);
+    int64_t ttl_cutoff_micros;
+    if (GetTimeToLiveCutoff(ancient_history_mark, &ttl_cutoff_micros)) {
+      const Schema* s = schema();
+      return opts.WithTimeToLive(s->column_id(s->find_ttl_column()), ttl_cutoff_micros);
+    }
+    return opts;
   }
   return HistoryGcOpts::Disabled();
 }
 
+void Tablet::UpdateMemRowSetCompactionWatermark() {
+  Timestamp ancient_history_mark;
+  if (!GetTabletAncientHistoryMark(&ancient_history_mark)) {
+    return;
+  }
+  // New scans read either at the current time, with snapshots which include
+  // everything committed before the clean timestamp, or at a snapshot no
+  // older than the ancient history mark. Scans which are already open may
+  // read at older snapshots, and the memrowset holds the watermark back for
+  // them.
+  Timestamp watermark = std::min(ancient_history_mark, mvcc_.GetCleanTimestamp());
+  scoped_refptr<TabletComponents> comps;
+  GetComponents(&comps);
+  comps->memrowset->AdvanceMutationCompactionWatermark(watermark);
+}
+
 Status Tablet::Flush() {
   TRACE_EVENT1("tablet", "Tablet::Flush", "id", tablet_id());
   std::lock_guard<Semaphore> lock(rowsets_flush_sem_);
@@ -1156,7 +1489,8 @@ Status Tablet::FlushInternal(const RowSetsInCompaction& input,
   input.DumpToLog();
   LOG_WITH_PREFIX(INFO) << "Memstore in-memory size: " << old_ms->memory_footprint() << " bytes";
 
-  RETURN_NOT_OK(DoMergeCompactionOrFlush(input, mrs_being_flushed));
+  RETURN_NOT_OK(DoMergeCompactionOrFlush(input, mrs_being_flushed,
+                                         fs::DataDirStorageClass::FAST));
 
   // Sanity check that no insertions happened during our flush.
   CHECK_EQ(start_insert_count, old_ms->debug_insert_count())
@@ -1390,6 +1724,10 @@ void Tablet::RegisterMaintenanceOps(MaintenanceManager* maint_mgr) {
     maintenance_ops.push_back(undo_delta_block_gc_op.release());
   }
 
+  gscoped_ptr<MaintenanceOp> migrate_cold_rs_op(new MigrateColdRowSetsOp(this));
+  maint_mgr->RegisterOp(migrate_cold_rs_op.get());
+  maintenance_ops.push_back(migrate_cold_rs_op.release());
+
   std::lock_guard<simple_spinlock> l(state_lock_);
   maintenance_ops_.swap(maintenance_ops);
 }
@@ -1422,6 +1760,13 @@ void Tablet::CancelMaintenanceOps() {
   }
 }
 
+void Tablet::MarkMaintenanceOpsDirty() const {
+  std::lock_guard<simple_spinlock> l(state_lock_);
+  for (MaintenanceOp* op : maintenance_ops_) {
+    op->MarkStatsDirty();
+  }
+}
+
 Status Tablet::FlushMetadata(const RowSetVector& to_remove,
                              const RowSetMetadataVector& to_add,
                              int64_t mrs_being_flushed) {
@@ -1438,7 +1783,8 @@ Status Tablet::FlushMetadata(const RowSetVector& to_remove,
 }
 
 Status Tablet::DoMergeCompactionOrFlush(const RowSetsInCompaction &input,
-                                        int64_t mrs_being_flushed) {
+                                        int64_t mrs_being_flushed,
+                                        fs::DataDirStorageClass storage_class) {
   const char *op_name =
         (mrs_being_flushed == TabletMetadata::kNoMrsFlushed) ? "Compaction" : "Flush";
   TRACE_EVENT2("tablet", "Tablet::DoMergeCompactionOrFlush",
@@ -1454,17 +1800,13 @@ Status Tablet::DoMergeCompactionOrFlush(const RowSetsInCompaction &input,
                           "PostTakeMvccSnapshot hook failed");
   }
 
-  shared_ptr<CompactionInput> merge;
-  RETURN_NOT_OK(input.CreateCompactionInput(flush_snap, schema(), &merge));
-
-  RollingDiskRowSetWriter drsw(metadata_.get(), merge->schema(), DefaultBloomSizing(),
-                               compaction_policy_->target_rowset_size());
-  RETURN_NOT_OK_PREPEND(drsw.Open(), "Failed to open DiskRowSet for flush");
-
   HistoryGcOpts history_gc_opts = GetHistoryGcOpts();
-  RETURN_NOT_OK_PREPEND(FlushCompactionInput(merge.get(), flush_snap, history_gc_opts, &drsw),
-                        "Flush to disk failed");
-  RETURN_NOT_OK_PREPEND(drsw.Finish(), "Failed to finish DRS writer");
+  RowSetMetadataVector new_drs_metas;
+  int64_t written_count;
+  uint64_t written_size;
+  RETURN_NOT_OK(WriteCompactionOrFlushOutput(input, mrs_being_flushed, storage_class,
+                                             flush_snap, history_gc_opts, &new_drs_metas,
+                                             &written_count, &written_size));
 
   if (common_hooks_) {
     RETURN_NOT_OK_PREPEND(common_hooks_->PostWriteSnapshot(),
@@ -1473,7 +1815,7 @@ Status Tablet::DoMergeCompactionOrFlush(const RowSetsInCompaction &input,
 
   // Though unlikely, it's possible that all of the input rows were actually
   // GCed in this compaction. In that case, we don't actually want to reopen.
-  bool gced_all_input = drsw.written_count() == 0;
+  bool gced_all_input = written_count == 0;
   if (gced_all_input) {
     LOG_WITH_PREFIX(INFO) << op_name << " resulted in no output rows (all input rows "
                           << "were GCed!)  Removing all input rowsets.";
@@ -1483,10 +1825,7 @@ Status Tablet::DoMergeCompactionOrFlush(const RowSetsInCompaction &input,
   // The RollingDiskRowSet writer wrote out one or more RowSets as the
   // output. Open these into 'new_rowsets'.
   vector<shared_ptr<RowSet> > new_disk_rowsets;
-  RowSetMetadataVector new_drs_metas;
-  drsw.GetWrittenRowSetMetadata(&new_drs_metas);
-
-  if (metrics_.get()) metrics_->bytes_flushed->IncrementBy(drsw.written_size());
+  if (metrics_.get()) metrics_->bytes_flushed->IncrementBy(written_size);
   CHECK(!new_drs_metas.empty());
   {
     TRACE_EVENT0("tablet", "Opening compaction results");
@@ -1585,10 +1924,12 @@ Status Tablet::DoMergeCompactionOrFlush(const RowSetsInCompaction &input,
   }
 
   // Phase 2. Here we re-scan the compaction input, copying those missed updates into the
-  // new rowset's DeltaTracker.
+  // new rowset's DeltaTracker. This covers the whole key range at once, even if phase 1
+  // was split: the new rowsets are in key order either way.
   LOG_WITH_PREFIX(INFO) << op_name
                         << " Phase 2: carrying over any updates which arrived during Phase 1";
   LOG_WITH_PREFIX(INFO) << "Phase 2 snapshot: " << non_duplicated_txns_snap.ToString();
+  shared_ptr<CompactionInput> merge;
   RETURN_NOT_OK_PREPEND(
       input.CreateCompactionInput(non_duplicated_txns_snap, schema(), &merge),
           Substitute("Failed to create $0 inputs", op_name).c_str());
@@ -1630,8 +1971,10 @@ Status Tablet::DoMergeCompactionOrFlush(const RowSetsInCompaction &input,
   // their metadata was written to disk.
   AtomicSwapRowSets({ inprogress_rowset }, new_disk_rowsets);
 
-  LOG_WITH_PREFIX(INFO) << op_name << " successful on " << drsw.written_count()
-                        << " rows " << "(" << drsw.written_size() << " bytes)";
+  LOG_WITH_PREFIX(INFO) << op_name << " successful on " << written_count
+                        << " rows " << "(" << written_size << " bytes)";
+
+  UpdateProposedSplitKey();
 
   if (common_hooks_) {
     RETURN_NOT_OK_PREPEND(common_hooks_->PostSwapNewRowSet(),
@@ -1641,6 +1984,112 @@ Status Tablet::DoMergeCompactionOrFlush(const RowSetsInCompaction &input,
   return Status::OK();
 }
 
+Status Tablet::WriteCompactionOrFlushOutput(const RowSetsInCompaction& input,
+                                            int64_t mrs_being_flushed,
+                                            fs::DataDirStorageClass storage_class,
+                                            const MvccSnapshot& snap,
+                                            const HistoryGcOpts& history_gc_opts,
+                                            RowSetMetadataVector* new_drs_metas,
+                                            int64_t* written_count,
+                                            uint64_t* written_size) {
+  // Only compactions are split: a flush has just the one MemRowSet as input.
+  vector<string> split_keys;
+  if (mrs_being_flushed == TabletMetadata::kNoMrsFlushed &&
+      FLAGS_tablet_compaction_max_partitions > 1) {
+    uint64_t input_size = 0;
+    for (const shared_ptr<RowSet>& rs : input.rowsets()) {
+      input_size += rs->OnDiskBaseDataSize();
+    }
+    int num_partitions = FLAGS_tablet_compaction_max_partitions;
+    if (FLAGS_tablet_compaction_min_partition_size_mb > 0) {
+      const uint64_t min_partition_size =
+          static_cast<uint64_t>(FLAGS_tablet_compaction_min_partition_size_mb) * 1024 * 1024;
+      num_partitions = static_cast<int>(std::min<uint64_t>(
+          num_partitions, input_size / min_partition_size));
+    }
+    RETURN_NOT_OK_PREPEND(input.SplitKeyRange(num_partitions, &split_keys),
+                          "Failed to split compaction key range");
+  }
+
+  // Partition i covers the keys in [bounds[i - 1], bounds[i]), where the
+  // missing bounds at either end are unbounded.
+  Arena arena(1024);
+  vector<unique_ptr<EncodedKey>> bounds;
+  for (const string& key : split_keys) {
+    gscoped_ptr<EncodedKey> bound;
+    RETURN_NOT_OK(EncodedKey::DecodeEncodedString(*schema(), &arena, key, &bound));
+    bounds.emplace_back(bound.release());
+  }
+  const int num_partitions = bounds.size() + 1;
+
+  vector<unique_ptr<RollingDiskRowSetWriter>> writers(num_partitions);
+  vector<Status> statuses(num_partitions);
+  auto write_partition = [&](int i) -> Status {
+    shared_ptr<CompactionInput> merge;
+    if (num_partitions == 1) {
+      RETURN_NOT_OK(input.CreateCompactionInput(snap, schema(), &merge));
+    } else {
+      RETURN_NOT_OK(input.CreateCompactionInput(
+          snap, schema(),
+          i == 0 ? nullptr : bounds[i - 1].get(),
+          i == num_partitions - 1 ? nullptr : bounds[i].get(),
+          &merge));
+    }
+
+    writers[i].reset(new RollingDiskRowSetWriter(metadata_.get(), merge->schema(),
+                                                 DefaultBloomSizing(),
+                                                 compaction_policy_->target_rowset_size()));
+    writers[i]->set_storage_class(storage_class);
+    RETURN_NOT_OK_PREPEND(writers[i]->Open(), "Failed to open DiskRowSet for flush");
+    RETURN_NOT_OK_PREPEND(FlushCompactionInput(merge.get(), snap, history_gc_opts,
+                                               writers[i].get()),
+                          "Flush to disk failed");
+    RETURN_NOT_OK_PREPEND(writers[i]->Finish(), "Failed to finish DRS writer");
+    return Status::OK();
+  };
+
+  if (num_partitions == 1) {
+    RETURN_NOT_OK(write_partition(0));
+  } else {
+    LOG_WITH_PREFIX(INFO) << "Compaction: writing " << num_partitions
+                          << " key ranges in parallel";
+    // The last partition is written by this thread.
+    gscoped_ptr<ThreadPool> pool;
+    RETURN_NOT_OK(ThreadPoolBuilder("compaction")
+                  .set_max_threads(num_partitions - 1)
+                  .Build(&pool));
+    scoped_refptr<Trace> trace(Trace::CurrentTrace());
+    const fs::IOPriority io_priority = fs::ScopedIOPriority::Current();
+    for (int i = 0; i < num_partitions - 1; i++) {
+      Status s = pool->SubmitFunc([&, i]() {
+        ADOPT_TRACE(trace.get());
+        fs::ScopedIOPriority p(io_priority);
+        statuses[i] = write_partition(i);
+      });
+      if (!s.ok()) {
+        statuses[i] = write_partition(i);
+      }
+    }
+    statuses[num_partitions - 1] = write_partition(num_partitions - 1);
+    pool->Wait();
+    for (const Status& s : statuses) {
+      RETURN_NOT_OK(s);
+    }
+  }
+
+  new_drs_metas->clear();
+  *written_count = 0;
+  *written_size = 0;
+  for (const auto& writer : writers) {
+    RowSetMetadataVector metas;
+    writer->GetWrittenRowSetMetadata(&metas);
+    new_drs_metas->insert(new_drs_metas->end(), metas.begin(), metas.end());
+    *written_count += writer->written_count();
+    *written_size += writer->written_size();
+  }
+  return Status::OK();
+}
+
 Status Tablet::HandleEmptyCompactionOrFlush(const RowSetVector& rowsets,
                                             int mrs_being_flushed) {
   // Write out the new Tablet Metadata and remove old rowsets.
@@ -1669,14 +2118,118 @@ Status Tablet::Compact(CompactFlags flags) {
 
   input.DumpToLog();
 
-  return DoMergeCompactionOrFlush(input, TabletMetadata::kNoMrsFlushed);
+  // Compacting cold rowsets together shouldn't bring them back to fast
+  // storage, but any hot input brings the output there.
+  fs::DataDirStorageClass storage_class = fs::DataDirStorageClass::SLOW;
+  for (const shared_ptr<RowSet>& rs : input.rowsets()) {
+    if (rs->metadata()->storage_class() != fs::DataDirStorageClass::SLOW) {
+      storage_class = fs::DataDirStorageClass::FAST;
+      break;
+    }
+  }
+  return DoMergeCompactionOrFlush(input, TabletMetadata::kNoMrsFlushed, storage_class);
+}
+
+bool Tablet::HasSlowStorage() const {
+  return metadata_->fs_manager()->dd_manager()->GroupHasStorageClass(
+      tablet_id(), fs::DataDirStorageClass::SLOW);
+}
+
+void Tablet::GetFastRowSetAccessCounts(unordered_map<int64_t, uint64_t>* counts) const {
+  counts->clear();
+  shared_ptr<RowSetTree> rowsets_copy;
+  {
+    shared_lock<rw_spinlock> l(component_lock_);
+    rowsets_copy = components_->rowsets;
+  }
+  std::lock_guard<std::mutex> compact_lock(compact_select_lock_);
+  for (const shared_ptr<RowSet>& rs : rowsets_copy->all_rowsets()) {
+    if (!rs->IsAvailableForCompaction()) {
+      continue;
+    }
+    shared_ptr<RowSetMetadata> rs_metadata = rs->metadata();
+    if (rs_metadata->storage_class() == fs::DataDirStorageClass::FAST) {
+      InsertOrDie(counts, rs_metadata->id(), rs->AccessCount());
+    }
+  }
+}
+
+Status Tablet::PickColdRowSet(const unordered_set<int64_t>& candidate_ids,
+                              int64_t* rowset_id,
+                              uint64_t* size) const {
+  *rowset_id = -1;
+  *size = 0;
+  if (candidate_ids.empty() || !clock_->HasPhysicalComponent() ||
+      FLAGS_tablet_cold_rowset_min_age_sec < 0) {
+    return Status::OK();
+  }
+  Timestamp now = clock_->Now();
+  uint64_t now_micros = HybridClock::GetPhysicalValueMicros(now);
+  uint64_t min_age_micros = FLAGS_tablet_cold_rowset_min_age_sec * 1000000ULL;
+  if (min_age_micros > now_micros) {
+    return Status::OK();
+  }
+  Timestamp cold_mark = HybridClock::TimestampFromMicrosecondsAndLogicalValue(
+      now_micros - min_age_micros, HybridClock::GetLogicalValue(now));
+
+  shared_ptr<RowSetTree> rowsets_copy;
+  {
+    shared_lock<rw_spinlock> l(component_lock_);
+    rowsets_copy = components_->rowsets;
+  }
+  for (const shared_ptr<RowSet>& rs : rowsets_copy->all_rowsets()) {
+    shared_ptr<RowSetMetadata> rs_metadata = rs->metadata();
+    if (!rs_metadata || !ContainsKey(candidate_ids, rs_metadata->id())) {
+      continue;
+    }
+    uint64_t rs_size = rs->OnDiskSize();
+    if (rs_size <= *size) {
+      continue;
+    }
+    bool may_have_writes;
+    RETURN_NOT_OK(rs->MayHaveWritesSince(cold_mark, &may_have_writes));
+    if (!may_have_writes) {
+      *rowset_id = rs_metadata->id();
+      *size = rs_size;
+    }
+  }
+  return Status::OK();
+}
+
+Status Tablet::MigrateRowSetToSlowStorage(int64_t rowset_id) {
+  RETURN_IF_STOPPED_OR_CHECK_STATE(kOpen);
+
+  RowSetsInCompaction input;
+  {
+    std::lock_guard<std::mutex> compact_lock(compact_select_lock_);
+    shared_lock<rw_spinlock> l(component_lock_);
+    for (const shared_ptr<RowSet>& rs : components_->rowsets->all_rowsets()) {
+      shared_ptr<RowSetMetadata> rs_metadata = rs->metadata();
+      if (!rs_metadata || rs_metadata->id() != rowset_id) {
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(*rs->compact_flush_lock(), std::try_to_lock);
+      if (lock.owns_lock()) {
+        input.AddRowSet(rs, std::move(lock));
+      }
+      break;
+    }
+  }
+  if (input.num_rowsets() == 0) {
+    return Status::NotFound(Substitute("rowset $0 is gone or being compacted", rowset_id));
+  }
+
+  LOG_WITH_PREFIX(INFO) << "Moving cold rowset " << rowset_id << " to slow data directories";
+  input.DumpToLog();
+  return DoMergeCompactionOrFlush(input, TabletMetadata::kNoMrsFlushed,
+                                  fs::DataDirStorageClass::SLOW);
 }
 
 void Tablet::UpdateCompactionStats(MaintenanceOpStats* stats) {
 
-  // TODO: use workload statistics here to find out how "hot" the tablet has
-  // been in the last 5 minutes, and somehow scale the compaction quality
-  // based on that, so we favor hot tablets.
+  // The quality computed here already favors the hot key ranges within this
+  // tablet. CompactRowSetsOp scales it by the tablet's recent access rate so
+  // that hot tablets are favored over cold ones.
   double quality = 0;
   unordered_set<RowSet*> picked_set_ignored;
 
@@ -1699,6 +2252,19 @@ void Tablet::UpdateCompactionStats(MaintenanceOpStats* stats) {
 }
 
 
+uint64_t Tablet::CountRowSetAccesses() const {
+  shared_ptr<RowSetTree> rowsets_copy;
+  {
+    shared_lock<rw_spinlock> l(component_lock_);
+    rowsets_copy = components_->rowsets;
+  }
+  uint64_t count = 0;
+  for (const shared_ptr<RowSet>& rs : rowsets_copy->all_rowsets()) {
+    count += rs->AccessCount();
+  }
+  return count;
+}
+
 Status Tablet::DebugDump(vector<string> *lines) {
   shared_lock<rw_spinlock> l(component_lock_);
 
@@ -1786,6 +2352,269 @@ Status Tablet::CountRows(uint64_t *count) const {
   return Status::OK();
 }
 
+Status Tablet::CountLiveRows(uint64_t* count) const {
+  // The counts aren't read at a single point in time, so writes racing with
+  // this call may or may not be reflected in the result.
+  const int64_t uncommitted = uncommitted_live_rows_;
+  scoped_refptr<TabletComponents> comps;
+  GetComponents(&comps);
+
+  int64_t total;
+  RETURN_NOT_OK(comps->memrowset->CountLiveRows(&total));
+  for (const shared_ptr<RowSet>& rowset : comps->rowsets->all_rowsets()) {
+    int64_t l_count;
+    RETURN_NOT_OK(rowset->CountLiveRows(&l_count));
+    total += l_count;
+  }
+  *count = std::max<int64_t>(0, total - uncommitted);
+  return Status::OK();
+}
+
+Status Tablet::GetColumnStatistics(const string& column_name,
+                                   cfile::ColumnStatisticsPB* stats,
+                                   int* num_rowsets,
+                                   int* num_rowsets_with_stats) const {
+  scoped_refptr<TabletComponents> comps;
+  GetComponents(&comps);
+
+  const Schema* s = schema();
+  const int col_idx = s->find_column(column_name);
+  if (col_idx == Schema::kColumnNotFound) {
+    return Status::NotFound("no such column", column_name);
+  }
+  const ColumnId col_id = s->column_id(col_idx);
+  const TypeInfo* typeinfo = s->column(col_idx).type_info();
+
+  stats->Clear();
+  *num_rowsets = 0;
+  *num_rowsets_with_stats = 0;
+  for (const shared_ptr<RowSet>& rowset : comps->rowsets->all_rowsets()) {
+    (*num_rowsets)++;
+    cfile::ColumnStatisticsPB rowset_stats;
+    Status status = rowset->GetColumnStatistics(col_id, &rowset_stats);
+    if (status.IsNotFound() || status.IsNotSupported()) {
+      continue;
+    }
+    RETURN_NOT_OK_PREPEND(status, Substitute("could not get statistics of rowset $0",
+                                             rowset->ToString()));
+    if ((*num_rowsets_with_stats)++ == 0) {
+      stats->Swap(&rowset_stats);
+    } else {
+      RETURN_NOT_OK(cfile::MergeColumnStatistics(typeinfo, rowset_stats, stats));
+    }
+  }
+  return Status::OK();
+}
+
+void Tablet::SampleKeyAccess(const Slice& encoded_key) const {
+  if (!hot_keys_) {
+    return;
+  }
+  const int interval = std::max(FLAGS_tablet_hot_keys_sample_interval, 1);
+  if (hot_keys_num_ops_.fetch_add(1, std::memory_order_relaxed) % interval != 0) {
+    return;
+  }
+  MonoTime now = MonoTime::Now();
+  std::lock_guard<simple_spinlock> l(hot_keys_lock_);
+  DecayHotKeysUnlocked(now);
+  hot_keys_->Add(encoded_key, interval);
+}
+
+void Tablet::DecayHotKeysUnlocked(MonoTime now) const {
+  DCHECK(hot_keys_lock_.is_locked());
+  const MonoDelta half_life =
+      MonoDelta::FromSeconds(std::max(FLAGS_tablet_hot_keys_half_life_secs, 1));
+  // After enough half-lives, nothing is left anyway.
+  static const int kMaxDecays = 64;
+  int num_decays = 0;
+  while (now - hot_keys_last_decay_ >= half_life) {
+    if (++num_decays > kMaxDecays) {
+      hot_keys_->Clear();
+      hot_keys_last_decay_ = now;
+      break;
+    }
+    hot_keys_->Decay();
+    hot_keys_last_decay_ += half_life;
+  }
+}
+
+void Tablet::GetHotKeys(int max_keys, TabletHotKeysPB* hot_keys) const {
+  hot_keys->Clear();
+  hot_keys->set_tablet_id(tablet_id());
+  if (!hot_keys_) {
+    return;
+  }
+  std::lock_guard<simple_spinlock> l(hot_keys_lock_);
+  DecayHotKeysUnlocked(MonoTime::Now());
+  hot_keys->set_estimated_ops(hot_keys_->total());
+  for (const auto& e : hot_keys_->TopK(max_keys)) {
+    TabletHotKeysPB::HotKeyPB* key = hot_keys->add_keys();
+    key->set_encoded_key(e.value);
+    key->set_estimated_ops(e.count);
+    key->set_max_overestimate(e.error);
+  }
+}
+
+Status Tablet::SplitKeyRange(const string& start_key,
+                             const string& stop_key,
+                             uint64_t target_chunk_size_bytes,
+                             vector<string>* split_keys,
+                             vector<uint64_t>* chunk_sizes) const {
+  // The number of keys sampled from a rowset per target chunk of its data.
+  // More samples even out the chunks better, at the cost of more index lookups.
+  const uint64_t kSamplesPerChunk = 8;
+  // Bounds the index lookups spent on a single rowset.
+  const uint64_t kMaxSamplesPerRowSet = 1024;
+
+  split_keys->clear();
+  chunk_sizes->clear();
+  if (target_chunk_size_bytes == 0) {
+    return Status::InvalidArgument("target chunk size must be positive");
+  }
+
+  scoped_refptr<TabletComponents> comps;
+  GetComponents(&comps);
+
+  // Each sampled key stands for the data of its rowset from that key up to the
+  // next sampled key.
+  vector<pair<string, double>> samples;
+  for (const shared_ptr<RowSet>& rowset : comps->rowsets->all_rowsets()) {
+    string min_key;
+    string max_key;
+    Status s = rowset->GetBounds(&min_key, &max_key);
+    if (s.IsNotSupported()) {
+      // In-memory rowsets have no bounds, nor any on-disk data.
+      continue;
+    }
+    RETURN_NOT_OK(s);
+    if (max_key < start_key || (!stop_key.empty() && min_key >= stop_key)) {
+      continue;
+    }
+    const uint64_t size = rowset->OnDiskBaseDataSize();
+    if (size == 0) {
+      continue;
+    }
+    const uint64_t num_samples = std::min(
+        kMaxSamplesPerRowSet, kSamplesPerChunk * (size / target_chunk_size_bytes + 1));
+    vector<string> keys;
+    s = rowset->SampleKeys(num_samples, &keys);
+    if (s.IsNotSupported()) {
+      continue;
+    }
+    RETURN_NOT_OK_PREPEND(s, Substitute("could not sample keys of rowset $0",
+                                        rowset->ToString()));
+    if (keys.empty()) {
+      continue;
+    }
+    const double bytes_per_key = static_cast<double>(size) / keys.size();
+    for (string& key : keys) {
+      if (key >= start_key && (stop_key.empty() || key < stop_key)) {
+        samples.emplace_back(std::move(key), bytes_per_key);
+      }
+    }
+  }
+  std::sort(samples.begin(), samples.end());
+
+  // Split before the first sample at which the chunk in progress has reached
+  // the target size. Keys sampled from several rowsets may repeat, and never
+  // start a new chunk twice.
+  double chunk_bytes = 0;
+  for (const auto& sample : samples) {
+    if (chunk_bytes >= target_chunk_size_bytes &&
+        sample.first > start_key &&
+        (split_keys->empty() || sample.first > split_keys->back())) {
+      split_keys->push_back(sample.first);
+      chunk_sizes->push_back(static_cast<uint64_t>(chunk_bytes));
+      chunk_bytes = 0;
+    }
+    chunk_bytes += sample.second;
+  }
+  chunk_sizes->push_back(static_cast<uint64_t>(chunk_bytes));
+  return Status::OK();
+}
+
+namespace {
+
+// FindSplitKey() splits the data into that many chunks, and the tablet is
+// split at the boundary between chunks which is the closest to the middle of
+// the data.
+const uint64_t kSplitKeyNumChunks = 16;
+
+} // anonymous namespace
+
+Status Tablet::FindSplitKey(string* split_key) const {
+  const uint64_t size = OnDiskDataSize();
+  if (size == 0) {
+    return Status::NotFound("tablet has no on-disk data");
+  }
+  vector<string> split_keys;
+  vector<uint64_t> chunk_sizes;
+  RETURN_NOT_OK(SplitKeyRange("", "", std::max<uint64_t>(1, size / kSplitKeyNumChunks),
+                              &split_keys, &chunk_sizes));
+  if (split_keys.empty()) {
+    return Status::NotFound("no key splits the on-disk data of the tablet");
+  }
+  uint64_t total_size = 0;
+  for (uint64_t chunk_size : chunk_sizes) {
+    total_size += chunk_size;
+  }
+  size_t best = 0;
+  uint64_t best_imbalance = std::numeric_limits<uint64_t>::max();
+  uint64_t size_before = 0;
+  for (size_t i = 0; i < split_keys.size(); i++) {
+    size_before += chunk_sizes[i];
+    const uint64_t size_after = total_size - size_before;
+    const uint64_t imbalance = size_before > size_after ? size_before - size_after
+                                                        : size_after - size_before;
+    if (imbalance < best_imbalance) {
+      best = i;
+      best_imbalance = imbalance;
+    }
+  }
+  *split_key = std::move(split_keys[best]);
+  return Status::OK();
+}
+
+bool Tablet::GetProposedSplitKey(string* split_key) const {
+  std::lock_guard<simple_spinlock> l(split_key_lock_);
+  if (proposed_split_key_.empty()) {
+    return false;
+  }
+  *split_key = proposed_split_key_;
+  return true;
+}
+
+void Tablet::UpdateProposedSplitKey() {
+  const int64_t threshold_mb = FLAGS_tablet_split_size_threshold_mb;
+  const uint64_t size = OnDiskSize();
+  if (threshold_mb <= 0 || size <= threshold_mb * 1024 * 1024) {
+    std::lock_guard<simple_spinlock> l(split_key_lock_);
+    proposed_split_key_.clear();
+    return;
+  }
+  {
+    // The key is only precise to a chunk anyway, so it's not worth sampling
+    // the whole tablet again until its size changed by about that much.
+    std::lock_guard<simple_spinlock> l(split_key_lock_);
+    const uint64_t delta = size > split_key_tablet_size_ ? size - split_key_tablet_size_
+                                                         : split_key_tablet_size_ - size;
+    if (!proposed_split_key_.empty() &&
+        delta < split_key_tablet_size_ / kSplitKeyNumChunks) {
+      return;
+    }
+  }
+  string split_key;
+  Status s = FindSplitKey(&split_key);
+  if (!s.ok()) {
+    LOG_WITH_PREFIX(WARNING) << "Unable to find a key at which to split the tablet: "
+                             << s.ToString();
+    split_key.clear();
+  }
+  std::lock_guard<simple_spinlock> l(split_key_lock_);
+  proposed_split_key_ = std::move(split_key);
+  split_key_tablet_size_ = size;
+}
+
 size_t Tablet::MemRowSetSize() const {
   scoped_refptr<TabletComponents> comps;
   GetComponents(&comps);
@@ -1880,7 +2709,9 @@ Status Tablet::FlushDMSWithHighestRetention(const ReplaySizeMap& replay_size_map
   RETURN_IF_STOPPED_OR_CHECK_STATE(kOpen);
   shared_ptr<RowSet> rowset = FindBestDMSToFlush(replay_size_map);
   if (rowset) {
-    return rowset->FlushDeltas();
+    Status s = rowset->FlushDeltas();
+    MarkMaintenanceOpsDirty();
+    return s;
   }
   return Status::OK();
 }
@@ -1937,7 +2768,12 @@ Status Tablet::FlushBiggestDMS() {
       biggest_drs = rowset;
     }
   }
-  return max_size > 0 ? biggest_drs->FlushDeltas() : Status::OK();
+  if (max_size <= 0) {
+    return Status::OK();
+  }
+  Status s = biggest_drs->FlushDeltas();
+  MarkMaintenanceOpsDirty();
+  return s;
 }
 
 Status Tablet::FlushAllDMSForTests() {
@@ -1988,6 +2824,9 @@ Status Tablet::CompactWorstDeltas(RowSet::DeltaCompactionType type) {
   // We just released compact_select_lock_ so other compactions can select and run, but the
   // rowset is ours.
   DCHECK(perf_improv != 0);
+  SCOPED_CLEANUP({
+    MarkMaintenanceOpsDirty();
+  });
   if (type == RowSet::MINOR_DELTA_COMPACTION) {
     RETURN_NOT_OK_PREPEND(rs->MinorCompactDeltaStores(),
                           "Failed minor delta compaction on " + rs->ToString());
@@ -2159,6 +2998,9 @@ Status Tablet::DeleteAncientUndoDeltas(int64_t* blocks_deleted, int64_t* bytes_d
     RETURN_NOT_OK(metadata_->Flush());
   }
 
+  if (tablet_blocks_deleted > 0) {
+    MarkMaintenanceOpsDirty();
+  }
   MonoDelta tablet_delete_duration = MonoTime::Now() - tablet_delete_start;
   metrics_->undo_delta_block_gc_bytes_deleted->IncrementBy(tablet_bytes_deleted);
   metrics_->undo_delta_block_gc_delete_duration->Increment(
@@ -2169,6 +3011,91 @@ Status Tablet::DeleteAncientUndoDeltas(int64_t* blocks_deleted, int64_t* bytes_d
   return Status::OK();
 }
 
+Status Tablet::EstimateBytesInExpiredRowSets(int64_t* bytes) {
+  DCHECK(bytes);
+  *bytes = 0;
+
+  HistoryGcOpts history_gc_opts = GetHistoryGcOpts();
+  if (!history_gc_opts.ttl_enabled()) {
+    return Status::OK();
+  }
+
+  scoped_refptr<TabletComponents> comps;
+  GetComponents(&comps);
+
+  int64_t tablet_bytes = 0;
+  for (const auto& rowset : comps->rowsets->all_rowsets()) {
+    bool expired;
+    RETURN_NOT_OK(rowset->IsExpiredBeforeAncientHistory(history_gc_opts, &expired));
+    if (expired) {
+      tablet_bytes += rowset->OnDiskSize();
+    }
+  }
+  *bytes = tablet_bytes;
+  return Status::OK();
+}
+
+Status Tablet::DeleteExpiredRowSets(int64_t* rowsets_deleted, int64_t* bytes_deleted) {
+  RETURN_IF_STOPPED_OR_CHECK_STATE(kOpen);
+
+  HistoryGcOpts history_gc_opts = GetHistoryGcOpts();
+  if (!history_gc_opts.ttl_enabled()) {
+    if (rowsets_deleted) *rowsets_deleted = 0;
+    if (bytes_deleted) *bytes_deleted = 0;
+    return Status::OK();
+  }
+
+  scoped_refptr<TabletComponents> comps;
+  GetComponents(&comps);
+
+  // Checking for expiry may require IO, so it's done before selecting the
+  // rowsets.
+  RowSetVector expired_rowsets;
+  for (const auto& rowset : comps->rowsets->all_rowsets()) {
+    bool expired;
+    RETURN_NOT_OK(rowset->IsExpiredBeforeAncientHistory(history_gc_opts, &expired));
+    if (expired) {
+      expired_rowsets.push_back(rowset);
+    }
+  }
+
+  // As when deleting ancient undos, hold the compact_flush_lock of each rowset
+  // so that it isn't concurrently compacted.
+  RowSetVector rowsets_to_delete;
+  vector<std::unique_lock<std::mutex>> rowset_locks;
+  {
+    std::lock_guard<std::mutex> compact_lock(compact_select_lock_);
+    for (const auto& rowset : expired_rowsets) {
+      if (!rowset->IsAvailableForCompaction()) {
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(*rowset->compact_flush_lock(), std::try_to_lock);
+      CHECK(lock.owns_lock()) << rowset->ToString() << " unable to lock compact_flush_lock";
+      rowsets_to_delete.push_back(rowset);
+      rowset_locks.push_back(std::move(lock));
+    }
+  }
+
+  int64_t tablet_bytes_deleted = 0;
+  if (!rowsets_to_delete.empty()) {
+    for (const auto& rowset : rowsets_to_delete) {
+      tablet_bytes_deleted += rowset->OnDiskSize();
+    }
+    // Like a compaction whose input rows were all GCed, just remove the
+    // rowsets. Their blocks are deleted along with the metadata.
+    LOG_WITH_PREFIX(INFO) << Substitute("Deleting $0 expired rowsets ($1)",
+                                        rowsets_to_delete.size(),
+                                        HumanReadableNumBytes::ToString(tablet_bytes_deleted));
+    RETURN_NOT_OK(HandleEmptyCompactionOrFlush(rowsets_to_delete,
+                                               TabletMetadata::kNoMrsFlushed));
+    metrics_->expired_rowsets_deleted->IncrementBy(rowsets_to_delete.size());
+  }
+
+  if (rowsets_deleted) *rowsets_deleted = rowsets_to_delete.size();
+  if (bytes_deleted) *bytes_deleted = tablet_bytes_deleted;
+  return Status::OK();
+}
+
 int64_t Tablet::CountUndoDeltasForTests() const {
   scoped_refptr<TabletComponents> comps;
   GetComponents(&comps);
@@ -2247,31 +3174,80 @@ string Tablet::LogPrefix() const {
 ////////////////////////////////////////////////////////////
 
 Tablet::Iterator::Iterator(const Tablet* tablet, const Schema& projection,
-                           MvccSnapshot snap, const OrderMode order)
+                           MvccSnapshot snap, const OrderMode order,
+                           ThreadPool* scan_pool)
     : tablet_(tablet),
       projection_(projection),
       snap_(std::move(snap)),
-      order_(order) {}
+      order_(order),
+      scan_pool_(scan_pool),
+      ttl_cutoff_micros_(0) {}
 
 Tablet::Iterator::~Iterator() {}
 
+void Tablet::Iterator::AddTimeToLivePredicate(ScanSpec** spec) {
+  const Schema* tablet_schema = tablet_->schema();
+  int ttl_col_idx = tablet_schema->find_ttl_column();
+  if (ttl_col_idx == Schema::kColumnNotFound ||
+      mapped_projection_->find_column_by_id(tablet_schema->column_id(ttl_col_idx)) ==
+          Schema::kColumnNotFound) {
+    return;
+  }
+  // A snapshot including all transactions doesn't have a meaningful time, so
+  // rows are never considered expired later than now.
+  Timestamp now = tablet_->clock_->Now();
+  Timestamp snap_time = std::min(snap_.all_committed_before(), now);
+  if (!tablet_->GetTimeToLiveCutoff(snap_time, &ttl_cutoff_micros_)) {
+    return;
+  }
+  if (*spec == nullptr) {
+    ttl_spec_.reset(new ScanSpec);
+    *spec = ttl_spec_.get();
+  }
+  (*spec)->AddPredicate(ColumnPredicate::Range(tablet_schema->column(ttl_col_idx),
+                                               &ttl_cutoff_micros_, nullptr));
+}
+
 Status Tablet::Iterator::Init(ScanSpec *spec) {
   DCHECK(iter_.get() == nullptr);
 
-  RETURN_NOT_OK(tablet_->GetMappedReadProjection(projection_, &projection_));
+  RETURN_NOT_OK(tablet_->GetMappedReadProjection(projection_, &mapped_projection_));
+
+  // Expired rows are filtered out like any other predicate, so that the zone
+  // maps of the time-to-live column can skip whole blocks of them.
+  AddTimeToLivePredicate(&spec);
 
   vector<shared_ptr<RowwiseIterator>> iters;
 
-  RETURN_NOT_OK(tablet_->CaptureConsistentIterators(&projection_, snap_, spec, order_, &iters));
+  RETURN_NOT_OK(tablet_->CaptureConsistentIterators(mapped_projection_.get(), snap_, spec,
+                                                    order_, &iters));
 
   switch (order_) {
-    case ORDERED:
-      iter_.reset(new MergeIterator(projection_, std::move(iters)));
+    case ORDERED: {
+      shared_ptr<const RowKeyComparator> key_comparator;
+      scoped_refptr<codegen::RowKeyFunctions> key_functions;
+      if (FLAGS_tablet_ordered_scan_use_codegen &&
+          codegen::CompilationManager::GetSingleton()->RequestRowKeyFunctions(
+              *mapped_projection_, &key_functions)) {
+        key_comparator.reset(new codegen::RowKeyComparator(std::move(key_functions)));
+      }
+      iter_.reset(new MergeIterator(*mapped_projection_, std::move(iters),
+                                    std::move(key_comparator)));
       break;
+    }
     case UNORDERED:
-    default:
-      iter_.reset(new UnionIterator(std::move(iters)));
+    default: {
+      const int num_threads = FLAGS_tablet_unordered_scan_threads;
+      if (scan_pool_ != nullptr && num_threads > 1 && iters.size() > 1) {
+        const int max_queued_blocks =
+            std::max(1, FLAGS_tablet_unordered_scan_queue_blocks) * num_threads;
+        iter_.reset(new ParallelUnionIterator(std::move(iters), scan_pool_, num_threads,
+                                              max_queued_blocks));
+      } else {
+        iter_.reset(new UnionIterator(std::move(iters)));
+      }
       break;
+    }
   }
 
   RETURN_NOT_OK(iter_->Init(spec));
@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
 #include <iosfwd>
@@ -25,6 +26,8 @@
 #include <mutex>
 #include <ostream>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include <glog/logging.h>
@@ -34,6 +37,7 @@
 #include "kudu/common/common.pb.h"
 #include "kudu/common/iterator.h"
 #include "kudu/common/schema.h"
+#include "kudu/fs/block_manager.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/port.h"
@@ -41,12 +45,14 @@
 #include "kudu/gutil/threading/thread_collision_warner.h"
 #include "kudu/tablet/lock_manager.h"
 #include "kudu/tablet/mvcc.h"
+#include "kudu/tablet/projection_cache.h"
 #include "kudu/tablet/rowset.h"
 #include "kudu/tablet/tablet_mem_trackers.h"
 #include "kudu/tablet/tablet_metadata.h"
 #include "kudu/util/bloom_filter.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/metrics.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/rw_semaphore.h"
 #include "kudu/util/semaphore.h"
 #include "kudu/util/status.h"
@@ -61,10 +67,16 @@ class MemTracker;
 class MonoDelta;
 class RowBlock;
 class ScanSpec;
+class SpaceSaving;
+class ThreadPool;
 class Throttler;
 class Timestamp;
 struct IteratorStats;
 
+namespace cfile {
+class ColumnStatisticsPB;
+}
+
 namespace log {
 class LogAnchorRegistry;
 }
@@ -137,12 +149,11 @@ class Tablet {
   Status DecodeWriteOperations(const Schema* client_schema,
                                WriteTransactionState* tx_state);
 
-  // Acquire locks for each of the operations in the given txn.
+  // Acquire locks for each of the operations in the given txn. The rows
+  // are locked in key order, as a single batch.
   //
-  // Note that, if this fails, it's still possible that the transaction
-  // state holds _some_ of the locks. In that case, we expect that
-  // the transaction will still clean them up when it is aborted (or
-  // otherwise destructed).
+  // Note that, if this fails, no locks are taken. The key probes of the
+  // operations may however already be set.
   Status AcquireRowLocks(WriteTransactionState* tx_state);
 
   // Starts an MVCC transaction which must have a pre-assigned timestamp.
@@ -186,16 +197,39 @@ class Tablet {
                            ProbeStats* stats) WARN_UNUSED_RESULT;
 
   // Create a new row iterator which yields the rows as of the current MVCC
-  // state of this tablet.
+  // state of this tablet, in no particular order.
   // The returned iterator is not initialized.
+  //
+  // See below for 'scan_pool'.
   Status NewRowIterator(const Schema &projection,
-                        gscoped_ptr<RowwiseIterator> *iter) const;
+                        gscoped_ptr<RowwiseIterator> *iter,
+                        ThreadPool* scan_pool = nullptr) const;
 
   // Create a new row iterator for some historical snapshot.
+  //
+  // If 'scan_pool' is non-NULL, unordered scans may read several rowsets at
+  // once on it (see --tablet_unordered_scan_threads). The pool must outlive
+  // the iterator.
   Status NewRowIterator(const Schema &projection,
                         const MvccSnapshot &snap,
                         const OrderMode order,
-                        gscoped_ptr<RowwiseIterator> *iter) const;
+                        gscoped_ptr<RowwiseIterator> *iter,
+                        ThreadPool* scan_pool = nullptr) const;
+
+  // Looks up the current versions of the rows whose primary keys are 'keys',
+  // which are rows of the key schema, and projects them onto the client
+  // projection 'projection'.
+  //
+  // Unlike a scan, this only reads from the rowsets which, according to their
+  // key bounds, bloom filters and key indexes, hold each key, and bypasses the
+  // iterators which merge the results of every rowset.
+  //
+  // 'block' must have 'projection' as its schema, and room for keys.size()
+  // rows. Row i of 'block' is set to the row with key 'keys[i]' and selected,
+  // or deselected if there is no such row.
+  Status GetRows(const Schema& projection,
+                 const std::vector<ConstContiguousRow>& keys,
+                 RowBlock* block) const;
 
   // Flush the current MemRowSet for this tablet to disk. This swaps
   // in a new (initially empty) MemRowSet in its place.
@@ -244,6 +278,32 @@ class Tablet {
   // Update the statistics for performing a compaction.
   void UpdateCompactionStats(MaintenanceOpStats* stats);
 
+  // Returns the sum of RowSet::AccessCount() over the tablet's rowsets.
+  uint64_t CountRowSetAccesses() const;
+
+  // Returns whether the tablet's data dir group has slow data directories to
+  // which cold rowsets may be moved.
+  bool HasSlowStorage() const;
+
+  // Sets 'counts' to the RowSet::AccessCount() of each rowset which may be
+  // moved to slow data directories, keyed by rowset ID: the DiskRowSets
+  // placed in fast directories which aren't being compacted.
+  void GetFastRowSetAccessCounts(std::unordered_map<int64_t, uint64_t>* counts) const;
+
+  // Among the rowsets with IDs in 'candidate_ids', finds the largest one with
+  // no writes newer than --tablet_cold_rowset_min_age_sec, setting
+  // 'rowset_id' to its ID and 'size' to its on-disk size. Sets 'rowset_id'
+  // to -1 if there's none, or if the tablet's clock can't tell the age of
+  // writes.
+  Status PickColdRowSet(const std::unordered_set<int64_t>& candidate_ids,
+                        int64_t* rowset_id,
+                        uint64_t* size) const;
+
+  // Rewrites the rowset with ID 'rowset_id' into slow data directories and
+  // swaps it in, the way a compaction of that rowset alone would. Returns
+  // NotFound if the rowset no longer exists or is being compacted.
+  Status MigrateRowSetToSlowStorage(int64_t rowset_id);
+
   // Returns the exact current size of the MRS, in bytes. A value greater than 0 doesn't imply
   // that the MRS has data, only that it has allocated that amount of memory.
   // This method takes a read lock on component_lock_ and is thread-safe.
@@ -307,7 +367,8 @@ class Tablet {
                                                        std::shared_ptr<RowSet>* rs) const;
 
   // Estimate the number of bytes in ancient undo delta stores. This may be an
-  // overestimate.
+  // overestimate if the timestamps of some undo delta blocks aren't recorded
+  // in the rowset metadata yet.
   Status EstimateBytesInPotentiallyAncientUndoDeltas(int64_t* bytes);
 
   // Initialize undo delta blocks for up to 'time_budget' amount of time.
@@ -322,6 +383,16 @@ class Tablet {
   Status DeleteAncientUndoDeltas(int64_t* blocks_deleted = nullptr,
                                  int64_t* bytes_deleted = nullptr);
 
+  // Sum the on-disk sizes of the rowsets whose rows all expired before the
+  // ancient history mark. Always zero if the tablet has no time-to-live column.
+  Status EstimateBytesInExpiredRowSets(int64_t* bytes);
+
+  // Find and remove all rowsets whose rows all expired before the ancient
+  // history mark, without compacting them. If this method returns OK, the
+  // number of rowsets and bytes deleted are returned in the out-parameters.
+  Status DeleteExpiredRowSets(int64_t* rowsets_deleted = nullptr,
+                              int64_t* bytes_deleted = nullptr);
+
   // Count the number of deltas in the tablet. Only used for tests.
   int64_t CountUndoDeltasForTests() const;
   int64_t CountRedoDeltasForTests() const;
@@ -334,6 +405,64 @@ class Tablet {
   // memrowset in the current implementation.
   Status CountRows(uint64_t *count) const;
 
+  // Sets 'count' to the number of live rows of the tablet, as seen by a
+  // READ_LATEST scan. Unlike CountRows(), this is answered from counts
+  // maintained as rows are inserted and deleted, without reading any data.
+  Status CountLiveRows(uint64_t* count) const;
+
+  // Adjusts the number of live rows changed by applied but not yet committed
+  // transactions, which CountLiveRows() excludes.
+  void AdjustUncommittedLiveRows(int64_t delta) {
+    uncommitted_live_rows_ += delta;
+  }
+
+  // Sets 'stats' to the statistics of the column named 'column_name', merged
+  // across the rowsets which have them. Only on-disk base data is covered:
+  // neither the MemRowSet nor any deltas are accounted for.
+  //
+  // Sets 'num_rowsets' to the number of on-disk rowsets, and
+  // 'num_rowsets_with_stats' to the number of those which had statistics for
+  // the column. If the latter is 0, 'stats' is left empty.
+  Status GetColumnStatistics(const std::string& column_name,
+                             cfile::ColumnStatisticsPB* stats,
+                             int* num_rowsets,
+                             int* num_rowsets_with_stats) const;
+
+  // Sets 'hot_keys' to the (at most) 'max_keys' primary keys of this tablet
+  // with the most recent row operations, and to the estimated number of
+  // recent row operations on the whole tablet. Both are estimated from a
+  // sample of the rows written and looked up: see --tablet_hot_keys_capacity.
+  void GetHotKeys(int max_keys, TabletHotKeysPB* hot_keys) const;
+
+  // Splits the encoded primary key range [start_key, stop_key) into chunks of
+  // about 'target_chunk_size_bytes' of on-disk base data each. An empty key
+  // leaves that end of the range unbounded.
+  //
+  // The sizes are estimated from keys sampled from the key index of each
+  // on-disk rowset, each sample standing for an equal share of its rowset's
+  // size. Neither the MemRowSet nor any deltas are accounted for.
+  //
+  // Sets 'split_keys' to the encoded keys at which to split the range, in
+  // increasing order, and 'chunk_sizes' to the estimated sizes of the
+  // resulting split_keys->size() + 1 chunks.
+  Status SplitKeyRange(const std::string& start_key,
+                       const std::string& stop_key,
+                       uint64_t target_chunk_size_bytes,
+                       std::vector<std::string>* split_keys,
+                       std::vector<uint64_t>* chunk_sizes) const;
+
+  // Sets 'split_key' to the encoded primary key which splits the on-disk base
+  // data of the tablet into two halves of about the same size, as estimated
+  // by SplitKeyRange(). Returns NotFound if there's no such key, e.g. if the
+  // tablet has no on-disk data.
+  Status FindSplitKey(std::string* split_key) const;
+
+  // Sets 'split_key' to the key at which to split this tablet, as computed by
+  // FindSplitKey() after the latest flush or compaction, and returns true, if
+  // the tablet is larger than --tablet_split_size_threshold_mb. Otherwise
+  // returns false. Doesn't read any data.
+  bool GetProposedSplitKey(std::string* split_key) const;
+
 
   // Verbosely dump this entire tablet to the logs. This is only
   // really useful when debugging unit tests failures where the tablet
@@ -355,6 +484,9 @@ class Tablet {
   LockManager* lock_manager() { return &lock_manager_; }
 
   const TabletMetadata *metadata() const { return metadata_.get(); }
+
+  // Returns the cache of the projections resolved by the scans of this tablet.
+  ProjectionCache* projection_cache() const { return &projection_cache_; }
   TabletMetadata *metadata() { return metadata_.get(); }
   scoped_refptr<TabletMetadata> shared_metadata() const { return metadata_; }
 
@@ -378,9 +510,22 @@ class Tablet {
   // Otherwise, returns false.
   bool GetTabletAncientHistoryMark(Timestamp* ancient_history_mark) const WARN_UNUSED_RESULT;
 
+  // If the tablet's schema has a time-to-live column and the tablet uses a
+  // HybridClock, sets 'cutoff_micros' to the lowest value of the
+  // time-to-live column of rows which haven't expired yet as of 'timestamp',
+  // and returns true. Otherwise, returns false.
+  bool GetTimeToLiveCutoff(Timestamp timestamp,
+                           int64_t* cutoff_micros) const WARN_UNUSED_RESULT;
+
   // Calculates history GC options based on properties of the Clock implementation.
   HistoryGcOpts GetHistoryGcOpts() const;
 
+  // Let the current MemRowSet collapse the mutations of its rows which every
+  // new scan sees as committed: those older than both the ancient history mark
+  // and the MVCC clean timestamp, as far as the snapshots of its open
+  // iterators allow. Does nothing unless history GC is enabled.
+  void UpdateMemRowSetCompactionWatermark();
+
   // Method used by tests to retrieve all rowsets of this table. This
   // will be removed once code for selecting the appropriate RowSet is
   // finished and delta files is finished is part of Tablet class.
@@ -402,6 +547,12 @@ class Tablet {
   // This method is thread-safe.
   void CancelMaintenanceOps();
 
+  // Marks the statistics of the maintenance ops associated with this tablet
+  // as stale, following a change to its rowsets or delta stores.
+  //
+  // This method is thread-safe.
+  void MarkMaintenanceOpsDirty() const;
+
   const std::string& tablet_id() const { return metadata_->tablet_id(); }
 
   // Return the metrics for this tablet.
@@ -548,9 +699,26 @@ class Tablet {
   Status PickRowSetsToCompact(RowSetsInCompaction *picked,
                               CompactFlags flags) const;
 
-  // Performs a merge compaction or a flush.
+  // Performs a merge compaction or a flush, placing the output rowsets in
+  // data directories of 'storage_class'.
   Status DoMergeCompactionOrFlush(const RowSetsInCompaction &input,
-                                  int64_t mrs_being_flushed);
+                                  int64_t mrs_being_flushed,
+                                  fs::DataDirStorageClass storage_class);
+
+  // Phase 1 of a merge compaction or flush: writes the rows of 'input' as of
+  // 'snap' into new DiskRowSets, returning their metadata in key order in
+  // 'new_drs_metas'.
+  //
+  // Compactions of enough data are split into key ranges which are written
+  // in parallel, each into its own DiskRowSets.
+  Status WriteCompactionOrFlushOutput(const RowSetsInCompaction& input,
+                                      int64_t mrs_being_flushed,
+                                      fs::DataDirStorageClass storage_class,
+                                      const MvccSnapshot& snap,
+                                      const HistoryGcOpts& history_gc_opts,
+                                      RowSetMetadataVector* new_drs_metas,
+                                      int64_t* written_count,
+                                      uint64_t* written_size);
 
   // Handle the case in which a compaction or flush yielded no output rows.
   // In this case, we just need to remove the rowsets in 'rowsets' from the
@@ -577,6 +745,18 @@ class Tablet {
   void AtomicSwapRowSetsUnlocked(const RowSetVector &to_remove,
                                  const RowSetVector &to_add);
 
+  // Samples a row operation on the row with primary key 'encoded_key', to
+  // track the hot keys of the tablet.
+  void SampleKeyAccess(const Slice& encoded_key) const;
+
+  // Halves the counts of the hot keys once for every half-life elapsed since
+  // they were last halved.
+  void DecayHotKeysUnlocked(MonoTime now) const;
+
+  // Recomputes the key returned by GetProposedSplitKey() if the size of the
+  // tablet changed enough since it was last computed.
+  void UpdateProposedSplitKey();
+
   void GetComponents(scoped_refptr<TabletComponents>* comps) const {
     shared_lock<rw_spinlock> l(component_lock_);
     *comps = components_;
@@ -595,9 +775,10 @@ class Tablet {
                        const std::shared_ptr<MemRowSet>& old_ms);
 
   // Convert the specified read client schema (without IDs) to a server schema (with IDs)
-  // This method is used by NewRowIterator().
+  // This method is used by NewRowIterator(). The mapped projections are cached
+  // in 'projection_cache_', and shared by the scans with the same projection.
   Status GetMappedReadProjection(const Schema& projection,
-                                 Schema *mapped_projection) const;
+                                 std::shared_ptr<const Schema>* mapped_projection) const;
 
   Status CheckRowInTablet(const ConstContiguousRow& row) const;
 
@@ -663,6 +844,24 @@ class Tablet {
 
   std::unique_ptr<Throttler> throttler_;
 
+  // The most frequent primary keys of a sample of the row operations, or
+  // null if hot keys aren't tracked. The counts are already scaled up by the
+  // sampling interval.
+  mutable simple_spinlock hot_keys_lock_;
+  std::unique_ptr<SpaceSaving> hot_keys_;
+  mutable MonoTime hot_keys_last_decay_;
+  mutable std::atomic<int64_t> hot_keys_num_ops_;
+
+  // The key at which to split the tablet, empty if none is proposed, and the
+  // on-disk size of the tablet when it was computed.
+  mutable simple_spinlock split_key_lock_;
+  std::string proposed_split_key_;
+  uint64_t split_key_tablet_size_;
+
+  // The net number of rows inserted less rows deleted by transactions which
+  // have been applied but not committed.
+  std::atomic<int64_t> uncommitted_live_rows_;
+
   int64_t next_mrs_id_;
 
   // A pointer to the server's clock.
@@ -671,6 +870,10 @@ class Tablet {
   MvccManager mvcc_;
   LockManager lock_manager_;
 
+  // The projections resolved by the scans of this tablet. Also used by the
+  // tablet server to resolve the projections of the scan requests.
+  mutable ProjectionCache projection_cache_;
+
   gscoped_ptr<CompactionPolicy> compaction_policy_;
 
   // Lock protecting the selection of rowsets for compaction.
@@ -745,7 +948,7 @@ class Tablet::Iterator : public RowwiseIterator {
   std::string ToString() const OVERRIDE;
 
   const Schema &schema() const OVERRIDE {
-    return projection_;
+    return mapped_projection_ ? *mapped_projection_ : projection_;
   }
 
   virtual void GetIteratorStats(std::vector<IteratorStats>* stats) const OVERRIDE;
@@ -756,13 +959,28 @@ class Tablet::Iterator : public RowwiseIterator {
   DISALLOW_COPY_AND_ASSIGN(Iterator);
 
   Iterator(const Tablet* tablet, const Schema& projection, MvccSnapshot snap,
-           const OrderMode order);
+           const OrderMode order, ThreadPool* scan_pool);
+
+  // If the tablet has a time-to-live column and it's part of the projection,
+  // adds a predicate to 'spec' which filters out the rows which had expired
+  // as of the snapshot. If '*spec' is null, it's replaced with a spec owned
+  // by this iterator.
+  void AddTimeToLivePredicate(ScanSpec** spec);
 
   const Tablet *tablet_;
-  Schema projection_;
+  // The client projection, and once initialized, the projection mapped onto
+  // the tablet schema, which may be shared with other iterators.
+  const Schema projection_;
+  std::shared_ptr<const Schema> mapped_projection_;
   const MvccSnapshot snap_;
   const OrderMode order_;
+  ThreadPool* const scan_pool_;
   gscoped_ptr<RowwiseIterator> iter_;
+
+  // The bound of the time-to-live predicate, and the spec holding it if the
+  // caller didn't pass one. See AddTimeToLivePredicate().
+  int64_t ttl_cutoff_micros_;
+  std::unique_ptr<ScanSpec> ttl_spec_;
 };
 
 // Structure which represents the components of the tablet's storage.
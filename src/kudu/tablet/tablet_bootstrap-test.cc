@@ -28,6 +28,7 @@
 #include <vector>
 
 #include <boost/optional/optional.hpp>
+#include <gflags/gflags_declare.h>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 
@@ -78,6 +79,9 @@
 #include "kudu/util/status.h"
 #include "kudu/util/test_macros.h"
 
+DECLARE_bool(tablet_bootstrap_skip_flushed_segments);
+DECLARE_int32(tablet_bootstrap_read_ahead_mb);
+
 using std::shared_ptr;
 using std::string;
 using std::unique_ptr;
@@ -266,6 +270,59 @@ TEST_F(BootstrapTest, TestBootstrapHighOpIdIndex) {
   ASSERT_OPID_EQ(last_opid, boot_info.last_committed_id);
 }
 
+// Test bootstrapping from several segments, with the log entries read by the
+// replaying thread rather than ahead of their replay.
+TEST_F(BootstrapTest, TestBootstrapWithoutReadAhead) {
+  FLAGS_tablet_bootstrap_read_ahead_mb = 0;
+  const int kNumSegments = 3;
+  const int kEntriesPerSegment = 10;
+  ASSERT_OK(BuildLog());
+  for (int i = 0; i < kNumSegments; i++) {
+    AppendReplicateBatchAndCommitEntryPairsToLog(kEntriesPerSegment);
+    ASSERT_OK(RollLog());
+  }
+
+  shared_ptr<Tablet> tablet;
+  ConsensusBootstrapInfo boot_info;
+  ASSERT_OK(BootstrapTestTablet(-1, -1, &tablet, &boot_info));
+  ASSERT_OPID_EQ(MakeOpId(1, current_index_ - 1), boot_info.last_id);
+
+  vector<string> results;
+  IterateTabletRows(tablet.get(), &results);
+  ASSERT_EQ(kNumSegments * kEntriesPerSegment, results.size());
+}
+
+// Test that the log segments holding only ops which the metadata records as
+// durably applied are skipped.
+TEST_F(BootstrapTest, TestSkipFlushedSegments) {
+  FLAGS_tablet_bootstrap_skip_flushed_segments = true;
+  ASSERT_OK(BuildLog());
+  AppendReplicateBatchAndCommitEntryPairsToLog(10);
+  ASSERT_OK(RollLog());
+  AppendReplicateBatchAndCommitEntryPairsToLog(10);
+  ASSERT_OK(RollLog());
+  const int64_t first_unflushed_index = current_index_;
+  AppendReplicateBatchAndCommitEntryPairsToLog(5);
+
+  scoped_refptr<TabletMetadata> meta;
+  ASSERT_OK(LoadTestTabletMetadata(-1, -1, &meta));
+  meta->UpdateMinUnflushedLogIndex(first_unflushed_index);
+  ASSERT_OK(meta->Flush());
+  ASSERT_OK(CreateConsensusMetadata(meta));
+
+  shared_ptr<Tablet> tablet;
+  ConsensusBootstrapInfo boot_info;
+  ASSERT_OK(RunBootstrapOnTestTablet(meta, &tablet, &boot_info));
+  ASSERT_OPID_EQ(MakeOpId(1, current_index_ - 1), boot_info.last_id);
+  ASSERT_OPID_EQ(MakeOpId(1, current_index_ - 1), boot_info.last_committed_id);
+
+  // Only the ops of the last segment were replayed. In a real tablet, those
+  // of the skipped segments would be in its flushed stores.
+  vector<string> results;
+  IterateTabletRows(tablet.get(), &results);
+  ASSERT_EQ(5, results.size());
+}
+
 // Tests attempting a local bootstrap of a tablet that was in the middle of a
 // tablet copy before "crashing".
 TEST_F(BootstrapTest, TestIncompleteTabletCopy) {
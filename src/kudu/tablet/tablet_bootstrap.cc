@@ -17,6 +17,7 @@
 
 #include "kudu/tablet/tablet_bootstrap.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <iterator>
 #include <map>
@@ -48,6 +49,7 @@
 #include "kudu/consensus/metadata.pb.h"
 #include "kudu/consensus/opid.pb.h"
 #include "kudu/consensus/opid_util.h"
+#include "kudu/consensus/quorum_util.h"
 #include "kudu/consensus/raft_consensus.h"
 #include "kudu/fs/fs_manager.h"
 #include "kudu/gutil/bind.h"
@@ -76,6 +78,7 @@
 #include "kudu/tablet/transactions/write_transaction.h"
 #include "kudu/tserver/tserver.pb.h"
 #include "kudu/tserver/tserver_admin.pb.h"
+#include "kudu/util/blocking_queue.h"
 #include "kudu/util/debug/trace_event.h"
 #include "kudu/util/env.h"
 #include "kudu/util/env_util.h"
@@ -87,6 +90,7 @@
 #include "kudu/util/path_util.h"
 #include "kudu/util/pb_util.h"
 #include "kudu/util/stopwatch.h"
+#include "kudu/util/thread.h"
 
 
 DECLARE_int32(group_commit_queue_size_bytes);
@@ -101,6 +105,21 @@ DEFINE_double(fault_crash_during_log_replay, 0.0,
               "(For testing only!)");
 TAG_FLAG(fault_crash_during_log_replay, unsafe);
 
+DEFINE_int32(tablet_bootstrap_read_ahead_mb, 64,
+             "Maximum amount of log entries read ahead of their replay during tablet "
+             "bootstrap, by a thread of their own. Reading, decompressing and "
+             "verifying the entries then overlaps with replaying them. If 0, the "
+             "entries are read by the replaying thread.");
+TAG_FLAG(tablet_bootstrap_read_ahead_mb, advanced);
+TAG_FLAG(tablet_bootstrap_read_ahead_mb, experimental);
+
+DEFINE_bool(tablet_bootstrap_skip_flushed_segments, false,
+            "Whether tablet bootstrap skips the log segments holding only ops which "
+            "were already durably applied to the tablet's data. Those segments are "
+            "then dropped from the log along with the rest of the old log, so "
+            "followers that lag behind them will need to be copied.");
+TAG_FLAG(tablet_bootstrap_skip_flushed_segments, experimental);
+
 DECLARE_int32(max_clock_sync_error_usec);
 
 namespace kudu {
@@ -111,6 +130,7 @@ using consensus::ALTER_SCHEMA_OP;
 using consensus::CHANGE_CONFIG_OP;
 using consensus::CommitMsg;
 using consensus::ConsensusBootstrapInfo;
+using consensus::IsRaftConfigWitness;
 using consensus::MinimumOpId;
 using consensus::NO_OP;
 using consensus::OpId;
@@ -261,6 +281,11 @@ class TabletBootstrap {
   // later on when then tablet is rebuilt and starts accepting writes from clients.
   Status PlaySegments(ConsensusBootstrapInfo* results);
 
+  // Removes from the front of 'segments' those holding only ops which the
+  // tablet metadata records as durably applied, and sets the last op of the
+  // removed segments as the last replayed and committed op of 'state'.
+  Status SkipFlushedSegments(log::SegmentSequence* segments, ReplayState* state);
+
   // Append the given commit message to the log.
   // Does not support writing a TxResult.
   Status AppendCommitMsg(const CommitMsg& commit_msg);
@@ -368,6 +393,8 @@ class TabletBootstrap {
 
   const scoped_refptr<TabletMetadata> tablet_meta_;
   const RaftConfigPB committed_raft_config_;
+  // Whether the local replica is a witness, which never applies the writes.
+  const bool is_witness_;
   const scoped_refptr<Clock> clock_;
   shared_ptr<MemTracker> mem_tracker_;
   scoped_refptr<rpc::ResultTracker> result_tracker_;
@@ -485,6 +512,8 @@ TabletBootstrap::TabletBootstrap(
     const scoped_refptr<LogAnchorRegistry>& log_anchor_registry)
     : tablet_meta_(tablet_meta),
       committed_raft_config_(std::move(committed_raft_config)),
+      is_witness_(IsRaftConfigWitness(tablet_meta->fs_manager()->uuid(),
+                                      committed_raft_config_)),
       clock_(clock),
       mem_tracker_(std::move(mem_tracker)),
       result_tracker_(result_tracker),
@@ -1121,10 +1150,185 @@ void TabletBootstrap::DumpReplayStateToLog(const ReplayState& state) {
   }
 }
 
+namespace {
+
+// Reads the entries of a sequence of log segments, one segment after the
+// other. If 'max_buffered_bytes' is positive, the entries are read ahead of
+// the calls to ReadNextEntry() by a thread of their own, up to that many
+// bytes of them.
+class LogEntryReadAhead {
+ public:
+  LogEntryReadAhead(log::SegmentSequence segments, int64_t max_buffered_bytes)
+      : segments_(std::move(segments)),
+        max_buffered_bytes_(max_buffered_bytes),
+        next_segment_idx_(0),
+        queue_(max_buffered_bytes),
+        offset_(0),
+        read_up_to_offset_(0) {
+  }
+
+  ~LogEntryReadAhead() {
+    queue_.Shutdown();
+    if (thread_) {
+      CHECK_OK(ThreadJoiner(thread_.get()).Join());
+    }
+    Item* item;
+    while (queue_.BlockingGet(&item)) {
+      delete item;
+    }
+  }
+
+  Status Start() {
+    if (max_buffered_bytes_ <= 0 || segments_.empty()) {
+      return Status::OK();
+    }
+    return Thread::Create("tablet", "bootstrap-read-ahead",
+                          [this]() { this->ReadAheadThread(); }, &thread_);
+  }
+
+  // Reads the next entry of the current segment into 'entry'. Returns
+  // EndOfFile at the end of the segment, after which the entries of the next
+  // segment are returned.
+  Status ReadNextEntry(unique_ptr<LogEntryPB>* entry) {
+    unique_ptr<Item> item;
+    if (thread_) {
+      Item* next;
+      CHECK(queue_.BlockingGet(&next));
+      item.reset(next);
+    } else {
+      item.reset(new Item);
+      ReadNextItem(item.get());
+    }
+    offset_ = item->offset;
+    read_up_to_offset_ = item->read_up_to_offset;
+    RETURN_NOT_OK(item->status);
+    *entry = std::move(item->entry);
+    return Status::OK();
+  }
+
+  // The offsets of the reader of the current segment, as of the entry last
+  // returned. See log::LogEntryReader.
+  int64_t offset() const { return offset_; }
+  int64_t read_up_to_offset() const { return read_up_to_offset_; }
+
+ private:
+  // An entry read, or the error hit reading it.
+  struct Item {
+    unique_ptr<LogEntryPB> entry;
+    Status status;
+    int64_t offset;
+    int64_t read_up_to_offset;
+    size_t size;
+  };
+
+  struct ItemSize {
+    static size_t logical_size(const Item* item) {
+      return item->size;
+    }
+  };
+
+  void ReadAheadThread() {
+    while (next_segment_idx_ < segments_.size() || reader_) {
+      unique_ptr<Item> item(new Item);
+      ReadNextItem(item.get());
+      // Errors other than the end of a segment stop the replay.
+      bool stop = !item->status.ok() && !item->status.IsEndOfFile();
+      if (!queue_.BlockingPut(item.get())) {
+        return;
+      }
+      ignore_result(item.release());
+      if (stop) {
+        return;
+      }
+    }
+  }
+
+  void ReadNextItem(Item* item) {
+    if (!reader_) {
+      DCHECK_LT(next_segment_idx_, segments_.size());
+      reader_.reset(new log::LogEntryReader(segments_[next_segment_idx_++].get()));
+    }
+    item->entry.reset(new LogEntryPB);
+    item->status = reader_->ReadNextEntry(item->entry.get());
+    item->offset = reader_->offset();
+    item->read_up_to_offset = reader_->read_up_to_offset();
+    item->size = 0;
+    if (item->status.ok()) {
+      item->size = item->entry->ByteSize();
+    } else {
+      item->entry.reset();
+      if (item->status.IsEndOfFile()) {
+        reader_.reset();
+      }
+    }
+  }
+
+  const log::SegmentSequence segments_;
+  const int64_t max_buffered_bytes_;
+
+  // The reader of the segment being read, and the index of the next one.
+  // Only accessed by the read-ahead thread, if any.
+  size_t next_segment_idx_;
+  unique_ptr<log::LogEntryReader> reader_;
+
+  BlockingQueue<Item*, ItemSize> queue_;
+  scoped_refptr<Thread> thread_;
+
+  int64_t offset_;
+  int64_t read_up_to_offset_;
+
+  DISALLOW_COPY_AND_ASSIGN(LogEntryReadAhead);
+};
+
+} // anonymous namespace
+
+Status TabletBootstrap::SkipFlushedSegments(log::SegmentSequence* segments,
+                                            ReplayState* state) {
+  const int64_t min_unflushed_index = tablet_meta_->min_unflushed_log_index();
+  if (min_unflushed_index <= 0) {
+    return Status::OK();
+  }
+
+  // The last segment is always replayed, as it may not have a footer yet, and
+  // so that the new log isn't started empty.
+  size_t num_skipped = 0;
+  int64_t last_skipped_index = -1;
+  while (num_skipped + 1 < segments->size()) {
+    const scoped_refptr<ReadableLogSegment>& segment = (*segments)[num_skipped];
+    if (!segment->HasFooter() ||
+        segment->footer().max_replicate_index() >= min_unflushed_index) {
+      break;
+    }
+    last_skipped_index = std::max(last_skipped_index, segment->footer().max_replicate_index());
+    num_skipped++;
+  }
+  if (num_skipped == 0) {
+    return Status::OK();
+  }
+
+  // The ops of the skipped segments were all committed, or they couldn't
+  // have been applied.
+  if (last_skipped_index > 0) {
+    OpId last_skipped_id;
+    RETURN_NOT_OK_PREPEND(log_reader_->LookupOpId(last_skipped_index, &last_skipped_id),
+                          "Could not look up the last op of the skipped log segments");
+    state->prev_op_id = last_skipped_id;
+    state->committed_op_id = last_skipped_id;
+  }
+  LOG_WITH_PREFIX(INFO) << Substitute("Skipping $0 log segments holding only ops "
+                                      "durably applied to the tablet (through index $1)",
+                                      num_skipped, last_skipped_index);
+  segments->erase(segments->begin(), segments->begin() + num_skipped);
+  return Status::OK();
+}
+
 Status TabletBootstrap::PlaySegments(ConsensusBootstrapInfo* consensus_info) {
   ReplayState state;
   log::SegmentSequence segments;
   RETURN_NOT_OK(log_reader_->GetSegmentsSnapshot(&segments));
+  if (FLAGS_tablet_bootstrap_skip_flushed_segments) {
+    RETURN_NOT_OK(SkipFlushedSegments(&segments, &state));
+  }
 
   // The first thing to do is to rewind the tablet's schema back to the schema
   // as of the point in time where the logs begin. We must replay the writes
@@ -1149,14 +1353,16 @@ Status TabletBootstrap::PlaySegments(ConsensusBootstrapInfo* consensus_info) {
   const auto kStatusUpdateInterval = MonoDelta::FromSeconds(5);
   int segment_count = 0;
 
-  for (const scoped_refptr<ReadableLogSegment>& segment : segments) {
-    log::LogEntryReader reader(segment.get());
+  LogEntryReadAhead reader(segments,
+                           static_cast<int64_t>(FLAGS_tablet_bootstrap_read_ahead_mb) * 1024 * 1024);
+  RETURN_NOT_OK_PREPEND(reader.Start(), "Failed to start reading the log ahead of replay");
 
+  for (const scoped_refptr<ReadableLogSegment>& segment : segments) {
     int entry_count = 0;
     while (true) {
-      unique_ptr<LogEntryPB> entry(new LogEntryPB);
+      unique_ptr<LogEntryPB> entry;
 
-      Status s = reader.ReadNextEntry(entry.get());
+      Status s = reader.ReadNextEntry(&entry);
       if (PREDICT_FALSE(!s.ok())) {
         if (s.IsEndOfFile()) {
           break;
@@ -1187,7 +1393,7 @@ Status TabletBootstrap::PlaySegments(ConsensusBootstrapInfo* consensus_info) {
       if (now - last_status_update > kStatusUpdateInterval) {
         SetStatusMessage(Substitute("Bootstrap replaying log segment $0/$1 "
                                     "($2/$3 this segment, stats: $4)",
-                                    segment_count + 1, log_reader_->num_segments(),
+                                    segment_count + 1, segments.size(),
                                     HumanReadableNumBytes::ToString(reader.offset()),
                                     HumanReadableNumBytes::ToString(reader.read_up_to_offset()),
                                     stats_.ToString()));
@@ -1197,7 +1403,7 @@ Status TabletBootstrap::PlaySegments(ConsensusBootstrapInfo* consensus_info) {
 
     SetStatusMessage(Substitute("Bootstrap replayed $0/$1 log segments. "
                                 "Stats: $2. Pending: $3 replicates",
-                                segment_count + 1, log_reader_->num_segments(),
+                                segment_count + 1, segments.size(),
                                 stats_.ToString(),
                                 state.pending_replicates.size()));
     segment_count++;
@@ -1384,7 +1590,7 @@ Status TabletBootstrap::PlayWriteRequest(ReplicateMsg* replicate_msg,
   }
 
   Status play_status;
-  if (!all_flushed && write->has_row_operations()) {
+  if (!all_flushed && !is_witness_ && write->has_row_operations()) {
     // Rather than RETURN_NOT_OK() here, we need to just save the status and do the
     // RETURN_NOT_OK() down below the Commit() call below. Even though it seems wrong
     // to commit the transaction when in fact it failed to apply, we would throw a CHECK
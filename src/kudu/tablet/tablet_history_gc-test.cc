@@ -34,10 +34,12 @@
 #include "kudu/clock/mock_ntp.h"
 #include "kudu/clock/time_service.h"
 #include "kudu/common/common.pb.h"
+#include "kudu/common/iterator.h"
 #include "kudu/common/partial_row.h"
 #include "kudu/common/schema.h"
 #include "kudu/common/timestamp.h"
 #include "kudu/gutil/casts.h"
+#include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/move.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/ref_counted.h"
@@ -50,6 +52,7 @@
 #include "kudu/tablet/rowset_metadata.h"
 #include "kudu/tablet/tablet-harness.h"
 #include "kudu/tablet/tablet-test-base.h"
+#include "kudu/tablet/tablet-test-util.h"
 #include "kudu/tablet/tablet.h"
 #include "kudu/tablet/tablet_metadata.h"
 #include "kudu/tablet/tablet_metrics.h"
@@ -602,13 +605,12 @@ TEST_F(TabletHistoryGcNoMaintMgrTest, TestUndoDeltaBlockGc) {
   const int expected_undo_blocks = (kNumMutationsPerRow + 1) * num_rowsets_;
   ASSERT_EQ(expected_undo_blocks, tablet()->CountUndoDeltasForTests());
 
-  // There will be uninitialized undos so we will estimate that there may be
-  // undos to GC.
+  // The timestamps of the undos are recorded in the rowset metadata, so the
+  // estimate is exact even though the undos may not be initialized.
   int64_t bytes;
   ASSERT_OK(tablet()->EstimateBytesInPotentiallyAncientUndoDeltas(&bytes));
-  ASSERT_GT(bytes, 0);
+  ASSERT_EQ(0, bytes);
 
-  // Now initialize the undos. Our estimates should be back to 0.
   int64_t bytes_in_ancient_undos = 0;
   const MonoDelta kNoTimeLimit = MonoDelta();
   ASSERT_OK(tablet()->InitAncientUndoDeltas(kNoTimeLimit, &bytes_in_ancient_undos));
@@ -643,5 +645,131 @@ TEST_F(TabletHistoryGcNoMaintMgrTest, TestUndoDeltaBlockGc) {
   ASSERT_EQ(1, tablet()->metrics()->undo_delta_block_gc_delete_duration->TotalCount());
 }
 
+class TabletTimeToLiveTest : public KuduTabletTest {
+ public:
+  TabletTimeToLiveTest()
+      : KuduTabletTest(CreateSchema(), TabletHarness::Options::HYBRID_CLOCK) {
+    FLAGS_time_source = "mock";
+  }
+
+  virtual void SetUp() OVERRIDE {
+    NO_FATALS(KuduTabletTest::SetUp());
+    SetMockTime(GetCurrentTimeMicros());
+  }
+
+ protected:
+  static const int64_t kTimeToLiveSec = 60;
+
+  static Schema CreateSchema() {
+    ColumnStorageAttributes ttl_attrs;
+    ttl_attrs.ttl_sec = kTimeToLiveSec;
+    return Schema({ ColumnSchema("key", INT64),
+                    ColumnSchema("ts", UNIXTIME_MICROS, false, nullptr, nullptr, ttl_attrs) },
+                  1);
+  }
+
+  void SetMockTime(int64_t micros) {
+    auto* hybrid_clock = down_cast<HybridClock*>(clock());
+    auto* ntp = down_cast<clock::MockNtp*>(hybrid_clock->time_service());
+    ntp->SetMockClockWallTimeForTests(micros);
+  }
+
+  int64_t NowMicros() {
+    return HybridClock::GetPhysicalValueMicros(clock()->Now());
+  }
+
+  void AddTimeToHybridClock(MonoDelta delta) {
+    SetMockTime(NowMicros() + delta.ToMicroseconds());
+  }
+
+  // Inserts the rows with keys [start_key, start_key + num_rows), whose
+  // time-to-live column holds 'ts_micros', and flushes them.
+  void InsertAndFlushRows(int64_t start_key, int64_t num_rows, int64_t ts_micros) {
+    LocalTabletWriter writer(tablet().get(), &client_schema_);
+    KuduPartialRow row(&client_schema_);
+    for (int64_t key = start_key; key < start_key + num_rows; key++) {
+      ASSERT_OK(row.SetInt64(0, key));
+      ASSERT_OK(row.SetUnixTimeMicros(1, ts_micros));
+      ASSERT_OK(writer.Insert(row));
+    }
+    ASSERT_OK(tablet()->Flush());
+  }
+
+  int64_t CountVisibleRows() {
+    gscoped_ptr<RowwiseIterator> iter;
+    CHECK_OK(tablet()->NewRowIterator(client_schema_, &iter));
+    CHECK_OK(iter->Init(nullptr));
+    int fetched;
+    CHECK_OK(SilentIterateToStringList(iter.get(), &fetched));
+    return fetched;
+  }
+
+  int64_t CountRowsOnDisk() {
+    uint64_t count;
+    CHECK_OK(tablet()->CountRows(&count));
+    return count;
+  }
+};
+
+// Test that expired rows aren't returned by scans, and are removed by
+// compactions once they expired before the ancient history mark.
+TEST_F(TabletTimeToLiveTest, TestExpiredRowsFilteredAndCompacted) {
+  FLAGS_tablet_history_max_age_sec = 1;
+  const int64_t now = NowMicros();
+  NO_FATALS(InsertAndFlushRows(0, 100, now - 2 * kTimeToLiveSec * 1000000));
+  NO_FATALS(InsertAndFlushRows(100, 100, now));
+  ASSERT_EQ(100, CountVisibleRows());
+  ASSERT_EQ(200, CountRowsOnDisk());
+
+  // The insertions of the expired rows are still within the history
+  // retention period, so they can't be removed yet.
+  ASSERT_OK(tablet()->Compact(Tablet::FORCE_COMPACT_ALL));
+  ASSERT_EQ(100, CountVisibleRows());
+  ASSERT_EQ(200, CountRowsOnDisk());
+
+  NO_FATALS(AddTimeToHybridClock(MonoDelta::FromSeconds(2)));
+  ASSERT_OK(tablet()->Compact(Tablet::FORCE_COMPACT_ALL));
+  ASSERT_EQ(100, CountVisibleRows());
+  ASSERT_EQ(100, CountRowsOnDisk());
+}
+
+// Test that a rowset whose rows all expired before the ancient history mark
+// is deleted without being compacted.
+TEST_F(TabletTimeToLiveTest, TestDeleteExpiredRowSets) {
+  FLAGS_tablet_history_max_age_sec = 1;
+  const int64_t now = NowMicros();
+  NO_FATALS(InsertAndFlushRows(0, 100, now - 2 * kTimeToLiveSec * 1000000));
+  NO_FATALS(InsertAndFlushRows(100, 100, now));
+  ASSERT_EQ(2, tablet()->num_rowsets());
+
+  // Unlike a compaction, this doesn't need to wait for the insertions to
+  // become ancient history: scans at any snapshot after the ancient history
+  // mark filter out all of the rowset's rows anyway.
+  int64_t bytes;
+  ASSERT_OK(tablet()->EstimateBytesInExpiredRowSets(&bytes));
+  ASSERT_GT(bytes, 0);
+
+  int64_t rowsets_deleted;
+  ASSERT_OK(tablet()->DeleteExpiredRowSets(&rowsets_deleted));
+  ASSERT_EQ(1, rowsets_deleted);
+  ASSERT_EQ(1, tablet()->num_rowsets());
+  ASSERT_EQ(100, CountVisibleRows());
+  ASSERT_EQ(100, CountRowsOnDisk());
+  ASSERT_EQ(1, tablet()->metrics()->expired_rowsets_deleted->value());
+
+  // Updating the time-to-live column revives a row, so its rowset isn't
+  // deleted even once its base data expired.
+  NO_FATALS(AddTimeToHybridClock(MonoDelta::FromSeconds(2 * kTimeToLiveSec)));
+  ASSERT_EQ(0, CountVisibleRows());
+  LocalTabletWriter writer(tablet().get(), &client_schema_);
+  KuduPartialRow row(&client_schema_);
+  ASSERT_OK(row.SetInt64(0, 100));
+  ASSERT_OK(row.SetUnixTimeMicros(1, NowMicros()));
+  ASSERT_OK(writer.Update(row));
+  ASSERT_OK(tablet()->DeleteExpiredRowSets(&rowsets_deleted));
+  ASSERT_EQ(0, rowsets_deleted);
+  ASSERT_EQ(1, CountVisibleRows());
+}
+
 } // namespace tablet
 } // namespace kudu
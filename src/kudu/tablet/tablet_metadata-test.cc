@@ -19,12 +19,17 @@
 #include <memory>
 #include <ostream>
 #include <string>
+#include <vector>
 
+#include <boost/optional/optional.hpp>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 
 #include "kudu/common/partial_row.h"
 #include "kudu/common/wire_protocol-test-util.h"
+#include "kudu/fs/block_id.h"
+#include "kudu/fs/block_manager.h"
+#include "kudu/fs/fs_manager.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/port.h"
 #include "kudu/tablet/local_tablet_writer.h"
@@ -37,6 +42,9 @@
 #include "kudu/util/status.h"
 #include "kudu/util/test_macros.h"
 
+using std::unique_ptr;
+using std::vector;
+
 namespace kudu {
 namespace tablet {
 
@@ -142,6 +150,50 @@ TEST_F(TestTabletMetadata, TestOnDiskSize) {
   ASSERT_GE(final_size, superblock_pb.ByteSize());
 }
 
+// Test that tombstoning a tablet keeps the blocks it copied from a replica
+// when asked to, for a later copy from that replica to reuse.
+TEST_F(TestTabletMetadata, TestKeepCopiedBlocks) {
+  gscoped_ptr<KuduPartialRow> row;
+  BuildPartialRow(0, 0, "foo", &row);
+  writer_->Insert(*row);
+  ASSERT_OK(harness_->tablet()->Flush());
+  harness_->tablet()->Shutdown();
+
+  // Pretend the blocks of the tablet were copied from another replica.
+  TabletMetadata* meta = harness_->tablet()->metadata();
+  vector<BlockId> block_ids = meta->CollectBlockIds();
+  ASSERT_FALSE(block_ids.empty());
+  TabletSuperBlockPB superblock_pb;
+  ASSERT_OK(meta->ToSuperBlock(&superblock_pb));
+  superblock_pb.set_copy_source_uuid("source");
+  for (int i = 0; i < block_ids.size(); i++) {
+    CopiedBlockPB* copied_pb = superblock_pb.add_copied_blocks();
+    block_ids[i].CopyToPB(copied_pb->mutable_local_block_id());
+    BlockId(1000 + i).CopyToPB(copied_pb->mutable_source_block_id());
+  }
+  ASSERT_OK(meta->ReplaceSuperBlock(superblock_pb));
+  ASSERT_EQ(block_ids.size(), meta->copied_blocks().size());
+
+  // The blocks are kept for a copy from the same replica.
+  ASSERT_OK(meta->DeleteTabletData(TABLET_DATA_TOMBSTONED, boost::none, "source"));
+  ASSERT_TRUE(meta->rowsets().empty());
+  ASSERT_EQ(block_ids.size(), meta->copied_blocks().size());
+  ASSERT_FALSE(meta->IsTombstonedWithNoBlocks());
+  for (const BlockId& block_id : block_ids) {
+    unique_ptr<fs::ReadableBlock> block;
+    ASSERT_OK(meta->fs_manager()->OpenBlock(block_id, &block));
+  }
+
+  // Otherwise, they're deleted.
+  ASSERT_OK(meta->DeleteTabletData(TABLET_DATA_TOMBSTONED, boost::none, "other"));
+  ASSERT_TRUE(meta->copied_blocks().empty());
+  ASSERT_TRUE(meta->IsTombstonedWithNoBlocks());
+  for (const BlockId& block_id : block_ids) {
+    unique_ptr<fs::ReadableBlock> block;
+    Status s = meta->fs_manager()->OpenBlock(block_id, &block);
+    ASSERT_TRUE(s.IsNotFound()) << s.ToString();
+  }
+}
 
 } // namespace tablet
 } // namespace kudu
@@ -173,6 +173,12 @@ vector<BlockIdPB> TabletMetadata::CollectBlockIdPBs(const TabletSuperBlockPB& su
     if (rowset.has_adhoc_index_block()) {
       block_ids.push_back(rowset.adhoc_index_block());
     }
+    for (const ColumnDataPB& index : rowset.secondary_indexes()) {
+      block_ids.push_back(index.block());
+    }
+    for (const ColumnDataPB& bloom : rowset.column_bloom_filters()) {
+      block_ids.push_back(bloom.block());
+    }
   }
   return block_ids;
 }
@@ -185,11 +191,29 @@ vector<BlockId> TabletMetadata::CollectBlockIds() {
                      rowset_block_ids.begin(),
                      rowset_block_ids.end());
   }
+  // The copied blocks kept by a tombstoned tablet are live too.
+  if (!copied_blocks_.empty()) {
+    BlockIdSet rowset_block_ids(block_ids.begin(), block_ids.end());
+    for (const auto& e : copied_blocks_) {
+      if (!ContainsKey(rowset_block_ids, e.first)) {
+        block_ids.push_back(e.first);
+      }
+    }
+  }
   return block_ids;
 }
 
+vector<string> TabletMetadata::DataDirUuids() const {
+  DataDirGroupPB group;
+  if (!fs_manager_->dd_manager()->GetDataDirGroupPB(tablet_id_, &group)) {
+    return {};
+  }
+  return vector<string>(group.uuids().begin(), group.uuids().end());
+}
+
 Status TabletMetadata::DeleteTabletData(TabletDataState delete_type,
-                                        const boost::optional<OpId>& last_logged_opid) {
+                                        const boost::optional<OpId>& last_logged_opid,
+                                        const string& keep_blocks_copied_from) {
   DCHECK(!last_logged_opid || last_logged_opid->IsInitialized());
   CHECK(delete_type == TABLET_DATA_DELETED ||
         delete_type == TABLET_DATA_TOMBSTONED ||
@@ -205,8 +229,26 @@ Status TabletMetadata::DeleteTabletData(TabletDataState delete_type,
   // we have been deleted.
   {
     std::lock_guard<LockType> l(data_lock_);
+    const bool keep_copied_blocks = !keep_blocks_copied_from.empty() &&
+                                    keep_blocks_copied_from == copy_source_uuid_;
     for (const shared_ptr<RowSetMetadata>& rsmd : rowsets_) {
-      AddOrphanedBlocksUnlocked(rsmd->GetAllBlocks());
+      vector<BlockId> blocks = rsmd->GetAllBlocks();
+      if (keep_copied_blocks) {
+        blocks.erase(std::remove_if(blocks.begin(), blocks.end(),
+                                    [&](const BlockId& b) {
+                                      return ContainsKey(copied_blocks_, b);
+                                    }),
+                     blocks.end());
+      }
+      AddOrphanedBlocksUnlocked(blocks);
+    }
+    if (!keep_copied_blocks) {
+      vector<BlockId> copied_blocks;
+      for (const auto& e : copied_blocks_) {
+        copied_blocks.push_back(e.first);
+      }
+      AddOrphanedBlocksUnlocked(copied_blocks);
+      copy_source_uuid_.clear();
     }
     rowsets_.clear();
     tablet_data_state_ = delete_type;
@@ -243,7 +285,8 @@ bool TabletMetadata::IsTombstonedWithNoBlocks() const {
   std::lock_guard<LockType> l(data_lock_);
   return tablet_data_state_ == TABLET_DATA_TOMBSTONED &&
       rowsets_.empty() &&
-      orphaned_blocks_.empty();
+      orphaned_blocks_.empty() &&
+      copied_blocks_.empty();
 }
 
 Status TabletMetadata::DeleteSuperBlock() {
@@ -287,6 +330,7 @@ TabletMetadata::TabletMetadata(FsManager* fs_manager, string tablet_id,
       table_name_(std::move(table_name)),
       partition_schema_(std::move(partition_schema)),
       tablet_data_state_(tablet_data_state),
+      min_unflushed_log_index_(0),
       tombstone_last_logged_opid_(std::move(tombstone_last_logged_opid)),
       num_flush_pins_(0),
       needs_flush_(false),
@@ -391,6 +435,7 @@ Status TabletMetadata::LoadFromSuperBlock(const TabletSuperBlockPB& superblock)
     }
 
     tablet_data_state_ = superblock.tablet_data_state();
+    min_unflushed_log_index_ = superblock.min_unflushed_log_index();
 
     rowsets_.clear();
     for (const RowSetDataPB& rowset_pb : superblock.rowsets()) {
@@ -400,6 +445,13 @@ Status TabletMetadata::LoadFromSuperBlock(const TabletSuperBlockPB& superblock)
       rowsets_.push_back(shared_ptr<RowSetMetadata>(rowset_meta.release()));
     }
 
+    copy_source_uuid_ = superblock.copy_source_uuid();
+    copied_blocks_.clear();
+    for (const CopiedBlockPB& copied_pb : superblock.copied_blocks()) {
+      copied_blocks_.emplace(BlockId::FromPB(copied_pb.local_block_id()),
+                             BlockId::FromPB(copied_pb.source_block_id()));
+    }
+
     // Determine the largest block ID known to the tablet metadata so we can
     // notify the block manager of blocks it may have missed (e.g. if a data
     // directory failed and the blocks on it were not read).
@@ -472,6 +524,11 @@ void TabletMetadata::AddOrphanedBlocks(const vector<BlockId>& blocks) {
 
 void TabletMetadata::AddOrphanedBlocksUnlocked(const vector<BlockId>& blocks) {
   DCHECK(data_lock_.is_locked());
+  if (!copied_blocks_.empty()) {
+    for (const BlockId& b : blocks) {
+      copied_blocks_.erase(b);
+    }
+  }
   orphaned_blocks_.insert(blocks.begin(), blocks.end());
 }
 
@@ -622,6 +679,16 @@ boost::optional<consensus::OpId> TabletMetadata::tombstone_last_logged_opid() co
   return tombstone_last_logged_opid_;
 }
 
+string TabletMetadata::copy_source_uuid() const {
+  std::lock_guard<LockType> l(data_lock_);
+  return copy_source_uuid_;
+}
+
+TabletMetadata::CopiedBlockMap TabletMetadata::copied_blocks() const {
+  std::lock_guard<LockType> l(data_lock_);
+  return copied_blocks_;
+}
+
 Status TabletMetadata::ReadSuperBlockFromDisk(TabletSuperBlockPB* superblock) const {
   string path = fs_manager_->GetTabletMetadataPath(tablet_id_);
   RETURN_NOT_OK_PREPEND(
@@ -658,6 +725,9 @@ Status TabletMetadata::ToSuperBlockUnlocked(TabletSuperBlockPB* super_block,
                         "Couldn't serialize schema into superblock");
 
   pb.set_tablet_data_state(tablet_data_state_);
+  if (min_unflushed_log_index_ > 0) {
+    pb.set_min_unflushed_log_index(min_unflushed_log_index_);
+  }
   if (tombstone_last_logged_opid_ &&
       !OpIdEquals(MinimumOpId(), *tombstone_last_logged_opid_)) {
     *pb.mutable_tombstone_last_logged_opid() = *tombstone_last_logged_opid_;
@@ -667,6 +737,15 @@ Status TabletMetadata::ToSuperBlockUnlocked(TabletSuperBlockPB* super_block,
     block_id.CopyToPB(pb.mutable_orphaned_blocks()->Add());
   }
 
+  if (!copied_blocks_.empty()) {
+    pb.set_copy_source_uuid(copy_source_uuid_);
+    for (const auto& e : copied_blocks_) {
+      CopiedBlockPB* copied_pb = pb.add_copied_blocks();
+      e.first.CopyToPB(copied_pb->mutable_local_block_id());
+      e.second.CopyToPB(copied_pb->mutable_source_block_id());
+    }
+  }
+
   // Serialize the tablet's DataDirGroupPB if one exists. One may not exist if
   // this is called during a tablet deletion.
   DataDirGroupPB group_pb;
@@ -750,6 +829,16 @@ void TabletMetadata::set_tablet_data_state(TabletDataState state) {
   tablet_data_state_ = state;
 }
 
+int64_t TabletMetadata::min_unflushed_log_index() const {
+  std::lock_guard<LockType> l(data_lock_);
+  return min_unflushed_log_index_;
+}
+
+void TabletMetadata::UpdateMinUnflushedLogIndex(int64_t index) {
+  std::lock_guard<LockType> l(data_lock_);
+  min_unflushed_log_index_ = std::max(min_unflushed_log_index_, index);
+}
+
 string TabletMetadata::LogPrefix() const {
   return Substitute("T $0 P $1: ", tablet_id_, fs_manager_->uuid());
 }
@@ -21,6 +21,7 @@
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <unordered_set>
 #include <utility>
 #include <vector>
@@ -110,6 +111,10 @@ class TabletMetadata : public RefCountedThreadSafe<TabletMetadata> {
 
   std::vector<BlockId> CollectBlockIds();
 
+  // Returns the UUIDs of the data directories in the tablet's data dir group,
+  // or none if it has no group.
+  std::vector<std::string> DataDirUuids() const;
+
   const std::string& tablet_id() const {
     DCHECK_NE(state_, kNotLoadedYet);
     return tablet_id_;
@@ -197,9 +202,14 @@ class TabletMetadata : public RefCountedThreadSafe<TabletMetadata> {
   // last_logged_opid is not modified. This is important for roll-forward of
   // partially-tombstoned tablets during crash recovery.
   //
+  // If 'keep_blocks_copied_from' is the uuid of the server the copied blocks
+  // of the tablet were copied from, those blocks are kept, for a tablet copy
+  // from that server to reuse. See copied_blocks().
+  //
   // Returns only once all data has been removed.
   Status DeleteTabletData(TabletDataState delete_type,
-                          const boost::optional<consensus::OpId>& last_logged_opid);
+                          const boost::optional<consensus::OpId>& last_logged_opid,
+                          const std::string& keep_blocks_copied_from = "");
 
   // Return true if this metadata references no blocks (either live or orphaned) and is
   // already marked as tombstoned. If this is the case, then calling DeleteTabletData
@@ -226,11 +236,29 @@ class TabletMetadata : public RefCountedThreadSafe<TabletMetadata> {
 
   void SetLastDurableMrsIdForTests(int64_t mrs_id) { last_durable_mrs_id_ = mrs_id; }
 
+  // Returns the index of the first op which may not be durably applied to
+  // the tablet's data as of the last flush of the metadata, or 0 if unknown.
+  int64_t min_unflushed_log_index() const;
+
+  // Records that all the ops with a lower index than 'index' are durably
+  // applied to the tablet's data. Takes effect on the next Flush(). Calls
+  // with a lower index than a previous one are ignored.
+  void UpdateMinUnflushedLogIndex(int64_t index);
+
   void SetPreFlushCallback(StatusClosure callback) { pre_flush_callback_ = std::move(callback); }
 
   // Return the last-logged opid of a tombstoned tablet, if known.
   boost::optional<consensus::OpId> tombstone_last_logged_opid() const;
 
+  // Maps the blocks of the tablet copied from the blocks of another replica,
+  // and still in use, to the blocks of the other replica.
+  typedef std::unordered_map<BlockId, BlockId, BlockIdHash, BlockIdEqual> CopiedBlockMap;
+
+  // Returns the uuid of the server the copied blocks were copied from, and
+  // the copied blocks.
+  std::string copy_source_uuid() const;
+  CopiedBlockMap copied_blocks() const;
+
   // Loads the currently-flushed superblock from disk into the given protobuf.
   Status ReadSuperBlockFromDisk(TabletSuperBlockPB* superblock) const;
 
@@ -355,9 +383,17 @@ class TabletMetadata : public RefCountedThreadSafe<TabletMetadata> {
   // Protected by 'data_lock_'.
   BlockIdSet orphaned_blocks_;
 
+  // See copied_blocks(). A block is removed from the map once orphaned.
+  // Protected by 'data_lock_'.
+  std::string copy_source_uuid_;
+  CopiedBlockMap copied_blocks_;
+
   // The current state of tablet copy for the tablet.
   TabletDataState tablet_data_state_;
 
+  // See min_unflushed_log_index(). Protected by 'data_lock_'.
+  int64_t min_unflushed_log_index_;
+
   // Record of the last opid logged by the tablet before it was last
   // tombstoned. Has no meaning for non-tombstoned tablets.
   // Protected by 'data_lock_'.
@@ -104,6 +104,10 @@ METRIC_DEFINE_counter(tablet, scans_started, "Scans Started",
 METRIC_DEFINE_gauge_size(tablet, tablet_active_scanners, "Active Scanners",
                          kudu::MetricUnit::kScanners,
                          "Number of scanners that are currently active on this tablet");
+METRIC_DEFINE_counter(tablet, rows_looked_up, "Rows Looked Up",
+                      kudu::MetricUnit::kRows,
+                      "Number of primary keys looked up by point lookups on this tablet, "
+                      "found or not");
 
 METRIC_DEFINE_counter(tablet, bloom_lookups, "Bloom Filter Lookups",
                       kudu::MetricUnit::kProbes,
@@ -127,6 +131,12 @@ METRIC_DEFINE_counter(tablet, undo_delta_block_gc_bytes_deleted,
                       "Number of bytes deleted by garbage-collecting old UNDO delta blocks "
                       "on this tablet since this server was restarted. "
                       "Does not include bytes garbage collected during compactions.");
+METRIC_DEFINE_counter(tablet, expired_rowsets_deleted,
+                      "Expired RowSets Deleted",
+                      kudu::MetricUnit::kUnits,
+                      "Number of rowsets deleted on this tablet since this server was "
+                      "restarted because all of their rows had outlived the table's "
+                      "time-to-live. Does not include rows removed during compactions.");
 
 METRIC_DEFINE_histogram(tablet, bloom_lookups_per_op, "Bloom Lookups per Operation",
                         kudu::MetricUnit::kProbes,
@@ -204,6 +214,11 @@ METRIC_DEFINE_gauge_uint32(tablet, undo_delta_block_gc_running,
   kudu::MetricUnit::kMaintenanceOperations,
   "Number of UNDO delta block GC operations currently running.");
 
+METRIC_DEFINE_gauge_uint32(tablet, migrate_cold_rs_running,
+  "Cold RowSet Migrations Running",
+  kudu::MetricUnit::kMaintenanceOperations,
+  "Number of operations moving cold RowSets to slow data directories currently running.");
+
 METRIC_DEFINE_gauge_int64(tablet, undo_delta_block_estimated_retained_bytes,
   "Estimated Deletable Bytes Retained in Undo Delta Blocks",
   kudu::MetricUnit::kBytes,
@@ -250,11 +265,22 @@ METRIC_DEFINE_histogram(tablet, undo_delta_block_gc_perform_duration,
   kudu::MetricUnit::kMilliseconds,
   "Time spent running the maintenance operation to GC ancient UNDO delta blocks.", 60000LU, 1);
 
+METRIC_DEFINE_histogram(tablet, migrate_cold_rs_duration,
+  "Cold RowSet Migration Duration",
+  kudu::MetricUnit::kMilliseconds,
+  "Time spent moving cold RowSets to slow data directories.", 60000LU, 1);
+
 METRIC_DEFINE_counter(tablet, leader_memory_pressure_rejections,
   "Leader Memory Pressure Rejections",
   kudu::MetricUnit::kRequests,
   "Number of RPC requests rejected due to memory pressure while LEADER.");
 
+METRIC_DEFINE_counter(tablet, leader_memory_pressure_delays,
+  "Leader Memory Pressure Delays",
+  kudu::MetricUnit::kRequests,
+  "Number of write requests delayed because the tablet was past its soft "
+  "memory limit while LEADER.");
+
 using strings::Substitute;
 using std::unordered_map;
 
@@ -279,12 +305,14 @@ TabletMetrics::TabletMetrics(const scoped_refptr<MetricEntity>& entity)
     MINIT(scanner_bytes_scanned_from_disk),
     MINIT(scans_started),
     GINIT(tablet_active_scanners),
+    MINIT(rows_looked_up),
     MINIT(bloom_lookups),
     MINIT(key_file_lookups),
     MINIT(delta_file_lookups),
     MINIT(mrs_lookups),
     MINIT(bytes_flushed),
     MINIT(undo_delta_block_gc_bytes_deleted),
+    MINIT(expired_rowsets_deleted),
     MINIT(bloom_lookups_per_op),
     MINIT(key_file_lookups_per_op),
     MINIT(delta_file_lookups_per_op),
@@ -298,6 +326,7 @@ TabletMetrics::TabletMetrics(const scoped_refptr<MetricEntity>& entity)
     GINIT(delta_minor_compact_rs_running),
     GINIT(delta_major_compact_rs_running),
     GINIT(undo_delta_block_gc_running),
+    GINIT(migrate_cold_rs_running),
     GINIT(undo_delta_block_estimated_retained_bytes),
     MINIT(flush_dms_duration),
     MINIT(flush_mrs_duration),
@@ -307,7 +336,9 @@ TabletMetrics::TabletMetrics(const scoped_refptr<MetricEntity>& entity)
     MINIT(undo_delta_block_gc_init_duration),
     MINIT(undo_delta_block_gc_delete_duration),
     MINIT(undo_delta_block_gc_perform_duration),
-    MINIT(leader_memory_pressure_rejections) {
+    MINIT(migrate_cold_rs_duration),
+    MINIT(leader_memory_pressure_rejections),
+    MINIT(leader_memory_pressure_delays) {
 }
 #undef MINIT
 #undef GINIT
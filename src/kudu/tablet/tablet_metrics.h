@@ -60,6 +60,7 @@ struct TabletMetrics {
   scoped_refptr<Counter> scanner_bytes_scanned_from_disk;
   scoped_refptr<Counter> scans_started;
   scoped_refptr<AtomicGauge<size_t>> tablet_active_scanners;
+  scoped_refptr<Counter> rows_looked_up;
 
   // Probe stats
   scoped_refptr<Counter> bloom_lookups;
@@ -70,6 +71,7 @@ struct TabletMetrics {
   // Operation stats.
   scoped_refptr<Counter> bytes_flushed;
   scoped_refptr<Counter> undo_delta_block_gc_bytes_deleted;
+  scoped_refptr<Counter> expired_rowsets_deleted;
 
   scoped_refptr<Histogram> bloom_lookups_per_op;
   scoped_refptr<Histogram> key_file_lookups_per_op;
@@ -86,6 +88,7 @@ struct TabletMetrics {
   scoped_refptr<AtomicGauge<uint32_t> > delta_minor_compact_rs_running;
   scoped_refptr<AtomicGauge<uint32_t> > delta_major_compact_rs_running;
   scoped_refptr<AtomicGauge<uint32_t> > undo_delta_block_gc_running;
+  scoped_refptr<AtomicGauge<uint32_t> > migrate_cold_rs_running;
   scoped_refptr<AtomicGauge<int64_t> > undo_delta_block_estimated_retained_bytes;
 
   scoped_refptr<Histogram> flush_dms_duration;
@@ -96,8 +99,10 @@ struct TabletMetrics {
   scoped_refptr<Histogram> undo_delta_block_gc_init_duration;
   scoped_refptr<Histogram> undo_delta_block_gc_delete_duration;
   scoped_refptr<Histogram> undo_delta_block_gc_perform_duration;
+  scoped_refptr<Histogram> migrate_cold_rs_duration;
 
   scoped_refptr<Counter> leader_memory_pressure_rejections;
+  scoped_refptr<Counter> leader_memory_pressure_delays;
 };
 
 } // namespace tablet
@@ -17,15 +17,22 @@
 
 #include "kudu/tablet/tablet_mm_ops.h"
 
+#include <cmath>
 #include <mutex>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
+#include <vector>
 
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 
+#include "kudu/fs/io_scheduler.h"
+#include "kudu/gutil/map-util.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/tablet/rowset.h"
 #include "kudu/tablet/tablet.h"
+#include "kudu/tablet/tablet_metadata.h"
 #include "kudu/tablet/tablet_metrics.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/logging.h"
@@ -41,14 +48,33 @@ DEFINE_int32(undo_delta_block_gc_init_budget_millis, 1000,
 TAG_FLAG(undo_delta_block_gc_init_budget_millis, evolving);
 TAG_FLAG(undo_delta_block_gc_init_budget_millis, advanced);
 
+DEFINE_double(tablet_cold_rowset_max_accesses_per_sec, 0.1,
+              "Rowsets which served fewer accesses per second than this over the "
+              "last --tablet_cold_rowset_access_window_sec, and which hold no recent "
+              "writes, are moved to the data directories listed in --fs_slow_data_dirs. "
+              "See --tablet_cold_rowset_min_age_sec.");
+TAG_FLAG(tablet_cold_rowset_max_accesses_per_sec, experimental);
+TAG_FLAG(tablet_cold_rowset_max_accesses_per_sec, runtime);
+
+DEFINE_int32(tablet_cold_rowset_access_window_sec, 5 * 60,
+             "The number of seconds over which the access rate of rowsets is "
+             "measured to tell whether they are cold.");
+TAG_FLAG(tablet_cold_rowset_access_window_sec, experimental);
+TAG_FLAG(tablet_cold_rowset_access_window_sec, runtime);
+
+DECLARE_double(compaction_access_weight);
+
 using std::string;
+using std::unordered_map;
+using std::unordered_set;
+using std::vector;
 using strings::Substitute;
 
 namespace kudu {
 namespace tablet {
 
 TabletOpBase::TabletOpBase(string name, IOUsage io_usage, Tablet* tablet)
-    : MaintenanceOp(std::move(name), io_usage),
+    : MaintenanceOp(std::move(name), io_usage, MaintenanceOp::PUSHED_STATS),
       tablet_(tablet) {
 }
 
@@ -56,6 +82,10 @@ string TabletOpBase::LogPrefix() const {
   return tablet_->LogPrefix();
 }
 
+vector<string> TabletOpBase::DataDirUuids() const {
+  return tablet_->metadata()->DataDirUuids();
+}
+
 ////////////////////////////////////////////////////////////
 // CompactRowSetsOp
 ////////////////////////////////////////////////////////////
@@ -64,7 +94,9 @@ CompactRowSetsOp::CompactRowSetsOp(Tablet* tablet)
   : TabletOpBase(Substitute("CompactRowSetsOp($0)", tablet->tablet_id()),
                  MaintenanceOp::HIGH_IO_USAGE, tablet),
     last_num_mrs_flushed_(0),
-    last_num_rs_compacted_(0) {
+    last_num_rs_compacted_(0),
+    access_rate_(0),
+    last_access_count_(0) {
 }
 
 void CompactRowSetsOp::UpdateStats(MaintenanceOpStats* stats) {
@@ -72,6 +104,7 @@ void CompactRowSetsOp::UpdateStats(MaintenanceOpStats* stats) {
 
   // Any operation that changes the on-disk row layout invalidates the
   // cached stats.
+  bool cached = false;
   TabletMetrics* metrics = tablet_->metrics();
   if (metrics) {
     uint64_t new_num_mrs_flushed = metrics->flush_mrs_duration->TotalCount();
@@ -79,16 +112,52 @@ void CompactRowSetsOp::UpdateStats(MaintenanceOpStats* stats) {
     if (prev_stats_.valid() &&
         new_num_mrs_flushed == last_num_mrs_flushed_ &&
         new_num_rs_compacted == last_num_rs_compacted_) {
-      *stats = prev_stats_;
-      return;
+      cached = true;
     } else {
       last_num_mrs_flushed_ = new_num_mrs_flushed;
       last_num_rs_compacted_ = new_num_rs_compacted;
     }
   }
 
-  tablet_->UpdateCompactionStats(&prev_stats_);
+  if (!cached) {
+    tablet_->UpdateCompactionStats(&prev_stats_);
+  }
   *stats = prev_stats_;
+
+  // The access rate changes independently of the rowset layout, so the
+  // projected gain is rescaled on every update.
+  double boost = UpdateAccessRateBoost();
+  if (boost != 1) {
+    stats->set_perf_improvement(prev_stats_.perf_improvement() * boost);
+  }
+}
+
+double CompactRowSetsOp::UpdateAccessRateBoost() {
+  if (FLAGS_compaction_access_weight <= 0) {
+    return 1;
+  }
+  MonoTime now = MonoTime::Now();
+  uint64_t access_count = tablet_->CountRowSetAccesses();
+  if (last_access_count_time_.Initialized()) {
+    double elapsed_secs = (now - last_access_count_time_).ToSeconds();
+    if (elapsed_secs > 0) {
+      // Flushes and compactions replace rowsets with new ones whose counters
+      // start from zero, so the total may go backwards.
+      uint64_t accesses = access_count > last_access_count_ ?
+          access_count - last_access_count_ : 0;
+      double rate = accesses / elapsed_secs;
+      // Smooth the rate across updates, which happen every few hundred
+      // milliseconds, so that a brief burst or lull doesn't dominate.
+      static const double kSmoothing = 0.8;
+      access_rate_ = kSmoothing * access_rate_ + (1 - kSmoothing) * rate;
+    }
+  }
+  last_access_count_ = access_count;
+  last_access_count_time_ = now;
+
+  // An idle tablet keeps its unscaled gain; a tablet serving thousands of
+  // accesses per second gets several times more.
+  return 1 + FLAGS_compaction_access_weight * std::log10(1 + access_rate_);
 }
 
 bool CompactRowSetsOp::Prepare() {
@@ -105,6 +174,7 @@ bool CompactRowSetsOp::Prepare() {
 }
 
 void CompactRowSetsOp::Perform() {
+  fs::ScopedIOPriority io_priority(fs::IOPriority::COMPACTION);
   WARN_NOT_OK(tablet_->Compact(Tablet::COMPACT_NO_FLAGS),
               Substitute("$0Compaction failed on $1",
                          LogPrefix(), tablet_->tablet_id()));
@@ -176,6 +246,7 @@ bool MinorDeltaCompactionOp::Prepare() {
 }
 
 void MinorDeltaCompactionOp::Perform() {
+  fs::ScopedIOPriority io_priority(fs::IOPriority::COMPACTION);
   WARN_NOT_OK(tablet_->CompactWorstDeltas(RowSet::MINOR_DELTA_COMPACTION),
               Substitute("$0Minor delta compaction failed on $1",
                          LogPrefix(), tablet_->tablet_id()));
@@ -252,6 +323,7 @@ bool MajorDeltaCompactionOp::Prepare() {
 }
 
 void MajorDeltaCompactionOp::Perform() {
+  fs::ScopedIOPriority io_priority(fs::IOPriority::COMPACTION);
   WARN_NOT_OK(tablet_->CompactWorstDeltas(RowSet::MAJOR_DELTA_COMPACTION),
               Substitute("$0Major delta compaction failed on $1",
                          LogPrefix(), tablet_->tablet_id()));
@@ -278,6 +350,10 @@ void UndoDeltaBlockGCOp::UpdateStats(MaintenanceOpStats* stats) {
   int64_t max_estimated_retained_bytes = 0;
   WARN_NOT_OK(tablet_->EstimateBytesInPotentiallyAncientUndoDeltas(&max_estimated_retained_bytes),
               "Unable to count bytes in potentially ancient undo deltas");
+  int64_t expired_rowset_bytes = 0;
+  WARN_NOT_OK(tablet_->EstimateBytesInExpiredRowSets(&expired_rowset_bytes),
+              "Unable to count bytes in expired rowsets");
+  max_estimated_retained_bytes += expired_rowset_bytes;
   stats->set_data_retained_bytes(max_estimated_retained_bytes);
   stats->set_runnable(max_estimated_retained_bytes > 0);
 }
@@ -288,6 +364,11 @@ bool UndoDeltaBlockGCOp::Prepare() {
 }
 
 void UndoDeltaBlockGCOp::Perform() {
+  // Rowsets whose rows all expired are removed first, so that their undos
+  // aren't needlessly initialized below.
+  CHECK_OK_PREPEND(tablet_->DeleteExpiredRowSets(),
+                   Substitute("$0GC of expired rowsets failed", LogPrefix()));
+
   MonoDelta time_budget = MonoDelta::FromMilliseconds(FLAGS_undo_delta_block_gc_init_budget_millis);
   int64_t bytes_in_ancient_undos = 0;
   Status s = tablet_->InitAncientUndoDeltas(time_budget, &bytes_in_ancient_undos);
@@ -315,5 +396,100 @@ std::string UndoDeltaBlockGCOp::LogPrefix() const {
   return tablet_->LogPrefix();
 }
 
+////////////////////////////////////////////////////////////
+// MigrateColdRowSetsOp
+////////////////////////////////////////////////////////////
+
+MigrateColdRowSetsOp::MigrateColdRowSetsOp(Tablet* tablet)
+  : TabletOpBase(Substitute("MigrateColdRowSetsOp($0)", tablet->tablet_id()),
+                 MaintenanceOp::HIGH_IO_USAGE, tablet),
+    cold_rowset_id_(-1),
+    rowset_id_to_migrate_(-1) {
+}
+
+void MigrateColdRowSetsOp::UpdateStats(MaintenanceOpStats* stats) {
+  std::lock_guard<simple_spinlock> l(lock_);
+
+  // Looking for cold rowsets may read delta file stats, so it's only done
+  // once per access window.
+  MonoTime now = MonoTime::Now();
+  if (prev_stats_.valid() && last_sample_time_.Initialized() &&
+      now - last_sample_time_ <
+          MonoDelta::FromSeconds(FLAGS_tablet_cold_rowset_access_window_sec)) {
+    *stats = prev_stats_;
+    return;
+  }
+
+  unordered_map<int64_t, uint64_t> access_counts;
+  if (tablet_->HasSlowStorage()) {
+    tablet_->GetFastRowSetAccessCounts(&access_counts);
+  }
+
+  // Rowsets which appeared since the last sample haven't been observed for
+  // long enough to be considered.
+  unordered_set<int64_t> rarely_accessed_ids;
+  if (last_sample_time_.Initialized()) {
+    double elapsed_secs = (now - last_sample_time_).ToSeconds();
+    for (const auto& e : access_counts) {
+      const uint64_t* last_count = FindOrNull(last_access_counts_, e.first);
+      if (last_count != nullptr && e.second >= *last_count &&
+          (e.second - *last_count) / elapsed_secs <
+              FLAGS_tablet_cold_rowset_max_accesses_per_sec) {
+        rarely_accessed_ids.insert(e.first);
+      }
+    }
+  }
+  last_access_counts_.swap(access_counts);
+  last_sample_time_ = now;
+
+  uint64_t cold_rowset_size = 0;
+  Status s = tablet_->PickColdRowSet(rarely_accessed_ids, &cold_rowset_id_, &cold_rowset_size);
+  if (PREDICT_FALSE(!s.ok())) {
+    LOG_WITH_PREFIX(WARNING) << "Couldn't look for cold rowsets: " << s.ToString();
+    cold_rowset_id_ = -1;
+  }
+  VLOG_WITH_PREFIX(1) << "Coldest rowset on fast storage: " << cold_rowset_id_
+                      << " (" << cold_rowset_size << " bytes)";
+
+  // Moving data doesn't make anything faster, so the op reports just enough
+  // of an improvement to be run when idle.
+  prev_stats_.set_runnable(cold_rowset_id_ != -1);
+  prev_stats_.set_perf_improvement(cold_rowset_id_ != -1 ? 0.001 : 0);
+  *stats = prev_stats_;
+}
+
+bool MigrateColdRowSetsOp::Prepare() {
+  std::lock_guard<simple_spinlock> l(lock_);
+  if (cold_rowset_id_ == -1) {
+    return false;
+  }
+  // Claim the rowset so that it isn't picked again before the next sample.
+  rowset_id_to_migrate_ = cold_rowset_id_;
+  cold_rowset_id_ = -1;
+  prev_stats_.set_runnable(false);
+  prev_stats_.set_perf_improvement(0);
+  return true;
+}
+
+void MigrateColdRowSetsOp::Perform() {
+  int64_t rowset_id;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    rowset_id = rowset_id_to_migrate_;
+  }
+  fs::ScopedIOPriority io_priority(fs::IOPriority::COMPACTION);
+  WARN_NOT_OK(tablet_->MigrateRowSetToSlowStorage(rowset_id),
+              Substitute("$0Moving rowset $1 to slow storage failed on $2",
+                         LogPrefix(), rowset_id, tablet_->tablet_id()));
+}
+
+scoped_refptr<Histogram> MigrateColdRowSetsOp::DurationHistogram() const {
+  return tablet_->metrics()->migrate_cold_rs_duration;
+}
+
+scoped_refptr<AtomicGauge<uint32_t> > MigrateColdRowSetsOp::RunningGauge() const {
+  return tablet_->metrics()->migrate_cold_rs_running;
+}
+
 } // namespace tablet
 } // namespace kudu
@@ -20,12 +20,15 @@
 
 #include <cstdint>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/maintenance_manager.h"
+#include "kudu/util/monotime.h"
 
 namespace kudu {
 
@@ -37,11 +40,16 @@ namespace tablet {
 
 class Tablet;
 
+// Base class of the tablet's maintenance ops. Their statistics only change
+// as the tablet's rowsets and delta stores do, so the tablet marks them dirty
+// when it flushes or compacts instead of having them polled.
 class TabletOpBase : public MaintenanceOp {
  public:
   TabletOpBase(std::string name, IOUsage io_usage, Tablet* tablet);
   std::string LogPrefix() const;
 
+  virtual std::vector<std::string> DataDirUuids() const OVERRIDE;
+
  protected:
   Tablet* const tablet_;
 };
@@ -68,10 +76,20 @@ class CompactRowSetsOp : public TabletOpBase {
   virtual scoped_refptr<AtomicGauge<uint32_t> > RunningGauge() const OVERRIDE;
 
  private:
+  // Updates 'access_rate_' from the tablet's rowset access counters and
+  // returns the factor by which to scale the compaction's perf improvement.
+  double UpdateAccessRateBoost();
+
   mutable simple_spinlock lock_;
   MaintenanceOpStats prev_stats_;
   uint64_t last_num_mrs_flushed_;
   uint64_t last_num_rs_compacted_;
+
+  // Smoothed rate of rowset accesses per second, and the access count and
+  // time at which it was last updated.
+  double access_rate_;
+  uint64_t last_access_count_;
+  MonoTime last_access_count_time_;
 };
 
 // MaintenanceOp to run minor compaction on delta stores.
@@ -130,19 +148,20 @@ class MajorDeltaCompactionOp : public TabletOpBase {
 };
 
 // MaintenanceOp to garbage-collect undo delta blocks that are older than the
+// ancient history mark, as well as rowsets whose rows all expired before the
 // ancient history mark.
 class UndoDeltaBlockGCOp : public TabletOpBase {
  public:
   explicit UndoDeltaBlockGCOp(Tablet* tablet);
 
   // Estimates the number of bytes that may potentially be in ancient delta
-  // undo blocks. Over time, as Perform() is invoked, this estimate gets more
-  // accurate.
+  // undo blocks, plus the size of the expired rowsets. Over time, as
+  // Perform() is invoked, this estimate gets more accurate.
   void UpdateStats(MaintenanceOpStats* stats) override;
 
   bool Prepare() override;
 
-  // Deletes ancient history data from disk. This also initializes undo delta
+  // Deletes ancient history data and expired rowsets from disk. This also initializes undo delta
   // blocks greedily (in a budgeted manner controlled by the
   // --undo_delta_block_gc_init_budget_millis gflag) that makes the estimate
   // performed in UpdateStats() more accurate.
@@ -158,6 +177,47 @@ class UndoDeltaBlockGCOp : public TabletOpBase {
   DISALLOW_COPY_AND_ASSIGN(UndoDeltaBlockGCOp);
 };
 
+// MaintenanceOp to move cold rowsets to slow data directories.
+//
+// Every --tablet_cold_rowset_access_window_sec, this samples the access
+// counts of the rowsets placed in fast data directories. Rowsets which served
+// fewer than --tablet_cold_rowset_max_accesses_per_sec over the window, and
+// which hold no writes newer than --tablet_cold_rowset_min_age_sec, are cold.
+// The largest of them is rewritten into slow data directories. The op only
+// reports a token perf improvement, so that it runs when there's nothing
+// more useful to do.
+class MigrateColdRowSetsOp : public TabletOpBase {
+ public:
+  explicit MigrateColdRowSetsOp(Tablet* tablet);
+
+  void UpdateStats(MaintenanceOpStats* stats) override;
+
+  bool Prepare() override;
+
+  void Perform() override;
+
+  scoped_refptr<Histogram> DurationHistogram() const override;
+
+  scoped_refptr<AtomicGauge<uint32_t> > RunningGauge() const override;
+
+ private:
+  mutable simple_spinlock lock_;
+  MaintenanceOpStats prev_stats_;
+
+  // The cold rowset found by the last sample, or -1 if there's none.
+  int64_t cold_rowset_id_;
+
+  // The rowset to move in Perform(), as claimed by Prepare().
+  int64_t rowset_id_to_migrate_;
+
+  // The access counts of the rowsets in fast data directories, keyed by
+  // rowset ID, as of the time of the last sample.
+  std::unordered_map<int64_t, uint64_t> last_access_counts_;
+  MonoTime last_sample_time_;
+
+  DISALLOW_COPY_AND_ASSIGN(MigrateColdRowSetsOp);
+};
+
 
 } // namespace tablet
 } // namespace kudu
@@ -20,6 +20,7 @@
 #include <ostream>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include <boost/optional/optional.hpp>
 #include <gflags/gflags.h>
@@ -76,7 +77,10 @@
 
 METRIC_DECLARE_entity(tablet);
 
+DECLARE_int32(flush_lookahead_secs);
 DECLARE_int32(flush_threshold_mb);
+DECLARE_int64(log_target_replay_size_mb);
+DECLARE_int32(tablet_replicate_batch_max_ops);
 
 namespace kudu {
 namespace tablet {
@@ -97,6 +101,7 @@ using rpc::Messenger;
 using std::shared_ptr;
 using std::string;
 using std::unique_ptr;
+using std::vector;
 using tserver::WriteRequestPB;
 using tserver::WriteResponsePB;
 
@@ -569,6 +574,47 @@ TEST_F(TabletReplicaTest, TestGCEmptyLog) {
   ASSERT_OK(tablet_replica_->RunLogGC());
 }
 
+// Test that writes submitted concurrently, and thus replicated in batches,
+// are each assigned their own OpId and all succeed.
+TEST_F(TabletReplicaTest, TestBatchedReplication) {
+  FLAGS_tablet_replicate_batch_max_ops = 8;
+  const int kNumWrites = 100;
+
+  ConsensusBootstrapInfo info;
+  ASSERT_OK(StartReplicaAndWaitUntilLeader(info));
+  boost::optional<OpId> first_id = tablet_replica_->consensus()->GetLastOpId(RECEIVED_OPID);
+  ASSERT_TRUE(first_id);
+
+  vector<unique_ptr<WriteRequestPB>> reqs;
+  vector<unique_ptr<WriteResponsePB>> resps;
+  CountDownLatch rpc_latch(kNumWrites);
+  for (int i = 0; i < kNumWrites; i++) {
+    reqs.emplace_back(new WriteRequestPB());
+    ASSERT_OK(GenerateSequentialInsertRequest(reqs.back().get()));
+    resps.emplace_back(new WriteResponsePB());
+    unique_ptr<WriteTransactionState> tx_state(new WriteTransactionState(tablet_replica_.get(),
+                                                                         reqs.back().get(),
+                                                                         nullptr,
+                                                                         resps.back().get()));
+    tx_state->set_completion_callback(gscoped_ptr<TransactionCompletionCallback>(
+        new LatchTransactionCompletionCallback<WriteResponsePB>(&rpc_latch,
+                                                                resps.back().get())));
+    ASSERT_OK(tablet_replica_->SubmitWrite(std::move(tx_state)));
+  }
+  rpc_latch.Wait();
+
+  for (const auto& resp : resps) {
+    ASSERT_FALSE(resp->has_error()) << SecureDebugString(*resp);
+  }
+  boost::optional<OpId> last_id = tablet_replica_->consensus()->GetLastOpId(RECEIVED_OPID);
+  ASSERT_TRUE(last_id);
+  ASSERT_EQ(first_id->index() + kNumWrites, last_id->index());
+
+  uint64_t num_rows;
+  ASSERT_OK(tablet()->CountRows(&num_rows));
+  ASSERT_EQ(kNumWrites, num_rows);
+}
+
 TEST_F(TabletReplicaTest, TestFlushOpsPerfImprovements) {
   FLAGS_flush_threshold_mb = 64;
 
@@ -598,6 +644,51 @@ TEST_F(TabletReplicaTest, TestFlushOpsPerfImprovements) {
   ASSERT_LT(0.7, stats.perf_improvement());
   ASSERT_GT(1.0, stats.perf_improvement());
   stats.Clear();
+
+  // Below the threshold, but growing by 1MB/s, so it'll be 26MB over the
+  // threshold by the end of the lookahead period.
+  FLAGS_flush_lookahead_secs = 60;
+  stats.set_ram_anchored(30 * 1024 * 1024);
+  FlushOpPerfImprovementPolicy::SetPerfImprovementForFlush(&stats, 1, 1024 * 1024);
+  ASSERT_NEAR(stats.perf_improvement(), 26, 0.01);
+  stats.Clear();
+
+  // Same, but the logs it retains are projected to go over the target replay size.
+  FLAGS_log_target_replay_size_mb = 100;
+  stats.set_ram_anchored(1024 * 1024);
+  stats.set_logs_retained_bytes(80 * 1024 * 1024);
+  FlushOpPerfImprovementPolicy::SetPerfImprovementForFlush(&stats, 1, 0, 1024 * 1024);
+  ASSERT_NEAR(stats.perf_improvement(), 40, 0.01);
+  stats.Clear();
+
+  // Growing, but not fast enough to matter within the lookahead period.
+  stats.set_ram_anchored(30 * 1024 * 1024);
+  FlushOpPerfImprovementPolicy::SetPerfImprovementForFlush(&stats, 1, 1024);
+  ASSERT_EQ(0.0, stats.perf_improvement());
+  stats.Clear();
+}
+
+TEST(GrowthRateEstimatorTest, TestRate) {
+  GrowthRateEstimator estimator;
+  MonoTime now = MonoTime::Now();
+  estimator.AddSample(0, now);
+  ASSERT_EQ(0, estimator.rate_per_sec());
+
+  // Grow steadily by 1000/s; the estimate converges to it.
+  for (int i = 1; i <= 600; i++) {
+    estimator.AddSample(i * 1000, now + MonoDelta::FromSeconds(i));
+  }
+  ASSERT_NEAR(1000, estimator.rate_per_sec(), 1);
+
+  // A drop, as after a flush, doesn't change the rate.
+  estimator.AddSample(0, now + MonoDelta::FromSeconds(601));
+  ASSERT_NEAR(1000, estimator.rate_per_sec(), 1);
+
+  // No growth at all decays the rate.
+  for (int i = 602; i <= 1200; i++) {
+    estimator.AddSample(0, now + MonoDelta::FromSeconds(i));
+  }
+  ASSERT_NEAR(0, estimator.rate_per_sec(), 1);
 }
 
 } // namespace tablet
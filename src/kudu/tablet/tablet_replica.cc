@@ -26,6 +26,7 @@
 #include <type_traits>
 #include <vector>
 
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 
 #include "kudu/clock/clock.h"
@@ -47,8 +48,11 @@
 #include "kudu/tablet/tablet.pb.h"
 #include "kudu/tablet/tablet_replica_mm_ops.h"
 #include "kudu/tablet/transactions/alter_schema_transaction.h"
+#include "kudu/tablet/transactions/apply_batcher.h"
+#include "kudu/tablet/transactions/replicate_batcher.h"
 #include "kudu/tablet/transactions/transaction_driver.h"
 #include "kudu/tablet/transactions/write_transaction.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/maintenance_manager.h"
 #include "kudu/util/metrics.h"
@@ -189,6 +193,8 @@ Status TabletReplica::Start(const ConsensusBootstrapInfo& bootstrap_info,
               METRIC_op_prepare_queue_time.Instantiate(metric_entity),
               METRIC_op_prepare_run_time.Instantiate(metric_entity)
           });
+      replicate_batcher_.reset(new ReplicateBatcher(consensus_.get()));
+      apply_batcher_ = std::make_shared<ApplyBatcher>(apply_pool_);
 
       if (tablet_->metrics() != nullptr) {
         TRACE("Starting instrumentation");
@@ -437,6 +443,11 @@ void TabletReplica::GetTabletStatusPB(TabletStatusPB* status_pb_out) const {
   meta_->partition().ToPB(status_pb_out->mutable_partition());
   status_pb_out->set_tablet_data_state(meta_->tablet_data_state());
   status_pb_out->set_estimated_on_disk_size(OnDiskSize());
+  shared_ptr<Tablet> tablet = shared_tablet();
+  string split_key;
+  if (tablet && tablet->GetProposedSplitKey(&split_key)) {
+    status_pb_out->set_proposed_split_key(std::move(split_key));
+  }
 }
 
 Status TabletReplica::RunLogGC() {
@@ -555,6 +566,10 @@ log::RetentionIndexes TabletReplica::GetRetentionIndexes() const {
     }
   }
 
+  // The ops needed for durability are the ones not yet durably applied to the
+  // tablet's data, so those before them can be skipped on bootstrap.
+  meta_->UpdateMinUnflushedLogIndex(ret.for_durability);
+
   return ret;
 }
 
@@ -636,7 +651,9 @@ Status TabletReplica::NewLeaderTransactionDriver(gscoped_ptr<Transaction> transa
     log_.get(),
     prepare_pool_token_.get(),
     apply_pool_,
-    &txn_order_verifier_);
+    &txn_order_verifier_,
+    replicate_batcher_.get(),
+    apply_batcher_.get());
   RETURN_NOT_OK(tx_driver->Init(std::move(transaction), consensus::LEADER));
   driver->swap(tx_driver);
 
@@ -651,7 +668,9 @@ Status TabletReplica::NewReplicaTransactionDriver(gscoped_ptr<Transaction> trans
     log_.get(),
     prepare_pool_token_.get(),
     apply_pool_,
-    &txn_order_verifier_);
+    &txn_order_verifier_,
+    replicate_batcher_.get(),
+    apply_batcher_.get());
   RETURN_NOT_OK(tx_driver->Init(std::move(transaction), consensus::REPLICA));
   driver->swap(tx_driver);
 
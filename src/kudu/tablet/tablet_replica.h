@@ -76,6 +76,8 @@ class ResultTracker;
 
 namespace tablet {
 class AlterSchemaTransactionState;
+class ApplyBatcher;
+class ReplicateBatcher;
 class TabletStatusPB;
 class TransactionDriver;
 class WriteTransactionState;
@@ -356,6 +358,14 @@ class TabletReplica : public RefCountedThreadSafe<TabletReplica>,
   // Token for serial task submission to the server-wide transaction prepare pool.
   std::unique_ptr<ThreadPoolToken> prepare_pool_token_;
 
+  // Batches the replication of the leader transactions prepared on
+  // 'prepare_pool_token_'.
+  std::unique_ptr<ReplicateBatcher> replicate_batcher_;
+
+  // Batches the apply of the transactions on 'apply_pool_'. Shared with the
+  // apply tasks it submits.
+  std::shared_ptr<ApplyBatcher> apply_batcher_;
+
   scoped_refptr<clock::Clock> clock_;
 
   // List of maintenance operations for the tablet that need information that only the peer
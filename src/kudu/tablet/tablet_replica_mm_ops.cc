@@ -17,16 +17,21 @@
 
 #include "kudu/tablet/tablet_replica_mm_ops.h"
 
+#include <algorithm>
+#include <cmath>
 #include <map>
 #include <mutex>
 #include <ostream>
 #include <string>
+#include <vector>
 
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 
+#include "kudu/fs/io_scheduler.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/tablet/tablet_metadata.h"
 #include "kudu/tablet/tablet_metrics.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/maintenance_manager.h"
@@ -45,6 +50,14 @@ DEFINE_int32(flush_threshold_secs, 2 * 60,
              "even if it is not large.");
 TAG_FLAG(flush_threshold_secs, experimental);
 
+DEFINE_int32(flush_lookahead_secs, 60,
+             "A memstore becomes flushable ahead of reaching --flush_threshold_mb, or of "
+             "retaining --log_target_replay_size_mb of logs, if it's projected to do so "
+             "within this many seconds at its recent growth rate. 0 disables flushing "
+             "ahead of time.");
+TAG_FLAG(flush_lookahead_secs, experimental);
+
+DECLARE_int64(log_target_replay_size_mb);
 
 METRIC_DEFINE_gauge_uint32(tablet, log_gc_running,
                            "Log GCs Running",
@@ -59,18 +72,38 @@ namespace kudu {
 namespace tablet {
 
 using std::map;
+using std::string;
+using std::vector;
 using strings::Substitute;
 
 // Upper bound for how long it takes to reach "full perf improvement" in time-based flushing.
 const double kFlushUpperBoundMs = 60 * 60 * 1000;
 
+// Time over which the weight of a memstore growth rate sample decays by a factor of e.
+const double kGrowthRateTimeConstantSecs = 60;
+
 //
 // FlushOpPerfImprovementPolicy.
 //
 
 void FlushOpPerfImprovementPolicy::SetPerfImprovementForFlush(MaintenanceOpStats* stats,
-                                                              double elapsed_ms) {
+                                                              double elapsed_ms,
+                                                              double ram_growth_bytes_per_sec,
+                                                              double logs_growth_bytes_per_sec) {
   double anchored_mb = static_cast<double>(stats->ram_anchored()) / (1024 * 1024);
+
+  // How far past the flush threshold, or the target log replay size, the
+  // memstore is projected to be in --flush_lookahead_secs.
+  const double lookahead_secs = std::max(FLAGS_flush_lookahead_secs, 0);
+  double projected_anchored_mb = anchored_mb +
+      std::max(ram_growth_bytes_per_sec, 0.0) * lookahead_secs / (1024 * 1024);
+  double projected_logs_retained_mb =
+      (static_cast<double>(stats->logs_retained_bytes()) +
+       std::max(logs_growth_bytes_per_sec, 0.0) * lookahead_secs) / (1024 * 1024);
+  double projected_extra_mb = std::max(
+      projected_anchored_mb - static_cast<double>(FLAGS_flush_threshold_mb),
+      projected_logs_retained_mb - static_cast<double>(FLAGS_log_target_replay_size_mb));
+
   if (anchored_mb > FLAGS_flush_threshold_mb) {
     // If we're over the user-specified flush threshold, then consider the perf
     // improvement to be 1 for every extra MB.  This produces perf_improvement results
@@ -81,6 +114,12 @@ void FlushOpPerfImprovementPolicy::SetPerfImprovementForFlush(MaintenanceOpStats
     double extra_mb = anchored_mb - static_cast<double>(FLAGS_flush_threshold_mb);
     DCHECK_GE(extra_mb, 0);
     stats->set_perf_improvement(extra_mb);
+  } else if (projected_extra_mb > 0) {
+    // The memstore is being written to fast enough that it'll go over a
+    // threshold soon. Flush it ahead of time, scoring it as if it already had,
+    // so that it doesn't grow into the server-wide memory limit first.
+    stats->set_perf_improvement(
+        std::max(projected_extra_mb, std::min(elapsed_ms / kFlushUpperBoundMs, 1.0)));
   } else if (elapsed_ms > FLAGS_flush_threshold_secs * 1000) {
     // Even if we aren't over the threshold, consider flushing if we haven't flushed
     // in a long time. But, don't give it a large perf_improvement score. We should
@@ -95,6 +134,32 @@ void FlushOpPerfImprovementPolicy::SetPerfImprovementForFlush(MaintenanceOpStats
   }
 }
 
+//
+// GrowthRateEstimator.
+//
+
+GrowthRateEstimator::GrowthRateEstimator()
+    : last_value_(0),
+      rate_per_sec_(0) {
+}
+
+void GrowthRateEstimator::AddSample(int64_t value, MonoTime now) {
+  if (!last_sample_time_.Initialized() || value < last_value_) {
+    last_sample_time_ = now;
+    last_value_ = value;
+    return;
+  }
+  double elapsed_secs = (now - last_sample_time_).ToSeconds();
+  if (elapsed_secs <= 0) {
+    return;
+  }
+  double rate = (value - last_value_) / elapsed_secs;
+  double alpha = 1 - std::exp(-elapsed_secs / kGrowthRateTimeConstantSecs);
+  rate_per_sec_ += alpha * (rate - rate_per_sec_);
+  last_sample_time_ = now;
+  last_value_ = value;
+}
+
 //
 // FlushMRSOp.
 //
@@ -102,6 +167,10 @@ void FlushOpPerfImprovementPolicy::SetPerfImprovementForFlush(MaintenanceOpStats
 void FlushMRSOp::UpdateStats(MaintenanceOpStats* stats) {
   std::lock_guard<simple_spinlock> l(lock_);
 
+  // Piggyback on the periodic stats updates to let the memrowset compact the
+  // mutation lists of its frequently updated rows.
+  tablet_replica_->tablet()->UpdateMemRowSetCompactionWatermark();
+
   map<int64_t, int64_t> replay_size_map;
   if (tablet_replica_->tablet()->MemRowSetEmpty() ||
       !tablet_replica_->GetReplaySizeMap(&replay_size_map).ok()) {
@@ -118,11 +187,14 @@ void FlushMRSOp::UpdateStats(MaintenanceOpStats* stats) {
   stats->set_logs_retained_bytes(
       tablet_replica_->tablet()->MemRowSetLogReplaySize(replay_size_map));
 
-  // TODO(todd): use workload statistics here to find out how "hot" the tablet has
-  // been in the last 5 minutes.
+  MonoTime now = MonoTime::Now();
+  ram_growth_.AddSample(stats->ram_anchored(), now);
+  logs_growth_.AddSample(stats->logs_retained_bytes(), now);
   FlushOpPerfImprovementPolicy::SetPerfImprovementForFlush(
       stats,
-      time_since_flush_.elapsed().wall_millis());
+      time_since_flush_.elapsed().wall_millis(),
+      ram_growth_.rate_per_sec(),
+      logs_growth_.rate_per_sec());
 }
 
 bool FlushMRSOp::Prepare() {
@@ -138,6 +210,7 @@ void FlushMRSOp::Perform() {
   SCOPED_CLEANUP({
     tablet->rowsets_flush_sem_.unlock();
   });
+  fs::ScopedIOPriority io_priority(fs::IOPriority::FLUSH);
 
   Status s = tablet->FlushUnlocked();
   if (PREDICT_FALSE(!s.ok())) {
@@ -161,6 +234,10 @@ scoped_refptr<AtomicGauge<uint32_t> > FlushMRSOp::RunningGauge() const {
   return tablet_replica_->tablet()->metrics()->flush_mrs_running;
 }
 
+vector<string> FlushMRSOp::DataDirUuids() const {
+  return tablet_replica_->tablet_metadata()->DataDirUuids();
+}
+
 //
 // FlushDeltaMemStoresOp.
 //
@@ -181,9 +258,14 @@ void FlushDeltaMemStoresOp::UpdateStats(MaintenanceOpStats* stats) {
   stats->set_runnable(true);
   stats->set_logs_retained_bytes(retention_size);
 
+  MonoTime now = MonoTime::Now();
+  ram_growth_.AddSample(dms_size, now);
+  logs_growth_.AddSample(retention_size, now);
   FlushOpPerfImprovementPolicy::SetPerfImprovementForFlush(
       stats,
-      time_since_flush_.elapsed().wall_millis());
+      time_since_flush_.elapsed().wall_millis(),
+      ram_growth_.rate_per_sec(),
+      logs_growth_.rate_per_sec());
 }
 
 void FlushDeltaMemStoresOp::Perform() {
@@ -194,6 +276,7 @@ void FlushDeltaMemStoresOp::Perform() {
     return;
   }
   Tablet* tablet = tablet_replica_->tablet();
+  fs::ScopedIOPriority io_priority(fs::IOPriority::FLUSH);
   Status s = tablet->FlushDMSWithHighestRetention(max_idx_to_replay_size);
   if (PREDICT_FALSE(!s.ok())) {
     LOG(WARNING) << tablet->LogPrefix() << "failed to flush DMS: " << s.ToString();
@@ -216,6 +299,10 @@ scoped_refptr<AtomicGauge<uint32_t> > FlushDeltaMemStoresOp::RunningGauge() cons
   return tablet_replica_->tablet()->metrics()->flush_dms_running;
 }
 
+vector<string> FlushDeltaMemStoresOp::DataDirUuids() const {
+  return tablet_replica_->tablet_metadata()->DataDirUuids();
+}
+
 //
 // LogGCOp.
 //
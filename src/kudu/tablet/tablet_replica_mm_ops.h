@@ -20,6 +20,7 @@
 
 #include <cstdint>
 #include <string>
+#include <vector>
 
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/ref_counted.h"
@@ -29,6 +30,7 @@
 #include "kudu/util/locks.h"
 #include "kudu/util/maintenance_manager.h"
 #include "kudu/util/metrics.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/semaphore.h"
 #include "kudu/util/stopwatch.h"
 
@@ -40,13 +42,37 @@ class FlushOpPerfImprovementPolicy {
   ~FlushOpPerfImprovementPolicy() {}
 
   // Sets the performance improvement based on the anchored ram if it's over the threshold,
-  // else it will set it based on how long it has been since the last flush.
-  static void SetPerfImprovementForFlush(MaintenanceOpStats* stats, double elapsed_ms);
+  // or if it's projected to go over the threshold soon, given it grows by
+  // 'ram_growth_bytes_per_sec' and its log retention by 'logs_growth_bytes_per_sec'.
+  // Else it will set it based on how long it has been since the last flush.
+  static void SetPerfImprovementForFlush(MaintenanceOpStats* stats, double elapsed_ms,
+                                         double ram_growth_bytes_per_sec = 0,
+                                         double logs_growth_bytes_per_sec = 0);
 
  private:
   FlushOpPerfImprovementPolicy() {}
 };
 
+// Estimates how fast a quantity, such as the memory anchored by a memstore,
+// grows, as an exponentially weighted moving average of its growth rate
+// between samples. Not thread-safe.
+class GrowthRateEstimator {
+ public:
+  GrowthRateEstimator();
+
+  // Adds a sample of the quantity, taken at 'now'. A decrease, e.g. after a
+  // flush, leaves the rate as is.
+  void AddSample(int64_t value, MonoTime now);
+
+  // Returns the estimated growth rate, per second.
+  double rate_per_sec() const { return rate_per_sec_; }
+
+ private:
+  MonoTime last_sample_time_;
+  int64_t last_value_;
+  double rate_per_sec_;
+};
+
 // Maintenance op for MRS flush. Only one can happen at a time.
 class FlushMRSOp : public MaintenanceOp {
  public:
@@ -67,11 +93,17 @@ class FlushMRSOp : public MaintenanceOp {
 
   virtual scoped_refptr<AtomicGauge<uint32_t> > RunningGauge() const OVERRIDE;
 
+  virtual std::vector<std::string> DataDirUuids() const OVERRIDE;
+
  private:
-  // Lock protecting time_since_flush_.
+  // Lock protecting time_since_flush_, ram_growth_ and logs_growth_.
   mutable simple_spinlock lock_;
   Stopwatch time_since_flush_;
 
+  // The growth rates of the MRS and of the logs it retains.
+  GrowthRateEstimator ram_growth_;
+  GrowthRateEstimator logs_growth_;
+
   TabletReplica *const tablet_replica_;
 };
 
@@ -99,11 +131,17 @@ class FlushDeltaMemStoresOp : public MaintenanceOp {
 
   virtual scoped_refptr<AtomicGauge<uint32_t> > RunningGauge() const OVERRIDE;
 
+  virtual std::vector<std::string> DataDirUuids() const OVERRIDE;
+
  private:
-  // Lock protecting time_since_flush_
+  // Lock protecting time_since_flush_, ram_growth_ and logs_growth_.
   mutable simple_spinlock lock_;
   Stopwatch time_since_flush_;
 
+  // The growth rates of the DMS to flush and of the logs it retains.
+  GrowthRateEstimator ram_growth_;
+  GrowthRateEstimator logs_growth_;
+
   TabletReplica *const tablet_replica_;
 };
 
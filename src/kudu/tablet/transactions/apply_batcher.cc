@@ -0,0 +1,83 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/tablet/transactions/apply_batcher.h"
+
+#include <mutex>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "kudu/tablet/transactions/transaction.h"
+#include "kudu/tablet/transactions/transaction_driver.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/threadpool.h"
+
+DEFINE_int32(tablet_apply_batch_max_ops, 32,
+             "Maximum number of committed write operations of a tablet, waiting "
+             "to be applied, to apply together in a single pass. Batching amortizes "
+             "the WAL and MVCC overhead of applying small writes. If 1, each "
+             "operation is applied on its own.");
+TAG_FLAG(tablet_apply_batch_max_ops, advanced);
+TAG_FLAG(tablet_apply_batch_max_ops, runtime);
+
+using std::shared_ptr;
+using std::vector;
+
+namespace kudu {
+namespace tablet {
+
+ApplyBatcher::ApplyBatcher(ThreadPool* apply_pool)
+    : apply_pool_(DCHECK_NOTNULL(apply_pool)) {
+}
+
+ApplyBatcher::~ApplyBatcher() {
+  DCHECK(queue_.empty());
+}
+
+Status ApplyBatcher::Submit(TransactionDriver* driver) {
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    queue_.emplace_back(driver);
+  }
+  shared_ptr<ApplyBatcher> s_this = shared_from_this();
+  return apply_pool_->SubmitFunc([s_this]() { s_this->ApplyNextBatch(); });
+}
+
+void ApplyBatcher::ApplyNextBatch() {
+  vector<scoped_refptr<TransactionDriver>> batch;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    // Only writes are applied in batches: other transactions are applied
+    // on their own.
+    while (!queue_.empty() &&
+           batch.size() < FLAGS_tablet_apply_batch_max_ops &&
+           (batch.empty() ||
+            (batch.front()->tx_type() == Transaction::WRITE_TXN &&
+             queue_.front()->tx_type() == Transaction::WRITE_TXN))) {
+      batch.emplace_back(std::move(queue_.front()));
+      queue_.pop_front();
+    }
+  }
+  if (!batch.empty()) {
+    TransactionDriver::ApplyBatch(batch);
+  }
+}
+
+} // namespace tablet
+} // namespace kudu
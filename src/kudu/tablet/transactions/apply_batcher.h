@@ -0,0 +1,82 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef KUDU_TABLET_APPLY_BATCHER_H_
+#define KUDU_TABLET_APPLY_BATCHER_H_
+
+#include <deque>
+#include <memory>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+class ThreadPool;
+
+namespace tablet {
+
+class TransactionDriver;
+
+// Groups the apply of a tablet's committed transactions, so that writes
+// which are queued for apply together are applied in a single pass rather
+// than one at a time.
+//
+// Every transaction submitted to the batcher is queued and a task is
+// submitted to the apply pool. Each task applies, in the order they were
+// queued, up to --tablet_apply_batch_max_ops consecutive write transactions
+// waiting in the queue, or finds the queue empty if earlier tasks applied
+// its transaction already. Under light load every batch holds a single
+// transaction, and applies of a tablet run as concurrently as before; when
+// the apply pool is backed up, the per-operation overhead of appending the
+// commit message to the WAL and of committing in MVCC is amortized over the
+// batch. See TransactionDriver::ApplyBatch().
+//
+// Tasks hold a reference to the batcher, so it may outlive its tablet
+// replica until the last of them ran.
+//
+// This class is thread-safe.
+class ApplyBatcher : public std::enable_shared_from_this<ApplyBatcher> {
+ public:
+  explicit ApplyBatcher(ThreadPool* apply_pool);
+  ~ApplyBatcher();
+
+  // Queues 'driver', whose transaction was prepared and replicated, to be
+  // applied.
+  Status Submit(TransactionDriver* driver);
+
+ private:
+  // Applies the next batch of queued transactions, if any.
+  void ApplyNextBatch();
+
+  ThreadPool* const apply_pool_;
+
+  // Protects 'queue_'.
+  simple_spinlock lock_;
+
+  // The transactions waiting to be applied, in the order they were submitted.
+  std::deque<scoped_refptr<TransactionDriver>> queue_;
+
+  DISALLOW_COPY_AND_ASSIGN(ApplyBatcher);
+};
+
+} // namespace tablet
+} // namespace kudu
+
+#endif // KUDU_TABLET_APPLY_BATCHER_H_
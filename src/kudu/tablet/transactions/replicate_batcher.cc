@@ -0,0 +1,95 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/tablet/transactions/replicate_batcher.h"
+
+#include <utility>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "kudu/consensus/raft_consensus.h"
+#include "kudu/tablet/transactions/transaction_driver.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/status.h"
+#include "kudu/util/trace.h"
+
+DEFINE_int32(tablet_replicate_batch_max_ops, 32,
+             "Maximum number of leader write operations of a tablet, prepared one after "
+             "the other, to replicate together as a single batch. Batching amortizes the "
+             "consensus and WAL overhead of small writes. If 1, each operation is "
+             "replicated as soon as it is prepared.");
+TAG_FLAG(tablet_replicate_batch_max_ops, advanced);
+TAG_FLAG(tablet_replicate_batch_max_ops, runtime);
+
+using kudu::consensus::ConsensusRound;
+using kudu::consensus::RaftConsensus;
+
+namespace kudu {
+namespace tablet {
+
+ReplicateBatcher::ReplicateBatcher(RaftConsensus* consensus)
+    : consensus_(DCHECK_NOTNULL(consensus)),
+      num_pending_prepares_(0) {
+}
+
+ReplicateBatcher::~ReplicateBatcher() {
+  DCHECK(drivers_.empty());
+}
+
+void ReplicateBatcher::PrepareSubmitted() {
+  num_pending_prepares_++;
+}
+
+void ReplicateBatcher::PrepareNotSubmitted() {
+  int remaining = --num_pending_prepares_;
+  DCHECK_GE(remaining, 0);
+}
+
+void ReplicateBatcher::Add(TransactionDriver* driver, scoped_refptr<ConsensusRound> round) {
+  drivers_.emplace_back(driver);
+  rounds_.emplace_back(std::move(round));
+  if (rounds_.size() >= FLAGS_tablet_replicate_batch_max_ops) {
+    Flush();
+  }
+}
+
+void ReplicateBatcher::PrepareFinished() {
+  int remaining = --num_pending_prepares_;
+  DCHECK_GE(remaining, 0);
+  // If another prepare task is queued, it is guaranteed to run after this
+  // one, and will replicate the batch (or add to it) then.
+  if (remaining == 0 && !rounds_.empty()) {
+    Flush();
+  }
+}
+
+void ReplicateBatcher::Flush() {
+  DCHECK(!rounds_.empty());
+  TRACE("Replicating batch of $0 operations", rounds_.size());
+  Status s = consensus_->ReplicateBatch(rounds_);
+  if (PREDICT_FALSE(!s.ok())) {
+    for (const auto& driver : drivers_) {
+      driver->ReplicationFailedToStart(s);
+    }
+  }
+  drivers_.clear();
+  rounds_.clear();
+}
+
+} // namespace tablet
+} // namespace kudu
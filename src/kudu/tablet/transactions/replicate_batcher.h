@@ -0,0 +1,99 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef KUDU_TABLET_REPLICATE_BATCHER_H_
+#define KUDU_TABLET_REPLICATE_BATCHER_H_
+
+#include <atomic>
+#include <vector>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/ref_counted.h"
+
+namespace kudu {
+
+namespace consensus {
+class ConsensusRound;
+class RaftConsensus;
+} // namespace consensus
+
+namespace tablet {
+
+class TransactionDriver;
+
+// Groups the replication of leader transactions which are prepared
+// back-to-back, so that they are appended to the Raft queue (and hence to the
+// local WAL and to the requests sent to the followers) as a single batch
+// rather than one at a time.
+//
+// A tablet's transactions are prepared one at a time on its serial prepare
+// pool token. Instead of replicating each leader transaction as soon as it is
+// prepared, the prepare task adds it to the current batch. The batch is
+// replicated at the end of the last prepare task queued on the token, or once
+// it reaches --tablet_replicate_batch_max_ops transactions. Under light load
+// every batch holds a single transaction, so latency is unaffected; under
+// heavy load of small writes, the per-operation consensus and WAL overhead is
+// amortized over the batch.
+//
+// Each transaction still has its own OpId, responds to its own client and is
+// applied on its own.
+//
+// PrepareSubmitted() and PrepareNotSubmitted() are thread-safe. The other
+// methods must only be called from the prepare pool token's tasks.
+class ReplicateBatcher {
+ public:
+  explicit ReplicateBatcher(consensus::RaftConsensus* consensus);
+  ~ReplicateBatcher();
+
+  // Must be called before submitting a prepare task to the prepare pool token.
+  void PrepareSubmitted();
+
+  // Must be called if a prepare task announced by PrepareSubmitted() could
+  // not be submitted.
+  void PrepareNotSubmitted();
+
+  // Adds the round of 'driver', a leader transaction that has just been
+  // prepared and started, to the current batch.
+  void Add(TransactionDriver* driver, scoped_refptr<consensus::ConsensusRound> round);
+
+  // Must be called at the end of every prepare task, whether or not it added
+  // a transaction. Replicates the current batch if no other prepare tasks are
+  // queued.
+  void PrepareFinished();
+
+ private:
+  // Replicates the current batch, failing its transactions if replication
+  // could not be started.
+  void Flush();
+
+  consensus::RaftConsensus* const consensus_;
+
+  // The number of prepare tasks which have been announced by
+  // PrepareSubmitted() but have not yet finished.
+  std::atomic<int> num_pending_prepares_;
+
+  // The transactions of the current batch, and their rounds.
+  std::vector<scoped_refptr<TransactionDriver>> drivers_;
+  std::vector<scoped_refptr<consensus::ConsensusRound>> rounds_;
+
+  DISALLOW_COPY_AND_ASSIGN(ReplicateBatcher);
+};
+
+} // namespace tablet
+} // namespace kudu
+
+#endif // KUDU_TABLET_REPLICATE_BATCHER_H_
@@ -17,6 +17,8 @@
 
 #include "kudu/tablet/transactions/transaction.h"
 
+#include <utility>
+
 #include "kudu/rpc/result_tracker.h"
 
 namespace kudu {
@@ -34,11 +36,12 @@ TransactionState::TransactionState(TabletReplica* tablet_replica)
     : tablet_replica_(tablet_replica),
       completion_clbk_(new TransactionCompletionCallback()),
       timestamp_error_(0),
-      arena_(1024),
+      arena_(ArenaCache::Shared()->Get(1024)),
       external_consistency_mode_(CLIENT_PROPAGATED) {
 }
 
 TransactionState::~TransactionState() {
+  ArenaCache::Shared()->Put(std::move(arena_));
 }
 
 TransactionCompletionCallback::TransactionCompletionCallback()
@@ -20,6 +20,7 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <mutex>
 #include <string>
 
@@ -220,7 +221,7 @@ class TransactionState {
   // Return the arena associated with this transaction.
   // NOTE: this is not a thread-safe arena!
   Arena* arena() {
-    return &arena_;
+    return arena_.get();
   }
 
   // Each implementation should have its own ToString() method.
@@ -293,7 +294,9 @@ class TransactionState {
   // The clock error when timestamp_ was read.
   uint64_t timestamp_error_;
 
-  Arena arena_;
+  // Taken from, and returned to, the shared ArenaCache, so that transactions
+  // don't each allocate a fresh arena buffer.
+  std::unique_ptr<Arena> arena_;
 
   // This OpId stores the canonical "anchor" OpId for this transaction.
   consensus::OpId op_id_;
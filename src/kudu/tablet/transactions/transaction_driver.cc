@@ -18,10 +18,12 @@
 #include "kudu/tablet/transactions/transaction_driver.h"
 
 #include <functional>
+#include <memory>
 #include <mutex>
 #include <ostream>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include <glog/logging.h>
 #include <google/protobuf/descriptor.h>
@@ -35,6 +37,7 @@
 #include "kudu/consensus/time_manager.h"
 #include "kudu/gutil/bind.h"
 #include "kudu/gutil/bind_helpers.h"
+#include "kudu/gutil/casts.h"
 #include "kudu/gutil/move.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/strings/strcat.h"
@@ -45,7 +48,10 @@
 #include "kudu/tablet/tablet.h"
 #include "kudu/tablet/tablet_replica.h"
 #include "kudu/tablet/transaction_order_verifier.h"
+#include "kudu/tablet/transactions/apply_batcher.h"
+#include "kudu/tablet/transactions/replicate_batcher.h"
 #include "kudu/tablet/transactions/transaction_tracker.h"
+#include "kudu/tablet/transactions/write_transaction.h"
 #include "kudu/util/debug/trace_event.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/pb_util.h"
@@ -65,6 +71,8 @@ using pb_util::SecureShortDebugString;
 using rpc::RequestIdPB;
 using rpc::ResultTracker;
 using std::string;
+using std::unique_ptr;
+using std::vector;
 using strings::Substitute;
 
 static const char* kTimestampFieldName = "timestamp";
@@ -108,13 +116,17 @@ TransactionDriver::TransactionDriver(TransactionTracker *txn_tracker,
                                      Log* log,
                                      ThreadPoolToken* prepare_pool_token,
                                      ThreadPool* apply_pool,
-                                     TransactionOrderVerifier* order_verifier)
+                                     TransactionOrderVerifier* order_verifier,
+                                     ReplicateBatcher* replicate_batcher,
+                                     ApplyBatcher* apply_batcher)
     : txn_tracker_(txn_tracker),
       consensus_(consensus),
       log_(log),
       prepare_pool_token_(prepare_pool_token),
       apply_pool_(apply_pool),
       order_verifier_(order_verifier),
+      replicate_batcher_(replicate_batcher),
+      apply_batcher_(apply_batcher),
       trace_(new Trace()),
       start_time_(MonoTime::Now()),
       replication_state_(NOT_REPLICATING),
@@ -223,8 +235,14 @@ Status TransactionDriver::ExecuteAsync() {
   }
 
   if (s.ok()) {
+    if (replicate_batcher_) {
+      replicate_batcher_->PrepareSubmitted();
+    }
     s = prepare_pool_token_->SubmitClosure(
       Bind(&TransactionDriver::PrepareTask, Unretained(this)));
+    if (PREDICT_FALSE(!s.ok()) && replicate_batcher_) {
+      replicate_batcher_->PrepareNotSubmitted();
+    }
   }
 
   if (!s.ok()) {
@@ -237,10 +255,16 @@ Status TransactionDriver::ExecuteAsync() {
 
 void TransactionDriver::PrepareTask() {
   TRACE_EVENT_FLOW_END0("txn", "PrepareTask", this);
+  // The driver may be destroyed by the time Prepare() returns, so keep our
+  // own copy of the batcher.
+  ReplicateBatcher* batcher = replicate_batcher_;
   Status prepare_status = Prepare();
   if (PREDICT_FALSE(!prepare_status.ok())) {
     HandleFailure(prepare_status);
   }
+  if (batcher) {
+    batcher->PrepareFinished();
+  }
 }
 
 void TransactionDriver::RegisterFollowerTransactionOnResultTracker() {
@@ -318,6 +342,9 @@ Status TransactionDriver::Prepare() {
       RETURN_NOT_OK(consensus_->time_manager()->AssignTimestamp(
                         mutable_state()->consensus_round()->replicate_msg()));
       RETURN_NOT_OK(transaction_->Start());
+      // Let the peers attribute their handling of the operation to its trace.
+      mutable_state()->consensus_round()->replicate_scoped_refptr()->set_span_context(
+          trace()->span_context());
       VLOG_WITH_PREFIX(4) << "Triggering consensus replication.";
       // Trigger consensus replication.
       {
@@ -326,6 +353,12 @@ Status TransactionDriver::Prepare() {
         replication_start_time_ = MonoTime::Now();
       }
 
+      if (replicate_batcher_) {
+        // The batcher replicates the transaction, or calls
+        // ReplicationFailedToStart(), by the end of the last queued prepare.
+        replicate_batcher_->Add(this, mutable_state()->consensus_round());
+        break;
+      }
       Status s = consensus_->Replicate(mutable_state()->consensus_round());
       if (PREDICT_FALSE(!s.ok())) {
         std::lock_guard<simple_spinlock> lock(lock_);
@@ -394,6 +427,16 @@ void TransactionDriver::HandleFailure(const Status& s) {
   }
 }
 
+void TransactionDriver::ReplicationFailedToStart(const Status& s) {
+  {
+    std::lock_guard<simple_spinlock> lock(lock_);
+    CHECK_EQ(replication_state_, REPLICATING);
+    transaction_status_ = s;
+    replication_state_ = REPLICATION_FAILED;
+  }
+  HandleFailure(s);
+}
+
 void TransactionDriver::ReplicationFinished(const Status& status) {
   MonoTime replication_finished_time = MonoTime::Now();
 
@@ -431,6 +474,8 @@ void TransactionDriver::ReplicationFinished(const Status& status) {
   }
 
   TRACE_COUNTER_INCREMENT("replication_time_us", replication_duration.ToMicroseconds());
+  trace()->RecordChildSpan("replication", replication_finished_time - replication_duration,
+                           replication_finished_time);
 
   // If we have prepared and replicated, we're ready
   // to move ahead and apply this operation.
@@ -487,16 +532,17 @@ Status TransactionDriver::ApplyAsync() {
   }
 
   TRACE_EVENT_FLOW_BEGIN0("txn", "ApplyTask", this);
+  if (apply_batcher_) {
+    return apply_batcher_->Submit(this);
+  }
   return apply_pool_->SubmitClosure(Bind(&TransactionDriver::ApplyTask, Unretained(this)));
 }
 
-void TransactionDriver::ApplyTask() {
-  TRACE_EVENT_FLOW_END0("txn", "ApplyTask", this);
-  ADOPT_TRACE(trace());
+bool TransactionDriver::ApplyTransaction(gscoped_ptr<CommitMsg>* commit_msg) {
   Tablet* tablet = state()->tablet_replica()->tablet();
   if (tablet->HasBeenStopped()) {
     HandleFailure(Status::IllegalState("Not Applying transaction; the tablet is stopped"));
-    return;
+    return false;
   }
 
   {
@@ -505,21 +551,33 @@ void TransactionDriver::ApplyTask() {
     DCHECK_EQ(prepare_state_, PREPARED);
   }
 
+  MonoTime apply_start = MonoTime::Now();
+  Status s = transaction_->Apply(commit_msg);
+  trace()->RecordChildSpan("apply", apply_start, MonoTime::Now());
+  if (PREDICT_FALSE(!s.ok())) {
+    LOG(WARNING) << Substitute("Did not Apply transaction $0: $1",
+        transaction_->ToString(), s.ToString());
+    HandleFailure(s);
+    return false;
+  }
+  (*commit_msg)->mutable_commited_op_id()->CopyFrom(op_id_copy_);
+  SetResponseTimestamp(transaction_->state(), transaction_->state()->timestamp());
+  return true;
+}
+
+void TransactionDriver::ApplyTask() {
+  TRACE_EVENT_FLOW_END0("txn", "ApplyTask", this);
+  ADOPT_TRACE(trace());
+
   // We need to ref-count ourself, since Commit() may run very quickly
   // and end up calling Finalize() while we're still in this code.
   scoped_refptr<TransactionDriver> ref(this);
 
   {
     gscoped_ptr<CommitMsg> commit_msg;
-    Status s = transaction_->Apply(&commit_msg);
-    if (PREDICT_FALSE(!s.ok())) {
-      LOG(WARNING) << Substitute("Did not Apply transaction $0: $1",
-          transaction_->ToString(), s.ToString());
-      HandleFailure(s);
+    if (!ApplyTransaction(&commit_msg)) {
       return;
     }
-    commit_msg->mutable_commited_op_id()->CopyFrom(op_id_copy_);
-    SetResponseTimestamp(transaction_->state(), transaction_->state()->timestamp());
 
     {
       TRACE_EVENT1("txn", "AsyncAppendCommit", "txn", this);
@@ -545,6 +603,60 @@ void TransactionDriver::ApplyTask() {
   }
 }
 
+void TransactionDriver::ApplyBatch(const vector<scoped_refptr<TransactionDriver>>& drivers) {
+  if (drivers.size() == 1) {
+    drivers.front()->ApplyTask();
+    return;
+  }
+  TRACE_EVENT1("txn", "ApplyBatch", "num_txns", drivers.size());
+
+  // Apply the transactions in order, leaving out the ones that failed to apply:
+  // HandleFailure() already took care of them.
+  vector<TransactionDriver*> applied;
+  vector<unique_ptr<CommitMsg>> commit_msgs;
+  applied.reserve(drivers.size());
+  commit_msgs.reserve(drivers.size());
+  for (const scoped_refptr<TransactionDriver>& driver : drivers) {
+    DCHECK_EQ(driver->tx_type(), Transaction::WRITE_TXN);
+    TRACE_EVENT_FLOW_END0("txn", "ApplyTask", driver.get());
+    ADOPT_TRACE(driver->trace());
+    gscoped_ptr<CommitMsg> commit_msg;
+    if (driver->ApplyTransaction(&commit_msg)) {
+      applied.push_back(driver.get());
+      commit_msgs.emplace_back(commit_msg.release());
+    }
+  }
+  if (applied.empty()) {
+    return;
+  }
+
+  // All of the drivers belong to the same tablet and share its log.
+  {
+    TRACE_EVENT1("txn", "AsyncAppendCommits", "num_txns", applied.size());
+    CHECK_OK(applied.front()->log_->AsyncAppendCommits(
+        std::move(commit_msgs),
+        Bind(CrashIfNotOkStatusCB, "Enqueued commit operations failed to write to WAL")));
+  }
+
+  // As in ApplyTask(), commit wait before the transactions' locks are released.
+  vector<WriteTransactionState*> states;
+  states.reserve(applied.size());
+  for (TransactionDriver* driver : applied) {
+    if (driver->mutable_state()->external_consistency_mode() == COMMIT_WAIT) {
+      ADOPT_TRACE(driver->trace());
+      TRACE("APPLY: Commit Wait.");
+      CHECK_OK(driver->CommitWait());
+    }
+    states.push_back(down_cast<WriteTransactionState*>(driver->mutable_state()));
+  }
+
+  // Make the writes visible all at once, then finish them one by one.
+  WriteTransactionState::CommitMvccTxns(states);
+  for (TransactionDriver* driver : applied) {
+    driver->Finalize();
+  }
+}
+
 void TransactionDriver::SetResponseTimestamp(TransactionState* transaction_state,
                                              const Timestamp& timestamp) {
   google::protobuf::Message* response = transaction_state->response();
@@ -18,6 +18,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 #include <gtest/gtest_prod.h>
 
@@ -47,6 +48,8 @@ class RaftConsensus;
 }
 
 namespace tablet {
+class ApplyBatcher;
+class ReplicateBatcher;
 class TransactionOrderVerifier;
 class TransactionTracker;
 
@@ -85,7 +88,9 @@ class TransactionTracker;
 //
 //      If Prepare() has already completed, then we trigger ApplyAsync().
 //
-//  5 - ApplyAsync() submits ApplyTask() to the apply_pool_.
+//  5 - ApplyAsync() submits ApplyTask() to the apply_pool_, or, if the driver was given
+//      an ApplyBatcher, queues the transaction on it to be applied by ApplyBatch()
+//      together with the writes queued next to it.
 //      ApplyTask() calls transaction_->Apply().
 //
 //      When Apply() is called, changes are made to the in-memory data structures. These
@@ -225,12 +230,22 @@ class TransactionDriver : public RefCountedThreadSafe<TransactionDriver> {
  public:
   // Construct TransactionDriver. TransactionDriver does not take ownership
   // of any of the objects pointed to in the constructor's arguments.
+  //
+  // If 'replicate_batcher' is not null, leader transactions are replicated
+  // through it rather than directly. It must be used by all of the drivers
+  // sharing 'prepare_pool_token'.
+  //
+  // If 'apply_batcher' is not null, transactions are applied through it
+  // rather than directly. It must be used by all of the drivers of the
+  // tablet.
   TransactionDriver(TransactionTracker* txn_tracker,
                     consensus::RaftConsensus* consensus,
                     log::Log* log,
                     ThreadPoolToken* prepare_pool_token,
                     ThreadPool* apply_pool,
-                    TransactionOrderVerifier* order_verifier);
+                    TransactionOrderVerifier* order_verifier,
+                    ReplicateBatcher* replicate_batcher = nullptr,
+                    ApplyBatcher* apply_batcher = nullptr);
 
   // Perform any non-constructor initialization. Sets the transaction
   // that will be executed.
@@ -280,6 +295,8 @@ class TransactionDriver : public RefCountedThreadSafe<TransactionDriver> {
  private:
   FRIEND_TEST(TabletReplicaTest, TestShuttingDownMVCC);
   friend class RefCountedThreadSafe<TransactionDriver>;
+  friend class ApplyBatcher;
+  friend class ReplicateBatcher;
   enum ReplicationState {
     // The operation has not yet been sent to consensus for replication
     NOT_REPLICATING,
@@ -318,6 +335,15 @@ class TransactionDriver : public RefCountedThreadSafe<TransactionDriver> {
   // results from the Apply().
   void ApplyTask();
 
+  // Applies the transaction and fills in 'commit_msg' with the results of the
+  // Apply(). Returns false, having called HandleFailure(), if it couldn't.
+  bool ApplyTransaction(gscoped_ptr<consensus::CommitMsg>* commit_msg);
+
+  // Applies the transactions of 'drivers', which must be writes of the same
+  // tablet, as ApplyTask() would one by one, but appending their commit
+  // messages to the WAL as a single batch and committing them in MVCC at once.
+  static void ApplyBatch(const std::vector<scoped_refptr<TransactionDriver>>& drivers);
+
   // Sleeps until the transaction is allowed to commit based on the
   // requested consistency mode.
   Status CommitWait();
@@ -328,6 +354,10 @@ class TransactionDriver : public RefCountedThreadSafe<TransactionDriver> {
   // In others, where we can't recover, this will FATAL.
   void HandleFailure(const Status& s);
 
+  // Called by the ReplicateBatcher if replication of the batch containing
+  // this (leader) transaction could not be started.
+  void ReplicationFailedToStart(const Status& s);
+
   // Called on Transaction::Apply() after the CommitMsg has been successfully
   // appended to the WAL.
   void Finalize();
@@ -356,6 +386,8 @@ class TransactionDriver : public RefCountedThreadSafe<TransactionDriver> {
   ThreadPoolToken* const prepare_pool_token_;
   ThreadPool* const apply_pool_;
   TransactionOrderVerifier* const order_verifier_;
+  ReplicateBatcher* const replicate_batcher_;
+  ApplyBatcher* const apply_batcher_;
 
   Status transaction_status_;
 
@@ -75,6 +75,7 @@ namespace tablet {
 using pb_util::SecureShortDebugString;
 using consensus::CommitMsg;
 using consensus::DriverType;
+using consensus::RaftConsensus;
 using consensus::ReplicateMsg;
 using consensus::WRITE_OP;
 using tserver::TabletServerErrorPB;
@@ -83,7 +84,8 @@ using tserver::WriteResponsePB;
 
 WriteTransaction::WriteTransaction(unique_ptr<WriteTransactionState> state, DriverType type)
   : Transaction(state.get(), type, Transaction::WRITE_TXN),
-  state_(std::move(state)) {
+  state_(std::move(state)),
+  is_witness_(false) {
   start_time_ = MonoTime::Now();
 }
 
@@ -111,6 +113,17 @@ Status WriteTransaction::Prepare() {
     return s;
   }
 
+  // A witness doesn't apply the writes, so it has no rows to decode or lock.
+  // IsWitness() doesn't take the consensus lock.
+  if (type() == consensus::REPLICA) {
+    RaftConsensus* consensus = state()->tablet_replica()->consensus();
+    is_witness_ = consensus && consensus->IsWitness();
+    if (is_witness_) {
+      TRACE("PREPARE: witness, not decoding the rows");
+      return Status::OK();
+    }
+  }
+
   Tablet* tablet = state()->tablet_replica()->tablet();
 
   Status s = tablet->DecodeWriteOperations(&client_schema, state());
@@ -155,6 +168,16 @@ Status WriteTransaction::Apply(gscoped_ptr<CommitMsg>* commit_msg) {
     SleepFor(MonoDelta::FromMilliseconds(FLAGS_tablet_inject_latency_on_apply_write_txn_ms));
   }
 
+  if (is_witness_) {
+    // The empty result of the commit message marks the write as skipped for
+    // the bootstraps of the witness too.
+    TRACE("APPLY: witness, not applying the rows");
+    commit_msg->reset(new CommitMsg());
+    (*commit_msg)->mutable_result();
+    (*commit_msg)->set_op_type(WRITE_OP);
+    return Status::OK();
+  }
+
   Tablet* tablet = state()->tablet_replica()->tablet();
   RETURN_NOT_OK(tablet->ApplyRowOperations(state()));
 
@@ -329,6 +352,35 @@ void WriteTransactionState::ReleaseMvccTxn(Transaction::TransactionResult result
     }
   }
   mvcc_tx_.reset();
+  ReleaseUncommittedLiveRows();
+}
+
+void WriteTransactionState::CommitMvccTxns(const vector<WriteTransactionState*>& states) {
+  vector<ScopedTransaction*> txns;
+  txns.reserve(states.size());
+  for (WriteTransactionState* state : states) {
+    txns.push_back(DCHECK_NOTNULL(state->mvcc_tx_.get()));
+  }
+  ScopedTransaction::CommitBatch(txns);
+  for (WriteTransactionState* state : states) {
+    state->mvcc_tx_.reset();
+    state->ReleaseUncommittedLiveRows();
+  }
+}
+
+void WriteTransactionState::AddUncommittedLiveRows(Tablet* tablet, int64_t delta) {
+  DCHECK(live_rows_tablet_ == nullptr || live_rows_tablet_ == tablet);
+  live_rows_tablet_ = tablet;
+  uncommitted_live_rows_ += delta;
+  tablet->AdjustUncommittedLiveRows(delta);
+}
+
+void WriteTransactionState::ReleaseUncommittedLiveRows() {
+  if (live_rows_tablet_ != nullptr) {
+    live_rows_tablet_->AdjustUncommittedLiveRows(-uncommitted_live_rows_);
+    live_rows_tablet_ = nullptr;
+    uncommitted_live_rows_ = 0;
+  }
 }
 
 void WriteTransactionState::ReleaseTxResultPB(TxResultPB* result) const {
@@ -368,9 +420,12 @@ void WriteTransactionState::UpdateMetricsForOp(const RowOp& op) {
 
 void WriteTransactionState::ReleaseRowLocks() {
   // free the row locks
+  vector<ScopedRowLock*> locks;
+  locks.reserve(row_ops_.size());
   for (RowOp* op : row_ops_) {
-    op->row_lock.Release();
+    locks.push_back(&op->row_lock);
   }
+  ScopedRowLock::ReleaseBatch(locks);
 }
 
 WriteTransactionState::~WriteTransactionState() {
@@ -19,6 +19,7 @@
 #define KUDU_TABLET_WRITE_TRANSACTION_H_
 
 #include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -51,6 +52,7 @@ class RequestIdPB;
 namespace tablet {
 
 class ScopedTransaction;
+class Tablet;
 class TabletReplica;
 class TxResultPB;
 struct RowOp;
@@ -128,6 +130,15 @@ class WriteTransactionState : public TransactionState {
 
   void ReleaseMvccTxn(Transaction::TransactionResult result);
 
+  // Commits the MVCC transactions of the given applied writes at once, ahead
+  // of finishing the writes, which then don't commit them one by one.
+  static void CommitMvccTxns(const std::vector<WriteTransactionState*>& states);
+
+  // Records that an applied op of this transaction changed the number of
+  // live rows of 'tablet' by 'delta'. Until the MVCC transaction is
+  // committed or aborted, the tablet excludes the change from its count.
+  void AddUncommittedLiveRows(Tablet* tablet, int64_t delta);
+
   void set_schema_at_decode_time(const Schema* schema) {
     std::lock_guard<simple_spinlock> l(txn_state_lock_);
     schema_at_decode_time_ = schema;
@@ -188,6 +199,10 @@ class WriteTransactionState : public TransactionState {
   // Releases all the row locks acquired by this transaction.
   void ReleaseRowLocks();
 
+  // Makes the tablet count the live rows changed by this transaction, once
+  // its MVCC transaction is done.
+  void ReleaseUncommittedLiveRows();
+
   // Reset the RPC request, response, and row_ops_ (which refers to data
   // from the request).
   void ResetRpcFields();
@@ -216,6 +231,10 @@ class WriteTransactionState : public TransactionState {
   // The tablet components, acquired at the same time as mvcc_tx_ is set.
   scoped_refptr<const TabletComponents> tablet_components_;
 
+  // The tablet whose live rows this transaction changed, and by how much.
+  Tablet* live_rows_tablet_ = nullptr;
+  int64_t uncommitted_live_rows_ = 0;
+
   // A lock held on the tablet's schema. Prevents concurrent schema change
   // from racing with a write.
   shared_lock<rw_semaphore> schema_lock_;
@@ -283,6 +302,10 @@ class WriteTransaction : public Transaction {
 
   std::unique_ptr<WriteTransactionState> state_;
 
+  // Whether the local replica is a witness, in which case the rows of the
+  // write are neither decoded nor applied.
+  bool is_witness_;
+
  private:
   DISALLOW_COPY_AND_ASSIGN(WriteTransaction);
 };
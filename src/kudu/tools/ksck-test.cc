@@ -354,7 +354,7 @@ TEST_F(KsckTest, TestOneTableCheck) {
   ASSERT_OK(RunKsck());
   ASSERT_OK(ksck_->ChecksumData(ChecksumOptions()));
   ASSERT_STR_CONTAINS(err_stream_.str(),
-                      "0/1 replicas remaining (20B from disk, 10 rows summed)");
+                      "0/1 replicas remaining (20B from disk, 10 rows summed;");
 }
 
 TEST_F(KsckTest, TestOneSmallReplicatedTable) {
@@ -362,7 +362,7 @@ TEST_F(KsckTest, TestOneSmallReplicatedTable) {
   ASSERT_OK(RunKsck());
   ASSERT_OK(ksck_->ChecksumData(ChecksumOptions()));
   ASSERT_STR_CONTAINS(err_stream_.str(),
-                      "0/9 replicas remaining (180B from disk, 90 rows summed)");
+                      "0/9 replicas remaining (180B from disk, 90 rows summed;");
 
   // Test filtering (a non-matching pattern)
   err_stream_.str("");
@@ -379,7 +379,7 @@ TEST_F(KsckTest, TestOneSmallReplicatedTable) {
   ASSERT_OK(RunKsck());
   ASSERT_OK(ksck_->ChecksumData(ChecksumOptions()));
   ASSERT_STR_CONTAINS(err_stream_.str(),
-                      "0/9 replicas remaining (180B from disk, 90 rows summed)");
+                      "0/9 replicas remaining (180B from disk, 90 rows summed;");
 
   // Test filtering with a matching tablet ID pattern.
   err_stream_.str("");
@@ -388,7 +388,7 @@ TEST_F(KsckTest, TestOneSmallReplicatedTable) {
   ASSERT_OK(RunKsck());
   ASSERT_OK(ksck_->ChecksumData(ChecksumOptions()));
   ASSERT_STR_CONTAINS(err_stream_.str(),
-                      "0/3 replicas remaining (60B from disk, 30 rows summed)");
+                      "0/3 replicas remaining (60B from disk, 30 rows summed;");
 }
 
 TEST_F(KsckTest, TestOneSmallReplicatedTableWithConsensusState) {
@@ -313,13 +313,17 @@ class ChecksumResultReporter : public RefCountedThreadSafe<ChecksumResultReporte
 
   // Blocks until either the number of results plus errors reported equals
   // num_tablet_replicas (from the constructor), or until the timeout expires,
-  // whichever comes first. Progress messages are printed to 'out'.
+  // whichever comes first. Progress messages, including the rates since the
+  // previous message, are printed to 'out'.
   // Returns false if the timeout expired before all responses came in.
   // Otherwise, returns true.
   bool WaitFor(const MonoDelta& timeout, std::ostream* out) const {
     MonoTime start = MonoTime::Now();
     MonoTime deadline = start + timeout;
 
+    MonoTime last_report = start;
+    int64_t last_bytes = 0;
+    int64_t last_rows = 0;
     bool done = false;
     while (!done) {
       MonoTime now = MonoTime::Now();
@@ -328,12 +332,23 @@ class ChecksumResultReporter : public RefCountedThreadSafe<ChecksumResultReporte
 
       done = responses_.WaitFor(MonoDelta::FromMilliseconds(std::min(rem_ms, 5000)));
       string status = done ? "finished in " : "running for ";
-      int run_time_sec = (MonoTime::Now() - start).ToSeconds();
+      now = MonoTime::Now();
+      int run_time_sec = (now - start).ToSeconds();
+      double interval_sec = std::max((now - last_report).ToSeconds(), 0.001);
+      int64_t bytes = disk_bytes_summed_.Load();
+      int64_t rows = rows_summed_.Load();
       (*out) << "Checksum " << status << run_time_sec << "s: "
              << responses_.count() << "/" << expected_count_ << " replicas remaining ("
-             << HumanReadableNumBytes::ToString(disk_bytes_summed_.Load()) << " from disk, "
-             << HumanReadableInt::ToString(rows_summed_.Load()) << " rows summed)"
+             << HumanReadableNumBytes::ToString(bytes) << " from disk, "
+             << HumanReadableInt::ToString(rows) << " rows summed; "
+             << HumanReadableNumBytes::ToString(
+                    static_cast<int64_t>((bytes - last_bytes) / interval_sec)) << "/s, "
+             << HumanReadableInt::ToString(
+                    static_cast<int64_t>((rows - last_rows) / interval_sec)) << " rows/s)"
              << endl;
+      last_report = now;
+      last_bytes = bytes;
+      last_rows = rows;
     }
     return true;
   }
@@ -49,6 +49,7 @@
 #include "kudu/util/test_util.h"
 #include "kudu/util/thread.h"
 
+DECLARE_bool(checksum_columnar_hash);
 DECLARE_int32(heartbeat_interval_ms);
 
 namespace kudu {
@@ -258,8 +259,8 @@ TEST_F(RemoteKsckTest, TestChecksum) {
       // in this short-running test.
       ASSERT_STR_CONTAINS(err_stream_.str(),
                           AllowSlowTests() ?
-                          "0/30 replicas remaining (0B from disk, 300 rows summed)" :
-                          "0/9 replicas remaining (0B from disk, 300 rows summed)");
+                          "0/30 replicas remaining (0B from disk, 300 rows summed;" :
+                          "0/9 replicas remaining (0B from disk, 300 rows summed;");
       break;
     }
     SleepFor(MonoDelta::FromMilliseconds(10));
@@ -267,6 +268,17 @@ TEST_F(RemoteKsckTest, TestChecksum) {
   ASSERT_OK(s);
 }
 
+// The checksums of the replicas also match when computed a row at a time.
+TEST_F(RemoteKsckTest, TestChecksumRowCrc) {
+  FLAGS_checksum_columnar_hash = false;
+  ASSERT_OK(GenerateRowWrites(100));
+  ASSERT_OK(ksck_->CheckMasterRunning());
+  ASSERT_OK(ksck_->FetchTableAndTabletInfo());
+  ASSERT_OK(ksck_->FetchInfoFromTabletServers());
+  ASSERT_OK(ksck_->ChecksumData(ChecksumOptions(MonoDelta::FromSeconds(30), 16, true, 0)));
+  ASSERT_STR_CONTAINS(err_stream_.str(), "300 rows summed;");
+}
+
 TEST_F(RemoteKsckTest, TestChecksumTimeout) {
   uint64_t num_writes = 10000;
   LOG(INFO) << "Generating row writes...";
@@ -18,6 +18,8 @@
 #include "kudu/tools/ksck_remote.h"
 
 #include <cstdint>
+#include <memory>
+#include <mutex>
 #include <ostream>
 #include <unordered_map>
 #include <utility>
@@ -49,12 +51,21 @@
 #include "kudu/tserver/tserver.pb.h"
 #include "kudu/tserver/tserver_service.pb.h"
 #include "kudu/tserver/tserver_service.proxy.h"
+#include "kudu/util/locks.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/net/net_util.h"
 #include "kudu/util/net/sockaddr.h"
 
 DECLARE_int64(timeout_ms); // defined in tool_action_common
 DEFINE_bool(checksum_cache_blocks, false, "Should the checksum scanners cache the read blocks");
+DEFINE_bool(checksum_columnar_hash, true,
+            "Whether the tablet servers should checksum the rows a column at a "
+            "time with a 64-bit hash, rather than a row at a time with CRC32C. "
+            "Much cheaper, but requires all the tablet servers to support it.");
+DEFINE_int64(checksum_scan_max_disk_bytes_per_sec, 0,
+             "Maximum rate at which the checksum scans of each tablet server "
+             "may read from disk, to limit their impact on other workloads. "
+             "0 means unlimited.");
 
 namespace kudu {
 namespace tools {
@@ -80,7 +91,44 @@ MonoDelta GetDefaultTimeout() {
   return MonoDelta::FromMilliseconds(FLAGS_timeout_ms);
 }
 
+// Paces the checksum scans of a tablet server so that together they read at
+// most --checksum_scan_max_disk_bytes_per_sec from disk on average.
+//
+// The amount read is only known once a scan request completes, so rather
+// than admitting requests, the throttle accounts for what each one read and
+// returns how long to delay the next one.
+class ChecksumScanThrottle {
+ public:
+  explicit ChecksumScanThrottle(int64_t bytes_per_sec)
+      : bytes_per_sec_(bytes_per_sec),
+        next_request_time_(MonoTime::Now()) {
+  }
+
+  // Accounts for a request which read 'bytes' from disk, and returns how long
+  // to wait before sending the next request.
+  MonoDelta Account(int64_t bytes) {
+    if (bytes_per_sec_ <= 0) {
+      return MonoDelta::FromNanoseconds(0);
+    }
+    MonoTime now = MonoTime::Now();
+    std::lock_guard<simple_spinlock> l(lock_);
+    if (next_request_time_ < now) {
+      next_request_time_ = now;
+    }
+    next_request_time_ += MonoDelta::FromNanoseconds(bytes * 1000000000 / bytes_per_sec_);
+    return next_request_time_ - now;
+  }
+
+ private:
+  const int64_t bytes_per_sec_;
+
+  simple_spinlock lock_;
+  MonoTime next_request_time_;
+};
+
 Status RemoteKsckTabletServer::Init() {
+  checksum_throttle_ = std::make_shared<ChecksumScanThrottle>(
+      FLAGS_checksum_scan_max_disk_bytes_per_sec);
   vector<Sockaddr> addresses;
   RETURN_NOT_OK(ParseAddressList(
       host_port_.ToString(),
@@ -182,13 +230,19 @@ class ChecksumStepper {
  public:
   ChecksumStepper(string tablet_id, const Schema& schema, string server_uuid,
                   ChecksumOptions options, ChecksumProgressCallbacks* callbacks,
-                  shared_ptr<tserver::TabletServerServiceProxy> proxy)
+                  shared_ptr<tserver::TabletServerServiceProxy> proxy,
+                  shared_ptr<Messenger> messenger,
+                  shared_ptr<ChecksumScanThrottle> throttle)
       : schema_(schema),
         tablet_id_(std::move(tablet_id)),
         server_uuid_(std::move(server_uuid)),
         options_(options),
         callbacks_(callbacks),
         proxy_(std::move(proxy)),
+        messenger_(std::move(messenger)),
+        throttle_(std::move(throttle)),
+        algorithm_(FLAGS_checksum_columnar_hash ? tserver::ChecksumRequestPB::COLUMNAR_HASH
+                                                : tserver::ChecksumRequestPB::ROW_CRC32C),
         call_seq_id_(0),
         checksum_(0) {
     DCHECK(proxy_);
@@ -210,6 +264,11 @@ class ChecksumStepper {
     if (s.ok() && resp_.has_error()) {
       s = StatusFromPB(resp_.error().status());
     }
+    if (s.ok() && resp_.algorithm() != algorithm_) {
+      s = Status::NotSupported(
+          Substitute("tablet server $0 does not support columnar checksums; run with "
+                     "--checksum_columnar_hash=false", server_uuid_));
+    }
     if (!s.ok()) {
       callbacks_->Finished(s, 0);
       return; // Deletes 'this'.
@@ -219,6 +278,7 @@ class ChecksumStepper {
           resp_.resource_metrics().cfile_cache_hit_bytes();
       callbacks_->Progress(resp_.rows_checksummed(), bytes);
     }
+    const MonoDelta delay = throttle_->Account(resp_.resource_metrics().cfile_cache_miss_bytes());
     DCHECK(resp_.has_checksum());
     checksum_ = resp_.checksum();
 
@@ -228,11 +288,25 @@ class ChecksumStepper {
       return; // Deletes 'this'.
     }
 
-    // We're not done scanning yet. Fetch the next chunk.
+    // We're not done scanning yet. Fetch the next chunk, once the throttle
+    // allows it.
     if (resp_.has_scanner_id()) {
       scanner_id_ = resp_.scanner_id();
     }
-    SendRequest(kContinueRequest);
+    if (delay.ToNanoseconds() > 0) {
+      messenger_->ScheduleOnReactor(
+          [this](const Status& s) {
+            if (!s.ok()) {
+              callbacks_->Finished(s.CloneAndPrepend("checksum scan aborted"), 0);
+              delete this;
+              return;
+            }
+            SendRequest(kContinueRequest);
+          },
+          delay);
+    } else {
+      SendRequest(kContinueRequest);
+    }
     ignore_result(deleter.release()); // We have more work to do.
   }
 
@@ -246,6 +320,7 @@ class ChecksumStepper {
     switch (type) {
       case kNewRequest: {
         req_.set_call_seq_id(call_seq_id_);
+        req_.set_algorithm(algorithm_);
         req_.mutable_new_request()->mutable_projected_columns()->CopyFrom(cols_);
         req_.mutable_new_request()->set_tablet_id(tablet_id_);
         req_.mutable_new_request()->set_cache_blocks(FLAGS_checksum_cache_blocks);
@@ -262,6 +337,7 @@ class ChecksumStepper {
         rpc_.Reset();
 
         req_.set_call_seq_id(++call_seq_id_);
+        req_.set_algorithm(algorithm_);
         DCHECK(!scanner_id_.empty());
         req_.mutable_continue_request()->set_scanner_id(scanner_id_);
         req_.mutable_continue_request()->set_previous_checksum(checksum_);
@@ -285,6 +361,9 @@ class ChecksumStepper {
   const ChecksumOptions options_;
   ChecksumProgressCallbacks* const callbacks_;
   const shared_ptr<tserver::TabletServerServiceProxy> proxy_;
+  const shared_ptr<Messenger> messenger_;
+  const shared_ptr<ChecksumScanThrottle> throttle_;
+  const tserver::ChecksumRequestPB::Algorithm algorithm_;
 
   uint32_t call_seq_id_;
   string scanner_id_;
@@ -305,7 +384,8 @@ void RemoteKsckTabletServer::RunTabletChecksumScanAsync(
         const ChecksumOptions& options,
         ChecksumProgressCallbacks* callbacks) {
   gscoped_ptr<ChecksumStepper> stepper(
-      new ChecksumStepper(tablet_id, schema, uuid(), options, callbacks, ts_proxy_));
+      new ChecksumStepper(tablet_id, schema, uuid(), options, callbacks, ts_proxy_,
+                          messenger_, checksum_throttle_));
   stepper->Start();
   ignore_result(stepper.release()); // Deletes self on callback.
 }
@@ -55,6 +55,8 @@ class TabletServerServiceProxy;
 
 namespace tools {
 
+class ChecksumScanThrottle;
+
 // This implementation connects to a Tablet Server via RPC.
 class RemoteKsckTabletServer : public KsckTabletServer {
  public:
@@ -90,6 +92,9 @@ class RemoteKsckTabletServer : public KsckTabletServer {
   std::shared_ptr<server::GenericServiceProxy> generic_proxy_;
   std::shared_ptr<tserver::TabletServerServiceProxy> ts_proxy_;
   std::shared_ptr<consensus::ConsensusServiceProxy> consensus_proxy_;
+
+  // Shared by the checksum scans of this tablet server.
+  std::shared_ptr<ChecksumScanThrottle> checksum_throttle_;
 };
 
 // This implementation connects to a Master via RPC.
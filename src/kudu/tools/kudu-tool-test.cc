@@ -424,6 +424,7 @@ TEST_F(ToolTest, TestModeHelp) {
   }
   {
     const vector<string> kLocalReplicaModeRegexes = {
+        "bulk_load.*Load rows from a file directly into new rowsets",
         "cmeta.*Operate on a local tablet replica's consensus",
         "data_size.*Summarize the data size",
         "dump.*Dump a Kudu filesystem",
@@ -485,6 +486,10 @@ TEST_F(ToolTest, TestModeHelp) {
   {
     const vector<string> kPerfRegexes = {
         "loadgen.*Run load generation with optional scan afterwards",
+        "replay.*Replay captured write and scan requests against a cluster",
+        "table_scan.*Scan a table and report the scan rate",
+        "wal.*Measure the latency and throughput of WAL appends",
+        "workload.*Run a mixed workload and report the operation latencies",
     };
     NO_FATALS(RunTestHelp("perf", kPerfRegexes));
   }
@@ -533,7 +538,8 @@ TEST_F(ToolTest, TestModeHelp) {
         "set_flag.*Change a gflag value",
         "status.*Get the status",
         "timestamp.*Get the current timestamp",
-        "list.*List tablet servers"
+        "list.*List tablet servers",
+        "drain_leaders.*Gracefully transfer the leadership"
     };
     NO_FATALS(RunTestHelp("tserver", kTServerModeRegexes));
   }
@@ -628,8 +634,11 @@ TEST_F(ToolTest, TestFsCheck) {
     ASSERT_OK(fs.Open(&report));
     ASSERT_OK(env_->DeleteFile(fs.GetTabletMetadataPath(kTabletId)));
   }
+  //
+  // The orphaned blocks are found the same way however many threads are used.
   for (int i = 0; i < 2; i++) {
-    NO_FATALS(RunFsCheck(Substitute("fs check --fs_wal_dir=$0", kTestDir),
+    NO_FATALS(RunFsCheck(Substitute("fs check --fs_wal_dir=$0 --fs_io_threads=$1",
+                                    kTestDir, i + 1),
                          block_ids.size() / 2, kTabletId, {}, block_ids.size() / 2));
   }
 
@@ -1296,6 +1305,60 @@ void ToolTest::RunLoadgen(int num_tservers,
 }
 
 // Run the loadgen benchmark with all optional parameters set to defaults.
+// The rowsets of a local replica are dumped and summarized the same way
+// however many threads are used.
+TEST_F(ToolTest, TestLocalReplicaParallelDump) {
+  const string kTestDir = GetTestPath("test");
+  const string kTestTablet = "test-tablet";
+  const int kNumRowSets = 10;
+  const Schema kSchema(GetSimpleTestSchema());
+  const Schema kSchemaWithIds(SchemaBuilder(kSchema).Build());
+
+  {
+    TabletHarness::Options opts(kTestDir);
+    opts.tablet_id = kTestTablet;
+    TabletHarness harness(kSchemaWithIds, opts);
+    ASSERT_OK(harness.Create(true));
+    ASSERT_OK(harness.Open());
+    LocalTabletWriter writer(harness.tablet().get(), &kSchema);
+    KuduPartialRow row(&kSchemaWithIds);
+    for (int num_flushes = 0; num_flushes < kNumRowSets; num_flushes++) {
+      for (int i = 0; i < 10; i++) {
+        ASSERT_OK(row.SetInt32(0, num_flushes * 10 + i));
+        ASSERT_OK(row.SetInt32(1, i));
+        ASSERT_OK(row.SetStringCopy(2, "HelloWorld"));
+        writer.Insert(row);
+      }
+      harness.tablet()->Flush();
+    }
+    harness.tablet()->Shutdown();
+  }
+  const string fs_paths = "--fs_wal_dir=" + kTestDir + " "
+      "--fs_data_dirs=" + kTestDir;
+
+  for (const auto& action : { "dump rowset --dump_data", "data_size" }) {
+    string serial;
+    NO_FATALS(RunActionStdoutString(
+        Substitute("local_replica $0 $1 $2 --fs_io_threads=1",
+                   action, kTestTablet, fs_paths), &serial));
+    string parallel;
+    NO_FATALS(RunActionStdoutString(
+        Substitute("local_replica $0 $1 $2 --fs_io_threads=4",
+                   action, kTestTablet, fs_paths), &parallel));
+    ASSERT_EQ(serial, parallel);
+  }
+
+  string stdout;
+  NO_FATALS(RunActionStdoutString(
+      Substitute("local_replica dump rowset $0 $1 --fs_io_threads=3",
+                 kTestTablet, fs_paths), &stdout));
+  size_t pos = 0;
+  for (int i = 0; i < kNumRowSets; i++) {
+    pos = stdout.find(Substitute("Dumping rowset $0\n", i), pos);
+    ASSERT_NE(string::npos, pos) << "rowset " << i << " missing or out of order";
+  }
+}
+
 TEST_F(ToolTest, TestLoadgenDefaultParameters) {
   NO_FATALS(RunLoadgen());
 }
@@ -1348,6 +1411,125 @@ TEST_F(ToolTest, TestLoadgenManualFlush) {
       "bench_manual_flush"));
 }
 
+// Run 'kudu perf table_scan' against a table populated by 'kudu perf loadgen'.
+TEST_F(ToolTest, TestPerfTableScan) {
+  const string kTableName = "perf.table_scan";
+  NO_FATALS(RunLoadgen(1, { "--num_rows_per_thread=1000", "--num_threads=2" }, kTableName));
+  string out;
+  ASSERT_OK(RunKuduTool({
+    "perf",
+    "table_scan",
+    cluster_->master()->bound_rpc_addr().ToString(),
+    kTableName,
+    "--num_threads=2",
+  }, &out));
+  ASSERT_STR_CONTAINS(out, "tablets     : 2");
+  ASSERT_STR_CONTAINS(out, "rows total  : 2000");
+  ASSERT_STR_CONTAINS(out, "rows skew");
+}
+
+// Capture the requests of 'kudu perf loadgen' and replay them with
+// 'kudu perf replay'.
+TEST_F(ToolTest, TestPerfReplay) {
+  ExternalMiniClusterOptions opts;
+  opts.extra_tserver_flags.emplace_back("--request_capture_sampling_rate=1");
+  NO_FATALS(StartExternalMiniCluster(std::move(opts)));
+  ASSERT_OK(RunKuduTool({
+    "perf",
+    "loadgen",
+    cluster_->master()->bound_rpc_addr().ToString(),
+    "--keep_auto_table",
+    "--num_rows_per_thread=100",
+    "--run_scan",
+  }));
+
+  vector<string> files;
+  ASSERT_OK(env_->Glob(JoinPathSegments(cluster_->tablet_server(0)->log_dir(),
+                                        "*.requests.*"), &files));
+  ASSERT_EQ(1, files.size());
+  string out;
+  string err;
+  ASSERT_OK(RunKuduTool({
+    "perf",
+    "replay",
+    cluster_->master()->bound_rpc_addr().ToString(),
+    files[0],
+    "--replay_speedup=0",
+    "--show_first_n_errors=1",
+  }, &out, &err));
+  // The scans succeed, while the rows inserted by the writes are already
+  // present.
+  ASSERT_STR_MATCHES(out, "scan *: count=[1-9][0-9]* errors=0");
+  ASSERT_STR_MATCHES(out, "write *: count=0 errors=[1-9]");
+  ASSERT_STR_CONTAINS(err, "already present");
+}
+
+// Run 'kudu perf wal' with synced appends and a concurrent data directory load.
+TEST_F(ToolTest, TestPerfWal) {
+  const string kWalDir = GetTestPath("wal");
+  const string kDataDir = GetTestPath("data");
+  ASSERT_OK(env_->CreateDir(kWalDir));
+  ASSERT_OK(env_->CreateDir(kDataDir));
+  string out;
+  ASSERT_OK(RunKuduTool({
+    "perf",
+    "wal",
+    kWalDir,
+    "--log_force_fsync_all",
+    "--num_threads=4",
+    "--wal_batch_size=2",
+    "--wal_num_batches_per_thread=50",
+    Substitute("--data_load_dirs=$0", kDataDir),
+  }, &out));
+  ASSERT_STR_CONTAINS(out, "batches total : 200");
+  ASSERT_STR_MATCHES(out, "sync latency_us\\(count=[1-9]");
+
+  // The temporary WAL and the data directory load files are deleted.
+  vector<string> children;
+  ASSERT_OK(env_->GetChildren(kWalDir, &children));
+  ASSERT_EQ(2, children.size());
+  ASSERT_OK(env_->GetChildren(kDataDir, &children));
+  ASSERT_EQ(2, children.size());
+}
+
+// Run 'kudu perf workload' with all the operations and key distributions.
+TEST_F(ToolTest, TestPerfWorkload) {
+  NO_FATALS(StartExternalMiniCluster());
+  for (const string& distribution : { "uniform", "zipfian", "latest" }) {
+    SCOPED_TRACE(distribution);
+    string out;
+    ASSERT_OK(RunKuduTool({
+      "perf",
+      "workload",
+      cluster_->master()->bound_rpc_addr().ToString(),
+      Substitute("--key_distribution=$0", distribution),
+      "--insert_pct=20",
+      "--upsert_pct=20",
+      "--update_pct=20",
+      "--read_pct=20",
+      "--scan_pct=20",
+      "--num_ops_per_thread=200",
+      "--num_threads=2",
+      "--workload_record_count=1000",
+    }, &out));
+    ASSERT_STR_CONTAINS(out, "ops total   : 400");
+    for (const char* op : { "insert", "upsert", "update", "read", "scan" }) {
+      ASSERT_STR_MATCHES(out, Substitute("$0 *: count=[0-9]+ errors=0", op));
+    }
+  }
+
+  // The operation percentages must add up to 100.
+  string err;
+  Status s = RunKuduTool({
+    "perf",
+    "workload",
+    cluster_->master()->bound_rpc_addr().ToString(),
+    "--read_pct=60",
+  }, nullptr, &err);
+  ASSERT_TRUE(s.IsRuntimeError()) << s.ToString();
+  ASSERT_STR_CONTAINS(err, "must add up to 100");
+}
+
 // Test 'kudu remote_replica copy' tool when the destination tablet server is online.
 // 1. Test the copy tool when the destination replica is healthy
 // 2. Test the copy tool when the destination replica is tombstoned
@@ -1615,6 +1797,78 @@ TEST_F(ToolTest, TestLocalReplicaTombstoneDelete) {
   }
 }
 
+// Test 'kudu local_replica bulk_load'.
+TEST_F(ToolTest, TestLocalReplicaBulkLoad) {
+  NO_FATALS(StartMiniCluster());
+  TestWorkload workload(mini_cluster_.get());
+  workload.set_num_replicas(1);
+  workload.Setup();
+
+  MiniTabletServer* ts = mini_cluster_->mini_tablet_server(0);
+  string tablet_id;
+  {
+    vector<scoped_refptr<TabletReplica>> tablet_replicas;
+    ts->server()->tablet_manager()->GetTabletReplicas(&tablet_replicas);
+    ASSERT_EQ(1, tablet_replicas.size());
+    tablet_id = tablet_replicas[0]->tablet_id();
+  }
+  const string& tserver_dir = ts->options()->fs_opts.wal_root;
+  ts->Shutdown();
+
+  // The workload's schema is (key INT32, int_val INT32, string_val STRING NULL).
+  const int kNumRows = 2500;
+  const string input_path = GetTestPath("rows.csv");
+  {
+    string rows;
+    for (int i = 0; i < kNumRows; i++) {
+      rows += Substitute("$0,$1,$2\n", i, i * 2, i % 2 == 0 ? Substitute("s$0", i) : "");
+    }
+    ASSERT_OK(WriteStringToFile(env_, rows, input_path));
+  }
+  const string bulk_load = Substitute("local_replica bulk_load $0 $1 "
+                                      "--fs_wal_dir=$2 --fs_data_dirs=$2",
+                                      tablet_id, input_path, tserver_dir);
+
+  // Rows that aren't sorted by primary key are rejected.
+  {
+    const string unsorted_path = GetTestPath("unsorted.csv");
+    ASSERT_OK(WriteStringToFile(env_, "1,1,a\n0,0,b\n", unsorted_path));
+    string stderr;
+    Status s = RunTool(Substitute("local_replica bulk_load $0 $1 "
+                                  "--fs_wal_dir=$2 --fs_data_dirs=$2",
+                                  tablet_id, unsorted_path, tserver_dir),
+                       nullptr, &stderr, nullptr, nullptr);
+    ASSERT_TRUE(s.IsRuntimeError());
+    ASSERT_STR_CONTAINS(stderr, "not in strictly increasing primary key order");
+  }
+
+  string stdout;
+  NO_FATALS(RunActionStdoutString(bulk_load, &stdout));
+  ASSERT_STR_CONTAINS(stdout, Substitute("Loaded $0 rows", kNumRows));
+
+  // The replica isn't empty anymore.
+  {
+    string stderr;
+    Status s = RunTool(bulk_load, nullptr, &stderr, nullptr, nullptr);
+    ASSERT_TRUE(s.IsRuntimeError());
+    ASSERT_STR_CONTAINS(stderr, "already has 1 rowset(s)");
+  }
+
+  ASSERT_OK(ts->Start());
+  ASSERT_OK(ts->WaitStarted());
+  shared_ptr<client::KuduClient> client;
+  ASSERT_OK(mini_cluster_->CreateClient(nullptr, &client));
+  shared_ptr<client::KuduTable> table;
+  ASSERT_OK(client->OpenTable(TestWorkload::kDefaultTableName, &table));
+  vector<string> rows;
+  ASSERT_EVENTUALLY([&] {
+    ScanTableToStrings(table.get(), &rows);
+    ASSERT_EQ(kNumRows, rows.size());
+  });
+  ASSERT_EQ("(int32 key=0, int32 int_val=0, string string_val=\"s0\")", rows[0]);
+  ASSERT_EQ("(int32 key=1, int32 int_val=2, string string_val=NULL)", rows[1]);
+}
+
 // Test for 'local_replica cmeta' functionality.
 TEST_F(ToolTest, TestLocalReplicaCMetaOps) {
   NO_FATALS(StartMiniCluster());
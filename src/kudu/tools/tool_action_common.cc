@@ -22,6 +22,7 @@
 #include <algorithm>
 #include <cerrno>
 #include <cstddef>
+#include <functional>
 #include <iomanip>
 #include <iostream>
 #include <memory>
@@ -48,11 +49,13 @@
 #include "kudu/consensus/log_util.h"
 #include "kudu/consensus/opid.pb.h"
 #include "kudu/gutil/endian.h"
+#include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/gutil/strings/numbers.h"
 #include "kudu/gutil/strings/split.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/sysinfo.h"
 #include "kudu/master/master.proxy.h" // IWYU pragma: keep
 #include "kudu/rpc/messenger.h"
 #include "kudu/rpc/rpc_controller.h"
@@ -72,6 +75,7 @@
 #include "kudu/util/net/sockaddr.h"
 #include "kudu/util/pb_util.h"
 #include "kudu/util/status.h"
+#include "kudu/util/threadpool.h"
 
 DEFINE_bool(force, false, "If true, allows the set_flag command to set a flag "
             "which is not explicitly marked as runtime-settable. Such flag "
@@ -93,6 +97,9 @@ DEFINE_string(columns, "", "Comma-separated list of column fields to include in
 DEFINE_string(format, "pretty",
               "Format to use for printing list output tables.\n"
               "Possible values: pretty, space, tsv, csv, and json");
+DEFINE_int32(fs_io_threads, 0,
+             "Number of threads used to open, check and read the blocks of the "
+             "local filesystem in parallel. If 0, uses one thread per CPU.");
 
 namespace boost {
 template <typename Signature>
@@ -375,6 +382,28 @@ Status SetServerFlag(const string& address, uint16_t default_port,
   }
 }
 
+int NumFsIoThreads() {
+  return FLAGS_fs_io_threads > 0 ? FLAGS_fs_io_threads : base::NumCPUs();
+}
+
+Status ParallelFor(size_t n, const std::function<Status(size_t)>& task) {
+  // Declared before the pool, so that it outlives any tasks still running if
+  // a submission fails.
+  vector<Status> statuses(n);
+  gscoped_ptr<ThreadPool> pool;
+  RETURN_NOT_OK(ThreadPoolBuilder("tool-fs-io")
+                .set_max_threads(NumFsIoThreads())
+                .Build(&pool));
+  for (size_t i = 0; i < n; i++) {
+    RETURN_NOT_OK(pool->SubmitFunc([&task, &statuses, i]() { statuses[i] = task(i); }));
+  }
+  pool->Wait();
+  for (const auto& s : statuses) {
+    RETURN_NOT_OK(s);
+  }
+  return Status::OK();
+}
+
 Status PrintServerStatus(const string& address, uint16_t default_port) {
   ServerStatusPB status;
   RETURN_NOT_OK(GetServerStatus(address, default_port, &status));
@@ -17,7 +17,9 @@
 
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <memory>
 #include <ostream>
 #include <string>
@@ -111,6 +113,16 @@ Status PrintServerTimestamp(const std::string& address, uint16_t default_port);
 Status SetServerFlag(const std::string& address, uint16_t default_port,
                      const std::string& flag, const std::string& value);
 
+// Returns the number of threads with which the tools read the local
+// filesystem, as per --fs_io_threads.
+int NumFsIoThreads();
+
+// Runs 'task' for each index in [0, 'n') on a pool of NumFsIoThreads()
+// threads. Used by the tools which read many blocks of the local filesystem.
+//
+// Returns the error of the task with the lowest index which failed, if any.
+Status ParallelFor(size_t n, const std::function<Status(size_t)>& task);
+
 // A table of data to present to the user.
 //
 // Supports formatting based on the --format flag.
@@ -18,6 +18,7 @@
 #include "kudu/tools/tool_action.h"
 
 #include <algorithm>
+#include <cstddef>
 #include <cstdint>
 #include <iostream>
 #include <iterator>
@@ -44,6 +45,7 @@
 #include "kudu/gutil/strings/numbers.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/tablet/tablet_metadata.h"
+#include "kudu/tools/tool_action_common.h"
 #include "kudu/util/env.h"
 #include "kudu/util/faststring.h"
 #include "kudu/util/pb_util.h"
@@ -51,6 +53,7 @@
 #include "kudu/util/status.h"
 
 DECLARE_bool(print_meta);
+DECLARE_int32(log_block_manager_open_threads);
 DEFINE_bool(print_rows, true,
             "Print each row in the CFile");
 DEFINE_string(uuid, "",
@@ -83,6 +86,9 @@ namespace {
 Status Check(const RunnerContext& /*context*/) {
   FsManagerOpts fs_opts;
   fs_opts.read_only = !FLAGS_repair;
+  // The block manager checks, and if --repair is set repairs, its containers
+  // while opening them, using as many threads as the rest of the check.
+  FLAGS_log_block_manager_open_threads = NumFsIoThreads();
   FsManager fs_manager(Env::Default(), std::move(fs_opts));
   FsReport report;
   RETURN_NOT_OK(fs_manager.Open(&report));
@@ -99,15 +105,20 @@ Status Check(const RunnerContext& /*context*/) {
   unordered_map<BlockId, string, BlockIdHash, BlockIdEqual> live_block_id_to_tablet;
   vector<string> tablet_ids;
   RETURN_NOT_OK(fs_manager.ListTabletIds(&tablet_ids));
-  for (const auto& t : tablet_ids) {
+  vector<vector<BlockId>> block_ids_by_tablet(tablet_ids.size());
+  RETURN_NOT_OK(ParallelFor(tablet_ids.size(), [&](size_t i) {
     scoped_refptr<TabletMetadata> meta;
-    RETURN_NOT_OK(TabletMetadata::Load(&fs_manager, t, &meta));
-    vector<BlockId> tablet_live_block_ids = meta->CollectBlockIds();
+    RETURN_NOT_OK(TabletMetadata::Load(&fs_manager, tablet_ids[i], &meta));
+    block_ids_by_tablet[i] = meta->CollectBlockIds();
+    return Status::OK();
+  }));
+  for (int i = 0; i < tablet_ids.size(); i++) {
+    const auto& tablet_live_block_ids = block_ids_by_tablet[i];
     live_block_ids.insert(live_block_ids.end(),
                           tablet_live_block_ids.begin(),
                           tablet_live_block_ids.end());
     for (const auto& id : tablet_live_block_ids) {
-      InsertOrDie(&live_block_id_to_tablet, id, t);
+      InsertOrDie(&live_block_id_to_tablet, id, tablet_ids[i]);
     }
   }
 
@@ -146,16 +157,16 @@ Status Check(const RunnerContext& /*context*/) {
     deletion_transaction = fs_manager.block_manager()->NewDeletionTransaction();
   }
   vector<BlockId> deleted;
-  for (const auto& id : orphaned_block_ids) {
-    // Opening a block isn't free, but the number of orphaned blocks shouldn't
-    // be extraordinarily high.
-    uint64_t size;
-    {
-      unique_ptr<ReadableBlock> block;
-      RETURN_NOT_OK(fs_manager.OpenBlock(id, &block));
-      RETURN_NOT_OK(block->Size(&size));
-    }
-    fs::OrphanedBlockCheck::Entry entry(id, size);
+  // Opening a block isn't free, so the orphaned blocks are sized in parallel.
+  vector<uint64_t> orphaned_block_sizes(orphaned_block_ids.size());
+  RETURN_NOT_OK(ParallelFor(orphaned_block_ids.size(), [&](size_t i) {
+    unique_ptr<ReadableBlock> block;
+    RETURN_NOT_OK(fs_manager.OpenBlock(orphaned_block_ids[i], &block));
+    return block->Size(&orphaned_block_sizes[i]);
+  }));
+  for (int i = 0; i < orphaned_block_ids.size(); i++) {
+    const auto& id = orphaned_block_ids[i];
+    fs::OrphanedBlockCheck::Entry entry(id, orphaned_block_sizes[i]);
 
     if (FLAGS_repair) {
       deletion_transaction->AddDeletedBlock(id);
@@ -337,6 +348,7 @@ unique_ptr<Mode> BuildFsMode() {
       .Description("Check a Kudu filesystem for inconsistencies")
       .AddOptionalParameter("fs_wal_dir")
       .AddOptionalParameter("fs_data_dirs")
+      .AddOptionalParameter("fs_io_threads")
       .AddOptionalParameter("repair")
       .Build();
 
@@ -18,12 +18,15 @@
 #include "kudu/tools/tool_action.h"
 
 #include <algorithm>
+#include <cerrno>
 #include <cstddef>
 #include <cstdint>
+#include <fstream>
 #include <iostream>
 #include <list>
 #include <map>
 #include <memory>
+#include <sstream>
 #include <string>
 #include <unordered_map>
 #include <utility>
@@ -37,11 +40,14 @@
 #include "kudu/cfile/cfile.pb.h"
 #include "kudu/cfile/cfile_reader.h"
 #include "kudu/cfile/cfile_util.h"
+#include "kudu/clock/hybrid_clock.h"
 #include "kudu/common/common.pb.h"
 #include "kudu/common/partition.h"
+#include "kudu/common/row.h"
 #include "kudu/common/row_changelist.h"
 #include "kudu/common/rowblock.h"
 #include "kudu/common/schema.h"
+#include "kudu/common/timestamp.h"
 #include "kudu/common/wire_protocol.h"
 #include "kudu/consensus/consensus.pb.h"
 #include "kudu/consensus/consensus_meta.h"
@@ -65,6 +71,7 @@
 #include "kudu/gutil/strings/stringpiece.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/gutil/strings/util.h"
+#include "kudu/gutil/walltime.h"
 #include "kudu/master/sys_catalog.h"
 #include "kudu/rpc/messenger.h"
 #include "kudu/tablet/cfile_set.h"
@@ -72,16 +79,21 @@
 #include "kudu/tablet/delta_stats.h"
 #include "kudu/tablet/delta_store.h"
 #include "kudu/tablet/deltafile.h"
+#include "kudu/tablet/diskrowset.h"
 #include "kudu/tablet/metadata.pb.h"
+#include "kudu/tablet/mutation.h"
 #include "kudu/tablet/mvcc.h"
 #include "kudu/tablet/rowset_metadata.h"
+#include "kudu/tablet/tablet.h"
 #include "kudu/tablet/tablet_metadata.h"
 #include "kudu/tablet/tablet_replica.h"
 #include "kudu/tools/tool_action_common.h"
 #include "kudu/tserver/tablet_copy_client.h"
 #include "kudu/tserver/ts_tablet_manager.h"
 #include "kudu/util/env.h"
+#include "kudu/util/errno.h"
 #include "kudu/util/env_util.h"
+#include "kudu/util/faststring.h"
 #include "kudu/util/mem_tracker.h"
 #include "kudu/util/memory/arena.h"
 #include "kudu/util/metrics.h"
@@ -104,6 +116,17 @@ DEFINE_bool(clean_unsafe, false,
             "This is not guaranteed to be safe because it also removes the "
             "consensus metadata (including Raft voting record) for the "
             "specified tablet, which violates the Raft vote durability requirements.");
+DEFINE_string(bulk_load_delimiter, ",",
+              "Delimiter between the fields of the rows in the input file of "
+              "'local_replica bulk_load'. Fields may not contain the delimiter.");
+DEFINE_int64(bulk_load_timestamp_micros, 0,
+             "Physical time, in microseconds since the Unix epoch, at which the "
+             "rows loaded by 'local_replica bulk_load' become visible to snapshot "
+             "scans. Use the same value when loading every replica of a tablet. "
+             "If 0, the current time is used.");
+
+DECLARE_int32(budgeted_compaction_target_rowset_size);
+DECLARE_int32(log_block_manager_open_threads);
 
 namespace kudu {
 namespace tools {
@@ -112,6 +135,7 @@ using cfile::CFileIterator;
 using cfile::CFileReader;
 using cfile::DumpIterator;
 using cfile::ReaderOptions;
+using clock::HybridClock;
 using consensus::ConsensusMetadata;
 using consensus::ConsensusMetadataManager;
 using consensus::OpId;
@@ -142,9 +166,13 @@ using tablet::DeltaFileReader;
 using tablet::DeltaIterator;
 using tablet::DeltaKeyAndUpdate;
 using tablet::DeltaType;
+using tablet::Mutation;
 using tablet::MvccSnapshot;
+using tablet::RollingDiskRowSetWriter;
 using tablet::RowSetMetadata;
+using tablet::RowSetMetadataVector;
 using tablet::TabletMetadata;
+using tablet::Tablet;
 using tablet::TabletDataState;
 using tserver::TabletCopyClient;
 using tserver::TSTabletManager;
@@ -155,6 +183,7 @@ const char* const kSeparatorLine =
     "----------------------------------------------------------------------\n";
 
 const char* const kTermArg = "term";
+const char* const kInputPathArg = "input_path";
 
 const char* const kTabletIdGlobArg = "tablet_id_pattern";
 const char* const kTabletIdGlobArgDesc = "Tablet identifier pattern. "
@@ -168,6 +197,7 @@ string Indent(int indent) {
 Status FsInit(unique_ptr<FsManager>* fs_manager) {
   FsManagerOpts fs_opts;
   fs_opts.read_only = true;
+  FLAGS_log_block_manager_open_threads = NumFsIoThreads();
   unique_ptr<FsManager> fs_ptr(new FsManager(Env::Default(), fs_opts));
   RETURN_NOT_OK(fs_ptr->Open());
   fs_manager->swap(fs_ptr);
@@ -406,26 +436,218 @@ Status DeleteLocalReplica(const RunnerContext& context) {
   return Status::OK();
 }
 
-Status SummarizeSize(FsManager* fs,
-                     const vector<BlockId>& blocks,
-                     StringPiece block_type,
-                     int64_t* running_sum) {
-  int64_t local_sum = 0;
-  for (const auto& b : blocks) {
-    unique_ptr<fs::ReadableBlock> rb;
-    RETURN_NOT_OK_PREPEND(fs->OpenBlock(b, &rb),
-                          Substitute("could not open block $0", b.ToString()));
-    uint64_t size = 0;
-    RETURN_NOT_OK_PREPEND(rb->Size(&size),
-                          Substitute("could not get size for block $0", b.ToString()));
-    local_sum += size;
-    if (VLOG_IS_ON(1)) {
-      cout << Substitute("$0 block $1: $2 bytes $3",
-                         block_type, b.ToString(),
-                         size, HumanReadableNumBytes::ToString(size)) << endl;
+namespace {
+
+// Parses 'field' into the cell 'col_idx' of 'row'. Variable-length data is
+// copied into 'arena'.
+Status ParseCell(const StringPiece& field, int col_idx, Arena* arena, ContiguousRow* row) {
+  const ColumnSchema& col = row->schema()->column(col_idx);
+  if (col.is_nullable()) {
+    row->set_null(col_idx, field.empty());
+    if (field.empty()) {
+      return Status::OK();
+    }
+  }
+  const string str = field.ToString();
+  uint8_t* cell = row->mutable_cell_ptr(col_idx);
+  int64_t int_value;
+  bool ok = true;
+  switch (col.type_info()->type()) {
+    case INT8:
+      ok = safe_strto64(str, &int_value) && int_value >= INT8_MIN && int_value <= INT8_MAX;
+      *reinterpret_cast<int8_t*>(cell) = int_value;
+      break;
+    case INT16:
+      ok = safe_strto64(str, &int_value) && int_value >= INT16_MIN && int_value <= INT16_MAX;
+      *reinterpret_cast<int16_t*>(cell) = int_value;
+      break;
+    case INT32:
+      ok = safe_strto32(str, reinterpret_cast<int32_t*>(cell));
+      break;
+    case INT64:
+    case UNIXTIME_MICROS:
+      ok = safe_strto64(str, reinterpret_cast<int64_t*>(cell));
+      break;
+    case BOOL:
+      if (str == "true" || str == "1") {
+        *reinterpret_cast<bool*>(cell) = true;
+      } else if (str == "false" || str == "0") {
+        *reinterpret_cast<bool*>(cell) = false;
+      } else {
+        ok = false;
+      }
+      break;
+    case FLOAT:
+      ok = safe_strtof(str, reinterpret_cast<float*>(cell));
+      break;
+    case DOUBLE:
+      ok = safe_strtod(str, reinterpret_cast<double*>(cell));
+      break;
+    case STRING:
+    case BINARY: {
+      Slice* slice = reinterpret_cast<Slice*>(cell);
+      if (!arena->RelocateSlice(Slice(str), slice)) {
+        return Status::RuntimeError("unable to allocate memory for a cell");
+      }
+      break;
+    }
+    default:
+      return Status::NotSupported(Substitute("column $0 has unsupported type $1",
+                                             col.name(), col.type_info()->name()));
+  }
+  if (!ok) {
+    return Status::InvalidArgument(Substitute("invalid value '$0' for column $1 of type $2",
+                                              str, col.name(), col.type_info()->name()));
+  }
+  return Status::OK();
+}
+
+// Returns an error unless the replica holds no data: it has no rowsets and
+// its WAL has no writes that would be replayed into a MemRowSet on startup.
+Status CheckReplicaIsEmpty(FsManager* fs, const TabletMetadata& meta) {
+  if (meta.tablet_data_state() != TabletDataState::TABLET_DATA_READY) {
+    return Status::IllegalState(Substitute("tablet $0 is in state $1", meta.tablet_id(),
+                                           TabletDataState_Name(meta.tablet_data_state())));
+  }
+  if (!meta.rowsets().empty()) {
+    return Status::IllegalState(Substitute("tablet $0 already has $1 rowset(s)",
+                                           meta.tablet_id(), meta.rowsets().size()));
+  }
+  shared_ptr<LogReader> reader;
+  Status s = LogReader::Open(fs, scoped_refptr<LogIndex>(), meta.tablet_id(),
+                             scoped_refptr<MetricEntity>(), &reader);
+  if (s.IsNotFound()) {
+    return Status::OK();
+  }
+  RETURN_NOT_OK(s);
+  SegmentSequence segments;
+  RETURN_NOT_OK(reader->GetSegmentsSnapshot(&segments));
+  for (const auto& segment : segments) {
+    LogEntryReader entry_reader(segment.get());
+    while (true) {
+      LogEntryPB entry;
+      s = entry_reader.ReadNextEntry(&entry);
+      if (s.IsEndOfFile()) break;
+      RETURN_NOT_OK_PREPEND(s, "Error in log segment");
+      if (entry.type() == log::REPLICATE &&
+          entry.replicate().op_type() == consensus::WRITE_OP) {
+        return Status::IllegalState(Substitute("the WAL of tablet $0 contains writes",
+                                               meta.tablet_id()));
+      }
+    }
+  }
+  return Status::OK();
+}
+
+} // anonymous namespace
+
+Status BulkLoad(const RunnerContext& context) {
+  const string& tablet_id = FindOrDie(context.required_args, kTabletIdArg);
+  const string& input_path = FindOrDie(context.required_args, kInputPathArg);
+  if (FLAGS_bulk_load_delimiter.empty()) {
+    return Status::InvalidArgument("--bulk_load_delimiter must not be empty");
+  }
+  const Timestamp timestamp = HybridClock::TimestampFromMicroseconds(
+      FLAGS_bulk_load_timestamp_micros > 0 ? FLAGS_bulk_load_timestamp_micros
+                                           : GetCurrentTimeMicros());
+
+  FsManager fs_manager(Env::Default(), FsManagerOpts());
+  RETURN_NOT_OK(fs_manager.Open());
+  scoped_refptr<TabletMetadata> meta;
+  RETURN_NOT_OK(TabletMetadata::Load(&fs_manager, tablet_id, &meta));
+  RETURN_NOT_OK(CheckReplicaIsEmpty(&fs_manager, *meta.get()));
+
+  std::ifstream input(input_path);
+  if (!input) {
+    return Status::IOError(Substitute("unable to open $0", input_path), ErrnoToString(errno));
+  }
+
+  const Schema& schema = meta->schema();
+  RollingDiskRowSetWriter writer(meta.get(), schema, Tablet::DefaultBloomSizing(),
+                                 FLAGS_budgeted_compaction_target_rowset_size);
+  RETURN_NOT_OK_PREPEND(writer.Open(), "Failed to open DiskRowSet writer");
+
+  // Rows are parsed into 'row' and then copied into 'block'. Every row gets
+  // an UNDO delete at 'timestamp', like rows flushed from a MemRowSet, so that
+  // snapshot scans at earlier timestamps don't see it.
+  static const int kBlockNumRows = 1000;
+  Arena arena(1024 * 1024);
+  RowBlock block(schema, kBlockNumRows, &arena);
+  vector<uint8_t> row_buf(ContiguousRowHelper::row_size(schema));
+  ContiguousRow row(&schema, row_buf.data());
+  faststring undo_buf;
+  RowChangeListEncoder undo_encoder(&undo_buf);
+  undo_encoder.SetToDelete();
+  faststring last_key;
+  faststring key;
+  int64_t num_rows = 0;
+  int n = 0;
+
+  auto flush_block = [&]() -> Status {
+    for (int i = 0; i < n; i++) {
+      Mutation* undo = Mutation::CreateInArena(&arena, timestamp, undo_encoder.as_changelist());
+      rowid_t row_idx_in_drs;
+      RETURN_NOT_OK(writer.AppendUndoDeltas(i, undo, &row_idx_in_drs));
+    }
+    block.Resize(n);
+    RETURN_NOT_OK(writer.AppendBlock(block));
+    RETURN_NOT_OK(writer.RollIfNecessary());
+    block.Resize(block.row_capacity());
+    arena.Reset();
+    n = 0;
+    return Status::OK();
+  };
+
+  string line;
+  int64_t line_num = 0;
+  while (std::getline(input, line)) {
+    line_num++;
+    vector<StringPiece> fields = Split(line, FLAGS_bulk_load_delimiter);
+    if (fields.size() != schema.num_columns()) {
+      return Status::InvalidArgument(Substitute("line $0 has $1 fields, expected $2",
+                                                line_num, fields.size(), schema.num_columns()));
     }
+    for (int i = 0; i < schema.num_columns(); i++) {
+      RETURN_NOT_OK_PREPEND(ParseCell(fields[i], i, &arena, &row),
+                            Substitute("line $0", line_num));
+    }
+
+    bool in_partition;
+    RETURN_NOT_OK(meta->partition_schema().PartitionContainsRow(
+        meta->partition(), ConstContiguousRow(row), &in_partition));
+    if (!in_partition) {
+      return Status::InvalidArgument(Substitute(
+          "line $0: row $1 does not belong to tablet $2", line_num,
+          schema.DebugRowKey(row), tablet_id));
+    }
+    schema.EncodeComparableKey(row, &key);
+    if (num_rows > 0 && Slice(key).compare(Slice(last_key)) <= 0) {
+      return Status::InvalidArgument(Substitute(
+          "line $0: row $1 is not in strictly increasing primary key order", line_num,
+          schema.DebugRowKey(row)));
+    }
+    last_key.assign_copy(key.data(), key.size());
+
+    RowBlockRow dst = block.row(n);
+    RETURN_NOT_OK(CopyRow(row, &dst, static_cast<Arena*>(nullptr)));
+    num_rows++;
+    if (++n == kBlockNumRows) {
+      RETURN_NOT_OK(flush_block());
+    }
+  }
+  if (input.bad()) {
+    return Status::IOError(Substitute("error reading $0", input_path), ErrnoToString(errno));
+  }
+  if (n > 0) {
+    RETURN_NOT_OK(flush_block());
   }
-  *running_sum += local_sum;
+  RETURN_NOT_OK_PREPEND(writer.Finish(), "Failed to finish DiskRowSet writer");
+
+  RowSetMetadataVector new_metas;
+  writer.GetWrittenRowSetMetadata(&new_metas);
+  RETURN_NOT_OK(meta->UpdateAndFlush({}, new_metas, TabletMetadata::kNoMrsFlushed));
+  cout << Substitute("Loaded $0 rows into $1 rowset(s) of tablet $2 at timestamp $3",
+                     num_rows, new_metas.size(), tablet_id, timestamp.ToString()) << endl;
   return Status::OK();
 }
 
@@ -468,6 +690,13 @@ struct TabletSizeStats {
 };
 } // anonymous namespace
 
+// A block whose size is to be added to a size summary.
+struct BlockToSummarize {
+  BlockId block_id;
+  string block_type;
+  int64_t* bytes;
+};
+
 Status SummarizeDataSize(const RunnerContext& context) {
   const string& tablet_id_pattern = FindOrDie(context.required_args, kTabletIdGlobArg);
   unique_ptr<FsManager> fs;
@@ -475,44 +704,95 @@ Status SummarizeDataSize(const RunnerContext& context) {
 
   vector<string> tablets;
   RETURN_NOT_OK(fs->ListTabletIds(&tablets));
-
-  std::unordered_map<string, TabletSizeStats> size_stats_by_table_id;
-
-  DataTable output_table({ "table id", "tablet id", "rowset id", "block type", "size" });
-
-  for (const string& tablet_id : tablets) {
-    TabletSizeStats tablet_stats;
-    if (!MatchPattern(tablet_id, tablet_id_pattern)) continue;
-    scoped_refptr<TabletMetadata> meta;
-    RETURN_NOT_OK_PREPEND(TabletMetadata::Load(fs.get(), tablet_id, &meta),
-                          Substitute("could not load tablet metadata for $0", tablet_id));
-    const string& table_id = meta->table_id();
+  tablets.erase(std::remove_if(tablets.begin(), tablets.end(),
+                               [&](const string& tablet_id) {
+                                 return !MatchPattern(tablet_id, tablet_id_pattern);
+                               }),
+                tablets.end());
+
+  vector<scoped_refptr<TabletMetadata>> metas(tablets.size());
+  RETURN_NOT_OK(ParallelFor(tablets.size(), [&](size_t i) {
+    RETURN_NOT_OK_PREPEND(TabletMetadata::Load(fs.get(), tablets[i], &metas[i]),
+                          Substitute("could not load tablet metadata for $0", tablets[i]));
+    return Status::OK();
+  }));
+
+  // Collect the blocks of every rowset, along with the stats that their
+  // sizes are added to, so that the blocks of all of the tablets can be
+  // opened in parallel.
+  vector<vector<TabletSizeStats>> rowset_stats(tablets.size());
+  vector<BlockToSummarize> blocks;
+  for (int i = 0; i < tablets.size(); i++) {
+    const auto& meta = metas[i];
+    rowset_stats[i].resize(meta->rowsets().size());
+    int j = 0;
     for (const shared_ptr<RowSetMetadata>& rs_meta : meta->rowsets()) {
-      TabletSizeStats rowset_stats;
-      RETURN_NOT_OK(SummarizeSize(fs.get(), rs_meta->redo_delta_blocks(),
-                                  "REDO", &rowset_stats.redo_bytes));
-      RETURN_NOT_OK(SummarizeSize(fs.get(), rs_meta->undo_delta_blocks(),
-                                  "UNDO", &rowset_stats.undo_bytes));
-      RETURN_NOT_OK(SummarizeSize(fs.get(), { rs_meta->bloom_block() },
-                                  "Bloom", &rowset_stats.bloom_bytes));
+      TabletSizeStats* stats = &rowset_stats[i][j++];
+      for (const auto& b : rs_meta->redo_delta_blocks()) {
+        blocks.push_back({ b, "REDO", &stats->redo_bytes });
+      }
+      for (const auto& b : rs_meta->undo_delta_blocks()) {
+        blocks.push_back({ b, "UNDO", &stats->undo_bytes });
+      }
+      blocks.push_back({ rs_meta->bloom_block(), "Bloom", &stats->bloom_bytes });
       if (rs_meta->has_adhoc_index_block()) {
-        RETURN_NOT_OK(SummarizeSize(fs.get(), { rs_meta->adhoc_index_block() },
-                                    "PK index", &rowset_stats.pk_index_bytes));
+        blocks.push_back({ rs_meta->adhoc_index_block(), "PK index", &stats->pk_index_bytes });
       }
-      const auto& column_blocks_by_id = rs_meta->GetColumnBlocksById();
-      for (const auto& e : column_blocks_by_id) {
-        const auto& col_id = e.first;
-        const auto& block = e.second;
+      const auto col_key = [&](ColumnId col_id) {
         const auto& col_idx = meta->schema().find_column_by_id(col_id);
-        string col_key = Substitute(
+        return Substitute(
             "c$0 ($1)", col_id,
             (col_idx != Schema::kColumnNotFound) ?
                 meta->schema().column(col_idx).name() : "?");
-        RETURN_NOT_OK(SummarizeSize(
-            fs.get(), { block }, col_key, &rowset_stats.column_bytes[col_key]));
+      };
+      const auto& column_blocks_by_id = rs_meta->GetColumnBlocksById();
+      for (const auto& e : column_blocks_by_id) {
+        string key = col_key(e.first);
+        blocks.push_back({ e.second, key, &stats->column_bytes[key] });
       }
-      rowset_stats.AddToTable(table_id, tablet_id, std::to_string(rs_meta->id()), &output_table);
-      tablet_stats.Add(rowset_stats);
+      // The secondary indexes and bloom filters are accounted for as columns
+      // of their own.
+      for (const auto& e : rs_meta->GetSecondaryIndexBlocksById()) {
+        string key = col_key(e.first) + " index";
+        blocks.push_back({ e.second, key, &stats->column_bytes[key] });
+      }
+      for (const auto& e : rs_meta->GetColumnBloomFilterBlocksById()) {
+        string key = col_key(e.first) + " bloom";
+        blocks.push_back({ e.second, key, &stats->column_bytes[key] });
+      }
+    }
+  }
+
+  vector<uint64_t> sizes(blocks.size());
+  RETURN_NOT_OK(ParallelFor(blocks.size(), [&](size_t i) {
+    const BlockId& b = blocks[i].block_id;
+    unique_ptr<fs::ReadableBlock> rb;
+    RETURN_NOT_OK_PREPEND(fs->OpenBlock(b, &rb),
+                          Substitute("could not open block $0", b.ToString()));
+    RETURN_NOT_OK_PREPEND(rb->Size(&sizes[i]),
+                          Substitute("could not get size for block $0", b.ToString()));
+    return Status::OK();
+  }));
+  for (int i = 0; i < blocks.size(); i++) {
+    *blocks[i].bytes += sizes[i];
+    if (VLOG_IS_ON(1)) {
+      cout << Substitute("$0 block $1: $2 bytes $3",
+                         blocks[i].block_type, blocks[i].block_id.ToString(),
+                         sizes[i], HumanReadableNumBytes::ToString(sizes[i])) << endl;
+    }
+  }
+
+  std::unordered_map<string, TabletSizeStats> size_stats_by_table_id;
+  DataTable output_table({ "table id", "tablet id", "rowset id", "block type", "size" });
+  for (int i = 0; i < tablets.size(); i++) {
+    const string& tablet_id = tablets[i];
+    const string& table_id = metas[i]->table_id();
+    TabletSizeStats tablet_stats;
+    int j = 0;
+    for (const shared_ptr<RowSetMetadata>& rs_meta : metas[i]->rowsets()) {
+      const TabletSizeStats& stats = rowset_stats[i][j++];
+      stats.AddToTable(table_id, tablet_id, std::to_string(rs_meta->id()), &output_table);
+      tablet_stats.Add(stats);
     }
     tablet_stats.AddToTable(table_id, tablet_id, "*", &output_table);
     size_stats_by_table_id[table_id].Add(tablet_stats);
@@ -647,24 +927,25 @@ Status ListLocalReplicas(const RunnerContext& context) {
 
 Status DumpCFileBlockInternal(FsManager* fs_manager,
                               const BlockId& block_id,
-                              int indent) {
+                              int indent,
+                              std::ostream* out) {
   unique_ptr<ReadableBlock> block;
   RETURN_NOT_OK(fs_manager->OpenBlock(block_id, &block));
   unique_ptr<CFileReader> reader;
   RETURN_NOT_OK(CFileReader::Open(std::move(block), ReaderOptions(), &reader));
 
-  cout << Indent(indent) << "CFile Header: "
+  *out << Indent(indent) << "CFile Header: "
        << pb_util::SecureShortDebugString(reader->header()) << endl;
   if (!FLAGS_dump_data) {
     return Status::OK();
   }
-  cout << Indent(indent) << reader->footer().num_values()
+  *out << Indent(indent) << reader->footer().num_values()
        << " values:" << endl;
 
   gscoped_ptr<CFileIterator> it;
   RETURN_NOT_OK(reader->NewIterator(&it, CFileReader::DONT_CACHE_BLOCK));
   RETURN_NOT_OK(it->SeekToFirst());
-  return DumpIterator(*reader, it.get(), &cout, FLAGS_nrows, indent + 2);
+  return DumpIterator(*reader, it.get(), out, FLAGS_nrows, indent + 2);
 }
 
 Status DumpDeltaCFileBlockInternal(FsManager* fs_manager,
@@ -672,7 +953,8 @@ Status DumpDeltaCFileBlockInternal(FsManager* fs_manager,
                                    const shared_ptr<RowSetMetadata>& rs_meta,
                                    const BlockId& block_id,
                                    DeltaType delta_type,
-                                   int indent) {
+                                   int indent,
+                                   std::ostream* out) {
   // Open the delta reader
   unique_ptr<ReadableBlock> readable_block;
   RETURN_NOT_OK(fs_manager->OpenBlock(block_id, &readable_block));
@@ -682,7 +964,7 @@ Status DumpDeltaCFileBlockInternal(FsManager* fs_manager,
                                       ReaderOptions(),
                                       &delta_reader));
 
-  cout << Indent(indent) << "Delta stats: "
+  *out << Indent(indent) << "Delta stats: "
        << delta_reader->delta_stats().ToString() << endl;
   if (FLAGS_metadata_only) {
     return Status::OK();
@@ -704,7 +986,7 @@ Status DumpDeltaCFileBlockInternal(FsManager* fs_manager,
   Status s = delta_reader->NewDeltaIterator(&schema, snap_all, &raw_iter);
 
   if (s.IsNotFound()) {
-    cout << "Empty delta block." << endl;
+    *out << "Empty delta block." << endl;
     return Status::OK();
   }
   RETURN_NOT_OK(s);
@@ -755,14 +1037,14 @@ Status DumpDeltaCFileBlockInternal(FsManager* fs_manager,
 
     RETURN_NOT_OK(delta_iter->PrepareBatch(
         n, DeltaIterator::PREPARE_FOR_COLLECT));
-    vector<DeltaKeyAndUpdate> out;
+    vector<DeltaKeyAndUpdate> deltas;
     RETURN_NOT_OK(
         delta_iter->FilterColumnIdsAndCollectDeltas(vector<ColumnId>(),
-                                                              &out,
+                                                              &deltas,
                                                               &arena));
-    for (const DeltaKeyAndUpdate& upd : out) {
+    for (const DeltaKeyAndUpdate& upd : deltas) {
       if (FLAGS_dump_data) {
-        cout << Indent(indent) << upd.key.ToString() << " "
+        *out << Indent(indent) << upd.key.ToString() << " "
              << RowChangeList(upd.cell).ToString(schema) << endl;
         ++ndeltas;
       }
@@ -780,11 +1062,12 @@ Status DumpDeltaCFileBlockInternal(FsManager* fs_manager,
 Status DumpRowSetInternal(FsManager* fs_manager,
                           const Schema& schema,
                           const shared_ptr<RowSetMetadata>& rs_meta,
-                          int indent) {
+                          int indent,
+                          std::ostream* out) {
   tablet::RowSetDataPB pb;
   rs_meta->ToProtobuf(&pb);
 
-  cout << Indent(indent) << "RowSet metadata: " << pb_util::SecureDebugString(pb)
+  *out << Indent(indent) << "RowSet metadata: " << pb_util::SecureDebugString(pb)
        << endl << endl;
 
   RowSetMetadata::ColumnIdToBlockIdMap col_blocks =
@@ -794,41 +1077,43 @@ Status DumpRowSetInternal(FsManager* fs_manager,
     ColumnId col_id = e.first;
     const BlockId& block_id = e.second;
 
-    cout << Indent(indent) << "Dumping column block " << block_id
+    *out << Indent(indent) << "Dumping column block " << block_id
          << " for column id " << col_id;
     int col_idx = schema.find_column_by_id(col_id);
     if (col_idx != -1) {
-      cout << "( " << schema.column(col_idx).ToString() <<  ")";
+      *out << "( " << schema.column(col_idx).ToString() <<  ")";
     }
-    cout << ":" << endl;
-    cout << Indent(indent) << kSeparatorLine;
+    *out << ":" << endl;
+    *out << Indent(indent) << kSeparatorLine;
     if (FLAGS_metadata_only) continue;
-    RETURN_NOT_OK(DumpCFileBlockInternal(fs_manager, block_id, indent));
-    cout << endl;
+    RETURN_NOT_OK(DumpCFileBlockInternal(fs_manager, block_id, indent, out));
+    *out << endl;
   }
 
   for (const BlockId& block : rs_meta->undo_delta_blocks()) {
-    cout << Indent(indent) << "Dumping undo delta block " << block << ":"
+    *out << Indent(indent) << "Dumping undo delta block " << block << ":"
          << endl << Indent(indent) << kSeparatorLine;
     RETURN_NOT_OK(DumpDeltaCFileBlockInternal(fs_manager,
                                               schema,
                                               rs_meta,
                                               block,
                                               tablet::UNDO,
-                                              indent));
-    cout << endl;
+                                              indent,
+                                              out));
+    *out << endl;
   }
 
   for (const BlockId& block : rs_meta->redo_delta_blocks()) {
-    cout << Indent(indent) << "Dumping redo delta block " << block << ":"
+    *out << Indent(indent) << "Dumping redo delta block " << block << ":"
          << endl << Indent(indent) << kSeparatorLine;
     RETURN_NOT_OK(DumpDeltaCFileBlockInternal(fs_manager,
                                               schema,
                                               rs_meta,
                                               block,
                                               tablet::REDO,
-                                              indent));
-    cout << endl;
+                                              indent,
+                                              out));
+    *out << endl;
   }
 
   return Status::OK();
@@ -852,7 +1137,7 @@ Status DumpRowSet(const RunnerContext& context) {
     for (const shared_ptr<RowSetMetadata>& rs_meta : meta->rowsets())  {
       if (rs_meta->id() == FLAGS_rowset_index) {
         return DumpRowSetInternal(fs_manager.get(), meta->schema(),
-                                  rs_meta, 0);
+                                  rs_meta, 0, &cout);
       }
     }
     return Status::InvalidArgument(
@@ -860,12 +1145,23 @@ Status DumpRowSet(const RunnerContext& context) {
                    FLAGS_rowset_index, tablet_id));
   }
 
-  // Rowset index not provided, dump all rowsets
-  size_t idx = 0;
-  for (const shared_ptr<RowSetMetadata>& rs_meta : meta->rowsets())  {
-    cout << endl << "Dumping rowset " << idx++ << endl << kSeparatorLine;
-    RETURN_NOT_OK(DumpRowSetInternal(fs_manager.get(), meta->schema(),
-                                     rs_meta, 2));
+  // Rowset index not provided, dump all rowsets. They're dumped in parallel
+  // into memory, a batch of as many rowsets as there are threads at a time,
+  // and printed in order.
+  const RowSetMetadataVector& rowsets = meta->rowsets();
+  const size_t batch_size = NumFsIoThreads();
+  for (size_t start = 0; start < rowsets.size(); start += batch_size) {
+    const size_t end = std::min(start + batch_size, rowsets.size());
+    vector<std::ostringstream> dumps(end - start);
+    Status s = ParallelFor(end - start, [&](size_t i) {
+      return DumpRowSetInternal(fs_manager.get(), meta->schema(),
+                                rowsets[start + i], 2, &dumps[i]);
+    });
+    for (size_t i = 0; i < dumps.size(); i++) {
+      cout << endl << "Dumping rowset " << start + i << endl << kSeparatorLine
+           << dumps[i].str();
+    }
+    RETURN_NOT_OK(s);
   }
   return Status::OK();
 }
@@ -902,6 +1198,7 @@ unique_ptr<Mode> BuildDumpMode() {
       .AddOptionalParameter("dump_data")
       .AddOptionalParameter("fs_wal_dir")
       .AddOptionalParameter("fs_data_dirs")
+      .AddOptionalParameter("fs_io_threads")
       .AddOptionalParameter("metadata_only")
       .AddOptionalParameter("nrows")
       .AddOptionalParameter("rowset_index")
@@ -970,6 +1267,25 @@ unique_ptr<Mode> BuildLocalReplicaMode() {
       .AddAction(std::move(set_term))
       .Build();
 
+  unique_ptr<Action> bulk_load =
+      ActionBuilder("bulk_load", &BulkLoad)
+      .Description("Load rows from a file directly into new rowsets of an empty "
+          "tablet replica. The tablet server must be stopped.")
+      .ExtraDescription("Each line of the input file is a row whose fields are "
+          "separated by --bulk_load_delimiter, in the order of the table's "
+          "columns. An empty field is NULL in a nullable column. The rows must "
+          "belong to the tablet and be sorted by primary key. The rows are "
+          "written straight into DiskRowSets, bypassing the WAL, the MemRowSet "
+          "and compactions. They are not replicated: load the same file into "
+          "every replica of the tablet, with the same --bulk_load_timestamp_micros.")
+      .AddRequiredParameter({ kTabletIdArg, kTabletIdArgDesc })
+      .AddRequiredParameter({ kInputPathArg, "Path to the file of rows to load" })
+      .AddOptionalParameter("fs_wal_dir")
+      .AddOptionalParameter("fs_data_dirs")
+      .AddOptionalParameter("bulk_load_delimiter")
+      .AddOptionalParameter("bulk_load_timestamp_micros")
+      .Build();
+
   unique_ptr<Action> copy_from_remote =
       ActionBuilder("copy_from_remote", &CopyFromRemote)
       .Description("Copy a tablet replica from a remote server")
@@ -1004,12 +1320,14 @@ unique_ptr<Mode> BuildLocalReplicaMode() {
       .AddRequiredParameter({ kTabletIdGlobArg, kTabletIdGlobArgDesc })
       .AddOptionalParameter("fs_wal_dir")
       .AddOptionalParameter("fs_data_dirs")
+      .AddOptionalParameter("fs_io_threads")
       .AddOptionalParameter("format")
       .Build();
 
   return ModeBuilder("local_replica")
       .Description("Operate on local tablet replicas via the local filesystem")
       .AddMode(std::move(cmeta))
+      .AddAction(std::move(bulk_load))
       .AddAction(std::move(copy_from_remote))
       .AddAction(std::move(data_size))
       .AddAction(std::move(delete_local_replica))
@@ -104,10 +104,49 @@
 // so for the example above each run increments the sequence number by 10000:
 // 1000 rows per thread * 2 threads * 5 columns
 //
+//
+// The 'table_scan' action scans an existing table through scan tokens, one
+// tablet per thread at a time, and reports the scan rate and per-tablet skew:
+//
+//   kudu perf table_scan 127.0.0.1 t3 --num_threads=4
+//
+//
+// The 'workload' action runs a YCSB-style mix of operations against an
+// auto-created table and reports the latency percentiles of each operation.
+// For example, 95% point lookups and 5% inserts with the most recently
+// inserted keys being the most popular (YCSB's workload D):
+//
+//   kudu perf workload 127.0.0.1 --read_pct=95 --insert_pct=5 \
+//     --update_pct=0 --key_distribution=latest --num_threads=8
+//
+//
+// The 'replay' action replays the write and scan requests captured by tablet
+// servers running with --request_capture_sampling_rate > 0 against another
+// cluster with the same tables, at the pace they were received, e.g. to
+// compare the latencies of a candidate configuration or release with those
+// of the current one under the same traffic:
+//
+//   kudu perf replay 127.0.0.1 /var/log/kudu/kudu-tserver.*.requests.*
+//
+//
+// The 'wal' action appends to a temporary WAL on the given device through the
+// real Log code path and reports the append and sync latencies, e.g. of
+// durable appends of 4 KiB operations from 16 threads while another disk is
+// loaded with writes:
+//
+//   kudu perf wal /mnt/ssd0 --log_force_fsync_all --num_threads=16 \
+//     --wal_op_size_bytes=4096 --data_load_dirs=/mnt/disk1
+//
 
+#include "kudu/client/client.pb.h"
+#include "kudu/common/row_operations.h"
+#include "kudu/common/wire_protocol.h"
+#include "kudu/common/wire_protocol.pb.h"
 #include "kudu/tools/tool_action.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <cstdint>
 #include <cstdlib>
 #include <iomanip>
@@ -122,23 +161,44 @@
 #include <vector>
 
 #include <gflags/gflags.h>
+#include <glog/logging.h>
 
 #include "kudu/client/client.h"
 #include "kudu/client/scan_batch.h"
+#include "kudu/client/scan_predicate.h"
 #include "kudu/client/schema.h"
 #include "kudu/client/shared_ptr.h"
+#include "kudu/client/value.h"
 #include "kudu/client/write_op.h"
 #include "kudu/common/common.pb.h"
 #include "kudu/common/partial_row.h"
 #include "kudu/common/schema.h"
 #include "kudu/common/types.h"
+#include "kudu/consensus/consensus.pb.h"
+#include "kudu/consensus/log.h"
+#include "kudu/consensus/log_util.h"
+#include "kudu/consensus/opid_util.h"
+#include "kudu/consensus/ref_counted_replicate.h"
+#include "kudu/fs/fs_manager.h"
+#include "kudu/gutil/hash/city.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/split.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/tools/tool_action_common.h"
+#include "kudu/tserver/request_capture.h"
+#include "kudu/tserver/tserver.pb.h"
+#include "kudu/util/async_util.h"
+#include "kudu/util/env.h"
+#include "kudu/util/hdr_histogram.h"
+#include "kudu/util/histogram.pb.h"
+#include "kudu/util/metrics.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/oid_generator.h"
+#include "kudu/util/path_util.h"
 #include "kudu/util/random.h"
+#include "kudu/util/random_util.h"
+#include "kudu/util/scoped_cleanup.h"
 #include "kudu/util/status.h"
 #include "kudu/util/stopwatch.h"
 
@@ -151,15 +211,26 @@ using kudu::client::KuduClientBuilder;
 using kudu::client::KuduColumnSchema;
 using kudu::client::KuduError;
 using kudu::client::KuduInsert;
+using kudu::client::KuduPredicate;
 using kudu::client::KuduScanBatch;
+using kudu::client::KuduScanToken;
+using kudu::client::KuduScanTokenBuilder;
 using kudu::client::KuduScanner;
 using kudu::client::KuduSchema;
 using kudu::client::KuduSchemaBuilder;
 using kudu::client::KuduSession;
 using kudu::client::KuduTable;
 using kudu::client::KuduTableCreator;
+using kudu::client::KuduUpdate;
+using kudu::client::KuduUpsert;
+using kudu::client::KuduValue;
 using kudu::client::sp::shared_ptr;
+using kudu::consensus::ReplicateMsg;
+using kudu::consensus::ReplicateRefPtr;
+using kudu::log::Log;
+using kudu::log::LogOptions;
 using std::accumulate;
+using std::atomic;
 using std::cerr;
 using std::cout;
 using std::endl;
@@ -185,9 +256,22 @@ DEFINE_int32(error_buffer_size_bytes, 16 * 1024 * 1024,
              "This setting may impose an additional upper limit for the "
              "effective number of errors controlled by the "
              "'--show_first_n_errors' flag.");
+DEFINE_string(data_load_dirs, "",
+              "Comma-separated list of directories in which to write files "
+              "concurrently with the WAL appends of 'perf wal', to measure "
+              "the WAL under the load of the data directories. Empty means "
+              "no concurrent load.");
+DEFINE_int32(data_load_threads_per_dir, 1,
+             "Number of threads writing and syncing files in each of the "
+             "directories of --data_load_dirs.");
+DEFINE_bool(fill_cache, false,
+            "Whether the table scan should fill the tablet servers' block caches "
+            "with the blocks it reads.");
 DEFINE_int32(flush_per_n_rows, 0,
              "Perform async flush per given number of rows added. "
              "Setting to non-zero implicitly turns on manual flush mode.");
+DEFINE_int32(insert_pct, 0,
+             "Percentage of the workload's operations which insert a new row.");
 DEFINE_bool(keep_auto_table, false,
             "If using the auto-generated table, enabling this option "
             "retains the table populated with the data after the test "
@@ -196,6 +280,13 @@ DEFINE_bool(keep_auto_table, false,
             "has no effect if using already existing table "
             "(see the '--table_name' flag): the existing tables nor their data "
             "are never dropped/deleted.");
+DEFINE_string(key_distribution, "zipfian",
+              "Distribution of the keys of the workload's upserts, updates, reads "
+              "and scans over the existing rows: 'uniform', 'zipfian' "
+              "(some keys are much more popular than others) or 'latest' "
+              "(the most recently inserted keys are the most popular).");
+DEFINE_uint64(num_ops_per_thread, 10000,
+              "Number of operations each workload thread performs.");
 DEFINE_uint64(num_rows_per_thread, 1000,
               "Number of rows each thread generates and inserts; "
               "0 means unlimited. All rows generated by a thread are inserted "
@@ -203,11 +294,23 @@ DEFINE_uint64(num_rows_per_thread, 1000,
 DEFINE_int32(num_threads, 2,
              "Number of generator threads to run. Each thread runs its own "
              "KuduSession.");
+DEFINE_int32(read_pct, 50,
+             "Percentage of the workload's operations which look up a single row "
+             "by its key.");
+DEFINE_double(replay_speedup, 1.0,
+              "Factor by which to speed up the replay of the captured requests "
+              "relative to the pace they were received at. 0 replays them as "
+              "fast as possible.");
 DEFINE_bool(run_scan, false,
             "Whether to run post-insertion scan to verify that the count of "
             "the inserted rows matches the expected number. If enabled, "
             "the scan is run only if no errors were encountered "
             "while inserting the generated rows.");
+DEFINE_int32(scan_length, 100,
+             "Maximum number of rows returned by each of the workload's range scans.");
+DEFINE_int32(scan_pct, 0,
+             "Percentage of the workload's operations which scan a range of rows "
+             "starting at a key.");
 DEFINE_uint64(seq_start, 0,
               "Initial value for the generator in sequential mode. "
               "This is useful when running multiple times against already "
@@ -247,16 +350,42 @@ DEFINE_int32(table_num_buckets, 8,
 DEFINE_int32(table_num_replicas, 1,
              "The number of replicas for the auto-created table; "
              "0 means 'use server-side default'.");
+DEFINE_int32(update_pct, 50,
+             "Percentage of the workload's operations which update an existing row.");
+DEFINE_int32(upsert_pct, 0,
+             "Percentage of the workload's operations which upsert a row.");
 DEFINE_bool(use_random, false,
             "Whether to use random numbers instead of sequential ones. "
             "In case of using random numbers collisions are possible over "
             "the data for columns with unique constraint (e.g. primary key).");
+DEFINE_int32(wal_batch_size, 1,
+             "Number of operations in each batch appended to the WAL.");
+DEFINE_uint64(wal_num_batches_per_thread, 10000,
+              "Number of batches each thread appends to the WAL.");
+DEFINE_int32(wal_op_size_bytes, 1024,
+             "Size of the payload of each operation appended to the WAL. The "
+             "payload is random, so it doesn't compress.");
+DEFINE_uint64(workload_record_count, 100000,
+              "Number of rows the workload inserts into its table before running "
+              "its operations.");
+DEFINE_int32(workload_seed, 0,
+             "Seed for the random choices of the workload, for repeatable runs.");
+
+METRIC_DECLARE_entity(tablet);
+METRIC_DECLARE_counter(log_bytes_logged);
+METRIC_DECLARE_histogram(log_append_latency);
+METRIC_DECLARE_histogram(log_entry_batches_per_group);
+METRIC_DECLARE_histogram(log_sync_latency);
 
 namespace kudu {
 namespace tools {
 
 namespace {
 
+const char* const kKeyColumnName = "key";
+const char* const kTableNameArg = "table_name";
+const char* const kWalDirArg = "wal_dir";
+
 class Generator {
  public:
   enum Mode {
@@ -535,7 +664,7 @@ Status CountTableRows(const shared_ptr<KuduClient>& client,
   return Status::OK();
 }
 
-Status TestLoadGenerator(const RunnerContext& context) {
+Status CreateClient(const RunnerContext& context, shared_ptr<KuduClient>* client) {
   const string& master_addresses_str =
       FindOrDie(context.required_args, kMasterAddressesArg);
 
@@ -544,36 +673,48 @@ Status TestLoadGenerator(const RunnerContext& context) {
     return Status::InvalidArgument(
         "At least one master address must be specified");
   }
+  return KuduClientBuilder()
+      .master_server_addrs(master_addrs)
+      .Build(client);
+}
+
+// Create a table with a unique name starting with 'prefix' and the following
+// pre-defined structure, hash-partitioned by the key:
+//
+//   key INT64 NOT NULL PRIMARY KEY, int_val INT32, string_val STRING
+Status CreateAutoTable(const shared_ptr<KuduClient>& client,
+                       const string& prefix,
+                       string* table_name) {
+  ObjectIdGenerator oid_generator;
+  *table_name = prefix + oid_generator.Next();
+  KuduSchema schema;
+  KuduSchemaBuilder b;
+  b.AddColumn(kKeyColumnName)->Type(KuduColumnSchema::INT64)->NotNull()->PrimaryKey();
+  b.AddColumn("int_val")->Type(KuduColumnSchema::INT32);
+  b.AddColumn("string_val")->Type(KuduColumnSchema::STRING);
+  RETURN_NOT_OK(b.Build(&schema));
+
+  unique_ptr<KuduTableCreator> table_creator(client->NewTableCreator());
+  return table_creator->table_name(*table_name)
+      .schema(&schema)
+      .num_replicas(FLAGS_table_num_replicas)
+      .add_hash_partitions(vector<string>({ kKeyColumnName }),
+                           FLAGS_table_num_buckets)
+      .wait(true)
+      .Create();
+}
+
+Status TestLoadGenerator(const RunnerContext& context) {
   shared_ptr<KuduClient> client;
-  RETURN_NOT_OK(KuduClientBuilder()
-                .master_server_addrs(master_addrs)
-                .Build(&client));
+  RETURN_NOT_OK(CreateClient(context, &client));
   string table_name;
   bool is_auto_table = false;
   if (!FLAGS_table_name.empty()) {
     table_name = FLAGS_table_name;
   } else {
-    static const string kKeyColumnName = "key";
-
     // The auto-created table case.
     is_auto_table = true;
-    ObjectIdGenerator oid_generator;
-    table_name = "loadgen_auto_" + oid_generator.Next();
-    KuduSchema schema;
-    KuduSchemaBuilder b;
-    b.AddColumn(kKeyColumnName)->Type(KuduColumnSchema::INT64)->NotNull()->PrimaryKey();
-    b.AddColumn("int_val")->Type(KuduColumnSchema::INT32);
-    b.AddColumn("string_val")->Type(KuduColumnSchema::STRING);
-    RETURN_NOT_OK(b.Build(&schema));
-
-    unique_ptr<KuduTableCreator> table_creator(client->NewTableCreator());
-    RETURN_NOT_OK(table_creator->table_name(table_name)
-                  .schema(&schema)
-                  .num_replicas(FLAGS_table_num_replicas)
-                  .add_hash_partitions(vector<string>({ kKeyColumnName }),
-                                       FLAGS_table_num_buckets)
-                  .wait(true)
-                  .Create());
+    RETURN_NOT_OK(CreateAutoTable(client, "loadgen_auto_", &table_name));
   }
   cout << "Using " << (is_auto_table ? "auto-created " : "")
        << "table '" << table_name << "'" << endl;
@@ -629,6 +770,943 @@ Status TestLoadGenerator(const RunnerContext& context) {
   return Status::OK();
 }
 
+// Scan all the tablets of the table with the specified name through scan
+// tokens, FLAGS_num_threads tablets at a time, and report the scan rate
+// along with the skew between the tablets.
+Status TableScan(const RunnerContext& context) {
+  const string& table_name = FindOrDie(context.required_args, kTableNameArg);
+  shared_ptr<KuduClient> client;
+  RETURN_NOT_OK(CreateClient(context, &client));
+  shared_ptr<KuduTable> table;
+  RETURN_NOT_OK(client->OpenTable(table_name, &table));
+
+  vector<KuduScanToken*> tokens;
+  ElementDeleter deleter(&tokens);
+  KuduScanTokenBuilder builder(table.get());
+  RETURN_NOT_OK(builder.SetCacheBlocks(FLAGS_fill_cache));
+  RETURN_NOT_OK(builder.Build(&tokens));
+
+  struct TabletStats {
+    string tablet_id;
+    uint64_t rows = 0;
+    uint64_t bytes = 0;
+    double wall_millis = 0;
+    Status status;
+  };
+  vector<TabletStats> stats(tokens.size());
+  std::atomic<size_t> next_token(0);
+  auto scan_tablets = [&]() {
+    for (size_t i = next_token++; i < tokens.size(); i = next_token++) {
+      TabletStats* tablet_stats = &stats[i];
+      tablet_stats->tablet_id = tokens[i]->tablet().id();
+      Stopwatch sw;
+      sw.start();
+      tablet_stats->status = [&]() -> Status {
+        KuduScanner* scanner_ptr;
+        RETURN_NOT_OK(tokens[i]->IntoKuduScanner(&scanner_ptr));
+        unique_ptr<KuduScanner> scanner(scanner_ptr);
+        RETURN_NOT_OK(scanner->Open());
+        KuduScanBatch batch;
+        while (scanner->HasMoreRows()) {
+          RETURN_NOT_OK(scanner->NextBatch(&batch));
+          tablet_stats->rows += batch.NumRows();
+          tablet_stats->bytes += batch.direct_data().size() + batch.indirect_data().size();
+        }
+        return Status::OK();
+      }();
+      sw.stop();
+      tablet_stats->wall_millis = sw.elapsed().wall_millis();
+    }
+  };
+
+  Stopwatch sw;
+  sw.start();
+  vector<thread> threads;
+  for (int i = 0; i < FLAGS_num_threads; ++i) {
+    threads.emplace_back(scan_tablets);
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  sw.stop();
+
+  uint64_t total_rows = 0;
+  uint64_t total_bytes = 0;
+  uint64_t max_rows = 0;
+  double max_millis = 0;
+  double total_millis = 0;
+  for (const auto& tablet_stats : stats) {
+    RETURN_NOT_OK_PREPEND(tablet_stats.status,
+                          Substitute("failed to scan tablet $0", tablet_stats.tablet_id));
+    total_rows += tablet_stats.rows;
+    total_bytes += tablet_stats.bytes;
+    total_millis += tablet_stats.wall_millis;
+    max_rows = std::max(max_rows, tablet_stats.rows);
+    max_millis = std::max(max_millis, tablet_stats.wall_millis);
+  }
+
+  const double wall_secs = std::max(sw.elapsed().wall_seconds(), 1e-9);
+  cout << "Per-tablet report" << endl;
+  for (const auto& tablet_stats : stats) {
+    cout << "  " << tablet_stats.tablet_id << ": "
+         << tablet_stats.rows << " rows, "
+         << tablet_stats.bytes << " bytes, "
+         << tablet_stats.wall_millis << " ms" << endl;
+  }
+  cout << endl << "Scanner report" << endl
+       << "  tablets     : " << stats.size() << endl
+       << "  rows total  : " << total_rows << endl
+       << "  bytes total : " << total_bytes << endl
+       << "  time total  : " << wall_secs * 1000 << " ms" << endl
+       << "  rows/s      : " << total_rows / wall_secs << endl
+       << "  bytes/s     : " << total_bytes / wall_secs << endl;
+  if (!stats.empty()) {
+    // The skew is the ratio of the largest tablet to the average one: the
+    // scan can't be faster than the scan of its slowest tablet.
+    const double mean_rows = static_cast<double>(total_rows) / stats.size();
+    const double mean_millis = total_millis / stats.size();
+    cout << "  rows skew   : " << (mean_rows > 0 ? max_rows / mean_rows : 1.0) << endl
+         << "  time skew   : " << (mean_millis > 0 ? max_millis / mean_millis : 1.0) << endl;
+  }
+  return Status::OK();
+}
+
+// Generates ranks in [0, num_items) following a Zipfian distribution, with
+// rank 0 the most popular, as described in "Quickly Generating Billion-Record
+// Synthetic Databases" by Gray et al. (SIGMOD 1994), which is also what YCSB
+// uses.
+class ZipfianGenerator {
+ public:
+  // The skew used by YCSB.
+  static constexpr double kTheta = 0.99;
+
+  explicit ZipfianGenerator(uint64_t num_items)
+      : num_items_(std::max<uint64_t>(num_items, 2)),
+        alpha_(1.0 / (1.0 - kTheta)),
+        zetan_(Zeta(num_items_)),
+        eta_((1 - pow(2.0 / num_items_, 1 - kTheta)) / (1 - Zeta(2) / zetan_)) {
+  }
+
+  uint64_t Next(Random* random) const {
+    const double u = random->NextDoubleFraction();
+    const double uz = u * zetan_;
+    if (uz < 1.0) {
+      return 0;
+    }
+    if (uz < 1.0 + pow(0.5, kTheta)) {
+      return 1;
+    }
+    return std::min<uint64_t>(num_items_ * pow(eta_ * u - eta_ + 1, alpha_),
+                              num_items_ - 1);
+  }
+
+ private:
+  static double Zeta(uint64_t n) {
+    double sum = 0;
+    for (uint64_t i = 1; i <= n; i++) {
+      sum += 1 / pow(i, kTheta);
+    }
+    return sum;
+  }
+
+  const uint64_t num_items_;
+  const double alpha_;
+  const double zetan_;
+  const double eta_;
+};
+
+// The operations of 'kudu perf workload'.
+enum WorkloadOp {
+  OP_INSERT,
+  OP_UPSERT,
+  OP_UPDATE,
+  OP_READ,
+  OP_SCAN,
+  NUM_WORKLOAD_OPS,
+};
+
+const char* WorkloadOpName(int op) {
+  switch (op) {
+    case OP_INSERT: return "insert";
+    case OP_UPSERT: return "upsert";
+    case OP_UPDATE: return "update";
+    case OP_READ: return "read";
+    case OP_SCAN: return "scan";
+    default: LOG(FATAL) << "unknown workload operation " << op;
+  }
+  return "";
+}
+
+// The state shared by the threads of 'kudu perf workload'.
+class Workload {
+ public:
+  Workload(shared_ptr<KuduClient> client, shared_ptr<KuduTable> table)
+      : client_(std::move(client)),
+        table_(std::move(table)),
+        num_keys_(FLAGS_workload_record_count),
+        zipfian_(FLAGS_workload_record_count) {
+    for (auto& histogram : latencies_us_) {
+      // Track latencies of up to a minute with 3 significant digits.
+      histogram.reset(new HdrHistogram(60 * 1000 * 1000, 3));
+    }
+    const int pcts[] = { FLAGS_insert_pct, FLAGS_upsert_pct, FLAGS_update_pct,
+                         FLAGS_read_pct, FLAGS_scan_pct };
+    int sum = 0;
+    for (int op = 0; op < NUM_WORKLOAD_OPS; op++) {
+      sum += pcts[op];
+      cumulative_pcts_[op] = sum;
+    }
+  }
+
+  static Status ValidateFlags() {
+    const int pcts[] = { FLAGS_insert_pct, FLAGS_upsert_pct, FLAGS_update_pct,
+                         FLAGS_read_pct, FLAGS_scan_pct };
+    int sum = 0;
+    for (int pct : pcts) {
+      if (pct < 0) {
+        return Status::InvalidArgument("operation percentages must not be negative");
+      }
+      sum += pct;
+    }
+    if (sum != 100) {
+      return Status::InvalidArgument(
+          Substitute("operation percentages must add up to 100, not $0", sum));
+    }
+    if (FLAGS_key_distribution != "uniform" &&
+        FLAGS_key_distribution != "zipfian" &&
+        FLAGS_key_distribution != "latest") {
+      return Status::InvalidArgument(
+          Substitute("unknown key distribution '$0'", FLAGS_key_distribution));
+    }
+    if (FLAGS_workload_record_count == 0 && FLAGS_insert_pct != 100) {
+      return Status::InvalidArgument(
+          "a workload with no initial records may only consist of inserts");
+    }
+    return Status::OK();
+  }
+
+  // Inserts the keys [0, --workload_record_count) in parallel.
+  Status Load() {
+    vector<Status> statuses(FLAGS_num_threads);
+    vector<thread> threads;
+    for (int i = 0; i < FLAGS_num_threads; i++) {
+      threads.emplace_back([this, i, &statuses]() {
+        statuses[i] = LoadThread(i);
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    for (const auto& s : statuses) {
+      RETURN_NOT_OK(s);
+    }
+    return Status::OK();
+  }
+
+  // Runs --num_ops_per_thread operations in each of the threads.
+  Status Run() {
+    vector<Status> statuses(FLAGS_num_threads);
+    vector<thread> threads;
+    for (int i = 0; i < FLAGS_num_threads; i++) {
+      threads.emplace_back([this, i, &statuses]() {
+        statuses[i] = RunThread(i);
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    for (const auto& s : statuses) {
+      RETURN_NOT_OK(s);
+    }
+    return Status::OK();
+  }
+
+  void PrintReport(double wall_secs) const {
+    uint64_t total_ops = 0;
+    for (const auto& histogram : latencies_us_) {
+      total_ops += histogram->TotalCount();
+    }
+    wall_secs = std::max(wall_secs, 1e-9);
+    cout << endl << "Workload report" << endl
+         << "  time total  : " << wall_secs * 1000 << " ms" << endl
+         << "  ops total   : " << total_ops << endl
+         << "  ops/s       : " << total_ops / wall_secs << endl;
+    for (int op = 0; op < NUM_WORKLOAD_OPS; op++) {
+      const HdrHistogram& histogram = *latencies_us_[op];
+      if (histogram.TotalCount() == 0 && errors_[op].load() == 0) {
+        continue;
+      }
+      cout << "  " << std::left << std::setw(7) << WorkloadOpName(op)
+           << ": count=" << histogram.TotalCount()
+           << " errors=" << errors_[op].load()
+           << " ops/s=" << histogram.TotalCount() / wall_secs
+           << " latency_us(mean=" << histogram.MeanValue()
+           << " p50=" << histogram.ValueAtPercentile(50)
+           << " p95=" << histogram.ValueAtPercentile(95)
+           << " p99=" << histogram.ValueAtPercentile(99)
+           << " p99.9=" << histogram.ValueAtPercentile(99.9)
+           << " max=" << histogram.MaxValue() << ")" << endl;
+    }
+  }
+
+ private:
+  Status LoadThread(int thread_idx) {
+    shared_ptr<KuduSession> session(client_->NewSession());
+    RETURN_NOT_OK(session->SetFlushMode(KuduSession::AUTO_FLUSH_BACKGROUND));
+    Random random(FLAGS_workload_seed + thread_idx);
+    for (uint64_t key = thread_idx; key < FLAGS_workload_record_count;
+         key += FLAGS_num_threads) {
+      unique_ptr<KuduInsert> insert(table_->NewInsert());
+      RETURN_NOT_OK(FillRow(key, &random, insert->mutable_row()));
+      RETURN_NOT_OK(session->Apply(insert.release()));
+    }
+    Status s = session->Flush();
+    if (!s.ok()) {
+      vector<KuduError*> errors;
+      ElementDeleter d(&errors);
+      session->GetPendingErrors(&errors, nullptr);
+      if (!errors.empty()) {
+        return errors.front()->status().CloneAndPrepend("unable to load the records");
+      }
+    }
+    return s;
+  }
+
+  Status RunThread(int thread_idx) {
+    shared_ptr<KuduSession> session(client_->NewSession());
+    RETURN_NOT_OK(session->SetFlushMode(KuduSession::AUTO_FLUSH_SYNC));
+    // Seed differently from the load phase so that the values differ.
+    Random random(FLAGS_workload_seed + FLAGS_num_threads + thread_idx);
+    for (uint64_t i = 0; i < FLAGS_num_ops_per_thread; i++) {
+      const int op = ChooseOp(&random);
+      MonoTime start = MonoTime::Now();
+      Status s = RunOp(op, session.get(), &random);
+      const int64_t latency_us = (MonoTime::Now() - start).ToMicroseconds();
+      if (s.ok()) {
+        latencies_us_[op]->Increment(latency_us);
+      } else {
+        errors_[op]++;
+        if (errors_[op].load() <= FLAGS_show_first_n_errors) {
+          lock_guard<mutex> lock(cerr_lock);
+          cerr << WorkloadOpName(op) << " failed: " << s.ToString() << endl;
+        }
+      }
+    }
+    return Status::OK();
+  }
+
+  int ChooseOp(Random* random) const {
+    const int pct = random->Uniform(100);
+    for (int op = 0; op < NUM_WORKLOAD_OPS; op++) {
+      if (pct < cumulative_pcts_[op]) {
+        return op;
+      }
+    }
+    LOG(FATAL) << "operation percentages don't add up to 100";
+    return OP_READ;
+  }
+
+  // Chooses an existing key according to --key_distribution.
+  uint64_t ChooseKey(Random* random) const {
+    const uint64_t num_keys = std::max<uint64_t>(num_keys_.load(), 1);
+    if (FLAGS_key_distribution == "uniform") {
+      return random->Uniform64(num_keys);
+    }
+    const uint64_t rank = zipfian_.Next(random);
+    if (FLAGS_key_distribution == "latest") {
+      // The most recently inserted keys are the most popular.
+      return num_keys - 1 - std::min(rank, num_keys - 1);
+    }
+    // Scatter the popular keys over the key space so that they don't all
+    // land in the same place, like YCSB's scrambled Zipfian distribution.
+    uint64_t hash = rank;
+    hash = util_hash::CityHash64(reinterpret_cast<const char*>(&hash), sizeof(hash));
+    return hash % num_keys;
+  }
+
+  Status FillRow(uint64_t key, Random* random, KuduPartialRow* row) const {
+    RETURN_NOT_OK(row->SetInt64(kKeyColumnName, key));
+    RETURN_NOT_OK(row->SetInt32("int_val", random->Next32()));
+    string value(FLAGS_string_len, 'x');
+    for (auto& c : value) {
+      c = 'a' + random->Uniform(26);
+    }
+    return row->SetString("string_val", value);
+  }
+
+  Status RunOp(int op, KuduSession* session, Random* random) {
+    switch (op) {
+      case OP_INSERT: {
+        unique_ptr<KuduInsert> insert(table_->NewInsert());
+        RETURN_NOT_OK(FillRow(num_keys_++, random, insert->mutable_row()));
+        return ApplyAndCheck(session, insert.release());
+      }
+      case OP_UPSERT: {
+        unique_ptr<KuduUpsert> upsert(table_->NewUpsert());
+        RETURN_NOT_OK(FillRow(ChooseKey(random), random, upsert->mutable_row()));
+        return ApplyAndCheck(session, upsert.release());
+      }
+      case OP_UPDATE: {
+        unique_ptr<KuduUpdate> update(table_->NewUpdate());
+        RETURN_NOT_OK(FillRow(ChooseKey(random), random, update->mutable_row()));
+        return ApplyAndCheck(session, update.release());
+      }
+      case OP_READ:
+      case OP_SCAN: {
+        KuduScanner scanner(table_.get());
+        const int64_t key = ChooseKey(random);
+        if (op == OP_READ) {
+          RETURN_NOT_OK(scanner.AddConjunctPredicate(table_->NewComparisonPredicate(
+              kKeyColumnName, KuduPredicate::EQUAL, KuduValue::FromInt(key))));
+        } else {
+          RETURN_NOT_OK(scanner.AddConjunctPredicate(table_->NewComparisonPredicate(
+              kKeyColumnName, KuduPredicate::GREATER_EQUAL, KuduValue::FromInt(key))));
+          RETURN_NOT_OK(scanner.SetLimit(FLAGS_scan_length));
+        }
+        RETURN_NOT_OK(scanner.Open());
+        KuduScanBatch batch;
+        while (scanner.HasMoreRows()) {
+          RETURN_NOT_OK(scanner.NextBatch(&batch));
+        }
+        return Status::OK();
+      }
+      default:
+        LOG(FATAL) << "unknown workload operation " << op;
+    }
+    return Status::OK();
+  }
+
+  // Applies 'write_op' and returns its row error, if any.
+  static Status ApplyAndCheck(KuduSession* session, client::KuduWriteOperation* write_op) {
+    Status s = session->Apply(write_op);
+    if (!s.ok()) {
+      vector<KuduError*> errors;
+      ElementDeleter d(&errors);
+      session->GetPendingErrors(&errors, nullptr);
+      if (!errors.empty()) {
+        return errors.front()->status();
+      }
+    }
+    return s;
+  }
+
+  const shared_ptr<KuduClient> client_;
+  const shared_ptr<KuduTable> table_;
+
+  // The number of keys inserted so far: the keys are [0, num_keys_).
+  std::atomic<uint64_t> num_keys_;
+
+  // Ranks are generated over the initial records only: YCSB does the same
+  // rather than recomputing the distribution's constants as keys are added.
+  const ZipfianGenerator zipfian_;
+
+  // The upper bound (exclusive) of each operation's range of percentages.
+  int cumulative_pcts_[NUM_WORKLOAD_OPS];
+
+  unique_ptr<HdrHistogram> latencies_us_[NUM_WORKLOAD_OPS];
+  std::atomic<int64_t> errors_[NUM_WORKLOAD_OPS] = {};
+};
+
+Status RunWorkload(const RunnerContext& context) {
+  RETURN_NOT_OK(Workload::ValidateFlags());
+  shared_ptr<KuduClient> client;
+  RETURN_NOT_OK(CreateClient(context, &client));
+  string table_name;
+  RETURN_NOT_OK(CreateAutoTable(client, "workload_auto_", &table_name));
+  cout << "Using auto-created table '" << table_name << "'" << endl;
+  shared_ptr<KuduTable> table;
+  RETURN_NOT_OK(client->OpenTable(table_name, &table));
+
+  Workload workload(client, table);
+  Stopwatch load_sw;
+  load_sw.start();
+  RETURN_NOT_OK(workload.Load());
+  load_sw.stop();
+  cout << "Loaded " << FLAGS_workload_record_count << " records in "
+       << load_sw.elapsed().wall_millis() << " ms" << endl;
+
+  Stopwatch sw;
+  sw.start();
+  RETURN_NOT_OK(workload.Run());
+  sw.stop();
+  workload.PrintReport(sw.elapsed().wall_seconds());
+
+  if (!FLAGS_keep_auto_table) {
+    cout << "Dropping auto-created table '" << table_name << "'" << endl;
+    RETURN_NOT_OK(client->DeleteTable(table_name));
+  }
+  return Status::OK();
+}
+
+// Replays captured write and scan requests, in the order and at the relative
+// times they were received at, through a client connected to another cluster.
+// Writes are sent to the table of the same name, and scans are rebuilt from
+// scan tokens, so the tables may be partitioned differently than the ones the
+// requests were captured from.
+class Replayer {
+ public:
+  Replayer(shared_ptr<KuduClient> client, vector<tserver::CapturedRequestPB> requests)
+      : client_(std::move(client)),
+        requests_(std::move(requests)),
+        next_request_(0),
+        max_lag_us_(0) {
+    std::stable_sort(requests_.begin(), requests_.end(),
+                     [](const tserver::CapturedRequestPB& a,
+                        const tserver::CapturedRequestPB& b) {
+                       return a.received_micros() < b.received_micros();
+                     });
+    for (auto& histogram : latencies_us_) {
+      histogram.reset(new HdrHistogram(60 * 1000 * 1000, 3));
+    }
+  }
+
+  // Replays all the requests from --num_threads threads.
+  Status Run() {
+    if (requests_.empty()) {
+      return Status::OK();
+    }
+    start_ = MonoTime::Now();
+    vector<Status> statuses(FLAGS_num_threads);
+    vector<thread> threads;
+    for (int i = 0; i < FLAGS_num_threads; i++) {
+      threads.emplace_back([this, i, &statuses]() {
+        statuses[i] = RunThread();
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    for (const auto& s : statuses) {
+      RETURN_NOT_OK(s);
+    }
+    return Status::OK();
+  }
+
+  void PrintReport(double wall_secs) const {
+    wall_secs = std::max(wall_secs, 1e-9);
+    cout << endl << "Replay report" << endl
+         << "  time total  : " << wall_secs * 1000 << " ms" << endl
+         << "  requests    : " << requests_.size() << endl
+         << "  max lag     : " << max_lag_us_.load() / 1000 << " ms" << endl;
+    for (int type = 0; type < NUM_REQUEST_TYPES; type++) {
+      const HdrHistogram& histogram = *latencies_us_[type];
+      cout << "  " << std::left << std::setw(6) << (type == WRITE ? "write" : "scan")
+           << ": count=" << histogram.TotalCount()
+           << " errors=" << errors_[type].load()
+           << " latency_us(mean=" << histogram.MeanValue()
+           << " p50=" << histogram.ValueAtPercentile(50)
+           << " p95=" << histogram.ValueAtPercentile(95)
+           << " p99=" << histogram.ValueAtPercentile(99)
+           << " p99.9=" << histogram.ValueAtPercentile(99.9)
+           << " max=" << histogram.MaxValue() << ")" << endl;
+    }
+    if (max_lag_us_.load() > 1000 * 1000) {
+      cout << "The replay fell behind the captured pace: consider increasing "
+           << "--num_threads" << endl;
+    }
+  }
+
+ private:
+  enum RequestType {
+    WRITE,
+    SCAN,
+    NUM_REQUEST_TYPES
+  };
+
+  Status RunThread() {
+    shared_ptr<KuduSession> session(client_->NewSession());
+    RETURN_NOT_OK(session->SetFlushMode(KuduSession::MANUAL_FLUSH));
+    const int64_t first_micros = requests_.front().received_micros();
+    while (true) {
+      const size_t idx = next_request_++;
+      if (idx >= requests_.size()) {
+        return Status::OK();
+      }
+      const auto& req = requests_[idx];
+
+      // Wait until the request is due, and keep track of how far behind the
+      // captured pace the replay is.
+      if (FLAGS_replay_speedup > 0) {
+        const MonoTime due = start_ + MonoDelta::FromMicroseconds(
+            (req.received_micros() - first_micros) / FLAGS_replay_speedup);
+        const MonoTime now = MonoTime::Now();
+        if (now < due) {
+          SleepFor(due - now);
+        } else {
+          const int64_t lag_us = (now - due).ToMicroseconds();
+          int64_t max_lag_us = max_lag_us_.load();
+          while (lag_us > max_lag_us &&
+                 !max_lag_us_.compare_exchange_weak(max_lag_us, lag_us)) {
+          }
+        }
+      }
+
+      const RequestType type = req.has_write() ? WRITE : SCAN;
+      MonoTime start;
+      Status s = type == WRITE ? ReplayWrite(req, session.get(), &start)
+                               : ReplayScan(req, &start);
+      if (s.ok()) {
+        latencies_us_[type]->Increment((MonoTime::Now() - start).ToMicroseconds());
+      } else {
+        errors_[type]++;
+        if (errors_[type].load() <= FLAGS_show_first_n_errors) {
+          lock_guard<mutex> lock(cerr_lock);
+          cerr << "replay of a " << (type == WRITE ? "write" : "scan") << " to table '"
+               << req.table_name() << "' failed: " << s.ToString() << endl;
+        }
+      }
+    }
+  }
+
+  // Replays the captured write 'req', setting 'start' to when it was sent.
+  Status ReplayWrite(const tserver::CapturedRequestPB& req,
+                     KuduSession* session,
+                     MonoTime* start) {
+    shared_ptr<KuduTable> table;
+    RETURN_NOT_OK(OpenTable(req.table_name(), &table));
+    const tserver::WriteRequestPB& write = req.write();
+    Schema client_schema;
+    RETURN_NOT_OK(SchemaFromPB(write.schema(), &client_schema));
+    // The rows of all the operations on 'table' share its schema.
+    unique_ptr<KuduInsert> prototype(table->NewInsert());
+    RowOperationsPBDecoder decoder(&write.row_operations(), &client_schema,
+                                   prototype->row().schema(), nullptr);
+    vector<DecodedRowOperation> ops;
+    RETURN_NOT_OK(decoder.DecodeAsPartialRows(&ops));
+
+    for (const auto& op : ops) {
+      unique_ptr<client::KuduWriteOperation> write_op;
+      switch (op.type) {
+        case RowOperationsPB::INSERT: write_op.reset(table->NewInsert()); break;
+        case RowOperationsPB::UPSERT: write_op.reset(table->NewUpsert()); break;
+        case RowOperationsPB::UPDATE: write_op.reset(table->NewUpdate()); break;
+        case RowOperationsPB::DELETE: write_op.reset(table->NewDelete()); break;
+        default:
+          return Status::NotSupported(
+              Substitute("unexpected operation type $0", RowOperationsPB::Type_Name(op.type)));
+      }
+      *write_op->mutable_row() = *op.split_row;
+      RETURN_NOT_OK(session->Apply(write_op.release()));
+    }
+
+    // The rows point into 'write', which outlives the flush.
+    *start = MonoTime::Now();
+    Status s = session->Flush();
+    if (!s.ok()) {
+      vector<KuduError*> errors;
+      ElementDeleter d(&errors);
+      session->GetPendingErrors(&errors, nullptr);
+      if (!errors.empty()) {
+        return errors.front()->status();
+      }
+    }
+    return s;
+  }
+
+  // Replays the captured scan 'req' over the same range of partition keys,
+  // setting 'start' to when it was sent.
+  Status ReplayScan(const tserver::CapturedRequestPB& req, MonoTime* start) {
+    const tserver::NewScanRequestPB& scan = req.scan();
+    client::ScanTokenPB token;
+    token.set_table_name(req.table_name());
+    token.mutable_projected_columns()->CopyFrom(scan.projected_columns());
+    token.mutable_column_predicates()->CopyFrom(scan.column_predicates());
+    if (scan.has_start_primary_key()) {
+      token.set_lower_bound_primary_key(scan.start_primary_key());
+    }
+    if (scan.has_stop_primary_key()) {
+      token.set_upper_bound_primary_key(scan.stop_primary_key());
+    }
+    if (!req.partition_key_start().empty()) {
+      token.set_lower_bound_partition_key(req.partition_key_start());
+    }
+    if (!req.partition_key_end().empty()) {
+      token.set_upper_bound_partition_key(req.partition_key_end());
+    }
+    if (scan.has_limit()) {
+      token.set_limit(scan.limit());
+    }
+    // Snapshot scans are replayed at the current time, since the captured
+    // timestamps mean nothing to the target cluster.
+    token.set_read_mode(scan.read_mode());
+    token.set_cache_blocks(scan.cache_blocks());
+    token.set_fault_tolerant(scan.order_mode() == ORDERED);
+    string serialized;
+    if (!token.SerializeToString(&serialized)) {
+      return Status::Corruption("unable to serialize scan token");
+    }
+
+    KuduScanner* scanner_ptr;
+    RETURN_NOT_OK(KuduScanToken::DeserializeIntoScanner(client_.get(), serialized,
+                                                        &scanner_ptr));
+    unique_ptr<KuduScanner> scanner(scanner_ptr);
+    *start = MonoTime::Now();
+    RETURN_NOT_OK(scanner->Open());
+    KuduScanBatch batch;
+    while (scanner->HasMoreRows()) {
+      RETURN_NOT_OK(scanner->NextBatch(&batch));
+    }
+    return Status::OK();
+  }
+
+  Status OpenTable(const string& table_name, shared_ptr<KuduTable>* table) {
+    {
+      lock_guard<mutex> l(tables_lock_);
+      if (FindCopy(tables_, table_name, table)) {
+        return Status::OK();
+      }
+    }
+    RETURN_NOT_OK(client_->OpenTable(table_name, table));
+    lock_guard<mutex> l(tables_lock_);
+    InsertIfNotPresent(&tables_, table_name, *table);
+    return Status::OK();
+  }
+
+  const shared_ptr<KuduClient> client_;
+
+  // The captured requests, in the order they were received.
+  vector<tserver::CapturedRequestPB> requests_;
+
+  // When the replay started, corresponding to the first request.
+  MonoTime start_;
+
+  // The index of the next request to replay.
+  std::atomic<size_t> next_request_;
+
+  // The most a request was sent behind its schedule.
+  std::atomic<int64_t> max_lag_us_;
+
+  mutex tables_lock_;
+  std::unordered_map<string, shared_ptr<KuduTable>> tables_;
+
+  unique_ptr<HdrHistogram> latencies_us_[NUM_REQUEST_TYPES];
+  std::atomic<int64_t> errors_[NUM_REQUEST_TYPES] = {};
+};
+
+Status RunReplay(const RunnerContext& context) {
+  if (FLAGS_replay_speedup < 0) {
+    return Status::InvalidArgument("--replay_speedup must not be negative");
+  }
+  vector<tserver::CapturedRequestPB> requests;
+  for (const auto& path : context.variadic_args) {
+    RETURN_NOT_OK_PREPEND(tserver::ReadCapturedRequests(Env::Default(), path, &requests),
+                          Substitute("unable to read captured requests from $0", path));
+  }
+  cout << "Replaying " << requests.size() << " captured requests" << endl;
+
+  shared_ptr<KuduClient> client;
+  RETURN_NOT_OK(CreateClient(context, &client));
+  Replayer replayer(client, std::move(requests));
+  Stopwatch sw;
+  sw.start();
+  RETURN_NOT_OK(replayer.Run());
+  sw.stop();
+  replayer.PrintReport(sw.elapsed().wall_seconds());
+  return Status::OK();
+}
+
+// Appends batches of NO_OP replicates to a new WAL through the same Log code
+// path as the tablet replicas, from several threads at once so that the log
+// groups their batches as it does under a real write load. Each thread waits
+// for its batch to be appended (and synced, with --log_force_fsync_all)
+// before appending the next one.
+class WalBenchmark {
+ public:
+  explicit WalBenchmark(Env* env)
+      : env_(env),
+        latencies_us_(new HdrHistogram(60 * 1000 * 1000, 3)),
+        data_load_bytes_(0),
+        stop_data_load_(false),
+        next_index_(1) {
+  }
+
+  // Creates the filesystem of the WAL in a new directory under 'wal_dir',
+  // runs the appends against it and deletes it.
+  Status Run(const string& wal_dir) {
+    const string root = JoinPathSegments(wal_dir, "perf-wal-" + oid_generator_.Next());
+    FsManagerOpts opts;
+    opts.wal_root = root;
+    opts.data_roots = { root };
+    FsManager fs_manager(env_, opts);
+    auto cleanup = MakeScopedCleanup([&]() {
+      WARN_NOT_OK(env_->DeleteRecursively(root),
+                  Substitute("unable to delete $0", root));
+    });
+    RETURN_NOT_OK(fs_manager.CreateInitialFileSystemLayout());
+    RETURN_NOT_OK(fs_manager.Open());
+
+    entity_ = METRIC_ENTITY_tablet.Instantiate(&metric_registry_, "perf-wal");
+    const Schema schema = SchemaBuilder(Schema({ ColumnSchema(kKeyColumnName, INT64) }, 1))
+        .Build();
+    RETURN_NOT_OK(Log::Open(LogOptions(), &fs_manager, "perf-wal", schema,
+                            0, // schema_version
+                            entity_, &log_));
+
+    vector<thread> load_threads;
+    vector<string> load_dirs = strings::Split(FLAGS_data_load_dirs, ",",
+                                              strings::SkipEmpty());
+    vector<Status> load_statuses(load_dirs.size() * FLAGS_data_load_threads_per_dir);
+    for (size_t i = 0; i < load_statuses.size(); i++) {
+      const string& dir = load_dirs[i % load_dirs.size()];
+      load_threads.emplace_back([this, dir, i, &load_statuses]() {
+        load_statuses[i] = DataLoadThread(dir);
+      });
+    }
+
+    vector<thread> threads;
+    vector<Status> statuses(FLAGS_num_threads);
+    Stopwatch sw;
+    sw.start();
+    for (int i = 0; i < FLAGS_num_threads; i++) {
+      threads.emplace_back([this, i, &statuses]() {
+        statuses[i] = AppendThread(i);
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    sw.stop();
+
+    stop_data_load_ = true;
+    for (auto& t : load_threads) {
+      t.join();
+    }
+    RETURN_NOT_OK(log_->Close());
+    for (const auto& s : statuses) {
+      RETURN_NOT_OK_PREPEND(s, "unable to append to the WAL");
+    }
+    for (const auto& s : load_statuses) {
+      RETURN_NOT_OK_PREPEND(s, "unable to write the data directory load");
+    }
+    return PrintReport(sw.elapsed().wall_seconds());
+  }
+
+ private:
+  Status AppendThread(int thread_idx) {
+    Random random(thread_idx);
+    string payload(FLAGS_wal_op_size_bytes, '\0');
+    for (uint64_t i = 0; i < FLAGS_wal_num_batches_per_thread; i++) {
+      vector<ReplicateRefPtr> replicates;
+      for (int j = 0; j < FLAGS_wal_batch_size; j++) {
+        ReplicateRefPtr replicate =
+            consensus::make_scoped_refptr_replicate(new ReplicateMsg());
+        replicate->get()->set_op_type(consensus::NO_OP);
+        RandomString(&payload[0], payload.size(), &random);
+        replicate->get()->mutable_noop_request()->set_payload_for_tests(payload);
+        replicates.emplace_back(std::move(replicate));
+      }
+
+      Synchronizer sync;
+      MonoTime start = MonoTime::Now();
+      {
+        // As in consensus, the replicates are appended in the order of their
+        // indexes.
+        lock_guard<mutex> l(append_lock_);
+        for (auto& replicate : replicates) {
+          // The log doesn't interpret the timestamps.
+          replicate->get()->set_timestamp(next_index_);
+          *replicate->get()->mutable_id() = consensus::MakeOpId(1, next_index_++);
+        }
+        RETURN_NOT_OK(log_->AsyncAppendReplicates(replicates, sync.AsStatusCallback()));
+      }
+      RETURN_NOT_OK(sync.Wait());
+      latencies_us_->Increment((MonoTime::Now() - start).ToMicroseconds());
+    }
+    return Status::OK();
+  }
+
+  // Writes files of 64 MiB into 'dir', syncing and deleting each of them,
+  // until the appends are done.
+  Status DataLoadThread(const string& dir) {
+    const int64_t kChunkSize = 1024 * 1024;
+    const int kChunksPerFile = 64;
+    Random random(GetRandomSeed32());
+    string chunk = RandomString(kChunkSize, &random);
+    while (!stop_data_load_) {
+      const string path = JoinPathSegments(dir, "perf-wal-load-" + oid_generator_.Next());
+      unique_ptr<WritableFile> file;
+      RETURN_NOT_OK(env_->NewWritableFile(path, &file));
+      auto cleanup = MakeScopedCleanup([&]() {
+        WARN_NOT_OK(env_->DeleteFile(path), Substitute("unable to delete $0", path));
+      });
+      for (int i = 0; i < kChunksPerFile && !stop_data_load_; i++) {
+        RETURN_NOT_OK(file->Append(chunk));
+        data_load_bytes_ += kChunkSize;
+      }
+      RETURN_NOT_OK(file->Sync());
+      RETURN_NOT_OK(file->Close());
+    }
+    return Status::OK();
+  }
+
+  Status PrintReport(double wall_secs) const {
+    wall_secs = std::max(wall_secs, 1e-9);
+    const uint64_t batches = latencies_us_->TotalCount();
+    const uint64_t ops = batches * FLAGS_wal_batch_size;
+    const int64_t bytes_logged = METRIC_log_bytes_logged.Instantiate(entity_)->value();
+    cout << endl << "WAL report" << endl
+         << "  time total    : " << wall_secs * 1000 << " ms" << endl
+         << "  batches total : " << batches << endl
+         << "  ops/s         : " << ops / wall_secs << endl
+         << "  bytes/s       : " << bytes_logged / wall_secs << endl;
+    if (!FLAGS_data_load_dirs.empty()) {
+      cout << "  data load bytes/s : " << data_load_bytes_ / wall_secs << endl;
+    }
+    cout << "  batch latency_us(mean=" << latencies_us_->MeanValue()
+         << " p50=" << latencies_us_->ValueAtPercentile(50)
+         << " p95=" << latencies_us_->ValueAtPercentile(95)
+         << " p99=" << latencies_us_->ValueAtPercentile(99)
+         << " p99.9=" << latencies_us_->ValueAtPercentile(99.9)
+         << " max=" << latencies_us_->MaxValue() << ")" << endl;
+
+    // The log's own histograms break the batch latency down: the time to
+    // append each group of batches to the segment, the time to sync it, and
+    // the number of batches in each group.
+    const std::pair<const char*, Histogram*> log_histograms[] = {
+      { "append latency_us", METRIC_log_append_latency.Instantiate(entity_).get() },
+      { "sync latency_us", METRIC_log_sync_latency.Instantiate(entity_).get() },
+      { "batches per group", METRIC_log_entry_batches_per_group.Instantiate(entity_).get() },
+    };
+    for (const auto& h : log_histograms) {
+      HistogramSnapshotPB snapshot;
+      RETURN_NOT_OK(h.second->GetHistogramSnapshotPB(&snapshot, MetricJsonOptions()));
+      cout << "  " << h.first << "(count=" << snapshot.total_count()
+           << " mean=" << snapshot.mean()
+           << " p95=" << snapshot.percentile_95()
+           << " p99=" << snapshot.percentile_99()
+           << " p99.9=" << snapshot.percentile_99_9()
+           << " max=" << snapshot.max() << ")" << endl;
+    }
+    return Status::OK();
+  }
+
+  Env* const env_;
+  ObjectIdGenerator oid_generator_;
+  MetricRegistry metric_registry_;
+  scoped_refptr<MetricEntity> entity_;
+  scoped_refptr<Log> log_;
+
+  const unique_ptr<HdrHistogram> latencies_us_;
+  std::atomic<int64_t> data_load_bytes_;
+  std::atomic<bool> stop_data_load_;
+
+  // Protects 'next_index_' and orders the appends by index.
+  mutex append_lock_;
+  int64_t next_index_;
+};
+
+Status RunWal(const RunnerContext& context) {
+  const string& wal_dir = FindOrDie(context.required_args, kWalDirArg);
+  if (FLAGS_wal_batch_size <= 0 || FLAGS_wal_op_size_bytes < 0 ||
+      FLAGS_data_load_threads_per_dir < 0) {
+    return Status::InvalidArgument(
+        "--wal_batch_size must be positive, and --wal_op_size_bytes and "
+        "--data_load_threads_per_dir non-negative");
+  }
+  WalBenchmark benchmark(Env::Default());
+  return benchmark.Run(wal_dir);
+}
+
 } // anonymous namespace
 
 unique_ptr<Mode> BuildPerfMode() {
@@ -663,9 +1741,101 @@ unique_ptr<Mode> BuildPerfMode() {
       .AddOptionalParameter("use_random")
       .Build();
 
+  unique_ptr<Action> table_scan =
+      ActionBuilder("table_scan", &TableScan)
+      .Description("Scan a table and report the scan rate")
+      .ExtraDescription(
+          "Scan all the tablets of a table in parallel through scan tokens, "
+          "and report the number of rows and bytes scanned per second along "
+          "with per-tablet statistics and the skew between the tablets.")
+      .AddRequiredParameter({ kMasterAddressesArg, kMasterAddressesArgDesc })
+      .AddRequiredParameter({ kTableNameArg, "Name of the table to scan" })
+      .AddOptionalParameter("fill_cache")
+      .AddOptionalParameter("num_threads")
+      .Build();
+
+  unique_ptr<Action> workload =
+      ActionBuilder("workload", &RunWorkload)
+      .Description("Run a mixed workload and report the operation latencies")
+      .ExtraDescription(
+          "Load an auto-created table with generated rows, then run a YCSB-style "
+          "mix of inserts, upserts, updates, point lookups and range scans "
+          "against it, and report the throughput and latency percentiles "
+          "of each operation. For example, YCSB's workload A (50% reads, "
+          "50% updates) is the default, and its workload E is "
+          "--scan_pct=95 --insert_pct=5 --read_pct=0 --update_pct=0.")
+      .AddRequiredParameter({ kMasterAddressesArg, kMasterAddressesArgDesc })
+      .AddOptionalParameter("insert_pct")
+      .AddOptionalParameter("keep_auto_table")
+      .AddOptionalParameter("key_distribution")
+      .AddOptionalParameter("num_ops_per_thread")
+      .AddOptionalParameter("num_threads")
+      .AddOptionalParameter("read_pct")
+      .AddOptionalParameter("scan_length")
+      .AddOptionalParameter("scan_pct")
+      .AddOptionalParameter("show_first_n_errors")
+      .AddOptionalParameter("string_len")
+      .AddOptionalParameter("table_num_buckets")
+      .AddOptionalParameter("table_num_replicas")
+      .AddOptionalParameter("update_pct")
+      .AddOptionalParameter("upsert_pct")
+      .AddOptionalParameter("workload_record_count")
+      .AddOptionalParameter("workload_seed")
+      .Build();
+
+  unique_ptr<Action> replay =
+      ActionBuilder("replay", &RunReplay)
+      .Description("Replay captured write and scan requests against a cluster")
+      .ExtraDescription(
+          "Replay the write and scan requests captured by tablet servers "
+          "running with --request_capture_sampling_rate, at the pace they were "
+          "received, against the tables of the same name in the cluster, and "
+          "report the latency percentiles of the writes and the scans. Writes "
+          "are replayed as is, so replaying inserts into a cluster that "
+          "already has the rows results in errors.")
+      .AddRequiredParameter({ kMasterAddressesArg, kMasterAddressesArgDesc })
+      .AddRequiredVariadicParameter({
+          "capture_files", "Files of requests captured by the tablet servers" })
+      .AddOptionalParameter("num_threads")
+      .AddOptionalParameter("replay_speedup")
+      .AddOptionalParameter("show_first_n_errors")
+      .Build();
+
+  unique_ptr<Action> wal =
+      ActionBuilder("wal", &RunWal)
+      .Description("Measure the latency and throughput of WAL appends")
+      .ExtraDescription(
+          "Create a WAL in a temporary directory on the device to measure and "
+          "append batches of operations to it from several threads, through "
+          "the same code path as tablet replicas, optionally while loading "
+          "other directories with writes. Report the throughput and the "
+          "latency percentiles of the appends and of the syncs. To measure "
+          "durable appends, as when qualifying WAL devices, pass "
+          "--log_force_fsync_all.")
+      .AddRequiredParameter({ kWalDirArg,
+          "Directory in which to create the temporary WAL. It is deleted "
+          "afterwards." })
+      .AddOptionalParameter("data_load_dirs")
+      .AddOptionalParameter("data_load_threads_per_dir")
+      .AddOptionalParameter("group_commit_queue_size_bytes")
+      .AddOptionalParameter("log_compression_codec")
+      .AddOptionalParameter("log_force_fsync_all")
+      .AddOptionalParameter("log_group_sync")
+      .AddOptionalParameter("log_pipelined_sync")
+      .AddOptionalParameter("log_segment_size_mb")
+      .AddOptionalParameter("num_threads")
+      .AddOptionalParameter("wal_batch_size")
+      .AddOptionalParameter("wal_num_batches_per_thread")
+      .AddOptionalParameter("wal_op_size_bytes")
+      .Build();
+
   return ModeBuilder("perf")
       .Description("Measure the performance of a Kudu cluster")
       .AddAction(std::move(insert))
+      .AddAction(std::move(replay))
+      .AddAction(std::move(table_scan))
+      .AddAction(std::move(wal))
+      .AddAction(std::move(workload))
       .Build();
 }
 
@@ -150,7 +150,8 @@ class ReplicaDumper {
                                   &schema,
                                   &client_schema,
                                   client::KuduScanner::NO_FLAGS,
-                                  make_gscoped_ptr(resp.release_data())));
+                                  make_gscoped_ptr(resp.release_data()),
+                                  gscoped_ptr<ColumnarRowBlockPB>()));
       vector<KuduRowResult> rows;
       results.ExtractRows(&rows);
       for (const auto& r : rows) {
@@ -306,6 +307,10 @@ Status ListReplicas(const RunnerContext& context) {
       cout << "Estimated on disk size: "
            << HumanReadableNumBytes::ToString(rs.estimated_on_disk_size()) << endl;
     }
+    if (rs.has_proposed_split_key()) {
+      cout << "Proposed split key: "
+           << schema.DebugEncodedRowKey(rs.proposed_split_key(), Schema::START_KEY) << endl;
+    }
     cout << "Schema: " << schema.ToString() << endl;
   }
 
@@ -424,7 +424,7 @@ unique_ptr<Mode> BuildTabletMode() {
       .AddRequiredParameter({ kTsUuidArg,
                               "UUID of the tablet server that should host the new replica" })
       .AddRequiredParameter(
-          { kReplicaTypeArg, "New replica's type. Must be VOTER or NON-VOTER."
+          { kReplicaTypeArg, "New replica's type. Must be VOTER, NON-VOTER or WITNESS."
           })
       .Build();
 
@@ -17,6 +17,7 @@
 
 #include "kudu/tools/tool_action.h"
 
+#include <cstdint>
 #include <iostream>
 #include <memory>
 #include <string>
@@ -37,13 +38,20 @@
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/master/master.pb.h"
 #include "kudu/master/master.proxy.h"
+#include "kudu/rpc/rpc_controller.h"
+#include "kudu/server/server_base.pb.h"
 #include "kudu/tools/tool_action_common.h"
 #include "kudu/tserver/tablet_server.h"
+#include "kudu/tserver/tserver_admin.pb.h"
+#include "kudu/tserver/tserver_admin.proxy.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/status.h"
 
 DECLARE_string(columns);
+DECLARE_int64(timeout_ms);
 
 using std::cout;
+using std::endl;
 using std::string;
 using std::unique_ptr;
 using std::vector;
@@ -53,6 +61,10 @@ namespace kudu {
 using master::ListTabletServersRequestPB;
 using master::ListTabletServersResponsePB;
 using master::MasterServiceProxy;
+using rpc::RpcController;
+using tserver::DrainLeadersRequestPB;
+using tserver::DrainLeadersResponsePB;
+using tserver::TabletServerAdminServiceProxy;
 
 namespace tools {
 namespace {
@@ -64,6 +76,11 @@ const char* const kTServerAddressDesc = "Address of a Kudu Tablet Server of "
 const char* const kFlagArg = "flag";
 const char* const kValueArg = "value";
 
+// How often 'tserver drain_leaders' checks whether leaders remain. A
+// leadership transfer takes at most an election timeout, after which the
+// remaining leaders are asked again.
+const int64_t kDrainLeadersPollIntervalMs = 1000;
+
 Status TServerSetFlag(const RunnerContext& context) {
   const string& address = FindOrDie(context.required_args, kTServerAddressArg);
   const string& flag = FindOrDie(context.required_args, kFlagArg);
@@ -82,6 +99,39 @@ Status TServerTimestamp(const RunnerContext& context) {
   return PrintServerTimestamp(address, tserver::TabletServer::kDefaultPort);
 }
 
+Status TServerDrainLeaders(const RunnerContext& context) {
+  const string& address = FindOrDie(context.required_args, kTServerAddressArg);
+  server::ServerStatusPB status;
+  RETURN_NOT_OK(GetServerStatus(address, tserver::TabletServer::kDefaultPort, &status));
+  unique_ptr<TabletServerAdminServiceProxy> proxy;
+  RETURN_NOT_OK(BuildProxy(address, tserver::TabletServer::kDefaultPort, &proxy));
+
+  const MonoTime deadline = MonoTime::Now() + MonoDelta::FromMilliseconds(FLAGS_timeout_ms);
+  while (true) {
+    DrainLeadersRequestPB req;
+    DrainLeadersResponsePB resp;
+    RpcController rpc;
+    rpc.set_deadline(deadline);
+    req.set_dest_uuid(status.node_instance().permanent_uuid());
+    RETURN_NOT_OK(proxy->DrainLeaders(req, &resp, &rpc));
+    if (resp.has_error()) {
+      return StatusFromPB(resp.error().status());
+    }
+    if (resp.num_leaders() == 0) {
+      cout << "No tablet leaders remain on " << address << endl;
+      return Status::OK();
+    }
+    cout << strings::Substitute("$0 tablet leaders remain on $1 ($2 transfers started)",
+                                resp.num_leaders(), address, resp.num_transfers_started())
+         << endl;
+    if (MonoTime::Now() + MonoDelta::FromMilliseconds(kDrainLeadersPollIntervalMs) > deadline) {
+      return Status::TimedOut(strings::Substitute(
+          "$0 tablet leaders remain on $1", resp.num_leaders(), address));
+    }
+    SleepFor(MonoDelta::FromMilliseconds(kDrainLeadersPollIntervalMs));
+  }
+}
+
 Status ListTServers(const RunnerContext& context) {
   LeaderMasterProxy proxy;
   RETURN_NOT_OK(proxy.Init(context));
@@ -167,6 +217,19 @@ unique_ptr<Mode> BuildTServerMode() {
       .AddRequiredParameter({ kTServerAddressArg, kTServerAddressDesc })
       .Build();
 
+  unique_ptr<Action> drain_leaders =
+      ActionBuilder("drain_leaders", &TServerDrainLeaders)
+      .Description("Gracefully transfer the leadership of all the tablets led "
+                   "by a Kudu Tablet Server to other replicas")
+      .ExtraDescription("Leaders are asked to hand over their leadership to a "
+                        "follower which has caught up with them, e.g. before "
+                        "the Tablet Server is restarted. The tool waits until "
+                        "the Tablet Server leads no tablets or --timeout_ms "
+                        "elapses.")
+      .AddRequiredParameter({ kTServerAddressArg, kTServerAddressDesc })
+      .AddOptionalParameter("timeout_ms")
+      .Build();
+
   unique_ptr<Action> list_tservers =
       ActionBuilder("list", &ListTServers)
       .Description("List tablet servers in a Kudu cluster")
@@ -186,6 +249,7 @@ unique_ptr<Mode> BuildTServerMode() {
       .AddAction(std::move(status))
       .AddAction(std::move(timestamp))
       .AddAction(std::move(list_tservers))
+      .AddAction(std::move(drain_leaders))
       .Build();
 }
 
@@ -84,6 +84,14 @@ DEFINE_int32(heartbeat_inject_latency_before_heartbeat_ms, 0,
 TAG_FLAG(heartbeat_inject_latency_before_heartbeat_ms, runtime);
 TAG_FLAG(heartbeat_inject_latency_before_heartbeat_ms, unsafe);
 
+DEFINE_bool(heartbeat_compact_full_tablet_reports, true,
+            "Whether full tablet reports to masters which support it report a digest "
+            "of the consensus state of each running tablet replica rather than the "
+            "consensus state itself. The master asks for the replicas whose state it "
+            "doesn't know to be reported in full.");
+TAG_FLAG(heartbeat_compact_full_tablet_reports, advanced);
+TAG_FLAG(heartbeat_compact_full_tablet_reports, runtime);
+
 using kudu::master::MasterServiceProxy;
 using kudu::master::TabletReportPB;
 using kudu::pb_util::SecureDebugString;
@@ -133,7 +141,10 @@ class Heartbeater::Thread {
   void TriggerASAP();
   void MarkTabletDirty(const string& tablet_id, const string& reason);
   void GenerateIncrementalTabletReport(TabletReportPB* report);
-  void GenerateFullTabletReport(TabletReportPB* report);
+  // Generates a full tablet report. If 'compact' is true, the running replicas
+  // report a digest of their consensus state (see
+  // ReportedTabletPB.consensus_state_digest).
+  void GenerateFullTabletReport(TabletReportPB* report, bool compact);
 
   // Mark that the master successfully received and processed the given
   // tablet report. This uses the report sequence number to "un-dirty" any
@@ -280,7 +291,7 @@ vector<TabletReportPB> Heartbeater::GenerateFullTabletReportsForTests() {
   vector<TabletReportPB>  results;
   for (const auto& thread : threads_) {
     TabletReportPB report;
-    thread->GenerateFullTabletReport(&report);
+    thread->GenerateFullTabletReport(&report, /*compact=*/false);
     results.emplace_back(std::move(report));
   }
   return results;
@@ -416,11 +427,13 @@ Status Heartbeater::Thread::DoHeartbeat() {
   // send us knew ones if they exist.
   req.set_latest_tsk_seq_num(server_->token_verifier().GetMaxKnownKeySequenceNumber());
 
+  const bool compact_full_report = FLAGS_heartbeat_compact_full_tablet_reports &&
+      last_hb_response_.supports_compact_tablet_reports();
   if (send_full_tablet_report_) {
     LOG(INFO) << Substitute(
         "Master $0 was elected leader, sending a full tablet report...",
         master_address_.ToString());
-    GenerateFullTabletReport(req.mutable_tablet_report());
+    GenerateFullTabletReport(req.mutable_tablet_report(), compact_full_report);
     // Should the heartbeat fail, we'd want the next heartbeat to resend this
     // full tablet report. As such, send_full_tablet_report_ is only reset
     // after all error checking is complete.
@@ -428,13 +441,14 @@ Status Heartbeater::Thread::DoHeartbeat() {
     LOG(INFO) << Substitute(
         "Master $0 requested a full tablet report, sending...",
         master_address_.ToString());
-    GenerateFullTabletReport(req.mutable_tablet_report());
+    GenerateFullTabletReport(req.mutable_tablet_report(), compact_full_report);
   } else {
     VLOG(2) << Substitute("Sending an incremental tablet report to master $0...",
                           master_address_.ToString());
     GenerateIncrementalTabletReport(req.mutable_tablet_report());
   }
   req.set_num_live_tablets(server_->tablet_manager()->GetNumLiveTablets());
+  server_->tablet_manager()->PopulateLoad(req.mutable_load());
 
   RpcController rpc;
   rpc.set_timeout(MonoDelta::FromMilliseconds(FLAGS_heartbeat_rpc_timeout_ms));
@@ -491,6 +505,14 @@ Status Heartbeater::Thread::DoHeartbeat() {
   }
 
   MarkTabletReportAcknowledged(req.tablet_report());
+
+  // Report in full the tablets the master couldn't make sense of in compact
+  // form, in the next heartbeat.
+  for (const auto& update : last_hb_response_.tablet_report().tablets()) {
+    if (update.needs_full_report()) {
+      MarkTabletDirty(update.tablet_id(), "master requested a full report");
+    }
+  }
   return Status::OK();
 }
 
@@ -643,11 +665,11 @@ void Heartbeater::Thread::GenerateIncrementalTabletReport(TabletReportPB* report
       report, dirty_tablet_ids);
 }
 
-void Heartbeater::Thread::GenerateFullTabletReport(TabletReportPB* report) {
+void Heartbeater::Thread::GenerateFullTabletReport(TabletReportPB* report, bool compact) {
   report->Clear();
   report->set_sequence_number(next_report_seq_.fetch_add(1));
   report->set_is_incremental(false);
-  server_->tablet_manager()->PopulateFullTabletReport(report);
+  server_->tablet_manager()->PopulateFullTabletReport(report, compact);
 }
 
 } // namespace tserver
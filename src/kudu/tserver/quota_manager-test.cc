@@ -0,0 +1,125 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/tserver/quota_manager.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <gflags/gflags_declare.h>
+#include <gtest/gtest.h>
+
+#include "kudu/util/monotime.h"
+#include "kudu/util/status.h"
+#include "kudu/util/test_macros.h"
+#include "kudu/util/test_util.h"
+
+DECLARE_string(table_quotas);
+DECLARE_string(user_quotas);
+
+using std::string;
+using std::unordered_map;
+using std::vector;
+
+namespace kudu {
+namespace tserver {
+
+class QuotaManagerTest : public KuduTest {
+ public:
+  QuotaManagerTest()
+      : now_(MonoTime::Now()) {
+  }
+
+ protected:
+  MonoTime now_;
+};
+
+TEST_F(QuotaManagerTest, TestParseQuotas) {
+  vector<unordered_map<string, int64_t>> limits;
+  ASSERT_OK(QuotaManager::ParseQuotas("", &limits));
+  ASSERT_EQ(QuotaManager::kNumResources, limits.size());
+  ASSERT_OK(QuotaManager::ParseQuotas(
+      "t1:write_bytes:1000, db:t2 : scan_rows : 20,t1:scan_bytes:300", &limits));
+  ASSERT_EQ(1000, limits[QuotaManager::kWriteBytes]["t1"]);
+  ASSERT_EQ(20, limits[QuotaManager::kScanRows]["db:t2"]);
+  ASSERT_EQ(300, limits[QuotaManager::kScanBytes]["t1"]);
+
+  for (const char* bad : { "t1", "t1:1000", ":write_bytes:1000", "t1:reads:1000",
+                           "t1:write_bytes:0", "t1:write_bytes:x" }) {
+    ASSERT_TRUE(QuotaManager::ParseQuotas(bad, &limits).IsInvalidArgument()) << bad;
+  }
+}
+
+// Writes are admitted while the quotas of their table and user aren't in
+// debt, and rejected until the debt is repaid.
+TEST_F(QuotaManagerTest, TestWriteQuotas) {
+  FLAGS_table_quotas = "t1:write_bytes:1000";
+  FLAGS_user_quotas = "bob:write_bytes:500";
+  QuotaManager quotas;
+  ASSERT_TRUE(quotas.enabled());
+
+  // A burst of a second worth of writes is admitted, and the write which
+  // exhausts the bucket is admitted too.
+  ASSERT_TRUE(quotas.AdmitWrite("t1", "alice", 600, now_));
+  ASSERT_TRUE(quotas.AdmitWrite("t1", "alice", 600, now_));
+  ASSERT_FALSE(quotas.AdmitWrite("t1", "alice", 1, now_));
+
+  // Other tables aren't affected.
+  ASSERT_TRUE(quotas.AdmitWrite("t2", "alice", 1000000, now_));
+
+  // The debt of 200 bytes is repaid after 200ms.
+  ASSERT_FALSE(quotas.AdmitWrite("t1", "alice", 1, now_ + MonoDelta::FromMilliseconds(100)));
+  ASSERT_TRUE(quotas.AdmitWrite("t1", "alice", 1, now_ + MonoDelta::FromMilliseconds(300)));
+
+  // The user quota applies to all the tables.
+  ASSERT_TRUE(quotas.AdmitWrite("t2", "bob", 600, now_));
+  ASSERT_FALSE(quotas.AdmitWrite("t3", "bob", 1, now_));
+}
+
+// Scans are charged once their batches end, and the following batches are
+// delayed until the debt is repaid.
+TEST_F(QuotaManagerTest, TestScanQuotas) {
+  FLAGS_table_quotas = "t1:scan_rows:100,t1:scan_bytes:1000";
+  QuotaManager quotas;
+  ASSERT_EQ(MonoDelta::FromSeconds(0), quotas.ScanDelay("t1", "alice", now_));
+
+  // Scanning twice the rate puts the row quota a second in debt.
+  quotas.ChargeScan("t1", "alice", 200, 10, now_);
+  ASSERT_EQ(MonoDelta::FromSeconds(1), quotas.ScanDelay("t1", "alice", now_));
+  ASSERT_EQ(MonoDelta::FromMilliseconds(500),
+            quotas.ScanDelay("t1", "alice", now_ + MonoDelta::FromMilliseconds(500)));
+
+  // The longest delay of the quotas applies.
+  quotas.ChargeScan("t1", "alice", 0, 4000, now_ + MonoDelta::FromMilliseconds(500));
+  ASSERT_EQ(MonoDelta::FromSeconds(3),
+            quotas.ScanDelay("t1", "alice", now_ + MonoDelta::FromMilliseconds(500)));
+
+  ASSERT_EQ(MonoDelta::FromSeconds(0), quotas.ScanDelay("t2", "alice", now_));
+}
+
+TEST_F(QuotaManagerTest, TestDisabled) {
+  QuotaManager quotas;
+  ASSERT_FALSE(quotas.enabled());
+  ASSERT_TRUE(quotas.AdmitWrite("t1", "alice", 1L << 40, now_));
+  quotas.ChargeScan("t1", "alice", 1L << 40, 1L << 40, now_);
+  ASSERT_EQ(MonoDelta::FromSeconds(0), quotas.ScanDelay("t1", "alice", now_));
+}
+
+} // namespace tserver
+} // namespace kudu
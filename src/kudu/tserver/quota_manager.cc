@@ -0,0 +1,260 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/tserver/quota_manager.h"
+
+#include <algorithm>
+#include <iterator>
+#include <mutex>
+#include <utility>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "kudu/gutil/strings/numbers.h"
+#include "kudu/gutil/strings/split.h"
+#include "kudu/gutil/strings/strip.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/flag_tags.h"
+
+DEFINE_string(table_quotas, "",
+              "Comma-separated list of <table>:<resource>:<limit> triples setting "
+              "per-second quotas on what this tablet server serves to the given "
+              "tables, over all of their tablets. <resource> is one of "
+              "'write_bytes' (bytes of row operations written), 'scan_rows' (rows "
+              "scanned) and 'scan_bytes' (bytes of scan results returned). Writes "
+              "exceeding a quota are rejected as throttled, and scans exceeding one "
+              "are slowed down.");
+TAG_FLAG(table_quotas, experimental);
+
+DEFINE_string(user_quotas, "",
+              "Comma-separated list of <user>:<resource>:<limit> triples setting "
+              "per-second quotas on what this tablet server serves to the given "
+              "users. See --table_quotas for the resources.");
+TAG_FLAG(user_quotas, experimental);
+
+DEFINE_double(quota_burst_seconds, 1.0,
+              "The number of seconds worth of its rate a table or user may consume "
+              "in a burst after being idle, as per --table_quotas and --user_quotas.");
+TAG_FLAG(quota_burst_seconds, experimental);
+
+DEFINE_int32(quota_max_scan_delay_ms, 500,
+             "The longest the response to a scan batch is held back while the scan "
+             "quotas of its table or user are exceeded. Such a batch returns no rows, "
+             "and the next one is held back again if the quotas are still exceeded.");
+TAG_FLAG(quota_max_scan_delay_ms, experimental);
+TAG_FLAG(quota_max_scan_delay_ms, runtime);
+
+namespace {
+
+bool ValidateQuotas(const char* flagname, const std::string& value) {
+  std::vector<std::unordered_map<std::string, int64_t>> limits;
+  kudu::Status s = kudu::tserver::QuotaManager::ParseQuotas(value, &limits);
+  if (!s.ok()) {
+    LOG(ERROR) << strings::Substitute("Invalid value for --$0: $1", flagname, s.ToString());
+    return false;
+  }
+  return true;
+}
+DEFINE_validator(table_quotas, &ValidateQuotas);
+DEFINE_validator(user_quotas, &ValidateQuotas);
+
+bool ValidateBurstSeconds(const char* flagname, double value) {
+  if (value > 0) {
+    return true;
+  }
+  LOG(ERROR) << strings::Substitute("Invalid value for --$0: $1 (must be positive)",
+                                    flagname, value);
+  return false;
+}
+DEFINE_validator(quota_burst_seconds, &ValidateBurstSeconds);
+
+} // anonymous namespace
+
+using std::string;
+using std::unique_ptr;
+using std::unordered_map;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+namespace tserver {
+
+namespace {
+
+const char* const kResourceNames[] = { "write_bytes", "scan_rows", "scan_bytes" };
+static_assert(arraysize(kResourceNames) == QuotaManager::kNumResources,
+              "a resource is missing a name");
+
+} // anonymous namespace
+
+QuotaManager::Bucket::Bucket(int64_t rate, double burst_seconds)
+    : rate_(rate),
+      capacity_(rate * burst_seconds),
+      tokens_(capacity_) {
+}
+
+void QuotaManager::Bucket::RefillUnlocked(MonoTime now) {
+  if (last_refill_.Initialized() && now > last_refill_) {
+    tokens_ = std::min(capacity_, tokens_ + rate_ * (now - last_refill_).ToSeconds());
+  }
+  if (!last_refill_.Initialized() || now > last_refill_) {
+    last_refill_ = now;
+  }
+}
+
+MonoDelta QuotaManager::Bucket::TimeToRepay(MonoTime now) {
+  std::lock_guard<simple_spinlock> l(lock_);
+  RefillUnlocked(now);
+  if (tokens_ >= 0) {
+    return MonoDelta::FromSeconds(0);
+  }
+  return MonoDelta::FromSeconds(-tokens_ / rate_);
+}
+
+void QuotaManager::Bucket::Charge(int64_t amount, MonoTime now) {
+  std::lock_guard<simple_spinlock> l(lock_);
+  RefillUnlocked(now);
+  tokens_ -= amount;
+}
+
+QuotaManager::QuotaManager()
+    : table_buckets_(kNumResources),
+      user_buckets_(kNumResources) {
+  vector<unordered_map<string, int64_t>> limits;
+  CHECK_OK(ParseQuotas(FLAGS_table_quotas, &limits));
+  AddBuckets(limits, &table_buckets_);
+  CHECK_OK(ParseQuotas(FLAGS_user_quotas, &limits));
+  AddBuckets(limits, &user_buckets_);
+  enabled_ = !FLAGS_table_quotas.empty() || !FLAGS_user_quotas.empty();
+}
+
+QuotaManager::~QuotaManager() {
+}
+
+Status QuotaManager::ParseQuotas(const string& quotas,
+                                 vector<unordered_map<string, int64_t>>* limits) {
+  limits->clear();
+  limits->resize(kNumResources);
+  vector<string> quota_list = strings::Split(quotas, ",", strings::SkipWhitespace());
+  for (const string& quota : quota_list) {
+    // Split from the right, so that keys may contain colons.
+    size_t limit_sep = quota.rfind(':');
+    size_t resource_sep = limit_sep == string::npos || limit_sep == 0 ?
+        string::npos : quota.rfind(':', limit_sep - 1);
+    if (resource_sep == string::npos) {
+      return Status::InvalidArgument(Substitute("invalid quota '$0'", quota));
+    }
+    string key = quota.substr(0, resource_sep);
+    string resource_name = quota.substr(resource_sep + 1, limit_sep - resource_sep - 1);
+    string limit_str = quota.substr(limit_sep + 1);
+    StripWhiteSpace(&key);
+    StripWhiteSpace(&resource_name);
+    StripWhiteSpace(&limit_str);
+    if (key.empty()) {
+      return Status::InvalidArgument(Substitute("invalid quota '$0'", quota));
+    }
+    const char* const* name = std::find(std::begin(kResourceNames), std::end(kResourceNames),
+                                        resource_name);
+    if (name == std::end(kResourceNames)) {
+      return Status::InvalidArgument(Substitute("unknown resource in quota '$0'", quota));
+    }
+    int64_t limit;
+    if (!safe_strto64(limit_str, &limit) || limit <= 0) {
+      return Status::InvalidArgument(Substitute("invalid limit in quota '$0'", quota));
+    }
+    (*limits)[name - std::begin(kResourceNames)][key] = limit;
+  }
+  return Status::OK();
+}
+
+void QuotaManager::AddBuckets(const vector<unordered_map<string, int64_t>>& limits,
+                              vector<BucketMap>* buckets) {
+  for (int r = 0; r < kNumResources; r++) {
+    for (const auto& key_and_limit : limits[r]) {
+      (*buckets)[r].emplace(key_and_limit.first,
+                            unique_ptr<Bucket>(new Bucket(key_and_limit.second,
+                                                          FLAGS_quota_burst_seconds)));
+    }
+  }
+}
+
+QuotaManager::Bucket* QuotaManager::FindBucket(vector<BucketMap>* buckets,
+                                               Resource resource,
+                                               const string& key) {
+  const BucketMap& map = (*buckets)[resource];
+  if (map.empty()) {
+    return nullptr;
+  }
+  auto it = map.find(key);
+  return it == map.end() ? nullptr : it->second.get();
+}
+
+bool QuotaManager::AdmitWrite(const string& table, const string& user,
+                              int64_t bytes, MonoTime now) {
+  if (!enabled_) {
+    return true;
+  }
+  Bucket* table_bucket = FindBucket(&table_buckets_, kWriteBytes, table);
+  Bucket* user_bucket = FindBucket(&user_buckets_, kWriteBytes, user);
+  for (Bucket* bucket : { table_bucket, user_bucket }) {
+    if (bucket && bucket->TimeToRepay(now).ToNanoseconds() > 0) {
+      return false;
+    }
+  }
+  for (Bucket* bucket : { table_bucket, user_bucket }) {
+    if (bucket) {
+      bucket->Charge(bytes, now);
+    }
+  }
+  return true;
+}
+
+MonoDelta QuotaManager::ScanDelay(const string& table, const string& user, MonoTime now) {
+  MonoDelta delay = MonoDelta::FromSeconds(0);
+  if (!enabled_) {
+    return delay;
+  }
+  for (Resource resource : { kScanRows, kScanBytes }) {
+    for (Bucket* bucket : { FindBucket(&table_buckets_, resource, table),
+                            FindBucket(&user_buckets_, resource, user) }) {
+      if (bucket) {
+        delay = std::max(delay, bucket->TimeToRepay(now));
+      }
+    }
+  }
+  return delay;
+}
+
+void QuotaManager::ChargeScan(const string& table, const string& user,
+                              int64_t rows, int64_t bytes, MonoTime now) {
+  if (!enabled_) {
+    return;
+  }
+  for (Resource resource : { kScanRows, kScanBytes }) {
+    int64_t amount = resource == kScanRows ? rows : bytes;
+    for (Bucket* bucket : { FindBucket(&table_buckets_, resource, table),
+                            FindBucket(&user_buckets_, resource, user) }) {
+      if (bucket) {
+        bucket->Charge(amount, now);
+      }
+    }
+  }
+}
+
+} // namespace tserver
+} // namespace kudu
@@ -0,0 +1,140 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_TSERVER_QUOTA_MANAGER_H
+#define KUDU_TSERVER_QUOTA_MANAGER_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+namespace tserver {
+
+// Enforces per-table and per-user quotas on the rate of the writes and scans
+// served by this tablet server, so that a single tenant can't saturate it at
+// the expense of everyone else's latency.
+//
+// The quotas are set with --table_quotas and --user_quotas, and each is
+// enforced with a token bucket shared by all the tablets of the table hosted
+// by this server, or by all the requests of the user. A quota thus caps what
+// each tablet server serves to a table or user, rather than what the whole
+// cluster does.
+//
+// Requests are admitted as long as their buckets aren't in debt, and charged
+// once their cost is known, which may put the buckets in debt: writes that
+// would exceed a quota are rejected, and the batches of scans that exceeded
+// one are held back until the debt is repaid.
+//
+// This class is thread-safe.
+class QuotaManager {
+ public:
+  // The resources whose rate quotas limit.
+  enum Resource {
+    // Bytes of row operations written.
+    kWriteBytes,
+    // Rows scanned, whether or not they're returned.
+    kScanRows,
+    // Bytes of scan results returned.
+    kScanBytes,
+    kNumResources
+  };
+
+  QuotaManager();
+  ~QuotaManager();
+
+  // Parses 'quotas', a comma-separated list of <key>:<resource>:<limit>
+  // triples as in --table_quotas, into 'limits', which maps each resource
+  // to the per-second limits of its keys.
+  static Status ParseQuotas(
+      const std::string& quotas,
+      std::vector<std::unordered_map<std::string, int64_t>>* limits);
+
+  // Whether any quota is set.
+  bool enabled() const { return enabled_; }
+
+  // Returns whether a write of 'bytes' bytes to table 'table' by user 'user'
+  // is admitted at 'now' by their quotas. If it is, it's charged to them.
+  bool AdmitWrite(const std::string& table, const std::string& user,
+                  int64_t bytes, MonoTime now);
+
+  // Returns how long a scan batch of table 'table' by user 'user' starting at
+  // 'now' should be held back for the debt of their scan quotas to be repaid.
+  MonoDelta ScanDelay(const std::string& table, const std::string& user, MonoTime now);
+
+  // Charges a scan batch of table 'table' by user 'user' ending at 'now',
+  // which scanned 'rows' rows and returned 'bytes' bytes.
+  void ChargeScan(const std::string& table, const std::string& user,
+                  int64_t rows, int64_t bytes, MonoTime now);
+
+ private:
+  // A token bucket which may go in debt.
+  class Bucket {
+   public:
+    Bucket(int64_t rate, double burst_seconds);
+
+    // Refills the bucket at 'now', and returns how long it takes for its
+    // debt to be repaid.
+    MonoDelta TimeToRepay(MonoTime now);
+
+    // Takes 'amount' tokens at 'now', going in debt if there aren't enough.
+    void Charge(int64_t amount, MonoTime now);
+
+   private:
+    void RefillUnlocked(MonoTime now);
+
+    const double rate_;
+    const double capacity_;
+
+    simple_spinlock lock_;
+    double tokens_;
+    MonoTime last_refill_;
+
+    DISALLOW_COPY_AND_ASSIGN(Bucket);
+  };
+
+  typedef std::unordered_map<std::string, std::unique_ptr<Bucket>> BucketMap;
+
+  // Adds a bucket to 'buckets' for each of the limits of each resource.
+  static void AddBuckets(const std::vector<std::unordered_map<std::string, int64_t>>& limits,
+                         std::vector<BucketMap>* buckets);
+
+  // Returns the bucket of 'key' for 'resource' in 'buckets', or null if
+  // the key has no quota on the resource.
+  static Bucket* FindBucket(std::vector<BucketMap>* buckets, Resource resource,
+                            const std::string& key);
+
+  // The buckets of the tables and the users, indexed by resource. They're
+  // set up at construction, so they may be looked up without locking.
+  std::vector<BucketMap> table_buckets_;
+  std::vector<BucketMap> user_buckets_;
+
+  bool enabled_;
+
+  DISALLOW_COPY_AND_ASSIGN(QuotaManager);
+};
+
+} // namespace tserver
+} // namespace kudu
+
+#endif // KUDU_TSERVER_QUOTA_MANAGER_H
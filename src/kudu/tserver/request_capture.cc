@@ -0,0 +1,148 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/gutil/strings/stringpiece.h"
+#include "kudu/tserver/request_capture.h"
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "kudu/common/partition.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/walltime.h"
+#include "kudu/tablet/tablet_metadata.h"
+#include "kudu/tablet/tablet_replica.h"
+#include "kudu/tserver/tserver.pb.h"
+#include "kudu/util/coding.h"
+#include "kudu/util/env.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/mutex.h"
+#include "kudu/util/random_util.h"
+#include "kudu/util/slice.h"
+
+DEFINE_double(request_capture_sampling_rate, 0,
+              "Fraction of the write and scan requests received by the tablet "
+              "server to capture into the 'requests' log in --log_dir, for "
+              "replaying with 'kudu perf replay'. 0 disables the capture.");
+TAG_FLAG(request_capture_sampling_rate, experimental);
+TAG_FLAG(request_capture_sampling_rate, runtime);
+
+DEFINE_int32(request_capture_log_size_limit_mb, 256,
+             "Size at which the log of captured requests is rolled over to a "
+             "new file.");
+TAG_FLAG(request_capture_log_size_limit_mb, experimental);
+
+using std::string;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+namespace tserver {
+
+RequestCapture::RequestCapture(Env* env, const string& log_dir)
+    : rng_(GetRandomSeed32()),
+      log_(env, log_dir, "requests") {
+  log_.SetSizeLimitBytes(static_cast<int64_t>(FLAGS_request_capture_log_size_limit_mb) << 20);
+  // The captured requests are binary records read back by 'kudu perf replay'.
+  log_.SetCompressionEnabled(false);
+}
+
+RequestCapture::~RequestCapture() {
+}
+
+bool RequestCapture::ShouldCapture() {
+  const double rate = FLAGS_request_capture_sampling_rate;
+  return rate > 0 && rng_.NextDoubleFraction() < rate;
+}
+
+void RequestCapture::InitCapturedRequest(const tablet::TabletReplica& replica,
+                                         const MonoTime& received,
+                                         CapturedRequestPB* pb) {
+  // Translate the monotonic receipt time into wall clock time, so requests
+  // captured on different servers can be interleaved when replayed.
+  const MonoDelta queued = MonoTime::Now() - received;
+  pb->set_received_micros(GetCurrentTimeMicros() - queued.ToMicroseconds());
+  const auto& meta = replica.tablet_metadata();
+  pb->set_table_name(meta->table_name());
+  pb->set_partition_key_start(meta->partition().partition_key_start());
+  pb->set_partition_key_end(meta->partition().partition_key_end());
+}
+
+void RequestCapture::CaptureWrite(const tablet::TabletReplica& replica,
+                                  const WriteRequestPB& req,
+                                  const MonoTime& received) {
+  CapturedRequestPB pb;
+  InitCapturedRequest(replica, received, &pb);
+  pb.mutable_write()->CopyFrom(req);
+  // The external consistency state is meaningless to the cluster the request
+  // is replayed against.
+  pb.mutable_write()->clear_propagated_timestamp();
+  Append(pb);
+}
+
+void RequestCapture::CaptureScan(const tablet::TabletReplica& replica,
+                                 const NewScanRequestPB& scan_pb,
+                                 const MonoTime& received) {
+  CapturedRequestPB pb;
+  InitCapturedRequest(replica, received, &pb);
+  pb.mutable_scan()->CopyFrom(scan_pb);
+  pb.mutable_scan()->clear_propagated_timestamp();
+  Append(pb);
+}
+
+void RequestCapture::Append(const CapturedRequestPB& pb) {
+  faststring buf;
+  PutFixed32LengthPrefixedSlice(&buf, Slice(pb.SerializeAsString()));
+  MutexLock l(lock_);
+  WARN_NOT_OK(log_.Append(StringPiece(reinterpret_cast<const char*>(buf.data()), buf.size())),
+              "unable to capture request");
+}
+
+Status ReadCapturedRequests(Env* env,
+                            const string& path,
+                            vector<CapturedRequestPB>* requests) {
+  faststring data;
+  RETURN_NOT_OK(ReadFileToString(env, path, &data));
+  Slice remaining(data);
+  while (!remaining.empty()) {
+    if (remaining.size() < sizeof(uint32_t)) {
+      return Status::Corruption(Substitute("$0: truncated record length", path));
+    }
+    const uint32_t len = DecodeFixed32(remaining.data());
+    remaining.remove_prefix(sizeof(uint32_t));
+    if (remaining.size() < len) {
+      return Status::Corruption(Substitute("$0: truncated record of $1 bytes", path, len));
+    }
+    CapturedRequestPB pb;
+    if (!pb.ParseFromArray(remaining.data(), len)) {
+      return Status::Corruption(Substitute("$0: unable to parse record", path));
+    }
+    requests->emplace_back(std::move(pb));
+    remaining.remove_prefix(len);
+  }
+  return Status::OK();
+}
+
+} // namespace tserver
+} // namespace kudu
@@ -0,0 +1,103 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_TSERVER_REQUEST_CAPTURE_H
+#define KUDU_TSERVER_REQUEST_CAPTURE_H
+
+#include <string>
+#include <vector>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/util/mutex.h"
+#include "kudu/util/random.h"
+#include "kudu/util/rolling_log.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+class Env;
+class MonoTime;
+
+namespace tablet {
+class TabletReplica;
+} // namespace tablet
+
+namespace tserver {
+
+class CapturedRequestPB;
+class NewScanRequestPB;
+class WriteRequestPB;
+
+// Captures a sample of the write and new scan requests received by a tablet
+// server, along with when they were received, into a rolling log named
+// "requests" in --log_dir. 'kudu perf replay' replays them against another
+// cluster, to validate configuration and version changes against the shape
+// of real traffic.
+//
+// Each record of the log is a CapturedRequestPB, prefixed by its size as a
+// little-endian fixed32.
+//
+// The sampled requests are written out synchronously by the thread handling
+// them, so the sampling rate should be kept low on busy servers.
+//
+// This class is thread-safe.
+class RequestCapture {
+ public:
+  RequestCapture(Env* env, const std::string& log_dir);
+  ~RequestCapture();
+
+  // Returns whether the next request should be captured, as per
+  // --request_capture_sampling_rate.
+  bool ShouldCapture();
+
+  // Captures the write request 'req' to 'replica', received at 'received'.
+  void CaptureWrite(const tablet::TabletReplica& replica,
+                    const WriteRequestPB& req,
+                    const MonoTime& received);
+
+  // Captures the new scan request 'scan_pb' to 'replica', received at
+  // 'received'.
+  void CaptureScan(const tablet::TabletReplica& replica,
+                   const NewScanRequestPB& scan_pb,
+                   const MonoTime& received);
+
+ private:
+  // Fills in the fields of 'pb' common to writes and scans.
+  static void InitCapturedRequest(const tablet::TabletReplica& replica,
+                                  const MonoTime& received,
+                                  CapturedRequestPB* pb);
+
+  // Appends 'pb' to the log.
+  void Append(const CapturedRequestPB& pb);
+
+  ThreadSafeRandom rng_;
+
+  Mutex lock_;
+  RollingLog log_;
+
+  DISALLOW_COPY_AND_ASSIGN(RequestCapture);
+};
+
+// Reads the requests captured in the log file at 'path', appending them to
+// 'requests'.
+Status ReadCapturedRequests(Env* env,
+                            const std::string& path,
+                            std::vector<CapturedRequestPB>* requests);
+
+} // namespace tserver
+} // namespace kudu
+
+#endif // KUDU_TSERVER_REQUEST_CAPTURE_H
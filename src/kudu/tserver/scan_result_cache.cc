@@ -0,0 +1,157 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/tserver/scan_result_cache.h"
+
+#include <cstring>
+#include <string>
+
+#include <glog/logging.h>
+
+#include "kudu/common/common.pb.h"
+#include "kudu/common/wire_protocol.pb.h"
+#include "kudu/tserver/tserver.pb.h"
+#include "kudu/util/cache.h"
+#include "kudu/util/coding.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/slice.h"
+
+using std::string;
+
+namespace kudu {
+namespace tserver {
+
+namespace {
+
+// Entries bigger than this fraction of the capacity aren't cached, so that
+// one large result doesn't evict all the others.
+const int kMaxEntryCapacityFraction = 8;
+
+// Appends the length of 'data' followed by 'data' to 'dst'.
+void PutLengthPrefixed(faststring* dst, const Slice& data) {
+  PutFixed32(dst, data.size());
+  dst->append(data.data(), data.size());
+}
+
+// Reads the length-prefixed data at the start of 'input' into 'data',
+// advancing 'input' past it.
+bool GetLengthPrefixed(Slice* input, Slice* data) {
+  if (input->size() < sizeof(uint32_t)) {
+    return false;
+  }
+  uint32_t len = DecodeFixed32(input->data());
+  input->remove_prefix(sizeof(uint32_t));
+  if (input->size() < len) {
+    return false;
+  }
+  *data = Slice(input->data(), len);
+  input->remove_prefix(len);
+  return true;
+}
+
+} // anonymous namespace
+
+ScanResultCache::ScanResultCache(size_t capacity)
+    : capacity_(capacity),
+      cache_(NewLRUCache(DRAM_CACHE, capacity, "scan_result_cache")) {
+}
+
+ScanResultCache::~ScanResultCache() {}
+
+bool ScanResultCache::EncodeKey(const NewScanRequestPB& scan_pb,
+                                uint32_t schema_version,
+                                faststring* key) {
+  if (scan_pb.read_mode() != READ_AT_SNAPSHOT || !scan_pb.has_snap_timestamp()) {
+    return false;
+  }
+  // Leave out the fields which don't change the results of the scan.
+  NewScanRequestPB key_pb(scan_pb);
+  key_pb.clear_propagated_timestamp();
+  key_pb.clear_cache_blocks();
+  string serialized;
+  if (!key_pb.SerializeToString(&serialized)) {
+    return false;
+  }
+  key->clear();
+  PutFixed32(key, schema_version);
+  key->append(serialized);
+  return true;
+}
+
+void ScanResultCache::Insert(const Slice& key,
+                             const ScanResponsePB& resp,
+                             const Slice& rows_data,
+                             const Slice& indirect_data) {
+  ScanResponsePB cached_pb;
+  if (resp.has_data()) {
+    cached_pb.mutable_data()->set_num_rows(resp.data().num_rows());
+  }
+  cached_pb.mutable_aggregate_groups()->CopyFrom(resp.aggregate_groups());
+  if (resp.has_last_primary_key()) {
+    cached_pb.set_last_primary_key(resp.last_primary_key());
+  }
+  if (resp.has_snap_timestamp()) {
+    cached_pb.set_snap_timestamp(resp.snap_timestamp());
+  }
+
+  faststring value;
+  PutLengthPrefixed(&value, Slice(cached_pb.SerializeAsString()));
+  PutLengthPrefixed(&value, rows_data);
+  PutLengthPrefixed(&value, indirect_data);
+  size_t charge = key.size() + value.size();
+  if (charge > capacity_ / kMaxEntryCapacityFraction) {
+    return;
+  }
+
+  Cache::PendingHandle* pending = cache_->Allocate(key, value.size(), charge);
+  if (!pending) {
+    return;
+  }
+  memcpy(cache_->MutableValue(pending), value.data(), value.size());
+  Cache::Handle* inserted = cache_->Insert(pending, nullptr);
+  cache_->Release(inserted);
+}
+
+bool ScanResultCache::Lookup(const Slice& key,
+                             ScanResponsePB* resp,
+                             faststring* rows_data,
+                             faststring* indirect_data) {
+  Cache::UniqueHandle handle(cache_->Lookup(key, Cache::EXPECT_IN_CACHE),
+                             Cache::HandleDeleter(cache_.get()));
+  if (!handle) {
+    return false;
+  }
+  Slice value = cache_->Value(handle.get());
+  Slice pb_data;
+  Slice rows;
+  Slice indirect;
+  ScanResponsePB cached_pb;
+  if (!GetLengthPrefixed(&value, &pb_data) ||
+      !GetLengthPrefixed(&value, &rows) ||
+      !GetLengthPrefixed(&value, &indirect) ||
+      !cached_pb.ParseFromArray(pb_data.data(), pb_data.size())) {
+    LOG(DFATAL) << "Corrupt scan result cache entry";
+    return false;
+  }
+  resp->MergeFrom(cached_pb);
+  rows_data->assign_copy(rows.data(), rows.size());
+  indirect_data->assign_copy(indirect.data(), indirect.size());
+  return true;
+}
+
+} // namespace tserver
+} // namespace kudu
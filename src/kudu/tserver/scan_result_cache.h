@@ -0,0 +1,91 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_TSERVER_SCAN_RESULT_CACHE_H
+#define KUDU_TSERVER_SCAN_RESULT_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "kudu/gutil/macros.h"
+
+namespace kudu {
+
+class Cache;
+class Slice;
+class faststring;
+
+namespace tserver {
+
+class NewScanRequestPB;
+class ScanResponsePB;
+
+// An LRU cache of the results of snapshot scans which complete in a single
+// response, so that a scan repeated with the same projection, predicates and
+// snapshot timestamp (e.g. by a dashboard) is answered without scanning the
+// tablet again.
+//
+// Only scans at a snapshot timestamp chosen by the client are cached: once
+// the scan ran, writes can't change the rows visible at that timestamp, so
+// entries never need to be invalidated on write. Instead, the tablet's schema
+// version is part of the key, so an altered tablet doesn't return stale
+// results.
+//
+// Entries are charged against a MemTracker named "scan_result_cache".
+//
+// This class is thread-safe.
+class ScanResultCache {
+ public:
+  // Creates a cache holding up to 'capacity' bytes of results.
+  explicit ScanResultCache(size_t capacity);
+  ~ScanResultCache();
+
+  // Encodes into 'key' the key under which the results of 'scan_pb' are
+  // cached, when scanning a tablet whose schema is at 'schema_version'.
+  //
+  // Returns false if the results of the scan can't be cached.
+  static bool EncodeKey(const NewScanRequestPB& scan_pb,
+                        uint32_t schema_version,
+                        faststring* key);
+
+  // Caches the complete results of the scan under 'key': the row block,
+  // aggregates, last primary key and snapshot timestamp set in 'resp', and
+  // the row data in 'rows_data' and 'indirect_data'.
+  void Insert(const Slice& key,
+              const ScanResponsePB& resp,
+              const Slice& rows_data,
+              const Slice& indirect_data);
+
+  // Looks up the results cached under 'key'. On a hit, merges the cached
+  // fields into 'resp', fills in 'rows_data' and 'indirect_data', and returns
+  // true.
+  bool Lookup(const Slice& key,
+              ScanResponsePB* resp,
+              faststring* rows_data,
+              faststring* indirect_data);
+
+ private:
+  const size_t capacity_;
+  std::unique_ptr<Cache> cache_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScanResultCache);
+};
+
+} // namespace tserver
+} // namespace kudu
+
+#endif // KUDU_TSERVER_SCAN_RESULT_CACHE_H
@@ -0,0 +1,139 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#include "kudu/tserver/scan_scheduler.h"
+
+#include <string>
+#include <unordered_map>
+
+#include <gflags/gflags.h>
+#include <gflags/gflags_declare.h>
+#include <gtest/gtest.h>
+
+#include "kudu/util/monotime.h"
+#include "kudu/util/status.h"
+#include "kudu/util/test_macros.h"
+#include "kudu/util/test_util.h"
+
+DECLARE_int32(scan_scheduler_min_time_slice_ms);
+DECLARE_int32(scan_scheduler_time_slice_ms);
+DECLARE_string(scan_scheduler_shares);
+
+using std::string;
+using std::unordered_map;
+
+namespace kudu {
+namespace tserver {
+
+class ScanSchedulerTest : public KuduTest {
+ public:
+  ScanSchedulerTest()
+      : now_(MonoTime::Now()),
+        full_slice_(MonoDelta::FromMilliseconds(FLAGS_scan_scheduler_time_slice_ms)),
+        min_slice_(MonoDelta::FromMilliseconds(FLAGS_scan_scheduler_min_time_slice_ms)) {
+  }
+
+ protected:
+  // Runs a batch of 'key' taking 'elapsed', returning the time slice it was
+  // given.
+  MonoDelta RunBatch(ScanScheduler* scheduler, const string& key, MonoDelta elapsed) {
+    MonoDelta slice = scheduler->BeginBatch(key, now_);
+    now_ += elapsed;
+    scheduler->EndBatch(key, elapsed, now_);
+    return slice;
+  }
+
+  MonoTime now_;
+  const MonoDelta full_slice_;
+  const MonoDelta min_slice_;
+};
+
+// A scan alone always gets full time slices, however long it runs.
+TEST_F(ScanSchedulerTest, TestSingleScan) {
+  ScanScheduler scheduler;
+  for (int i = 0; i < 10; i++) {
+    ASSERT_EQ(full_slice_, RunBatch(&scheduler, "big", full_slice_));
+  }
+}
+
+// A long scan is preempted by a short one which starts while it runs, and gets
+// full time slices again once the short one is done.
+TEST_F(ScanSchedulerTest, TestShortScanPreemptsLongScan) {
+  ScanScheduler scheduler;
+  for (int i = 0; i < 10; i++) {
+    ASSERT_EQ(full_slice_, RunBatch(&scheduler, "big", full_slice_));
+  }
+
+  // The short scan doesn't start from zero, so it isn't ahead of the long
+  // scan, but it isn't behind by ten time slices either.
+  ASSERT_EQ(full_slice_, scheduler.BeginBatch("small", now_));
+  ASSERT_EQ(full_slice_, RunBatch(&scheduler, "big", full_slice_));
+  ASSERT_EQ(full_slice_, RunBatch(&scheduler, "big", full_slice_));
+
+  // The long scan is now more than a time slice ahead, so it gets short time
+  // slices while the short scan is active.
+  ASSERT_EQ(min_slice_, RunBatch(&scheduler, "big", min_slice_));
+  scheduler.EndBatch("small", MonoDelta::FromMilliseconds(1), now_);
+  ASSERT_EQ(full_slice_, RunBatch(&scheduler, "small", MonoDelta::FromMilliseconds(1)));
+  ASSERT_EQ(min_slice_, RunBatch(&scheduler, "big", min_slice_));
+
+  // Once the short scan has been done for a while, the long scan is alone again.
+  now_ += MonoDelta::FromSeconds(2);
+  ASSERT_EQ(full_slice_, RunBatch(&scheduler, "big", full_slice_));
+}
+
+// Scans of keys with a bigger share can run further ahead before they're
+// preempted.
+TEST_F(ScanSchedulerTest, TestShares) {
+  FLAGS_scan_scheduler_shares = "big:4";
+  ScanScheduler scheduler;
+  ASSERT_EQ(full_slice_, scheduler.BeginBatch("small", now_));
+  for (int i = 0; i < 4; i++) {
+    ASSERT_EQ(full_slice_, RunBatch(&scheduler, "big", full_slice_));
+  }
+  // With a weight of 4, the big key has only used a time slice of virtual time.
+  ASSERT_EQ(full_slice_, RunBatch(&scheduler, "big", full_slice_));
+  ASSERT_EQ(min_slice_, RunBatch(&scheduler, "big", min_slice_));
+  scheduler.EndBatch("small", MonoDelta::FromMilliseconds(1), now_);
+}
+
+TEST_F(ScanSchedulerTest, TestIdleKeysExpire) {
+  ScanScheduler scheduler;
+  RunBatch(&scheduler, "a", full_slice_);
+  RunBatch(&scheduler, "b", full_slice_);
+  ASSERT_EQ(2, scheduler.keys_.size());
+  now_ += MonoDelta::FromSeconds(120);
+  RunBatch(&scheduler, "c", full_slice_);
+  ASSERT_EQ(1, scheduler.keys_.size());
+}
+
+TEST_F(ScanSchedulerTest, TestParseShares) {
+  unordered_map<string, double> weights;
+  ASSERT_OK(ScanScheduler::ParseShares("", &weights));
+  ASSERT_TRUE(weights.empty());
+  ASSERT_OK(ScanScheduler::ParseShares("etl:0.5, dashboards:4", &weights));
+  ASSERT_EQ(2, weights.size());
+  ASSERT_EQ(0.5, weights["etl"]);
+  ASSERT_EQ(4, weights["dashboards"]);
+
+  for (const string& shares : { "etl", "etl:", ":1", "etl:0", "etl:-1", "etl:x", "etl:1:2" }) {
+    SCOPED_TRACE(shares);
+    ASSERT_TRUE(ScanScheduler::ParseShares(shares, &weights).IsInvalidArgument());
+  }
+}
+
+} // namespace tserver
+} // namespace kudu
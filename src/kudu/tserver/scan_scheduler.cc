@@ -0,0 +1,199 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#include "kudu/tserver/scan_scheduler.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "kudu/gutil/strings/split.h"
+#include "kudu/gutil/strings/strip.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/flag_tags.h"
+
+DEFINE_bool(scan_scheduler_enabled, false,
+            "Whether to share the time tablet server threads spend on scan batches "
+            "between the tables or users scanning concurrently, as per "
+            "--scan_scheduler_share_key, instead of running every batch for up to "
+            "--scan_scheduler_time_slice_ms in the order the requests arrive.");
+TAG_FLAG(scan_scheduler_enabled, experimental);
+TAG_FLAG(scan_scheduler_enabled, runtime);
+
+DEFINE_string(scan_scheduler_share_key, "table",
+              "What the scan scheduler shares the time spent on scan batches "
+              "between: 'table' for the scanned tables, or 'user' for the users "
+              "scanning them.");
+TAG_FLAG(scan_scheduler_share_key, experimental);
+
+DEFINE_string(scan_scheduler_shares, "",
+              "Comma-separated list of <key>:<weight> pairs setting the share of "
+              "scan time of the given tables or users, as per "
+              "--scan_scheduler_share_key. Those not listed have a weight of 1.");
+TAG_FLAG(scan_scheduler_shares, experimental);
+
+DEFINE_int32(scan_scheduler_time_slice_ms, 500,
+             "The longest a single scan batch runs for before responding to the "
+             "client, whether or not the scan scheduler is enabled.");
+TAG_FLAG(scan_scheduler_time_slice_ms, advanced);
+TAG_FLAG(scan_scheduler_time_slice_ms, runtime);
+
+DEFINE_int32(scan_scheduler_min_time_slice_ms, 20,
+             "The time a scan batch runs for when the scan scheduler finds that "
+             "its table or user is more than a time slice ahead of its share.");
+TAG_FLAG(scan_scheduler_min_time_slice_ms, experimental);
+TAG_FLAG(scan_scheduler_min_time_slice_ms, runtime);
+
+namespace {
+
+bool ValidateShareKey(const char* flagname, const std::string& value) {
+  if (value == "table" || value == "user") {
+    return true;
+  }
+  LOG(ERROR) << strings::Substitute("Invalid value for --$0: '$1' (must be 'table' or 'user')",
+                                    flagname, value);
+  return false;
+}
+DEFINE_validator(scan_scheduler_share_key, &ValidateShareKey);
+
+bool ValidateShares(const char* flagname, const std::string& value) {
+  std::unordered_map<std::string, double> weights;
+  kudu::Status s = kudu::tserver::ScanScheduler::ParseShares(value, &weights);
+  if (!s.ok()) {
+    LOG(ERROR) << strings::Substitute("Invalid value for --$0: $1", flagname, s.ToString());
+    return false;
+  }
+  return true;
+}
+DEFINE_validator(scan_scheduler_shares, &ValidateShares);
+
+} // anonymous namespace
+
+using std::string;
+using std::unordered_map;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+namespace tserver {
+
+namespace {
+
+// A key whose last batch ended within this long is still considered active:
+// its scan is likely between two batches.
+const MonoDelta kActiveWindow = MonoDelta::FromSeconds(1);
+
+// Keys inactive for this long are forgotten.
+const MonoDelta kIdleExpiry = MonoDelta::FromSeconds(60);
+
+} // anonymous namespace
+
+ScanScheduler::ScanScheduler() {
+  CHECK_OK(ParseShares(FLAGS_scan_scheduler_shares, &weights_));
+}
+
+Status ScanScheduler::ParseShares(const string& shares,
+                                  unordered_map<string, double>* weights) {
+  weights->clear();
+  vector<string> share_list = strings::Split(shares, ",", strings::SkipWhitespace());
+  for (const string& share : share_list) {
+    vector<string> key_weight = strings::Split(share, ":");
+    for (string& s : key_weight) {
+      StripWhiteSpace(&s);
+    }
+    if (key_weight.size() != 2 || key_weight[0].empty()) {
+      return Status::InvalidArgument(Substitute("invalid share '$0'", share));
+    }
+    char* end;
+    double weight = strtod(key_weight[1].c_str(), &end);
+    if (key_weight[1].empty() || *end != '\0' || !(weight > 0)) {
+      return Status::InvalidArgument(Substitute("invalid weight in share '$0'", share));
+    }
+    (*weights)[key_weight[0]] = weight;
+  }
+  return Status::OK();
+}
+
+bool ScanScheduler::IsActive(const KeyState& state, MonoTime now) {
+  return state.running > 0 ||
+      (state.last_end.Initialized() && now - state.last_end < kActiveWindow);
+}
+
+double ScanScheduler::WeightOf(const string& key) const {
+  auto it = weights_.find(key);
+  return it == weights_.end() ? 1 : it->second;
+}
+
+MonoDelta ScanScheduler::BeginBatch(const string& key, MonoTime now) {
+  const MonoDelta slice = MonoDelta::FromMilliseconds(FLAGS_scan_scheduler_time_slice_ms);
+  std::lock_guard<simple_spinlock> l(lock_);
+  KeyState& state = keys_[key];
+  const bool was_active = IsActive(state, now);
+
+  // Find the virtual time of the key furthest behind among the other active
+  // keys, forgetting about those idle for long.
+  double min_other_vtime_us = std::numeric_limits<double>::infinity();
+  for (auto it = keys_.begin(); it != keys_.end();) {
+    if (&it->second == &state) {
+      ++it;
+    } else if (IsActive(it->second, now)) {
+      min_other_vtime_us = std::min(min_other_vtime_us, it->second.vtime_us);
+      ++it;
+    } else if (!it->second.last_end.Initialized() || now - it->second.last_end > kIdleExpiry) {
+      it = keys_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  state.running++;
+  if (min_other_vtime_us == std::numeric_limits<double>::infinity()) {
+    return slice;
+  }
+
+  if (!was_active) {
+    state.vtime_us = std::max(state.vtime_us, min_other_vtime_us);
+  }
+  if (state.vtime_us - min_other_vtime_us > slice.ToMicroseconds()) {
+    return MonoDelta::FromMilliseconds(
+        std::min(FLAGS_scan_scheduler_min_time_slice_ms, FLAGS_scan_scheduler_time_slice_ms));
+  }
+  return slice;
+}
+
+void ScanScheduler::EndBatch(const string& key, MonoDelta elapsed, MonoTime now) {
+  const double weight = WeightOf(key);
+  std::lock_guard<simple_spinlock> l(lock_);
+  auto it = keys_.find(key);
+  if (it == keys_.end()) {
+    // Batches which are running keep their key from expiring.
+    LOG(DFATAL) << "Scan batch ended for unknown key " << key;
+    return;
+  }
+  KeyState& state = it->second;
+  DCHECK_GT(state.running, 0);
+  state.running--;
+  state.vtime_us += elapsed.ToMicroseconds() / weight;
+  state.last_end = now;
+}
+
+} // namespace tserver
+} // namespace kudu
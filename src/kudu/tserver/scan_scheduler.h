@@ -0,0 +1,100 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_TSERVER_SCAN_SCHEDULER_H
+#define KUDU_TSERVER_SCAN_SCHEDULER_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#include <gtest/gtest_prod.h>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+namespace tserver {
+
+// Shares the time tablet server threads spend on scan batches between the
+// tables, or the users, whose scans run concurrently.
+//
+// Each scan is charged to a key (the scanned table or the user, as per
+// --scan_scheduler_share_key). The scheduler tracks, for each key, the time
+// spent on its batches divided by its weight: its "virtual time". The batch
+// of a scan whose key is more than one time slice ahead of another active key
+// is given --scan_scheduler_min_time_slice_ms instead of a full time slice, so
+// it responds early and frees its service thread for the scans behind it.
+// That way, short interactive scans aren't stuck behind the batches of a long
+// analytic scan, which still runs at full speed when it's alone.
+//
+// A key which becomes active again starts no further behind than the active
+// keys, so that it can't bank its idle time.
+//
+// This class is thread-safe.
+class ScanScheduler {
+ public:
+  ScanScheduler();
+
+  // Parses 'shares', a comma-separated list of <key>:<weight> pairs as
+  // in --scan_scheduler_shares, into 'weights'.
+  static Status ParseShares(const std::string& shares,
+                            std::unordered_map<std::string, double>* weights);
+
+  // Starts a batch of a scan charged to 'key' at 'now', returning the time
+  // the batch may run for.
+  MonoDelta BeginBatch(const std::string& key, MonoTime now);
+
+  // Ends a batch of a scan charged to 'key' started with BeginBatch(), which
+  // ran for 'elapsed', at 'now'.
+  void EndBatch(const std::string& key, MonoDelta elapsed, MonoTime now);
+
+ private:
+  FRIEND_TEST(ScanSchedulerTest, TestIdleKeysExpire);
+
+  struct KeyState {
+    // The time spent on the key's batches, in microseconds, divided by its
+    // weight.
+    double vtime_us = 0;
+    // The number of the key's batches running.
+    int running = 0;
+    // The last time a batch of the key ended.
+    MonoTime last_end;
+  };
+
+  // Whether a key is active at 'now': it has a batch running, or had one end
+  // recently enough that its scan is likely between two batches.
+  static bool IsActive(const KeyState& state, MonoTime now);
+
+  double WeightOf(const std::string& key) const;
+
+  // The weights of the keys set in --scan_scheduler_shares. Keys not listed
+  // have a weight of 1.
+  std::unordered_map<std::string, double> weights_;
+
+  // Protects 'keys_'.
+  simple_spinlock lock_;
+  std::unordered_map<std::string, KeyState> keys_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScanScheduler);
+};
+
+} // namespace tserver
+} // namespace kudu
+
+#endif // KUDU_TSERVER_SCAN_SCHEDULER_H
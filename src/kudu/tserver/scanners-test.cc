@@ -69,6 +69,25 @@ TEST(ScannersTest, TestManager) {
   ASSERT_FALSE(mgr.UnregisterScanner("xxx"));
 }
 
+TEST(ScannersTest, TestCreateThenRegister) {
+  scoped_refptr<TabletReplica> null_replica(nullptr);
+  ScannerManager mgr(nullptr);
+
+  // A created scanner has no ID and isn't registered until asked to be.
+  SharedScanner s;
+  mgr.CreateScanner(null_replica, "", RowFormatFlags::NO_FLAGS, &s);
+  ASSERT_TRUE(s->id().empty());
+  ASSERT_EQ(0, mgr.CountActiveScanners());
+
+  mgr.RegisterScanner(s);
+  ASSERT_FALSE(s->id().empty());
+  ASSERT_EQ(1, mgr.CountActiveScanners());
+  SharedScanner result;
+  ASSERT_TRUE(mgr.LookupScanner(s->id(), &result));
+  ASSERT_EQ(result.get(), s.get());
+  ASSERT_TRUE(mgr.UnregisterScanner(s->id()));
+}
+
 TEST(ScannerTest, TestExpire) {
   scoped_refptr<TabletReplica> null_replica(nullptr);
   FLAGS_scanner_ttl_ms = 100;
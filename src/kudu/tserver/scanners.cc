@@ -22,6 +22,7 @@
 
 #include <gflags/gflags.h>
 
+#include "kudu/common/common.pb.h"
 #include "kudu/common/iterator.h"
 #include "kudu/common/scan_spec.h"
 #include "kudu/common/schema.h"
@@ -119,6 +120,23 @@ void ScannerManager::NewScanner(const scoped_refptr<TabletReplica>& tablet_repli
                                 const std::string& requestor_string,
                                 uint64_t row_format_flags,
                                 SharedScanner* scanner) {
+  CreateScanner(tablet_replica, requestor_string, row_format_flags, scanner);
+  RegisterScanner(*scanner);
+}
+
+void ScannerManager::CreateScanner(const scoped_refptr<TabletReplica>& tablet_replica,
+                                   const std::string& requestor_string,
+                                   uint64_t row_format_flags,
+                                   SharedScanner* scanner) {
+  scanner->reset(new Scanner("",
+                             tablet_replica,
+                             requestor_string,
+                             metrics_.get(),
+                             row_format_flags));
+}
+
+void ScannerManager::RegisterScanner(const SharedScanner& scanner) {
+  DCHECK(scanner->id_.empty());
   // Keep trying to generate a unique ID until we get one.
   bool success = false;
   while (!success) {
@@ -127,15 +145,13 @@ void ScannerManager::NewScanner(const scoped_refptr<TabletReplica>& tablet_repli
     // just retry until we avoid a collision. Alternatively we could
     // verify that the requestor userid does not change mid-scan.
     string id = oid_generator_.Next();
-    scanner->reset(new Scanner(id,
-                               tablet_replica,
-                               requestor_string,
-                               metrics_.get(),
-                               row_format_flags));
-
     ScannerMapStripe& stripe = GetStripeByScannerId(id);
     std::lock_guard<RWMutex> l(stripe.lock_);
-    success = InsertIfNotPresent(&stripe.scanners_by_id_, id, *scanner);
+    if (!ContainsKey(stripe.scanners_by_id_, id)) {
+      scanner->id_ = id;
+      InsertOrDie(&stripe.scanners_by_id_, id, scanner);
+      success = true;
+    }
   }
 }
 
@@ -173,13 +189,34 @@ void ScannerManager::RemoveExpiredScanners() {
   MonoDelta scanner_ttl = MonoDelta::FromMilliseconds(FLAGS_scanner_ttl_ms);
   const MonoTime now = MonoTime::Now();
 
+  vector<string> expired_ids;
   for (ScannerMapStripe* stripe : scanner_maps_) {
+    // Look for expired scanners holding the lock in shared mode, so as not to
+    // block the creation and lookup of scanners. Most of the time, there are
+    // none.
+    expired_ids.clear();
+    {
+      shared_lock<RWMutex> l(stripe->lock_);
+      for (const ScannerMapEntry& se : stripe->scanners_by_id_) {
+        if (se.second->TimeSinceLastAccess(now) > scanner_ttl) {
+          expired_ids.push_back(se.first);
+        }
+      }
+    }
+    if (expired_ids.empty()) {
+      continue;
+    }
+
     std::lock_guard<RWMutex> l(stripe->lock_);
-    for (auto it = stripe->scanners_by_id_.begin(); it != stripe->scanners_by_id_.end();) {
+    for (const string& id : expired_ids) {
+      auto it = stripe->scanners_by_id_.find(id);
+      if (it == stripe->scanners_by_id_.end()) {
+        continue;
+      }
+      // The scanner may have been accessed in the meantime.
       const SharedScanner& scanner = it->second;
       MonoDelta idle_time = scanner->TimeSinceLastAccess(now);
       if (idle_time <= scanner_ttl) {
-        ++it;
         continue;
       }
 
@@ -191,7 +228,7 @@ void ScannerManager::RemoveExpiredScanners() {
           scanner->tablet_id(),
           idle_time.ToMilliseconds(),
           scanner_ttl.ToMilliseconds());
-      it = stripe->scanners_by_id_.erase(it);
+      stripe->scanners_by_id_.erase(it);
       if (metrics_) {
         metrics_->scanners_expired->Increment();
       }
@@ -210,6 +247,8 @@ Scanner::Scanner(string id, const scoped_refptr<TabletReplica>& tablet_replica,
       call_seq_id_(0),
       start_time_(MonoTime::Now()),
       metrics_(metrics),
+      limit_(-1),
+      num_rows_returned_(0),
       arena_(256),
       row_format_flags_(row_format_flags) {
   if (tablet_replica_) {
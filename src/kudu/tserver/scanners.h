@@ -17,6 +17,7 @@
 #ifndef KUDU_TSERVER_SCANNERS_H
 #define KUDU_TSERVER_SCANNERS_H
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <memory>
@@ -46,6 +47,7 @@
 
 namespace kudu {
 
+class AggregationSpecPB;
 class RowwiseIterator;
 class ScanSpec;
 class Schema;
@@ -80,6 +82,18 @@ class ScannerManager {
                   uint64_t row_format_flags,
                   SharedScanner* scanner);
 
+  // Create a new scanner without an ID, which isn't in the map. A scan which
+  // completes within its first request never needs to be looked up, so
+  // registering its scanner would only add contention on the map.
+  void CreateScanner(const scoped_refptr<tablet::TabletReplica>& tablet_replica,
+                     const std::string& requestor_string,
+                     uint64_t row_format_flags,
+                     SharedScanner* scanner);
+
+  // Assign a unique ID to 'scanner', which was created by CreateScanner(), and
+  // insert it into the map.
+  void RegisterScanner(const SharedScanner& scanner);
+
   // Lookup the given scanner by its ID.
   // Returns true if the scanner is found successfully.
   bool LookupScanner(const std::string& scanner_id, SharedScanner* scanner);
@@ -250,15 +264,16 @@ class Scanner {
   // Returns the time this scan was started.
   const MonoTime& start_time() const { return start_time_; }
 
-  // Associate a projection schema with the Scanner. The scanner takes
-  // ownership of 'client_projection_schema'.
+  // Associate a projection schema with the Scanner. The schema may be shared
+  // with other scanners.
   //
   // Note: 'client_projection_schema' is set if the client's
   // projection is a subset of the iterator's schema -- the iterator's
   // schema needs to include all columns that have predicates, whereas
   // the client may not want to project all of them.
-  void set_client_projection_schema(gscoped_ptr<Schema> client_projection_schema) {
-    client_projection_schema_.swap(client_projection_schema);
+  void set_client_projection_schema(
+      std::shared_ptr<const Schema> client_projection_schema) {
+    client_projection_schema_ = std::move(client_projection_schema);
   }
 
   // Returns request's projection schema if it differs from the schema
@@ -268,6 +283,49 @@ class Scanner {
   // See the note about 'set_client_projection_schema' above.
   const Schema* client_projection_schema() const { return client_projection_schema_.get(); }
 
+  // Associate an aggregation with the Scanner, so that its responses return
+  // the partial aggregates of the scanned rows instead of the rows.
+  void set_aggregation_spec(gscoped_ptr<AggregationSpecPB> aggregation_spec) {
+    aggregation_spec_.swap(aggregation_spec);
+  }
+
+  // Returns the aggregation the scanner evaluates, or NULL if it returns rows.
+  const AggregationSpecPB* aggregation_spec() const { return aggregation_spec_.get(); }
+
+  // Sets the key under which the scan scheduler accounts for the time spent
+  // on the scan's batches, e.g. the name of the scanned table.
+  void set_scheduler_key(std::string key) {
+    scheduler_key_ = std::move(key);
+  }
+
+  // Returns the scan scheduler key of the scanner, empty if it isn't set.
+  const std::string& scheduler_key() const { return scheduler_key_; }
+
+  // Sets the name of the user who started the scan, to whose quotas the
+  // scan is charged.
+  void set_username(std::string username) {
+    username_ = std::move(username);
+  }
+
+  // Returns the name of the user who started the scan.
+  const std::string& username() const { return username_; }
+
+  // Limits the number of rows the scanner returns over all of its responses.
+  void set_limit(int64_t limit) {
+    limit_ = limit;
+  }
+
+  // Returns the number of rows the scanner may still return before reaching
+  // its limit, or -1 if it has no limit.
+  int64_t num_rows_remaining() const {
+    return limit_ < 0 ? -1 : std::max<int64_t>(0, limit_ - num_rows_returned_);
+  }
+
+  // Records that a response returned 'num_rows' rows.
+  void add_num_rows_returned(int64_t num_rows) {
+    num_rows_returned_ += num_rows;
+  }
+
   // Get per-column stats for each iterator.
   void GetIteratorStats(std::vector<IteratorStats>* stats) const;
 
@@ -287,8 +345,9 @@ class Scanner {
 
   static const std::string kNullTabletId;
 
-  // The unique ID of this scanner.
-  const std::string id_;
+  // The unique ID of this scanner. Empty until the scanner is registered with
+  // the ScannerManager, which sets it once.
+  std::string id_;
 
   // Tablet associated with the scanner.
   const scoped_refptr<tablet::TabletReplica> tablet_replica_;
@@ -322,7 +381,21 @@ class Scanner {
 
   // Stores the request's projection schema, if it differs from the
   // schema used by the iterator.
-  gscoped_ptr<Schema> client_projection_schema_;
+  std::shared_ptr<const Schema> client_projection_schema_;
+
+  // The aggregation the client requested, if any.
+  gscoped_ptr<AggregationSpecPB> aggregation_spec_;
+
+  // See set_scheduler_key().
+  std::string scheduler_key_;
+
+  // See set_username().
+  std::string username_;
+
+  // The maximum number of rows to return, or -1 for no limit, and the number
+  // of rows returned so far.
+  int64_t limit_;
+  int64_t num_rows_returned_;
 
   gscoped_ptr<RowwiseIterator> iter_;
 
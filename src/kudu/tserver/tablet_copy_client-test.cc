@@ -70,6 +70,8 @@ using std::string;
 using std::thread;
 using std::vector;
 
+DECLARE_int32(tablet_copy_fetches_in_flight_per_file);
+DECLARE_int32(tablet_copy_transfer_chunk_size_bytes);
 DECLARE_string(block_manager);
 
 METRIC_DECLARE_counter(block_manager_total_disk_sync);
@@ -217,6 +219,23 @@ TEST_F(TabletCopyClientTest, TestDownloadWalSegment) {
   ASSERT_OK(CompareFileContents(path, server_path));
 }
 
+// Ensure that a file fetched as many chunks, several of them in flight at
+// once, is written in order.
+TEST_F(TabletCopyClientTest, TestDownloadWalSegmentInSmallChunks) {
+  FLAGS_tablet_copy_transfer_chunk_size_bytes = 1000;
+  FLAGS_tablet_copy_fetches_in_flight_per_file = 4;
+  ASSERT_OK(env_util::CreateDirIfMissing(
+      env_, fs_manager_->GetTabletWalDir(GetTabletId())));
+
+  uint64_t seqno = client_->wal_seqnos_[0];
+  string path = fs_manager_->GetWalSegmentFileName(GetTabletId(), seqno);
+  ASSERT_OK(client_->DownloadWAL(seqno));
+
+  log::SegmentSequence local_segments;
+  ASSERT_OK(tablet_replica_->log()->reader()->GetSegmentsSnapshot(&local_segments));
+  ASSERT_OK(CompareFileContents(path, local_segments[0]->path()));
+}
+
 // Ensure that we detect data corruption at the per-transfer level.
 TEST_F(TabletCopyClientTest, TestVerifyData) {
   string good = "This is a known good string";
@@ -233,13 +252,13 @@ TEST_F(TabletCopyClientTest, TestVerifyData) {
   valid_chunk.set_total_data_length(kDataTotalLen);
 
   // Make sure we work on the happy case.
-  ASSERT_OK(client_->VerifyData(kGoodOffset, valid_chunk));
+  ASSERT_OK(client_->VerifyData(kGoodOffset, valid_chunk, valid_chunk.data()));
 
   // Test unexpected offset.
   DataChunkPB bad_offset = valid_chunk;
   bad_offset.set_offset(kBadOffset);
   Status s;
-  s = client_->VerifyData(kGoodOffset, bad_offset);
+  s = client_->VerifyData(kGoodOffset, bad_offset, bad_offset.data());
   ASSERT_TRUE(s.IsInvalidArgument()) << "Bad offset expected: " << s.ToString();
   ASSERT_STR_CONTAINS(s.ToString(), "Offset did not match");
   LOG(INFO) << "Expected error returned: " << s.ToString();
@@ -247,7 +266,7 @@ TEST_F(TabletCopyClientTest, TestVerifyData) {
   // Test bad checksum.
   DataChunkPB bad_checksum = valid_chunk;
   bad_checksum.set_data(bad);
-  s = client_->VerifyData(kGoodOffset, bad_checksum);
+  s = client_->VerifyData(kGoodOffset, bad_checksum, bad_checksum.data());
   ASSERT_TRUE(s.IsCorruption()) << "Invalid checksum expected: " << s.ToString();
   ASSERT_STR_CONTAINS(s.ToString(), "CRC32 does not match");
   LOG(INFO) << "Expected error returned: " << s.ToString();
@@ -17,10 +17,14 @@
 
 #include "kudu/tserver/tablet_copy_client.h"
 
+#include <algorithm>
 #include <cstdint>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <ostream>
 #include <utility>
+#include <vector>
 
 #include <boost/optional/optional.hpp>
 #include <gflags/gflags.h>
@@ -35,11 +39,14 @@
 #include "kudu/consensus/metadata.pb.h"
 #include "kudu/consensus/opid.pb.h"
 #include "kudu/consensus/opid_util.h"
+#include "kudu/consensus/quorum_util.h"
 #include "kudu/fs/block_id.h"
 #include "kudu/fs/block_manager.h"
 #include "kudu/fs/data_dirs.h"
 #include "kudu/fs/fs.pb.h"
 #include "kudu/fs/fs_manager.h"
+#include "kudu/fs/io_scheduler.h"
+#include "kudu/gutil/map-util.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/gutil/walltime.h"
@@ -51,6 +58,8 @@
 #include "kudu/tserver/tablet_copy.pb.h"
 #include "kudu/tserver/tablet_copy.proxy.h"
 #include "kudu/tserver/ts_tablet_manager.h"
+#include "kudu/util/atomic.h"
+#include "kudu/util/countdown_latch.h"
 #include "kudu/util/crc.h"
 #include "kudu/util/env.h"
 #include "kudu/util/env_util.h"
@@ -64,6 +73,9 @@
 #include "kudu/util/pb_util.h"
 #include "kudu/util/random.h"
 #include "kudu/util/random_util.h"
+#include "kudu/util/scoped_cleanup.h"
+#include "kudu/util/slice.h"
+#include "kudu/util/threadpool.h"
 
 DEFINE_int32(tablet_copy_begin_session_timeout_ms, 3000,
              "Tablet server RPC client timeout for BeginTabletCopySession calls. "
@@ -95,6 +107,17 @@ DEFINE_double(tablet_copy_fault_crash_before_write_cmeta, 0.0,
 TAG_FLAG(tablet_copy_fault_crash_before_write_cmeta, unsafe);
 TAG_FLAG(tablet_copy_fault_crash_before_write_cmeta, runtime);
 
+DEFINE_int32(tablet_copy_download_threads, 4,
+             "Number of blocks of a tablet that tablet copy downloads concurrently.");
+TAG_FLAG(tablet_copy_download_threads, advanced);
+
+DEFINE_int32(tablet_copy_fetches_in_flight_per_file, 2,
+             "Number of chunks of a file that tablet copy requests ahead of the one "
+             "being written, so that the transfer of the next chunks overlaps the "
+             "writing of the current one.");
+TAG_FLAG(tablet_copy_fetches_in_flight_per_file, advanced);
+TAG_FLAG(tablet_copy_fetches_in_flight_per_file, runtime);
+
 DECLARE_int32(tablet_copy_transfer_chunk_size_bytes);
 
 METRIC_DEFINE_counter(server, tablet_copy_bytes_fetched,
@@ -116,6 +139,7 @@ namespace tserver {
 
 using consensus::ConsensusMetadata;
 using consensus::ConsensusMetadataManager;
+using consensus::IsRaftConfigWitness;
 using consensus::MakeOpId;
 using consensus::OpId;
 using env_util::CopyFile;
@@ -129,6 +153,7 @@ using std::unique_ptr;
 using std::vector;
 using strings::Substitute;
 using tablet::ColumnDataPB;
+using tablet::CopiedBlockPB;
 using tablet::DeltaDataPB;
 using tablet::RowSetDataPB;
 using tablet::TabletDataState;
@@ -277,6 +302,8 @@ Status TabletCopyClient::Start(const HostPort& copy_source_addr,
   // deleted locally. We must clear them all.
   superblock_->clear_rowsets();
   superblock_->clear_orphaned_blocks();
+  superblock_->clear_copy_source_uuid();
+  superblock_->clear_copied_blocks();
 
   // The UUIDs within the DataDirGroupPB on the remote are also unique to the
   // remote and have no meaning to us.
@@ -285,6 +312,9 @@ Status TabletCopyClient::Start(const HostPort& copy_source_addr,
   // Set the data state to COPYING to indicate that, on crash, this replica
   // should be discarded.
   superblock_->set_tablet_data_state(tablet::TABLET_DATA_COPYING);
+  if (resp.has_responder_uuid()) {
+    superblock_->set_copy_source_uuid(resp.responder_uuid());
+  }
 
   wal_seqnos_.assign(resp.wal_segment_seqnos().begin(), resp.wal_segment_seqnos().end());
   remote_cstate_.reset(resp.release_initial_cstate());
@@ -319,12 +349,21 @@ Status TabletCopyClient::Start(const HostPort& copy_source_addr,
     }
 
     // Remove any existing orphaned blocks and WALs from the tablet, and
-    // set the data state to 'COPYING'.
+    // set the data state to 'COPYING'. The blocks kept from a previous copy
+    // from the same source are reused by DownloadBlocks(), and listed in the
+    // new superblock meanwhile so that Abort() deletes them.
     RETURN_NOT_OK_PREPEND(
         TSTabletManager::DeleteTabletData(meta_, cmeta_manager_,
                                           tablet::TABLET_DATA_COPYING,
-                                          /*last_logged_opid=*/ boost::none),
+                                          /*last_logged_opid=*/ boost::none,
+                                          resp.responder_uuid()),
         "Could not replace superblock with COPYING data state");
+    for (const auto& e : meta_->copied_blocks()) {
+      reusable_blocks_.emplace(e.second, e.first);
+      CopiedBlockPB* copied_pb = superblock_->add_copied_blocks();
+      e.first.CopyToPB(copied_pb->mutable_local_block_id());
+      e.second.CopyToPB(copied_pb->mutable_source_block_id());
+    }
     RETURN_NOT_OK_PREPEND(fs_manager_->dd_manager()->CreateDataDirGroup(tablet_id_),
         "Could not create a new directory group for tablet copy");
   } else {
@@ -513,6 +552,8 @@ int TabletCopyClient::CountRemoteBlocks() const {
     if (rowset.has_adhoc_index_block()) {
       num_blocks++;
     }
+    num_blocks += rowset.secondary_indexes_size();
+    num_blocks += rowset.column_bloom_filters_size();
   }
   return num_blocks;
 }
@@ -520,13 +561,121 @@ int TabletCopyClient::CountRemoteBlocks() const {
 Status TabletCopyClient::DownloadBlocks() {
   CHECK_EQ(kStarted, state_);
 
-  // Count up the total number of blocks to download.
-  int num_remote_blocks = CountRemoteBlocks();
+  // A witness stores no data: it only needs the WAL.
+  if (IsRaftConfigWitness(fs_manager_->uuid(), remote_cstate_->committed_config())) {
+    LOG_WITH_PREFIX(INFO) << "Not downloading any blocks: the replica is a witness";
+    RecordCopiedBlocks({}, {});
+    return Status::OK();
+  }
 
-  // Download each block, writing the new block IDs into the new superblock
-  // as each block downloads.
-  int block_count = 0;
-  LOG_WITH_PREFIX(INFO) << "Starting download of " << num_remote_blocks << " data blocks...";
+  // Collect the blocks to download, in the order they're referenced by the
+  // superblock.
+  vector<BlockId> src_block_ids;
+  for (const RowSetDataPB& src_rowset : remote_superblock_->rowsets()) {
+    for (const ColumnDataPB& src_col : src_rowset.columns()) {
+      src_block_ids.emplace_back(BlockId::FromPB(src_col.block()));
+    }
+    for (const DeltaDataPB& src_redo : src_rowset.redo_deltas()) {
+      src_block_ids.emplace_back(BlockId::FromPB(src_redo.block()));
+    }
+    for (const DeltaDataPB& src_undo : src_rowset.undo_deltas()) {
+      src_block_ids.emplace_back(BlockId::FromPB(src_undo.block()));
+    }
+    if (src_rowset.has_bloom_block()) {
+      src_block_ids.emplace_back(BlockId::FromPB(src_rowset.bloom_block()));
+    }
+    if (src_rowset.has_adhoc_index_block()) {
+      src_block_ids.emplace_back(BlockId::FromPB(src_rowset.adhoc_index_block()));
+    }
+    for (const ColumnDataPB& src_index : src_rowset.secondary_indexes()) {
+      src_block_ids.emplace_back(BlockId::FromPB(src_index.block()));
+    }
+    for (const ColumnDataPB& src_bloom : src_rowset.column_bloom_filters()) {
+      src_block_ids.emplace_back(BlockId::FromPB(src_bloom.block()));
+    }
+  }
+  const int num_remote_blocks = src_block_ids.size();
+  DCHECK_EQ(CountRemoteBlocks(), num_remote_blocks);
+
+  // Reuse the blocks kept from the previous copy from the same source.
+  vector<BlockId> dst_block_ids(num_remote_blocks);
+  vector<Status> statuses(num_remote_blocks);
+  int num_reused_blocks = 0;
+  for (int i = 0; i < num_remote_blocks; i++) {
+    const BlockId* local_block_id = FindOrNull(reusable_blocks_, src_block_ids[i]);
+    if (local_block_id) {
+      dst_block_ids[i] = *local_block_id;
+      num_reused_blocks++;
+    }
+  }
+
+  // Download the other blocks concurrently. Once a download fails, the ones
+  // not yet started are skipped.
+  LOG_WITH_PREFIX(INFO) << "Starting download of " << num_remote_blocks - num_reused_blocks
+                        << " data blocks, reusing " << num_reused_blocks << "...";
+  gscoped_ptr<ThreadPool> pool;
+  RETURN_NOT_OK(ThreadPoolBuilder("tablet-copy-dl")
+                .set_max_threads(std::max(1, FLAGS_tablet_copy_download_threads))
+                .Build(&pool));
+  AtomicInt<int32_t> block_count(num_reused_blocks);
+  AtomicBool failed(false);
+  for (int i = 0; i < num_remote_blocks; i++) {
+    if (!dst_block_ids[i].IsNull()) {
+      continue;
+    }
+    Status s = pool->SubmitFunc([&, i]() {
+      if (failed.Load()) {
+        statuses[i] = Status::Aborted("Tablet copy failed");
+        return;
+      }
+      // The IO priority is per-thread.
+      fs::ScopedIOPriority io_priority(fs::IOPriority::TABLET_COPY);
+      const BlockId& old_block_id = src_block_ids[i];
+      SetStatusMessage(Substitute("Downloading block $0 ($1/$2)",
+                                  old_block_id.ToString(),
+                                  block_count.Load() + 1, num_remote_blocks));
+      BlockId new_block_id;
+      statuses[i] = DownloadBlock(old_block_id, &new_block_id).CloneAndPrepend(
+          "Unable to download block with id " + old_block_id.ToString());
+      if (!statuses[i].ok()) {
+        failed.Store(true);
+        return;
+      }
+      dst_block_ids[i] = new_block_id;
+      block_count.Increment();
+    });
+    if (!s.ok()) {
+      statuses[i] = s;
+      failed.Store(true);
+      break;
+    }
+  }
+  pool->Wait();
+  pool->Shutdown();
+
+  // Write the new block IDs into the new superblock. Even if a download
+  // failed, the blocks that were downloaded are referenced so that Abort()
+  // deletes them.
+  //
+  // We can't leave superblock_ unserializable with unset required field
+  // values in child elements, so only the downloaded blocks are referenced.
+  Status first_error;
+  int idx = 0;
+  auto downloaded = [&](BlockIdPB* dest_block_id) {
+    const int i = idx++;
+    if (!statuses[i].ok()) {
+      if (first_error.ok() && !statuses[i].IsAborted()) {
+        first_error = statuses[i];
+      }
+      return false;
+    }
+    if (dst_block_ids[i].IsNull()) {
+      // Never submitted.
+      return false;
+    }
+    dst_block_ids[i].CopyToPB(dest_block_id);
+    return true;
+  };
   for (const RowSetDataPB& src_rowset : remote_superblock_->rowsets()) {
     // Create rowset.
     RowSetDataPB* dst_rowset = superblock_->add_rowsets();
@@ -540,49 +689,87 @@ Status TabletCopyClient::DownloadBlocks() {
     dst_rowset->clear_undo_deltas();
     dst_rowset->clear_bloom_block();
     dst_rowset->clear_adhoc_index_block();
+    dst_rowset->clear_secondary_indexes();
+    dst_rowset->clear_column_bloom_filters();
+    // The downloaded blocks are placed in fast data directories; the local
+    // tablet moves the rowset to slow ones once it's found to be cold.
+    dst_rowset->clear_slow_storage();
 
-    // We can't leave superblock_ unserializable with unset required field
-    // values in child elements, so we must download and rewrite each block
-    // before referencing it in the rowset.
     for (const ColumnDataPB& src_col : src_rowset.columns()) {
       BlockIdPB new_block_id;
-      RETURN_NOT_OK(DownloadAndRewriteBlock(src_col.block(), num_remote_blocks,
-                                            &block_count, &new_block_id));
-      ColumnDataPB* dst_col = dst_rowset->add_columns();
-      *dst_col = src_col;
-      *dst_col->mutable_block() = new_block_id;
+      if (downloaded(&new_block_id)) {
+        ColumnDataPB* dst_col = dst_rowset->add_columns();
+        *dst_col = src_col;
+        *dst_col->mutable_block() = new_block_id;
+      }
     }
     for (const DeltaDataPB& src_redo : src_rowset.redo_deltas()) {
       BlockIdPB new_block_id;
-      RETURN_NOT_OK(DownloadAndRewriteBlock(src_redo.block(), num_remote_blocks,
-                                            &block_count, &new_block_id));
-      DeltaDataPB* dst_redo = dst_rowset->add_redo_deltas();
-      *dst_redo = src_redo;
-      *dst_redo->mutable_block() = new_block_id;
+      if (downloaded(&new_block_id)) {
+        DeltaDataPB* dst_redo = dst_rowset->add_redo_deltas();
+        *dst_redo = src_redo;
+        *dst_redo->mutable_block() = new_block_id;
+      }
     }
     for (const DeltaDataPB& src_undo : src_rowset.undo_deltas()) {
       BlockIdPB new_block_id;
-      RETURN_NOT_OK(DownloadAndRewriteBlock(src_undo.block(), num_remote_blocks,
-                                            &block_count, &new_block_id));
-      DeltaDataPB* dst_undo = dst_rowset->add_undo_deltas();
-      *dst_undo = src_undo;
-      *dst_undo->mutable_block() = new_block_id;
+      if (downloaded(&new_block_id)) {
+        DeltaDataPB* dst_undo = dst_rowset->add_undo_deltas();
+        *dst_undo = src_undo;
+        *dst_undo->mutable_block() = new_block_id;
+      }
     }
     if (src_rowset.has_bloom_block()) {
       BlockIdPB new_block_id;
-      RETURN_NOT_OK(DownloadAndRewriteBlock(src_rowset.bloom_block(), num_remote_blocks,
-                                            &block_count, &new_block_id));
-      *dst_rowset->mutable_bloom_block() = new_block_id;
+      if (downloaded(&new_block_id)) {
+        *dst_rowset->mutable_bloom_block() = new_block_id;
+      }
     }
     if (src_rowset.has_adhoc_index_block()) {
       BlockIdPB new_block_id;
-      RETURN_NOT_OK(DownloadAndRewriteBlock(src_rowset.adhoc_index_block(), num_remote_blocks,
-                                            &block_count, &new_block_id));
-      *dst_rowset->mutable_adhoc_index_block() = new_block_id;
+      if (downloaded(&new_block_id)) {
+        *dst_rowset->mutable_adhoc_index_block() = new_block_id;
+      }
+    }
+    for (const ColumnDataPB& src_index : src_rowset.secondary_indexes()) {
+      BlockIdPB new_block_id;
+      if (downloaded(&new_block_id)) {
+        ColumnDataPB* dst_index = dst_rowset->add_secondary_indexes();
+        *dst_index = src_index;
+        *dst_index->mutable_block() = new_block_id;
+      }
+    }
+    for (const ColumnDataPB& src_bloom : src_rowset.column_bloom_filters()) {
+      BlockIdPB new_block_id;
+      if (downloaded(&new_block_id)) {
+        ColumnDataPB* dst_bloom = dst_rowset->add_column_bloom_filters();
+        *dst_bloom = src_bloom;
+        *dst_bloom->mutable_block() = new_block_id;
+      }
     }
   }
+  DCHECK_EQ(num_remote_blocks, idx);
+  RecordCopiedBlocks(src_block_ids, dst_block_ids);
+  return first_error;
+}
 
-  return Status::OK();
+void TabletCopyClient::RecordCopiedBlocks(const vector<BlockId>& src_block_ids,
+                                          const vector<BlockId>& dst_block_ids) {
+  DCHECK_EQ(src_block_ids.size(), dst_block_ids.size());
+  superblock_->clear_copied_blocks();
+  for (int i = 0; i < dst_block_ids.size(); i++) {
+    if (dst_block_ids[i].IsNull()) {
+      continue;
+    }
+    CopiedBlockPB* copied_pb = superblock_->add_copied_blocks();
+    dst_block_ids[i].CopyToPB(copied_pb->mutable_local_block_id());
+    src_block_ids[i].CopyToPB(copied_pb->mutable_source_block_id());
+    reusable_blocks_.erase(src_block_ids[i]);
+  }
+  for (const auto& e : reusable_blocks_) {
+    e.second.CopyToPB(superblock_->add_orphaned_blocks());
+  }
+  reusable_blocks_.clear();
 }
 
 Status TabletCopyClient::DownloadWAL(uint64_t wal_segment_seqno) {
@@ -631,23 +818,6 @@ Status TabletCopyClient::WriteConsensusMetadata() {
   return Status::OK();
 }
 
-Status TabletCopyClient::DownloadAndRewriteBlock(const BlockIdPB& src_block_id,
-                                                 int num_blocks,
-                                                 int* block_count,
-                                                 BlockIdPB* dest_block_id) {
-  BlockId old_block_id(BlockId::FromPB(src_block_id));
-  SetStatusMessage(Substitute("Downloading block $0 ($1/$2)",
-                              old_block_id.ToString(),
-                              *block_count + 1, num_blocks));
-  BlockId new_block_id;
-  RETURN_NOT_OK_PREPEND(DownloadBlock(old_block_id, &new_block_id),
-      "Unable to download block with id " + old_block_id.ToString());
-
-  new_block_id.CopyToPB(dest_block_id);
-  (*block_count)++;
-  return Status::OK();
-}
-
 Status TabletCopyClient::DownloadBlock(const BlockId& old_block_id,
                                        BlockId* new_block_id) {
   VLOG_WITH_PREFIX(1) << "Downloading block with block_id " << old_block_id.ToString();
@@ -666,57 +836,138 @@ Status TabletCopyClient::DownloadBlock(const BlockId& old_block_id,
 
   *new_block_id = block->id();
   RETURN_NOT_OK_PREPEND(block->Finalize(), "Unable to finalize block");
+  std::lock_guard<simple_spinlock> l(lock_);
   transaction_->AddCreatedBlock(std::move(block));
   return Status::OK();
 }
 
+namespace {
+
+// A FetchData call for a chunk of a file, possibly in flight.
+struct ChunkFetch {
+  ChunkFetch() : latch(1) {}
+
+  FetchDataRequestPB req;
+  FetchDataResponsePB resp;
+  rpc::RpcController controller;
+  CountDownLatch latch;
+};
+
+} // anonymous namespace
+
 template<class Appendable>
 Status TabletCopyClient::DownloadFile(const DataIdPB& data_id,
                                       Appendable* appendable) {
-  uint64_t offset = 0;
-  rpc::RpcController controller;
-  controller.set_timeout(MonoDelta::FromMilliseconds(session_idle_timeout_millis_));
   FetchDataRequestPB req;
   req.set_session_id(session_id_);
   req.mutable_data_id()->CopyFrom(data_id);
   req.set_max_length(FLAGS_tablet_copy_transfer_chunk_size_bytes);
-
-  bool done = false;
-  while (!done) {
-    req.set_offset(offset);
-
-    // Request the next data chunk.
-    FetchDataResponsePB resp;
-    RETURN_NOT_OK_PREPEND(SendRpcWithRetry(&controller, [&] {
-          return proxy_->FetchData(req, &resp, &controller);
-    }), "unable to fetch data from remote");
+  req.set_data_in_sidecar(true);
+
+  // Verifies and writes the chunk at 'offset', received in the response of
+  // 'controller'. Sets 'size' to the size of its data.
+  auto append_chunk = [&](uint64_t offset, const DataChunkPB& chunk,
+                          const rpc::RpcController& controller, uint64_t* size) {
+    Slice data;
+    if (chunk.has_data_sidecar()) {
+      RETURN_NOT_OK_PREPEND(controller.GetInboundSidecar(chunk.data_sidecar(), &data),
+                            "Unable to get chunk data");
+    } else {
+      data = chunk.data();
+    }
 
     // Sanity-check for corruption.
-    RETURN_NOT_OK_PREPEND(VerifyData(offset, resp.chunk()),
+    RETURN_NOT_OK_PREPEND(VerifyData(offset, chunk, data),
                           Substitute("Error validating data item $0",
                                      pb_util::SecureShortDebugString(data_id)));
 
     // Write the data.
-    RETURN_NOT_OK(appendable->Append(resp.chunk().data()));
+    RETURN_NOT_OK(appendable->Append(data));
 
     if (PREDICT_FALSE(FLAGS_tablet_copy_download_file_inject_latency_ms > 0)) {
       LOG_WITH_PREFIX(INFO) << "Injecting latency into file download: " <<
           FLAGS_tablet_copy_download_file_inject_latency_ms;
       SleepFor(MonoDelta::FromMilliseconds(FLAGS_tablet_copy_download_file_inject_latency_ms));
     }
-
-    auto chunk_size = resp.chunk().data().size();
-    done = offset + chunk_size == resp.chunk().total_data_length();
-    offset += chunk_size;
     if (tablet_copy_metrics_) {
-      tablet_copy_metrics_->bytes_fetched->IncrementBy(chunk_size);
+      tablet_copy_metrics_->bytes_fetched->IncrementBy(data.size());
+    }
+    *size = data.size();
+    return Status::OK();
+  };
+
+  // Request the first chunk alone: it tells the length of the file and the
+  // size of the chunks the source sends.
+  uint64_t total_data_length;
+  {
+    rpc::RpcController controller;
+    FetchDataResponsePB resp;
+    req.set_offset(0);
+    RETURN_NOT_OK_PREPEND(SendRpcWithRetry(&controller, [&] {
+          return proxy_->FetchData(req, &resp, &controller);
+    }), "unable to fetch data from remote");
+    uint64_t size;
+    RETURN_NOT_OK(append_chunk(0, resp.chunk(), controller, &size));
+    total_data_length = resp.chunk().total_data_length();
+    req.set_offset(size);
+    req.set_max_length(std::max<uint64_t>(size, 1));
+    if (req.offset() == total_data_length) {
+      return Status::OK();
+    }
+  }
+
+  // Keep up to --tablet_copy_fetches_in_flight_per_file chunks requested
+  // ahead of the one being written. The chunks are written in order.
+  uint64_t offset = req.offset();
+  uint64_t next_fetch_offset = offset;
+  std::deque<unique_ptr<ChunkFetch>> in_flight;
+  auto wait_in_flight = [&]() {
+    for (const auto& fetch : in_flight) {
+      fetch->latch.Wait();
+    }
+    in_flight.clear();
+  };
+  auto cleanup = MakeScopedCleanup(wait_in_flight);
+  while (offset < total_data_length) {
+    const size_t max_in_flight = std::max(1, FLAGS_tablet_copy_fetches_in_flight_per_file);
+    while (in_flight.size() < max_in_flight && next_fetch_offset < total_data_length) {
+      unique_ptr<ChunkFetch> fetch(new ChunkFetch);
+      fetch->req = req;
+      fetch->req.set_offset(next_fetch_offset);
+      fetch->controller.set_timeout(MonoDelta::FromMilliseconds(session_idle_timeout_millis_));
+      CountDownLatch* latch = &fetch->latch;
+      proxy_->FetchDataAsync(fetch->req, &fetch->resp, &fetch->controller,
+                             [latch]() { latch->CountDown(); });
+      next_fetch_offset += req.max_length();
+      in_flight.emplace_back(std::move(fetch));
+    }
+
+    unique_ptr<ChunkFetch> fetch = std::move(in_flight.front());
+    in_flight.pop_front();
+    fetch->latch.Wait();
+    if (!fetch->controller.status().ok()) {
+      // Retry synchronously, backing off if the source is busy.
+      RETURN_NOT_OK_PREPEND(SendRpcWithRetry(&fetch->controller, [&] {
+            return proxy_->FetchData(fetch->req, &fetch->resp, &fetch->controller);
+      }), "unable to fetch data from remote");
+    }
+    uint64_t size;
+    RETURN_NOT_OK(append_chunk(offset, fetch->resp.chunk(), fetch->controller, &size));
+    offset += size;
+
+    // The chunks requested ahead assumed this one would be full. If it isn't,
+    // request them again from where it ended.
+    if (offset < total_data_length && size < req.max_length()) {
+      wait_in_flight();
+      next_fetch_offset = offset;
     }
   }
 
   return Status::OK();
 }
 
-Status TabletCopyClient::VerifyData(uint64_t offset, const DataChunkPB& chunk) {
+Status TabletCopyClient::VerifyData(uint64_t offset, const DataChunkPB& chunk,
+                                    const Slice& data) {
   // Verify the offset is what we expected.
   if (offset != chunk.offset()) {
     return Status::InvalidArgument("Offset did not match what was asked for",
@@ -724,17 +975,17 @@ Status TabletCopyClient::VerifyData(uint64_t offset, const DataChunkPB& chunk) {
   }
 
   // Verify that the chunk does not overflow the total data length.
-  if (offset + chunk.data().length() > chunk.total_data_length()) {
+  if (offset + data.size() > chunk.total_data_length()) {
     return Status::InvalidArgument("Chunk exceeds total block data length",
-        Substitute("$0 vs $1", offset + chunk.data().length(), chunk.total_data_length()));
+        Substitute("$0 vs $1", offset + data.size(), chunk.total_data_length()));
   }
 
   // Verify the checksum.
-  uint32_t crc32 = crc::Crc32c(chunk.data().data(), chunk.data().length());
+  uint32_t crc32 = crc::Crc32c(data.data(), data.size());
   if (PREDICT_FALSE(crc32 != chunk.crc32())) {
     return Status::Corruption(
         Substitute("CRC32 does not match at offset $0 size $1: $2 vs $3",
-          offset, chunk.data().size(), crc32, chunk.crc32()));
+          offset, data.size(), crc32, chunk.crc32()));
   }
   return Status::OK();
 }
@@ -768,8 +1019,13 @@ Status TabletCopyClient::SendRpcWithRetry(rpc::RpcController* controller, F f) {
       // Polynomial backoff with 50% jitter.
       double kJitterPct = 0.5;
       int32_t kBackoffBaseMs = 10;
+      double fraction;
+      {
+        std::lock_guard<simple_spinlock> l(lock_);
+        fraction = rng_.NextDoubleFraction();
+      }
       MonoDelta backoff = MonoDelta::FromMilliseconds(
-          (1 - kJitterPct + (kJitterPct * rng_.NextDoubleFraction()))
+          (1 - kJitterPct + (kJitterPct * fraction))
           * kBackoffBaseMs * attempt * attempt);
       if (MonoTime::Now() + backoff > deadline) {
         return Status::TimedOut("unable to fetch data from remote");
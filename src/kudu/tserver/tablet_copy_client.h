@@ -20,22 +20,24 @@
 #include <cstdint>
 #include <string>
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
 #include <gtest/gtest_prod.h>
 
+#include "kudu/fs/block_id.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/ref_counted.h"
+#include "kudu/util/locks.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/random.h"
 #include "kudu/util/status.h"
 
 namespace kudu {
 
-class BlockId;
-class BlockIdPB;
 class FsManager;
 class HostPort;
+class Slice;
 
 namespace consensus {
 class ConsensusMetadata;
@@ -75,7 +77,7 @@ struct TabletCopyClientMetrics {
 // This class is not thread-safe.
 //
 // TODO:
-// * Parallelize download of blocks and WAL segments.
+// * Parallelize download of WAL segments.
 //
 class TabletCopyClient {
  public:
@@ -134,6 +136,7 @@ class TabletCopyClient {
   FRIEND_TEST(TabletCopyClientTest, TestDownloadBlock);
   FRIEND_TEST(TabletCopyClientTest, TestVerifyData);
   FRIEND_TEST(TabletCopyClientTest, TestDownloadWalSegment);
+  FRIEND_TEST(TabletCopyClientTest, TestDownloadWalSegmentInSmallChunks);
   FRIEND_TEST(TabletCopyClientTest, TestDownloadAllBlocks);
   FRIEND_TEST(TabletCopyClientAbortTest, TestAbort);
 
@@ -171,36 +174,36 @@ class TabletCopyClient {
   // Count the number of blocks on the remote (from 'remote_superblock_').
   int CountRemoteBlocks() const;
 
-  // Download all blocks belonging to a tablet sequentially. Add all
-  // downloaded blocks to the tablet copy's transaction.
+  // Download all blocks belonging to a tablet, up to
+  // --tablet_copy_download_threads at a time. Add all downloaded blocks to
+  // the tablet copy's transaction.
   //
-  // Blocks are given new IDs upon creation. On success, 'superblock_'
-  // is populated to reflect the new block IDs.
+  // Blocks are given new IDs upon creation. 'superblock_' is populated to
+  // reflect the new block IDs of the downloaded blocks, even on failure, so
+  // that Abort() deletes them.
   Status DownloadBlocks();
 
-  // Download the remote block specified by 'src_block_id'. 'num_blocks' should
-  // be given as the total number of blocks there are to download (for logging
-  // purposes). Add the block to the tablet copy's transaction, to close blocks
-  // belonging to the transaction together when the copying is complete.
-  //
-  // On success:
-  // - 'dest_block_id' is set to the new ID of the downloaded block.
-  // - 'block_count' is incremented by 1.
-  Status DownloadAndRewriteBlock(const BlockIdPB& src_block_id,
-                                 int num_blocks,
-                                 int* block_count,
-                                 BlockIdPB* dest_block_id);
+  // Lists in 'superblock_' the downloaded or reused blocks, as
+  // 'dst_block_ids', and the blocks of the source they were copied from, as
+  // 'src_block_ids'. Null destination blocks are skipped. The reusable blocks
+  // which weren't reused are orphaned.
+  void RecordCopiedBlocks(const std::vector<BlockId>& src_block_ids,
+                          const std::vector<BlockId>& dst_block_ids);
 
   // Download a single block.
   // Data block is opened with new ID. After downloading, the block is finalized
   // and added to the tablet copy's transaction.
   //
   // On success, 'new_block_id' is set to the new ID of the downloaded block.
+  //
+  // May be called concurrently.
   Status DownloadBlock(const BlockId& old_block_id,
                        BlockId* new_block_id);
 
   // Download a single remote file. The block and WAL implementations delegate
-  // to this method when downloading files.
+  // to this method when downloading files. Up to
+  // --tablet_copy_fetches_in_flight_per_file chunks of the file are fetched
+  // at a time, and appended in order.
   //
   // An Appendable is typically a WritableBlock (block) or WritableFile (WAL).
   //
@@ -209,7 +212,8 @@ class TabletCopyClient {
   template<class Appendable>
   Status DownloadFile(const DataIdPB& data_id, Appendable* appendable);
 
-  Status VerifyData(uint64_t offset, const DataChunkPB& resp);
+  // Verifies 'data', the data of 'chunk', which was requested at 'offset'.
+  Status VerifyData(uint64_t offset, const DataChunkPB& chunk, const Slice& data);
 
   // Runs the provided functor, which must send an RPC and return the result
   // status, until it succeeds, times out, or fails with a non-retriable error.
@@ -249,6 +253,14 @@ class TabletCopyClient {
   std::vector<uint64_t> wal_seqnos_;
   int64_t start_time_micros_;
 
+  // The blocks kept by the replaced tablet from its previous copy from the
+  // same source, keyed by the ids of the blocks of the source. Instead of
+  // being downloaded again, the blocks of the source found here are reused.
+  std::unordered_map<BlockId, BlockId, BlockIdHash, BlockIdEqual> reusable_blocks_;
+
+  // Protects 'rng_' and 'transaction_', which concurrent downloads share.
+  simple_spinlock lock_;
+
   Random rng_;
 
   TabletCopyClientMetrics* tablet_copy_metrics_;
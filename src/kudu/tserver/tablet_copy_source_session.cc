@@ -37,6 +37,7 @@
 #include "kudu/fs/data_dirs.h"
 #include "kudu/fs/fs.pb.h"
 #include "kudu/fs/fs_manager.h"
+#include "kudu/fs/io_scheduler.h"
 #include "kudu/gutil/basictypes.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/port.h"
@@ -45,6 +46,7 @@
 #include "kudu/rpc/transfer.h"
 #include "kudu/tablet/tablet_metadata.h"
 #include "kudu/tablet/tablet_replica.h"
+#include "kudu/util/faststring.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/pb_util.h"
@@ -131,6 +133,11 @@ Status TabletCopySourceSession::InitOnce() {
 
   RETURN_NOT_OK(tablet_replica_->CheckRunning());
   RETURN_NOT_OK(CheckHealthyDirGroup());
+  // A witness, which may be the leader for a while to catch up the data
+  // replicas, has no data to copy.
+  if (PREDICT_FALSE(tablet_replica_->consensus()->IsWitness())) {
+    return Status::IllegalState("Tablet replica is a witness, which stores no data");
+  }
 
   const string& tablet_id = tablet_replica_->tablet_id();
 
@@ -260,7 +267,7 @@ template <class Info>
 static Status ReadFileChunkToBuf(const Info* info,
                                  uint64_t offset, int64_t client_maxlen,
                                  const string& data_name,
-                                 string* data, int64_t* file_size,
+                                 faststring* data, int64_t* file_size,
                                  TabletCopyErrorPB::Code* error_code) {
   int64_t response_data_size = 0;
   RETURN_NOT_OK_PREPEND(GetResponseDataSize(info->size, offset, client_maxlen, error_code,
@@ -270,11 +277,8 @@ static Status ReadFileChunkToBuf(const Info* info,
   Stopwatch chunk_timer(Stopwatch::THIS_THREAD);
   chunk_timer.start();
 
-  // Writing into a std::string buffer is basically guaranteed to work on C++11,
-  // however any modern compiler should be compatible with it.
-  // Violates the API contract, but avoids excessive copies.
   data->resize(response_data_size);
-  uint8_t* buf = reinterpret_cast<uint8_t*>(const_cast<char*>(data->data()));
+  uint8_t* buf = data->data();
   Slice slice(buf, response_data_size);
   Status s = info->Read(offset, slice);
   if (PREDICT_FALSE(!s.ok())) {
@@ -299,7 +303,7 @@ static Status ReadFileChunkToBuf(const Info* info,
 
 Status TabletCopySourceSession::GetBlockPiece(const BlockId& block_id,
                                              uint64_t offset, int64_t client_maxlen,
-                                             string* data, int64_t* block_file_size,
+                                             faststring* data, int64_t* block_file_size,
                                              TabletCopyErrorPB::Code* error_code) {
   DCHECK(init_once_.init_succeeded());
   RETURN_NOT_OK_PREPEND(CheckHealthyDirGroup(error_code),
@@ -307,6 +311,7 @@ Status TabletCopySourceSession::GetBlockPiece(const BlockId& block_id,
   ImmutableReadableBlockInfo* block_info;
   RETURN_NOT_OK(FindBlock(block_id, &block_info, error_code));
 
+  fs::ScopedIOPriority io_priority(fs::IOPriority::TABLET_COPY);
   RETURN_NOT_OK(ReadFileChunkToBuf(block_info, offset, client_maxlen,
                                    Substitute("block $0", block_id.ToString()),
                                    data, block_file_size, error_code));
@@ -321,7 +326,7 @@ Status TabletCopySourceSession::GetBlockPiece(const BlockId& block_id,
 
 Status TabletCopySourceSession::GetLogSegmentPiece(uint64_t segment_seqno,
                                                    uint64_t offset, int64_t client_maxlen,
-                                                   std::string* data, int64_t* log_file_size,
+                                                   faststring* data, int64_t* log_file_size,
                                                    TabletCopyErrorPB::Code* error_code) {
   DCHECK(init_once_.init_succeeded());
   RETURN_NOT_OK_PREPEND(CheckHealthyDirGroup(error_code),
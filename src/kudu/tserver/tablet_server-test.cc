@@ -15,6 +15,7 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include "kudu/tserver/request_capture.h"
 #include "kudu/tserver/tablet_server-test-base.h"
 
 #include <unistd.h>
@@ -36,6 +37,7 @@
 
 #include "kudu/clock/clock.h"
 #include "kudu/clock/hybrid_clock.h"
+#include "kudu/common/aggregation.h"
 #include "kudu/common/common.pb.h"
 #include "kudu/common/encoded_key.h"
 #include "kudu/common/partial_row.h"
@@ -58,6 +60,7 @@
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/ref_counted.h"
+#include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/stringprintf.h"
 #include "kudu/gutil/strings/escaping.h"
 #include "kudu/gutil/strings/substitute.h"
@@ -70,6 +73,7 @@
 #include "kudu/tablet/metadata.pb.h"
 #include "kudu/tablet/tablet.h"
 #include "kudu/tablet/tablet_metadata.h"
+#include "kudu/tablet/tablet_metrics.h"
 #include "kudu/tablet/tablet_replica.h"
 #include "kudu/tserver/heartbeater.h"
 #include "kudu/tserver/mini_tablet_server.h"
@@ -88,11 +92,13 @@
 #include "kudu/util/env.h"
 #include "kudu/util/faststring.h"
 #include "kudu/util/jsonwriter.h"
+#include "kudu/util/mem_tracker.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/net/sockaddr.h"
 #include "kudu/util/path_util.h"
 #include "kudu/util/pb_util.h"
+#include "kudu/util/scoped_cleanup.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/status.h"
 #include "kudu/util/stopwatch.h"
@@ -132,11 +138,20 @@ DEFINE_int32(delete_tablet_bench_num_flushes, 200,
              "Number of disk row sets to flush in the delete tablet benchmark");
 
 DECLARE_bool(fail_dns_resolution);
+DECLARE_bool(raft_enable_leader_leases);
+DECLARE_double(request_capture_sampling_rate);
 DECLARE_int32(metrics_retirement_age_ms);
+DECLARE_int32(quota_max_scan_delay_ms);
 DECLARE_int32(scanner_batch_size_rows);
 DECLARE_int32(scanner_gc_check_interval_us);
 DECLARE_int32(scanner_ttl_ms);
+DECLARE_int32(tablet_hot_keys_sample_interval);
+DECLARE_int32(tablet_max_write_delay_ms);
+DECLARE_int64(scan_result_cache_capacity_mb);
+DECLARE_int64(tablet_soft_memory_limit_mb);
 DECLARE_string(block_manager);
+DECLARE_string(log_dir);
+DECLARE_string(table_quotas);
 
 // Declare these metrics prototypes for simpler unit testing of their behavior.
 METRIC_DECLARE_counter(rows_inserted);
@@ -390,6 +405,10 @@ TEST_F(TabletServerTest, TestInsert) {
     ASSERT_OK(proxy_->Write(req, &resp, &controller));
     SCOPED_TRACE(SecureDebugString(resp));
     ASSERT_FALSE(resp.has_error());
+    // The server reports its load, which is light.
+    ASSERT_TRUE(resp.has_load_hint());
+    ASSERT_GE(resp.load_hint().queue_time_us(), 0);
+    ASSERT_FALSE(resp.load_hint().memory_pressure());
     req.clear_row_operations();
   }
 
@@ -454,6 +473,45 @@ TEST_F(TabletServerTest, TestInsert) {
   ASSERT_GE(now_after.value(), now_before.value());
 }
 
+// Test that writes to a tablet past its soft memory limit are delayed rather
+// than rejected, and that the delay is hinted to the client.
+TEST_F(TabletServerTest, TestWriteDelayedPastTabletSoftMemoryLimit) {
+  const int kMaxDelayMs = 200;
+  FLAGS_tablet_soft_memory_limit_mb = 1;
+  FLAGS_tablet_max_write_delay_ms = kMaxDelayMs;
+
+  WriteRequestPB req;
+  req.set_tablet_id(kTabletId);
+  ASSERT_OK(SchemaToPB(schema_, req.mutable_schema()));
+  WriteResponsePB resp;
+  RpcController controller;
+
+  // While the tablet is under its limit, writes aren't delayed.
+  AddTestRowToPB(RowOperationsPB::INSERT, schema_, 1, 1, "under the limit",
+                 req.mutable_row_operations());
+  ASSERT_OK(proxy_->Write(req, &resp, &controller));
+  ASSERT_FALSE(resp.has_error()) << SecureShortDebugString(resp);
+  ASSERT_FALSE(resp.load_hint().has_write_delay_ms());
+
+  // Push the tablet way past its limit: writes are delayed by the maximum.
+  shared_ptr<MemTracker> tracker = MemTracker::CreateTracker(
+      -1, "test", tablet_replica_->tablet()->mem_tracker());
+  tracker->Consume(3 * 1024 * 1024);
+  SCOPED_CLEANUP({ tracker->Release(3 * 1024 * 1024); });
+
+  req.clear_row_operations();
+  AddTestRowToPB(RowOperationsPB::INSERT, schema_, 2, 1, "past the limit",
+                 req.mutable_row_operations());
+  controller.Reset();
+  MonoTime start = MonoTime::Now();
+  ASSERT_OK(proxy_->Write(req, &resp, &controller));
+  ASSERT_FALSE(resp.has_error()) << SecureShortDebugString(resp);
+  ASSERT_EQ(kMaxDelayMs, resp.load_hint().write_delay_ms());
+  ASSERT_GE((MonoTime::Now() - start).ToMilliseconds(), kMaxDelayMs);
+  ASSERT_EQ(1, tablet_replica_->tablet()->metrics()->leader_memory_pressure_delays->value());
+  NO_FATALS(VerifyRows(schema_, { KeyValue(1, 1), KeyValue(2, 1) }));
+}
+
 TEST_F(TabletServerTest, TestExternalConsistencyModes_ClientPropagated) {
   WriteRequestPB req;
   req.set_tablet_id(kTabletId);
@@ -1435,6 +1493,76 @@ TEST_F(TabletServerTest, TestSnapshotScan_WithoutSnapshotTimestamp) {
   ASSERT_GT(resp.propagated_timestamp(), resp.snap_timestamp());
 }
 
+// Tests that a leader holding a lease scans right after its last committed
+// operation when no snapshot timestamp is provided.
+TEST_F(TabletServerTest, TestSnapshotScan_WithLeaderLease) {
+  FLAGS_raft_enable_leader_leases = true;
+  vector<uint64_t> write_timestamps_collector;
+  InsertTestRowsRemote(0, 1, 1, nullptr, kTabletId, &write_timestamps_collector);
+  ASSERT_EQ(1, write_timestamps_collector.size());
+
+  ScanRequestPB req;
+  ScanResponsePB resp;
+  RpcController rpc;
+
+  const Schema& projection = schema_;
+  NewScanRequestPB* scan = req.mutable_new_scan_request();
+  scan->set_tablet_id(kTabletId);
+  ASSERT_OK(SchemaToColumnPBs(projection, scan->mutable_projected_columns()));
+  req.set_call_seq_id(0);
+  scan->set_read_mode(READ_AT_SNAPSHOT);
+
+  {
+    SCOPED_TRACE(SecureDebugString(req));
+    ASSERT_OK(proxy_->Scan(req, &resp, &rpc));
+    SCOPED_TRACE(SecureDebugString(resp));
+    ASSERT_FALSE(resp.has_error());
+  }
+
+  // The write is the last committed operation of the single replica, which
+  // always holds the lease.
+  ASSERT_EQ(write_timestamps_collector[0] + 1, resp.snap_timestamp());
+  vector<string> results;
+  NO_FATALS(
+    StringifyRowsFromResponse(projection, rpc, &resp, &results));
+  ASSERT_EQ(1, results.size());
+}
+
+// Tests that a scan tolerating stale data picks a snapshot timestamp that can
+// be served without waiting and includes the already committed writes.
+TEST_F(TabletServerTest, TestSnapshotScan_WithMaxStaleness) {
+  vector<uint64_t> write_timestamps_collector;
+  InsertTestRowsRemote(0, 1, 1, nullptr, kTabletId, &write_timestamps_collector);
+  ASSERT_EQ(1, write_timestamps_collector.size());
+
+  ScanRequestPB req;
+  ScanResponsePB resp;
+  RpcController rpc;
+
+  const Schema& projection = schema_;
+  NewScanRequestPB* scan = req.mutable_new_scan_request();
+  scan->set_tablet_id(kTabletId);
+  ASSERT_OK(SchemaToColumnPBs(projection, scan->mutable_projected_columns()));
+  req.set_call_seq_id(0);
+  scan->set_read_mode(READ_AT_SNAPSHOT);
+  scan->set_max_staleness_ms(60 * 1000);
+
+  const Timestamp pre_scan_ts = mini_server_->server()->clock()->Now();
+  {
+    SCOPED_TRACE(SecureDebugString(req));
+    ASSERT_OK(proxy_->Scan(req, &resp, &rpc));
+    SCOPED_TRACE(SecureDebugString(resp));
+    ASSERT_FALSE(resp.has_error());
+  }
+
+  // With no operations in flight the leader's safe time is its current time.
+  ASSERT_GE(resp.snap_timestamp(), pre_scan_ts.ToUint64());
+  vector<string> results;
+  NO_FATALS(
+    StringifyRowsFromResponse(projection, rpc, &resp, &results));
+  ASSERT_EQ(1, results.size());
+}
+
 // Tests that a snapshot in the future (beyond the current time plus maximum
 // synchronization error) fails as an invalid snapshot.
 TEST_F(TabletServerTest, TestSnapshotScan_SnapshotInTheFutureFails) {
@@ -1505,6 +1633,237 @@ TEST_F(TabletServerTest, TestSnapshotScan_OpenScanner) {
   // This tests tablet server shutdown with an active scanner.
 }
 
+// Test looking up rows by primary key, some of them flushed and some not.
+TEST_F(TabletServerTest, TestGet) {
+  InsertTestRowsRemote(0, 10);
+  ASSERT_OK(tablet_replica_->tablet()->Flush());
+  InsertTestRowsRemote(10, 10);
+
+  const Schema& projection = schema_;
+  GetRequestPB req;
+  GetResponsePB resp;
+  RpcController rpc;
+  req.set_tablet_id(kTabletId);
+  ASSERT_OK(SchemaToColumnPBs(projection, req.mutable_projected_columns()));
+  for (int32_t key : { 3, 42, 15 }) {
+    KuduPartialRow row(&schema_);
+    ASSERT_OK(row.SetInt32("key", key));
+    ASSERT_OK(row.EncodeRowKey(req.add_primary_keys()));
+  }
+  {
+    SCOPED_TRACE(SecureDebugString(req));
+    ASSERT_OK(proxy_->Get(req, &resp, &rpc));
+    SCOPED_TRACE(SecureDebugString(resp));
+    ASSERT_FALSE(resp.has_error());
+  }
+  ASSERT_EQ(3, resp.found_size());
+  ASSERT_TRUE(resp.found(0));
+  ASSERT_FALSE(resp.found(1));
+  ASSERT_TRUE(resp.found(2));
+
+  Slice direct, indirect;
+  ASSERT_OK(rpc.GetInboundSidecar(resp.data().rows_sidecar(), &direct));
+  ASSERT_OK(rpc.GetInboundSidecar(resp.data().indirect_data_sidecar(), &indirect));
+  vector<const uint8_t*> rows;
+  ASSERT_OK(ExtractRowsFromRowBlockPB(projection, resp.data(), indirect, &direct, &rows));
+  ASSERT_EQ(2, rows.size());
+  ASSERT_EQ(R"((int32 key=3, int32 int_val=3, string string_val="original3"))",
+            projection.DebugRow(ConstContiguousRow(&projection, rows[0])));
+  ASSERT_EQ(R"((int32 key=15, int32 int_val=15, string string_val="original15"))",
+            projection.DebugRow(ConstContiguousRow(&projection, rows[1])));
+
+  // Looking up rows doesn't create any scanner.
+  ASSERT_EQ(0, mini_server_->server()->scanner_manager()->CountActiveScanners());
+}
+
+// Test handling a batch of scan requests in a single RPC, one of which fails.
+TEST_F(TabletServerTest, TestMultiScan) {
+  InsertTestRowsRemote(0, 10);
+
+  const Schema& projection = schema_;
+  MultiScanRequestPB req;
+  MultiScanResponsePB resp;
+  RpcController rpc;
+  for (const string& tablet_id : vector<string>({ kTabletId, "nonexistent", kTabletId })) {
+    ScanRequestPB* scan_req = req.add_requests();
+    NewScanRequestPB* scan = scan_req->mutable_new_scan_request();
+    scan->set_tablet_id(tablet_id);
+    ASSERT_OK(SchemaToColumnPBs(projection, scan->mutable_projected_columns()));
+    scan_req->set_call_seq_id(0);
+  }
+  {
+    SCOPED_TRACE(SecureDebugString(req));
+    ASSERT_OK(proxy_->MultiScan(req, &resp, &rpc));
+    SCOPED_TRACE(SecureDebugString(resp));
+  }
+  ASSERT_EQ(3, resp.responses_size());
+
+  ASSERT_TRUE(resp.responses(1).has_error());
+  ASSERT_EQ(TabletServerErrorPB::TABLET_NOT_FOUND, resp.responses(1).error().code());
+
+  for (int i : { 0, 2 }) {
+    ScanResponsePB* scan_resp = resp.mutable_responses(i);
+    ASSERT_FALSE(scan_resp->has_error());
+    ASSERT_FALSE(scan_resp->has_more_results());
+    vector<string> results;
+    NO_FATALS(StringifyRowsFromResponse(projection, rpc, scan_resp, &results));
+    ASSERT_EQ(10, results.size());
+    ASSERT_EQ(R"((int32 key=0, int32 int_val=0, string string_val="original0"))", results[0]);
+  }
+}
+
+class ScanResultCacheTabletServerTest : public TabletServerTest {
+ public:
+  void SetUp() override {
+    FLAGS_scan_result_cache_capacity_mb = 1;
+    NO_FATALS(TabletServerTest::SetUp());
+  }
+};
+
+// Test that repeated snapshot scans at the same timestamp are answered from
+// the scan result cache, and that the cached results stay those of the
+// snapshot after further writes.
+TEST_F(ScanResultCacheTabletServerTest, TestRepeatedSnapshotScan) {
+  vector<uint64_t> write_timestamps_collector;
+  InsertTestRowsRemote(0, 10, 1, nullptr, kTabletId, &write_timestamps_collector);
+  Timestamp read_timestamp(write_timestamps_collector.back());
+  scoped_refptr<Counter> rows_scanned =
+      tablet_replica_->tablet()->metrics()->scanner_rows_scanned;
+
+  const Schema& projection = schema_;
+  auto snapshot_scan = [&](Timestamp ts, vector<string>* results) {
+    ScanRequestPB req;
+    ScanResponsePB resp;
+    RpcController rpc;
+    NewScanRequestPB* scan = req.mutable_new_scan_request();
+    scan->set_tablet_id(kTabletId);
+    ASSERT_OK(SchemaToColumnPBs(projection, scan->mutable_projected_columns()));
+    scan->set_read_mode(READ_AT_SNAPSHOT);
+    scan->set_snap_timestamp(ts.ToUint64());
+    req.set_call_seq_id(0);
+    SCOPED_TRACE(SecureDebugString(req));
+    ASSERT_OK(proxy_->Scan(req, &resp, &rpc));
+    SCOPED_TRACE(SecureDebugString(resp));
+    ASSERT_FALSE(resp.has_error());
+    ASSERT_FALSE(resp.has_more_results());
+    ASSERT_EQ(ts.ToUint64(), resp.snap_timestamp());
+    NO_FATALS(StringifyRowsFromResponse(projection, rpc, &resp, results));
+  };
+
+  vector<string> results;
+  NO_FATALS(snapshot_scan(read_timestamp, &results));
+  ASSERT_EQ(10, results.size());
+  int64_t rows_scanned_after_first_scan = rows_scanned->value();
+  ASSERT_GT(rows_scanned_after_first_scan, 0);
+
+  // The same scan is answered from the cache, without reading the tablet.
+  vector<string> cached_results;
+  NO_FATALS(snapshot_scan(read_timestamp, &cached_results));
+  ASSERT_EQ(results, cached_results);
+  ASSERT_EQ(rows_scanned_after_first_scan, rows_scanned->value());
+
+  // Writes don't change the results at the cached snapshot, but are visible
+  // to scans at later snapshots.
+  write_timestamps_collector.clear();
+  InsertTestRowsRemote(10, 5, 1, nullptr, kTabletId, &write_timestamps_collector);
+  cached_results.clear();
+  NO_FATALS(snapshot_scan(read_timestamp, &cached_results));
+  ASSERT_EQ(results, cached_results);
+  results.clear();
+  NO_FATALS(snapshot_scan(Timestamp(write_timestamps_collector.back()), &results));
+  ASSERT_EQ(15, results.size());
+  ASSERT_GT(rows_scanned->value(), rows_scanned_after_first_scan);
+}
+
+class RequestCaptureTabletServerTest : public TabletServerTest {
+ public:
+  void SetUp() override {
+    FLAGS_log_dir = GetTestPath("logs");
+    ASSERT_OK(env_->CreateDir(FLAGS_log_dir));
+    FLAGS_request_capture_sampling_rate = 1;
+    NO_FATALS(TabletServerTest::SetUp());
+  }
+};
+
+// Test that sampled writes and scans are captured with the table they were
+// sent to, and can be read back for replay.
+TEST_F(RequestCaptureTabletServerTest, TestCaptureRequests) {
+  InsertTestRowsRemote(0, 10, 2);
+  ScanResponsePB resp;
+  NO_FATALS(OpenScannerWithAllColumns(&resp));
+
+  vector<string> files;
+  ASSERT_OK(env_->Glob(JoinPathSegments(FLAGS_log_dir, "*.requests.*"), &files));
+  ASSERT_EQ(1, files.size());
+  vector<CapturedRequestPB> requests;
+  ASSERT_OK(ReadCapturedRequests(env_, files[0], &requests));
+  ASSERT_EQ(3, requests.size());
+  int64_t last_received_micros = 0;
+  for (int i = 0; i < requests.size(); i++) {
+    const auto& req = requests[i];
+    SCOPED_TRACE(SecureDebugString(req));
+    ASSERT_EQ(kTableId, req.table_name());
+    ASSERT_GE(req.received_micros(), last_received_micros);
+    last_received_micros = req.received_micros();
+    ASSERT_EQ(i < 2, req.has_write());
+    ASSERT_EQ(i == 2, req.has_scan());
+  }
+
+  // Nothing is captured once the sampling rate drops to 0.
+  FLAGS_request_capture_sampling_rate = 0;
+  InsertTestRowsRemote(10, 1);
+  requests.clear();
+  ASSERT_OK(ReadCapturedRequests(env_, files[0], &requests));
+  ASSERT_EQ(3, requests.size());
+}
+
+class QuotaTabletServerTest : public TabletServerTest {
+ public:
+  void SetUp() override {
+    FLAGS_table_quotas = Substitute("$0:scan_rows:100", kTableId);
+    NO_FATALS(TabletServerTest::SetUp());
+  }
+};
+
+// Test that the batches of a scan over its quota return no rows, and that
+// their responses are held back rather than the scan waiting on a service
+// thread.
+TEST_F(QuotaTabletServerTest, TestScanOverQuotaIsHeldBack) {
+  const int kMaxDelayMs = 200;
+  FLAGS_quota_max_scan_delay_ms = kMaxDelayMs;
+  FLAGS_scanner_batch_size_rows = 500;
+  InsertTestRowsDirect(0, 1000);
+
+  // The first batch scans 500 rows, putting the quota 4 seconds in debt.
+  ScanRequestPB req;
+  ScanResponsePB resp;
+  RpcController rpc;
+  NewScanRequestPB* scan = req.mutable_new_scan_request();
+  scan->set_tablet_id(kTabletId);
+  ASSERT_OK(SchemaToColumnPBs(schema_, scan->mutable_projected_columns()));
+  req.set_call_seq_id(0);
+  req.set_batch_size_bytes(1);
+  ASSERT_OK(proxy_->Scan(req, &resp, &rpc));
+  SCOPED_TRACE(SecureDebugString(resp));
+  ASSERT_FALSE(resp.has_error());
+  ASSERT_TRUE(resp.has_more_results());
+  ASSERT_EQ(500, resp.data().num_rows());
+
+  // The next batch is empty, and held back for the longest delay.
+  const string scanner_id = resp.scanner_id();
+  req.Clear();
+  resp.Clear();
+  rpc.Reset();
+  req.set_scanner_id(scanner_id);
+  req.set_call_seq_id(1);
+  req.set_batch_size_bytes(1);
+  MonoTime start = MonoTime::Now();
+  ASSERT_OK(proxy_->Scan(req, &resp, &rpc));
+  ASSERT_GE(MonoTime::Now() - start, MonoDelta::FromMilliseconds(kMaxDelayMs));
+  ASSERT_FALSE(resp.has_error());
+  ASSERT_TRUE(resp.has_more_results());
+  ASSERT_EQ(0, resp.data().num_rows());
+}
 
 // Test retrying a snapshot scan using last_row.
 TEST_F(TabletServerTest, TestSnapshotScan_LastRow) {
@@ -1728,6 +2087,42 @@ TEST_F(TabletServerTest, TestScanWithStringPredicates) {
   ASSERT_EQ(R"((int32 key=59, int32 int_val=118, string string_val="hello 59"))", results[9]);
 }
 
+// Test that a scan reports the resources it used in its response.
+TEST_F(TabletServerTest, TestScanResourceMetrics) {
+  InsertTestRowsDirect(0, 100);
+  ASSERT_OK(tablet_replica_->tablet()->Flush());
+  // Update a flushed row, so that the scan applies a delta to it.
+  UpdateTestRowRemote(55, 12345);
+
+  ScanRequestPB req;
+  ScanResponsePB resp;
+  RpcController rpc;
+
+  NewScanRequestPB* scan = req.mutable_new_scan_request();
+  scan->set_tablet_id(kTabletId);
+  scan->set_read_mode(READ_AT_SNAPSHOT);
+  ASSERT_OK(SchemaToColumnPBs(schema_, scan->mutable_projected_columns()));
+
+  // Set up a range predicate: "hello 50" <= string_val <= "hello 59"
+  ColumnRangePredicatePB* pred = scan->add_deprecated_range_predicates();
+  pred->mutable_column()->CopyFrom(scan->projected_columns(2));
+  pred->set_lower_bound("hello 50");
+  pred->set_inclusive_upper_bound("hello 59");
+
+  ASSERT_OK(proxy_->Scan(req, &resp, &rpc));
+  SCOPED_TRACE(SecureDebugString(resp));
+  ASSERT_FALSE(resp.has_error());
+  ASSERT_FALSE(resp.has_more_results());
+
+  const ResourceMetricsPB& metrics = resp.resource_metrics();
+  EXPECT_EQ(100, metrics.rows_scanned());
+  EXPECT_EQ(10, metrics.rows_returned());
+  EXPECT_GE(metrics.delta_mutations_applied(), 1);
+  EXPECT_GT(metrics.cfile_cache_miss_bytes() + metrics.cfile_cache_hit_bytes(), 0);
+  EXPECT_GT(metrics.cpu_user_nanos() + metrics.cpu_system_nanos(), 0);
+  EXPECT_TRUE(metrics.has_safe_time_wait_nanos());
+}
+
 TEST_F(TabletServerTest, TestScanWithPredicates) {
   // TODO: need to test adding a predicate on a column which isn't part of the
   // projection! I don't think we implemented this at the tablet layer yet,
@@ -1984,6 +2379,148 @@ TEST_F(TabletServerTest, TestScan_InvalidScanSeqId) {
   }
 }
 
+// Test scans with an aggregation: the responses carry partial aggregates
+// instead of rows, which merge into the aggregates of the whole tablet.
+TEST_F(TabletServerTest, TestScanWithAggregation) {
+  const int kNumRows = 1000;
+  InsertTestRowsDirect(0, kNumRows);
+
+  ScanRequestPB req;
+  NewScanRequestPB* scan = req.mutable_new_scan_request();
+  scan->set_tablet_id(kTabletId);
+  ASSERT_OK(SchemaToColumnPBs(schema_, scan->mutable_projected_columns()));
+  AggregationSpecPB* aggregation = scan->mutable_aggregation();
+  const auto add_aggregate = [&](AggregationSpecPB::Function function, const char* column) {
+    auto* agg = aggregation->add_aggregates();
+    agg->set_function(function);
+    if (column) {
+      agg->set_column(column);
+    }
+  };
+  add_aggregate(AggregationSpecPB::COUNT, nullptr);
+  add_aggregate(AggregationSpecPB::SUM, "int_val");
+  add_aggregate(AggregationSpecPB::MIN, "string_val");
+  add_aggregate(AggregationSpecPB::MAX, "key");
+  req.set_call_seq_id(0);
+  req.set_batch_size_bytes(10000);
+
+  // Without any group-by column, the partial aggregates stay small, so the
+  // whole tablet is aggregated by a single request.
+  {
+    ScanResponsePB resp;
+    RpcController rpc;
+    ASSERT_OK(proxy_->Scan(req, &resp, &rpc));
+    SCOPED_TRACE(SecureDebugString(resp));
+    ASSERT_FALSE(resp.has_error());
+    ASSERT_FALSE(resp.has_more_results());
+    ASSERT_FALSE(resp.has_data());
+    ASSERT_EQ(1, resp.aggregate_groups_size());
+
+    unique_ptr<ScanAggregator> aggregator;
+    ASSERT_OK(ScanAggregator::Create(*aggregation, schema_, &aggregator));
+    ASSERT_OK(aggregator->MergeFrom(resp.aggregate_groups()));
+    vector<KuduPartialRow*> rows;
+    ElementDeleter d(&rows);
+    aggregator->GetResultRows(&rows);
+    ASSERT_EQ(1, rows.size());
+    ASSERT_EQ("int64 count(*)=1000, int64 sum(int_val)=999000, "
+              "string min(string_val)=\"hello 0\", int32 max(key)=999",
+              rows[0]->ToString());
+  }
+
+  // Grouping by the key, every response is limited by the size of its partial
+  // aggregates, and continuing the scan keeps aggregating.
+  FLAGS_scanner_batch_size_rows = 100;
+  aggregation->set_group_by_key_prefix_len(1);
+  req.set_batch_size_bytes(1);
+  unique_ptr<ScanAggregator> aggregator;
+  ASSERT_OK(ScanAggregator::Create(*aggregation, schema_, &aggregator));
+  int num_responses = 0;
+  ScanResponsePB resp;
+  do {
+    RpcController rpc;
+    ASSERT_OK(proxy_->Scan(req, &resp, &rpc));
+    SCOPED_TRACE(SecureDebugString(resp));
+    ASSERT_FALSE(resp.has_error());
+    ASSERT_FALSE(resp.has_data());
+    ASSERT_OK(aggregator->MergeFrom(resp.aggregate_groups()));
+    if (req.has_new_scan_request()) {
+      req.clear_new_scan_request();
+      req.set_scanner_id(resp.scanner_id());
+    }
+    req.set_call_seq_id(++num_responses);
+  } while (resp.has_more_results());
+  ASSERT_GE(num_responses, kNumRows / 100);
+
+  vector<KuduPartialRow*> rows;
+  ElementDeleter d(&rows);
+  aggregator->GetResultRows(&rows);
+  ASSERT_EQ(kNumRows, rows.size());
+  ASSERT_EQ("int32 key=7, int64 count(*)=1, int64 sum(int_val)=14, "
+            "string min(string_val)=\"hello 7\", int32 max(key)=7",
+            rows[7]->ToString());
+}
+
+// Test that the live rows of a tablet are counted both by the CountLiveRows
+// RPC and by a COUNT(*) scan, which is answered without scanning.
+TEST_F(TabletServerTest, TestCountLiveRows) {
+  InsertTestRowsDirect(0, 100);
+  ASSERT_OK(tablet_replica_->tablet()->Flush());
+  DeleteTestRowsRemote(10, 20);
+
+  {
+    CountLiveRowsRequestPB req;
+    req.set_tablet_id(kTabletId);
+    CountLiveRowsResponsePB resp;
+    RpcController rpc;
+    ASSERT_OK(proxy_->CountLiveRows(req, &resp, &rpc));
+    SCOPED_TRACE(SecureDebugString(resp));
+    ASSERT_FALSE(resp.has_error());
+    ASSERT_EQ(80, resp.live_row_count());
+  }
+
+  ScanRequestPB req;
+  NewScanRequestPB* scan = req.mutable_new_scan_request();
+  scan->set_tablet_id(kTabletId);
+  scan->mutable_aggregation()->add_aggregates()->set_function(AggregationSpecPB::COUNT);
+  req.set_call_seq_id(0);
+  ScanResponsePB resp;
+  RpcController rpc;
+  ASSERT_OK(proxy_->Scan(req, &resp, &rpc));
+  SCOPED_TRACE(SecureDebugString(resp));
+  ASSERT_FALSE(resp.has_error());
+  ASSERT_FALSE(resp.has_more_results());
+  ASSERT_FALSE(resp.has_scanner_id());
+  ASSERT_EQ(1, resp.aggregate_groups_size());
+  ASSERT_EQ(80, resp.aggregate_groups(0).values(0).count());
+}
+
+// Test that aggregations which don't group by a prefix of the primary key
+// are rejected.
+TEST_F(TabletServerTest, TestInvalidScanRequest_BadAggregation) {
+  InsertTestRowsDirect(0, 10);
+
+  ScanRequestPB req;
+  NewScanRequestPB* scan = req.mutable_new_scan_request();
+  scan->set_tablet_id(kTabletId);
+  const Schema projection({ ColumnSchema("int_val", INT32),
+                            ColumnSchema("key", INT32) },
+                          0);
+  ASSERT_OK(SchemaToColumnPBs(projection, scan->mutable_projected_columns()));
+  AggregationSpecPB* aggregation = scan->mutable_aggregation();
+  aggregation->set_group_by_key_prefix_len(1);
+  aggregation->add_aggregates()->set_function(AggregationSpecPB::COUNT);
+  req.set_call_seq_id(0);
+
+  ScanResponsePB resp;
+  RpcController rpc;
+  ASSERT_OK(proxy_->Scan(req, &resp, &rpc));
+  SCOPED_TRACE(SecureDebugString(resp));
+  ASSERT_TRUE(resp.has_error());
+  ASSERT_EQ(TabletServerErrorPB::INVALID_SCAN_SPEC, resp.error().code());
+  ASSERT_STR_CONTAINS(resp.error().status().message(), "must be primary key column key");
+}
+
 // Regression test for KUDU-1789: when ScannerKeepAlive is called on a non-existent
 // scanner, it should properly respond with an error.
 TEST_F(TabletServerTest, TestScan_KeepAliveExpiredScanner) {
@@ -2074,6 +2611,63 @@ TEST_F(TabletServerTest, TestOrderedScan_ProjectionWithKeyColumnsOutOfOrder) {
                     R"((string string_val="hello $0", int32 int_val=$1, int32 key=$0))");
 }
 
+// Test that an ordered scan with a limit returns the first rows in primary key
+// order, across several rowsets, and then closes the scanner.
+TEST_F(TabletServerTest, TestOrderedScanWithLimit) {
+  InsertTestRowsDirect(20, 10);
+  ASSERT_OK(tablet_replica_->tablet()->Flush());
+  InsertTestRowsDirect(0, 10);
+  ASSERT_OK(tablet_replica_->tablet()->Flush());
+  InsertTestRowsDirect(10, 10);
+
+  // Return a few rows per block, so that the limit spans several blocks.
+  FLAGS_scanner_batch_size_rows = 4;
+
+  ScanResponsePB resp;
+  ScanRequestPB req;
+  RpcController rpc;
+
+  NewScanRequestPB* scan = req.mutable_new_scan_request();
+  scan->set_tablet_id(kTabletId);
+  ASSERT_OK(SchemaToColumnPBs(schema_, scan->mutable_projected_columns()));
+  req.set_call_seq_id(0);
+  scan->set_read_mode(READ_AT_SNAPSHOT);
+  scan->set_order_mode(ORDERED);
+  scan->set_limit(15);
+  {
+    SCOPED_TRACE(SecureDebugString(req));
+    req.set_batch_size_bytes(0); // so it won't return data right away
+    ASSERT_OK(proxy_->Scan(req, &resp, &rpc));
+    SCOPED_TRACE(SecureDebugString(resp));
+    ASSERT_FALSE(resp.has_error());
+  }
+
+  vector<string> results;
+  ASSERT_NO_FATAL_FAILURE(DrainScannerToStrings(resp.scanner_id(), schema_, &results));
+  ASSERT_EQ(15, results.size());
+  for (int i = 0; i < results.size(); ++i) {
+    ASSERT_EQ(Substitute(R"((int32 key=$0, int32 int_val=$1, string string_val="hello $0"))",
+                         i, i * 2),
+              results[i]);
+  }
+
+  // Reaching the limit closed the scanner.
+  ASSERT_EQ(0, mini_server_->server()->scanner_manager()->CountActiveScanners());
+
+  // A limit of zero doesn't return any row.
+  req.Clear();
+  resp.Clear();
+  rpc.Reset();
+  scan = req.mutable_new_scan_request();
+  scan->set_tablet_id(kTabletId);
+  ASSERT_OK(SchemaToColumnPBs(schema_, scan->mutable_projected_columns()));
+  scan->set_limit(0);
+  ASSERT_OK(proxy_->Scan(req, &resp, &rpc));
+  ASSERT_FALSE(resp.has_error()) << SecureDebugString(resp);
+  ASSERT_FALSE(resp.has_more_results());
+  ASSERT_EQ(0, resp.data().num_rows());
+}
+
 TEST_F(TabletServerTest, TestAlterSchema) {
   AlterSchemaRequestPB req;
   AlterSchemaResponsePB resp;
@@ -2583,6 +3177,108 @@ TEST_F(TabletServerTest, TestChecksumScan) {
   ASSERT_FALSE(resp.has_more_results());
 }
 
+TEST_F(TabletServerTest, TestListTabletsHotKeys) {
+  FLAGS_tablet_hot_keys_sample_interval = 1;
+  NO_FATALS(InsertTestRowsRemote(0, 10));
+
+  ListTabletsRequestPB req;
+  req.set_need_schema_info(false);
+  req.set_need_hot_keys(true);
+  req.set_max_hot_keys(3);
+  ListTabletsResponsePB resp;
+  RpcController controller;
+  ASSERT_OK(proxy_->ListTablets(req, &resp, &controller));
+  ASSERT_FALSE(resp.has_error()) << SecureDebugString(resp.error());
+  ASSERT_EQ(1, resp.status_and_schema_size());
+  const tablet::TabletHotKeysPB& hot_keys = resp.status_and_schema(0).hot_keys();
+  ASSERT_EQ(kTabletId, hot_keys.tablet_id());
+  ASSERT_EQ(10, hot_keys.estimated_ops());
+  ASSERT_EQ(3, hot_keys.keys_size());
+  for (const auto& key : hot_keys.keys()) {
+    ASSERT_EQ(1, key.estimated_ops());
+  }
+
+  // Hot keys aren't included unless asked for.
+  req.clear_need_hot_keys();
+  controller.Reset();
+  ASSERT_OK(proxy_->ListTablets(req, &resp, &controller));
+  ASSERT_FALSE(resp.status_and_schema(0).has_hot_keys());
+}
+
+// Test that columnar checksums don't depend on how the rows are batched.
+TEST_F(TabletServerTest, TestColumnarChecksumScan) {
+  ChecksumRequestPB req;
+  req.mutable_new_request()->set_tablet_id(kTabletId);
+  req.mutable_new_request()->set_read_mode(READ_LATEST);
+  req.set_call_seq_id(0);
+  req.set_algorithm(ChecksumRequestPB::COLUMNAR_HASH);
+  ASSERT_OK(SchemaToColumnPBs(schema_, req.mutable_new_request()->mutable_projected_columns(),
+                              SCHEMA_PB_WITHOUT_IDS));
+  const ChecksumRequestPB new_req = req;
+
+  // Runs a checksum scan of the whole tablet, in batches of a single row if
+  // 'one_row_per_batch' is true.
+  auto checksum = [&](bool one_row_per_batch, uint64_t* result) {
+    FLAGS_scanner_batch_size_rows = one_row_per_batch ? 1 : 100;
+    ChecksumRequestPB req = new_req;
+    if (one_row_per_batch) {
+      req.set_batch_size_bytes(1);
+    }
+    ChecksumResponsePB resp;
+    for (;;) {
+      RpcController controller;
+      ASSERT_OK(proxy_->Checksum(req, &resp, &controller));
+      ASSERT_FALSE(resp.has_error()) << SecureDebugString(resp.error());
+      ASSERT_EQ(ChecksumRequestPB::COLUMNAR_HASH, resp.algorithm());
+      if (!resp.has_more_results()) {
+        break;
+      }
+      if (req.has_new_request()) {
+        req.clear_new_request();
+        req.mutable_continue_request()->set_scanner_id(resp.scanner_id());
+      }
+      req.mutable_continue_request()->set_previous_checksum(resp.checksum());
+      req.set_call_seq_id(req.call_seq_id() + 1);
+    }
+    *result = resp.checksum();
+  };
+
+  uint64_t empty_checksum;
+  NO_FATALS(checksum(false, &empty_checksum));
+  ASSERT_EQ(0, empty_checksum);
+
+  InsertTestRowsRemote(1, 1);
+  uint64_t first_checksum;
+  NO_FATALS(checksum(false, &first_checksum));
+  ASSERT_NE(0, first_checksum);
+
+  // A second row, with a null string field.
+  InsertTestRowsRemote(2, 1, 1, nullptr, kTabletId, nullptr, nullptr, false);
+  uint64_t both_checksum;
+  NO_FATALS(checksum(false, &both_checksum));
+  ASSERT_NE(first_checksum, both_checksum);
+  uint64_t batched_checksum;
+  NO_FATALS(checksum(true, &batched_checksum));
+  ASSERT_EQ(both_checksum, batched_checksum);
+
+  // It differs from the row-wise CRC.
+  {
+    ChecksumRequestPB crc_req = new_req;
+    crc_req.clear_algorithm();
+    ChecksumResponsePB resp;
+    RpcController controller;
+    ASSERT_OK(proxy_->Checksum(crc_req, &resp, &controller));
+    ASSERT_EQ(ChecksumRequestPB::ROW_CRC32C, resp.algorithm());
+    ASSERT_EQ(CalcTestRowChecksum(1) + CalcTestRowChecksum(2, false), resp.checksum());
+  }
+
+  // Deleting the second row brings back the checksum of the first one.
+  NO_FATALS(DeleteTestRowsRemote(2, 1));
+  uint64_t after_delete_checksum;
+  NO_FATALS(checksum(false, &after_delete_checksum));
+  ASSERT_EQ(first_checksum, after_delete_checksum);
+}
+
 class DelayFsyncLogHook : public log::Log::LogFaultHooks {
  public:
   DelayFsyncLogHook() : log_latch1_(1), test_latch1_(1) {}
@@ -22,14 +22,19 @@
 #include <type_traits>
 #include <utility>
 
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 
 #include "kudu/cfile/block_cache.h"
+#include "kudu/cfile/block_cache_warmer.h"
+#include "kudu/fs/block_manager.h"
+#include "kudu/fs/data_dirs.h"
 #include "kudu/fs/fs_manager.h"
 #include "kudu/gutil/bind.h"
 #include "kudu/gutil/bind_helpers.h"
 #include "kudu/gutil/move.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/sysinfo.h"
 #include "kudu/rpc/service_if.h"
 #include "kudu/tserver/heartbeater.h"
 #include "kudu/tserver/scanners.h"
@@ -37,9 +42,18 @@
 #include "kudu/tserver/tablet_service.h"
 #include "kudu/tserver/ts_tablet_manager.h"
 #include "kudu/tserver/tserver_path_handlers.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/maintenance_manager.h"
 #include "kudu/util/net/net_util.h"
 #include "kudu/util/status.h"
+#include "kudu/util/threadpool.h"
+
+DEFINE_int32(scan_pool_max_threads, 0,
+             "Maximum number of threads of the pool on which unordered scans read "
+             "several rowsets at once (see --tablet_unordered_scan_threads). The pool "
+             "is shared by all the scans of the tablet server, which bounds the "
+             "threads they use altogether. 0 means the number of CPUs.");
+TAG_FLAG(scan_pool_max_threads, experimental);
 
 using std::string;
 using kudu::rpc::ServiceIf;
@@ -95,6 +109,11 @@ Status TabletServer::Init() {
 
   heartbeater_.reset(new Heartbeater(opts_, this));
 
+  RETURN_NOT_OK(ThreadPoolBuilder("scan")
+                .set_max_threads(FLAGS_scan_pool_max_threads > 0 ?
+                                 FLAGS_scan_pool_max_threads : base::NumCPUs())
+                .Build(&scan_pool_));
+
   RETURN_NOT_OK_PREPEND(tablet_manager_->Init(),
                         "Could not init Tablet Manager");
 
@@ -129,6 +148,14 @@ Status TabletServer::Start() {
 
   RETURN_NOT_OK(heartbeater_->Start());
   RETURN_NOT_OK(maintenance_manager_->Init(fs_manager_->uuid()));
+  fs_manager_->block_manager()->RegisterMaintenanceOps(maintenance_manager_.get());
+  fs::DataDirManager* dd_manager = fs_manager_->dd_manager();
+  maintenance_manager_->set_io_backpressure_func([dd_manager]() {
+    return dd_manager->IsBackgroundIOBacklogged();
+  });
+
+  block_cache_warmer_.reset(new cfile::BlockCacheWarmer(fs_manager_.get()));
+  RETURN_NOT_OK(block_cache_warmer_->Start());
 
   google::FlushLogFiles(google::INFO); // Flush the startup messages.
 
@@ -145,6 +172,9 @@ void TabletServer::Shutdown() {
 
     // 2. Shut down the tserver's subsystems.
     maintenance_manager_->Shutdown();
+    if (block_cache_warmer_) {
+      block_cache_warmer_->Shutdown();
+    }
     WARN_NOT_OK(heartbeater_->Stop(), "Failed to stop TS Heartbeat thread");
     fs_manager_->UnsetErrorNotificationCb();
     tablet_manager_->Shutdown();
@@ -31,6 +31,11 @@
 namespace kudu {
 
 class MaintenanceManager;
+class ThreadPool;
+
+namespace cfile {
+class BlockCacheWarmer;
+} // namespace cfile
 
 namespace tserver {
 
@@ -68,6 +73,10 @@ class TabletServer : public kserver::KuduServer {
 
   ScannerManager* scanner_manager() { return scanner_manager_.get(); }
 
+  // The pool on which unordered scans read several rowsets at once, shared
+  // by all the scans of this server.
+  ThreadPool* scan_pool() { return scan_pool_.get(); }
+
   Heartbeater* heartbeater() { return heartbeater_.get(); }
 
   void set_fail_heartbeats_for_tests(bool fail_heartbeats_for_tests) {
@@ -98,6 +107,10 @@ class TabletServer : public kserver::KuduServer {
   // Manager for tablets which are available on this server.
   gscoped_ptr<TSTabletManager> tablet_manager_;
 
+  // Shared by the parallel scans of all tablets. Declared before
+  // 'scanner_manager_' so that it outlives the iterators of the scanners.
+  gscoped_ptr<ThreadPool> scan_pool_;
+
   // Manager for open scanners from clients.
   // This is always non-NULL. It is scoped only to minimize header
   // dependencies.
@@ -112,6 +125,10 @@ class TabletServer : public kserver::KuduServer {
   // The maintenance manager for this tablet server
   std::shared_ptr<MaintenanceManager> maintenance_manager_;
 
+  // Persists the hottest blocks of the block cache, and reads them back
+  // into the cache on startup.
+  gscoped_ptr<cfile::BlockCacheWarmer> block_cache_warmer_;
+
   DISALLOW_COPY_AND_ASSIGN(TabletServer);
 };
 
@@ -15,13 +15,16 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include "kudu/tserver/request_capture.h"
 #include "kudu/tserver/tablet_service.h"
 
 #include <algorithm>
 #include <cstdint>
 #include <cstring>
 #include <functional>
+#include <limits>
 #include <memory>
+#include <mutex>
 #include <ostream>
 #include <string>
 #include <type_traits>
@@ -33,7 +36,10 @@
 #include <gflags/gflags_declare.h>
 #include <glog/logging.h>
 
+#include "kudu/cfile/cfile.pb.h"
+#include "kudu/cfile/column_statistics.h"
 #include "kudu/clock/clock.h"
+#include "kudu/common/aggregation.h"
 #include "kudu/common/column_predicate.h"
 #include "kudu/common/columnblock.h"
 #include "kudu/common/common.pb.h"
@@ -41,6 +47,7 @@
 #include "kudu/common/iterator.h"
 #include "kudu/common/iterator_stats.h"
 #include "kudu/common/partition.h"
+#include "kudu/common/row_checksum.h"
 #include "kudu/common/rowblock.h"
 #include "kudu/common/scan_spec.h"
 #include "kudu/common/schema.h"
@@ -60,13 +67,16 @@
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/gutil/stringprintf.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/rpc/messenger.h"
 #include "kudu/rpc/rpc_context.h"
 #include "kudu/rpc/rpc_header.pb.h"
 #include "kudu/rpc/rpc_sidecar.h"
 #include "kudu/server/server_base.h"
 #include "kudu/tablet/compaction.h"
+#include "kudu/tablet/delta_store.h"
 #include "kudu/tablet/metadata.pb.h"
 #include "kudu/tablet/mvcc.h"
+#include "kudu/tablet/projection_cache.h"
 #include "kudu/tablet/tablet.h"
 #include "kudu/tablet/tablet_metadata.h"
 #include "kudu/tablet/tablet_metrics.h"
@@ -74,6 +84,9 @@
 #include "kudu/tablet/transactions/alter_schema_transaction.h"
 #include "kudu/tablet/transactions/transaction.h"
 #include "kudu/tablet/transactions/write_transaction.h"
+#include "kudu/tserver/quota_manager.h"
+#include "kudu/tserver/scan_result_cache.h"
+#include "kudu/tserver/scan_scheduler.h"
 #include "kudu/tserver/scanners.h"
 #include "kudu/tserver/tablet_replica_lookup.h"
 #include "kudu/tserver/tablet_server.h"
@@ -82,19 +95,28 @@
 #include "kudu/tserver/tserver_admin.pb.h"
 #include "kudu/tserver/tserver_service.pb.h"
 #include "kudu/util/auto_release_pool.h"
+#include "kudu/util/coding.h"
+#include "kudu/util/countdown_latch.h"
 #include "kudu/util/crc.h"
+#include "kudu/util/debug/leakcheck_disabler.h"
 #include "kudu/util/debug/trace_event.h"
+#include "kudu/util/env.h"
 #include "kudu/util/faststring.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/logging.h"
+#include "kudu/util/mem_tracker.h"
 #include "kudu/util/memory/arena.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/pb_util.h"
 #include "kudu/util/process_memory.h"
+#include "kudu/util/scoped_cleanup.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/status.h"
 #include "kudu/util/status_callback.h"
+#include "kudu/util/stopwatch.h"
+#include "kudu/util/threadlocal.h"
+#include "kudu/util/threadpool.h"
 #include "kudu/util/trace.h"
 #include "kudu/util/trace_metrics.h"
 #include "kudu/util/website_util.h"
@@ -125,6 +147,47 @@ DEFINE_int32(scanner_max_wait_ms, 1000,
              "longer.");
 TAG_FLAG(scanner_max_wait_ms, advanced);
 
+DEFINE_int64(tablet_soft_memory_limit_mb, 0,
+             "Memory used by a tablet (in megabytes) past which writes to it "
+             "are delayed, in proportion to how far past the limit it is. This "
+             "slows down a tablet whose ingest outpaces its flushes before the "
+             "whole server hits its soft memory limit and rejects writes to "
+             "all tablets. If 0, a quarter of the process memory limit is used. "
+             "If negative, writes are never delayed.");
+TAG_FLAG(tablet_soft_memory_limit_mb, advanced);
+TAG_FLAG(tablet_soft_memory_limit_mb, runtime);
+
+DEFINE_int32(tablet_max_write_delay_ms, 1000,
+             "The maximum amount of time (in milliseconds) a write to a tablet "
+             "past its soft memory limit is delayed. Writes are delayed this "
+             "long once the tablet uses twice its soft memory limit.");
+TAG_FLAG(tablet_max_write_delay_ms, advanced);
+TAG_FLAG(tablet_max_write_delay_ms, runtime);
+
+DEFINE_int64(scan_result_cache_capacity_mb, 0,
+             "Capacity (in megabytes) of the cache of results of snapshot scans "
+             "at a client-chosen timestamp which fit in a single response. "
+             "Repeated identical scans, such as those of dashboards, are "
+             "answered from the cache without scanning the tablet. If 0, "
+             "scan results aren't cached.");
+TAG_FLAG(scan_result_cache_capacity_mb, advanced);
+TAG_FLAG(scan_result_cache_capacity_mb, experimental);
+
+DEFINE_int32(multi_scan_threads, 8,
+             "Maximum number of threads running the scans of MultiScan requests, "
+             "in addition to the RPC service threads handling the requests. If 0 "
+             "or less, the scans of a MultiScan request run one after the other.");
+TAG_FLAG(multi_scan_threads, advanced);
+
+DEFINE_int32(multi_update_consensus_threads, 8,
+             "Maximum number of threads handling the requests of "
+             "MultiUpdateConsensus RPCs, in addition to the RPC service threads "
+             "handling the RPCs, so that a request waiting for its replica doesn't "
+             "hold up the others. If 0 or less, the requests of a "
+             "MultiUpdateConsensus RPC are handled one after the other.");
+TAG_FLAG(multi_update_consensus_threads, advanced);
+TAG_FLAG(multi_update_consensus_threads, experimental);
+
 // Fault injection flags.
 DEFINE_int32(scanner_inject_latency_on_each_batch_ms, 0,
              "If set, the scanner will pause the specified number of milliesconds "
@@ -134,6 +197,11 @@ TAG_FLAG(scanner_inject_latency_on_each_batch_ms, unsafe);
 
 DECLARE_int32(memory_limit_warn_threshold_percentage);
 DECLARE_int32(tablet_history_max_age_sec);
+DECLARE_string(log_dir);
+DECLARE_bool(scan_scheduler_enabled);
+DECLARE_int32(scan_scheduler_time_slice_ms);
+DECLARE_string(scan_scheduler_share_key);
+DECLARE_int32(quota_max_scan_delay_ms);
 
 using google::protobuf::RepeatedPtrField;
 using kudu::consensus::ChangeConfigRequestPB;
@@ -145,10 +213,13 @@ using kudu::consensus::GetNodeInstanceRequestPB;
 using kudu::consensus::GetNodeInstanceResponsePB;
 using kudu::consensus::LeaderStepDownRequestPB;
 using kudu::consensus::LeaderStepDownResponsePB;
+using kudu::consensus::MultiConsensusRequestPB;
+using kudu::consensus::MultiConsensusResponsePB;
 using kudu::consensus::OpId;
 using kudu::consensus::UnsafeChangeConfigRequestPB;
 using kudu::consensus::UnsafeChangeConfigResponsePB;
 using kudu::consensus::RaftConsensus;
+using kudu::consensus::RaftPeerPB;
 using kudu::consensus::RunLeaderElectionRequestPB;
 using kudu::consensus::RunLeaderElectionResponsePB;
 using kudu::consensus::StartTabletCopyRequestPB;
@@ -163,6 +234,7 @@ using kudu::rpc::RpcContext;
 using kudu::rpc::RpcSidecar;
 using kudu::server::ServerBase;
 using kudu::tablet::AlterSchemaTransactionState;
+using kudu::tablet::ProjectionCache;
 using kudu::tablet::TABLET_DATA_COPYING;
 using kudu::tablet::TABLET_DATA_DELETED;
 using kudu::tablet::TABLET_DATA_TOMBSTONED;
@@ -188,6 +260,30 @@ namespace tserver {
 
 namespace {
 
+// Trace metrics accounting for the resources used by a scan request. See
+// ResourceMetricsPB.
+const char* kScanRowsScannedMetricName = "scan_rows_scanned";
+const char* kScanRowsReturnedMetricName = "scan_rows_returned";
+const char* kScanSafeTimeWaitNanosMetricName = "scan_safe_time_wait_nanos";
+
+// Returns how long to delay a write to 'tablet', in milliseconds, based on how
+// far its memory usage is past --tablet_soft_memory_limit_mb.
+int32_t ComputeWriteDelayMs(const Tablet& tablet) {
+  int64_t limit = FLAGS_tablet_soft_memory_limit_mb * 1024 * 1024;
+  if (limit < 0 || FLAGS_tablet_max_write_delay_ms <= 0) {
+    return 0;
+  }
+  if (limit == 0) {
+    limit = process_memory::HardLimit() / 4;
+  }
+  int64_t excess = tablet.mem_tracker()->consumption() - limit;
+  if (limit <= 0 || excess <= 0) {
+    return 0;
+  }
+  double excess_ratio = std::min(1.0, static_cast<double>(excess) / limit);
+  return std::max(1, static_cast<int32_t>(excess_ratio * FLAGS_tablet_max_write_delay_ms));
+}
+
 // Lookup the given tablet, only ensuring that it exists.
 // If it does not, responds to the RPC associated with 'context' after setting
 // resp->mutable_error() to indicate the failure reason.
@@ -208,24 +304,34 @@ bool LookupTabletReplicaOrRespond(TabletReplicaLookupIf* tablet_manager,
   return true;
 }
 
-template<class RespClass>
-void RespondTabletNotRunning(const scoped_refptr<TabletReplica>& replica,
+// Returns the error for a request to 'replica', which is in the non-RUNNING
+// state 'tablet_state', setting 'error_code' to the matching code.
+Status TabletNotRunningError(const scoped_refptr<TabletReplica>& replica,
                              tablet::TabletStatePB tablet_state,
-                             RespClass* resp,
-                             rpc::RpcContext* context) {
+                             TabletServerErrorPB::Code* error_code) {
   Status s = Status::IllegalState("Tablet not RUNNING",
                                   tablet::TabletStatePB_Name(tablet_state));
-  auto error_code = TabletServerErrorPB::TABLET_NOT_RUNNING;
+  *error_code = TabletServerErrorPB::TABLET_NOT_RUNNING;
   if (replica->tablet_metadata()->tablet_data_state() == TABLET_DATA_TOMBSTONED ||
       replica->tablet_metadata()->tablet_data_state() == TABLET_DATA_DELETED) {
     // Treat tombstoned tablets as if they don't exist for most purposes.
     // This takes precedence over failed, since we don't reset the failed
     // status of a TabletReplica when deleting it. Only tablet copy does that.
-    error_code = TabletServerErrorPB::TABLET_NOT_FOUND;
+    *error_code = TabletServerErrorPB::TABLET_NOT_FOUND;
   } else if (tablet_state == tablet::FAILED) {
     s = s.CloneAndAppend(replica->error().ToString());
-    error_code = TabletServerErrorPB::TABLET_FAILED;
+    *error_code = TabletServerErrorPB::TABLET_FAILED;
   }
+  return s;
+}
+
+template<class RespClass>
+void RespondTabletNotRunning(const scoped_refptr<TabletReplica>& replica,
+                             tablet::TabletStatePB tablet_state,
+                             RespClass* resp,
+                             rpc::RpcContext* context) {
+  TabletServerErrorPB::Code error_code;
+  Status s = TabletNotRunningError(replica, tablet_state, &error_code);
   SetupErrorAndRespond(resp->mutable_error(), s, error_code, context);
 }
 
@@ -263,6 +369,25 @@ bool LookupRunningTabletReplicaOrRespond(TabletReplicaLookupIf* tablet_manager,
   return true;
 }
 
+// Like LookupRunningTabletReplicaOrRespond(), for requests of a batch:
+// returns a bad Status if the tablet doesn't exist or isn't RUNNING, setting
+// 'error_code' to the code of the error.
+Status LookupRunningTabletReplica(TabletReplicaLookupIf* tablet_manager,
+                                  const string& tablet_id,
+                                  scoped_refptr<TabletReplica>* replica,
+                                  TabletServerErrorPB::Code* error_code) {
+  Status s = tablet_manager->GetTabletReplica(tablet_id, replica);
+  if (PREDICT_FALSE(!s.ok())) {
+    *error_code = TabletServerErrorPB::TABLET_NOT_FOUND;
+    return s;
+  }
+  tablet::TabletStatePB state = (*replica)->state();
+  if (PREDICT_FALSE(state != tablet::RUNNING)) {
+    return TabletNotRunningError(*replica, state, error_code);
+  }
+  return Status::OK();
+}
+
 template<class ReqClass, class RespClass>
 bool CheckUuidMatchOrRespond(TabletReplicaLookupIf* tablet_manager,
                              const char* method_name,
@@ -311,6 +436,48 @@ bool GetConsensusOrRespond(const scoped_refptr<TabletReplica>& replica,
   return true;
 }
 
+// Handles one of the requests of a MultiUpdateConsensus() call, the same way
+// UpdateConsensus() does. Returns a bad Status if the request failed, setting
+// 'error_code' to the code of the error.
+Status UpdateConsensusInBatch(TabletReplicaLookupIf* tablet_manager,
+                              const ConsensusRequestPB& req,
+                              ConsensusResponsePB* resp,
+                              TabletServerErrorPB::Code* error_code) {
+  const string& local_uuid = tablet_manager->NodeInstance().permanent_uuid();
+  if (PREDICT_FALSE(req.has_dest_uuid() && req.dest_uuid() != local_uuid)) {
+    *error_code = TabletServerErrorPB::WRONG_SERVER_UUID;
+    return Status::InvalidArgument(Substitute("MultiUpdateConsensus: Wrong destination UUID "
+                                              "requested. Local UUID: $0. Requested UUID: $1",
+                                              local_uuid, req.dest_uuid()));
+  }
+  scoped_refptr<TabletReplica> replica;
+  RETURN_NOT_OK(LookupRunningTabletReplica(tablet_manager, req.tablet_id(), &replica,
+                                           error_code));
+  shared_ptr<RaftConsensus> consensus = replica->shared_consensus();
+  if (PREDICT_FALSE(!consensus)) {
+    *error_code = TabletServerErrorPB::TABLET_NOT_RUNNING;
+    return Status::ServiceUnavailable("Raft Consensus unavailable",
+                                      "Tablet replica not initialized");
+  }
+  *error_code = TabletServerErrorPB::UNKNOWN_ERROR;
+  return consensus->Update(&req, resp);
+}
+
+// Parses the ops of 'req' out of the RPC sidecar the leader sent them in.
+Status ParseOpsFromSidecar(RpcContext* context, ConsensusRequestPB* req) {
+  Slice sidecar;
+  RETURN_NOT_OK(context->GetInboundSidecar(req->ops_sidecar_idx(), &sidecar));
+  while (!sidecar.empty()) {
+    Slice op;
+    if (PREDICT_FALSE(!GetLengthPrefixedSlice(&sidecar, &op) ||
+                      !req->add_ops()->ParseFromArray(op.data(), op.size()))) {
+      return Status::Corruption("Could not parse the ops sidecar of the request");
+    }
+  }
+  req->clear_ops_sidecar_idx();
+  return Status::OK();
+}
+
 Status GetTabletRef(const scoped_refptr<TabletReplica>& replica,
                     shared_ptr<Tablet>* tablet,
                     TabletServerErrorPB::Code* error_code) {
@@ -322,6 +489,83 @@ Status GetTabletRef(const scoped_refptr<TabletReplica>& replica,
   return Status::OK();
 }
 
+// Sets 'projection' to the client projection made of 'columns', shared with
+// the requests for the same columns through the projection cache of 'tablet',
+// and 'signature' to what identifies these columns in the cache.
+Status ResolveClientProjection(const Tablet& tablet,
+                               const RepeatedPtrField<ColumnSchemaPB>& columns,
+                               shared_ptr<const Schema>* projection,
+                               string* signature) {
+  signature->clear();
+  for (const ColumnSchemaPB& col : columns) {
+    // Each column is prefixed with its length so that the signature is unambiguous.
+    signature->append(Substitute("$0:", col.ByteSize()));
+    col.AppendPartialToString(signature);
+  }
+  const string key = ProjectionCache::MakeKey(ProjectionCache::CLIENT_PROJECTION,
+                                              tablet.metadata()->schema_version(), *signature);
+  *projection = tablet.projection_cache()->Lookup(key);
+  if (*projection) {
+    return Status::OK();
+  }
+  shared_ptr<Schema> resolved(new Schema);
+  RETURN_NOT_OK(ColumnPBsToSchema(columns, resolved.get()));
+  if (resolved->has_column_ids()) {
+    return Status::InvalidArgument("User requests should not have Column IDs");
+  }
+  tablet.projection_cache()->Insert(key, resolved);
+  *projection = std::move(resolved);
+  return Status::OK();
+}
+
+// Sets 'projection' to the projection which a scan reads from 'tablet': the
+// client projection identified by 'client_signature', made of the columns of
+// 'client_projection', followed by the columns the scan needs on top of it,
+// 'missing_cols'. The projection is shared with the scans of the same columns
+// through the projection cache of 'tablet'.
+void ResolveScanProjection(const Tablet& tablet,
+                           const Schema& client_projection,
+                           const string& client_signature,
+                           const vector<ColumnSchema>& missing_cols,
+                           shared_ptr<const Schema>* projection) {
+  string signature = client_signature;
+  for (const ColumnSchema& col : missing_cols) {
+    signature.push_back('\0');
+    signature.append(col.name());
+  }
+  const string key = ProjectionCache::MakeKey(ProjectionCache::SCAN_PROJECTION,
+                                              tablet.metadata()->schema_version(), signature);
+  *projection = tablet.projection_cache()->Lookup(key);
+  if (*projection) {
+    return;
+  }
+
+  // Build a new projection with the projection columns and the missing columns. Make
+  // sure to set whether the column is a key column appropriately.
+  const Schema& tablet_schema = *tablet.schema();
+  SchemaBuilder projection_builder;
+  vector<ColumnSchema> projection_columns = client_projection.columns();
+  for (const ColumnSchema& col : missing_cols) {
+    projection_columns.push_back(col);
+  }
+  for (const ColumnSchema& col : projection_columns) {
+    CHECK_OK(projection_builder.AddColumn(col, tablet_schema.is_key_column(col.name())));
+  }
+  shared_ptr<const Schema> resolved(new Schema(projection_builder.BuildWithoutIds()));
+  tablet.projection_cache()->Insert(key, resolved);
+  *projection = std::move(resolved);
+}
+
+// Witnesses store no data, so they can't serve scans.
+Status CheckNotWitness(TabletReplica* replica, TabletServerErrorPB::Code* error_code) {
+  shared_ptr<RaftConsensus> consensus = replica->shared_consensus();
+  if (PREDICT_FALSE(consensus && consensus->IsWitness())) {
+    *error_code = TabletServerErrorPB::TABLET_NOT_RUNNING;
+    return Status::ServiceUnavailable("Tablet replica is a witness, which stores no data");
+  }
+  return Status::OK();
+}
+
 template <class RespType>
 void HandleUnknownError(const Status& s, RespType* resp, RpcContext* context) {
   resp->Clear();
@@ -436,6 +680,14 @@ class ScanResultCollector {
   //
   // Does nothing by default.
   virtual void set_row_format_flags(uint64_t /* row_format_flags */) {}
+
+  // Sets how long the response should be held back because the scan exceeded
+  // a quota of its table or user, in which case the batch has no rows.
+  void set_quota_delay(const MonoDelta& delay) { quota_delay_ = delay; }
+  const MonoDelta& quota_delay() const { return quota_delay_; }
+
+ private:
+  MonoDelta quota_delay_ = MonoDelta::FromNanoseconds(0);
 };
 
 namespace {
@@ -476,21 +728,67 @@ class ScanResultCopier : public ScanResultCollector {
         rows_data_(DCHECK_NOTNULL(rows_data)),
         indirect_data_(DCHECK_NOTNULL(indirect_data)),
         num_rows_returned_(0),
-        pad_unixtime_micros_to_16_bytes_(false) {}
+        pad_unixtime_micros_to_16_bytes_(false),
+        columnar_layout_(false) {}
 
   void HandleRowBlock(const Schema* client_projection_schema,
                               const RowBlock& row_block) override {
     num_rows_returned_ += row_block.selection_vector()->CountSelected();
-    SerializeRowBlock(row_block, rowblock_pb_, client_projection_schema,
-                      rows_data_, indirect_data_, pad_unixtime_micros_to_16_bytes_);
+    if (columnar_layout_) {
+      if (!columnar_batch_) {
+        columnar_batch_.reset(new ColumnarSerializedBatch(
+            client_projection_schema ? *client_projection_schema : row_block.schema()));
+      }
+      SerializeRowBlockColumnar(row_block, client_projection_schema, columnar_batch_.get());
+    } else {
+      SerializeRowBlock(row_block, rowblock_pb_, client_projection_schema,
+                        rows_data_, indirect_data_, pad_unixtime_micros_to_16_bytes_);
+    }
     SetLastRow(row_block, &last_primary_key_);
   }
 
   // Returns number of bytes buffered to return.
   int64_t ResponseSize() const override {
+    if (columnar_batch_) {
+      return columnar_batch_->TotalSize();
+    }
     return rows_data_->size() + indirect_data_->size();
   }
 
+  bool columnar_layout() const {
+    return columnar_layout_;
+  }
+
+  // Fills in 'columnar_pb' with the columnar data collected so far, adding
+  // each buffer as an outbound sidecar to 'context'.
+  //
+  // If no rows were collected, only the row count is set.
+  void SetupColumnarResponse(RpcContext* context, ColumnarRowBlockPB* columnar_pb) {
+    DCHECK(columnar_layout_);
+    columnar_pb->set_num_rows(num_rows_returned_);
+    if (!columnar_batch_) {
+      return;
+    }
+    for (auto& col : columnar_batch_->columns) {
+      auto* col_pb = columnar_pb->add_columns();
+      int idx;
+      CHECK_OK(context->AddOutboundSidecar(
+          RpcSidecar::FromFaststring(std::move(col.data)), &idx));
+      col_pb->set_data_sidecar(idx);
+      if (col.varlen_data) {
+        CHECK_OK(context->AddOutboundSidecar(
+            RpcSidecar::FromFaststring(std::move(col.varlen_data)), &idx));
+        col_pb->set_varlen_data_sidecar(idx);
+      }
+      if (col.non_null_bitmap) {
+        CHECK_OK(context->AddOutboundSidecar(
+            RpcSidecar::FromFaststring(std::move(col.non_null_bitmap)), &idx));
+        col_pb->set_non_null_bitmap_sidecar(idx);
+      }
+    }
+    columnar_batch_.reset();
+  }
+
   const faststring& last_primary_key() const override {
     return last_primary_key_;
   }
@@ -503,6 +801,9 @@ class ScanResultCopier : public ScanResultCollector {
     if (row_format_flags & RowFormatFlags::PAD_UNIX_TIME_MICROS_TO_16_BYTES) {
       pad_unixtime_micros_to_16_bytes_ = true;
     }
+    if (row_format_flags & RowFormatFlags::COLUMNAR_LAYOUT) {
+      columnar_layout_ = true;
+    }
   }
 
  private:
@@ -512,6 +813,11 @@ class ScanResultCopier : public ScanResultCollector {
   int64_t num_rows_returned_;
   faststring last_primary_key_;
   bool pad_unixtime_micros_to_16_bytes_;
+  bool columnar_layout_;
+
+  // Lazily created when the first row block is collected, since the
+  // projection isn't known until then.
+  unique_ptr<ColumnarSerializedBatch> columnar_batch_;
 
   DISALLOW_COPY_AND_ASSIGN(ScanResultCopier);
 };
@@ -519,8 +825,9 @@ class ScanResultCopier : public ScanResultCollector {
 // Checksums the scan result.
 class ScanResultChecksummer : public ScanResultCollector {
  public:
-  ScanResultChecksummer()
-      : crc_(crc::GetCrc32cInstance()),
+  explicit ScanResultChecksummer(ChecksumRequestPB::Algorithm algorithm)
+      : algorithm_(algorithm),
+        crc_(crc::GetCrc32cInstance()),
         agg_checksum_(0),
         rows_checksummed_(0) {
   }
@@ -531,12 +838,18 @@ class ScanResultChecksummer : public ScanResultCollector {
       client_projection_schema = &row_block.schema();
     }
 
-    size_t nrows = row_block.nrows();
-    for (size_t i = 0; i < nrows; i++) {
-      if (!row_block.selection_vector()->IsRowSelected(i)) continue;
-      uint32_t row_crc = CalcRowCrc32(*client_projection_schema, row_block.row(i));
-      agg_checksum_ += row_crc;
-      rows_checksummed_++;
+    if (algorithm_ == ChecksumRequestPB::COLUMNAR_HASH) {
+      agg_checksum_ += columnar_checksummer_.SumRowHashes(
+          row_block, client_projection_schema->num_columns());
+      rows_checksummed_ += row_block.selection_vector()->CountSelected();
+    } else {
+      size_t nrows = row_block.nrows();
+      for (size_t i = 0; i < nrows; i++) {
+        if (!row_block.selection_vector()->IsRowSelected(i)) continue;
+        uint32_t row_crc = CalcRowCrc32(*client_projection_schema, row_block.row(i));
+        agg_checksum_ += row_crc;
+        rows_checksummed_++;
+      }
     }
     // Find the last selected row and save its encoded key.
     SetLastRow(row_block, &encoded_last_row_);
@@ -587,6 +900,8 @@ class ScanResultChecksummer : public ScanResultCollector {
   }
 
 
+  const ChecksumRequestPB::Algorithm algorithm_;
+  ColumnarRowChecksummer columnar_checksummer_;
   faststring tmp_buf_;
   crc::Crc* const crc_;
   uint64_t agg_checksum_;
@@ -596,6 +911,105 @@ class ScanResultChecksummer : public ScanResultCollector {
   DISALLOW_COPY_AND_ASSIGN(ScanResultChecksummer);
 };
 
+// Returns whether 'scan_pb' counts all the rows of the tablet visible to a
+// READ_LATEST scan, so it can be answered from Tablet::CountLiveRows()
+// without scanning them.
+static bool IsLiveRowCountScan(const NewScanRequestPB& scan_pb) {
+  if (!scan_pb.has_aggregation() ||
+      scan_pb.read_mode() != READ_LATEST ||
+      scan_pb.has_limit() ||
+      scan_pb.column_predicates_size() > 0 ||
+      scan_pb.deprecated_range_predicates_size() > 0 ||
+      scan_pb.has_start_primary_key() ||
+      scan_pb.has_stop_primary_key() ||
+      scan_pb.has_last_primary_key()) {
+    return false;
+  }
+  const AggregationSpecPB& spec = scan_pb.aggregation();
+  if (spec.group_by_key_prefix_len() > 0 || spec.aggregates_size() == 0) {
+    return false;
+  }
+  for (const auto& agg : spec.aggregates()) {
+    if (agg.function() != AggregationSpecPB::COUNT || agg.has_column()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Aggregates the scan result, returning partial aggregates to the client
+// instead of the rows.
+class ScanResultAggregator : public ScanResultCollector {
+ public:
+  explicit ScanResultAggregator(const AggregationSpecPB& spec)
+      : spec_(spec) {
+  }
+
+  void HandleRowBlock(const Schema* client_projection_schema,
+                      const RowBlock& row_block) override {
+    if (!aggregator_) {
+      // The aggregation was validated against the projection when the
+      // scanner was created.
+      CHECK_OK(ScanAggregator::Create(
+          spec_, client_projection_schema ? *client_projection_schema : row_block.schema(),
+          &aggregator_));
+    }
+    aggregator_->AddRowBlock(row_block);
+    SetLastRow(row_block, &last_primary_key_);
+  }
+
+  // Returns the approximate size of the partial aggregates: without any
+  // group-by column, this stays small, so the scan proceeds until the time
+  // budget of the request runs out.
+  int64_t ResponseSize() const override {
+    return aggregator_ ? aggregator_->EstimatedResultSize() : 0;
+  }
+
+  const faststring& last_primary_key() const override {
+    return last_primary_key_;
+  }
+
+  int64_t NumRowsReturned() const override {
+    return 0;
+  }
+
+  // Sets the result of an aggregation made only of COUNTs without a column,
+  // and without any group-by column, to 'count' rows, in lieu of scanning
+  // them.
+  void SetRowCount(int64_t count) {
+    DCHECK(!aggregator_);
+    row_count_ = count;
+  }
+
+  // Moves the partial aggregates collected so far into 'groups'.
+  void TakeResults(RepeatedPtrField<AggregateGroupPB>* groups) {
+    if (aggregator_) {
+      aggregator_->TakeResults(groups);
+    } else if (row_count_ > 0) {
+      // Like a scan, only return a group if there are rows.
+      AggregateGroupPB* group = groups->Add();
+      for (int i = 0; i < spec_.aggregates_size(); i++) {
+        group->add_values()->set_count(row_count_);
+      }
+      row_count_ = 0;
+    }
+  }
+
+ private:
+  const AggregationSpecPB spec_;
+
+  // Set by SetRowCount().
+  int64_t row_count_ = 0;
+
+  // Lazily created when the first row block is collected, since the
+  // projection isn't known until then.
+  unique_ptr<ScanAggregator> aggregator_;
+
+  faststring last_primary_key_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScanResultAggregator);
+};
+
 // Return the batch size to use for a given request, after clamping
 // the user-requested request within the server-side allowable range.
 // This is only a hint, really more of a threshold since returned bytes
@@ -611,9 +1025,23 @@ static size_t GetMaxBatchSizeBytesHint(const ScanRequestPB* req) {
 
 TabletServiceImpl::TabletServiceImpl(TabletServer* server)
   : TabletServerServiceIf(server->metric_entity(), server->result_tracker()),
-    server_(server) {
+    server_(server),
+    request_capture_(new RequestCapture(Env::Default(), FLAGS_log_dir)),
+    scan_scheduler_(new ScanScheduler()),
+    quota_manager_(new QuotaManager()) {
+  if (FLAGS_scan_result_cache_capacity_mb > 0) {
+    scan_result_cache_.reset(
+        new ScanResultCache(FLAGS_scan_result_cache_capacity_mb * 1024 * 1024));
+  }
+  if (FLAGS_multi_scan_threads > 0) {
+    CHECK_OK(ThreadPoolBuilder("multi-scan")
+             .set_max_threads(FLAGS_multi_scan_threads)
+             .Build(&multi_scan_pool_));
+  }
 }
 
+TabletServiceImpl::~TabletServiceImpl() {}
+
 bool TabletServiceImpl::AuthorizeClientOrServiceUser(const google::protobuf::Message* /*req*/,
                                                  google::protobuf::Message* /*resp*/,
                                                  rpc::RpcContext* rpc) {
@@ -812,6 +1240,42 @@ void TabletServiceAdminImpl::DeleteTablet(const DeleteTabletRequestPB* req,
   context->RespondSuccess();
 }
 
+void TabletServiceAdminImpl::DrainLeaders(const DrainLeadersRequestPB* req,
+                                          DrainLeadersResponsePB* resp,
+                                          rpc::RpcContext* context) {
+  if (!CheckUuidMatchOrRespond(server_->tablet_manager(), "DrainLeaders", req, resp, context)) {
+    return;
+  }
+  LOG(INFO) << "Received DrainLeaders RPC from " << context->requestor_string();
+
+  vector<scoped_refptr<TabletReplica>> replicas;
+  server_->tablet_manager()->GetTabletReplicas(&replicas);
+  int num_leaders = 0;
+  int num_transfers_started = 0;
+  for (const auto& replica : replicas) {
+    if (replica->state() != tablet::RUNNING) continue;
+    shared_ptr<RaftConsensus> consensus = replica->shared_consensus();
+    if (!consensus || consensus->role() != RaftPeerPB::LEADER) continue;
+    num_leaders++;
+    if (consensus->leader_transfer_in_progress()) continue;
+
+    LeaderStepDownResponsePB step_down_resp;
+    Status s = consensus->TransferLeadership(boost::none, &step_down_resp);
+    if (s.ok() && step_down_resp.has_error()) {
+      s = StatusFromPB(step_down_resp.error().status());
+    }
+    if (s.ok()) {
+      num_transfers_started++;
+    } else {
+      LOG(WARNING) << "T " << replica->tablet_id()
+                   << ": unable to start leadership transfer: " << s.ToString();
+    }
+  }
+  resp->set_num_leaders(num_leaders);
+  resp->set_num_transfers_started(num_transfers_started);
+  context->RespondSuccess();
+}
+
 void TabletServiceImpl::Write(const WriteRequestPB* req,
                               WriteResponsePB* resp,
                               rpc::RpcContext* context) {
@@ -819,11 +1283,18 @@ void TabletServiceImpl::Write(const WriteRequestPB* req,
                "tablet_id", req->tablet_id());
   DVLOG(3) << "Received Write RPC: " << SecureDebugString(*req);
 
+  WriteResponsePB::LoadHintPB* load_hint = resp->mutable_load_hint();
+  load_hint->set_queue_time_us((MonoTime::Now() - context->GetTimeReceived()).ToMicroseconds());
+  load_hint->set_memory_pressure(process_memory::UnderMemoryPressure(nullptr));
+
   scoped_refptr<TabletReplica> replica;
   if (!LookupRunningTabletReplicaOrRespond(server_->tablet_manager(), req->tablet_id(), resp,
                                            context, &replica)) {
     return;
   }
+  if (request_capture_->ShouldCapture()) {
+    request_capture_->CaptureWrite(*replica.get(), *req, context->GetTimeReceived());
+  }
 
   shared_ptr<Tablet> tablet;
   TabletServerErrorPB::Code error_code;
@@ -835,6 +1306,17 @@ void TabletServiceImpl::Write(const WriteRequestPB* req,
 
   uint64_t bytes = req->row_operations().rows().size() +
       req->row_operations().indirect_data().size();
+  if (quota_manager_->enabled() &&
+      !quota_manager_->AdmitWrite(replica->tablet_metadata()->table_name(),
+                                  context->remote_user().username(),
+                                  bytes, MonoTime::Now())) {
+    SetupErrorAndRespond(resp->mutable_error(),
+                         Status::ServiceUnavailable("Rejecting Write request: over quota"),
+                         TabletServerErrorPB::THROTTLED,
+                         context);
+    return;
+  }
+  // Only charge the tablet's throttler for writes admitted by the quotas.
   if (!tablet->ShouldThrottleAllow(bytes)) {
     SetupErrorAndRespond(resp->mutable_error(),
                          Status::ServiceUnavailable("Rejecting Write request: throttled"),
@@ -862,6 +1344,42 @@ void TabletServiceImpl::Write(const WriteRequestPB* req,
     return;
   }
 
+  // Slow down writes to a tablet past its own soft memory limit, giving its
+  // flushes a chance to catch up. The delay is timed by a reactor so as not to
+  // hold up a service thread, but the write is resumed on the prepare pool of
+  // the tablet: submitting it takes the consensus lock, and reactor threads
+  // must not wait.
+  int32_t delay_ms = ComputeWriteDelayMs(*tablet);
+  if (delay_ms > 0) {
+    tablet->metrics()->leader_memory_pressure_delays->Increment();
+    load_hint->set_write_delay_ms(delay_ms);
+    TRACE(Substitute("Delaying write by $0 ms: tablet past its soft memory limit", delay_ms));
+    ThreadPool* pool = server_->tablet_prepare_pool(replica->tablet_id());
+    server_->messenger()->ScheduleOnReactor(
+        [this, pool, replica, req, resp, context](const Status& s) {
+          Status submit_status = s;
+          if (PREDICT_TRUE(submit_status.ok())) {
+            submit_status = pool->SubmitFunc([this, replica, req, resp, context]() {
+                SubmitWrite(replica, req, resp, context);
+              });
+          }
+          if (PREDICT_FALSE(!submit_status.ok())) {
+            SetupErrorAndRespond(resp->mutable_error(), submit_status,
+                                 TabletServerErrorPB::UNKNOWN_ERROR,
+                                 context);
+          }
+        },
+        MonoDelta::FromMilliseconds(delay_ms));
+    return;
+  }
+
+  SubmitWrite(replica, req, resp, context);
+}
+
+void TabletServiceImpl::SubmitWrite(const scoped_refptr<TabletReplica>& replica,
+                                    const WriteRequestPB* req,
+                                    WriteResponsePB* resp,
+                                    rpc::RpcContext* context) {
   if (!server_->clock()->SupportsExternalConsistencyMode(req->external_consistency_mode())) {
     Status s = Status::NotSupported("The configured clock does not support the"
         " required consistency mode.");
@@ -871,6 +1389,7 @@ void TabletServiceImpl::Write(const WriteRequestPB* req,
     return;
   }
 
+  Status s;
   unique_ptr<WriteTransactionState> tx_state(new WriteTransactionState(
       replica.get(),
       req,
@@ -910,11 +1429,22 @@ ConsensusServiceImpl::ConsensusServiceImpl(ServerBase* server,
     : ConsensusServiceIf(server->metric_entity(), server->result_tracker()),
       server_(server),
       tablet_manager_(tablet_manager) {
+  if (FLAGS_multi_update_consensus_threads > 0) {
+    CHECK_OK(ThreadPoolBuilder("multi-update")
+             .set_max_threads(FLAGS_multi_update_consensus_threads)
+             .Build(&multi_update_pool_));
+  }
 }
 
 ConsensusServiceImpl::~ConsensusServiceImpl() {
 }
 
+void ConsensusServiceImpl::Shutdown() {
+  if (multi_update_pool_) {
+    multi_update_pool_->Shutdown();
+  }
+}
+
 bool ConsensusServiceImpl::AuthorizeServiceUser(const google::protobuf::Message* /*req*/,
                                                 google::protobuf::Message* /*resp*/,
                                                 rpc::RpcContext* rpc) {
@@ -939,6 +1469,14 @@ void ConsensusServiceImpl::UpdateConsensus(const ConsensusRequestPB* req,
   // Submit the update directly to the TabletReplica's RaftConsensus instance.
   shared_ptr<RaftConsensus> consensus;
   if (!GetConsensusOrRespond(replica, resp, context, &consensus)) return;
+  if (req->has_ops_sidecar_idx()) {
+    // The request is modified in place, as RaftConsensus::Update() does too.
+    Status s = ParseOpsFromSidecar(context, const_cast<ConsensusRequestPB*>(req));
+    if (PREDICT_FALSE(!s.ok())) {
+      HandleUnknownError(s, resp, context);
+      return;
+    }
+  }
   Status s = consensus->Update(req, resp);
   if (PREDICT_FALSE(!s.ok())) {
     // Clear the response first, since a partially-filled response could
@@ -954,6 +1492,43 @@ void ConsensusServiceImpl::UpdateConsensus(const ConsensusRequestPB* req,
   context->RespondSuccess();
 }
 
+void ConsensusServiceImpl::MultiUpdateConsensus(const MultiConsensusRequestPB* req,
+                                                MultiConsensusResponsePB* resp,
+                                                rpc::RpcContext* context) {
+  DVLOG(3) << "Received Consensus Multi-Update RPC: " << SecureDebugString(*req);
+  // Handle the requests concurrently: a request waits for any other update of
+  // its replica in progress, which shouldn't hold up the requests to other
+  // replicas.
+  const int num_requests = req->requests_size();
+  for (int i = 0; i < num_requests; i++) {
+    resp->add_responses();
+  }
+  CountDownLatch latch(num_requests);
+  for (int i = 0; i < num_requests; i++) {
+    const ConsensusRequestPB* update_req = &req->requests(i);
+    ConsensusResponsePB* update_resp = resp->mutable_responses(i);
+    auto run_update = [this, update_req, update_resp, &latch]() {
+      TabletServerErrorPB::Code error_code;
+      Status s = UpdateConsensusInBatch(tablet_manager_, *update_req, update_resp, &error_code);
+      if (PREDICT_FALSE(!s.ok())) {
+        // As in UpdateConsensus(), don't leave a partially-filled response.
+        update_resp->Clear();
+        StatusToPB(s, update_resp->mutable_error()->mutable_status());
+        update_resp->mutable_error()->set_code(error_code);
+      }
+      latch.CountDown();
+    };
+    // The last request is handled on this thread, which would otherwise just
+    // wait.
+    if (i == num_requests - 1 || !multi_update_pool_ ||
+        !multi_update_pool_->SubmitFunc(run_update).ok()) {
+      run_update();
+    }
+  }
+  latch.Wait();
+  context->RespondSuccess();
+}
+
 void ConsensusServiceImpl::RequestConsensusVote(const VoteRequestPB* req,
                                                 VoteResponsePB* resp,
                                                 rpc::RpcContext* context) {
@@ -1116,7 +1691,16 @@ void ConsensusServiceImpl::LeaderStepDown(const LeaderStepDownRequestPB* req,
 
   shared_ptr<RaftConsensus> consensus;
   if (!GetConsensusOrRespond(replica, resp, context, &consensus)) return;
-  Status s = consensus->StepDown(resp);
+  Status s;
+  if (req->mode() == consensus::GRACEFUL) {
+    boost::optional<string> new_leader_uuid;
+    if (req->has_new_leader_uuid()) {
+      new_leader_uuid = req->new_leader_uuid();
+    }
+    s = consensus->TransferLeadership(new_leader_uuid, resp);
+  } else {
+    s = consensus->StepDown(resp);
+  }
   if (PREDICT_FALSE(!s.ok())) {
     SetupErrorAndRespond(resp->mutable_error(), s,
                          TabletServerErrorPB::UNKNOWN_ERROR,
@@ -1231,11 +1815,34 @@ void TabletServiceImpl::ScannerKeepAlive(const ScannerKeepAliveRequestPB *req,
 }
 
 namespace {
-void SetResourceMetrics(ResourceMetricsPB* metrics, rpc::RpcContext* context) {
+// Sets the resource metrics from the trace of the request being handled.
+// That is the RPC's trace, or its child trace for one of the scans of a
+// MultiScan RPC.
+void SetResourceMetrics(ResourceMetricsPB* metrics) {
+  Trace* trace = Trace::CurrentTrace();
+  DCHECK(trace);
+  const TraceMetrics& trace_metrics = *trace->metrics();
   metrics->set_cfile_cache_miss_bytes(
-    context->trace()->metrics()->GetMetric(cfile::CFILE_CACHE_MISS_BYTES_METRIC_NAME));
+    trace_metrics.GetMetric(cfile::CFILE_CACHE_MISS_BYTES_METRIC_NAME));
   metrics->set_cfile_cache_hit_bytes(
-    context->trace()->metrics()->GetMetric(cfile::CFILE_CACHE_HIT_BYTES_METRIC_NAME));
+    trace_metrics.GetMetric(cfile::CFILE_CACHE_HIT_BYTES_METRIC_NAME));
+  metrics->set_rows_scanned(trace_metrics.GetMetric(kScanRowsScannedMetricName));
+  metrics->set_rows_returned(trace_metrics.GetMetric(kScanRowsReturnedMetricName));
+  metrics->set_delta_mutations_applied(
+    trace_metrics.GetMetric(tablet::DELTA_MUTATIONS_APPLIED_METRIC_NAME));
+  metrics->set_safe_time_wait_nanos(trace_metrics.GetMetric(kScanSafeTimeWaitNanosMetricName));
+}
+
+// Validates that 'req' either starts a new scan or continues an existing one.
+Status ValidateScanRequest(const ScanRequestPB& req) {
+  // The user must pass a new_scan_request or a scanner ID, but not both.
+  if (PREDICT_FALSE(req.has_scanner_id() && req.has_new_scan_request())) {
+    return Status::InvalidArgument("Must not pass both a scanner_id and new_scan_request");
+  }
+  if (PREDICT_FALSE(!req.has_scanner_id() && !req.has_new_scan_request())) {
+    return Status::InvalidArgument("Must pass either a scanner_id or new_scan_request");
+  }
+  return Status::OK();
 }
 } // anonymous namespace
 
@@ -1243,87 +1850,233 @@ void TabletServiceImpl::Scan(const ScanRequestPB* req,
                              ScanResponsePB* resp,
                              rpc::RpcContext* context) {
   TRACE_EVENT0("tserver", "TabletServiceImpl::Scan");
-  // Validate the request: user must pass a new_scan_request or
-  // a scanner ID, but not both.
-  if (PREDICT_FALSE(req->has_scanner_id() &&
-                    req->has_new_scan_request())) {
-    context->RespondFailure(Status::InvalidArgument(
-                            "Must not pass both a scanner_id and new_scan_request"));
+  Status s = ValidateScanRequest(*req);
+  if (PREDICT_FALSE(!s.ok())) {
+    context->RespondFailure(s);
+    return;
+  }
+
+  TabletServerErrorPB::Code error_code = TabletServerErrorPB::UNKNOWN_ERROR;
+  MonoDelta quota_delay;
+  s = HandleScan(req, resp, context, nullptr, &quota_delay, &error_code);
+  if (PREDICT_FALSE(!s.ok())) {
+    SetupErrorAndRespond(resp->mutable_error(), s, error_code, context);
     return;
   }
+  RespondSuccessAfter(context, quota_delay);
+}
+
+void TabletServiceImpl::MultiScan(const MultiScanRequestPB* req,
+                                  MultiScanResponsePB* resp,
+                                  rpc::RpcContext* context) {
+  TRACE_EVENT1("tserver", "TabletServiceImpl::MultiScan",
+               "num_requests", req->requests_size());
+  for (const ScanRequestPB& scan_req : req->requests()) {
+    Status s = ValidateScanRequest(scan_req);
+    if (PREDICT_FALSE(!s.ok())) {
+      context->RespondFailure(s);
+      return;
+    }
+  }
+
+  // Run the scans concurrently. The sidecars of their results all go to the
+  // same RPC, so they're attached one at a time.
+  const int num_requests = req->requests_size();
+  for (int i = 0; i < num_requests; i++) {
+    resp->add_responses();
+  }
+  std::mutex sidecar_lock;
+  vector<MonoDelta> quota_delays(num_requests);
+  CountDownLatch latch(num_requests);
+  for (int i = 0; i < num_requests; i++) {
+    const ScanRequestPB* scan_req = &req->requests(i);
+    ScanResponsePB* scan_resp = resp->mutable_responses(i);
+    MonoDelta* quota_delay = &quota_delays[i];
+    auto run_scan = [this, i, scan_req, scan_resp, quota_delay, context,
+                     &sidecar_lock, &latch]() {
+      // Each scan gets its own trace so that its resource metrics only
+      // account for it.
+      scoped_refptr<Trace> trace(new Trace());
+      context->trace()->AddChildTrace(Substitute("scan $0", i), trace.get());
+      ADOPT_TRACE(trace.get());
+      TabletServerErrorPB::Code error_code = TabletServerErrorPB::UNKNOWN_ERROR;
+      Status s = HandleScan(scan_req, scan_resp, context, &sidecar_lock, quota_delay,
+                            &error_code);
+      if (PREDICT_FALSE(!s.ok())) {
+        // As in MultiUpdateConsensus(), report the error in the response to
+        // the request which failed, without leaving it partially filled.
+        scan_resp->Clear();
+        StatusToPB(s, scan_resp->mutable_error()->mutable_status());
+        scan_resp->mutable_error()->set_code(error_code);
+      }
+      latch.CountDown();
+    };
+    // The last scan runs on this thread, which would otherwise just wait.
+    if (i == num_requests - 1 || !multi_scan_pool_ ||
+        !multi_scan_pool_->SubmitFunc(run_scan).ok()) {
+      run_scan();
+    }
+  }
+  latch.Wait();
+  // The response is held back for as long as the most delayed of the scans.
+  MonoDelta quota_delay = MonoDelta::FromNanoseconds(0);
+  for (const MonoDelta& d : quota_delays) {
+    quota_delay = std::max(quota_delay, d);
+  }
+  RespondSuccessAfter(context, quota_delay);
+}
+
+void TabletServiceImpl::RespondSuccessAfter(rpc::RpcContext* context, const MonoDelta& delay) {
+  if (delay.ToNanoseconds() <= 0) {
+    context->RespondSuccess();
+    return;
+  }
+  // The response is complete: send it even if the reactor is shutting down.
+  server_->messenger()->ScheduleOnReactor(
+      [context](const Status& /* s */) { context->RespondSuccess(); },
+      delay);
+}
+
+Status TabletServiceImpl::HandleScan(const ScanRequestPB* req,
+                                     ScanResponsePB* resp,
+                                     rpc::RpcContext* context,
+                                     std::mutex* sidecar_lock,
+                                     MonoDelta* quota_delay,
+                                     TabletServerErrorPB::Code* error_code) {
+  DCHECK(ValidateScanRequest(*req).ok());
+  *quota_delay = MonoDelta::FromNanoseconds(0);
+
+  // Time the handling of the request, to report it in the response.
+  Stopwatch scan_sw(Stopwatch::THIS_THREAD);
+  scan_sw.start();
 
   size_t batch_size_bytes = GetMaxBatchSizeBytesHint(req);
   unique_ptr<faststring> rows_data(new faststring(batch_size_bytes * 11 / 10));
   unique_ptr<faststring> indirect_data(new faststring(batch_size_bytes * 11 / 10));
   RowwiseRowBlockPB data;
-  ScanResultCopier collector(&data, rows_data.get(), indirect_data.get());
+  ScanResultCopier copier(&data, rows_data.get(), indirect_data.get());
 
-  bool has_more_results = false;
-  TabletServerErrorPB::Code error_code = TabletServerErrorPB::UNKNOWN_ERROR;
+  // Scans with an aggregation return partial aggregates instead of rows. The
+  // collector has to be picked before the request is handled, so look up the
+  // aggregation of a continued scan here.
+  unique_ptr<ScanResultAggregator> aggregator;
   if (req->has_new_scan_request()) {
-    const NewScanRequestPB& scan_pb = req->new_scan_request();
-    scoped_refptr<TabletReplica> replica;
-    if (!LookupRunningTabletReplicaOrRespond(server_->tablet_manager(), scan_pb.tablet_id(), resp,
-                                             context, &replica)) {
-      return;
+    if (req->new_scan_request().has_aggregation()) {
+      aggregator.reset(new ScanResultAggregator(req->new_scan_request().aggregation()));
     }
-    string scanner_id;
-    Timestamp scan_timestamp;
-    Status s = HandleNewScanRequest(replica.get(), req, context,
-                                    &collector, &scanner_id, &scan_timestamp, &has_more_results,
-                                    &error_code);
-    if (PREDICT_FALSE(!s.ok())) {
-      SetupErrorAndRespond(resp->mutable_error(), s, error_code, context);
-      return;
+  } else {
+    SharedScanner scanner;
+    if (server_->scanner_manager()->LookupScanner(req->scanner_id(), &scanner) &&
+        scanner->aggregation_spec() != nullptr) {
+      aggregator.reset(new ScanResultAggregator(*scanner->aggregation_spec()));
     }
+  }
+  ScanResultCollector* collector = aggregator ?
+      static_cast<ScanResultCollector*>(aggregator.get()) : &copier;
 
-    // Only set the scanner id if we have more results.
-    if (has_more_results) {
-      resp->set_scanner_id(scanner_id);
-    }
-    if (scan_timestamp != Timestamp::kInvalidTimestamp) {
-      resp->set_snap_timestamp(scan_timestamp.ToUint64());
+  bool has_more_results = false;
+  // The key under which the results of the scan are cached, if they can be.
+  faststring cache_key;
+  if (req->has_new_scan_request()) {
+    const NewScanRequestPB& scan_pb = req->new_scan_request();
+    scoped_refptr<TabletReplica> replica;
+    RETURN_NOT_OK(LookupRunningTabletReplica(server_->tablet_manager(), scan_pb.tablet_id(),
+                                             &replica, error_code));
+    if (request_capture_->ShouldCapture()) {
+      request_capture_->CaptureScan(*replica.get(), scan_pb, context->GetTimeReceived());
     }
-  } else if (req->has_scanner_id()) {
-    Status s = HandleContinueScanRequest(req, &collector, &has_more_results, &error_code);
-    if (PREDICT_FALSE(!s.ok())) {
-      SetupErrorAndRespond(resp->mutable_error(), s, error_code, context);
-      return;
+    if (IsLiveRowCountScan(scan_pb)) {
+      // Counting the rows needs neither a scanner nor the result cache.
+      RETURN_NOT_OK(CheckNotWitness(replica.get(), error_code));
+      shared_ptr<Tablet> tablet;
+      RETURN_NOT_OK(GetTabletRef(replica, &tablet, error_code));
+      uint64_t count;
+      RETURN_NOT_OK(tablet->CountLiveRows(&count));
+      TRACE("Counted $0 live rows without scanning", count);
+      aggregator->SetRowCount(count);
+    } else {
+      if (scan_result_cache_ && batch_size_bytes > 0 &&
+          ScanResultCache::EncodeKey(scan_pb, replica->tablet_metadata()->schema_version(),
+                                     &cache_key) &&
+          ScanFromResultCache(req, cache_key, replica.get(), resp, context, sidecar_lock)) {
+        return Status::OK();
+      }
+      string scanner_id;
+      Timestamp scan_timestamp;
+      RETURN_NOT_OK(HandleNewScanRequest(replica.get(), req, context,
+                                         collector, &scanner_id, &scan_timestamp,
+                                         &has_more_results, error_code));
+
+      // Only set the scanner id if we have more results.
+      if (has_more_results) {
+        resp->set_scanner_id(scanner_id);
+      }
+      if (scan_timestamp != Timestamp::kInvalidTimestamp) {
+        resp->set_snap_timestamp(scan_timestamp.ToUint64());
+      }
     }
   } else {
-    context->RespondFailure(Status::InvalidArgument(
-                              "Must pass either a scanner_id or new_scan_request"));
-    return;
+    RETURN_NOT_OK(HandleContinueScanRequest(req, collector, &has_more_results, error_code));
   }
   resp->set_has_more_results(has_more_results);
 
-  resp->mutable_data()->CopyFrom(data);
-
-  // Add sidecar data to context and record the returned indices.
-  int rows_idx;
-  CHECK_OK(context->AddOutboundSidecar(
-      RpcSidecar::FromFaststring((std::move(rows_data))), &rows_idx));
-  resp->mutable_data()->set_rows_sidecar(rows_idx);
-
-  // Add indirect data as a sidecar, if applicable.
-  if (indirect_data->size() > 0) {
-    int indirect_idx;
-    CHECK_OK(context->AddOutboundSidecar(
-        RpcSidecar::FromFaststring(std::move(indirect_data)), &indirect_idx));
-    resp->mutable_data()->set_indirect_data_sidecar(indirect_idx);
-  }
-
   // Set the last row found by the collector.
   //
   // We could have an empty batch if all the remaining rows are filtered by the
   // predicate, in which case do not set the last row.
-  const faststring& last = collector.last_primary_key();
+  const faststring& last = collector->last_primary_key();
   if (last.length() > 0) {
     resp->set_last_primary_key(last.ToString());
   }
+
+  std::unique_lock<std::mutex> l;
+  if (sidecar_lock) {
+    l = std::unique_lock<std::mutex>(*sidecar_lock);
+  }
+  // Only cache the results of scans which completed in this response.
+  bool cache_results = cache_key.length() > 0 && !has_more_results;
+  if (aggregator) {
+    aggregator->TakeResults(resp->mutable_aggregate_groups());
+    if (cache_results) {
+      scan_result_cache_->Insert(cache_key, *resp, Slice(), Slice());
+    }
+  } else if (copier.columnar_layout()) {
+    copier.SetupColumnarResponse(context, resp->mutable_columnar_data());
+  } else {
+    resp->mutable_data()->CopyFrom(data);
+    if (cache_results) {
+      scan_result_cache_->Insert(cache_key, *resp, *rows_data, *indirect_data);
+    }
+
+    // Add sidecar data to context and record the returned indices.
+    int rows_idx;
+    CHECK_OK(context->AddOutboundSidecar(
+        RpcSidecar::FromFaststring((std::move(rows_data))), &rows_idx));
+    resp->mutable_data()->set_rows_sidecar(rows_idx);
+
+    // Add indirect data as a sidecar, if applicable.
+    if (indirect_data->size() > 0) {
+      int indirect_idx;
+      CHECK_OK(context->AddOutboundSidecar(
+          RpcSidecar::FromFaststring(std::move(indirect_data)), &indirect_idx));
+      resp->mutable_data()->set_indirect_data_sidecar(indirect_idx);
+    }
+  }
+  if (l.owns_lock()) {
+    l.unlock();
+  }
+
   resp->set_propagated_timestamp(server_->clock()->Now().ToUint64());
-  SetResourceMetrics(resp->mutable_resource_metrics(), context);
-  context->RespondSuccess();
+  scan_sw.stop();
+  const CpuTimes scan_times = scan_sw.elapsed();
+  resp->set_scan_wall_time_us(scan_times.wall / 1000);
+  resp->set_scan_cpu_time_us((scan_times.user + scan_times.system) / 1000);
+  ResourceMetricsPB* resource_metrics = resp->mutable_resource_metrics();
+  SetResourceMetrics(resource_metrics);
+  resource_metrics->set_cpu_user_nanos(scan_times.user);
+  resource_metrics->set_cpu_system_nanos(scan_times.system);
+  *quota_delay = collector->quota_delay();
+  return Status::OK();
 }
 
 void TabletServiceImpl::ListTablets(const ListTabletsRequestPB* req,
@@ -1341,6 +2094,12 @@ void TabletServiceImpl::ListTablets(const ListTabletsRequestPB* req,
                           status->mutable_schema()));
       replica->tablet_metadata()->partition_schema().ToPB(status->mutable_partition_schema());
     }
+    if (req->need_hot_keys()) {
+      shared_ptr<Tablet> tablet = replica->shared_tablet();
+      if (tablet) {
+        tablet->GetHotKeys(req->max_hot_keys(), status->mutable_hot_keys());
+      }
+    }
   }
   context->RespondSuccess();
 }
@@ -1365,7 +2124,7 @@ void TabletServiceImpl::Checksum(const ChecksumRequestPB* req,
   if (req->has_batch_size_bytes()) scan_req.set_batch_size_bytes(req->batch_size_bytes());
   if (req->has_close_scanner()) scan_req.set_close_scanner(req->close_scanner());
 
-  ScanResultChecksummer collector;
+  ScanResultChecksummer collector(req->algorithm());
   bool has_more = false;
   TabletServerErrorPB::Code error_code;
   if (req->has_new_request()) {
@@ -1406,9 +2165,206 @@ void TabletServiceImpl::Checksum(const ChecksumRequestPB* req,
   }
 
   resp->set_checksum(collector.agg_checksum());
+  resp->set_algorithm(req->algorithm());
   resp->set_has_more_results(has_more);
-  SetResourceMetrics(resp->mutable_resource_metrics(), context);
+  SetResourceMetrics(resp->mutable_resource_metrics());
   resp->set_rows_checksummed(collector.rows_checksummed());
+  RespondSuccessAfter(context, collector.quota_delay());
+}
+
+void TabletServiceImpl::GetColumnStatistics(const GetColumnStatisticsRequestPB* req,
+                                            GetColumnStatisticsResponsePB* resp,
+                                            rpc::RpcContext* context) {
+  scoped_refptr<TabletReplica> replica;
+  if (!LookupRunningTabletReplicaOrRespond(server_->tablet_manager(), req->tablet_id(), resp,
+                                           context, &replica)) {
+    return;
+  }
+
+  shared_ptr<Tablet> tablet;
+  TabletServerErrorPB::Code error_code;
+  Status s = GetTabletRef(replica, &tablet, &error_code);
+  if (PREDICT_FALSE(!s.ok())) {
+    SetupErrorAndRespond(resp->mutable_error(), s, error_code, context);
+    return;
+  }
+
+  vector<string> column_names(req->column_names().begin(), req->column_names().end());
+  if (column_names.empty()) {
+    for (const ColumnSchema& col : tablet->schema()->columns()) {
+      column_names.push_back(col.name());
+    }
+  }
+
+  for (const string& name : column_names) {
+    GetColumnStatisticsResponsePB::ColumnStatistics* col = resp->add_columns();
+    col->set_column_name(name);
+    int num_rowsets;
+    int num_rowsets_with_stats;
+    s = tablet->GetColumnStatistics(name, col->mutable_statistics(),
+                                    &num_rowsets, &num_rowsets_with_stats);
+    if (PREDICT_FALSE(!s.ok())) {
+      resp->clear_columns();
+      SetupErrorAndRespond(resp->mutable_error(), s,
+                           s.IsNotFound() ? TabletServerErrorPB::INVALID_SCHEMA
+                                          : TabletServerErrorPB::UNKNOWN_ERROR,
+                           context);
+      return;
+    }
+    col->set_num_rowsets(num_rowsets);
+    col->set_num_rowsets_with_stats(num_rowsets_with_stats);
+    uint64_t estimate;
+    if (cfile::EstimateDistinctValues(col->statistics(), &estimate).ok()) {
+      col->set_distinct_values_estimate(estimate);
+    }
+  }
+  context->RespondSuccess();
+}
+
+void TabletServiceImpl::CountLiveRows(const CountLiveRowsRequestPB* req,
+                                      CountLiveRowsResponsePB* resp,
+                                      rpc::RpcContext* context) {
+  scoped_refptr<TabletReplica> replica;
+  if (!LookupRunningTabletReplicaOrRespond(server_->tablet_manager(), req->tablet_id(), resp,
+                                           context, &replica)) {
+    return;
+  }
+
+  shared_ptr<Tablet> tablet;
+  TabletServerErrorPB::Code error_code;
+  Status s = GetTabletRef(replica, &tablet, &error_code);
+  if (PREDICT_FALSE(!s.ok())) {
+    SetupErrorAndRespond(resp->mutable_error(), s, error_code, context);
+    return;
+  }
+
+  uint64_t count;
+  s = tablet->CountLiveRows(&count);
+  if (PREDICT_FALSE(!s.ok())) {
+    SetupErrorAndRespond(resp->mutable_error(), s,
+                         TabletServerErrorPB::UNKNOWN_ERROR, context);
+    return;
+  }
+  resp->set_live_row_count(count);
+  context->RespondSuccess();
+}
+
+void TabletServiceImpl::SplitKeyRange(const SplitKeyRangeRequestPB* req,
+                                      SplitKeyRangeResponsePB* resp,
+                                      rpc::RpcContext* context) {
+  scoped_refptr<TabletReplica> replica;
+  if (!LookupRunningTabletReplicaOrRespond(server_->tablet_manager(), req->tablet_id(), resp,
+                                           context, &replica)) {
+    return;
+  }
+
+  shared_ptr<Tablet> tablet;
+  TabletServerErrorPB::Code error_code;
+  Status s = GetTabletRef(replica, &tablet, &error_code);
+  if (PREDICT_FALSE(!s.ok())) {
+    SetupErrorAndRespond(resp->mutable_error(), s, error_code, context);
+    return;
+  }
+
+  vector<string> split_keys;
+  vector<uint64_t> chunk_sizes;
+  s = tablet->SplitKeyRange(req->start_primary_key(), req->stop_primary_key(),
+                            req->target_chunk_size_bytes(), &split_keys, &chunk_sizes);
+  if (PREDICT_FALSE(!s.ok())) {
+    SetupErrorAndRespond(resp->mutable_error(), s, TabletServerErrorPB::UNKNOWN_ERROR, context);
+    return;
+  }
+  for (string& key : split_keys) {
+    resp->add_split_primary_keys()->swap(key);
+  }
+  for (uint64_t size : chunk_sizes) {
+    resp->add_chunk_sizes_bytes(size);
+  }
+  context->RespondSuccess();
+}
+
+void TabletServiceImpl::Get(const GetRequestPB* req,
+                            GetResponsePB* resp,
+                            rpc::RpcContext* context) {
+  TRACE_EVENT1("tserver", "TabletServiceImpl::Get",
+               "tablet_id", req->tablet_id());
+  scoped_refptr<TabletReplica> replica;
+  if (!LookupRunningTabletReplicaOrRespond(server_->tablet_manager(), req->tablet_id(), resp,
+                                           context, &replica)) {
+    return;
+  }
+
+  shared_ptr<Tablet> tablet;
+  TabletServerErrorPB::Code error_code;
+  Status s = GetTabletRef(replica, &tablet, &error_code);
+  if (PREDICT_FALSE(!s.ok())) {
+    SetupErrorAndRespond(resp->mutable_error(), s, error_code, context);
+    return;
+  }
+
+  shared_ptr<const Schema> projection_ptr;
+  string projection_signature;
+  s = ResolveClientProjection(*tablet, req->projected_columns(), &projection_ptr,
+                              &projection_signature);
+  if (PREDICT_FALSE(!s.ok())) {
+    SetupErrorAndRespond(resp->mutable_error(), s, TabletServerErrorPB::INVALID_SCHEMA, context);
+    return;
+  }
+
+  if (req->has_propagated_timestamp()) {
+    s = server_->clock()->Update(Timestamp(req->propagated_timestamp()));
+    if (PREDICT_FALSE(!s.ok())) {
+      SetupErrorAndRespond(resp->mutable_error(), s, TabletServerErrorPB::UNKNOWN_ERROR, context);
+      return;
+    }
+  }
+
+  // Decode the keys into rows of the key schema.
+  const Schema& key_schema = tablet->key_schema();
+  Arena arena(32 * 1024);
+  vector<ConstContiguousRow> keys;
+  keys.reserve(req->primary_keys_size());
+  for (const string& encoded : req->primary_keys()) {
+    uint8_t* row_data = static_cast<uint8_t*>(arena.AllocateBytes(key_schema.key_byte_size()));
+    s = key_schema.DecodeRowKey(encoded, row_data, &arena);
+    if (PREDICT_FALSE(!s.ok())) {
+      SetupErrorAndRespond(resp->mutable_error(), s.CloneAndPrepend("Invalid primary key"),
+                           TabletServerErrorPB::UNKNOWN_ERROR, context);
+      return;
+    }
+    keys.emplace_back(&key_schema, row_data);
+  }
+
+  const Schema& projection = *projection_ptr;
+  RowBlock block(projection, keys.size(), &arena);
+  s = tablet->GetRows(projection, keys, &block);
+  if (PREDICT_FALSE(!s.ok())) {
+    SetupErrorAndRespond(resp->mutable_error(), s,
+                         s.IsInvalidArgument() ? TabletServerErrorPB::INVALID_SCHEMA
+                                               : TabletServerErrorPB::UNKNOWN_ERROR,
+                         context);
+    return;
+  }
+  for (size_t i = 0; i < block.nrows(); i++) {
+    resp->add_found(block.selection_vector()->IsRowSelected(i));
+  }
+
+  unique_ptr<faststring> rows_data(new faststring());
+  unique_ptr<faststring> indirect_data(new faststring());
+  SerializeRowBlock(block, resp->mutable_data(), &projection,
+                    rows_data.get(), indirect_data.get(),
+                    req->row_format_flags() & RowFormatFlags::PAD_UNIX_TIME_MICROS_TO_16_BYTES);
+  int rows_idx;
+  CHECK_OK(context->AddOutboundSidecar(
+      RpcSidecar::FromFaststring(std::move(rows_data)), &rows_idx));
+  resp->mutable_data()->set_rows_sidecar(rows_idx);
+  if (indirect_data->size() > 0) {
+    int indirect_idx;
+    CHECK_OK(context->AddOutboundSidecar(
+        RpcSidecar::FromFaststring(std::move(indirect_data)), &indirect_idx));
+    resp->mutable_data()->set_indirect_data_sidecar(indirect_idx);
+  }
+  resp->set_propagated_timestamp(server_->clock()->Now().ToUint64());
   context->RespondSuccess();
 }
 
@@ -1416,6 +2372,7 @@ bool TabletServiceImpl::SupportsFeature(uint32_t feature) const {
   switch (feature) {
     case TabletServerFeatures::COLUMN_PREDICATES:
     case TabletServerFeatures::PAD_UNIXTIME_MICROS_TO_16_BYTES:
+    case TabletServerFeatures::COLUMNAR_LAYOUT_FEATURE:
       return true;
     default:
       return false;
@@ -1423,6 +2380,9 @@ bool TabletServiceImpl::SupportsFeature(uint32_t feature) const {
 }
 
 void TabletServiceImpl::Shutdown() {
+  if (multi_scan_pool_) {
+    multi_scan_pool_->Shutdown();
+  }
 }
 
 // Extract a void* pointer suitable for use in a ColumnRangePredicate from the
@@ -1582,6 +2542,17 @@ static Status SetupScanSpec(const NewScanRequestPB& scan_pb,
       }
     }
   }
+  // The tablet filters out rows which outlived the table's time-to-live, for
+  // which it needs the time-to-live column.
+  int ttl_col_idx = tablet_schema.find_ttl_column();
+  if (ttl_col_idx != Schema::kColumnNotFound) {
+    const ColumnSchema& col = tablet_schema.column(ttl_col_idx);
+    if (projection.find_column(col.name()) == Schema::kColumnNotFound &&
+        !ContainsKey(missing_col_names, col.name())) {
+      missing_cols->push_back(col);
+      InsertOrDie(&missing_col_names, col.name());
+    }
+  }
   // Then any encoded key range predicates.
   RETURN_NOT_OK(DecodeEncodedKeyRange(scan_pb, tablet_schema, scanner, ret.get()));
 
@@ -1590,6 +2561,16 @@ static Status SetupScanSpec(const NewScanRequestPB& scan_pb,
 }
 
 namespace {
+// Returns the arena in which the calling thread materializes the rows of the
+// scans it handles.
+Arena* GetScanArena() {
+  // Disable leak check. LSAN sometimes gets false positives on thread locals.
+  // See: https://github.com/google/sanitizers/issues/757
+  debug::ScopedLeakCheckDisabler d;
+  BLOCK_STATIC_THREAD_LOCAL(Arena, arena, 32 * 1024);
+  return arena;
+}
+
 // Checks if 'timestamp' is before the 'tablet's AHM if this is a READ_AT_SNAPSHOT scan.
 // Returns Status::OK() if it's not or Status::InvalidArgument() if it is.
 Status VerifyNotAncientHistory(Tablet* tablet, ReadMode read_mode, Timestamp timestamp) {
@@ -1607,8 +2588,104 @@ Status VerifyNotAncientHistory(Tablet* tablet, ReadMode read_mode, Timestamp tim
   }
   return Status::OK();
 }
+
+// Checks that 'aggregation' applies to the client's 'projection' and only
+// groups rows by a prefix of the primary key columns of 'tablet_schema'.
+Status ValidateAggregation(const AggregationSpecPB& aggregation,
+                           const Schema& tablet_schema,
+                           const Schema& projection) {
+  int group_by_len = aggregation.group_by_key_prefix_len();
+  if (group_by_len > tablet_schema.num_key_columns()) {
+    return Status::InvalidArgument(Substitute(
+        "cannot group by $0 columns: the primary key has $1 columns",
+        group_by_len, tablet_schema.num_key_columns()));
+  }
+  for (int i = 0; i < group_by_len && i < projection.num_columns(); i++) {
+    if (projection.column(i).name() != tablet_schema.column(i).name()) {
+      return Status::InvalidArgument(Substitute(
+          "group-by column $0 must be primary key column $1", i,
+          tablet_schema.column(i).name()));
+    }
+  }
+  unique_ptr<ScanAggregator> aggregator;
+  return ScanAggregator::Create(aggregation, projection, &aggregator);
+}
+
+// Deselects all but the first 'max_rows' selected rows of 'sel', so that a
+// scan stops returning rows once it reaches its limit. Returns the number of
+// rows which remain selected.
+int64_t LimitSelectedRows(int64_t max_rows, SelectionVector* sel) {
+  int64_t num_selected = sel->CountSelected();
+  if (num_selected <= max_rows) {
+    return num_selected;
+  }
+  int64_t num_kept = 0;
+  for (size_t i = 0; i < sel->nrows(); i++) {
+    if (!sel->IsRowSelected(i)) continue;
+    if (num_kept < max_rows) {
+      num_kept++;
+    } else {
+      sel->SetRowUnselected(i);
+    }
+  }
+  return num_kept;
+}
 } // anonymous namespace
 
+bool TabletServiceImpl::ScanFromResultCache(const ScanRequestPB* req,
+                                            const faststring& cache_key,
+                                            TabletReplica* replica,
+                                            ScanResponsePB* resp,
+                                            rpc::RpcContext* context,
+                                            std::mutex* sidecar_lock) {
+  DCHECK(scan_result_cache_);
+  const NewScanRequestPB& scan_pb = req->new_scan_request();
+  unique_ptr<faststring> rows_data(new faststring());
+  unique_ptr<faststring> indirect_data(new faststring());
+  if (!scan_result_cache_->Lookup(cache_key, resp, rows_data.get(), indirect_data.get())) {
+    return false;
+  }
+  TRACE("Found scan results in the cache");
+
+  // Perform the checks of a scan at the cached snapshot which don't depend on
+  // the data: the snapshot may have fallen behind the ancient history mark
+  // since the results were cached.
+  Status s;
+  if (scan_pb.has_propagated_timestamp()) {
+    s = server_->clock()->Update(Timestamp(scan_pb.propagated_timestamp()));
+  }
+  if (s.ok()) {
+    s = VerifyNotAncientHistory(replica->tablet(), READ_AT_SNAPSHOT,
+                                Timestamp(scan_pb.snap_timestamp()));
+  }
+  if (PREDICT_FALSE(!s.ok())) {
+    // Let the scan itself report the error.
+    resp->Clear();
+    return false;
+  }
+
+  resp->set_has_more_results(false);
+  if (resp->has_data()) {
+    std::unique_lock<std::mutex> l;
+    if (sidecar_lock) {
+      l = std::unique_lock<std::mutex>(*sidecar_lock);
+    }
+    int rows_idx;
+    CHECK_OK(context->AddOutboundSidecar(
+        RpcSidecar::FromFaststring(std::move(rows_data)), &rows_idx));
+    resp->mutable_data()->set_rows_sidecar(rows_idx);
+    if (indirect_data->size() > 0) {
+      int indirect_idx;
+      CHECK_OK(context->AddOutboundSidecar(
+          RpcSidecar::FromFaststring(std::move(indirect_data)), &indirect_idx));
+      resp->mutable_data()->set_indirect_data_sidecar(indirect_idx);
+    }
+  }
+  resp->set_propagated_timestamp(server_->clock()->Now().ToUint64());
+  SetResourceMetrics(resp->mutable_resource_metrics());
+  return true;
+}
+
 // Start a new scan.
 Status TabletServiceImpl::HandleNewScanRequest(TabletReplica* replica,
                                                const ScanRequestPB* req,
@@ -1625,30 +2702,49 @@ Status TabletServiceImpl::HandleNewScanRequest(TabletReplica* replica,
   TRACE_EVENT1("tserver", "TabletServiceImpl::HandleNewScanRequest",
                "tablet_id", scan_pb.tablet_id());
 
+  RETURN_NOT_OK(CheckNotWitness(replica, error_code));
+
   const Schema& tablet_schema = replica->tablet_metadata()->schema();
 
+  // The scanner is only registered with the scanner manager once it's known
+  // that the client will need to continue the scan, so there's nothing to
+  // unregister if we early-exit out of this function.
   SharedScanner scanner;
-  server_->scanner_manager()->NewScanner(replica,
-                                         rpc_context->requestor_string(),
-                                         scan_pb.row_format_flags(),
-                                         &scanner);
+  server_->scanner_manager()->CreateScanner(replica,
+                                            rpc_context->requestor_string(),
+                                            scan_pb.row_format_flags(),
+                                            &scanner);
+  scanner->set_scheduler_key(FLAGS_scan_scheduler_share_key == "user" ?
+                             rpc_context->remote_user().username() :
+                             replica->tablet_metadata()->table_name());
+  scanner->set_username(rpc_context->remote_user().username());
 
-  // If we early-exit out of this function, automatically unregister
-  // the scanner.
-  ScopedUnregisterScanner unreg_scanner(server_->scanner_manager(), scanner->id());
+  shared_ptr<Tablet> tablet;
+  RETURN_NOT_OK(GetTabletRef(replica, &tablet, error_code));
 
-  // Create the user's requested projection.
+  // Create the user's requested projection, or share that of a previous scan
+  // with the same projection.
   // TODO: add test cases for bad projections including 0 columns
-  Schema projection;
-  Status s = ColumnPBsToSchema(scan_pb.projected_columns(), &projection);
+  shared_ptr<const Schema> client_projection;
+  string client_projection_signature;
+  Status s = ResolveClientProjection(*tablet, scan_pb.projected_columns(), &client_projection,
+                                     &client_projection_signature);
   if (PREDICT_FALSE(!s.ok())) {
     *error_code = TabletServerErrorPB::INVALID_SCHEMA;
     return s;
   }
+  const Schema& projection = *client_projection;
 
-  if (projection.has_column_ids()) {
-    *error_code = TabletServerErrorPB::INVALID_SCHEMA;
-    return Status::InvalidArgument("User requests should not have Column IDs");
+  if (scan_pb.has_aggregation()) {
+    if (scan_pb.has_limit()) {
+      *error_code = TabletServerErrorPB::INVALID_SCAN_SPEC;
+      return Status::InvalidArgument("Cannot limit the number of rows of an aggregation");
+    }
+    s = ValidateAggregation(scan_pb.aggregation(), tablet_schema, projection);
+    if (PREDICT_FALSE(!s.ok())) {
+      *error_code = TabletServerErrorPB::INVALID_SCAN_SPEC;
+      return s;
+    }
   }
 
   if (scan_pb.order_mode() == ORDERED) {
@@ -1676,34 +2772,30 @@ Status TabletServiceImpl::HandleNewScanRequest(TabletReplica* replica,
   spec->OptimizeScan(tablet_schema, scanner->arena(), scanner->autorelease_pool(), true);
   VLOG(3) << "After optimizing scan spec: " << spec->ToString(tablet_schema);
 
-  if (spec->CanShortCircuit()) {
+  if (spec->CanShortCircuit() || (scan_pb.has_limit() && scan_pb.limit() == 0)) {
     VLOG(1) << "short-circuiting without creating a server-side scanner.";
     *has_more_results = false;
     return Status::OK();
   }
 
   // Store the original projection.
-  gscoped_ptr<Schema> orig_projection(new Schema(projection));
-  scanner->set_client_projection_schema(std::move(orig_projection));
-
-  // Build a new projection with the projection columns and the missing columns. Make
-  // sure to set whether the column is a key column appropriately.
-  SchemaBuilder projection_builder;
-  vector<ColumnSchema> projection_columns = projection.columns();
-  for (const ColumnSchema& col : missing_cols) {
-    projection_columns.push_back(col);
+  scanner->set_client_projection_schema(client_projection);
+  if (scan_pb.has_aggregation()) {
+    scanner->set_aggregation_spec(
+        gscoped_ptr<AggregationSpecPB>(new AggregationSpecPB(scan_pb.aggregation())));
   }
-  for (const ColumnSchema& col : projection_columns) {
-    CHECK_OK(projection_builder.AddColumn(col, tablet_schema.is_key_column(col.name())));
+  if (scan_pb.has_limit()) {
+    scanner->set_limit(std::min<uint64_t>(scan_pb.limit(), std::numeric_limits<int64_t>::max()));
   }
-  projection = projection_builder.BuildWithoutIds();
+
+  shared_ptr<const Schema> scan_projection;
+  ResolveScanProjection(*tablet, projection, client_projection_signature, missing_cols,
+                        &scan_projection);
 
   gscoped_ptr<RowwiseIterator> iter;
   // Preset the error code for when creating the iterator on the tablet fails
   TabletServerErrorPB::Code tmp_error_code = TabletServerErrorPB::MISMATCHED_SCHEMA;
 
-  shared_ptr<Tablet> tablet;
-  RETURN_NOT_OK(GetTabletRef(replica, &tablet, error_code));
   {
     TRACE("Creating iterator");
     TRACE_EVENT0("tserver", "Create iterator");
@@ -1715,11 +2807,11 @@ Status TabletServiceImpl::HandleNewScanRequest(TabletReplica* replica,
         return s;
       }
       case READ_LATEST: {
-        s = tablet->NewRowIterator(projection, &iter);
+        s = tablet->NewRowIterator(*scan_projection, &iter, server_->scan_pool());
         break;
       }
       case READ_AT_SNAPSHOT: {
-        s = HandleScanAtSnapshot(scan_pb, rpc_context, projection, replica,
+        s = HandleScanAtSnapshot(scan_pb, rpc_context, *scan_projection, replica,
                                  &iter, snap_timestamp);
         // If we got a Status::ServiceUnavailable() from HandleScanAtSnapshot() it might
         // mean we're just behind so let the client try again.
@@ -1805,25 +2897,24 @@ Status TabletServiceImpl::HandleNewScanRequest(TabletReplica* replica,
   }
 
   scanner->Init(std::move(iter), std::move(orig_spec));
-  unreg_scanner.Cancel();
-  *scanner_id = scanner->id();
-
-  VLOG(1) << "Started scanner " << scanner->id() << ": " << scanner->iter()->ToString();
 
   size_t batch_size_bytes = GetMaxBatchSizeBytesHint(req);
   if (batch_size_bytes > 0) {
     TRACE("Continuing scan request");
-    // TODO: instead of copying the pb, instead split HandleContinueScanRequest
-    // and call the second half directly
-    ScanRequestPB continue_req(*req);
-    continue_req.set_scanner_id(scanner->id());
-    RETURN_NOT_OK(HandleContinueScanRequest(&continue_req, result_collector, has_more_results,
-                                            error_code));
+    RETURN_NOT_OK(ContinueScan(scanner, req, result_collector, has_more_results, error_code));
   } else {
-    // Increment the scanner call sequence ID. HandleContinueScanRequest handles
-    // this in the non-empty scan case.
+    // Increment the scanner call sequence ID. ContinueScan() handles this in
+    // the non-empty scan case.
     scanner->IncrementCallSeqId();
   }
+
+  // A scan which returned all of its results in this first batch is never
+  // continued, so its scanner needn't be registered.
+  if (*has_more_results) {
+    server_->scanner_manager()->RegisterScanner(scanner);
+    *scanner_id = scanner->id();
+    VLOG(1) << "Started scanner " << scanner->id() << ": " << scanner->iter()->ToString();
+  }
   return Status::OK();
 }
 
@@ -1852,9 +2943,6 @@ Status TabletServiceImpl::HandleContinueScanRequest(const ScanRequestPB* req,
     }
   }
 
-  // Set the row format flags on the ScanResultCollector.
-  result_collector->set_row_format_flags(scanner->row_format_flags());
-
   // If we early-exit out of this function, automatically unregister the scanner.
   ScopedUnregisterScanner unreg_scanner(server_->scanner_manager(), scanner->id());
 
@@ -1867,6 +2955,25 @@ Status TabletServiceImpl::HandleContinueScanRequest(const ScanRequestPB* req,
     return Status::OK();
   }
 
+  RETURN_NOT_OK(ContinueScan(scanner, req, result_collector, has_more_results, error_code));
+  if (*has_more_results) {
+    unreg_scanner.Cancel();
+  } else {
+    VLOG(2) << "Scanner " << scanner->id() << " complete: removing...";
+  }
+  return Status::OK();
+}
+
+Status TabletServiceImpl::ContinueScan(const SharedScanner& scanner,
+                                       const ScanRequestPB* req,
+                                       ScanResultCollector* result_collector,
+                                       bool* has_more_results,
+                                       TabletServerErrorPB::Code* error_code) {
+  size_t batch_size_bytes = GetMaxBatchSizeBytesHint(req);
+
+  // Set the row format flags on the ScanResultCollector.
+  result_collector->set_row_format_flags(scanner->row_format_flags());
+
   if (req->call_seq_id() != scanner->call_seq_id()) {
     *error_code = TabletServerErrorPB::INVALID_SCAN_CALL_SEQ_ID;
     return Status::InvalidArgument("Invalid call sequence ID in scan request");
@@ -1879,17 +2986,60 @@ Status TabletServiceImpl::HandleContinueScanRequest(const ScanRequestPB* req,
   // TODO(todd): could size the RowBlock based on the user's requested batch size?
   // If people had really large indirect objects, we would currently overshoot
   // their requested batch size by a lot.
-  Arena arena(32 * 1024);
+  //
+  // The arena is reused by every scan request handled by this thread, rather
+  // than allocated anew for each: short scans would otherwise spend a good
+  // part of their time allocating and freeing it.
+  Arena* arena = GetScanArena();
+  arena->Reset();
+  SCOPED_CLEANUP({ arena->Reset(); });
   RowBlock block(scanner->iter()->schema(),
-                 FLAGS_scanner_batch_size_rows, &arena);
+                 FLAGS_scanner_batch_size_rows, arena);
+
+  // Hold back the scans of tables or users which exceeded their quotas: the
+  // batch returns no rows right away, and the caller holds back the response
+  // until the quotas are repaid, or for the longest delay. Waiting here would
+  // hold up a service thread.
+  string quota_table;
+  bool over_quota = false;
+  if (quota_manager_->enabled()) {
+    quota_table = scanner->tablet_replica()->tablet_metadata()->table_name();
+    MonoDelta delay = quota_manager_->ScanDelay(quota_table, scanner->username(),
+                                                MonoTime::Now());
+    if (delay.ToNanoseconds() > 0) {
+      over_quota = true;
+      delay = std::min(delay, MonoDelta::FromMilliseconds(FLAGS_quota_max_scan_delay_ms));
+      TRACE("Scan quota exceeded: holding back an empty batch for $0", delay.ToString());
+      result_collector->set_quota_delay(delay);
+    }
+  }
 
   // TODO(todd): in the future, use the client timeout to set a budget. For now,
-  // just use a half second, which should be plenty to amortize call overhead.
-  int budget_ms = 500;
-  MonoTime deadline = MonoTime::Now() + MonoDelta::FromMilliseconds(budget_ms);
+  // use a time slice of half a second by default, which should be plenty to
+  // amortize call overhead. With the scan scheduler, scans which are ahead of
+  // their share get a shorter time slice, so they don't hold up the others.
+  const MonoTime start = MonoTime::Now();
+  MonoTime deadline;
+  bool scheduled = FLAGS_scan_scheduler_enabled && !scanner->scheduler_key().empty();
+  if (scheduled) {
+    MonoDelta time_slice = scan_scheduler_->BeginBatch(scanner->scheduler_key(), start);
+    TRACE("Scan scheduler gave the batch a time slice of $0", time_slice.ToString());
+    deadline = start + time_slice;
+  } else {
+    deadline = start + MonoDelta::FromMilliseconds(FLAGS_scan_scheduler_time_slice_ms);
+  }
+  SCOPED_CLEANUP({
+    if (scheduled) {
+      MonoTime end = MonoTime::Now();
+      scan_scheduler_->EndBatch(scanner->scheduler_key(), end - start, end);
+    }
+  });
 
+  // With a limit, the scan stops as soon as it has returned enough rows. For
+  // ORDERED scans, these are the first rows in primary key order.
+  int64_t rows_remaining = scanner->num_rows_remaining();
   int64_t rows_scanned = 0;
-  while (iter->HasNext()) {
+  while (!over_quota && rows_remaining != 0 && iter->HasNext()) {
     if (PREDICT_FALSE(FLAGS_scanner_inject_latency_on_each_batch_ms > 0)) {
       SleepFor(MonoDelta::FromMilliseconds(FLAGS_scanner_inject_latency_on_each_batch_ms));
     }
@@ -1907,6 +3057,9 @@ Status TabletServiceImpl::HandleContinueScanRequest(const ScanRequestPB* req,
       // The collector will separately count the number of rows actually returned to
       // the client.
       rows_scanned += block.nrows();
+      if (rows_remaining > 0) {
+        rows_remaining -= LimitSelectedRows(rows_remaining, block.selection_vector());
+      }
       result_collector->HandleRowBlock(scanner->client_projection_schema(), block);
     }
 
@@ -1928,6 +3081,11 @@ Status TabletServiceImpl::HandleContinueScanRequest(const ScanRequestPB* req,
     }
   }
 
+  if (quota_manager_->enabled()) {
+    quota_manager_->ChargeScan(quota_table, scanner->username(), rows_scanned,
+                               result_collector->ResponseSize(), MonoTime::Now());
+  }
+
   scoped_refptr<TabletReplica> replica = scanner->tablet_replica();
   shared_ptr<Tablet> tablet;
   TabletServerErrorPB::Code tablet_ref_error_code;
@@ -1975,14 +3133,11 @@ Status TabletServiceImpl::HandleContinueScanRequest(const ScanRequestPB* req,
         delta_stats.bytes_read_from_disk);
   }
 
+  TRACE_COUNTER_INCREMENT(kScanRowsScannedMetricName, rows_scanned);
+  TRACE_COUNTER_INCREMENT(kScanRowsReturnedMetricName, result_collector->NumRowsReturned());
+  scanner->add_num_rows_returned(result_collector->NumRowsReturned());
   scanner->UpdateAccessTime();
-  *has_more_results = !req->close_scanner() && iter->HasNext();
-  if (*has_more_results) {
-    unreg_scanner.Cancel();
-  } else {
-    VLOG(2) << "Scanner " << scanner->id() << " complete: removing...";
-  }
-
+  *has_more_results = !req->close_scanner() && rows_remaining != 0 && iter->HasNext();
   return Status::OK();
 }
 
@@ -2017,11 +3172,45 @@ Status TabletServiceImpl::HandleScanAtSnapshot(const NewScanRequestPB& scan_pb,
   }
 
   Timestamp tmp_snap_timestamp;
+  bool read_under_lease = false;
 
   // If the client provided no snapshot timestamp we take the current clock
-  // time as the snapshot timestamp.
+  // time as the snapshot timestamp, unless the replica is a leader holding a
+  // lease: then we scan right after its last committed operation. No other
+  // replica committed anything since, so the scan is linearizable without
+  // waiting for safe time, and operations with higher timestamps weren't
+  // committed yet so they can be left out.
   if (!scan_pb.has_snap_timestamp()) {
-    tmp_snap_timestamp = server_->clock()->Now();
+    shared_ptr<RaftConsensus> consensus = replica->shared_consensus();
+    Timestamp lease_timestamp;
+    if (consensus && consensus->GetLeaderLeaseTimestamp(&lease_timestamp).ok() &&
+        (!scan_pb.has_propagated_timestamp() ||
+         lease_timestamp.value() >= scan_pb.propagated_timestamp())) {
+      tmp_snap_timestamp = Timestamp(lease_timestamp.value() + 1);
+      read_under_lease = true;
+    } else {
+      tmp_snap_timestamp = server_->clock()->Now();
+    }
+
+    // If the client tolerates stale data, scan at the newest timestamp that
+    // can be served without waiting, unless it's too stale.
+    if (!read_under_lease && scan_pb.has_max_staleness_ms() &&
+        server_->clock()->HasPhysicalComponent()) {
+      Timestamp servable_timestamp = replica->time_manager()->GetSafeTime();
+      Timestamp earliest_in_flight =
+          replica->tablet()->mvcc_manager()->GetEarliestInFlightTimestamp();
+      if (earliest_in_flight <= servable_timestamp) {
+        servable_timestamp = Timestamp(earliest_in_flight.value() - 1);
+      }
+      if (servable_timestamp < tmp_snap_timestamp &&
+          (!scan_pb.has_propagated_timestamp() ||
+           servable_timestamp.value() > scan_pb.propagated_timestamp()) &&
+          server_->clock()->GetPhysicalComponentDifference(
+              tmp_snap_timestamp, servable_timestamp).ToMilliseconds() <=
+              scan_pb.max_staleness_ms()) {
+        tmp_snap_timestamp = servable_timestamp;
+      }
+    }
   // ... else we use the client provided one, but make sure it is not too far
   // in the future as to be invalid.
   } else {
@@ -2075,7 +3264,9 @@ Status TabletServiceImpl::HandleScanAtSnapshot(const NewScanRequestPB& scan_pb,
   // the same timestamp (repeatable reads).
   TRACE("Waiting safe time to advance");
   MonoTime before = MonoTime::Now();
-  Status s = time_manager->WaitUntilSafe(tmp_snap_timestamp, final_deadline);
+  // Under a lease, all the operations in the snapshot are committed already.
+  Status s = read_under_lease ? Status::OK() :
+      time_manager->WaitUntilSafe(tmp_snap_timestamp, final_deadline);
 
   if (s.ok()) {
     // Wait for the in-flights in the snapshot to be finished.
@@ -2091,14 +3282,17 @@ Status TabletServiceImpl::HandleScanAtSnapshot(const NewScanRequestPB& scan_pb,
   }
   RETURN_NOT_OK(s);
 
-  uint64_t duration_usec = (MonoTime::Now() - before).ToMicroseconds();
+  const MonoDelta wait_duration = MonoTime::Now() - before;
+  TRACE_COUNTER_INCREMENT(kScanSafeTimeWaitNanosMetricName, wait_duration.ToNanoseconds());
+  uint64_t duration_usec = wait_duration.ToMicroseconds();
   tablet->metrics()->snapshot_read_inflight_wait_duration->Increment(duration_usec);
   TRACE("All operations in snapshot committed. Waited for $0 microseconds", duration_usec);
 
   if (scan_pb.order_mode() == UNKNOWN_ORDER_MODE) {
     return Status::InvalidArgument("Unknown order mode specified");
   }
-  RETURN_NOT_OK(tablet->NewRowIterator(projection, snap, scan_pb.order_mode(), iter));
+  RETURN_NOT_OK(tablet->NewRowIterator(projection, snap, scan_pb.order_mode(), iter,
+                                       server_->scan_pool()));
   *snap_timestamp = tmp_snap_timestamp;
   return Status::OK();
 }
@@ -18,6 +18,8 @@
 #define KUDU_TSERVER_TABLET_SERVICE_H
 
 #include <cstdint>
+#include <memory>
+#include <mutex>
 #include <string>
 
 #include "kudu/consensus/consensus.service.h"
@@ -35,10 +37,13 @@ class Message;
 
 namespace kudu {
 
+class MonoDelta;
 class RowwiseIterator;
 class Schema;
 class Status;
+class ThreadPool;
 class Timestamp;
+class faststring;
 
 namespace server {
 class ServerBase;
@@ -57,6 +62,8 @@ class GetNodeInstanceRequestPB;
 class GetNodeInstanceResponsePB;
 class LeaderStepDownRequestPB;
 class LeaderStepDownResponsePB;
+class MultiConsensusRequestPB;
+class MultiConsensusResponsePB;
 class RunLeaderElectionRequestPB;
 class RunLeaderElectionResponsePB;
 class StartTabletCopyRequestPB;
@@ -85,13 +92,19 @@ class CreateTabletRequestPB;
 class CreateTabletResponsePB;
 class DeleteTabletRequestPB;
 class DeleteTabletResponsePB;
+class QuotaManager;
+class RequestCapture;
+class ScanResultCache;
+class ScanScheduler;
 class ScanResultCollector;
+class Scanner;
 class TabletReplicaLookupIf;
 class TabletServer;
 
 class TabletServiceImpl : public TabletServerServiceIf {
  public:
   explicit TabletServiceImpl(TabletServer* server);
+  ~TabletServiceImpl();
 
   bool AuthorizeClient(const google::protobuf::Message* req,
                        google::protobuf::Message* resp,
@@ -124,11 +137,57 @@ class TabletServiceImpl : public TabletServerServiceIf {
                         ChecksumResponsePB* resp,
                         rpc::RpcContext* context) OVERRIDE;
 
+  void GetColumnStatistics(const GetColumnStatisticsRequestPB* req,
+                           GetColumnStatisticsResponsePB* resp,
+                           rpc::RpcContext* context) override;
+
+  void CountLiveRows(const CountLiveRowsRequestPB* req,
+                     CountLiveRowsResponsePB* resp,
+                     rpc::RpcContext* context) override;
+
+  void SplitKeyRange(const SplitKeyRangeRequestPB* req,
+                     SplitKeyRangeResponsePB* resp,
+                     rpc::RpcContext* context) override;
+
+  void MultiScan(const MultiScanRequestPB* req,
+                 MultiScanResponsePB* resp,
+                 rpc::RpcContext* context) override;
+
+  void Get(const GetRequestPB* req,
+           GetResponsePB* resp,
+           rpc::RpcContext* context) override;
+
   bool SupportsFeature(uint32_t feature) const override;
 
   virtual void Shutdown() OVERRIDE;
 
  private:
+  // Submits a write to 'replica' once Write() has admitted it. The RPC is
+  // responded to asynchronously.
+  void SubmitWrite(const scoped_refptr<tablet::TabletReplica>& replica,
+                   const WriteRequestPB* req,
+                   WriteResponsePB* resp,
+                   rpc::RpcContext* context);
+
+  // Handles the scan request 'req', filling in 'resp' and attaching the
+  // results to 'context' as sidecars, without responding to the RPC.
+  // 'sidecar_lock', if not null, is held while attaching the sidecars, so that
+  // several requests may be handled concurrently for the same RPC.
+  //
+  // Sets 'quota_delay' to how long the response should be held back because
+  // the scan exceeded a quota. Returns a bad Status if the request failed,
+  // setting 'error_code' to the code of the error.
+  Status HandleScan(const ScanRequestPB* req,
+                    ScanResponsePB* resp,
+                    rpc::RpcContext* context,
+                    std::mutex* sidecar_lock,
+                    MonoDelta* quota_delay,
+                    TabletServerErrorPB::Code* error_code);
+
+  // Responds successfully to 'context', after 'delay' if it's positive. The
+  // delay is timed by a reactor so as not to hold up a service thread.
+  void RespondSuccessAfter(rpc::RpcContext* context, const MonoDelta& delay);
+
   Status HandleNewScanRequest(tablet::TabletReplica* tablet_replica,
                               const ScanRequestPB* req,
                               const rpc::RpcContext* rpc_context,
@@ -143,6 +202,15 @@ class TabletServiceImpl : public TabletServerServiceIf {
                                    bool* has_more_results,
                                    TabletServerErrorPB::Code* error_code);
 
+  // Reads the next batch of results of the scan of 'scanner' into
+  // 'result_collector', on behalf of 'req'. 'scanner' needn't be registered
+  // with the scanner manager.
+  Status ContinueScan(const std::shared_ptr<Scanner>& scanner,
+                      const ScanRequestPB* req,
+                      ScanResultCollector* result_collector,
+                      bool* has_more_results,
+                      TabletServerErrorPB::Code* error_code);
+
   Status HandleScanAtSnapshot(const NewScanRequestPB& scan_pb,
                               const rpc::RpcContext* rpc_context,
                               const Schema& projection,
@@ -150,7 +218,37 @@ class TabletServiceImpl : public TabletServerServiceIf {
                               gscoped_ptr<RowwiseIterator>* iter,
                               Timestamp* snap_timestamp);
 
+  // Fills in the response to the new scan request 'req' with results from
+  // 'scan_result_cache_', if they are cached under 'cache_key', as
+  // HandleScan() does. Returns false if they aren't, in which case the request
+  // must be handled.
+  bool ScanFromResultCache(const ScanRequestPB* req,
+                           const faststring& cache_key,
+                           tablet::TabletReplica* replica,
+                           ScanResponsePB* resp,
+                           rpc::RpcContext* context,
+                           std::mutex* sidecar_lock);
+
   TabletServer* server_;
+
+  // Caches the results of repeated snapshot scans. NULL if
+  // --scan_result_cache_capacity_mb is 0.
+  std::unique_ptr<ScanResultCache> scan_result_cache_;
+
+  // Captures a sample of the write and scan requests, as per
+  // --request_capture_sampling_rate.
+  std::unique_ptr<RequestCapture> request_capture_;
+
+  // Runs the scans of MultiScan requests.
+  gscoped_ptr<ThreadPool> multi_scan_pool_;
+
+  // Shares the time spent on scan batches between tables or users, if
+  // --scan_scheduler_enabled is set.
+  std::unique_ptr<ScanScheduler> scan_scheduler_;
+
+  // Enforces the quotas of the tables and users on writes and scans, as per
+  // --table_quotas and --user_quotas.
+  std::unique_ptr<QuotaManager> quota_manager_;
 };
 
 class TabletServiceAdminImpl : public TabletServerAdminServiceIf {
@@ -173,6 +271,10 @@ class TabletServiceAdminImpl : public TabletServerAdminServiceIf {
                            AlterSchemaResponsePB* resp,
                            rpc::RpcContext* context) OVERRIDE;
 
+  virtual void DrainLeaders(const DrainLeadersRequestPB* req,
+                            DrainLeadersResponsePB* resp,
+                            rpc::RpcContext* context) OVERRIDE;
+
  private:
   TabletServer* server_;
 };
@@ -184,6 +286,8 @@ class ConsensusServiceImpl : public consensus::ConsensusServiceIf {
 
   virtual ~ConsensusServiceImpl();
 
+  virtual void Shutdown() OVERRIDE;
+
   bool AuthorizeServiceUser(const google::protobuf::Message* req,
                             google::protobuf::Message* resp,
                             rpc::RpcContext* rpc) override;
@@ -192,6 +296,10 @@ class ConsensusServiceImpl : public consensus::ConsensusServiceIf {
                                consensus::ConsensusResponsePB* resp,
                                rpc::RpcContext* context) OVERRIDE;
 
+  virtual void MultiUpdateConsensus(const consensus::MultiConsensusRequestPB* req,
+                                    consensus::MultiConsensusResponsePB* resp,
+                                    rpc::RpcContext* context) OVERRIDE;
+
   virtual void RequestConsensusVote(const consensus::VoteRequestPB* req,
                                     consensus::VoteResponsePB* resp,
                                     rpc::RpcContext* context) OVERRIDE;
@@ -231,6 +339,9 @@ class ConsensusServiceImpl : public consensus::ConsensusServiceIf {
  private:
   server::ServerBase* server_;
   TabletReplicaLookupIf* tablet_manager_;
+
+  // Handles the requests of MultiUpdateConsensus RPCs.
+  gscoped_ptr<ThreadPool> multi_update_pool_;
 };
 
 } // namespace tserver
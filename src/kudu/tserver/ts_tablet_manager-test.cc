@@ -31,6 +31,7 @@
 #include "kudu/common/schema.h"
 #include "kudu/consensus/metadata.pb.h"
 #include "kudu/consensus/opid_util.h"
+#include "kudu/consensus/quorum_util.h"
 #include "kudu/consensus/raft_consensus.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/port.h"
@@ -287,5 +288,29 @@ TEST_F(TsTabletManagerTest, TestTabletReports) {
   ASSERT_MONOTONIC_REPORT_SEQNO(&seqno, report);
 }
 
+// Compact full tablet reports carry the digest of the consensus state of the
+// running replicas in place of the state.
+TEST_F(TsTabletManagerTest, TestCompactFullTabletReport) {
+  scoped_refptr<TabletReplica> replica;
+  ASSERT_OK(CreateNewTablet("tablet-1", schema_, &replica));
+
+  TabletReportPB report;
+  tablet_manager_->PopulateFullTabletReport(&report, /*compact=*/false);
+  ASSERT_EQ(1, report.updated_tablets_size());
+  const ReportedTabletPB full = report.updated_tablets(0);
+  ASSERT_TRUE(full.has_consensus_state());
+  ASSERT_FALSE(full.has_consensus_state_digest());
+
+  report.Clear();
+  tablet_manager_->PopulateFullTabletReport(&report, /*compact=*/true);
+  ASSERT_EQ(1, report.updated_tablets_size());
+  const ReportedTabletPB& compact = report.updated_tablets(0);
+  ASSERT_EQ("tablet-1", compact.tablet_id());
+  ASSERT_FALSE(compact.has_consensus_state());
+  ASSERT_EQ(consensus::ConsensusStateDigest(full.consensus_state()),
+            compact.consensus_state_digest());
+  ASSERT_EQ(full.schema_version(), compact.schema_version());
+}
+
 } // namespace tserver
 } // namespace kudu
@@ -17,11 +17,14 @@
 
 #include "kudu/tserver/ts_tablet_manager.h"
 
+#include <algorithm>
 #include <cstdint>
+#include <limits>
 #include <memory>
 #include <mutex>
 #include <ostream>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -52,18 +55,23 @@
 #include "kudu/master/master.pb.h"
 #include "kudu/rpc/result_tracker.h"
 #include "kudu/tablet/metadata.pb.h"
+#include "kudu/tablet/tablet.h"
 #include "kudu/tablet/tablet_bootstrap.h"
 #include "kudu/tablet/tablet_metadata.h"
+#include "kudu/tablet/tablet_metrics.h"
 #include "kudu/tablet/tablet_replica.h"
 #include "kudu/tserver/heartbeater.h"
 #include "kudu/tserver/tablet_server.h"
 #include "kudu/util/debug/trace_event.h"
+#include "kudu/util/env.h"
 #include "kudu/util/fault_injection.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/logging.h"
+#include "kudu/util/metrics.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/net/net_util.h"
 #include "kudu/util/net/sockaddr.h"
+#include "kudu/util/process_memory.h"
 #include "kudu/util/scoped_cleanup.h"
 #include "kudu/util/stopwatch.h"
 #include "kudu/util/threadpool.h"
@@ -116,6 +124,18 @@ DEFINE_int32(tablet_state_walk_min_period_ms, 1000,
              "tablet map to update tablet state counts.");
 TAG_FLAG(tablet_state_walk_min_period_ms, advanced);
 
+DEFINE_int32(heartbeat_max_hot_tablets, 10,
+             "Maximum number of the tablet replicas with the most recent row operations "
+             "whose hot keys are reported to the master in each heartbeat.");
+TAG_FLAG(heartbeat_max_hot_tablets, advanced);
+TAG_FLAG(heartbeat_max_hot_tablets, runtime);
+
+DEFINE_int32(heartbeat_max_hot_keys_per_tablet, 5,
+             "Maximum number of hot keys reported to the master per tablet replica in "
+             "each heartbeat.");
+TAG_FLAG(heartbeat_max_hot_keys_per_tablet, advanced);
+TAG_FLAG(heartbeat_max_hot_keys_per_tablet, runtime);
+
 METRIC_DEFINE_gauge_int32(server, tablets_num_not_initialized,
                           "Number of Not Initialized Tablets",
                           kudu::MetricUnit::kTablets,
@@ -156,6 +176,8 @@ METRIC_DEFINE_gauge_int32(server, tablets_num_shutdown,
                           kudu::MetricUnit::kTablets,
                           "Number of tablets currently shut down");
 
+METRIC_DECLARE_histogram(rpc_incoming_queue_time);
+
 using std::shared_ptr;
 using std::string;
 using std::vector;
@@ -175,11 +197,13 @@ using consensus::OpIdToString;
 using consensus::RECEIVED_OPID;
 using consensus::RaftConfigPB;
 using consensus::RaftConsensus;
+using consensus::RaftPeerPB;
 using consensus::StartTabletCopyRequestPB;
 using consensus::kMinimumTerm;
 using fs::DataDirManager;
 using log::Log;
 using master::ReportedTabletPB;
+using master::TSLoadPB;
 using master::TabletReportPB;
 using tablet::Tablet;
 using tablet::TABLET_DATA_COPYING;
@@ -295,6 +319,10 @@ Status TSTabletManager::Init() {
   }
   LOG(INFO) << Substitute("Loaded tablet metadata ($0 live tablets)", metas.size());
 
+  // The pool opens the tablets in the order they're submitted, so submit the
+  // ones which should become available first.
+  SortTabletsForStartup(&metas);
+
   // Now submit the "Open" task for each.
   for (const scoped_refptr<TabletMetadata>& meta : metas) {
     scoped_refptr<TransitionInProgressDeleter> deleter;
@@ -317,6 +345,48 @@ Status TSTabletManager::Init() {
   return Status::OK();
 }
 
+void TSTabletManager::SortTabletsForStartup(vector<scoped_refptr<TabletMetadata>>* metas) {
+  struct StartupOrder {
+    bool likely_leader;
+    uint64_t wal_size;
+  };
+  std::unordered_map<string, StartupOrder> order_by_tablet_id;
+  for (const auto& meta : *metas) {
+    StartupOrder order = { false, 0 };
+    // The cmeta is cached by the manager, so loading it here doesn't cost an
+    // extra read when the tablet is opened. If it can't be loaded, opening
+    // the tablet will fail anyway.
+    scoped_refptr<ConsensusMetadata> cmeta;
+    if (cmeta_manager_->Load(meta->tablet_id(), &cmeta).ok()) {
+      // A replica which voted for itself in its last term most likely won
+      // that election. A replica which is the only voter is always leader.
+      order.likely_leader =
+          (cmeta->has_voted_for() && cmeta->voted_for() == fs_manager_->uuid()) ||
+          (cmeta->CountVotersInConfig(consensus::COMMITTED_CONFIG) == 1 &&
+           cmeta->IsVoterInConfig(fs_manager_->uuid(), consensus::COMMITTED_CONFIG));
+    }
+    // The size of the WAL is a proxy for how long bootstrapping the tablet
+    // takes. If it can't be determined, the tablet goes last.
+    Status s = fs_manager_->env()->GetFileSizeOnDiskRecursively(
+        fs_manager_->GetTabletWalDir(meta->tablet_id()), &order.wal_size);
+    if (!s.ok()) {
+      order.wal_size = std::numeric_limits<uint64_t>::max();
+    }
+    order_by_tablet_id[meta->tablet_id()] = order;
+  }
+
+  std::stable_sort(metas->begin(), metas->end(),
+                   [&](const scoped_refptr<TabletMetadata>& a,
+                       const scoped_refptr<TabletMetadata>& b) {
+    const StartupOrder& order_a = FindOrDie(order_by_tablet_id, a->tablet_id());
+    const StartupOrder& order_b = FindOrDie(order_by_tablet_id, b->tablet_id());
+    if (order_a.likely_leader != order_b.likely_leader) {
+      return order_a.likely_leader;
+    }
+    return order_a.wal_size < order_b.wal_size;
+  });
+}
+
 Status TSTabletManager::WaitForAllBootstrapsToFinish() {
   CHECK_EQ(state(), MANAGER_RUNNING);
 
@@ -603,8 +673,11 @@ void TSTabletManager::RunTabletCopy(
         // will simply tablet copy this replica again. We could try to
         // check again after calling Shutdown(), and if the check fails, try to
         // reopen the tablet. For now, we live with the (unlikely) race.
+        //
+        // The blocks previously copied from the same source are kept, for the
+        // copy to reuse rather than download them again.
         Status s = DeleteTabletData(meta, cmeta_manager_, TABLET_DATA_TOMBSTONED,
-                                    opt_last_logged_opid);
+                                    opt_last_logged_opid, copy_source_uuid);
         if (PREDICT_FALSE(!s.ok())) {
           CALLBACK_AND_RETURN(
               s.CloneAndPrepend(Substitute("Unable to delete on-disk data from tablet $0",
@@ -723,7 +796,7 @@ Status TSTabletManager::CreateAndRegisterTabletReplica(
       new TabletReplica(std::move(meta),
                         cmeta_manager_,
                         local_peer_pb_,
-                        server_->tablet_apply_pool(),
+                        server_->tablet_apply_pool(tablet_id),
                         Bind(&TSTabletManager::MarkTabletDirty,
                              Unretained(this),
                              tablet_id)));
@@ -975,7 +1048,7 @@ void TSTabletManager::OpenTablet(const scoped_refptr<TabletReplica>& replica,
                        server_->messenger(),
                        server_->result_tracker(),
                        log,
-                       server_->tablet_prepare_pool());
+                       server_->tablet_prepare_pool(tablet_id));
     if (!s.ok()) {
       LOG(ERROR) << LogPrefix(tablet_id) << "Tablet failed to start: "
                  << s.ToString();
@@ -1149,7 +1222,7 @@ void TSTabletManager::CreateReportedTabletPB(const scoped_refptr<TabletReplica>&
   }
 }
 
-void TSTabletManager::PopulateFullTabletReport(TabletReportPB* report) const {
+void TSTabletManager::PopulateFullTabletReport(TabletReportPB* report, bool compact) const {
   // Creating the tablet report can be slow in the case that it is in the
   // middle of flushing its consensus metadata. We don't want to hold
   // lock_ for too long, even in read mode, since it can cause other readers
@@ -1158,8 +1231,87 @@ void TSTabletManager::PopulateFullTabletReport(TabletReportPB* report) const {
   vector<scoped_refptr<tablet::TabletReplica>> to_report;
   GetTabletReplicas(&to_report);
   for (const auto& replica : to_report) {
-    CreateReportedTabletPB(replica, report->add_updated_tablets());
+    ReportedTabletPB* reported_tablet = report->add_updated_tablets();
+    CreateReportedTabletPB(replica, reported_tablet);
+    if (compact &&
+        reported_tablet->state() == tablet::RUNNING &&
+        reported_tablet->tablet_data_state() == TABLET_DATA_READY &&
+        !reported_tablet->has_error() &&
+        reported_tablet->has_consensus_state()) {
+      reported_tablet->set_consensus_state_digest(
+          consensus::ConsensusStateDigest(reported_tablet->consensus_state()));
+      reported_tablet->clear_consensus_state();
+    }
+  }
+}
+
+void TSTabletManager::PopulateLoad(TSLoadPB* load) const {
+  // See PopulateFullTabletReport() about copying the set of replicas.
+  vector<scoped_refptr<tablet::TabletReplica>> replicas;
+  GetTabletReplicas(&replicas);
+  int num_leaders = 0;
+  int64_t rows_written = 0;
+  int64_t rows_scanned = 0;
+  vector<tablet::TabletHotKeysPB> hot_tablets;
+  for (const auto& replica : replicas) {
+    shared_ptr<RaftConsensus> consensus = replica->shared_consensus();
+    if (consensus && consensus->role() == RaftPeerPB::LEADER) {
+      num_leaders++;
+    }
+    shared_ptr<Tablet> tablet = replica->shared_tablet();
+    if (tablet && tablet->metrics()) {
+      const tablet::TabletMetrics* metrics = tablet->metrics();
+      rows_written += metrics->rows_inserted->value() +
+                      metrics->rows_upserted->value() +
+                      metrics->rows_updated->value() +
+                      metrics->rows_deleted->value();
+      rows_scanned += metrics->scanner_rows_returned->value();
+    }
+    if (tablet && FLAGS_heartbeat_max_hot_tablets > 0) {
+      tablet::TabletHotKeysPB hot_keys;
+      tablet->GetHotKeys(FLAGS_heartbeat_max_hot_keys_per_tablet, &hot_keys);
+      if (hot_keys.estimated_ops() > 0) {
+        hot_tablets.emplace_back(std::move(hot_keys));
+      }
+    }
   }
+  load->set_num_leaders(num_leaders);
+
+  // Report the hottest replicas only.
+  const size_t num_hot = std::min<size_t>(hot_tablets.size(), FLAGS_heartbeat_max_hot_tablets);
+  std::partial_sort(hot_tablets.begin(), hot_tablets.begin() + num_hot, hot_tablets.end(),
+                    [](const tablet::TabletHotKeysPB& a, const tablet::TabletHotKeysPB& b) {
+                      return a.estimated_ops() > b.estimated_ops();
+                    });
+  for (size_t i = 0; i < num_hot; i++) {
+    load->add_hot_tablets()->Swap(&hot_tablets[i]);
+  }
+  load->set_rows_written(rows_written);
+  load->set_rows_scanned(rows_scanned);
+
+  int64_t free_bytes = 0;
+  int64_t capacity_bytes = 0;
+  for (const string& dir : fs_manager_->GetDataRootDirs()) {
+    SpaceInfo space_info;
+    Status s = fs_manager_->env()->GetSpaceInfo(dir, &space_info);
+    if (!s.ok()) {
+      KLOG_EVERY_N_SECS(WARNING, 60) << Substitute(
+          "Could not get the space info of data directory $0: $1", dir, s.ToString());
+      continue;
+    }
+    free_bytes += space_info.free_bytes;
+    capacity_bytes += space_info.capacity_bytes;
+  }
+  load->set_data_dirs_free_bytes(free_bytes);
+  load->set_data_dirs_capacity_bytes(capacity_bytes);
+
+  load->set_memory_pressure(process_memory::UnderMemoryPressure(nullptr));
+
+  // The histogram is shared by all of the RPC services of the server.
+  scoped_refptr<Histogram> queue_time =
+      METRIC_rpc_incoming_queue_time.Instantiate(server_->metric_entity());
+  load->set_rpcs_queued(queue_time->TotalCount());
+  load->set_rpc_queue_time_us(queue_time->TotalSum());
 }
 
 void TSTabletManager::PopulateIncrementalTabletReport(TabletReportPB* report,
@@ -1251,7 +1403,8 @@ Status TSTabletManager::DeleteTabletData(
     const scoped_refptr<TabletMetadata>& meta,
     const scoped_refptr<consensus::ConsensusMetadataManager>& cmeta_manager,
     TabletDataState delete_type,
-    boost::optional<OpId> last_logged_opid) {
+    boost::optional<OpId> last_logged_opid,
+    const string& keep_blocks_copied_from) {
   const string& tablet_id = meta->tablet_id();
   LOG(INFO) << LogPrefix(tablet_id, meta->fs_manager())
             << "Deleting tablet data with delete state "
@@ -1264,7 +1417,8 @@ Status TSTabletManager::DeleteTabletData(
 
   // Note: Passing an unset 'last_logged_opid' will retain the last_logged_opid
   // that was previously in the metadata.
-  RETURN_NOT_OK(meta->DeleteTabletData(delete_type, last_logged_opid));
+  RETURN_NOT_OK(meta->DeleteTabletData(delete_type, last_logged_opid,
+                                       keep_blocks_copied_from));
   last_logged_opid = meta->tombstone_last_logged_opid();
   LOG(INFO) << LogPrefix(tablet_id, meta->fs_manager())
             << "tablet deleted: last-logged OpId: "
@@ -64,6 +64,7 @@ class StartTabletCopyRequestPB;
 
 namespace master {
 class ReportedTabletPB;
+class TSLoadPB;
 class TabletReportPB;
 } // namespace master
 
@@ -162,14 +163,20 @@ class TSTabletManager : public tserver::TabletReplicaLookupIf {
       const consensus::StartTabletCopyRequestPB* req,
       std::function<void(const Status&, TabletServerErrorPB::Code)> cb);
 
-  // Adds updated tablet information to 'report'.
-  void PopulateFullTabletReport(master::TabletReportPB* report) const;
+  // Adds updated tablet information to 'report'. If 'compact' is true, the
+  // running replicas report a digest of their consensus state rather than the
+  // state itself.
+  void PopulateFullTabletReport(master::TabletReportPB* report, bool compact) const;
 
   // Adds updated tablet information to 'report'. Only tablets in 'tablet_ids'
   // are included.
   void PopulateIncrementalTabletReport(master::TabletReportPB* report,
                                        const std::vector<std::string>& tablet_ids) const;
 
+  // Fills 'load' with the load of this server, for the master's placement of
+  // new tablet replicas.
+  void PopulateLoad(master::TSLoadPB* load) const;
+
   // Get all of the tablets currently hosted on this server.
   virtual void GetTabletReplicas(
       std::vector<scoped_refptr<tablet::TabletReplica> >* replicas) const override;
@@ -193,11 +200,14 @@ class TSTabletManager : public tserver::TabletReplicaLookupIf {
   // 'tombstone_last_logged_opid' field in the tablet metadata. Otherwise, if
   // 'last_logged_opid' is equal to boost::none, the tablet metadata will
   // retain its previous value of 'tombstone_last_logged_opid', if any.
+  //
+  // See TabletMetadata::DeleteTabletData() for 'keep_blocks_copied_from'.
   static Status DeleteTabletData(
       const scoped_refptr<tablet::TabletMetadata>& meta,
       const scoped_refptr<consensus::ConsensusMetadataManager>& cmeta_manager,
       tablet::TabletDataState delete_type,
-      boost::optional<consensus::OpId> last_logged_opid);
+      boost::optional<consensus::OpId> last_logged_opid,
+      const std::string& keep_blocks_copied_from = "");
 
   // Forces shutdown of the tablet replicas in the data dir corresponding to 'uuid'.
   void FailTabletsInDataDir(const std::string& uuid);
@@ -285,6 +295,12 @@ class TSTabletManager : public tserver::TabletReplicaLookupIf {
   // TABLET_DATA_READY state. Generally, we tombstone the replica.
   Status HandleNonReadyTabletOnStartup(const scoped_refptr<tablet::TabletMetadata>& meta);
 
+  // Sorts the tablets in 'metas' in the order they should be opened on
+  // startup: first the tablets this server was likely leading, whose clients
+  // wait for them to elect a leader again, then those with the least WAL to
+  // replay, which can be opened soonest.
+  void SortTabletsForStartup(std::vector<scoped_refptr<tablet::TabletMetadata>>* metas);
+
   // Return Status::IllegalState if leader_term < last_logged_term.
   // Helper function for use with tablet copy.
   Status CheckLeaderTermNotLower(const std::string& tablet_id,
@@ -82,6 +82,7 @@ using kudu::MaintenanceManagerStatusPB;
 using kudu::pb_util::SecureDebugString;
 using kudu::pb_util::SecureShortDebugString;
 using kudu::tablet::Tablet;
+using kudu::tablet::TabletHotKeysPB;
 using kudu::tablet::TabletReplica;
 using kudu::tablet::TabletStatePB;
 using kudu::tablet::TabletStatusPB;
@@ -433,6 +434,27 @@ void TabletServerPathHandlers::HandleTabletPage(const Webserver::WebRequest& req
   const Schema& schema = replica->tablet_metadata()->schema();
   HtmlOutputSchemaTable(schema, output);
 
+  shared_ptr<Tablet> tablet = replica->shared_tablet();
+  if (tablet) {
+    static const int kMaxHotKeys = 20;
+    TabletHotKeysPB hot_keys;
+    tablet->GetHotKeys(kMaxHotKeys, &hot_keys);
+    *output << "<h2>Hot Keys</h2>\n";
+    *output << "<p>Estimated recent row operations: " << hot_keys.estimated_ops() << "</p>\n";
+    if (hot_keys.keys_size() > 0) {
+      *output << "<table class='table table-striped'>\n";
+      *output << "  <tr><th>Key</th><th>Estimated Recent Row Operations</th>"
+              << "<th>Maximum Overestimate</th></tr>\n";
+      for (const auto& key : hot_keys.keys()) {
+        *output << Substitute("  <tr><td>$0</td><td>$1</td><td>$2</td></tr>\n",
+                              EscapeForHtmlToString(schema.DebugEncodedRowKey(
+                                  key.encoded_key(), Schema::START_KEY)),
+                              key.estimated_ops(), key.max_overestimate());
+      }
+      *output << "</table>\n";
+    }
+  }
+
   *output << "<h2>Other Tablet Info Pages</h2>" << endl;
 
   // List of links to various tablet-specific info pages
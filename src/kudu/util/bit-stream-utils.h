@@ -100,6 +100,14 @@ class BitReader {
   template<typename T>
   bool GetValue(int num_bits, T* v);
 
+  // Gets up to 'batch_size' values of 'num_bits' bits each into 'v', and returns
+  // the number of values read, which is less than 'batch_size' only if the
+  // stream ran out. Byte-aligned groups of 8 values are unpacked with kernels
+  // specialized for each bit width up to 32, which is much faster than calling
+  // GetValue() repeatedly.
+  template<typename T>
+  int GetBatch(int num_bits, T* v, int batch_size);
+
   // Reads a 'num_bytes'-sized value from the buffer and stores it in 'v'. T needs to be a
   // little-endian native type and big enough to store 'num_bytes'. The value is assumed
   // to be byte-aligned so the stream will be advanced to the start of the next byte
@@ -131,6 +131,86 @@ inline bool BitReader::GetValue(int num_bits, T* v) {
   return true;
 }
 
+namespace bitstream_internal {
+
+// Unpacks groups of 8 values of BIT_WIDTH bits each from the byte-aligned
+// 'in', which has 'in_bytes' readable bytes. Each group occupies exactly
+// BIT_WIDTH bytes and every shift below is a compile-time constant, so the
+// loop unrolls into straight-line loads, shifts and masks.
+//
+// Only unpacks the groups which are followed by at least 8 readable bytes,
+// since the last value of a group is read with a 64-bit load. Returns the
+// number of values unpacked, a multiple of 8 no greater than 'num_values'.
+template<typename T, int BIT_WIDTH>
+inline int UnpackGroupsOfWidth(const uint8_t* in, int in_bytes, int num_values, T* out) {
+  static_assert(BIT_WIDTH >= 1 && BIT_WIDTH <= 32, "unsupported bit width");
+  const uint64_t kMask = (1ULL << BIT_WIDTH) - 1;
+  const int num_groups = std::min(num_values / 8,
+                                  std::max(0, (in_bytes - 8) / BIT_WIDTH));
+  for (int g = 0; g < num_groups; g++) {
+    for (int j = 0; j < 8; j++) {
+      const int bit = j * BIT_WIDTH;
+      out[j] = static_cast<T>((UNALIGNED_LOAD64(in + bit / 8) >> (bit % 8)) & kMask);
+    }
+    in += BIT_WIDTH;
+    out += 8;
+  }
+  return num_groups * 8;
+}
+
+// Dispatches to the unpacking kernel for 'bit_width'. Returns 0 for widths
+// without a kernel, leaving the caller to read the values one at a time.
+template<typename T>
+inline int UnpackGroups(int bit_width, const uint8_t* in, int in_bytes, int num_values, T* out) {
+  switch (bit_width) {
+#define UNPACK_CASE(w) \
+    case w: return UnpackGroupsOfWidth<T, w>(in, in_bytes, num_values, out)
+    UNPACK_CASE(1);  UNPACK_CASE(2);  UNPACK_CASE(3);  UNPACK_CASE(4);
+    UNPACK_CASE(5);  UNPACK_CASE(6);  UNPACK_CASE(7);  UNPACK_CASE(8);
+    UNPACK_CASE(9);  UNPACK_CASE(10); UNPACK_CASE(11); UNPACK_CASE(12);
+    UNPACK_CASE(13); UNPACK_CASE(14); UNPACK_CASE(15); UNPACK_CASE(16);
+    UNPACK_CASE(17); UNPACK_CASE(18); UNPACK_CASE(19); UNPACK_CASE(20);
+    UNPACK_CASE(21); UNPACK_CASE(22); UNPACK_CASE(23); UNPACK_CASE(24);
+    UNPACK_CASE(25); UNPACK_CASE(26); UNPACK_CASE(27); UNPACK_CASE(28);
+    UNPACK_CASE(29); UNPACK_CASE(30); UNPACK_CASE(31); UNPACK_CASE(32);
+#undef UNPACK_CASE
+    default: return 0;
+  }
+}
+
+} // namespace bitstream_internal
+
+template<typename T>
+inline int BitReader::GetBatch(int num_bits, T* v, int batch_size) {
+  DCHECK_LE(num_bits, sizeof(T) * 8);
+  int i = 0;
+
+  // Read single values until the stream is byte aligned. Within 8 values the
+  // offset cycles back to where it started, so give up after that.
+  while (i < batch_size && i < 8 && bit_offset_ % 8 != 0) {
+    if (PREDICT_FALSE(!GetValue(num_bits, &v[i]))) return i;
+    i++;
+  }
+
+  if (bit_offset_ % 8 == 0) {
+    int byte_pos = byte_offset_ + bit_offset_ / 8;
+    int unpacked = bitstream_internal::UnpackGroups(
+        num_bits, buffer_ + byte_pos, max_bytes_ - byte_pos, batch_size - i, v + i);
+    if (unpacked > 0) {
+      SeekToBit(position() + unpacked * num_bits);
+      i += unpacked;
+    }
+  }
+
+  // Pick up the values which don't fill a group or sit at the very end of
+  // the buffer.
+  while (i < batch_size) {
+    if (PREDICT_FALSE(!GetValue(num_bits, &v[i]))) break;
+    i++;
+  }
+  return i;
+}
+
 inline void BitReader::Rewind(int num_bits) {
   bit_offset_ -= num_bits;
   if (bit_offset_ >= 0) {
@@ -89,4 +89,38 @@ TEST(TestBloomFilter, TestInsertAndProbe) {
   ASSERT_NEAR(fp_rate, expected_fp_rate, 0.20*expected_fp_rate);
 }
 
+TEST(TestBloomFilter, TestSplitBlockInsertAndProbe) {
+  int n_keys = 2000;
+  BloomFilterBuilder bfb(
+    BloomFilterSizing::ByCountAndFPRate(n_keys, 0.01), SPLIT_BLOCK_BLOOM_FILTER);
+  ASSERT_EQ(0, bfb.n_bytes() % 32);
+  ASSERT_EQ(8, bfb.n_hashes());
+
+  // For the same size, the false positive rate is a bit higher than that of
+  // a classic bloom filter.
+  double expected_fp_rate = bfb.false_positive_rate();
+  ASSERT_GT(expected_fp_rate, 0.01);
+  ASSERT_LT(expected_fp_rate, 0.02);
+
+  AddRandomKeys(kRandomSeed, n_keys, &bfb);
+  BloomFilter bf(bfb.slice(), bfb.n_hashes(), SPLIT_BLOCK_BLOOM_FILTER);
+  CheckRandomKeys(kRandomSeed, n_keys, bf);
+
+  uint32_t num_queries = 100000;
+  uint32_t num_positives = 0;
+  for (int i = 0; i < num_queries; i++) {
+    uint64_t key = random();
+    Slice key_slice(reinterpret_cast<const uint8_t *>(&key), sizeof(key));
+    BloomKeyProbe probe(key_slice);
+    if (bf.MayContainKey(probe)) {
+      num_positives++;
+    }
+  }
+
+  double fp_rate = static_cast<double>(num_positives) / static_cast<double>(num_queries);
+  LOG(INFO) << "FP rate: " << fp_rate << " (" << num_positives << "/" << num_queries << ")";
+  LOG(INFO) << "Expected FP rate: " << expected_fp_rate;
+  ASSERT_NEAR(fp_rate, expected_fp_rate, 0.20*expected_fp_rate);
+}
+
 } // namespace kudu
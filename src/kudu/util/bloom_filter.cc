@@ -17,6 +17,8 @@
 
 #include "kudu/util/bloom_filter.h"
 
+#include <smmintrin.h>
+
 #include <cmath>
 #include <cstring>
 #include <ostream>
@@ -27,6 +29,36 @@ namespace kudu {
 
 static double kNaturalLog2 = 0.69314;
 
+// Odd constants used to derive the bit positions of a key within a block of a
+// split-block bloom filter from a single hash, one per 32-bit word.
+static const uint32_t kSplitBlockSalts[8] = {
+  0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+  0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U
+};
+
+// Return a vector of (1 << x) for each of the 32-bit lanes x of 'shifts',
+// which must be between 0 and 31.
+//
+// SSE4 has no per-lane variable shift, so this builds the float 2^x from its
+// exponent and converts it back to an integer. 2^31 overflows the conversion,
+// which then yields 0x80000000: exactly 1 << 31.
+static inline __m128i OneBitPerLane(__m128i shifts) {
+  __m128i exponents = _mm_slli_epi32(_mm_add_epi32(shifts, _mm_set1_epi32(127)), 23);
+  return _mm_cvttps_epi32(_mm_castsi128_ps(exponents));
+}
+
+// Compute the masks of the bits to set in the two halves of a split-block
+// bloom filter block for the given probe.
+static inline void SplitBlockMasks(const BloomKeyProbe &probe, __m128i* lo, __m128i* hi) {
+  const __m128i h = _mm_set1_epi32(probe.initial_hash());
+  const __m128i salts_lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(kSplitBlockSalts));
+  const __m128i salts_hi = _mm_loadu_si128(
+      reinterpret_cast<const __m128i*>(kSplitBlockSalts + 4));
+  // The top 5 bits of each salted hash pick the bit within its word.
+  *lo = OneBitPerLane(_mm_srli_epi32(_mm_mullo_epi32(h, salts_lo), 27));
+  *hi = OneBitPerLane(_mm_srli_epi32(_mm_mullo_epi32(h, salts_hi), 27));
+}
+
 static int ComputeOptimalHashCount(size_t n_bits, size_t elems) {
   int n_hashes = n_bits * kNaturalLog2 / elems;
   if (n_hashes < 1) n_hashes = 1;
@@ -56,10 +88,22 @@ BloomFilterSizing BloomFilterSizing::BySizeAndFPRate(size_t n_bytes, double fp_r
 }
 
 
-BloomFilterBuilder::BloomFilterBuilder(const BloomFilterSizing &sizing)
-  : n_bits_(sizing.n_bytes() * 8),
-    bitmap_(new uint8_t[sizing.n_bytes()]),
-    n_hashes_(ComputeOptimalHashCount(n_bits_, sizing.expected_count())),
+static size_t FilterBytes(const BloomFilterSizing &sizing, BloomFilterLayout layout) {
+  if (layout == SPLIT_BLOCK_BLOOM_FILTER) {
+    const size_t block_bytes = 32;
+    return (sizing.n_bytes() + block_bytes - 1) / block_bytes * block_bytes;
+  }
+  return sizing.n_bytes();
+}
+
+BloomFilterBuilder::BloomFilterBuilder(const BloomFilterSizing &sizing,
+                                       BloomFilterLayout layout)
+  : layout_(layout),
+    n_bits_(FilterBytes(sizing, layout) * 8),
+    bitmap_(new uint8_t[n_bits_ / 8]),
+    n_hashes_(layout == SPLIT_BLOCK_BLOOM_FILTER ?
+              BloomFilter::kSplitBlockHashes :
+              ComputeOptimalHashCount(n_bits_, sizing.expected_count())),
     expected_count_(sizing.expected_count()),
     n_inserted_(0) {
   Clear();
@@ -75,15 +119,50 @@ double BloomFilterBuilder::false_positive_rate() const {
     << "expected_count_ not initialized: can't call this function on "
     << "a BloomFilter initialized from external data";
 
+  if (layout_ == SPLIT_BLOCK_BLOOM_FILTER) {
+    // The number of keys landing in each block is roughly Poisson-distributed.
+    // A probe is a false positive if each of the words of its block has the
+    // probed bit set by one of the keys in the block.
+    const double block_bits = BloomFilter::kSplitBlockBytes * 8;
+    const double lambda = expected_count_ * block_bits / n_bits_;
+    const double word_bits = block_bits / BloomFilter::kSplitBlockHashes;
+    const int max_keys = static_cast<int>(lambda + 10 * sqrt(lambda) + 20);
+    double p_keys = exp(-lambda);
+    double fp_rate = 0;
+    for (int i = 0; i <= max_keys; i++) {
+      fp_rate += p_keys * pow(1 - pow(1 - 1 / word_bits, i), n_hashes_);
+      p_keys *= lambda / (i + 1);
+    }
+    return fp_rate;
+  }
   return pow(1 - exp(-static_cast<double>(n_hashes_) * expected_count_ / n_bits_), n_hashes_);
 }
 
-BloomFilter::BloomFilter(const Slice &data, size_t n_hashes)
-  : n_bits_(data.size() * 8),
+BloomFilter::BloomFilter(const Slice &data, size_t n_hashes, BloomFilterLayout layout)
+  : layout_(layout),
+    n_bits_(data.size() * 8),
     bitmap_(reinterpret_cast<const uint8_t *>(data.data())),
-    n_hashes_(n_hashes)
-{}
+    n_hashes_(n_hashes) {
+  DCHECK(layout_ != SPLIT_BLOCK_BLOOM_FILTER ||
+         (data.size() % kSplitBlockBytes == 0 && n_hashes == kSplitBlockHashes));
+}
 
+void BloomFilter::SplitBlockSet(const BloomKeyProbe &probe, uint8_t* block) {
+  __m128i lo, hi;
+  SplitBlockMasks(probe, &lo, &hi);
+  __m128i* words = reinterpret_cast<__m128i*>(block);
+  _mm_storeu_si128(words, _mm_or_si128(_mm_loadu_si128(words), lo));
+  _mm_storeu_si128(words + 1, _mm_or_si128(_mm_loadu_si128(words + 1), hi));
+}
+
+bool BloomFilter::SplitBlockTest(const BloomKeyProbe &probe, const uint8_t* block) {
+  __m128i lo, hi;
+  SplitBlockMasks(probe, &lo, &hi);
+  const __m128i* words = reinterpret_cast<const __m128i*>(block);
+  // _mm_testc_si128(a, b) is set if all of the bits of 'b' are set in 'a'.
+  return _mm_testc_si128(_mm_loadu_si128(words), lo) &
+         _mm_testc_si128(_mm_loadu_si128(words + 1), hi);
+}
 
 
 } // namespace kudu
@@ -23,11 +23,30 @@
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/hash/city.h"
 #include "kudu/gutil/macros.h"
+#include "kudu/gutil/port.h"
 #include "kudu/util/bitmap.h"
 #include "kudu/util/slice.h"
 
 namespace kudu {
 
+// The arrangement of the bits of a bloom filter.
+enum BloomFilterLayout {
+  // Each key sets n_hashes bits anywhere in the filter, so that probing for a
+  // key may touch a different cache line for each of its hashes.
+  CLASSIC_BLOOM_FILTER,
+
+  // The filter is split into 256-bit blocks, made of eight 32-bit words. Each
+  // key sets one bit in each word of a single block, chosen by the key's hash,
+  // so that probing for a key touches a single block, which is checked with
+  // a couple of SIMD operations.
+  //
+  // For the same size, the false positive rate is somewhat higher than that
+  // of a classic bloom filter. See:
+  //   "Cache-, Hash- and Space-Efficient Bloom Filters"
+  //   Putze, Sanders, and Singler, WEA 2007
+  SPLIT_BLOCK_BLOOM_FILTER,
+};
+
 // Probe calculated from a given key. This caches the calculated
 // hash values which are necessary for probing into a Bloom Filter,
 // so that when many bloom filters have to be consulted for a given
@@ -76,6 +95,12 @@ class BloomKeyProbe {
     return h + h_2_;
   }
 
+  // The hash used to pick the block of a split-block bloom filter. The bits
+  // within the block are picked from initial_hash().
+  uint32_t block_hash() const {
+    return h_2_;
+  }
+
  private:
   Slice key_;
 
@@ -116,9 +141,11 @@ class BloomFilterSizing {
 // Builder for a BloomFilter structure.
 class BloomFilterBuilder {
  public:
-  // Create a bloom filter.
-  // See BloomFilterSizing static methods to specify this argument.
-  explicit BloomFilterBuilder(const BloomFilterSizing &sizing);
+  // Create a bloom filter with the given layout.
+  // See BloomFilterSizing static methods to specify the sizing argument. The
+  // size of a split-block filter is rounded up to a whole number of blocks.
+  explicit BloomFilterBuilder(const BloomFilterSizing &sizing,
+                              BloomFilterLayout layout = CLASSIC_BLOOM_FILTER);
 
   // Clear all entries, reset insertion count.
   void Clear();
@@ -152,9 +179,13 @@ class BloomFilterBuilder {
   // Return the number of keys inserted.
   size_t count() const { return n_inserted_; }
 
+  BloomFilterLayout layout() const { return layout_; }
+
  private:
   DISALLOW_COPY_AND_ASSIGN(BloomFilterBuilder);
 
+  const BloomFilterLayout layout_;
+
   size_t n_bits_;
   gscoped_array<uint8_t> bitmap_;
 
@@ -172,16 +203,45 @@ class BloomFilterBuilder {
 // Wrapper around a byte array for reading it as a bloom filter.
 class BloomFilter {
  public:
-  BloomFilter() : bitmap_(nullptr) {}
-  BloomFilter(const Slice &data, size_t n_hashes);
+  BloomFilter() : layout_(CLASSIC_BLOOM_FILTER), bitmap_(nullptr) {}
+  BloomFilter(const Slice &data, size_t n_hashes,
+              BloomFilterLayout layout = CLASSIC_BLOOM_FILTER);
+
+  // The number of hashes of a split-block filter: one per word of a block.
+  static const int kSplitBlockHashes = 8;
+  // The size of a block of a split-block filter.
+  static const int kSplitBlockBytes = 32;
 
   // Return true if the filter may contain the given key.
   bool MayContainKey(const BloomKeyProbe &probe) const;
 
+  // Prefetch the part of a split-block filter which MayContainKey() reads for
+  // the given key. Probing a batch of keys is faster if all of their blocks
+  // are prefetched before any of them is tested. A no-op for classic filters.
+  void Prefetch(const BloomKeyProbe &probe) const;
+
+  // Return the bitmap of the filter.
+  Slice data() const {
+    return Slice(bitmap_, n_bits_ / 8);
+  }
+
  private:
   friend class BloomFilterBuilder;
   static uint32_t PickBit(uint32_t hash, size_t n_bits);
 
+  // Return the index of the split-block filter block for 'probe', for a
+  // filter of 'n_bits' bits.
+  static size_t PickBlock(const BloomKeyProbe &probe, size_t n_bits);
+
+  // Set the bits for 'probe' in the given split-block filter block.
+  static void SplitBlockSet(const BloomKeyProbe &probe, uint8_t* block);
+
+  // Return true if all the bits for 'probe' are set in the given split-block
+  // filter block.
+  static bool SplitBlockTest(const BloomKeyProbe &probe, const uint8_t* block);
+
+  BloomFilterLayout layout_;
+
   size_t n_bits_;
   const uint8_t *bitmap_;
 
@@ -205,7 +265,19 @@ inline uint32_t BloomFilter::PickBit(uint32_t hash, size_t n_bits) {
   }
 }
 
+inline size_t BloomFilter::PickBlock(const BloomKeyProbe &probe, size_t n_bits) {
+  // Map the hash onto [0, n_blocks) with a multiplication rather than a division.
+  const uint64_t n_blocks = n_bits / (kSplitBlockBytes * 8);
+  return static_cast<size_t>((static_cast<uint64_t>(probe.block_hash()) * n_blocks) >> 32);
+}
+
 inline void BloomFilterBuilder::AddKey(const BloomKeyProbe &probe) {
+  if (layout_ == SPLIT_BLOCK_BLOOM_FILTER) {
+    size_t block = BloomFilter::PickBlock(probe, n_bits_);
+    BloomFilter::SplitBlockSet(probe, &bitmap_[block * BloomFilter::kSplitBlockBytes]);
+    n_inserted_++;
+    return;
+  }
   uint32_t h = probe.initial_hash();
   for (size_t i = 0; i < n_hashes_; i++) {
     uint32_t bitpos = BloomFilter::PickBit(h, n_bits_);
@@ -215,7 +287,17 @@ inline void BloomFilterBuilder::AddKey(const BloomKeyProbe &probe) {
   n_inserted_++;
 }
 
+inline void BloomFilter::Prefetch(const BloomKeyProbe &probe) const {
+  if (layout_ == SPLIT_BLOCK_BLOOM_FILTER) {
+    prefetch(reinterpret_cast<const char *>(
+        &bitmap_[PickBlock(probe, n_bits_) * kSplitBlockBytes]), PREFETCH_HINT_T0);
+  }
+}
+
 inline bool BloomFilter::MayContainKey(const BloomKeyProbe &probe) const {
+  if (layout_ == SPLIT_BLOCK_BLOOM_FILTER) {
+    return SplitBlockTest(probe, &bitmap_[PickBlock(probe, n_bits_) * kSplitBlockBytes]);
+  }
   uint32_t h = probe.initial_hash();
 
   // Basic unrolling by 2s gives a small benefit here since the two bit positions
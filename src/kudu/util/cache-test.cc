@@ -2,10 +2,13 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <atomic>
 #include <cassert>
+#include <cstdint>
 #include <cstring>
 #include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <glog/logging.h>
@@ -16,16 +19,28 @@
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/ref_counted.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/sysinfo.h"
 #include "kudu/util/cache.h"
 #include "kudu/util/coding.h"
 #include "kudu/util/env.h"
 #include "kudu/util/faststring.h"
 #include "kudu/util/mem_tracker.h"
 #include "kudu/util/metrics.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/random.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/test_macros.h"
 #include "kudu/util/test_util.h"
 
+DECLARE_bool(cache_force_single_shard);
+
+DEFINE_int32(cache_bench_threads, 0,
+             "Number of threads looking up entries in ConcurrentLookupBenchmark. "
+             "0 means one thread per CPU.");
+DEFINE_int32(cache_bench_lookups_per_thread, 100000,
+             "Number of lookups each thread issues in ConcurrentLookupBenchmark.");
+
 #if defined(__linux__)
 DECLARE_string(nvm_cache_path);
 #endif // defined(__linux__)
@@ -72,10 +87,13 @@ class CacheTest : public KuduTest,
 
     cache_.reset(NewLRUCache(GetParam(), kCacheSize, "cache_test"));
 
-    MemTracker::FindTracker("cache_test-sharded_lru_cache", &mem_tracker_);
+    MemTracker::FindTracker(GetParam() == DRAM_CLOCK_CACHE ?
+                            "cache_test-sharded_clock_cache" :
+                            "cache_test-sharded_lru_cache",
+                            &mem_tracker_);
     // Since nvm cache does not have memtracker due to the use of
-    // tcmalloc for this we only check for it in the DRAM case.
-    if (GetParam() == DRAM_CACHE) {
+    // tcmalloc for this we only check for it in the DRAM cases.
+    if (GetParam() != NVM_CACHE) {
       ASSERT_TRUE(mem_tracker_.get());
     }
 
@@ -108,9 +126,11 @@ class CacheTest : public KuduTest,
 };
 
 #if defined(__linux__)
-INSTANTIATE_TEST_CASE_P(CacheTypes, CacheTest, ::testing::Values(DRAM_CACHE, NVM_CACHE));
+INSTANTIATE_TEST_CASE_P(CacheTypes, CacheTest,
+                        ::testing::Values(DRAM_CACHE, NVM_CACHE, DRAM_CLOCK_CACHE));
 #else
-INSTANTIATE_TEST_CASE_P(CacheTypes, CacheTest, ::testing::Values(DRAM_CACHE));
+INSTANTIATE_TEST_CASE_P(CacheTypes, CacheTest,
+                        ::testing::Values(DRAM_CACHE, DRAM_CLOCK_CACHE));
 #endif // defined(__linux__)
 
 TEST_P(CacheTest, TrackMemory) {
@@ -210,6 +230,50 @@ TEST_P(CacheTest, EvictionPolicy) {
   ASSERT_EQ(-1, Lookup(200));
 }
 
+// Measures the lookup throughput of many threads hitting a small set of hot
+// entries, as point reads of a few hot blocks do.
+TEST_P(CacheTest, ConcurrentLookupBenchmark) {
+  const int kNumKeys = 1024;
+  for (int i = 0; i < kNumKeys; i++) {
+    Insert(i, i);
+  }
+
+  const int num_threads = FLAGS_cache_bench_threads > 0 ?
+      FLAGS_cache_bench_threads : base::NumCPUs();
+  const int lookups_per_thread = FLAGS_cache_bench_lookups_per_thread;
+  std::atomic<bool> go(false);
+  std::atomic<int64_t> misses(0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; t++) {
+    threads.emplace_back([&, t]() {
+      Random rng(SeedRandom() + t);
+      while (!go) {}
+      int64_t thread_misses = 0;
+      for (int i = 0; i < lookups_per_thread; i++) {
+        // Skewed() picks small keys far more often than large ones.
+        int key = rng.Skewed(10);
+        if (Lookup(key) != key) {
+          thread_misses++;
+        }
+      }
+      misses += thread_misses;
+    });
+  }
+  MonoTime start = MonoTime::Now();
+  go = true;
+  for (auto& t : threads) {
+    t.join();
+  }
+  MonoDelta elapsed = MonoTime::Now() - start;
+  ASSERT_EQ(0, misses);
+
+  int64_t total_lookups = static_cast<int64_t>(num_threads) * lookups_per_thread;
+  LOG(INFO) << strings::Substitute(
+      "$0 threads did $1 lookups in $2: $3 lookups/sec",
+      num_threads, total_lookups, elapsed.ToString(),
+      static_cast<int64_t>(total_lookups / elapsed.ToSeconds()));
+}
+
 TEST_P(CacheTest, HeavyEntries) {
   // Add a bunch of light and heavy entries and then count the combined
   // size of items still in the cache, which must be approximately the
@@ -237,4 +301,107 @@ TEST_P(CacheTest, HeavyEntries) {
   ASSERT_LE(cached_weight, kCacheSize + kCacheSize/10);
 }
 
+// Tests for the high-priority pool of the DRAM cache. These use a single
+// shard so that the capacity of each pool is exact.
+class CachePriorityTest : public KuduTest {
+ public:
+  void SetUp() override {
+    KuduTest::SetUp();
+    FLAGS_cache_force_single_shard = true;
+  }
+
+ protected:
+  void CreateCache(double high_priority_pool_ratio) {
+    cache_.reset(NewLRUCache(DRAM_CACHE, kCacheSize, "cache_priority_test",
+                             high_priority_pool_ratio));
+  }
+
+  bool Contains(int key, Cache::CacheBehavior behavior = Cache::EXPECT_IN_CACHE) {
+    Cache::Handle* handle = cache_->Lookup(EncodeInt(key), behavior);
+    if (handle == nullptr) {
+      return false;
+    }
+    cache_->Release(handle);
+    return true;
+  }
+
+  void Insert(int key, Cache::Priority priority) {
+    std::string key_str = EncodeInt(key);
+    Cache::PendingHandle* handle = CHECK_NOTNULL(
+        cache_->Allocate(key_str, key_str.size(), 1, priority));
+    memcpy(cache_->MutableValue(handle), key_str.data(), key_str.size());
+    cache_->Release(cache_->Insert(handle, nullptr));
+  }
+
+  // Insert 'n' normal-priority entries which are never looked up, as a scan
+  // which doesn't expect to find its entries in the cache would.
+  void Scan(int first_key, int n) {
+    for (int i = 0; i < n; i++) {
+      Insert(first_key + i, Cache::NORMAL_PRIORITY);
+    }
+  }
+
+  static const int kCacheSize = 100;
+  gscoped_ptr<Cache> cache_;
+};
+
+TEST_F(CachePriorityTest, HighPriorityEntriesSurviveScan) {
+  for (double ratio : { 0.0, 0.2 }) {
+    SCOPED_TRACE(ratio);
+    CreateCache(ratio);
+    for (int i = 0; i < 10; i++) {
+      Insert(i, Cache::HIGH_PRIORITY);
+    }
+    Scan(1000, 10 * kCacheSize);
+    for (int i = 0; i < 10; i++) {
+      // Without a high-priority pool, the priority has no effect.
+      ASSERT_EQ(ratio > 0, Contains(i));
+    }
+  }
+}
+
+TEST_F(CachePriorityTest, HitEntriesArePromoted) {
+  CreateCache(0.2);
+  Insert(1, Cache::NORMAL_PRIORITY);
+  Insert(2, Cache::NORMAL_PRIORITY);
+
+  // A caching lookup moves the entry into the high-priority pool, but a
+  // non-caching one leaves it where it was.
+  ASSERT_TRUE(Contains(1, Cache::EXPECT_IN_CACHE));
+  ASSERT_TRUE(Contains(2, Cache::NO_EXPECT_IN_CACHE));
+  Scan(1000, 10 * kCacheSize);
+  ASSERT_TRUE(Contains(1));
+  ASSERT_FALSE(Contains(2));
+}
+
+TEST_F(CachePriorityTest, HighPriorityPoolIsBounded) {
+  CreateCache(0.2);
+  const int kHighPriPoolSize = kCacheSize / 5;
+  for (int i = 0; i < 2 * kHighPriPoolSize; i++) {
+    Insert(i, Cache::HIGH_PRIORITY);
+  }
+  // The oldest high-priority entries overflowed into the low-priority pool,
+  // so the scan evicts them.
+  Scan(1000, 10 * kCacheSize);
+  for (int i = 0; i < 2 * kHighPriPoolSize; i++) {
+    ASSERT_EQ(i >= kHighPriPoolSize, Contains(i)) << i;
+  }
+}
+
+TEST_F(CachePriorityTest, GetHottestKeys) {
+  CreateCache(0.2);
+  Insert(1, Cache::NORMAL_PRIORITY);
+  Insert(2, Cache::HIGH_PRIORITY);
+  Insert(3, Cache::NORMAL_PRIORITY);
+
+  // The high-priority pool comes first, then the rest, newest first.
+  std::vector<std::string> keys;
+  cache_->GetHottestKeys(10, &keys);
+  ASSERT_EQ((std::vector<std::string>{ EncodeInt(2), EncodeInt(3), EncodeInt(1) }), keys);
+
+  keys.clear();
+  cache_->GetHottestKeys(2, &keys);
+  ASSERT_EQ((std::vector<std::string>{ EncodeInt(2), EncodeInt(3) }), keys);
+}
+
 }  // namespace kudu
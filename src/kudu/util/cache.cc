@@ -2,12 +2,14 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <algorithm>
 #include <cstdint>
 #include <cstring>
 #include <memory>
 #include <mutex>
 #include <ostream>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <gflags/gflags.h>
@@ -29,6 +31,7 @@
 #include "kudu/util/cache.h"
 #include "kudu/util/cache_metrics.h"
 #include "kudu/util/flag_tags.h"
+#include "kudu/util/hugepage_allocator.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/mem_tracker.h"
 #include "kudu/util/metrics.h"
@@ -53,10 +56,28 @@ namespace kudu {
 Cache::~Cache() {
 }
 
+void Cache::SetMetrics(const scoped_refptr<MetricEntity>& metric_entity) {
+  SetMetrics(std::unique_ptr<CacheMetrics>(new CacheMetrics(metric_entity)));
+}
+
 namespace {
 
 typedef simple_spinlock MutexType;
 
+// Allocates the memory of an entry, from the huge page slabs if they can
+// serve it and from the heap otherwise.
+uint8_t* AllocateEntryMemory(size_t size) {
+  void* data = HugePageSlabAllocator::Get()->Allocate(size);
+  return data != nullptr ? static_cast<uint8_t*>(data) : new uint8_t[size];
+}
+
+// Frees memory allocated by AllocateEntryMemory().
+void FreeEntryMemory(uint8_t* data) {
+  if (!HugePageSlabAllocator::Get()->Free(data)) {
+    delete [] data;
+  }
+}
+
 // LRU cache implementation
 
 // An entry is a variable length heap-allocated structure.  Entries
@@ -71,6 +92,10 @@ struct LRUHandle {
   uint32_t val_length;
   Atomic32 refs;
   uint32_t hash;      // Hash of key(); used for fast sharding and comparisons
+  Cache::Priority priority;
+  bool in_high_pri_pool;  // Whether the entry is in the high-priority pool
+  bool hit;               // Whether the entry was ever hit by a caching lookup
+  Atomic32 clock_referenced;  // CLOCK reference bit; unused by the LRU cache
 
   // The storage for the key/value pair itself. The data is stored as:
   //   [key bytes ...] [padding up to 8-byte boundary] [value bytes ...]
@@ -181,6 +206,18 @@ class HandleTable {
 };
 
 // A single shard of sharded cache.
+//
+// If the shard has a high-priority pool, the LRU list is split in two at
+// 'lru_low_pri_': the low-priority pool holds the older entries and the
+// high-priority pool the newer ones. HIGH_PRIORITY entries and entries which
+// have been hit are inserted at the newest end of the high-priority pool; the
+// other entries are inserted at the newest end of the low-priority pool. When
+// the high-priority pool is over its capacity, its oldest entries are moved to
+// the low-priority pool. Entries are always evicted from the oldest end of the
+// list.
+//
+// Without a high-priority pool, 'lru_low_pri_' is always the newest entry and
+// this degenerates to a plain LRU list.
 class LRUCache {
  public:
   explicit LRUCache(MemTracker* tracker);
@@ -189,6 +226,13 @@ class LRUCache {
   // Separate from constructor so caller can easily make an array of LRUCache
   void SetCapacity(size_t capacity) { capacity_ = capacity; }
 
+  // Reserve the fraction 'ratio' of the capacity for the high-priority pool.
+  // Must be called after SetCapacity() and before any entry is inserted.
+  void SetHighPriorityPoolRatio(double ratio) {
+    high_pri_pool_ratio_ = ratio;
+    high_pri_pool_capacity_ = capacity_ * ratio;
+  }
+
   void SetMetrics(CacheMetrics* metrics) { metrics_ = metrics; }
 
   Cache::Handle* Insert(LRUHandle* handle, Cache::EvictionCallback* eviction_callback);
@@ -196,10 +240,15 @@ class LRUCache {
   Cache::Handle* Lookup(const Slice& key, uint32_t hash, bool caching);
   void Release(Cache::Handle* handle);
   void Erase(const Slice& key, uint32_t hash);
+  // Append the keys of up to 'max_keys' entries to 'keys', newest first.
+  void GetNewestKeys(size_t max_keys, vector<string>* keys);
 
  private:
   void LRU_Remove(LRUHandle* e);
-  void LRU_Append(LRUHandle* e);
+  void LRU_Insert(LRUHandle* e);
+  // Move the oldest entries of the high-priority pool to the low-priority
+  // pool until the high-priority pool fits in its capacity.
+  void MaintainPoolSize();
   // Just reduce the reference count by 1.
   // Return true if last reference
   bool Unref(LRUHandle* e);
@@ -208,15 +257,21 @@ class LRUCache {
 
   // Initialized before use.
   size_t capacity_;
+  double high_pri_pool_ratio_;
+  size_t high_pri_pool_capacity_;
 
   // mutex_ protects the following state.
   MutexType mutex_;
   size_t usage_;
+  size_t high_pri_pool_usage_;
 
   // Dummy head of LRU list.
   // lru.prev is newest entry, lru.next is oldest entry.
   LRUHandle lru_;
 
+  // The newest entry of the low-priority pool, or &lru_ if that pool is empty.
+  LRUHandle* lru_low_pri_;
+
   HandleTable table_;
 
   MemTracker* mem_tracker_;
@@ -225,12 +280,17 @@ class LRUCache {
 };
 
 LRUCache::LRUCache(MemTracker* tracker)
- : usage_(0),
+ : capacity_(0),
+   high_pri_pool_ratio_(0),
+   high_pri_pool_capacity_(0),
+   usage_(0),
+   high_pri_pool_usage_(0),
    mem_tracker_(tracker),
    metrics_(nullptr) {
   // Make empty circular linked list
   lru_.next = &lru_;
   lru_.prev = &lru_;
+  lru_low_pri_ = &lru_;
 }
 
 LRUCache::~LRUCache() {
@@ -259,24 +319,55 @@ void LRUCache::FreeEntry(LRUHandle* e) {
     metrics_->cache_usage->DecrementBy(e->charge);
     metrics_->evictions->Increment();
   }
-  delete [] e;
+  FreeEntryMemory(reinterpret_cast<uint8_t*>(e));
 }
 
 void LRUCache::LRU_Remove(LRUHandle* e) {
+  if (lru_low_pri_ == e) {
+    lru_low_pri_ = e->prev;
+  }
   e->next->prev = e->prev;
   e->prev->next = e->next;
   usage_ -= e->charge;
+  if (e->in_high_pri_pool) {
+    DCHECK_GE(high_pri_pool_usage_, e->charge);
+    high_pri_pool_usage_ -= e->charge;
+  }
 }
 
-void LRUCache::LRU_Append(LRUHandle* e) {
-  // Make "e" newest entry by inserting just before lru_
-  e->next = &lru_;
-  e->prev = lru_.prev;
-  e->prev->next = e;
-  e->next->prev = e;
+void LRUCache::LRU_Insert(LRUHandle* e) {
+  if (high_pri_pool_ratio_ > 0 &&
+      (e->priority == Cache::HIGH_PRIORITY || e->hit)) {
+    // Make "e" newest entry by inserting just before lru_
+    e->next = &lru_;
+    e->prev = lru_.prev;
+    e->prev->next = e;
+    e->next->prev = e;
+    e->in_high_pri_pool = true;
+    high_pri_pool_usage_ += e->charge;
+    MaintainPoolSize();
+  } else {
+    // Make "e" the newest entry of the low-priority pool by inserting it
+    // just after lru_low_pri_.
+    e->next = lru_low_pri_->next;
+    e->prev = lru_low_pri_;
+    e->prev->next = e;
+    e->next->prev = e;
+    e->in_high_pri_pool = false;
+    lru_low_pri_ = e;
+  }
   usage_ += e->charge;
 }
 
+void LRUCache::MaintainPoolSize() {
+  while (high_pri_pool_usage_ > high_pri_pool_capacity_) {
+    lru_low_pri_ = lru_low_pri_->next;
+    DCHECK(lru_low_pri_ != &lru_);
+    lru_low_pri_->in_high_pri_pool = false;
+    high_pri_pool_usage_ -= lru_low_pri_->charge;
+  }
+}
+
 Cache::Handle* LRUCache::Lookup(const Slice& key, uint32_t hash, bool caching) {
   LRUHandle* e;
   {
@@ -284,8 +375,15 @@ Cache::Handle* LRUCache::Lookup(const Slice& key, uint32_t hash, bool caching) {
     e = table_.Lookup(key, hash);
     if (e != nullptr) {
       base::RefCountInc(&e->refs);
-      LRU_Remove(e);
-      LRU_Append(e);
+      // With a high-priority pool, only lookups which expect the entry to be
+      // in the cache count as a use of it. That keeps one-off reads of an
+      // entry (e.g. by a scan which doesn't cache its blocks) from promoting
+      // it over the entries which are used repeatedly.
+      if (caching || high_pri_pool_ratio_ == 0) {
+        e->hit = true;
+        LRU_Remove(e);
+        LRU_Insert(e);
+      }
     }
   }
 
@@ -335,7 +433,7 @@ Cache::Handle* LRUCache::Insert(LRUHandle* e, Cache::EvictionCallback *eviction_
   {
     std::lock_guard<MutexType> l(mutex_);
 
-    LRU_Append(e);
+    LRU_Insert(e);
 
     LRUHandle* old = table_.Insert(e);
     if (old != nullptr) {
@@ -386,6 +484,265 @@ void LRUCache::Erase(const Slice& key, uint32_t hash) {
   }
 }
 
+void LRUCache::GetNewestKeys(size_t max_keys, vector<string>* keys) {
+  std::lock_guard<MutexType> l(mutex_);
+  // Walking from the newest end yields the high-priority pool first.
+  size_t n = 0;
+  for (LRUHandle* e = lru_.prev; e != &lru_ && n < max_keys; e = e->prev, n++) {
+    keys->emplace_back(e->key().ToString());
+  }
+}
+
+// A single shard of the CLOCK cache.
+//
+// Lookups only take the shard lock in shared mode, and a per-CPU one at that,
+// so concurrent lookups of the same shard don't contend with each other. To
+// make that possible, a hit doesn't reorder anything: it just sets the
+// reference bit of the entry. The entries form a ring, and eviction advances
+// a "hand" around it, clearing the reference bits it passes and evicting the
+// first entry whose bit was already clear. Insertions, erasures and evictions
+// take the lock in exclusive mode.
+//
+// An entry allocated with Cache::HIGH_PRIORITY starts with its reference bit
+// set, so it survives one more sweep of the hand than other new entries.
+class ClockCache {
+ public:
+  explicit ClockCache(MemTracker* tracker);
+  ~ClockCache();
+
+  // Separate from constructor so caller can easily make an array of ClockCache
+  void SetCapacity(size_t capacity) { capacity_ = capacity; }
+
+  void SetMetrics(CacheMetrics* metrics) { metrics_ = metrics; }
+
+  Cache::Handle* Insert(LRUHandle* handle, Cache::EvictionCallback* eviction_callback);
+  // Like Cache::Lookup, but with an extra "hash" parameter.
+  Cache::Handle* Lookup(const Slice& key, uint32_t hash, bool caching);
+  void Release(Cache::Handle* handle);
+  void Erase(const Slice& key, uint32_t hash);
+
+ private:
+  // Add 'e' to the ring, just behind the hand, so that it is the last entry
+  // the hand visits.
+  void Ring_Insert(LRUHandle* e);
+  void Ring_Remove(LRUHandle* e);
+  // Advance the hand to the next entry to evict and remove that entry from
+  // the ring and the table. The ring must not be empty.
+  LRUHandle* EvictOne();
+  // Just reduce the reference count by 1.
+  // Return true if last reference
+  bool Unref(LRUHandle* e);
+  // Call the user's eviction callback, if it exists, and free the entry.
+  void FreeEntry(LRUHandle* e);
+
+  // Initialized before use.
+  size_t capacity_;
+
+  // lock_ protects the following state. Lookups hold it in shared mode,
+  // everything else in exclusive mode.
+  percpu_rwlock lock_;
+  size_t usage_;
+
+  // The next entry of the ring to consider for eviction, or NULL if the ring
+  // is empty. Entries are linked into the ring through their 'next' and
+  // 'prev' members.
+  LRUHandle* hand_;
+
+  HandleTable table_;
+
+  MemTracker* mem_tracker_;
+
+  CacheMetrics* metrics_;
+};
+
+ClockCache::ClockCache(MemTracker* tracker)
+ : capacity_(0),
+   usage_(0),
+   hand_(nullptr),
+   mem_tracker_(tracker),
+   metrics_(nullptr) {
+}
+
+ClockCache::~ClockCache() {
+  while (hand_ != nullptr) {
+    LRUHandle* e = hand_;
+    DCHECK_EQ(e->refs, 1);  // Error if caller has an unreleased handle
+    Ring_Remove(e);
+    if (Unref(e)) {
+      FreeEntry(e);
+    }
+  }
+}
+
+bool ClockCache::Unref(LRUHandle* e) {
+  DCHECK_GT(ANNOTATE_UNPROTECTED_READ(e->refs), 0);
+  return !base::RefCountDec(&e->refs);
+}
+
+void ClockCache::FreeEntry(LRUHandle* e) {
+  DCHECK_EQ(ANNOTATE_UNPROTECTED_READ(e->refs), 0);
+  if (e->eviction_callback) {
+    e->eviction_callback->EvictedEntry(e->key(), e->value());
+  }
+  mem_tracker_->Release(e->charge);
+  if (PREDICT_TRUE(metrics_)) {
+    metrics_->cache_usage->DecrementBy(e->charge);
+    metrics_->evictions->Increment();
+  }
+  FreeEntryMemory(reinterpret_cast<uint8_t*>(e));
+}
+
+void ClockCache::Ring_Insert(LRUHandle* e) {
+  if (hand_ == nullptr) {
+    e->next = e;
+    e->prev = e;
+    hand_ = e;
+  } else {
+    e->next = hand_;
+    e->prev = hand_->prev;
+    e->prev->next = e;
+    e->next->prev = e;
+  }
+  usage_ += e->charge;
+}
+
+void ClockCache::Ring_Remove(LRUHandle* e) {
+  if (e->next == e) {
+    DCHECK_EQ(hand_, e);
+    hand_ = nullptr;
+  } else {
+    if (hand_ == e) {
+      hand_ = e->next;
+    }
+    e->next->prev = e->prev;
+    e->prev->next = e->next;
+  }
+  usage_ -= e->charge;
+}
+
+LRUHandle* ClockCache::EvictOne() {
+  DCHECK(hand_ != nullptr);
+  // Every pass over an entry clears its bit, so this takes at most two
+  // rounds of the ring.
+  while (base::subtle::NoBarrier_Load(&hand_->clock_referenced)) {
+    base::subtle::NoBarrier_Store(&hand_->clock_referenced, 0);
+    hand_ = hand_->next;
+  }
+  LRUHandle* victim = hand_;
+  Ring_Remove(victim);
+  table_.Remove(victim->key(), victim->hash);
+  return victim;
+}
+
+Cache::Handle* ClockCache::Lookup(const Slice& key, uint32_t hash, bool caching) {
+  LRUHandle* e;
+  {
+    shared_lock<rw_spinlock> l(lock_.get_lock());
+    e = table_.Lookup(key, hash);
+    if (e != nullptr) {
+      base::RefCountInc(&e->refs);
+      // Avoid dirtying the cache line of a hot entry whose bit is already set.
+      if (!base::subtle::NoBarrier_Load(&e->clock_referenced)) {
+        base::subtle::NoBarrier_Store(&e->clock_referenced, 1);
+      }
+    }
+  }
+
+  // Do the metrics outside of the lock.
+  if (metrics_) {
+    metrics_->lookups->Increment();
+    bool was_hit = (e != nullptr);
+    if (was_hit) {
+      if (caching) {
+        metrics_->cache_hits_caching->Increment();
+      } else {
+        metrics_->cache_hits->Increment();
+      }
+    } else {
+      if (caching) {
+        metrics_->cache_misses_caching->Increment();
+      } else {
+        metrics_->cache_misses->Increment();
+      }
+    }
+  }
+
+  return reinterpret_cast<Cache::Handle*>(e);
+}
+
+void ClockCache::Release(Cache::Handle* handle) {
+  LRUHandle* e = reinterpret_cast<LRUHandle*>(handle);
+  bool last_reference = Unref(e);
+  if (last_reference) {
+    FreeEntry(e);
+  }
+}
+
+Cache::Handle* ClockCache::Insert(LRUHandle* e, Cache::EvictionCallback *eviction_callback) {
+  // Set the remaining LRUHandle members which were not already allocated during
+  // Allocate().
+  e->eviction_callback = eviction_callback;
+  e->refs = 2;  // One from ClockCache, one for the returned handle
+  e->clock_referenced = e->priority == Cache::HIGH_PRIORITY ? 1 : 0;
+  mem_tracker_->Consume(e->charge);
+  if (PREDICT_TRUE(metrics_)) {
+    metrics_->cache_usage->IncrementBy(e->charge);
+    metrics_->inserts->Increment();
+  }
+
+  LRUHandle* to_remove_head = nullptr;
+  {
+    std::lock_guard<percpu_rwlock> l(lock_);
+
+    Ring_Insert(e);
+
+    LRUHandle* old = table_.Insert(e);
+    if (old != nullptr) {
+      Ring_Remove(old);
+      if (Unref(old)) {
+        old->next = to_remove_head;
+        to_remove_head = old;
+      }
+    }
+
+    while (usage_ > capacity_ && hand_ != nullptr) {
+      LRUHandle* old = EvictOne();
+      if (Unref(old)) {
+        old->next = to_remove_head;
+        to_remove_head = old;
+      }
+    }
+  }
+
+  // we free the entries here outside of mutex for
+  // performance reasons
+  while (to_remove_head != nullptr) {
+    LRUHandle* next = to_remove_head->next;
+    FreeEntry(to_remove_head);
+    to_remove_head = next;
+  }
+
+  return reinterpret_cast<Cache::Handle*>(e);
+}
+
+void ClockCache::Erase(const Slice& key, uint32_t hash) {
+  LRUHandle* e;
+  bool last_reference = false;
+  {
+    std::lock_guard<percpu_rwlock> l(lock_);
+    e = table_.Remove(key, hash);
+    if (e != nullptr) {
+      Ring_Remove(e);
+      last_reference = Unref(e);
+    }
+  }
+  // lock not held here
+  // last_reference will only be true if e != NULL
+  if (last_reference) {
+    FreeEntry(e);
+  }
+}
+
 // Determine the number of bits of the hash that should be used to determine
 // the cache shard. This, in turn, determines the number of shards.
 int DetermineShardBits() {
@@ -395,11 +752,14 @@ int DetermineShardBits() {
   return bits;
 }
 
-class ShardedLRUCache : public Cache {
+// A cache made of independent shards of type 'ShardType', which is either
+// LRUCache or ClockCache.
+template <class ShardType>
+class ShardedCache : public Cache {
  private:
   shared_ptr<MemTracker> mem_tracker_;
-  gscoped_ptr<CacheMetrics> metrics_;
-  vector<LRUCache*> shards_;
+  std::unique_ptr<CacheMetrics> metrics_;
+  vector<ShardType*> shards_;
 
   // Number of bits of hash used to determine the shard.
   const int shard_bits_;
@@ -420,24 +780,24 @@ class ShardedLRUCache : public Cache {
   }
 
  public:
-  explicit ShardedLRUCache(size_t capacity, const string& id)
+  // 'mem_tracker_id' is the id of the MemTracker accounting for the entries.
+  ShardedCache(size_t capacity, const string& mem_tracker_id)
       : shard_bits_(DetermineShardBits()) {
     // A cache is often a singleton, so:
     // 1. We reuse its MemTracker if one already exists, and
     // 2. It is directly parented to the root MemTracker.
-    mem_tracker_ = MemTracker::FindOrCreateGlobalTracker(
-        -1, strings::Substitute("$0-sharded_lru_cache", id));
+    mem_tracker_ = MemTracker::FindOrCreateGlobalTracker(-1, mem_tracker_id);
 
     int num_shards = 1 << shard_bits_;
     const size_t per_shard = (capacity + (num_shards - 1)) / num_shards;
     for (int s = 0; s < num_shards; s++) {
-      gscoped_ptr<LRUCache> shard(new LRUCache(mem_tracker_.get()));
+      gscoped_ptr<ShardType> shard(new ShardType(mem_tracker_.get()));
       shard->SetCapacity(per_shard);
       shards_.push_back(shard.release());
     }
   }
 
-  virtual ~ShardedLRUCache() {
+  virtual ~ShardedCache() {
     STLDeleteElements(&shards_);
   }
 
@@ -461,7 +821,8 @@ class ShardedLRUCache : public Cache {
   virtual Slice Value(Handle* handle) OVERRIDE {
     return reinterpret_cast<LRUHandle*>(handle)->value();
   }
-  virtual void SetMetrics(const scoped_refptr<MetricEntity>& entity) OVERRIDE {
+  using Cache::SetMetrics;
+  virtual void SetMetrics(std::unique_ptr<CacheMetrics> metrics) OVERRIDE {
     // TODO(KUDU-2165): reuse of the Cache singleton across multiple MiniCluster servers
     // causes TSAN errors. So, we'll ensure that metrics only get attached once, from
     // whichever server starts first. This has the downside that, in test builds, we won't
@@ -471,48 +832,89 @@ class ShardedLRUCache : public Cache {
       CHECK(IsGTest()) << "Metrics should only be set once per Cache singleton";
       return;
     }
-    metrics_.reset(new CacheMetrics(entity));
-    for (LRUCache* cache : shards_) {
+    metrics_ = std::move(metrics);
+    for (ShardType* cache : shards_) {
       cache->SetMetrics(metrics_.get());
     }
   }
 
   virtual PendingHandle* Allocate(Slice key, int val_len, int charge) OVERRIDE {
+    return Allocate(key, val_len, charge, NORMAL_PRIORITY);
+  }
+
+  virtual PendingHandle* Allocate(Slice key, int val_len, int charge,
+                                  Priority priority) OVERRIDE {
     int key_len = key.size();
     DCHECK_GE(key_len, 0);
     DCHECK_GE(val_len, 0);
     int key_len_padded = KUDU_ALIGN_UP(key_len, sizeof(void*));
-    uint8_t* buf = new uint8_t[sizeof(LRUHandle)
-                               + key_len_padded + val_len // the kv_data VLA data
-                               - 1 // (the VLA has a 1-byte placeholder)
-                               ];
+    uint8_t* buf = AllocateEntryMemory(sizeof(LRUHandle)
+                                       + key_len_padded + val_len // the kv_data VLA data
+                                       - 1 // (the VLA has a 1-byte placeholder)
+                                       );
     LRUHandle* handle = reinterpret_cast<LRUHandle*>(buf);
     handle->key_length = key_len;
     handle->val_length = val_len;
     handle->charge = charge;
     handle->hash = HashSlice(key);
+    handle->priority = priority;
+    handle->in_high_pri_pool = false;
+    handle->hit = false;
+    handle->clock_referenced = 0;
     memcpy(handle->kv_data, key.data(), key_len);
 
     return reinterpret_cast<PendingHandle*>(handle);
   }
 
   virtual void Free(PendingHandle* h) OVERRIDE {
-    uint8_t* data = reinterpret_cast<uint8_t*>(h);
-    delete [] data;
+    FreeEntryMemory(reinterpret_cast<uint8_t*>(h));
   }
 
   virtual uint8_t* MutableValue(PendingHandle* h) OVERRIDE {
     return reinterpret_cast<LRUHandle*>(h)->mutable_val_ptr();
   }
 
+ protected:
+  const vector<ShardType*>& shards() const { return shards_; }
+};
+
+class ShardedLRUCache : public ShardedCache<LRUCache> {
+ public:
+  ShardedLRUCache(size_t capacity, const string& id, double high_priority_pool_ratio)
+      : ShardedCache(capacity, strings::Substitute("$0-sharded_lru_cache", id)) {
+    CHECK(high_priority_pool_ratio >= 0 && high_priority_pool_ratio <= 1)
+        << "invalid high-priority pool ratio: " << high_priority_pool_ratio;
+    for (LRUCache* shard : shards()) {
+      shard->SetHighPriorityPoolRatio(high_priority_pool_ratio);
+    }
+  }
+
+  virtual void GetHottestKeys(size_t max_keys, vector<string>* keys) OVERRIDE {
+    // The keys are hashed uniformly across the shards, so each of them
+    // contributes an equal share.
+    const size_t per_shard = (max_keys + shards().size() - 1) / shards().size();
+    for (LRUCache* shard : shards()) {
+      shard->GetNewestKeys(std::min(per_shard, max_keys - keys->size()), keys);
+    }
+  }
+};
+
+class ShardedClockCache : public ShardedCache<ClockCache> {
+ public:
+  ShardedClockCache(size_t capacity, const string& id)
+      : ShardedCache(capacity, strings::Substitute("$0-sharded_clock_cache", id)) {
+  }
 };
 
 }  // end anonymous namespace
 
-Cache* NewLRUCache(CacheType type, size_t capacity, const string& id) {
+Cache* NewLRUCache(CacheType type, size_t capacity, const string& id,
+                   double high_priority_pool_ratio) {
   switch (type) {
     case DRAM_CACHE:
-      return new ShardedLRUCache(capacity, id);
+      return new ShardedLRUCache(capacity, id, high_priority_pool_ratio);
+    case DRAM_CLOCK_CACHE:
+      return new ShardedClockCache(capacity, id);
 #if !defined(__APPLE__)
     case NVM_CACHE:
       return NewLRUNvmCache(capacity, id);
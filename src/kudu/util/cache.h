@@ -22,6 +22,7 @@
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/ref_counted.h"
@@ -31,15 +32,28 @@ namespace kudu {
 
 class Cache;
 class MetricEntity;
+struct CacheMetrics;
 
 enum CacheType {
   DRAM_CACHE,
-  NVM_CACHE
+  NVM_CACHE,
+  // A DRAM cache which trades the LRU eviction policy for the CLOCK
+  // approximation of it, so that lookups don't serialize on a shard lock.
+  DRAM_CLOCK_CACHE
 };
 
 // Create a new cache with a fixed size capacity.  This implementation
 // of Cache uses a least-recently-used eviction policy.
-Cache* NewLRUCache(CacheType type, size_t capacity, const std::string& id);
+//
+// If 'high_priority_pool_ratio' is greater than 0, that fraction of the
+// capacity of a DRAM cache is reserved for entries allocated with
+// Cache::HIGH_PRIORITY and for entries which have been hit at least once
+// since their insertion. Other entries are inserted at the midpoint of the
+// LRU list, so that a burst of entries which are never used again is
+// evicted before the protected entries are. The NVM and CLOCK caches ignore
+// the ratio.
+Cache* NewLRUCache(CacheType type, size_t capacity, const std::string& id,
+                   double high_priority_pool_ratio = 0);
 
 class Cache {
  public:
@@ -101,6 +115,8 @@ class Cache {
   // with the basic metrics.
   // Passing NO_EXPECT_IN_CACHE will only increment the basic metrics.
   // This helps in determining if we are effectively caching the blocks that matter the most.
+  // In a cache with a high-priority pool, a NO_EXPECT_IN_CACHE hit also leaves the
+  // position of the entry in the LRU list unchanged.
   enum CacheBehavior {
     EXPECT_IN_CACHE,
     NO_EXPECT_IN_CACHE
@@ -129,8 +145,19 @@ class Cache {
   // to it have been released.
   virtual void Erase(const Slice& key) = 0;
 
+  // Append to 'keys' the keys of up to 'max_keys' of the entries least
+  // likely to be evicted next, the most valuable first. Used to persist the
+  // contents of the cache across restarts. The default implementation
+  // appends nothing.
+  virtual void GetHottestKeys(size_t max_keys, std::vector<std::string>* keys) {}
+
   // Pass a metric entity in order to start recoding metrics.
-  virtual void SetMetrics(const scoped_refptr<MetricEntity>& metric_entity) = 0;
+  //
+  // The cache reports to the block cache metrics of the entity.
+  void SetMetrics(const scoped_refptr<MetricEntity>& metric_entity);
+
+  // Start recording metrics into 'metrics'.
+  virtual void SetMetrics(std::unique_ptr<CacheMetrics> metrics) = 0;
 
   // ------------------------------------------------------------
   // Insertion path
@@ -157,6 +184,16 @@ class Cache {
   // the cache.
   struct PendingHandle { };
 
+  // The eviction priority of an entry. In caches configured with a
+  // high-priority pool, HIGH_PRIORITY entries are inserted into that pool
+  // and so survive longer than NORMAL_PRIORITY entries inserted at the
+  // same time. The CLOCK cache gives them one extra sweep of its hand
+  // before eviction. Other caches treat all entries alike.
+  enum Priority {
+    NORMAL_PRIORITY,
+    HIGH_PRIORITY
+  };
+
   // Allocate space for a new entry to be inserted into the cache.
   //
   // The provided 'key' is copied into the resulting handle object.
@@ -173,6 +210,12 @@ class Cache {
   // caller must either free it using Free(), or insert it using Insert().
   virtual PendingHandle* Allocate(Slice key, int val_len, int charge) = 0;
 
+  // As above, but with an eviction priority for the entry. The default
+  // implementation ignores the priority.
+  virtual PendingHandle* Allocate(Slice key, int val_len, int charge, Priority priority) {
+    return Allocate(key, val_len, charge);
+  }
+
   virtual uint8_t* MutableValue(PendingHandle* handle) = 0;
 
   // Commit a prepared entry into the cache.
@@ -49,6 +49,74 @@ METRIC_DEFINE_gauge_uint64(server, block_cache_usage, "Block Cache Memory Usage"
                            kudu::MetricUnit::kBytes,
                            "Memory consumed by the block cache");
 
+METRIC_DEFINE_counter(server, block_cache_compressed_inserts,
+                      "Compressed Block Cache Inserts", kudu::MetricUnit::kBlocks,
+                      "Number of compressed blocks inserted in the compressed tier of the "
+                      "block cache");
+METRIC_DEFINE_counter(server, block_cache_compressed_lookups,
+                      "Compressed Block Cache Lookups", kudu::MetricUnit::kBlocks,
+                      "Number of blocks looked up from the compressed tier of the block cache");
+METRIC_DEFINE_counter(server, block_cache_compressed_evictions,
+                      "Compressed Block Cache Evictions", kudu::MetricUnit::kBlocks,
+                      "Number of compressed blocks evicted from the compressed tier of the "
+                      "block cache");
+METRIC_DEFINE_counter(server, block_cache_compressed_misses,
+                      "Compressed Block Cache Misses", kudu::MetricUnit::kBlocks,
+                      "Number of lookups in the compressed tier of the block cache that "
+                      "didn't yield a block");
+METRIC_DEFINE_counter(server, block_cache_compressed_misses_caching,
+                      "Compressed Block Cache Misses (Caching)", kudu::MetricUnit::kBlocks,
+                      "Number of lookups in the compressed tier of the block cache that were "
+                      "expecting a block that didn't yield one");
+METRIC_DEFINE_counter(server, block_cache_compressed_hits,
+                      "Compressed Block Cache Hits", kudu::MetricUnit::kBlocks,
+                      "Number of lookups in the compressed tier of the block cache that "
+                      "found a block");
+METRIC_DEFINE_counter(server, block_cache_compressed_hits_caching,
+                      "Compressed Block Cache Hits (Caching)", kudu::MetricUnit::kBlocks,
+                      "Number of lookups in the compressed tier of the block cache that were "
+                      "expecting a block that found one. Each one of these saved a disk read "
+                      "at the cost of decompressing the block");
+
+METRIC_DEFINE_gauge_uint64(server, block_cache_compressed_usage,
+                           "Compressed Block Cache Memory Usage",
+                           kudu::MetricUnit::kBytes,
+                           "Memory consumed by the compressed tier of the block cache");
+
+METRIC_DEFINE_counter(server, block_cache_nvm_inserts,
+                      "NVM Block Cache Inserts", kudu::MetricUnit::kBlocks,
+                      "Number of blocks demoted from the DRAM block cache into its NVM tier");
+METRIC_DEFINE_counter(server, block_cache_nvm_lookups,
+                      "NVM Block Cache Lookups", kudu::MetricUnit::kBlocks,
+                      "Number of blocks looked up from the NVM tier of the block cache, "
+                      "after missing the DRAM block cache");
+METRIC_DEFINE_counter(server, block_cache_nvm_evictions,
+                      "NVM Block Cache Evictions", kudu::MetricUnit::kBlocks,
+                      "Number of blocks evicted from the NVM tier of the block cache, "
+                      "including the blocks promoted back to the DRAM block cache");
+METRIC_DEFINE_counter(server, block_cache_nvm_misses,
+                      "NVM Block Cache Misses", kudu::MetricUnit::kBlocks,
+                      "Number of lookups in the NVM tier of the block cache that "
+                      "didn't yield a block");
+METRIC_DEFINE_counter(server, block_cache_nvm_misses_caching,
+                      "NVM Block Cache Misses (Caching)", kudu::MetricUnit::kBlocks,
+                      "Number of lookups in the NVM tier of the block cache that were "
+                      "expecting a block that didn't yield one");
+METRIC_DEFINE_counter(server, block_cache_nvm_hits,
+                      "NVM Block Cache Hits", kudu::MetricUnit::kBlocks,
+                      "Number of lookups in the NVM tier of the block cache that "
+                      "found a block");
+METRIC_DEFINE_counter(server, block_cache_nvm_hits_caching,
+                      "NVM Block Cache Hits (Caching)", kudu::MetricUnit::kBlocks,
+                      "Number of lookups in the NVM tier of the block cache that were "
+                      "expecting a block that found one. Each one of these saved a disk "
+                      "read, and promoted the block back to the DRAM block cache");
+
+METRIC_DEFINE_gauge_uint64(server, block_cache_nvm_usage,
+                           "NVM Block Cache Memory Usage",
+                           kudu::MetricUnit::kBytes,
+                           "Persistent memory consumed by the NVM tier of the block cache");
+
 namespace kudu {
 
 #define MINIT(member, x) member(METRIC_##x.Instantiate(entity))
@@ -63,6 +131,33 @@ CacheMetrics::CacheMetrics(const scoped_refptr<MetricEntity>& entity)
     MINIT(cache_misses_caching, block_cache_misses_caching),
     GINIT(cache_usage, block_cache_usage) {
 }
+
+CacheMetrics* CacheMetrics::CreateForCompressedBlockCache(
+    const scoped_refptr<MetricEntity>& entity) {
+  CacheMetrics* m = new CacheMetrics();
+  m->inserts = METRIC_block_cache_compressed_inserts.Instantiate(entity);
+  m->lookups = METRIC_block_cache_compressed_lookups.Instantiate(entity);
+  m->evictions = METRIC_block_cache_compressed_evictions.Instantiate(entity);
+  m->cache_hits = METRIC_block_cache_compressed_hits.Instantiate(entity);
+  m->cache_hits_caching = METRIC_block_cache_compressed_hits_caching.Instantiate(entity);
+  m->cache_misses = METRIC_block_cache_compressed_misses.Instantiate(entity);
+  m->cache_misses_caching = METRIC_block_cache_compressed_misses_caching.Instantiate(entity);
+  m->cache_usage = METRIC_block_cache_compressed_usage.Instantiate(entity, 0);
+  return m;
+}
+CacheMetrics* CacheMetrics::CreateForNvmBlockCache(
+    const scoped_refptr<MetricEntity>& entity) {
+  CacheMetrics* m = new CacheMetrics();
+  m->inserts = METRIC_block_cache_nvm_inserts.Instantiate(entity);
+  m->lookups = METRIC_block_cache_nvm_lookups.Instantiate(entity);
+  m->evictions = METRIC_block_cache_nvm_evictions.Instantiate(entity);
+  m->cache_hits = METRIC_block_cache_nvm_hits.Instantiate(entity);
+  m->cache_hits_caching = METRIC_block_cache_nvm_hits_caching.Instantiate(entity);
+  m->cache_misses = METRIC_block_cache_nvm_misses.Instantiate(entity);
+  m->cache_misses_caching = METRIC_block_cache_nvm_misses_caching.Instantiate(entity);
+  m->cache_usage = METRIC_block_cache_nvm_usage.Instantiate(entity, 0);
+  return m;
+}
 #undef MINIT
 #undef GINIT
 
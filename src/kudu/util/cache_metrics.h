@@ -25,8 +25,18 @@
 namespace kudu {
 
 struct CacheMetrics {
+  // Instantiates the block cache metrics of 'metric_entity'.
   explicit CacheMetrics(const scoped_refptr<MetricEntity>& metric_entity);
 
+  // Instantiates the metrics of the compressed tier of the block cache, which
+  // are kept apart from those of the uncompressed tier.
+  static CacheMetrics* CreateForCompressedBlockCache(
+      const scoped_refptr<MetricEntity>& metric_entity);
+
+  // Instantiates the metrics of the NVM tier of the block cache.
+  static CacheMetrics* CreateForNvmBlockCache(
+      const scoped_refptr<MetricEntity>& metric_entity);
+
   scoped_refptr<Counter> inserts;
   scoped_refptr<Counter> lookups;
   scoped_refptr<Counter> evictions;
@@ -36,6 +46,9 @@ struct CacheMetrics {
   scoped_refptr<Counter> cache_misses_caching;
 
   scoped_refptr<AtomicGauge<uint64_t> > cache_usage;
+
+ private:
+  CacheMetrics() {}
 };
 
 } // namespace kudu
@@ -18,20 +18,27 @@
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <memory>
+#include <string>
 #include <vector>
 
 #include <gtest/gtest.h>
 
 #include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/compression/compression.pb.h"
 #include "kudu/util/compression/compression_codec.h"
+#include "kudu/util/faststring.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/test_macros.h"
 #include "kudu/util/test_util.h"
 
 namespace kudu {
 
+using std::string;
+using std::unique_ptr;
 using std::vector;
+using strings::Substitute;
 
 class TestCompression : public KuduTest {};
 
@@ -87,4 +94,71 @@ TEST_F(TestCompression, TestZlibCompressionCodec) {
   TestCompressionCodec(ZLIB);
 }
 
+TEST_F(TestCompression, TestZstdCompressionCodec) {
+  TestCompressionCodec(ZSTD);
+}
+
+TEST_F(TestCompression, TestZstdCompressionLevels) {
+  const CompressionCodec* fast;
+  const CompressionCodec* strong;
+  ASSERT_OK(GetCompressionCodec(ZSTD, 1, &fast));
+  ASSERT_OK(GetCompressionCodec(ZSTD, 19, &strong));
+  ASSERT_NE(fast, strong);
+  ASSERT_EQ(ZSTD, strong->type());
+
+  // Out-of-range levels are clamped rather than rejected.
+  const CompressionCodec* clamped;
+  ASSERT_OK(GetCompressionCodec(ZSTD, 0, &clamped));
+  ASSERT_EQ(fast, clamped);
+
+  // Codecs without levels ignore the level.
+  const CompressionCodec* lz4;
+  const CompressionCodec* lz4_leveled;
+  ASSERT_OK(GetCompressionCodec(LZ4, &lz4));
+  ASSERT_OK(GetCompressionCodec(LZ4, 9, &lz4_leveled));
+  ASSERT_EQ(lz4, lz4_leveled);
+}
+
+// Test that a trained dictionary round-trips data compressed with it, as well
+// as data compressed without any dictionary.
+TEST_F(TestCompression, TestZstdDictionary) {
+  faststring samples;
+  vector<size_t> sample_sizes;
+  for (int i = 0; i < 1000; i++) {
+    string record = Substitute("{\"host\": \"host-$0.example.com\", \"metric\": \"cpu_$1\", "
+                               "\"value\": $2}", i % 37, i % 5, i * 7919 % 10007);
+    samples.append(record);
+    sample_sizes.push_back(record.size());
+  }
+  string dict;
+  ASSERT_OK(TrainZstdDictionary(Slice(samples), sample_sizes, 4096, &dict));
+  ASSERT_FALSE(dict.empty());
+  ASSERT_LE(dict.size(), 4096);
+
+  unique_ptr<CompressionCodec> dict_codec;
+  ASSERT_OK(NewZstdDictionaryCodec(dict, 3, &dict_codec));
+  const CompressionCodec* plain_codec;
+  ASSERT_OK(GetCompressionCodec(ZSTD, 3, &plain_codec));
+
+  const string input = "{\"host\": \"host-12.example.com\", \"metric\": \"cpu_3\", "
+                       "\"value\": 4242}";
+  gscoped_array<uint8_t> cbuffer(new uint8_t[dict_codec->MaxCompressedLength(input.size())]);
+  faststring ubuffer;
+  ubuffer.resize(input.size());
+
+  // The dictionary lets such a small input compress much better.
+  size_t dict_compressed;
+  ASSERT_OK(dict_codec->Compress(input, cbuffer.get(), &dict_compressed));
+  ASSERT_OK(dict_codec->Uncompress(Slice(cbuffer.get(), dict_compressed),
+                                   ubuffer.data(), input.size()));
+  ASSERT_EQ(input, ubuffer.ToString());
+
+  size_t plain_compressed;
+  ASSERT_OK(plain_codec->Compress(input, cbuffer.get(), &plain_compressed));
+  ASSERT_LT(dict_compressed, plain_compressed);
+  ASSERT_OK(dict_codec->Uncompress(Slice(cbuffer.get(), plain_compressed),
+                                   ubuffer.data(), input.size()));
+  ASSERT_EQ(input, ubuffer.ToString());
+}
+
 } // namespace kudu
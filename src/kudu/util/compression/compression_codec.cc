@@ -17,27 +17,38 @@
 
 #include "kudu/util/compression/compression_codec.h"
 
+#include <algorithm>
 #include <memory>
+#include <mutex>
+#include <numeric>
 #include <ostream>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <glog/logging.h>
 #include <lz4.h>
 #include <snappy-sinksource.h>
 #include <snappy.h>
+#include <zdict.h>
 #include <zlib.h>
+#include <zstd.h>
 
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/singleton.h"
 #include "kudu/gutil/stringprintf.h"
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/faststring.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/string_case.h"
+#include "kudu/util/threadlocal.h"
 
 namespace kudu {
 
+using std::string;
+using std::unique_ptr;
 using std::vector;
+using strings::Substitute;
 
 CompressionCodec::CompressionCodec() {
 }
@@ -244,7 +255,223 @@ class ZlibCodec : public CompressionCodec {
   }
 };
 
+namespace {
+
+// Per-thread ZSTD contexts. Setting up a context allocates several hundred
+// kilobytes of working memory, so contexts are reused across calls.
+struct ZstdContexts {
+  ZstdContexts()
+      : cctx(ZSTD_createCCtx()),
+        dctx(ZSTD_createDCtx()) {
+    CHECK(cctx != nullptr && dctx != nullptr) << "unable to allocate zstd contexts";
+  }
+
+  ~ZstdContexts() {
+    ZSTD_freeCCtx(cctx);
+    ZSTD_freeDCtx(dctx);
+  }
+
+  ZSTD_CCtx* const cctx;
+  ZSTD_DCtx* const dctx;
+};
+
+ZstdContexts* GetZstdContexts() {
+  BLOCK_STATIC_THREAD_LOCAL(ZstdContexts, contexts);
+  return contexts;
+}
+
+} // anonymous namespace
+
+class ZstdCodec : public CompressionCodec {
+ public:
+  // The level used when none is specified; same as ZSTD_CLEVEL_DEFAULT.
+  static const int kDefaultLevel = 3;
+
+  explicit ZstdCodec(int level)
+      : level_(level) {
+  }
+
+  static const ZstdCodec* GetSingleton(int level);
+
+  Status Compress(const Slice& input,
+                  uint8_t *compressed, size_t *compressed_length) const OVERRIDE {
+    size_t n = ZSTD_compressCCtx(GetZstdContexts()->cctx,
+                                 compressed, MaxCompressedLength(input.size()),
+                                 input.data(), input.size(), level_);
+    return CheckCompressResult(n, compressed_length);
+  }
+
+  Status Compress(const vector<Slice>& input_slices,
+                  uint8_t *compressed, size_t *compressed_length) const OVERRIDE {
+    if (input_slices.size() == 1) {
+      return Compress(input_slices[0], compressed, compressed_length);
+    }
+
+    SlicesSource source(input_slices);
+    faststring buffer;
+    source.Dump(&buffer);
+    return Compress(Slice(buffer.data(), buffer.size()), compressed, compressed_length);
+  }
+
+  Status Uncompress(const Slice& compressed,
+                    uint8_t *uncompressed, size_t uncompressed_length) const OVERRIDE {
+    size_t n = ZSTD_decompressDCtx(GetZstdContexts()->dctx,
+                                   uncompressed, uncompressed_length,
+                                   compressed.data(), compressed.size());
+    return CheckUncompressResult(n, compressed, uncompressed_length);
+  }
+
+  size_t MaxCompressedLength(size_t source_bytes) const OVERRIDE {
+    return ZSTD_compressBound(source_bytes);
+  }
+
+  CompressionType type() const override {
+    return ZSTD;
+  }
+
+  static int ClampLevel(int level) {
+    return std::max(1, std::min(level, ZSTD_maxCLevel()));
+  }
+
+ protected:
+  static Status CheckCompressResult(size_t n, size_t* compressed_length) {
+    if (ZSTD_isError(n)) {
+      return Status::IOError("unable to compress the buffer", ZSTD_getErrorName(n));
+    }
+    *compressed_length = n;
+    return Status::OK();
+  }
+
+  static Status CheckUncompressResult(size_t n, const Slice& compressed,
+                                      size_t uncompressed_length) {
+    if (ZSTD_isError(n)) {
+      return Status::Corruption(
+          Substitute("unable to uncompress the buffer: $0", ZSTD_getErrorName(n)),
+          KUDU_REDACT(compressed.ToDebugString(100)));
+    }
+    if (n != uncompressed_length) {
+      return Status::Corruption(
+          Substitute("uncompressed size $0 does not match the expected size $1",
+                     n, uncompressed_length),
+          KUDU_REDACT(compressed.ToDebugString(100)));
+    }
+    return Status::OK();
+  }
+
+  const int level_;
+};
+
+// Holds one ZstdCodec per supported compression level.
+class ZstdCodecs {
+ public:
+  ZstdCodecs() {
+    for (int level = 1; level <= ZSTD_maxCLevel(); level++) {
+      codecs_.emplace_back(new ZstdCodec(level));
+    }
+  }
+
+  const ZstdCodec* Get(int level) const {
+    return codecs_[ZstdCodec::ClampLevel(level) - 1].get();
+  }
+
+ private:
+  vector<unique_ptr<ZstdCodec>> codecs_;
+};
+
+const ZstdCodec* ZstdCodec::GetSingleton(int level) {
+  return Singleton<ZstdCodecs>::get()->Get(level);
+}
+
+// A ZSTD codec which compresses using a pre-trained dictionary.
+//
+// Each compressed frame records the ID of the dictionary it was compressed
+// with, so frames compressed without any dictionary (e.g. before the
+// dictionary was trained) are still uncompressed correctly.
+class ZstdDictionaryCodec : public ZstdCodec {
+ public:
+  ZstdDictionaryCodec(int level, string dict, ZSTD_DDict* ddict)
+      : ZstdCodec(level),
+        dict_(std::move(dict)),
+        ddict_(ddict) {
+  }
+
+  ~ZstdDictionaryCodec() {
+    ZSTD_freeCDict(cdict_);
+    ZSTD_freeDDict(ddict_);
+  }
+
+  using ZstdCodec::Compress;
+
+  Status Compress(const Slice& input,
+                  uint8_t *compressed, size_t *compressed_length) const OVERRIDE {
+    // The digested compression dictionary is several times larger than the
+    // decompression one, so it's only built on first use: readers never need it.
+    std::call_once(cdict_once_, [this] {
+      cdict_ = ZSTD_createCDict(dict_.data(), dict_.size(), level_);
+    });
+    if (PREDICT_FALSE(cdict_ == nullptr)) {
+      return Status::RuntimeError("unable to load zstd dictionary");
+    }
+    size_t n = ZSTD_compress_usingCDict(GetZstdContexts()->cctx,
+                                        compressed, MaxCompressedLength(input.size()),
+                                        input.data(), input.size(), cdict_);
+    return CheckCompressResult(n, compressed_length);
+  }
+
+  Status Uncompress(const Slice& compressed,
+                    uint8_t *uncompressed, size_t uncompressed_length) const OVERRIDE {
+    if (ZSTD_getDictID_fromFrame(compressed.data(), compressed.size()) == 0) {
+      return ZstdCodec::Uncompress(compressed, uncompressed, uncompressed_length);
+    }
+    size_t n = ZSTD_decompress_usingDDict(GetZstdContexts()->dctx,
+                                          uncompressed, uncompressed_length,
+                                          compressed.data(), compressed.size(), ddict_);
+    return CheckUncompressResult(n, compressed, uncompressed_length);
+  }
+
+ private:
+  const string dict_;
+  ZSTD_DDict* const ddict_;
+
+  mutable std::once_flag cdict_once_;
+  mutable ZSTD_CDict* cdict_ = nullptr;
+};
+
+Status TrainZstdDictionary(const Slice& samples,
+                           const vector<size_t>& sample_sizes,
+                           size_t max_dict_size,
+                           string* dict) {
+  DCHECK_EQ(samples.size(), std::accumulate(sample_sizes.begin(), sample_sizes.end(), 0UL));
+  dict->resize(max_dict_size);
+  size_t n = ZDICT_trainFromBuffer(&(*dict)[0], max_dict_size,
+                                   samples.data(), sample_sizes.data(), sample_sizes.size());
+  if (ZDICT_isError(n)) {
+    dict->clear();
+    return Status::RuntimeError("unable to train zstd dictionary", ZDICT_getErrorName(n));
+  }
+  dict->resize(n);
+  return Status::OK();
+}
+
+Status NewZstdDictionaryCodec(const Slice& dict,
+                              int level,
+                              unique_ptr<CompressionCodec>* codec) {
+  ZSTD_DDict* ddict = ZSTD_createDDict(dict.data(), dict.size());
+  if (ddict == nullptr) {
+    return Status::InvalidArgument("invalid zstd dictionary",
+                                   KUDU_REDACT(dict.ToDebugString(100)));
+  }
+  codec->reset(new ZstdDictionaryCodec(ZstdCodec::ClampLevel(level), dict.ToString(), ddict));
+  return Status::OK();
+}
+
+Status GetCompressionCodec(CompressionType compression,
+                           const CompressionCodec** codec) {
+  return GetCompressionCodec(compression, ZstdCodec::kDefaultLevel, codec);
+}
+
 Status GetCompressionCodec(CompressionType compression,
+                           int level,
                            const CompressionCodec** codec) {
   switch (compression) {
     case NO_COMPRESSION:
@@ -259,6 +486,9 @@ Status GetCompressionCodec(CompressionType compression,
     case ZLIB:
       *codec = ZlibCodec::GetSingleton();
       break;
+    case ZSTD:
+      *codec = ZstdCodec::GetSingleton(level);
+      break;
     default:
       return Status::NotFound("bad compression type");
   }
@@ -275,6 +505,8 @@ CompressionType GetCompressionCodecType(const std::string& name) {
     return LZ4;
   if (uname == "ZLIB")
     return ZLIB;
+  if (uname == "ZSTD")
+    return ZSTD;
   if (uname == "NONE")
     return NO_COMPRESSION;
 
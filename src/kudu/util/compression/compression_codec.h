@@ -19,6 +19,7 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -71,6 +72,33 @@ class CompressionCodec {
 Status GetCompressionCodec(CompressionType compression,
                            const CompressionCodec** codec);
 
+// Like the above, but for codecs with tunable compression levels (currently
+// only ZSTD) returns a codec which compresses at 'level'. The level is clamped
+// to the range supported by the codec. Codecs without levels ignore it.
+//
+// The returned codec is a singleton and should be not be destroyed.
+Status GetCompressionCodec(CompressionType compression,
+                           int level,
+                           const CompressionCodec** codec);
+
+// Trains a ZSTD dictionary of at most 'max_dict_size' bytes from the
+// concatenated samples in 'samples', whose individual lengths are given by
+// 'sample_sizes'. On success, the dictionary is stored in 'dict'.
+//
+// Returns RuntimeError if the samples are not suitable for training (e.g.
+// there are too few of them).
+Status TrainZstdDictionary(const Slice& samples,
+                           const std::vector<size_t>& sample_sizes,
+                           size_t max_dict_size,
+                           std::string* dict);
+
+// Creates a ZSTD codec which compresses at 'level' with the trained dictionary
+// 'dict', and which can uncompress data compressed either with that dictionary
+// or with no dictionary at all. 'dict' is copied and need not outlive the codec.
+Status NewZstdDictionaryCodec(const Slice& dict,
+                              int level,
+                              std::unique_ptr<CompressionCodec>* codec);
+
 // Returns the compression codec type given the name
 CompressionType GetCompressionCodecType(const std::string& name);
 
@@ -87,6 +87,26 @@ TEST_F(DebugUtilTest, TestStackTraceMainThread) {
   ASSERT_STR_CONTAINS(s, "kudu::DebugUtilTest_TestStackTraceMainThread_Test::TestBody()");
 }
 
+TEST_F(DebugUtilTest, TestThreadStackTag) {
+  StackTrace stack;
+  string tag;
+  ASSERT_OK(GetThreadStack(Thread::CurrentThreadId(), &stack, &tag));
+  ASSERT_TRUE(stack.HasCollected());
+  ASSERT_EQ("", tag);
+  {
+    ScopedThreadStackTag outer("outer");
+    {
+      ScopedThreadStackTag inner("inner");
+      ASSERT_OK(GetThreadStack(Thread::CurrentThreadId(), &stack, &tag));
+      ASSERT_EQ("inner", tag);
+    }
+    ASSERT_OK(GetThreadStack(Thread::CurrentThreadId(), &stack, &tag));
+    ASSERT_EQ("outer", tag);
+  }
+  ASSERT_OK(GetThreadStack(Thread::CurrentThreadId(), &stack, &tag));
+  ASSERT_EQ("", tag);
+}
+
 TEST_F(DebugUtilTest, TestSignalStackTrace) {
   CountDownLatch l(1);
   scoped_refptr<Thread> t;
@@ -120,12 +120,19 @@ void TryFlushCoverage() {
 
 namespace {
 
+// The stack tag of the current thread. See SetThreadStackTag().
+__thread const char* tls_stack_tag = nullptr;
+
 // Global structure used to communicate between the signal handler
 // and a dumping thread.
 struct SignalCommunication {
   // The actual stack trace collected from the target thread.
   StackTrace stack;
 
+  // The stack tag of the target thread at the time its stack was collected,
+  // truncated and NUL-terminated.
+  char tag[64];
+
   // The current target. Signals can be delivered asynchronously, so the
   // dumper thread sets this variable first before sending a signal. If
   // a signal is received on a thread that doesn't match 'target_tid', it is
@@ -174,6 +181,15 @@ void HandleStackTraceSignal(int signum) {
   }
 
   g_comm.stack.Collect(2);
+  // Copy the tag by hand: this runs in a signal handler.
+  size_t tag_len = 0;
+  if (tls_stack_tag != nullptr) {
+    while (tls_stack_tag[tag_len] != '\0' && tag_len < sizeof(g_comm.tag) - 1) {
+      g_comm.tag[tag_len] = tls_stack_tag[tag_len];
+      tag_len++;
+    }
+  }
+  g_comm.tag[tag_len] = '\0';
   base::subtle::Release_Store(&g_comm.result_ready, 1);
 }
 
@@ -236,14 +252,20 @@ Status SetStackTraceSignal(int signum) {
   return Status::OK();
 }
 
-std::string DumpThreadStack(int64_t tid) {
+const char* SetThreadStackTag(const char* tag) {
+  const char* prev = tls_stack_tag;
+  tls_stack_tag = tag;
+  return prev;
+}
+
+Status GetThreadStack(int64_t tid, StackTrace* stack, string* tag) {
 #if defined(__linux__)
   base::SpinLockHolder h(&g_dumper_thread_lock);
 
   // Ensure that our signal handler is installed. We don't need any fancy GoogleOnce here
   // because of the mutex above.
   if (!InitSignalHandlerUnlocked(g_stack_trace_signum)) {
-    return "<unable to take thread stack: signal handler unavailable>";
+    return Status::IllegalState("unable to take thread stack: signal handler unavailable");
   }
 
   // Set the target TID in our communication structure, so if we end up with any
@@ -262,7 +284,7 @@ std::string DumpThreadStack(int64_t tid) {
       SignalCommunication::Lock l;
       g_comm.target_tid = 0;
     }
-    return "(unable to deliver signal: process may have exited)";
+    return Status::NotFound("unable to deliver signal: process may have exited");
   }
 
   // We give the thread ~1s to respond. In testing, threads typically respond within
@@ -271,7 +293,7 @@ std::string DumpThreadStack(int64_t tid) {
   // The main reason that a thread would not respond is that it has blocked signals. For
   // example, glibc's timer_thread doesn't respond to our signal, so we always time out
   // on that one.
-  string ret;
+  Status s;
   int i = 0;
   while (!base::subtle::Acquire_Load(&g_comm.result_ready) &&
          i++ < 100) {
@@ -283,20 +305,32 @@ std::string DumpThreadStack(int64_t tid) {
     CHECK_EQ(tid, g_comm.target_tid);
 
     if (!g_comm.result_ready) {
-      ret = "(thread did not respond: maybe it is blocking signals)";
+      s = Status::TimedOut("thread did not respond: maybe it is blocking signals");
     } else {
-      ret = g_comm.stack.Symbolize();
+      stack->CopyFrom(g_comm.stack);
+      if (tag) {
+        tag->assign(g_comm.tag);
+      }
     }
 
     g_comm.target_tid = 0;
     g_comm.result_ready = 0;
   }
-  return ret;
+  return s;
 #else // defined(__linux__)
-  return "(unsupported platform)";
+  return Status::NotSupported("unsupported platform");
 #endif
 }
 
+std::string DumpThreadStack(int64_t tid) {
+  StackTrace stack;
+  Status s = GetThreadStack(tid, &stack);
+  if (!s.ok()) {
+    return "(" + s.message().ToString() + ")";
+  }
+  return stack.Symbolize();
+}
+
 Status ListThreads(vector<pid_t> *tids) {
 #if defined(__linux__)
   DIR *dir = opendir("/proc/self/task/");
@@ -384,45 +418,51 @@ string StackTrace::ToHexString(int flags) const {
 string StackTrace::Symbolize() const {
   string ret;
   for (int i = 0; i < num_frames_; i++) {
-    void* pc = frames_[i];
-
-    char tmp[1024];
-    const char* symbol = "(unknown)";
-
-    // The return address 'pc' on the stack is the address of the instruction
-    // following the 'call' instruction. In the case of calling a function annotated
-    // 'noreturn', this address may actually be the first instruction of the next
-    // function, because the function we care about ends with the 'call'.
-    // So, we subtract 1 from 'pc' so that we're pointing at the 'call' instead
-    // of the return address.
-    //
-    // For example, compiling a C program with -O2 that simply calls 'abort()' yields
-    // the following disassembly:
-    //     Disassembly of section .text:
-    //
-    //     0000000000400440 <main>:
-    //       400440:	48 83 ec 08          	sub    $0x8,%rsp
-    //       400444:	e8 c7 ff ff ff       	callq  400410 <abort@plt>
-    //
-    //     0000000000400449 <_start>:
-    //       400449:	31 ed                	xor    %ebp,%ebp
-    //       ...
-    //
-    // If we were to take a stack trace while inside 'abort', the return pointer
-    // on the stack would be 0x400449 (the first instruction of '_start'). By subtracting
-    // 1, we end up with 0x400448, which is still within 'main'.
-    //
-    // This also ensures that we point at the correct line number when using addr2line
-    // on logged stacks.
-    if (google::Symbolize(
-            reinterpret_cast<char *>(pc) - 1, tmp, sizeof(tmp))) {
-      symbol = tmp;
-    }
-    StringAppendF(&ret, "    @ %*p  %s\n", kPrintfPointerFieldWidth, pc, symbol);
+    StringAppendF(&ret, "    @ %*p  %s\n", kPrintfPointerFieldWidth, frames_[i],
+                  SymbolizeFrame(i).c_str());
   }
   return ret;
 }
 
+string StackTrace::SymbolizeFrame(int i) const {
+  DCHECK_GE(i, 0);
+  DCHECK_LT(i, num_frames_);
+  void* pc = frames_[i];
+
+  char tmp[1024];
+
+  // The return address 'pc' on the stack is the address of the instruction
+  // following the 'call' instruction. In the case of calling a function annotated
+  // 'noreturn', this address may actually be the first instruction of the next
+  // function, because the function we care about ends with the 'call'.
+  // So, we subtract 1 from 'pc' so that we're pointing at the 'call' instead
+  // of the return address.
+  //
+  // For example, compiling a C program with -O2 that simply calls 'abort()' yields
+  // the following disassembly:
+  //     Disassembly of section .text:
+  //
+  //     0000000000400440 <main>:
+  //       400440:	48 83 ec 08          	sub    $0x8,%rsp
+  //       400444:	e8 c7 ff ff ff       	callq  400410 <abort@plt>
+  //
+  //     0000000000400449 <_start>:
+  //       400449:	31 ed                	xor    %ebp,%ebp
+  //       ...
+  //
+  // If we were to take a stack trace while inside 'abort', the return pointer
+  // on the stack would be 0x400449 (the first instruction of '_start'). By subtracting
+  // 1, we end up with 0x400448, which is still within 'main'.
+  //
+  // This also ensures that we point at the correct line number when using addr2line
+  // on logged stacks.
+  if (google::Symbolize(
+          reinterpret_cast<char *>(pc) - 1, tmp, sizeof(tmp))) {
+    return tmp;
+  }
+  return "(unknown)";
+}
+
 string StackTrace::ToLogFormatHexString() const {
   string ret;
   for (int i = 0; i < num_frames_; i++) {
@@ -24,6 +24,7 @@
 #include <string>
 #include <vector>
 
+#include "kudu/gutil/macros.h"
 #include "kudu/gutil/strings/fastmem.h"
 #include "kudu/util/status.h"
 
@@ -59,6 +60,12 @@ Status SetStackTraceSignal(int signum);
 // may be active at a time.
 std::string DumpThreadStack(int64_t tid);
 
+// Sets a short description of what the current thread is working on (for
+// example, the RPC method it is handling), which is reported along with its
+// stack by GetThreadStack(). 'tag' must remain valid until it is replaced;
+// nullptr clears it. Returns the previous tag.
+const char* SetThreadStackTag(const char* tag);
+
 // Return the current stack trace, stringified.
 std::string GetStackTrace();
 
@@ -163,6 +170,18 @@ class StackTrace {
   // resolved (only the hex addresses are given).
   std::string ToLogFormatHexString() const;
 
+  // Return the symbol name of the frame at index 'i', or "(unknown)" if it
+  // cannot be symbolized. This is not async-safe.
+  std::string SymbolizeFrame(int i) const;
+
+  int num_frames() const {
+    return num_frames_;
+  }
+
+  void* frame(int i) const {
+    return frames_[i];
+  }
+
   uint64_t HashCode() const;
 
  private:
@@ -178,6 +197,31 @@ class StackTrace {
   void* frames_[kMaxFrames];
 };
 
+// Collect the stack trace of the given thread into 'stack' without symbolizing
+// it. If 'tag' is not NULL, it is set to the thread's stack tag at the time
+// (see SetThreadStackTag()), or to the empty string if it had none.
+//
+// The requirements and synchronization are the same as for DumpThreadStack().
+Status GetThreadStack(int64_t tid, StackTrace* stack, std::string* tag = nullptr);
+
+// Sets the stack tag of the current thread for the lifetime of this object,
+// restoring the previous tag when it goes out of scope.
+class ScopedThreadStackTag {
+ public:
+  explicit ScopedThreadStackTag(const char* tag)
+      : prev_tag_(SetThreadStackTag(tag)) {
+  }
+
+  ~ScopedThreadStackTag() {
+    SetThreadStackTag(prev_tag_);
+  }
+
+ private:
+  const char* const prev_tag_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedThreadStackTag);
+};
+
 } // namespace kudu
 
 #endif
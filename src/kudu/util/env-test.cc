@@ -57,6 +57,7 @@
 #include "kudu/util/env.h"
 #include "kudu/util/env_util.h"
 #include "kudu/util/faststring.h"
+#include "kudu/util/io_uring.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/path_util.h"
 #include "kudu/util/random.h"
@@ -915,6 +916,119 @@ TEST_F(TestEnv, TestRWFile) {
   ASSERT_EQ(result4, kNewTestData);
 }
 
+TEST_F(TestEnv, TestMmap) {
+  unique_ptr<RWFile> file;
+  ASSERT_OK(env_->NewRWFile(GetTestPath("foo"), &file));
+  const string kTestData = "abcde";
+  ASSERT_OK(file->Write(0, kTestData));
+
+  shared_ptr<const FileMapping> mapping;
+  ASSERT_OK(file->Mmap(kTestData.length(), &mapping));
+  ASSERT_EQ(kTestData, Slice(mapping->data(), mapping->size()));
+
+  // A file can't be mapped for more than its size.
+  shared_ptr<const FileMapping> too_large;
+  Status s = file->Mmap(kTestData.length() + 1, &too_large);
+  ASSERT_TRUE(s.IsIOError()) << s.ToString();
+
+  // Overwrites within the mapping are visible through it, and appends once
+  // the file is mapped again.
+  ASSERT_OK(file->Write(0, "A"));
+  ASSERT_OK(file->Write(kTestData.length(), "f"));
+  ASSERT_EQ("Abcde", Slice(mapping->data(), mapping->size()));
+  ASSERT_OK(file->Mmap(kTestData.length() + 1, &mapping));
+  ASSERT_EQ("Abcdef", Slice(mapping->data(), mapping->size()));
+
+  // The mapping outlives the file, including through a read-only file.
+  unique_ptr<RandomAccessFile> readable;
+  ASSERT_OK(env_->NewRandomAccessFile(GetTestPath("foo"), &readable));
+  ASSERT_OK(readable->Mmap(0, &mapping));
+  readable.reset();
+  ASSERT_OK(file->Close());
+  file.reset();
+  ASSERT_EQ("Abcdef", Slice(mapping->data(), mapping->size()));
+}
+
+// Tests the asynchronous IO methods, through io_uring where the kernel
+// supports it and through the synchronous fallback otherwise.
+TEST_F(TestEnv, TestAsyncIO) {
+  unique_ptr<IoUring> ring;
+  Status s = IoUring::Create(4, &ring);
+  if (s.IsNotSupported()) {
+    LOG(INFO) << "io_uring is not supported, testing the synchronous fallback: "
+              << s.ToString();
+  } else {
+    ASSERT_OK(s);
+  }
+
+  unique_ptr<RWFile> file;
+  ASSERT_OK(env_->NewRWFile(GetTestPath("foo"), &file));
+
+  // Queue more writes than the ring has room for, so that queuing has to wait
+  // for some of them to complete.
+  const int kNumWrites = 16;
+  const string kTestData = "abcdefgh";
+  vector<Status> write_statuses(kNumWrites);
+  for (int i = 0; i < kNumWrites; i++) {
+    Slice halves[] = { Slice(kTestData.data(), 3), Slice(kTestData.data() + 3, 5) };
+    ASSERT_OK(file->WriteVAsync(ring.get(), i * kTestData.size(),
+                                ArrayView<const Slice>(halves, 2),
+                                [&write_statuses, i](const Status& s) {
+                                  write_statuses[i] = s;
+                                }));
+  }
+  if (ring) {
+    ASSERT_OK(ring->WaitAll());
+  }
+  for (const auto& ws : write_statuses) {
+    ASSERT_OK(ws);
+  }
+
+  Status sync_status = Status::Incomplete("not run");
+  ASSERT_OK(file->SyncAsync(ring.get(), [&](const Status& s) { sync_status = s; }));
+  if (ring) {
+    ASSERT_OK(ring->WaitAll());
+  }
+  ASSERT_OK(sync_status);
+
+  // Read all of the data back, from both the RWFile and a RandomAccessFile.
+  unique_ptr<RandomAccessFile> raf;
+  ASSERT_OK(env_->NewRandomAccessFile(GetTestPath("foo"), &raf));
+  for (int i = 0; i < kNumWrites; i++) {
+    uint8_t scratch1[kTestData.size()];
+    uint8_t scratch2[kTestData.size()];
+    Slice result1(scratch1, kTestData.size());
+    Slice result2(scratch2, kTestData.size());
+    Status read_status1 = Status::Incomplete("not run");
+    Status read_status2 = Status::Incomplete("not run");
+    ASSERT_OK(file->ReadVAsync(ring.get(), i * kTestData.size(),
+                               ArrayView<Slice>(&result1, 1),
+                               [&](const Status& s) { read_status1 = s; }));
+    ASSERT_OK(raf->ReadVAsync(ring.get(), i * kTestData.size(),
+                              ArrayView<Slice>(&result2, 1),
+                              [&](const Status& s) { read_status2 = s; }));
+    if (ring) {
+      ASSERT_OK(ring->WaitAll());
+    }
+    ASSERT_OK(read_status1);
+    ASSERT_OK(read_status2);
+    ASSERT_EQ(kTestData, result1.ToString());
+    ASSERT_EQ(kTestData, result2.ToString());
+  }
+
+  // Reading past the end of the file fails.
+  uint8_t scratch[kTestData.size()];
+  Slice result(scratch, kTestData.size());
+  Status read_status = Status::Incomplete("not run");
+  ASSERT_OK(raf->ReadVAsync(ring.get(), kNumWrites * kTestData.size(),
+                            ArrayView<Slice>(&result, 1),
+                            [&](const Status& s) { read_status = s; }));
+  if (ring) {
+    ASSERT_OK(ring->WaitAll());
+  }
+  ASSERT_TRUE(read_status.IsEndOfFile()) << read_status.ToString();
+}
+
 TEST_F(TestEnv, TestCanonicalize) {
   vector<string> synonyms = { GetTestPath("."), GetTestPath("./."), GetTestPath(".//./") };
   for (const string& synonym : synonyms) {
@@ -8,6 +8,7 @@
 
 #include <glog/logging.h>
 
+#include "kudu/util/array_view.h"
 #include "kudu/util/faststring.h"
 #include "kudu/util/slice.h"
 
@@ -24,12 +25,62 @@ SequentialFile::~SequentialFile() {
 RandomAccessFile::~RandomAccessFile() {
 }
 
+Status RandomAccessFile::ReadVAsync(IoUring* /* ring */, uint64_t offset,
+                                    ArrayView<Slice> results,
+                                    StdStatusCallback callback) const {
+  callback(ReadV(offset, results));
+  return Status::OK();
+}
+
+Status RandomAccessFile::DropCache(uint64_t /* offset */, size_t /* length */) const {
+  return Status::OK();
+}
+
+Status RandomAccessFile::Prefetch(uint64_t /* offset */, size_t /* length */) const {
+  return Status::OK();
+}
+
+Status RandomAccessFile::Mmap(uint64_t /* min_size */,
+                              std::shared_ptr<const FileMapping>* /* mapping */) const {
+  return Status::NotSupported("memory mapping is not supported", filename());
+}
+
 WritableFile::~WritableFile() {
 }
 
 RWFile::~RWFile() {
 }
 
+Status RWFile::ReadVAsync(IoUring* /* ring */, uint64_t offset, ArrayView<Slice> results,
+                          StdStatusCallback callback) const {
+  callback(ReadV(offset, results));
+  return Status::OK();
+}
+
+Status RWFile::DropCache(uint64_t /* offset */, size_t /* length */) const {
+  return Status::OK();
+}
+
+Status RWFile::Prefetch(uint64_t /* offset */, size_t /* length */) const {
+  return Status::OK();
+}
+
+Status RWFile::Mmap(uint64_t /* min_size */,
+                    std::shared_ptr<const FileMapping>* /* mapping */) const {
+  return Status::NotSupported("memory mapping is not supported", filename());
+}
+
+Status RWFile::WriteVAsync(IoUring* /* ring */, uint64_t offset, ArrayView<const Slice> data,
+                           StdStatusCallback callback) {
+  callback(WriteV(offset, data));
+  return Status::OK();
+}
+
+Status RWFile::SyncAsync(IoUring* /* ring */, StdStatusCallback callback) {
+  callback(Sync());
+  return Status::OK();
+}
+
 FileLock::~FileLock() {
 }
 
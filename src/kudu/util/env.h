@@ -23,11 +23,14 @@
 #include "kudu/gutil/callback_forward.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/util/status.h"
+#include "kudu/util/status_callback.h"
 
 namespace kudu {
 
 class faststring;
 class FileLock;
+class FileMapping;
+class IoUring;
 class RandomAccessFile;
 class RWFile;
 class SequentialFile;
@@ -413,6 +416,40 @@ class RandomAccessFile {
   // Safe for concurrent use by multiple threads.
   virtual Status ReadV(uint64_t offset, ArrayView<Slice> results) const = 0;
 
+  // Asynchronous version of ReadV(), which queues the read on 'ring' and
+  // returns without waiting for it. 'callback' is run with the outcome of the
+  // whole read from within 'ring'->Wait(), and the buffers of 'results', as
+  // well as this file, must remain valid until then.
+  //
+  // If this returns an error, the read wasn't queued and 'callback' will not
+  // be run. If 'ring' is NULL, or the file doesn't support asynchronous IO,
+  // the read is done synchronously and 'callback' is run before returning.
+  virtual Status ReadVAsync(IoUring* ring, uint64_t offset, ArrayView<Slice> results,
+                            StdStatusCallback callback) const;
+
+  // Advises the OS to drop the cached pages of the 'length' bytes of the file
+  // at 'offset' from its page cache, for data which won't be read again soon.
+  // Only the pages entirely within the range are dropped. If 'length' is 0,
+  // the range runs to the end of the file.
+  //
+  // This is only advice: it may have no effect, e.g. on dirty pages.
+  virtual Status DropCache(uint64_t offset, size_t length) const;
+
+  // Advises the OS to read the 'length' bytes of the file at 'offset' into
+  // its page cache in the background, for data which will be read soon.
+  //
+  // This is only advice: the pages may be evicted before they're read.
+  virtual Status Prefetch(uint64_t offset, size_t length) const;
+
+  // Maps the whole file into memory, read-only, and stores the mapping in
+  // 'mapping'. Returns an error if the file is shorter than 'min_size' bytes.
+  //
+  // Every call creates a new mapping of the file's current size, so callers
+  // should hold on to it. The mapping stays valid after the file is closed.
+  //
+  // Returns NotSupported if the file can't be memory mapped.
+  virtual Status Mmap(uint64_t min_size, std::shared_ptr<const FileMapping>* mapping) const;
+
   // Returns the size of the file
   virtual Status Size(uint64_t *size) const = 0;
 
@@ -424,6 +461,23 @@ class RandomAccessFile {
   virtual size_t memory_footprint() const = 0;
 };
 
+// A read-only memory mapping of a file, starting at offset 0. See
+// RandomAccessFile::Mmap().
+//
+// The pages are unmapped when the mapping is destroyed. Accessing a page
+// which is no longer backed by the file, e.g. because the file was truncated,
+// or which can't be read due to an IO error, raises SIGBUS.
+class FileMapping {
+ public:
+  virtual ~FileMapping() {}
+
+  // The first mapped byte of the file.
+  virtual const uint8_t* data() const = 0;
+
+  // The number of mapped bytes.
+  virtual size_t size() const = 0;
+};
+
 // Creation-time options for WritableFile
 struct WritableFileOptions {
   // Call Sync() during Close().
@@ -432,9 +486,15 @@ struct WritableFileOptions {
   // See CreateMode for details.
   Env::CreateMode mode;
 
+  // If true and 'mode' is OPEN_EXISTING, appends start at the beginning of
+  // the file and overwrite its contents in place. The contents count as
+  // preallocated space, so Close() truncates the file to the appended bytes.
+  bool overwrite;
+
   WritableFileOptions()
     : sync_on_close(false),
-      mode(Env::CREATE_IF_NON_EXISTING_TRUNCATE) { }
+      mode(Env::CREATE_IF_NON_EXISTING_TRUNCATE),
+      overwrite(false) { }
 };
 
 // Options specified when a file is opened for random access.
@@ -484,6 +544,10 @@ class WritableFile {
   // return a meaningful status.
   virtual Status Flush(FlushMode mode) = 0;
 
+  // Makes the data appended so far durable.
+  //
+  // May be called concurrently with Append() and AppendV(), in which case
+  // the data they append may or may not be covered.
   virtual Status Sync() = 0;
 
   virtual uint64_t Size() const = 0;
@@ -554,12 +618,40 @@ class RWFile {
   // Safe for concurrent use by multiple threads.
   virtual Status ReadV(uint64_t offset, ArrayView<Slice> results) const = 0;
 
+  // Asynchronous version of ReadV(), which queues the read on 'ring' and
+  // returns without waiting for it. 'callback' is run with the outcome of the
+  // whole read from within 'ring'->Wait(), and the buffers of 'results', as
+  // well as this file, must remain valid until then.
+  //
+  // If this returns an error, the read wasn't queued and 'callback' will not
+  // be run. If 'ring' is NULL, or the file doesn't support asynchronous IO,
+  // the read is done synchronously and 'callback' is run before returning.
+  virtual Status ReadVAsync(IoUring* ring, uint64_t offset, ArrayView<Slice> results,
+                            StdStatusCallback callback) const;
+
   // Writes 'data' to the file position given by 'offset'.
   virtual Status Write(uint64_t offset, const Slice& data) = 0;
 
   // Writes the 'data' slices to the file position given by 'offset'.
   virtual Status WriteV(uint64_t offset, ArrayView<const Slice> data) = 0;
 
+  // Advises the OS to drop cached pages of the file, with the same contract
+  // as RandomAccessFile::DropCache(). Dirty pages must be flushed first.
+  virtual Status DropCache(uint64_t offset, size_t length) const;
+
+  // Advises the OS to read pages of the file ahead, with the same contract
+  // as RandomAccessFile::Prefetch().
+  virtual Status Prefetch(uint64_t offset, size_t length) const;
+
+  // Maps the whole file into memory, with the same contract as
+  // RandomAccessFile::Mmap(). Writes to the file after the mapping was made
+  // are visible through it only if they fall within its size.
+  virtual Status Mmap(uint64_t min_size, std::shared_ptr<const FileMapping>* mapping) const;
+
+  // Asynchronous version of WriteV(), with the same contract as ReadVAsync().
+  virtual Status WriteVAsync(IoUring* ring, uint64_t offset, ArrayView<const Slice> data,
+                             StdStatusCallback callback);
+
   // Preallocates 'length' bytes for the file in the underlying filesystem
   // beginning at 'offset'. It is safe to preallocate the same range
   // repeatedly; this is an idempotent operation.
@@ -608,6 +700,12 @@ class RWFile {
   // made durable.
   virtual Status Sync() = 0;
 
+  // Asynchronous version of Sync(), with the same contract as ReadVAsync().
+  //
+  // Only writes which have completed before this is called are guaranteed to
+  // be made durable.
+  virtual Status SyncAsync(IoUring* ring, StdStatusCallback callback);
+
   // Closes the file, optionally calling Sync() on it if the file was
   // created with the sync_on_close option enabled.
   //
@@ -8,6 +8,7 @@
 #include <fts.h>
 #include <glob.h>
 #include <pthread.h>
+#include <sys/mman.h>
 #include <sys/resource.h>
 #include <sys/stat.h>
 #include <sys/statvfs.h>
@@ -17,6 +18,7 @@
 #include <unistd.h>
 
 #include <algorithm>
+#include <atomic>
 #include <cerrno>
 #include <cstdint>
 #include <cstdio>
@@ -53,6 +55,7 @@
 #include "kudu/util/fault_injection.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/flags.h"
+#include "kudu/util/io_uring.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/malloc.h"
 #include "kudu/util/monotime.h"
@@ -60,6 +63,7 @@
 #include "kudu/util/scoped_cleanup.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/status.h"
+#include "kudu/util/status_callback.h"
 #include "kudu/util/stopwatch.h"
 #include "kudu/util/thread_restrictions.h"
 #include "kudu/util/trace.h"
@@ -494,6 +498,98 @@ Status DoWriteV(int fd, const string& filename, uint64_t offset, ArrayView<const
   return Status::OK();
 }
 
+// Returns the part of 'slices' which remains to be transferred after the
+// first 'done' bytes have been.
+template <typename T>
+vector<Slice> RemainingSlices(const vector<T>& slices, size_t done) {
+  vector<Slice> rem;
+  for (const auto& s : slices) {
+    if (done >= s.size()) {
+      done -= s.size();
+      continue;
+    }
+    Slice r(s);
+    r.remove_prefix(done);
+    done = 0;
+    rem.emplace_back(r);
+  }
+  return rem;
+}
+
+// Queues a vectored read on 'ring'. A short read is finished synchronously
+// from the completion callback, so 'callback' sees the whole read's outcome.
+Status DoReadVAsync(IoUring* ring, int fd, const string& filename, uint64_t offset,
+                    ArrayView<Slice> results, StdStatusCallback callback) {
+  MAYBE_RETURN_EIO(filename, IOError(Env::kInjectedFailureStatusMsg, EIO));
+  if (results.size() > IOV_MAX) {
+    callback(DoReadV(fd, filename, offset, results));
+    return Status::OK();
+  }
+  int64_t bytes_req = 0;
+  for (const auto& r : results) {
+    bytes_req += r.size();
+  }
+  vector<Slice> slices(results.begin(), results.end());
+  return ring->QueueReadV(
+      fd, offset, results,
+      [=](int64_t res) {
+        if (PREDICT_TRUE(res == bytes_req)) {
+          callback(Status::OK());
+        } else if (PREDICT_FALSE(res < 0)) {
+          callback(IOError(filename, -res));
+        } else if (PREDICT_FALSE(res == 0)) {
+          callback(Status::EndOfFile(
+              Substitute("EOF trying to read $0 bytes at offset $1", bytes_req, offset)));
+        } else {
+          vector<Slice> rem = RemainingSlices(slices, res);
+          callback(DoReadV(fd, filename, offset + res, ArrayView<Slice>(rem)));
+        }
+      });
+}
+
+// Like DoReadVAsync(), but for a vectored write.
+Status DoWriteVAsync(IoUring* ring, int fd, const string& filename, uint64_t offset,
+                     ArrayView<const Slice> data, StdStatusCallback callback) {
+  MAYBE_RETURN_EIO(filename, IOError(Env::kInjectedFailureStatusMsg, EIO));
+  if (data.size() > IOV_MAX) {
+    callback(DoWriteV(fd, filename, offset, data));
+    return Status::OK();
+  }
+  int64_t bytes_req = 0;
+  for (const auto& d : data) {
+    bytes_req += d.size();
+  }
+  vector<Slice> slices(data.begin(), data.end());
+  return ring->QueueWriteV(
+      fd, offset, data,
+      [=](int64_t res) {
+        if (PREDICT_TRUE(res == bytes_req)) {
+          callback(Status::OK());
+        } else if (PREDICT_FALSE(res < 0)) {
+          callback(IOError(filename, -res));
+        } else {
+          vector<Slice> rem = RemainingSlices(slices, res);
+          callback(DoWriteV(fd, filename, offset + res, ArrayView<const Slice>(rem)));
+        }
+      });
+}
+
+// Asynchronous version of DoSync().
+Status DoSyncAsync(IoUring* ring, int fd, const string& filename,
+                   StdStatusCallback callback) {
+  MAYBE_RETURN_EIO(filename, IOError(Env::kInjectedFailureStatusMsg, EIO));
+  if (FLAGS_never_fsync) {
+    callback(Status::OK());
+    return Status::OK();
+  }
+  TRACE_COUNTER_INCREMENT(FLAGS_env_use_fsync ? "fsync" : "fdatasync", 1);
+  return ring->QueueSync(
+      fd, !FLAGS_env_use_fsync,
+      [=](int64_t res) {
+        callback(PREDICT_TRUE(res == 0) ? Status::OK() : IOError(filename, -res));
+      });
+}
+
 Status DoIsOnXfsFilesystem(const string& path, bool* result) {
 #ifdef __APPLE__
   *result = false;
@@ -553,6 +649,87 @@ class PosixSequentialFile: public SequentialFile {
   virtual const string& filename() const OVERRIDE { return filename_; }
 };
 
+// A read-only mmap() of a file. Unmapped on destruction.
+class PosixFileMapping : public FileMapping {
+ public:
+  PosixFileMapping(const uint8_t* data, size_t size)
+      : data_(data),
+        size_(size) {}
+
+  ~PosixFileMapping() {
+    if (size_ > 0 && munmap(const_cast<uint8_t*>(data_), size_) != 0) {
+      PLOG(WARNING) << "Failed to unmap file mapping";
+    }
+  }
+
+  virtual const uint8_t* data() const OVERRIDE { return data_; }
+
+  virtual size_t size() const OVERRIDE { return size_; }
+
+ private:
+  const uint8_t* data_;
+  const size_t size_;
+
+  DISALLOW_COPY_AND_ASSIGN(PosixFileMapping);
+};
+
+// Advises the kernel to drop the cached pages of a range of file 'fd'. See
+// RandomAccessFile::DropCache() for details.
+Status DoDropCache(int fd, const string& filename, uint64_t offset, size_t length) {
+  MAYBE_RETURN_EIO(filename, IOError(Env::kInjectedFailureStatusMsg, EIO));
+  TRACE_EVENT1("io", "DoDropCache", "path", filename);
+  ThreadRestrictions::AssertIOAllowed();
+#if defined(__linux__)
+  int err = posix_fadvise(fd, offset, length, POSIX_FADV_DONTNEED);
+  if (err != 0) {
+    return IOError(filename, err);
+  }
+#endif
+  return Status::OK();
+}
+
+// Advises the kernel to read a range of file 'fd' ahead. See
+// RandomAccessFile::Prefetch() for details.
+Status DoPrefetch(int fd, const string& filename, uint64_t offset, size_t length) {
+  MAYBE_RETURN_EIO(filename, IOError(Env::kInjectedFailureStatusMsg, EIO));
+  TRACE_EVENT1("io", "DoPrefetch", "path", filename);
+  ThreadRestrictions::AssertIOAllowed();
+#if defined(__linux__)
+  int err = posix_fadvise(fd, offset, length, POSIX_FADV_WILLNEED);
+  if (err != 0) {
+    return IOError(filename, err);
+  }
+#endif
+  return Status::OK();
+}
+
+// Maps the whole of file 'fd' read-only into memory. See
+// RandomAccessFile::Mmap() for details.
+Status DoMmap(int fd, const string& filename, uint64_t min_size,
+              std::shared_ptr<const FileMapping>* mapping) {
+  MAYBE_RETURN_EIO(filename, IOError(Env::kInjectedFailureStatusMsg, EIO));
+  TRACE_EVENT1("io", "DoMmap", "path", filename);
+  ThreadRestrictions::AssertIOAllowed();
+  struct stat st;
+  if (fstat(fd, &st) == -1) {
+    return IOError(filename, errno);
+  }
+  const uint64_t size = st.st_size;
+  if (size < min_size) {
+    return Status::IOError(Substitute("cannot map $0 bytes of a file of $1 bytes",
+                                      min_size, size), filename);
+  }
+  void* data = nullptr;
+  if (size > 0) {
+    data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+      return IOError(filename, errno);
+    }
+  }
+  mapping->reset(new PosixFileMapping(static_cast<const uint8_t*>(data), size));
+  return Status::OK();
+}
+
 // pread() based random-access
 class PosixRandomAccessFile: public RandomAccessFile {
  private:
@@ -572,6 +749,27 @@ class PosixRandomAccessFile: public RandomAccessFile {
     return DoReadV(fd_, filename_, offset, results);
   }
 
+  virtual Status ReadVAsync(IoUring* ring, uint64_t offset, ArrayView<Slice> results,
+                            StdStatusCallback callback) const OVERRIDE {
+    if (ring == nullptr) {
+      return RandomAccessFile::ReadVAsync(ring, offset, results, std::move(callback));
+    }
+    return DoReadVAsync(ring, fd_, filename_, offset, results, std::move(callback));
+  }
+
+  virtual Status DropCache(uint64_t offset, size_t length) const OVERRIDE {
+    return DoDropCache(fd_, filename_, offset, length);
+  }
+
+  virtual Status Prefetch(uint64_t offset, size_t length) const OVERRIDE {
+    return DoPrefetch(fd_, filename_, offset, length);
+  }
+
+  virtual Status Mmap(uint64_t min_size,
+                      std::shared_ptr<const FileMapping>* mapping) const OVERRIDE {
+    return DoMmap(fd_, filename_, min_size, mapping);
+  }
+
   virtual Status Size(uint64_t *size) const OVERRIDE {
     MAYBE_RETURN_EIO(filename_, IOError(Env::kInjectedFailureStatusMsg, EIO));
     TRACE_EVENT1("io", "PosixRandomAccessFile::Size", "path", filename_);
@@ -598,12 +796,12 @@ class PosixRandomAccessFile: public RandomAccessFile {
 class PosixWritableFile : public WritableFile {
  public:
   PosixWritableFile(std::string fname, int fd, uint64_t file_size,
-                    bool sync_on_close)
+                    uint64_t pre_allocated_size, bool sync_on_close)
       : filename_(std::move(fname)),
         fd_(fd),
         sync_on_close_(sync_on_close),
         filesize_(file_size),
-        pre_allocated_size_(0),
+        pre_allocated_size_(pre_allocated_size),
         pending_sync_(false) {}
 
   ~PosixWritableFile() {
@@ -710,8 +908,7 @@ class PosixWritableFile : public WritableFile {
     TRACE_EVENT1("io", "PosixWritableFile::Sync", "path", filename_);
     ThreadRestrictions::AssertIOAllowed();
     LOG_SLOW_EXECUTION(WARNING, 1000, Substitute("sync call for $0", filename_)) {
-      if (pending_sync_) {
-        pending_sync_ = false;
+      if (pending_sync_.exchange(false)) {
         RETURN_NOT_OK(DoSync(fd_, filename_));
       }
     }
@@ -731,7 +928,8 @@ class PosixWritableFile : public WritableFile {
   uint64_t filesize_;
   uint64_t pre_allocated_size_;
 
-  bool pending_sync_;
+  // Atomic since Sync() may run concurrently with appends.
+  std::atomic<bool> pending_sync_;
 };
 
 class PosixRWFile : public RWFile {
@@ -755,6 +953,27 @@ class PosixRWFile : public RWFile {
     return DoReadV(fd_, filename_, offset, results);
   }
 
+  virtual Status ReadVAsync(IoUring* ring, uint64_t offset, ArrayView<Slice> results,
+                            StdStatusCallback callback) const OVERRIDE {
+    if (ring == nullptr) {
+      return RWFile::ReadVAsync(ring, offset, results, std::move(callback));
+    }
+    return DoReadVAsync(ring, fd_, filename_, offset, results, std::move(callback));
+  }
+
+  virtual Status DropCache(uint64_t offset, size_t length) const OVERRIDE {
+    return DoDropCache(fd_, filename_, offset, length);
+  }
+
+  virtual Status Prefetch(uint64_t offset, size_t length) const OVERRIDE {
+    return DoPrefetch(fd_, filename_, offset, length);
+  }
+
+  virtual Status Mmap(uint64_t min_size,
+                      std::shared_ptr<const FileMapping>* mapping) const OVERRIDE {
+    return DoMmap(fd_, filename_, min_size, mapping);
+  }
+
   virtual Status Write(uint64_t offset, const Slice& data) OVERRIDE {
     return WriteV(offset, ArrayView<const Slice>(&data, 1));
   }
@@ -764,6 +983,14 @@ class PosixRWFile : public RWFile {
     return s;
   }
 
+  virtual Status WriteVAsync(IoUring* ring, uint64_t offset, ArrayView<const Slice> data,
+                             StdStatusCallback callback) OVERRIDE {
+    if (ring == nullptr) {
+      return RWFile::WriteVAsync(ring, offset, data, std::move(callback));
+    }
+    return DoWriteVAsync(ring, fd_, filename_, offset, data, std::move(callback));
+  }
+
   virtual Status PreAllocate(uint64_t offset,
                              size_t length,
                              PreAllocateMode mode) OVERRIDE {
@@ -865,6 +1092,13 @@ class PosixRWFile : public RWFile {
     return Status::OK();
   }
 
+  virtual Status SyncAsync(IoUring* ring, StdStatusCallback callback) OVERRIDE {
+    if (ring == nullptr) {
+      return RWFile::SyncAsync(ring, std::move(callback));
+    }
+    return DoSyncAsync(ring, fd_, filename_, std::move(callback));
+  }
+
   virtual Status Close() OVERRIDE {
     if (closed_) {
       return Status::OK();
@@ -1701,10 +1935,18 @@ class PosixEnv : public Env {
                                     const WritableFileOptions& opts,
                                     unique_ptr<WritableFile>* result) {
     uint64_t file_size = 0;
+    uint64_t pre_allocated_size = 0;
     if (opts.mode == OPEN_EXISTING) {
       RETURN_NOT_OK(GetFileSize(fname, &file_size));
+      if (opts.overwrite) {
+        // Treat the existing contents as preallocated space: appends start
+        // over from the beginning of the file.
+        pre_allocated_size = file_size;
+        file_size = 0;
+      }
     }
-    result->reset(new PosixWritableFile(fname, fd, file_size, opts.sync_on_close));
+    result->reset(new PosixWritableFile(fname, fd, file_size, pre_allocated_size,
+                                        opts.sync_on_close));
     return Status::OK();
   }
 
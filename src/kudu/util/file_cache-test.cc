@@ -230,6 +230,41 @@ TYPED_TEST(FileCacheTest, TestDeletion) {
   ASSERT_EQ(this->initial_open_fds_, CountOpenFds(this->env_));
 }
 
+TYPED_TEST(FileCacheTest, TestOpenExistingFiles) {
+  const int kNumFiles = 5;
+  ASSERT_OK(this->ReinitCache(kNumFiles));
+  vector<string> file_names;
+  for (int i = 0; i < kNumFiles; i++) {
+    file_names.emplace_back(this->GetTestPath(Substitute("file$0", i)));
+    ASSERT_OK(this->WriteTestFile(file_names.back(), string(i, 'x')));
+  }
+
+  // A batch with a missing file fails as a whole.
+  vector<shared_ptr<TypeParam>> files;
+  vector<string> with_missing = file_names;
+  with_missing.emplace_back("/does/not/exist");
+  ASSERT_TRUE(this->cache_->OpenExistingFiles(with_missing, &files).IsNotFound());
+  ASSERT_TRUE(files.empty());
+
+  // Otherwise, the files are returned in order.
+  ASSERT_OK(this->cache_->OpenExistingFiles(file_names, &files));
+  ASSERT_EQ(kNumFiles, files.size());
+  for (int i = 0; i < kNumFiles; i++) {
+    uint64_t size;
+    ASSERT_OK(files[i]->Size(&size));
+    ASSERT_EQ(i, size);
+  }
+  NO_FATALS(this->AssertFdsAndDescriptors(kNumFiles, kNumFiles));
+
+  // Files opened already share their descriptors.
+  vector<shared_ptr<TypeParam>> files2;
+  ASSERT_OK(this->cache_->OpenExistingFiles(file_names, &files2));
+  for (int i = 0; i < kNumFiles; i++) {
+    ASSERT_EQ(files[i].get(), files2[i].get());
+  }
+  NO_FATALS(this->AssertFdsAndDescriptors(kNumFiles, kNumFiles));
+}
+
 TYPED_TEST(FileCacheTest, TestInvalidation) {
   const string kFile1 = this->GetTestPath("foo");
   const string kData1 = "test data 1";
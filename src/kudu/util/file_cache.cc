@@ -46,11 +46,26 @@
 #include "kudu/util/slice.h"
 #include "kudu/util/status.h"
 #include "kudu/util/thread.h"
+#include "kudu/util/threadpool.h"
 
 DEFINE_int32(file_cache_expiry_period_ms, 60 * 1000,
              "Period of time (in ms) between removing expired file cache descriptors");
 TAG_FLAG(file_cache_expiry_period_ms, advanced);
 
+DEFINE_int32(file_cache_open_threads, 8,
+             "Maximum number of threads of each file cache opening batches of "
+             "files, e.g. the files of a rowset, in parallel. 0 opens them "
+             "one at a time from the calling thread.");
+TAG_FLAG(file_cache_open_threads, advanced);
+
+DEFINE_double(file_cache_high_priority_pool_ratio, 0.5,
+              "Fraction of the capacity of each file cache reserved for files "
+              "which were used again after being opened. Other files are "
+              "closed first when the cache is full, so that files opened once "
+              "by wide scans don't push out the files in regular use. 0 "
+              "closes the least recently used files first.");
+TAG_FLAG(file_cache_high_priority_pool_ratio, advanced);
+
 using std::shared_ptr;
 using std::string;
 using std::unique_ptr;
@@ -100,9 +115,9 @@ class BaseDescriptor {
   ~BaseDescriptor() {
     VLOG(2) << "Out of scope descriptor with file name: " << filename();
 
-    // The (now expired) weak_ptr remains in 'descriptors_', to be removed by
-    // the next call to RunDescriptorExpiry(). Removing it here would risk a
-    // deadlock on recursive acquisition of 'lock_'.
+    // The (now expired) weak_ptr remains in the descriptor map, to be removed
+    // by the next call to RunDescriptorExpiry(). Removing it here would risk a
+    // deadlock on recursive acquisition of the lock of its shard.
 
     if (deleted()) {
       cache()->Erase(filename());
@@ -161,6 +176,30 @@ class BaseDescriptor {
     }
   }
 
+  // If the file has been mapped before, and the largest mapping so far
+  // covers at least 'min_size' bytes, stores it in 'mapping' and returns true.
+  //
+  // Mappings outlive the opened files they were made from, so they're kept
+  // by the descriptor and shared by its users rather than remade whenever
+  // the file is reopened.
+  bool LookupMapping(uint64_t min_size, shared_ptr<const FileMapping>* mapping) const {
+    std::lock_guard<simple_spinlock> l(mapping_lock_);
+    if (mapping_ && mapping_->size() >= min_size) {
+      *mapping = mapping_;
+      return true;
+    }
+    return false;
+  }
+
+  // Keeps 'mapping' for LookupMapping(), unless it's smaller than the
+  // mapping kept already, i.e. the file grew in between.
+  void CacheMapping(const shared_ptr<const FileMapping>& mapping) const {
+    std::lock_guard<simple_spinlock> l(mapping_lock_);
+    if (!mapping_ || mapping_->size() < mapping->size()) {
+      mapping_ = mapping;
+    }
+  }
+
   Cache* cache() const { return file_cache_->cache_.get(); }
 
   Env* env() const { return file_cache_->env_; }
@@ -179,6 +218,12 @@ class BaseDescriptor {
   };
   std::atomic<uint8_t> flags_ {0};
 
+  // Protects 'mapping_'.
+  mutable simple_spinlock mapping_lock_;
+
+  // The largest mapping of the file so far, if any.
+  mutable shared_ptr<const FileMapping> mapping_;
+
   DISALLOW_COPY_AND_ASSIGN(BaseDescriptor);
 };
 
@@ -245,6 +290,29 @@ class Descriptor<RWFile> : public RWFile {
     return opened.file()->ReadV(offset, results);
   }
 
+  Status DropCache(uint64_t offset, size_t length) const override {
+    ScopedOpenedDescriptor<RWFile> opened(&base_);
+    RETURN_NOT_OK(ReopenFileIfNecessary(&opened));
+    return opened.file()->DropCache(offset, length);
+  }
+
+  Status Prefetch(uint64_t offset, size_t length) const override {
+    ScopedOpenedDescriptor<RWFile> opened(&base_);
+    RETURN_NOT_OK(ReopenFileIfNecessary(&opened));
+    return opened.file()->Prefetch(offset, length);
+  }
+
+  Status Mmap(uint64_t min_size, shared_ptr<const FileMapping>* mapping) const override {
+    if (base_.LookupMapping(min_size, mapping)) {
+      return Status::OK();
+    }
+    ScopedOpenedDescriptor<RWFile> opened(&base_);
+    RETURN_NOT_OK(ReopenFileIfNecessary(&opened));
+    RETURN_NOT_OK(opened.file()->Mmap(min_size, mapping));
+    base_.CacheMapping(*mapping);
+    return Status::OK();
+  }
+
   Status Write(uint64_t offset, const Slice& data) override {
     ScopedOpenedDescriptor<RWFile> opened(&base_);
     RETURN_NOT_OK(ReopenFileIfNecessary(&opened));
@@ -376,6 +444,29 @@ class Descriptor<RandomAccessFile> : public RandomAccessFile {
     return opened.file()->ReadV(offset, results);
   }
 
+  Status DropCache(uint64_t offset, size_t length) const override {
+    ScopedOpenedDescriptor<RandomAccessFile> opened(&base_);
+    RETURN_NOT_OK(ReopenFileIfNecessary(&opened));
+    return opened.file()->DropCache(offset, length);
+  }
+
+  Status Prefetch(uint64_t offset, size_t length) const override {
+    ScopedOpenedDescriptor<RandomAccessFile> opened(&base_);
+    RETURN_NOT_OK(ReopenFileIfNecessary(&opened));
+    return opened.file()->Prefetch(offset, length);
+  }
+
+  Status Mmap(uint64_t min_size, shared_ptr<const FileMapping>* mapping) const override {
+    if (base_.LookupMapping(min_size, mapping)) {
+      return Status::OK();
+    }
+    ScopedOpenedDescriptor<RandomAccessFile> opened(&base_);
+    RETURN_NOT_OK(ReopenFileIfNecessary(&opened));
+    RETURN_NOT_OK(opened.file()->Mmap(min_size, mapping));
+    base_.CacheMapping(*mapping);
+    return Status::OK();
+  }
+
   Status Size(uint64_t *size) const override {
     ScopedOpenedDescriptor<RandomAccessFile> opened(&base_);
     RETURN_NOT_OK(ReopenFileIfNecessary(&opened));
@@ -462,7 +553,8 @@ FileCache<FileType>::FileCache(const string& cache_name,
     : env_(env),
       cache_name_(cache_name),
       eviction_cb_(new EvictionCallback<FileType>()),
-      cache_(NewLRUCache(DRAM_CACHE, max_open_files, cache_name)),
+      cache_(NewLRUCache(DRAM_CACHE, max_open_files, cache_name,
+                         FLAGS_file_cache_high_priority_pool_ratio)),
       running_(1) {
   if (entity) {
     cache_->SetMetrics(entity);
@@ -473,6 +565,9 @@ FileCache<FileType>::FileCache(const string& cache_name,
 
 template <class FileType>
 FileCache<FileType>::~FileCache() {
+  if (open_pool_) {
+    open_pool_->Shutdown();
+  }
   running_.CountDown();
   if (descriptor_expiry_thread_) {
     descriptor_expiry_thread_->Join();
@@ -481,6 +576,12 @@ FileCache<FileType>::~FileCache() {
 
 template <class FileType>
 Status FileCache<FileType>::Init() {
+  if (FLAGS_file_cache_open_threads > 0) {
+    RETURN_NOT_OK(ThreadPoolBuilder(Substitute("$0-open", cache_name_))
+                  .set_min_threads(0)
+                  .set_max_threads(FLAGS_file_cache_open_threads)
+                  .Build(&open_pool_));
+  }
   return Thread::Create("cache", Substitute("$0-evict", cache_name_),
                         &FileCache::RunDescriptorExpiry, this,
                         &descriptor_expiry_thread_);
@@ -490,18 +591,7 @@ template <class FileType>
 Status FileCache<FileType>::OpenExistingFile(const string& file_name,
                                              shared_ptr<FileType>* file) {
   shared_ptr<internal::Descriptor<FileType>> desc;
-  {
-    // Find an existing descriptor, or create one if none exists.
-    std::lock_guard<simple_spinlock> l(lock_);
-    RETURN_NOT_OK(FindDescriptorUnlocked(file_name, &desc));
-    if (desc) {
-      VLOG(2) << "Found existing descriptor: " << desc->filename();
-    } else {
-      desc = std::make_shared<internal::Descriptor<FileType>>(this, file_name);
-      InsertOrDie(&descriptors_, file_name, desc);
-      VLOG(2) << "Created new descriptor: " << desc->filename();
-    }
-  }
+  RETURN_NOT_OK(FindOrCreateDescriptor(file_name, &desc));
 
   // Check that the underlying file can be opened (no-op for found
   // descriptors). Done outside the lock.
@@ -510,12 +600,52 @@ Status FileCache<FileType>::OpenExistingFile(const string& file_name,
   return Status::OK();
 }
 
+template <class FileType>
+Status FileCache<FileType>::OpenExistingFiles(const vector<string>& file_names,
+                                              vector<shared_ptr<FileType>>* files) {
+  vector<shared_ptr<internal::Descriptor<FileType>>> descs(file_names.size());
+  for (int i = 0; i < file_names.size(); i++) {
+    RETURN_NOT_OK(FindOrCreateDescriptor(file_names[i], &descs[i]));
+  }
+
+  // Open the files. Descriptors which were opened already return right away.
+  vector<Status> statuses(descs.size());
+  if (open_pool_ && descs.size() > 1) {
+    unique_ptr<ThreadPoolToken> token(
+        open_pool_->NewToken(ThreadPool::ExecutionMode::CONCURRENT));
+    for (int i = 0; i < descs.size(); i++) {
+      internal::Descriptor<FileType>* desc = descs[i].get();
+      Status* s = &statuses[i];
+      if (!token->SubmitFunc([desc, s]() { *s = desc->Init(); }).ok()) {
+        // The pool is shutting down; open the file from this thread instead.
+        *s = desc->Init();
+      }
+    }
+    token->Wait();
+  } else {
+    for (int i = 0; i < descs.size(); i++) {
+      statuses[i] = descs[i]->Init();
+    }
+  }
+  for (const auto& s : statuses) {
+    RETURN_NOT_OK(s);
+  }
+
+  files->clear();
+  files->reserve(descs.size());
+  for (auto& desc : descs) {
+    files->emplace_back(std::move(desc));
+  }
+  return Status::OK();
+}
+
 template <class FileType>
 Status FileCache<FileType>::DeleteFile(const string& file_name) {
   {
-    std::lock_guard<simple_spinlock> l(lock_);
+    DescriptorShard* shard = ShardFor(file_name);
+    std::lock_guard<simple_spinlock> l(shard->lock);
     shared_ptr<internal::Descriptor<FileType>> desc;
-    RETURN_NOT_OK(FindDescriptorUnlocked(file_name, &desc));
+    RETURN_NOT_OK(FindDescriptorUnlocked(shard, file_name, &desc));
 
     if (desc) {
       VLOG(2) << "Marking file for deletion: " << file_name;
@@ -538,17 +668,18 @@ void FileCache<FileType>::Invalidate(const string& file_name) {
   //
   // This ensures that any concurrent OpenExistingFile() during this method wil
   // see the invalidation and issue a CHECK failure.
+  DescriptorShard* shard = ShardFor(file_name);
   shared_ptr<internal::Descriptor<FileType>> desc;
   {
     // Find an existing descriptor, or create one if none exists.
-    std::lock_guard<simple_spinlock> l(lock_);
-    auto it = descriptors_.find(file_name);
-    if (it != descriptors_.end()) {
+    std::lock_guard<simple_spinlock> l(shard->lock);
+    auto it = shard->descriptors.find(file_name);
+    if (it != shard->descriptors.end()) {
       desc = it->second.lock();
     }
     if (!desc) {
       desc = std::make_shared<internal::Descriptor<FileType>>(this, file_name);
-      descriptors_.emplace(file_name, desc);
+      shard->descriptors[file_name] = desc;
     }
 
     desc->base_.MarkInvalidated();
@@ -563,55 +694,68 @@ void FileCache<FileType>::Invalidate(const string& file_name) {
   // the duration of this method, and no other methods erase strong
   // references from the map.
   {
-    std::lock_guard<simple_spinlock> l(lock_);
-    CHECK_EQ(1, descriptors_.erase(file_name));
+    std::lock_guard<simple_spinlock> l(shard->lock);
+    CHECK_EQ(1, shard->descriptors.erase(file_name));
   }
 }
 
 template <class FileType>
 int FileCache<FileType>::NumDescriptorsForTests() const {
-  std::lock_guard<simple_spinlock> l(lock_);
-  return descriptors_.size();
+  int num_descriptors = 0;
+  for (const auto& shard : shards_) {
+    std::lock_guard<simple_spinlock> l(shard.lock);
+    num_descriptors += shard.descriptors.size();
+  }
+  return num_descriptors;
 }
 
 template <class FileType>
 string FileCache<FileType>::ToDebugString() const {
-  std::lock_guard<simple_spinlock> l(lock_);
   string ret;
-  for (const auto& e : descriptors_) {
-    bool strong = false;
-    bool deleted = false;
-    bool opened = false;
-    shared_ptr<internal::Descriptor<FileType>> desc = e.second.lock();
-    if (desc) {
-      strong = true;
-      if (desc->base_.deleted()) {
-        deleted = true;
+  for (const auto& shard : shards_) {
+    std::lock_guard<simple_spinlock> l(shard.lock);
+    for (const auto& e : shard.descriptors) {
+      bool strong = false;
+      bool deleted = false;
+      bool opened = false;
+      shared_ptr<internal::Descriptor<FileType>> desc = e.second.lock();
+      if (desc) {
+        strong = true;
+        if (desc->base_.deleted()) {
+          deleted = true;
+        }
+        internal::ScopedOpenedDescriptor<FileType> o(
+            desc->base_.LookupFromCache());
+        if (o.opened()) {
+          opened = true;
+        }
       }
-      internal::ScopedOpenedDescriptor<FileType> o(
-          desc->base_.LookupFromCache());
-      if (o.opened()) {
-        opened = true;
+      if (strong) {
+        ret += Substitute("$0 (S$1$2)\n", e.first,
+                          deleted ? "D" : "", opened ? "O" : "");
+      } else {
+        ret += Substitute("$0\n", e.first);
       }
     }
-    if (strong) {
-      ret += Substitute("$0 (S$1$2)\n", e.first,
-                        deleted ? "D" : "", opened ? "O" : "");
-    } else {
-      ret += Substitute("$0\n", e.first);
-    }
   }
   return ret;
 }
 
+template <class FileType>
+typename FileCache<FileType>::DescriptorShard* FileCache<FileType>::ShardFor(
+    const string& file_name) {
+  return &shards_[std::hash<string>()(file_name) % kNumDescriptorShards];
+}
+
 template <class FileType>
 Status FileCache<FileType>::FindDescriptorUnlocked(
+    DescriptorShard* shard,
     const string& file_name,
     shared_ptr<internal::Descriptor<FileType>>* file) {
-  DCHECK(lock_.is_locked());
+  DCHECK(shard->lock.is_locked());
 
-  auto it = descriptors_.find(file_name);
-  if (it != descriptors_.end()) {
+  auto it = shard->descriptors.find(file_name);
+  if (it != shard->descriptors.end()) {
     // Found the descriptor. Has it expired?
     shared_ptr<internal::Descriptor<FileType>> desc = it->second.lock();
     if (desc) {
@@ -627,21 +771,42 @@ Status FileCache<FileType>::FindDescriptorUnlocked(
       return Status::OK();
     }
     // Descriptor has expired; erase it and pretend we found nothing.
-    descriptors_.erase(it);
+    shard->descriptors.erase(it);
   }
   return Status::OK();
 }
 
+template <class FileType>
+Status FileCache<FileType>::FindOrCreateDescriptor(
+    const string& file_name,
+    shared_ptr<internal::Descriptor<FileType>>* file) {
+  DescriptorShard* shard = ShardFor(file_name);
+  std::lock_guard<simple_spinlock> l(shard->lock);
+  shared_ptr<internal::Descriptor<FileType>> desc;
+  RETURN_NOT_OK(FindDescriptorUnlocked(shard, file_name, &desc));
+  if (desc) {
+    VLOG(2) << "Found existing descriptor: " << desc->filename();
+  } else {
+    desc = std::make_shared<internal::Descriptor<FileType>>(this, file_name);
+    InsertOrDie(&shard->descriptors, file_name, desc);
+    VLOG(2) << "Created new descriptor: " << desc->filename();
+  }
+  *file = std::move(desc);
+  return Status::OK();
+}
+
 template <class FileType>
 void FileCache<FileType>::RunDescriptorExpiry() {
   while (!running_.WaitFor(MonoDelta::FromMilliseconds(
       FLAGS_file_cache_expiry_period_ms))) {
-    std::lock_guard<simple_spinlock> l(lock_);
-    for (auto it = descriptors_.begin(); it != descriptors_.end();) {
-      if (it->second.expired()) {
-        it = descriptors_.erase(it);
-      } else {
-        it++;
+    for (auto& shard : shards_) {
+      std::lock_guard<simple_spinlock> l(shard.lock);
+      for (auto it = shard.descriptors.begin(); it != shard.descriptors.end();) {
+        if (it->second.expired()) {
+          it = shard.descriptors.erase(it);
+        } else {
+          it++;
+        }
       }
     }
   }
@@ -17,12 +17,15 @@
 
 #pragma once
 
+#include <array>
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include <gtest/gtest_prod.h>
 
+#include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/util/cache.h"
@@ -46,6 +49,7 @@ class Descriptor;
 
 class MetricEntity;
 class Thread;
+class ThreadPool;
 
 // Cache of open files.
 //
@@ -67,14 +71,21 @@ class Thread;
 // client if a file with the same name is already opened. To facilitate
 // descriptor sharing, the file cache maintains a by-file-name descriptor map.
 // The values are weak references to the descriptors so that map entries don't
-// affect the descriptor lifecycle.
+// affect the descriptor lifecycle. The map is sharded by file name, so that
+// concurrent opens of different files rarely contend on the same lock.
+//
+// Batches of files, e.g. all the cfiles of a rowset, may be opened in one go
+// with OpenExistingFiles(), which issues the open() calls in parallel.
 //
 // LRU cache
 // ---------
 // The lower half of the file cache is a standard LRU cache whose keys are file
 // names and whose values are pointers to opened file objects allocated on the
 // heap. Unlike the descriptor map, this cache has an upper bound on capacity,
-// and handles are evicted (and closed) according to an LRU algorithm.
+// and handles are evicted (and closed) according to an LRU algorithm. Part of
+// the capacity is reserved for files which were used again after being
+// opened (see --file_cache_high_priority_pool_ratio), so that a wide scan
+// over many cold files doesn't evict the files in regular use.
 //
 // Whenever a descriptor is used by a client in file I/O, its file name is used
 // in an LRU cache lookup. If found, the underlying file is still open and the
@@ -123,6 +134,14 @@ class FileCache {
   Status OpenExistingFile(const std::string& file_name,
                           std::shared_ptr<FileType>* file);
 
+  // Like OpenExistingFile(), but for several files at once. The files which
+  // aren't already open are opened in parallel.
+  //
+  // On success, 'files' holds the descriptors in the order of 'file_names'.
+  // Does not modify 'files' on error.
+  Status OpenExistingFiles(const std::vector<std::string>& file_names,
+                           std::vector<std::shared_ptr<FileType>>* files);
+
   // Deletes a file by name through the cache.
   //
   // If there is an outstanding descriptor for the file, the deletion will be
@@ -167,14 +186,36 @@ class FileCache {
   template<class FileType2>
   FRIEND_TEST(FileCacheTest, TestBasicOperations);
 
+  // A shard of the descriptor map.
+  struct DescriptorShard {
+    // Protects 'descriptors'.
+    mutable simple_spinlock lock;
+
+    // Maps filenames to descriptors.
+    std::unordered_map<std::string,
+                       std::weak_ptr<internal::Descriptor<FileType>>> descriptors;
+  };
+
+  static const int kNumDescriptorShards = 16;
+
+  // Returns the shard of the descriptor map in which 'file_name' belongs.
+  DescriptorShard* ShardFor(const std::string& file_name);
+
   // Looks up a descriptor by file name.
   //
-  // Must be called with 'lock_' held.
+  // Must be called with the lock of 'shard' held.
   Status FindDescriptorUnlocked(
+      DescriptorShard* shard,
+      const std::string& file_name,
+      std::shared_ptr<internal::Descriptor<FileType>>* file);
+
+  // Finds the descriptor of 'file_name', creating it if none exists. The
+  // descriptor isn't opened.
+  Status FindOrCreateDescriptor(
       const std::string& file_name,
       std::shared_ptr<internal::Descriptor<FileType>>* file);
 
-  // Periodically removes expired descriptors from 'descriptors_'.
+  // Periodically removes expired descriptors from the descriptor map.
   void RunDescriptorExpiry();
 
   // Interface to the underlying filesystem.
@@ -190,12 +231,12 @@ class FileCache {
   // Underlying cache instance. Caches opened files.
   std::unique_ptr<Cache> cache_;
 
-  // Protects the descriptor map.
-  mutable simple_spinlock lock_;
+  // The descriptor map.
+  std::array<DescriptorShard, kNumDescriptorShards> shards_;
 
-  // Maps filenames to descriptors.
-  std::unordered_map<std::string,
-                     std::weak_ptr<internal::Descriptor<FileType>>> descriptors_;
+  // Opens the files of OpenExistingFiles() in parallel. Null if
+  // --file_cache_open_threads is 0.
+  gscoped_ptr<ThreadPool> open_pool_;
 
   // Calls RunDescriptorExpiry() in a loop until 'running_' isn't set.
   scoped_refptr<Thread> descriptor_expiry_thread_;
@@ -113,4 +113,27 @@ TEST_F(HdrHistogramTest, PercentileAndCopyTest) {
   ASSERT_EQ(hist.TotalSum(), copy.TotalSum());
 }
 
+TEST_F(HdrHistogramTest, MergeTest) {
+  HdrHistogram a(10000LU, kSigDigits);
+  HdrHistogram b(10000LU, kSigDigits);
+  HdrHistogram merged(10000LU, kSigDigits);
+  a.Increment(5);
+  a.IncrementBy(100, 2);
+  b.Increment(1);
+  b.Increment(9000);
+
+  merged.MergeFrom(a);
+  merged.MergeFrom(b);
+  ASSERT_EQ(5, merged.TotalCount());
+  ASSERT_EQ(5 + 200 + 1 + 9000, merged.TotalSum());
+  ASSERT_EQ(1, merged.MinValue());
+  ASSERT_EQ(b.MaxValue(), merged.MaxValue());
+  ASSERT_EQ(2, merged.CountInBucketForValue(100));
+
+  // Merging an empty histogram changes nothing.
+  merged.MergeFrom(HdrHistogram(10000LU, kSigDigits));
+  ASSERT_EQ(5, merged.TotalCount());
+  ASSERT_EQ(1, merged.MinValue());
+}
+
 } // namespace kudu
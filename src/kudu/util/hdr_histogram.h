@@ -95,6 +95,11 @@ class HdrHistogram {
   void IncrementWithExpectedInterval(int64_t value,
                                      int64_t expected_interval_between_samples);
 
+  // Add all of the values recorded in 'other', which must have the same
+  // configuration as this histogram. Like the copy constructor, this isn't
+  // consistent with respect to concurrent writers of 'other'.
+  void MergeFrom(const HdrHistogram& other);
+
   // Fetch configuration params.
   uint64_t highest_trackable_value() const { return highest_trackable_value_; }
   int num_significant_digits() const { return num_significant_digits_; }
@@ -177,6 +182,10 @@ class HdrHistogram {
   void Init();
   int CountsArrayIndex(int bucket_index, int sub_bucket_index) const;
 
+  // Lower min_value_ to 'value' and raise max_value_ to 'value', if needed.
+  void UpdateMin(int64_t value);
+  void UpdateMax(int64_t value);
+
   uint64_t highest_trackable_value_;
   int num_significant_digits_;
   int counts_array_length_;
@@ -0,0 +1,97 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/util/hugepage_allocator.h"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "kudu/util/test_util.h"
+
+using std::vector;
+
+namespace kudu {
+
+class HugePageSlabAllocatorTest : public KuduTest {
+};
+
+TEST_F(HugePageSlabAllocatorTest, TestAllocateAndFree) {
+  HugePageSlabAllocator allocator(4 * HugePageSlabAllocator::kSlabSize, false);
+  ASSERT_TRUE(allocator.enabled());
+
+  // Sizes out of the range of the size classes are left to the heap.
+  ASSERT_EQ(nullptr, allocator.Allocate(100));
+  ASSERT_EQ(nullptr, allocator.Allocate(HugePageSlabAllocator::kMaxAllocationSize + 1));
+
+  // Sizes are rounded up to their size class.
+  void* p = allocator.Allocate(1025);
+  ASSERT_NE(nullptr, p);
+  ASSERT_TRUE(allocator.Owns(p));
+  ASSERT_EQ(1280, allocator.UsableSize(p));
+  ASSERT_EQ(0, reinterpret_cast<uintptr_t>(p) % 256);
+  memset(p, 0xff, 1280);
+
+  void* q = allocator.Allocate(64 * 1024);
+  ASSERT_NE(nullptr, q);
+  ASSERT_EQ(64 * 1024, allocator.UsableSize(q));
+
+  HugePageSlabAllocator::Stats stats;
+  allocator.GetStats(&stats);
+  ASSERT_EQ(4 * HugePageSlabAllocator::kSlabSize, stats.capacity_bytes);
+  ASSERT_EQ(2 * HugePageSlabAllocator::kSlabSize, stats.committed_bytes);
+  ASSERT_EQ(1280 + 64 * 1024, stats.allocated_bytes);
+  ASSERT_EQ(2, stats.size_classes.size());
+
+  // Freed objects are reused, and slabs stay with their size class.
+  ASSERT_TRUE(allocator.Free(p));
+  ASSERT_EQ(p, allocator.Allocate(1100));
+  ASSERT_TRUE(allocator.Free(p));
+  ASSERT_TRUE(allocator.Free(q));
+  allocator.GetStats(&stats);
+  ASSERT_EQ(2 * HugePageSlabAllocator::kSlabSize, stats.committed_bytes);
+  ASSERT_EQ(0, stats.allocated_bytes);
+
+  // Pointers from the heap aren't freed.
+  int x;
+  ASSERT_FALSE(allocator.Free(&x));
+}
+
+TEST_F(HugePageSlabAllocatorTest, TestExhaustion) {
+  HugePageSlabAllocator allocator(2 * HugePageSlabAllocator::kSlabSize, false);
+  vector<void*> ptrs;
+  while (void* p = allocator.Allocate(HugePageSlabAllocator::kMaxAllocationSize)) {
+    ptrs.push_back(p);
+  }
+  ASSERT_EQ(4, ptrs.size());
+  // All the slabs are dedicated to the largest size class.
+  ASSERT_EQ(nullptr, allocator.Allocate(2048));
+  ASSERT_TRUE(allocator.Free(ptrs.back()));
+  ASSERT_EQ(ptrs.back(), allocator.Allocate(HugePageSlabAllocator::kMaxAllocationSize));
+  for (void* p : ptrs) {
+    ASSERT_TRUE(allocator.Free(p));
+  }
+}
+
+TEST_F(HugePageSlabAllocatorTest, TestDisabled) {
+  ASSERT_FALSE(HugePageSlabAllocator::Get()->enabled());
+  ASSERT_EQ(nullptr, HugePageSlabAllocator::Get()->Allocate(4096));
+}
+
+} // namespace kudu
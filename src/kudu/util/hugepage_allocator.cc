@@ -0,0 +1,226 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/util/hugepage_allocator.h"
+
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <mutex>
+#include <ostream>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "kudu/util/alignment.h"
+#include "kudu/util/errno.h"
+#include "kudu/util/flag_tags.h"
+
+DEFINE_int64(hugepage_slab_allocator_capacity_mb, 0,
+             "Size of the huge page backed slabs from which the block cache "
+             "and the arenas of the MemRowSets and DeltaMemStores allocate "
+             "their buffers. The buffers which don't fit in the slabs are "
+             "allocated from the heap. 0 disables the slabs.");
+TAG_FLAG(hugepage_slab_allocator_capacity_mb, experimental);
+
+DEFINE_bool(hugepage_slab_allocator_use_hugetlbfs, false,
+            "Whether to back the slabs of --hugepage_slab_allocator_capacity_mb "
+            "with pages reserved for hugetlbfs, rather than with transparent "
+            "huge pages. The kernel must have enough free huge pages for the "
+            "whole capacity, otherwise transparent huge pages are used.");
+TAG_FLAG(hugepage_slab_allocator_use_hugetlbfs, experimental);
+
+using std::lock_guard;
+using std::unique_ptr;
+
+namespace kudu {
+
+constexpr size_t HugePageSlabAllocator::kSlabSize;
+constexpr size_t HugePageSlabAllocator::kMinAllocationSize;
+constexpr size_t HugePageSlabAllocator::kMaxAllocationSize;
+
+HugePageSlabAllocator* HugePageSlabAllocator::Get() {
+  static HugePageSlabAllocator* allocator = new HugePageSlabAllocator(
+      static_cast<size_t>(std::max<int64_t>(FLAGS_hugepage_slab_allocator_capacity_mb, 0)) << 20,
+      FLAGS_hugepage_slab_allocator_use_hugetlbfs);
+  return allocator;
+}
+
+HugePageSlabAllocator::HugePageSlabAllocator(size_t capacity, bool use_hugetlbfs)
+    : base_(nullptr),
+      capacity_(0),
+      mapped_size_(0),
+      mapping_(nullptr),
+      num_slabs_(0),
+      next_slab_(0) {
+  // Four size classes per doubling bound the internal fragmentation to 25%.
+  for (size_t size = kMinAllocationSize; size < kMaxAllocationSize; size *= 2) {
+    for (int quarters = 4; quarters < 8; quarters++) {
+      size_classes_.emplace_back(new SizeClass(size * quarters / 4));
+    }
+  }
+  size_classes_.emplace_back(new SizeClass(kMaxAllocationSize));
+
+  capacity = capacity / kSlabSize * kSlabSize;
+  if (capacity == 0) {
+    return;
+  }
+
+  void* mapping = MAP_FAILED;
+#if defined(__linux__) && defined(MAP_HUGETLB)
+  if (use_hugetlbfs) {
+    // The mapping is aligned on the huge page size. It fails upfront if the
+    // kernel doesn't have enough huge pages.
+    mapping = mmap(nullptr, capacity, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (mapping == MAP_FAILED) {
+      int err = errno;
+      LOG(WARNING) << "Unable to map " << capacity << " bytes of hugetlbfs pages, "
+                   << "using transparent huge pages instead: " << ErrnoToString(err);
+    } else {
+      mapped_size_ = capacity;
+      base_ = reinterpret_cast<uint8_t*>(mapping);
+    }
+  }
+#endif
+  if (mapping == MAP_FAILED) {
+    // Over-reserve by one slab to align the slabs on huge pages.
+    mapped_size_ = capacity + kSlabSize;
+    mapping = mmap(nullptr, mapped_size_, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (mapping == MAP_FAILED) {
+      int err = errno;
+      LOG(WARNING) << "Unable to reserve " << capacity << " bytes for the huge page "
+                   << "slab allocator, disabling it: " << ErrnoToString(err);
+      mapped_size_ = 0;
+      return;
+    }
+    base_ = reinterpret_cast<uint8_t*>(
+        KUDU_ALIGN_UP(reinterpret_cast<uintptr_t>(mapping), kSlabSize));
+#ifdef MADV_HUGEPAGE
+    if (madvise(base_, capacity, MADV_HUGEPAGE) != 0) {
+      int err = errno;
+      LOG(WARNING) << "Unable to enable transparent huge pages for the huge page "
+                   << "slab allocator: " << ErrnoToString(err);
+    }
+#endif
+  }
+  mapping_ = reinterpret_cast<uint8_t*>(mapping);
+  capacity_ = capacity;
+  num_slabs_ = capacity / kSlabSize;
+  slab_classes_.reset(new std::atomic<uint8_t>[num_slabs_]);
+}
+
+HugePageSlabAllocator::~HugePageSlabAllocator() {
+  if (mapping_ != nullptr) {
+    PCHECK(munmap(mapping_, mapped_size_) == 0);
+  }
+}
+
+int HugePageSlabAllocator::SizeClassIndex(size_t size) const {
+  DCHECK_GE(size, kMinAllocationSize);
+  DCHECK_LE(size, kMaxAllocationSize);
+  auto it = std::lower_bound(size_classes_.begin(), size_classes_.end(), size,
+                             [](const unique_ptr<SizeClass>& c, size_t s) {
+                               return c->object_size < s;
+                             });
+  DCHECK(it != size_classes_.end());
+  return it - size_classes_.begin();
+}
+
+bool HugePageSlabAllocator::RefillUnlocked(int class_idx, SizeClass* size_class) {
+  size_t slab = next_slab_.load(std::memory_order_relaxed);
+  do {
+    if (slab >= num_slabs_) {
+      return false;
+    }
+  } while (!next_slab_.compare_exchange_weak(slab, slab + 1));
+  slab_classes_[slab].store(class_idx, std::memory_order_release);
+
+  // Thread the objects so that they're handed out in address order.
+  uint8_t* start = base_ + slab * kSlabSize;
+  const size_t num_objects = kSlabSize / size_class->object_size;
+  for (size_t i = num_objects; i-- > 0;) {
+    FreeObject* obj = reinterpret_cast<FreeObject*>(start + i * size_class->object_size);
+    obj->next = size_class->free_list;
+    size_class->free_list = obj;
+  }
+  size_class->num_slabs++;
+  return true;
+}
+
+void* HugePageSlabAllocator::Allocate(size_t size) {
+  if (!enabled() || size < kMinAllocationSize || size > kMaxAllocationSize) {
+    return nullptr;
+  }
+  const int class_idx = SizeClassIndex(size);
+  SizeClass* size_class = size_classes_[class_idx].get();
+  lock_guard<simple_spinlock> l(size_class->lock);
+  if (size_class->free_list == nullptr && !RefillUnlocked(class_idx, size_class)) {
+    return nullptr;
+  }
+  FreeObject* obj = size_class->free_list;
+  size_class->free_list = obj->next;
+  size_class->num_allocated++;
+  return obj;
+}
+
+size_t HugePageSlabAllocator::UsableSize(const void* ptr) const {
+  DCHECK(Owns(ptr));
+  const size_t slab = (reinterpret_cast<const uint8_t*>(ptr) - base_) / kSlabSize;
+  return size_classes_[slab_classes_[slab].load(std::memory_order_acquire)]->object_size;
+}
+
+bool HugePageSlabAllocator::Free(void* ptr) {
+  if (!Owns(ptr)) {
+    return false;
+  }
+  const size_t slab = (reinterpret_cast<uint8_t*>(ptr) - base_) / kSlabSize;
+  SizeClass* size_class =
+      size_classes_[slab_classes_[slab].load(std::memory_order_acquire)].get();
+  FreeObject* obj = reinterpret_cast<FreeObject*>(ptr);
+  lock_guard<simple_spinlock> l(size_class->lock);
+  obj->next = size_class->free_list;
+  size_class->free_list = obj;
+  size_class->num_allocated--;
+  DCHECK_GE(size_class->num_allocated, 0);
+  return true;
+}
+
+void HugePageSlabAllocator::GetStats(Stats* stats) const {
+  stats->capacity_bytes = capacity_;
+  stats->committed_bytes = committed_bytes();
+  stats->allocated_bytes = 0;
+  stats->size_classes.clear();
+  for (const auto& size_class : size_classes_) {
+    SizeClassStats class_stats;
+    class_stats.object_size = size_class->object_size;
+    {
+      lock_guard<simple_spinlock> l(size_class->lock);
+      class_stats.num_slabs = size_class->num_slabs;
+      class_stats.num_allocated = size_class->num_allocated;
+    }
+    if (class_stats.num_slabs == 0) {
+      continue;
+    }
+    stats->allocated_bytes += class_stats.num_allocated * class_stats.object_size;
+    stats->size_classes.push_back(class_stats);
+  }
+}
+
+} // namespace kudu
@@ -0,0 +1,179 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_UTIL_HUGEPAGE_ALLOCATOR_H
+#define KUDU_UTIL_HUGEPAGE_ALLOCATOR_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest_prod.h>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/port.h"
+#include "kudu/util/locks.h"
+
+namespace kudu {
+
+// A slab allocator for the large, long-lived buffers of the block cache and
+// of the arenas of the MemRowSets and DeltaMemStores, backed by huge pages.
+//
+// At startup, the allocator reserves --hugepage_slab_allocator_capacity_mb of
+// address space, backed by hugetlbfs pages if
+// --hugepage_slab_allocator_use_hugetlbfs is set and the kernel has enough of
+// them, or else by transparent huge pages. The space is carved into 2MB slabs,
+// each dedicated to one size class once first needed. The size classes range
+// from 1KB to 1MB, four per doubling, which fits the usual sizes of the cfile
+// blocks and of the arena components with a bounded internal fragmentation.
+// Slabs are never returned to the kernel, nor moved between size classes.
+//
+// The allocator is disabled by default. When it's disabled, or when it can't
+// serve a request because the size is out of its range or the slabs of the
+// class are full, Allocate() returns nullptr and the caller falls back to
+// the heap.
+//
+// This class is thread-safe.
+class HugePageSlabAllocator {
+ public:
+  // The size of a slab, which is also the size of a huge page on x86-64.
+  static constexpr size_t kSlabSize = 2 * 1024 * 1024;
+
+  // The smallest and the largest size served by the allocator.
+  static constexpr size_t kMinAllocationSize = 1024;
+  static constexpr size_t kMaxAllocationSize = 1024 * 1024;
+
+  // The usage of one size class.
+  struct SizeClassStats {
+    // The size of the objects of the class.
+    size_t object_size;
+    // The number of slabs dedicated to the class.
+    int64_t num_slabs;
+    // The number of objects allocated and not freed.
+    int64_t num_allocated;
+  };
+
+  // The usage of the whole allocator.
+  struct Stats {
+    // The address space reserved by the allocator. 0 if it's disabled.
+    int64_t capacity_bytes;
+    // The bytes of the slabs dedicated to a size class.
+    int64_t committed_bytes;
+    // The bytes of the allocated objects, rounded up to their size class.
+    // The difference with 'committed_bytes' is lost to fragmentation.
+    int64_t allocated_bytes;
+    // The size classes with at least one slab.
+    std::vector<SizeClassStats> size_classes;
+  };
+
+  // Returns the process-wide allocator, which is set up as per the flags
+  // the first time this is called.
+  static HugePageSlabAllocator* Get();
+
+  ~HugePageSlabAllocator();
+
+  // Returns whether the allocator has reserved its slabs.
+  bool enabled() const { return base_ != nullptr; }
+
+  // Returns a buffer of at least 'size' bytes, aligned on 256 bytes, or
+  // nullptr if the allocator can't serve the request. Sizes below
+  // kMinAllocationSize are left to the heap.
+  void* Allocate(size_t size);
+
+  // Returns whether 'ptr' was allocated by Allocate().
+  bool Owns(const void* ptr) const {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(ptr);
+    return p >= base_ && p < base_ + capacity_;
+  }
+
+  // Returns the usable size of 'ptr', which must be owned by the allocator.
+  size_t UsableSize(const void* ptr) const;
+
+  // Frees 'ptr' and returns true if it was allocated by Allocate(). Returns
+  // false and does nothing otherwise.
+  bool Free(void* ptr);
+
+  // Returns the bytes of the slabs dedicated to a size class, which count
+  // towards the memory consumption of the process.
+  int64_t committed_bytes() const {
+    return static_cast<int64_t>(next_slab_.load(std::memory_order_relaxed)) * kSlabSize;
+  }
+
+  // Fills 'stats' with the current usage of the allocator.
+  void GetStats(Stats* stats) const;
+
+ private:
+  FRIEND_TEST(HugePageSlabAllocatorTest, TestAllocateAndFree);
+  FRIEND_TEST(HugePageSlabAllocatorTest, TestExhaustion);
+
+  // An object of a free list.
+  struct FreeObject {
+    FreeObject* next;
+  };
+
+  struct SizeClass {
+    explicit SizeClass(size_t size)
+        : object_size(size),
+          free_list(nullptr),
+          num_slabs(0),
+          num_allocated(0) {
+    }
+
+    const size_t object_size;
+
+    // Protects the fields below.
+    mutable simple_spinlock lock;
+    FreeObject* free_list;
+    int64_t num_slabs;
+    int64_t num_allocated;
+  };
+
+  // Reserves 'capacity' bytes of address space, rounded down to a multiple of
+  // kSlabSize. A 0 capacity disables the allocator.
+  HugePageSlabAllocator(size_t capacity, bool use_hugetlbfs);
+
+  // Returns the index of the smallest size class fitting 'size', which must be
+  // in [kMinAllocationSize, kMaxAllocationSize].
+  int SizeClassIndex(size_t size) const;
+
+  // Dedicates a new slab to 'size_class' and puts its objects on the free
+  // list. Returns false if all the slabs are already used.
+  bool RefillUnlocked(int class_idx, SizeClass* size_class);
+
+  // The reserved address space.
+  uint8_t* base_;
+  size_t capacity_;
+  // The size of the mapping, which may be larger than 'capacity_' to align
+  // 'base_' on kSlabSize.
+  size_t mapped_size_;
+  uint8_t* mapping_;
+
+  std::vector<std::unique_ptr<SizeClass>> size_classes_;
+
+  // The index of the size class of each slab, set when the slab is first
+  // dedicated to a class and immutable afterwards.
+  std::unique_ptr<std::atomic<uint8_t>[]> slab_classes_;
+  size_t num_slabs_;
+  std::atomic<size_t> next_slab_;
+
+  DISALLOW_COPY_AND_ASSIGN(HugePageSlabAllocator);
+};
+
+} // namespace kudu
+
+#endif // KUDU_UTIL_HUGEPAGE_ALLOCATOR_H
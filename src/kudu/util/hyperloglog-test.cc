@@ -0,0 +1,112 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/util/hyperloglog.h"
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "kudu/gutil/hash/city.h"
+#include "kudu/util/slice.h"
+#include "kudu/util/test_macros.h"
+
+using std::string;
+
+namespace kudu {
+
+namespace {
+
+uint64_t HashInt(uint64_t v) {
+  return util_hash::CityHash64(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+// Asserts that 'estimate' is within 'error' (a fraction) of 'expected'.
+void AssertEstimateNear(uint64_t expected, uint64_t estimate, double error) {
+  ASSERT_GE(estimate, expected * (1 - error)) << "expected about " << expected;
+  ASSERT_LE(estimate, expected * (1 + error)) << "expected about " << expected;
+}
+
+} // anonymous namespace
+
+TEST(HyperLogLogTest, TestEmpty) {
+  HyperLogLog hll;
+  ASSERT_EQ(0, hll.Estimate());
+}
+
+TEST(HyperLogLogTest, TestEstimates) {
+  for (int precision : { HyperLogLog::kMinPrecision,
+                         HyperLogLog::kDefaultPrecision,
+                         HyperLogLog::kMaxPrecision }) {
+    // Four times the standard error.
+    const double error = 4 * 1.04 / sqrt(1 << precision);
+    for (uint64_t n : { 10, 1000, 100000 }) {
+      SCOPED_TRACE(precision);
+      SCOPED_TRACE(n);
+      HyperLogLog hll(precision);
+      for (uint64_t i = 0; i < n; i++) {
+        hll.AddHash(HashInt(i));
+      }
+      NO_FATALS(AssertEstimateNear(n, hll.Estimate(), error));
+
+      // Adding the same values again doesn't change anything.
+      uint64_t estimate = hll.Estimate();
+      for (uint64_t i = 0; i < n; i++) {
+        hll.AddHash(HashInt(i));
+      }
+      ASSERT_EQ(estimate, hll.Estimate());
+    }
+  }
+}
+
+TEST(HyperLogLogTest, TestMerge) {
+  HyperLogLog a;
+  HyperLogLog b;
+  // Two overlapping ranges, with 15000 distinct values between them.
+  for (uint64_t i = 0; i < 10000; i++) {
+    a.AddHash(HashInt(i));
+    b.AddHash(HashInt(i + 5000));
+  }
+  a.Merge(b);
+  NO_FATALS(AssertEstimateNear(15000, a.Estimate(), 0.15));
+}
+
+TEST(HyperLogLogTest, TestSerialization) {
+  HyperLogLog hll(12);
+  for (uint64_t i = 0; i < 5000; i++) {
+    hll.AddHash(HashInt(i));
+  }
+  string serialized;
+  hll.SerializeTo(&serialized);
+  ASSERT_EQ(1 + (1 << 12), serialized.size());
+
+  HyperLogLog parsed;
+  ASSERT_OK(HyperLogLog::ParseFrom(serialized, &parsed));
+  ASSERT_EQ(12, parsed.precision());
+  ASSERT_EQ(hll.Estimate(), parsed.Estimate());
+
+  // Truncated or otherwise invalid sketches are rejected.
+  ASSERT_TRUE(HyperLogLog::ParseFrom(Slice(), &parsed).IsCorruption());
+  ASSERT_TRUE(HyperLogLog::ParseFrom(Slice(serialized.data(), serialized.size() - 1),
+                                     &parsed).IsCorruption());
+  serialized[0] = 30;
+  ASSERT_TRUE(HyperLogLog::ParseFrom(serialized, &parsed).IsCorruption());
+}
+
+} // namespace kudu
@@ -0,0 +1,110 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/util/hyperloglog.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <glog/logging.h>
+
+#include "kudu/gutil/bits.h"
+#include "kudu/gutil/strings/substitute.h"
+
+using std::string;
+using strings::Substitute;
+
+namespace kudu {
+
+HyperLogLog::HyperLogLog(int precision)
+    : precision_(precision),
+      registers_(1 << precision, 0) {
+  CHECK_GE(precision, kMinPrecision);
+  CHECK_LE(precision, kMaxPrecision);
+}
+
+void HyperLogLog::AddHash(uint64_t hash) {
+  // The top 'precision_' bits select the register; the register records the
+  // longest run of leading zeros seen in the remaining bits.
+  const size_t idx = hash >> (64 - precision_);
+  const uint64_t rest = hash << precision_;
+  const int max_rank = 64 - precision_ + 1;
+  const uint8_t rank = rest == 0 ? max_rank : 64 - Bits::Log2Floor64(rest);
+  registers_[idx] = std::max(registers_[idx], rank);
+}
+
+void HyperLogLog::Merge(const HyperLogLog& other) {
+  CHECK_EQ(precision_, other.precision_);
+  for (size_t i = 0; i < registers_.size(); i++) {
+    registers_[i] = std::max(registers_[i], other.registers_[i]);
+  }
+}
+
+uint64_t HyperLogLog::Estimate() const {
+  const double m = registers_.size();
+  double sum = 0;
+  int num_zeros = 0;
+  for (uint8_t r : registers_) {
+    sum += std::ldexp(1.0, -r);
+    if (r == 0) {
+      num_zeros++;
+    }
+  }
+  double alpha;
+  switch (precision_) {
+    case 4: alpha = 0.673; break;
+    case 5: alpha = 0.697; break;
+    case 6: alpha = 0.709; break;
+    default: alpha = 0.7213 / (1 + 1.079 / m); break;
+  }
+  double estimate = alpha * m * m / sum;
+
+  // For small cardinalities, linear counting of the empty registers is more
+  // accurate. With 64-bit hashes, no correction is needed for large ones.
+  if (estimate <= 2.5 * m && num_zeros > 0) {
+    estimate = m * std::log(m / num_zeros);
+  }
+  return static_cast<uint64_t>(std::llround(estimate));
+}
+
+void HyperLogLog::SerializeTo(string* out) const {
+  out->clear();
+  out->reserve(1 + registers_.size());
+  out->push_back(static_cast<char>(precision_));
+  out->append(reinterpret_cast<const char*>(registers_.data()), registers_.size());
+}
+
+Status HyperLogLog::ParseFrom(const Slice& data, HyperLogLog* hll) {
+  if (PREDICT_FALSE(data.empty())) {
+    return Status::Corruption("empty HyperLogLog sketch");
+  }
+  const int precision = data[0];
+  if (PREDICT_FALSE(precision < kMinPrecision || precision > kMaxPrecision)) {
+    return Status::Corruption(Substitute("invalid HyperLogLog precision: $0", precision));
+  }
+  const size_t num_registers = 1 << precision;
+  if (PREDICT_FALSE(data.size() != 1 + num_registers)) {
+    return Status::Corruption(Substitute(
+        "HyperLogLog sketch of precision $0 has $1 bytes, expected $2",
+        precision, data.size(), 1 + num_registers));
+  }
+  hll->precision_ = precision;
+  hll->registers_.assign(data.data() + 1, data.data() + data.size());
+  return Status::OK();
+}
+
+} // namespace kudu
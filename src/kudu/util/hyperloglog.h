@@ -0,0 +1,82 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_UTIL_HYPERLOGLOG_H
+#define KUDU_UTIL_HYPERLOGLOG_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "kudu/util/slice.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+// A HyperLogLog sketch, which estimates the number of distinct values in a
+// set using a fixed, small amount of memory. Sketches of different sets can
+// be merged into a sketch of their union.
+//
+// With 2^p registers, the standard error of the estimate is about
+// 1.04 / sqrt(2^p): e.g. 3.25% for the default precision of 10, for which
+// the serialized sketch takes a little over 1KB.
+//
+// See "HyperLogLog: the analysis of a near-optimal cardinality estimation
+// algorithm", Flajolet et al., AofA 2007.
+//
+// This class is not thread-safe.
+class HyperLogLog {
+ public:
+  static const int kMinPrecision = 4;
+  static const int kMaxPrecision = 16;
+  static const int kDefaultPrecision = 10;
+
+  explicit HyperLogLog(int precision = kDefaultPrecision);
+
+  // Adds a value, given its 64-bit hash. The hash function must mix its
+  // input well (e.g. CityHash), and must be the same for all sketches which
+  // are merged together.
+  void AddHash(uint64_t hash);
+
+  // Adds the values of 'other', which must have the same precision, to this
+  // sketch.
+  void Merge(const HyperLogLog& other);
+
+  // Returns the estimated number of distinct values added.
+  uint64_t Estimate() const;
+
+  int precision() const {
+    return precision_;
+  }
+
+  // Serializes the sketch into 'out', replacing its contents.
+  void SerializeTo(std::string* out) const;
+
+  // Parses a sketch serialized by SerializeTo() into 'hll'.
+  static Status ParseFrom(const Slice& data, HyperLogLog* hll);
+
+ private:
+  int precision_;
+
+  // For each of the 2^precision_ buckets which hashes are split into, the
+  // maximum position of the first set bit in the remaining hash bits of
+  // the values in that bucket.
+  std::vector<uint8_t> registers_;
+};
+
+} // namespace kudu
+
+#endif // KUDU_UTIL_HYPERLOGLOG_H
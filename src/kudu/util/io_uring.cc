@@ -0,0 +1,455 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/util/io_uring.h"
+
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <glog/logging.h>
+
+#include "kudu/gutil/basictypes.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/port.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/errno.h"
+#include "kudu/util/slice.h"
+
+using std::unique_ptr;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+
+struct IoUring::Operation {
+  uint8_t opcode = 0;
+  int fd = -1;
+  uint64_t offset = 0;
+  uint32_t op_flags = 0;
+
+  ResultCallback callback;
+
+  // The iovecs handed to the kernel, which must outlive the operation.
+  vector<struct iovec> iov;
+};
+
+#if defined(__linux__)
+
+namespace {
+
+// The io_uring kernel ABI, declared here rather than taken from
+// <linux/io_uring.h> or liburing so that Kudu builds against older kernel
+// headers and doesn't take on a new dependency. Only the parts used below are
+// declared.
+//
+// These layouts are fixed by the kernel and have been stable since io_uring
+// was introduced in Linux 5.1.
+
+const long kSysIoUringSetup = 425;  // NOLINT(runtime/int)
+const long kSysIoUringEnter = 426;  // NOLINT(runtime/int)
+
+const uint64_t kOffSqRing = 0;
+const uint64_t kOffCqRing = 0x8000000ULL;
+const uint64_t kOffSqes = 0x10000000ULL;
+
+const uint8_t kOpReadV = 1;
+const uint8_t kOpWriteV = 2;
+const uint8_t kOpFsync = 3;
+
+const uint32_t kFsyncDatasync = 1U << 0;
+const uint32_t kEnterGetEvents = 1U << 0;
+
+struct SubmissionQueueEntry {
+  uint8_t opcode;
+  uint8_t flags;
+  uint16_t ioprio;
+  int32_t fd;
+  uint64_t off;
+  uint64_t addr;
+  uint32_t len;
+  uint32_t op_flags;
+  uint64_t user_data;
+  uint64_t pad[3];
+};
+static_assert(sizeof(SubmissionQueueEntry) == 64, "unexpected io_uring_sqe size");
+
+struct CompletionQueueEntry {
+  uint64_t user_data;
+  int32_t res;
+  uint32_t flags;
+};
+static_assert(sizeof(CompletionQueueEntry) == 16, "unexpected io_uring_cqe size");
+
+struct SqRingOffsets {
+  uint32_t head;
+  uint32_t tail;
+  uint32_t ring_mask;
+  uint32_t ring_entries;
+  uint32_t flags;
+  uint32_t dropped;
+  uint32_t array;
+  uint32_t resv1;
+  uint64_t resv2;
+};
+static_assert(sizeof(SqRingOffsets) == 40, "unexpected io_sqring_offsets size");
+
+struct CqRingOffsets {
+  uint32_t head;
+  uint32_t tail;
+  uint32_t ring_mask;
+  uint32_t ring_entries;
+  uint32_t overflow;
+  uint32_t cqes;
+  uint32_t flags;
+  uint32_t resv1;
+  uint64_t resv2;
+};
+static_assert(sizeof(CqRingOffsets) == 40, "unexpected io_cqring_offsets size");
+
+struct RingParams {
+  uint32_t sq_entries;
+  uint32_t cq_entries;
+  uint32_t flags;
+  uint32_t sq_thread_cpu;
+  uint32_t sq_thread_idle;
+  uint32_t features;
+  uint32_t wq_fd;
+  uint32_t resv[3];
+  SqRingOffsets sq_off;
+  CqRingOffsets cq_off;
+};
+static_assert(sizeof(RingParams) == 120, "unexpected io_uring_params size");
+
+uint32_t* RingField(void* ring, uint32_t offset) {
+  return reinterpret_cast<uint32_t*>(static_cast<uint8_t*>(ring) + offset);
+}
+
+} // anonymous namespace
+
+struct IoUring::Rings {
+  Rings() = default;
+
+  ~Rings() {
+    if (sqes != nullptr) {
+      PCHECK(munmap(sqes, sqes_size) == 0);
+    }
+    if (cq_ring != nullptr) {
+      PCHECK(munmap(cq_ring, cq_ring_size) == 0);
+    }
+    if (sq_ring != nullptr) {
+      PCHECK(munmap(sq_ring, sq_ring_size) == 0);
+    }
+    if (fd >= 0) {
+      PCHECK(close(fd) == 0);
+    }
+  }
+
+  int fd = -1;
+
+  void* sq_ring = nullptr;
+  size_t sq_ring_size = 0;
+  uint32_t* sq_head = nullptr;
+  uint32_t* sq_tail = nullptr;
+  uint32_t sq_mask = 0;
+  uint32_t sq_entries = 0;
+  uint32_t* sq_array = nullptr;
+
+  SubmissionQueueEntry* sqes = nullptr;
+  size_t sqes_size = 0;
+
+  void* cq_ring = nullptr;
+  size_t cq_ring_size = 0;
+  uint32_t* cq_head = nullptr;
+  uint32_t* cq_tail = nullptr;
+  uint32_t cq_mask = 0;
+  CompletionQueueEntry* cqes = nullptr;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(Rings);
+};
+
+Status IoUring::Create(uint32_t queue_depth, unique_ptr<IoUring>* ring) {
+  CHECK_GT(queue_depth, 0);
+  RingParams params;
+  memset(&params, 0, sizeof(params));
+  int fd = syscall(kSysIoUringSetup, queue_depth, &params);
+  if (fd < 0) {
+    int err = errno;
+    if (err == ENOSYS || err == EPERM) {
+      return Status::NotSupported("io_uring is not supported by this kernel",
+                                  ErrnoToString(err), err);
+    }
+    return Status::IOError("could not set up io_uring", ErrnoToString(err), err);
+  }
+  unique_ptr<Rings> rings(new Rings());
+  rings->fd = fd;
+
+  rings->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+  void* sq_ring = mmap(nullptr, rings->sq_ring_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, fd, kOffSqRing);
+  if (sq_ring == MAP_FAILED) {
+    int err = errno;
+    return Status::IOError("could not map io_uring submission queue", ErrnoToString(err), err);
+  }
+  rings->sq_ring = sq_ring;
+  rings->sq_head = RingField(sq_ring, params.sq_off.head);
+  rings->sq_tail = RingField(sq_ring, params.sq_off.tail);
+  rings->sq_mask = *RingField(sq_ring, params.sq_off.ring_mask);
+  rings->sq_entries = *RingField(sq_ring, params.sq_off.ring_entries);
+  rings->sq_array = RingField(sq_ring, params.sq_off.array);
+
+  rings->sqes_size = params.sq_entries * sizeof(SubmissionQueueEntry);
+  void* sqes = mmap(nullptr, rings->sqes_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd, kOffSqes);
+  if (sqes == MAP_FAILED) {
+    int err = errno;
+    return Status::IOError("could not map io_uring submission entries", ErrnoToString(err), err);
+  }
+  rings->sqes = static_cast<SubmissionQueueEntry*>(sqes);
+
+  rings->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(CompletionQueueEntry);
+  void* cq_ring = mmap(nullptr, rings->cq_ring_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, fd, kOffCqRing);
+  if (cq_ring == MAP_FAILED) {
+    int err = errno;
+    return Status::IOError("could not map io_uring completion queue", ErrnoToString(err), err);
+  }
+  rings->cq_ring = cq_ring;
+  rings->cq_head = RingField(cq_ring, params.cq_off.head);
+  rings->cq_tail = RingField(cq_ring, params.cq_off.tail);
+  rings->cq_mask = *RingField(cq_ring, params.cq_off.ring_mask);
+  rings->cqes = reinterpret_cast<CompletionQueueEntry*>(
+      static_cast<uint8_t*>(cq_ring) + params.cq_off.cqes);
+
+  ring->reset(new IoUring(std::move(rings)));
+  return Status::OK();
+}
+
+IoUring::IoUring(unique_ptr<Rings> rings)
+    : rings_(std::move(rings)),
+      num_unsubmitted_(0),
+      num_in_flight_(0) {
+}
+
+IoUring::~IoUring() {
+  WARN_NOT_OK(WaitAll(), "could not wait for io_uring operations to complete");
+}
+
+Status IoUring::QueueOperation(unique_ptr<Operation> op) {
+  // The completion queue is twice the size of the submission queue, so as long
+  // as there are no more operations in flight than submission entries, it can
+  // never overflow.
+  // Callbacks run by Wait() may themselves queue operations, so loop until
+  // there's room.
+  while (num_in_flight_ >= static_cast<int>(rings_->sq_entries)) {
+    RETURN_NOT_OK(Wait(1));
+  }
+
+  // Only this thread produces submissions, so the tail needs no ordering on
+  // its own load; the head is advanced by the kernel.
+  uint32_t tail = *rings_->sq_tail;
+  DCHECK_LT(tail - __atomic_load_n(rings_->sq_head, __ATOMIC_ACQUIRE), rings_->sq_entries);
+  uint32_t index = tail & rings_->sq_mask;
+  SubmissionQueueEntry* sqe = &rings_->sqes[index];
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = op->opcode;
+  sqe->fd = op->fd;
+  sqe->off = op->offset;
+  sqe->op_flags = op->op_flags;
+  sqe->user_data = reinterpret_cast<uint64_t>(op.get());
+  if (!op->iov.empty()) {
+    sqe->addr = reinterpret_cast<uint64_t>(op->iov.data());
+    sqe->len = op->iov.size();
+  }
+  rings_->sq_array[index] = index;
+  __atomic_store_n(rings_->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+  ignore_result(op.release());
+  num_unsubmitted_++;
+  num_in_flight_++;
+  return Status::OK();
+}
+
+Status IoUring::Submit() {
+  while (num_unsubmitted_ > 0) {
+    int ret = syscall(kSysIoUringEnter, rings_->fd, num_unsubmitted_, 0, 0, nullptr, 0);
+    if (ret < 0) {
+      int err = errno;
+      if (err == EINTR || err == EAGAIN || err == EBUSY) {
+        // EAGAIN and EBUSY mean the kernel is out of resources, usually until
+        // some completions are reaped.
+        ReapCompletions();
+        continue;
+      }
+      return Status::IOError("could not submit io_uring operations", ErrnoToString(err), err);
+    }
+    num_unsubmitted_ -= ret;
+  }
+  return Status::OK();
+}
+
+Status IoUring::Wait(int min_completions) {
+  RETURN_NOT_OK(Submit());
+  min_completions = std::min(min_completions, num_in_flight_);
+  int completed = ReapCompletions();
+  while (completed < min_completions) {
+    int ret = syscall(kSysIoUringEnter, rings_->fd, 0, min_completions - completed,
+                      kEnterGetEvents, nullptr, 0);
+    if (ret < 0 && errno != EINTR) {
+      int err = errno;
+      return Status::IOError("could not wait for io_uring completions", ErrnoToString(err), err);
+    }
+    completed += ReapCompletions();
+  }
+  return Status::OK();
+}
+
+int IoUring::ReapCompletions() {
+  int completed = 0;
+  uint32_t head = *rings_->cq_head;
+  while (true) {
+    uint32_t tail = __atomic_load_n(rings_->cq_tail, __ATOMIC_ACQUIRE);
+    if (head == tail) {
+      break;
+    }
+    // Run callbacks in batches, releasing each batch's entries back to the
+    // kernel before running them: a callback may queue more operations.
+    vector<std::pair<Operation*, int64_t>> batch;
+    for (; head != tail; head++) {
+      const CompletionQueueEntry& cqe = rings_->cqes[head & rings_->cq_mask];
+      batch.emplace_back(reinterpret_cast<Operation*>(cqe.user_data), cqe.res);
+    }
+    __atomic_store_n(rings_->cq_head, head, __ATOMIC_RELEASE);
+    num_in_flight_ -= batch.size();
+    for (const auto& c : batch) {
+      unique_ptr<Operation> op(c.first);
+      op->callback(c.second);
+      completed++;
+    }
+    head = *rings_->cq_head;
+  }
+  return completed;
+}
+
+Status IoUring::QueueReadV(int fd, uint64_t offset, ArrayView<Slice> results,
+                           ResultCallback callback) {
+  if (PREDICT_FALSE(results.size() > IOV_MAX)) {
+    return Status::InvalidArgument(Substitute("cannot read more than $0 slices at once", IOV_MAX));
+  }
+  unique_ptr<Operation> op(new Operation);
+  op->opcode = kOpReadV;
+  op->fd = fd;
+  op->offset = offset;
+  op->callback = std::move(callback);
+  op->iov.resize(results.size());
+  for (size_t i = 0; i < results.size(); i++) {
+    op->iov[i].iov_base = results[i].mutable_data();
+    op->iov[i].iov_len = results[i].size();
+  }
+  return QueueOperation(std::move(op));
+}
+
+Status IoUring::QueueWriteV(int fd, uint64_t offset, ArrayView<const Slice> data,
+                            ResultCallback callback) {
+  if (PREDICT_FALSE(data.size() > IOV_MAX)) {
+    return Status::InvalidArgument(Substitute("cannot write more than $0 slices at once", IOV_MAX));
+  }
+  unique_ptr<Operation> op(new Operation);
+  op->opcode = kOpWriteV;
+  op->fd = fd;
+  op->offset = offset;
+  op->callback = std::move(callback);
+  op->iov.resize(data.size());
+  for (size_t i = 0; i < data.size(); i++) {
+    op->iov[i].iov_base = const_cast<uint8_t*>(data[i].data());
+    op->iov[i].iov_len = data[i].size();
+  }
+  return QueueOperation(std::move(op));
+}
+
+Status IoUring::QueueSync(int fd, bool datasync, ResultCallback callback) {
+  unique_ptr<Operation> op(new Operation);
+  op->callback = std::move(callback);
+  op->opcode = kOpFsync;
+  op->fd = fd;
+  op->op_flags = datasync ? kFsyncDatasync : 0;
+  return QueueOperation(std::move(op));
+}
+
+#else // !defined(__linux__)
+
+struct IoUring::Rings {
+};
+
+Status IoUring::Create(uint32_t /* queue_depth */, unique_ptr<IoUring>* /* ring */) {
+  return Status::NotSupported("io_uring is only supported on Linux");
+}
+
+IoUring::IoUring(unique_ptr<Rings> rings)
+    : rings_(std::move(rings)),
+      num_unsubmitted_(0),
+      num_in_flight_(0) {
+}
+
+IoUring::~IoUring() {
+}
+
+Status IoUring::QueueOperation(unique_ptr<Operation> /* op */) {
+  LOG(FATAL) << "io_uring is not supported";
+}
+
+Status IoUring::Submit() {
+  LOG(FATAL) << "io_uring is not supported";
+}
+
+Status IoUring::Wait(int /* min_completions */) {
+  LOG(FATAL) << "io_uring is not supported";
+}
+
+int IoUring::ReapCompletions() {
+  LOG(FATAL) << "io_uring is not supported";
+}
+
+Status IoUring::QueueReadV(int /* fd */, uint64_t /* offset */, ArrayView<Slice> /* results */,
+                           ResultCallback /* callback */) {
+  LOG(FATAL) << "io_uring is not supported";
+}
+
+Status IoUring::QueueWriteV(int /* fd */, uint64_t /* offset */,
+                            ArrayView<const Slice> /* data */, ResultCallback /* callback */) {
+  LOG(FATAL) << "io_uring is not supported";
+}
+
+Status IoUring::QueueSync(int /* fd */, bool /* datasync */, ResultCallback /* callback */) {
+  LOG(FATAL) << "io_uring is not supported";
+}
+
+#endif // defined(__linux__)
+
+} // namespace kudu
@@ -0,0 +1,128 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_UTIL_IO_URING_H
+#define KUDU_UTIL_IO_URING_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/util/array_view.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+class Slice;
+
+// A Linux io_uring instance: a pair of queues shared with the kernel, through
+// which a thread submits batches of IO operations and later collects their
+// completions, without blocking on each operation and without any thread of
+// its own.
+//
+// Operations are queued with the Queue*() methods, handed to the kernel by
+// Submit(), and completed by Wait(), which runs the callback of each
+// completed operation on the calling thread with the result of the system
+// call: the number of bytes transferred, or a negated errno. A read or write
+// may complete with fewer bytes than requested.
+//
+// Rather than using this class directly, most code should go through the
+// *Async() methods of RandomAccessFile and RWFile, which turn the results
+// into Statuses and finish short reads and writes.
+//
+// This class is not thread-safe: each thread should use its own instance.
+class IoUring {
+ public:
+  // Called with the result of a completed operation.
+  typedef std::function<void(int64_t result)> ResultCallback;
+
+  // Creates an instance which can have up to 'queue_depth' operations in
+  // flight.
+  //
+  // Returns NotSupported if the platform or the running kernel doesn't
+  // support io_uring.
+  static Status Create(uint32_t queue_depth, std::unique_ptr<IoUring>* ring);
+
+  // Waits for all operations in flight to complete.
+  ~IoUring();
+
+  // Queues a preadv() of the 'results' slices from 'fd', starting at
+  // 'offset'. At most IOV_MAX slices may be passed.
+  //
+  // 'callback' is run from Wait() once the read has completed. The buffers
+  // of 'results' must remain valid until then; the slices themselves needn't.
+  //
+  // If this returns an error, the read wasn't queued and 'callback' will not
+  // be run.
+  Status QueueReadV(int fd, uint64_t offset, ArrayView<Slice> results,
+                    ResultCallback callback);
+
+  // Like QueueReadV(), but a pwritev() of the 'data' slices.
+  Status QueueWriteV(int fd, uint64_t offset, ArrayView<const Slice> data,
+                     ResultCallback callback);
+
+  // Queues an fsync() of 'fd', or an fdatasync() if 'datasync' is true.
+  //
+  // Operations are not ordered with respect to each other: to sync previous
+  // writes, wait for them to complete before queuing the sync.
+  Status QueueSync(int fd, bool datasync, ResultCallback callback);
+
+  // Hands the queued operations to the kernel.
+  Status Submit();
+
+  // Submits the queued operations and waits until at least 'min_completions'
+  // operations have completed (or all of them, if fewer are in flight),
+  // running the callbacks of all of those which have completed.
+  Status Wait(int min_completions);
+
+  // Submits the queued operations and waits for all of them to complete.
+  Status WaitAll() {
+    return Wait(num_in_flight());
+  }
+
+  // Returns the number of operations queued or submitted whose callback has
+  // not run yet.
+  int num_in_flight() const {
+    return num_in_flight_;
+  }
+
+ private:
+  struct Operation;
+  struct Rings;
+
+  explicit IoUring(std::unique_ptr<Rings> rings);
+
+  // Adds 'op' to the submission queue, first making room for it if needed.
+  Status QueueOperation(std::unique_ptr<Operation> op);
+
+  // Runs the callbacks of the operations which have completed, and returns
+  // how many there were.
+  int ReapCompletions();
+
+  std::unique_ptr<Rings> rings_;
+
+  // The number of queued operations not yet handed to the kernel.
+  uint32_t num_unsubmitted_;
+
+  int num_in_flight_;
+
+  DISALLOW_COPY_AND_ASSIGN(IoUring);
+};
+
+} // namespace kudu
+
+#endif // KUDU_UTIL_IO_URING_H
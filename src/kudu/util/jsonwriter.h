@@ -42,8 +42,9 @@ class JsonWriterIf;
 // This class implements all the methods of rapidjson::JsonWriter, plus an
 // additional convenience method for String(std::string).
 //
-// We take an instance of std::stringstream in the constructor because Mongoose / Squeasel
-// uses std::stringstream for output buffering.
+// We take an instance of std::ostream in the constructor, so that the JSON can
+// be written to a std::ostringstream, as Mongoose / Squeasel use for output
+// buffering, or streamed out as it's written.
 class JsonWriter {
  public:
   enum Mode {
@@ -53,7 +54,7 @@ class JsonWriter {
     COMPACT
   };
 
-  JsonWriter(std::ostringstream* out, Mode mode);
+  JsonWriter(std::ostream* out, Mode mode);
   ~JsonWriter();
 
   void Null();
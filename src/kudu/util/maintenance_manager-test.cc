@@ -21,6 +21,7 @@
 #include <mutex>
 #include <ostream>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <boost/bind.hpp> // IWYU pragma: keep
@@ -55,6 +56,7 @@ METRIC_DEFINE_histogram(test, maintenance_op_duration,
                         "Maintenance Operation Duration",
                         kudu::MetricUnit::kSeconds, "", 60000000LU, 2);
 
+DECLARE_int32(maintenance_manager_stats_max_age_ms);
 DECLARE_int64(log_target_replay_size_mb);
 
 namespace kudu {
@@ -94,8 +96,9 @@ TEST_F(MaintenanceManagerTest, TestCreateAndShutdown) {
 class TestMaintenanceOp : public MaintenanceOp {
  public:
   TestMaintenanceOp(const std::string& name,
-                    IOUsage io_usage)
-    : MaintenanceOp(name, io_usage),
+                    IOUsage io_usage,
+                    StatsUpdates stats_updates = POLLED_STATS)
+    : MaintenanceOp(name, io_usage, stats_updates),
       ram_anchored_(500),
       logs_retained_bytes_(0),
       perf_improvement_(0),
@@ -104,6 +107,7 @@ class TestMaintenanceOp : public MaintenanceOp {
       maintenance_ops_running_(METRIC_maintenance_ops_running.Instantiate(metric_entity_, 0)),
       remaining_runs_(1),
       prepared_runs_(0),
+      stats_updates_count_(0),
       sleep_time_(MonoDelta::FromSeconds(0)) {
   }
 
@@ -136,6 +140,7 @@ class TestMaintenanceOp : public MaintenanceOp {
 
   virtual void UpdateStats(MaintenanceOpStats* stats) OVERRIDE {
     std::lock_guard<Mutex> guard(lock_);
+    stats_updates_count_++;
     stats->set_runnable(remaining_runs_ > 0);
     stats->set_ram_anchored(ram_anchored_);
     stats->set_logs_retained_bytes(logs_retained_bytes_);
@@ -175,6 +180,19 @@ class TestMaintenanceOp : public MaintenanceOp {
     return maintenance_ops_running_;
   }
 
+  virtual vector<string> DataDirUuids() const OVERRIDE {
+    return data_dir_uuids_;
+  }
+
+  void set_data_dir_uuids(vector<string> uuids) {
+    data_dir_uuids_ = std::move(uuids);
+  }
+
+  int stats_updates_count() {
+    std::lock_guard<Mutex> guard(lock_);
+    return stats_updates_count_;
+  }
+
  private:
   Mutex lock_;
 
@@ -192,8 +210,14 @@ class TestMaintenanceOp : public MaintenanceOp {
   // The number of Prepared() operations which have not yet been Perform()ed.
   int prepared_runs_;
 
+  // The number of times UpdateStats() was called.
+  int stats_updates_count_;
+
   // The amount of time each op invocation will sleep.
   MonoDelta sleep_time_;
+
+  // The data directories the op runs on. Set before registering the op.
+  vector<string> data_dir_uuids_;
 };
 
 // Create an op and wait for it to start running.  Unregister it while it is
@@ -304,6 +328,108 @@ TEST_F(MaintenanceManagerTest, TestLogRetentionPrioritization) {
   manager_->UnregisterOp(&op2);
 }
 
+// Test that high IO ops which only improve performance are deferred while the
+// disks are backlogged, but that ops needed to relieve memory pressure aren't.
+TEST_F(MaintenanceManagerTest, TestIOBackpressure) {
+  manager_->Shutdown();
+
+  TestMaintenanceOp low_io_op("low_io_op", MaintenanceOp::LOW_IO_USAGE);
+  low_io_op.set_perf_improvement(1);
+  low_io_op.set_ram_anchored(0);
+  TestMaintenanceOp high_io_op("high_io_op", MaintenanceOp::HIGH_IO_USAGE);
+  high_io_op.set_perf_improvement(10);
+  high_io_op.set_ram_anchored(100);
+  manager_->RegisterOp(&low_io_op);
+  manager_->RegisterOp(&high_io_op);
+
+  bool backlogged = false;
+  manager_->set_io_backpressure_func([&]() { return backlogged; });
+  ASSERT_EQ(&high_io_op, manager_->FindBestOp());
+
+  backlogged = true;
+  ASSERT_EQ(&low_io_op, manager_->FindBestOp());
+
+  indicate_memory_pressure_ = true;
+  ASSERT_EQ(&high_io_op, manager_->FindBestOp());
+  indicate_memory_pressure_ = false;
+
+  manager_->UnregisterOp(&low_io_op);
+  manager_->UnregisterOp(&high_io_op);
+}
+
+// Test that high IO ops sharing a data directory don't run at the same time,
+// while the free threads run ops on other data directories.
+TEST_F(MaintenanceManagerTest, TestDataDirConcurrencyLimit) {
+  TestMaintenanceOp op1("op1", MaintenanceOp::HIGH_IO_USAGE);
+  op1.set_perf_improvement(10);
+  op1.set_sleep_time(MonoDelta::FromSeconds(1));
+  op1.set_data_dir_uuids({ "dir-a" });
+  TestMaintenanceOp op2("op2", MaintenanceOp::HIGH_IO_USAGE);
+  op2.set_perf_improvement(5);
+  op2.set_sleep_time(MonoDelta::FromSeconds(1));
+  op2.set_data_dir_uuids({ "dir-a" });
+  manager_->RegisterOp(&op1);
+  manager_->RegisterOp(&op2);
+
+  // There are two threads, but only one of the ops may run on 'dir-a'.
+  ASSERT_EVENTUALLY([&]() {
+      ASSERT_EQ(1, op1.RunningGauge()->value() + op2.RunningGauge()->value());
+    });
+  SleepFor(MonoDelta::FromMilliseconds(100));
+  ASSERT_EQ(1, op1.RunningGauge()->value() + op2.RunningGauge()->value());
+
+  // An op on another data directory takes the free thread.
+  TestMaintenanceOp op3("op3", MaintenanceOp::HIGH_IO_USAGE);
+  op3.set_perf_improvement(1);
+  op3.set_sleep_time(MonoDelta::FromSeconds(1));
+  op3.set_data_dir_uuids({ "dir-b" });
+  manager_->RegisterOp(&op3);
+  ASSERT_EVENTUALLY([&]() {
+      ASSERT_EQ(1, op3.RunningGauge()->value());
+    });
+
+  // The op left waiting for 'dir-a' runs once it's free.
+  ASSERT_EVENTUALLY([&]() {
+      ASSERT_EQ(1, op1.DurationHistogram()->TotalCount());
+      ASSERT_EQ(1, op2.DurationHistogram()->TotalCount());
+      ASSERT_EQ(1, op3.DurationHistogram()->TotalCount());
+    });
+  manager_->UnregisterOp(&op1);
+  manager_->UnregisterOp(&op2);
+  manager_->UnregisterOp(&op3);
+}
+
+// Test that the stats of an op with pushed stats are only updated once it
+// marks them dirty, or once they're too old.
+TEST_F(MaintenanceManagerTest, TestPushedStats) {
+  manager_->Shutdown();
+
+  TestMaintenanceOp op("op", MaintenanceOp::HIGH_IO_USAGE, MaintenanceOp::PUSHED_STATS);
+  op.set_perf_improvement(0);
+  manager_->RegisterOp(&op);
+  ASSERT_EQ(nullptr, manager_->FindBestOp());
+  ASSERT_EQ(1, op.stats_updates_count());
+  ASSERT_EQ(nullptr, manager_->FindBestOp());
+  ASSERT_EQ(1, op.stats_updates_count());
+
+  // The change isn't seen until it's pushed.
+  op.set_perf_improvement(10);
+  ASSERT_EQ(nullptr, manager_->FindBestOp());
+  op.MarkStatsDirty();
+  ASSERT_EQ(&op, manager_->FindBestOp());
+  ASSERT_EQ(2, op.stats_updates_count());
+  ASSERT_EQ(&op, manager_->FindBestOp());
+  ASSERT_EQ(2, op.stats_updates_count());
+
+  // Stats which are too old are updated anyway.
+  op.set_perf_improvement(0);
+  FLAGS_maintenance_manager_stats_max_age_ms = 0;
+  ASSERT_EQ(nullptr, manager_->FindBestOp());
+  ASSERT_EQ(3, op.stats_updates_count());
+
+  manager_->UnregisterOp(&op);
+}
+
 // Test retrieving a list of an op's running instances
 TEST_F(MaintenanceManagerTest, TestRunningInstances) {
   TestMaintenanceOp op("op", MaintenanceOp::HIGH_IO_USAGE);
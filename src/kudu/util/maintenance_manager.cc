@@ -24,6 +24,7 @@
 #include <sstream>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include <boost/bind.hpp>
 #include <gflags/gflags.h>
@@ -38,6 +39,7 @@
 #include "kudu/util/logging.h"
 #include "kudu/util/maintenance_manager.pb.h"
 #include "kudu/util/metrics.h"
+#include "kudu/util/probes.h"
 #include "kudu/util/process_memory.h"
 #include "kudu/util/random_util.h"
 #include "kudu/util/scoped_cleanup.h"
@@ -48,6 +50,8 @@
 
 using std::pair;
 using std::shared_ptr;
+using std::string;
+using std::vector;
 using strings::Substitute;
 
 DEFINE_int32(maintenance_manager_num_threads, 1,
@@ -56,11 +60,27 @@ DEFINE_int32(maintenance_manager_num_threads, 1,
              "not be above the number of devices.");
 TAG_FLAG(maintenance_manager_num_threads, stable);
 
+DEFINE_int32(maintenance_manager_max_ops_per_data_dir, 1,
+             "Maximum number of IO-heavy maintenance operations, such as flushes "
+             "and compactions, that may run at once on a single data directory. "
+             "An operation needed to relieve memory pressure may exceed it. "
+             "If not positive, there is no per-directory limit.");
+TAG_FLAG(maintenance_manager_max_ops_per_data_dir, advanced);
+TAG_FLAG(maintenance_manager_max_ops_per_data_dir, runtime);
+
 DEFINE_int32(maintenance_manager_polling_interval_ms, 250,
        "Polling interval for the maintenance manager scheduler, "
        "in milliseconds.");
 TAG_FLAG(maintenance_manager_polling_interval_ms, hidden);
 
+DEFINE_int32(maintenance_manager_stats_max_age_ms, 10000,
+             "Maximum age of the statistics of maintenance operations which "
+             "report changes to them, rather than being polled every "
+             "scheduling period. Bounds how late time-dependent changes to "
+             "their statistics are noticed.");
+TAG_FLAG(maintenance_manager_stats_max_age_ms, advanced);
+TAG_FLAG(maintenance_manager_stats_max_age_ms, runtime);
+
 DEFINE_int32(maintenance_manager_history_size, 8,
        "Number of completed operations the manager is keeping track of.");
 TAG_FLAG(maintenance_manager_history_size, hidden);
@@ -104,11 +124,14 @@ void MaintenanceOpStats::Clear() {
   last_modified_ = MonoTime();
 }
 
-MaintenanceOp::MaintenanceOp(std::string name, IOUsage io_usage)
+MaintenanceOp::MaintenanceOp(std::string name, IOUsage io_usage,
+                             StatsUpdates stats_updates)
     : name_(std::move(name)),
       running_(0),
       cancel_(false),
-      io_usage_(io_usage) {
+      io_usage_(io_usage),
+      stats_updates_(stats_updates),
+      stats_dirty_(true) {
 }
 
 MaintenanceOp::~MaintenanceOp() {
@@ -280,23 +303,37 @@ void MaintenanceManager::RunSchedulerThread() {
     }
 
     // Prepare the maintenance operation.
+    vector<string> data_dirs;
+    if (op->io_usage() == MaintenanceOp::HIGH_IO_USAGE) {
+      data_dirs = op->DataDirUuids();
+    }
     op->running_++;
     running_ops_++;
+    for (const auto& dir : data_dirs) {
+      running_ops_by_data_dir_[dir]++;
+    }
     guard.unlock();
     bool ready = op->Prepare();
     guard.lock();
+    // Preparing the op typically changes what else it could run on.
+    op->MarkStatsDirty();
     if (!ready) {
       LOG_WITH_PREFIX(INFO) << "Prepare failed for " << op->name()
                             << ".  Re-running scheduler.";
       op->running_--;
       running_ops_--;
+      for (const auto& dir : data_dirs) {
+        if (--running_ops_by_data_dir_[dir] == 0) {
+          running_ops_by_data_dir_.erase(dir);
+        }
+      }
       op->cond_->Signal();
       continue;
     }
 
     // Run the maintenance operation.
     Status s = thread_pool_->SubmitFunc(boost::bind(
-          &MaintenanceManager::LaunchOp, this, op));
+          &MaintenanceManager::LaunchOp, this, op, data_dirs));
     CHECK(s.ok());
   }
 }
@@ -317,6 +354,11 @@ void MaintenanceManager::RunSchedulerThread() {
 //
 // In the third priority we're at a point where nothing's urgent and there's nothing we can run
 // quickly.
+//
+// HIGH_IO_USAGE ops on data directories which already run
+// --maintenance_manager_max_ops_per_data_dir of them are only considered for relieving memory
+// pressure, so that more threads spread the IO over more disks rather than piling it on the
+// same ones.
 // TODO We currently optimize for freeing log retention but we could consider having some sort of
 // sliding priority between log retention and RAM usage. For example, is an Op that frees
 // 128MB of log retention and 12MB of RAM always better than an op that frees 12MB of log retention
@@ -346,13 +388,25 @@ MaintenanceOp* MaintenanceManager::FindBestOp() {
 
   double best_perf_improvement = 0;
   MaintenanceOp* best_perf_improvement_op = nullptr;
+
+  // When the disks are backlogged, hold off on IO-heavy ops that merely
+  // improve performance or free up disk space.
+  const bool io_backlogged = io_backpressure_func_ && io_backpressure_func_();
+  if (io_backlogged) {
+    VLOG_AND_TRACE("maintenance", 2) << LogPrefix() << "Disks are backlogged with "
+                                     << "background IO, deferring high IO usage ops";
+  }
+  const MonoTime now = MonoTime::Now();
   for (OpMapTy::value_type &val : ops_) {
     MaintenanceOp* op(val.first);
     MaintenanceOpStats& stats(val.second);
     VLOG_WITH_PREFIX(3) << "Considering MM op " << op->name();
     // Update op stats.
-    stats.Clear();
-    op->UpdateStats(&stats);
+    if (ShouldUpdateStats(op, now)) {
+      stats.Clear();
+      op->UpdateStats(&stats);
+      op->stats_update_time_ = now;
+    }
     if (op->cancelled() || !stats.valid() || !stats.runnable()) {
       continue;
     }
@@ -368,6 +422,13 @@ MaintenanceOp* MaintenanceManager::FindBestOp() {
       most_mem_anchored_op = op;
       most_mem_anchored = stats.ram_anchored();
     }
+
+    if (op->io_usage() == MaintenanceOp::HIGH_IO_USAGE &&
+        !HasDataDirCapacity(op->DataDirUuids())) {
+      VLOG_AND_TRACE("maintenance", 2) << LogPrefix() << "Deferring op " << op->name()
+                                       << " because its data directories are busy";
+      continue;
+    }
     // We prioritize ops that can free more logs, but when it's the same we pick the one that
     // also frees up the most memory.
     if (stats.logs_retained_bytes() > 0 &&
@@ -379,6 +440,10 @@ MaintenanceOp* MaintenanceManager::FindBestOp() {
       most_logs_retained_bytes_ram_anchored = stats.ram_anchored();
     }
 
+    if (io_backlogged && op->io_usage() == MaintenanceOp::HIGH_IO_USAGE) {
+      continue;
+    }
+
     if (stats.data_retained_bytes() > most_data_retained_bytes) {
       most_data_retained_bytes_op = op;
       most_data_retained_bytes = stats.data_retained_bytes();
@@ -455,7 +520,34 @@ MaintenanceOp* MaintenanceManager::FindBestOp() {
   return nullptr;
 }
 
-void MaintenanceManager::LaunchOp(MaintenanceOp* op) {
+bool MaintenanceManager::ShouldUpdateStats(MaintenanceOp* op, const MonoTime& now) {
+  if (op->stats_updates() == MaintenanceOp::POLLED_STATS) {
+    return true;
+  }
+  // Clear the dirty bit before updating, so that changes made while the
+  // statistics are updated aren't lost.
+  if (op->stats_dirty_.Exchange(false)) {
+    return true;
+  }
+  return !op->stats_update_time_.Initialized() ||
+      now - op->stats_update_time_ >=
+          MonoDelta::FromMilliseconds(FLAGS_maintenance_manager_stats_max_age_ms);
+}
+
+bool MaintenanceManager::HasDataDirCapacity(const vector<string>& data_dirs) const {
+  const int32_t max_ops = FLAGS_maintenance_manager_max_ops_per_data_dir;
+  if (max_ops <= 0) {
+    return true;
+  }
+  for (const auto& dir : data_dirs) {
+    if (FindWithDefault(running_ops_by_data_dir_, dir, 0) >= max_ops) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void MaintenanceManager::LaunchOp(MaintenanceOp* op, const vector<string>& data_dirs) {
   int64_t thread_id = Thread::CurrentThreadId();
   OpInstance op_instance;
   op_instance.thread_id = thread_id;
@@ -482,7 +574,13 @@ void MaintenanceManager::LaunchOp(MaintenanceOp* op) {
     op->DurationHistogram()->Increment(op_instance.duration.ToMilliseconds());
 
     running_ops_--;
+    for (const auto& dir : data_dirs) {
+      if (--running_ops_by_data_dir_[dir] == 0) {
+        running_ops_by_data_dir_.erase(dir);
+      }
+    }
     op->running_--;
+    op->MarkStatsDirty();
     op->cond_->Signal();
     cond_.Signal(); // wake up scheduler
   });
@@ -492,7 +590,9 @@ void MaintenanceManager::LaunchOp(MaintenanceOp* op) {
     ADOPT_TRACE(trace.get());
     TRACE_EVENT1("maintenance", "MaintenanceManager::LaunchOp",
                  "name", op->name());
+    KUDU_PROBE(maintenance_op_start, op_instance.name.c_str());
     op->Perform();
+    KUDU_PROBE(maintenance_op_done, op_instance.name.c_str());
   }
   LOG_WITH_PREFIX(INFO) << op->name() << " metrics: " << trace->MetricsAsJSON();
 }
@@ -167,7 +167,8 @@ struct OpInstance {
 
 // MaintenanceOp objects represent background operations that the
 // MaintenanceManager can schedule.  Once a MaintenanceOp is registered, the
-// manager will periodically poll it for statistics.  The registrant is
+// manager will periodically poll it for statistics, or, for ops with
+// PUSHED_STATS, update them once they're marked dirty.  The registrant is
 // responsible for managing the memory associated with the MaintenanceOp object.
 // Op objects should be unregistered before being de-allocated.
 class MaintenanceOp {
@@ -180,7 +181,20 @@ class MaintenanceOp {
     HIGH_IO_USAGE // Everything else.
   };
 
-  explicit MaintenanceOp(std::string name, IOUsage io_usage);
+  // How the manager learns that the op's statistics have changed.
+  enum StatsUpdates {
+    // UpdateStats() is called every scheduling period.
+    POLLED_STATS,
+    // UpdateStats() is only called once MarkStatsDirty() has been called, or
+    // once the statistics are older than
+    // --maintenance_manager_stats_max_age_ms. Meant for ops whose statistics
+    // only change on events the registrant knows about, such as flushes and
+    // compactions.
+    PUSHED_STATS
+  };
+
+  MaintenanceOp(std::string name, IOUsage io_usage,
+                StatsUpdates stats_updates = POLLED_STATS);
   virtual ~MaintenanceOp();
 
   // Unregister this op, if it is currently registered.
@@ -193,6 +207,13 @@ class MaintenanceOp {
   // under the MaintenanceManager lock.
   virtual void UpdateStats(MaintenanceOpStats* stats) = 0;
 
+  // Marks the statistics of the op as stale, so that the manager updates
+  // them before its next scheduling decision. Runs of the op mark them
+  // stale as well. This is cheap and thread-safe.
+  void MarkStatsDirty() {
+    stats_dirty_.Store(true);
+  }
+
   // Prepare to perform the operation.  This will be run without holding the
   // maintenance manager lock.  It should be short, since it is run from the
   // context of the maintenance op scheduler thread rather than a worker thread.
@@ -209,12 +230,22 @@ class MaintenanceOp {
   // Returns the gauge for this op that tracks when this op is running. Cannot be NULL.
   virtual scoped_refptr<AtomicGauge<uint32_t> > RunningGauge() const = 0;
 
+  // Returns the UUIDs of the data directories this op reads and writes. The
+  // manager limits how many HIGH_IO_USAGE ops run on each data directory at
+  // once. Ops which return no directories aren't limited. This will be run
+  // under the MaintenanceManager lock.
+  virtual std::vector<std::string> DataDirUuids() const {
+    return {};
+  }
+
   uint32_t running() { return running_; }
 
   std::string name() const { return name_; }
 
   IOUsage io_usage() const { return io_usage_; }
 
+  StatsUpdates stats_updates() const { return stats_updates_; }
+
   // Return true if the operation has been cancelled due to Unregister() pending.
   bool cancelled() const {
     return cancel_.Load();
@@ -253,6 +284,15 @@ class MaintenanceOp {
   std::shared_ptr<MaintenanceManager> manager_;
 
   IOUsage io_usage_;
+
+  const StatsUpdates stats_updates_;
+
+  // Set when the statistics of a PUSHED_STATS op may have changed.
+  AtomicBool stats_dirty_;
+
+  // The last time the manager updated the statistics of the op. Protected by
+  // the MaintenanceManager's mutex.
+  MonoTime stats_update_time_;
 };
 
 struct MaintenanceOpComparator {
@@ -295,10 +335,23 @@ class MaintenanceManager : public std::enable_shared_from_this<MaintenanceManage
     memory_pressure_func_ = std::move(f);
   }
 
+  // Sets a function which should return true if the disks are backlogged
+  // with background IO. While it does, HIGH_IO_USAGE ops are only scheduled
+  // if they're needed to relieve memory pressure or to free up log retention.
+  //
+  // The function is called with the manager's lock held, so it must be cheap.
+  void set_io_backpressure_func(std::function<bool()> f) {
+    std::lock_guard<Mutex> guard(lock_);
+    io_backpressure_func_ = std::move(f);
+  }
+
   static const Options kDefaultOptions;
 
  private:
   FRIEND_TEST(MaintenanceManagerTest, TestLogRetentionPrioritization);
+  FRIEND_TEST(MaintenanceManagerTest, TestIOBackpressure);
+  FRIEND_TEST(MaintenanceManagerTest, TestDataDirConcurrencyLimit);
+  FRIEND_TEST(MaintenanceManagerTest, TestPushedStats);
   typedef std::map<MaintenanceOp*, MaintenanceOpStats,
           MaintenanceOpComparator> OpMapTy;
 
@@ -311,7 +364,15 @@ class MaintenanceManager : public std::enable_shared_from_this<MaintenanceManage
   // find the best op, or null if there is nothing we want to run
   MaintenanceOp* FindBestOp();
 
-  void LaunchOp(MaintenanceOp* op);
+  // Returns true if the statistics of 'op' must be updated as of 'now'.
+  static bool ShouldUpdateStats(MaintenanceOp* op, const MonoTime& now);
+
+  // Returns true if another HIGH_IO_USAGE op may run on each of 'data_dirs'.
+  bool HasDataDirCapacity(const std::vector<std::string>& data_dirs) const;
+
+  // Runs 'op', which counts against the concurrency limit of 'data_dirs'
+  // until it finishes.
+  void LaunchOp(MaintenanceOp* op, const std::vector<std::string>& data_dirs);
 
   std::string LogPrefix() const;
 
@@ -324,6 +385,8 @@ class MaintenanceManager : public std::enable_shared_from_this<MaintenanceManage
   bool shutdown_;
   int32_t polling_interval_ms_;
   uint64_t running_ops_;
+  // The number of HIGH_IO_USAGE ops running on each data directory, by UUID.
+  std::unordered_map<std::string, int> running_ops_by_data_dir_;
   // Vector used as a circular buffer for recently completed ops. Elements need to be added at
   // the completed_ops_count_ % the vector's size and then the count needs to be incremented.
   std::vector<OpInstance> completed_ops_;
@@ -335,6 +398,10 @@ class MaintenanceManager : public std::enable_shared_from_this<MaintenanceManage
   // This is indirected for testing purposes.
   std::function<bool(double*)> memory_pressure_func_;
 
+  // Function which should return true if the disks are backlogged with
+  // background IO. May be empty.
+  std::function<bool()> io_backpressure_func_;
+
   // Running instances lock.
   //
   // This is separate of lock_ so that worker threads don't need to take the
@@ -27,6 +27,7 @@
 #include <utility>
 #include <vector>
 
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 
@@ -34,6 +35,8 @@
 #include "kudu/util/monotime.h"
 #include "kudu/util/test_util.h"
 
+DECLARE_int64(mem_tracker_update_batch_bytes);
+
 namespace kudu {
 
 using std::equal_to;
@@ -117,6 +120,43 @@ TEST(MemTrackerTest, TrackerHierarchy) {
   c2->Release(60);
 }
 
+TEST(MemTrackerTest, BatchedUpdates) {
+  google::FlagSaver saver;
+  FLAGS_mem_tracker_update_batch_bytes = 100;
+  shared_ptr<MemTracker> p = MemTracker::CreateTracker(-1, "p");
+  shared_ptr<MemTracker> l = MemTracker::CreateTracker(1000, "l", p);
+  shared_ptr<MemTracker> c = MemTracker::CreateTracker(-1, "c", l);
+
+  // The tracker and its ancestors with a limit are updated immediately, the
+  // others once the calling thread has buffered enough updates.
+  c->Consume(60);
+  ASSERT_EQ(60, c->consumption());
+  ASSERT_EQ(60, l->consumption());
+  ASSERT_EQ(0, p->consumption());
+  ASSERT_TRUE(c->TryConsume(40));
+  ASSERT_EQ(100, l->consumption());
+  ASSERT_EQ(100, p->consumption());
+  c->Release(10);
+  ASSERT_EQ(90, l->consumption());
+  ASSERT_EQ(100, p->consumption());
+
+  // The updates buffered by a thread are flushed when it exits.
+  std::thread t([&]() { c->Consume(10); });
+  t.join();
+  ASSERT_EQ(100, c->consumption());
+  ASSERT_EQ(110, p->consumption());
+
+  // The updates buffered for a tracker are flushed when it's destroyed.
+  c->Release(90);
+  ASSERT_EQ(10, p->consumption());
+  c->Release(10);
+  ASSERT_EQ(0, c->consumption());
+  ASSERT_EQ(0, l->consumption());
+  ASSERT_EQ(10, p->consumption());
+  c.reset();
+  ASSERT_EQ(0, p->consumption());
+}
+
 class GcFunctionHelper {
  public:
   static const int kNumReleaseBytes = 1;
@@ -19,19 +19,35 @@
 
 #include <algorithm>
 #include <cstddef>
+#include <cstdlib>
 #include <deque>
 #include <limits>
 #include <list>
 #include <memory>
+#include <mutex>
 #include <ostream>
+#include <unordered_set>
 
+#include <gflags/gflags.h>
 #include <gperftools/malloc_extension.h>  // IWYU pragma: keep
 
 #include "kudu/gutil/once.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/locks.h"
 #include "kudu/util/mutex.h"
 #include "kudu/util/process_memory.h"
+#include "kudu/util/threadlocal.h"
+
+DEFINE_int64(mem_tracker_update_batch_bytes, 64 * 1024,
+             "Number of bytes of consumption that each thread may buffer for "
+             "the memory trackers without a limit, before updating them. "
+             "Buffering the updates avoids contention on the trackers shared "
+             "by all the threads, such as the root tracker, at the price of "
+             "their consumption lagging behind. 0 disables the buffering.");
+TAG_FLAG(mem_tracker_update_batch_bytes, advanced);
+TAG_FLAG(mem_tracker_update_batch_bytes, experimental);
 
 namespace kudu {
 
@@ -40,13 +56,83 @@ namespace kudu {
 
 using std::deque;
 using std::list;
+using std::lock_guard;
 using std::shared_ptr;
 using std::string;
+using std::unordered_set;
 using std::vector;
 using std::weak_ptr;
 
 using strings::Substitute;
 
+// The updates of the batched trackers of up to kNumEntries trackers, buffered
+// by a thread. The entries are flushed when the thread exits, and by the
+// destructor of their tracker, so they never refer to a destroyed tracker.
+struct MemTracker::ThreadBuffer {
+  static const int kNumEntries = 8;
+
+  struct Entry {
+    MemTracker* tracker;
+    int64_t bytes;
+  };
+
+  ThreadBuffer() : next_victim(0) {
+    for (auto& e : entries) {
+      e.tracker = nullptr;
+      e.bytes = 0;
+    }
+    lock_guard<simple_spinlock> l(*registry_lock());
+    registry()->insert(this);
+  }
+
+  ~ThreadBuffer() {
+    // Flush while still registered, so that the trackers of the entries can't
+    // be destroyed in the meantime.
+    lock_guard<simple_spinlock> r(*registry_lock());
+    {
+      lock_guard<simple_spinlock> l(lock);
+      for (auto& e : entries) {
+        FlushUnlocked(&e);
+      }
+    }
+    registry()->erase(this);
+  }
+
+  // Returns the buffer of the calling thread.
+  static ThreadBuffer* Get() {
+    BLOCK_STATIC_THREAD_LOCAL(ThreadBuffer, buffer);
+    return buffer;
+  }
+
+  // Applies the updates of 'e' to its tracker and frees it.
+  static void FlushUnlocked(Entry* e) {
+    if (e->tracker != nullptr) {
+      e->tracker->ApplyToBatched(e->bytes);
+      e->tracker = nullptr;
+      e->bytes = 0;
+    }
+  }
+
+  // Protects the registry of the buffers of all the threads. Taken before the
+  // lock of any buffer.
+  static simple_spinlock* registry_lock() {
+    static simple_spinlock* lock = new simple_spinlock();
+    return lock;
+  }
+
+  static unordered_set<ThreadBuffer*>* registry() {
+    static unordered_set<ThreadBuffer*>* buffers = new unordered_set<ThreadBuffer*>();
+    return buffers;
+  }
+
+  // Taken by the owning thread to update the entries, and by the destructors
+  // of trackers to flush them. Uncontended otherwise.
+  simple_spinlock lock;
+  Entry entries[kNumEntries];
+  // The entry to flush when all of them are in use.
+  int next_victim;
+};
+
 // The ancestor for all trackers. Every tracker is visible from the root down.
 static shared_ptr<MemTracker> root_tracker;
 static GoogleOnceType root_tracker_once = GOOGLE_ONCE_INIT;
@@ -79,6 +165,9 @@ MemTracker::MemTracker(int64_t byte_limit, const string& id, shared_ptr<MemTrack
 MemTracker::~MemTracker() {
   VLOG(1) << "Destroying tracker " << ToString();
   if (parent_) {
+    if (!batched_trackers_.empty()) {
+      FlushThreadBuffers();
+    }
     DCHECK(consumption() == 0) << "Memory tracker " << ToString()
         << " has unreleased consumption " << consumption();
     parent_->Release(consumption());
@@ -194,9 +283,10 @@ void MemTracker::Consume(int64_t bytes) {
   if (bytes == 0) {
     return;
   }
-  for (auto& tracker : all_trackers_) {
+  for (auto& tracker : immediate_trackers_) {
     tracker->consumption_.IncrementBy(bytes);
   }
+  UpdateBatched(bytes);
 }
 
 bool MemTracker::TryConsume(int64_t bytes) {
@@ -207,8 +297,8 @@ bool MemTracker::TryConsume(int64_t bytes) {
 
   int i = 0;
   // Walk the tracker tree top-down, consuming memory from each in turn.
-  for (i = all_trackers_.size() - 1; i >= 0; --i) {
-    MemTracker *tracker = all_trackers_[i];
+  for (i = immediate_trackers_.size() - 1; i >= 0; --i) {
+    MemTracker *tracker = immediate_trackers_[i];
     if (tracker->limit_ < 0) {
       tracker->consumption_.IncrementBy(bytes);
     } else {
@@ -219,6 +309,7 @@ bool MemTracker::TryConsume(int64_t bytes) {
   }
   // Everyone succeeded, return.
   if (i == -1) {
+    UpdateBatched(bytes);
     return true;
   }
 
@@ -227,8 +318,8 @@ bool MemTracker::TryConsume(int64_t bytes) {
   // the updated trackers aren't decremented. The max values are only used
   // for error reporting so this is probably okay. Rolling those back is
   // pretty hard; we'd need something like 2PC.
-  for (int j = all_trackers_.size() - 1; j > i; --j) {
-    all_trackers_[j]->consumption_.IncrementBy(-bytes);
+  for (int j = immediate_trackers_.size() - 1; j > i; --j) {
+    immediate_trackers_[j]->consumption_.IncrementBy(-bytes);
   }
   return false;
 }
@@ -243,12 +334,70 @@ void MemTracker::Release(int64_t bytes) {
     return;
   }
 
-  for (auto& tracker : all_trackers_) {
+  for (auto& tracker : immediate_trackers_) {
     tracker->consumption_.IncrementBy(-bytes);
   }
+  UpdateBatched(-bytes);
   process_memory::MaybeGCAfterRelease(bytes);
 }
 
+void MemTracker::UpdateBatched(int64_t bytes) {
+  if (batched_trackers_.empty()) {
+    return;
+  }
+  const int64_t batch_bytes = FLAGS_mem_tracker_update_batch_bytes;
+  if (batch_bytes <= 0) {
+    ApplyToBatched(bytes);
+    return;
+  }
+
+  ThreadBuffer* buffer = ThreadBuffer::Get();
+  lock_guard<simple_spinlock> l(buffer->lock);
+  ThreadBuffer::Entry* entry = nullptr;
+  ThreadBuffer::Entry* free_entry = nullptr;
+  for (auto& e : buffer->entries) {
+    if (e.tracker == this) {
+      entry = &e;
+      break;
+    }
+    if (e.tracker == nullptr && free_entry == nullptr) {
+      free_entry = &e;
+    }
+  }
+  if (entry == nullptr) {
+    entry = free_entry;
+    if (entry == nullptr) {
+      entry = &buffer->entries[buffer->next_victim];
+      buffer->next_victim = (buffer->next_victim + 1) % ThreadBuffer::kNumEntries;
+      ThreadBuffer::FlushUnlocked(entry);
+    }
+    entry->tracker = this;
+  }
+  entry->bytes += bytes;
+  if (std::abs(entry->bytes) >= batch_bytes) {
+    ApplyToBatched(entry->bytes);
+    entry->bytes = 0;
+  }
+}
+
+void MemTracker::ApplyToBatched(int64_t bytes) {
+  for (auto& tracker : batched_trackers_) {
+    tracker->consumption_.IncrementBy(bytes);
+  }
+}
+
+void MemTracker::FlushThreadBuffers() {
+  lock_guard<simple_spinlock> r(*ThreadBuffer::registry_lock());
+  for (ThreadBuffer* buffer : *ThreadBuffer::registry()) {
+    lock_guard<simple_spinlock> l(buffer->lock);
+    for (auto& e : buffer->entries) {
+      if (e.tracker == this) {
+        ThreadBuffer::FlushUnlocked(&e);
+      }
+    }
+  }
+}
+
 bool MemTracker::AnyLimitExceeded() {
   for (const auto& tracker : limit_trackers_) {
     if (tracker->LimitExceeded()) {
@@ -278,6 +427,13 @@ void MemTracker::Init() {
   }
   DCHECK_GT(all_trackers_.size(), 0);
   DCHECK_EQ(all_trackers_[0], this);
+  for (MemTracker* t : all_trackers_) {
+    if (t == this || t->has_limit()) {
+      immediate_trackers_.push_back(t);
+    } else {
+      batched_trackers_.push_back(t);
+    }
+  }
 }
 
 void MemTracker::AddChildTracker(const shared_ptr<MemTracker>& tracker) {
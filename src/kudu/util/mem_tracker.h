@@ -54,6 +54,14 @@ namespace kudu {
 // Memory consumption is tracked via calls to Consume()/Release(), either to
 // the tracker itself or to one of its descendants.
 //
+// The consumption of a tracker and of its ancestors with a limit is updated
+// immediately, so that limit checks are exact. The updates of its ancestors
+// without a limit, such as the root tracker, are buffered by each thread up
+// to --mem_tracker_update_batch_bytes, so that the threads don't all contend
+// on their counters. Their consumption may thus lag by up to that many bytes
+// per thread. The buffered updates are flushed when a thread exits and when
+// the tracker they belong to is destroyed.
+//
 // This class is thread-safe.
 class MemTracker : public std::enable_shared_from_this<MemTracker> {
  public:
@@ -169,6 +177,18 @@ class MemTracker : public std::enable_shared_from_this<MemTracker> {
   // Creates the root tracker.
   static void CreateRootTracker();
 
+  // Updates the consumption of 'batched_trackers_' by 'bytes', possibly
+  // buffering the update in the calling thread.
+  void UpdateBatched(int64_t bytes);
+
+  // Updates the consumption of 'batched_trackers_' by 'bytes', immediately.
+  void ApplyToBatched(int64_t bytes);
+
+  // Flushes the updates buffered by all threads for this tracker.
+  void FlushThreadBuffers();
+
+  struct ThreadBuffer;
+
   int64_t limit_;
   const std::string id_;
   const std::string descr_;
@@ -180,6 +200,10 @@ class MemTracker : public std::enable_shared_from_this<MemTracker> {
   std::vector<MemTracker*> all_trackers_;
   // all_trackers_ with valid limits
   std::vector<MemTracker*> limit_trackers_;
+  // this tracker plus limit_trackers_, which are updated immediately
+  std::vector<MemTracker*> immediate_trackers_;
+  // the other trackers of all_trackers_, whose updates are buffered
+  std::vector<MemTracker*> batched_trackers_;
 
   // All the child trackers of this tracker. Used for error reporting and
   // listing only (i.e. updating the consumption of a parent tracker does not
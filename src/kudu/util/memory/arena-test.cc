@@ -40,7 +40,9 @@ namespace kudu {
 using std::shared_ptr;
 using std::string;
 using std::thread;
+using std::unique_ptr;
 using std::vector;
+using std::weak_ptr;
 
 template<class ArenaType>
 static void AllocateThread(ArenaType *arena, uint8_t thread_index) {
@@ -92,6 +94,30 @@ TEST(TestArena, TestMultiThreaded) {
   }
 }
 
+TEST(TestArena, TestPerCpuMultiThreaded) {
+  CHECK(FLAGS_num_threads < 256);
+
+  shared_ptr<MemTracker> mem_tracker = MemTracker::CreateTracker(-1, "arena-test-tracker");
+  shared_ptr<MemoryTrackingBufferAllocator> allocator(
+      new MemoryTrackingBufferAllocator(HeapBufferAllocator::Get(), mem_tracker));
+  PerCpuMemoryTrackingArena arena(16, allocator);
+  ASSERT_GT(arena.num_slabs(), 0);
+
+  vector<thread> threads;
+  for (uint8_t i = 0; i < FLAGS_num_threads; i++) {
+    threads.emplace_back([&arena, i]() { AllocateThread(&arena, i); });
+  }
+  for (thread& thr : threads) {
+    thr.join();
+  }
+
+  // Every slab charges the shared tracker, so the footprint of the striped
+  // arena must account for everything that was allocated.
+  ASSERT_GE(arena.memory_footprint(),
+            static_cast<size_t>(FLAGS_num_threads * FLAGS_allocs_per_thread * FLAGS_alloc_size));
+  ASSERT_EQ(arena.memory_footprint(), static_cast<size_t>(mem_tracker->consumption()));
+}
+
 TEST(TestArena, TestAlignment) {
   ThreadSafeArena arena(1024);
   for (int i = 0; i < 1000; i++) {
@@ -202,4 +228,57 @@ TEST(TestArena, TestSTLAllocator) {
   }
 }
 
+TEST(TestArena, TestRetainUntilReset) {
+  Arena a(256);
+  shared_ptr<string> obj = std::make_shared<string>("retained");
+  weak_ptr<string> weak_obj = obj;
+  a.RetainUntilReset(std::move(obj));
+  ASSERT_FALSE(weak_obj.expired());
+  a.AllocateBytes(1024);
+  ASSERT_FALSE(weak_obj.expired());
+  a.Reset();
+  ASSERT_TRUE(weak_obj.expired());
+
+  // Retained objects are also released when the arena is destroyed.
+  {
+    ThreadSafeArena ts(256);
+    obj = std::make_shared<string>("retained");
+    weak_obj = obj;
+    ts.RetainUntilReset(std::move(obj));
+    ASSERT_FALSE(weak_obj.expired());
+  }
+  ASSERT_TRUE(weak_obj.expired());
+}
+
+TEST(TestArena, TestArenaCache) {
+  ArenaCache cache;
+  unique_ptr<Arena> a = cache.Get(256);
+  a->AllocateBytes(128);
+  Arena* a_ptr = a.get();
+  cache.Put(std::move(a));
+  ASSERT_EQ(1, cache.num_cached());
+
+  // The returned arena is reused, and has been reset.
+  unique_ptr<Arena> b = cache.Get(256);
+  ASSERT_EQ(a_ptr, b.get());
+  ASSERT_EQ(0, cache.num_cached());
+
+  // An arena which grew too large isn't cached.
+  b->AllocateBytes(ArenaCache::kMaxCachedFootprint * 2);
+  cache.Put(std::move(b));
+  ASSERT_EQ(0, cache.num_cached());
+
+  // An arena returned by another thread is reused by this one, whichever
+  // CPUs the threads run on.
+  unique_ptr<Arena> c = cache.Get(256);
+  Arena* c_ptr = c.get();
+  thread t([&]() {
+    cache.Put(std::move(c));
+  });
+  t.join();
+  ASSERT_EQ(1, cache.num_cached());
+  unique_ptr<Arena> d = cache.Get(256);
+  ASSERT_EQ(c_ptr, d.get());
+}
+
 } // namespace kudu
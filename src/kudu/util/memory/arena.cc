@@ -19,10 +19,14 @@
 //
 #include "kudu/util/memory/arena.h"
 
+#include <sched.h>
+
 #include <algorithm>
 #include <memory>
 #include <mutex>
 
+#include "kudu/gutil/sysinfo.h"
+
 using std::min;
 using std::unique_ptr;
 
@@ -130,9 +134,16 @@ void ArenaBase<THREADSAFE>::AddComponent(ArenaBase::Component *component) {
   arena_footprint_ += component->size();
 }
 
+template <bool THREADSAFE>
+void ArenaBase<THREADSAFE>::RetainUntilReset(std::shared_ptr<void> obj) {
+  std::lock_guard<mutex_type> lock(component_lock_);
+  retained_.emplace_back(std::move(obj));
+}
+
 template <bool THREADSAFE>
 void ArenaBase<THREADSAFE>::Reset() {
   std::lock_guard<mutex_type> lock(component_lock_);
+  retained_.clear();
 
   if (PREDICT_FALSE(arena_.size() > 1)) {
     unique_ptr<Component> last = std::move(arena_.back());
@@ -163,5 +174,124 @@ size_t ArenaBase<THREADSAFE>::memory_footprint() const {
 template class ArenaBase<true>;
 template class ArenaBase<false>;
 
+const size_t ArenaCache::kMaxCachedArenasPerShard;
+const size_t ArenaCache::kMaxCachedFootprint;
+
+ArenaCache::ArenaCache() {
+#if defined(__APPLE__) || defined(THREAD_SANITIZER)
+  // See PerCpuMemoryTrackingArena.
+  n_shards_ = 1;
+#else
+  n_shards_ = base::MaxCPUIndex() + 1;
+#endif
+  CHECK_GT(n_shards_, 0);
+  shards_.reset(new PaddedShard[n_shards_]);
+  for (int i = 0; i < n_shards_; i++) {
+    shards_[i].shard.free.reserve(kMaxCachedArenasPerShard);
+  }
+}
+
+ArenaCache::~ArenaCache() {
+}
+
+ArenaCache* ArenaCache::Shared() {
+  static ArenaCache* cache = new ArenaCache();
+  return cache;
+}
+
+int ArenaCache::CurrentShardIndex() const {
+#if defined(__APPLE__) || defined(THREAD_SANITIZER)
+  return 0;
+#else
+  int cpu = sched_getcpu();
+  if (PREDICT_FALSE(cpu < 0 || cpu >= n_shards_)) {
+    cpu = 0;
+  }
+  return cpu;
+#endif
+}
+
+unique_ptr<Arena> ArenaCache::Get(size_t initial_buffer_size) {
+  // Start with the shard of the current CPU, which is the least likely to be
+  // contended.
+  const int first = CurrentShardIndex();
+  for (int i = 0; i < n_shards_; i++) {
+    Shard* shard = &shards_[(first + i) % n_shards_].shard;
+    std::lock_guard<simple_spinlock> l(shard->lock);
+    if (!shard->free.empty()) {
+      unique_ptr<Arena> arena = std::move(shard->free.back());
+      shard->free.pop_back();
+      return arena;
+    }
+  }
+  return unique_ptr<Arena>(new Arena(initial_buffer_size));
+}
+
+void ArenaCache::Put(unique_ptr<Arena> arena) {
+  if (arena->memory_footprint() > kMaxCachedFootprint) {
+    return;
+  }
+  // Reset the arena before taking the lock, which it doesn't need.
+  arena->Reset();
+  Shard* shard = &shards_[CurrentShardIndex()].shard;
+  std::lock_guard<simple_spinlock> l(shard->lock);
+  if (shard->free.size() < kMaxCachedArenasPerShard) {
+    shard->free.emplace_back(std::move(arena));
+  }
+}
+
+size_t ArenaCache::num_cached() const {
+  size_t total = 0;
+  for (int i = 0; i < n_shards_; i++) {
+    const Shard& shard = shards_[i].shard;
+    std::lock_guard<simple_spinlock> l(shard.lock);
+    total += shard.free.size();
+  }
+  return total;
+}
+
+PerCpuMemoryTrackingArena::PerCpuMemoryTrackingArena(
+    size_t initial_buffer_size,
+    const std::shared_ptr<MemoryTrackingBufferAllocator>& tracking_allocator) {
+#if defined(__APPLE__) || defined(THREAD_SANITIZER)
+  // See percpu_rwlock: there's no cheap way to get the current CPU on OSX,
+  // and under TSAN we'd rather exercise the shared-slab path.
+  n_slabs_ = 1;
+#else
+  n_slabs_ = base::MaxCPUIndex() + 1;
+#endif
+  CHECK_GT(n_slabs_, 0);
+  slabs_.reset(new PaddedSlab[n_slabs_]);
+  for (int i = 0; i < n_slabs_; i++) {
+    slabs_[i].arena.reset(new ThreadSafeMemoryTrackingArena(initial_buffer_size,
+                                                            tracking_allocator));
+  }
+}
+
+PerCpuMemoryTrackingArena::~PerCpuMemoryTrackingArena() {
+}
+
+ThreadSafeMemoryTrackingArena* PerCpuMemoryTrackingArena::current() {
+#if defined(__APPLE__) || defined(THREAD_SANITIZER)
+  int cpu = 0;
+#else
+  int cpu = sched_getcpu();
+  // sched_getcpu() may fail or report a CPU that came online after we were
+  // constructed. Either way, any slab is correct, so fall back to the first.
+  if (PREDICT_FALSE(cpu < 0 || cpu >= n_slabs_)) {
+    cpu = 0;
+  }
+#endif
+  return slabs_[cpu].arena.get();
+}
+
+size_t PerCpuMemoryTrackingArena::memory_footprint() const {
+  size_t total = 0;
+  for (int i = 0; i < n_slabs_; i++) {
+    total += slabs_[i].arena->memory_footprint();
+  }
+  return total;
+}
+
 
 }  // namespace kudu
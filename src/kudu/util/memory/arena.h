@@ -30,6 +30,7 @@
 #include <memory>
 #include <new>
 #include <ostream>
+#include <utility>
 #include <vector>
 
 #include <boost/signals2/dummy_mutex.hpp>
@@ -166,8 +167,16 @@ class ArenaBase {
   // NOTE: alignment MUST be a power of two, or else this will break.
   void* AllocateBytesAligned(const size_t size, const size_t alignment);
 
+  // Keeps 'obj' alive until the arena is Reset() or destroyed. This allows
+  // data handed out together with the arena's allocations, e.g. Slices of
+  // a ColumnBlock, to point into buffers owned by 'obj' rather than being
+  // copied into the arena. Memory held by 'obj' isn't counted in the
+  // arena's footprint.
+  void RetainUntilReset(std::shared_ptr<void> obj);
+
   // Removes all data from the arena. (Invalidates all pointers returned by
-  // AddSlice and AllocateBytes). Does not cause memory allocation.
+  // AddSlice and AllocateBytes, and releases the objects retained by
+  // RetainUntilReset). Does not cause memory allocation.
   // May reduce memory footprint, as it discards all allocated buffers but
   // the last one.
   // Unless allocations exceed max_buffer_size, repetitive filling up and
@@ -222,6 +231,9 @@ class ArenaBase {
   size_t max_buffer_size_;
   size_t arena_footprint_;
 
+  // Objects kept alive until the next Reset(). See RetainUntilReset().
+  std::vector<std::shared_ptr<void>> retained_;
+
   // Lock covering 'slow path' allocation, when new components are
   // allocated and added to the arena's list. Also covers any other
   // mutation of the component data structure (eg Reset).
@@ -304,6 +316,63 @@ class ThreadSafeArena : public ArenaBase<true> {
   {}
 };
 
+// A cache of unused Arenas, so that short-lived objects which each need their
+// own arena (e.g. transactions) usually don't allocate and free the arena's
+// buffers.
+//
+// Arenas are often taken by one thread and returned by another: a write's
+// arena is taken by the RPC service thread which decodes it, and returned by
+// the thread which applies it. So rather than per thread, the cache is
+// sharded by CPU, each shard being protected by a spinlock: Put() caches the
+// arena in the shard of the current CPU, and Get() takes one from there, or
+// from any other shard if that one is empty.
+//
+// Returned arenas are Reset() before being cached. Any which have grown beyond
+// kMaxCachedFootprint, or which would make a shard cache more than
+// kMaxCachedArenasPerShard arenas, are deleted instead, so that a single large
+// request doesn't keep its memory pinned in the cache.
+//
+// This class is thread-safe.
+class ArenaCache {
+ public:
+  static const size_t kMaxCachedArenasPerShard = 16;
+  static const size_t kMaxCachedFootprint = 64 * 1024;
+
+  ArenaCache();
+  ~ArenaCache();
+
+  // Returns the cache shared by the whole process.
+  static ArenaCache* Shared();
+
+  // Returns an empty arena, reusing a cached one if possible. A newly
+  // created arena has 'initial_buffer_size' as its initial buffer size.
+  std::unique_ptr<Arena> Get(size_t initial_buffer_size);
+
+  // Resets 'arena' and caches it for a subsequent Get().
+  void Put(std::unique_ptr<Arena> arena);
+
+  // Returns the number of arenas cached.
+  size_t num_cached() const;
+
+ private:
+  struct Shard {
+    mutable simple_spinlock lock;
+    std::vector<std::unique_ptr<Arena>> free;
+  };
+  struct PaddedShard {
+    Shard shard;
+    char padding[CACHELINE_SIZE - (sizeof(Shard) % CACHELINE_SIZE)];
+  };
+
+  // Returns the index of the shard of the current CPU.
+  int CurrentShardIndex() const;
+
+  int n_shards_;
+  std::unique_ptr<PaddedShard[]> shards_;
+
+  DISALLOW_COPY_AND_ASSIGN(ArenaCache);
+};
+
 // Arena implementation that is integrated with MemTracker in order to
 // track heap-allocated space consumed by the arena.
 
@@ -344,6 +413,66 @@ class ThreadSafeMemoryTrackingArena : public ArenaBase<true> {
   std::shared_ptr<MemoryTrackingBufferAllocator> tracking_allocator_;
 };
 
+// Thread-safe, memory-tracking arena which is striped across CPUs.
+//
+// Each CPU allocates from its own ThreadSafeMemoryTrackingArena, so that
+// concurrent writers running on different cores don't contend on the CAS of
+// a single component's offset, nor on the component lock when a component
+// fills up. Allocations are never moved between slabs, so the memory returned
+// remains valid until the whole arena is destroyed.
+//
+// This exposes the allocation subset of the ArenaBase API, which is what the
+// MemRowSet and its ConcurrentBTree need from their ArenaType.
+class PerCpuMemoryTrackingArena {
+ public:
+  PerCpuMemoryTrackingArena(
+      size_t initial_buffer_size,
+      const std::shared_ptr<MemoryTrackingBufferAllocator>& tracking_allocator);
+
+  ~PerCpuMemoryTrackingArena();
+
+  void* AllocateBytes(const size_t size) {
+    return current()->AllocateBytes(size);
+  }
+
+  void* AllocateBytesAligned(const size_t size, const size_t alignment) {
+    return current()->AllocateBytesAligned(size, alignment);
+  }
+
+  uint8_t* AddSlice(const Slice& value) {
+    return current()->AddSlice(value);
+  }
+
+  bool RelocateSlice(const Slice& src, Slice* dst) {
+    return current()->RelocateSlice(src, dst);
+  }
+
+  template<class T, typename ... Args>
+  T* NewObject(Args&&... args) {
+    return current()->NewObject<T>(std::forward<Args>(args)...);
+  }
+
+  // Returns the sum of the footprints of all of the per-CPU slabs.
+  size_t memory_footprint() const;
+
+  // Returns the number of per-CPU slabs.
+  int num_slabs() const { return n_slabs_; }
+
+ private:
+  struct PaddedSlab {
+    std::unique_ptr<ThreadSafeMemoryTrackingArena> arena;
+    char padding[CACHELINE_SIZE -
+                 (sizeof(std::unique_ptr<ThreadSafeMemoryTrackingArena>) % CACHELINE_SIZE)];
+  };
+
+  ThreadSafeMemoryTrackingArena* current();
+
+  int n_slabs_;
+  std::unique_ptr<PaddedSlab[]> slabs_;
+
+  DISALLOW_COPY_AND_ASSIGN(PerCpuMemoryTrackingArena);
+};
+
 // Implementation of inline and template methods
 
 template<bool THREADSAFE>
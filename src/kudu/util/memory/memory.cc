@@ -30,6 +30,7 @@
 
 #include "kudu/util/alignment.h"
 #include "kudu/util/flag_tags.h"
+#include "kudu/util/hugepage_allocator.h"
 #include "kudu/util/memory/overwrite.h"
 #include "kudu/util/mem_tracker.h"
 
@@ -195,6 +196,49 @@ void ClearingBufferAllocator::FreeInternal(Buffer* buffer) {
   DelegateFree(delegate_, buffer);
 }
 
+Buffer* HugePageBufferAllocator::AllocateInternal(size_t requested,
+                                                  size_t minimal,
+                                                  BufferAllocator* originator) {
+  void* data = HugePageSlabAllocator::Get()->Allocate(requested);
+  if (data != nullptr) {
+    return CreateBuffer(data, requested, originator);
+  }
+  return DelegateAllocate(HeapBufferAllocator::Get(), requested, minimal, originator);
+}
+
+bool HugePageBufferAllocator::ReallocateInternal(size_t requested,
+                                                 size_t minimal,
+                                                 Buffer* buffer,
+                                                 BufferAllocator* originator) {
+  HugePageSlabAllocator* slabs = HugePageSlabAllocator::Get();
+  if (!slabs->Owns(buffer->data())) {
+    return DelegateReallocate(HeapBufferAllocator::Get(), requested, minimal, buffer,
+                              originator);
+  }
+  if (requested > 0 && requested <= slabs->UsableSize(buffer->data())) {
+    UpdateBuffer(buffer->data(), requested, buffer);
+    return true;
+  }
+  void* data = slabs->Allocate(requested);
+  if (data == nullptr) {
+    // Buffers which aren't owned by the slabs are freed by the heap allocator.
+    data = (requested == 0) ? &dummy_buffer[0] : malloc(requested);
+    if (data == nullptr) {
+      return false;
+    }
+  }
+  memcpy(data, buffer->data(), min(buffer->size(), requested));
+  slabs->Free(buffer->data());
+  UpdateBuffer(data, requested, buffer);
+  return true;
+}
+
+void HugePageBufferAllocator::FreeInternal(Buffer* buffer) {
+  if (!HugePageSlabAllocator::Get()->Free(buffer->data())) {
+    DelegateFree(HeapBufferAllocator::Get(), buffer);
+  }
+}
+
 Buffer* MediatingBufferAllocator::AllocateInternal(
     const size_t requested,
     const size_t minimal,
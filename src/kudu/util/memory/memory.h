@@ -313,6 +313,40 @@ class ClearingBufferAllocator : public BufferAllocator {
   DISALLOW_COPY_AND_ASSIGN(ClearingBufferAllocator);
 };
 
+// Allocator which serves the buffers fitting the slabs of the
+// HugePageSlabAllocator from them, and the others from the heap.
+class HugePageBufferAllocator : public BufferAllocator {
+ public:
+  virtual ~HugePageBufferAllocator() {}
+
+  // Returns a singleton instance of the huge page allocator.
+  static HugePageBufferAllocator* Get() {
+    return Singleton<HugePageBufferAllocator>::get();
+  }
+
+  virtual size_t Available() const OVERRIDE {
+    return std::numeric_limits<size_t>::max();
+  }
+
+ private:
+  friend class Singleton<HugePageBufferAllocator>;
+
+  virtual Buffer* AllocateInternal(size_t requested,
+                                   size_t minimal,
+                                   BufferAllocator* originator) OVERRIDE;
+
+  virtual bool ReallocateInternal(size_t requested,
+                                  size_t minimal,
+                                  Buffer* buffer,
+                                  BufferAllocator* originator) OVERRIDE;
+
+  virtual void FreeInternal(Buffer* buffer) OVERRIDE;
+
+  HugePageBufferAllocator() {}
+
+  DISALLOW_COPY_AND_ASSIGN(HugePageBufferAllocator);
+};
+
 // Abstract policy for modifying allocation requests - e.g. enforcing quotas.
 class Mediator {
  public:
@@ -17,7 +17,9 @@
 
 #include <cstdint>
 #include <ostream>
+#include <sstream>
 #include <string>
+#include <thread>
 #include <unordered_set>
 #include <vector>
 
@@ -32,6 +34,7 @@
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/util/hdr_histogram.h"
+#include "kudu/util/histogram.pb.h"
 #include "kudu/util/jsonreader.h"
 #include "kudu/util/jsonwriter.h"
 #include "kudu/util/metrics.h"
@@ -175,6 +178,40 @@ TEST_F(MetricsTest, SimpleHistogramTest) {
   // TODO: Test coverage needs to be improved a lot.
 }
 
+METRIC_DEFINE_histogram(test_entity, test_per_cpu_hist, "Test Per-CPU Histogram",
+                        MetricUnit::kMilliseconds, "foo", 1000000, 3, kudu::PER_CPU);
+
+// Records from several threads into a per-CPU histogram and verifies that
+// the merged view accounts for every value.
+TEST_F(MetricsTest, PerCpuHistogramTest) {
+  const int kNumThreads = 8;
+  const int kValuesPerThread = 1000;
+  scoped_refptr<Histogram> hist = METRIC_test_per_cpu_hist.Instantiate(entity_);
+  vector<std::thread> threads;
+  for (int t = 0; t < kNumThreads; t++) {
+    threads.emplace_back([&hist, t]() {
+      for (int i = 1; i <= kValuesPerThread; i++) {
+        hist->Increment(t * kValuesPerThread + i);
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  const int64_t kNumValues = kNumThreads * kValuesPerThread;
+  ASSERT_EQ(kNumValues, hist->TotalCount());
+  ASSERT_EQ(kNumValues * (kNumValues + 1) / 2, hist->TotalSum());
+  ASSERT_EQ(1, hist->MinValueForTests());
+  ASSERT_EQ(kNumValues, hist->MaxValueForTests());
+  ASSERT_EQ(kNumValues, hist->histogram_for_tests()->TotalCount());
+
+  HistogramSnapshotPB snapshot;
+  ASSERT_OK(hist->GetHistogramSnapshotPB(&snapshot, MetricJsonOptions()));
+  ASSERT_EQ(kNumValues, snapshot.total_count());
+  ASSERT_EQ(1, snapshot.min());
+  ASSERT_EQ(kNumValues, snapshot.max());
+}
+
 TEST_F(MetricsTest, JsonPrintTest) {
   scoped_refptr<Counter> bytes_seen = METRIC_reqs_pending.Instantiate(entity_);
   bytes_seen->Increment();
@@ -211,6 +248,59 @@ TEST_F(MetricsTest, JsonPrintTest) {
   ASSERT_EQ("", out.str());
 }
 
+TEST_F(MetricsTest, JsonFilterTest) {
+  scoped_refptr<Counter> reqs = METRIC_reqs_pending.Instantiate(entity_);
+  reqs->Increment();
+
+  // Filter by entity type.
+  std::ostringstream out;
+  JsonWriter writer(&out, JsonWriter::COMPACT);
+  MetricJsonOptions opts;
+  opts.entity_types = { "tablet" };
+  ASSERT_OK(registry_.WriteAsJson(&writer, { "*" }, opts));
+  ASSERT_EQ("[]", out.str());
+  out.str("");
+  opts.entity_types = { "tablet", "test_entity" };
+  ASSERT_OK(registry_.WriteAsJson(&writer, { "*" }, opts));
+  ASSERT_STR_CONTAINS(out.str(), "reqs_pending");
+
+  // The entity isn't output until one of its metrics is modified in the
+  // new epoch.
+  opts.entity_types.clear();
+  opts.only_modified_in_or_after_epoch = Metric::IncrementEpoch();
+  ASSERT_FALSE(reqs->ModifiedInOrAfterEpoch(opts.only_modified_in_or_after_epoch));
+  out.str("");
+  ASSERT_OK(entity_->WriteAsJson(&writer, { "*" }, opts));
+  ASSERT_EQ("", out.str());
+  reqs->Increment();
+  ASSERT_TRUE(reqs->ModifiedInOrAfterEpoch(opts.only_modified_in_or_after_epoch));
+  ASSERT_OK(entity_->WriteAsJson(&writer, { "*" }, opts));
+  ASSERT_STR_CONTAINS(out.str(), "reqs_pending");
+}
+
+TEST_F(MetricsTest, PrometheusPrintTest) {
+  scoped_refptr<Counter> reqs = METRIC_reqs_pending.Instantiate(entity_);
+  reqs->IncrementBy(3);
+  scoped_refptr<Histogram> hist = METRIC_test_hist.Instantiate(entity_);
+  hist->Increment(10);
+  hist->Increment(20);
+  entity_->SetAttribute("test_attr", "attr \"val\"");
+
+  std::ostringstream out;
+  registry_.WriteAsPrometheus(&out, { "*" }, MetricJsonOptions());
+  const string kLabels = "entity_type=\"test_entity\",entity_id=\"my-test\","
+                         "test_attr=\"attr \\\"val\\\"\"";
+  ASSERT_STR_CONTAINS(out.str(),
+                      "# HELP kudu_test_entity_reqs_pending Number of requests pending\n"
+                      "# TYPE kudu_test_entity_reqs_pending counter\n"
+                      "kudu_test_entity_reqs_pending{" + kLabels + "} 3\n");
+  ASSERT_STR_CONTAINS(out.str(), "# TYPE kudu_test_entity_test_hist summary\n");
+  ASSERT_STR_CONTAINS(out.str(),
+                      "kudu_test_entity_test_hist{" + kLabels + ",quantile=\"0.5\"} 10\n");
+  ASSERT_STR_CONTAINS(out.str(), "kudu_test_entity_test_hist_sum{" + kLabels + "} 30\n");
+  ASSERT_STR_CONTAINS(out.str(), "kudu_test_entity_test_hist_count{" + kLabels + "} 2\n");
+}
+
 // Test that metrics are retired when they are no longer referenced.
 TEST_F(MetricsTest, RetirementTest) {
   FLAGS_metrics_retirement_age_ms = 100;
@@ -16,9 +16,16 @@
 // under the License.
 #include "kudu/util/metrics.h"
 
+#include <sched.h>
+
+#include <algorithm>
+#include <cctype>
 #include <cstdlib>
 #include <iostream>
+#include <limits>
 #include <map>
+#include <ostream>
+#include <sstream>
 #include <utility>
 
 #include <gflags/gflags.h>
@@ -27,6 +34,7 @@
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/singleton.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/sysinfo.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/hdr_histogram.h"
 #include "kudu/util/histogram.pb.h"
@@ -44,6 +52,8 @@ METRIC_DEFINE_entity(server);
 
 namespace kudu {
 
+using std::ostream;
+using std::shared_ptr;
 using std::string;
 using std::vector;
 using strings::Substitute;
@@ -167,7 +177,9 @@ MetricEntity::MetricEntity(const MetricEntityPrototype* prototype,
     : prototype_(prototype),
       id_(std::move(id)),
       attributes_(std::move(attributes)),
-      published_(true) {}
+      published_(true) {
+  UpdatePrometheusLabelsUnlocked();
+}
 
 MetricEntity::~MetricEntity() {
 }
@@ -198,35 +210,80 @@ bool MatchMetricInList(const string& metric_name,
   return false;
 }
 
-} // anonymous namespace
+// Returns 'name' with the characters which aren't allowed in Prometheus
+// metric and label names replaced with underscores.
+string SanitizePrometheusName(const string& name) {
+  string ret = name;
+  for (int i = 0; i < ret.size(); i++) {
+    char c = ret[i];
+    if (!(isalpha(c) || c == '_' || (i > 0 && isdigit(c)))) {
+      ret[i] = '_';
+    }
+  }
+  return ret;
+}
+
+// Appends 'value' to 'out' as a quoted Prometheus label value.
+void AppendPrometheusLabelValue(const string& value, string* out) {
+  out->push_back('"');
+  for (char c : value) {
+    switch (c) {
+      case '\\': out->append("\\\\"); break;
+      case '"': out->append("\\\""); break;
+      case '\n': out->append("\\n"); break;
+      default: out->push_back(c);
+    }
+  }
+  out->push_back('"');
+}
 
+} // anonymous namespace
 
-Status MetricEntity::WriteAsJson(JsonWriter* writer,
-                                 const vector<string>& requested_metrics,
-                                 const MetricJsonOptions& opts) const {
+bool MetricEntity::CollectMetrics(const vector<string>& requested_metrics,
+                                  const MetricJsonOptions& opts,
+                                  OrderedMetricMap* metrics,
+                                  AttributeMap* attrs) const {
+  if (!opts.entity_types.empty() &&
+      std::find(opts.entity_types.begin(), opts.entity_types.end(),
+                prototype_->name()) == opts.entity_types.end()) {
+    return false;
+  }
   bool select_all = MatchMetricInList(id(), requested_metrics);
-
-  // We want the keys to be in alphabetical order when printing, so we use an ordered map here.
-  typedef std::map<const char*, scoped_refptr<Metric> > OrderedMetricMap;
-  OrderedMetricMap metrics;
-  AttributeMap attrs;
+  const int64_t epoch = opts.only_modified_in_or_after_epoch;
   {
     // Snapshot the metrics in this registry (not guaranteed to be a consistent snapshot)
     std::lock_guard<simple_spinlock> l(lock_);
-    attrs = attributes_;
+    if (attrs) {
+      *attrs = attributes_;
+    }
     for (const MetricMap::value_type& val : metric_map_) {
       const MetricPrototype* prototype = val.first;
       const scoped_refptr<Metric>& metric = val.second;
 
-      if (select_all || MatchMetricInList(prototype->name(), requested_metrics)) {
-        InsertOrDie(&metrics, prototype->name(), metric);
+      if ((select_all || MatchMetricInList(prototype->name(), requested_metrics)) &&
+          (epoch == 0 || metric->ModifiedInOrAfterEpoch(epoch))) {
+        InsertOrDie(metrics, prototype->name(), metric);
       }
     }
   }
 
   // If we had a filter, and we didn't either match this entity or any metrics inside
-  // it, don't print the entity at all.
-  if (!requested_metrics.empty() && !select_all && metrics.empty()) {
+  // it, don't print the entity at all. The same goes for an entity with no metric
+  // modified since the requested epoch.
+  if (metrics->empty() &&
+      (epoch > 0 || (!requested_metrics.empty() && !select_all))) {
+    return false;
+  }
+  return true;
+}
+
+Status MetricEntity::WriteAsJson(JsonWriter* writer,
+                                 const vector<string>& requested_metrics,
+                                 const MetricJsonOptions& opts) const {
+  // We want the keys to be in alphabetical order when printing, so we use an ordered map here.
+  OrderedMetricMap metrics;
+  AttributeMap attrs;
+  if (!CollectMetrics(requested_metrics, opts, &metrics, &attrs)) {
     return Status::OK();
   }
 
@@ -313,11 +370,33 @@ void MetricEntity::NeverRetire(const scoped_refptr<Metric>& metric) {
 void MetricEntity::SetAttributes(const AttributeMap& attrs) {
   std::lock_guard<simple_spinlock> l(lock_);
   attributes_ = attrs;
+  UpdatePrometheusLabelsUnlocked();
 }
 
 void MetricEntity::SetAttribute(const string& key, const string& val) {
   std::lock_guard<simple_spinlock> l(lock_);
   attributes_[key] = val;
+  UpdatePrometheusLabelsUnlocked();
+}
+
+void MetricEntity::UpdatePrometheusLabelsUnlocked() {
+  // Order the attributes so that the labels are the same across scrapes.
+  std::map<string, string> attrs(attributes_.begin(), attributes_.end());
+  string labels = "entity_type=";
+  AppendPrometheusLabelValue(prototype_->name(), &labels);
+  labels.append(",entity_id=");
+  AppendPrometheusLabelValue(id_, &labels);
+  for (const auto& attr : attrs) {
+    string name = SanitizePrometheusName(attr.first);
+    if (name == "entity_type" || name == "entity_id") {
+      continue;
+    }
+    labels.push_back(',');
+    labels.append(name);
+    labels.push_back('=');
+    AppendPrometheusLabelValue(attr.second, &labels);
+  }
+  prometheus_labels_ = std::make_shared<const string>(std::move(labels));
 }
 
 //
@@ -356,6 +435,60 @@ Status MetricRegistry::WriteAsJson(JsonWriter* writer,
   return Status::OK();
 }
 
+void MetricRegistry::WriteAsPrometheus(ostream* out,
+                                       const vector<string>& requested_metrics,
+                                       const MetricJsonOptions& opts) const {
+  EntityMap entities;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    entities = entities_;
+  }
+
+  // The samples of a metric must be grouped together, whatever their entity,
+  // so the metrics are first collected by name. Only references to the
+  // metrics and to the labels of their entity are held meanwhile.
+  struct Sample {
+    scoped_refptr<Metric> metric;
+    shared_ptr<const string> labels;
+  };
+  std::map<string, vector<Sample>> samples_by_name;
+  for (const auto& e : entities) {
+    MetricEntity::OrderedMetricMap metrics;
+    if (!e.second->CollectMetrics(requested_metrics, opts, &metrics, nullptr)) {
+      continue;
+    }
+    shared_ptr<const string> labels = e.second->prometheus_labels();
+    for (auto& m : metrics) {
+      const MetricPrototype* prototype = m.second->prototype();
+      string name = SanitizePrometheusName(
+          Substitute("kudu_$0_$1", prototype->entity_type(), prototype->name()));
+      samples_by_name[name].push_back({ std::move(m.second), labels });
+    }
+  }
+  entities.clear();
+
+  const auto old_precision = out->precision(std::numeric_limits<double>::max_digits10);
+  for (const auto& e : samples_by_name) {
+    const string& name = e.first;
+    const MetricPrototype* prototype = e.second.front().metric->prototype();
+    const char* type;
+    switch (prototype->type()) {
+      case MetricType::kCounter: type = "counter"; break;
+      case MetricType::kHistogram: type = "summary"; break;
+      default: type = "gauge"; break;
+    }
+    *out << "# HELP " << name << " " << prototype->description() << "\n";
+    *out << "# TYPE " << name << " " << type << "\n";
+    for (const Sample& sample : e.second) {
+      sample.metric->WriteAsPrometheus(out, name, *sample.labels);
+    }
+  }
+  out->precision(old_precision);
+
+  samples_by_name.clear(); // deref the metrics we just dumped before the retirement scan.
+  const_cast<MetricRegistry*>(this)->RetireOldMetrics();
+}
+
 void MetricRegistry::RetireOldMetrics() {
   std::lock_guard<simple_spinlock> l(lock_);
   for (auto it = entities_.begin(); it != entities_.end();) {
@@ -493,8 +626,11 @@ scoped_refptr<MetricEntity> MetricRegistry::FindOrCreateEntity(
 //
 // Metric
 //
+std::atomic<int64_t> Metric::current_epoch_(1);
+
 Metric::Metric(const MetricPrototype* prototype)
-  : prototype_(prototype) {
+  : prototype_(prototype),
+    m_epoch_(current_epoch()) {
 }
 
 Metric::~Metric() {
@@ -517,6 +653,14 @@ Status Gauge::WriteAsJson(JsonWriter* writer,
   return Status::OK();
 }
 
+void Gauge::WriteAsPrometheus(ostream* out, const string& name, const string& labels) const {
+  std::ostringstream value;
+  value.precision(out->precision());
+  if (WritePrometheusValue(&value)) {
+    *out << name << "{" << labels << "} " << value.str() << "\n";
+  }
+}
+
 //
 // StringGauge
 //
@@ -531,6 +675,7 @@ std::string StringGauge::value() const {
 }
 
 void StringGauge::set_value(const std::string& value) {
+  UpdateModificationEpoch();
   std::lock_guard<simple_spinlock> l(lock_);
   value_ = value;
 }
@@ -560,6 +705,7 @@ void Counter::Increment() {
 }
 
 void Counter::IncrementBy(int64_t amount) {
+  UpdateModificationEpoch();
   value_.IncrementBy(amount);
 }
 
@@ -576,6 +722,10 @@ Status Counter::WriteAsJson(JsonWriter* writer,
   return Status::OK();
 }
 
+void Counter::WriteAsPrometheus(ostream* out, const string& name, const string& labels) const {
+  *out << name << "{" << labels << "} " << value() << "\n";
+}
+
 /////////////////////////////////////////////////
 // HistogramPrototype
 /////////////////////////////////////////////////
@@ -603,17 +753,92 @@ scoped_refptr<Histogram> HistogramPrototype::Instantiate(
 // Histogram
 /////////////////////////////////////////////////
 
+struct Histogram::Shard {
+  Shard(uint64_t max_trackable_value, int num_sig_digits)
+      : histogram(max_trackable_value, num_sig_digits) {
+  }
+
+  HdrHistogram histogram;
+  char padding[CACHELINE_SIZE];
+};
+
+namespace {
+int NumHistogramShards(const HistogramPrototype* proto) {
+#if defined(__APPLE__)
+  // There's no cheap way to get the current CPU on OSX; see percpu_rwlock.
+  return 0;
+#else
+  return proto->flags() & PER_CPU ? base::MaxCPUIndex() + 1 : 0;
+#endif
+}
+} // anonymous namespace
+
 Histogram::Histogram(const HistogramPrototype* proto)
   : Metric(proto),
-    histogram_(new HdrHistogram(proto->max_trackable_value(), proto->num_sig_digits())) {
+    histogram_(new HdrHistogram(proto->max_trackable_value(), proto->num_sig_digits())),
+    num_shards_(NumHistogramShards(proto)),
+    shards_(num_shards_ > 0 ? new std::atomic<Shard*>[num_shards_] : nullptr) {
+  for (int i = 0; i < num_shards_; i++) {
+    shards_[i] = nullptr;
+  }
+}
+
+Histogram::~Histogram() {
+  for (int i = 0; i < num_shards_; i++) {
+    delete shards_[i].load();
+  }
+}
+
+HdrHistogram* Histogram::histogram_for_write() {
+  if (num_shards_ == 0) {
+    return histogram_.get();
+  }
+#if !defined(__APPLE__)
+  int cpu = sched_getcpu();
+  // sched_getcpu() may fail or report a CPU that came online after we were
+  // constructed. Either way, any histogram is correct, so fall back to the
+  // shared one.
+  if (PREDICT_FALSE(cpu < 0 || cpu >= num_shards_)) {
+    return histogram_.get();
+  }
+  Shard* shard = shards_[cpu].load(std::memory_order_acquire);
+  if (PREDICT_FALSE(shard == nullptr)) {
+    // Only allocate shards for the CPUs which actually record values, since
+    // a histogram may be instantiated for many entities but only be hot in a
+    // few of them. If two threads race to allocate, the loser frees its shard.
+    const HistogramPrototype* proto = down_cast<const HistogramPrototype*>(prototype_);
+    std::unique_ptr<Shard> new_shard(new Shard(proto->max_trackable_value(),
+                                               proto->num_sig_digits()));
+    if (shards_[cpu].compare_exchange_strong(shard, new_shard.get(),
+                                             std::memory_order_acq_rel)) {
+      shard = new_shard.release();
+    }
+  }
+  return &shard->histogram;
+#else
+  return histogram_.get();
+#endif
+}
+
+std::unique_ptr<HdrHistogram> Histogram::Snapshot() const {
+  std::unique_ptr<HdrHistogram> snapshot(new HdrHistogram(*histogram_));
+  for (int i = 0; i < num_shards_; i++) {
+    const Shard* shard = shards_[i].load(std::memory_order_acquire);
+    if (shard) {
+      snapshot->MergeFrom(shard->histogram);
+    }
+  }
+  return snapshot;
 }
 
 void Histogram::Increment(int64_t value) {
-  histogram_->Increment(value);
+  UpdateModificationEpoch();
+  histogram_for_write()->Increment(value);
 }
 
 void Histogram::IncrementBy(int64_t value, int64_t amount) {
-  histogram_->IncrementBy(value, amount);
+  UpdateModificationEpoch();
+  histogram_for_write()->IncrementBy(value, amount);
 }
 
 Status Histogram::WriteAsJson(JsonWriter* writer,
@@ -625,9 +850,23 @@ Status Histogram::WriteAsJson(JsonWriter* writer,
   return Status::OK();
 }
 
+void Histogram::WriteAsPrometheus(ostream* out, const string& name,
+                                  const string& labels) const {
+  static const char* const kQuantiles[] = { "0.5", "0.75", "0.95", "0.99", "0.999" };
+  static const double kPercentiles[] = { 50, 75, 95, 99, 99.9 };
+  std::unique_ptr<HdrHistogram> snapshot = Snapshot();
+  for (int i = 0; i < arraysize(kQuantiles); i++) {
+    *out << name << "{" << labels << ",quantile=\"" << kQuantiles[i] << "\"} "
+         << snapshot->ValueAtPercentile(kPercentiles[i]) << "\n";
+  }
+  *out << name << "_sum{" << labels << "} " << snapshot->TotalSum() << "\n";
+  *out << name << "_count{" << labels << "} " << snapshot->TotalCount() << "\n";
+}
+
 Status Histogram::GetHistogramSnapshotPB(HistogramSnapshotPB* snapshot_pb,
                                          const MetricJsonOptions& opts) const {
-  HdrHistogram snapshot(*histogram_);
+  std::unique_ptr<HdrHistogram> merged = Snapshot();
+  const HdrHistogram& snapshot = *merged;
   snapshot_pb->set_name(prototype_->name());
   if (opts.include_schema_info) {
     snapshot_pb->set_type(MetricType::Name(prototype_->type()));
@@ -661,22 +900,40 @@ Status Histogram::GetHistogramSnapshotPB(HistogramSnapshotPB* snapshot_pb,
 }
 
 uint64_t Histogram::CountInBucketForValueForTests(uint64_t value) const {
-  return histogram_->CountInBucketForValue(value);
+  return Snapshot()->CountInBucketForValue(value);
 }
 
 uint64_t Histogram::TotalCount() const {
-  return histogram_->TotalCount();
+  uint64_t total = histogram_->TotalCount();
+  for (int i = 0; i < num_shards_; i++) {
+    const Shard* shard = shards_[i].load(std::memory_order_acquire);
+    if (shard) {
+      total += shard->histogram.TotalCount();
+    }
+  }
+  return total;
+}
+
+uint64_t Histogram::TotalSum() const {
+  uint64_t total = histogram_->TotalSum();
+  for (int i = 0; i < num_shards_; i++) {
+    const Shard* shard = shards_[i].load(std::memory_order_acquire);
+    if (shard) {
+      total += shard->histogram.TotalSum();
+    }
+  }
+  return total;
 }
 
 uint64_t Histogram::MinValueForTests() const {
-  return histogram_->MinValue();
+  return Snapshot()->MinValue();
 }
 
 uint64_t Histogram::MaxValueForTests() const {
-  return histogram_->MaxValue();
+  return Snapshot()->MaxValue();
 }
 double Histogram::MeanValueForTests() const {
-  return histogram_->MeanValue();
+  return Snapshot()->MeanValue();
 }
 
 ScopedLatencyMetric::ScopedLatencyMetric(Histogram* latency_hist)
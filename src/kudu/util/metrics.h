@@ -223,8 +223,12 @@
 //
 /////////////////////////////////////////////////////
 
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
+#include <memory>
+#include <iosfwd>
+#include <map>
 #include <mutex>
 #include <string>
 #include <unordered_map>
@@ -283,9 +287,9 @@
   ::kudu::GaugePrototype<double> METRIC_##name(                      \
       ::kudu::MetricPrototype::CtorArgs(#entity, #name, label, unit, desc, ## __VA_ARGS__))
 
-#define METRIC_DEFINE_histogram(entity, name, label, unit, desc, max_val, num_sig_digits) \
+#define METRIC_DEFINE_histogram(entity, name, label, unit, desc, max_val, num_sig_digits, ...) \
   ::kudu::HistogramPrototype METRIC_##name(                                       \
-      ::kudu::MetricPrototype::CtorArgs(#entity, #name, label, unit, desc), \
+      ::kudu::MetricPrototype::CtorArgs(#entity, #name, label, unit, desc, ## __VA_ARGS__), \
     max_val, num_sig_digits)
 
 // The following macros act as forward declarations for entity types and metric prototypes.
@@ -407,7 +411,8 @@ class MetricType {
 struct MetricJsonOptions {
   MetricJsonOptions() :
     include_raw_histograms(false),
-    include_schema_info(false) {
+    include_schema_info(false),
+    only_modified_in_or_after_epoch(0) {
   }
 
   // Include the raw histogram values and counts in the JSON output.
@@ -420,6 +425,17 @@ struct MetricJsonOptions {
   // unit, etc).
   // Default: false
   bool include_schema_info;
+
+  // The types of the entities to output. An empty list matches every type.
+  // Default: empty
+  std::vector<std::string> entity_types;
+
+  // Only output the metrics modified in or after this epoch (see
+  // Metric::IncrementEpoch()), and skip the entities which have none of them.
+  // Metrics whose modifications aren't tracked, such as FunctionGauges, are
+  // always output. 0 outputs every metric.
+  // Default: 0
+  int64_t only_modified_in_or_after_epoch;
 };
 
 class MetricEntityPrototype {
@@ -476,6 +492,15 @@ class MetricEntity : public RefCountedThreadSafe<MetricEntity> {
                      const std::vector<std::string>& requested_metrics,
                      const MetricJsonOptions& opts) const;
 
+  // Returns the labels which identify this entity in the Prometheus text
+  // format, without the enclosing braces: its type, its ID and its attributes.
+  // The labels are rebuilt whenever the attributes change, rather than for
+  // every metric of every scrape.
+  std::shared_ptr<const std::string> prometheus_labels() const {
+    std::lock_guard<simple_spinlock> l(lock_);
+    return prometheus_labels_;
+  }
+
   const MetricMap& UnsafeMetricsMapForTests() const { return metric_map_; }
 
   // Mark that the given metric should never be retired until the metric
@@ -518,6 +543,9 @@ class MetricEntity : public RefCountedThreadSafe<MetricEntity> {
   friend class MetricRegistry;
   friend class RefCountedThreadSafe<MetricEntity>;
 
+  // The metrics of an entity to output, ordered by name.
+  typedef std::map<const char*, scoped_refptr<Metric>> OrderedMetricMap;
+
   MetricEntity(const MetricEntityPrototype* prototype, std::string id,
                AttributeMap attributes);
   ~MetricEntity();
@@ -527,6 +555,18 @@ class MetricEntity : public RefCountedThreadSafe<MetricEntity> {
   // type defined within the metric prototype.
   void CheckInstantiation(const MetricPrototype* proto) const;
 
+  // Collects the metrics of this entity which match 'requested_metrics' and
+  // 'opts' into 'metrics', and the attributes of the entity into 'attrs' if
+  // not null. Returns false if the entity shouldn't be output at all.
+  bool CollectMetrics(const std::vector<std::string>& requested_metrics,
+                      const MetricJsonOptions& opts,
+                      OrderedMetricMap* metrics,
+                      AttributeMap* attrs) const;
+
+  // Rebuilds 'prometheus_labels_' from the attributes. Must be called with
+  // 'lock_' held.
+  void UpdatePrometheusLabelsUnlocked();
+
   const MetricEntityPrototype* const prototype_;
   const std::string id_;
 
@@ -538,6 +578,9 @@ class MetricEntity : public RefCountedThreadSafe<MetricEntity> {
   // The key/value attributes. Protected by lock_.
   AttributeMap attributes_;
 
+  // The Prometheus labels built from the attributes. Protected by lock_.
+  std::shared_ptr<const std::string> prometheus_labels_;
+
   // The set of metrics which should never be retired. Protected by lock_.
   std::vector<scoped_refptr<Metric> > never_retire_metrics_;
 
@@ -553,12 +596,46 @@ class Metric : public RefCountedThreadSafe<Metric> {
   virtual Status WriteAsJson(JsonWriter* writer,
                              const MetricJsonOptions& opts) const = 0;
 
+  // Writes the samples of this metric in the Prometheus text format, named
+  // 'name' and labeled with 'labels'. The '# HELP' and '# TYPE' lines are
+  // written by the registry. Metrics without a numeric value write nothing.
+  virtual void WriteAsPrometheus(std::ostream* out,
+                                 const std::string& name,
+                                 const std::string& labels) const = 0;
+
   const MetricPrototype* prototype() const { return prototype_; }
 
+  // Returns whether this metric was modified in or after 'epoch'.
+  virtual bool ModifiedInOrAfterEpoch(int64_t epoch) const {
+    return m_epoch_.load(std::memory_order_relaxed) >= epoch;
+  }
+
+  // Starts a new modification epoch, and returns it. The metrics modified
+  // from now on report having been modified in it, so that a client which
+  // polls the metrics can ask for those modified since its last poll only.
+  static int64_t IncrementEpoch() {
+    return current_epoch_.fetch_add(1, std::memory_order_relaxed) + 1;
+  }
+
+  // Returns the current modification epoch.
+  static int64_t current_epoch() {
+    return current_epoch_.load(std::memory_order_relaxed);
+  }
+
  protected:
   explicit Metric(const MetricPrototype* prototype);
   virtual ~Metric();
 
+  // Records that the metric was modified in the current epoch. This is
+  // called on every update, so it only writes when the epoch has changed,
+  // to not bounce the cache line of a hot metric between the CPUs.
+  void UpdateModificationEpoch() {
+    int64_t current = current_epoch_.load(std::memory_order_relaxed);
+    if (PREDICT_FALSE(m_epoch_.load(std::memory_order_relaxed) < current)) {
+      m_epoch_.store(current, std::memory_order_relaxed);
+    }
+  }
+
   const MetricPrototype* const prototype_;
 
  private:
@@ -570,6 +647,11 @@ class Metric : public RefCountedThreadSafe<Metric> {
   // uninitialized.
   MonoTime retire_time_;
 
+  // The epoch in which the metric was last modified.
+  std::atomic<int64_t> m_epoch_;
+
+  static std::atomic<int64_t> current_epoch_;
+
   DISALLOW_COPY_AND_ASSIGN(Metric);
 };
 
@@ -599,6 +681,16 @@ class MetricRegistry {
                      const std::vector<std::string>& requested_metrics,
                      const MetricJsonOptions& opts) const;
 
+  // Writes the metrics in this registry to 'out' in the Prometheus text
+  // format, selected the same way as by WriteAsJson().
+  //
+  // Each metric is named 'kudu_<entity type>_<metric name>' and labeled with
+  // the type, ID and attributes of its entity. Histograms are written as
+  // summaries. String gauges are skipped.
+  void WriteAsPrometheus(std::ostream* out,
+                         const std::vector<std::string>& requested_metrics,
+                         const MetricJsonOptions& opts) const;
+
   // For each registered entity, retires orphaned metrics. If an entity has no more
   // metrics and there are no external references, entities are removed as well.
   //
@@ -663,7 +755,14 @@ class MetricPrototypeRegistry {
 enum PrototypeFlags {
   // Flag which causes a Gauge prototype to expose itself as if it
   // were a counter.
-  EXPOSE_AS_COUNTER = 1 << 0
+  EXPOSE_AS_COUNTER = 1 << 0,
+
+  // Flag which causes a Histogram to record into a separate HdrHistogram for
+  // each CPU, merging them only when the histogram is read. This avoids
+  // contending on the same cache lines from every thread, at the cost of
+  // memory for each CPU which records into the histogram, so it should be
+  // reserved for server-wide histograms recorded on hot paths.
+  PER_CPU = 1 << 1
 };
 
 class MetricPrototype {
@@ -698,6 +797,7 @@ class MetricPrototype {
   const char* label() const { return args_.label_; }
   MetricUnit::Type unit() const { return args_.unit_; }
   const char* description() const { return args_.description_; }
+  uint32_t flags() const { return args_.flags_; }
   virtual MetricType::Type type() const = 0;
 
   // Writes the fields of this prototype to the given JSON writer.
@@ -758,8 +858,13 @@ class Gauge : public Metric {
   virtual ~Gauge() {}
   virtual Status WriteAsJson(JsonWriter* w,
                              const MetricJsonOptions& opts) const OVERRIDE;
+  virtual void WriteAsPrometheus(std::ostream* out,
+                                 const std::string& name,
+                                 const std::string& labels) const OVERRIDE;
  protected:
   virtual void WriteValue(JsonWriter* writer) const = 0;
+  // Writes the value of the gauge. Returns false if it isn't numeric.
+  virtual bool WritePrometheusValue(std::ostream* out) const = 0;
  private:
   DISALLOW_COPY_AND_ASSIGN(Gauge);
 };
@@ -773,6 +878,9 @@ class StringGauge : public Gauge {
   void set_value(const std::string& value);
  protected:
   virtual void WriteValue(JsonWriter* writer) const OVERRIDE;
+  virtual bool WritePrometheusValue(std::ostream* /*out*/) const OVERRIDE {
+    return false;
+  }
  private:
   std::string value_;
   mutable simple_spinlock lock_;  // Guards value_
@@ -791,12 +899,15 @@ class AtomicGauge : public Gauge {
     return static_cast<T>(value_.Load(kMemOrderRelease));
   }
   virtual void set_value(const T& value) {
+    UpdateModificationEpoch();
     value_.Store(static_cast<int64_t>(value), kMemOrderNoBarrier);
   }
   void Increment() {
+    UpdateModificationEpoch();
     value_.IncrementBy(1, kMemOrderNoBarrier);
   }
   virtual void IncrementBy(int64_t amount) {
+    UpdateModificationEpoch();
     value_.IncrementBy(amount, kMemOrderNoBarrier);
   }
   void Decrement() {
@@ -810,6 +921,10 @@ class AtomicGauge : public Gauge {
   virtual void WriteValue(JsonWriter* writer) const OVERRIDE {
     writer->Value(value());
   }
+  virtual bool WritePrometheusValue(std::ostream* out) const OVERRIDE {
+    *out << value();
+    return true;
+  }
   AtomicInt<int64_t> value_;
  private:
   DISALLOW_COPY_AND_ASSIGN(AtomicGauge);
@@ -885,6 +1000,11 @@ class FunctionGauge : public Gauge {
     writer->Value(value());
   }
 
+  // The modifications of the value returned by the function aren't tracked.
+  virtual bool ModifiedInOrAfterEpoch(int64_t /*epoch*/) const OVERRIDE {
+    return true;
+  }
+
   // Reset this FunctionGauge to return a specific value.
   // This should be used during destruction. If you want a settable
   // Gauge, use a normal Gauge instead of a FunctionGauge.
@@ -931,6 +1051,11 @@ class FunctionGauge : public Gauge {
     return v;
   }
 
+  virtual bool WritePrometheusValue(std::ostream* out) const OVERRIDE {
+    *out << value();
+    return true;
+  }
+
   mutable simple_spinlock lock_;
   Callback<T()> function_;
   DISALLOW_COPY_AND_ASSIGN(FunctionGauge);
@@ -963,6 +1088,9 @@ class Counter : public Metric {
   void IncrementBy(int64_t amount);
   virtual Status WriteAsJson(JsonWriter* w,
                              const MetricJsonOptions& opts) const OVERRIDE;
+  virtual void WriteAsPrometheus(std::ostream* out,
+                                 const std::string& name,
+                                 const std::string& labels) const OVERRIDE;
 
  private:
   FRIEND_TEST(MetricsTest, SimpleCounterTest);
@@ -1005,9 +1133,17 @@ class Histogram : public Metric {
   // or IncrementBy()).
   uint64_t TotalCount() const;
 
+  // Return the sum of the values added to the histogram.
+  uint64_t TotalSum() const;
+
   virtual Status WriteAsJson(JsonWriter* w,
                              const MetricJsonOptions& opts) const OVERRIDE;
 
+  // Writes the histogram as a Prometheus summary.
+  virtual void WriteAsPrometheus(std::ostream* out,
+                                 const std::string& name,
+                                 const std::string& labels) const OVERRIDE;
+
   // Returns a snapshot of this histogram including the bucketed values and counts.
   Status GetHistogramSnapshotPB(HistogramSnapshotPB* snapshot,
                                 const MetricJsonOptions& opts) const;
@@ -1017,14 +1153,35 @@ class Histogram : public Metric {
   uint64_t MaxValueForTests() const;
   double MeanValueForTests() const;
 
-  const HdrHistogram* histogram_for_tests() const { return histogram_.get(); }
+  // Returns a snapshot of the recorded values, merged across CPUs.
+  std::unique_ptr<HdrHistogram> histogram_for_tests() const { return Snapshot(); }
 
  private:
   FRIEND_TEST(MetricsTest, SimpleHistogramTest);
   friend class MetricEntity;
+
+  // The HdrHistogram of one CPU, padded so that the hot fields of
+  // different CPUs' histograms don't share a cache line.
+  struct Shard;
+
   explicit Histogram(const HistogramPrototype* proto);
+  ~Histogram();
+
+  // Returns the HdrHistogram to record values into: that of the current CPU
+  // if the histogram is sharded, allocated on first use.
+  HdrHistogram* histogram_for_write();
+
+  // Returns a (non-consistent) snapshot of the values recorded in all of
+  // the shards.
+  std::unique_ptr<HdrHistogram> Snapshot() const;
 
   const gscoped_ptr<HdrHistogram> histogram_;
+
+  // If the prototype has the PER_CPU flag, one lazily allocated shard per CPU,
+  // which values are recorded into instead of 'histogram_'. Otherwise, 0.
+  const int num_shards_;
+  const std::unique_ptr<std::atomic<Shard*>[]> shards_;
+
   DISALLOW_COPY_AND_ASSIGN(Histogram);
 };
 
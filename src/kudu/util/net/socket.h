@@ -73,6 +73,11 @@ class Socket {
   // Set or clear TCP_CORK
   Status SetTcpCork(bool enabled);
 
+  // Set SO_BUSY_POLL to 'usec': the number of microseconds the kernel may
+  // busy-poll the device queue for packets when the socket is read or
+  // polled with no data ready. Only supported on Linux.
+  Status SetBusyPoll(int usec);
+
   // Set or clear O_NONBLOCK
   Status SetNonBlocking(bool enabled);
   Status IsNonBlocking(bool* is_nonblock) const;
@@ -86,6 +91,11 @@ class Socket {
   // Sets SO_REUSEADDR to 'flag'. Should be used prior to Bind().
   Status SetReuseAddr(bool flag);
 
+  // Sets SO_REUSEPORT to 'flag', allowing several sockets to listen on the
+  // same address, which the kernel then balances new connections across.
+  // Should be used prior to Bind(), on every socket bound to the address.
+  Status SetReusePort(bool flag);
+
   // Convenience method to invoke the common sequence:
   // 1) SetReuseAddr(true)
   // 2) Bind()
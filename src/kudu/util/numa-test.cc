@@ -0,0 +1,60 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/util/numa.h"
+
+#include <vector>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include "kudu/util/status.h"
+#include "kudu/util/test_macros.h"
+
+using std::vector;
+
+namespace kudu {
+
+TEST(NumaTest, TestParseCpuList) {
+  vector<int> ids;
+  ASSERT_OK(ParseCpuList("0\n", &ids));
+  ASSERT_EQ(vector<int>({ 0 }), ids);
+  ASSERT_OK(ParseCpuList("0-3,8,10-11\n", &ids));
+  ASSERT_EQ(vector<int>({ 0, 1, 2, 3, 8, 10, 11 }), ids);
+  ASSERT_OK(ParseCpuList("\n", &ids));
+  ASSERT_TRUE(ids.empty());
+
+  ASSERT_TRUE(ParseCpuList("3-1", &ids).IsInvalidArgument());
+  ASSERT_TRUE(ParseCpuList("0-1-2", &ids).IsInvalidArgument());
+  ASSERT_TRUE(ParseCpuList("a", &ids).IsInvalidArgument());
+}
+
+#if defined(__linux__)
+TEST(NumaTest, TestBindToNode) {
+  ASSERT_GE(NumNumaNodes(), 1);
+  vector<int> cpus;
+  Status s = GetNumaNodeCpus(0, &cpus);
+  if (!s.ok()) {
+    LOG(INFO) << "Skipping test, NUMA topology not available: " << s.ToString();
+    return;
+  }
+  ASSERT_FALSE(cpus.empty());
+  ASSERT_OK(BindCurrentThreadToNumaNode(0));
+}
+#endif
+
+} // namespace kudu
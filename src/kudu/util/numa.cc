@@ -0,0 +1,141 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/util/numa.h"
+
+#if defined(__linux__)
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+
+#include <glog/logging.h>
+
+#include "kudu/gutil/strings/numbers.h"
+#include "kudu/gutil/strings/split.h"
+#include "kudu/gutil/strings/strip.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/env.h"
+#include "kudu/util/errno.h"
+#include "kudu/util/faststring.h"
+
+using std::string;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+
+namespace {
+
+// From <numaif.h>, which is part of libnuma.
+const int kMpolPreferred = 1;
+
+Status ReadSysfsList(const string& path, vector<int>* ids) {
+  faststring buf;
+  RETURN_NOT_OK(ReadFileToString(Env::Default(), path, &buf));
+  return ParseCpuList(buf.ToString(), ids);
+}
+
+} // anonymous namespace
+
+Status ParseCpuList(const string& list, vector<int>* ids) {
+  string trimmed = list;
+  StripWhiteSpace(&trimmed);
+  vector<int> result;
+  vector<string> ranges = strings::Split(trimmed, ",", strings::SkipEmpty());
+  for (const string& range : ranges) {
+    vector<string> bounds = strings::Split(range, "-");
+    int32_t first;
+    int32_t last;
+    if (bounds.size() > 2 ||
+        !safe_strto32(bounds[0], &first) ||
+        !safe_strto32(bounds.back(), &last) ||
+        first < 0 || last < first) {
+      return Status::InvalidArgument("invalid CPU list", list);
+    }
+    for (int id = first; id <= last; id++) {
+      result.push_back(id);
+    }
+  }
+  *ids = std::move(result);
+  return Status::OK();
+}
+
+int NumNumaNodes() {
+  static const int num_nodes = []() {
+    vector<int> nodes;
+    Status s = ReadSysfsList("/sys/devices/system/node/online", &nodes);
+    if (!s.ok() || nodes.empty()) {
+      VLOG(1) << "Unable to read the NUMA topology, assuming a single node: "
+              << s.ToString();
+      return 1;
+    }
+    return *std::max_element(nodes.begin(), nodes.end()) + 1;
+  }();
+  return num_nodes;
+}
+
+Status GetNumaNodeCpus(int node, vector<int>* cpus) {
+  return ReadSysfsList(Substitute("/sys/devices/system/node/node$0/cpulist", node), cpus);
+}
+
+Status BindCurrentThreadToNumaNode(int node) {
+#if defined(__linux__)
+  vector<int> cpus;
+  RETURN_NOT_OK(GetNumaNodeCpus(node, &cpus));
+  if (cpus.empty()) {
+    return Status::InvalidArgument(Substitute("NUMA node $0 has no CPUs", node));
+  }
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for (int cpu : cpus) {
+    if (cpu < CPU_SETSIZE) {
+      CPU_SET(cpu, &cpu_set);
+    }
+  }
+  if (sched_setaffinity(0, sizeof(cpu_set), &cpu_set) != 0) {
+    int err = errno;
+    return Status::IOError(Substitute("unable to bind thread to the CPUs of NUMA node $0",
+                                      node), ErrnoToString(err), err);
+  }
+
+  // Prefer rather than bind the node's memory, so that allocations spill over
+  // to the other nodes rather than failing once it's full.
+  unsigned long node_mask = 0;
+  if (node >= static_cast<int>(sizeof(node_mask) * CHAR_BIT)) {
+    return Status::NotSupported(Substitute("NUMA node $0 is out of range", node));
+  }
+  node_mask |= 1UL << node;
+  // The kernel ignores the last bit of 'maxnode'.
+  if (syscall(SYS_set_mempolicy, kMpolPreferred, &node_mask,
+              sizeof(node_mask) * CHAR_BIT + 1) != 0) {
+    int err = errno;
+    return Status::IOError(Substitute("unable to set the memory policy to NUMA node $0",
+                                      node), ErrnoToString(err), err);
+  }
+  return Status::OK();
+#else
+  return Status::NotSupported("NUMA placement is only supported on Linux");
+#endif
+}
+
+} // namespace kudu
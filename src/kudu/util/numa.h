@@ -0,0 +1,46 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// Utilities to place threads and their memory on the NUMA nodes of the
+// machine. The topology is read from sysfs, so they don't depend on libnuma.
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+// Parses a list of CPU or node ids in the format used by the kernel in sysfs,
+// e.g. "0-3,8,10-11", into 'ids'.
+Status ParseCpuList(const std::string& list, std::vector<int>* ids);
+
+// Returns the number of NUMA nodes of this machine, or 1 if it has a single
+// node or its topology can't be read. The topology is read once.
+int NumNumaNodes();
+
+// Returns in 'cpus' the CPUs of NUMA node 'node'.
+Status GetNumaNodeCpus(int node, std::vector<int>* cpus);
+
+// Restricts the calling thread to the CPUs of NUMA node 'node', and makes it
+// allocate its memory from that node whenever the node has free memory.
+//
+// Returns NotSupported on platforms other than Linux.
+Status BindCurrentThreadToNumaNode(int node);
+
+} // namespace kudu
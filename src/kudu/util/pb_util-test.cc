@@ -455,6 +455,44 @@ TEST_P(TestPBContainerVersions, TestMultipleMessages) {
   ASSERT_OK(pb_reader.Close());
 }
 
+TEST_P(TestPBContainerVersions, TestAppendBatch) {
+  ProtoContainerTestPB pb;
+  pb.set_name("foo");
+  pb.set_note("bar");
+
+  unique_ptr<WritablePBContainerFile> pb_writer;
+  ASSERT_OK(NewPBCWriter(version_, RWFileOptions(), &pb_writer));
+  ASSERT_OK(pb_writer->CreateNew(pb));
+
+  // Interleave single appends with batches of various sizes.
+  vector<ProtoContainerTestPB> batch(5, pb);
+  vector<const google::protobuf::Message*> msgs;
+  int next_value = 0;
+  for (int batch_size = 0; batch_size <= batch.size(); batch_size++) {
+    msgs.clear();
+    for (int i = 0; i < batch_size; i++) {
+      batch[i].set_value(next_value++);
+      msgs.push_back(&batch[i]);
+    }
+    ASSERT_OK(pb_writer->AppendBatch(msgs));
+    pb.set_value(next_value++);
+    ASSERT_OK(pb_writer->Append(pb));
+  }
+  ASSERT_OK(pb_writer->Close());
+
+  unique_ptr<RandomAccessFile> reader;
+  ASSERT_OK(env_->NewRandomAccessFile(path_, &reader));
+  ReadablePBContainerFile pb_reader(std::move(reader));
+  ASSERT_OK(pb_reader.Open());
+  for (int i = 0; i < next_value; i++) {
+    ProtoContainerTestPB read_pb;
+    ASSERT_OK(pb_reader.ReadNextPB(&read_pb));
+    ASSERT_EQ(i, read_pb.value());
+  }
+  ASSERT_TRUE(pb_reader.ReadNextPB(nullptr).IsEndOfFile());
+  ASSERT_OK(pb_reader.Close());
+}
+
 TEST_P(TestPBContainerVersions, TestInterleavedReadWrite) {
   ProtoContainerTestPB pb;
   pb.set_name("foo");
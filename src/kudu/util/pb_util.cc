@@ -702,6 +702,19 @@ Status WritablePBContainerFile::Append(const Message& msg) {
   return Status::OK();
 }
 
+Status WritablePBContainerFile::AppendBatch(const vector<const Message*>& msgs) {
+  DCHECK_EQ(FileState::OPEN, state_);
+
+  faststring buf;
+  for (const auto* msg : msgs) {
+    RETURN_NOT_OK_PREPEND(AppendMsgToBuffer(*msg, &buf),
+                          "Failed to prepare buffer for writing");
+  }
+  RETURN_NOT_OK_PREPEND(AppendBytes(buf), "Failed to append data to file");
+
+  return Status::OK();
+}
+
 Status WritablePBContainerFile::Flush() {
   DCHECK_EQ(FileState::OPEN, state_);
 
@@ -954,6 +967,11 @@ uint64_t ReadablePBContainerFile::offset() const {
   return offset_;
 }
 
+void ReadablePBContainerFile::Seek(uint64_t offset) {
+  DCHECK_EQ(FileState::OPEN, state_);
+  offset_ = offset;
+}
+
 Status ReadPBContainerFromPath(Env* env, const std::string& path, Message* msg) {
   unique_ptr<RandomAccessFile> file;
   RETURN_NOT_OK(env->NewRandomAccessFile(path, &file));
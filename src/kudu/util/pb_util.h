@@ -25,6 +25,7 @@
 #include <iosfwd>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <boost/optional/optional.hpp>
 #include <google/protobuf/message.h>
@@ -302,6 +303,10 @@ class WritablePBContainerFile {
   // must be called prior to calling Append(), i.e. the file must be open.
   Status Append(const google::protobuf::Message& msg);
 
+  // Like Append(), but writes all of 'msgs' with a single write to the
+  // underlying file.
+  Status AppendBatch(const std::vector<const google::protobuf::Message*>& msgs);
+
   // Asynchronously flushes all dirty container data to the filesystem.
   // The file must be open.
   Status Flush();
@@ -432,6 +437,12 @@ class ReadablePBContainerFile {
   // File must be open.
   uint64_t offset() const;
 
+  // Moves the read offset to 'offset', which should be the beginning of a
+  // record, e.g. a value previously returned by offset(). Reading from any
+  // other offset will most likely fail with Status::Corruption.
+  // File must be open.
+  void Seek(uint64_t offset);
+
  private:
   FileState state_;
   int version_;
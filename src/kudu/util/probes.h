@@ -0,0 +1,53 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// Statically-defined tracepoints (USDT probes) on the hot paths of the
+// servers.
+//
+// A probe compiles down to a single nop plus a note in the ELF binary
+// describing where its arguments live, so it costs next to nothing unless a
+// tracer such as SystemTap or bpftrace attaches to it. Unlike probes on
+// function names, the probes are stable across releases and survive
+// inlining. All of them belong to the 'kudu' provider, e.g.:
+//
+//   bpftrace -e 'usdt:/path/to/kudu-tserver:kudu:log_sync_done
+//                { @sync_us = hist(arg1); }'
+//
+// See README.systemtap in src/kudu/tools for the list of probes and their
+// arguments.
+//
+// Probe arguments must be integers or pointers, and should be cheap to
+// compute, since they're evaluated whether or not a tracer is attached.
+//
+// On platforms without <sys/sdt.h> the probes compile to nothing.
+#ifndef KUDU_UTIL_PROBES_H
+#define KUDU_UTIL_PROBES_H
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define KUDU_HAVE_USDT_PROBES 1
+#endif
+#endif
+
+#ifdef KUDU_HAVE_USDT_PROBES
+#define KUDU_PROBE(name, ...) STAP_PROBEV(kudu, name, ##__VA_ARGS__)
+#else
+#define KUDU_PROBE(name, ...) do {} while (0)
+#endif
+
+#endif // KUDU_UTIL_PROBES_H
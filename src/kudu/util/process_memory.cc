@@ -33,6 +33,7 @@
 #include "kudu/util/debug/trace_event.h"  // IWYU pragma: keep
 #include "kudu/util/env.h"
 #include "kudu/util/flag_tags.h"
+#include "kudu/util/hugepage_allocator.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/mem_tracker.h"        // IWYU pragma: keep
 #include "kudu/util/process_memory.h"
@@ -202,7 +203,10 @@ int64_t CurrentConsumption() {
   static Atomic64 consumption = 0;
   uint64_t time = GetMonoTimeMicros();
   if (time > last_read_time + kReadIntervalMicros && read_lock.try_lock()) {
-    base::subtle::NoBarrier_Store(&consumption, GetTCMallocCurrentAllocatedBytes());
+    // The huge page slabs are mapped outside of tcmalloc.
+    base::subtle::NoBarrier_Store(&consumption,
+                                  GetTCMallocCurrentAllocatedBytes() +
+                                  HugePageSlabAllocator::Get()->committed_bytes());
     // Re-fetch the time after getting the consumption. This way, in case fetching
     // consumption is extremely slow for some reason (eg due to lots of contention
     // in tcmalloc) we at least ensure that we wait at least another full interval
@@ -17,6 +17,8 @@
 #ifndef IMPALA_RLE_ENCODING_H
 #define IMPALA_RLE_ENCODING_H
 
+#include <algorithm>
+
 #include <glog/logging.h>
 
 #include "kudu/gutil/port.h"
@@ -102,6 +104,12 @@ class RleDecoder {
   // Gets the next value.  Returns false if there are no more.
   bool Get(T* val);
 
+  // Gets the next 'num_values' values into 'values', filling repeated runs
+  // in bulk and unpacking literal runs with BitReader::GetBatch(). Returns
+  // the number of values read, which is less than 'num_values' only if the
+  // data ran out.
+  size_t GetBatch(T* values, size_t num_values);
+
   // Seek to the previous value.
   void RewindOne();
 
@@ -271,6 +279,30 @@ inline bool RleDecoder<T>::Get(T* val) {
   return true;
 }
 
+template<typename T>
+inline size_t RleDecoder<T>::GetBatch(T* values, size_t num_values) {
+  DCHECK(bit_reader_.is_initialized());
+  size_t num_read = 0;
+  while (num_read < num_values && ReadHeader()) {
+    if (PREDICT_TRUE(repeat_count_ > 0)) {
+      size_t n = std::min<size_t>(repeat_count_, num_values - num_read);
+      std::fill_n(values + num_read, n, static_cast<T>(current_value_));
+      repeat_count_ -= n;
+      num_read += n;
+    } else {
+      DCHECK(literal_count_ > 0);
+      int n = std::min<size_t>(literal_count_, num_values - num_read);
+      int result = bit_reader_.GetBatch(bit_width_, values + num_read, n);
+      DCHECK_EQ(n, result);
+      literal_count_ -= n;
+      num_read += n;
+    }
+  }
+  // Rewinding doesn't know how a batch was split between runs.
+  rewind_state_ = CANT_REWIND;
+  return num_read;
+}
+
 template<typename T>
 inline void RleDecoder<T>::RewindOne() {
   DCHECK(bit_reader_.is_initialized());
@@ -19,6 +19,7 @@
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <memory>
 #include <ostream>
 #include <string>
 #include <vector>
@@ -37,9 +38,11 @@
 #include "kudu/util/hexdump.h"
 #include "kudu/util/rle-encoding.h"
 #include "kudu/util/slice.h"
+#include "kudu/util/test_macros.h"
 #include "kudu/util/test_util.h"
 
 using std::string;
+using std::unique_ptr;
 using std::vector;
 
 namespace kudu {
@@ -141,6 +144,39 @@ TEST(BitArray, TestValues) {
   }
 }
 
+// Writes 'num_vals' values with width 'bit_width', reads 'skip' of them one
+// at a time and the rest with GetBatch().
+void TestBitArrayGetBatch(int bit_width, int num_vals, int skip) {
+  const uint64_t mod = bit_width == 64? 1 : 1LL << bit_width;
+
+  faststring buffer;
+  BitWriter writer(&buffer);
+  for (int i = 0; i < num_vals; ++i) {
+    writer.PutValue(i * 7919 % mod, bit_width);
+  }
+  writer.Flush();
+
+  BitReader reader(buffer.data(), writer.bytes_written());
+  for (int i = 0; i < skip; ++i) {
+    uint64_t val = 0;
+    ASSERT_TRUE(reader.GetValue(bit_width, &val));
+  }
+  vector<uint64_t> vals(num_vals);
+  ASSERT_EQ(num_vals - skip, reader.GetBatch(bit_width, vals.data(), num_vals - skip));
+  for (int i = skip; i < num_vals; ++i) {
+    ASSERT_EQ(i * 7919 % mod, vals[i - skip]) << "width " << bit_width << " index " << i;
+  }
+}
+
+TEST(BitArray, TestGetBatch) {
+  for (int width = 1; width <= kMaxWidth; ++width) {
+    for (int skip = 0; skip < 9; ++skip) {
+      NO_FATALS(TestBitArrayGetBatch(width, 9, skip));
+      NO_FATALS(TestBitArrayGetBatch(width, 1023, skip));
+    }
+  }
+}
+
 // Test some mixed values
 TEST(BitArray, TestMixed) {
   const int kTestLenBits = 1024;
@@ -487,6 +523,53 @@ TEST_F(TestRle, TestRoundTripRandomSequencesWithRuns) {
     ASSERT_EQ(string_rep, roundtrip_str);
   }
 }
+// Decodes the same RLE data with Get() and with GetBatch() in random-sized
+// batches, and checks that they agree.
+template<typename T>
+void TestRleGetBatch(int bit_width) {
+  const int kNumValues = 10000;
+  const uint64_t mod = bit_width == 64 ? MathLimits<uint64_t>::kMax : (1ULL << bit_width) - 1;
+  faststring buffer;
+  RleEncoder<T> encoder(&buffer, bit_width);
+  int num_values = 0;
+  while (num_values < kNumValues) {
+    // Alternate short literal stretches with longer repeated runs.
+    int run_length = random() % 2 ? 1 : random() % 50;
+    encoder.Put(static_cast<T>(random() & mod), run_length);
+    num_values += run_length;
+  }
+  int encoded_len = encoder.Flush();
+
+  vector<T> expected(num_values);
+  RleDecoder<T> decoder(buffer.data(), encoded_len, bit_width);
+  for (int i = 0; i < num_values; ++i) {
+    T val;
+    ASSERT_TRUE(decoder.Get(&val));
+    expected[i] = val;
+  }
+
+  unique_ptr<T[]> actual(new T[num_values]);
+  RleDecoder<T> batch_decoder(buffer.data(), encoded_len, bit_width);
+  int num_read = 0;
+  while (num_read < num_values) {
+    size_t batch = std::min<size_t>(random() % 200 + 1, num_values - num_read);
+    ASSERT_EQ(batch, batch_decoder.GetBatch(actual.get() + num_read, batch));
+    num_read += batch;
+  }
+  for (int i = 0; i < num_values; ++i) {
+    ASSERT_EQ(expected[i], actual[i]) << "width " << bit_width << " index " << i;
+  }
+}
+
+TEST_F(TestRle, TestGetBatch) {
+  SeedRandom();
+  NO_FATALS(TestRleGetBatch<bool>(1));
+  for (int width = 1; width <= 32; ++width) {
+    NO_FATALS(TestRleGetBatch<uint32_t>(width));
+  }
+  NO_FATALS(TestRleGetBatch<uint64_t>(64));
+}
+
 TEST_F(TestRle, TestSkip) {
   faststring buffer(1);
   RleEncoder<bool> encoder(&buffer, 1);
@@ -0,0 +1,101 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/util/space_saving.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "kudu/util/slice.h"
+
+using std::string;
+using std::vector;
+
+namespace kudu {
+
+TEST(SpaceSavingTest, TestHeavyHitters) {
+  SpaceSaving sketch(10);
+  // Interleave two heavy hitters with many values which occur once.
+  for (int i = 0; i < 5000; i++) {
+    sketch.Add(Slice(std::to_string(i)));
+    if (i % 5 == 0) {
+      sketch.Add("hot", 2);
+    }
+    if (i % 5 == 1) {
+      sketch.Add("warm");
+    }
+  }
+  ASSERT_EQ(5000 + 2000 + 1000, sketch.total());
+
+  vector<SpaceSaving::Entry> top = sketch.TopK(2);
+  ASSERT_EQ(2, top.size());
+  ASSERT_EQ("hot", top[0].value);
+  ASSERT_EQ("warm", top[1].value);
+  // The counts are never underestimated, and overestimated by at most the
+  // error.
+  ASSERT_GE(top[0].count, 2000);
+  ASSERT_LE(top[0].count - top[0].error, 2000);
+  ASSERT_GE(top[1].count, 1000);
+  ASSERT_LE(top[1].count - top[1].error, 1000);
+
+  ASSERT_EQ(10, sketch.TopK(100).size());
+}
+
+TEST(SpaceSavingTest, TestExactWhenUnderCapacity) {
+  SpaceSaving sketch(4);
+  sketch.Add("a", 3);
+  sketch.Add("b");
+  sketch.Add("a");
+  sketch.Add("c", 2);
+  vector<SpaceSaving::Entry> top = sketch.TopK(10);
+  ASSERT_EQ(3, top.size());
+  ASSERT_EQ("a", top[0].value);
+  ASSERT_EQ(4, top[0].count);
+  ASSERT_EQ(0, top[0].error);
+  ASSERT_EQ("c", top[1].value);
+  ASSERT_EQ(2, top[1].count);
+  ASSERT_EQ("b", top[2].value);
+  ASSERT_EQ(1, top[2].count);
+}
+
+TEST(SpaceSavingTest, TestDecay) {
+  SpaceSaving sketch(4);
+  sketch.Add("a", 8);
+  sketch.Add("b");
+  sketch.Decay();
+  ASSERT_EQ(4, sketch.total());
+  vector<SpaceSaving::Entry> top = sketch.TopK(10);
+  // "b" decayed away.
+  ASSERT_EQ(1, top.size());
+  ASSERT_EQ("a", top[0].value);
+  ASSERT_EQ(4, top[0].count);
+
+  // The sketch keeps working after a decay.
+  sketch.Add("b", 5);
+  top = sketch.TopK(10);
+  ASSERT_EQ("b", top[0].value);
+  ASSERT_EQ(5, top[0].count);
+
+  sketch.Clear();
+  ASSERT_EQ(0, sketch.total());
+  ASSERT_TRUE(sketch.TopK(10).empty());
+}
+
+} // namespace kudu
@@ -0,0 +1,91 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/util/space_saving.h"
+
+#include <algorithm>
+#include <utility>
+
+#include <glog/logging.h>
+
+using std::string;
+using std::vector;
+
+namespace kudu {
+
+SpaceSaving::SpaceSaving(int capacity)
+    : capacity_(capacity),
+      total_(0) {
+  CHECK_GT(capacity, 0);
+  entries_.reserve(capacity);
+}
+
+void SpaceSaving::Add(const Slice& value, int64_t count) {
+  DCHECK_GT(count, 0);
+  total_ += count;
+  string key = value.ToString();
+  auto it = index_.find(key);
+  if (it != index_.end()) {
+    entries_[it->second].count += count;
+    return;
+  }
+  if (entries_.size() < capacity_) {
+    index_.emplace(key, entries_.size());
+    entries_.push_back({ std::move(key), count, 0 });
+    return;
+  }
+  // Replace the entry with the smallest count: the new value may have
+  // occurred up to that many times while it wasn't tracked.
+  auto min = std::min_element(entries_.begin(), entries_.end(),
+                              [](const Entry& a, const Entry& b) { return a.count < b.count; });
+  index_.erase(min->value);
+  index_.emplace(key, min - entries_.begin());
+  min->value = std::move(key);
+  min->error = min->count;
+  min->count += count;
+}
+
+void SpaceSaving::Decay() {
+  total_ /= 2;
+  vector<Entry> entries;
+  entries.reserve(capacity_);
+  index_.clear();
+  for (auto& e : entries_) {
+    if (e.count < 2) continue;
+    index_.emplace(e.value, entries.size());
+    entries.push_back({ std::move(e.value), e.count / 2, e.error / 2 });
+  }
+  entries_.swap(entries);
+}
+
+void SpaceSaving::Clear() {
+  total_ = 0;
+  entries_.clear();
+  index_.clear();
+}
+
+vector<SpaceSaving::Entry> SpaceSaving::TopK(int k) const {
+  vector<Entry> top(entries_);
+  std::sort(top.begin(), top.end(),
+            [](const Entry& a, const Entry& b) { return a.count > b.count; });
+  if (top.size() > k) {
+    top.resize(k);
+  }
+  return top;
+}
+
+} // namespace kudu
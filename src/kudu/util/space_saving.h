@@ -0,0 +1,86 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_UTIL_SPACE_SAVING_H
+#define KUDU_UTIL_SPACE_SAVING_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "kudu/util/slice.h"
+
+namespace kudu {
+
+// A Space-Saving sketch, which finds the most frequent values of a stream
+// ("heavy hitters") using a fixed number of counters.
+//
+// Every value which occurs more than total() / capacity times is guaranteed
+// to be tracked. The count of a tracked value may be overestimated, by at
+// most the 'error' of its entry, but is never underestimated.
+//
+// See "Efficient Computation of Frequent and Top-k Elements in Data Streams",
+// Metwally et al., ICDT 2005.
+//
+// This class is not thread-safe.
+class SpaceSaving {
+ public:
+  struct Entry {
+    std::string value;
+    // The estimated number of occurrences of 'value'.
+    int64_t count;
+    // The maximum amount by which 'count' overestimates the occurrences.
+    int64_t error;
+  };
+
+  explicit SpaceSaving(int capacity);
+
+  // Adds 'count' occurrences of 'value'.
+  void Add(const Slice& value, int64_t count = 1);
+
+  // Halves all the counts, so that the sketch favors recent values over old
+  // ones. Entries whose count drops to zero are removed.
+  void Decay();
+
+  // Removes all the entries.
+  void Clear();
+
+  // Returns the 'k' entries with the highest counts, in decreasing order of
+  // count.
+  std::vector<Entry> TopK(int k) const;
+
+  // Returns the total number of occurrences added, net of decay.
+  int64_t total() const {
+    return total_;
+  }
+
+  int capacity() const {
+    return capacity_;
+  }
+
+ private:
+  const int capacity_;
+  int64_t total_;
+
+  // The tracked values, and the index of each in 'entries_'.
+  std::vector<Entry> entries_;
+  std::unordered_map<std::string, int> index_;
+};
+
+} // namespace kudu
+
+#endif // KUDU_UTIL_SPACE_SAVING_H
@@ -0,0 +1,86 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/util/stack_sampler.h"
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <string>
+
+#include <gflags/gflags_declare.h>
+#include <gtest/gtest.h>
+
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/gutil/strings/util.h"
+#include "kudu/util/debug-util.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/scoped_cleanup.h"
+#include "kudu/util/status.h"
+#include "kudu/util/test_macros.h"
+#include "kudu/util/test_util.h"
+#include "kudu/util/thread.h"
+
+DECLARE_int32(stack_sampling_interval_ms);
+
+using std::map;
+using std::string;
+
+namespace kudu {
+
+class StackSamplerTest : public KuduTest {
+};
+
+// Stack sampling relies on procfs and the tgkill syscall.
+#if defined(__linux__)
+
+TEST_F(StackSamplerTest, TestSamplesRunningThreadWithTag) {
+  // Take the samples explicitly rather than from the background thread.
+  FLAGS_stack_sampling_interval_ms = 0;
+
+  std::atomic<bool> done(false);
+  scoped_refptr<Thread> spinner;
+  ASSERT_OK(Thread::Create("test", "spinner", [&]() {
+        ScopedThreadStackTag tag("spin-method");
+        while (!done) {
+        }
+      }, &spinner));
+  auto cleanup = MakeScopedCleanup([&]() {
+      done = true;
+      spinner->Join();
+    });
+
+  StackSampler* sampler = StackSampler::GetInstance();
+  map<string, int64_t> folded;
+  ASSERT_EVENTUALLY([&]() {
+      sampler->SampleOnce();
+      folded.clear();
+      sampler->GetFoldedStacks(MonoDelta::FromSeconds(60), &folded);
+      bool found = false;
+      for (const auto& entry : folded) {
+        if (HasPrefixString(entry.first, "spinner;spin-method;")) {
+          ASSERT_GT(entry.second, 0);
+          found = true;
+        }
+      }
+      ASSERT_TRUE(found);
+    });
+}
+
+#endif // defined(__linux__)
+
+} // namespace kudu
@@ -0,0 +1,217 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/util/stack_sampler.h"
+
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/env.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/status.h"
+#include "kudu/util/thread.h"
+
+DEFINE_int32(stack_sampling_interval_ms, 1000,
+             "Interval at which the stacks of running threads are sampled for "
+             "the continuous profile served at /flamegraph. 0 disables sampling.");
+TAG_FLAG(stack_sampling_interval_ms, advanced);
+TAG_FLAG(stack_sampling_interval_ms, experimental);
+
+DEFINE_int32(stack_sampling_history_mins, 60,
+             "Number of minutes of stack samples to keep for the continuous "
+             "profile served at /flamegraph.");
+TAG_FLAG(stack_sampling_history_mins, advanced);
+TAG_FLAG(stack_sampling_history_mins, experimental);
+
+using std::lock_guard;
+using std::map;
+using std::pair;
+using std::string;
+using std::unordered_map;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+
+namespace {
+
+// The most distinct stacks kept per one-minute bucket. Any further stacks
+// are counted under a single placeholder so that a pathological workload
+// cannot grow the history without bound.
+const size_t kMaxStacksPerBucket = 10000;
+
+// Returns true if the given thread is running or runnable ('R') or in an
+// uninterruptible wait, usually for IO ('D'). Sleeping threads are not
+// sampled: they would dominate the profile and each sample costs a signal.
+bool IsThreadActive(int64_t tid) {
+#if defined(__linux__)
+  faststring buf;
+  if (!ReadFileToString(Env::Default(), Substitute("/proc/self/task/$0/stat", tid),
+                        &buf).ok()) {
+    return false;
+  }
+  // The state follows the parenthesized command name, which may itself
+  // contain spaces and parentheses.
+  string stat = buf.ToString();
+  size_t pos = stat.rfind(')');
+  if (pos == string::npos || pos + 2 >= stat.size()) {
+    return false;
+  }
+  char state = stat[pos + 2];
+  return state == 'R' || state == 'D';
+#else
+  return false;
+#endif
+}
+
+// Frame names are joined with ';' in the folded format.
+string SanitizeFrame(string frame) {
+  std::replace(frame.begin(), frame.end(), ';', ':');
+  return frame;
+}
+
+} // anonymous namespace
+
+size_t StackSampler::SampleKeyHash::operator()(const SampleKey& key) const {
+  std::hash<string> string_hash;
+  size_t h = key.stack.HashCode();
+  h = h * 31 + string_hash(key.thread_name);
+  h = h * 31 + string_hash(key.tag);
+  return h;
+}
+
+StackSampler::StackSampler()
+    : start_time_(MonoTime::Now()),
+      buckets_(std::max(FLAGS_stack_sampling_history_mins, 1)),
+      finish_(1) {
+  if (FLAGS_stack_sampling_interval_ms > 0) {
+    CHECK_OK(Thread::Create("stack-sampler", "stack-sampler",
+                            boost::bind(&StackSampler::RunThread, this),
+                            &thread_));
+  }
+}
+
+StackSampler::~StackSampler() {
+  finish_.CountDown();
+  if (thread_) {
+    CHECK_OK(ThreadJoiner(thread_.get()).Join());
+  }
+}
+
+int64_t StackSampler::MinuteOf(MonoTime time) const {
+  return (time - start_time_).ToSeconds() / 60;
+}
+
+void StackSampler::RunThread() {
+  while (!finish_.WaitFor(MonoDelta::FromMilliseconds(FLAGS_stack_sampling_interval_ms))) {
+    SampleOnce();
+  }
+}
+
+void StackSampler::SampleOnce() {
+  vector<pair<int64_t, string>> threads;
+  ListKuduThreads(&threads);
+
+  // Collect the stacks first: each one waits for the target thread to handle
+  // a signal, and we don't want to hold 'lock_' meanwhile.
+  const int64_t self_tid = Thread::CurrentThreadId();
+  vector<SampleKey> samples;
+  for (auto& thread : threads) {
+    if (thread.first == self_tid || !IsThreadActive(thread.first)) {
+      continue;
+    }
+    SampleKey key;
+    if (!GetThreadStack(thread.first, &key.stack, &key.tag).ok()) {
+      // The thread may have exited or be blocking signals.
+      continue;
+    }
+    key.thread_name = std::move(thread.second);
+    samples.emplace_back(std::move(key));
+  }
+
+  const int64_t minute = MinuteOf(MonoTime::Now());
+  lock_guard<simple_spinlock> l(lock_);
+  Bucket* bucket = &buckets_[minute % buckets_.size()];
+  if (bucket->minute != minute) {
+    bucket->minute = minute;
+    bucket->counts.clear();
+  }
+  for (auto& sample : samples) {
+    auto it = bucket->counts.find(sample);
+    if (it != bucket->counts.end()) {
+      it->second++;
+    } else if (bucket->counts.size() < kMaxStacksPerBucket) {
+      bucket->counts.emplace(std::move(sample), 1);
+    } else {
+      SampleKey overflow;
+      overflow.thread_name = "(too many distinct stacks)";
+      bucket->counts[overflow]++;
+    }
+  }
+}
+
+void StackSampler::GetFoldedStacks(MonoDelta window, map<string, int64_t>* folded) const {
+  const int64_t now_minute = MinuteOf(MonoTime::Now());
+  const int64_t window_mins = (window.ToSeconds() + 59) / 60;
+  const int64_t first_minute = now_minute - std::max<int64_t>(window_mins, 1) + 1;
+
+  unordered_map<SampleKey, int64_t, SampleKeyHash> counts;
+  {
+    lock_guard<simple_spinlock> l(lock_);
+    for (const auto& bucket : buckets_) {
+      if (bucket.minute < first_minute) {
+        continue;
+      }
+      for (const auto& entry : bucket.counts) {
+        counts[entry.first] += entry.second;
+      }
+    }
+  }
+
+  // Symbolization is relatively expensive, and the same frames recur in
+  // most stacks.
+  unordered_map<void*, string> symbols;
+  for (const auto& entry : counts) {
+    const SampleKey& key = entry.first;
+    string stack = SanitizeFrame(key.thread_name);
+    if (!key.tag.empty()) {
+      stack += ";" + SanitizeFrame(key.tag);
+    }
+    for (int i = key.stack.num_frames() - 1; i >= 0; i--) {
+      auto it = symbols.find(key.stack.frame(i));
+      if (it == symbols.end()) {
+        it = symbols.emplace(key.stack.frame(i),
+                             SanitizeFrame(key.stack.SymbolizeFrame(i))).first;
+      }
+      stack += ";" + it->second;
+    }
+    (*folded)[stack] += entry.second;
+  }
+}
+
+} // namespace kudu
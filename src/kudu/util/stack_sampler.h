@@ -0,0 +1,116 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// This class defines a singleton thread which continuously samples the stacks
+// of the process's running kudu::Threads at a low rate, so that intermittent
+// performance problems can be diagnosed after the fact without having to
+// start a profiler while they are happening.
+//
+// Samples are aggregated by thread name (which identifies the thread pool a
+// thread belongs to) and by the thread's stack tag (for example, the RPC method
+// being handled; see ScopedThreadStackTag), and kept in a ring buffer of
+// one-minute buckets.
+#ifndef KUDU_UTIL_STACK_SAMPLER_H
+#define KUDU_UTIL_STACK_SAMPLER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/gutil/singleton.h"
+#include "kudu/util/countdown_latch.h"
+#include "kudu/util/debug-util.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/monotime.h"
+
+namespace kudu {
+
+class Thread;
+
+class StackSampler {
+ public:
+  static StackSampler* GetInstance() {
+    return Singleton<StackSampler>::get();
+  }
+
+  // Aggregates the samples taken during the last 'window', rounded up to
+  // whole minutes, into 'folded' in the "folded stacks" format consumed by
+  // flame graph tools: each key is a semicolon-separated list of frames,
+  // starting with the thread name and (if any) the stack tag followed by the
+  // outermost frame, and each value is the number of samples of that stack.
+  void GetFoldedStacks(MonoDelta window, std::map<std::string, int64_t>* folded) const;
+
+  // Samples the stacks of the currently running threads once.
+  void SampleOnce();
+
+ private:
+  friend class Singleton<StackSampler>;
+
+  struct SampleKey {
+    std::string thread_name;
+    std::string tag;
+    StackTrace stack;
+
+    bool operator==(const SampleKey& other) const {
+      return thread_name == other.thread_name &&
+          tag == other.tag &&
+          stack.Equals(other.stack);
+    }
+  };
+
+  struct SampleKeyHash {
+    size_t operator()(const SampleKey& key) const;
+  };
+
+  // The samples taken during one minute.
+  struct Bucket {
+    // The number of minutes since 'start_time_' at which this bucket started,
+    // or -1 if the bucket is unused.
+    int64_t minute = -1;
+    std::unordered_map<SampleKey, int64_t, SampleKeyHash> counts;
+  };
+
+  StackSampler();
+  ~StackSampler();
+
+  void RunThread();
+
+  // Returns the minute since 'start_time_' that 'time' falls in.
+  int64_t MinuteOf(MonoTime time) const;
+
+  const MonoTime start_time_;
+
+  // Protects 'buckets_'.
+  mutable simple_spinlock lock_;
+
+  // Ring buffer of per-minute buckets, indexed by minute modulo its size.
+  std::vector<Bucket> buckets_;
+
+  CountDownLatch finish_;
+  scoped_refptr<Thread> thread_;
+
+  DISALLOW_COPY_AND_ASSIGN(StackSampler);
+};
+
+} // namespace kudu
+
+#endif // KUDU_UTIL_STACK_SAMPLER_H
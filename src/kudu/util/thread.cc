@@ -50,6 +50,7 @@
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/debug-util.h"
+#include "kudu/util/errno.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/kernel_stack_watchdog.h"
 #include "kudu/util/logging.h"
@@ -68,6 +69,7 @@ using boost::mem_fn;
 using std::endl;
 using std::map;
 using std::ostringstream;
+using std::pair;
 using std::shared_ptr;
 using std::string;
 using std::vector;
@@ -181,6 +183,9 @@ class ThreadMgr {
   // already been removed, this is a no-op.
   void RemoveThread(const pthread_t& pthread_id, const string& category);
 
+  // Appends the system ID and name of each registered thread to 'threads'.
+  void ListThreads(vector<pair<int64_t, string>>* threads);
+
  private:
   // Container class for any details we want to capture about a thread
   // TODO: Add start-time.
@@ -350,6 +355,15 @@ void ThreadMgr::RemoveThread(const pthread_t& pthread_id, const string& category
   ANNOTATE_IGNORE_READS_AND_WRITES_END();
 }
 
+void ThreadMgr::ListThreads(vector<pair<int64_t, string>>* threads) {
+  MutexLock l(lock_);
+  for (const ThreadCategoryMap::value_type& category : thread_categories_) {
+    for (const ThreadCategory::value_type& thread : category.second) {
+      threads->emplace_back(thread.second.thread_id(), thread.second.name());
+    }
+  }
+}
+
 void ThreadMgr::PrintThreadCategoryRows(const ThreadCategory& category,
     ostringstream* output) {
   for (const ThreadCategory::value_type& thread : category) {
@@ -430,6 +444,11 @@ Status StartThreadInstrumentation(const scoped_refptr<MetricEntity>& server_metr
   return thread_manager->StartInstrumentation(server_metrics, web);
 }
 
+void ListKuduThreads(vector<pair<int64_t, string>>* threads) {
+  GoogleOnceInit(&once, &InitThreading);
+  thread_manager->ListThreads(threads);
+}
+
 ThreadJoiner::ThreadJoiner(Thread* thr)
   : thread_(CHECK_NOTNULL(thr)),
     warn_after_ms_(kDefaultWarnAfterMs),
@@ -518,6 +537,22 @@ std::string Thread::ToString() const {
   return Substitute("Thread $0 (name: \"$1\", category: \"$2\")", tid(), name_, category_);
 }
 
+Status Thread::SetCpuAffinity(int cpu) {
+#if defined(__linux__)
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(cpu, &cpus);
+  int err = pthread_setaffinity_np(thread_, sizeof(cpus), &cpus);
+  if (err != 0) {
+    return Status::RuntimeError(Substitute("could not pin $0 to CPU $1", ToString(), cpu),
+                                ErrnoToString(err), err);
+  }
+  return Status::OK();
+#else
+  return Status::NotSupported("setting the CPU affinity of threads is only supported on Linux");
+#endif // defined(__linux__)
+}
+
 int64_t Thread::WaitForTid() const {
   const string log_prefix = Substitute("$0 ($1) ", name_, category_);
   SCOPED_LOG_SLOW_EXECUTION_PREFIX(WARNING, 500 /* ms */, log_prefix,
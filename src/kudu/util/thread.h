@@ -238,6 +238,11 @@ class Thread : public RefCountedThreadSafe<Thread> {
   // Return a string representation of the thread identifying information.
   std::string ToString() const;
 
+  // Pins the thread to run on CPU 'cpu' only.
+  //
+  // Returns NotSupported on platforms other than Linux.
+  Status SetCpuAffinity(int cpu);
+
   // The current thread of execution, or NULL if the current thread isn't a kudu::Thread.
   // This call is signal-safe.
   static Thread* current_thread() { return tls_; }
@@ -382,6 +387,9 @@ class Thread : public RefCountedThreadSafe<Thread> {
 // the given entity. If 'web' is NULL, does not register the path handler.
 Status StartThreadInstrumentation(const scoped_refptr<MetricEntity>& server_metrics,
                                   WebCallbackRegistry* web);
+
+// Appends the system thread ID and name of every running kudu::Thread to 'threads'.
+void ListKuduThreads(std::vector<std::pair<int64_t, std::string>>* threads);
 } // namespace kudu
 
 #endif /* KUDU_UTIL_THREAD_H */
@@ -15,8 +15,10 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <sched.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <atomic>
 #include <cstdint>
 #include <iterator>
@@ -48,6 +50,7 @@
 #include "kudu/util/locks.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/monotime.h"
+#include "kudu/util/numa.h"
 #include "kudu/util/promise.h"
 #include "kudu/util/random.h"
 #include "kudu/util/scoped_cleanup.h"
@@ -138,6 +141,29 @@ TEST_F(ThreadPoolTest, TestSimpleTasks) {
   pool_->Shutdown();
 }
 
+// Test that a pool bound to a NUMA node runs its tasks on the node's CPUs.
+TEST_F(ThreadPoolTest, TestNumaNode) {
+  ASSERT_OK(RebuildPoolWithBuilder(ThreadPoolBuilder(kDefaultPoolName)
+                                   .set_max_threads(2)
+                                   .set_numa_node(0)));
+  Atomic32 counter(0);
+  for (int i = 0; i < 10; i++) {
+    ASSERT_OK(pool_->SubmitClosure(Bind(&SimpleTaskMethod, 1, &counter)));
+  }
+#if defined(__linux__)
+  vector<int> cpus;
+  if (GetNumaNodeCpus(0, &cpus).ok()) {
+    std::atomic<int> task_cpu(-1);
+    ASSERT_OK(pool_->SubmitFunc([&]() { task_cpu = sched_getcpu(); }));
+    pool_->Wait();
+    ASSERT_NE(cpus.end(), std::find(cpus.begin(), cpus.end(), task_cpu.load()));
+  }
+#endif
+  pool_->Wait();
+  ASSERT_EQ(10, base::subtle::NoBarrier_Load(&counter));
+  pool_->Shutdown();
+}
+
 static void IssueTraceStatement() {
   TRACE("hello from task");
 }
@@ -901,4 +927,165 @@ TEST_F(ThreadPoolTest, TestTokenConcurrency) {
                           kSubmitThreads, total_num_tokens_submitted.load());
 }
 
+class WorkStealingThreadPoolTest : public ThreadPoolTest {
+ public:
+  void SetUp() override {
+    ThreadPoolTest::SetUp();
+    ASSERT_OK(RebuildPoolWithBuilder(ThreadPoolBuilder(kDefaultPoolName)
+                                     .set_max_threads(kNumWorkers)
+                                     .set_work_stealing(true)));
+  }
+
+ protected:
+  static const int kNumWorkers = 4;
+};
+
+TEST_F(WorkStealingThreadPoolTest, TestSimpleTasks) {
+  ASSERT_EQ(kNumWorkers, pool_->num_threads());
+
+  Atomic32 counter(0);
+  std::shared_ptr<Runnable> task(new SimpleTask(15, &counter));
+  ASSERT_OK(pool_->SubmitFunc(boost::bind(&SimpleTaskMethod, 10, &counter)));
+  ASSERT_OK(pool_->Submit(task));
+  ASSERT_OK(pool_->SubmitFunc(boost::bind(&SimpleTaskMethod, 20, &counter)));
+  ASSERT_OK(pool_->Submit(task));
+  ASSERT_OK(pool_->SubmitClosure(Bind(&SimpleTaskMethod, 123, &counter)));
+  pool_->Wait();
+  ASSERT_EQ(10 + 15 + 20 + 15 + 123, base::subtle::NoBarrier_Load(&counter));
+  pool_->Shutdown();
+  ASSERT_EQ(0, pool_->num_threads());
+  ASSERT_TRUE(pool_->SubmitFunc([](){}).IsServiceUnavailable());
+}
+
+// The tasks of a token all start out on a single worker's queue, so they
+// can only run concurrently if the other workers steal them.
+TEST_F(WorkStealingThreadPoolTest, TestTasksAreStolen) {
+  alarm(60);
+  SCOPED_CLEANUP({
+      alarm(0); // Disable alarm on test exit.
+  });
+
+  unique_ptr<ThreadPoolToken> t = pool_->NewToken(ThreadPool::ExecutionMode::CONCURRENT);
+  Barrier barrier(kNumWorkers);
+  for (int i = 0; i < kNumWorkers; i++) {
+    ASSERT_OK(t->SubmitFunc([&barrier]() { barrier.Wait(); }));
+  }
+  t->Wait();
+}
+
+TEST_F(WorkStealingThreadPoolTest, TestSerialTokensKeepOrder) {
+  const int kNumTokens = 8;
+  const int kNumSubmissions = 100;
+  vector<unique_ptr<ThreadPoolToken>> tokens;
+  vector<vector<int>> results(kNumTokens);
+  for (int i = 0; i < kNumTokens; i++) {
+    tokens.emplace_back(pool_->NewToken(ThreadPool::ExecutionMode::SERIAL));
+  }
+  for (int i = 0; i < kNumSubmissions; i++) {
+    for (int j = 0; j < kNumTokens; j++) {
+      vector<int>* result = &results[j];
+      ASSERT_OK(tokens[j]->SubmitFunc([result, i]() {
+        if (i % 10 == 0) {
+          SleepFor(MonoDelta::FromMicroseconds(100));
+        }
+        result->push_back(i);
+      }));
+    }
+  }
+  pool_->Wait();
+  for (const auto& result : results) {
+    ASSERT_EQ(kNumSubmissions, result.size());
+    for (int i = 0; i < kNumSubmissions; i++) {
+      ASSERT_EQ(i, result[i]);
+    }
+  }
+}
+
+TEST_F(WorkStealingThreadPoolTest, TestShutdownWithQueuedTasks) {
+  CountDownLatch latch(1);
+  atomic<int> num_run(0);
+  for (int i = 0; i < kNumWorkers * 4; i++) {
+    ASSERT_OK(pool_->SubmitFunc([&]() {
+      latch.Wait();
+      num_run++;
+    }));
+  }
+  // Only the tasks which were running when the pool was shut down run to
+  // completion; the queued ones are dropped.
+  SleepFor(MonoDelta::FromMilliseconds(100));
+  thread unblocker([&]() {
+    SleepFor(MonoDelta::FromMilliseconds(100));
+    latch.CountDown();
+  });
+  pool_->Shutdown();
+  unblocker.join();
+  ASSERT_EQ(kNumWorkers, num_run);
+  ASSERT_TRUE(pool_->SubmitFunc([](){}).IsServiceUnavailable());
+}
+
+TEST_F(WorkStealingThreadPoolTest, TestMaxQueueSize) {
+  ASSERT_OK(RebuildPoolWithBuilder(ThreadPoolBuilder(kDefaultPoolName)
+                                   .set_max_threads(1)
+                                   .set_max_queue_size(1)
+                                   .set_work_stealing(true)));
+  CountDownLatch latch(1);
+  // The first task runs, the second is queued, and the third is rejected.
+  ASSERT_OK(pool_->SubmitClosure(Bind(&CountDownLatch::Wait, Unretained(&latch))));
+  ASSERT_OK(pool_->SubmitClosure(Bind(&CountDownLatch::Wait, Unretained(&latch))));
+  Status s = pool_->SubmitClosure(Bind(&CountDownLatch::Wait, Unretained(&latch)));
+  ASSERT_TRUE(s.IsServiceUnavailable()) << "Expected failure due to queue blowout:" << s.ToString();
+  latch.CountDown();
+  pool_->Wait();
+}
+
+// Measures the throughput of short tasks submitted through many SERIAL
+// tokens, as the apply pool sees under a multi-tablet write load, with
+// either a single shared queue or with work stealing, for increasing
+// numbers of worker threads.
+class ThreadPoolScalingTest : public ThreadPoolTest,
+                              public testing::WithParamInterface<bool> {};
+
+INSTANTIATE_TEST_CASE_P(WorkStealing, ThreadPoolScalingTest, ::testing::Bool());
+
+TEST_P(ThreadPoolScalingTest, TestSubmitScaling) {
+  const bool work_stealing = GetParam();
+  const int kNumTokens = 16;
+  const int kTasksPerToken = AllowSlowTests() ? 100000 : 5000;
+
+  for (int num_threads = 1; num_threads <= base::NumCPUs(); num_threads *= 2) {
+    ASSERT_OK(RebuildPoolWithBuilder(ThreadPoolBuilder(kDefaultPoolName)
+                                     .set_min_threads(num_threads)
+                                     .set_max_threads(num_threads)
+                                     .set_work_stealing(work_stealing)));
+    vector<unique_ptr<ThreadPoolToken>> tokens;
+    for (int i = 0; i < kNumTokens; i++) {
+      tokens.emplace_back(pool_->NewToken(ThreadPool::ExecutionMode::SERIAL));
+    }
+    atomic<int64_t> num_run(0);
+
+    MonoTime start = MonoTime::Now();
+    vector<thread> submitters;
+    for (int i = 0; i < kNumTokens; i++) {
+      ThreadPoolToken* token = tokens[i].get();
+      submitters.emplace_back([&num_run, token, kTasksPerToken]() {
+        for (int j = 0; j < kTasksPerToken; j++) {
+          CHECK_OK(token->SubmitFunc([&num_run]() { num_run++; }));
+        }
+      });
+    }
+    for (auto& t : submitters) {
+      t.join();
+    }
+    pool_->Wait();
+    MonoDelta elapsed = MonoTime::Now() - start;
+
+    ASSERT_EQ(kNumTokens * kTasksPerToken, num_run);
+    LOG(INFO) << Substitute("$0 threads, work stealing $1: $2 tasks/s",
+                            num_threads, work_stealing ? "on" : "off",
+                            static_cast<int64_t>(num_run / elapsed.ToSeconds()));
+    tokens.clear();
+    pool_->Shutdown();
+  }
+}
+
 } // namespace kudu
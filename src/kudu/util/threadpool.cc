@@ -31,10 +31,13 @@
 #include "kudu/gutil/callback.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/map-util.h"
+#include "kudu/gutil/port.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/gutil/sysinfo.h"
 #include "kudu/gutil/walltime.h"
+#include "kudu/util/logging.h"
 #include "kudu/util/metrics.h"
+#include "kudu/util/numa.h"
 #include "kudu/util/thread.h"
 #include "kudu/util/trace.h"
 #include "kudu/util/trace_metrics.h"
@@ -88,7 +91,9 @@ ThreadPoolBuilder::ThreadPoolBuilder(string name)
       min_threads_(0),
       max_threads_(base::NumCPUs()),
       max_queue_size_(std::numeric_limits<int>::max()),
-      idle_timeout_(MonoDelta::FromMilliseconds(500)) {}
+      idle_timeout_(MonoDelta::FromMilliseconds(500)),
+      work_stealing_(false),
+      numa_node_(-1) {}
 
 ThreadPoolBuilder& ThreadPoolBuilder::set_trace_metric_prefix(const string& prefix) {
   trace_metric_prefix_ = prefix;
@@ -122,6 +127,17 @@ ThreadPoolBuilder& ThreadPoolBuilder::set_metrics(ThreadPoolMetrics metrics) {
   return *this;
 }
 
+ThreadPoolBuilder& ThreadPoolBuilder::set_work_stealing(bool work_stealing) {
+  work_stealing_ = work_stealing;
+  return *this;
+}
+
+ThreadPoolBuilder& ThreadPoolBuilder::set_numa_node(int numa_node) {
+  CHECK_GE(numa_node, -1);
+  numa_node_ = numa_node;
+  return *this;
+}
+
 Status ThreadPoolBuilder::Build(gscoped_ptr<ThreadPool>* pool) const {
   pool->reset(new ThreadPool(*this));
   RETURN_NOT_OK((*pool)->Init());
@@ -134,12 +150,15 @@ Status ThreadPoolBuilder::Build(gscoped_ptr<ThreadPool>* pool) const {
 
 ThreadPoolToken::ThreadPoolToken(ThreadPool* pool,
                                  ThreadPool::ExecutionMode mode,
-                                 ThreadPoolMetrics metrics)
+                                 ThreadPoolMetrics metrics,
+                                 int queue_idx)
     : mode_(mode),
       metrics_(std::move(metrics)),
       pool_(pool),
+      queue_idx_(queue_idx),
+      lock_(queue_idx < 0 ? &pool->lock_ : &pool->worker_queues_[queue_idx]->lock),
       state_(State::IDLE),
-      not_running_cond_(&pool->lock_),
+      not_running_cond_(lock_),
       active_threads_(0) {
 }
 
@@ -161,15 +180,19 @@ Status ThreadPoolToken::Submit(shared_ptr<Runnable> r) {
 }
 
 void ThreadPoolToken::Shutdown() {
-  MutexLock unique_lock(pool_->lock_);
-  pool_->CheckNotPoolThreadUnlocked();
+  CheckNotPoolThread();
+  MutexLock unique_lock(*lock_);
 
   // Clear the queue under the lock, but defer the releasing of the tasks
   // outside the lock, in case there are concurrent threads wanting to access
   // the ThreadPool. The task's destructors may acquire locks, etc, so this
   // also prevents lock inversions.
   std::deque<ThreadPool::Task> to_release = std::move(entries_);
-  pool_->total_queued_tasks_ -= to_release.size();
+  if (!pool_->work_stealing_) {
+    pool_->total_queued_tasks_ -= to_release.size();
+  }
+  std::deque<ThreadPoolToken*>* queue = pool_->work_stealing_ ?
+      &pool_->worker_queues_[queue_idx_]->queue : &pool_->queue_;
 
   switch (state()) {
     case State::IDLE:
@@ -186,9 +209,9 @@ void ThreadPoolToken::Shutdown() {
       // Plus doing it this way (rather than switching to QUIESCING and waiting
       // for a worker thread to process the queue entry) helps retain state
       // transition symmetry with ThreadPool::Shutdown.
-      for (auto it = pool_->queue_.begin(); it != pool_->queue_.end();) {
+      for (auto it = queue->begin(); it != queue->end();) {
         if (*it == this) {
-          it = pool_->queue_.erase(it);
+          it = queue->erase(it);
         } else {
           it++;
         }
@@ -213,6 +236,9 @@ void ThreadPoolToken::Shutdown() {
 
   // Finally release the queued tasks, outside the lock.
   unique_lock.Unlock();
+  if (pool_->work_stealing_ && !to_release.empty()) {
+    pool_->ReleaseOutstandingTasks(to_release.size());
+  }
   for (auto& t : to_release) {
     if (t.trace) {
       t.trace->Release();
@@ -221,8 +247,8 @@ void ThreadPoolToken::Shutdown() {
 }
 
 void ThreadPoolToken::Wait() {
-  MutexLock unique_lock(pool_->lock_);
-  pool_->CheckNotPoolThreadUnlocked();
+  CheckNotPoolThread();
+  MutexLock unique_lock(*lock_);
   while (IsActive()) {
     not_running_cond_.Wait();
   }
@@ -233,8 +259,8 @@ bool ThreadPoolToken::WaitUntil(const MonoTime& until) {
 }
 
 bool ThreadPoolToken::WaitFor(const MonoDelta& delta) {
-  MutexLock unique_lock(pool_->lock_);
-  pool_->CheckNotPoolThreadUnlocked();
+  CheckNotPoolThread();
+  MutexLock unique_lock(*lock_);
   while (IsActive()) {
     if (!not_running_cond_.TimedWait(delta)) {
       return false;
@@ -243,6 +269,11 @@ bool ThreadPoolToken::WaitFor(const MonoDelta& delta) {
   return true;
 }
 
+void ThreadPoolToken::CheckNotPoolThread() {
+  MutexLock l(pool_->lock_);
+  pool_->CheckNotPoolThreadUnlocked();
+}
+
 void ThreadPoolToken::Transition(State new_state) {
 #ifndef NDEBUG
   CHECK_NE(state_, new_state);
@@ -312,6 +343,7 @@ ThreadPool::ThreadPool(const ThreadPoolBuilder& builder)
     max_threads_(builder.max_threads_),
     max_queue_size_(builder.max_queue_size_),
     idle_timeout_(builder.idle_timeout_),
+    numa_node_(builder.numa_node_),
     pool_status_(Status::Uninitialized("The pool was not initialized.")),
     idle_cond_(&lock_),
     no_threads_cond_(&lock_),
@@ -320,8 +352,23 @@ ThreadPool::ThreadPool(const ThreadPoolBuilder& builder)
     num_threads_pending_start_(0),
     active_threads_(0),
     total_queued_tasks_(0),
-    tokenless_(NewToken(ExecutionMode::CONCURRENT)),
+    work_stealing_(builder.work_stealing_),
+    num_parked_workers_(0),
+    num_outstanding_tasks_(0),
+    next_queue_idx_(0),
+    shutting_down_(false),
     metrics_(builder.metrics_) {
+  if (work_stealing_) {
+    worker_queues_.resize(max_threads_);
+    for (auto& q : worker_queues_) {
+      q.reset(new WorkerQueue());
+    }
+    for (int i = 0; i < worker_queues_.size(); i++) {
+      worker_queues_[i]->tokenless = DoNewToken(ExecutionMode::CONCURRENT, {}, i);
+    }
+  }
+  tokenless_ = NewToken(ExecutionMode::CONCURRENT);
+
   string prefix = !builder.trace_metric_prefix_.empty() ?
       builder.trace_metric_prefix_ : builder.name_;
 
@@ -334,8 +381,8 @@ ThreadPool::ThreadPool(const ThreadPoolBuilder& builder)
 }
 
 ThreadPool::~ThreadPool() {
-  // There should only be one live token: the one used in tokenless submission.
-  CHECK_EQ(1, tokens_.size()) << Substitute(
+  // The only live tokens should be the ones used in tokenless submission.
+  CHECK_EQ(1 + worker_queues_.size(), tokens_.size()) << Substitute(
       "Threadpool $0 destroyed with $1 allocated tokens",
       name_, tokens_.size());
   Shutdown();
@@ -346,6 +393,23 @@ Status ThreadPool::Init() {
     return Status::NotSupported("The thread pool is already initialized");
   }
   pool_status_ = Status::OK();
+  if (work_stealing_) {
+    num_threads_pending_start_ = max_threads_;
+    for (int i = 0; i < max_threads_; i++) {
+      Status status = kudu::Thread::Create(
+          "thread pool", strings::Substitute("$0 [worker]", name_),
+          &ThreadPool::WorkStealingDispatchThread, this, i, nullptr);
+      if (!status.ok()) {
+        {
+          MutexLock l(lock_);
+          num_threads_pending_start_ -= max_threads_ - i;
+        }
+        Shutdown();
+        return status;
+      }
+    }
+    return Status::OK();
+  }
   num_threads_pending_start_ = min_threads_;
   for (int i = 0; i < min_threads_; i++) {
     Status status = CreateThread();
@@ -366,15 +430,33 @@ void ThreadPool::Shutdown() {
   // concern though because shutting down a pool typically requires clients to
   // be quiesced first, so there's no danger of a client getting confused.
   pool_status_ = Status::ServiceUnavailable("The pool has been shut down.");
+  shutting_down_ = true;
 
   // Clear the various queues under the lock, but defer the releasing
   // of the tasks outside the lock, in case there are concurrent threads
   // wanting to access the ThreadPool. The task's destructors may acquire
   // locks, etc, so this also prevents lock inversions.
+  //
+  // In work-stealing mode, the worker queues must be cleared before the
+  // tokens' tasks are, so that no worker can take a token with no tasks.
+  // Workers don't requeue tokens once 'shutting_down_' is set.
   queue_.clear();
+  for (auto& q : worker_queues_) {
+    MutexLock l(q->lock);
+    q->queue.clear();
+    q->wake_cond.Broadcast();
+  }
   std::deque<std::deque<Task>> to_release;
+  int64_t num_released = 0;
   for (auto* t : tokens_) {
+    // In work-stealing mode, the token's state is protected by the lock of
+    // its worker queue rather than by lock_.
+    std::unique_ptr<MutexLock> token_lock;
+    if (work_stealing_) {
+      token_lock.reset(new MutexLock(*t->lock_));
+    }
     if (!t->entries_.empty()) {
+      num_released += t->entries_.size();
       to_release.emplace_back(std::move(t->entries_));
     }
     switch (t->state()) {
@@ -395,6 +477,10 @@ void ThreadPool::Shutdown() {
         break;
     }
   }
+  if (work_stealing_ && num_released > 0 &&
+      num_outstanding_tasks_.fetch_sub(num_released) == num_released) {
+    idle_cond_.Broadcast();
+  }
 
   // The queues are empty. Wake any sleeping worker threads and wait for all
   // of them to exit. Some worker threads will exit immediately upon waking,
@@ -428,18 +514,34 @@ unique_ptr<ThreadPoolToken> ThreadPool::NewToken(ExecutionMode mode) {
 
 unique_ptr<ThreadPoolToken> ThreadPool::NewTokenWithMetrics(
     ExecutionMode mode, ThreadPoolMetrics metrics) {
+  int queue_idx = -1;
+  if (work_stealing_) {
+    queue_idx = next_queue_idx_++ % worker_queues_.size();
+  }
+  return DoNewToken(mode, std::move(metrics), queue_idx);
+}
+
+unique_ptr<ThreadPoolToken> ThreadPool::DoNewToken(
+    ExecutionMode mode, ThreadPoolMetrics metrics, int queue_idx) {
   MutexLock guard(lock_);
   unique_ptr<ThreadPoolToken> t(new ThreadPoolToken(this,
                                                     mode,
-                                                    std::move(metrics)));
+                                                    std::move(metrics),
+                                                    queue_idx));
   InsertOrDie(&tokens_, t.get());
   return t;
 }
 
 void ThreadPool::ReleaseToken(ThreadPoolToken* t) {
   MutexLock guard(lock_);
-  CHECK(!t->IsActive()) << Substitute("Token with state $0 may not be released",
-                                      ThreadPoolToken::StateToString(t->state()));
+  {
+    std::unique_ptr<MutexLock> token_lock;
+    if (work_stealing_) {
+      token_lock.reset(new MutexLock(*t->lock_));
+    }
+    CHECK(!t->IsActive()) << Substitute("Token with state $0 may not be released",
+                                        ThreadPoolToken::StateToString(t->state()));
+  }
   CHECK_EQ(1, tokens_.erase(t));
 }
 
@@ -452,11 +554,18 @@ Status ThreadPool::SubmitFunc(boost::function<void()> f) {
 }
 
 Status ThreadPool::Submit(shared_ptr<Runnable> r) {
+  if (work_stealing_) {
+    int queue_idx = next_queue_idx_++ % worker_queues_.size();
+    return DoSubmit(std::move(r), worker_queues_[queue_idx]->tokenless.get());
+  }
   return DoSubmit(std::move(r), tokenless_.get());
 }
 
 Status ThreadPool::DoSubmit(shared_ptr<Runnable> r, ThreadPoolToken* token) {
   DCHECK(token);
+  if (work_stealing_) {
+    return DoSubmitWorkStealing(std::move(r), token);
+  }
   MonoTime submit_time = MonoTime::Now();
 
   MutexLock guard(lock_);
@@ -559,10 +668,108 @@ Status ThreadPool::DoSubmit(shared_ptr<Runnable> r, ThreadPoolToken* token) {
   return Status::OK();
 }
 
+Status ThreadPool::DoSubmitWorkStealing(shared_ptr<Runnable> r, ThreadPoolToken* token) {
+  MonoTime submit_time = MonoTime::Now();
+
+  // Size limit check. Queued and running tasks are counted together, so
+  // this admits the same number of tasks as the check in DoSubmit().
+  int64_t length_at_submit = num_outstanding_tasks_++;
+  if (length_at_submit >= static_cast<int64_t>(max_threads_) + max_queue_size_) {
+    ReleaseOutstandingTasks(1);
+    return Status::ServiceUnavailable(
+        Substitute("Thread pool is at capacity ($0/$1 tasks outstanding)",
+                   length_at_submit, static_cast<int64_t>(max_threads_) + max_queue_size_));
+  }
+
+  WorkerQueue* q = worker_queues_[token->queue_idx_].get();
+  bool wake_other = false;
+  {
+    MutexLock guard(q->lock);
+    if (PREDICT_FALSE(shutting_down_ || !token->MaySubmitNewTasks())) {
+      guard.Unlock();
+      ReleaseOutstandingTasks(1);
+      return Status::ServiceUnavailable(shutting_down_ ?
+                                        "The pool has been shut down." :
+                                        "Thread pool token was shut down");
+    }
+
+    Task task;
+    task.runnable = std::move(r);
+    task.trace = Trace::CurrentTrace();
+    // See DoSubmit().
+    if (task.trace) {
+      task.trace->AddRef();
+    }
+    task.submit_time = submit_time;
+
+    // Add the task to the token's queue, and the token to its worker's
+    // queue if it has become runnable.
+    ThreadPoolToken::State state = token->state();
+    DCHECK(state == ThreadPoolToken::State::IDLE ||
+           state == ThreadPoolToken::State::RUNNING);
+    token->entries_.emplace_back(std::move(task));
+    if (state == ThreadPoolToken::State::IDLE ||
+        token->mode() == ExecutionMode::CONCURRENT) {
+      q->queue.emplace_back(token);
+      if (state == ThreadPoolToken::State::IDLE) {
+        token->Transition(ThreadPoolToken::State::RUNNING);
+      }
+      // Wake up the queue's worker if it's parked. Otherwise it's busy, so
+      // wake up some other parked worker to steal the task.
+      if (q->parked) {
+        q->parked = false;
+        num_parked_workers_--;
+        q->wake_cond.Signal();
+      } else {
+        wake_other = num_parked_workers_ > 0;
+      }
+    }
+  }
+  if (wake_other) {
+    WakeParkedWorker();
+  }
+
+  if (metrics_.queue_length_histogram) {
+    metrics_.queue_length_histogram->Increment(length_at_submit);
+  }
+  if (token->metrics_.queue_length_histogram) {
+    token->metrics_.queue_length_histogram->Increment(length_at_submit);
+  }
+  return Status::OK();
+}
+
+void ThreadPool::WakeParkedWorker() {
+  for (auto& q : worker_queues_) {
+    MutexLock l(q->lock);
+    if (q->parked) {
+      q->parked = false;
+      num_parked_workers_--;
+      q->wake_cond.Signal();
+      return;
+    }
+  }
+}
+
+void ThreadPool::ReleaseOutstandingTasks(int64_t n) {
+  if (num_outstanding_tasks_.fetch_sub(n) == n) {
+    // Take the lock so that the broadcast can't fall between a waiter
+    // checking for pending tasks and starting to wait.
+    MutexLock l(lock_);
+    idle_cond_.Broadcast();
+  }
+}
+
+bool ThreadPool::HasPendingTasksUnlocked() const {
+  if (work_stealing_) {
+    return num_outstanding_tasks_ > 0;
+  }
+  return total_queued_tasks_ > 0 || active_threads_ > 0;
+}
+
 void ThreadPool::Wait() {
   MutexLock unique_lock(lock_);
   CheckNotPoolThreadUnlocked();
-  while (total_queued_tasks_ > 0 || active_threads_ > 0) {
+  while (HasPendingTasksUnlocked()) {
     idle_cond_.Wait();
   }
 }
@@ -574,7 +781,7 @@ bool ThreadPool::WaitUntil(const MonoTime& until) {
 bool ThreadPool::WaitFor(const MonoDelta& delta) {
   MutexLock unique_lock(lock_);
   CheckNotPoolThreadUnlocked();
-  while (total_queued_tasks_ > 0 || active_threads_ > 0) {
+  while (HasPendingTasksUnlocked()) {
     if (!idle_cond_.TimedWait(delta)) {
       return false;
     }
@@ -583,6 +790,7 @@ bool ThreadPool::WaitFor(const MonoDelta& delta) {
 }
 
 void ThreadPool::DispatchThread() {
+  MaybeBindToNumaNode();
   MutexLock unique_lock(lock_);
   InsertOrDie(&threads_, Thread::current_thread());
   DCHECK_GT(num_threads_pending_start_, 0);
@@ -633,49 +841,7 @@ void ThreadPool::DispatchThread() {
 
     unique_lock.Unlock();
 
-    // Release the reference which was held by the queued item.
-    ADOPT_TRACE(task.trace);
-    if (task.trace) {
-      task.trace->Release();
-    }
-
-    // Update metrics
-    MonoTime now(MonoTime::Now());
-    int64_t queue_time_us = (now - task.submit_time).ToMicroseconds();
-    TRACE_COUNTER_INCREMENT(queue_time_trace_metric_name_, queue_time_us);
-    if (metrics_.queue_time_us_histogram) {
-      metrics_.queue_time_us_histogram->Increment(queue_time_us);
-    }
-    if (token->metrics_.queue_time_us_histogram) {
-      token->metrics_.queue_time_us_histogram->Increment(queue_time_us);
-    }
-
-    // Execute the task
-    {
-      MicrosecondsInt64 start_wall_us = GetMonoTimeMicros();
-      MicrosecondsInt64 start_cpu_us = GetThreadCpuTimeMicros();
-
-      task.runnable->Run();
-
-      int64_t wall_us = GetMonoTimeMicros() - start_wall_us;
-      int64_t cpu_us = GetThreadCpuTimeMicros() - start_cpu_us;
-
-      if (metrics_.run_time_us_histogram) {
-        metrics_.run_time_us_histogram->Increment(wall_us);
-      }
-      if (token->metrics_.run_time_us_histogram) {
-        token->metrics_.run_time_us_histogram->Increment(wall_us);
-      }
-      TRACE_COUNTER_INCREMENT(run_wall_time_trace_metric_name_, wall_us);
-      TRACE_COUNTER_INCREMENT(run_cpu_time_trace_metric_name_, cpu_us);
-    }
-    // Destruct the task while we do not hold the lock.
-    //
-    // The task's destructor may be expensive if it has a lot of bound
-    // objects, and we don't want to block submission of the threadpool.
-    // In the worst case, the destructor might even try to do something
-    // with this threadpool, and produce a deadlock.
-    task.runnable.reset();
+    RunTask(&task, token);
     unique_lock.Lock();
 
     // Possible states:
@@ -717,11 +883,160 @@ void ThreadPool::DispatchThread() {
   }
 }
 
+void ThreadPool::RunTask(Task* task, ThreadPoolToken* token) {
+  // Release the reference which was held by the queued item.
+  ADOPT_TRACE(task->trace);
+  if (task->trace) {
+    task->trace->Release();
+  }
+
+  // Update metrics
+  MonoTime now(MonoTime::Now());
+  int64_t queue_time_us = (now - task->submit_time).ToMicroseconds();
+  TRACE_COUNTER_INCREMENT(queue_time_trace_metric_name_, queue_time_us);
+  if (metrics_.queue_time_us_histogram) {
+    metrics_.queue_time_us_histogram->Increment(queue_time_us);
+  }
+  if (token->metrics_.queue_time_us_histogram) {
+    token->metrics_.queue_time_us_histogram->Increment(queue_time_us);
+  }
+
+  // Execute the task
+  {
+    MicrosecondsInt64 start_wall_us = GetMonoTimeMicros();
+    MicrosecondsInt64 start_cpu_us = GetThreadCpuTimeMicros();
+
+    task->runnable->Run();
+
+    int64_t wall_us = GetMonoTimeMicros() - start_wall_us;
+    int64_t cpu_us = GetThreadCpuTimeMicros() - start_cpu_us;
+
+    if (metrics_.run_time_us_histogram) {
+      metrics_.run_time_us_histogram->Increment(wall_us);
+    }
+    if (token->metrics_.run_time_us_histogram) {
+      token->metrics_.run_time_us_histogram->Increment(wall_us);
+    }
+    TRACE_COUNTER_INCREMENT(run_wall_time_trace_metric_name_, wall_us);
+    TRACE_COUNTER_INCREMENT(run_cpu_time_trace_metric_name_, cpu_us);
+  }
+  // Destruct the task while we do not hold the lock.
+  //
+  // The task's destructor may be expensive if it has a lot of bound
+  // objects, and we don't want to block submission of the threadpool.
+  // In the worst case, the destructor might even try to do something
+  // with this threadpool, and produce a deadlock.
+  task->runnable.reset();
+}
+
+void ThreadPool::WorkStealingDispatchThread(int queue_idx) {
+  MaybeBindToNumaNode();
+  {
+    MutexLock l(lock_);
+    InsertOrDie(&threads_, Thread::current_thread());
+    DCHECK_GT(num_threads_pending_start_, 0);
+    num_threads_++;
+    num_threads_pending_start_--;
+  }
+  WorkerQueue* own = worker_queues_[queue_idx].get();
+
+  while (!shutting_down_) {
+    Task task;
+    ThreadPoolToken* token;
+    bool found = TakeOrStealTask(queue_idx, &task, &token);
+    if (!found) {
+      // Park. Having marked ourselves as parked, look for work once more:
+      // a submitter which didn't see us parked must have queued its task
+      // before we take this second look.
+      {
+        MutexLock l(own->lock);
+        own->parked = true;
+        num_parked_workers_++;
+      }
+      found = TakeOrStealTask(queue_idx, &task, &token);
+      MutexLock l(own->lock);
+      while (!found && own->parked && !shutting_down_) {
+        own->wake_cond.Wait();
+      }
+      if (own->parked) {
+        own->parked = false;
+        num_parked_workers_--;
+      }
+    }
+    if (found) {
+      RunTask(&task, token);
+      FinishWorkStealingTask(token);
+    }
+  }
+
+  MutexLock l(lock_);
+  CHECK_EQ(threads_.erase(Thread::current_thread()), 1);
+  num_threads_--;
+  if (num_threads_ + num_threads_pending_start_ == 0) {
+    no_threads_cond_.Broadcast();
+  }
+}
+
+bool ThreadPool::TakeOrStealTask(int queue_idx, Task* task, ThreadPoolToken** token) {
+  int num_queues = worker_queues_.size();
+  for (int i = 0; i < num_queues; i++) {
+    WorkerQueue* q = worker_queues_[(queue_idx + i) % num_queues].get();
+    MutexLock l(q->lock);
+    if (q->queue.empty()) {
+      continue;
+    }
+    ThreadPoolToken* t = q->queue.front();
+    q->queue.pop_front();
+    DCHECK_EQ(ThreadPoolToken::State::RUNNING, t->state());
+    DCHECK(!t->entries_.empty());
+    *task = std::move(t->entries_.front());
+    t->entries_.pop_front();
+    t->active_threads_++;
+    *token = t;
+    return true;
+  }
+  return false;
+}
+
+void ThreadPool::FinishWorkStealingTask(ThreadPoolToken* token) {
+  {
+    MutexLock l(*token->lock_);
+    // See the end of the loop in DispatchThread(). A SERIAL token with more
+    // tasks goes back to its own worker's queue, keeping its tasks in order.
+    ThreadPoolToken::State state = token->state();
+    DCHECK(state == ThreadPoolToken::State::RUNNING ||
+           state == ThreadPoolToken::State::QUIESCING);
+    if (--token->active_threads_ == 0) {
+      if (state == ThreadPoolToken::State::QUIESCING) {
+        DCHECK(token->entries_.empty());
+        token->Transition(ThreadPoolToken::State::QUIESCED);
+      } else if (token->entries_.empty()) {
+        token->Transition(ThreadPoolToken::State::IDLE);
+      } else if (token->mode() == ExecutionMode::SERIAL && !shutting_down_) {
+        worker_queues_[token->queue_idx_]->queue.emplace_back(token);
+      }
+    }
+  }
+  ReleaseOutstandingTasks(1);
+}
+
 Status ThreadPool::CreateThread() {
   return kudu::Thread::Create("thread pool", strings::Substitute("$0 [worker]", name_),
                               &ThreadPool::DispatchThread, this, nullptr);
 }
 
+void ThreadPool::MaybeBindToNumaNode() {
+  if (numa_node_ < 0) {
+    return;
+  }
+  Status s = BindCurrentThreadToNumaNode(numa_node_);
+  if (PREDICT_FALSE(!s.ok())) {
+    KLOG_EVERY_N_SECS(WARNING, 60) << Substitute("Unable to bind a worker of pool $0 to "
+                                                 "NUMA node $1: $2", name_, numa_node_,
+                                                 s.ToString()) << THROTTLE_MSG;
+  }
+}
+
 void ThreadPool::CheckNotPoolThreadUnlocked() {
   Thread* current = Thread::current_thread();
   if (ContainsKey(threads_, current)) {
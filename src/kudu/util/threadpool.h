@@ -17,11 +17,14 @@
 #ifndef KUDU_UTIL_THREAD_POOL_H
 #define KUDU_UTIL_THREAD_POOL_H
 
+#include <atomic>
+#include <cstdint>
 #include <deque>
 #include <iosfwd>
 #include <memory>
 #include <string>
 #include <unordered_set>
+#include <vector>
 
 #include <gtest/gtest_prod.h>
 
@@ -112,6 +115,21 @@ struct ThreadPoolMetrics {
 // metrics: Histograms, counters, etc. to update on various threadpool events.
 //    Default: not set.
 //
+// work_stealing: Run the pool as a fixed set of 'max_threads' workers, each
+//    with its own queue, rather than with a single queue shared by all
+//    threads. Each token is assigned to one worker's queue when it is
+//    created, and workers which run out of work steal tasks from the other
+//    queues. Submitting and running tasks then only contends on the lock of
+//    the token's queue rather than on the lock of the whole pool, which helps
+//    pools running many short tasks from many tokens. 'min_threads' and
+//    'idle_timeout' are ignored, so 'max_threads' should be modest.
+//    Default: false.
+//
+// numa_node: Bind the worker threads to the CPUs of this NUMA node, and make
+//    them allocate their memory from it. Failing to bind a thread is logged
+//    but doesn't fail it. See kudu/util/numa.h.
+//    Default: -1, i.e. the threads aren't bound.
+//
 class ThreadPoolBuilder {
  public:
   explicit ThreadPoolBuilder(std::string name);
@@ -124,6 +142,8 @@ class ThreadPoolBuilder {
   ThreadPoolBuilder& set_max_queue_size(int max_queue_size);
   ThreadPoolBuilder& set_idle_timeout(const MonoDelta& idle_timeout);
   ThreadPoolBuilder& set_metrics(ThreadPoolMetrics metrics);
+  ThreadPoolBuilder& set_work_stealing(bool work_stealing);
+  ThreadPoolBuilder& set_numa_node(int numa_node);
 
   // Instantiate a new ThreadPool with the existing builder arguments.
   Status Build(gscoped_ptr<ThreadPool>* pool) const;
@@ -137,6 +157,8 @@ class ThreadPoolBuilder {
   int max_queue_size_;
   MonoDelta idle_timeout_;
   ThreadPoolMetrics metrics_;
+  bool work_stealing_;
+  int numa_node_;
 
   DISALLOW_COPY_AND_ASSIGN(ThreadPoolBuilder);
 };
@@ -250,6 +272,33 @@ class ThreadPool {
     MonoTime submit_time;
   };
 
+  // In work-stealing mode, the queue of one worker thread. The state of the
+  // tokens assigned to this queue is protected by its 'lock' rather than by
+  // the pool's lock_.
+  struct WorkerQueue {
+    WorkerQueue()
+        : wake_cond(&lock),
+          parked(false) {
+    }
+
+    Mutex lock;
+
+    // Signaled when the parked worker of this queue should look for work.
+    ConditionVariable wake_cond;
+
+    // FIFO of the tokens assigned to this queue from which tasks should be
+    // executed.
+    std::deque<ThreadPoolToken*> queue;
+
+    // Whether the worker of this queue is parked waiting for work.
+    bool parked;
+
+    // ExecutionMode::CONCURRENT token used for the tokenless submissions
+    // which are assigned to this queue. Declared last so that it is
+    // destroyed while 'lock' is still valid.
+    std::unique_ptr<ThreadPoolToken> tokenless;
+  };
+
   // Creates a new thread pool using a builder.
   explicit ThreadPool(const ThreadPoolBuilder& builder);
 
@@ -259,18 +308,59 @@ class ThreadPool {
   // Dispatcher responsible for dequeueing and executing the tasks
   void DispatchThread();
 
+  // Dispatcher of the worker owning worker_queues_[queue_idx] in
+  // work-stealing mode.
+  void WorkStealingDispatchThread(int queue_idx);
+
   // Create new thread.
   //
   // REQUIRES: caller has incremented 'num_threads_pending_start_' ahead of this call.
   // NOTE: For performance reasons, lock_ should not be held.
   Status CreateThread();
 
+  // Binds the calling worker thread to 'numa_node_', if set.
+  void MaybeBindToNumaNode();
+
+  // Runs 'task' of 'token' and updates the metrics, without holding any locks.
+  void RunTask(Task* task, ThreadPoolToken* token);
+
   // Aborts if the current thread is a member of this thread pool.
   void CheckNotPoolThreadUnlocked();
 
   // Submits a task to be run via token.
   Status DoSubmit(std::shared_ptr<Runnable> r, ThreadPoolToken* token);
 
+  // DoSubmit() in work-stealing mode.
+  Status DoSubmitWorkStealing(std::shared_ptr<Runnable> r, ThreadPoolToken* token);
+
+  // Takes the next task from the worker queues, starting with the one at
+  // 'queue_idx'. Returns false if all of the queues are empty.
+  bool TakeOrStealTask(int queue_idx, Task* task, ThreadPoolToken** token);
+
+  // Updates the state of 'token' after a worker finished running one of its
+  // tasks in work-stealing mode.
+  void FinishWorkStealingTask(ThreadPoolToken* token);
+
+  // Wakes up any one parked worker in work-stealing mode.
+  //
+  // NOTE: must not be called with any worker queue's lock held.
+  void WakeParkedWorker();
+
+  // Removes 'n' tasks from the count of outstanding tasks in work-stealing
+  // mode, waking up waiters if the pool became idle.
+  //
+  // NOTE: must not be called with lock_ or any worker queue's lock held.
+  void ReleaseOutstandingTasks(int64_t n);
+
+  // Returns true if there are queued or running tasks.
+  bool HasPendingTasksUnlocked() const;
+
+  // Allocates a new token assigned to worker queue 'queue_idx', or -1
+  // if the pool isn't in work-stealing mode.
+  std::unique_ptr<ThreadPoolToken> DoNewToken(ExecutionMode mode,
+                                              ThreadPoolMetrics metrics,
+                                              int queue_idx);
+
   // Releases token 't' and invalidates it.
   void ReleaseToken(ThreadPoolToken* t);
 
@@ -279,6 +369,7 @@ class ThreadPool {
   const int max_threads_;
   const int max_queue_size_;
   const MonoDelta idle_timeout_;
+  const int numa_node_;
 
   // Overall status of the pool. Set to an error when the pool is shut down.
   //
@@ -341,6 +432,32 @@ class ThreadPool {
   // Protected by lock_.
   std::unordered_set<Thread*> threads_;
 
+  // Whether this pool runs in work-stealing mode. If so, queue_,
+  // active_threads_ and total_queued_tasks_ are unused; the members below
+  // take their place.
+  const bool work_stealing_;
+
+  // One queue per worker thread, in work-stealing mode.
+  //
+  // Lock ordering: lock_ may be acquired before the lock of a worker queue,
+  // but not the other way around. At most one worker queue lock is held at
+  // a time.
+  std::vector<std::unique_ptr<WorkerQueue>> worker_queues_;
+
+  // Number of workers whose queue is marked as parked.
+  std::atomic<int> num_parked_workers_;
+
+  // Number of client tasks queued or running, in work-stealing mode.
+  std::atomic<int64_t> num_outstanding_tasks_;
+
+  // Used to assign tokens and tokenless submissions to the worker queues
+  // round-robin.
+  std::atomic<uint32_t> next_queue_idx_;
+
+  // Set when the pool is shut down in work-stealing mode, so that workers
+  // and submitters needn't consult pool_status_ under lock_.
+  std::atomic<bool> shutting_down_;
+
   // ExecutionMode::CONCURRENT token used by the pool for tokenless submission.
   std::unique_ptr<ThreadPoolToken> tokenless_;
 
@@ -358,7 +475,8 @@ class ThreadPool {
 // thread pool. Tokens can only be created via ThreadPool::NewToken().
 //
 // All functions are thread-safe. Mutable members are protected via the
-// ThreadPool's lock.
+// ThreadPool's lock or, in work-stealing mode, via the lock of the worker
+// queue the token is assigned to.
 class ThreadPoolToken {
  public:
   // Destroys the token.
@@ -431,12 +549,19 @@ class ThreadPoolToken {
   // Returns a textual representation of 's' suitable for debugging.
   static const char* StateToString(State s);
 
-  // Constructs a new token.
+  // Constructs a new token. In work-stealing mode, 'queue_idx' is the
+  // index of the worker queue the token is assigned to; otherwise it's -1.
   //
   // The token may not outlive its thread pool ('pool').
   ThreadPoolToken(ThreadPool* pool,
                   ThreadPool::ExecutionMode mode,
-                  ThreadPoolMetrics metrics);
+                  ThreadPoolMetrics metrics,
+                  int queue_idx);
+
+  // Aborts if the current thread is a member of the token's thread pool.
+  //
+  // NOTE: must be called without holding 'lock_'.
+  void CheckNotPoolThread();
 
   // Changes this token's state to 'new_state' taking actions as needed.
   void Transition(State new_state);
@@ -466,6 +591,14 @@ class ThreadPoolToken {
   // Pointer to the token's thread pool.
   ThreadPool* pool_;
 
+  // Index of the worker queue this token is assigned to in work-stealing
+  // mode, or -1.
+  const int queue_idx_;
+
+  // The lock protecting the mutable members of this token: the pool's lock_,
+  // or the lock of worker queue 'queue_idx_'.
+  Mutex* const lock_;
+
   // Token state machine.
   State state_;
 
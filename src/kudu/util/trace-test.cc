@@ -16,11 +16,14 @@
 // under the License.
 
 #include <cctype>
+#include <cinttypes>
 #include <cstdint>
 #include <cstring>
 #include <map>
 #include <ostream>
+#include <sstream>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <gtest/gtest.h>
@@ -31,6 +34,7 @@
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/ref_counted.h"
+#include "kudu/gutil/stringprintf.h"
 #include "kudu/gutil/walltime.h"
 #include "kudu/util/atomic.h"
 #include "kudu/util/countdown_latch.h"
@@ -45,6 +49,7 @@
 #include "kudu/util/test_util.h"
 #include "kudu/util/thread.h"
 #include "kudu/util/trace_metrics.h"
+#include "kudu/util/trace_spans.h"
 #include "kudu/util/trace.h"
 
 using kudu::debug::TraceLog;
@@ -124,6 +129,73 @@ TEST_F(TraceTest, TestChildTrace) {
             XOutDigits(traceA->DumpToString(Trace::NO_FLAGS)));
 }
 
+// Test that the spans of a sampled trace and of its child traces are
+// recorded with the right parents, and are exported in the Zipkin format.
+TEST_F(TraceTest, TestSpans) {
+  scoped_refptr<Trace> unsampled(new Trace);
+  ASSERT_FALSE(unsampled->span_context().sampled());
+
+  const uint64_t trace_id = TraceSpanCollector::NewId();
+  const uint64_t parent_span_id = TraceSpanCollector::NewId();
+  scoped_refptr<Trace> trace(new Trace);
+  trace->StartSpan(trace_id, parent_span_id);
+  ASSERT_TRUE(trace->span_context().sampled());
+  const uint64_t span_id = trace->span_context().span_id;
+  ASSERT_NE(0, span_id);
+  ASSERT_NE(parent_span_id, span_id);
+
+  // A child trace records into the same span as its parent.
+  scoped_refptr<Trace> child(new Trace);
+  trace->AddChildTrace("child", child.get());
+  ASSERT_EQ(trace_id, child->span_context().trace_id);
+  ASSERT_EQ(span_id, child->span_context().span_id);
+
+  MonoTime start = MonoTime::Now();
+  {
+    ADOPT_TRACE(child.get());
+    SleepFor(MonoDelta::FromMilliseconds(10));
+    TRACE_SPAN("wait", start);
+  }
+  trace->RecordSpan("root", start, MonoTime::Now(), { { "peer", "127.0.0.1:1" } });
+
+  // Spans of unsampled traces are not recorded.
+  unsampled->RecordSpan("unsampled", start, MonoTime::Now());
+
+  vector<TraceSpan> spans;
+  for (auto& span : TraceSpanCollector::GetInstance()->GetSpans()) {
+    ASSERT_NE("unsampled", span.name);
+    if (span.trace_id == trace_id) {
+      spans.emplace_back(std::move(span));
+    }
+  }
+  ASSERT_EQ(2, spans.size());
+  ASSERT_EQ("wait", spans[0].name);
+  ASSERT_EQ(span_id, spans[0].parent_span_id);
+  ASSERT_GE(spans[0].duration_micros, 10000);
+  ASSERT_EQ("root", spans[1].name);
+  ASSERT_EQ(span_id, spans[1].span_id);
+  ASSERT_EQ(parent_span_id, spans[1].parent_span_id);
+  ASSERT_LE(spans[1].start_micros, GetCurrentTimeMicros());
+
+  std::ostringstream json;
+  TraceSpanCollector::GetInstance()->WriteAsZipkinJson(&json);
+  Document d;
+  d.Parse<0>(json.str().c_str());
+  ASSERT_TRUE(d.IsArray());
+  int num_found = 0;
+  for (rapidjson::SizeType i = 0; i < d.Size(); i++) {
+    const Value& span = d[i];
+    if (span["traceId"].GetString() == StringPrintf("%016" PRIx64, trace_id)) {
+      ASSERT_EQ(16, strlen(span["id"].GetString()));
+      ASSERT_TRUE(span.HasMember("parentId"));
+      ASSERT_TRUE(span["timestamp"].IsInt64());
+      ASSERT_TRUE(span["localEndpoint"].HasMember("serviceName"));
+      num_found++;
+    }
+  }
+  ASSERT_EQ(2, num_found);
+}
+
 static void GenerateTraceEvents(int thread_id,
                                 int num_events) {
   for (int i = 0; i < num_events; i++) {
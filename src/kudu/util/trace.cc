@@ -257,6 +257,9 @@ void Trace::DumpCurrentTrace() {
 
 void Trace::AddChildTrace(StringPiece label, Trace* child_trace) {
   CHECK(arena_->RelocateStringPiece(label, &label));
+  if (span_context_.sampled() && !child_trace->span_context().sampled()) {
+    child_trace->set_span_context(span_context_);
+  }
 
   std::lock_guard<simple_spinlock> l(lock_);
   scoped_refptr<Trace> ptr(child_trace);
@@ -268,4 +271,41 @@ std::vector<std::pair<StringPiece, scoped_refptr<Trace>>> Trace::ChildTraces() c
   return child_traces_;
 }
 
+void Trace::StartSpan(uint64_t trace_id, uint64_t parent_span_id) {
+  DCHECK_NE(0, trace_id);
+  span_context_.trace_id = trace_id;
+  span_context_.span_id = TraceSpanCollector::NewId();
+  span_context_.parent_span_id = parent_span_id;
+}
+
+void Trace::RecordSpan(string name, MonoTime start, MonoTime end,
+                       vector<pair<string, string>> tags) const {
+  if (!span_context_.sampled()) {
+    return;
+  }
+  TraceSpan span;
+  span.trace_id = span_context_.trace_id;
+  span.span_id = span_context_.span_id;
+  span.parent_span_id = span_context_.parent_span_id;
+  span.name = std::move(name);
+  span.start_micros = TraceSpanCollector::ToWallMicros(start);
+  span.duration_micros = (end - start).ToMicroseconds();
+  span.tags = std::move(tags);
+  TraceSpanCollector::GetInstance()->Add(std::move(span));
+}
+
+void Trace::RecordChildSpan(string name, MonoTime start, MonoTime end) const {
+  if (!span_context_.sampled()) {
+    return;
+  }
+  TraceSpan span;
+  span.trace_id = span_context_.trace_id;
+  span.span_id = TraceSpanCollector::NewId();
+  span.parent_span_id = span_context_.span_id;
+  span.name = std::move(name);
+  span.start_micros = TraceSpanCollector::ToWallMicros(start);
+  span.duration_micros = (end - start).ToMicroseconds();
+  TraceSpanCollector::GetInstance()->Add(std::move(span));
+}
+
 } // namespace kudu
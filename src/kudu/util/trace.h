@@ -30,7 +30,9 @@
 #include "kudu/gutil/threading/thread_collision_warner.h"
 #include "kudu/gutil/walltime.h"
 #include "kudu/util/locks.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/trace_metrics.h"
+#include "kudu/util/trace_spans.h"
 
 namespace kudu {
 class Trace;
@@ -97,6 +99,23 @@ class Trace;
 #define TRACE_COUNTER_SCOPE_LATENCY_US(counter_name) \
   ::kudu::ScopedTraceLatencyCounter _scoped_latency(counter_name)
 
+// Record a span named 'name' which started at the MonoTime 'start' and ends
+// now, as a child of the current trace's span, if the current trace is part
+// of a sampled distributed trace (see trace_spans.h). For example:
+//
+//   MonoTime start = MonoTime::Now();
+//   ... wait for the row lock
+//   TRACE_SPAN("row_lock_wait", start);
+//
+// NOTE: like TRACE_COUNTER_INCREMENT, the 'name' should be a constant.
+#define TRACE_SPAN(name, start) \
+  do { \
+    kudu::Trace* _trace = Trace::CurrentTrace(); \
+    if (_trace && _trace->span_context().sampled()) { \
+      _trace->RecordChildSpan(name, start, MonoTime::Now()); \
+    } \
+  } while (0);
+
 // Construct a constant C string counter name which acts as a sort of
 // coarse-grained histogram for trace metrics.
 #define BUCKETED_COUNTER_NAME(prefix, duration_us)      \
@@ -188,6 +207,34 @@ class Trace : public RefCountedThreadSafe<Trace> {
   // Return a copy of the current set of related "child" traces.
   std::vector<std::pair<StringPiece, scoped_refptr<Trace>>> ChildTraces() const;
 
+  // Makes this trace record into a new span of the sampled distributed
+  // trace 'trace_id', as a child of the span 'parent_span_id' (0 to start a
+  // new root span). Child traces added afterwards record into the same span.
+  //
+  // This must be called before the trace is shared with other threads.
+  void StartSpan(uint64_t trace_id, uint64_t parent_span_id);
+
+  // Makes this trace record into the existing span 'context', e.g. to
+  // propagate that span to the RPCs made on its behalf.
+  //
+  // This must be called before the trace is shared with other threads.
+  void set_span_context(const TraceSpanContext& context) {
+    span_context_ = context;
+  }
+
+  const TraceSpanContext& span_context() const {
+    return span_context_;
+  }
+
+  // If this trace is sampled, records this trace's own span, named 'name',
+  // with the given start and end times and tags.
+  void RecordSpan(std::string name, MonoTime start, MonoTime end,
+                  std::vector<std::pair<std::string, std::string>> tags = {}) const;
+
+  // If this trace is sampled, records a new child span of this trace's span.
+  // See also TRACE_SPAN().
+  void RecordChildSpan(std::string name, MonoTime start, MonoTime end) const;
+
   // Return the current trace attached to this thread, if there is one.
   static Trace* CurrentTrace() {
     return threadlocal_trace_;
@@ -237,6 +284,10 @@ class Trace : public RefCountedThreadSafe<Trace> {
 
   TraceMetrics metrics_;
 
+  // The span of the distributed trace which this trace records into, if it
+  // is sampled.
+  TraceSpanContext span_context_;
+
   DISALLOW_COPY_AND_ASSIGN(Trace);
 };
 
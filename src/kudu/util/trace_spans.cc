@@ -0,0 +1,162 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/util/trace_spans.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "kudu/gutil/stringprintf.h"
+#include "kudu/gutil/walltime.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/jsonwriter.h"
+#include "kudu/util/net/net_util.h"
+#include "kudu/util/random.h"
+#include "kudu/util/random_util.h"
+#include "kudu/util/status.h"
+
+DEFINE_double(trace_sampling_rate, 0,
+              "Fraction of incoming RPCs which are not already part of a sampled "
+              "distributed trace that start a new one. The spans of sampled traces "
+              "are exported at /tracing/json/spans.");
+TAG_FLAG(trace_sampling_rate, advanced);
+TAG_FLAG(trace_sampling_rate, experimental);
+TAG_FLAG(trace_sampling_rate, runtime);
+
+DEFINE_int32(trace_span_buffer_size, 10000,
+             "Number of the most recently finished spans of sampled distributed "
+             "traces to keep in memory for export.");
+TAG_FLAG(trace_span_buffer_size, advanced);
+TAG_FLAG(trace_span_buffer_size, experimental);
+TAG_FLAG(trace_span_buffer_size, runtime);
+
+using std::lock_guard;
+using std::string;
+using std::vector;
+
+namespace kudu {
+
+namespace {
+
+ThreadSafeRandom* IdRandom() {
+  static ThreadSafeRandom* random = new ThreadSafeRandom(GetRandomSeed32());
+  return random;
+}
+
+string IdToHex(uint64_t id) {
+  return StringPrintf("%016" PRIx64, id);
+}
+
+} // anonymous namespace
+
+TraceSpanCollector::TraceSpanCollector()
+    : service_name_(google::ProgramInvocationShortName()) {
+  Status s = GetHostname(&hostname_);
+  if (!s.ok()) {
+    LOG(WARNING) << "Unable to determine the hostname for trace spans: " << s.ToString();
+  }
+}
+
+uint64_t TraceSpanCollector::NewId() {
+  uint64_t id;
+  do {
+    id = IdRandom()->Next64();
+  } while (id == 0);
+  return id;
+}
+
+bool TraceSpanCollector::ShouldSampleNewTrace() {
+  double rate = FLAGS_trace_sampling_rate;
+  if (PREDICT_TRUE(rate <= 0)) {
+    return false;
+  }
+  return IdRandom()->NextDoubleFraction() < rate;
+}
+
+int64_t TraceSpanCollector::ToWallMicros(MonoTime time) {
+  return GetCurrentTimeMicros() - (MonoTime::Now() - time).ToMicroseconds();
+}
+
+void TraceSpanCollector::Add(TraceSpan span) {
+  const size_t capacity = std::max(FLAGS_trace_span_buffer_size, 0);
+  lock_guard<simple_spinlock> l(lock_);
+  while (!spans_.empty() && spans_.size() >= capacity) {
+    spans_.pop_front();
+  }
+  if (capacity > 0) {
+    spans_.emplace_back(std::move(span));
+  }
+}
+
+vector<TraceSpan> TraceSpanCollector::GetSpans() const {
+  lock_guard<simple_spinlock> l(lock_);
+  return vector<TraceSpan>(spans_.begin(), spans_.end());
+}
+
+void TraceSpanCollector::WriteAsZipkinJson(std::ostringstream* out) const {
+  vector<TraceSpan> spans = GetSpans();
+
+  JsonWriter jw(out, JsonWriter::COMPACT);
+  jw.StartArray();
+  for (const auto& span : spans) {
+    jw.StartObject();
+    jw.String("traceId");
+    jw.String(IdToHex(span.trace_id));
+    jw.String("id");
+    jw.String(IdToHex(span.span_id));
+    if (span.parent_span_id != 0) {
+      jw.String("parentId");
+      jw.String(IdToHex(span.parent_span_id));
+    }
+    jw.String("name");
+    jw.String(span.name);
+    jw.String("timestamp");
+    jw.Int64(span.start_micros);
+    jw.String("duration");
+    jw.Int64(span.duration_micros);
+
+    jw.String("localEndpoint");
+    jw.StartObject();
+    jw.String("serviceName");
+    jw.String(service_name_);
+    jw.EndObject();
+
+    jw.String("tags");
+    jw.StartObject();
+    if (!hostname_.empty()) {
+      jw.String("host");
+      jw.String(hostname_);
+    }
+    for (const auto& tag : span.tags) {
+      jw.String(tag.first);
+      jw.String(tag.second);
+    }
+    jw.EndObject();
+    jw.EndObject();
+  }
+  jw.EndArray();
+}
+
+} // namespace kudu
@@ -0,0 +1,124 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// Support for sampled distributed traces which follow a request across RPC
+// hops (for example, from a tablet server handling a write to the followers
+// which replicate it).
+//
+// Unlike a Trace, which is local to a single server, the spans of a
+// distributed trace are tied together by a trace ID and by each span's parent
+// span ID, which are propagated in the TraceContextPB of the RPC request
+// header. Each server keeps the spans it finished recently in the process-wide
+// TraceSpanCollector, from which they are exported in the Zipkin v2 JSON format
+// so that the spans of all servers can be assembled by an external collector.
+#ifndef KUDU_UTIL_TRACE_SPANS_H
+#define KUDU_UTIL_TRACE_SPANS_H
+
+#include <cstdint>
+#include <deque>
+#include <iosfwd>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/singleton.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/monotime.h"
+
+namespace kudu {
+
+// The position of a Trace within a sampled distributed trace.
+struct TraceSpanContext {
+  // The ID of the distributed trace, or 0 if the trace is not sampled.
+  uint64_t trace_id = 0;
+
+  // The ID of the span which the Trace records into.
+  uint64_t span_id = 0;
+
+  // The ID of the parent of 'span_id', or 0 if it is the root span.
+  uint64_t parent_span_id = 0;
+
+  bool sampled() const {
+    return trace_id != 0;
+  }
+};
+
+// A finished span.
+struct TraceSpan {
+  uint64_t trace_id = 0;
+  uint64_t span_id = 0;
+  uint64_t parent_span_id = 0;
+
+  std::string name;
+
+  // The start of the span, in microseconds since the Unix epoch.
+  int64_t start_micros = 0;
+  int64_t duration_micros = 0;
+
+  // Arbitrary annotations, e.g. the address of the remote peer.
+  std::vector<std::pair<std::string, std::string>> tags;
+};
+
+// Keeps the most recently finished spans of this process in a ring buffer
+// of --trace_span_buffer_size entries.
+//
+// This class is thread-safe.
+class TraceSpanCollector {
+ public:
+  static TraceSpanCollector* GetInstance() {
+    return Singleton<TraceSpanCollector>::get();
+  }
+
+  // Returns a new random, non-zero trace or span ID.
+  static uint64_t NewId();
+
+  // Returns true if a request which isn't already part of a sampled trace
+  // should start a new one, according to --trace_sampling_rate.
+  static bool ShouldSampleNewTrace();
+
+  // Converts the monotonic time 'time' into microseconds since the Unix
+  // epoch, as used for TraceSpan::start_micros.
+  static int64_t ToWallMicros(MonoTime time);
+
+  // Adds the given finished span, evicting the oldest one if the buffer is full.
+  void Add(TraceSpan span);
+
+  // Writes the buffered spans as a Zipkin v2 JSON array, oldest first.
+  void WriteAsZipkinJson(std::ostringstream* out) const;
+
+  // Returns a copy of the buffered spans, oldest first.
+  std::vector<TraceSpan> GetSpans() const;
+
+ private:
+  friend class Singleton<TraceSpanCollector>;
+  TraceSpanCollector();
+
+  // The name and host which the spans of this process are reported under.
+  const std::string service_name_;
+  std::string hostname_;
+
+  // Protects 'spans_'.
+  mutable simple_spinlock lock_;
+  std::deque<TraceSpan> spans_;
+
+  DISALLOW_COPY_AND_ASSIGN(TraceSpanCollector);
+};
+
+} // namespace kudu
+
+#endif // KUDU_UTIL_TRACE_SPANS_H
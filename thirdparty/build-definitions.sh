@@ -419,6 +419,20 @@ build_lz4() {
   popd
 }
 
+build_zstd() {
+  ZSTD_BDIR=$TP_BUILD_DIR/$ZSTD_NAME$MODE_SUFFIX
+  mkdir -p $ZSTD_BDIR
+  pushd $ZSTD_BDIR
+
+  # zstd's Makefile builds in its source tree, so build from a copy.
+  rsync -av --delete $ZSTD_SOURCE/ .
+  CFLAGS="$EXTRA_CFLAGS -O3" \
+    make -C lib -j$PARALLEL $EXTRA_MAKEFLAGS \
+    PREFIX=$PREFIX \
+    install-static install-includes
+  popd
+}
+
 build_bitshuffle() {
   BITSHUFFLE_BDIR=$TP_BUILD_DIR/$BITSHUFFLE_NAME$MODE_SUFFIX
   mkdir -p $BITSHUFFLE_BDIR